@@ -0,0 +1,20 @@
+-- A scenario for eden_bench: the town, crowded with townsfolk who keep walking off to new spots
+setRegion('sereia')
+
+local townsfolk = {}
+for i = 1, 40 do
+   townsfolk[i] = { name = 'townsperson' .. i, spritesheet = 'npc1', x = map:tilesToPixels((i - 1) % 10), y = map:tilesToPixels(math.floor((i - 1) / 10)) }
+end
+
+-- The whole crowd is sent off in one call, with the destinations in one flat list that is reused every time
+local npcs = map:addNPCs(townsfolk)
+local destinations = {}
+while true do
+   for i = 1, #npcs do
+      destinations[i * 2 - 1] = map:tilesToPixels(random(0, 9))
+      destinations[i * 2] = map:tilesToPixels(random(0, 9))
+   end
+
+   map:moveActors(npcs, destinations)
+   delay(500)
+end
@@ -0,0 +1,11 @@
+-- A scenario for eden_bench: a cutscene that is nothing but dialogue, which the bench keeps dismissing
+setRegion('sereia')
+
+while true do
+   narrate('Our story begins four centuries after the angels left this world.', true)
+   say('Oh, hello!')
+   say('Can you do me a favour? Can you talk to the other guy for me?', true)
+   say('So did you talk to the other guy yet?', true)
+   narrate('It was a dark and<playSound(\'thunder\')>... stormy night...', true)
+   say('Thank you so much! I\'d reward you, but that hasn\'t been implemented yet!', true)
+end
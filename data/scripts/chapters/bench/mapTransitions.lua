@@ -0,0 +1,5 @@
+-- A scenario for eden_bench: the player goes in and out of the town as fast as the maps can load
+while true do
+   setRegion('sereia')
+   delay(100)
+end
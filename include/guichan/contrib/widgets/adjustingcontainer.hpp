@@ -112,12 +112,17 @@ namespace gcn
          * allowing you to show a fixed, maximum size while not limiting the actual
          * container.
          *
+         * The layout is only worked out again once it has changed, that is once
+         * a widget is added, removed or resized, or a property of the container
+         * is set, so calling adjustContent (or letting logic call it every frame)
+         * costs nothing while the layout stays the same.
+         *
          * For more help with using AdjustingContainers, try the Guichan forums
          * (http://guichan.sourceforge.net/forum/) or email mrlachatte@gmail.com.
          *
          * @author Josh Matthews
          */
-        class AdjustingContainer : public gcn::Container
+        class AdjustingContainer : public gcn::Container, public gcn::WidgetListener
         {
         public:
             /**
@@ -176,11 +181,17 @@ namespace gcn
             virtual void setHorizontalSpacing(unsigned int horizontalSpacing);
         
             /**
-             * Rearrange the widgets and resize the container.
+             * Rearrange the widgets and resize the container, if the layout has
+             * changed since they were last arranged.
              */
             virtual void adjustContent();
 
 
+            // Inherited from WidgetListener
+
+            virtual void widgetResized(const Event& event);
+
+
             // Inherited from Container
 
             virtual void logic();
@@ -192,6 +203,8 @@ namespace gcn
             virtual void remove(Widget *widget);
 
             virtual void clear();
+
+            virtual void death(const Event& event);
                
             /**
              * Possible alignment values for each column.
@@ -228,6 +241,11 @@ namespace gcn
             unsigned int mPaddingBottom;
             unsigned int mVerticalSpacing;
             unsigned int mHorizontalSpacing;
+
+            /**
+             * True if the widgets have to be arranged again, false otherwise.
+             */
+            bool mLayoutDirty;
         };
     }
 }
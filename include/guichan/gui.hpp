@@ -490,6 +490,35 @@ namespace gcn
          * Used to properly distribute mouse events.
          */
         std::deque<Widget*> mWidgetWithMouseQueue;
+
+        /**
+         * True if the widget at the last position looked up by getWidgetAt
+         * is still known, false otherwise.
+         */
+        bool mWidgetAtValid;
+
+        /**
+         * Holds the x coordinate of the last position looked up by getWidgetAt.
+         */
+        int mWidgetAtX;
+
+        /**
+         * Holds the y coordinate of the last position looked up by getWidgetAt.
+         */
+        int mWidgetAtY;
+
+        /**
+         * Holds the widget that was at the last position looked up by getWidgetAt.
+         */
+        Widget* mWidgetAt;
+
+        /**
+         * Holds the geometry revision of the widgets when the last position
+         * was looked up by getWidgetAt.
+         *
+         * @see Widget::getGeometryRevision
+         */
+        unsigned int mWidgetAtRevision;
     };
 }
 
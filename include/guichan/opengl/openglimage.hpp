@@ -79,6 +79,11 @@ namespace gcn
          * NOTE: The functions getPixel and putPixel are only guaranteed to work
          *       before an image has been converted to display format.
          *
+         * When the image is converted to display format right away, the pixels
+         * are uploaded to the texture straight from the array (only images that
+         * contain magic pink are copied first, to make it transparent), and the
+         * texture is only padded out to powers of two if the driver needs it.
+         *
          * @param pixels to load from.
          * @param width the width of the image.
          * @param height the height of the image.
@@ -143,6 +148,22 @@ namespace gcn
         virtual void convertToDisplayFormat();
 
     protected:
+        /**
+         * Picks the size of the texture for the image, which is the size of
+         * the image itself if the driver supports textures of any size, and
+         * the closest higher powers of two otherwise.
+         */
+        void setTextureSize();
+
+        /**
+         * Creates the texture for the image and uploads the pixels to it.
+         *
+         * @param pixels the pixels of the image, without magic pink.
+         * @param rowLength the number of pixels from the start of one row
+         *                  of the array to the start of the next.
+         */
+        void uploadTexture(const unsigned int* pixels, int rowLength);
+
         GLuint mTextureHandle;
         unsigned int* mPixels;
         bool mAutoFree;
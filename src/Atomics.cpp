@@ -0,0 +1,63 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Atomics.h"
+
+#ifdef _WIN32
+   #include <windows.h>
+#endif
+
+bool Atomics::compareAndSwap(volatile unsigned long* value, unsigned long expected, unsigned long replacement)
+{
+#ifdef _WIN32
+   return InterlockedCompareExchange(reinterpret_cast<volatile LONG*>(value), replacement, expected) == static_cast<LONG>(expected);
+#else
+   return __sync_bool_compare_and_swap(value, expected, replacement);
+#endif
+}
+
+unsigned long Atomics::exchange(volatile unsigned long* value, unsigned long replacement)
+{
+#ifdef _WIN32
+   return InterlockedExchange(reinterpret_cast<volatile LONG*>(value), replacement);
+#else
+   // Unlike __sync_lock_test_and_set, compare-and-swap is a full barrier
+   unsigned long current = *value;
+   for(;;)
+   {
+      const unsigned long previous = __sync_val_compare_and_swap(value, current, replacement);
+      if(previous == current) return previous;
+      current = previous;
+   }
+#endif
+}
+
+void Atomics::increment(volatile unsigned long* value)
+{
+#ifdef _WIN32
+   InterlockedIncrement(reinterpret_cast<volatile LONG*>(value));
+#else
+   __sync_fetch_and_add(value, 1UL);
+#endif
+}
+
+void Atomics::add(volatile long* value, long amount)
+{
+#ifdef _WIN32
+   InterlockedExchangeAdd(reinterpret_cast<volatile LONG*>(value), amount);
+#else
+   __sync_fetch_and_add(value, amount);
+#endif
+}
+
+void Atomics::memoryBarrier()
+{
+#ifdef _WIN32
+   MemoryBarrier();
+#else
+   __sync_synchronize();
+#endif
+}
@@ -0,0 +1,59 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ATOMICS_H
+#define ATOMICS_H
+
+/**
+ * The atomic operations used by the engine's lock-free queues and shared counters,
+ * on top of the Interlocked functions on Windows and the __sync builtins elsewhere.
+ * Every operation other than memoryBarrier is also a full barrier.
+ */
+namespace Atomics
+{
+   /**
+    * Sets a value that is shared between threads to a new one, if it has the expected value.
+    *
+    * @param value The value to set.
+    * @param expected The value that it must have.
+    * @param replacement The value to set it to.
+    *
+    * @return true iff the value was set.
+    */
+   bool compareAndSwap(volatile unsigned long* value, unsigned long expected, unsigned long replacement);
+
+   /**
+    * Sets a value that is shared between threads to a new one.
+    *
+    * @param value The value to set.
+    * @param replacement The value to set it to.
+    *
+    * @return The value that it had.
+    */
+   unsigned long exchange(volatile unsigned long* value, unsigned long replacement);
+
+   /**
+    * Adds one to a value that is shared between threads.
+    *
+    * @param value The value to add to.
+    */
+   void increment(volatile unsigned long* value);
+
+   /**
+    * Adds to a value that is shared between threads.
+    *
+    * @param value The value to add to.
+    * @param amount The amount to add, which can be negative.
+    */
+   void add(volatile long* value, long amount);
+
+   /**
+    * Keeps the writes before the barrier from being seen by other threads after the writes that come after it.
+    */
+   void memoryBarrier();
+}
+
+#endif
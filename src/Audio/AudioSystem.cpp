@@ -0,0 +1,183 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "AudioSystem.h"
+#include "JobSystem.h"
+#include "MemoryTracker.h"
+#include "StartupTimeline.h"
+#include <SDL.h>
+#include "SDL_mixer.h"
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_AUDIO;
+
+// CD quality, which every device can play
+const int AudioSystem::DEFAULT_SAMPLE_RATE = 44100;
+
+// About 12ms at the default rate, short enough that a menu blip feels instant
+const int AudioSystem::DEFAULT_BUFFER_SIZE = 512;
+
+// Stereo
+const int AudioSystem::DEFAULT_OUTPUT_CHANNELS = 2;
+
+// About 93ms at the default rate; past this, the delay would be noticeable even in the menus
+const int AudioSystem::MAX_BUFFER_SIZE = 4096;
+
+int AudioSystem::sampleRate = DEFAULT_SAMPLE_RATE;
+int AudioSystem::bufferSize = DEFAULT_BUFFER_SIZE;
+int AudioSystem::outputChannels = DEFAULT_OUTPUT_CHANNELS;
+bool AudioSystem::headless = false;
+bool AudioSystem::opened = false;
+AudioSystem::OpenJob* AudioSystem::openJob = NULL;
+std::string AudioSystem::openError;
+
+class AudioSystem::OpenJob : public JobSystem::Job
+{
+   /** The time that the device started opening. */
+   double startTime;
+
+   /** The time that the device finished opening (or failed to). */
+   double endTime;
+
+   /** The reason that the device couldn't be opened, or empty if it opened. */
+   std::string error;
+
+   public:
+      OpenJob() : JobSystem::Job(true), startTime(0), endTime(0)
+      {
+      }
+
+      void run(int /*slot*/)
+      {
+         startTime = StartupTimeline::getTime();
+         try
+         {
+            AudioSystem::openDevice();
+         }
+         catch(Exception& e)
+         {
+            // Exceptions can't cross threads, so the failure is reported when the main thread next waits for the device
+            error = e.getMessage();
+         }
+
+         endTime = StartupTimeline::getTime();
+      }
+
+      void finalize()
+      {
+         AudioSystem::openJob = NULL;
+         AudioSystem::openError = error;
+         StartupTimeline::add("audio device", startTime, endTime);
+      }
+};
+
+void AudioSystem::configure(int rate, int buffer, int channels)
+{
+   sampleRate = rate;
+   bufferSize = buffer;
+   outputChannels = channels;
+}
+
+void AudioSystem::setHeadless(bool enabled)
+{
+   headless = enabled;
+}
+
+void AudioSystem::initSubSystem()
+{
+   MemoryTracker::Scope memoryScope(MemoryTracker::AUDIO);
+   if(headless)
+   {
+      SDL_putenv(const_cast<char*>("SDL_AUDIODRIVER=dummy"));
+   }
+
+   if(SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+   {
+      T_T(std::string("Couldn't initialize SDL audio: ") + SDL_GetError());
+   }
+}
+
+void AudioSystem::openDevice()
+{
+   MemoryTracker::Scope memoryScope(MemoryTracker::AUDIO);
+   for(int buffer = bufferSize; !opened; buffer *= 2)
+   {
+      if(Mix_OpenAudio(sampleRate, AUDIO_S16SYS, outputChannels, buffer) == 0)
+      {
+         bufferSize = buffer;
+         opened = true;
+      }
+      else if(buffer >= MAX_BUFFER_SIZE)
+      {
+         T_T(std::string("Unable to open audio: ") + Mix_GetError());
+      }
+      else
+      {
+         DEBUG("Unable to open audio with a buffer of %d samples (%s); trying a larger buffer.", buffer, Mix_GetError());
+      }
+   }
+
+   // The device may not have been able to give the rate asked for, which changes how long the buffer lasts
+   Uint16 format;
+   Mix_QuerySpec(&sampleRate, &format, &outputChannels);
+   DEBUG("Opened audio at %dHz with %d channels and a buffer of %d samples (%.1fms).", sampleRate, outputChannels, bufferSize, getLatency());
+}
+
+void AudioSystem::open()
+{
+   initSubSystem();
+   openDevice();
+}
+
+void AudioSystem::openInBackground()
+{
+   // SDL's subsystems aren't started safely from other threads, so only the device is opened in the background
+   initSubSystem();
+
+   openJob = new OpenJob();
+   JobSystem::submit(openJob);
+}
+
+void AudioSystem::finishOpening()
+{
+   if(openJob != NULL)
+   {
+      JobSystem::wait(openJob);
+   }
+
+   if(!openError.empty())
+   {
+      const std::string error = openError;
+      openError.clear();
+      T_T(error);
+   }
+}
+
+void AudioSystem::close()
+{
+   if(openJob != NULL)
+   {
+      JobSystem::wait(openJob);
+   }
+
+   if(opened)
+   {
+      Mix_CloseAudio();
+      SDL_QuitSubSystem(SDL_INIT_AUDIO);
+      opened = false;
+   }
+}
+
+int AudioSystem::getBufferSize()
+{
+   return bufferSize;
+}
+
+double AudioSystem::getLatency()
+{
+   return sampleRate > 0 ? bufferSize * 1000.0 / sampleRate : 0;
+}
@@ -0,0 +1,125 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef AUDIO_SYSTEM_H
+#define AUDIO_SYSTEM_H
+
+#include <string>
+
+/**
+ * Opens and closes the audio device that sounds and music are mixed into, apart from the rest of SDL.
+ *
+ * The sample rate, buffer size and number of output channels can be set before the device is opened.
+ * The buffer size is how many samples the mixer fills at a time, so it sets how long a sound waits
+ * before it is heard; small buffers play sounds sooner, but not every device can keep up with them.
+ * If the device won't open with the buffer size asked for, the buffer is doubled until it does
+ * (up to MAX_BUFFER_SIZE).
+ *
+ * Opening the device can take a good part of startup on some drivers, so it can be opened on a job worker
+ * while the rest of the engine starts up (see openInBackground). Sounds and music wait for the device to open
+ * before they are loaded.
+ */
+class AudioSystem
+{
+   /** The job that opens the device in the background. */
+   class OpenJob;
+   friend class OpenJob;
+
+   /** The largest buffer (in samples) that the device is tried with, which is too long to be of use for anything shorter. */
+   static const int MAX_BUFFER_SIZE;
+
+   /** The sample rate (in Hz) to open the device with. */
+   static int sampleRate;
+
+   /** The size of the buffer (in samples) to open the device with. */
+   static int bufferSize;
+
+   /** The number of output channels (1 for mono, 2 for stereo) to open the device with. */
+   static int outputChannels;
+
+   /** True iff audio goes to SDL's dummy driver instead of a sound card. */
+   static bool headless;
+
+   /** True iff the device is open. */
+   static bool opened;
+
+   /** The job opening the device in the background, or NULL if it isn't being opened in the background. */
+   static OpenJob* openJob;
+
+   /** The reason that the device couldn't be opened in the background, or empty if nothing went wrong. */
+   static std::string openError;
+
+   /**
+    * Opens the device for the mixer, once SDL's audio has started.
+    */
+   static void openDevice();
+
+   /**
+    * Starts SDL's audio, on the main thread.
+    */
+   static void initSubSystem();
+
+   public:
+      /** The sample rate (in Hz) that the device is opened with by default. */
+      static const int DEFAULT_SAMPLE_RATE;
+
+      /** The size of the buffer (in samples) that the device is opened with by default. */
+      static const int DEFAULT_BUFFER_SIZE;
+
+      /** The number of output channels that the device is opened with by default. */
+      static const int DEFAULT_OUTPUT_CHANNELS;
+
+      /**
+       * Sets the format of the audio device. This has to be set before the device is opened.
+       *
+       * @param rate The sample rate (in Hz).
+       * @param buffer The size of the buffer (in samples), which should be a power of two.
+       * @param channels The number of output channels (1 for mono, 2 for stereo).
+       */
+      static void configure(int rate, int buffer, int channels);
+
+      /**
+       * Sets whether audio goes to SDL's dummy driver, for machines without a sound card
+       * (see GraphicsUtil::setHeadless). This has to be set before the device is opened.
+       *
+       * @param enabled true iff the engine runs headless.
+       */
+      static void setHeadless(bool enabled);
+
+      /**
+       * Starts SDL's audio and opens the device for the mixer, falling back to larger buffers if the device rejects small ones.
+       */
+      static void open();
+
+      /**
+       * Starts SDL's audio, and hands opening the device to a job worker, so that the rest of the engine can start up
+       * while it opens. Must be called on the main thread, after the job system has started.
+       */
+      static void openInBackground();
+
+      /**
+       * Waits for the device to finish opening in the background (if it is), so that sounds and music can be loaded.
+       * Must be called on the main thread.
+       */
+      static void finishOpening();
+
+      /**
+       * Closes the device, once all of the sounds and music have been freed.
+       */
+      static void close();
+
+      /**
+       * @return The size of the buffer (in samples) that the device was opened with.
+       */
+      static int getBufferSize();
+
+      /**
+       * @return The time (in milliseconds) that the buffer holds, which is how long a sound can wait before it is heard.
+       */
+      static double getLatency();
+};
+
+#endif
@@ -3,21 +3,88 @@
  *
  *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
  */
-
+
 #include "Music.h"
+#include "AssetArchive.h"
+#include <vector>
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_AUDIO;
 
+// About a minute and a half of CD quality stereo, which covers a looping region theme;
+// anything longer is streamed rather than taking up more memory
+const Uint32 Music::MAX_DECODED_SIZE = 16 << 20;
+
 Music* Music::currentMusic = NULL;
+Music* Music::fadingMusic = NULL;
+Uint32 Music::currentPosition = 0;
+Uint32 Music::fadingPosition = 0;
+Uint32 Music::fadeLength = 0;
+Uint32 Music::fadeProgress = 0;
+int Music::mixRate = 0;
+int Music::mixChannels = 0;
+bool Music::hooked = false;
 
-Music::Music(ResourceKey name) : Resource(name)
+Music::Music(ResourceKey name) : Resource(name), music(NULL), musicSource(NULL), decoded(NULL), frameCount(0), loopStart(0), loopEnd(0), looping(false)
 {
 }
 
+void Music::prepare(const char* path)
+{
+   std::vector<char> data;
+   if(!AssetArchive::read(path, data) || data.empty())
+   {
+      return;
+   }
+
+   Mix_Chunk* chunk = Mix_LoadWAV_RW(SDL_RWFromConstMem(&data[0], data.size()), 1);
+   if(chunk == NULL)
+   {
+      DEBUG("Music %s can't be decoded ahead of time, so it will be streamed: %s", path, Mix_GetError());
+      return;
+   }
+
+   if(chunk->alen > MAX_DECODED_SIZE)
+   {
+      DEBUG("Music %s is too long to keep decoded, so it will be streamed.", path);
+      Mix_FreeChunk(chunk);
+      return;
+   }
+
+   decoded = chunk;
+}
+
 void Music::load(const char* path)
 {
-   music = Mix_LoadMUS(path);
+   if(decoded != NULL)
+   {
+      // The song was decoded to the device's format, so its length in frames follows from the device's channels
+      Uint16 format;
+      Mix_QuerySpec(&mixRate, &format, &mixChannels);
+      frameCount = decoded->alen / (sizeof(Sint16) * mixChannels);
+      return;
+   }
+
+   // Music plays straight out of the asset archive if it holds the file, but SDL_mixer can only
+   // stream some formats from memory, so anything else is loaded from its loose file instead
+   const char* data;
+   std::size_t size;
+   if(AssetArchive::find(path, data, size))
+   {
+      musicSource = SDL_RWFromConstMem(data, size);
+      music = Mix_LoadMUS_RW(musicSource);
+      if(music == NULL)
+      {
+         DEBUG("Unable to play archived music %s from memory: %s", path, Mix_GetError());
+         SDL_RWclose(musicSource);
+         musicSource = NULL;
+      }
+   }
+
+   if(music == NULL)
+   {
+      music = Mix_LoadMUS(path);
+   }
 
    if(music == NULL)
    {
@@ -27,7 +94,14 @@ void Music::load(const char* path)
 
 size_t Music::getSize()
 {
-   return sizeof(Music);
+   // Streamed music is decoded from its file as it plays, so only a small buffer of it is ever in memory
+   return sizeof(Music) + (decoded != NULL ? decoded->alen : 0);
+}
+
+bool Music::isInUse()
+{
+   // Decoded music can still be fading out after another song has taken over
+   return Resource::isInUse() || currentMusic == this || isMixing(this);
 }
 
 void Music::setPlayingMusic(Music* music)
@@ -37,47 +111,226 @@ void Music::setPlayingMusic(Music* music)
 
 bool Music::isPlaying(Music* music)
 {
+   if(music->decoded != NULL)
+   {
+      SDL_LockAudio();
+      const bool playing = hooked && music == currentMusic;
+      SDL_UnlockAudio();
+      return playing;
+   }
+
    return (music == currentMusic) && Mix_PlayingMusic();
 }
 
+bool Music::isMixing(Music* music)
+{
+   SDL_LockAudio();
+   const bool mixing = hooked && (music == currentMusic || music == fadingMusic);
+   SDL_UnlockAudio();
+   return mixing;
+}
+
+void Music::setHooked(bool enabled)
+{
+   if(enabled != hooked)
+   {
+      if(enabled)
+      {
+         // The engine's mixer takes the music's place in SDL_mixer, so whatever SDL_mixer was streaming stops
+         Mix_HaltMusic();
+         Mix_HookMusic(&Music::mixMusic, NULL);
+      }
+      else
+      {
+         Mix_HookMusic(NULL, NULL);
+         currentMusic = NULL;
+         fadingMusic = NULL;
+      }
+
+      hooked = enabled;
+   }
+}
+
+void Music::advance(Music*& music, Uint32& position)
+{
+   ++position;
+
+   const Uint32 end = music->looping && music->loopEnd > 0 && music->loopEnd <= music->frameCount ? music->loopEnd : music->frameCount;
+   if(position >= end)
+   {
+      if(music->looping && music->loopStart < end)
+      {
+         position = music->loopStart;
+      }
+      else
+      {
+         music = NULL;
+      }
+   }
+}
+
+void Music::mixMusic(void* /*data*/, Uint8* stream, int length)
+{
+   Sint16* samples = reinterpret_cast<Sint16*>(stream);
+   const int frames = length / (sizeof(Sint16) * mixChannels);
+
+   for(int frame = 0; frame < frames; ++frame)
+   {
+      // Both songs are mixed at full volume once the fade is over (with nothing left fading out)
+      float currentGain = 1.0f;
+      float fadingGain = 0.0f;
+      if(fadeProgress < fadeLength)
+      {
+         currentGain = static_cast<float>(fadeProgress) / fadeLength;
+         fadingGain = 1.0f - currentGain;
+         ++fadeProgress;
+      }
+      else
+      {
+         fadingMusic = NULL;
+      }
+
+      if(currentMusic == NULL && fadingMusic == NULL)
+      {
+         return;
+      }
+
+      const Sint16* currentSamples = currentMusic != NULL ? reinterpret_cast<const Sint16*>(currentMusic->decoded->abuf) + currentPosition * mixChannels : NULL;
+      const Sint16* fadingSamples = fadingMusic != NULL ? reinterpret_cast<const Sint16*>(fadingMusic->decoded->abuf) + fadingPosition * mixChannels : NULL;
+
+      for(int channel = 0; channel < mixChannels; ++channel)
+      {
+         float value = samples[channel];
+         if(currentSamples != NULL)
+         {
+            value += currentSamples[channel] * currentGain;
+         }
+
+         if(fadingSamples != NULL)
+         {
+            value += fadingSamples[channel] * fadingGain;
+         }
+
+         samples[channel] = static_cast<Sint16>(value > 32767.0f ? 32767.0f : (value < -32768.0f ? -32768.0f : value));
+      }
+
+      samples += mixChannels;
+
+      if(currentMusic != NULL)
+      {
+         advance(currentMusic, currentPosition);
+      }
+
+      if(fadingMusic != NULL)
+      {
+         advance(fadingMusic, fadingPosition);
+      }
+   }
+}
+
 void Music::fadeOutMusic(int time)
 {
-   if(Mix_PlayingMusic())
+   SDL_LockAudio();
+   if(hooked)
+   {
+      if(currentMusic != NULL)
+      {
+         fadingMusic = currentMusic;
+         fadingPosition = currentPosition;
+         currentMusic = NULL;
+         fadeLength = static_cast<Uint32>(time) * mixRate / 1000;
+         fadeProgress = 0;
+      }
+   }
+   else if(Mix_PlayingMusic())
    {
       Mix_FadeOutMusic(time);
       currentMusic = NULL;
    }
+   SDL_UnlockAudio();
 }
 
 void Music::stopMusic()
 {
-   if(Mix_PlayingMusic())
+   SDL_LockAudio();
+   if(hooked)
+   {
+      currentMusic = NULL;
+      fadingMusic = NULL;
+   }
+   else if(Mix_PlayingMusic())
    {
       Mix_HaltMusic();
       currentMusic = NULL;
    }
+   SDL_UnlockAudio();
+}
+
+void Music::setLoop(Uint32 startFrame, Uint32 endFrame)
+{
+   SDL_LockAudio();
+   loopStart = startFrame;
+   loopEnd = endFrame;
+   looping = true;
+   SDL_UnlockAudio();
 }
 
-void Music::play()
+void Music::play(int fadeTime)
 {
 #ifndef MUSIC_OFF
-   if(music == NULL) return;
+   if(music == NULL && decoded == NULL) return;
+
+   if(isPlaying(this)) return;
 
-   if(!isPlaying(this))
+   if(decoded != NULL)
    {
+      // Only the audio thread's view of the songs changes here, so the lock is only held for a moment
+      SDL_LockAudio();
+      setHooked(true);
+      fadingMusic = (fadeTime > 0 && currentMusic != NULL) ? currentMusic : NULL;
+      fadingPosition = currentPosition;
       setPlayingMusic(this);
-      if(Mix_PlayMusic(music, 0) < 0)
-      {
-         DEBUG("There was a problem playing the music: %s", Mix_GetError());
-      }
+      currentPosition = 0;
+      fadeLength = static_cast<Uint32>(fadeTime) * mixRate / 1000;
+      fadeProgress = 0;
+      SDL_UnlockAudio();
+      return;
+   }
+
+   SDL_LockAudio();
+   setHooked(false);
+   setPlayingMusic(this);
+   SDL_UnlockAudio();
+
+   const int loops = looping ? -1 : 0;
+   if((fadeTime > 0 ? Mix_FadeInMusic(music, loops, fadeTime) : Mix_PlayMusic(music, loops)) < 0)
+   {
+      DEBUG("There was a problem playing the music: %s", Mix_GetError());
    }
 #endif
 }
 
 Music::~Music()
 {
+   if(decoded != NULL)
+   {
+      // The audio thread can't be left mixing samples that are about to be freed
+      SDL_LockAudio();
+      if(currentMusic == this) currentMusic = NULL;
+      if(fadingMusic == this) fadingMusic = NULL;
+      SDL_UnlockAudio();
+
+      Mix_FreeChunk(decoded);
+   }
+
    if(music != NULL)
    {
       Mix_FreeMusic(music);
    }
+
+   // The music reads from its source for as long as it plays, so the source goes last
+   if(musicSource != NULL)
+   {
+      SDL_RWclose(musicSource);
+   }
 }
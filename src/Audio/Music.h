@@ -9,6 +9,7 @@
 
 #include "Resource.h"
 #include "SDL_mixer.h"
+#include <string>
 
 /** \todo Get rid of the MUSIC_OFF macro usage once an options menu with
  * persistence is successfully implemented.
@@ -20,13 +21,78 @@
  * This Resource represents a song, and provides an interface for playing,
  * fading, or looping a song.
  *
+ * Songs are decoded ahead of time, on the resource loader's threads (see prepare), so that playing one
+ * (or prefetching the next one) never stalls the main thread. Decoded songs are mixed by the engine itself
+ * through SDL_mixer's music hook, which lets one song crossfade into the next and loop between sample frames
+ * exactly. Songs that SDL_mixer can't decode ahead of time, or that are too long to keep decoded in memory,
+ * are streamed by SDL_mixer as they play instead, and can only fade out before the next song fades in.
+ *
  * @author Noam Chitayat
  */
 class Music : public Resource
 {
-   /** The current music that is playing. */
+   /** The largest decoded song (in bytes) that is kept in memory to be mixed by the engine. */
+   static const Uint32 MAX_DECODED_SIZE;
+
+   /** The current music that is playing. Decoded music is only touched while holding the audio lock. */
    static Music* currentMusic;
 
+   /** The decoded music that is fading out under the current music, or NULL if nothing is fading out. */
+   static Music* fadingMusic;
+
+   /** The next sample frame to mix from the current music. */
+   static Uint32 currentPosition;
+
+   /** The next sample frame to mix from the fading music. */
+   static Uint32 fadingPosition;
+
+   /** The length (in sample frames) of the fade between the fading music and the current music, or 0 if nothing is fading. */
+   static Uint32 fadeLength;
+
+   /** The number of sample frames of the fade that have been mixed. */
+   static Uint32 fadeProgress;
+
+   /** The sample rate (in Hz) of the audio device, which the decoded music is converted to. */
+   static int mixRate;
+
+   /** The number of output channels of the audio device, which the decoded music is converted to. */
+   static int mixChannels;
+
+   /** True iff the engine's mixer is hooked into SDL_mixer in place of its own music player. */
+   static bool hooked;
+
+   /**
+    * Mixes the decoded music into the audio stream. SDL_mixer calls this from the audio thread, holding the audio lock.
+    *
+    * @param data Unused.
+    * @param stream The stream to mix into.
+    * @param length The length of the stream (in bytes).
+    */
+   static void mixMusic(void* data, Uint8* stream, int length);
+
+   /**
+    * Moves the mixer on by one sample frame in a decoded song, looping it or ending it when it reaches its end.
+    *
+    * @param music The song, which is set to NULL if it ends.
+    * @param position The next sample frame to mix from the song.
+    */
+   static void advance(Music*& music, Uint32& position);
+
+   /**
+    * Hooks the engine's mixer into SDL_mixer, or unhooks it so that SDL_mixer can stream music itself.
+    * This must be called while holding the audio lock.
+    *
+    * @param enabled true iff the engine's mixer should play the music.
+    */
+   static void setHooked(bool enabled);
+
+   /**
+    * @param music A song.
+    *
+    * @return true iff the engine's mixer is playing (or fading out) the song.
+    */
+   static bool isMixing(Music* music);
+
    /**
     * @param music The music to check.
     *
@@ -44,6 +110,24 @@ class Music : public Resource
    /** The SDL music object for this music resource */
    Mix_Music* music;
 
+   /** The archived file that the music is played from, or NULL if it is played from a loose file. */
+   SDL_RWops* musicSource;
+
+   /** The song's samples, decoded to the audio device's format ahead of time, or NULL if the song is streamed instead. */
+   Mix_Chunk* decoded;
+
+   /** The number of sample frames in the decoded song. */
+   Uint32 frameCount;
+
+   /** The first sample frame of the song's loop. */
+   Uint32 loopStart;
+
+   /** The sample frame after the last one in the song's loop, or 0 for the end of the song. */
+   Uint32 loopEnd;
+
+   /** True iff the song loops once it is played. */
+   bool looping;
+
    /**
     * Loads the music resource with the specified file name and path.
     *
@@ -59,6 +143,15 @@ class Music : public Resource
        */
       Music(ResourceKey name);
 
+      /**
+       * Implementation of method in Resource class.
+       * Decodes the song ahead of time, so that it can be mixed (and crossfaded) by the engine.
+       * Songs that can't be decoded are left to be streamed by SDL_mixer.
+       *
+       * @param path The path to the music file.
+       */
+      void prepare(const char* path);
+
       /**
        * Implementation of method in Resource class.
        *
@@ -67,9 +160,28 @@ class Music : public Resource
       size_t getSize();
 
       /**
-       * Play this song.
+       * Implementation of method in Resource class.
+       *
+       * @return true iff the music is held, or is the music currently playing.
+       */
+      bool isInUse();
+
+      /**
+       * Sets the song to loop between two sample frames (at the audio device's sample rate) whenever it is played.
+       * Only songs that were decoded ahead of time loop between their loop points; streamed songs loop from start to end.
+       *
+       * @param startFrame The first sample frame of the loop.
+       * @param endFrame The sample frame after the last one in the loop, or 0 for the end of the song.
+       */
+      void setLoop(Uint32 startFrame, Uint32 endFrame);
+
+      /**
+       * Play this song, in place of the song that is playing.
+       *
+       * @param fadeTime The time (in ms) to crossfade from the song that is playing into this one, or 0 to cut straight to it.
+       *                 Streamed songs can't be crossfaded, so the song that is playing is stopped and this one fades in.
        */
-      void play();
+      void play(int fadeTime = 0);
 
       /**
        * Fades out the currently playing song.
@@ -3,33 +3,219 @@
  *
  *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
  */
-
+
 #include "Sound.h"
 #include "Task.h"
+#include "AssetArchive.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_AUDIO;
 
-std::map<int, Sound*> Sound::playingList;
+// A little more than a screen's width, so that sounds just off screen can still be heard coming
+const int Sound::AUDIBLE_DISTANCE = 1024;
+
+// About 6 seconds of CD quality stereo; blips and footsteps stay decoded, while long stingers and ambience don't
+const Uint32 Sound::MAX_RESIDENT_SIZE = 1 << 20;
+
+Sound* Sound::playingList[CHANNEL_COUNT] = { NULL };
+Task* Sound::channelTasks[CHANNEL_COUNT] = { NULL };
+int Sound::channelPriorities[CHANNEL_COUNT] = { 0 };
+unsigned long Sound::channelStarts[CHANNEL_COUNT] = { 0 };
+unsigned long Sound::playCount = 0;
+int Sound::listenerX = 0;
+int Sound::listenerY = 0;
+Sound::EmitterLocator Sound::emitterLocator = NULL;
+void* Sound::emitterContext = NULL;
+bool Sound::channelPositional[CHANNEL_COUNT] = { false };
+int Sound::channelX[CHANNEL_COUNT] = { 0 };
+int Sound::channelY[CHANNEL_COUNT] = { 0 };
+unsigned int Sound::channelEmitters[CHANNEL_COUNT] = { 0 };
+Sint16 Sound::channelAngles[CHANNEL_COUNT] = { 0 };
+Uint8 Sound::channelDistances[CHANNEL_COUNT] = { 0 };
+volatile int Sound::finishedChannels[FINISHED_QUEUE_SIZE];
+volatile unsigned int Sound::finishedPushCount = 0;
+volatile unsigned int Sound::finishedPopCount = 0;
 
-bool Sound::ownsChannel(Sound* sound, int channel)
+/**
+ * Keeps the reads and writes on either side of the barrier from being reordered across it,
+ * so that a slot of the finished channel queue is always written before it is published (and read before it is released).
+ */
+static inline void memoryBarrier()
 {
-   return sound == playingList[channel];
+#if defined(_MSC_VER)
+   // x86 doesn't reorder stores with stores or loads with loads, so only the compiler needs to be held back
+   _ReadWriteBarrier();
+#else
+   __sync_synchronize();
+#endif
 }
 
 void Sound::channelFinished(int channel)
 {
-   DEBUG("Channel %d finished playing.", channel);
-   Sound* finishedSound = playingList[channel];
+   // Nothing but the queue can be touched here, since this runs on the audio thread.
+   // The queue has room for every channel, so it can't overflow (see finishedChannels).
+   const unsigned int pushCount = finishedPushCount;
+   finishedChannels[pushCount & (FINISHED_QUEUE_SIZE - 1)] = channel;
+   memoryBarrier();
+   finishedPushCount = pushCount + 1;
+}
 
-   if(finishedSound != NULL)
-   {  finishedSound->finished();
+void Sound::processFinishedChannels()
+{
+   const unsigned int pushCount = finishedPushCount;
+   memoryBarrier();
+
+   for(unsigned int popCount = finishedPopCount; popCount != pushCount; ++popCount)
+   {
+      const int channel = finishedChannels[popCount & (FINISHED_QUEUE_SIZE - 1)];
+      memoryBarrier();
+      finishedPopCount = popCount + 1;
+
+      DEBUG("Channel %d finished playing.", channel);
+      if(channel >= 0 && channel < CHANNEL_COUNT && playingList[channel] != NULL)
+      {
+         Sound* sound = playingList[channel];
+         --sound->instanceCount;
+         playingList[channel] = NULL;
+         channelPositional[channel] = false;
+
+         Task* task = channelTasks[channel];
+         channelTasks[channel] = NULL;
+         if(task)
+         {
+            task->signal();
+         }
+
+         sound->releaseDecoded();
+      }
    }
 }
 
-Sound::Sound(ResourceKey name) : Resource(name), playingChannel(-1)
+void Sound::setListener(int x, int y)
+{
+   listenerX = x;
+   listenerY = y;
+}
+
+void Sound::setEmitterLocator(EmitterLocator locator, void* context)
+{
+   emitterLocator = locator;
+   emitterContext = context;
+}
+
+bool Sound::locate(int x, int y, Sint16& angle, Uint8& distance)
 {
+   const double xDistance = x - listenerX;
+   const double yDistance = y - listenerY;
+   const double range = sqrt(xDistance * xDistance + yDistance * yDistance);
+
+   // SDL_mixer measures angles clockwise from straight ahead, which is up the screen
+   const double degrees = atan2(xDistance, -yDistance) * 180.0 / 3.14159265358979;
+   angle = static_cast<Sint16>(degrees < 0 ? degrees + 360.0 : degrees);
+   distance = static_cast<Uint8>(std::min(range, static_cast<double>(AUDIBLE_DISTANCE)) * 255 / AUDIBLE_DISTANCE);
+
+   return range <= AUDIBLE_DISTANCE;
+}
+
+void Sound::updatePositions()
+{
+   // Every channel is moved in the same pass under the audio lock, so they all change in the same buffer
+   SDL_LockAudio();
+   for(int channel = 0; channel < CHANNEL_COUNT; ++channel)
+   {
+      if(playingList[channel] == NULL || !channelPositional[channel])
+      {
+         continue;
+      }
+
+      if(channelEmitters[channel] != 0 && emitterLocator != NULL)
+      {
+         emitterLocator(emitterContext, channelEmitters[channel], channelX[channel], channelY[channel]);
+      }
+
+      // Sounds that wander out of range while they play fade to the quietest distance rather than being cut off
+      Sint16 angle;
+      Uint8 distance;
+      locate(channelX[channel], channelY[channel], angle, distance);
+      if(angle != channelAngles[channel] || distance != channelDistances[channel])
+      {
+         Mix_SetPosition(channel, angle, distance);
+         channelAngles[channel] = angle;
+         channelDistances[channel] = distance;
+      }
+   }
+   SDL_UnlockAudio();
+}
+
+int Sound::findVoice(const Sound* sound)
+{
+   int voice = -1;
+
+   if(sound->instanceCount >= sound->maxInstances)
+   {
+      // The sound takes over from its own oldest instance
+      for(int channel = 0; channel < CHANNEL_COUNT; ++channel)
+      {
+         if(playingList[channel] == sound && (voice == -1 || channelStarts[channel] < channelStarts[voice]))
+         {
+            voice = channel;
+         }
+      }
+   }
+   else
+   {
+      for(int channel = 0; channel < CHANNEL_COUNT && voice == -1; ++channel)
+      {
+         if(playingList[channel] == NULL && !Mix_Playing(channel))
+         {
+            return channel;
+         }
+      }
+
+      // Every voice is taken, so the lowest priority sound gives up its voice (the oldest of them, to break ties)
+      for(int channel = 0; channel < CHANNEL_COUNT; ++channel)
+      {
+         if(voice == -1 || channelPriorities[channel] < channelPriorities[voice]
+               || (channelPriorities[channel] == channelPriorities[voice] && channelStarts[channel] < channelStarts[voice]))
+         {
+            voice = channel;
+         }
+      }
+
+      if(voice != -1 && channelPriorities[voice] > sound->priority)
+      {
+         return -1;
+      }
+   }
+
+   if(voice != -1)
+   {
+      // Halting the voice queues it up as finished, so the sound on it is told to finish before the voice is reused
+      Mix_HaltChannel(voice);
+      processFinishedChannels();
+   }
+
+   return voice;
+}
+
+Sound::Sound(ResourceKey name) : Resource(name), sound(NULL), starting(false), priority(0), maxInstances(CHANNEL_COUNT), instanceCount(0)
+{
+}
+
+void Sound::prepare(const char* path)
+{
+   if(!AssetArchive::read(path, preparedData))
+   {
+      // Loading the sound will read the file again on its own
+      preparedData.clear();
+   }
 }
 
 void Sound::load(const char* path)
@@ -40,9 +226,34 @@ void Sound::load(const char* path)
    Mix_ChannelFinished(&Sound::channelFinished);
 
    DEBUG("Loading WAV %s", path);
-   sound = Mix_LoadWAV(path);
+   if(preparedData.empty())
+   {
+      // The file is read into memory even if it wasn't read in the background, in case it is kept compressed
+      prepare(path);
+   }
+
+   if(!preparedData.empty())
+   {
+      // The file was already read, so the sound is decoded straight from memory
+      sound = Mix_LoadWAV_RW(SDL_RWFromConstMem(&preparedData[0], preparedData.size()), 1);
+
+      // A long sound that decodes to much more than its file is kept as the file, and decoded again whenever it plays
+      if(sound != NULL && sound->alen > MAX_RESIDENT_SIZE && preparedData.size() * 2 < sound->alen)
+      {
+         DEBUG("Keeping %s compressed until it is played (%u bytes decoded, %u compressed).", path, static_cast<unsigned int>(sound->alen), static_cast<unsigned int>(preparedData.size()));
+         Mix_FreeChunk(sound);
+         sound = NULL;
+         compressedData.swap(preparedData);
+      }
+
+      std::vector<char>().swap(preparedData);
+   }
+   else
+   {
+      sound = Mix_LoadWAV_RW(AssetArchive::open(path), 1);
+   }
 
-   if(sound == NULL)
+   if(sound == NULL && compressedData.empty())
    {
       T_T(Mix_GetError());
    }
@@ -50,16 +261,83 @@ void Sound::load(const char* path)
    DEBUG("Successfully loaded WAV %s.", path);
 }
 
+void Sound::decode()
+{
+   if(sound == NULL && !compressedData.empty())
+   {
+      sound = Mix_LoadWAV_RW(SDL_RWFromConstMem(&compressedData[0], compressedData.size()), 1);
+      if(sound == NULL)
+      {
+         DEBUG("Unable to decode sound \"%s\": %s", getResourceName().c_str(), Mix_GetError());
+      }
+   }
+}
+
+void Sound::releaseDecoded()
+{
+   if(sound != NULL && !compressedData.empty() && instanceCount == 0 && !starting)
+   {
+      Mix_FreeChunk(sound);
+      sound = NULL;
+   }
+}
+
 size_t Sound::getSize()
 {
-   return sizeof(Sound);
+   // Compressed sounds only count their samples while they are decoded, so the budget sees what is actually in memory
+   size_t size = sizeof(Sound) + preparedData.size() + compressedData.size();
+   if(sound != NULL)
+   {
+      size += sound->alen;
+   }
+
+   return size;
+}
+
+bool Sound::isInUse()
+{
+   // A playing sound can't be freed out from under the mixer (or the task waiting on it)
+   return Resource::isInUse() || instanceCount > 0;
+}
+
+bool Sound::canReload()
+{
+   return instanceCount == 0;
+}
+
+void Sound::swapData(Resource& other)
+{
+   std::swap(sound, static_cast<Sound&>(other).sound);
+   compressedData.swap(static_cast<Sound&>(other).compressedData);
+}
+
+void Sound::setPriority(int newPriority)
+{
+   priority = newPriority;
+}
+
+void Sound::setMaxInstances(int count)
+{
+   maxInstances = std::max(count, 1);
 }
 
 void Sound::play(Task* task)
 {
-#ifndef SOUND_OFF
-   if(sound == NULL)
+   playOnVoice(task, 0, 0);
+}
+
+void Sound::playAt(int x, int y, Task* task)
+{
+   playPositional(x, y, 0, task);
+}
+
+void Sound::playFrom(unsigned int emitter, Task* task)
+{
+   int x;
+   int y;
+   if(emitterLocator == NULL || !emitterLocator(emitterContext, emitter, x, y))
    {
+      DEBUG("Sound \"%s\" has nothing to play from.", getResourceName().c_str());
       if(task)
       {
          task->signal();
@@ -68,44 +346,108 @@ void Sound::play(Task* task)
       return;
    }
 
-   playingChannel = Mix_PlayChannel(-1, sound, 0);
-   if(playingChannel == -1)
+   playPositional(x, y, emitter, task);
+}
+
+void Sound::playPositional(int x, int y, unsigned int emitter, Task* task)
+{
+   // Sounds that can't be heard are culled before they take up a voice
+   Sint16 angle;
+   Uint8 distance;
+   if(!locate(x, y, angle, distance))
    {
-      DEBUG("There was a problem playing the sound ""%s"": %s", getResourceName().c_str(), Mix_GetError());
+      DEBUG("Sound \"%s\" is too far away to be heard.", getResourceName().c_str());
+      if(task)
+      {
+         task->signal();
+      }
+
+      return;
    }
 
-   playingList[playingChannel] = this;
-   playTask = task;
-#endif
+   const int voice = playOnVoice(task, angle, distance);
+   if(voice != -1)
+   {
+      channelPositional[voice] = true;
+      channelX[voice] = x;
+      channelY[voice] = y;
+      channelEmitters[voice] = emitter;
+      channelAngles[voice] = angle;
+      channelDistances[voice] = distance;
+   }
 }
 
-void Sound::stop()
+int Sound::playOnVoice(Task* task, Sint16 angle, Uint8 distance)
 {
-   if(ownsChannel(this, playingChannel))
+   int voice = -1;
+#ifndef SOUND_OFF
+   // Compressed sounds are decoded before taking the audio lock, so that the mixer isn't held up while they decode
+   starting = true;
+   decode();
+   if(sound != NULL)
    {
-      Mix_HaltChannel(playingChannel);
+      // Holding the audio lock keeps the voice from finishing until the sound has been filed under it,
+      // and the queue is drained first so that the voice's last sound is told it finished before it loses the voice
+      SDL_LockAudio();
+      processFinishedChannels();
+      voice = findVoice(this);
+      if(voice != -1)
+      {
+         // A position of (0, 0) takes off the positional effect left by the voice's last sound
+         Mix_SetPosition(voice, angle, distance);
+         voice = Mix_PlayChannel(voice, sound, 0);
+      }
+
+      if(voice != -1)
+      {
+         playingList[voice] = this;
+         channelTasks[voice] = task;
+         channelPriorities[voice] = priority;
+         channelStarts[voice] = ++playCount;
+         channelPositional[voice] = false;
+         ++instanceCount;
+      }
+      SDL_UnlockAudio();
+   }
+   starting = false;
+
+   if(voice == -1)
+   {
+      releaseDecoded();
+      DEBUG("Sound \"%s\" wasn't played: %s", getResourceName().c_str(), sound != NULL ? "every voice is taken by a higher priority sound" : "it isn't loaded");
+      if(task)
+      {
+         task->signal();
+      }
    }
+#endif
+
+   return voice;
 }
 
-void Sound::finished()
+void Sound::stop()
 {
-   DEBUG("Sound finished.");
-   if(playTask)
+   SDL_LockAudio();
+   for(int channel = 0; channel < CHANNEL_COUNT; ++channel)
    {
-      playTask->signal();
-      playTask = NULL;
+      if(playingList[channel] == this)
+      {
+         Mix_HaltChannel(channel);
+      }
    }
-
-   playingChannel = -1;
+   SDL_UnlockAudio();
 }
 
 Sound::~Sound()
 {
    if(sound != NULL)
    {
-      if(ownsChannel(this, playingChannel))
+      if(instanceCount > 0)
       {
          stop();
+
+         // Halting the voices queued them up as finished, so they are drained now, while the sound is still around to be told
+         processFinishedChannels();
       }
 
       Mix_FreeChunk(sound);
@@ -3,13 +3,13 @@
  *
  *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
  */
-
+
 #ifndef SOUND_H
 #define SOUND_H
 
 #include "Resource.h"
 #include "SDL_mixer.h"
-#include <map>
+#include <vector>
 
 class Task;
 
@@ -23,48 +23,233 @@ class Task;
  * This Resource represents a sound, and provides an interface for playing
  * or stopping a sound.
  *
+ * SDL_mixer reports that a channel has finished playing from the audio thread, so the
+ * callback only records the channel in a lock-free queue. The sounds that finished are
+ * only told so (and signal their tasks) when the main thread drains the queue,
+ * in processFinishedChannels.
+ *
+ * Sounds are played on a fixed pool of voices (the mixer's channels), so the cost of mixing them
+ * never grows past that many at once. When every voice is taken, a new sound steals the voice of
+ * the lowest priority sound that is playing (the one that started first, if several share that priority),
+ * as long as that sound's priority isn't higher than its own; otherwise the new sound isn't played.
+ * A sound can also be limited to a number of instances at once, in which case a new instance
+ * takes over from its oldest one. Sounds placed on the map are culled if they are too far from
+ * the listener to be heard, and are panned and attenuated by their position otherwise.
+ * A sound can also be played from an emitter (such as an actor), which is located through the
+ * EmitterLocator; the positions of all of the sounds on the map are worked out again together,
+ * once per frame, in updatePositions, so that they follow the listener and their emitters.
+ *
+ * A sound that isn't played (for any of these reasons) signals its task straight away,
+ * and a sound whose voice is stolen signals its task as though it had finished.
+ *
+ * Long effects that are compressed (such as OGG files) stay compressed in memory, and are only
+ * decoded while they play, which keeps the samples of rarely played sounds from taking up memory.
+ *
  * @author Noam Chitayat
  */
 class Sound : public Resource
 {
-   /** The map of currently playing Sound resources based on channel. */
-   static std::map<int, Sound*> playingList;
-
-   /**
-    * Checks whether or not a specified sound owns a certain channel.
-    *
-    * @param sound The sound to check.
-    * @param channel The channel to check ownership of.
-    *
-    * @return true iff sound is playing on channel.
-    */
-   static bool ownsChannel(Sound* sound, int channel);
-
-   /** A callback used when a channel is released and its sound is done playing. */
-   static void channelFinished(int channel);
-
-   /** A Task object used to signal waiting coroutines when this sound object is done playing. */
-   Task* playTask;
-
-   /** The SDL sound resource. */
-   Mix_Chunk* sound;
-
-   /** This sound's current channel. */
-   int playingChannel;
-
-   /**
-    * Loads the music resource with the specified file name and path.
-    *
-    * @param path The path to the music file.
-    */
-   void load(const char* path);
-
-   /**
-    * A callback used to signal to the sound that it has finished playing.
-    */
-   void finished();
+   public:
+      /**
+       * Finds where an emitter is on the map.
+       *
+       * @param context The context that the locator was set with.
+       * @param emitter The emitter that a sound is playing from.
+       * @param x Set to the x-coordinate (in pixels) of the emitter.
+       * @param y Set to the y-coordinate (in pixels) of the emitter.
+       *
+       * @return true iff the emitter is still on the map.
+       */
+      typedef bool (*EmitterLocator)(void* context, unsigned int emitter, int& x, int& y);
+
+   private:
+      /** The number of mixer channels that sounds are played on. */
+      static const int CHANNEL_COUNT = MIX_CHANNELS;
+
+      /** The number of slots in the queue of finished channels, which is a power of two so that positions can be masked down to a slot. */
+      static const unsigned int FINISHED_QUEUE_SIZE = 16;
+
+      /** The distance (in pixels) from the listener past which positional sounds can't be heard. */
+      static const int AUDIBLE_DISTANCE;
+
+      /** The largest size (in bytes) of decoded samples that are kept in memory for a compressed sound that isn't playing. */
+      static const Uint32 MAX_RESIDENT_SIZE;
+
+      /** The currently playing Sound resources, by channel (NULL for the channels that are free). */
+      static Sound* playingList[CHANNEL_COUNT];
+
+      /** The task to signal when each channel finishes playing (or NULL if there is none), by channel. */
+      static Task* channelTasks[CHANNEL_COUNT];
+
+      /** The priority that each channel's sound was played at, by channel. */
+      static int channelPriorities[CHANNEL_COUNT];
+
+      /** The order in which each channel's sound was played, by channel, so that the oldest sound can be found. */
+      static unsigned long channelStarts[CHANNEL_COUNT];
+
+      /** The number of sounds that have been played, which numbers each sound in the order it was played. */
+      static unsigned long playCount;
+
+      /** The location (in pixels) of the listener that positional sounds are heard from. */
+      static int listenerX, listenerY;
+
+      /** The function that finds where emitters are, and the context it is called with. */
+      static EmitterLocator emitterLocator;
+      static void* emitterContext;
+
+      /** True for the channels whose sounds are placed on the map, by channel. */
+      static bool channelPositional[CHANNEL_COUNT];
+
+      /** The location (in pixels) of each positional channel's sound, by channel. */
+      static int channelX[CHANNEL_COUNT];
+      static int channelY[CHANNEL_COUNT];
+
+      /** The emitter that each channel's sound follows (or 0 if the sound stays where it was played), by channel. */
+      static unsigned int channelEmitters[CHANNEL_COUNT];
+
+      /** The angle and distance that each positional channel was last set to, by channel, so that channels that haven't moved are left alone. */
+      static Sint16 channelAngles[CHANNEL_COUNT];
+      static Uint8 channelDistances[CHANNEL_COUNT];
+
+      /**
+       * The channels that finished playing, in a ring written only by the audio thread and read only by the main thread.
+       * Each channel can only finish once for each time that a sound is played on it, and the queue is drained before
+       * any sound is played, so it never holds more than CHANNEL_COUNT channels.
+       */
+      static volatile int finishedChannels[FINISHED_QUEUE_SIZE];
+
+      /** The number of channels ever pushed onto the queue of finished channels. Only written by the audio thread. */
+      static volatile unsigned int finishedPushCount;
+
+      /** The number of channels ever taken off the queue of finished channels. Only written by the main thread. */
+      static volatile unsigned int finishedPopCount;
+
+      /**
+       * A callback used when a channel is released and its sound is done playing.
+       * This is called from the audio thread (or from within Mix_HaltChannel), so it only queues the channel up.
+       */
+      static void channelFinished(int channel);
+
+      /**
+       * Finds the voice to play a sound on, freeing it (by stopping the sound on it) if it has to be stolen.
+       * This must be called while holding the audio lock, with the queue of finished channels drained.
+       *
+       * @param sound The sound to play.
+       *
+       * @return The channel to play the sound on, or -1 if every voice is taken by a sound of higher priority.
+       */
+      static int findVoice(const Sound* sound);
+
+      /**
+       * Works out how a sound at a location on the map is heard by the listener.
+       *
+       * @param x The x-coordinate (in pixels) of the sound.
+       * @param y The y-coordinate (in pixels) of the sound.
+       * @param angle Set to the direction that the sound comes from (in degrees clockwise from straight ahead).
+       * @param distance Set to how far away the sound is (from 0 for right at the listener, to 255 for as far as can be heard).
+       *
+       * @return true iff the sound is close enough to the listener to be heard.
+       */
+      static bool locate(int x, int y, Sint16& angle, Uint8& distance);
+
+      /** The SDL sound resource (NULL for a compressed sound that isn't playing). */
+      Mix_Chunk* sound;
+
+      /** The compressed contents of the sound file, for sounds that are only decoded while they play. */
+      std::vector<char> compressedData;
+
+      /** True while an instance of the sound is being started, so that its samples aren't released out from under it. */
+      bool starting;
+
+      /** The priority of the sound when it takes a voice. Sounds with higher priorities steal the voices of sounds with lower ones. */
+      int priority;
+
+      /** The most instances of the sound that can play at once. */
+      int maxInstances;
+
+      /** The number of instances of the sound that are playing (or haven't been told that they've finished). */
+      int instanceCount;
+
+      /** The contents of the sound file, if they were read ahead of time by prepare() */
+      std::vector<char> preparedData;
+
+      /**
+       * Loads the music resource with the specified file name and path.
+       *
+       * @param path The path to the music file.
+       */
+      void load(const char* path);
+
+      /**
+       * Decodes a compressed sound's samples, if they aren't already decoded.
+       */
+      void decode();
+
+      /**
+       * Frees a compressed sound's decoded samples once no instance of it is playing.
+       */
+      void releaseDecoded();
+
+      /**
+       * Plays an instance of this sound on a voice, if one can be found for it.
+       *
+       * @param task A task to signal when the sound completes (or NULL).
+       * @param angle The direction that the sound comes from (in degrees clockwise from straight ahead).
+       * @param distance How far away the sound is (from 0 for right at the listener, to 255 for as far as can be heard).
+       *
+       * @return The channel that the sound is playing on, or -1 if it wasn't played.
+       */
+      int playOnVoice(Task* task, Sint16 angle, Uint8 distance);
+
+      /**
+       * Plays an instance of this sound from a location on the map, unless it is too far away to be heard.
+       *
+       * @param x The x-coordinate (in pixels) of the sound.
+       * @param y The y-coordinate (in pixels) of the sound.
+       * @param emitter The emitter that the sound follows (or 0 if it stays where it is played).
+       * @param task A task to signal when the sound completes (or NULL).
+       */
+      void playPositional(int x, int y, unsigned int emitter, Task* task);
+
+      /**
+       * Implementation of method in Resource class.
+       * Swaps the sound's samples (and compressed data).
+       *
+       * @param other The sound to swap data with.
+       */
+      void swapData(Resource& other);
 
    public:
+      /**
+       * Tells the sounds whose channels have finished playing that they are done,
+       * which signals the tasks waiting on them. This must be called from the main thread,
+       * once per logic step.
+       */
+      static void processFinishedChannels();
+
+      /**
+       * Sets where positional sounds are heard from (such as the middle of the screen).
+       *
+       * @param x The x-coordinate (in pixels) of the listener.
+       * @param y The y-coordinate (in pixels) of the listener.
+       */
+      static void setListener(int x, int y);
+
+      /**
+       * Sets how emitters are found on the map. Emitters that can't be found leave their sounds where they were last heard.
+       *
+       * @param locator The function that finds the emitters (or NULL to stop following emitters).
+       * @param context The context to call the locator with.
+       */
+      static void setEmitterLocator(EmitterLocator locator, void* context);
+
+      /**
+       * Pans and attenuates every sound playing on the map by where it is relative to the listener,
+       * moving the sounds that follow emitters along with them. This must be called from the main thread,
+       * once per frame, after the listener and the emitters have moved.
+       */
+      static void updatePositions();
+
       /**
        * Constructor.
        *
@@ -72,6 +257,24 @@ class Sound : public Resource
        */
       Sound(ResourceKey name);
 
+      /**
+       * Implementation of method in Resource class.
+       * Reads the sound file into memory, so that loading the sound doesn't wait on the disk.
+       *
+       * @param path The path to the sound file.
+       */
+      void prepare(const char* path);
+
+      /**
+       * @param newPriority The priority of the sound when it takes a voice (0 by default).
+       */
+      void setPriority(int newPriority);
+
+      /**
+       * @param count The most instances of the sound that can play at once (as many as there are voices, by default).
+       */
+      void setMaxInstances(int count);
+
       /**
        * Play this sound once.
        *
@@ -80,7 +283,26 @@ class Sound : public Resource
       void play(Task* task = NULL);
 
       /**
-       * Stop this sound if it is currently playing.
+       * Play this sound once, from a location on the map. The sound is panned and attenuated by where it is
+       * relative to the listener, and isn't played at all if it is too far away to be heard.
+       *
+       * @param x The x-coordinate (in pixels) of the sound.
+       * @param y The y-coordinate (in pixels) of the sound.
+       * @param task A task to signal when the sound completes. (optional)
+       */
+      void playAt(int x, int y, Task* task = NULL);
+
+      /**
+       * Play this sound once, from an emitter on the map (such as an actor). The sound follows the emitter
+       * as it moves, and isn't played at all if the emitter can't be found or is too far away to be heard.
+       *
+       * @param emitter The emitter to play the sound from, as the EmitterLocator knows it.
+       * @param task A task to signal when the sound completes. (optional)
+       */
+      void playFrom(unsigned int emitter, Task* task = NULL);
+
+      /**
+       * Stop every instance of this sound that is currently playing.
        */
       void stop();
 
@@ -91,6 +313,20 @@ class Sound : public Resource
        */
       size_t getSize();
 
+      /**
+       * Implementation of method in Resource class.
+       *
+       * @return true iff the sound is held, or is playing.
+       */
+      bool isInUse();
+
+      /**
+       * Implementation of method in Resource class.
+       *
+       * @return true iff the sound isn't playing, since the mixer reads its samples as it plays.
+       */
+      bool canReload();
+
       /**
        * Destructor.
        */
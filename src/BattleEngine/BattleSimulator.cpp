@@ -0,0 +1,244 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "BattleSimulator.h"
+#include "CharacterStats.h"
+#include "Character.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_BATTLE_ENG;
+
+// A combatant with no agility takes a turn for every two of a combatant with as much agility as this
+static const int AGILITY_HALF_DELAY = 32;
+
+// Every fourth attack is critical for a combatant with this much reflex, and none are more likely than that
+static const int REFLEX_FOR_MAX_CRITICAL = 64;
+static const Uint32 MAX_CRITICAL_CHANCE = 65536 / 4;
+
+// Poison takes a sixteenth of a combatant's health on each of its turns
+static const int POISON_SHARE = 16;
+
+// The same increment that splitmix uses, which sets apart the seeds of neighbouring battles
+static const Uint32 SEED_INCREMENT = 0x9E3779B9;
+
+BattleSimulator::StatTables::StatTables()
+{
+   for(int stat = 0; stat <= MAX_STAT; ++stat)
+   {
+      // Strength pays off a little more than in proportion, so that strong attackers get through heavy armour
+      attack[stat] = 4 + stat * 2 + stat * stat / 64;
+      defence[stat] = stat + stat * stat / 128;
+      turnDelay[stat] = BASE_TURN_DELAY * AGILITY_HALF_DELAY / (stat + AGILITY_HALF_DELAY);
+      criticalChance[stat] = std::min(static_cast<Uint32>(stat) * MAX_CRITICAL_CHANCE / REFLEX_FOR_MAX_CRITICAL, MAX_CRITICAL_CHANCE);
+   }
+}
+
+const BattleSimulator::StatTables& BattleSimulator::getTables()
+{
+   static const StatTables tables;
+   return tables;
+}
+
+int BattleSimulator::clampStat(int stat)
+{
+   return std::max(0, std::min(stat, static_cast<int>(MAX_STAT)));
+}
+
+BattleSimulator::BattleSimulator() : combatantCount(0), queuedTurns(0), randomState(1)
+{
+}
+
+void BattleSimulator::clear()
+{
+   combatantCount = 0;
+}
+
+int BattleSimulator::addCombatant(const CharacterStats& stats, int hp, int team)
+{
+   if(combatantCount == MAX_COMBATANTS || team < 0 || team >= TEAM_COUNT)
+   {
+      DEBUG("Unable to add a combatant to team %d of a battle with %d combatants.", team, combatantCount);
+      return -1;
+   }
+
+   const StatTables& tables = getTables();
+   const int combatant = combatantCount++;
+   this->team[combatant] = team;
+   attack[combatant] = tables.attack[clampStat(stats.strength)];
+   defence[combatant] = tables.defence[clampStat(stats.endurance)];
+   turnDelay[combatant] = tables.turnDelay[clampStat(stats.agility)];
+   criticalChance[combatant] = tables.criticalChance[clampStat(stats.reflex)];
+   maxHP[combatant] = std::max(stats.maxHP, 1);
+   startingHP[combatant] = std::max(std::min(hp, maxHP[combatant]), 1);
+   startingStatus[combatant] = 0;
+   startingStatusTurns[combatant] = 0;
+   return combatant;
+}
+
+int BattleSimulator::addCombatant(const Character& character, int team)
+{
+   return addCombatant(character.getStats(), character.getHP(), team);
+}
+
+void BattleSimulator::setStartingStatus(int combatant, Status status, int turns)
+{
+   if(combatant < 0 || combatant >= combatantCount) return;
+
+   startingStatus[combatant] = turns > 0 ? status : 0;
+   startingStatusTurns[combatant] = turns;
+}
+
+Uint32 BattleSimulator::nextRandom()
+{
+   randomState ^= randomState << 13;
+   randomState ^= randomState >> 17;
+   randomState ^= randomState << 5;
+   return randomState;
+}
+
+void BattleSimulator::defeat(int combatant)
+{
+   hp[combatant] = 0;
+   --livingCount[team[combatant]];
+}
+
+bool BattleSimulator::takeTurn(int combatant)
+{
+   if(status[combatant] != 0)
+   {
+      const bool stunned = (status[combatant] & STUNNED) != 0;
+      if((status[combatant] & POISONED) != 0)
+      {
+         hp[combatant] -= std::max(maxHP[combatant] / POISON_SHARE, 1);
+      }
+
+      if(--statusTurns[combatant] <= 0)
+      {
+         status[combatant] = 0;
+      }
+
+      if(hp[combatant] <= 0)
+      {
+         defeat(combatant);
+         return false;
+      }
+
+      if(stunned) return true;
+   }
+
+   // Go after the weakest foe, so that fights end rather than spreading the damage around
+   const int foeTeam = team[combatant] ^ 1;
+   int target = -1;
+   for(int i = 0; i < combatantCount; ++i)
+   {
+      if(team[i] == foeTeam && hp[i] > 0 && (target < 0 || hp[i] < hp[target]))
+      {
+         target = i;
+      }
+   }
+
+   if(target < 0) return true;
+
+   // Each hit lands somewhere from 7/8 to 9/8 of its base damage
+   const Uint32 random = nextRandom();
+   int damage = std::max(attack[combatant] - defence[target] / 2, 1);
+   damage = damage * static_cast<int>(28 + (random & 7)) / 32;
+
+   if((random >> 16) < criticalChance[combatant])
+   {
+      damage *= 2;
+      status[target] |= STUNNED;
+      statusTurns[target] = std::max(statusTurns[target], 1);
+   }
+
+   hp[target] -= std::max(damage, 1);
+   if(hp[target] <= 0)
+   {
+      defeat(target);
+   }
+
+   return true;
+}
+
+BattleSimulator::Outcome BattleSimulator::run(Uint32 seed)
+{
+   randomState = seed != 0 ? seed : 1;
+   livingCount[0] = livingCount[1] = 0;
+   queuedTurns = 0;
+
+   for(int combatant = 0; combatant < combatantCount; ++combatant)
+   {
+      hp[combatant] = startingHP[combatant];
+      status[combatant] = startingStatus[combatant];
+      statusTurns[combatant] = startingStatusTurns[combatant];
+      ++livingCount[team[combatant]];
+
+      // The combatants don't all act at once at the start, but after a random part of their first delay
+      Turn& turn = turnQueue[queuedTurns++];
+      turn.time = nextRandom() % turnDelay[combatant];
+      turn.combatant = combatant;
+   }
+
+   std::make_heap(turnQueue, turnQueue + queuedTurns, IsLater());
+
+   Outcome outcome;
+   outcome.winningTeam = -1;
+   outcome.turns = 0;
+
+   while(livingCount[0] > 0 && livingCount[1] > 0)
+   {
+      if(outcome.turns == MAX_TURNS)
+      {
+         return outcome;
+      }
+
+      std::pop_heap(turnQueue, turnQueue + queuedTurns, IsLater());
+      Turn& turn = turnQueue[queuedTurns - 1];
+
+      // Combatants that were defeated since their turn was queued just drop out of the queue
+      if(hp[turn.combatant] <= 0)
+      {
+         --queuedTurns;
+         continue;
+      }
+
+      ++outcome.turns;
+      if(takeTurn(turn.combatant))
+      {
+         turn.time += turnDelay[turn.combatant];
+         std::push_heap(turnQueue, turnQueue + queuedTurns, IsLater());
+      }
+      else
+      {
+         --queuedTurns;
+      }
+   }
+
+   // A battle set up without one of its teams is won by the other (or by neither, if it has no combatants at all)
+   if(livingCount[0] > 0) outcome.winningTeam = 0;
+   else if(livingCount[1] > 0) outcome.winningTeam = 1;
+   return outcome;
+}
+
+long BattleSimulator::runMany(int battleCount, Uint32 seed, int wins[TEAM_COUNT])
+{
+   long totalTurns = 0;
+   wins[0] = wins[1] = 0;
+
+   for(int battle = 0; battle < battleCount; ++battle)
+   {
+      const Outcome outcome = run(seed + battle * SEED_INCREMENT);
+      if(outcome.winningTeam >= 0)
+      {
+         ++wins[outcome.winningTeam];
+      }
+
+      totalTurns += outcome.turns;
+   }
+
+   return totalTurns;
+}
@@ -0,0 +1,238 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef BATTLE_SIMULATOR_H
+#define BATTLE_SIMULATOR_H
+
+#include "SDL_stdinc.h"
+
+struct CharacterStats;
+class Character;
+
+/**
+ * The core of battle resolution: the turn order, the damage that attacks deal, and the status effects that
+ * combatants suffer, worked out from snapshots of the combatants' stats. The simulator knows nothing of drawing
+ * or of scripts, so it can run headlessly, and fast enough to play out a great many battles between the same
+ * combatants (such as to balance an encounter by how often the party wins it).
+ *
+ * The combatants are kept as flat arrays of the numbers that the battle runs on, which are worked out from their
+ * stats once, when they are added, using tables of each stat's effect that are built once for every simulator.
+ * The turns are taken from a binary heap ordered by the time at which each combatant acts next, so faster combatants
+ * (with more agility) act more often. Each combatant attacks the weakest living combatant of the other team on its turn:
+ * critical hits (which come more often with more reflex) deal double damage and stun their target for its next turn,
+ * and poisoned combatants lose a share of their health at the start of each of their turns.
+ *
+ * Running a battle never allocates, and starts over from the snapshots, so the same simulator can run any number of battles.
+ */
+class BattleSimulator
+{
+   public:
+      /** The most combatants that a battle can have. */
+      static const int MAX_COMBATANTS = 16;
+
+      /** The number of teams that fight each other. */
+      static const int TEAM_COUNT = 2;
+
+      /** The status effects that a combatant can suffer, as bits. */
+      enum Status
+      {
+         /** The combatant loses a share of its health at the start of each of its turns. */
+         POISONED = 1 << 0,
+         /** The combatant loses its turns. */
+         STUNNED = 1 << 1
+      };
+
+      /** How a battle turned out. */
+      struct Outcome
+      {
+         /** The team left standing, or -1 if the battle ran out of turns before either team fell. */
+         int winningTeam;
+
+         /** The number of turns that the battle took. */
+         int turns;
+      };
+
+   private:
+      /** The largest stat value that the tables hold, which higher stats are clamped to. */
+      static const int MAX_STAT = 255;
+
+      /** The time between the turns of a combatant without any agility. */
+      static const Uint32 BASE_TURN_DELAY = 4096;
+
+      /** The most turns that a battle can take before it is called a draw, so that two unkillable teams can't fight forever. */
+      static const int MAX_TURNS = 1000;
+
+      /** The tables of each stat's effect in battle, indexed by the stat's value. */
+      struct StatTables
+      {
+         /** The power of a combatant's attacks, by strength. */
+         int attack[MAX_STAT + 1];
+
+         /** How much damage a combatant shrugs off, by endurance. */
+         int defence[MAX_STAT + 1];
+
+         /** The time between a combatant's turns, by agility. */
+         Uint32 turnDelay[MAX_STAT + 1];
+
+         /** The chance (out of 65536) that a combatant's attack is critical, by reflex. */
+         Uint32 criticalChance[MAX_STAT + 1];
+
+         /**
+          * Constructor. Builds the tables.
+          */
+         StatTables();
+      };
+
+      /**
+       * @return The stat tables, which are built the first time they are needed.
+       */
+      static const StatTables& getTables();
+
+      /**
+       * @param stat A stat value.
+       *
+       * @return The stat, clamped to the range of the tables.
+       */
+      static int clampStat(int stat);
+
+      /** A combatant's next turn, in the turn queue. */
+      struct Turn
+      {
+         /** The time at which the combatant acts. */
+         Uint32 time;
+
+         /** The combatant. */
+         int combatant;
+      };
+
+      /**
+       * Orders the turn queue's heap so that the earliest turn is on top (and the first combatant added goes first in a tie).
+       * This is a function object rather than a function, so that the heap operations can inline it.
+       */
+      struct IsLater
+      {
+         /**
+          * @return true iff the first turn comes after the second.
+          */
+         bool operator()(const Turn& first, const Turn& second) const
+         {
+            return first.time != second.time ? first.time > second.time : first.combatant > second.combatant;
+         }
+      };
+
+      /** The number of combatants in the battle. */
+      int combatantCount;
+
+      // The snapshots of the combatants, which each battle starts from
+      int team[MAX_COMBATANTS];
+      int attack[MAX_COMBATANTS];
+      int defence[MAX_COMBATANTS];
+      Uint32 turnDelay[MAX_COMBATANTS];
+      Uint32 criticalChance[MAX_COMBATANTS];
+      int maxHP[MAX_COMBATANTS];
+      int startingHP[MAX_COMBATANTS];
+      int startingStatus[MAX_COMBATANTS];
+      int startingStatusTurns[MAX_COMBATANTS];
+
+      // The state of the battle being run
+      int hp[MAX_COMBATANTS];
+      int status[MAX_COMBATANTS];
+      int statusTurns[MAX_COMBATANTS];
+      int livingCount[TEAM_COUNT];
+
+      /** The heap of the living combatants' next turns. */
+      Turn turnQueue[MAX_COMBATANTS];
+
+      /** The number of turns in the turn queue. */
+      int queuedTurns;
+
+      /** The state of the battle's random number generator (a xorshift generator, which is cheap enough to draw from for every hit). */
+      Uint32 randomState;
+
+      /**
+       * @return The next 32 random bits of the battle.
+       */
+      Uint32 nextRandom();
+
+      /**
+       * Takes a combatant out of the battle once its health runs out.
+       *
+       * @param combatant The combatant.
+       */
+      void defeat(int combatant);
+
+      /**
+       * Plays out a combatant's turn.
+       *
+       * @param combatant The combatant whose turn it is.
+       *
+       * @return true iff the combatant is still standing (and so takes another turn later).
+       */
+      bool takeTurn(int combatant);
+
+   public:
+      /**
+       * Constructor. The battle starts without any combatants.
+       */
+      BattleSimulator();
+
+      /**
+       * Removes every combatant, so that a different battle can be set up.
+       */
+      void clear();
+
+      /**
+       * Adds a combatant to the battle.
+       *
+       * @param stats The combatant's stats (with its equipment's bonuses included).
+       * @param hp The health that the combatant starts the battle with.
+       * @param team The team that the combatant fights for (from 0 up to TEAM_COUNT).
+       *
+       * @return The number of the combatant, or -1 if the battle is full (or the team doesn't exist).
+       */
+      int addCombatant(const CharacterStats& stats, int hp, int team);
+
+      /**
+       * Adds a snapshot of one of the player's characters to the battle, as they are now.
+       *
+       * @param character The character.
+       * @param team The team that the character fights for.
+       *
+       * @return The number of the combatant, or -1 if the battle is full (or the team doesn't exist).
+       */
+      int addCombatant(const Character& character, int team);
+
+      /**
+       * Starts a combatant off with a status effect in each battle.
+       *
+       * @param combatant The number of the combatant.
+       * @param status The status effect.
+       * @param turns The number of the combatant's turns that the status effect lasts.
+       */
+      void setStartingStatus(int combatant, Status status, int turns);
+
+      /**
+       * Plays out a battle between the combatants, from their snapshots.
+       *
+       * @param seed The seed for the battle's random numbers, so that a battle can be played out again exactly.
+       *
+       * @return How the battle turned out.
+       */
+      Outcome run(Uint32 seed);
+
+      /**
+       * Plays out a number of battles between the combatants, each with its own random numbers.
+       *
+       * @param battleCount The number of battles to run.
+       * @param seed The seed that the battles' seeds are worked out from.
+       * @param wins Set to the number of battles won by each team (an array of TEAM_COUNT).
+       *
+       * @return The total number of turns taken by the battles.
+       */
+      long runMany(int battleCount, Uint32 seed, int wins[TEAM_COUNT]);
+};
+
+#endif
@@ -0,0 +1,608 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * A benchmark of whole frames of the game, for catching frame time regressions before a release.
+ * It runs each scenario through the game's own states, headless and with exactly one logic step per frame,
+ * for a fixed number of frames, and reports each scenario's frame time percentiles, heap allocations per frame,
+ * the peak heap memory held by each of the engine's subsystems (see MemoryTracker) and the peak memory of the process as JSON.
+ *
+ * Each scenario but the menu's is a chapter script in data/scripts/chapters/bench/, which sets up the scene and keeps it busy.
+ * If a scenario has an input recording (data/bench/<scenario>.edr), the recording's input and random seed are played back;
+ * otherwise the scenario's random numbers are drawn from a fixed seed, and any input it needs (such as
+ * advancing dialogue, or closing the menu) is pushed by the bench. Recordings are made with --record,
+ * which runs a scenario in a window and records the input given to it.
+ *
+ * The benchmark needs a build with EDEN_HEADLESS, unless it is recording.
+ *
+ * With --time-scale, each frame runs that many logic steps instead of one (such as --time-scale 10 to play a scenario through
+ * ten times over in the same number of frames), which is still the same on every machine.
+ *
+ * Usage: eden_bench [--frames <count>] [--output <path>] [--record <scenario>] [--time-scale <factor>] [--log <level>[:<categories>]] [scenario...]
+ */
+
+#include "GraphicsUtil.h"
+#include "AudioSystem.h"
+#include "ExecutionStack.h"
+#include "EngineClock.h"
+#include "TileEngine.h"
+#include "HomeMenu.h"
+#include "MenuShell.h"
+#include "PlayerData.h"
+#include "ResourceLoader.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "MemoryTracker.h"
+#include "AssetArchive.h"
+#include "StringTable.h"
+#include "SaveGameWriter.h"
+#include "InputReplay.h"
+#include "RandomStreams.h"
+#include "guichan.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "SDL.h"
+
+#ifdef _WIN32
+   #include <windows.h>
+   #include <psapi.h>
+#else
+   #include <sys/time.h>
+   #include <sys/resource.h>
+#endif
+
+#include "DebugUtils.h"
+
+// Enough frames for the percentiles to settle, while keeping a run of every scenario to under a minute
+static const int DEFAULT_FRAME_COUNT = 2000;
+
+// Scenarios without a recording draw the same random numbers on every run
+static const Uint32 BENCH_SEED = 0x0EDE4;
+
+// Where the input recordings of the scenarios are kept
+static const char* RECORDING_DIRECTORY = "data/bench/";
+
+// The save game that the menu scenario shows, which is the one the title screen's menu prototype shows
+static const char* MENU_SAVE_GAME = "data/savegames/savegamejson.edd";
+
+// Long enough for each line to finish typing out (in fast mode) before it is dismissed
+static const int DIALOGUE_LINE_FRAMES = 30;
+
+// Long enough for the menu to settle after it opens, so that each cycle draws a few ordinary frames too
+static const int MENU_OPEN_FRAMES = 20;
+
+/**
+ * @return The current time (in microseconds), measured from an arbitrary point.
+ */
+static double getMicroseconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return double(counter.QuadPart) * 1000000.0 / double(frequency.QuadPart);
+#else
+   timeval now;
+   gettimeofday(&now, NULL);
+   return double(now.tv_sec) * 1000000.0 + double(now.tv_usec);
+#endif
+}
+
+/**
+ * @return The most memory (in kilobytes) that the process has held at once, or -1 if it can't be found out.
+ */
+static long getPeakMemory()
+{
+#ifdef _WIN32
+   PROCESS_MEMORY_COUNTERS counters;
+   if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return -1;
+   return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+   rusage usage;
+   if(getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+   return static_cast<long>(usage.ru_maxrss / 1024);
+#else
+   return static_cast<long>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+/**
+ * Pushes a press and release of a key onto SDL's event queue, as if the player had tapped it.
+ *
+ * @param key The key to tap.
+ */
+static void tapKey(SDLKey key)
+{
+   SDL_Event event;
+   memset(&event, 0, sizeof(event));
+   event.type = SDL_KEYDOWN;
+   event.key.type = SDL_KEYDOWN;
+   event.key.state = SDL_PRESSED;
+   event.key.keysym.sym = key;
+   SDL_PushEvent(&event);
+
+   event.type = SDL_KEYUP;
+   event.key.type = SDL_KEYUP;
+   event.key.state = SDL_RELEASED;
+   SDL_PushEvent(&event);
+}
+
+/**
+ * Dismisses each line of dialogue once it has had time to type out.
+ *
+ * @param frameNumber The number of frames drawn so far.
+ */
+static void advanceDialogue(int frameNumber)
+{
+   if(frameNumber % DIALOGUE_LINE_FRAMES == 0)
+   {
+      tapKey(SDLK_SPACE);
+   }
+}
+
+/**
+ * Closes the menu once it has been open for a while.
+ *
+ * @param frameNumber The number of frames drawn since the menu opened.
+ */
+static void closeMenu(int frameNumber)
+{
+   if(frameNumber % MENU_OPEN_FRAMES == 0)
+   {
+      tapKey(SDLK_ESCAPE);
+   }
+}
+
+/** A scripted scenario to time. */
+struct Scenario
+{
+   /** The name of the scenario, which also names its recording. */
+   const char* name;
+
+   /** The chapter that plays out the scenario, or NULL for the menu scenario. */
+   const char* chapter;
+
+   /** The function that pushes the input the scenario needs after each frame (when it isn't played back), or NULL if it needs none. */
+   void (*pushInput)(int frameNumber);
+};
+
+static const Scenario SCENARIOS[] =
+{
+   { "crowdedTown", "bench/crowdedTown", NULL },
+   { "dialogueCutscene", "bench/dialogueCutscene", &advanceDialogue },
+   { "mapTransitions", "bench/mapTransitions", NULL },
+   { "menuCycles", NULL, &closeMenu },
+};
+
+static const int SCENARIO_COUNT = sizeof(SCENARIOS) / sizeof(SCENARIOS[0]);
+
+/** The measurements taken over a run of a scenario. */
+struct ScenarioRun
+{
+   /** The scenario being run. */
+   const Scenario* scenario;
+
+   /** Whether or not the run's input comes from a recording. */
+   bool replayed;
+
+   /** The time (in microseconds) that each frame took. */
+   std::vector<double> frameTimes;
+
+   /** The number of heap allocations made during each frame. */
+   std::vector<unsigned long> frameAllocations;
+
+   /** The time (in microseconds) that the last frame ended. */
+   double lastFrameEnd;
+
+   /** The number of heap allocations that had been made when the last frame ended. */
+   unsigned long lastAllocationCount;
+
+   /** The most heap memory (in bytes) that each subsystem held at the end of a frame, indexed by MemoryTracker::Tag. */
+   std::vector<long> peakHeapBytes;
+
+   /** The peak memory (in kilobytes) of the process when the run ended. */
+   long peakMemory;
+};
+
+/**
+ * Starts timing a scenario's next frame from now.
+ *
+ * @param run The run of the scenario.
+ */
+static void startTiming(ScenarioRun& run)
+{
+   run.lastFrameEnd = getMicroseconds();
+   run.lastAllocationCount = MemoryTracker::getTotalAllocationCount();
+}
+
+/**
+ * Measures each frame of a scenario as it is drawn, then pushes the input that the scenario needs.
+ *
+ * @param context The run of the scenario.
+ * @param frameNumber The number of frames drawn since the game loop started.
+ */
+static void observeFrame(void* context, int frameNumber)
+{
+   ScenarioRun* run = static_cast<ScenarioRun*>(context);
+   const double frameEnd = getMicroseconds();
+   const unsigned long allocations = MemoryTracker::getTotalAllocationCount();
+
+   run->frameTimes.push_back(frameEnd - run->lastFrameEnd);
+   run->frameAllocations.push_back(allocations - run->lastAllocationCount);
+   run->lastFrameEnd = frameEnd;
+   run->lastAllocationCount = allocations;
+
+   for(int tag = 0; tag < MemoryTracker::TAG_COUNT; ++tag)
+   {
+      run->peakHeapBytes[tag] = std::max(run->peakHeapBytes[tag], MemoryTracker::getLiveBytes(static_cast<MemoryTracker::Tag>(tag)));
+   }
+
+   if(run->scenario->pushInput != NULL && !run->replayed)
+   {
+      run->scenario->pushInput(frameNumber);
+   }
+}
+
+/**
+ * Runs a scenario's chapter in the tile engine.
+ *
+ * @param stack The execution stack to run the chapter on.
+ * @param run The run of the scenario.
+ * @param frameCount The number of frames to run for.
+ */
+static void runChapter(ExecutionStack& stack, ScenarioRun& run, int frameCount)
+{
+   // Loading the chapter (and its first map) is startup, rather than a frame of the scenario
+   stack.pushState(new TileEngine(stack, run.scenario->chapter));
+   stack.setFrameLimit(frameCount);
+   startTiming(run);
+   stack.execute();
+   stack.clear();
+}
+
+/**
+ * Opens and closes the in-game menu over and over, the way the title screen's menu prototype opens it.
+ *
+ * @param stack The execution stack to run the menu on.
+ * @param run The run of the scenario.
+ * @param frameCount The number of frames to run for.
+ */
+static void runMenuCycles(ExecutionStack& stack, ScenarioRun& run, int frameCount)
+{
+   PlayerData playerData;
+   playerData.load(MENU_SAVE_GAME);
+
+   MenuShell* menuShell = NULL;
+   while(static_cast<int>(run.frameTimes.size()) < frameCount)
+   {
+      // Opening the menu is part of the first frame of each cycle
+      startTiming(run);
+      if(menuShell == NULL)
+      {
+         menuShell = new MenuShell(playerData);
+      }
+      else
+      {
+         menuShell->refresh(playerData);
+      }
+
+      stack.pushState(new HomeMenu(stack, *menuShell, playerData));
+      stack.setFrameLimit(frameCount - static_cast<int>(run.frameTimes.size()));
+      stack.execute();
+      stack.clear();
+
+      if(stack.getFramesDrawn() == 0 || InputReplay::isFinished()) break;
+   }
+
+   delete menuShell;
+}
+
+/**
+ * Runs a scenario, measuring each of its frames.
+ *
+ * @param scenario The scenario to run.
+ * @param frameCount The number of frames to run for.
+ * @param recording true iff the scenario's input should be recorded, instead of played back.
+ *
+ * @return The measurements taken over the run.
+ */
+static ScenarioRun runScenario(const Scenario& scenario, int frameCount, bool recording)
+{
+   ScenarioRun run;
+   run.scenario = &scenario;
+   run.replayed = false;
+   run.peakMemory = -1;
+   run.peakHeapBytes.resize(MemoryTracker::TAG_COUNT, 0);
+
+   const std::string recordingPath = std::string(RECORDING_DIRECTORY) + scenario.name + ".edr";
+   if(recording)
+   {
+      if(!InputReplay::record(recordingPath, BENCH_SEED))
+      {
+         fprintf(stderr, "Unable to record to %s; the scenario will run without being recorded.\n", recordingPath.c_str());
+      }
+
+      RandomStreams::setInitialSeed(BENCH_SEED);
+   }
+   else if(std::ifstream(recordingPath.c_str()).is_open() && InputReplay::play(recordingPath))
+   {
+      run.replayed = true;
+      RandomStreams::setInitialSeed(InputReplay::getSeed());
+   }
+   else
+   {
+      RandomStreams::setInitialSeed(BENCH_SEED);
+   }
+
+   ExecutionStack stack;
+   stack.setFrameObserver(&observeFrame, &run);
+   if(!recording)
+   {
+      // Frames are drawn as fast as they can be, and each one simulates the same step of time
+      stack.getFramePacer().setTargetFrameRate(0);
+      stack.getFramePacer().setFixedStepping(true);
+   }
+
+   run.frameTimes.reserve(frameCount);
+   run.frameAllocations.reserve(frameCount);
+
+   if(scenario.chapter != NULL)
+   {
+      runChapter(stack, run, frameCount);
+   }
+   else
+   {
+      runMenuCycles(stack, run, frameCount);
+   }
+
+   InputReplay::stop();
+   run.peakMemory = getPeakMemory();
+   return run;
+}
+
+/**
+ * @param sortedValues A sorted list of values.
+ * @param percent The percentile to find.
+ *
+ * @return The value at the percentile (by nearest rank), or 0 if there are no values.
+ */
+template<typename T> static T getPercentile(const std::vector<T>& sortedValues, double percent)
+{
+   if(sortedValues.empty()) return T();
+
+   int rank = static_cast<int>(std::ceil(percent / 100.0 * sortedValues.size())) - 1;
+   rank = std::max(0, std::min(rank, static_cast<int>(sortedValues.size()) - 1));
+   return sortedValues[rank];
+}
+
+/**
+ * Writes the measurements taken over the runs of the scenarios as JSON.
+ *
+ * @param out The stream to write to.
+ * @param runs The runs of the scenarios.
+ */
+static void writeReport(std::ostream& out, const std::vector<ScenarioRun>& runs)
+{
+   out << std::fixed << std::setprecision(3);
+   out << "{\n   \"scenarios\": [";
+
+   for(std::vector<ScenarioRun>::const_iterator run = runs.begin(); run != runs.end(); ++run)
+   {
+      std::vector<double> frameTimes(run->frameTimes);
+      std::sort(frameTimes.begin(), frameTimes.end());
+
+      std::vector<unsigned long> frameAllocations(run->frameAllocations);
+      std::sort(frameAllocations.begin(), frameAllocations.end());
+
+      double totalTime = 0;
+      for(std::vector<double>::const_iterator iter = frameTimes.begin(); iter != frameTimes.end(); ++iter)
+      {
+         totalTime += *iter;
+      }
+
+      double totalAllocations = 0;
+      for(std::vector<unsigned long>::const_iterator iter = frameAllocations.begin(); iter != frameAllocations.end(); ++iter)
+      {
+         totalAllocations += *iter;
+      }
+
+      const double frameCount = std::max<size_t>(frameTimes.size(), 1);
+
+      out << (run == runs.begin() ? "\n" : ",\n");
+      out << "      {\n";
+      out << "         \"name\": \"" << run->scenario->name << "\",\n";
+      out << "         \"replayed\": " << (run->replayed ? "true" : "false") << ",\n";
+      out << "         \"frames\": " << frameTimes.size() << ",\n";
+      out << "         \"frameTimeMs\": { "
+          << "\"mean\": " << totalTime / frameCount / 1000.0 << ", "
+          << "\"p50\": " << getPercentile(frameTimes, 50) / 1000.0 << ", "
+          << "\"p90\": " << getPercentile(frameTimes, 90) / 1000.0 << ", "
+          << "\"p95\": " << getPercentile(frameTimes, 95) / 1000.0 << ", "
+          << "\"p99\": " << getPercentile(frameTimes, 99) / 1000.0 << ", "
+          << "\"max\": " << (frameTimes.empty() ? 0.0 : frameTimes.back() / 1000.0) << " },\n";
+      out << "         \"allocationsPerFrame\": { "
+          << "\"mean\": " << totalAllocations / frameCount << ", "
+          << "\"p50\": " << getPercentile(frameAllocations, 50) << ", "
+          << "\"p99\": " << getPercentile(frameAllocations, 99) << ", "
+          << "\"max\": " << (frameAllocations.empty() ? 0UL : frameAllocations.back()) << " },\n";
+      out << "         \"peakHeapKB\": { ";
+      for(int tag = 0; tag < MemoryTracker::TAG_COUNT; ++tag)
+      {
+         out << (tag == 0 ? "" : ", ") << '"' << MemoryTracker::getTagName(static_cast<MemoryTracker::Tag>(tag)) << "\": " << run->peakHeapBytes[tag] / 1024;
+      }
+
+      out << " },\n";
+      out << "         \"peakMemoryKB\": " << run->peakMemory << "\n";
+      out << "      }";
+   }
+
+   out << "\n   ]\n}\n";
+}
+
+int main(int argc, char *argv[])
+{
+   int frameCount = DEFAULT_FRAME_COUNT;
+   const char* outputPath = NULL;
+   const char* recordedScenario = NULL;
+   std::vector<const Scenario*> scenarios;
+
+   for(int argNum = 1; argNum < argc; ++argNum)
+   {
+      if(strcmp(argv[argNum], "--frames") == 0 && argNum + 1 < argc)
+      {
+         frameCount = atoi(argv[++argNum]);
+      }
+      else if(strcmp(argv[argNum], "--output") == 0 && argNum + 1 < argc)
+      {
+         outputPath = argv[++argNum];
+      }
+      else if(strcmp(argv[argNum], "--record") == 0 && argNum + 1 < argc)
+      {
+         recordedScenario = argv[++argNum];
+      }
+      else if(strcmp(argv[argNum], "--time-scale") == 0 && argNum + 1 < argc)
+      {
+         EngineClock::setTimeScale(atof(argv[++argNum]));
+      }
+      else if(strcmp(argv[argNum], "--log") == 0 && argNum + 1 < argc && DebugUtils::configure(argv[argNum + 1]))
+      {
+         ++argNum;
+      }
+      else
+      {
+         const Scenario* scenario = NULL;
+         for(int i = 0; i < SCENARIO_COUNT; ++i)
+         {
+            if(strcmp(argv[argNum], SCENARIOS[i].name) == 0)
+            {
+               scenario = &SCENARIOS[i];
+            }
+         }
+
+         if(scenario == NULL)
+         {
+            printf("Usage: %s [--frames <count>] [--output <path>] [--record <scenario>] [--time-scale <factor>] [--log <level>[:<categories>]] [scenario...]\n", argv[0]);
+            printf("Scenarios:");
+            for(int i = 0; i < SCENARIO_COUNT; ++i)
+            {
+               printf(" %s", SCENARIOS[i].name);
+            }
+
+            printf("\n");
+            return 1;
+         }
+
+         scenarios.push_back(scenario);
+      }
+   }
+
+   if(recordedScenario != NULL)
+   {
+      scenarios.clear();
+      for(int i = 0; i < SCENARIO_COUNT; ++i)
+      {
+         if(strcmp(recordedScenario, SCENARIOS[i].name) == 0)
+         {
+            scenarios.push_back(&SCENARIOS[i]);
+         }
+      }
+
+      if(scenarios.empty())
+      {
+         printf("There is no scenario named %s.\n", recordedScenario);
+         return 1;
+      }
+   }
+   else
+   {
+      if(scenarios.empty())
+      {
+         for(int i = 0; i < SCENARIO_COUNT; ++i)
+         {
+            scenarios.push_back(&SCENARIOS[i]);
+         }
+      }
+
+      GraphicsUtil::setHeadless(true);
+      AudioSystem::setHeadless(true);
+   }
+
+   DebugUtils::startLogThread();
+
+   std::vector<ScenarioRun> runs;
+   try
+   {
+      if(std::ifstream("data.edp").is_open())
+      {
+         AssetArchive::mount("data.edp");
+      }
+
+      ResourceLoader::loadBakeManifest("data/baked/manifest.txt");
+      StringTable::setLanguage("en");
+      JobSystem::start();
+      AudioSystem::open();
+      GraphicsUtil::getInstance();
+
+      for(std::vector<const Scenario*>::const_iterator iter = scenarios.begin(); iter != scenarios.end(); ++iter)
+      {
+         fprintf(stderr, "Running %s for %d frames...\n", (*iter)->name, frameCount);
+         runs.push_back(runScenario(**iter, frameCount, recordedScenario != NULL));
+      }
+
+      SaveGameWriter::stop();
+      GraphicsUtil::getInstance()->closeFont();
+      ResourceLoader::freeAll();
+      JobSystem::stop();
+      FrameArena::release();
+      AudioSystem::close();
+      GraphicsUtil::destroy();
+      AssetArchive::unmount();
+   }
+   catch(gcn::Exception& e)
+   {
+      fprintf(stderr, "Uncaught Guichan exception: \n%s\n", e.getMessage().c_str());
+      return 1;
+   }
+   catch(Exception& e)
+   {
+      fprintf(stderr, "Uncaught game exception: \n%s\n", e.getMessage().c_str());
+      return 1;
+   }
+   catch(std::exception& e)
+   {
+      fprintf(stderr, "Uncaught STL exception: \n%s\n", e.what());
+      return 1;
+   }
+
+   if(outputPath != NULL)
+   {
+      std::ofstream output(outputPath);
+      if(!output)
+      {
+         fprintf(stderr, "Unable to write the report to %s.\n", outputPath);
+         return 1;
+      }
+
+      writeReport(output, runs);
+   }
+   else
+   {
+      writeReport(std::cout, runs);
+   }
+
+   return 0;
+}
@@ -0,0 +1,714 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * Micro benchmarks for the engine's core data structures and loaders, for checking the cost of a change
+ * to one of them without the noise of whole frames (which eden_bench measures).
+ *
+ * Each benchmark sets up what it needs, then times a number of iterations of the operation it measures,
+ * and reports the time and heap allocations per operation. Iterations of the fastest operations repeat them
+ * several times over, so that each iteration is long enough for the clock to measure.
+ * The benchmarks run on the game's own data, headless, so the benchmark needs a build with EDEN_HEADLESS.
+ *
+ * Usage: micro_bench [--iterations <count>] [--log <level>[:<categories>]] [benchmark name filter...]
+ */
+
+#include "GraphicsUtil.h"
+#include "EntityGrid.h"
+#include "XMap.h"
+#include "TileEngine.h"
+#include "TileState.h"
+#include "Scheduler.h"
+#include "Thread.h"
+#include "Spritesheet.h"
+#include "PlayerData.h"
+#include "Quest.h"
+#include "SaveGameWriter.h"
+#include "BattleSimulator.h"
+#include "CharacterStats.h"
+#include "ResourceLoader.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "MemoryTracker.h"
+#include "AssetArchive.h"
+#include "StringTable.h"
+#include "OpenGLGraphics.h"
+#include "OpenGLTTF.h"
+#include "Point2D.h"
+#include "guichan.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+   #include <windows.h>
+#else
+   #include <sys/time.h>
+#endif
+
+#include "DebugUtils.h"
+
+// Enough iterations for the percentiles to settle, while keeping a run of every benchmark to under a minute
+static const int DEFAULT_ITERATION_COUNT = 200;
+
+// Enough repetitions of the fastest operations for each iteration to take a good many microseconds
+static const int FAST_OPERATION_REPETITIONS = 1000;
+
+// The same granularity as the entity grid uses by default, which path queries start and end on
+static const int MOVEMENT_TILE_SIZE = 16;
+
+// Every benchmark draws the same random numbers on every run
+static const unsigned int BENCH_SEED = 0x0EDE4;
+
+// The map that the grid and map benchmarks use, which is the game's only map
+static const char* MAP_NAME = "outside";
+static const char* MAP_PATH = "data/regions/sereia/outside.tmx";
+
+// The spritesheet that the spritesheet benchmark loads, which is the one the game's NPCs use
+static const char* SPRITESHEET_NAME = "npc1";
+static const char* SPRITESHEET_PATH = "data/sprites/npc1";
+
+// The save game that the save game benchmarks load, which is the one the title screen's menu prototype shows
+static const char* JSON_SAVE_GAME = "data/savegames/savegamejson.edd";
+
+// Where the save game benchmarks write their binary save game, which is removed once they are done
+static const char* BINARY_SAVE_GAME = "micro_bench.edd";
+
+// The font that the font benchmark draws with, which is the one the game's menus use
+static const char* FONT_PATH = "data/fonts/LDSRegular.ttf";
+
+// About as long as a line of dialogue
+static const char* FONT_TEXT = "The quick brown fox jumps over the lazy dog, then naps in the shade.";
+
+/**
+ * @return The current time (in microseconds), measured from an arbitrary point.
+ */
+static double getMicroseconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return double(counter.QuadPart) * 1000000.0 / double(frequency.QuadPart);
+#else
+   timeval now;
+   gettimeofday(&now, NULL);
+   return double(now.tv_sec) * 1000000.0 + double(now.tv_usec);
+#endif
+}
+
+/**
+ * @return The value at the given percentile of a sorted list of values.
+ */
+static double getPercentile(const std::vector<double>& sortedValues, double percentile)
+{
+   if(sortedValues.empty()) return 0;
+   return sortedValues[static_cast<unsigned int>(percentile * (sortedValues.size() - 1))];
+}
+
+/**
+ * The timing of a benchmark's iterations. A benchmark does its setup, then runs an iteration
+ * of its operation for as long as keepRunning() returns true; work that isn't part of the operation
+ * can be left out of an iteration's time and allocations by pausing the timing around it.
+ */
+class BenchmarkState
+{
+   /** The number of iterations to run. */
+   const int iterationCount;
+
+   /** The argument that the benchmark was registered with (such as the size of the thing it measures). */
+   const int argument;
+
+   /** The number of iterations started so far. */
+   int iteration;
+
+   /** The number of times the operation is repeated in each iteration. */
+   int operationsPerIteration;
+
+   /** The time that the iteration's timing last started or resumed. */
+   double lapStart;
+
+   /** The time taken by the iteration before its timing was last paused. */
+   double lapTime;
+
+   /** The number of heap allocations that had been made when the iteration's timing last started or resumed. */
+   unsigned long lapAllocationStart;
+
+   /** The number of heap allocations made by the iteration before its timing was last paused. */
+   unsigned long lapAllocations;
+
+   /** Whether or not the iteration's timing is paused. */
+   bool paused;
+
+   public:
+      /** The time (in microseconds) that each iteration took. */
+      std::vector<double> iterationTimes;
+
+      /** The number of heap allocations made during each iteration. */
+      std::vector<double> iterationAllocations;
+
+      /**
+       * Constructor.
+       *
+       * @param iterationCount The number of iterations to run.
+       * @param argument The argument that the benchmark was registered with.
+       */
+      BenchmarkState(int iterationCount, int argument) : iterationCount(iterationCount), argument(argument),
+         iteration(0), operationsPerIteration(1), lapStart(0), lapTime(0), lapAllocationStart(0), lapAllocations(0), paused(false)
+      {
+      }
+
+      /**
+       * @return The argument that the benchmark was registered with.
+       */
+      int getArgument() const
+      {
+         return argument;
+      }
+
+      /**
+       * @return The number of times the operation is repeated in each iteration.
+       */
+      int getOperationsPerIteration() const
+      {
+         return operationsPerIteration;
+      }
+
+      /**
+       * Sets the number of times that the operation is repeated in each iteration, so that the report is per operation.
+       *
+       * @param operations The number of operations in each iteration.
+       */
+      void setOperationsPerIteration(int operations)
+      {
+         operationsPerIteration = operations;
+      }
+
+      /**
+       * Finishes timing the last iteration (if there was one), and starts timing the next one.
+       *
+       * @return true iff there is another iteration to run.
+       */
+      bool keepRunning()
+      {
+         if(iteration > 0)
+         {
+            pauseTiming();
+            iterationTimes.push_back(lapTime);
+            iterationAllocations.push_back(double(lapAllocations));
+         }
+
+         if(iteration == iterationCount) return false;
+
+         ++iteration;
+         lapTime = 0;
+         lapAllocations = 0;
+         resumeTiming();
+         return true;
+      }
+
+      /**
+       * Stops counting time and allocations towards the current iteration.
+       */
+      void pauseTiming()
+      {
+         if(paused) return;
+
+         lapTime += getMicroseconds() - lapStart;
+         lapAllocations += MemoryTracker::getTotalAllocationCount() - lapAllocationStart;
+         paused = true;
+      }
+
+      /**
+       * Starts counting time and allocations towards the current iteration again.
+       */
+      void resumeTiming()
+      {
+         paused = false;
+         lapAllocationStart = MemoryTracker::getTotalAllocationCount();
+         lapStart = getMicroseconds();
+      }
+};
+
+/** Keeps the results of the timed operations from being optimized out. */
+static volatile long resultSink = 0;
+
+/**
+ * Generates random pixel locations on a map, such that an area of the given size fits on the map at each of them.
+ *
+ * @param map The map.
+ * @param width The width of the area (in pixels).
+ * @param height The height of the area (in pixels).
+ * @param count The number of locations to generate.
+ * @param locations Filled with the locations.
+ */
+static void generateLocations(const Map& map, int width, int height, int count, std::vector<shapes::Point2D>& locations)
+{
+   const int xRange = std::max(1, map.getWidth() * TileEngine::TILE_SIZE - width);
+   const int yRange = std::max(1, map.getHeight() * TileEngine::TILE_SIZE - height);
+
+   locations.clear();
+   for(int i = 0; i < count; ++i)
+   {
+      locations.push_back(shapes::Point2D(rand() % xRange, rand() % yRange));
+   }
+}
+
+/**
+ * Checks whether square actors of a given size (the benchmark's argument, in pixels) can stand at random places on the map.
+ */
+static void benchmarkCanOccupyArea(BenchmarkState& state)
+{
+   const int footprint = state.getArgument();
+
+   XMap map(MAP_NAME, MAP_PATH);
+   EntityGrid grid;
+   grid.setMapData(&map);
+
+   std::vector<shapes::Point2D> locations;
+   generateLocations(map, footprint, footprint, FAST_OPERATION_REPETITIONS, locations);
+
+   // The grid checks occupancy through the interface that the rerouting searches use
+   const Pathfinder::OccupancyMap& occupancy = grid;
+   const TileState actorState(TileState::ACTOR, &grid);
+
+   state.setOperationsPerIteration(FAST_OPERATION_REPETITIONS);
+   while(state.keepRunning())
+   {
+      long occupiable = 0;
+      for(int i = 0; i < FAST_OPERATION_REPETITIONS; ++i)
+      {
+         occupiable += occupancy.canOccupyArea(locations[i], footprint, footprint, actorState);
+      }
+
+      resultSink += occupiable;
+   }
+}
+
+/**
+ * Sets the map of an entity grid, which initializes its collision map and its pathfinder.
+ */
+static void benchmarkPathfinderInit(BenchmarkState& state)
+{
+   XMap map(MAP_NAME, MAP_PATH);
+   XMap otherMap(MAP_NAME, MAP_PATH);
+   EntityGrid grid;
+
+   // The grid keeps its buffers between maps, so each iteration switches maps the way a map transition does
+   bool useOtherMap = false;
+   while(state.keepRunning())
+   {
+      grid.setMapData(useOtherMap ? &otherMap : &map);
+      useOtherMap = !useOtherMap;
+   }
+}
+
+/**
+ * Finds the best paths between random pairs of places on the map.
+ */
+static void benchmarkPathfinderQuery(BenchmarkState& state)
+{
+   XMap map(MAP_NAME, MAP_PATH);
+   EntityGrid grid;
+   grid.setMapData(&map);
+
+   std::vector<shapes::Point2D> sources;
+   std::vector<shapes::Point2D> destinations;
+   generateLocations(map, MOVEMENT_TILE_SIZE, MOVEMENT_TILE_SIZE, state.getArgument(), sources);
+   generateLocations(map, MOVEMENT_TILE_SIZE, MOVEMENT_TILE_SIZE, state.getArgument(), destinations);
+
+   state.setOperationsPerIteration(state.getArgument());
+   while(state.keepRunning())
+   {
+      long waypoints = 0;
+      for(int i = 0; i < state.getArgument(); ++i)
+      {
+         waypoints += grid.findBestPath(sources[i], destinations[i]).size();
+      }
+
+      resultSink += waypoints;
+
+      // Each iteration stands in for a frame, so the searches' scratch memory is given back as the game loop would
+      state.pauseTiming();
+      FrameArena::reset();
+      state.resumeTiming();
+   }
+}
+
+/** A thread that does nothing but yield, so that a scheduler run only costs the scheduling itself. */
+class IdleThread : public Thread
+{
+   public:
+      bool resume(long /*timePassed*/)
+      {
+         ++resultSink;
+         return false;
+      }
+};
+
+/**
+ * Runs a scheduler with a given number of ready threads (the benchmark's argument).
+ */
+static void benchmarkRunThreads(BenchmarkState& state)
+{
+   Scheduler scheduler;
+   for(int i = 0; i < state.getArgument(); ++i)
+   {
+      scheduler.start(new IdleThread());
+   }
+
+   // The first run readies the started threads
+   scheduler.runThreads(0);
+
+   while(state.keepRunning())
+   {
+      scheduler.runThreads(16);
+   }
+}
+
+/**
+ * Plays out battles between two teams of a given number of combatants each (the benchmark's argument),
+ * with stats drawn at random around those of the characters early in the game.
+ */
+static void benchmarkBattleSimulation(BenchmarkState& state)
+{
+   BattleSimulator simulator;
+   for(int team = 0; team < BattleSimulator::TEAM_COUNT; ++team)
+   {
+      for(int i = 0; i < state.getArgument(); ++i)
+      {
+         CharacterStats stats;
+         stats.strength = 8 + rand() % 16;
+         stats.endurance = 8 + rand() % 16;
+         stats.agility = 8 + rand() % 16;
+         stats.reflex = 8 + rand() % 16;
+         stats.maxHP = 80 + rand() % 80;
+         simulator.addCombatant(stats, stats.maxHP, team);
+      }
+   }
+
+   state.setOperationsPerIteration(FAST_OPERATION_REPETITIONS);
+   Uint32 seed = BENCH_SEED;
+   while(state.keepRunning())
+   {
+      int wins[BattleSimulator::TEAM_COUNT];
+      resultSink += simulator.runMany(FAST_OPERATION_REPETITIONS, seed, wins) + wins[0];
+      seed += FAST_OPERATION_REPETITIONS;
+   }
+}
+
+/**
+ * Loads a spritesheet. The image is streamed into the texture atlas the first time, and found there after that,
+ * so the iterations after the first mostly time the parsing of the frames and animations.
+ */
+static void benchmarkSpritesheetLoad(BenchmarkState& state)
+{
+   while(state.keepRunning())
+   {
+      Spritesheet spritesheet(SPRITESHEET_NAME);
+      spritesheet.initialize(SPRITESHEET_PATH);
+
+      state.pauseTiming();
+      JobSystem::finalizeJobs();
+      GraphicsUtil::getInstance()->uploadStreamedTextures();
+      state.resumeTiming();
+   }
+}
+
+/**
+ * Parses a map file.
+ */
+static void benchmarkMapParse(BenchmarkState& state)
+{
+   while(state.keepRunning())
+   {
+      XMap map(MAP_NAME, MAP_PATH);
+      resultSink += map.getWidth();
+   }
+}
+
+/**
+ * Looks up each quest in a save game's quest log by its path.
+ */
+static void benchmarkGetQuest(BenchmarkState& state)
+{
+   PlayerData playerData;
+   playerData.load(JSON_SAVE_GAME);
+
+   const Quest* rootQuest = playerData.getRootQuest();
+   std::map<std::string, const Quest*> quests;
+   rootQuest->getSubquestPaths(quests);
+
+   std::vector<std::string> paths;
+   for(std::map<std::string, const Quest*>::const_iterator iter = quests.begin(); iter != quests.end(); ++iter)
+   {
+      paths.push_back(iter->first);
+   }
+
+   if(paths.empty())
+   {
+      paths.push_back("");
+   }
+
+   // The quests are looked up in a shuffled order, so that the lookups don't just walk the index in order
+   std::random_shuffle(paths.begin(), paths.end());
+
+   state.setOperationsPerIteration(FAST_OPERATION_REPETITIONS);
+   while(state.keepRunning())
+   {
+      long found = 0;
+      for(int i = 0; i < FAST_OPERATION_REPETITIONS; ++i)
+      {
+         found += rootQuest->getQuest(paths[i % paths.size()]) != NULL;
+      }
+
+      resultSink += found;
+   }
+}
+
+/**
+ * Loads a save game written before the binary format, which is parsed as JSON.
+ */
+static void benchmarkLoadJsonSave(BenchmarkState& state)
+{
+   while(state.keepRunning())
+   {
+      PlayerData playerData;
+      playerData.load(JSON_SAVE_GAME);
+   }
+}
+
+/**
+ * Serializes a save game and writes it out.
+ */
+static void benchmarkSerializeSave(BenchmarkState& state)
+{
+   PlayerData playerData;
+   playerData.load(JSON_SAVE_GAME);
+
+   while(state.keepRunning())
+   {
+      playerData.save(BINARY_SAVE_GAME);
+      SaveGameWriter::waitForSave(BINARY_SAVE_GAME);
+   }
+}
+
+/**
+ * Loads a binary save game.
+ */
+static void benchmarkLoadBinarySave(BenchmarkState& state)
+{
+   PlayerData savedPlayerData;
+   savedPlayerData.load(JSON_SAVE_GAME);
+   savedPlayerData.save(BINARY_SAVE_GAME);
+   SaveGameWriter::waitForSave(BINARY_SAVE_GAME);
+
+   while(state.keepRunning())
+   {
+      PlayerData playerData;
+      playerData.load(BINARY_SAVE_GAME);
+   }
+}
+
+/**
+ * Draws a line of text into the batch of an OpenGL graphics object, and flushes the batch.
+ */
+static void benchmarkDrawString(BenchmarkState& state)
+{
+   edwt::OpenGLGraphics graphics;
+   graphics.setTargetPlane(GraphicsUtil::getInstance()->getWidth(), GraphicsUtil::getInstance()->getHeight());
+
+   // The first line drawn renders the glyphs, which are cached from then on
+   edwt::OpenGLTrueTypeFont font(FONT_PATH, 16);
+   graphics._beginDraw();
+   font.drawString(&graphics, FONT_TEXT, 0, 0);
+   graphics._endDraw();
+
+   state.setOperationsPerIteration(state.getArgument());
+   while(state.keepRunning())
+   {
+      graphics._beginDraw();
+      for(int i = 0; i < state.getArgument(); ++i)
+      {
+         font.drawString(&graphics, FONT_TEXT, 0, i * font.getHeight());
+      }
+
+      graphics._endDraw();
+   }
+}
+
+/** A benchmark to run. */
+struct Benchmark
+{
+   /** The name of the benchmark, which the benchmarks to run are chosen by. */
+   const char* name;
+
+   /** The function that sets up the benchmark and runs its iterations. */
+   void (*run)(BenchmarkState& state);
+
+   /** The argument that the benchmark is run with (such as the size of the thing it measures). */
+   int argument;
+};
+
+static const Benchmark BENCHMARKS[] =
+{
+   { "entityGrid/canOccupyArea/16", &benchmarkCanOccupyArea, 16 },
+   { "entityGrid/canOccupyArea/32", &benchmarkCanOccupyArea, 32 },
+   { "entityGrid/canOccupyArea/64", &benchmarkCanOccupyArea, 64 },
+   { "entityGrid/canOccupyArea/96", &benchmarkCanOccupyArea, 96 },
+   { "pathfinder/init", &benchmarkPathfinderInit, 0 },
+   { "pathfinder/findBestPath", &benchmarkPathfinderQuery, 100 },
+   { "scheduler/runThreads/1", &benchmarkRunThreads, 1 },
+   { "scheduler/runThreads/16", &benchmarkRunThreads, 16 },
+   { "scheduler/runThreads/256", &benchmarkRunThreads, 256 },
+   { "battle/simulate/1", &benchmarkBattleSimulation, 1 },
+   { "battle/simulate/4", &benchmarkBattleSimulation, 4 },
+   { "spritesheet/load", &benchmarkSpritesheetLoad, 0 },
+   { "xmap/parse", &benchmarkMapParse, 0 },
+   { "quest/getQuest", &benchmarkGetQuest, 0 },
+   { "saveGame/loadJson", &benchmarkLoadJsonSave, 0 },
+   { "saveGame/serialize", &benchmarkSerializeSave, 0 },
+   { "saveGame/loadBinary", &benchmarkLoadBinarySave, 0 },
+   { "font/drawString", &benchmarkDrawString, 20 },
+};
+
+static const int BENCHMARK_COUNT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+/**
+ * Runs a benchmark, and prints a row of the report for it.
+ *
+ * @param benchmark The benchmark to run.
+ * @param iterationCount The number of iterations to run.
+ */
+static void runBenchmark(const Benchmark& benchmark, int iterationCount)
+{
+   srand(BENCH_SEED);
+
+   BenchmarkState state(iterationCount, benchmark.argument);
+   benchmark.run(state);
+   FrameArena::reset();
+
+   std::vector<double>& times = state.iterationTimes;
+   std::vector<double>& allocations = state.iterationAllocations;
+   std::sort(times.begin(), times.end());
+   std::sort(allocations.begin(), allocations.end());
+
+   // The times are reported per operation, in nanoseconds, since the fastest operations take well under a microsecond
+   const double operations = state.getOperationsPerIteration();
+   printf("%-30s %6d x %-5d | p50 %12.1fns  p99 %12.1fns  max %12.1fns | %8.2f allocations/op\n",
+          benchmark.name, static_cast<int>(times.size()), state.getOperationsPerIteration(),
+          getPercentile(times, 0.5) * 1000.0 / operations, getPercentile(times, 0.99) * 1000.0 / operations,
+          getPercentile(times, 1.0) * 1000.0 / operations, getPercentile(allocations, 0.5) / operations);
+}
+
+/**
+ * @param name The name of a benchmark.
+ * @param filters The filters given on the command line.
+ *
+ * @return true iff there are no filters, or the name contains one of them.
+ */
+static bool matchesFilters(const char* name, const std::vector<const char*>& filters)
+{
+   if(filters.empty()) return true;
+
+   for(std::vector<const char*>::const_iterator iter = filters.begin(); iter != filters.end(); ++iter)
+   {
+      if(strstr(name, *iter) != NULL) return true;
+   }
+
+   return false;
+}
+
+int main(int argc, char *argv[])
+{
+   int iterationCount = DEFAULT_ITERATION_COUNT;
+   std::vector<const char*> filters;
+
+   for(int argNum = 1; argNum < argc; ++argNum)
+   {
+      if(strcmp(argv[argNum], "--iterations") == 0 && argNum + 1 < argc)
+      {
+         iterationCount = atoi(argv[++argNum]);
+      }
+      else if(strcmp(argv[argNum], "--log") == 0 && argNum + 1 < argc && DebugUtils::configure(argv[argNum + 1]))
+      {
+         ++argNum;
+      }
+      else if(argv[argNum][0] == '-')
+      {
+         printf("Usage: %s [--iterations <count>] [--log <level>[:<categories>]] [benchmark name filter...]\n", argv[0]);
+         printf("Benchmarks:");
+         for(int i = 0; i < BENCHMARK_COUNT; ++i)
+         {
+            printf(" %s", BENCHMARKS[i].name);
+         }
+
+         printf("\n");
+         return 1;
+      }
+      else
+      {
+         filters.push_back(argv[argNum]);
+      }
+   }
+
+   GraphicsUtil::setHeadless(true);
+   DebugUtils::startLogThread();
+
+   try
+   {
+      if(std::ifstream("data.edp").is_open())
+      {
+         AssetArchive::mount("data.edp");
+      }
+
+      StringTable::setLanguage("en");
+      JobSystem::start();
+      GraphicsUtil::getInstance();
+
+      printf("Micro benchmarks: %d iterations each\n\n", iterationCount);
+      for(int i = 0; i < BENCHMARK_COUNT; ++i)
+      {
+         if(matchesFilters(BENCHMARKS[i].name, filters))
+         {
+            runBenchmark(BENCHMARKS[i], iterationCount);
+         }
+      }
+
+      SaveGameWriter::stop();
+      remove(BINARY_SAVE_GAME);
+
+      GraphicsUtil::getInstance()->closeFont();
+      ResourceLoader::freeAll();
+      JobSystem::stop();
+      FrameArena::release();
+      GraphicsUtil::destroy();
+      AssetArchive::unmount();
+   }
+   catch(gcn::Exception& e)
+   {
+      fprintf(stderr, "Uncaught Guichan exception: \n%s\n", e.getMessage().c_str());
+      return 1;
+   }
+   catch(Exception& e)
+   {
+      fprintf(stderr, "Uncaught game exception: \n%s\n", e.getMessage().c_str());
+      return 1;
+   }
+   catch(std::exception& e)
+   {
+      fprintf(stderr, "Uncaught STL exception: \n%s\n", e.what());
+      return 1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,532 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * A headless benchmark for the pathfinder. It generates synthetic collision grids of
+ * several kinds and sizes, and reports how long the pathfinder takes to initialize on
+ * each of them, how much heap memory it allocates, and the latency and node expansions of
+ * best path and rerouted path queries between random pairs of open tiles.
+ * The cost of each best path is also checked against an exact search over the whole grid.
+ *
+ * Usage: pathfinder_bench [queries per grid] [random seed]
+ *
+ * The pathfinder's debug output goes to stderr, so redirect it to keep the report readable.
+ */
+
+#include "Pathfinder.h"
+#include "Pathfinder_OccupancyMap.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "MemoryTracker.h"
+#include "PassabilityPyramid.h"
+#include "TileState.h"
+#include "Point2D.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+#ifdef _WIN32
+   #include <windows.h>
+#else
+   #include <sys/time.h>
+#endif
+
+// The same granularity as the entity grid uses by default
+static const int MOVEMENT_TILE_SIZE = 16;
+
+// The same pyramid depth as the entity grid builds for its default granularity (16px to 128px cells)
+static const int PYRAMID_LEVEL_COUNT = 4;
+
+// Roughly one tile in fifty holds an actor that rerouted paths have to get around
+static const int ACTOR_PERCENTAGE = 2;
+
+/** The kinds of grids the benchmark generates. */
+enum GridKind
+{
+   /** Mostly open ground with a few scattered obstacles and walls. */
+   OPEN_FIELD,
+
+   /** Obstacles scattered uniformly at random. */
+   RANDOM_OBSTACLES,
+
+   /** A maze of single-tile corridors with exactly one route between any two open tiles. */
+   MAZE
+};
+
+/** A collision grid, stored row by row. */
+struct Grid
+{
+   /** The width of the grid (in tiles). */
+   int width;
+
+   /** The height of the grid (in tiles). */
+   int height;
+
+   /** The tiles of the grid. */
+   std::vector<TileState> tiles;
+
+   /** Pointers to the start of each row of tiles, in the form the pathfinder expects. */
+   std::vector<TileState*> rows;
+
+   Grid(int width, int height) : width(width), height(height), tiles(width * height), rows(height)
+   {
+      for(int y = 0; y < height; ++y)
+      {
+         rows[y] = &tiles[y * width];
+      }
+   }
+
+   TileState& at(int x, int y) { return tiles[y * width + x]; }
+};
+
+/**
+ * Answers occupancy queries straight from the synthetic grid, the same way the entity grid would.
+ */
+class GridOccupancy : public Pathfinder::OccupancyMap
+{
+   /** The grid to check. */
+   const Grid& grid;
+
+   public:
+      GridOccupancy(const Grid& grid) : grid(grid) {}
+
+      bool canOccupyArea(const shapes::Point2D& area, int width, int height, const TileState& state) const
+      {
+         const int left = area.x / MOVEMENT_TILE_SIZE;
+         const int top = area.y / MOVEMENT_TILE_SIZE;
+         const int right = (area.x + width - 1) / MOVEMENT_TILE_SIZE;
+         const int bottom = (area.y + height - 1) / MOVEMENT_TILE_SIZE;
+         if(left < 0 || top < 0 || right >= grid.width || bottom >= grid.height) return false;
+
+         for(int y = top; y <= bottom; ++y)
+         {
+            for(int x = left; x <= right; ++x)
+            {
+               const TileState& tile = grid.tiles[y * grid.width + x];
+               if(tile.entityType != TileState::FREE && (tile.entityType != state.entityType || tile.entity != state.entity))
+               {
+                  return false;
+               }
+            }
+         }
+
+         return true;
+      }
+};
+
+/** The latencies and node expansions of a set of queries. */
+struct QueryStats
+{
+   /** The time taken by each query (in microseconds). */
+   std::vector<double> latencies;
+
+   /** The total number of tiles expanded over every query. */
+   unsigned long expansions;
+
+   /** The number of queries that found a path. */
+   int pathsFound;
+
+   QueryStats() : expansions(0), pathsFound(0) {}
+};
+
+/** How the costs of a set of best paths compare to the optimal costs. */
+struct PathCostStats
+{
+   /** The number of paths compared. */
+   int pathsCompared;
+
+   /** The number of paths that cost more than the optimal path. */
+   int longerPaths;
+
+   /** The sum of each path's extra cost, as a fraction of the optimal cost. */
+   double totalExcess;
+
+   /** The largest extra cost of a path, as a fraction of the optimal cost. */
+   double maxExcess;
+
+   PathCostStats() : pathsCompared(0), longerPaths(0), totalExcess(0), maxExcess(0) {}
+};
+
+/**
+ * @return The current time (in microseconds), measured from an arbitrary point.
+ */
+static double getMicroseconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return double(counter.QuadPart) * 1000000.0 / double(frequency.QuadPart);
+#else
+   timeval now;
+   gettimeofday(&now, NULL);
+   return double(now.tv_sec) * 1000000.0 + double(now.tv_usec);
+#endif
+}
+
+/**
+ * Fills a grid with obstacles of the given kind.
+ */
+static void generateGrid(Grid& grid, GridKind kind)
+{
+   for(int y = 0; y < grid.height; ++y)
+   {
+      for(int x = 0; x < grid.width; ++x)
+      {
+         TileState& tile = grid.at(x, y);
+         tile.entity = NULL;
+
+         switch(kind)
+         {
+            case OPEN_FIELD:
+               tile.entityType = rand() % 100 < 3 ? TileState::OBSTACLE : TileState::FREE;
+               break;
+            case RANDOM_OBSTACLES:
+               tile.entityType = rand() % 100 < 30 ? TileState::OBSTACLE : TileState::FREE;
+               break;
+            case MAZE:
+               tile.entityType = TileState::OBSTACLE;
+               break;
+         }
+      }
+   }
+
+   if(kind == OPEN_FIELD)
+   {
+      // A few walls, so that the best paths aren't all straight lines
+      const int wallCount = grid.width * grid.height / 400;
+      for(int i = 0; i < wallCount; ++i)
+      {
+         const bool horizontal = rand() % 2 == 0;
+         const int length = 3 + rand() % 10;
+         int x = rand() % grid.width;
+         int y = rand() % grid.height;
+         for(int j = 0; j < length && x < grid.width && y < grid.height; ++j)
+         {
+            grid.at(x, y).entityType = TileState::OBSTACLE;
+            if(horizontal) ++x; else ++y;
+         }
+      }
+   }
+   else if(kind == MAZE)
+   {
+      // Carve the maze out of the cells at odd coordinates with a randomized depth-first search
+      const int cellsWide = (grid.width - 1) / 2;
+      const int cellsHigh = (grid.height - 1) / 2;
+      if(cellsWide <= 0 || cellsHigh <= 0) return;
+
+      static const int CELL_OFFSETS[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+      std::vector<bool> visited(cellsWide * cellsHigh, false);
+      std::vector<int> stack;
+      stack.push_back(0);
+      visited[0] = true;
+      grid.at(1, 1).entityType = TileState::FREE;
+
+      while(!stack.empty())
+      {
+         const int cell = stack.back();
+         const int cellX = cell % cellsWide;
+         const int cellY = cell / cellsWide;
+
+         int unvisitedNeighbours[4];
+         int unvisitedCount = 0;
+         for(int i = 0; i < 4; ++i)
+         {
+            const int neighbourX = cellX + CELL_OFFSETS[i][0];
+            const int neighbourY = cellY + CELL_OFFSETS[i][1];
+            if(neighbourX < 0 || neighbourY < 0 || neighbourX >= cellsWide || neighbourY >= cellsHigh) continue;
+            if(visited[neighbourY * cellsWide + neighbourX]) continue;
+            unvisitedNeighbours[unvisitedCount++] = i;
+         }
+
+         if(unvisitedCount == 0)
+         {
+            stack.pop_back();
+            continue;
+         }
+
+         const int direction = unvisitedNeighbours[rand() % unvisitedCount];
+         const int neighbourX = cellX + CELL_OFFSETS[direction][0];
+         const int neighbourY = cellY + CELL_OFFSETS[direction][1];
+         grid.at(2 * cellX + 1 + CELL_OFFSETS[direction][0], 2 * cellY + 1 + CELL_OFFSETS[direction][1]).entityType = TileState::FREE;
+         grid.at(2 * neighbourX + 1, 2 * neighbourY + 1).entityType = TileState::FREE;
+
+         visited[neighbourY * cellsWide + neighbourX] = true;
+         stack.push_back(neighbourY * cellsWide + neighbourX);
+      }
+   }
+}
+
+/**
+ * Places stationary actors on a few of the open tiles.
+ *
+ * @param grid The grid to place the actors on.
+ * @param actors Filled with the addresses used to identify each actor.
+ */
+static void placeActors(Grid& grid, std::vector<int>& actors)
+{
+   std::vector<int> actorTiles;
+   for(int tileNum = 0; tileNum < static_cast<int>(grid.tiles.size()); ++tileNum)
+   {
+      if(grid.tiles[tileNum].entityType == TileState::FREE && rand() % 100 < ACTOR_PERCENTAGE)
+      {
+         actorTiles.push_back(tileNum);
+      }
+   }
+
+   actors.assign(actorTiles.size(), 0);
+   for(unsigned int i = 0; i < actorTiles.size(); ++i)
+   {
+      grid.tiles[actorTiles[i]] = TileState(TileState::ACTOR, &actors[i]);
+   }
+}
+
+/**
+ * @return The coordinates (in tiles) of a random free tile, or (-1, -1) if it took too long to find one.
+ */
+static shapes::Point2D pickFreeTile(const Grid& grid)
+{
+   for(int attempt = 0; attempt < 1000; ++attempt)
+   {
+      const int x = rand() % grid.width;
+      const int y = rand() % grid.height;
+      if(grid.tiles[y * grid.width + x].entityType == TileState::FREE)
+      {
+         return shapes::Point2D(x, y);
+      }
+   }
+
+   return shapes::Point2D(-1, -1);
+}
+
+/**
+ * Runs Dijkstra's algorithm over the whole grid, with the same moves and costs as the pathfinder's static searches
+ * (8-connected, with only static obstacles in the way).
+ *
+ * @return The cost of the cheapest path between two tiles, or infinity if there is none.
+ */
+static float findExactCost(const Grid& grid, const shapes::Point2D& srcTile, const shapes::Point2D& dstTile)
+{
+   static const int NEIGHBOUR_OFFSETS[8][2] = { { 0, -1 }, { -1, 0 }, { 1, 0 }, { 0, 1 }, { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+   static const float ROOT_2 = 1.41421356f;
+
+   typedef std::pair<float, int> QueueEntry;
+   std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > openSet;
+   std::vector<float> costs(grid.tiles.size(), std::numeric_limits<float>::infinity());
+
+   const int srcTileNum = srcTile.y * grid.width + srcTile.x;
+   const int dstTileNum = dstTile.y * grid.width + dstTile.x;
+   costs[srcTileNum] = 0;
+   openSet.push(QueueEntry(0, srcTileNum));
+
+   while(!openSet.empty())
+   {
+      const QueueEntry entry = openSet.top();
+      openSet.pop();
+      if(entry.first > costs[entry.second]) continue;
+      if(entry.second == dstTileNum) return entry.first;
+
+      const int x = entry.second % grid.width;
+      const int y = entry.second / grid.width;
+      for(int i = 0; i < 8; ++i)
+      {
+         const int neighbourX = x + NEIGHBOUR_OFFSETS[i][0];
+         const int neighbourY = y + NEIGHBOUR_OFFSETS[i][1];
+         if(neighbourX < 0 || neighbourY < 0 || neighbourX >= grid.width || neighbourY >= grid.height) continue;
+
+         const int neighbourTileNum = neighbourY * grid.width + neighbourX;
+         if(grid.tiles[neighbourTileNum].entityType == TileState::OBSTACLE) continue;
+
+         const float cost = entry.first + (i >= 4 ? ROOT_2 : 1.0f);
+         if(cost < costs[neighbourTileNum])
+         {
+            costs[neighbourTileNum] = cost;
+            openSet.push(QueueEntry(cost, neighbourTileNum));
+         }
+      }
+   }
+
+   return std::numeric_limits<float>::infinity();
+}
+
+/**
+ * @return The cost of moving along a path (in pixels) from a source tile.
+ */
+static float getPathCost(const shapes::Point2D& srcTile, const Pathfinder::Path& path)
+{
+   float cost = 0;
+   shapes::Point2D prevTile = srcTile;
+   for(Pathfinder::Path::const_iterator iter = path.begin(); iter != path.end(); ++iter)
+   {
+      const shapes::Point2D tile = *iter / MOVEMENT_TILE_SIZE;
+      cost += (tile.x != prevTile.x && tile.y != prevTile.y) ? 1.41421356f : 1.0f;
+      prevTile = tile;
+   }
+
+   return cost;
+}
+
+/**
+ * @return The latency at the given percentile of a sorted set of latencies.
+ */
+static double getPercentile(const std::vector<double>& sortedLatencies, double percentile)
+{
+   if(sortedLatencies.empty()) return 0;
+   return sortedLatencies[static_cast<unsigned int>(percentile * (sortedLatencies.size() - 1))];
+}
+
+/**
+ * Prints a row of the report for a set of queries.
+ */
+static void printQueryStats(const char* queryName, QueryStats& stats)
+{
+   std::sort(stats.latencies.begin(), stats.latencies.end());
+   const int queryCount = stats.latencies.size();
+
+   printf("   %-18s %5d queries, %5d found | p50 %10.1fus  p90 %10.1fus  p99 %10.1fus  max %10.1fus | %10.1f expansions/query\n",
+          queryName, queryCount, stats.pathsFound,
+          getPercentile(stats.latencies, 0.5), getPercentile(stats.latencies, 0.9),
+          getPercentile(stats.latencies, 0.99), getPercentile(stats.latencies, 1.0),
+          queryCount > 0 ? double(stats.expansions) / queryCount : 0.0);
+}
+
+/**
+ * Prints a row of the report comparing the costs of a set of best paths to the optimal costs.
+ */
+static void printPathCostStats(const PathCostStats& stats)
+{
+   printf("   %-18s %5d compared, %4d longer | mean excess %6.2f%%  max excess %7.2f%%\n",
+          "best path cost", stats.pathsCompared, stats.longerPaths,
+          stats.pathsCompared > 0 ? stats.totalExcess * 100.0 / stats.pathsCompared : 0.0, stats.maxExcess * 100.0);
+}
+
+/**
+ * Generates a grid, then initializes a pathfinder on it and runs the queries.
+ */
+static void benchmarkGrid(GridKind kind, const char* kindName, int size, int queryCount)
+{
+   Grid grid(size, size);
+   generateGrid(grid, kind);
+
+   // Actors would wall off most of the single-tile corridors in a maze, so mazes are left empty
+   std::vector<int> actors;
+   if(kind != MAZE)
+   {
+      placeActors(grid, actors);
+   }
+
+   const long memoryBefore = MemoryTracker::getTotalLiveBytes();
+   const double initStart = getMicroseconds();
+
+   PassabilityPyramid pyramid;
+   pyramid.build(&grid.rows[0], grid.width, grid.height, PYRAMID_LEVEL_COUNT);
+
+   Pathfinder pathfinder;
+   pathfinder.initialize(&grid.rows[0], &pyramid, MOVEMENT_TILE_SIZE, grid.width, grid.height);
+
+   const double initTime = getMicroseconds() - initStart;
+   const long memoryUsed = MemoryTracker::getTotalLiveBytes() - memoryBefore;
+
+   printf("%-16s %4dx%-4d | init %10.1fms | memory %8.1fKB\n", kindName, size, size, initTime / 1000.0, memoryUsed / 1024.0);
+
+   const GridOccupancy occupancy(grid);
+   QueryStats bestPathStats;
+   QueryStats aStarStats;
+   QueryStats jumpPointStats;
+   PathCostStats costStats;
+
+   int mover = 0;
+   const TileState moverState(TileState::ACTOR, &mover);
+   for(int i = 0; i < queryCount; ++i)
+   {
+      const shapes::Point2D srcTile = pickFreeTile(grid);
+      const shapes::Point2D dstTile = pickFreeTile(grid);
+      if(srcTile.x < 0 || dstTile.x < 0) break;
+
+      const shapes::Point2D src = srcTile * MOVEMENT_TILE_SIZE;
+      const shapes::Point2D dst = dstTile * MOVEMENT_TILE_SIZE;
+
+      unsigned long expansionsBefore = pathfinder.getExpansionCount();
+      double queryStart = getMicroseconds();
+      Pathfinder::Path path = pathfinder.findBestPath(src, dst);
+      bestPathStats.latencies.push_back(getMicroseconds() - queryStart);
+      bestPathStats.expansions += pathfinder.getExpansionCount() - expansionsBefore;
+      if(!path.empty()) ++bestPathStats.pathsFound;
+
+      // The exact search isn't timed; it only checks that the best path really is the cheapest one
+      const float exactCost = findExactCost(grid, srcTile, dstTile);
+      if(!path.empty() && exactCost > 0)
+      {
+         const double excess = (getPathCost(srcTile, path) - exactCost) / exactCost;
+         ++costStats.pathsCompared;
+         if(excess > 0.001)
+         {
+            ++costStats.longerPaths;
+            costStats.totalExcess += excess;
+            costStats.maxExcess = std::max(costStats.maxExcess, excess);
+         }
+      }
+
+      // Rerouted paths are found for an actor standing on the source tile
+      TileState& srcState = grid.at(srcTile.x, srcTile.y);
+      srcState = moverState;
+
+      for(int mode = 0; mode < 2; ++mode)
+      {
+         QueryStats& stats = mode == 0 ? aStarStats : jumpPointStats;
+         pathfinder.setSearchMode(mode == 0 ? Pathfinder::A_STAR_SEARCH : Pathfinder::JUMP_POINT_SEARCH);
+
+         expansionsBefore = pathfinder.getExpansionCount();
+         queryStart = getMicroseconds();
+         path = pathfinder.findReroutedPath(occupancy, src, dst, MOVEMENT_TILE_SIZE, MOVEMENT_TILE_SIZE);
+         stats.latencies.push_back(getMicroseconds() - queryStart);
+         stats.expansions += pathfinder.getExpansionCount() - expansionsBefore;
+         if(!path.empty()) ++stats.pathsFound;
+      }
+
+      srcState = TileState(TileState::FREE);
+
+      // Each query stands in for a frame, so the searches' scratch memory is given back as the game loop would
+      FrameArena::reset();
+   }
+
+   printQueryStats("findBestPath", bestPathStats);
+   printPathCostStats(costStats);
+   printQueryStats("rerouted (A*)", aStarStats);
+   printQueryStats("rerouted (JPS)", jumpPointStats);
+}
+
+int main(int argc, char* argv[])
+{
+   const int queryCount = argc > 1 ? atoi(argv[1]) : 200;
+   const unsigned int seed = argc > 2 ? atoi(argv[2]) : 1;
+
+   static const int GRID_SIZES[] = { 10, 32, 64, 128, 256, 512 };
+   static const int GRID_SIZE_COUNT = sizeof(GRID_SIZES) / sizeof(GRID_SIZES[0]);
+
+   printf("Pathfinder benchmark: %d queries per grid, seed %u\n\n", queryCount, seed);
+
+   // The rerouting searches run on the job system's workers, as they do in the game
+   JobSystem::start();
+
+   for(int i = 0; i < GRID_SIZE_COUNT; ++i)
+   {
+      srand(seed);
+      benchmarkGrid(OPEN_FIELD, "open field", GRID_SIZES[i], queryCount);
+      benchmarkGrid(RANDOM_OBSTACLES, "random obstacles", GRID_SIZES[i], queryCount);
+      benchmarkGrid(MAZE, "maze", GRID_SIZES[i], queryCount);
+      printf("\n");
+   }
+
+   JobSystem::stop();
+   FrameArena::release();
+   return 0;
+}
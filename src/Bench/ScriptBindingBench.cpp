@@ -0,0 +1,150 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * A headless benchmark for the overhead of calling the engine's C functions from Lua scripts.
+ * It times a script loop calling a C function that finds its engine in each of the ways that the
+ * script engine can: not at all (the cost of the call itself), through a global lookup, and through
+ * an upvalue of the function's closure (which is how the script engine registers its functions).
+ *
+ * Usage: script_binding_bench [calls per binding]
+ */
+
+// Include the Lua libraries. Since they are written in clean C, the functions
+// need to be included in this fashion to work with the C++ code.
+extern "C"
+{
+   #include <lua.h>
+   #include <lualib.h>
+   #include <lauxlib.h>
+}
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#ifdef _WIN32
+   #include <windows.h>
+#else
+   #include <sys/time.h>
+#endif
+
+// The same name that the script engine once stored itself under, which can't clash with a script's globals
+static const char* ENGINE_GLOBAL_NAME = ",";
+
+/** Stands in for the script engine that each bound function dispatches to. */
+struct Engine
+{
+   /** The number of calls that reached the engine, so that none of them can be optimized out. */
+   long calls;
+};
+
+/**
+ * @return The current time (in microseconds), measured from an arbitrary point.
+ */
+static double getMicroseconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return double(counter.QuadPart) * 1000000.0 / double(frequency.QuadPart);
+#else
+   timeval now;
+   gettimeofday(&now, NULL);
+   return double(now.tv_sec) * 1000000.0 + double(now.tv_usec);
+#endif
+}
+
+/** A bound function that doesn't look up the engine at all. */
+static int callWithoutEngine(lua_State* /*luaVM*/)
+{
+   return 0;
+}
+
+/** A bound function that looks up the engine in the globals on each call. */
+static int callThroughGlobal(lua_State* luaVM)
+{
+   lua_getglobal(luaVM, ENGINE_GLOBAL_NAME);
+   Engine* engine = static_cast<Engine*>(lua_touserdata(luaVM, lua_gettop(luaVM)));
+   lua_pop(luaVM, 1);
+   ++engine->calls;
+   return 0;
+}
+
+/** A bound function that gets the engine from its closure's upvalue. */
+static int callThroughUpvalue(lua_State* luaVM)
+{
+   Engine* engine = static_cast<Engine*>(lua_touserdata(luaVM, lua_upvalueindex(1)));
+   ++engine->calls;
+   return 0;
+}
+
+/**
+ * Times a script loop that calls a global function.
+ *
+ * @param luaVM The Lua VM holding the function.
+ * @param bindingName The name of the binding, for the report.
+ * @param functionName The global name of the function to call.
+ * @param callCount The number of calls to make.
+ *
+ * @return The average time (in nanoseconds) per call.
+ */
+static double benchmarkBinding(lua_State* luaVM, const char* bindingName, const char* functionName, int callCount)
+{
+   std::stringstream script;
+   script << "local f = " << functionName << " for i = 1, " << callCount << " do f() end";
+
+   if(luaL_loadstring(luaVM, script.str().c_str()) != 0)
+   {
+      fprintf(stderr, "Unable to compile benchmark script: %s\n", lua_tostring(luaVM, -1));
+      exit(1);
+   }
+
+   const double start = getMicroseconds();
+   if(lua_pcall(luaVM, 0, 0, 0) != 0)
+   {
+      fprintf(stderr, "Unable to run benchmark script: %s\n", lua_tostring(luaVM, -1));
+      exit(1);
+   }
+
+   const double perCall = (getMicroseconds() - start) * 1000.0 / callCount;
+   printf("   %-16s %8.1fns/call\n", bindingName, perCall);
+   return perCall;
+}
+
+int main(int argc, char* argv[])
+{
+   const int callCount = argc > 1 ? atoi(argv[1]) : 10000000;
+
+   lua_State* luaVM = luaL_newstate();
+   luaL_openlibs(luaVM);
+
+   Engine engine;
+   engine.calls = 0;
+
+   lua_pushlightuserdata(luaVM, &engine);
+   lua_setglobal(luaVM, ENGINE_GLOBAL_NAME);
+
+   lua_register(luaVM, "withoutEngine", callWithoutEngine);
+   lua_register(luaVM, "throughGlobal", callThroughGlobal);
+
+   lua_pushlightuserdata(luaVM, &engine);
+   lua_pushcclosure(luaVM, callThroughUpvalue, 1);
+   lua_setglobal(luaVM, "throughUpvalue");
+
+   printf("Script binding benchmark: %d calls per binding\n\n", callCount);
+
+   const double baseline = benchmarkBinding(luaVM, "no engine lookup", "withoutEngine", callCount);
+   const double global = benchmarkBinding(luaVM, "global lookup", "throughGlobal", callCount);
+   const double upvalue = benchmarkBinding(luaVM, "upvalue", "throughUpvalue", callCount);
+
+   printf("\nEngine lookup overhead: global %.1fns/call, upvalue %.1fns/call\n", global - baseline, upvalue - baseline);
+
+   lua_close(luaVM);
+   return engine.calls == 2L * callCount ? 0 : 1;
+}
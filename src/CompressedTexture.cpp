@@ -0,0 +1,158 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "CompressedTexture.h"
+#include "GLState.h"
+#include "GraphicsUtil.h"
+#include "AssetStream.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS | DEBUG_RES_LOAD;
+
+const std::string CompressedTexture::EXTENSION = ".dds";
+
+bool CompressedTexture::functionsLoaded = false;
+bool CompressedTexture::compressionSupported = false;
+
+// The compressed texture functions aren't part of OpenGL 1.1, so they have to be looked up from the driver
+static PFNGLCOMPRESSEDTEXIMAGE2DARBPROC compressedTexImage2D = NULL;
+
+/**
+ * @param bytes The first of four bytes holding a little-endian 32-bit number.
+ *
+ * @return The number.
+ */
+static unsigned int readLittleEndian(const unsigned char* bytes)
+{
+   return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+}
+
+void CompressedTexture::loadFunctions()
+{
+   functionsLoaded = true;
+
+   const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+   if(extensions == NULL || strstr(extensions, "GL_EXT_texture_compression_s3tc") == NULL)
+   {
+      DEBUG("S3TC texture compression is not supported; images will be loaded uncompressed.");
+      return;
+   }
+
+   compressedTexImage2D = reinterpret_cast<PFNGLCOMPRESSEDTEXIMAGE2DARBPROC>(GraphicsUtil::getProcAddress("glCompressedTexImage2DARB"));
+
+   compressionSupported = compressedTexImage2D != NULL;
+   DEBUG("S3TC texture compression is %s", compressionSupported ? "supported" : "missing functions; images will be loaded uncompressed.");
+}
+
+std::string CompressedTexture::getPath(const char* imagePath)
+{
+   std::string path(imagePath);
+   const std::string::size_type extensionStart = path.find_last_of('.');
+   if(extensionStart != std::string::npos && path.find_first_of("/\\", extensionStart) == std::string::npos)
+   {
+      path.erase(extensionStart);
+   }
+
+   return path + EXTENSION;
+}
+
+bool CompressedTexture::load(const std::string& path, GLuint& texture, int& w, int& h)
+{
+   AssetStream input(path, std::ios::in | std::ios::binary);
+   if(!input.is_open())
+   {
+      return false;
+   }
+
+   if(!functionsLoaded)
+   {
+      loadFunctions();
+   }
+
+   if(!compressionSupported)
+   {
+      return false;
+   }
+
+   // A DDS file is a 4-byte signature followed by a 124-byte header; the sizes of interest
+   // are at fixed offsets in the header, followed by the pixel format's flags and FourCC code
+   const int HEADER_SIZE = 128;
+   const unsigned int FOURCC_FLAG = 0x4;
+   unsigned char header[HEADER_SIZE];
+   if(!input.read(reinterpret_cast<char*>(header), HEADER_SIZE) || memcmp(header, "DDS ", 4) != 0)
+   {
+      DEBUG("%s is not a DDS file; loading the uncompressed image instead.", path.c_str());
+      return false;
+   }
+
+   const int height = readLittleEndian(header + 12);
+   const int width = readLittleEndian(header + 16);
+   const int mipmapCount = std::max(1u, readLittleEndian(header + 28));
+   const unsigned int formatFlags = readLittleEndian(header + 80);
+
+   GLenum format;
+   int blockSize = 16;
+   if(!(formatFlags & FOURCC_FLAG))
+   {
+      DEBUG("%s is not compressed; loading the uncompressed image instead.", path.c_str());
+      return false;
+   }
+   else if(memcmp(header + 84, "DXT1", 4) == 0)
+   {
+      format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+      blockSize = 8;
+   }
+   else if(memcmp(header + 84, "DXT3", 4) == 0)
+   {
+      format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+   }
+   else if(memcmp(header + 84, "DXT5", 4) == 0)
+   {
+      format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+   }
+   else
+   {
+      DEBUG("%s uses an unsupported compression format; loading the uncompressed image instead.", path.c_str());
+      return false;
+   }
+
+   // Read every mipmap level before creating the texture, so that a truncated file leaves nothing behind
+   std::vector<std::vector<char> > levels(mipmapCount);
+   for(int level = 0; level < mipmapCount; ++level)
+   {
+      const int levelWidth = std::max(1, width >> level);
+      const int levelHeight = std::max(1, height >> level);
+      levels[level].resize(((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize);
+      if(!input.read(&levels[level][0], levels[level].size()))
+      {
+         DEBUG("%s is truncated; loading the uncompressed image instead.", path.c_str());
+         return false;
+      }
+   }
+
+   glGenTextures(1, &texture);
+   GLState::bindTexture(texture);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipmapCount - 1);
+
+   for(int level = 0; level < mipmapCount; ++level)
+   {
+      compressedTexImage2D(GL_TEXTURE_2D, level, format, std::max(1, width >> level), std::max(1, height >> level), 0,
+            levels[level].size(), &levels[level][0]);
+   }
+
+   w = width;
+   h = height;
+
+   DEBUG("Loaded compressed image %s (%dx%d, %d mipmap levels).", path.c_str(), w, h, mipmapCount);
+   return true;
+}
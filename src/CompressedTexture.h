@@ -0,0 +1,61 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include <string>
+
+typedef unsigned int GLuint;
+
+/**
+ * The CompressedTexture loads precompressed images from DDS files (DXT1, DXT3 or DXT5),
+ * along with any mipmaps stored in them. The compressed blocks are handed to the driver
+ * as they are, so the image takes a quarter to an eighth of the video memory of its PNG,
+ * and nothing has to be decoded or converted before it is uploaded.
+ *
+ * A compressed image sits beside the PNG it was made from, with the same name and a .dds extension.
+ * The PNG is used instead when there is no such file, or when the driver can't draw S3TC textures.
+ */
+class CompressedTexture
+{
+   /** The file extension of compressed images. */
+   static const std::string EXTENSION;
+
+   /** Whether or not the compressed texture functions have been looked up. */
+   static bool functionsLoaded;
+
+   /** Whether or not the driver supports S3TC compressed textures. */
+   static bool compressionSupported;
+
+   /**
+    * Looks up the compressed texture functions, if the driver supports them.
+    */
+   static void loadFunctions();
+
+   public:
+      /**
+       * @param imagePath The file path to an uncompressed image.
+       *
+       * @return The file path that a compressed version of the image would have.
+       */
+      static std::string getPath(const char* imagePath);
+
+      /**
+       * Loads a compressed image into a new texture.
+       *
+       * @param path The file path to the compressed image.
+       * @param texture The parameter used to return the OpenGL texture index.
+       * @param w The parameter used to return image width.
+       * @param h The parameter used to return image height.
+       *
+       * @return true iff the image was loaded; false if there is no compressed image
+       *         at the path, it can't be read, or the driver can't draw it.
+       */
+      static bool load(const std::string& path, GLuint& texture, int& w, int& h);
+};
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "CompositeCondition.h"
+
+CompositeCondition::CompositeCondition(Mode mode) : mode(mode)
+{
+}
+
+void CompositeCondition::add(WaitCondition* condition)
+{
+   conditions.push_back(condition);
+}
+
+bool CompositeCondition::isMet() const
+{
+   if(conditions.empty()) return true;
+
+   // Stop testing as soon as the answer is known
+   const bool stopWhenMet = mode == ANY;
+   for(std::vector<WaitCondition*>::const_iterator iter = conditions.begin(); iter != conditions.end(); ++iter)
+   {
+      if((*iter)->isMet() == stopWhenMet)
+      {
+         return stopWhenMet;
+      }
+   }
+
+   return !stopWhenMet;
+}
+
+CompositeCondition::~CompositeCondition()
+{
+   for(std::vector<WaitCondition*>::iterator iter = conditions.begin(); iter != conditions.end(); ++iter)
+   {
+      delete *iter;
+   }
+}
@@ -0,0 +1,69 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef COMPOSITE_CONDITION_H
+#define COMPOSITE_CONDITION_H
+
+#include "WaitCondition.h"
+#include <vector>
+
+/**
+ * A condition made up of other conditions, which is met once all of them are met (or once any of them is).
+ * A thread can wait on a whole group of things (such as every NPC in a crowd finishing its orders)
+ * with a single wait, so it is only resumed once, when the group is done, instead of once for each of them.
+ */
+class CompositeCondition : public WaitCondition
+{
+   public:
+      /** How the conditions are combined. */
+      enum Mode
+      {
+         /** The condition is met once every one of the conditions is met. */
+         ALL,
+         /** The condition is met once any one of the conditions is met. */
+         ANY
+      };
+
+   private:
+      /** How the conditions are combined. */
+      const Mode mode;
+
+      /** The conditions, which belong to this condition. */
+      std::vector<WaitCondition*> conditions;
+
+      /** Composite conditions can't be copied. */
+      CompositeCondition(const CompositeCondition&);
+
+      /** Composite conditions can't be copied. */
+      CompositeCondition& operator=(const CompositeCondition&);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param mode How the conditions are combined.
+       */
+      CompositeCondition(Mode mode);
+
+      /**
+       * Adds a condition to the group.
+       *
+       * @param condition The condition, which is deleted along with this one.
+       */
+      void add(WaitCondition* condition);
+
+      /**
+       * @return true iff the conditions are met, as combined by the mode. A group without any conditions is always met.
+       */
+      bool isMet() const;
+
+      /**
+       * Destructor. Deletes the conditions.
+       */
+      ~CompositeCondition();
+};
+
+#endif
@@ -5,44 +5,188 @@
  */
 
 #include "Scheduler.h"
+#include "Sequence.h"
 #include "Task.h"
+#include "WaitCondition.h"
 #include "Thread.h"
+#include "FrameProfiler.h"
+#include <SDL.h>
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_SCHEDULER;
 
-Scheduler::Scheduler() : runningThread(NULL)
+// Half of a frame at 60 frames per second, which leaves the rest of the frame for the game logic and drawing
+static const long DEFAULT_RUN_BUDGET = 8;
+
+Scheduler::Scheduler() : runningThread(NULL), runBudget(DEFAULT_RUN_BUDGET), wheelTime(0)
+{
+}
+
+Scheduler::ThreadQueue* Scheduler::getQueue(Thread::ScheduleState state, Thread::Priority priority)
+{
+   switch(state)
+   {
+      case Thread::STARTING: return &unstartedThreads;
+      case Thread::READY: return &readyThreads[priority];
+      case Thread::WAITING: return &waitingThreads;
+      case Thread::SUSPENDED: return &suspendedThreads;
+      case Thread::FINISHED: return &finishedThreads;
+      case Thread::UNSCHEDULED:
+      default: return NULL;
+   }
+}
+
+void Scheduler::unlink(Thread* thread)
+{
+   ThreadQueue* queue = thread->scheduleState == Thread::SLEEPING ? &timerWheel[thread->wheelSlot] : getQueue(thread->scheduleState, thread->priority);
+   if(queue != NULL)
+   {
+      if(thread->previousScheduled != NULL) thread->previousScheduled->nextScheduled = thread->nextScheduled;
+      else queue->head = thread->nextScheduled;
+
+      if(thread->nextScheduled != NULL) thread->nextScheduled->previousScheduled = thread->previousScheduled;
+      else queue->tail = thread->previousScheduled;
+   }
+
+   thread->previousScheduled = thread->nextScheduled = NULL;
+}
+
+void Scheduler::append(Thread* thread, ThreadQueue& queue)
+{
+   thread->previousScheduled = queue.tail;
+   thread->nextScheduled = NULL;
+
+   if(queue.tail != NULL) queue.tail->nextScheduled = thread;
+   else queue.head = thread;
+
+   queue.tail = thread;
+}
+
+void Scheduler::reschedule(Thread* thread, Thread::ScheduleState state)
+{
+   unlink(thread);
+
+   ThreadQueue* queue = getQueue(state, thread->priority);
+   if(queue != NULL)
+   {
+      append(thread, *queue);
+   }
+
+   thread->scheduleState = state;
+}
+
+void Scheduler::park(Thread* thread)
 {
+   unlink(thread);
+
+   // Threads that sleep for longer than the wheel reaches are parked at its far end, and parked again when they get there
+   const unsigned long wheelSpan = 1UL << (WHEEL_SLOT_BITS * WHEEL_LEVELS);
+   unsigned long wakeTime = thread->wakeTime;
+   if(wakeTime - wheelTime >= wheelSpan)
+   {
+      wakeTime = wheelTime + wheelSpan - 1;
+   }
+
+   // Use the lowest level whose slots are shared by the wake time and the current time,
+   // so that the thread is moved down (or woken up) when the wheel turns to its slot
+   int level = 0;
+   while(level < WHEEL_LEVELS - 1 && (wakeTime >> (WHEEL_SLOT_BITS * (level + 1))) != (wheelTime >> (WHEEL_SLOT_BITS * (level + 1))))
+   {
+      ++level;
+   }
+
+   const int slot = level * WHEEL_SLOTS + ((wakeTime >> (WHEEL_SLOT_BITS * level)) & (WHEEL_SLOTS - 1));
+   append(thread, timerWheel[slot]);
+   thread->wheelSlot = slot;
+   thread->scheduleState = Thread::SLEEPING;
+}
+
+void Scheduler::turnWheel(long timePassed)
+{
+   for(long tick = 0; tick < timePassed; ++tick)
+   {
+      ++wheelTime;
+
+      // When a level comes back around to its first slot, the next slot of the level above it
+      // is reached, so its threads are spread out over the levels below
+      for(int level = 1; level < WHEEL_LEVELS && (wheelTime & ((1UL << (WHEEL_SLOT_BITS * level)) - 1)) == 0; ++level)
+      {
+         ThreadQueue& slot = timerWheel[level * WHEEL_SLOTS + ((wheelTime >> (WHEEL_SLOT_BITS * level)) & (WHEEL_SLOTS - 1))];
+         while(slot.head != NULL)
+         {
+            park(slot.head);
+         }
+      }
+
+      // Wake up the threads whose wake time is now, putting them onto the back of the unstarted queue
+      ThreadQueue& slot = timerWheel[wheelTime & (WHEEL_SLOTS - 1)];
+      while(slot.head != NULL)
+      {
+         Thread* thread = slot.head;
+         if(thread->wakeTime != wheelTime)
+         {
+            // This thread sleeps for longer than the wheel reaches, and has only gotten to the far end of it
+            park(thread);
+            continue;
+         }
+
+         TRACE("Waking up thread %d...", thread->getId());
+         reschedule(thread, Thread::STARTING);
+      }
+   }
 }
 
 void Scheduler::printFinishedQueue()
 {
-   DEBUG("Finished Thread List:");
-   DEBUG("---");
-   const int queueSize = finishedThreads.size();
-   for(int i = 0; i < queueSize; ++i)
+   // Don't walk the whole queue just to drop every line of it
+   if(!DebugUtils::isLogging(debugFlag, DebugUtils::LEVEL_TRACE)) return;
+
+   TRACE("Finished Thread List:");
+   TRACE("---");
+   for(Thread* t = finishedThreads.head; t != NULL; t = t->nextScheduled)
    {
-      Thread* t = finishedThreads.front();
-      DEBUG("\t%d at address 0x%x", t->getId(), t);
-      finishedThreads.pop();
-      finishedThreads.push(t);
+      TRACE("\t%d at address 0x%x", t->getId(), t);
    }
-   DEBUG("---");
+   TRACE("---");
 }
 
 void Scheduler::start(Thread* thread)
 {
-   DEBUG("Starting thread %d...", thread->getId());
+   TRACE("Starting thread %d...", thread->getId());
 
    // Ensure that this thread is not already scheduled
-   if(readyThreads.find(thread) == readyThreads.end()
-      && unstartedThreads.find(thread) == unstartedThreads.end())
+   if(thread->scheduleState == Thread::UNSCHEDULED)
    {
-      // Insert the thread into the unstarted thread list
-      unstartedThreads.insert(thread);
+      // Insert the thread into the unstarted thread queue
+      reschedule(thread, Thread::STARTING);
    }
 }
 
+void Scheduler::start(Sequence* sequence)
+{
+   sequence->scheduler = this;
+   sequence->nextSequence = NULL;
+
+   if(startingSequences.tail != NULL) startingSequences.tail->nextSequence = sequence;
+   else startingSequences.head = sequence;
+
+   startingSequences.tail = sequence;
+}
+
+void Scheduler::block(Sequence* sequence, Task* pendingTask)
+{
+   TRACE("Blocking a sequence on task %d...", pendingTask->getTaskId());
+   sequence->waiting = true;
+   pendingTask->blockedSequence = sequence;
+}
+
+void Scheduler::join(Sequence* sequence, Thread* thread)
+{
+   TRACE("Joining a sequence on thread %d...", thread->getId());
+   sequence->waiting = true;
+   thread->joiningSequence = sequence;
+}
+
 bool Scheduler::hasRunningThread()
 {
    return runningThread;
@@ -50,214 +194,466 @@ bool Scheduler::hasRunningThread()
 
 int Scheduler::block(Task* pendingTask)
 {
-   DEBUG("Blocking thread %d on task %d...", runningThread->getId(), pendingTask->getTaskId());
+   TRACE("Blocking thread %d on task %d...", runningThread->getId(), pendingTask->getTaskId());
 
-   // Find the thread in the ready list
-   if(readyThreads.find(runningThread) != readyThreads.end())
+   if(runningThread->scheduleState == Thread::READY)
    {
-      // If the thread is in the ready list, push it into the finished thread list
-      DEBUG("Putting thread %d in the finish list", runningThread->getId());
-      finishedThreads.push(runningThread);
-      printFinishedQueue();
-
-      // Add the thread to the blocked list
-      blockedThreads[pendingTask->getTaskId()] = runningThread;
+      // Take the thread off the ready queue until the task is done
+      TRACE("Moving thread %d to the waiting queue", runningThread->getId());
+      reschedule(runningThread, Thread::WAITING);
+      pendingTask->blockedThread = runningThread;
+      profiler.setYieldReason(SchedulerProfiler::BLOCKED_ON_TASK);
    }
    else
    {
       T_T("Attempting to block a thread that isn't ready/running!");
    }
 
-   DEBUG("Yielding: %d", runningThread->getId());
+   TRACE("Yielding: %d", runningThread->getId());
    return runningThread->yield();
 }
 
-void Scheduler::taskDone(TaskId finishedTask)
+void Scheduler::taskDone(Task* finishedTask)
 {
-   DEBUG("Task %d finished.", finishedTask);
+   TRACE("Task %d finished.", finishedTask->getTaskId());
 
-   Thread* resumingThread = blockedThreads[finishedTask];
-   if(resumingThread)
+   Thread* resumingThread = finishedTask->blockedThread;
+   if(resumingThread != NULL && resumingThread->scheduleState == Thread::WAITING)
    {
-      DEBUG("Putting thread %d on resume list...", resumingThread->getId());
+      TRACE("Putting thread %d on resume list...", resumingThread->getId());
 
-      // Put the resumed thread onto the unstarted stack
-      unstartedThreads.insert(resumingThread);
+      // Put the resumed thread onto the unstarted queue
+      reschedule(resumingThread, Thread::STARTING);
+   }
 
-      // Remove the thread from the block list
-      blockedThreads[finishedTask] = NULL;
+   if(finishedTask->blockedSequence != NULL)
+   {
+      finishedTask->blockedSequence->waiting = false;
    }
+
+   finishedTask->blockedThread = NULL;
+   finishedTask->blockedSequence = NULL;
 }
 
 int Scheduler::join(Thread* thread)
 {
-   DEBUG("Joining thread %d on thread %d...", runningThread->getId(), thread->getId());
+   TRACE("Joining thread %d on thread %d...", runningThread->getId(), thread->getId());
 
-   // Find the thread in the ready list
-   if(readyThreads.find(runningThread) != readyThreads.end())
+   if(runningThread->scheduleState == Thread::READY)
    {
-      // If the thread is in the ready list, push it into the finished thread list
-      DEBUG("Putting thread %d in the finish list", runningThread->getId());
-      finishedThreads.push(runningThread);
-      printFinishedQueue();
-
-      // Add the thread to the joining list
-      joiningThreads[thread] = runningThread;
+      // Take the thread off the ready queue until the other thread finishes
+      TRACE("Moving thread %d to the waiting queue", runningThread->getId());
+      reschedule(runningThread, Thread::WAITING);
+      thread->joiningThread = runningThread;
+      profiler.setYieldReason(SchedulerProfiler::JOINED);
    }
    else
    {
       T_T("Attempting to suspend a thread that isn't ready/running!");
    }
 
-   DEBUG("Yielding: %d", runningThread->getId());
+   TRACE("Yielding: %d", runningThread->getId());
    return runningThread->yield();
 }
 
+int Scheduler::waitUntil(WaitCondition* condition)
+{
+   if(condition->isMet())
+   {
+      delete condition;
+      return 0;
+   }
+
+   ConditionWait wait;
+   wait.condition = condition;
+   wait.task = Task::getNextTask(*this);
+   conditionWaits.push_back(wait);
+   return block(wait.task);
+}
+
+void Scheduler::testConditions()
+{
+   for(unsigned int i = 0; i < conditionWaits.size();)
+   {
+      ConditionWait& wait = conditionWaits[i];
+      if(!wait.condition->isMet())
+      {
+         ++i;
+         continue;
+      }
+
+      // The waiting thread is readied along with the other unstarted threads, and the wait is swapped out of the list
+      delete wait.condition;
+      wait.task->signal();
+      wait = conditionWaits.back();
+      conditionWaits.pop_back();
+   }
+}
+
+void Scheduler::setPriority(Thread* thread, Thread::Priority priority)
+{
+   if(thread->priority == priority) return;
+
+   // A ready thread moves to the back of its new class's queue
+   if(thread->scheduleState == Thread::READY)
+   {
+      unlink(thread);
+      thread->priority = priority;
+      append(thread, readyThreads[priority]);
+   }
+   else
+   {
+      thread->priority = priority;
+   }
+}
+
+int Scheduler::sleep(long time)
+{
+   TRACE("Putting thread %d to sleep for %ld milliseconds...", runningThread->getId(), time);
+
+   if(runningThread->scheduleState == Thread::READY)
+   {
+      // Sleep for at least until the next run, since the current time's slot in the wheel is already past
+      runningThread->wakeTime = wheelTime + (time > 0 ? time : 1);
+      park(runningThread);
+      profiler.setYieldReason(SchedulerProfiler::SLEEPING);
+   }
+   else
+   {
+      T_T("Attempting to put a thread to sleep that isn't ready/running!");
+   }
+
+   TRACE("Yielding: %d", runningThread->getId());
+   return runningThread->yield();
+}
+
+void Scheduler::suspend()
+{
+   if(runningThread != NULL && runningThread->scheduleState == Thread::READY)
+   {
+      TRACE("Suspending thread %d...", runningThread->getId());
+      reschedule(runningThread, Thread::SUSPENDED);
+      profiler.setYieldReason(SchedulerProfiler::SUSPENDED);
+   }
+}
+
+void Scheduler::wake(Thread* thread)
+{
+   if(thread->scheduleState == Thread::SUSPENDED)
+   {
+      // Woken threads are readied along with the other unstarted threads at the start of the next run
+      TRACE("Waking thread %d...", thread->getId());
+      reschedule(thread, Thread::STARTING);
+   }
+}
+
 void Scheduler::threadDone(Thread* thread)
 {
    // A thread has completed execution,
    // so check if anyone is waiting for it to finish
-   Thread* resumingThread = joiningThreads[thread];
+   Thread* resumingThread = thread->joiningThread;
 
-   if(resumingThread)
+   if(resumingThread != NULL && resumingThread->scheduleState == Thread::WAITING)
    {
-      // If there is such a thread, put it on the unstarted thread list again
-      DEBUG("Putting thread %d on resume list...", resumingThread->getId());
-      unstartedThreads.insert(resumingThread);
+      // If there is such a thread, put it on the unstarted thread queue again
+      TRACE("Putting thread %d on resume list...", resumingThread->getId());
+      reschedule(resumingThread, Thread::STARTING);
+   }
 
-      // Clear the joining thread out of the joining list
-      joiningThreads[thread] = NULL;
+   if(thread->joiningSequence != NULL)
+   {
+      thread->joiningSequence->waiting = false;
    }
+
+   thread->joiningThread = NULL;
+   thread->joiningSequence = NULL;
+}
+
+void Scheduler::runSequences(long timePassed)
+{
+   // The sequences started since the last run go on after the others
+   if(startingSequences.head != NULL)
+   {
+      if(sequences.tail != NULL) sequences.tail->nextSequence = startingSequences.head;
+      else sequences.head = startingSequences.head;
+
+      sequences.tail = startingSequences.tail;
+      startingSequences.head = startingSequences.tail = NULL;
+   }
+
+   // Only the stepped sequence can leave the list during its step (sequences started meanwhile
+   // wait for the next run), so the next sequence is safe to hold onto
+   Sequence* previousSequence = NULL;
+   Sequence* sequence = sequences.head;
+   while(sequence != NULL)
+   {
+      Sequence* const nextSequence = sequence->nextSequence;
+      if(sequence->resume(timePassed))
+      {
+         if(previousSequence != NULL) previousSequence->nextSequence = nextSequence;
+         else sequences.head = nextSequence;
+
+         if(sequences.tail == sequence) sequences.tail = previousSequence;
+
+         delete sequence;
+      }
+      else
+      {
+         previousSequence = sequence;
+      }
+
+      sequence = nextSequence;
+   }
+}
+
+void Scheduler::deleteSequences(SequenceList& list)
+{
+   while(list.head != NULL)
+   {
+      Sequence* sequence = list.head;
+      list.head = sequence->nextSequence;
+      delete sequence;
+   }
+
+   list.tail = NULL;
 }
 
 void Scheduler::finished(Thread* thread)
 {
    // Check for any joins on this thread, then push it onto the finished
-   // thread list
+   // thread queue to be deleted after the run
    threadDone(thread);
-   DEBUG("Putting thread %d in the finish list", thread->getId());
+   TRACE("Putting thread %d in the finish list", thread->getId());
+   reschedule(thread, Thread::FINISHED);
    printFinishedQueue();
-   finishedThreads.push(thread);
-   deletedThreads.push(thread);
 }
 
 void Scheduler::runThreads(long timePassed)
 {
-   // If there are any threads on the unstarted list, then put them all into
-   // the ready list and clear the unstarted list
-   if(!unstartedThreads.empty())
+   PROFILE_ZONE("Scheduler::runThreads");
+
+   // Wake up the threads that are done sleeping, so that they are readied along with the other unstarted threads
+   turnWheel(timePassed);
+
+   // The threads whose conditions have come true are readied with them too
+   testConditions();
+
+   // The engine's sequences are stepped first, so that the threads they unblock are readied in this run
+   runSequences(timePassed);
+
+   // If there are any threads on the unstarted queue, then move them all onto
+   // the back of the ready queue, in the order they were started
+   while(unstartedThreads.head != NULL)
    {
-      readyThreads.insert(unstartedThreads.begin(), unstartedThreads.end());
-      unstartedThreads.clear();
+      reschedule(unstartedThreads.head, Thread::READY);
    }
 
-   // Run each thread until either it yields or finishes execution
-   for(ThreadList::iterator iter = readyThreads.begin(); iter != readyThreads.end(); ++iter)
+   // Run each thread until either it yields or finishes execution, one priority class after another.
+   // Once the budget is used up, only the critical threads still get their turns.
+   const Uint32 runStartTime = SDL_GetTicks();
+   bool anyPreempted = false;
+   for(int priority = 0; priority < Thread::NUM_PRIORITIES; ++priority)
    {
-      // Set the running thread to the next thread
-      runningThread = *iter;
+      anyPreempted = resumeQueue(readyThreads[priority], timePassed, runStartTime, priority != Thread::CRITICAL) || anyPreempted;
+   }
 
-      try
+   // Give the preempted threads more turns, one after the other (and the higher classes first), for as long as the budget lasts
+   while(anyPreempted && !isOverBudget(runStartTime))
+   {
+      anyPreempted = false;
+      for(int priority = 0; priority < Thread::NUM_PRIORITIES; ++priority)
       {
-         // Run/resume the thread
-         bool scriptIsFinished = runningThread->resume(timePassed);
-   
-         if(scriptIsFinished)
+         Thread* nextThread = readyThreads[priority].head;
+         while(nextThread != NULL && !isOverBudget(runStartTime))
          {
-            finished(runningThread);
+            runningThread = nextThread;
+            nextThread = runningThread->nextScheduled;
+
+            if(runningThread->preempted)
+            {
+               // The thread already got the time for this run on its first turn
+               resumeRunningThread(0);
+               anyPreempted = anyPreempted || (runningThread->scheduleState == Thread::READY && runningThread->preempted);
+            }
          }
       }
-      catch(Exception& e)
-      {
-         // This coroutine malfunctioned in some terminal way. We should not run it again.
-         /** \todo These debug messages cause a segmentation fault when a map script throws an exception. */
-         DEBUG("Thread failure encountered! Removing thread %d", runningThread->getId());
-         DEBUG("Reason: %s", e.getMessage().c_str());
-         finished(*iter);
-      }
    }
 
    // Clear the running thread since none are running now
    runningThread = NULL;
 
-   // If there are any finished/blocked threads,
-   // remove them from the ready thread list
-   while(!finishedThreads.empty())
-   {
-      Thread* thread = finishedThreads.front();
-      DEBUG("Removing thread %d from ready list...", thread->getId());
+   // If there are any threads that are done and need deleting, delete them
+   deleteThreads(finishedThreads);
+}
 
-      readyThreads.erase(thread);
-      finishedThreads.pop();
-   }
+bool Scheduler::isOverBudget(Uint32 runStartTime) const
+{
+   return runBudget > 0 && SDL_GetTicks() - runStartTime >= static_cast<Uint32>(runBudget);
+}
 
-   // If there are any threads that are done and need deleting, delete them
-   while(!deletedThreads.empty())
+bool Scheduler::resumeQueue(ThreadQueue& queue, long timePassed, Uint32 runStartTime, bool budgeted)
+{
+   // Only the running thread can leave the ready queue during its turn (and threads that are
+   // started or unblocked meanwhile wait for the next run), so the next thread is safe to hold onto.
+   bool anyPreempted = false;
+   Thread* nextThread = queue.head;
+   while(nextThread != NULL)
    {
-      Thread* thread = deletedThreads.front();
-      DEBUG("Deleting thread %d", thread->getId());
-      delete thread;
-      deletedThreads.pop();
+      if(budgeted && isOverBudget(runStartTime))
+      {
+         DEBUG("Scheduler run is over budget; leaving threads from %d onwards for the next run", nextThread->getId());
+
+         for(Thread* t = nextThread; t != NULL; t = t->nextScheduled)
+         {
+            t->missedTime += timePassed;
+         }
+
+         // Rotate the queue so that the threads that didn't get a turn go first in the next run
+         if(nextThread != queue.head)
+         {
+            queue.tail->nextScheduled = queue.head;
+            queue.head->previousScheduled = queue.tail;
+            queue.tail = nextThread->previousScheduled;
+            queue.tail->nextScheduled = NULL;
+            nextThread->previousScheduled = NULL;
+            queue.head = nextThread;
+         }
+
+         break;
+      }
+
+      // Set the running thread to the next thread
+      runningThread = nextThread;
+      nextThread = runningThread->nextScheduled;
+
+      const long threadTime = timePassed + runningThread->missedTime;
+      runningThread->missedTime = 0;
+      resumeRunningThread(threadTime);
+
+      anyPreempted = anyPreempted || (runningThread->scheduleState == Thread::READY && runningThread->preempted);
    }
+
+   return anyPreempted;
 }
 
-Scheduler::~Scheduler()
+void Scheduler::resumeRunningThread(long timePassed)
 {
-   // Delete all the blocked threads.
-   BlockList::iterator blockListIter;
-   for(blockListIter = blockedThreads.begin(); blockListIter != blockedThreads.end(); ++blockListIter)
+   try
    {
-      Thread* threadToDelete = blockListIter->second;
-      if(threadToDelete != NULL)
+      // Run/resume the thread
+      FrameProfiler::Event resumeEvent("script resume");
+      if(resumeEvent.isRecorded())
       {
-         delete threadToDelete;
+         resumeEvent.setDetail(runningThread->getName());
       }
-   }
 
-   // Delete all the threads waiting on a join.
-   JoinList::iterator joinListIter;
-   for(joinListIter = joiningThreads.begin(); joinListIter != joiningThreads.end(); ++joinListIter)
-   {
-      Thread* threadToDelete = joinListIter->second;
-      if(threadToDelete != NULL)
+      profiler.beginResume();
+      runningThread->preempted = false;
+      bool scriptIsFinished = runningThread->resume(timePassed);
+      if(runningThread->preempted)
       {
-         delete threadToDelete;
+         profiler.setYieldReason(SchedulerProfiler::PREEMPTED);
       }
-   }
 
-   // Delete all the unstarted threads.
-   ThreadList::iterator unstartedListIter;
-   for(unstartedListIter = unstartedThreads.begin(); unstartedListIter != unstartedThreads.end(); ++unstartedListIter)
-   {
-      Thread* threadToDelete = *unstartedListIter;
-      if(threadToDelete != NULL)
+      profiler.endResume(runningThread, scriptIsFinished, false);
+
+      if(scriptIsFinished)
       {
-         delete threadToDelete;
+         finished(runningThread);
       }
    }
+   catch(Exception& e)
+   {
+      // This coroutine malfunctioned in some terminal way. We should not run it again.
+      /** \todo These debug messages cause a segmentation fault when a map script throws an exception. */
+      LOG_ERROR("Thread failure encountered! Removing thread %d", runningThread->getId());
+      LOG_ERROR("Reason: %s", e.getMessage().c_str());
+      profiler.endResume(runningThread, false, true);
+      finished(runningThread);
+   }
+}
+
+void Scheduler::setRunBudget(long milliseconds)
+{
+   runBudget = milliseconds;
+}
 
-   // Delete all the ready threads.
-   ThreadList::iterator readyListIter;
-   for(readyListIter = readyThreads.begin(); readyListIter != readyThreads.end(); ++readyListIter)
+SchedulerProfiler& Scheduler::getProfiler()
+{
+   return profiler;
+}
+
+int Scheduler::countQueue(const ThreadQueue& queue)
+{
+   int count = 0;
+   for(const Thread* t = queue.head; t != NULL; t = t->nextScheduled)
    {
-      Thread* threadToDelete = *readyListIter;
-      if(threadToDelete != NULL)
-      {
-         delete threadToDelete;
-      }
+      ++count;
    }
 
-   // Delete all the finished threads.
-   while(!finishedThreads.empty())
+   return count;
+}
+
+Scheduler::ThreadCounts Scheduler::countThreads() const
+{
+   ThreadCounts counts;
+   counts.starting = countQueue(unstartedThreads);
+   counts.ready = 0;
+   for(int priority = 0; priority < Thread::NUM_PRIORITIES; ++priority)
+   {
+      counts.ready += countQueue(readyThreads[priority]);
+   }
+
+   counts.waiting = countQueue(waitingThreads);
+   counts.suspended = countQueue(suspendedThreads);
+   counts.finished = countQueue(finishedThreads);
+
+   counts.sleeping = 0;
+   for(int slot = 0; slot < WHEEL_LEVELS * WHEEL_SLOTS; ++slot)
+   {
+      counts.sleeping += countQueue(timerWheel[slot]);
+   }
+
+   return counts;
+}
+
+void Scheduler::deleteThreads(ThreadQueue& queue)
+{
+   Thread* thread = queue.head;
+   while(thread != NULL)
    {
-      delete finishedThreads.front();
-      finishedThreads.pop();
+      Thread* nextThread = thread->nextScheduled;
+      TRACE("Deleting thread %d", thread->getId());
+      delete thread;
+      thread = nextThread;
    }
 
-   // Delete all the threads waiting to be destroyed.
-   while(!deletedThreads.empty())
+   queue.head = queue.tail = NULL;
+}
+
+Scheduler::~Scheduler()
+{
+   for(std::vector<ConditionWait>::iterator iter = conditionWaits.begin(); iter != conditionWaits.end(); ++iter)
+   {
+      delete iter->condition;
+   }
+
+   deleteSequences(sequences);
+   deleteSequences(startingSequences);
+
+   // Delete all the threads, in every state
+   deleteThreads(waitingThreads);
+   deleteThreads(suspendedThreads);
+   deleteThreads(unstartedThreads);
+   for(int priority = 0; priority < Thread::NUM_PRIORITIES; ++priority)
+   {
+      deleteThreads(readyThreads[priority]);
+   }
+
+   deleteThreads(finishedThreads);
+
+   for(int slot = 0; slot < WHEEL_LEVELS * WHEEL_SLOTS; ++slot)
    {
-      delete deletedThreads.front();
-      deletedThreads.pop();
+      deleteThreads(timerWheel[slot]);
    }
 }
@@ -7,14 +7,15 @@
 #ifndef SCRIPT_SCHEDULER_H
 #define SCRIPT_SCHEDULER_H
 
-#include "TaskId.h"
-
-#include <map>
-#include <set>
-#include <queue>
+#include "SchedulerProfiler.h"
+#include "Thread.h"
+#include "SDL_stdinc.h"
+#include <cstddef>
+#include <vector>
 
+class Sequence;
 class Task;
-class Thread;
+class WaitCondition;
 
 /**
  * A scheduler for scheduling, resuming and blocking a set of Threads.
@@ -24,44 +25,210 @@ class Thread;
  * Objects that work with the threads can request that the scheduler block them
  * until completion of a task or until another Thread has completed execution.
  *
+ * The scheduler's queues are linked through the threads themselves, and each thread holds its own
+ * place in the scheduler, so starting, blocking, joining and readying a thread never allocates or searches.
+ * Ready threads are resumed in the order that they became ready.
+ *
+ * Threads that sleep for a while are parked in a hierarchical timer wheel instead of being resumed to count down.
+ * Each level of the wheel has WHEEL_SLOTS slots, with each slot of a level covering as much time as the whole
+ * level below it. A sleeping thread is put in the lowest level that reaches its wake time, and is moved down
+ * a level each time the wheel turns past the slot it is in, until it is woken up out of the lowest level.
+ * Parking and waking a thread takes constant time, and nothing is done for a sleeping thread on the runs in between.
+ *
+ * Each run is given a time budget. Once the budget is used up, the run ends, and the threads that didn't
+ * get a turn go first in the next run (along with the time they missed). Threads that are preempted
+ * in the middle of their work (see Thread::preempted) get further turns, in rotation, while there is budget left.
+ *
+ * Ready threads are kept in a queue for each priority class (see Thread::Priority), and the classes take their
+ * turns in order, so the budget goes to the threads that the player is waiting on before the ambient ones.
+ * When a run is short of time, the ambient threads are the first to be put off (and so run less often, with
+ * the time they missed handed to them when they do), and critical threads get their turns whatever the budget.
+ *
+ * Threads can also wait on a condition (such as an actor finishing its orders) that the scheduler tests in C++
+ * at the start of each run, so that a thread waiting for something to happen costs no script work until it happens.
+ *
+ * The scheduler also steps the engine's own sequences (see Sequence) at the start of each run, before any of its threads.
+ *
+ * The scheduler's profiler can record how long each resume takes and why each thread stops running (see SchedulerProfiler).
+ *
  * @author Noam Chitayat
  */
 class Scheduler
 {
-   /** A list of threads. */
-   typedef std::set<Thread*> ThreadList;
+   /** A thread waiting on a condition. */
+   struct ConditionWait
+   {
+      /** The condition, which belongs to the scheduler. */
+      WaitCondition* condition;
 
-   /** A queue of threads. */
-   typedef std::queue<Thread*> ThreadQueue;
+      /** The task that the thread is blocked on until the condition is met. */
+      Task* task;
+   };
 
-   /** A list of blocked threads, indexed by the TaskId on which they are waiting */
-   typedef std::map<TaskId, Thread*> BlockList;
+   /** The threads waiting on conditions. */
+   std::vector<ConditionWait> conditionWaits;
 
-   /** A list of joining/waiting threads, indexed by the Thread on which they are waiting */
-   typedef std::map<Thread*, Thread*> JoinList;
+   /** A queue of threads, linked through the threads' previousScheduled and nextScheduled pointers. */
+   struct ThreadQueue
+   {
+      /** The first thread in the queue, or NULL if the queue is empty. */
+      Thread* head;
 
+      /** The last thread in the queue, or NULL if the queue is empty. */
+      Thread* tail;
 
-   /** The list of currently blocked threads in this scheduler */
-   BlockList blockedThreads;
+      ThreadQueue() : head(NULL), tail(NULL) {}
+   };
 
-   /** The list of currently joining/waiting threads in this scheduler */
-   JoinList joiningThreads;
+   /** The threads that are started or unblocked, to be added to the ready queue in the next run. */
+   ThreadQueue unstartedThreads;
 
-   /** The list of newly readied threads to be added to the ready list in the next run. */
-   ThreadList unstartedThreads;
+   /** The ready threads to be resumed during the next run, in a queue for each priority class. */
+   ThreadQueue readyThreads[Thread::NUM_PRIORITIES];
 
-   /** The list of ready threads to be resumed during the next run. */
-   ThreadList readyThreads;
+   /** The threads that are blocked on a task, or waiting for another thread to finish. */
+   ThreadQueue waitingThreads;
 
-   /** A list of threads to remove from the ready list after a run. */
+   /** The threads that have nothing to do until they are woken up. */
+   ThreadQueue suspendedThreads;
+
+   /** The threads that are done, and are deleted after a run. */
    ThreadQueue finishedThreads;
 
-   /** A list of threads to delete after a run. */
-   ThreadQueue deletedThreads;
+   /** A list of sequences, linked through the sequences' nextSequence pointers. */
+   struct SequenceList
+   {
+      /** The first sequence in the list, or NULL if the list is empty. */
+      Sequence* head;
+
+      /** The last sequence in the list, or NULL if the list is empty. */
+      Sequence* tail;
+
+      SequenceList() : head(NULL), tail(NULL) {}
+   };
+
+   /** The sequences that are stepped on each run, in the order they were started. */
+   SequenceList sequences;
+
+   /** The sequences that were started since the last run, which join the others at the start of the next run. */
+   SequenceList startingSequences;
 
    /** The currently running thread */
    Thread* runningThread;
 
+   /** The profiler that records the threads' resumes, when it is enabled. */
+   SchedulerProfiler profiler;
+
+   /** The amount of time (in milliseconds) that a run can take before the threads that haven't had a turn are left for the next run, or 0 for no limit. */
+   long runBudget;
+
+   /** The number of bits of the wake time that pick a thread's slot in a level of the timer wheel. */
+   static const int WHEEL_SLOT_BITS = 6;
+
+   /** The number of slots in each level of the timer wheel. */
+   static const int WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS;
+
+   /** The number of levels in the timer wheel. */
+   static const int WHEEL_LEVELS = 4;
+
+   /** The sleeping threads, in a slot for each millisecond of the lowest level, then a slot for each span of each higher level. */
+   ThreadQueue timerWheel[WHEEL_LEVELS * WHEEL_SLOTS];
+
+   /** The time (in milliseconds) that the timer wheel has turned to, counted from the creation of the scheduler. */
+   unsigned long wheelTime;
+
+   /**
+    * @param state A thread's schedule state.
+    * @param priority The thread's priority class.
+    *
+    * @return The queue that threads in the state are kept in, or NULL if they aren't kept in one.
+    */
+   ThreadQueue* getQueue(Thread::ScheduleState state, Thread::Priority priority);
+
+   /**
+    * @param runStartTime The time that the run started at (in SDL ticks).
+    *
+    * @return true iff the run has used up its budget.
+    */
+   bool isOverBudget(Uint32 runStartTime) const;
+
+   /**
+    * Gives each thread of a ready queue a turn, in order, until the run's budget is used up.
+    * The threads that don't get a turn are given the time that they missed, and the queue is rotated
+    * so that they go first in the next run.
+    *
+    * @param queue The ready queue of a priority class.
+    * @param timePassed The amount of time that has passed since the last run.
+    * @param runStartTime The time that the run started at (in SDL ticks).
+    * @param budgeted true iff the threads can be put off once the budget is used up.
+    *
+    * @return true iff any of the threads were preempted, and are still ready for another turn.
+    */
+   bool resumeQueue(ThreadQueue& queue, long timePassed, Uint32 runStartTime, bool budgeted);
+
+   /**
+    * Removes a thread from the queue that it is in, if it is in one.
+    *
+    * @param thread The thread to remove.
+    */
+   void unlink(Thread* thread);
+
+   /**
+    * Adds a thread to the back of a queue.
+    *
+    * @param thread The thread to add, which must not be in a queue.
+    * @param queue The queue to add the thread to.
+    */
+   static void append(Thread* thread, ThreadQueue& queue);
+
+   /**
+    * Moves a thread from the queue for its current state to the back of the queue for a new state.
+    *
+    * @param thread The thread to move.
+    * @param state The new state of the thread.
+    */
+   void reschedule(Thread* thread, Thread::ScheduleState state);
+
+   /**
+    * Puts a thread to sleep in the slot of the timer wheel that its wake time falls in.
+    *
+    * @param thread The thread to park, with its wake time set.
+    */
+   void park(Thread* thread);
+
+   /**
+    * Turns the timer wheel forward, waking up the threads whose wake times are passed.
+    *
+    * @param timePassed The amount of time to turn the wheel by.
+    */
+   void turnWheel(long timePassed);
+
+   /**
+    * Tests the conditions that threads are waiting on, and unblocks the threads whose conditions are met.
+    */
+   void testConditions();
+
+   /**
+    * Steps each sequence that isn't waiting, and deletes the sequences that finish.
+    *
+    * @param timePassed The amount of time that has passed since the last run.
+    */
+   void runSequences(long timePassed);
+
+   /**
+    * Deletes every sequence in a list.
+    *
+    * @param list The list of sequences to delete, which is left empty.
+    */
+   static void deleteSequences(SequenceList& list);
+
+   /**
+    * Resumes the running thread, and puts it on the finished queue if it finishes (or fails).
+    *
+    * @param timePassed The amount of time to pass to the thread.
+    */
+   void resumeRunningThread(long timePassed);
+
    /**
     * Signal that a Thread has run to completion so that waiting Threads
     * can be unblocked.
@@ -70,6 +237,20 @@ class Scheduler
     */
    void threadDone(Thread* thread);
 
+   /**
+    * Deletes every thread in a queue.
+    *
+    * @param queue The queue of threads to delete, which is left empty.
+    */
+   static void deleteThreads(ThreadQueue& queue);
+
+   /**
+    * @param queue A queue of threads.
+    *
+    * @return The number of threads in the queue.
+    */
+   static int countQueue(const ThreadQueue& queue);
+
    public:
       /**
        * Constructor. Initializes member variables.
@@ -98,13 +279,37 @@ class Scheduler
        */
       void start(Thread* thread);
 
+      /**
+       * Add a sequence to the scheduler, to be stepped from the next run until it finishes,
+       * after which the scheduler deletes it.
+       *
+       * @param sequence The sequence to start.
+       */
+      void start(Sequence* sequence);
+
+      /**
+       * Set a sequence to wait until a task is finished.
+       *
+       * @param sequence The sequence that waits.
+       * @param task The task upon which the sequence is waiting.
+       */
+      void block(Sequence* sequence, Task* task);
+
+      /**
+       * Set a sequence to wait until a Thread has finished executing.
+       *
+       * @param sequence The sequence that waits.
+       * @param thread The Thread on which the sequence is waiting.
+       */
+      void join(Sequence* sequence, Thread* thread);
+
       /**
        * Signals that an instruction has been completed so that the scheduler
        * can unblock any waiting Threads.
        *
-       * @param finishedTask The ID of the instruction that has been finished.
+       * @param finishedTask The instruction that has been finished.
        */
-      void taskDone(TaskId finishedTask);
+      void taskDone(Task* finishedTask);
 
       /**
        * Block a Thread and make it wait until another Thread has finished
@@ -117,16 +322,89 @@ class Scheduler
        */
       int join(Thread* runningThread);
 
+      /**
+       * Block the running Thread until a condition is met. If the condition is already met,
+       * the thread isn't blocked, and goes on right away.
+       *
+       * @param condition The condition to wait on, which is deleted by the scheduler once it is met.
+       *
+       * @return a yield code from the Thread being blocked (or 0, if it goes on right away)
+       */
+      int waitUntil(WaitCondition* condition);
+
+      /**
+       * Sets the priority class of a Thread, which decides where its turn comes in each run,
+       * and whether its turn can be put off when a run is short of time. Threads start out INTERACTIVE.
+       *
+       * @param thread The thread.
+       * @param priority The thread's new priority class.
+       */
+      void setPriority(Thread* thread, Thread::Priority priority);
+
+      /**
+       * Put the running Thread to sleep for a given amount of time, after which
+       * it is readied again.
+       *
+       * @param time The amount of time to sleep for (in milliseconds).
+       *
+       * @return a yield code from the Thread being put to sleep
+       */
+      int sleep(long time);
+
+      /**
+       * Take the running Thread off the ready queue until it is woken up, so that it
+       * isn't resumed while it has nothing to do. Unlike blocking, the Thread isn't yielded,
+       * so this can be used by Threads that are not in the middle of a script.
+       */
+      void suspend();
+
+      /**
+       * Ready a suspended Thread again, so that it is resumed in the next run.
+       * Threads that aren't suspended are left as they are.
+       *
+       * @param thread The thread to wake up.
+       */
+      void wake(Thread* thread);
+
       /**
        * Signal that a Thread has been finished and destroy the Thread.
        */
       void finished(Thread* thread);
 
       /**
-       * Print the contents of the finished thread list to debug output.
+       * Print the contents of the finished thread queue to debug output.
        */
       void printFinishedQueue();
 
+      /**
+       * @return The profiler that records this scheduler's thread resumes.
+       */
+      SchedulerProfiler& getProfiler();
+
+      /** The number of this scheduler's threads in each schedule state. */
+      struct ThreadCounts
+      {
+         /** Threads that are waiting to be readied at the start of the next run. */
+         int starting;
+         /** Threads that are resumed on each run. */
+         int ready;
+         /** Threads that are blocked on a task, or waiting for another thread to finish. */
+         int waiting;
+         /** Threads that are asleep in the timer wheel. */
+         int sleeping;
+         /** Threads that have nothing to do until something wakes them up. */
+         int suspended;
+         /** Threads that are done, and will be deleted at the end of the run. */
+         int finished;
+      };
+
+      /**
+       * Counts the threads in each of the scheduler's queues.
+       *
+       * @return The number of threads in each schedule state.
+       */
+      ThreadCounts countThreads() const;
+
       /**
        * A scheduler run resumes each Thread in order and allows them to execute
        * until either completion or yielding.
@@ -136,6 +414,14 @@ class Scheduler
        */
       void runThreads(long timePassed);
 
+      /**
+       * Sets the amount of time that each run can take. Threads that don't get a turn
+       * before the budget is used up are resumed first on the next run.
+       *
+       * @param milliseconds The budget for each run (in milliseconds), or 0 for no limit.
+       */
+      void setRunBudget(long milliseconds);
+
       /**
        * Destrutor.
        */
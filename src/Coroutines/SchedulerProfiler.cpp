@@ -0,0 +1,211 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "SchedulerProfiler.h"
+#include "EngineClock.h"
+#include "Thread.h"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_SCHEDULER;
+
+// Enough for several minutes of a busy map at 60 frames per second, without letting a forgotten profile use up memory
+static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+const char* SchedulerProfiler::YIELD_REASON_NAMES[] = { "yield", "preempt", "task", "join", "sleep", "suspend", "finish", "fail" };
+
+SchedulerProfiler::ThreadStats::ThreadStats() : resumeCount(0), totalTime(0), longestTime(0)
+{
+   std::fill(yieldCounts, yieldCounts + NUM_YIELD_REASONS, 0);
+}
+
+SchedulerProfiler::SchedulerProfiler() : enabled(false), enabledTime(0), resumeStartTime(0), pendingReason(YIELDED)
+{
+}
+
+double SchedulerProfiler::getMicroseconds()
+{
+   return EngineClock::getTime();
+}
+
+void SchedulerProfiler::setEnabled(bool enable)
+{
+   if(enable && !enabled)
+   {
+      threadStats.clear();
+      traceEvents.clear();
+      enabledTime = getMicroseconds();
+   }
+
+   enabled = enable;
+}
+
+bool SchedulerProfiler::isEnabled() const
+{
+   return enabled;
+}
+
+void SchedulerProfiler::beginResume()
+{
+   if(!enabled) return;
+
+   pendingReason = YIELDED;
+   resumeStartTime = getMicroseconds();
+}
+
+void SchedulerProfiler::setYieldReason(YieldReason reason)
+{
+   pendingReason = reason;
+}
+
+void SchedulerProfiler::endResume(Thread* thread, bool finished, bool failed)
+{
+   // A resume that began before the profiler was enabled has no start time to measure from
+   if(!enabled || resumeStartTime < enabledTime) return;
+
+   const double duration = getMicroseconds() - resumeStartTime;
+   const YieldReason reason = failed ? FAILED : finished ? FINISHED : pendingReason;
+
+   ThreadStats& stats = threadStats[thread->getId()];
+   if(stats.resumeCount == 0)
+   {
+      stats.name = thread->getName();
+   }
+
+   ++stats.resumeCount;
+   stats.totalTime += duration;
+   stats.longestTime = std::max(stats.longestTime, duration);
+   ++stats.yieldCounts[reason];
+
+   if(traceEvents.size() < MAX_TRACE_EVENTS)
+   {
+      TraceEvent event;
+      event.threadId = thread->getId();
+      event.startTime = resumeStartTime - enabledTime;
+      event.duration = duration;
+      event.reason = reason;
+      traceEvents.push_back(event);
+   }
+}
+
+void SchedulerProfiler::describe(std::vector<std::string>& lines) const
+{
+   std::vector<std::pair<double, int> > threadsByTime;
+   for(std::map<int, ThreadStats>::const_iterator iter = threadStats.begin(); iter != threadStats.end(); ++iter)
+   {
+      threadsByTime.push_back(std::make_pair(iter->second.totalTime, iter->first));
+   }
+
+   std::sort(threadsByTime.begin(), threadsByTime.end(), std::greater<std::pair<double, int> >());
+
+   for(std::vector<std::pair<double, int> >::const_iterator iter = threadsByTime.begin(); iter != threadsByTime.end(); ++iter)
+   {
+      const ThreadStats& stats = threadStats.find(iter->second)->second;
+
+      std::stringstream line;
+      line << std::fixed << std::setprecision(3);
+      line << iter->second << ' ' << stats.name << ": " << stats.resumeCount << " resumes, "
+           << stats.totalTime / 1000.0 << " ms total, "
+           << stats.totalTime / 1000.0 / stats.resumeCount << " ms average, "
+           << stats.longestTime / 1000.0 << " ms longest";
+      lines.push_back(line.str());
+
+      std::stringstream reasons;
+      reasons << "   stopped by";
+      for(int reason = 0; reason < NUM_YIELD_REASONS; ++reason)
+      {
+         if(stats.yieldCounts[reason] > 0)
+         {
+            reasons << ' ' << YIELD_REASON_NAMES[reason] << " x" << stats.yieldCounts[reason];
+         }
+      }
+
+      lines.push_back(reasons.str());
+   }
+
+   if(threadsByTime.empty())
+   {
+      lines.push_back("No threads have been resumed while profiling.");
+   }
+}
+
+/**
+ * Writes a string to a JSON file, with the characters that JSON can't hold as they are escaped.
+ *
+ * @param output The file to write to.
+ * @param value The string to write.
+ */
+static void writeJsonString(std::ofstream& output, const std::string& value)
+{
+   output << '"';
+   for(std::string::const_iterator iter = value.begin(); iter != value.end(); ++iter)
+   {
+      if(*iter == '"' || *iter == '\\')
+      {
+         output << '\\' << *iter;
+      }
+      else if(static_cast<unsigned char>(*iter) < 0x20)
+      {
+         output << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(*iter) << std::dec << std::setfill(' ');
+      }
+      else
+      {
+         output << *iter;
+      }
+   }
+
+   output << '"';
+}
+
+bool SchedulerProfiler::writeChromeTrace(const std::string& path) const
+{
+   std::ofstream output(path.c_str(), std::ios::out | std::ios::trunc);
+   if(!output)
+   {
+      DEBUG("Unable to write scheduler trace to %s.", path.c_str());
+      return false;
+   }
+
+   output << std::fixed << std::setprecision(3);
+   output << "{\"traceEvents\":[";
+   bool firstEvent = true;
+
+   // Name each thread's track after the thread
+   for(std::map<int, ThreadStats>::const_iterator iter = threadStats.begin(); iter != threadStats.end(); ++iter)
+   {
+      output << (firstEvent ? "\n" : ",\n");
+      output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << iter->first << ",\"args\":{\"name\":";
+      writeJsonString(output, iter->second.name);
+      output << "}}";
+      firstEvent = false;
+   }
+
+   for(std::vector<TraceEvent>::const_iterator iter = traceEvents.begin(); iter != traceEvents.end(); ++iter)
+   {
+      output << (firstEvent ? "\n" : ",\n");
+      output << "{\"name\":\"resume\",\"cat\":\"scheduler\",\"ph\":\"X\",\"pid\":1,\"tid\":" << iter->threadId
+             << ",\"ts\":" << iter->startTime << ",\"dur\":" << iter->duration
+             << ",\"args\":{\"stop\":\"" << YIELD_REASON_NAMES[iter->reason] << "\"}}";
+      firstEvent = false;
+   }
+
+   output << "\n]}\n";
+
+   if(!output)
+   {
+      DEBUG("Unable to write scheduler trace to %s.", path.c_str());
+      return false;
+   }
+
+   DEBUG("Wrote %d scheduler trace events to %s.", static_cast<int>(traceEvents.size()), path.c_str());
+   return true;
+}
@@ -0,0 +1,174 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SCHEDULER_PROFILER_H
+#define SCHEDULER_PROFILER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+class Thread;
+
+/**
+ * Measures how the scheduler's threads spend their time, so that the thread (or script) eating into the frame can be found.
+ *
+ * While the profiler is enabled, it records each resume of each thread: how long the resume took, and why the thread
+ * stopped running (it yielded, blocked on a task, joined another thread, went to sleep, was suspended, or finished).
+ * The totals for each thread can be listed (such as in the debug console), and the resumes themselves can be written
+ * out as a Chrome trace (which can be opened in chrome://tracing) to see how they line up over time.
+ *
+ * A disabled profiler costs nothing but a check of whether or not it is enabled at each resume.
+ */
+class SchedulerProfiler
+{
+   public:
+      /** The reasons that a thread can stop running at the end of a resume. */
+      enum YieldReason
+      {
+         /** The thread yielded, and will be resumed again on the next run. */
+         YIELDED,
+         /** The thread ran for too long, and was stopped to let the other threads run. */
+         PREEMPTED,
+         /** The thread blocked on a task. */
+         BLOCKED_ON_TASK,
+         /** The thread joined another thread, and waits for it to finish. */
+         JOINED,
+         /** The thread went to sleep for a while. */
+         SLEEPING,
+         /** The thread was suspended until something wakes it up. */
+         SUSPENDED,
+         /** The thread ran to completion. */
+         FINISHED,
+         /** The thread failed with an exception. */
+         FAILED,
+         /** The number of YieldReason values. */
+         NUM_YIELD_REASONS
+      };
+
+   private:
+      /** The names of the yield reasons, in the same order as the YieldReason enum. */
+      static const char* YIELD_REASON_NAMES[];
+
+      /** The totals recorded for one thread. */
+      struct ThreadStats
+      {
+         /** The name of the thread. */
+         std::string name;
+
+         /** The number of times that the thread was resumed. */
+         unsigned long resumeCount;
+
+         /** The total time spent in the thread's resumes (in microseconds). */
+         double totalTime;
+
+         /** The time taken by the thread's longest resume (in microseconds). */
+         double longestTime;
+
+         /** The number of resumes that ended for each reason, indexed by YieldReason. */
+         unsigned long yieldCounts[NUM_YIELD_REASONS];
+
+         ThreadStats();
+      };
+
+      /** A single resume of a thread, as it appears in the trace. */
+      struct TraceEvent
+      {
+         /** The ID of the resumed thread. */
+         int threadId;
+
+         /** When the resume started (in microseconds since the profiler was enabled). */
+         double startTime;
+
+         /** How long the resume took (in microseconds). */
+         double duration;
+
+         /** Why the thread stopped running. */
+         YieldReason reason;
+      };
+
+      /** Whether or not resumes are being recorded. */
+      bool enabled;
+
+      /** The time at which the profiler was enabled (in microseconds, measured from an arbitrary point). */
+      double enabledTime;
+
+      /** The time at which the current resume started (in microseconds, measured from an arbitrary point). */
+      double resumeStartTime;
+
+      /** The reason that the current resume will end with, if the thread stops running before it returns. */
+      YieldReason pendingReason;
+
+      /** The totals for each thread that has been resumed while profiling, by thread ID. */
+      std::map<int, ThreadStats> threadStats;
+
+      /** The recorded resumes, in the order that they finished. */
+      std::vector<TraceEvent> traceEvents;
+
+      /**
+       * @return The current time (in microseconds), measured from an arbitrary point.
+       */
+      static double getMicroseconds();
+
+   public:
+      /**
+       * Constructor. The profiler starts out disabled.
+       */
+      SchedulerProfiler();
+
+      /**
+       * Starts or stops recording resumes. Enabling the profiler clears what was recorded before.
+       *
+       * @param enable true to start recording, false to stop.
+       */
+      void setEnabled(bool enable);
+
+      /**
+       * @return true iff resumes are being recorded.
+       */
+      bool isEnabled() const;
+
+      /**
+       * Marks the start of a thread's resume.
+       */
+      void beginResume();
+
+      /**
+       * Records why the running thread is about to stop running, for when it blocks, joins, sleeps or is suspended
+       * from inside its resume.
+       *
+       * @param reason The reason that the thread stops running.
+       */
+      void setYieldReason(YieldReason reason);
+
+      /**
+       * Marks the end of a thread's resume, and records it.
+       *
+       * @param thread The thread that was resumed.
+       * @param finished true iff the thread ran to completion.
+       * @param failed true iff the thread failed with an exception.
+       */
+      void endResume(Thread* thread, bool finished, bool failed);
+
+      /**
+       * Describes the totals for each thread, busiest thread first.
+       *
+       * @param lines The list to add the lines of the description to.
+       */
+      void describe(std::vector<std::string>& lines) const;
+
+      /**
+       * Writes the recorded resumes out as a Chrome trace (in the Trace Event JSON format),
+       * with each thread on its own track.
+       *
+       * @param path The path of the file to write.
+       *
+       * @return true iff the trace was written.
+       */
+      bool writeChromeTrace(const std::string& path) const;
+};
+
+#endif
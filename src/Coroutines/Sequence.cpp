@@ -0,0 +1,70 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Sequence.h"
+#include "Scheduler.h"
+#include "ObjectPool.h"
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_SCHEDULER;
+
+Sequence::Sequence() : scheduler(NULL), nextSequence(NULL), sleepTime(0), waiting(false), resumePoint(0)
+{
+}
+
+bool Sequence::resume(long timePassed)
+{
+   if(waiting) return false;
+
+   if(sleepTime > 0)
+   {
+      sleepTime -= timePassed;
+      if(sleepTime > 0) return false;
+   }
+
+   return step(timePassed);
+}
+
+Scheduler& Sequence::getScheduler()
+{
+   return *scheduler;
+}
+
+void Sequence::sleep(long time)
+{
+   sleepTime = time;
+}
+
+void Sequence::await(Task* task)
+{
+   scheduler->block(this, task);
+}
+
+void Sequence::join(Thread* thread)
+{
+   scheduler->join(this, thread);
+}
+
+ObjectPool& Sequence::getPool()
+{
+   // Never destroyed, like the pool of tasks, so that a sequence deleted while the game shuts down still has a pool to go back to
+   static ObjectPool* pool = new ObjectPool("sequences", POOLED_SIZE);
+   return *pool;
+}
+
+void* Sequence::operator new(size_t size)
+{
+   return getPool().allocate(size);
+}
+
+void Sequence::operator delete(void* block, size_t size)
+{
+   getPool().release(block, size);
+}
+
+Sequence::~Sequence()
+{
+}
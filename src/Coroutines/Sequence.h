@@ -0,0 +1,157 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include <cstddef>
+
+class Scheduler;
+class Task;
+class Thread;
+class ObjectPool;
+
+/**
+ * Starts the body of a sequence's step. Everything from here to SEQUENCE_END is the sequence's code,
+ * which picks up where it waited the last time it was stepped.
+ */
+#define SEQUENCE_BEGIN() switch(resumePoint) { case 0:
+
+/**
+ * Waits for something (given as a call that sets up the wait), then goes on from the same spot.
+ * Each wait has to be on a line of its own, since the line number marks the spot to go on from.
+ */
+#define SEQUENCE_WAIT(wait) do { wait; resumePoint = __LINE__; return false; case __LINE__:; } while(0)
+
+/** Waits for the next frame. */
+#define SEQUENCE_YIELD() SEQUENCE_WAIT((void)0)
+
+/** Waits for an amount of time (in milliseconds). */
+#define SEQUENCE_SLEEP(time) SEQUENCE_WAIT(sleep(time))
+
+/** Waits for a task to be signalled. */
+#define SEQUENCE_AWAIT(task) SEQUENCE_WAIT(await(task))
+
+/** Waits for a thread (such as a script) to finish. */
+#define SEQUENCE_JOIN(thread) SEQUENCE_WAIT(join(thread))
+
+/** Ends the body of a sequence's step, finishing the sequence if its code runs off the end. */
+#define SEQUENCE_END() } resumePoint = -1; return true
+
+/**
+ * A sequence is engine code that plays out over many frames (such as revealing a line of dialogue),
+ * written as straight-line code that waits for frames, timers, tasks and threads in between its steps,
+ * instead of as a state machine or a Thread of its own.
+ *
+ * Sequences are stackless coroutines: a sequence's step function is written between SEQUENCE_BEGIN and SEQUENCE_END,
+ * and each wait (SEQUENCE_YIELD, SEQUENCE_SLEEP, SEQUENCE_AWAIT or SEQUENCE_JOIN) returns from the step, noting where to go on from
+ * the next time the sequence is stepped. Since the step returns at each wait, local variables don't last across waits,
+ * so anything that a sequence needs after a wait is kept in the sequence's members. The waits can't be put inside
+ * a switch statement of the sequence's own.
+ *
+ * The scheduler steps its sequences at the start of each run, before its threads, whatever the run's budget,
+ * so a sequence's waits end on the frame that they are due. Sequences are small and short-lived,
+ * so they are allocated from a shared pool (see ObjectPool), as long as they fit in its blocks.
+ */
+class Sequence
+{
+   friend class Scheduler;
+
+   /** The size (in bytes) of the pool's blocks; larger sequences are allocated from the heap. */
+   static const size_t POOLED_SIZE = 128;
+
+   /** The scheduler that steps the sequence, or NULL if it hasn't been started. */
+   Scheduler* scheduler;
+
+   /** The next sequence in the scheduler's list, or NULL if this is the last one. */
+   Sequence* nextSequence;
+
+   /** The time (in milliseconds) left before the sequence wakes up, if it is asleep. */
+   long sleepTime;
+
+   /** true iff the sequence is waiting for a task or a thread. */
+   bool waiting;
+
+   /** @return The pool that sequences are allocated from. */
+   static ObjectPool& getPool();
+
+   /**
+    * Steps the sequence, unless it is still waiting.
+    *
+    * @param timePassed The amount of time that has passed since the last run.
+    *
+    * @return true iff the sequence is finished.
+    */
+   bool resume(long timePassed);
+
+   /**
+    * Sequences can't be copied.
+    */
+   Sequence(const Sequence&);
+
+   /**
+    * Sequences can't be copied.
+    */
+   Sequence& operator=(const Sequence&);
+
+   protected:
+      /** The line of the wait that the sequence goes on from, 0 before it is first stepped, or -1 once it is finished. */
+      int resumePoint;
+
+      /**
+       * @return The scheduler that steps the sequence.
+       */
+      Scheduler& getScheduler();
+
+      /**
+       * Sets the sequence to sleep for an amount of time. Use SEQUENCE_SLEEP instead.
+       *
+       * @param time The amount of time to sleep for (in milliseconds).
+       */
+      void sleep(long time);
+
+      /**
+       * Sets the sequence to wait for a task, which must not have been signalled yet. Use SEQUENCE_AWAIT instead.
+       *
+       * @param task The task to wait for.
+       */
+      void await(Task* task);
+
+      /**
+       * Sets the sequence to wait for a thread of the same scheduler to finish. Use SEQUENCE_JOIN instead.
+       *
+       * @param thread The thread to wait for.
+       */
+      void join(Thread* thread);
+
+      /**
+       * Runs the sequence up to its next wait.
+       *
+       * @param timePassed The amount of time that has passed since the last run.
+       *
+       * @return true iff the sequence is finished.
+       */
+      virtual bool step(long timePassed) = 0;
+
+   public:
+      /**
+       * Constructor.
+       */
+      Sequence();
+
+      /** Allocates the sequence from the pool of sequences. */
+      static void* operator new(size_t size);
+
+      /** Hands the sequence's memory back to the pool of sequences. */
+      static void operator delete(void* block, size_t size);
+
+      /**
+       * Destructor.
+       */
+      virtual ~Sequence();
+};
+
+#endif
@@ -6,6 +6,7 @@
 
 #include "Task.h"
 #include "Scheduler.h"
+#include "ObjectPool.h"
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_SCHEDULER;
@@ -19,7 +20,7 @@ Task* Task::getNextTask(Scheduler& scheduler)
 }
 
 Task::Task(TaskId taskId, Scheduler& scheduler)
-                      : id(taskId), scheduler(scheduler)
+                      : id(taskId), scheduler(scheduler), blockedThread(NULL), blockedSequence(NULL)
 {}
 
 TaskId Task::getTaskId()
@@ -29,10 +30,27 @@ TaskId Task::getTaskId()
 
 void Task::signal()
 {
-   scheduler.taskDone(id);
+   scheduler.taskDone(this);
    delete this;
 }
 
 Task::~Task()
 {
 }
+
+ObjectPool& Task::getPool()
+{
+   // Never destroyed, so that a task signalled while the game shuts down still has a pool to go back to
+   static ObjectPool* pool = new ObjectPool("tasks", sizeof(Task));
+   return *pool;
+}
+
+void* Task::operator new(size_t size)
+{
+   return getPool().allocate(size);
+}
+
+void Task::operator delete(void* block, size_t size)
+{
+   getPool().release(block, size);
+}
@@ -8,24 +8,40 @@
 #define TASK_H
 
 #include "TaskId.h"
+#include <cstddef>
 
 class Scheduler;
+class Thread;
+class Sequence;
+class ObjectPool;
 
 /**
  * A Task is a ticket container for engine instructions that occur across
  * many frames of logic. These tasks are handed to the Scheduler, which blocks
  * Threads waiting on the instruction and resumes them when the instruction is finished.
  *
+ * Scripts start tasks all the time (for every line of dialogue and every sound they wait on),
+ * so tasks are allocated from a pool instead of the heap.
+ *
  * @author Noam Chitayat
  */
 class Task
 {
+   /** The scheduler records the thread blocked on a task in the task itself. */
+   friend class Scheduler;
+
    /** The unique identifier for this task */
    TaskId id;
    
    /** The scheduler to signal when this task is finished */
    Scheduler& scheduler;
 
+   /** The thread blocked on this task, or NULL if there isn't one */
+   Thread* blockedThread;
+
+   /** The sequence waiting on this task, or NULL if there isn't one */
+   Sequence* blockedSequence;
+
    /**
     *  Constructor. Assigns a new task ID and associates a Scheduler with the
     *  Task.
@@ -41,6 +57,15 @@ class Task
     */
    ~Task();
 
+   /** @return The pool that tasks are allocated from. */
+   static ObjectPool& getPool();
+
+   /** Allocates the task from the pool of tasks. */
+   static void* operator new(size_t size);
+
+   /** Hands the task's memory back to the pool of tasks. */
+   static void operator delete(void* block, size_t size);
+
    public:
       /**
        *  Create and return a new task.
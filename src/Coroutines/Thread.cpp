@@ -5,10 +5,12 @@
  */
 
 #include "Thread.h"
+#include <cstddef>
+#include <sstream>
 
 int Thread::nextThreadId = 0;
 
-Thread::Thread()
+Thread::Thread() : scheduleState(UNSCHEDULED), previousScheduled(NULL), nextScheduled(NULL), joiningThread(NULL), joiningSequence(NULL), wakeTime(0), wheelSlot(0), missedTime(0), priority(INTERACTIVE), preempted(false)
 {
    threadId = nextThreadId++;
 }
@@ -18,6 +20,18 @@ int Thread::getId()
    return threadId;
 }
 
+Thread::Priority Thread::getPriority() const
+{
+   return priority;
+}
+
+std::string Thread::getName()
+{
+   std::stringstream name;
+   name << "Thread " << threadId;
+   return name.str();
+}
+
 int Thread::yield()
 {
    return 0;
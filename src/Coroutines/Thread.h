@@ -7,6 +7,10 @@
 #ifndef THREAD_H
 #define THREAD_H
 
+#include <string>
+
+class Sequence;
+
 /**
  * A Thread is, in this case, an object that can yield, resume or block.
  * The typical scenario for a Thread object is a resumption (with the amount of
@@ -20,15 +24,89 @@
  */
 class Thread
 {
+   /** The scheduler keeps its threads in queues linked through the threads themselves. */
+   friend class Scheduler;
+
    /** 
     * The next available thread ID to use for constructing a thread.
     */
    static int nextThreadId;
 
+   /** Where a thread is in its scheduler, which also tells which of the scheduler's queues it is in. */
+   enum ScheduleState
+   {
+      /** The thread hasn't been started. */
+      UNSCHEDULED,
+      /** The thread is waiting to join the ready threads at the start of the next run. */
+      STARTING,
+      /** The thread is resumed on each run. */
+      READY,
+      /** The thread is blocked on a task, or waiting for another thread to finish. */
+      WAITING,
+      /** The thread is asleep in the scheduler's timer wheel until its wake time. */
+      SLEEPING,
+      /** The thread has nothing to do until something wakes it up. */
+      SUSPENDED,
+      /** The thread is done, and will be deleted at the end of the run. */
+      FINISHED
+   };
+
+   /** Where the thread is in its scheduler. */
+   ScheduleState scheduleState;
+
+   /** The thread before this one in its scheduler queue, or NULL if it is first (or not in a queue). */
+   Thread* previousScheduled;
+
+   /** The thread after this one in its scheduler queue, or NULL if it is last (or not in a queue). */
+   Thread* nextScheduled;
+
+   /** The thread waiting for this one to finish, or NULL if there isn't one. */
+   Thread* joiningThread;
+
+   /** The sequence waiting for this thread to finish, or NULL if there isn't one. */
+   Sequence* joiningSequence;
+
+   /** The scheduler time (in milliseconds) at which the thread wakes up, if it is asleep. */
+   unsigned long wakeTime;
+
+   /** The slot of the scheduler's timer wheel that the thread is in, if it is asleep. */
+   int wheelSlot;
+
+   /** The time that has passed over runs in which the thread didn't get a turn, which it is given at its next resume. */
+   long missedTime;
+
+   public:
+      /**
+       * How urgently a thread needs its turns. The scheduler resumes ready threads one class after another, in this order,
+       * so when a run is short of time, the threads of the lower classes are the ones put off to the next run.
+       */
+      enum Priority
+      {
+         /** The thread's turn can't be put off (such as the dialogue that the player is reading), even once the run's budget is used up. */
+         CRITICAL,
+         /** The thread is part of what the player is waiting on (such as a cutscene's script). */
+         INTERACTIVE,
+         /** The thread only adds life to the scene (such as an NPC wandering around), and can fall behind without the player noticing. */
+         AMBIENT,
+         /** The number of Priority values. */
+         NUM_PRIORITIES
+      };
+
+   private:
+      /** The thread's priority class. */
+      Priority priority;
+
    protected:
       /** The numeric identified of this thread (currently just used for debugging) */
       int threadId;
 
+      /**
+       * True iff the thread's last resume was cut short before it was done with its work for the run
+       * (as opposed to yielding to wait for the next run), in which case the scheduler resumes it again
+       * in the same run if there is time left.
+       */
+      bool preempted;
+
    public:
       
       /**
@@ -41,6 +119,16 @@ class Thread
        */
       int getId();
 
+      /**
+       * @return The thread's priority class (see Scheduler::setPriority).
+       */
+      Priority getPriority() const;
+
+      /**
+       * @return A name for this Thread to show in diagnostics (such as the scheduler's profile).
+       */
+      virtual std::string getName();
+
       /**
        * Resume this Thread, or run through its logic.
        *
@@ -0,0 +1,29 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef WAIT_CONDITION_H
+#define WAIT_CONDITION_H
+
+/**
+ * A condition that a thread can wait on until it is met, such as an actor finishing its orders (see Scheduler::waitUntil).
+ * The scheduler tests the conditions of the waiting threads at the start of each run, so conditions should be cheap to test,
+ * and shouldn't hold on to anything that can go away while they wait (such as an actor, rather than its handle).
+ */
+class WaitCondition
+{
+   public:
+      /**
+       * @return true iff the condition is met, so that the thread waiting on it can go on.
+       */
+      virtual bool isMet() const = 0;
+
+      /**
+       * Destructor.
+       */
+      virtual ~WaitCondition() {}
+};
+
+#endif
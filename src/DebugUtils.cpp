@@ -5,26 +5,331 @@
  */
 
 #include "DebugUtils.h"
+#include "Atomics.h"
+#include <SDL.h>
+#include <SDL_thread.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <sstream>
 
-long DebugUtils::debugFlags = DEBUG_ALL & ~DEBUG_ENTITY_GRID;
+#ifdef _WIN32
+   #include <windows.h>
+   #define vsnprintf _vsnprintf
+#endif
 
-void DebugUtils::print(long flag, std::string str)
+// The number of records in the ring, which must be a power of two.
+// Room for a burst of messages (such as a trace of a whole path search) between the log thread's writes
+static const unsigned long RING_SIZE = 1 << 11;
+
+// Enough for any line of the log; longer messages are cut short
+static const size_t MAX_MESSAGE_LENGTH = 256;
+
+// Often enough that the log keeps up with the game, without waking the log thread up for nothing
+static const Uint32 FLUSH_INTERVAL = 10;
+
+// The names of the levels, in the same order as the Level enum
+static const char* LEVEL_NAMES[] = { "error", "warning", "info", "trace" };
+
+// The names of the categories, in the same order as the bits of the debug flags
+static const char* CATEGORY_NAMES[] = { "main", "exec_stack", "game_state", "graphics", "edwt", "title", "tile_engine", "menu",
+      "battle", "overworld", "dialogue", "resources", "script", "audio", "scheduler", "npc", "pathfinder", "sprite", "player",
+      "entity_grid" };
+
+static const int CATEGORY_COUNT = sizeof(CATEGORY_NAMES) / sizeof(CATEGORY_NAMES[0]);
+
+#ifdef DEBUG_MODE
+// Debug builds log everything but the entity grid (which logs every tile occupied and freed) out of the box
+long DebugUtils::levelFlags[] = { DEBUG_ALL, DEBUG_ALL, DEBUG_ALL & ~(DEBUG_ENTITY_GRID), 0 };
+#else
+// Other builds only log what goes wrong, unless they are told to log more
+long DebugUtils::levelFlags[] = { DEBUG_ALL, DEBUG_ALL, 0, 0 };
+#endif
+
+/** A message in the ring, waiting to be written out by the log thread. */
+struct LogRecord
+{
+   /**
+    * The position in the log that the record can be claimed at, or that position plus one once the message in it
+    * is ready to be written out. Writing the message out frees the record for the position a lap of the ring later.
+    */
+   volatile unsigned long sequence;
+
+   /** The category of the message. */
+   long flag;
+
+   /** The level of the message. */
+   DebugUtils::Level level;
+
+   /** When the message was logged (in milliseconds since SDL was started). */
+   Uint32 time;
+
+   /** The text of the message. */
+   char text[MAX_MESSAGE_LENGTH];
+};
+
+/** The ring of messages waiting to be written out. */
+static LogRecord ring[RING_SIZE];
+
+/** The position in the log that the next message will be claimed at. */
+static volatile unsigned long writePosition = 0;
+
+/** The position in the log of the next message to write out (only touched by the log thread). */
+static unsigned long readPosition = 0;
+
+/** The number of messages that have been dropped because the ring was full. */
+static volatile unsigned long droppedCount = 0;
+
+/** The number of dropped messages that have been reported in the log. */
+static unsigned long reportedDroppedCount = 0;
+
+/** The thread that writes out the log, or NULL if messages are written straight to the error log. */
+static SDL_Thread* logThread = NULL;
+
+/** Whether or not messages are being put in the ring for the log thread. */
+static volatile bool logThreadRunning = false;
+
+/** Whether or not the log thread has been asked to stop. */
+static volatile bool logThreadStopping = false;
+
+/**
+ * @param flag The debug flag of a category.
+ *
+ * @return The name of the category.
+ */
+static const char* getCategoryName(long flag)
+{
+   for(int i = 0; i < CATEGORY_COUNT; ++i)
+   {
+      if(flag & (1L << i)) return CATEGORY_NAMES[i];
+   }
+
+   return "unknown";
+}
+
+/**
+ * Writes a line of the log out to the error log.
+ *
+ * @param time When the message was logged (in milliseconds since SDL was started).
+ * @param flag The category of the message.
+ * @param level The level of the message.
+ * @param text The text of the message.
+ */
+static void writeLine(Uint32 time, long flag, DebugUtils::Level level, const char* text)
+{
+   fprintf(stderr, "[%6u.%03u] %-7s %-11s %s\n", static_cast<unsigned int>(time / 1000), static_cast<unsigned int>(time % 1000),
+         LEVEL_NAMES[level], getCategoryName(flag), text);
+}
+
+/**
+ * Claims the record for the next position in the log.
+ *
+ * @param position The parameter used to return the claimed position.
+ *
+ * @return The claimed record, or NULL if the ring is full.
+ */
+static LogRecord* claimRecord(unsigned long& position)
+{
+   position = writePosition;
+   for(;;)
+   {
+      LogRecord& record = ring[position & (RING_SIZE - 1)];
+      const long lap = static_cast<long>(record.sequence - position);
+      if(lap == 0)
+      {
+         if(Atomics::compareAndSwap(&writePosition, position, position + 1))
+         {
+            return &record;
+         }
+      }
+      else if(lap < 0)
+      {
+         // The record still holds the message from a lap ago, which hasn't been written out yet
+         return NULL;
+      }
+
+      position = writePosition;
+   }
+}
+
+/**
+ * Writes out the messages that are ready in the ring, in the order they were claimed, and reports any that were dropped.
+ * Only the log thread (or the thread that stopped it) does this.
+ */
+static void flushRing()
+{
+   for(;;)
+   {
+      LogRecord& record = ring[readPosition & (RING_SIZE - 1)];
+      if(record.sequence != readPosition + 1) break;
+
+      Atomics::memoryBarrier();
+      writeLine(record.time, record.flag, record.level, record.text);
+      Atomics::memoryBarrier();
+
+      record.sequence = readPosition + RING_SIZE;
+      ++readPosition;
+   }
+
+   const unsigned long dropped = droppedCount;
+   if(dropped != reportedDroppedCount)
+   {
+      fprintf(stderr, "%lu log messages were dropped because the log couldn't keep up.\n", dropped - reportedDroppedCount);
+      reportedDroppedCount = dropped;
+   }
+
+   fflush(stderr);
+}
+
+/**
+ * Writes out the log every so often, until asked to stop.
+ *
+ * @param data Unused.
+ *
+ * @return 0.
+ */
+static int runLogThread(void* /*data*/)
+{
+   while(!logThreadStopping)
+   {
+      flushRing();
+      SDL_Delay(FLUSH_INTERVAL);
+   }
+
+   flushRing();
+   return 0;
+}
+
+void DebugUtils::setLevel(Level level, long flags)
 {
-   if(debugFlags & flag) fprintf(stderr, "%s", str.c_str());
+   for(int i = 0; i < NUM_LEVELS; ++i)
+   {
+      if(i <= level) levelFlags[i] |= flags;
+      else levelFlags[i] &= ~flags;
+   }
 }
 
-void DebugUtils::print(long flag, const char* fmt, ...)
+bool DebugUtils::configure(const std::string& config)
 {
-   if(debugFlags & flag)
+   const std::string::size_type separator = config.find(':');
+   const std::string levelName = config.substr(0, separator);
+
+   int level = 0;
+   while(level < NUM_LEVELS && levelName != LEVEL_NAMES[level])
+   {
+      ++level;
+   }
+
+   if(level == NUM_LEVELS) return false;
+
+   long flags = 0;
+   if(separator == std::string::npos)
    {
-      va_list argp;
-      va_start(argp, fmt);
-      vfprintf(stderr, fmt, argp);
-      fprintf(stderr, "\n");
-      va_end(argp);
+      flags = DEBUG_ALL;
    }
+   else
+   {
+      std::stringstream categories(config.substr(separator + 1));
+      std::string categoryName;
+      while(std::getline(categories, categoryName, ','))
+      {
+         int category = 0;
+         while(category < CATEGORY_COUNT && categoryName != CATEGORY_NAMES[category])
+         {
+            ++category;
+         }
+
+         if(category == CATEGORY_COUNT) return false;
+         flags |= 1L << category;
+      }
+   }
+
+   setLevel(static_cast<Level>(level), flags);
+   return true;
+}
+
+void DebugUtils::log(long flag, Level level, const std::string& str)
+{
+   log(flag, level, "%s", str.c_str());
+}
+
+void DebugUtils::log(long flag, Level level, const char* fmt, ...)
+{
+   if(!isLogging(flag, level)) return;
+
+   va_list argp;
+   va_start(argp, fmt);
+
+   unsigned long position;
+   LogRecord* record = logThreadRunning ? claimRecord(position) : NULL;
+   if(record != NULL)
+   {
+      vsnprintf(record->text, MAX_MESSAGE_LENGTH, fmt, argp);
+      record->text[MAX_MESSAGE_LENGTH - 1] = '\0';
+      record->flag = flag;
+      record->level = level;
+      record->time = SDL_GetTicks();
+
+      // The message has to be in the record before the log thread can see that it is ready
+      Atomics::memoryBarrier();
+      record->sequence = position + 1;
+   }
+   else if(logThreadRunning)
+   {
+      Atomics::increment(&droppedCount);
+   }
+   else
+   {
+      char text[MAX_MESSAGE_LENGTH];
+      vsnprintf(text, MAX_MESSAGE_LENGTH, fmt, argp);
+      text[MAX_MESSAGE_LENGTH - 1] = '\0';
+      writeLine(SDL_GetTicks(), flag, level, text);
+   }
+
+   va_end(argp);
+}
+
+void DebugUtils::startLogThread()
+{
+   if(logThread != NULL) return;
+
+   for(unsigned long i = 0; i < RING_SIZE; ++i)
+   {
+      ring[i].sequence = i;
+   }
+
+   writePosition = readPosition = 0;
+   logThreadStopping = false;
+
+   logThread = SDL_CreateThread(runLogThread, NULL);
+   if(logThread == NULL)
+   {
+      fprintf(stderr, "Unable to start the log thread: %s\n", SDL_GetError());
+      return;
+   }
+
+   logThreadRunning = true;
+
+   static bool stopRegistered = false;
+   if(!stopRegistered)
+   {
+      atexit(stopLogThread);
+      stopRegistered = true;
+   }
+}
+
+void DebugUtils::stopLogThread()
+{
+   if(logThread == NULL) return;
+
+   // Messages logged from here on go straight to the error log, while the log thread writes out the ring
+   logThreadRunning = false;
+   logThreadStopping = true;
+   SDL_WaitThread(logThread, NULL);
+   logThread = NULL;
+
+   // Pick up anything that was claimed just before the log thread was asked to stop
+   flushRing();
 }
 
 void DebugUtils::pause()
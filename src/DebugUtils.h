@@ -10,12 +10,22 @@
 #include <string>
 #include "Exception.h"
 
-// Make a nice easy access macro for debug statements in the code
+// Make nice easy access macros for log statements in the code.
+// A message whose category and level aren't being logged costs one check of a flag, and its arguments aren't evaluated.
+#if defined(DEBUG_MODE) || defined(EDEN_LOGGING)
+   #define LOG(level, x, ...) do { if(DebugUtils::isLogging(debugFlag, level)) DebugUtils::log(debugFlag, level, x, ## __VA_ARGS__); } while(false)
+#else
+   #define LOG(level, x, ...) do {} while(false)
+#endif
+
+#define LOG_ERROR(x, ...) LOG(DebugUtils::LEVEL_ERROR, x, ## __VA_ARGS__)
+#define LOG_WARNING(x, ...) LOG(DebugUtils::LEVEL_WARNING, x, ## __VA_ARGS__)
+#define DEBUG(x, ...) LOG(DebugUtils::LEVEL_INFO, x, ## __VA_ARGS__)
+#define TRACE(x, ...) LOG(DebugUtils::LEVEL_TRACE, x, ## __VA_ARGS__)
+
 #ifdef DEBUG_MODE
-   #define DEBUG(x, ...) DebugUtils::print(debugFlag, x, ## __VA_ARGS__)
    #define DEBUG_PAUSE DebugUtils::pause();
 #else
-   #define DEBUG(x, ...)
    #define DEBUG_PAUSE
 #endif
 
@@ -54,37 +64,101 @@
 
 /**
  *  Provides utilities to help game devs debug the game code,
- *  including a print function for printing error logs.
+ *  including the log that the LOG macros write to.
  *  Also implements functionality for reading program args and setting
- *  debug flags appropriately.
+ *  which categories (debug flags) are logged at which levels.
+ *
+ *  Each message is logged under the debug flag of the file it comes from (its category) and a level.
+ *  Until the log thread is started, messages are written straight to the error log. Once it is started,
+ *  messages are copied into a ring of records without taking a lock, and the log thread writes them out a few
+ *  times a frame, so that logging from the main thread (and from the worker threads) doesn't wait on the console.
+ *  If the ring fills up faster than it is written out, the messages that don't fit are dropped and counted.
  *
  *  @author Noam Chitayat
  */
 class DebugUtils
 {
-   /**
-    * Debug flags to output on. This variable controls which components of
-    * the game will actually output when DEBUG is used.
-    */
-   static long debugFlags;
+   public:
+      /** How important a message is. A category logged at a level also logs the levels above it. */
+      enum Level
+      {
+         /** Something went wrong, and what was being done has been given up on. */
+         LEVEL_ERROR,
+         /** Something went wrong, but the engine carried on. */
+         LEVEL_WARNING,
+         /** What the engine is doing. */
+         LEVEL_INFO,
+         /** Step-by-step detail from busy code (such as each tile of a path search), which is too much to log out of the box. */
+         LEVEL_TRACE,
+         /** The number of Level values. */
+         NUM_LEVELS
+      };
+
+   private:
+      /** The categories (debug flags) that are logged at each level, indexed by Level. */
+      static long levelFlags[NUM_LEVELS];
 
    public:
       /**
-       * Print a string to the error log if the associated debug flag is active
+       * @param flag The debug flag of a category.
+       * @param level The level of a message.
+       *
+       * @return true iff messages at the level are logged for the category.
+       */
+      static bool isLogging(long flag, Level level)
+      {
+         return (levelFlags[level] & flag) != 0;
+      }
+
+      /**
+       * Sets the level that categories are logged at.
+       *
+       * @param level The least important level of message to log.
+       * @param flags The debug flags of the categories to set the level for.
+       */
+      static void setLevel(Level level, long flags);
+
+      /**
+       * Sets which categories are logged at which levels from a program argument, which has the form
+       * <level>[:<category>,<category>...]. The level is one of error, warning, info or trace, and the categories
+       * are named after the debug flags (such as scheduler or pathfinder). Without categories, the level is set for all of them.
+       *
+       * @param config The text of the argument.
+       *
+       * @return true iff the argument was understood (and has been applied).
+       */
+      static bool configure(const std::string& config);
+
+      /**
+       * Logs a message, if its category is logged at its level (which the LOG macros check before the message is made).
        *
        * @param flag the associated debug flag (usually set at the top of *.cpp files).
-       * @param str the string to print.
+       * @param level the level of the message.
+       * @param str the string to log.
        */
-      static void print(long flag, std::string str);
+      static void log(long flag, Level level, const std::string& str);
 
       /**
-       * Print a string to the error log if the associated debug flag is active
+       * Logs a message, if its category is logged at its level (which the LOG macros check before the message is made).
        * Uses a format string followed by a variable argument list (treat like printf)
        *
        * @param flag the associated debug flag (usually set at the top of *.cpp files).
-       * @param fmt the format string to print
+       * @param level the level of the message.
+       * @param fmt the format string to log
+       */
+      static void log(long flag, Level level, const char* fmt, ...);
+
+      /**
+       * Starts the thread that writes out the log, so that logging no longer waits for the messages to be written.
+       * The thread is stopped (and what is left of the log is written out) when the program exits.
+       */
+      static void startLogThread();
+
+      /**
+       * Stops the thread that writes out the log, after it writes out what is left of it.
+       * Messages logged afterwards are written straight to the error log again.
        */
-      static void print(long flag, const char* fmt, ...);
+      static void stopLogThread();
 
       /**
        * Standard debug pausing mechanism.
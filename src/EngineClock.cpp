@@ -0,0 +1,102 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "EngineClock.h"
+
+#ifdef _WIN32
+   #include <windows.h>
+#elif defined(__APPLE__)
+   #include <mach/mach_time.h>
+#else
+   #include <time.h>
+#endif
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EXEC_STACK;
+
+double EngineClock::frameTime = 0;
+double EngineClock::frameDelta = 0;
+double EngineClock::timeScale = 1.0;
+bool EngineClock::paused = false;
+int EngineClock::pendingFrameSteps = 0;
+bool EngineClock::steppingFrame = false;
+
+double EngineClock::getTime()
+{
+#ifdef _WIN32
+   LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return double(counter.QuadPart) * 1000000.0 / double(frequency.QuadPart);
+#elif defined(__APPLE__)
+   mach_timebase_info_data_t timebase;
+   mach_timebase_info(&timebase);
+   return double(mach_absolute_time()) * timebase.numer / timebase.denom / 1000.0;
+#else
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return double(now.tv_sec) * 1000000.0 + double(now.tv_nsec) / 1000.0;
+#endif
+}
+
+void EngineClock::beginFrame()
+{
+   const double now = getTime();
+   frameDelta = frameTime > 0 ? now - frameTime : 0;
+   frameTime = now;
+
+   steppingFrame = paused && pendingFrameSteps > 0;
+   if(steppingFrame)
+   {
+      --pendingFrameSteps;
+   }
+}
+
+double EngineClock::getFrameTime()
+{
+   return frameTime;
+}
+
+double EngineClock::getFrameDelta()
+{
+   return frameDelta;
+}
+
+void EngineClock::setTimeScale(double scale)
+{
+   timeScale = scale > 0 ? scale : 0;
+   DEBUG("Time scale set to %.2f", timeScale);
+}
+
+double EngineClock::getTimeScale()
+{
+   return timeScale;
+}
+
+void EngineClock::setPaused(bool pause)
+{
+   paused = pause;
+   pendingFrameSteps = 0;
+}
+
+bool EngineClock::isPaused()
+{
+   return paused;
+}
+
+void EngineClock::stepFrames(int count)
+{
+   if(count > 0)
+   {
+      pendingFrameSteps += count;
+   }
+}
+
+bool EngineClock::isSteppingFrame()
+{
+   return steppingFrame;
+}
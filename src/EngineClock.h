@@ -0,0 +1,102 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ENGINE_CLOCK_H
+#define ENGINE_CLOCK_H
+
+/**
+ * The engine's clock, which everything that measures or paces time reads from, so that they all agree.
+ * The time is read from the system's monotonic high-resolution counter (in microseconds), so it never jumps
+ * when the wall clock is changed, and frame times aren't rounded to whole milliseconds.
+ *
+ * The time at the start of each frame is kept as a snapshot (see beginFrame), so that everything stepped in a frame
+ * sees the same time, however long the frame's logic takes. The clock also carries the scale of the game's time:
+ * the frame pacer simulates the time that passes multiplied by the time scale, so the game can be slowed down
+ * or fast-forwarded (such as to play a long scenario through at ten times its speed), and paused and run
+ * a single frame at a time (with exactly one logic step each), for stepping through a problem deterministically.
+ *
+ * The clock may only be scaled, paused and stepped on the main thread; its time can be read from any thread.
+ */
+class EngineClock
+{
+   /** The time (in microseconds) at the start of the current frame. */
+   static double frameTime;
+
+   /** The time (in microseconds) between the start of the last frame and the start of the current one. */
+   static double frameDelta;
+
+   /** The multiple of the time that passes that the game simulates. */
+   static double timeScale;
+
+   /** Whether or not the game's time is paused. */
+   static bool paused;
+
+   /** The number of frames left to step while the game's time is paused. */
+   static int pendingFrameSteps;
+
+   /** Whether or not the current frame is one of the frames stepped while the game's time is paused. */
+   static bool steppingFrame;
+
+   public:
+      /**
+       * @return The time on the system's monotonic counter (in microseconds, from an unspecified starting point).
+       */
+      static double getTime();
+
+      /**
+       * Takes the snapshot of the time at the start of a frame. This should happen once per frame, before anything is stepped.
+       */
+      static void beginFrame();
+
+      /**
+       * @return The time (in microseconds) at the start of the current frame.
+       */
+      static double getFrameTime();
+
+      /**
+       * @return The real time (in microseconds) between the start of the last frame and the start of the current one.
+       */
+      static double getFrameDelta();
+
+      /**
+       * Sets the multiple of the time that passes that the game simulates.
+       *
+       * @param scale The time scale (1 to run the game in real time, less to slow it down, more to fast-forward it).
+       */
+      static void setTimeScale(double scale);
+
+      /**
+       * @return The multiple of the time that passes that the game simulates.
+       */
+      static double getTimeScale();
+
+      /**
+       * Pauses or resumes the game's time. Frames are still drawn while it is paused, but nothing is stepped
+       * unless a step is asked for (see stepFrames). Resuming drops any steps that haven't run yet.
+       *
+       * @param pause true iff the game's time should be paused.
+       */
+      static void setPaused(bool pause);
+
+      /**
+       * @return true iff the game's time is paused.
+       */
+      static bool isPaused();
+
+      /**
+       * Runs a number of frames, each with exactly one logic step, while the game's time is paused.
+       *
+       * @param count The number of frames to step.
+       */
+      static void stepFrames(int count);
+
+      /**
+       * @return true iff the current frame is being stepped while the game's time is paused.
+       */
+      static bool isSteppingFrame();
+};
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "EventBus.h"
+#include "Atomics.h"
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EXEC_STACK;
+
+EventBus::Slot EventBus::slots[QUEUE_SIZE];
+volatile unsigned long EventBus::writePosition = 0;
+unsigned long EventBus::readPosition = 0;
+volatile unsigned long EventBus::droppedCount = 0;
+unsigned long EventBus::reportedDroppedCount = 0;
+EventBus::Subscriber EventBus::subscribers[EVENT_TYPE_COUNT][MAX_SUBSCRIBERS];
+
+bool EventBus::post(EventType type, int value, const char* text)
+{
+   unsigned long position = writePosition;
+   for(;;)
+   {
+      const unsigned long index = position & (QUEUE_SIZE - 1);
+      Slot& slot = slots[index];
+      const long lap = static_cast<long>(slot.sequence + index - position);
+      if(lap == 0)
+      {
+         if(Atomics::compareAndSwap(&writePosition, position, position + 1))
+         {
+            Event& event = slot.event;
+            event.type = type;
+            event.value = value;
+            if(text != NULL)
+            {
+               strncpy(event.text, text, MAX_TEXT_LENGTH);
+               event.text[MAX_TEXT_LENGTH - 1] = '\0';
+            }
+            else
+            {
+               event.text[0] = '\0';
+            }
+
+            // The event has to be in the slot before the main thread can see that it is ready
+            Atomics::memoryBarrier();
+            slot.sequence = position + 1 - index;
+            return true;
+         }
+      }
+      else if(lap < 0)
+      {
+         // The slot still holds the event from a lap ago, which hasn't been handled yet
+         Atomics::increment(&droppedCount);
+         return false;
+      }
+
+      position = writePosition;
+   }
+}
+
+void EventBus::drain()
+{
+   // Events posted by the handlers could otherwise keep the drain going forever
+   const unsigned long endPosition = writePosition;
+
+   while(readPosition != endPosition)
+   {
+      const unsigned long index = readPosition & (QUEUE_SIZE - 1);
+      Slot& slot = slots[index];
+
+      // A slot claimed before the drain began may still be being written, in which case it waits for the next frame
+      if(slot.sequence + index != readPosition + 1) break;
+
+      Atomics::memoryBarrier();
+      const Event& event = slot.event;
+      Subscriber* typeSubscribers = subscribers[event.type];
+      for(int i = 0; i < MAX_SUBSCRIBERS; ++i)
+      {
+         if(typeSubscribers[i].handler != NULL)
+         {
+            typeSubscribers[i].handler(typeSubscribers[i].context, event);
+         }
+      }
+      Atomics::memoryBarrier();
+
+      slot.sequence = readPosition + QUEUE_SIZE - index;
+      ++readPosition;
+   }
+
+   const unsigned long dropped = droppedCount;
+   if(dropped != reportedDroppedCount)
+   {
+      LOG_WARNING("%lu events were dropped because the main thread couldn't keep up.", dropped - reportedDroppedCount);
+      reportedDroppedCount = dropped;
+   }
+}
+
+void EventBus::subscribe(EventType type, Handler handler, void* context)
+{
+   Subscriber* typeSubscribers = subscribers[type];
+   for(int i = 0; i < MAX_SUBSCRIBERS; ++i)
+   {
+      if(typeSubscribers[i].handler == NULL)
+      {
+         typeSubscribers[i].handler = handler;
+         typeSubscribers[i].context = context;
+         return;
+      }
+   }
+
+   T_T("Too many handlers are subscribed to the same type of event.");
+}
+
+void EventBus::unsubscribe(EventType type, Handler handler, void* context)
+{
+   Subscriber* typeSubscribers = subscribers[type];
+   for(int i = 0; i < MAX_SUBSCRIBERS; ++i)
+   {
+      if(typeSubscribers[i].handler == handler && typeSubscribers[i].context == context)
+      {
+         // The subscription is emptied rather than closed up, so that a drain going over the handlers doesn't skip one
+         typeSubscribers[i].handler = NULL;
+         typeSubscribers[i].context = NULL;
+         return;
+      }
+   }
+}
@@ -0,0 +1,148 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <cstddef>
+
+/**
+ * Carries events from any thread to the main thread, such as the commands entered into the debug console
+ * and the notices that work done on other threads (such as writing a save game) has finished.
+ *
+ * Events are posted into a fixed ring of preallocated slots without taking a lock, and without allocating anything,
+ * so that any number of threads can post at once. Once per frame, before the game state is stepped, the main thread
+ * drains the events that were posted since the last frame, in the order they were posted, handing each one
+ * to the handlers subscribed to its type. If the ring fills up faster than that, the events that
+ * don't fit are dropped and counted.
+ *
+ * Handlers may only be subscribed and unsubscribed on the main thread.
+ */
+class EventBus
+{
+   public:
+      /** The kinds of events that can be posted. */
+      enum EventType
+      {
+         /** A line was entered into the debug console (in the text). */
+         DEBUG_COMMAND,
+         /** A save game (at the path in the text) was written, or failed to be written if the value is 0. */
+         SAVE_WRITTEN,
+         /** The number of event types. */
+         EVENT_TYPE_COUNT
+      };
+
+      /** The length of the text that goes with an event, which is enough for a line of the debug console or a save game's path (longer text is cut short). */
+      static const unsigned int MAX_TEXT_LENGTH = 256;
+
+      /** An event, as it is handed to each handler. */
+      struct Event
+      {
+         /** The kind of event. */
+         EventType type;
+
+         /** A number that goes with the event (its meaning depends on the type). */
+         int value;
+
+         /** The text that goes with the event (its meaning depends on the type), which is empty if there isn't any. */
+         char text[MAX_TEXT_LENGTH];
+      };
+
+      /**
+       * Handles an event on the main thread. The event is only valid until the handler returns.
+       *
+       * @param context The context given when the handler was subscribed.
+       * @param event The event.
+       */
+      typedef void (*Handler)(void* context, const Event& event);
+
+   private:
+      /** The number of slots in the ring, which is a power of two so that positions can be masked down to a slot, with room for a burst of events between frames. */
+      static const unsigned long QUEUE_SIZE = 1 << 8;
+
+      /** The number of handlers that each event type can have. */
+      static const int MAX_SUBSCRIBERS = 4;
+
+      /** A slot of the ring. */
+      struct Slot
+      {
+         /**
+          * The position in the ring that the slot can be claimed at, or that position plus one once the event in it
+          * is ready to be handled, less the slot's index (so that the slots start out claimable without being set up).
+          * Handling the event frees the slot for the position a lap of the ring later.
+          */
+         volatile unsigned long sequence;
+
+         /** The event in the slot. */
+         Event event;
+      };
+
+      /** A handler subscribed to an event type. */
+      struct Subscriber
+      {
+         /** The handler, or NULL if the subscription is free. */
+         Handler handler;
+
+         /** The context to hand to the handler. */
+         void* context;
+      };
+
+      /** The ring of events. */
+      static Slot slots[QUEUE_SIZE];
+
+      /** The position in the ring that the next event will be claimed at. */
+      static volatile unsigned long writePosition;
+
+      /** The position in the ring of the next event to handle (only touched by the main thread). */
+      static unsigned long readPosition;
+
+      /** The number of events that have been dropped because the ring was full. */
+      static volatile unsigned long droppedCount;
+
+      /** The number of dropped events that have been reported. */
+      static unsigned long reportedDroppedCount;
+
+      /** The handlers subscribed to each event type. */
+      static Subscriber subscribers[EVENT_TYPE_COUNT][MAX_SUBSCRIBERS];
+
+   public:
+      /**
+       * Posts an event, to be handled on the main thread the next time the events are drained. Safe to call from any thread.
+       *
+       * @param type The kind of event.
+       * @param value A number that goes with the event.
+       * @param text The text that goes with the event, or NULL if there isn't any.
+       *
+       * @return true iff the event was posted (false if it was dropped because the ring was full).
+       */
+      static bool post(EventType type, int value = 0, const char* text = NULL);
+
+      /**
+       * Hands every event posted before the call to the handlers subscribed to its type, and reports any events that were dropped.
+       * Events posted by the handlers wait for the next drain. This is called on the main thread once per frame.
+       */
+      static void drain();
+
+      /**
+       * Subscribes a handler to an event type.
+       *
+       * @param type The kind of event to handle.
+       * @param handler The handler.
+       * @param context The context to hand to the handler with each event.
+       */
+      static void subscribe(EventType type, Handler handler, void* context);
+
+      /**
+       * Unsubscribes a handler from an event type. Safe to call from a handler.
+       *
+       * @param type The kind of event that the handler handles.
+       * @param handler The handler.
+       * @param context The context that the handler was subscribed with.
+       */
+      static void unsubscribe(EventType type, Handler handler, void* context);
+};
+
+#endif
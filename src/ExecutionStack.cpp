@@ -8,10 +8,28 @@
 #include "GraphicsUtil.h"
 #include "DebugUtils.h"
 #include "GameState.h"
+#include "InputQueue.h"
+#include "InputReplay.h"
+#include "FrameProfiler.h"
+#include "EngineClock.h"
+#include "EventBus.h"
+#include "PerformanceStats.h"
+#include "ProfileServer.h"
+#include "FrameArena.h"
+#include "StartupTimeline.h"
 
 const int debugFlag = DEBUG_EXEC_STACK;
 
+ExecutionStack::ExecutionStack() : frameLimit(0), framesDrawn(0), pipelined(true), frameObserver(NULL), frameObserverContext(NULL)
+{
+}
+
 ExecutionStack::~ExecutionStack()
+{
+   clear();
+}
+
+void ExecutionStack::clear()
 {
    // Delete all states on the stack
    while(!stateStack.empty())
@@ -29,20 +47,107 @@ void ExecutionStack::popState()
 
 void ExecutionStack::pushState(GameState* newState)
 {
+   if(!stateStack.empty())
+   {
+      newState->pushedOver(*stateStack.top());
+   }
+
    stateStack.push(newState);
    newState->activate();
+
+   // The new state shouldn't have to catch up on the time spent setting it up
+   framePacer.reset();
+}
+
+FramePacer& ExecutionStack::getFramePacer()
+{
+   return framePacer;
+}
+
+void ExecutionStack::setFrameLimit(int frames)
+{
+   frameLimit = frames;
+}
+
+void ExecutionStack::setPipelined(bool enabled)
+{
+   pipelined = enabled;
+}
+
+void ExecutionStack::setFrameObserver(FrameObserver observer, void* context)
+{
+   frameObserver = observer;
+   frameObserverContext = context;
+}
+
+int ExecutionStack::getFramesDrawn() const
+{
+   return framesDrawn;
 }
 
 void ExecutionStack::execute()
 {
-   while(!stateStack.empty())
+   framePacer.reset();
+   framesDrawn = 0;
+
+   while(!stateStack.empty() && (frameLimit <= 0 || framesDrawn < frameLimit) && !InputReplay::isFinished())
    {
+      // Everything in the frame is paced from the same moment, however long the frame's logic takes
+      EngineClock::beginFrame();
+      FrameProfiler::beginFrame();
+      ProfileServer::publishFrame();
+      PROFILE_ZONE("ExecutionStack::execute");
+
+      framePacer.beginFrame();
+
+      // Whatever the other threads have finished or asked for since the last frame is handled before anything is stepped
+      EventBus::drain();
+
+      // Step the state once for each step of time that has passed, unless it finishes or pushes a new state
       GameState* currentState = stateStack.top();
-      if(currentState->advanceFrame())
+      bool stateActive = true;
+      while(stateActive && stateStack.top() == currentState && !InputReplay::isFinished() && framePacer.nextStep())
+      {
+         InputReplay::beginStep();
+         InputQueue::drain();
+         stateActive = currentState->advanceFrame(framePacer.getStepTime());
+         InputReplay::endStep();
+      }
+
+      if(stateActive && stateStack.top() == currentState && EngineClock::isPaused() && !EngineClock::isSteppingFrame())
+      {
+         // Nothing is stepped while the game's time is paused, but the state still takes its input, so that the time can be resumed
+         InputQueue::drain();
+         stateActive = currentState->advancePausedFrame();
+      }
+
+      if(stateActive)
       {
+         // The last frame was drawn by the GPU while this frame's logic ran, so it can be shown before this frame is drawn over it
+         GraphicsUtil::getInstance()->presentFrame();
+
          // The state is still active, so draw its results
          GraphicsUtil::getInstance()->clearBuffer();
          currentState->drawFrame();
+         if(!pipelined)
+         {
+            GraphicsUtil::getInstance()->presentFrame();
+         }
+
+         currentState->idle(framePacer.getTimeLeftInFrame());
+
+         PROFILE_ZONE("FramePacer::endFrame");
+         framePacer.endFrame();
+         PerformanceStats::endFrame();
+         ++framesDrawn;
+
+         // Startup is over once the first frame (and whatever the state loaded in its idle time) is done
+         StartupTimeline::finish();
+
+         if(frameObserver != NULL)
+         {
+            frameObserver(frameObserverContext, framesDrawn);
+         }
       }
       else
       {
@@ -53,6 +158,14 @@ void ExecutionStack::execute()
          {
             stateStack.top()->activate();
          }
+
+         framePacer.reset();
       }
+
+      // Nothing allocated from the frame arena outlives the frame
+      FrameArena::reset();
    }
+
+   // The last frame drawn is still waiting to be shown
+   GraphicsUtil::getInstance()->presentFrame();
 }
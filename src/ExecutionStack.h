@@ -8,6 +8,7 @@
 #define EXECUTION_STACK_H
 
 #include "Singleton.h"
+#include "FramePacer.h"
 #include <stack>
 
 class GameState;
@@ -17,6 +18,11 @@ class GameState;
  * Holds different states of the game (Title Screen, Tile Engine, etc.) 
  * and allows for easy change of state.
  * Main functionality is calling advanceFrame and drawFrame, and destroying finished states in the execute() function.
+ * The calls are paced by a FramePacer, so that logic runs in fixed steps and frames are drawn at a steady rate.
+ *
+ * Frames are pipelined: each frame is handed to the driver without waiting for the GPU to draw it, and is only shown on screen
+ * after the next frame's logic steps have run, so the simulation of one frame overlaps the drawing of the last one.
+ * This shows each frame a frame later, so it can be turned off where input latency matters more than headroom.
  *
  * @author Noam Chitayat
  */
@@ -28,12 +34,40 @@ class ExecutionStack
     */
    std::stack<GameState*> stateStack;
 
+   /** Paces the logic steps and frames of the game loop. */
+   FramePacer framePacer;
+
+   /** The number of frames to draw before the game loop stops, or 0 if it runs until every state is finished. */
+   int frameLimit;
+
+   /** The number of frames drawn since the game loop started. */
+   int framesDrawn;
+
+   /** Whether or not each frame's logic runs before the last frame is shown on screen. */
+   bool pipelined;
+
+   /** The function called after each frame is drawn (or NULL if there is none), and the context it is called with. */
+   void (*frameObserver)(void* context, int frameNumber);
+   void* frameObserverContext;
+
    /**
     * Remove and delete the most recent state pushed on the stack.
     */
    void popState();
 
    public:
+      /**
+       * A function called after each frame is drawn, such as to time the frames of a benchmark.
+       *
+       * @param context The context that the observer was set with.
+       * @param frameNumber The number of frames drawn since the game loop started, including this one.
+       */
+      typedef void (*FrameObserver)(void* context, int frameNumber);
+
+      /**
+       * Constructor.
+       */
+      ExecutionStack();
 
       /**
        * Destructor.
@@ -50,12 +84,50 @@ class ExecutionStack
        */
       void pushState(GameState* newState);
 
+      /**
+       * @return The pacer that paces the game loop.
+       */
+      FramePacer& getFramePacer();
+
+      /**
+       * Sets a number of frames to stop the game loop after, even if there are states left on the stack
+       * (such as for automated performance runs).
+       *
+       * @param frames The number of frames to draw, or 0 to run until every state is finished.
+       */
+      void setFrameLimit(int frames);
+
+      /**
+       * Sets whether or not frames are pipelined, so that each frame's logic runs while the GPU draws the last frame.
+       *
+       * @param enabled true iff frames should be pipelined, or false to show each frame as soon as it is drawn.
+       */
+      void setPipelined(bool enabled);
+
+      /**
+       * Sets a function to call after each frame is drawn.
+       *
+       * @param observer The function to call (or NULL to stop calling one).
+       * @param context The context to call the observer with.
+       */
+      void setFrameObserver(FrameObserver observer, void* context);
+
+      /**
+       * @return The number of frames drawn since the game loop started.
+       */
+      int getFramesDrawn() const;
+
+      /**
+       * Deletes every state left on the stack, such as after the frame limit has stopped the game loop.
+       */
+      void clear();
+
       /**
        * Execute the game loop.
-       * Step through the state logic. If the logic returns true
-       * then the state is not ready to terminate, so run its draw step.
+       * Step through the state logic, once for every fixed step of time that has passed since the last frame.
+       * If the logic returns true then the state is not ready to terminate, so run its draw step.
        * Otherwise, pop the stack and activate the next most recent state.
-       * Keep going until there are no more states, and then quit.
+       * Keep going until there are no more states (or the frame limit is reached), and then quit.
        */
       void execute();
 };
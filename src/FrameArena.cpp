@@ -0,0 +1,95 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "FrameArena.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EXEC_STACK;
+
+// Enough for the scratch lists of the searches and lookups of a busy frame, so most games never grow it
+const size_t FrameArena::INITIAL_BLOCK_SIZE = 256 << 10;
+
+// Large enough for any of the engine's types (doubles and pointers included)
+const size_t FrameArena::ALIGNMENT = 16;
+
+char* FrameArena::block = NULL;
+size_t FrameArena::blockSize = 0;
+size_t FrameArena::used = 0;
+std::vector<char*> FrameArena::overflowAllocations;
+size_t FrameArena::overflowSize = 0;
+
+size_t FrameArena::align(size_t bytes)
+{
+   return (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+void* FrameArena::allocate(size_t bytes)
+{
+   if(block == NULL)
+   {
+      block = new char[INITIAL_BLOCK_SIZE];
+      blockSize = INITIAL_BLOCK_SIZE;
+   }
+
+   const size_t size = align(bytes);
+   if(size <= blockSize - used)
+   {
+      void* memory = block + used;
+      used += size;
+      return memory;
+   }
+
+   // The block is full for this frame; the allocation is counted so that the block can grow to fit it from now on
+   char* memory = new char[size];
+   overflowAllocations.push_back(memory);
+   overflowSize += size;
+   return memory;
+}
+
+void FrameArena::deallocate(void* memory, size_t bytes)
+{
+   const size_t size = align(bytes);
+   if(static_cast<char*>(memory) + size == block + used)
+   {
+      used -= size;
+   }
+}
+
+void FrameArena::reset()
+{
+   for(std::vector<char*>::iterator iter = overflowAllocations.begin(); iter != overflowAllocations.end(); ++iter)
+   {
+      delete [] *iter;
+   }
+
+   overflowAllocations.clear();
+
+   if(overflowSize > 0)
+   {
+      // Doubling the block (at least) keeps a slowly growing frame from growing the block every time
+      size_t newSize = blockSize * 2;
+      while(newSize < blockSize + overflowSize)
+      {
+         newSize *= 2;
+      }
+
+      DEBUG("Growing the frame arena from %d to %d bytes", static_cast<int>(blockSize), static_cast<int>(newSize));
+      delete [] block;
+      block = new char[newSize];
+      blockSize = newSize;
+      overflowSize = 0;
+   }
+
+   used = 0;
+}
+
+void FrameArena::release()
+{
+   reset();
+   delete [] block;
+   block = NULL;
+   blockSize = 0;
+}
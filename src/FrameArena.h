@@ -0,0 +1,157 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <vector>
+
+/**
+ * A bump allocator for the short-lived data built up over the course of a single frame (such as the scratch lists of a search).
+ * Allocating from the arena only moves a pointer along a block of memory, and nothing is freed until the arena is reset
+ * at the end of each frame by the execution stack, which hands the whole block back at once.
+ *
+ * If a frame needs more memory than the block holds, the rest is allocated from the heap, and the block grows to fit
+ * when the arena is reset, so that once the game has settled into its usual frames the arena stops touching the heap.
+ *
+ * The arena is only for the main thread, and the memory it hands out is only good until the end of the frame.
+ */
+class FrameArena
+{
+   /** The size (in bytes) of the block that the arena starts out with. */
+   static const size_t INITIAL_BLOCK_SIZE;
+
+   /** The alignment (in bytes) of every allocation. */
+   static const size_t ALIGNMENT;
+
+   /** The block that allocations are taken from, or NULL if nothing has been allocated yet. */
+   static char* block;
+
+   /** The size (in bytes) of the block. */
+   static size_t blockSize;
+
+   /** The number of bytes of the block that have been handed out this frame. */
+   static size_t used;
+
+   /** The allocations that didn't fit in the block this frame, which are freed when the arena is reset. */
+   static std::vector<char*> overflowAllocations;
+
+   /** The number of bytes allocated from the heap this frame because they didn't fit in the block. */
+   static size_t overflowSize;
+
+   /**
+    * @param bytes A number of bytes.
+    *
+    * @return The number of bytes, rounded up to the alignment of the allocations.
+    */
+   static size_t align(size_t bytes);
+
+   public:
+      /**
+       * Allocates memory that lasts until the end of the frame.
+       *
+       * @param bytes The number of bytes to allocate.
+       *
+       * @return The memory, aligned for any of the engine's types.
+       */
+      static void* allocate(size_t bytes);
+
+      /**
+       * Gives back memory allocated from the arena. Only the latest allocation from the block is actually reclaimed
+       * (such as when a vector grows into a larger allocation right after its last one); anything else waits for the reset.
+       *
+       * @param memory The memory to give back.
+       * @param bytes The number of bytes that were allocated.
+       */
+      static void deallocate(void* memory, size_t bytes);
+
+      /**
+       * Frees everything allocated since the last reset, and grows the block if this frame didn't fit in it.
+       * Nothing allocated from the arena can be used after this.
+       */
+      static void reset();
+
+      /**
+       * Frees the arena's memory (such as when the game exits).
+       */
+      static void release();
+};
+
+/**
+ * An STL allocator that allocates from the FrameArena, for containers that only live for part of a frame.
+ */
+template<typename T> class FrameAllocator
+{
+   public:
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+
+      template<typename U> struct rebind
+      {
+         typedef FrameAllocator<U> other;
+      };
+
+      FrameAllocator() {}
+
+      template<typename U> FrameAllocator(const FrameAllocator<U>&) {}
+
+      pointer address(reference value) const
+      {
+         return &value;
+      }
+
+      const_pointer address(const_reference value) const
+      {
+         return &value;
+      }
+
+      pointer allocate(size_type count, const void* /*hint*/ = 0)
+      {
+         return static_cast<pointer>(FrameArena::allocate(count * sizeof(T)));
+      }
+
+      void deallocate(pointer memory, size_type count)
+      {
+         FrameArena::deallocate(memory, count * sizeof(T));
+      }
+
+      size_type max_size() const
+      {
+         return std::numeric_limits<size_type>::max() / sizeof(T);
+      }
+
+      void construct(pointer memory, const T& value)
+      {
+         new(memory) T(value);
+      }
+
+      void destroy(pointer memory)
+      {
+         memory->~T();
+      }
+};
+
+/** Every frame allocator allocates from the same arena, so memory allocated by one can be freed by any other. */
+template<typename T, typename U> bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&)
+{
+   return true;
+}
+
+/** Every frame allocator allocates from the same arena, so memory allocated by one can be freed by any other. */
+template<typename T, typename U> bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&)
+{
+   return false;
+}
+
+#endif
@@ -0,0 +1,391 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "FrameCapture.h"
+#include "GraphicsUtil.h"
+#include "PerformanceStats.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+#ifndef GL_PIXEL_PACK_BUFFER_ARB
+#define GL_PIXEL_PACK_BUFFER_ARB 0x88EB
+#endif
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+// A few frames' slack covers a slow write now and then; past that the workers aren't keeping up, and holding more frames only eats memory
+const int FrameCapture::MAX_PENDING_ENCODES = 8;
+
+// Frames are read back with 4 bytes to a pixel, whose rows are always aligned for glReadPixels
+static const int BYTES_PER_PIXEL = 4;
+
+// The most pixels that a TGA run-length packet can hold
+static const int MAX_PACKET_LENGTH = 128;
+
+bool FrameCapture::functionsLoaded = false;
+bool FrameCapture::buffersSupported = false;
+
+// The pixel buffer object functions aren't part of OpenGL 1.1, so they have to be looked up from the driver
+static PFNGLGENBUFFERSARBPROC genBuffers = NULL;
+static PFNGLBINDBUFFERARBPROC bindBuffer = NULL;
+static PFNGLBUFFERDATAARBPROC bufferData = NULL;
+static PFNGLMAPBUFFERARBPROC mapBuffer = NULL;
+static PFNGLUNMAPBUFFERARBPROC unmapBuffer = NULL;
+static PFNGLDELETEBUFFERSARBPROC deleteBuffers = NULL;
+
+/**
+ * @return true iff two pixels have the same colour (the screen's alpha is ignored).
+ */
+static bool isSameColour(const unsigned char* first, const unsigned char* second)
+{
+   return first[0] == second[0] && first[1] == second[1] && first[2] == second[2];
+}
+
+/**
+ * Adds a pixel's colour to an encoded image, in the blue, green, red order of a TGA file.
+ */
+static void appendColour(std::vector<unsigned char>& out, const unsigned char* pixel)
+{
+   out.push_back(pixel[0]);
+   out.push_back(pixel[1]);
+   out.push_back(pixel[2]);
+}
+
+/**
+ * Run-length encodes a row of pixels into TGA packets, none of which cross into the next row.
+ *
+ * @param row The row's pixels, in the blue, green, red, alpha order that they were read back in.
+ * @param width The number of pixels in the row.
+ * @param out The encoded image to add the packets to.
+ */
+static void encodeRow(const unsigned char* row, int width, std::vector<unsigned char>& out)
+{
+   int x = 0;
+   while(x < width)
+   {
+      int length = 1;
+      while(x + length < width && length < MAX_PACKET_LENGTH && isSameColour(row + x * BYTES_PER_PIXEL, row + (x + length) * BYTES_PER_PIXEL))
+      {
+         ++length;
+      }
+
+      if(length > 1)
+      {
+         out.push_back(static_cast<unsigned char>(0x80 | (length - 1)));
+         appendColour(out, row + x * BYTES_PER_PIXEL);
+      }
+      else
+      {
+         // A raw packet goes up to the next pair of matching pixels, which start a run packet of their own
+         while(x + length < width && length < MAX_PACKET_LENGTH
+               && !(x + length + 1 < width && isSameColour(row + (x + length) * BYTES_PER_PIXEL, row + (x + length + 1) * BYTES_PER_PIXEL)))
+         {
+            ++length;
+         }
+
+         out.push_back(static_cast<unsigned char>(length - 1));
+         for(int i = 0; i < length; ++i)
+         {
+            appendColour(out, row + (x + i) * BYTES_PER_PIXEL);
+         }
+      }
+
+      x += length;
+   }
+}
+
+class FrameCapture::EncodeJob : public JobSystem::Job
+{
+   /** The capture that the frame belongs to. */
+   FrameCapture& capture;
+
+   /** The frame's pixels, bottom row first. */
+   std::vector<unsigned char> pixels;
+
+   /** The width of the frame (in pixels). */
+   const int width;
+
+   /** The height of the frame (in pixels). */
+   const int height;
+
+   /** The path to write the frame to. */
+   const std::string path;
+
+   /** Whether or not the frame was written. */
+   bool written;
+
+   public:
+      EncodeJob(FrameCapture& capture, std::vector<unsigned char>& framePixels, int width, int height, const std::string& path) : JobSystem::Job(true),
+         capture(capture), width(width), height(height), path(path), written(false)
+      {
+         // The frame is handed over instead of copied again
+         pixels.swap(framePixels);
+      }
+
+      void run(int /*slot*/)
+      {
+         // An uncompressed true-colour image would be type 2; type 10 is the same, run-length encoded.
+         // The rows go bottom to top, which is both TGA's default and the order that OpenGL reads them back in.
+         const unsigned char header[18] =
+         {
+            0, 0, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            static_cast<unsigned char>(width & 0xFF), static_cast<unsigned char>(width >> 8),
+            static_cast<unsigned char>(height & 0xFF), static_cast<unsigned char>(height >> 8),
+            24, 0
+         };
+
+         std::vector<unsigned char> encoded(header, header + sizeof(header));
+         encoded.reserve(pixels.size() / 2);
+         for(int y = 0; y < height; ++y)
+         {
+            encodeRow(&pixels[y * width * BYTES_PER_PIXEL], width, encoded);
+         }
+
+         FILE* file = fopen(path.c_str(), "wb");
+         if(file == NULL) return;
+
+         written = fwrite(&encoded[0], 1, encoded.size(), file) == encoded.size();
+         written = fclose(file) == 0 && written;
+      }
+
+      void finalize()
+      {
+         capture.encodeFinished(written);
+      }
+};
+
+void FrameCapture::loadFunctions()
+{
+   functionsLoaded = true;
+
+   const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+   if(extensions == NULL || strstr(extensions, "GL_ARB_pixel_buffer_object") == NULL)
+   {
+      DEBUG("Pixel buffer objects are not supported; captured frames will stall until they are drawn.");
+      return;
+   }
+
+   genBuffers = reinterpret_cast<PFNGLGENBUFFERSARBPROC>(GraphicsUtil::getProcAddress("glGenBuffersARB"));
+   bindBuffer = reinterpret_cast<PFNGLBINDBUFFERARBPROC>(GraphicsUtil::getProcAddress("glBindBufferARB"));
+   bufferData = reinterpret_cast<PFNGLBUFFERDATAARBPROC>(GraphicsUtil::getProcAddress("glBufferDataARB"));
+   mapBuffer = reinterpret_cast<PFNGLMAPBUFFERARBPROC>(GraphicsUtil::getProcAddress("glMapBufferARB"));
+   unmapBuffer = reinterpret_cast<PFNGLUNMAPBUFFERARBPROC>(GraphicsUtil::getProcAddress("glUnmapBufferARB"));
+   deleteBuffers = reinterpret_cast<PFNGLDELETEBUFFERSARBPROC>(GraphicsUtil::getProcAddress("glDeleteBuffersARB"));
+
+   buffersSupported = genBuffers != NULL && bindBuffer != NULL && bufferData != NULL && mapBuffer != NULL && unmapBuffer != NULL && deleteBuffers != NULL;
+   DEBUG("Pixel buffer objects are %s", buffersSupported ? "supported" : "missing functions; captured frames will stall until they are drawn.");
+}
+
+FrameCapture::FrameCapture() : annotations(NULL), bufferWidth(0), bufferHeight(0), nextBuffer(0), pendingBuffer(0), framePending(false),
+   framesNumbered(0), framesDropped(0), pendingEncodes(0), failedWrites(0)
+{
+   for(int i = 0; i < BUFFER_COUNT; ++i)
+   {
+      buffers[i] = 0;
+   }
+}
+
+bool FrameCapture::start(const std::string& captureDirectory)
+{
+   stop();
+
+   std::string trimmedDirectory = captureDirectory;
+   while(trimmedDirectory.length() > 1 && trimmedDirectory[trimmedDirectory.length() - 1] == '/')
+   {
+      trimmedDirectory.erase(trimmedDirectory.length() - 1);
+   }
+
+   const std::string annotationsPath = trimmedDirectory + "/frames.csv";
+   annotations = fopen(annotationsPath.c_str(), "w");
+   if(annotations == NULL)
+   {
+      DEBUG("Unable to open %s; frames won't be captured.", annotationsPath.c_str());
+      return false;
+   }
+
+   fprintf(annotations, "frame,frame_time_ms,draw_calls,texture_binds,fps,dropped\n");
+
+   directory = trimmedDirectory;
+   bufferWidth = 0;
+   bufferHeight = 0;
+   nextBuffer = 0;
+   framePending = false;
+   framesNumbered = 0;
+   framesDropped = 0;
+   failedWrites = 0;
+
+   DEBUG("Capturing frames into %s", directory.c_str());
+   return true;
+}
+
+void FrameCapture::stop()
+{
+   if(!isCapturing()) return;
+
+   finishPendingFrame();
+   JobSystem::wait(encodes);
+
+   fclose(annotations);
+   annotations = NULL;
+
+   DEBUG("Captured %d frames into %s (%d dropped, %d unable to be written).", framesNumbered, directory.c_str(), framesDropped, failedWrites);
+   directory.clear();
+
+   // The buffers hold a whole screen each, so they aren't kept around between captures
+   heldPixels.clear();
+   if(buffers[0] != 0)
+   {
+      deleteBuffers(BUFFER_COUNT, buffers);
+      for(int i = 0; i < BUFFER_COUNT; ++i)
+      {
+         buffers[i] = 0;
+      }
+   }
+}
+
+bool FrameCapture::isCapturing() const
+{
+   return !directory.empty();
+}
+
+int FrameCapture::getFrameCount() const
+{
+   return framesNumbered;
+}
+
+int FrameCapture::getDroppedCount() const
+{
+   return framesDropped;
+}
+
+void FrameCapture::captureFrame(int width, int height)
+{
+   if(!isCapturing() || width <= 0 || height <= 0) return;
+
+   if(!functionsLoaded)
+   {
+      loadFunctions();
+   }
+
+   if(width != bufferWidth || height != bufferHeight)
+   {
+      // The frame waiting in the buffers is of the old size, so it has to be finished before they are resized
+      finishPendingFrame();
+      bufferWidth = width;
+      bufferHeight = height;
+
+      if(buffersSupported)
+      {
+         if(buffers[0] == 0)
+         {
+            genBuffers(BUFFER_COUNT, buffers);
+         }
+
+         for(int i = 0; i < BUFFER_COUNT; ++i)
+         {
+            bindBuffer(GL_PIXEL_PACK_BUFFER_ARB, buffers[i]);
+            bufferData(GL_PIXEL_PACK_BUFFER_ARB, width * height * BYTES_PER_PIXEL, NULL, GL_STREAM_READ_ARB);
+         }
+
+         bindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+      }
+   }
+
+   if(buffersSupported)
+   {
+      // With a pixel buffer bound, the copy is queued behind the frame's drawing instead of waiting for it
+      const int frameBuffer = nextBuffer;
+      bindBuffer(GL_PIXEL_PACK_BUFFER_ARB, buffers[frameBuffer]);
+      glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+      bindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+      nextBuffer = (nextBuffer + 1) % BUFFER_COUNT;
+
+      // The frame before this one has had a whole frame to be copied, so mapping its buffer shouldn't have to wait
+      finishPendingFrame();
+      pendingBuffer = frameBuffer;
+   }
+   else
+   {
+      finishPendingFrame();
+      heldPixels.resize(width * height * BYTES_PER_PIXEL);
+      glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, &heldPixels[0]);
+   }
+
+   framePending = true;
+}
+
+void FrameCapture::finishPendingFrame()
+{
+   if(!framePending) return;
+   framePending = false;
+
+   const int frameNumber = framesNumbered;
+   ++framesNumbered;
+
+   std::vector<unsigned char> pixels;
+   const bool dropped = pendingEncodes >= MAX_PENDING_ENCODES;
+   if(dropped)
+   {
+      ++framesDropped;
+   }
+   else if(buffersSupported)
+   {
+      bindBuffer(GL_PIXEL_PACK_BUFFER_ARB, buffers[pendingBuffer]);
+      const unsigned char* data = static_cast<const unsigned char*>(mapBuffer(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB));
+      if(data != NULL)
+      {
+         pixels.assign(data, data + bufferWidth * bufferHeight * BYTES_PER_PIXEL);
+         unmapBuffer(GL_PIXEL_PACK_BUFFER_ARB);
+      }
+
+      bindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+   }
+   else
+   {
+      pixels.swap(heldPixels);
+   }
+
+   // The counters were last updated when the pending frame ended, so they describe it (and not the frame being read back after it)
+   fprintf(annotations, "%d,%lu,%lu,%lu,%.1f,%d\n", frameNumber, PerformanceStats::getLastFrameTime(), PerformanceStats::getLastFrameDrawCalls(),
+         PerformanceStats::getLastFrameTextureBinds(), PerformanceStats::getFramesPerSecond(), dropped ? 1 : 0);
+
+   if(dropped) return;
+
+   if(pixels.empty())
+   {
+      DEBUG("Unable to map the pixels of captured frame %d.", frameNumber);
+      ++failedWrites;
+      return;
+   }
+
+   std::ostringstream path;
+   path << directory << "/frame" << std::setw(6) << std::setfill('0') << frameNumber << ".tga";
+
+   ++pendingEncodes;
+   JobSystem::submit(new EncodeJob(*this, pixels, bufferWidth, bufferHeight, path.str()), &encodes);
+}
+
+void FrameCapture::encodeFinished(bool written)
+{
+   --pendingEncodes;
+   if(!written)
+   {
+      ++failedWrites;
+   }
+}
+
+FrameCapture::~FrameCapture()
+{
+   stop();
+}
@@ -0,0 +1,165 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "JobSystem.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+typedef unsigned int GLuint;
+
+/**
+ * Records each frame drawn to the screen into a directory, as a numbered series of TGA images
+ * (frame000000.tga, frame000001.tga, ...), along with frames.csv, which annotates each frame with
+ * the frame time counters kept by PerformanceStats.
+ *
+ * The frames are read back through a pair of pixel buffer objects, so that the GPU copies each frame
+ * into one buffer while the frame before it is mapped from the other, and the main thread never waits
+ * for a frame to finish drawing. The pixels are then encoded and written to disk by the job system's workers.
+ * If the encodes fall too far behind, frames are dropped (and counted in the annotations) rather than
+ * letting the frames waiting to be written pile up in memory.
+ *
+ * Pixel buffer objects need GL_ARB_pixel_buffer_object from the driver; where it is missing,
+ * each frame is read back with a plain glReadPixels, which stalls the main thread until the frame is drawn.
+ * The capture may only be used while the OpenGL context is current.
+ */
+class FrameCapture
+{
+   class EncodeJob;
+
+   /** The number of pixel buffers that frames are read back through. */
+   static const int BUFFER_COUNT = 2;
+
+   /** The most frames that can wait to be encoded at once, before frames are dropped. */
+   static const int MAX_PENDING_ENCODES;
+
+   /** Whether or not the pixel buffer object functions have been looked up. */
+   static bool functionsLoaded;
+
+   /** Whether or not the driver supports pixel buffer objects. */
+   static bool buffersSupported;
+
+   /**
+    * Looks up the pixel buffer object functions, if the driver supports them.
+    */
+   static void loadFunctions();
+
+   /** The directory that the frames are written to, or an empty string if frames aren't being captured. */
+   std::string directory;
+
+   /** The annotations file, or NULL if frames aren't being captured. */
+   FILE* annotations;
+
+   /** The pixel buffers that frames are read back through, or 0s if they haven't been created. */
+   GLuint buffers[BUFFER_COUNT];
+
+   /** The width of the frames in the pixel buffers (in pixels). */
+   int bufferWidth;
+
+   /** The height of the frames in the pixel buffers (in pixels). */
+   int bufferHeight;
+
+   /** The frame read back without pixel buffers, held until the next frame so that its annotations can be filled in. */
+   std::vector<unsigned char> heldPixels;
+
+   /** The pixel buffer that the next frame is read back into. */
+   int nextBuffer;
+
+   /** The pixel buffer holding the frame waiting to be annotated. */
+   int pendingBuffer;
+
+   /** Whether or not a frame has been read back and is waiting to be annotated and encoded. */
+   bool framePending;
+
+   /** The number of frames numbered (written or dropped) since the capture started. */
+   int framesNumbered;
+
+   /** The number of frames dropped since the capture started, because too many were waiting to be encoded. */
+   int framesDropped;
+
+   /** The number of frames handed to the workers and not yet finalized. */
+   int pendingEncodes;
+
+   /** The number of frames that couldn't be written since the capture started. */
+   int failedWrites;
+
+   /** Counts the encoding jobs, so that the capture can wait for them to write their frames. */
+   JobSystem::Counter encodes;
+
+   /**
+    * Annotates the frame read back by the last call to captureFrame, then hands it to the workers to encode,
+    * or drops it if too many frames are already waiting to be encoded.
+    */
+   void finishPendingFrame();
+
+   /**
+    * Records that an encoding job is done.
+    *
+    * @param written true iff the job wrote its frame.
+    */
+   void encodeFinished(bool written);
+
+   /** Frame captures can't be copied. */
+   FrameCapture(const FrameCapture&);
+
+   /** Frame captures can't be copied. */
+   FrameCapture& operator=(const FrameCapture&);
+
+   public:
+      /**
+       * Constructor.
+       */
+      FrameCapture();
+
+      /**
+       * Starts capturing frames into a directory, stopping any capture already running.
+       * Frames already in the directory with the same names are overwritten.
+       *
+       * @param directory The directory to write the frames to, which must exist.
+       *
+       * @return true iff the capture started.
+       */
+      bool start(const std::string& directory);
+
+      /**
+       * Stops capturing frames, waiting for the frames read back so far to be written.
+       */
+      void stop();
+
+      /**
+       * @return true iff frames are being captured.
+       */
+      bool isCapturing() const;
+
+      /**
+       * @return The number of frames written or dropped since the capture started.
+       */
+      int getFrameCount() const;
+
+      /**
+       * @return The number of frames dropped since the capture started.
+       */
+      int getDroppedCount() const;
+
+      /**
+       * Reads back the frame drawn to the screen, if frames are being captured, and hands the frame before it to the workers.
+       * This must be called once the frame has been drawn, before the screen is flipped.
+       *
+       * @param width The width of the screen (in pixels).
+       * @param height The height of the screen (in pixels).
+       */
+      void captureFrame(int width, int height);
+
+      /**
+       * Destructor. Stops the capture, and releases the pixel buffers.
+       */
+      ~FrameCapture();
+};
+
+#endif
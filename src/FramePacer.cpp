@@ -0,0 +1,154 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "FramePacer.h"
+#include "EngineClock.h"
+#include <SDL.h>
+#include <cmath>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EXEC_STACK;
+
+// Ten millisecond steps are short enough that the simulation keeps up with fast actors and quick input
+const long FramePacer::DEFAULT_STEP_TIME = 10;
+
+// Frames drawn above the refresh rate of a typical monitor are never seen
+const int FramePacer::DEFAULT_FRAME_RATE = 60;
+
+// A frame that takes longer than this (such as the first frame after a map loads) is simulated as if it didn't
+const long FramePacer::MAX_FRAME_TIME = 100;
+
+// SDL_Delay can oversleep by a couple of milliseconds on most platforms
+const double FramePacer::SPIN_TIME = 2.0;
+
+FramePacer::FramePacer() : targetFrameRate(DEFAULT_FRAME_RATE), stepTime(DEFAULT_STEP_TIME), fixedStepping(false)
+{
+   reset();
+}
+
+double FramePacer::getCurrentTime()
+{
+   return EngineClock::getTime() / 1000.0;
+}
+
+void FramePacer::setTargetFrameRate(int framesPerSecond)
+{
+   targetFrameRate = framesPerSecond;
+   nextFrameTime = getCurrentTime();
+}
+
+int FramePacer::getTargetFrameRate() const
+{
+   return targetFrameRate;
+}
+
+void FramePacer::setStepTime(long milliseconds)
+{
+   stepTime = milliseconds;
+}
+
+long FramePacer::getStepTime() const
+{
+   return stepTime;
+}
+
+void FramePacer::setFixedStepping(bool enabled)
+{
+   fixedStepping = enabled;
+}
+
+void FramePacer::reset()
+{
+   lastFrameTime = getCurrentTime();
+   nextFrameTime = lastFrameTime;
+   accumulatedTime = 0;
+}
+
+void FramePacer::beginFrame()
+{
+   const double currentTime = EngineClock::getFrameTime() / 1000.0;
+   double frameTime = currentTime - lastFrameTime;
+   lastFrameTime = currentTime;
+
+   if(EngineClock::isPaused())
+   {
+      // What is left of the step in progress is kept, so that the frame is drawn where the game was paused
+      if(EngineClock::isSteppingFrame())
+      {
+         accumulatedTime = std::fmod(accumulatedTime, double(stepTime)) + stepTime;
+      }
+
+      return;
+   }
+
+   if(fixedStepping)
+   {
+      // Whatever was left over from a frame that stopped stepping early (such as by pushing a state) is dropped
+      accumulatedTime = std::fmod(accumulatedTime, double(stepTime)) + stepTime * EngineClock::getTimeScale();
+      return;
+   }
+
+   // The limit is on the real time, so that a fast-forwarded game isn't held back by it
+   if(frameTime > MAX_FRAME_TIME)
+   {
+      LOG_WARNING("Frame took %.1fms; only simulating %ldms of it.", frameTime, MAX_FRAME_TIME);
+      frameTime = MAX_FRAME_TIME;
+   }
+
+   accumulatedTime += frameTime * EngineClock::getTimeScale();
+}
+
+bool FramePacer::nextStep()
+{
+   if(accumulatedTime < stepTime)
+   {
+      return false;
+   }
+
+   accumulatedTime -= stepTime;
+   return true;
+}
+
+float FramePacer::getInterpolation() const
+{
+   return static_cast<float>(accumulatedTime / stepTime);
+}
+
+long FramePacer::getTimeLeftInFrame() const
+{
+   if(targetFrameRate <= 0) return 0;
+
+   // Leave the spin at the end of the wait alone, so that whatever fills the time doesn't make the frame late
+   const double timeLeft = nextFrameTime + 1000.0 / targetFrameRate - getCurrentTime() - SPIN_TIME;
+   return timeLeft > 0 ? static_cast<long>(timeLeft) : 0;
+}
+
+void FramePacer::endFrame()
+{
+   if(targetFrameRate <= 0) return;
+
+   const double frameLength = 1000.0 / targetFrameRate;
+   nextFrameTime += frameLength;
+
+   const double currentTime = getCurrentTime();
+   if(currentTime > nextFrameTime + frameLength)
+   {
+      // The loop has fallen more than a frame behind, so start pacing over from now instead of rushing to catch up
+      nextFrameTime = currentTime;
+      return;
+   }
+
+   // Sleep through most of the wait, then spin for the rest so that the frame doesn't start late
+   const double sleepTime = nextFrameTime - currentTime - SPIN_TIME;
+   if(sleepTime >= 1.0)
+   {
+      SDL_Delay(static_cast<Uint32>(sleepTime));
+   }
+
+   while(getCurrentTime() < nextFrameTime)
+   {
+   }
+}
@@ -0,0 +1,137 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+/**
+ * Paces the game loop. Game logic is run in fixed steps (of DEFAULT_STEP_TIME milliseconds, unless set otherwise),
+ * as many as the time since the last frame calls for, so that the simulation runs at the same rate and gives the same
+ * results no matter how fast frames are drawn. Frames usually fall between two steps, so the pacer also reports
+ * how far along the next step the frame is, which lets moving things be drawn between where the steps put them.
+ * After each frame is drawn, the pacer waits out whatever is left of the frame's share of time under the
+ * target frame rate: it sleeps for most of the wait, and then spins for the last few milliseconds,
+ * since sleeps can overshoot.
+ *
+ * Time is read from the EngineClock's snapshot of the frame's start, to a fraction of a millisecond, and the time simulated
+ * is the time that passed multiplied by the clock's time scale. While the clock is paused, nothing is simulated
+ * except for a single logic step in each frame that the clock steps.
+ */
+class FramePacer
+{
+   /** The longest time (in milliseconds) that a single frame can add to the simulation. */
+   static const long MAX_FRAME_TIME;
+
+   /** The part of each wait (in milliseconds) that is spent spinning instead of sleeping. */
+   static const double SPIN_TIME;
+
+   /** The frames per second to hold the loop to, or 0 if frames aren't capped. */
+   int targetFrameRate;
+
+   /** The length (in milliseconds) of each logic step. */
+   long stepTime;
+
+   /** Whether or not each frame runs exactly one logic step, however long it took. */
+   bool fixedStepping;
+
+   /** The time (in milliseconds on the engine clock) that the last frame began. */
+   double lastFrameTime;
+
+   /** The time (in milliseconds on the engine clock) that the next frame should begin. */
+   double nextFrameTime;
+
+   /** The simulation time (in milliseconds) that has passed, but hasn't been stepped through. */
+   double accumulatedTime;
+
+   /**
+    * @return The time now (in milliseconds on the engine clock).
+    */
+   static double getCurrentTime();
+
+   public:
+      /** The length (in milliseconds) of each logic step, unless it is set otherwise. */
+      static const long DEFAULT_STEP_TIME;
+
+      /** The frame rate that the loop is held to unless it is set otherwise. */
+      static const int DEFAULT_FRAME_RATE;
+
+      /**
+       * Constructor.
+       */
+      FramePacer();
+
+      /**
+       * Sets the frame rate to hold the loop to.
+       *
+       * @param framesPerSecond The target frame rate, or 0 to draw frames as fast as possible.
+       */
+      void setTargetFrameRate(int framesPerSecond);
+
+      /**
+       * @return The frame rate that the loop is held to, or 0 if frames aren't capped.
+       */
+      int getTargetFrameRate() const;
+
+      /**
+       * Sets the length of each logic step. Longer steps run the simulation less often,
+       * which is cheaper on slow machines, without changing how fast it runs.
+       *
+       * @param milliseconds The length of each logic step (in milliseconds).
+       */
+      void setStepTime(long milliseconds);
+
+      /**
+       * @return The length (in milliseconds) of each logic step.
+       */
+      long getStepTime() const;
+
+      /**
+       * Sets whether or not each frame runs exactly one logic step, instead of as many as the time since the last frame calls for.
+       * This ties the simulation to the frame count instead of the clock, so that timing runs draw the same frames
+       * of the same simulation on machines of any speed. The clock's time scale still applies, as a number of steps per frame
+       * (so a scale of 10 runs ten logic steps in every frame).
+       *
+       * @param enabled true iff each frame should run exactly one logic step.
+       */
+      void setFixedStepping(bool enabled);
+
+      /**
+       * Starts a frame, adding the time since the last frame (as scaled by the engine clock) to the simulation time to step through.
+       * The engine clock's snapshot of the frame must be taken first (see EngineClock::beginFrame).
+       */
+      void beginFrame();
+
+      /**
+       * Takes a logic step out of the simulation time, if enough time has built up for one.
+       *
+       * @return true iff a logic step should be run.
+       */
+      bool nextStep();
+
+      /**
+       * @return How far (from 0 to 1) the current frame falls between the last logic step and the next one.
+       */
+      float getInterpolation() const;
+
+      /**
+       * @return The time (in milliseconds) left before the next frame is due under the target frame rate,
+       *         or 0 if frames aren't capped or the next frame is already late.
+       */
+      long getTimeLeftInFrame() const;
+
+      /**
+       * Finishes a frame, waiting until the next frame is due under the target frame rate.
+       */
+      void endFrame();
+
+      /**
+       * Discards the time built up so far, so that time spent away from the loop
+       * (such as loading a new state) isn't simulated.
+       */
+      void reset();
+};
+
+#endif
@@ -0,0 +1,531 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "FrameProfiler.h"
+#include "EngineClock.h"
+#include "GLState.h"
+#include "SDL_opengl.h"
+#include "SDL_thread.h"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_MAIN;
+
+// Four seconds of frames at 60 frames per second, which is as many as the overlay can show side by side
+const int FrameProfiler::FRAME_HISTORY = 240;
+
+// The frame time (in microseconds) that reaches the top of the overlay, which is two frames at 60 frames per second
+static const double OVERLAY_SCALE_TIME = 33333.0;
+
+// The height (in pixels) of the overlay graph
+static const float OVERLAY_HEIGHT = 100.0f;
+
+// The frame time (in microseconds) marked across the overlay, which is one frame at 60 frames per second
+static const double OVERLAY_TARGET_TIME = 16667.0;
+
+bool FrameProfiler::enabled = false;
+bool FrameProfiler::overlayVisible = false;
+unsigned long FrameProfiler::mainThreadId = 0;
+double FrameProfiler::enabledTime = 0;
+std::vector<FrameProfiler::FrameRecord> FrameProfiler::frames;
+int FrameProfiler::currentFrame = 0;
+int FrameProfiler::framesRecorded = 0;
+int FrameProfiler::depth = 0;
+bool FrameProfiler::frameStarted = false;
+double FrameProfiler::hitchThreshold = 0;
+int FrameProfiler::hitchFrameCount = 0;
+std::string FrameProfiler::hitchPathPrefix;
+int FrameProfiler::hitchesWritten = 0;
+int FrameProfiler::framesSinceHitch = 0;
+
+double FrameProfiler::getTime()
+{
+   return EngineClock::getTime() - enabledTime;
+}
+
+void FrameProfiler::setEnabled(bool enable)
+{
+   if(enable && !enabled)
+   {
+      frames.assign(FRAME_HISTORY, FrameRecord());
+      currentFrame = 0;
+      framesRecorded = 0;
+      depth = 0;
+      frameStarted = false;
+      framesSinceHitch = 0;
+      mainThreadId = SDL_ThreadID();
+
+      enabledTime = 0;
+      enabledTime = getTime();
+   }
+
+   enabled = enable;
+}
+
+bool FrameProfiler::isEnabled()
+{
+   return enabled;
+}
+
+void FrameProfiler::setOverlayVisible(bool visible)
+{
+   overlayVisible = visible;
+}
+
+bool FrameProfiler::isOverlayVisible()
+{
+   return overlayVisible;
+}
+
+void FrameProfiler::setHitchDetection(double threshold, int frameCount, const std::string& pathPrefix)
+{
+   hitchThreshold = std::max(threshold, 0.0) * 1000.0;
+   hitchFrameCount = std::max(1, std::min(frameCount, FRAME_HISTORY));
+   hitchPathPrefix = pathPrefix;
+   hitchesWritten = 0;
+   framesSinceHitch = 0;
+
+   if(hitchThreshold > 0)
+   {
+      setEnabled(true);
+   }
+}
+
+double FrameProfiler::getHitchThreshold()
+{
+   return hitchThreshold / 1000.0;
+}
+
+int FrameProfiler::getHitchesWritten()
+{
+   return hitchesWritten;
+}
+
+int FrameProfiler::beginZone(const char* name)
+{
+   // Zones on other threads (such as the resource loaders) would run into the main thread's frames
+   if(SDL_ThreadID() != mainThreadId) return -1;
+
+   ZoneRecord zone;
+   zone.name = name;
+   zone.depth = depth++;
+   zone.startTime = getTime();
+   zone.duration = 0;
+
+   std::vector<ZoneRecord>& zones = frames[currentFrame].zones;
+   zones.push_back(zone);
+   return static_cast<int>(zones.size()) - 1;
+}
+
+void FrameProfiler::endZone(int zoneIndex)
+{
+   --depth;
+
+   // A zone that outlived the profile (or the frame it started in) has nothing left to finish
+   std::vector<ZoneRecord>& zones = frames[currentFrame].zones;
+   if(enabled && zoneIndex < static_cast<int>(zones.size()))
+   {
+      zones[zoneIndex].duration = getTime() - zones[zoneIndex].startTime;
+   }
+}
+
+int FrameProfiler::beginEvent(const char* kind, const char* detail)
+{
+   if(SDL_ThreadID() != mainThreadId) return -1;
+
+   EventRecord event;
+   event.kind = kind;
+   if(detail != NULL)
+   {
+      event.detail = detail;
+   }
+
+   event.startTime = getTime();
+   event.duration = 0;
+
+   std::vector<EventRecord>& events = frames[currentFrame].events;
+   events.push_back(event);
+   return static_cast<int>(events.size()) - 1;
+}
+
+void FrameProfiler::setEventDetail(int eventIndex, const std::string& detail)
+{
+   std::vector<EventRecord>& events = frames[currentFrame].events;
+   if(enabled && eventIndex < static_cast<int>(events.size()))
+   {
+      events[eventIndex].detail = detail;
+   }
+}
+
+void FrameProfiler::endEvent(int eventIndex)
+{
+   // Like zones, an event that outlived its frame has nothing left to finish
+   std::vector<EventRecord>& events = frames[currentFrame].events;
+   if(enabled && eventIndex < static_cast<int>(events.size()))
+   {
+      events[eventIndex].duration = getTime() - events[eventIndex].startTime;
+   }
+}
+
+void FrameProfiler::beginFrame()
+{
+   if(!enabled) return;
+
+   // A frame runs until the next one begins, so that the time spent waiting for the next frame is counted too
+   if(frameStarted)
+   {
+      FrameRecord& finishedFrame = frames[currentFrame];
+      finishedFrame.duration = getTime() - finishedFrame.startTime;
+
+      currentFrame = (currentFrame + 1) % FRAME_HISTORY;
+      framesRecorded = std::min(framesRecorded + 1, FRAME_HISTORY);
+      ++framesSinceHitch;
+
+      // A hitch within the frames written for the last one is already in its trace
+      if(hitchThreshold > 0 && finishedFrame.duration > hitchThreshold && framesSinceHitch >= hitchFrameCount)
+      {
+         std::stringstream path;
+         path << hitchPathPrefix << (hitchesWritten + 1) << ".json";
+         if(writeTrace(path.str(), std::min(hitchFrameCount, framesRecorded), finishedFrame.duration))
+         {
+            LOG_WARNING("Frame took %.1f ms; wrote the %d frames leading up to it to %s", finishedFrame.duration / 1000.0,
+                  std::min(hitchFrameCount, framesRecorded), path.str().c_str());
+            ++hitchesWritten;
+         }
+
+         framesSinceHitch = 0;
+      }
+   }
+
+   FrameRecord& frame = frames[currentFrame];
+   frame.startTime = getTime();
+   frame.duration = 0;
+   frame.zones.clear();
+   frame.gpuPasses.clear();
+   frame.events.clear();
+   frameStarted = true;
+}
+
+void FrameProfiler::recordGpuPass(int framesAgo, const char* name, int passDepth, double startTime, double duration)
+{
+   // The frame that drew the pass may have rolled out of the history, or have been drawn before the profiler was enabled
+   if(!enabled || !frameStarted || framesAgo < 0 || framesAgo > framesRecorded || framesAgo >= FRAME_HISTORY) return;
+
+   FrameRecord& frame = frames[(currentFrame + FRAME_HISTORY - framesAgo) % FRAME_HISTORY];
+
+   ZoneRecord pass;
+   pass.name = name;
+   pass.depth = passDepth;
+   pass.startTime = frame.startTime + startTime;
+   pass.duration = duration;
+   frame.gpuPasses.push_back(pass);
+}
+
+/** The totals recorded for a zone across the recorded frames. */
+struct ZoneStats
+{
+   /** The number of zones that the zone ran inside of. */
+   int depth;
+
+   /** The number of times that the zone ran. */
+   unsigned long runs;
+
+   /** The total time spent in the zone (in microseconds). */
+   double totalTime;
+
+   /** The time taken by the zone's longest run (in microseconds). */
+   double longestTime;
+};
+
+/**
+ * Adds a frame's runs of each zone to the zones' totals.
+ *
+ * @param zones The zones run in the frame (or the render passes drawn for it).
+ * @param statsByZone The totals of each zone, by the zone's name.
+ */
+template<class ZoneList> static void addZoneStats(const ZoneList& zones, std::map<std::string, ZoneStats>& statsByZone)
+{
+   for(typename ZoneList::const_iterator iter = zones.begin(); iter != zones.end(); ++iter)
+   {
+      std::map<std::string, ZoneStats>::iterator stats = statsByZone.find(iter->name);
+      if(stats == statsByZone.end())
+      {
+         ZoneStats newStats = { iter->depth, 0, 0, 0 };
+         stats = statsByZone.insert(std::make_pair(std::string(iter->name), newStats)).first;
+      }
+
+      ++stats->second.runs;
+      stats->second.totalTime += iter->duration;
+      stats->second.longestTime = std::max(stats->second.longestTime, iter->duration);
+   }
+}
+
+/**
+ * Describes the totals of each zone, busiest zone first.
+ *
+ * @param statsByZone The totals of each zone, by the zone's name.
+ * @param framesRecorded The number of frames that the totals were taken over.
+ * @param prefix The text to put before each zone's name.
+ * @param lines The list to add the lines of the description to.
+ */
+static void describeZoneStats(const std::map<std::string, ZoneStats>& statsByZone, int framesRecorded, const std::string& prefix, std::vector<std::string>& lines)
+{
+   std::vector<std::pair<double, std::string> > zonesByTime;
+   for(std::map<std::string, ZoneStats>::const_iterator iter = statsByZone.begin(); iter != statsByZone.end(); ++iter)
+   {
+      zonesByTime.push_back(std::make_pair(iter->second.totalTime, iter->first));
+   }
+
+   std::sort(zonesByTime.begin(), zonesByTime.end(), std::greater<std::pair<double, std::string> >());
+
+   for(std::vector<std::pair<double, std::string> >::const_iterator iter = zonesByTime.begin(); iter != zonesByTime.end(); ++iter)
+   {
+      const ZoneStats& stats = statsByZone.find(iter->second)->second;
+
+      std::stringstream line;
+      line << std::fixed << std::setprecision(3);
+      line << std::string(stats.depth * 2, ' ') << prefix << iter->second << ": "
+           << stats.totalTime / 1000.0 / framesRecorded << " ms per frame, "
+           << stats.runs << " runs, " << stats.longestTime / 1000.0 << " ms longest";
+      lines.push_back(line.str());
+   }
+}
+
+void FrameProfiler::describe(std::vector<std::string>& lines)
+{
+   if(framesRecorded == 0)
+   {
+      lines.push_back("No frames have been recorded.");
+      return;
+   }
+
+   std::map<std::string, ZoneStats> statsByZone;
+   std::map<std::string, ZoneStats> statsByGpuPass;
+   double totalFrameTime = 0;
+   double longestFrameTime = 0;
+
+   for(int i = 0; i < framesRecorded; ++i)
+   {
+      const FrameRecord& frame = frames[(currentFrame + FRAME_HISTORY - 1 - i) % FRAME_HISTORY];
+      totalFrameTime += frame.duration;
+      longestFrameTime = std::max(longestFrameTime, frame.duration);
+
+      addZoneStats(frame.zones, statsByZone);
+      addZoneStats(frame.gpuPasses, statsByGpuPass);
+   }
+
+   std::stringstream summary;
+   summary << std::fixed << std::setprecision(3);
+   summary << framesRecorded << " frames, " << totalFrameTime / 1000.0 / framesRecorded << " ms average, "
+           << longestFrameTime / 1000.0 << " ms longest";
+   lines.push_back(summary.str());
+
+   describeZoneStats(statsByZone, framesRecorded, "", lines);
+   describeZoneStats(statsByGpuPass, framesRecorded, "GPU ", lines);
+}
+
+/**
+ * Picks a colour for a zone out of its name, so that each zone keeps the same colour from frame to frame.
+ *
+ * @param name The name of the zone.
+ */
+static void setZoneColour(const char* name)
+{
+   unsigned int hash = 2166136261u;
+   for(const char* c = name; *c != '\0'; ++c)
+   {
+      hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+   }
+
+   // Keep the colours bright enough to stand out against the map
+   glColor4f(0.3f + (hash & 0xFF) / 365.0f, 0.3f + ((hash >> 8) & 0xFF) / 365.0f, 0.3f + ((hash >> 16) & 0xFF) / 365.0f, 0.8f);
+}
+
+void FrameProfiler::drawOverlay(int width, int height)
+{
+   if(!overlayVisible || !enabled) return;
+
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   const bool blendEnabled = GLState::isBlending();
+
+   GLState::setTexturing(false);
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+   // The modelview matrix may still hold a drawing offset, but the overlay always sits at the bottom of the screen
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   const float barWidth = float(width) / FRAME_HISTORY;
+   const float bottom = float(height);
+   const float pixelsPerMicrosecond = OVERLAY_HEIGHT / OVERLAY_SCALE_TIME;
+
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glColor4f(0.0f, 0.0f, 0.0f, 0.5f);
+      glVertex3f(0.0f, bottom - OVERLAY_HEIGHT, 0.0f);
+      glVertex3f(float(width), bottom - OVERLAY_HEIGHT, 0.0f);
+      glVertex3f(float(width), bottom, 0.0f);
+      glVertex3f(0.0f, bottom, 0.0f);
+
+      // The newest frame is drawn at the right edge
+      for(int i = 0; i < framesRecorded; ++i)
+      {
+         const FrameRecord& frame = frames[(currentFrame + FRAME_HISTORY - 1 - i) % FRAME_HISTORY];
+         const float right = float(width) - i * barWidth;
+         const float left = right - barWidth;
+
+         const float frameTop = bottom - std::min(float(frame.duration) * pixelsPerMicrosecond, OVERLAY_HEIGHT);
+         glColor4f(0.5f, 0.5f, 0.5f, 0.8f);
+         glVertex3f(left, frameTop, 0.0f);
+         glVertex3f(right, frameTop, 0.0f);
+         glVertex3f(right, bottom, 0.0f);
+         glVertex3f(left, bottom, 0.0f);
+
+         // Stack up the zones just under the outermost one, which between them show where the frame went
+         float zoneBottom = bottom;
+         for(std::vector<ZoneRecord>::const_iterator iter = frame.zones.begin(); iter != frame.zones.end(); ++iter)
+         {
+            if(iter->depth != 1) continue;
+
+            const float zoneTop = std::max(zoneBottom - float(iter->duration) * pixelsPerMicrosecond, bottom - OVERLAY_HEIGHT);
+            setZoneColour(iter->name);
+            glVertex3f(left, zoneTop, 0.0f);
+            glVertex3f(right, zoneTop, 0.0f);
+            glVertex3f(right, zoneBottom, 0.0f);
+            glVertex3f(left, zoneBottom, 0.0f);
+            zoneBottom = zoneTop;
+         }
+      }
+
+      const float targetLine = bottom - float(OVERLAY_TARGET_TIME) * pixelsPerMicrosecond;
+      glColor4f(1.0f, 0.2f, 0.2f, 0.8f);
+      glVertex3f(0.0f, targetLine - 1.0f, 0.0f);
+      glVertex3f(float(width), targetLine - 1.0f, 0.0f);
+      glVertex3f(float(width), targetLine, 0.0f);
+      glVertex3f(0.0f, targetLine, 0.0f);
+
+      glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+   glEnd();
+
+   glPopMatrix();
+
+   GLState::setTexturing(true);
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+/**
+ * Writes a string to a JSON file, with quotes and backslashes escaped.
+ *
+ * @param output The file to write to.
+ * @param value The string to write.
+ */
+static void writeJsonString(std::ofstream& output, const char* value)
+{
+   output << '"';
+   for(const char* c = value; *c != '\0'; ++c)
+   {
+      if(*c == '"' || *c == '\\')
+      {
+         output << '\\';
+      }
+
+      output << *c;
+   }
+
+   output << '"';
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string& path)
+{
+   return writeTrace(path, framesRecorded, -1.0);
+}
+
+bool FrameProfiler::writeTrace(const std::string& path, int frameCount, double hitchTime)
+{
+   std::ofstream output(path.c_str(), std::ios::out | std::ios::trunc);
+   if(!output)
+   {
+      DEBUG("Unable to write frame trace to %s.", path.c_str());
+      return false;
+   }
+
+   output << std::fixed << std::setprecision(3);
+   output << "{\"traceEvents\":[";
+   bool firstEvent = true;
+   int eventCount = 0;
+
+   // Write the oldest frame first, so that the events are in order of time
+   for(int i = frameCount - 1; i >= 0; --i)
+   {
+      const FrameRecord& frame = frames[(currentFrame + FRAME_HISTORY - 1 - i) % FRAME_HISTORY];
+
+      output << (firstEvent ? "\n" : ",\n");
+      output << "{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << frame.startTime
+             << ",\"dur\":" << frame.duration << "}";
+      firstEvent = false;
+      ++eventCount;
+
+      for(std::vector<ZoneRecord>::const_iterator iter = frame.zones.begin(); iter != frame.zones.end(); ++iter)
+      {
+         output << ",\n{\"name\":";
+         writeJsonString(output, iter->name);
+         output << ",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << iter->startTime
+                << ",\"dur\":" << iter->duration << "}";
+         ++eventCount;
+      }
+
+      // The GPU's passes go on a track of their own, since they overlap the zones that drew them
+      for(std::vector<ZoneRecord>::const_iterator iter = frame.gpuPasses.begin(); iter != frame.gpuPasses.end(); ++iter)
+      {
+         output << ",\n{\"name\":";
+         writeJsonString(output, iter->name);
+         output << ",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":" << iter->startTime
+                << ",\"dur\":" << iter->duration << "}";
+         ++eventCount;
+      }
+
+      // Events nest inside the zones they happened in, with what they were about kept in their arguments
+      for(std::vector<EventRecord>::const_iterator iter = frame.events.begin(); iter != frame.events.end(); ++iter)
+      {
+         output << ",\n{\"name\":";
+         writeJsonString(output, iter->kind);
+         output << ",\"cat\":\"event\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << iter->startTime
+                << ",\"dur\":" << iter->duration << ",\"args\":{\"detail\":";
+         writeJsonString(output, iter->detail.c_str());
+         output << "}}";
+         ++eventCount;
+      }
+   }
+
+   output << "\n]";
+   if(hitchTime >= 0)
+   {
+      // Trace viewers show the trace's other data alongside it, so the hitch is described there
+      output << ",\"otherData\":{\"hitchFrameTime\":" << hitchTime / 1000.0 << ",\"hitchThreshold\":" << hitchThreshold / 1000.0 << "}";
+   }
+
+   output << "}\n";
+
+   if(!output)
+   {
+      DEBUG("Unable to write frame trace to %s.", path.c_str());
+      return false;
+   }
+
+   DEBUG("Wrote %d frame trace events to %s.", eventCount, path.c_str());
+   return true;
+}
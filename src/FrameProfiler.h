@@ -0,0 +1,367 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <string>
+#include <vector>
+
+#define PROFILE_ZONE_NAME_JOIN(name, line) name ## line
+#define PROFILE_ZONE_NAME(line) PROFILE_ZONE_NAME_JOIN(profileZone, line)
+
+/**
+ * Times the rest of the enclosing scope as a zone of the current frame, under the given name
+ * (which must be a string literal, since only its pointer is kept).
+ */
+#define PROFILE_ZONE(name) FrameProfiler::Zone PROFILE_ZONE_NAME(__LINE__)(name)
+
+/**
+ * Times the rest of the enclosing scope as an event of the current frame, of the given kind (a string literal)
+ * and about the given detail (such as the key of the resource being loaded), which is copied.
+ */
+#define PROFILE_EVENT(kind, detail) FrameProfiler::Event PROFILE_ZONE_NAME(__LINE__)(kind, detail)
+
+/**
+ * Measures where the time goes in each frame, by timing named zones of the engine's code (marked out with PROFILE_ZONE).
+ *
+ * While the profiler is enabled, it records the start and length of every zone entered on the main thread
+ * for each of the last FRAME_HISTORY frames. Zones can be nested, and each zone remembers how deeply it was nested.
+ * The recorded frames can be summed up by zone (such as in the debug console), shown as an overlay graph of
+ * frame times along the bottom of the screen, or written out as a Chrome trace (which can be opened in chrome://tracing,
+ * or imported into Tracy) to see how the zones of each frame line up.
+ *
+ * The GPU's time on each render pass (see GPUPassTimer) is recorded alongside the zones, against the frame that drew it,
+ * once it has been read back from the GPU a few frames later.
+ *
+ * Along with the zones, the profiler records events: the work that a frame's time can't be put down to without
+ * knowing what it was done on, such as a resource loaded in the middle of the frame (and its key), a script resumed
+ * (and its name) or a step of the garbage collector. Events are marked out with PROFILE_EVENT, or with an Event whose detail is
+ * only filled in while it is being recorded.
+ *
+ * The profiler can also watch for hitches: once a frame takes longer than a threshold, the frames leading up to it
+ * (with their zones and events) are written out as a Chrome trace of their own, so that every hitch comes with its cause.
+ *
+ * A disabled profiler costs nothing but a check of whether or not it is enabled as each zone is entered.
+ */
+class FrameProfiler
+{
+   friend class ProfileServer;
+
+   /** The number of frames that are kept. */
+   static const int FRAME_HISTORY;
+
+   /** A single run of a zone. */
+   struct ZoneRecord
+   {
+      /** The name of the zone. */
+      const char* name;
+
+      /** The number of zones that the zone ran inside of. */
+      int depth;
+
+      /** When the zone started (in microseconds since the profiler was enabled). */
+      double startTime;
+
+      /** How long the zone took (in microseconds). */
+      double duration;
+   };
+
+   /** A single event. */
+   struct EventRecord
+   {
+      /** The kind of the event. */
+      const char* kind;
+
+      /** What the event was about, or an empty string if it wasn't given. */
+      std::string detail;
+
+      /** When the event started (in microseconds since the profiler was enabled). */
+      double startTime;
+
+      /** How long the event took (in microseconds). */
+      double duration;
+   };
+
+   /** The zones run during a frame. */
+   struct FrameRecord
+   {
+      /** When the frame started (in microseconds since the profiler was enabled). */
+      double startTime;
+
+      /** How long the frame took (in microseconds), or 0 if it hasn't finished. */
+      double duration;
+
+      /** The zones run during the frame, in the order that they were entered. */
+      std::vector<ZoneRecord> zones;
+
+      /** The render passes drawn by the GPU for the frame, placed from the start of the frame, in the order that they started. */
+      std::vector<ZoneRecord> gpuPasses;
+
+      /** The events during the frame, in the order that they started. */
+      std::vector<EventRecord> events;
+   };
+
+   /** Whether or not zones are being recorded. */
+   static bool enabled;
+
+   /** Whether or not the overlay graph is drawn. */
+   static bool overlayVisible;
+
+   /** The thread that zones are recorded on. */
+   static unsigned long mainThreadId;
+
+   /** The time at which the profiler was enabled (in microseconds, measured from an arbitrary point). */
+   static double enabledTime;
+
+   /** The recorded frames, kept in a ring. */
+   static std::vector<FrameRecord> frames;
+
+   /** The index in the ring of the frame being recorded. */
+   static int currentFrame;
+
+   /** The number of frames that have been recorded, up to FRAME_HISTORY. */
+   static int framesRecorded;
+
+   /** The number of zones that the profiler is inside of. */
+   static int depth;
+
+   /** Whether or not a frame is being recorded. */
+   static bool frameStarted;
+
+   /** The frame time (in microseconds) past which a frame counts as a hitch, or 0 if hitches aren't being watched for. */
+   static double hitchThreshold;
+
+   /** The number of frames (ending with the hitch) written out for each hitch. */
+   static int hitchFrameCount;
+
+   /** The start of the path that hitches are written to, which is followed by the hitch's number and .json. */
+   static std::string hitchPathPrefix;
+
+   /** The number of hitches written out since hitches started being watched for. */
+   static int hitchesWritten;
+
+   /** The number of frames finished since the last hitch was written out, so that the frames written for each hitch don't overlap. */
+   static int framesSinceHitch;
+
+   /**
+    * @return The current time (in microseconds since the profiler was enabled).
+    */
+   static double getTime();
+
+   /**
+    * Starts recording a zone.
+    *
+    * @param name The name of the zone.
+    *
+    * @return The index of the zone in the current frame, or -1 if the zone isn't recorded.
+    */
+   static int beginZone(const char* name);
+
+   /**
+    * Finishes recording a zone.
+    *
+    * @param zoneIndex The index of the zone in the current frame.
+    */
+   static void endZone(int zoneIndex);
+
+   /**
+    * Starts recording an event.
+    *
+    * @param kind The kind of the event.
+    * @param detail What the event is about, or NULL.
+    *
+    * @return The index of the event in the current frame, or -1 if the event isn't recorded.
+    */
+   static int beginEvent(const char* kind, const char* detail);
+
+   /**
+    * Sets what an event being recorded is about.
+    *
+    * @param eventIndex The index of the event in the current frame.
+    * @param detail What the event is about.
+    */
+   static void setEventDetail(int eventIndex, const std::string& detail);
+
+   /**
+    * Finishes recording an event.
+    *
+    * @param eventIndex The index of the event in the current frame.
+    */
+   static void endEvent(int eventIndex);
+
+   /**
+    * Writes the latest recorded frames out as a Chrome trace (in the Trace Event JSON format).
+    *
+    * @param path The path of the file to write.
+    * @param frameCount The number of frames to write, ending with the latest finished frame.
+    * @param hitchTime The time (in microseconds) that the latest frame took, if it is being written as a hitch, or a negative number otherwise.
+    *
+    * @return true iff the trace was written.
+    */
+   static bool writeTrace(const std::string& path, int frameCount, double hitchTime);
+
+   public:
+      /**
+       * Times a zone for as long as it lives (see PROFILE_ZONE).
+       */
+      class Zone
+      {
+         /** The index of the zone in the current frame, or -1 if it isn't recorded. */
+         int zoneIndex;
+
+         /** Zones can't be copied. */
+         Zone(const Zone&);
+
+         /** Zones can't be copied. */
+         Zone& operator=(const Zone&);
+
+         public:
+            /**
+             * Constructor. Starts timing the zone.
+             *
+             * @param name The name of the zone, which must outlive the profile (such as a string literal).
+             */
+            Zone(const char* name) : zoneIndex(enabled ? beginZone(name) : -1) {}
+
+            /**
+             * Destructor. Stops timing the zone.
+             */
+            ~Zone() { if(zoneIndex >= 0) endZone(zoneIndex); }
+      };
+
+      /**
+       * Times an event for as long as it lives (see PROFILE_EVENT).
+       */
+      class Event
+      {
+         /** The index of the event in the current frame, or -1 if it isn't recorded. */
+         int eventIndex;
+
+         /** Events can't be copied. */
+         Event(const Event&);
+
+         /** Events can't be copied. */
+         Event& operator=(const Event&);
+
+         public:
+            /**
+             * Constructor. Starts timing the event.
+             *
+             * @param kind The kind of the event, which must outlive the profile (such as a string literal).
+             * @param detail What the event is about, or NULL to leave it to setDetail.
+             */
+            Event(const char* kind, const char* detail = NULL) : eventIndex(enabled ? beginEvent(kind, detail) : -1) {}
+
+            /**
+             * @return true iff the event is being recorded, so that working out its detail is worthwhile.
+             */
+            bool isRecorded() const { return eventIndex >= 0; }
+
+            /**
+             * Sets what the event is about, if it is being recorded.
+             *
+             * @param detail What the event is about.
+             */
+            void setDetail(const std::string& detail) { if(eventIndex >= 0) setEventDetail(eventIndex, detail); }
+
+            /**
+             * Destructor. Stops timing the event.
+             */
+            ~Event() { if(eventIndex >= 0) endEvent(eventIndex); }
+      };
+
+      /**
+       * Starts or stops recording zones. Enabling the profiler clears what was recorded before,
+       * and makes the calling thread the one that zones are recorded on.
+       *
+       * @param enable true to start recording, false to stop.
+       */
+      static void setEnabled(bool enable);
+
+      /**
+       * @return true iff zones are being recorded.
+       */
+      static bool isEnabled();
+
+      /**
+       * Shows or hides the overlay graph of frame times.
+       *
+       * @param visible true to show the overlay.
+       */
+      static void setOverlayVisible(bool visible);
+
+      /**
+       * @return true iff the overlay graph is shown.
+       */
+      static bool isOverlayVisible();
+
+      /**
+       * Starts or stops watching for hitches. Watching for hitches enables the profiler, since it records the frames
+       * that are written out. Each hitch is written to the path prefix followed by the hitch's number (from 1) and .json.
+       *
+       * @param threshold The frame time (in milliseconds) past which a frame counts as a hitch, or 0 to stop watching for hitches.
+       * @param frameCount The number of frames (ending with the hitch) to write out for each hitch, up to the number of frames kept.
+       * @param pathPrefix The start of the path to write each hitch to.
+       */
+      static void setHitchDetection(double threshold, int frameCount, const std::string& pathPrefix);
+
+      /**
+       * @return The frame time (in milliseconds) past which a frame counts as a hitch, or 0 if hitches aren't being watched for.
+       */
+      static double getHitchThreshold();
+
+      /**
+       * @return The number of hitches written out since hitches started being watched for.
+       */
+      static int getHitchesWritten();
+
+      /**
+       * Marks the start of a frame, which also finishes the frame before it.
+       * Zones entered from now on belong to the new frame.
+       */
+      static void beginFrame();
+
+      /**
+       * Records the GPU's time on a render pass, against the frame that drew it.
+       * Passes drawn before the oldest recorded frame (or before the profiler was enabled) are left out.
+       *
+       * @param framesAgo The number of frames before the current frame that the pass was drawn in (0 for the current frame).
+       * @param name The name of the pass (which must be a string literal, since only its pointer is kept).
+       * @param depth The number of passes that the pass ran inside of.
+       * @param startTime When the pass started on the GPU (in microseconds since the frame's first pass started).
+       * @param duration How long the GPU took on the pass (in microseconds).
+       */
+      static void recordGpuPass(int framesAgo, const char* name, int depth, double startTime, double duration);
+
+      /**
+       * Describes the time taken by each zone in the recorded frames, busiest zone first,
+       * followed by the GPU's time on each render pass.
+       *
+       * @param lines The list to add the lines of the description to.
+       */
+      static void describe(std::vector<std::string>& lines);
+
+      /**
+       * Draws a graph of the recorded frame times along the bottom of the screen, with the outermost zones
+       * of each frame stacked up in their own colours.
+       *
+       * @param width The width of the screen.
+       * @param height The height of the screen.
+       */
+      static void drawOverlay(int width, int height);
+
+      /**
+       * Writes the recorded frames out as a Chrome trace (in the Trace Event JSON format).
+       *
+       * @param path The path of the file to write.
+       *
+       * @return true iff the trace was written.
+       */
+      static bool writeChromeTrace(const std::string& path);
+};
+
+#endif
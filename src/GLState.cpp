@@ -0,0 +1,162 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "GLState.h"
+#include "SDL_opengl.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+GLuint GLState::boundTexture = 0;
+bool GLState::boundTextureKnown = false;
+int GLState::texturing = -1;
+int GLState::blending = -1;
+GLenum GLState::blendSource = GL_ONE;
+GLenum GLState::blendDestination = GL_ZERO;
+bool GLState::blendFunctionKnown = false;
+GLint GLState::textureMode = GL_MODULATE;
+bool GLState::textureModeKnown = false;
+int GLState::vertexArrays = -1;
+unsigned long GLState::drawCallCount = 0;
+unsigned long GLState::textureBindCount = 0;
+
+void GLState::invalidate()
+{
+   boundTextureKnown = false;
+   texturing = -1;
+   blending = -1;
+   blendFunctionKnown = false;
+   textureModeKnown = false;
+   vertexArrays = -1;
+}
+
+void GLState::bindTexture(GLuint texture)
+{
+   if(!boundTextureKnown || boundTexture != texture)
+   {
+      glBindTexture(GL_TEXTURE_2D, texture);
+      boundTexture = texture;
+      boundTextureKnown = true;
+      ++textureBindCount;
+   }
+}
+
+void GLState::setTexturing(bool enabled)
+{
+   if(texturing != int(enabled))
+   {
+      if(enabled) glEnable(GL_TEXTURE_2D);
+      else glDisable(GL_TEXTURE_2D);
+      texturing = enabled;
+   }
+}
+
+bool GLState::isTexturing()
+{
+   if(texturing < 0)
+   {
+      // Only query the driver when nothing has been set since the state was last forgotten
+      texturing = glIsEnabled(GL_TEXTURE_2D) ? 1 : 0;
+   }
+
+   return texturing == 1;
+}
+
+void GLState::setBlending(bool enabled)
+{
+   if(blending != int(enabled))
+   {
+      if(enabled) glEnable(GL_BLEND);
+      else glDisable(GL_BLEND);
+      blending = enabled;
+   }
+}
+
+bool GLState::isBlending()
+{
+   if(blending < 0)
+   {
+      blending = glIsEnabled(GL_BLEND) ? 1 : 0;
+   }
+
+   return blending == 1;
+}
+
+void GLState::setBlendFunction(GLenum source, GLenum destination)
+{
+   if(!blendFunctionKnown || blendSource != source || blendDestination != destination)
+   {
+      glBlendFunc(source, destination);
+      blendSource = source;
+      blendDestination = destination;
+      blendFunctionKnown = true;
+   }
+}
+
+void GLState::forgetBlendFunction()
+{
+   blendFunctionKnown = false;
+}
+
+void GLState::getBlendFunction(GLenum& source, GLenum& destination)
+{
+   if(!blendFunctionKnown)
+   {
+      GLint queriedSource, queriedDestination;
+      glGetIntegerv(GL_BLEND_SRC, &queriedSource);
+      glGetIntegerv(GL_BLEND_DST, &queriedDestination);
+      blendSource = queriedSource;
+      blendDestination = queriedDestination;
+      blendFunctionKnown = true;
+   }
+
+   source = blendSource;
+   destination = blendDestination;
+}
+
+void GLState::setTextureMode(GLint mode)
+{
+   if(!textureModeKnown || textureMode != mode)
+   {
+      glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, mode);
+      textureMode = mode;
+      textureModeKnown = true;
+   }
+}
+
+void GLState::setVertexArrays(bool enabled)
+{
+   if(vertexArrays != int(enabled))
+   {
+      if(enabled)
+      {
+         glEnableClientState(GL_VERTEX_ARRAY);
+         glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+      }
+      else
+      {
+         glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+         glDisableClientState(GL_VERTEX_ARRAY);
+      }
+
+      vertexArrays = enabled;
+   }
+}
+
+void GLState::countDrawCall()
+{
+   ++drawCallCount;
+}
+
+unsigned long GLState::getDrawCallCount()
+{
+   return drawCallCount;
+}
+
+unsigned long GLState::getTextureBindCount()
+{
+   return textureBindCount;
+}
@@ -0,0 +1,149 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+typedef unsigned int GLuint;
+typedef unsigned int GLenum;
+typedef int GLint;
+
+/**
+ * Keeps track of the OpenGL state that the engine changes as it draws (the bound texture, texturing,
+ * blending and the texture environment), so that setting state that is already in effect costs nothing,
+ * and so that the state can be read back without querying the driver, which stalls the pipeline.
+ *
+ * The engine's drawing code should change this state through GLState rather than calling OpenGL directly.
+ * Code that calls OpenGL directly (such as Guichan, which restores the state it changes when it is done drawing
+ * the GUI, but binds textures whenever it loads an image) leaves the tracked state stale, so it is
+ * forgotten at the start of every frame with invalidate().
+ */
+class GLState
+{
+   /** The texture bound to GL_TEXTURE_2D, if it is known. */
+   static GLuint boundTexture;
+
+   /** Whether or not the bound texture is known. */
+   static bool boundTextureKnown;
+
+   /** 1 if GL_TEXTURE_2D is enabled, 0 if it is disabled and -1 if it isn't known. */
+   static int texturing;
+
+   /** 1 if GL_BLEND is enabled, 0 if it is disabled and -1 if it isn't known. */
+   static int blending;
+
+   /** The source and destination blend factors, if they are known. */
+   static GLenum blendSource, blendDestination;
+
+   /** Whether or not the blend factors are known. */
+   static bool blendFunctionKnown;
+
+   /** The texture environment mode, if it is known. */
+   static GLint textureMode;
+
+   /** Whether or not the texture environment mode is known. */
+   static bool textureModeKnown;
+
+   /** Whether or not the vertex and texture coordinate arrays are enabled, if it is known. */
+   static int vertexArrays;
+
+   /** The number of draw calls made by the engine's drawing code since the program started. */
+   static unsigned long drawCallCount;
+
+   /** The number of textures bound through bindTexture since the program started (binds that were skipped aren't counted). */
+   static unsigned long textureBindCount;
+
+   public:
+      /**
+       * Forgets all of the tracked state, so that the next change to each part of it goes straight to OpenGL.
+       */
+      static void invalidate();
+
+      /**
+       * Binds a texture to GL_TEXTURE_2D, unless it is already bound.
+       *
+       * @param texture The texture to bind.
+       */
+      static void bindTexture(GLuint texture);
+
+      /**
+       * Enables or disables GL_TEXTURE_2D, unless it is already in that state.
+       *
+       * @param enabled true iff texturing should be enabled.
+       */
+      static void setTexturing(bool enabled);
+
+      /**
+       * @return true iff GL_TEXTURE_2D is enabled.
+       */
+      static bool isTexturing();
+
+      /**
+       * Enables or disables GL_BLEND, unless it is already in that state.
+       *
+       * @param enabled true iff blending should be enabled.
+       */
+      static void setBlending(bool enabled);
+
+      /**
+       * @return true iff GL_BLEND is enabled.
+       */
+      static bool isBlending();
+
+      /**
+       * Sets the blend factors, unless they are already in effect.
+       *
+       * @param source The source blend factor.
+       * @param destination The destination blend factor.
+       */
+      static void setBlendFunction(GLenum source, GLenum destination);
+
+      /**
+       * Forgets the tracked blend factors, after they have been changed without going through GLState
+       * (such as by a separate alpha blend function).
+       */
+      static void forgetBlendFunction();
+
+      /**
+       * Gets the blend factors in effect.
+       *
+       * @param source The parameter used to return the source blend factor.
+       * @param destination The parameter used to return the destination blend factor.
+       */
+      static void getBlendFunction(GLenum& source, GLenum& destination);
+
+      /**
+       * Sets the texture environment mode (such as GL_REPLACE or GL_MODULATE), unless it is already in effect.
+       *
+       * @param mode The texture environment mode.
+       */
+      static void setTextureMode(GLint mode);
+
+      /**
+       * Enables or disables the vertex and texture coordinate arrays used by vertex buffers,
+       * unless they are already in that state.
+       *
+       * @param enabled true iff the arrays should be enabled.
+       */
+      static void setVertexArrays(bool enabled);
+
+      /**
+       * Counts a draw call (a glBegin/glEnd block or a glDrawArrays call) made by the engine's drawing code.
+       */
+      static void countDrawCall();
+
+      /**
+       * @return The number of draw calls counted since the program started.
+       */
+      static unsigned long getDrawCallCount();
+
+      /**
+       * @return The number of textures bound through bindTexture since the program started.
+       */
+      static unsigned long getTextureBindCount();
+};
+
+#endif
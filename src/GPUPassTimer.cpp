@@ -0,0 +1,222 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "GPUPassTimer.h"
+#include "GraphicsUtil.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+
+// The timestamp functions came after the OpenGL headers that SDL ships with, so they are declared here
+typedef void (APIENTRY* QueryCounterFunction)(GLuint id, GLenum target);
+typedef void (APIENTRY* GetQueryObjectui64vFunction)(GLuint id, GLenum pname, Uint64* params);
+
+bool GPUPassTimer::functionsLoaded = false;
+bool GPUPassTimer::queriesSupported = false;
+GLuint GPUPassTimer::queries[FRAME_LATENCY][MAX_PASSES * 2];
+GPUPassTimer::FrameRecord GPUPassTimer::frames[FRAME_LATENCY];
+int GPUPassTimer::currentFrame = 0;
+unsigned long GPUPassTimer::submittedFrames = 0;
+int GPUPassTimer::depth = 0;
+bool GPUPassTimer::measuring = true;
+std::vector<std::pair<std::string, double> > GPUPassTimer::lastTimes;
+
+// The query functions aren't part of OpenGL 1.1, so they have to be looked up from the driver
+static PFNGLGENQUERIESARBPROC genQueries = NULL;
+static PFNGLDELETEQUERIESARBPROC deleteQueries = NULL;
+static PFNGLGETQUERYOBJECTUIVARBPROC getQueryObjectuiv = NULL;
+static QueryCounterFunction queryCounter = NULL;
+static GetQueryObjectui64vFunction getQueryObjectui64v = NULL;
+
+void GPUPassTimer::loadFunctions()
+{
+   functionsLoaded = true;
+
+   const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+   if(extensions == NULL || strstr(extensions, "GL_ARB_timer_query") == NULL)
+   {
+      DEBUG("Timestamp queries are not supported; the GPU's time on each render pass won't be measured.");
+      return;
+   }
+
+   genQueries = reinterpret_cast<PFNGLGENQUERIESARBPROC>(GraphicsUtil::getProcAddress("glGenQueriesARB"));
+   deleteQueries = reinterpret_cast<PFNGLDELETEQUERIESARBPROC>(GraphicsUtil::getProcAddress("glDeleteQueriesARB"));
+   getQueryObjectuiv = reinterpret_cast<PFNGLGETQUERYOBJECTUIVARBPROC>(GraphicsUtil::getProcAddress("glGetQueryObjectuivARB"));
+   queryCounter = reinterpret_cast<QueryCounterFunction>(GraphicsUtil::getProcAddress("glQueryCounter"));
+   getQueryObjectui64v = reinterpret_cast<GetQueryObjectui64vFunction>(GraphicsUtil::getProcAddress("glGetQueryObjectui64v"));
+
+   queriesSupported = genQueries != NULL && deleteQueries != NULL && getQueryObjectuiv != NULL && queryCounter != NULL && getQueryObjectui64v != NULL;
+   DEBUG("Timestamp queries are %s", queriesSupported ? "supported" : "missing functions; the GPU's time on each render pass won't be measured.");
+}
+
+bool GPUPassTimer::isSupported()
+{
+   if(!functionsLoaded)
+   {
+      loadFunctions();
+   }
+
+   return queriesSupported;
+}
+
+int GPUPassTimer::beginPass(const char* name)
+{
+   if(!isSupported() || !measuring) return -1;
+
+   FrameRecord& frame = frames[currentFrame];
+   if(frame.passCount == MAX_PASSES) return -1;
+
+   if(queries[0][0] == 0)
+   {
+      genQueries(FRAME_LATENCY * MAX_PASSES * 2, &queries[0][0]);
+   }
+
+   const int passIndex = frame.passCount++;
+   frame.passes[passIndex].name = name;
+   frame.passes[passIndex].depth = depth++;
+   queryCounter(queries[currentFrame][passIndex * 2], GL_TIMESTAMP);
+   frame.lastQuery = passIndex * 2;
+   return passIndex;
+}
+
+void GPUPassTimer::endPass(int passIndex)
+{
+   --depth;
+
+   queryCounter(queries[currentFrame][passIndex * 2 + 1], GL_TIMESTAMP);
+   frames[currentFrame].lastQuery = passIndex * 2 + 1;
+}
+
+void GPUPassTimer::readFrame(FrameRecord& frame, const GLuint* frameQueries)
+{
+   // The profiler's current frame is the one being submitted, which was numbered one less than the frames submitted so far
+   const int framesAgo = static_cast<int>(submittedFrames - 1 - frame.frameNumber);
+
+   // The first pass started before any of the others, so the passes are placed in the frame from its start
+   Uint64 frameStart = 0;
+   getQueryObjectui64v(frameQueries[0], GL_QUERY_RESULT_ARB, &frameStart);
+
+   lastTimes.clear();
+   for(int i = 0; i < frame.passCount; ++i)
+   {
+      Uint64 start = 0;
+      Uint64 end = 0;
+      getQueryObjectui64v(frameQueries[i * 2], GL_QUERY_RESULT_ARB, &start);
+      getQueryObjectui64v(frameQueries[i * 2 + 1], GL_QUERY_RESULT_ARB, &end);
+
+      // The timestamps are in nanoseconds, and the profiler keeps microseconds
+      const double duration = end > start ? double(end - start) / 1000.0 : 0.0;
+      const PassRecord& pass = frame.passes[i];
+      FrameProfiler::recordGpuPass(framesAgo, pass.name, pass.depth, double(start - frameStart) / 1000.0, duration);
+
+      std::vector<std::pair<std::string, double> >::iterator iter = lastTimes.begin();
+      while(iter != lastTimes.end() && iter->first != pass.name)
+      {
+         ++iter;
+      }
+
+      if(iter == lastTimes.end())
+      {
+         lastTimes.push_back(std::make_pair(std::string(pass.name), duration / 1000.0));
+      }
+      else
+      {
+         iter->second += duration / 1000.0;
+      }
+   }
+}
+
+void GPUPassTimer::endFrame()
+{
+   if(!isSupported()) return;
+
+   FrameRecord& frame = frames[currentFrame];
+   if(measuring && frame.passCount > 0)
+   {
+      frame.frameNumber = submittedFrames;
+      frame.pending = true;
+   }
+
+   ++submittedFrames;
+
+   // The frames finish in the order they were submitted, starting with the one after the current frame, so the first one that isn't ready holds up the rest
+   for(int i = 1; i <= FRAME_LATENCY; ++i)
+   {
+      const int frameIndex = (currentFrame + i) % FRAME_LATENCY;
+      FrameRecord& waitingFrame = frames[frameIndex];
+      if(!waitingFrame.pending) continue;
+
+      // The query taken last is the last one that the GPU finishes
+      GLuint available = 0;
+      getQueryObjectuiv(queries[frameIndex][waitingFrame.lastQuery], GL_QUERY_RESULT_AVAILABLE_ARB, &available);
+      if(!available) break;
+
+      readFrame(waitingFrame, queries[frameIndex]);
+      waitingFrame.pending = false;
+   }
+
+   currentFrame = (currentFrame + 1) % FRAME_LATENCY;
+   depth = 0;
+
+   // If the GPU is still on the frame that last used the next frame's queries, the next frame goes unmeasured instead of waiting on it
+   FrameRecord& nextFrame = frames[currentFrame];
+   measuring = !nextFrame.pending;
+   if(measuring)
+   {
+      nextFrame.passCount = 0;
+   }
+}
+
+void GPUPassTimer::describe(std::vector<std::string>& lines)
+{
+   if(!isSupported())
+   {
+      lines.push_back("GPU: timestamp queries are not supported");
+      return;
+   }
+
+   if(lastTimes.empty())
+   {
+      lines.push_back("GPU: no passes measured yet");
+      return;
+   }
+
+   std::stringstream line;
+   line << std::fixed << std::setprecision(2) << "GPU:";
+   for(std::vector<std::pair<std::string, double> >::const_iterator iter = lastTimes.begin(); iter != lastTimes.end(); ++iter)
+   {
+      line << (iter == lastTimes.begin() ? " " : ", ") << iter->first << ' ' << iter->second << " ms";
+   }
+
+   lines.push_back(line.str());
+}
+
+void GPUPassTimer::releaseQueries()
+{
+   if(queries[0][0] != 0)
+   {
+      deleteQueries(FRAME_LATENCY * MAX_PASSES * 2, &queries[0][0]);
+      memset(queries, 0, sizeof(queries));
+   }
+
+   for(int i = 0; i < FRAME_LATENCY; ++i)
+   {
+      frames[i].passCount = 0;
+      frames[i].pending = false;
+   }
+
+   measuring = true;
+   lastTimes.clear();
+}
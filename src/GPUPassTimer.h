@@ -0,0 +1,180 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef GPU_PASS_TIMER_H
+#define GPU_PASS_TIMER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "FrameProfiler.h"
+
+typedef unsigned int GLuint;
+
+#define PROFILE_GPU_PASS(name) GPUPassTimer::Pass PROFILE_ZONE_NAME(__LINE__)(name)
+
+/**
+ * Measures how long the GPU spends on each render pass of a frame (such as the map layers, sprites, GUI and text uploads),
+ * so that a slow frame can be told apart as GPU-bound or CPU-bound. Passes are marked with PROFILE_GPU_PASS, much like
+ * FrameProfiler's zones; a pass that runs more than once in a frame (such as the sprite batch's flushes) is added up.
+ *
+ * Each pass is bracketed by a pair of timestamp queries, which can be taken inside the GPUTimer's measurement of the whole frame
+ * and inside each other. The GPU draws behind the CPU, so a frame's passes are only read back once the driver has finished
+ * the frame (a few frames later), and the CPU never waits on them. The measurements are handed to the FrameProfiler
+ * against the frame that issued them, and the latest frame's are kept for the performance HUD.
+ *
+ * Timestamp queries need GL_ARB_timer_query from the driver; where it is missing (even if GL_EXT_timer_query is there,
+ * whose queries can't nest), isSupported() is false and passes aren't measured. Passes may only be marked
+ * on the main thread, while the OpenGL context is current.
+ */
+class GPUPassTimer
+{
+   /** The number of frames whose passes can be waiting on the GPU at once. */
+   static const int FRAME_LATENCY = 4;
+
+   /** The most passes measured in a frame; passes past it go unmeasured. */
+   static const int MAX_PASSES = 32;
+
+   /** A pass measured in a frame. */
+   struct PassRecord
+   {
+      /** The name of the pass. */
+      const char* name;
+
+      /** The number of passes that the pass ran inside of. */
+      int depth;
+   };
+
+   /** The passes measured in a frame, waiting on the GPU. */
+   struct FrameRecord
+   {
+      /** Which frame the passes were measured in, counted from the first frame submitted. */
+      unsigned long frameNumber;
+
+      /** The passes, in the order they started. */
+      PassRecord passes[MAX_PASSES];
+
+      /** The number of passes. */
+      int passCount;
+
+      /** The query taken last in the frame. */
+      int lastQuery;
+
+      /** Whether or not the passes were submitted, and haven't been read back yet. */
+      bool pending;
+   };
+
+   /** Whether or not the timestamp query functions have been looked up. */
+   static bool functionsLoaded;
+
+   /** Whether or not the driver supports timestamp queries. */
+   static bool queriesSupported;
+
+   /** The queries that the passes' start and end times are taken with (two for each pass), or 0s if they haven't been created. */
+   static GLuint queries[FRAME_LATENCY][MAX_PASSES * 2];
+
+   /** The passes of each frame waiting on the GPU (or being measured). */
+   static FrameRecord frames[FRAME_LATENCY];
+
+   /** The frame that passes are being measured in. */
+   static int currentFrame;
+
+   /** The number of frames submitted. */
+   static unsigned long submittedFrames;
+
+   /** The number of passes begun and not yet ended. */
+   static int depth;
+
+   /** Whether or not the current frame's passes are being measured, which they aren't if every frame's queries are still on the GPU. */
+   static bool measuring;
+
+   /** The time (in milliseconds) that each pass took in the latest frame read back, in the order that the passes first ran. */
+   static std::vector<std::pair<std::string, double> > lastTimes;
+
+   /**
+    * Looks up the timestamp query functions, if the driver supports them.
+    */
+   static void loadFunctions();
+
+   /**
+    * Starts measuring a pass.
+    *
+    * @param name The name of the pass, which must outlive the frame.
+    *
+    * @return The index of the pass's record in the current frame, or -1 if the pass isn't being measured.
+    */
+   static int beginPass(const char* name);
+
+   /**
+    * Finishes measuring a pass.
+    *
+    * @param passIndex The index returned by beginPass.
+    */
+   static void endPass(int passIndex);
+
+   /**
+    * Reads back the passes of a frame that the GPU has finished, and hands them to the FrameProfiler.
+    *
+    * @param frame The frame's record.
+    * @param frameQueries The frame's queries.
+    */
+   static void readFrame(FrameRecord& frame, const GLuint* frameQueries);
+
+   public:
+      /**
+       * Measures a render pass from its construction until it goes out of scope.
+       * Use PROFILE_GPU_PASS to declare one.
+       */
+      class Pass
+      {
+         /** The index of the pass's record, or -1 if it isn't being measured. */
+         int passIndex;
+
+         /** Passes can't be copied. */
+         Pass(const Pass&);
+
+         /** Passes can't be copied. */
+         Pass& operator=(const Pass&);
+
+         public:
+            /**
+             * Constructor. Starts measuring the pass.
+             *
+             * @param name The name of the pass, which must outlive the frame (a string literal).
+             */
+            Pass(const char* name) : passIndex(beginPass(name)) {}
+
+            /**
+             * Destructor. Finishes measuring the pass.
+             */
+            ~Pass() { if(passIndex >= 0) endPass(passIndex); }
+      };
+
+      /**
+       * @return true iff the driver can measure the GPU's time on each pass.
+       */
+      static bool isSupported();
+
+      /**
+       * Finishes the current frame's passes, reads back those of earlier frames that the GPU has finished,
+       * and starts measuring the next frame's. This should happen once per frame, as the frame is submitted.
+       */
+      static void endFrame();
+
+      /**
+       * Describes the GPU's time on each pass in the latest frame read back.
+       *
+       * @param lines The list to add the lines of the description to.
+       */
+      static void describe(std::vector<std::string>& lines);
+
+      /**
+       * Releases the queries. This must happen before the OpenGL context is destroyed.
+       */
+      static void releaseQueries();
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "GPUTimer.h"
+#include "GraphicsUtil.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+
+bool GPUTimer::functionsLoaded = false;
+bool GPUTimer::queriesSupported = false;
+
+// The query functions aren't part of OpenGL 1.1, so they have to be looked up from the driver
+static PFNGLGENQUERIESARBPROC genQueries = NULL;
+static PFNGLDELETEQUERIESARBPROC deleteQueries = NULL;
+static PFNGLBEGINQUERYARBPROC beginQuery = NULL;
+static PFNGLENDQUERYARBPROC endQuery = NULL;
+static PFNGLGETQUERYOBJECTUIVARBPROC getQueryObjectuiv = NULL;
+
+void GPUTimer::loadFunctions()
+{
+   functionsLoaded = true;
+
+   const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+   if(extensions == NULL || strstr(extensions, "GL_EXT_timer_query") == NULL)
+   {
+      DEBUG("Timer queries are not supported; the GPU's drawing time won't be measured.");
+      return;
+   }
+
+   genQueries = reinterpret_cast<PFNGLGENQUERIESARBPROC>(GraphicsUtil::getProcAddress("glGenQueriesARB"));
+   deleteQueries = reinterpret_cast<PFNGLDELETEQUERIESARBPROC>(GraphicsUtil::getProcAddress("glDeleteQueriesARB"));
+   beginQuery = reinterpret_cast<PFNGLBEGINQUERYARBPROC>(GraphicsUtil::getProcAddress("glBeginQueryARB"));
+   endQuery = reinterpret_cast<PFNGLENDQUERYARBPROC>(GraphicsUtil::getProcAddress("glEndQueryARB"));
+   getQueryObjectuiv = reinterpret_cast<PFNGLGETQUERYOBJECTUIVARBPROC>(GraphicsUtil::getProcAddress("glGetQueryObjectuivARB"));
+
+   queriesSupported = genQueries != NULL && deleteQueries != NULL && beginQuery != NULL && endQuery != NULL && getQueryObjectuiv != NULL;
+   DEBUG("Timer queries are %s", queriesSupported ? "supported" : "missing functions; the GPU's drawing time won't be measured.");
+}
+
+bool GPUTimer::isSupported()
+{
+   if(!functionsLoaded)
+   {
+      loadFunctions();
+   }
+
+   return queriesSupported;
+}
+
+GPUTimer::GPUTimer() : oldestQuery(0), pendingQueries(0), measuring(false), lastTime(-1.0)
+{
+   for(int i = 0; i < QUERY_COUNT; ++i)
+   {
+      queries[i] = 0;
+   }
+}
+
+void GPUTimer::begin()
+{
+   if(!isSupported() || pendingQueries == QUERY_COUNT) return;
+
+   if(queries[0] == 0)
+   {
+      genQueries(QUERY_COUNT, queries);
+   }
+
+   beginQuery(GL_TIME_ELAPSED_EXT, queries[(oldestQuery + pendingQueries) % QUERY_COUNT]);
+   measuring = true;
+}
+
+void GPUTimer::end()
+{
+   if(!measuring) return;
+
+   endQuery(GL_TIME_ELAPSED_EXT);
+   measuring = false;
+   ++pendingQueries;
+}
+
+bool GPUTimer::poll()
+{
+   bool measured = false;
+
+   // The queries finish in the order they were taken, so the first one that isn't ready holds up the rest
+   while(pendingQueries > 0)
+   {
+      GLuint available = 0;
+      getQueryObjectuiv(queries[oldestQuery], GL_QUERY_RESULT_AVAILABLE_ARB, &available);
+      if(!available) break;
+
+      // The time is in nanoseconds, which a 32-bit result holds for frames of up to 4 seconds
+      GLuint elapsed = 0;
+      getQueryObjectuiv(queries[oldestQuery], GL_QUERY_RESULT_ARB, &elapsed);
+      lastTime = elapsed / 1000000.0;
+      measured = true;
+
+      oldestQuery = (oldestQuery + 1) % QUERY_COUNT;
+      --pendingQueries;
+   }
+
+   return measured;
+}
+
+double GPUTimer::getLastTime() const
+{
+   return lastTime;
+}
+
+GPUTimer::~GPUTimer()
+{
+   if(queries[0] != 0)
+   {
+      deleteQueries(QUERY_COUNT, queries);
+   }
+}
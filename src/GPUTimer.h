@@ -0,0 +1,97 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+typedef unsigned int GLuint;
+
+/**
+ * Measures how long the GPU spends drawing a stretch of each frame, using timer queries.
+ * The GPU draws behind the CPU, so a measurement is only read back once the driver has it
+ * (a few frames after it was taken), and the CPU never waits on it.
+ *
+ * Timer queries need GL_EXT_timer_query from the driver; where it is missing, isSupported() is false,
+ * and the timer never has a measurement. The timer may only be used while the OpenGL context is current.
+ */
+class GPUTimer
+{
+   /** The number of measurements that can be waiting on the GPU at once. */
+   static const int QUERY_COUNT = 4;
+
+   /** Whether or not the timer query functions have been looked up. */
+   static bool functionsLoaded;
+
+   /** Whether or not the driver supports timer queries. */
+   static bool queriesSupported;
+
+   /**
+    * Looks up the timer query functions, if the driver supports them.
+    */
+   static void loadFunctions();
+
+   /** The queries that measurements are taken with, or 0s if they haven't been created. */
+   GLuint queries[QUERY_COUNT];
+
+   /** The query that the oldest measurement still waiting on the GPU was taken with. */
+   int oldestQuery;
+
+   /** The number of measurements still waiting on the GPU. */
+   int pendingQueries;
+
+   /** Whether or not a measurement is being taken (between begin() and end()). */
+   bool measuring;
+
+   /** The last measurement that was read back (in milliseconds), or a negative number if there hasn't been one. */
+   double lastTime;
+
+   /** Timers can't be copied. */
+   GPUTimer(const GPUTimer&);
+
+   /** Timers can't be copied. */
+   GPUTimer& operator=(const GPUTimer&);
+
+   public:
+      /**
+       * @return true iff the driver can measure the GPU's drawing time.
+       */
+      static bool isSupported();
+
+      /**
+       * Constructor.
+       */
+      GPUTimer();
+
+      /**
+       * Starts measuring the drawing that follows. If every query is still waiting on the GPU,
+       * nothing is measured this time.
+       */
+      void begin();
+
+      /**
+       * Stops measuring, if begin() started a measurement.
+       */
+      void end();
+
+      /**
+       * Reads back the measurements that the GPU has finished since the last call.
+       *
+       * @return true iff a new measurement was read back.
+       */
+      bool poll();
+
+      /**
+       * @return The last measurement read back by poll() (in milliseconds), or a negative number if there hasn't been one.
+       */
+      double getLastTime() const;
+
+      /**
+       * Destructor. Releases the queries.
+       */
+      ~GPUTimer();
+};
+
+#endif
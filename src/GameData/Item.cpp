@@ -5,22 +5,27 @@
  */
 
 #include "Item.h"
-#include "json.h"
+#include <cstddef>
 
-Item::Item(Json::Value& node) : id(node["id"].asInt()), name(node["name"].asString())
+Item::Item() : id(0), name(NULL)
 {
 }
 
-const int Item::getId() const
+Item::Item(int id, const char* name) : id(id), name(name)
+{
+}
+
+int Item::getId() const
 {
    return id;
 }
 
-const std::string& Item::getName() const
+const char* Item::getName() const
 {
    return name;
 }
 
-Item::~Item()
+bool Item::exists() const
 {
+   return name != NULL;
 }
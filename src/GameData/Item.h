@@ -7,48 +7,50 @@
 #ifndef ITEM_H
 #define ITEM_H
 
-#include <string>
-
-namespace Json
-{
-   class Value;
-};
-
 /**
  * Metadata for an item. Since currently, all the games items are non-customizable (no 'unique' items),
  * a template is sufficient for describing all the properties that an item will have. As a result,
  * Item is not an object representative of a single item found in the world; it is the information describing a given item.
+ *
+ * Items are small, flat records that ItemData keeps in an array indexed by ID. An item's name belongs to
+ * the item database (it usually points straight into the compiled database file), so items are never copied out of it.
  */
 class Item
 {
    /** The unique identifier of this item. */
-   const int id;
+   int id;
    
-   /** The name of this item. */
-   const std::string name;
+   /** The name of this item, or NULL for the record of an ID that no item has. */
+   const char* name;
 
    public:
+      /**
+       * Constructor for the record of an ID that no item has.
+       */
+      Item();
+
       /**
        * Constructor.
        *
-       * @param itemNode The JSON node containing the item metadata to load.
+       * @param id The unique identifier of the item.
+       * @param name The name of the item, which must outlive the item.
        */
-      Item(Json::Value& itemNode);
+      Item(int id, const char* name);
    
       /**
        * @return The unique identifier of this item.
        */
-      const int getId() const;
+      int getId() const;
       
       /**
        * @return The name of this item.
        */
-      const std::string& getName() const;
-   
+      const char* getName() const;
+
       /**
-       * Destructor.
+       * @return true iff an item has this record's ID.
        */
-      ~Item();
+      bool exists() const;
 };
 
 #endif
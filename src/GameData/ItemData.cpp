@@ -5,61 +5,188 @@
  */
 
 #include "ItemData.h"
-#include "Item.h"
-#include "json.h"
-#include <fstream>
+#include "ItemDataFormat.h"
+#include "JsonPullParser.h"
+#include "ResourceLoader.h"
+#include "SDL_endian.h"
+#include <cstring>
+#include <utility>
 
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_PLAYER;
 const char* ITEM_DATA_PATH = "data/metadata/items.edb";
 
+// Compiled beside the JSON database by the item data compiler
+const char* COMPILED_ITEM_DATA_PATH = "data/metadata/items.edi";
+
 void ItemData::initialize()
 {
-   Json::Reader reader;
-   DEBUG("Loading item data file %s", ITEM_DATA_PATH);
+   if(!loadCompiledItems())
+   {
+      loadItems();
+   }
+
+   DEBUG("Item data loaded.");
+}
 
-   std::ifstream input(ITEM_DATA_PATH);
-   if(!input)
+bool ItemData::loadCompiledItems()
+{
+   // A baked database was compiled from the JSON database as it is now, so it is used ahead of one compiled by hand
+   std::string compiledPath;
+   if(!ResourceLoader::findBakedAsset(ITEM_DATA_PATH, compiledPath))
    {
-      T_T("Failed to open data file for reading.");
+      compiledPath = COMPILED_ITEM_DATA_PATH;
    }
 
-   Json::Value jsonRoot;
-   if(!reader.parse(input, jsonRoot))
+   try
    {
-      DEBUG("Failed to parse item data: %s", reader.getFormattedErrorMessages().c_str());
-      T_T("Item database is corrupt.");
+      compiledItems.openAsset(compiledPath);
+   }
+   catch(const Exception&)
+   {
+      DEBUG("No compiled item database at %s.", compiledPath.c_str());
+      return false;
    }
 
-   Json::Value& itemList = jsonRoot["data"];
+   const char* const data = compiledItems.getData();
+   const std::size_t fileSize = compiledItems.getSize();
 
-   if(!itemList.isArray())
+   ItemDataFormat::Header header;
+   if(fileSize < sizeof(header))
    {
-      T_T("Failed to parse item data.");
+      DEBUG("Compiled item database %s is too short.", compiledPath.c_str());
+      compiledItems.close();
+      return false;
    }
 
-   int numItems = itemList.size();
-   for(int i = 0; i < numItems; ++i)
+   memcpy(&header, data, sizeof(header));
+   const std::size_t recordCount = SDL_SwapLE32(header.recordCount);
+   const std::size_t recordsOffset = SDL_SwapLE32(header.recordsOffset);
+   const std::size_t namesOffset = SDL_SwapLE32(header.namesOffset);
+   const std::size_t namesSize = SDL_SwapLE32(header.namesSize);
+
+   if(memcmp(header.magic, ItemDataFormat::MAGIC, sizeof(header.magic)) != 0 || SDL_SwapLE32(header.version) != ItemDataFormat::VERSION
+         || SDL_SwapLE32(header.fileSize) != fileSize || recordsOffset % sizeof(Uint32) != 0
+         || recordsOffset + recordCount * sizeof(ItemDataFormat::Record) > fileSize || namesOffset + namesSize > fileSize)
    {
-      int id = itemList[i]["id"].asInt();
-      items[id] = new Item const(itemList[i]);
-      DEBUG("Loaded item ID %d", id);
-   } 
+      DEBUG("File %s is not an item database for this version of the engine, and must be recompiled.", compiledPath.c_str());
+      compiledItems.close();
+      return false;
+   }
 
-   DEBUG("Item data loaded.");
+   const ItemDataFormat::Record* const records = reinterpret_cast<const ItemDataFormat::Record*>(data + recordsOffset);
+   const char* const itemNames = data + namesOffset;
+
+   items.assign(recordCount, Item());
+   for(std::size_t id = 0; id < recordCount; ++id)
+   {
+      const Uint32 nameOffset = SDL_SwapLE32(records[id].nameOffset);
+      if(nameOffset == ItemDataFormat::NO_ITEM)
+      {
+         continue;
+      }
+
+      const Uint32 nameLength = SDL_SwapLE32(records[id].nameLength);
+      if(nameOffset >= namesSize || nameLength >= namesSize - nameOffset || itemNames[nameOffset + nameLength] != '\0')
+      {
+         DEBUG("Compiled item database %s has a name that runs past its end, and must be recompiled.", compiledPath.c_str());
+         items.clear();
+         compiledItems.close();
+         return false;
+      }
+
+      items[id] = Item(static_cast<int>(id), itemNames + nameOffset);
+   }
+
+   DEBUG("Loaded %u items from compiled item database %s", SDL_SwapLE32(header.itemCount), compiledPath.c_str());
+   return true;
 }
 
-Item const* ItemData::getItem(int key)
+void ItemData::loadItems()
 {
-   return items[key];
+   DEBUG("Loading item data file %s", ITEM_DATA_PATH);
+
+   // The items are read straight out of the file, without building a document out of the whole database first
+   JsonPullParser parser(ITEM_DATA_PATH);
+   if(parser.peek() != JsonPullParser::OBJECT)
+   {
+      T_T("Item database is corrupt.");
+   }
+
+   bool foundItems = false;
+   std::string key;
+   std::string name;
+
+   // Every item's name is collected into one block before the items point into it, since the block moves as it grows
+   std::vector<std::pair<int, std::size_t> > nameOffsets;
+   int highestId = -1;
+
+   parser.beginObject();
+   while(parser.nextKey(key))
+   {
+      if(key != "data" || parser.peek() != JsonPullParser::ARRAY)
+      {
+         parser.skipValue();
+         continue;
+      }
+
+      foundItems = true;
+      parser.beginArray();
+      while(parser.hasNextElement())
+      {
+         int id = 0;
+         name.clear();
+
+         parser.beginObject();
+         while(parser.nextKey(key))
+         {
+            if(key == "id") id = parser.readInt();
+            else if(key == "name") parser.readString(name);
+            else parser.skipValue();
+         }
+
+         if(id < 0)
+         {
+            DEBUG("Skipping item %s with negative ID %d", name.c_str(), id);
+            continue;
+         }
+
+         nameOffsets.push_back(std::make_pair(id, names.size()));
+         names.insert(names.end(), name.begin(), name.end());
+         names.push_back('\0');
+         if(id > highestId) highestId = id;
+         DEBUG("Loaded item ID %d", id);
+      }
+   }
+
+   parser.finish();
+
+   if(!foundItems)
+   {
+      T_T("Failed to parse item data.");
+   }
+
+   items.assign(highestId + 1, Item());
+   for(std::vector<std::pair<int, std::size_t> >::const_iterator iter = nameOffsets.begin(); iter != nameOffsets.end(); ++iter)
+   {
+      items[iter->first] = Item(iter->first, &names[iter->second]);
+   }
 }
 
-void ItemData::finish()
+Item const* ItemData::getItem(int key) const
 {
-   for(std::map<int, Item const*>::iterator iter = items.begin(); iter != items.end(); ++iter)
+   if(key < 0 || static_cast<std::size_t>(key) >= items.size() || !items[key].exists())
    {
-      delete iter->second;
+      return NULL;
    }
+
+   return &items[key];
 }
 
+void ItemData::finish()
+{
+   items.clear();
+   names.clear();
+   compiledItems.close();
+}
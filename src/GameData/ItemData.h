@@ -7,26 +7,47 @@
 #ifndef ITEM_DATA_H
 #define ITEM_DATA_H
 
-#include <map>
-#include <string>
+#include <vector>
 
+#include "Item.h"
+#include "MappedFile.h"
 #include "Singleton.h"
 
-class Item;
-
 /**
- * A global map holding all the item metadata (item IDs and the associated names, descriptions, etc.) for the game.
+ * A global table holding all the item metadata (item IDs and the associated names, descriptions, etc.) for the game.
+ *
+ * The items are kept in an array indexed by item ID, so looking an item up is a single read. They are loaded from
+ * the compiled item database (the baked one, or items.edi) when there is one, whose names are used straight from the mapped file;
+ * otherwise, they are loaded from the JSON item database (items.edb) that it is compiled from.
  *
  * @author Noam Chitayat
  */
 class ItemData : public Singleton<ItemData>
 {
-   /** A map of all the items, mapped by Item ID. */
-   std::map<int, Item const*> items;
+   /** Every item, at the index of its ID. IDs that no item has hold an item that doesn't exist. */
+   std::vector<Item> items;
+
+   /** The compiled item database, which holds the names of the items if they were loaded from it. */
+   MappedFile compiledItems;
+
+   /** The names of the items (each followed by a '\0'), if they were loaded from the JSON item database. */
+   std::vector<char> names;
+
+   /**
+    * Load the items from the compiled item database.
+    *
+    * @return true iff the compiled item database was found, and is for this version of the engine.
+    */
+   bool loadCompiledItems();
+
+   /**
+    * Load the items from the JSON item database.
+    */
+   void loadItems();
 
    public:
       /**
-       * Load up all the item metadata from items.edb.
+       * Load up all the item metadata from items.edi, or items.edb if there is no items.edi.
        */
       void initialize();   
 
@@ -34,11 +55,13 @@ class ItemData : public Singleton<ItemData>
        * Get an item by its ID.
        *
        * @param key The ID of the item metadata to be retrieved.
+       *
+       * @return The item, or NULL if no item has the ID.
        */
-      Item const* getItem(int key);
+      Item const* getItem(int key) const;
 
       /**
-       * Clean up the item metadata map.
+       * Clean up the item metadata.
        */
       void finish();
 };
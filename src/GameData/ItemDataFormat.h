@@ -0,0 +1,71 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ITEM_DATA_FORMAT_H
+#define ITEM_DATA_FORMAT_H
+
+#include "SDL_stdinc.h"
+
+/**
+ * The layout of compiled item database (.edi) files, which are written by the item data compiler
+ * and loaded by ItemData. Every number in the file is stored in little-endian byte order. The file is laid out as:
+ *
+ * - The header below.
+ * - The records (4-byte aligned): a Record for every item ID from 0 up to the highest ID in the database,
+ *   so that an item's record is found by indexing the records with its ID.
+ * - The names of every item, one after the other, each followed by a '\0' so that it can be used in place.
+ */
+namespace ItemDataFormat
+{
+   /** The characters that every compiled item database file starts with. */
+   static const char MAGIC[4] = { 'E', 'D', 'I', '\0' };
+
+   /** The version of the format; files written with any other version must be recompiled. */
+   static const Uint32 VERSION = 1;
+
+   /** The name offset of the record of an ID that no item has. */
+   static const Uint32 NO_ITEM = 0xFFFFFFFF;
+
+   /** The header at the start of every compiled item database file. */
+   struct Header
+   {
+      /** The characters in MAGIC. */
+      char magic[4];
+
+      /** The format version that the file was written with. */
+      Uint32 version;
+
+      /** The number of records (one more than the highest item ID). */
+      Uint32 recordCount;
+
+      /** The number of items in the database. */
+      Uint32 itemCount;
+
+      /** The file offset of the records. */
+      Uint32 recordsOffset;
+
+      /** The file offset of the names. */
+      Uint32 namesOffset;
+
+      /** The size of the names (including their '\0's). */
+      Uint32 namesSize;
+
+      /** The size of the whole file. */
+      Uint32 fileSize;
+   };
+
+   /** The item with a given ID, as stored in a compiled item database file. */
+   struct Record
+   {
+      /** The offset of the item's name in the names, or NO_ITEM if no item has the ID. */
+      Uint32 nameOffset;
+
+      /** The length of the item's name (not including its '\0'). */
+      Uint32 nameLength;
+   };
+};
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "StringTable.h"
+#include "StringTableFormat.h"
+#include "ResourceLoader.h"
+#include "SDL_endian.h"
+#include <algorithm>
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_RES_LOAD;
+
+// Beside the rest of the game's data, so that the tables are packed into the asset archive with it
+const char* const StringTable::STRING_TABLE_DIRECTORY = "data/strings/";
+
+MappedFile StringTable::table;
+const StringTableFormat::Entry* StringTable::entries = NULL;
+std::size_t StringTable::entryCount = 0;
+const Uint32* StringTable::breaks = NULL;
+std::size_t StringTable::breakCount = 0;
+const char* StringTable::characters = NULL;
+std::string StringTable::language;
+
+/**
+ * Orders string table entries by their IDs, the same way that the string table compiler sorts them.
+ */
+class EntryIdLess
+{
+   const char* characters;
+
+   static int compare(const char* left, std::size_t leftLength, const char* right, std::size_t rightLength)
+   {
+      const int result = memcmp(left, right, std::min(leftLength, rightLength));
+      return result != 0 ? result : (leftLength < rightLength ? -1 : (leftLength > rightLength ? 1 : 0));
+   }
+
+   public:
+      EntryIdLess(const char* characters) : characters(characters) {}
+
+      bool operator()(const StringTableFormat::Entry& entry, const std::string& id) const
+      {
+         return compare(characters + SDL_SwapLE32(entry.idOffset), SDL_SwapLE32(entry.idLength), id.data(), id.length()) < 0;
+      }
+};
+
+bool StringTable::setLanguage(const std::string& newLanguage)
+{
+   unload();
+   language = newLanguage;
+
+   // A language's baked table was compiled from its strings as they are now, so it is used ahead of one compiled by hand
+   std::string path;
+   if(!ResourceLoader::findBakedAsset(STRING_TABLE_DIRECTORY + newLanguage + ".json", path))
+   {
+      path = STRING_TABLE_DIRECTORY + newLanguage + ".eds";
+   }
+
+   try
+   {
+      table.openAsset(path);
+   }
+   catch(const Exception&)
+   {
+      DEBUG("Unable to open string table %s; no strings can be found in language %s.", path.c_str(), newLanguage.c_str());
+      return false;
+   }
+
+   const char* const data = table.getData();
+   const std::size_t fileSize = table.getSize();
+
+   StringTableFormat::Header header;
+   if(fileSize < sizeof(header))
+   {
+      DEBUG("String table %s is too short.", path.c_str());
+      unload();
+      return false;
+   }
+
+   memcpy(&header, data, sizeof(header));
+   const std::size_t count = SDL_SwapLE32(header.stringCount);
+   const std::size_t entriesOffset = SDL_SwapLE32(header.entriesOffset);
+   const std::size_t breaksOffset = SDL_SwapLE32(header.breaksOffset);
+   const std::size_t breaksCount = SDL_SwapLE32(header.breakCount);
+   const std::size_t charactersOffset = SDL_SwapLE32(header.charactersOffset);
+   const std::size_t charactersSize = SDL_SwapLE32(header.charactersSize);
+
+   if(memcmp(header.magic, StringTableFormat::MAGIC, sizeof(header.magic)) != 0 || SDL_SwapLE32(header.version) != StringTableFormat::VERSION
+         || SDL_SwapLE32(header.fileSize) != fileSize || entriesOffset % sizeof(Uint32) != 0 || breaksOffset % sizeof(Uint32) != 0
+         || entriesOffset + count * sizeof(StringTableFormat::Entry) > fileSize || breaksOffset + breaksCount * sizeof(Uint32) > fileSize
+         || charactersOffset + charactersSize > fileSize)
+   {
+      DEBUG("File %s is not a string table for this version of the engine, and must be recompiled.", path.c_str());
+      unload();
+      return false;
+   }
+
+   const StringTableFormat::Entry* const tableEntries = reinterpret_cast<const StringTableFormat::Entry*>(data + entriesOffset);
+   for(std::size_t i = 0; i < count; ++i)
+   {
+      const StringTableFormat::Entry& entry = tableEntries[i];
+      if(SDL_SwapLE32(entry.idOffset) + SDL_SwapLE32(entry.idLength) > charactersSize
+            || SDL_SwapLE32(entry.textOffset) + SDL_SwapLE32(entry.textLength) > charactersSize
+            || SDL_SwapLE32(entry.firstBreak) + SDL_SwapLE32(entry.breakCount) > breaksCount)
+      {
+         DEBUG("String table %s has a string that runs past its end.", path.c_str());
+         unload();
+         return false;
+      }
+   }
+
+   entries = tableEntries;
+   entryCount = count;
+   breaks = reinterpret_cast<const Uint32*>(data + breaksOffset);
+   breakCount = breaksCount;
+   characters = data + charactersOffset;
+
+   DEBUG("Loaded string table %s with %d strings, laid out %upx wide at %upt.", path.c_str(), static_cast<int>(entryCount),
+         SDL_SwapLE32(header.layoutWidth), SDL_SwapLE32(header.layoutFontSize));
+   return true;
+}
+
+void StringTable::unload()
+{
+   entries = NULL;
+   entryCount = 0;
+   breaks = NULL;
+   breakCount = 0;
+   characters = NULL;
+   table.close();
+}
+
+const std::string& StringTable::getLanguage()
+{
+   return language;
+}
+
+const StringTableFormat::Entry* StringTable::findEntry(const std::string& id)
+{
+   if(entries == NULL) return NULL;
+
+   const StringTableFormat::Entry* const end = entries + entryCount;
+   const StringTableFormat::Entry* const entry = std::lower_bound(entries, end, id, EntryIdLess(characters));
+   if(entry == end || SDL_SwapLE32(entry->idLength) != id.length() || memcmp(characters + SDL_SwapLE32(entry->idOffset), id.data(), id.length()) != 0)
+   {
+      return NULL;
+   }
+
+   return entry;
+}
+
+bool StringTable::lookup(const std::string& id, std::string& text)
+{
+   const StringTableFormat::Entry* const entry = findEntry(id);
+   if(entry == NULL)
+   {
+      return false;
+   }
+
+   text.assign(characters + SDL_SwapLE32(entry->textOffset), SDL_SwapLE32(entry->textLength));
+
+   // Each break is at a space, so the text is broken into lines without moving any of it
+   const Uint32* const firstBreak = breaks + SDL_SwapLE32(entry->firstBreak);
+   const Uint32* const lastBreak = firstBreak + SDL_SwapLE32(entry->breakCount);
+   for(const Uint32* lineBreak = firstBreak; lineBreak != lastBreak; ++lineBreak)
+   {
+      const Uint32 offset = SDL_SwapLE32(*lineBreak);
+      if(offset < text.length())
+      {
+         text[offset] = '\n';
+      }
+   }
+
+   return true;
+}
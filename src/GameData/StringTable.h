@@ -0,0 +1,97 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include <cstddef>
+#include <string>
+#include "MappedFile.h"
+#include "SDL_stdinc.h"
+
+namespace StringTableFormat
+{
+   struct Entry;
+};
+
+/**
+ * Serves the game's text in the current language, out of a compiled string table (.eds) for each language,
+ * written by the string table compiler from the language's strings (see StringTableFormat.h).
+ * Scripts refer to their text by ID, and the ID is looked up in the current language whenever the text is shown,
+ * so switching languages takes effect without reloading any scripts.
+ *
+ * The strings were measured with the game's default font when the table was compiled, and the compiler broke
+ * their long lines to fit the dialogue box, so the text comes out already laid out, with no word wrapping to do at runtime.
+ *
+ * The table is mapped into memory when its language is set, and a lookup is a binary search of its entries in place,
+ * so the only allocation is for the copy of the text that is handed back.
+ */
+class StringTable
+{
+   /** The directory that the compiled string tables are kept in, named after their languages. */
+   static const char* const STRING_TABLE_DIRECTORY;
+
+   /** The mapped string table of the current language. */
+   static MappedFile table;
+
+   /** The entries of the table, or NULL if no table is loaded. */
+   static const StringTableFormat::Entry* entries;
+
+   /** The number of strings in the table. */
+   static std::size_t entryCount;
+
+   /** The line breaks of the strings. */
+   static const Uint32* breaks;
+
+   /** The number of line breaks. */
+   static std::size_t breakCount;
+
+   /** The characters of the IDs and strings. */
+   static const char* characters;
+
+   /** The current language. */
+   static std::string language;
+
+   /**
+    * Unloads the table of the current language.
+    */
+   static void unload();
+
+   /**
+    * @param id The ID of a string.
+    *
+    * @return The entry for the string, or NULL if the string isn't in the table.
+    */
+   static const StringTableFormat::Entry* findEntry(const std::string& id);
+
+   public:
+      /**
+       * Switches to another language, loading its string table. If the table can't be loaded,
+       * the language is still switched, but none of its strings can be found.
+       *
+       * @param newLanguage The name of the language (which names its table, such as "en" for data/strings/en.eds).
+       *
+       * @return true iff the language's string table was loaded.
+       */
+      static bool setLanguage(const std::string& newLanguage);
+
+      /**
+       * @return The current language.
+       */
+      static const std::string& getLanguage();
+
+      /**
+       * Finds a string of the current language, with its line breaks in place.
+       *
+       * @param id The ID of the string.
+       * @param text Set to the string, broken into lines by '\n' characters.
+       *
+       * @return true iff the string is in the current language's table.
+       */
+      static bool lookup(const std::string& id, std::string& text);
+};
+
+#endif
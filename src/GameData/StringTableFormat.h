@@ -0,0 +1,92 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef STRING_TABLE_FORMAT_H
+#define STRING_TABLE_FORMAT_H
+
+#include "SDL_stdinc.h"
+
+/**
+ * The layout of compiled string table (.eds) files, which are written by the string table compiler
+ * and loaded by StringTable. Every number in the file is stored in little-endian byte order. The file is laid out as:
+ *
+ * - The header below.
+ * - The entries (4-byte aligned): an Entry for every string, sorted by ID (comparing the bytes of the IDs),
+ *   so that an ID can be found by binary search straight from the file.
+ * - The line breaks (4-byte aligned): a 32-bit offset into its text for every line break of every string,
+ *   with the breaks of each string together and in order. Each break is at a space that becomes a new line
+ *   when the string is shown.
+ * - The characters of every ID and string, one after the other.
+ */
+namespace StringTableFormat
+{
+   /** The characters that every compiled string table file starts with. */
+   static const char MAGIC[4] = { 'E', 'D', 'S', '\0' };
+
+   /** The version of the format; files written with any other version must be recompiled. */
+   static const Uint32 VERSION = 1;
+
+   /** The header at the start of every compiled string table file. */
+   struct Header
+   {
+      /** The characters in MAGIC. */
+      char magic[4];
+
+      /** The format version that the file was written with. */
+      Uint32 version;
+
+      /** The number of strings in the table. */
+      Uint32 stringCount;
+
+      /** The file offset of the entries. */
+      Uint32 entriesOffset;
+
+      /** The file offset of the line breaks. */
+      Uint32 breaksOffset;
+
+      /** The number of line breaks. */
+      Uint32 breakCount;
+
+      /** The file offset of the characters. */
+      Uint32 charactersOffset;
+
+      /** The size of the characters. */
+      Uint32 charactersSize;
+
+      /** The width (in pixels) that the strings' lines were broken to fit. */
+      Uint32 layoutWidth;
+
+      /** The size (in points) of the font that the strings were measured with. */
+      Uint32 layoutFontSize;
+
+      /** The size of the whole file. */
+      Uint32 fileSize;
+   };
+
+   /** The location of a string (and its ID) in a compiled string table file. */
+   struct Entry
+   {
+      /** The offset of the ID in the characters. */
+      Uint32 idOffset;
+
+      /** The length of the ID. */
+      Uint32 idLength;
+
+      /** The offset of the string in the characters. */
+      Uint32 textOffset;
+
+      /** The length of the string. */
+      Uint32 textLength;
+
+      /** The index of the string's first line break in the line breaks. */
+      Uint32 firstBreak;
+
+      /** The number of line breaks in the string. */
+      Uint32 breakCount;
+   };
+};
+
+#endif
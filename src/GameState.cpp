@@ -6,6 +6,12 @@
 
 #include "GameState.h"
 #include "GraphicsUtil.h"
+#include "ResourceLoader.h"
+#include "JobSystem.h"
+#include "ScreenTransition.h"
+#include "RenderTarget.h"
+#include "FrameProfiler.h"
+#include "InputQueue.h"
 #include <SDL.h>
 #include "Container.h"
 #include "DebugConsoleWindow.h"
@@ -13,7 +19,7 @@
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_GAME_STATE;
 
-GameState::GameState(ExecutionStack& executionStack) : executionStack(executionStack), internalContainer(true)
+GameState::GameState(ExecutionStack& executionStack) : executionStack(executionStack), internalContainer(true), snapshotBackground(false), snapshot(NULL), suspendedState(NULL)
 {
    top = new edwt::Container();
    top->setDimension(gcn::Rectangle(0, 0, GraphicsUtil::getInstance()->getWidth(), GraphicsUtil::getInstance()->getHeight()));
@@ -21,7 +27,7 @@ GameState::GameState(ExecutionStack& executionStack) : executionStack(executionS
    top->setEnabled(true);
 }
 
-GameState::GameState(ExecutionStack& executionStack, edwt::Container* container) : executionStack(executionStack), top(container), internalContainer(false)
+GameState::GameState(ExecutionStack& executionStack, edwt::Container* container) : executionStack(executionStack), top(container), internalContainer(false), snapshotBackground(false), snapshot(NULL), suspendedState(NULL)
 {
 }
 
@@ -31,10 +37,65 @@ void GameState::activate()
    finished = false;
 }
 
-bool GameState::advanceFrame()
+void GameState::pushedOver(GameState& state)
+{
+   suspendedState = &state;
+   if(snapshotBackground && snapshot == NULL)
+   {
+      snapshot = state.captureFrame();
+   }
+}
+
+RenderTarget* GameState::captureFrame()
+{
+   if(!RenderTarget::isSupported())
+   {
+      return NULL;
+   }
+
+   PROFILE_ZONE("GameState::captureFrame");
+   GraphicsUtil* graphics = GraphicsUtil::getInstance();
+   graphics->presentFrame();
+
+   // The state's interface is still the one in use, so its widgets end up in the snapshot along with it
+   graphics->clearBuffer();
+   draw();
+   graphics->drawGUI();
+
+   RenderTarget* frame = new RenderTarget(graphics->getWidth(), graphics->getHeight());
+   frame->capture();
+   graphics->clearBuffer();
+
+   DEBUG("Captured a snapshot of the suspended state.");
+   return frame;
+}
+
+bool GameState::advanceFrame(long timePassed)
+{
+   PROFILE_ZONE("GameState::advanceFrame");
+   GraphicsUtil::getInstance()->stepGUI();
+   GraphicsUtil::getInstance()->getTransition()->step(timePassed);
+   return step(timePassed);
+}
+
+bool GameState::advancePausedFrame()
 {
    GraphicsUtil::getInstance()->stepGUI();
-   return step();
+
+   bool active = true;
+   InputQueue::Input input;
+   while(InputQueue::poll(input))
+   {
+      if(input.event.type == SDL_QUIT)
+      {
+         active = false;
+         continue;
+      }
+
+      handleEvent(input.event);
+   }
+
+   return active;
 }
 
 void GameState::handleEvent(SDL_Event& event)
@@ -44,16 +105,41 @@ void GameState::handleEvent(SDL_Event& event)
 
 void GameState::drawFrame()
 {
+   PROFILE_ZONE("GameState::drawFrame");
+   GraphicsUtil::getInstance()->uploadStreamedTextures();
+   JobSystem::finalizeJobs();
+   ResourceLoader::finishRequests();
+
+   GraphicsUtil::getInstance()->beginScene();
+   if(snapshot != NULL)
+   {
+      snapshot->draw();
+   }
+   else if(snapshotBackground && suspendedState != NULL)
+   {
+      // Without a snapshot, the state below has to be drawn again every frame
+      suspendedState->draw();
+   }
+
    draw();
+   GraphicsUtil::getInstance()->endScene();
 
    GraphicsUtil::getInstance()->drawGUI();
+   GraphicsUtil::getInstance()->drawTransition();
+   FrameProfiler::drawOverlay(GraphicsUtil::getInstance()->getWidth(), GraphicsUtil::getInstance()->getHeight());
 
-   // Make sure everything is displayed on screen
-   GraphicsUtil::getInstance()->flipScreen();
+   // The frame is shown by the execution stack, once the next frame's logic has run while the GPU draws this one
+   GraphicsUtil::getInstance()->submitFrame();
+}
+
+void GameState::idle(long /*timeAvailable*/)
+{
 }
 
 GameState::~GameState()
 {
+   delete snapshot;
+
    if(internalContainer)
    {
       GraphicsUtil::getInstance()->setInterface(NULL);
@@ -8,6 +8,7 @@
 #define GAME_STATE_H
 
 class ExecutionStack;
+class RenderTarget;
 
 namespace edwt
 {
@@ -28,6 +29,10 @@ union SDL_Event;
  * The activate method is called by the Execution Stack whenever
  * the state reaches the top of the stack.
  *
+ * A state that only covers part of the screen (such as a menu over the map) can draw over a snapshot of the state below it,
+ * instead of the state below drawing itself every frame. The snapshot is taken once, when the state is pushed over
+ * the other state, so that drawing the overlay only costs as much as its own GUI.
+ *
  * @author Noam Chitayat
  */
 class GameState
@@ -45,6 +50,9 @@ class GameState
       /** Set true to signal the state logic to terminate so that the state is destroyed. */
       bool finished;
 
+      /** Set true (before the state is pushed) for the state to draw over a snapshot of the state below it. */
+      bool snapshotBackground;
+
       /**
        * Constructor.
        * Initializes the top-level GUI widget container.
@@ -65,9 +73,11 @@ class GameState
       /**
        * Runs the state's logic processing
        *
+       * @param timePassed The amount of game time (in milliseconds) that the step covers.
+       *
        * @return true iff the state is not finished
        */
-      virtual bool step() = 0;
+      virtual bool step(long timePassed) = 0;
 
       /**
        * Does common event handling that is required across all game states.
@@ -82,6 +92,21 @@ class GameState
        */
       virtual void draw() = 0;
 
+      /**
+       * Draws the state and its widgets once more, and copies the result into a texture.
+       * Whatever frame is waiting to be shown is shown first, since it is drawn over.
+       *
+       * @return The snapshot (which the caller must delete), or NULL if the driver can't keep one.
+       */
+      RenderTarget* captureFrame();
+
+   private:
+      /** The snapshot of the state below that is drawn under this state, or NULL if there is none. */
+      RenderTarget* snapshot;
+
+      /** The state below this one on the stack, or NULL if the state is at the bottom of the stack. */
+      GameState* suspendedState;
+
    public:
       /**
        * State activation called every time this state is found at the top of the execution stack.
@@ -90,21 +115,49 @@ class GameState
        */
       virtual void activate();
 
+      /**
+       * Called when the state is pushed onto the execution stack over another state, before it is activated.
+       * If the state draws over a snapshot, the state below is snapshotted here.
+       *
+       * @param state The state below, which is suspended until this state is finished.
+       */
+      void pushedOver(GameState& state);
+
       /**
        * Called every frame in order to trigger logic processing in the game state
        * that is at the top of the execution stack.
        * Generic logic that happens in every game state (such as GUI logic) should go in here.
+       *
+       * @param timePassed The amount of game time (in milliseconds) that the step covers.
        */
-      virtual bool advanceFrame();
+      virtual bool advanceFrame(long timePassed);
 
+      /**
+       * Called every frame in place of advanceFrame while the game's time is paused (see EngineClock),
+       * so that the state at the top of the execution stack still takes its input, although none of its logic is stepped.
+       * By default, the input is passed on to the GUI, and quitting finishes the state.
+       *
+       * @return true iff the state is not finished running.
+       */
+      virtual bool advancePausedFrame();
    
       /**
        * Called every frame in order to trigger drawing the game state
        * that is at the top of the execution stack.
        * Generic drawing code that is performed in every game state (such as drawing GUI and flipping the buffer) should go in here.
+       * A state that draws over a snapshot has the snapshot drawn before it draws, so it can dim (or otherwise cover) the snapshot in its own draw.
+       * The buffer is flipped exactly once per frame, here.
        */
       virtual void drawFrame();
 
+      /**
+       * Does work that can be put off (such as cleaning up memory) in the time left over after a frame is drawn.
+       * Does nothing unless the state overrides it.
+       *
+       * @param timeAvailable The time (in milliseconds) left before the next frame is due.
+       */
+      virtual void idle(long timeAvailable);
+
       /**
        * Destructor.
        */
@@ -8,71 +8,155 @@
 #include <SDL.h>
 #include "SDL_opengl.h"
 #include "SDL_image.h"
-#include "SDL_mixer.h"
 #include "SDL_ttf.h"
 #include "guichan.hpp"
 #include "guichan/sdl.hpp"
 #include "guichan/opengl.hpp"
 #include "guichan/opengl/openglsdlimageloader.hpp"
 #include "Container.h"
+#include "OpenGLGraphics.h"
 #include "OpenGLTTF.h"
+#include "SpriteBatch.h"
+#include "RenderTarget.h"
+#include "GPUTimer.h"
+#include "GPUPassTimer.h"
+#include "FrameCapture.h"
+#include "ScreenTransition.h"
+#include "TextureLoader.h"
+#include "CompressedTexture.h"
+#include "PixelConverter.h"
+#include "GLState.h"
+#include "HeadlessContext.h"
+#include "AssetArchive.h"
+#include "FrameProfiler.h"
+#include "MemoryTracker.h"
+#include <algorithm>
 
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_GRAPHICS;
 
 SDL_Surface* GraphicsUtil::screen = NULL;
+bool GraphicsUtil::headless = false;
+float GraphicsUtil::maxSceneScale = 1.0f;
+double GraphicsUtil::frameBudget = 0.0;
+
+// Below half of the screen's resolution, the stretched scene is too blurry to play
+static const float MIN_SCENE_SCALE = 0.5f;
+
+// Small enough steps that a change in resolution is hardly noticeable from one frame to the next
+static const float SCENE_SCALE_STEP = 0.05f;
+
+// Frames close to the budget are already at risk of missing it, so the resolution drops before they go over
+static const double SCALE_DOWN_THRESHOLD = 0.9;
+
+// Well under the budget, so that raising the resolution again doesn't push the frames straight back over it
+static const double SCALE_UP_THRESHOLD = 0.7;
+
+// The GPU's measurements lag a few frames behind, so frames drawn before the last change are left alone
+static const int SCALE_SETTLE_FRAMES = 8;
+
+void GraphicsUtil::setHeadless(bool enabled)
+{
+   headless = enabled;
+}
+
+bool GraphicsUtil::isHeadless()
+{
+   return headless;
+}
+
+void GraphicsUtil::configureSceneScale(float scale, double budget)
+{
+   maxSceneScale = std::max(MIN_SCENE_SCALE, std::min(scale, 1.0f));
+   frameBudget = std::max(budget, 0.0);
+}
+
+void* GraphicsUtil::getProcAddress(const char* name)
+{
+   return headless ? HeadlessContext::getProcAddress(name) : SDL_GL_GetProcAddress(name);
+}
 
 void GraphicsUtil::initialize()
 {
    currentXOffset = 0;
    currentYOffset = 0;
+   headlessContext = NULL;
 
    initSDL();
    initGuichan();
+
+   spriteBatch = new SpriteBatch();
+   textureAtlas = new TextureAtlas();
+   textureLoader = new TextureLoader(*textureAtlas);
+   textureLoader->start();
+   guiLayer = new RenderTarget(width, height);
+   sceneLayer = new RenderTarget(width, height, true, true);
+   frameTimer = new GPUTimer();
+   frameCapture = new FrameCapture();
+   sceneScale = maxSceneScale;
+   framesSinceScaleChange = 0;
+   drawingScene = false;
+   guiChanged = true;
+   guiLogicPending = true;
+   transition = new ScreenTransition();
+   framePending = false;
 }
 
 void GraphicsUtil::initSDL()
 {
-   // Audio information (HARDCODED)
-   int audio_rate = 44100;
-   Uint16 audio_format = AUDIO_S16SYS; /* 16-bit stereo */
-   int audio_channels = 2;
-   int audio_buffers = 2048;
-
-   // Initialize SDL audio and video bindings
-   if(SDL_Init (SDL_INIT_AUDIO|SDL_INIT_VIDEO) < 0)
+   if(headless)
    {
-      printf ("Couldn't initialize SDL: %s\n", SDL_GetError ());
-      exit(1);
+      // Without a display, SDL still has to run for its events, timers and threads
+      SDL_putenv(const_cast<char*>("SDL_VIDEODRIVER=dummy"));
    }
 
-   // Initialize SDL_mixer audio library
-   if(Mix_OpenAudio(audio_rate, audio_format, audio_channels, audio_buffers))
+   // Initialize SDL video bindings (audio is opened on its own, by the AudioSystem)
+   if(SDL_Init(SDL_INIT_VIDEO) < 0)
    {
-      printf("Unable to open audio: %s\n", SDL_GetError());
+      printf ("Couldn't initialize SDL: %s\n", SDL_GetError ());
       exit(1);
    }
 
    // Enable the OpenGL double buffer
-   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 0);
+   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+
+   // The sprite batch orders the sprites with the depth buffer, which has room enough for them at 16 bits
+   SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16);
+
+   // Have buffer swaps wait for the display's vertical refresh, if requested
+   SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, vsyncEnabled ? 1 : 0);
 
    // On exit, run the SDL cleanup
    atexit (SDL_Quit);
  
-   // Set 800x600 32-bits video mode (HARDCODED)
-   screen = SDL_SetVideoMode (width, height, 32, SDL_HWSURFACE | SDL_OPENGL | SDL_HWACCEL);
-   if(screen == NULL)
+   if(headless)
    {
-      printf ("Couldn't set 800x600x32 video mode: %s\n", SDL_GetError());
-      exit(1);
+      // The dummy video driver can't create an OpenGL context, so the engine draws into one of its own
+      screen = SDL_SetVideoMode (width, height, 32, SDL_SWSURFACE);
+      if(screen == NULL)
+      {
+         T_T(std::string("Couldn't set up the dummy video driver: ") + SDL_GetError());
+      }
+
+      headlessContext = new HeadlessContext(width, height);
+   }
+   else
+   {
+      // Set 800x600 32-bits video mode (HARDCODED)
+      screen = SDL_SetVideoMode (width, height, 32, SDL_HWSURFACE | SDL_OPENGL | SDL_HWACCEL);
+      if(screen == NULL)
+      {
+         printf ("Couldn't set 800x600x32 video mode: %s\n", SDL_GetError());
+         exit(1);
+      }
    }
 
    // Enable Texture Mapping
-   glEnable(GL_TEXTURE_2D);
+   GLState::setTexturing(true);
 
    // Sprites drawn to screen replace whatever is behind them (tiles, background)
-   glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+   GLState::setTextureMode(GL_REPLACE);
 
    // Set up the viewport and reset the projection matrix
    glViewport(0, 0, width, height);
@@ -102,12 +186,13 @@ void GraphicsUtil::initSDL()
 
 void GraphicsUtil::initGuichan()
 {
+   MemoryTracker::Scope memoryScope(MemoryTracker::GUI);
    imageLoader = new gcn::OpenGLSDLImageLoader();
 
    // The ImageLoader in use is static and must be set to be
    // able to load images
    gcn::Image::setImageLoader(imageLoader);
-   graphics = new gcn::OpenGLGraphics();
+   graphics = new edwt::OpenGLGraphics();
    graphics->setTargetPlane(800, 600);
 
    input = new gcn::SDLInput();
@@ -140,15 +225,52 @@ void GraphicsUtil::initGuichan()
 
 void GraphicsUtil::flipScreen()
 {
+   // Swapping the buffers flushes any enqueued GL commands first
+   if(headlessContext != NULL)
+   {
+      headlessContext->swapBuffers();
+   }
+   else
+   {
+      SDL_GL_SwapBuffers();
+   }
+
+   framePending = false;
+}
+
+void GraphicsUtil::submitFrame()
+{
+   frameTimer->end();
+   GPUPassTimer::endFrame();
+
+   // The GUI and transition are drawn by now, so the capture gets the frame just as it will be shown
+   frameCapture->captureFrame(getWidth(), getHeight());
    glFlush();
-   SDL_GL_SwapBuffers();
+   framePending = true;
+
+   ++framesSinceScaleChange;
+   adjustSceneScale();
 }
 
-void GraphicsUtil::loadGLTexture(const char* path, GLuint& texture, int& w, int& h)
+void GraphicsUtil::presentFrame()
+{
+   if(framePending)
+   {
+      flipScreen();
+   }
+}
+
+SDL_Surface* GraphicsUtil::loadImage(const char* path)
 {
    // Create storage space for the texture and load the image
    DEBUG("Loading image %s...", path);
-   SDL_Surface *image = IMG_Load(path);
+   SDL_RWops* source = AssetArchive::open(path);
+   if(source == NULL)
+   {
+      T_T(std::string("Unable to open image: ") + path);
+   }
+
+   SDL_Surface *image = IMG_Load_RW(source, 1);
 
    if(!image)
    {
@@ -157,40 +279,40 @@ void GraphicsUtil::loadGLTexture(const char* path, GLuint& texture, int& w, int&
    }
 
    DEBUG("Image load successful!");
+   return image;
+}
+
+const unsigned char* GraphicsUtil::convertToRGBA(SDL_Surface* image, int& pitch)
+{
+   // The staging buffer is kept between loads, so it isn't counted towards whichever resource happened to grow it
+   MemoryTracker::Scope memoryScope(MemoryTracker::UNTAGGED);
+   try
+   {
+      return PixelConverter::toRGBA(image, stagingPixels, pitch);
+   }
+   catch(Exception&)
+   {
+      // Problem converting the image; free it before passing the exception on
+      SDL_FreeSurface(image);
+      throw;
+   }
+}
 
-   Uint32 rmask, gmask, bmask, amask;
-
-/* SDL interprets each pixel as a 32-bit number, 
-   so our masks must depend on the endianness 
-   (byte order) of the machine */
-
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-   rmask = 0xff000000;
-   gmask = 0x00ff0000;
-   bmask = 0x0000ff00;
-   amask = 0x000000ff;
-#else
-   rmask = 0x000000ff;
-   gmask = 0x0000ff00;
-   bmask = 0x00ff0000;
-   amask = 0xff000000;
-#endif
-
-   SDL_Surface* rgbSurface = SDL_CreateRGBSurface(SDL_SWSURFACE, image->w, 
-                                 image->h, 32,
-                                 rmask, gmask, bmask, amask);
-
-   if(!rgbSurface)
+void GraphicsUtil::loadGLTexture(const char* path, GLuint& texture, int& w, int& h)
+{
+   if(CompressedTexture::load(CompressedTexture::getPath(path), texture, w, h))
    {
-      // Problem converting the image; throw an exception
-      T_T(std::string("Unable to convert image: ") + SDL_GetError());
+      return;
    }
 
-   SDL_BlitSurface(image, 0, rgbSurface, 0);
+   SDL_Surface* image = loadImage(path);
 
    w = image->w;
    h = image->h;
 
+   int pitch;
+   const unsigned char* pixels = convertToRGBA(image, pitch);
+
    // Create the texture
    DEBUG("Generating texture...");
    glGenTextures(1, &texture);
@@ -200,7 +322,7 @@ void GraphicsUtil::loadGLTexture(const char* path, GLuint& texture, int& w, int&
    // Bind this texture as the current texture OpenGL should work with
    // Any texture ops on GL_TEXTURE_2D will become associated with this texture
    DEBUG("Binding GL texture");
-   glBindTexture(GL_TEXTURE_2D, texture);
+   GLState::bindTexture(texture);
 
    // Add Linear filtering for the texture
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -208,18 +330,97 @@ void GraphicsUtil::loadGLTexture(const char* path, GLuint& texture, int& w, int&
 
    // Transfer the image data into the texture
    DEBUG("Transferring image data to GL texture");
-   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, 
-           (void*)rgbSurface->pixels);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+   glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / 4);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+   glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
    DEBUG("Freeing image surface");
    SDL_FreeSurface(image);
 
-   DEBUG("Freeing RGBA surface");
-   SDL_FreeSurface(rgbSurface);
-
    DEBUG("Texture creation complete.");
 }
 
+const TextureAtlas::Region* GraphicsUtil::loadCompressedAtlasTexture(const char* path, int& w, int& h)
+{
+   // The atlas outlives the resources packed into it, so its bookkeeping isn't counted towards them
+   MemoryTracker::Scope memoryScope(MemoryTracker::UNTAGGED);
+   GLuint texture;
+   if(!CompressedTexture::load(CompressedTexture::getPath(path), texture, w, h))
+   {
+      return NULL;
+   }
+
+   return &textureAtlas->addTexture(path, texture, w, h);
+}
+
+const TextureAtlas::Region& GraphicsUtil::loadAtlasTexture(const char* path, int& w, int& h)
+{
+   const TextureAtlas::Region* compressedRegion = loadCompressedAtlasTexture(path, w, h);
+   if(compressedRegion != NULL)
+   {
+      return *compressedRegion;
+   }
+
+   return packAtlasTexture(path, loadImage(path), w, h);
+}
+
+const TextureAtlas::Region& GraphicsUtil::loadAtlasTexture(const char* path, SDL_Surface* image, int& w, int& h)
+{
+   const TextureAtlas::Region* compressedRegion = loadCompressedAtlasTexture(path, w, h);
+   if(compressedRegion != NULL)
+   {
+      SDL_FreeSurface(image);
+      return *compressedRegion;
+   }
+
+   return packAtlasTexture(path, image, w, h);
+}
+
+const TextureAtlas::Region& GraphicsUtil::packAtlasTexture(const char* path, SDL_Surface* image, int& w, int& h)
+{
+   w = image->w;
+   h = image->h;
+
+   int pitch;
+   const unsigned char* pixels = convertToRGBA(image, pitch);
+
+   DEBUG("Packing image data into the texture atlas");
+   MemoryTracker::Scope memoryScope(MemoryTracker::UNTAGGED);
+   const TextureAtlas::Region& region = textureAtlas->add(path, pixels, pitch, w, h);
+
+   DEBUG("Freeing image surface");
+   SDL_FreeSurface(image);
+
+   return region;
+}
+
+const TextureAtlas::Region& GraphicsUtil::streamAtlasTexture(const char* path, int& w, int& h)
+{
+   const TextureAtlas::Region* region = loadCompressedAtlasTexture(path, w, h);
+   if(region != NULL)
+   {
+      return *region;
+   }
+
+   {
+      MemoryTracker::Scope memoryScope(MemoryTracker::UNTAGGED);
+      region = textureLoader->load(path, w, h);
+   }
+
+   return region != NULL ? *region : loadAtlasTexture(path, w, h);
+}
+
+void GraphicsUtil::uploadStreamedTextures()
+{
+   textureLoader->uploadDecodedImages();
+}
+
+void GraphicsUtil::forgetAtlasTexture(const char* path)
+{
+   textureAtlas->forget(path);
+}
+
 int GraphicsUtil::getWidth()
 {
    return width;
@@ -250,29 +451,181 @@ void GraphicsUtil::setInterface(gcn::Container* newTop)
    }
 
    top = newTop;
+   invalidateGUI();
 }
 
 void GraphicsUtil::stepGUI()
 {
+   // In the middle of play, the GUI is mostly a hidden console and a dialogue box that only change when told to
+   if(!guiLogicPending && animatedWidgets.empty() && input->isKeyQueueEmpty() && input->isMouseQueueEmpty())
+   {
+      return;
+   }
+
+   PROFILE_ZONE("gcn::Gui::logic");
+   MemoryTracker::Scope memoryScope(MemoryTracker::GUI);
    gui->logic();
+   guiLogicPending = false;
+
+   // The logic may have laid the widgets out again
+   guiChanged = true;
+}
+
+void GraphicsUtil::setAnimating(gcn::Widget* widget, bool animating)
+{
+   if(animating)
+   {
+      animatedWidgets.insert(widget);
+   }
+   else
+   {
+      animatedWidgets.erase(widget);
+   }
+}
+
+SpriteBatch* GraphicsUtil::getSpriteBatch()
+{
+   return spriteBatch;
+}
+
+bool GraphicsUtil::isSceneLayered() const
+{
+   if(!RenderTarget::isSupported()) return false;
+   return maxSceneScale < 1.0f || (frameBudget > 0.0 && GPUTimer::isSupported());
+}
+
+void GraphicsUtil::beginScene()
+{
+   if(!isSceneLayered()) return;
+
+   // The timer runs until the frame is submitted, so that the budget covers what is drawn over the scene as well
+   frameTimer->begin();
+
+   spriteBatch->flush();
+   sceneLayer->begin(sceneScale);
+   drawingScene = true;
+}
+
+void GraphicsUtil::endScene()
+{
+   if(!drawingScene) return;
+
+   PROFILE_ZONE("GraphicsUtil::endScene");
+   spriteBatch->flush();
+   sceneLayer->end();
+   sceneLayer->drawOpaque(width, height);
+   drawingScene = false;
+}
+
+float GraphicsUtil::getSceneScale() const
+{
+   return isSceneLayered() ? sceneScale : 1.0f;
+}
+
+void GraphicsUtil::adjustSceneScale()
+{
+   if(frameBudget <= 0.0 || !frameTimer->poll() || framesSinceScaleChange < SCALE_SETTLE_FRAMES) return;
+
+   const double gpuTime = frameTimer->getLastTime();
+   float newScale = sceneScale;
+   if(gpuTime > frameBudget * SCALE_DOWN_THRESHOLD)
+   {
+      newScale = std::max(sceneScale - SCENE_SCALE_STEP, MIN_SCENE_SCALE);
+   }
+   else if(gpuTime < frameBudget * SCALE_UP_THRESHOLD)
+   {
+      newScale = std::min(sceneScale + SCENE_SCALE_STEP, maxSceneScale);
+   }
+
+   if(newScale != sceneScale)
+   {
+      DEBUG("The GPU took %.2f ms to draw a frame (with a budget of %.2f ms); drawing the scene at %d%% resolution.",
+            gpuTime, frameBudget, static_cast<int>(newScale * 100.0f + 0.5f));
+      sceneScale = newScale;
+      framesSinceScaleChange = 0;
+   }
 }
 
 void GraphicsUtil::drawGUI()
 {
-   // Draw the GUI to buffer
-   gui->draw();
+   MemoryTracker::Scope memoryScope(MemoryTracker::GUI);
+
+   // Draw the sprites under the GUI
+   spriteBatch->flush();
+
+   PROFILE_GPU_PASS("GUI");
+   if(!RenderTarget::isSupported())
+   {
+      // Without an offscreen layer to keep the GUI in, it is drawn to buffer every frame
+      PROFILE_ZONE("gcn::Gui::draw");
+      gui->draw();
+   }
+   else
+   {
+      if(guiChanged)
+      {
+         PROFILE_ZONE("gcn::Gui::draw");
+         guiLayer->begin();
+         gui->draw();
+         guiLayer->end();
+         guiChanged = false;
+      }
+
+      guiLayer->draw();
+   }
+}
+
+ScreenTransition* GraphicsUtil::getTransition()
+{
+   return transition;
+}
+
+FrameCapture* GraphicsUtil::getFrameCapture()
+{
+   return frameCapture;
+}
+
+void GraphicsUtil::drawTransition()
+{
+   transition->draw(width, height);
+}
 
-   // Update the screen
-   SDL_GL_SwapBuffers();
+void GraphicsUtil::invalidateGUI()
+{
+   guiChanged = true;
+   guiLogicPending = true;
 }
 
 void GraphicsUtil::pushInput(SDL_Event event)
 {
+   switch(event.type)
+   {
+      case SDL_KEYDOWN:
+      case SDL_KEYUP:
+      case SDL_MOUSEMOTION:
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+      case SDL_ACTIVEEVENT:
+      {
+         // The widgets may react to any of these, so they have to be drawn again
+         invalidateGUI();
+         break;
+      }
+      default:
+      {
+         break;
+      }
+   }
+
    input->pushInput(event);
 }
 
 void GraphicsUtil::clearBuffer()
 {
+   // Guichan binds textures behind the state tracker's back whenever it loads an image,
+   // so the tracked state is only trusted within a frame
+   GLState::invalidate();
+
    glMatrixMode(GL_MODELVIEW);
    glClear(GL_COLOR_BUFFER_BIT);
    glLoadIdentity();
@@ -283,6 +636,7 @@ void GraphicsUtil::setOffset(int xOffset, int yOffset)
    glTranslated(xOffset - currentXOffset, yOffset - currentYOffset, 0);
    currentXOffset = xOffset;
    currentYOffset = yOffset;
+   spriteBatch->setOffset(xOffset, yOffset);
 }
 
 void GraphicsUtil::resetOffset()
@@ -290,56 +644,31 @@ void GraphicsUtil::resetOffset()
    glTranslated(-currentXOffset, -currentYOffset, 0);
    currentXOffset = 0;
    currentYOffset = 0;
+   spriteBatch->setOffset(0, 0);
 }
 
-void GraphicsUtil::FadeToColor(float red, float green, float blue, int delay)
+void GraphicsUtil::closeFont()
 {
-   long time = SDL_GetTicks();
-   float alpha = 0.0f;
-
-   GLint oldSrcFactor, oldDstFactor;
-   glGetIntegerv(GL_BLEND_SRC, &oldSrcFactor);
-   glGetIntegerv(GL_BLEND_DST, &oldDstFactor);
-   bool blendEnabled = glIsEnabled(GL_BLEND);
-   bool dTestEnabled = glIsEnabled(GL_DEPTH_TEST);
-   bool tex2dEnabled = glIsEnabled(GL_TEXTURE_2D);
-
-   glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-   if(!blendEnabled) glEnable(GL_BLEND);
-   if(dTestEnabled)  glDisable(GL_DEPTH_TEST);
-   if(tex2dEnabled)  glDisable(GL_TEXTURE_2D);
-
-   for (;;)
-   {
-      glBegin(GL_QUADS);
-         glColor4f(red, green, blue, alpha);
-         glVertex3f( 0.0f,         0.0f,          0.0f);
-         glVertex3f( (float)width, 0.0f,          0.0f);
-         glVertex3f( (float)width, (float)height, 0.0f);
-         glVertex3f( 0.0f,         (float)height, 0.0f);
-      glEnd();
-
-      GraphicsUtil::getInstance()->flipScreen();
- 
-      long timePassed = SDL_GetTicks() - time;
-      alpha = ((timePassed*1.0f)/delay);
-
-      //We're done when alpha reaches 1.0
-      if (alpha >= 1.0f)
-      {
-         glColor3f(1.0f,1.0f,1.0f);
-         break;
-      }
-   }
-
-   if(tex2dEnabled)  glEnable(GL_TEXTURE_2D);
-   if(dTestEnabled)  glEnable(GL_DEPTH_TEST);
-   if(!blendEnabled) glDisable(GL_BLEND);
-   glBlendFunc(oldSrcFactor,oldDstFactor);
+   gcn::Widget::setGlobalFont(NULL);
+   delete font;
+   font = NULL;
 }
 
 void GraphicsUtil::finish()
 {
+   // The sprite batch's vertex buffer, the atlas pages, the GUI and scene layers, the frame timers' queries and the frame capture's pixel buffers
+   // belong to the OpenGL context, so they go before SDL does.
+   // The texture loader goes before the atlas, since it uploads decoded images into it.
+   delete spriteBatch;
+   delete textureLoader;
+   delete textureAtlas;
+   delete guiLayer;
+   delete sceneLayer;
+   delete frameTimer;
+   GPUPassTimer::releaseQueries();
+   delete frameCapture;
+   delete transition;
+
    //Destroys some Guichan stuff
    delete font;
    delete guiContainer;
@@ -347,6 +676,10 @@ void GraphicsUtil::finish()
    delete imageLoader;
    delete graphics;
    delete input;
+   animatedWidgets.clear();
+
+   // Everything drawn with the offscreen context is gone, so it can go too
+   delete headlessContext;
 
    //Destroy the SDL_ttf stuff
    if(!TTF_WasInit())
@@ -356,4 +689,7 @@ void GraphicsUtil::finish()
 
    // Destroy SDL stuff
    SDL_Quit();
+
+   // Every subsystem has shut down by now, so whatever they still hold was never freed
+   MemoryTracker::reportLeaks("GraphicsUtil::destroy", MemoryTracker::TILE_ENGINE, MemoryTracker::AUDIO);
 }
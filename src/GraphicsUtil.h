@@ -8,9 +8,19 @@
 #define GRAPHICS_UTIL_H
 
 #include "Singleton.h"
+#include "TextureAtlas.h"
+#include <set>
+#include <vector>
 
 struct SDL_Surface;
 union SDL_Event;
+class SpriteBatch;
+class RenderTarget;
+class GPUTimer;
+class FrameCapture;
+class ScreenTransition;
+class TextureLoader;
+class HeadlessContext;
 
 namespace gcn
 {
@@ -19,11 +29,13 @@ namespace gcn
    class OpenGLSDLImageLoader;
    class Gui;
    class Container;
+   class Widget;
 };
     
 namespace edwt
 {
    class Container;
+   class OpenGLGraphics;
    class OpenGLTrueTypeFont;
 };
 
@@ -42,11 +54,23 @@ class GraphicsUtil : public Singleton<GraphicsUtil>
    /** The screen surface */    
    static SDL_Surface* screen;
 
+   /** Whether or not the engine draws into an offscreen buffer instead of a window. */
+   static bool headless;
+
+   /** The offscreen context that the engine draws into when it runs headless, or NULL if it draws into a window. */
+   HeadlessContext* headlessContext;
+
+   /** The largest fraction of the screen's resolution that the scene is drawn at (see configureSceneScale). */
+   static float maxSceneScale;
+
+   /** The time that the GPU should take to draw a frame (in milliseconds), or 0 if the scene's resolution stays fixed. */
+   static double frameBudget;
+
    /** The Guichan SDL input driver */
    gcn::SDLInput* input;
 
    /** The Guichan OpenGL Graphics driver */
-   gcn::OpenGLGraphics* graphics;
+   edwt::OpenGLGraphics* graphics;
 
    /** The Guichan OpenGL image loader (for loading images via SDL) */
    gcn::OpenGLSDLImageLoader* imageLoader;
@@ -69,9 +93,103 @@ class GraphicsUtil : public Singleton<GraphicsUtil>
    /** The y-offset to draw at (in pixels). */
    int currentYOffset;
 
+   /** The batch that sprites are drawn into over the course of a frame. */
+   SpriteBatch* spriteBatch;
+
+   /** The atlas that spritesheet and tileset images are packed into. */
+   TextureAtlas* textureAtlas;
+
+   /** The loader that decodes spritesheet images in the background. */
+   TextureLoader* textureLoader;
+
+   /** The buffer that images loaded on the main thread are converted to RGBA in, kept between loads. */
+   std::vector<unsigned char> stagingPixels;
+
+   /**
+    * Gets the pixels of a loaded image as 32-bit RGBA, converting them into the staging buffer if need be.
+    * If the image can't be converted, it is freed before the exception is passed on.
+    *
+    * @param image The loaded image
+    * @param pitch The parameter used to return the number of bytes in each row of pixels
+    *
+    * @return The image's RGBA pixels, which are valid until the image is freed or another image is converted
+    */
+   const unsigned char* convertToRGBA(SDL_Surface* image, int& pitch);
+
+   /**
+    * Load the compressed version of the image given in the path into a page of its own
+    * in the texture atlas, if there is a compressed version that the driver can draw.
+    *
+    * @param path The file path to the uncompressed image
+    * @param w The parameter used to return image width
+    * @param h The parameter used to return image height
+    *
+    * @return The region of the atlas that holds the image, or NULL if the compressed image wasn't loaded
+    */
+   const TextureAtlas::Region* loadCompressedAtlasTexture(const char* path, int& w, int& h);
+
+   /**
+    * Pack a loaded image into the shared texture atlas, and free the image.
+    *
+    * @param path The file path that the image was loaded from
+    * @param image The loaded image
+    * @param w The parameter used to return image width
+    * @param h The parameter used to return image height
+    *
+    * @return The region of the atlas that holds the image
+    */
+   const TextureAtlas::Region& packAtlasTexture(const char* path, SDL_Surface* image, int& w, int& h);
+
+   /** The offscreen layer that the GUI widgets are drawn into, and redrawn from until they change. */
+   RenderTarget* guiLayer;
+
+   /** Whether or not the GUI widgets may have changed since they were last drawn into the layer. */
+   bool guiChanged;
+
+   /** Whether or not the GUI widgets may have changed since their logic was last run. */
+   bool guiLogicPending;
+
+   /** The widgets that have asked for their logic to be run on every frame (see setAnimating). */
+   std::set<gcn::Widget*> animatedWidgets;
+
+   /** The offscreen layer that the scene is drawn into at a lower resolution than the screen, and stretched over it from. */
+   RenderTarget* sceneLayer;
+
+   /** Measures how long the GPU takes to draw each frame, so that the scene's resolution can follow the frame budget. */
+   GPUTimer* frameTimer;
+
+   /** Reads back each submitted frame while frames are being captured (see the /capture debug command). */
+   FrameCapture* frameCapture;
+
+   /** The fraction of the screen's resolution that the scene is drawn at. */
+   float sceneScale;
+
+   /** The number of frames submitted since the scene's resolution last changed. */
+   int framesSinceScaleChange;
+
+   /** Whether or not drawing is going into the scene layer (between beginScene and endScene). */
+   bool drawingScene;
+
+   /**
+    * @return true iff the scene should be drawn into the scene layer, instead of straight to the screen.
+    */
+   bool isSceneLayered() const;
+
+   /**
+    * Reads back how long the GPU took to draw the latest frames, and lowers the scene's resolution
+    * if they went over the frame budget (or raises it back if they came in well under it).
+    */
+   void adjustSceneScale();
+
+   /** The transition drawn over the screen at the end of each frame. */
+   ScreenTransition* transition;
+
+   /** Whether or not a frame has been submitted to the driver, but hasn't been shown on screen yet. */
+   bool framePending;
+
    /**
-    * Initializes SDL audio and video bindings
-    * Initializes SDL mixer and TTF libraries
+    * Initializes SDL video bindings
+    * Initializes the SDL TTF library
     * Initializes an OpenGL viewport and projection
     */
    void initSDL();
@@ -105,7 +223,52 @@ class GraphicsUtil : public Singleton<GraphicsUtil>
    
       /** The screen height (currently HARDCODED) */
       static const int height = 600;
+
+      /** Whether or not buffer swaps wait for the display's vertical refresh (currently HARDCODED) */
+      static const bool vsyncEnabled = true;
    
+      /**
+       * Sets whether the engine draws into an offscreen buffer instead of a window (such as for automated
+       * performance runs on machines without a display). Video goes to SDL's dummy driver, and
+       * OpenGL draws into an EGL pbuffer (audio is sent to the dummy driver by AudioSystem::setHeadless). This has to be set before the GraphicsUtil instance is first used.
+       *
+       * @param enabled true iff the engine should run headless.
+       */
+      static void setHeadless(bool enabled);
+
+      /**
+       * @return true iff the engine draws into an offscreen buffer instead of a window.
+       */
+      static bool isHeadless();
+
+      /**
+       * Sets the resolution that the scene (everything drawn before the GUI) is drawn at, as a fraction of the screen's.
+       * The scene is stretched over the screen with smooth filtering, while the GUI, the transition and
+       * the profiler overlay are still drawn at the screen's resolution. With a frame budget, the resolution is
+       * lowered (down to half of the screen's) while the GPU takes longer than the budget to draw each frame,
+       * and raised back towards the given scale once it catches up. This has to be set before the GraphicsUtil instance
+       * is first used, and is ignored where the driver can't draw into render targets (or measure the GPU, for the budget).
+       *
+       * @param scale The fraction of the screen's width and height to draw the scene at (at most 1).
+       * @param budget The time that the GPU should take to draw a frame (in milliseconds), or 0 to keep the resolution fixed.
+       */
+      static void configureSceneScale(float scale, double budget);
+
+      /**
+       * Looks up an OpenGL extension function from the driver of the context that the engine draws with.
+       *
+       * @param name The name of the function.
+       *
+       * @return The function, or NULL if the driver doesn't have it.
+       */
+      static void* getProcAddress(const char* name);
+
+      /**
+       * Closes the global default font, and has the widgets fall back on Guichan's built-in font.
+       * The font holds its font file, so it has to be closed before the ResourceLoader frees its resources.
+       */
+      void closeFont();
+
       /**
        * @return The width of the screen
        */
@@ -125,7 +288,8 @@ class GraphicsUtil : public Singleton<GraphicsUtil>
    
       /**
        * Load the texture given in the path, set the tileset's height
-       * and width based on the bitmap
+       * and width based on the bitmap.
+       * If a compressed version of the image is beside it, that is loaded instead.
        *
        * @param path The file path to the tileset
        * @param texture The parameter used to return the OpenGL texture index
@@ -133,24 +297,161 @@ class GraphicsUtil : public Singleton<GraphicsUtil>
        * @param h The parameter used to return image height
        */
       void loadGLTexture(const char* path, GLuint& texture, int& w, int& h);
+
+      /**
+       * Loads an image, in whatever pixel format it was stored in.
+       * This doesn't touch the OpenGL context, so it can be called from any thread.
+       * PixelConverter gets the image's pixels as 32-bit RGBA.
+       *
+       * @param path The file path to the image
+       *
+       * @return The loaded image, which must be freed by the caller
+       */
+      static SDL_Surface* loadImage(const char* path);
+
+      /**
+       * Load the image given in the path into the shared texture atlas, unless it is already there.
+       * If a compressed version of the image is beside it, that is loaded into a page of its own instead.
+       * The atlas texture belongs to the atlas, and must not be deleted by the caller.
+       *
+       * @param path The file path to the image
+       * @param w The parameter used to return image width
+       * @param h The parameter used to return image height
+       *
+       * @return The region of the atlas that holds the image
+       */
+      const TextureAtlas::Region& loadAtlasTexture(const char* path, int& w, int& h);
+
+      /**
+       * Load an image that has already been loaded from the given path (such as in the background) into the
+       * shared texture atlas, as in loadAtlasTexture. The image is freed, even if a compressed version is used instead.
+       *
+       * @param path The file path that the image was loaded from
+       * @param image The loaded image, which is freed
+       * @param w The parameter used to return image width
+       * @param h The parameter used to return image height
+       *
+       * @return The region of the atlas that holds the image
+       */
+      const TextureAtlas::Region& loadAtlasTexture(const char* path, SDL_Surface* image, int& w, int& h);
+
+      /**
+       * Reserve space for the image given in the path in the shared texture atlas, and decode the image
+       * in the background. The image is drawn transparent until it has been decoded and uploaded.
+       * Compressed images, and images whose size can't be read up front, are loaded right away, as in loadAtlasTexture.
+       *
+       * @param path The file path to the image
+       * @param w The parameter used to return image width
+       * @param h The parameter used to return image height
+       *
+       * @return The region of the atlas that holds (or will hold) the image
+       */
+      const TextureAtlas::Region& streamAtlasTexture(const char* path, int& w, int& h);
+
+      /**
+       * Upload the images decoded in the background since the last frame into the texture atlas.
+       * This should happen once per frame, before anything is drawn.
+       */
+      void uploadStreamedTextures();
+
+      /**
+       * Forget the space given to an image in the shared texture atlas (such as when its file has changed),
+       * so that it is loaded afresh the next time it is loaded into the atlas. Regions that were handed out
+       * for the image can still be drawn, and keep showing the old image.
+       *
+       * @param path The file path to the image
+       */
+      void forgetAtlasTexture(const char* path);
    
       /**
-       * Flush any enqueued GL commands and then flip the screen buffer
+       * Flush any enqueued GL commands and then flip the screen buffer.
+       * This should happen exactly once per frame.
        */
       void flipScreen();
+
+      /**
+       * Hand the enqueued GL commands for the frame to the driver, without waiting for them to be drawn,
+       * so that the CPU can get on with the next frame's logic while the GPU draws this one.
+       * The frame isn't shown on screen until presentFrame is called.
+       */
+      void submitFrame();
+
+      /**
+       * Flip the screen buffer to show the last submitted frame, if it hasn't been shown yet.
+       * This must happen before the next frame is drawn over the back buffer.
+       */
+      void presentFrame();
    
       /**
-       * Run GUI widget logic
+       * Run GUI widget logic and hand queued input to the widgets.
+       * Widgets are left alone on frames where nothing could have changed them: no input is queued,
+       * the GUI hasn't been invalidated since the last step, and no widget is animating.
        */
       void stepGUI();
+
+      /**
+       * Sets whether a widget needs its logic run on every frame, such as while it is animating.
+       * Other widgets only have their logic run when the GUI is invalidated or given input.
+       * A widget that is animating must stop before it is deleted.
+       *
+       * @param widget The widget.
+       * @param animating true iff the widget's logic has to run on every frame.
+       */
+      void setAnimating(gcn::Widget* widget, bool animating);
    
       /**
-       * Draw GUI widgets to the screen
+       * Redirects the scene's drawing into the scene layer, if it is drawn at a lower resolution than the screen.
+       * This should happen once per frame, before the scene is drawn.
+       */
+      void beginScene();
+
+      /**
+       * Draws the sprites batched so far and then stretches the scene layer over the screen, if beginScene redirected the scene into it.
+       * This should happen once per frame, before the GUI is drawn.
+       */
+      void endScene();
+
+      /**
+       * @return The fraction of the screen's resolution that the scene is being drawn at.
+       */
+      float getSceneScale() const;
+
+      /**
+       * @return The batch that sprites are drawn into. The batch is drawn before the GUI widgets.
+       */
+      SpriteBatch* getSpriteBatch();
+
+      /**
+       * Draw the sprites batched so far, then the GUI widgets, to the back buffer.
+       * The widgets are only drawn again if the GUI has been invalidated since the last frame;
+       * otherwise, the previous frame's GUI is reused.
        */
       void drawGUI();
 
       /**
-       * Push an SDL input event to the widgets
+       * @return The transition drawn over the screen. It is played forward with every logic step.
+       */
+      ScreenTransition* getTransition();
+
+      /**
+       * Draw the screen transition (if it covers any of the screen) over everything drawn so far this frame.
+       */
+      void drawTransition();
+
+      /**
+       * @return The capture that records the submitted frames to disk, when started.
+       */
+      FrameCapture* getFrameCapture();
+
+      /**
+       * Mark the GUI widgets as changed, so that their logic is run and they are drawn again on the next frame.
+       * Widgets are invalidated automatically when input is pushed to them or the interface changes;
+       * anything that changes them otherwise (such as a timer or a script) must call this.
+       */
+      void invalidateGUI();
+
+      /**
+       * Push an SDL input event to the widgets, invalidating the GUI if it is a keyboard or mouse event
        *
        * @param event the input event to send to the widgets
        */
@@ -171,16 +472,6 @@ class GraphicsUtil : public Singleton<GraphicsUtil>
        */
       void resetOffset();
 
-      /** 
-       *  Graphical effect: Fade to a specific colour in a specified time period
-       *
-       *  @param red   The amount of red   (0.0f <= red <= 1.0f)
-       *  @param green The amount of green (0.0f <= green <= 1.0f)
-       *  @param blue  The amount of blue  (0.0f <= blue <= 1.0f)
-       *  @param delay The amount of time taken for the fade (in milliseconds)
-       */
-      void FadeToColor(float red, float green, float blue, int delay);
-   
       /**
        * Clear the color buffers and reset the model matrix
        * \todo Come up with a better name for this (though that suggestion indicates that this method may not be good design).
@@ -0,0 +1,121 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "HeadlessContext.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+
+#ifdef EDEN_HEADLESS
+#include <EGL/egl.h>
+#endif
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+#ifdef EDEN_HEADLESS
+
+HeadlessContext::HeadlessContext(int width, int height) : display(NULL), surface(NULL), context(NULL)
+{
+   EGLDisplay eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+   EGLint majorVersion, minorVersion;
+   if(eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &majorVersion, &minorVersion))
+   {
+      T_T("Unable to create a headless context: couldn't connect to an EGL display.");
+   }
+
+   display = eglDisplay;
+   DEBUG("Initialized EGL %d.%d for headless rendering.", majorVersion, minorVersion);
+
+   // The engine draws with desktop OpenGL, into the same 32-bit colour buffer and depth buffer that the window would have
+   const EGLint configAttributes[] =
+   {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_RED_SIZE, 8,
+      EGL_GREEN_SIZE, 8,
+      EGL_BLUE_SIZE, 8,
+      EGL_ALPHA_SIZE, 8,
+      EGL_DEPTH_SIZE, 16,
+      EGL_NONE
+   };
+
+   EGLConfig config;
+   EGLint configCount = 0;
+   if(!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount) || configCount == 0 || !eglBindAPI(EGL_OPENGL_API))
+   {
+      release();
+      T_T("Unable to create a headless context: the EGL display doesn't support OpenGL pbuffers.");
+   }
+
+   const EGLint surfaceAttributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+   surface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttributes);
+   context = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, NULL);
+   if(surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, surface, surface, static_cast<EGLContext>(context)))
+   {
+      release();
+      T_T("Unable to create a headless context: couldn't create an OpenGL context drawing into a pbuffer.");
+   }
+
+   DEBUG("Created %dx%d headless context.", width, height);
+}
+
+void HeadlessContext::release()
+{
+   EGLDisplay eglDisplay = static_cast<EGLDisplay>(display);
+   if(eglDisplay == NULL) return;
+
+   eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+   if(context != NULL && context != EGL_NO_CONTEXT)
+   {
+      eglDestroyContext(eglDisplay, static_cast<EGLContext>(context));
+   }
+
+   if(surface != NULL && surface != EGL_NO_SURFACE)
+   {
+      eglDestroySurface(eglDisplay, static_cast<EGLSurface>(surface));
+   }
+
+   eglTerminate(eglDisplay);
+
+   display = NULL;
+   surface = NULL;
+   context = NULL;
+}
+
+void* HeadlessContext::getProcAddress(const char* name)
+{
+   return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+#else
+
+HeadlessContext::HeadlessContext(int /*width*/, int /*height*/) : display(NULL), surface(NULL), context(NULL)
+{
+   T_T("Unable to create a headless context: this build doesn't support headless rendering (configure it with EDEN_HEADLESS).");
+}
+
+void HeadlessContext::release()
+{
+}
+
+void* HeadlessContext::getProcAddress(const char* /*name*/)
+{
+   return NULL;
+}
+
+#endif
+
+void HeadlessContext::swapBuffers()
+{
+   // There's no window to show the frame in, but waiting for it keeps frame times honest
+   glFinish();
+}
+
+HeadlessContext::~HeadlessContext()
+{
+   release();
+}
@@ -0,0 +1,70 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+/**
+ * An OpenGL context that draws into an offscreen EGL pbuffer instead of a window,
+ * so that the engine can run (and be timed) on machines without a display, such as build servers.
+ * Everything drawn into it goes through the same driver as it would on screen; it just never gets shown.
+ *
+ * Headless contexts are only available in builds configured with EDEN_HEADLESS, which links against EGL.
+ * In other builds, creating one throws an exception.
+ */
+class HeadlessContext
+{
+   /** The EGL display connection, or NULL if there isn't one. */
+   void* display;
+
+   /** The EGL pbuffer surface that the context draws into, or NULL if there isn't one. */
+   void* surface;
+
+   /** The EGL context, or NULL if there isn't one. */
+   void* context;
+
+   /**
+    * Releases whatever parts of the context have been created.
+    */
+   void release();
+
+   /** Headless contexts can't be copied. */
+   HeadlessContext(const HeadlessContext&);
+
+   /** Headless contexts can't be copied. */
+   HeadlessContext& operator=(const HeadlessContext&);
+
+   public:
+      /**
+       * Constructor. Creates an OpenGL context drawing into an offscreen buffer, and makes it current.
+       *
+       * @param width The width of the offscreen buffer (in pixels).
+       * @param height The height of the offscreen buffer (in pixels).
+       */
+      HeadlessContext(int width, int height);
+
+      /**
+       * Looks up an OpenGL extension function from the headless context's driver.
+       *
+       * @param name The name of the function.
+       *
+       * @return The function, or NULL if the driver doesn't have it.
+       */
+      static void* getProcAddress(const char* name);
+
+      /**
+       * Finishes the frame. Nothing is shown, so this only waits for the frame's drawing to finish,
+       * so that frames are timed the same way as they are on screen.
+       */
+      void swapBuffers();
+
+      /**
+       * Destructor. Releases the context and its offscreen buffer.
+       */
+      ~HeadlessContext();
+};
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "InputQueue.h"
+#include "InputReplay.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_MAIN;
+
+/** The key that each action maps to, in the same order as the actions. */
+static const SDLKey ACTION_KEYS[] = { SDLK_UNKNOWN, SDLK_UP, SDLK_DOWN, SDLK_LEFT, SDLK_RIGHT, SDLK_SPACE, SDLK_ESCAPE, SDLK_BACKQUOTE };
+
+std::deque<InputQueue::Input> InputQueue::inputs;
+bool InputQueue::heldActions[InputQueue::ACTION_COUNT] = { false };
+
+InputQueue::Action InputQueue::getAction(SDLKey key)
+{
+   for(int action = NO_ACTION + 1; action < ACTION_COUNT; ++action)
+   {
+      if(ACTION_KEYS[action] == key)
+      {
+         return static_cast<Action>(action);
+      }
+   }
+
+   return NO_ACTION;
+}
+
+void InputQueue::drain()
+{
+   Input input;
+   while(InputReplay::pollEvent(&input.event))
+   {
+      const bool keyEvent = input.event.type == SDL_KEYDOWN || input.event.type == SDL_KEYUP;
+      input.action = keyEvent ? getAction(input.event.key.keysym.sym) : NO_ACTION;
+      input.pressed = input.event.type == SDL_KEYDOWN;
+      input.timestamp = SDL_GetTicks();
+      inputs.push_back(input);
+   }
+
+   const Uint8* keyState = InputReplay::getKeyState();
+   for(int action = NO_ACTION + 1; action < ACTION_COUNT; ++action)
+   {
+      heldActions[action] = keyState[ACTION_KEYS[action]] != 0;
+   }
+}
+
+bool InputQueue::poll(Input& input)
+{
+   if(inputs.empty()) return false;
+
+   input = inputs.front();
+   inputs.pop_front();
+   return true;
+}
+
+void InputQueue::wait(Input& input)
+{
+   while(!poll(input))
+   {
+      // Waiting on SDL with no event to fill in leaves the event in SDL's queue for drain to take
+      if(SDL_WaitEvent(NULL) == 0)
+      {
+         T_T(std::string("Unable to wait for input: ") + SDL_GetError());
+      }
+
+      drain();
+   }
+}
+
+bool InputQueue::isHeld(Action action)
+{
+   return heldActions[action];
+}
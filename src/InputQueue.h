@@ -0,0 +1,113 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include "SDL.h"
+#include <deque>
+
+/**
+ * Collects the game's input once per logic step, so that the game states can handle every event that arrived
+ * since the last step, in the order they arrived, instead of one event per step.
+ *
+ * At the start of each step, every pending event is drained (through InputReplay, so that the input can
+ * be recorded and played back) into a queue. Key events for the keys that the game uses are mapped to actions,
+ * so that the states react to actions instead of to particular keys. The states take the inputs off the
+ * queue with poll(), and pass whatever they don't handle on to the GUI.
+ *
+ * Which actions are held down is also noted at the start of each step, so that everything in the step
+ * (such as the player character's movement) sees the same keyboard.
+ */
+class InputQueue
+{
+   public:
+      /** What the player can ask the game to do. */
+      enum Action
+      {
+         /** The input isn't one of the game's actions (such as a mouse event, or a key that has no action). */
+         NO_ACTION,
+         /** Move up. */
+         MOVE_UP,
+         /** Move down. */
+         MOVE_DOWN,
+         /** Move left. */
+         MOVE_LEFT,
+         /** Move right. */
+         MOVE_RIGHT,
+         /** Talk to whoever is in front of the player, or move the dialogue along. */
+         CONFIRM,
+         /** Leave the current state. */
+         CANCEL,
+         /** Show or hide the debug console. */
+         TOGGLE_CONSOLE,
+         /** The number of actions. */
+         ACTION_COUNT
+      };
+
+      /** An input event, along with the action it maps to. */
+      struct Input
+      {
+         /** The event, as it came from SDL (or from a recording). */
+         SDL_Event event;
+
+         /** The action that the event's key maps to, or NO_ACTION if it isn't a key event for an action. */
+         Action action;
+
+         /** Whether the action's key was pressed (as opposed to released). */
+         bool pressed;
+
+         /** The time (in milliseconds since SDL started) that the event was taken from SDL. */
+         Uint32 timestamp;
+      };
+
+   private:
+      /** The inputs waiting to be handled, in the order they arrived. */
+      static std::deque<Input> inputs;
+
+      /** Whether or not each action was held down at the start of the current step. */
+      static bool heldActions[ACTION_COUNT];
+
+      /**
+       * @param key A key.
+       *
+       * @return The action that the key maps to, or NO_ACTION if it doesn't map to one.
+       */
+      static Action getAction(SDLKey key);
+
+   public:
+      /**
+       * Takes every pending event, adding them to the back of the queue, and notes down which actions are held down.
+       * This is called at the start of each logic step.
+       */
+      static void drain();
+
+      /**
+       * Takes the next input off the front of the queue.
+       *
+       * @param input The parameter used to return the input.
+       *
+       * @return true iff there was an input in the queue.
+       */
+      static bool poll(Input& input);
+
+      /**
+       * Takes the next input off the front of the queue, waiting for an event to arrive if the queue is empty
+       * (for states that only change when there is input, such as the title screen).
+       *
+       * @param input The parameter used to return the input.
+       */
+      static void wait(Input& input);
+
+      /**
+       * @param action An action.
+       *
+       * @return true iff the action was held down at the start of the current step.
+       */
+      static bool isHeld(Action action);
+};
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "InputReplay.h"
+#include <algorithm>
+#include <cstring>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_MAIN;
+
+// Marks a file as an input recording, and changes whenever the format does
+static const char RECORDING_SIGNATURE[] = "EDIR0001";
+
+// The step number written after the last recorded step, so that playback knows where the session ended
+static const Uint32 END_OF_RECORDING = 0xFFFFFFFF;
+
+InputReplay::Mode InputReplay::mode = InputReplay::LIVE;
+std::fstream InputReplay::file;
+Uint32 InputReplay::stepNumber = 0;
+Uint32 InputReplay::nextRecordedStep = 0;
+Uint32 InputReplay::seed = 0;
+bool InputReplay::finished = false;
+std::vector<Uint8> InputReplay::keyState(SDLK_LAST, 0);
+bool InputReplay::keyStateRecorded = false;
+std::vector<std::pair<Uint16, Uint8> > InputReplay::keyChanges;
+std::deque<SDL_Event> InputReplay::events;
+
+/**
+ * Writes a value to a recording, as it is laid out in memory.
+ *
+ * @param file The recording.
+ * @param value The value to write.
+ */
+template<typename T> static void writeValue(std::fstream& file, T value)
+{
+   file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * Reads a value written by writeValue.
+ *
+ * @param file The recording.
+ *
+ * @return The value, or 0 if the recording ended.
+ */
+template<typename T> static T readValue(std::fstream& file)
+{
+   T value = 0;
+   file.read(reinterpret_cast<char*>(&value), sizeof(T));
+   return value;
+}
+
+bool InputReplay::record(const std::string& path, Uint32 randomSeed)
+{
+   stop();
+
+   file.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+   if(!file)
+   {
+      DEBUG("Unable to record input to %s.", path.c_str());
+      return false;
+   }
+
+   file.write(RECORDING_SIGNATURE, sizeof(RECORDING_SIGNATURE) - 1);
+   writeValue<Uint32>(file, randomSeed);
+
+   seed = randomSeed;
+   mode = RECORDING;
+   DEBUG("Recording input to %s.", path.c_str());
+   return true;
+}
+
+bool InputReplay::play(const std::string& path)
+{
+   stop();
+
+   file.open(path.c_str(), std::ios::in | std::ios::binary);
+   char signature[sizeof(RECORDING_SIGNATURE) - 1];
+   if(!file || !file.read(signature, sizeof(signature)) || memcmp(signature, RECORDING_SIGNATURE, sizeof(signature)) != 0)
+   {
+      DEBUG("Unable to play back input from %s: it isn't an input recording.", path.c_str());
+      file.close();
+      return false;
+   }
+
+   seed = readValue<Uint32>(file);
+   mode = PLAYING;
+   readNextStepNumber();
+
+   DEBUG("Playing back input from %s.", path.c_str());
+   return true;
+}
+
+void InputReplay::stop()
+{
+   if(mode == RECORDING)
+   {
+      writeValue<Uint32>(file, END_OF_RECORDING);
+      writeValue<Uint32>(file, stepNumber);
+      DEBUG("Recorded %u steps of input.", static_cast<unsigned int>(stepNumber));
+   }
+
+   if(file.is_open())
+   {
+      file.close();
+   }
+
+   mode = LIVE;
+   stepNumber = 0;
+   finished = false;
+   keyChanges.clear();
+   events.clear();
+   std::fill(keyState.begin(), keyState.end(), 0);
+}
+
+InputReplay::Mode InputReplay::getMode()
+{
+   return mode;
+}
+
+Uint32 InputReplay::getSeed()
+{
+   return seed;
+}
+
+bool InputReplay::isFinished()
+{
+   return finished;
+}
+
+void InputReplay::readNextStepNumber()
+{
+   nextRecordedStep = readValue<Uint32>(file);
+   if(!file || nextRecordedStep == END_OF_RECORDING)
+   {
+      // The real end of the session follows the marker, since the last steps may not have had any input
+      nextRecordedStep = file ? readValue<Uint32>(file) : stepNumber;
+      if(!file)
+      {
+         DEBUG("Input recording ended early.");
+      }
+
+      file.close();
+   }
+}
+
+void InputReplay::beginStep()
+{
+   if(mode == RECORDING)
+   {
+      keyStateRecorded = false;
+      keyChanges.clear();
+      events.clear();
+   }
+   else if(mode == PLAYING && file.is_open() && nextRecordedStep == stepNumber)
+   {
+      readStep();
+   }
+}
+
+void InputReplay::endStep()
+{
+   if(mode == RECORDING)
+   {
+      writeStep();
+   }
+   else if(mode == PLAYING)
+   {
+      // Events that the game didn't take during their step aren't held over, just as they weren't when recorded
+      events.clear();
+   }
+
+   ++stepNumber;
+
+   if(mode == PLAYING && !file.is_open() && stepNumber >= nextRecordedStep)
+   {
+      finished = true;
+   }
+}
+
+void InputReplay::writeStep()
+{
+   if(keyChanges.empty() && events.empty()) return;
+
+   writeValue<Uint32>(file, stepNumber);
+
+   writeValue<Uint16>(file, static_cast<Uint16>(keyChanges.size()));
+   for(std::vector<std::pair<Uint16, Uint8> >::const_iterator iter = keyChanges.begin(); iter != keyChanges.end(); ++iter)
+   {
+      writeValue<Uint16>(file, iter->first);
+      writeValue<Uint8>(file, iter->second);
+   }
+
+   writeValue<Uint16>(file, static_cast<Uint16>(events.size()));
+   for(std::deque<SDL_Event>::const_iterator iter = events.begin(); iter != events.end(); ++iter)
+   {
+      writeEvent(*iter);
+   }
+}
+
+void InputReplay::readStep()
+{
+   const Uint16 keyChangeCount = readValue<Uint16>(file);
+   for(Uint16 i = 0; i < keyChangeCount; ++i)
+   {
+      const Uint16 key = readValue<Uint16>(file);
+      const Uint8 state = readValue<Uint8>(file);
+      if(key < keyState.size())
+      {
+         keyState[key] = state;
+      }
+   }
+
+   events.clear();
+   const Uint16 eventCount = readValue<Uint16>(file);
+   for(Uint16 i = 0; i < eventCount; ++i)
+   {
+      SDL_Event event;
+      readEvent(event);
+      events.push_back(event);
+   }
+
+   readNextStepNumber();
+}
+
+void InputReplay::writeEvent(const SDL_Event& event)
+{
+   writeValue<Uint8>(file, event.type);
+   switch(event.type)
+   {
+      case SDL_KEYDOWN:
+      case SDL_KEYUP:
+      {
+         writeValue<Uint8>(file, event.key.state);
+         writeValue<Uint8>(file, event.key.keysym.scancode);
+         writeValue<Uint16>(file, static_cast<Uint16>(event.key.keysym.sym));
+         writeValue<Uint16>(file, static_cast<Uint16>(event.key.keysym.mod));
+         writeValue<Uint16>(file, event.key.keysym.unicode);
+         break;
+      }
+      case SDL_MOUSEMOTION:
+      {
+         writeValue<Uint8>(file, event.motion.state);
+         writeValue<Uint16>(file, event.motion.x);
+         writeValue<Uint16>(file, event.motion.y);
+         writeValue<Sint16>(file, event.motion.xrel);
+         writeValue<Sint16>(file, event.motion.yrel);
+         break;
+      }
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+      {
+         writeValue<Uint8>(file, event.button.button);
+         writeValue<Uint8>(file, event.button.state);
+         writeValue<Uint16>(file, event.button.x);
+         writeValue<Uint16>(file, event.button.y);
+         break;
+      }
+   }
+}
+
+void InputReplay::readEvent(SDL_Event& event)
+{
+   memset(&event, 0, sizeof(event));
+   event.type = readValue<Uint8>(file);
+   switch(event.type)
+   {
+      case SDL_KEYDOWN:
+      case SDL_KEYUP:
+      {
+         event.key.state = readValue<Uint8>(file);
+         event.key.keysym.scancode = readValue<Uint8>(file);
+         event.key.keysym.sym = static_cast<SDLKey>(readValue<Uint16>(file));
+         event.key.keysym.mod = static_cast<SDLMod>(readValue<Uint16>(file));
+         event.key.keysym.unicode = readValue<Uint16>(file);
+         break;
+      }
+      case SDL_MOUSEMOTION:
+      {
+         event.motion.state = readValue<Uint8>(file);
+         event.motion.x = readValue<Uint16>(file);
+         event.motion.y = readValue<Uint16>(file);
+         event.motion.xrel = readValue<Sint16>(file);
+         event.motion.yrel = readValue<Sint16>(file);
+         break;
+      }
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+      {
+         event.button.button = readValue<Uint8>(file);
+         event.button.state = readValue<Uint8>(file);
+         event.button.x = readValue<Uint16>(file);
+         event.button.y = readValue<Uint16>(file);
+         break;
+      }
+   }
+}
+
+bool InputReplay::isRecordedEvent(const SDL_Event& event)
+{
+   switch(event.type)
+   {
+      case SDL_KEYDOWN:
+      case SDL_KEYUP:
+      case SDL_MOUSEMOTION:
+      case SDL_MOUSEBUTTONDOWN:
+      case SDL_MOUSEBUTTONUP:
+      case SDL_QUIT:
+      {
+         return true;
+      }
+      default:
+      {
+         return false;
+      }
+   }
+}
+
+bool InputReplay::pollEvent(SDL_Event* event)
+{
+   if(mode != PLAYING)
+   {
+      if(!SDL_PollEvent(event)) return false;
+
+      if(mode == RECORDING && isRecordedEvent(*event))
+      {
+         events.push_back(*event);
+      }
+
+      return true;
+   }
+
+   // Live player input is dropped during playback, but the window can still be closed
+   while(SDL_PollEvent(event))
+   {
+      if(event->type == SDL_QUIT || !isRecordedEvent(*event))
+      {
+         return true;
+      }
+   }
+
+   if(events.empty()) return false;
+
+   *event = events.front();
+   events.pop_front();
+   return true;
+}
+
+Uint8* InputReplay::getKeyState()
+{
+   if(mode == LIVE)
+   {
+      return SDL_GetKeyState(NULL);
+   }
+
+   if(mode == RECORDING && !keyStateRecorded)
+   {
+      // The keys are noted down once per step, so that everything in the step sees the same keyboard, when recorded and when played back
+      int keyCount;
+      const Uint8* liveKeyState = SDL_GetKeyState(&keyCount);
+      for(int key = 0; key < keyCount && key < static_cast<int>(keyState.size()); ++key)
+      {
+         if(keyState[key] != liveKeyState[key])
+         {
+            keyState[key] = liveKeyState[key];
+            keyChanges.push_back(std::make_pair(static_cast<Uint16>(key), liveKeyState[key]));
+         }
+      }
+
+      keyStateRecorded = true;
+   }
+
+   return &keyState[0];
+}
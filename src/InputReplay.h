@@ -0,0 +1,177 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef INPUT_REPLAY_H
+#define INPUT_REPLAY_H
+
+#include "SDL.h"
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Sits between SDL and the game's input handling, so that a session's input can be recorded to a file
+ * and played back later, such as to time the same session of play in two builds of the game.
+ *
+ * The game reads its input through pollEvent() and getKeyState() instead of through SDL. While recording,
+ * they hand out SDL's input as usual, and note down which events were handed out and how the keyboard stood
+ * in each logic step. While playing back, they hand out the recorded input for each step instead, and the
+ * live input is ignored (except for quitting the game). Since logic steps are of a fixed length, and the
+ * random number streams are seeded from the recording, the game plays out the same way every time.
+ * Playback ends the game after the last recorded step.
+ *
+ * Recordings should start at a chapter (rather than at the title screen), since the title screen waits on
+ * SDL for input without stepping. The debug console's commands aren't recorded.
+ */
+class InputReplay
+{
+   public:
+      /** What the input layer is doing. */
+      enum Mode
+      {
+         /** Input comes straight from SDL. */
+         LIVE,
+         /** Input comes from SDL, and is recorded. */
+         RECORDING,
+         /** Input comes from a recording. */
+         PLAYING
+      };
+
+   private:
+      /** What the input layer is doing. */
+      static Mode mode;
+
+      /** The file being recorded to or played back from. */
+      static std::fstream file;
+
+      /** The number of the logic step being run. */
+      static Uint32 stepNumber;
+
+      /** The number of the next step in the recording that has input, while playing back. */
+      static Uint32 nextRecordedStep;
+
+      /** The seed that the game's random numbers are drawn from. */
+      static Uint32 seed;
+
+      /** Whether or not the last recorded step has been played back. */
+      static bool finished;
+
+      /** The state of each key, as the game sees it. */
+      static std::vector<Uint8> keyState;
+
+      /** Whether or not the key state has been noted down during the current step, while recording. */
+      static bool keyStateRecorded;
+
+      /** The key state changes in the current step, as key and state pairs. */
+      static std::vector<std::pair<Uint16, Uint8> > keyChanges;
+
+      /** The events handed out in the current step while recording, or waiting to be handed out while playing back. */
+      static std::deque<SDL_Event> events;
+
+      /**
+       * Writes the input of the current step to the recording, if there was any.
+       */
+      static void writeStep();
+
+      /**
+       * Reads the input of the current step from the recording, if it has any.
+       */
+      static void readStep();
+
+      /**
+       * Reads the header of the next step from the recording, or marks the recording as played back
+       * when it reaches the end.
+       */
+      static void readNextStepNumber();
+
+      /**
+       * Writes an event to the recording.
+       *
+       * @param event The event to write.
+       */
+      static void writeEvent(const SDL_Event& event);
+
+      /**
+       * Reads an event from the recording.
+       *
+       * @param event The parameter used to return the event.
+       */
+      static void readEvent(SDL_Event& event);
+
+      /**
+       * @param event An event.
+       *
+       * @return true iff the event is player input that should be recorded.
+       */
+      static bool isRecordedEvent(const SDL_Event& event);
+
+   public:
+      /**
+       * Starts recording input to a file.
+       *
+       * @param path The path of the file to record to.
+       * @param randomSeed The seed that the game's random numbers are drawn from, to be played back along with the input.
+       *
+       * @return true iff the file could be opened.
+       */
+      static bool record(const std::string& path, Uint32 randomSeed);
+
+      /**
+       * Starts playing back a recording.
+       *
+       * @param path The path of the recording.
+       *
+       * @return true iff the recording could be opened.
+       */
+      static bool play(const std::string& path);
+
+      /**
+       * Finishes recording or playing back, and closes the file.
+       */
+      static void stop();
+
+      /**
+       * @return What the input layer is doing.
+       */
+      static Mode getMode();
+
+      /**
+       * @return The seed that the game's random numbers should be drawn from while recording or playing back.
+       */
+      static Uint32 getSeed();
+
+      /**
+       * @return true iff a recording is being played back, and its last step has been played.
+       */
+      static bool isFinished();
+
+      /**
+       * Marks the start of a logic step.
+       */
+      static void beginStep();
+
+      /**
+       * Marks the end of a logic step. Playback is finished once the last recorded step has ended.
+       */
+      static void endStep();
+
+      /**
+       * Takes the next input event for the game, as SDL_PollEvent does.
+       *
+       * @param event The parameter used to return the event.
+       *
+       * @return true iff there was an event.
+       */
+      static bool pollEvent(SDL_Event* event);
+
+      /**
+       * @return The state of each key, indexed by SDLKey, as SDL_GetKeyState returns them.
+       */
+      static Uint8* getKeyState();
+};
+
+#endif
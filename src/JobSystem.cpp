@@ -0,0 +1,547 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "JobSystem.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include <algorithm>
+
+#ifdef _WIN32
+   #include <windows.h>
+#else
+   #include <unistd.h>
+#endif
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EXEC_STACK;
+
+// The engine's background work (loading, rerouting searches and NPC idle functions) doesn't keep more workers than this busy
+const int JobSystem::MAX_WORKER_COUNT = 8;
+
+// Resource loads spend most of their time waiting on the disk, so even a single core gets a couple of workers,
+// so that one slow read doesn't hold up every other job
+const int JobSystem::MIN_WORKER_COUNT = 2;
+
+std::vector<JobSystem::Worker*> JobSystem::workers;
+int JobSystem::workerCount = 0;
+SDL_mutex* JobSystem::lock = NULL;
+SDL_cond* JobSystem::jobQueued = NULL;
+SDL_cond* JobSystem::jobDone = NULL;
+int JobSystem::queuedCount = 0;
+unsigned long JobSystem::doneCount = 0;
+bool JobSystem::stopping = false;
+std::list<JobSystem::Job*> JobSystem::finalizeQueue;
+
+JobSystem::Job::Job(bool finalizedOnMainThread) : finalizedOnMainThread(finalizedOnMainThread), counter(NULL), dependency(NULL), ran(false)
+{
+}
+
+void JobSystem::Job::finalize()
+{
+}
+
+JobSystem::Job::~Job()
+{
+}
+
+JobSystem::Counter::Counter() : count(0)
+{
+}
+
+bool JobSystem::Counter::isDone() const
+{
+   if(lock == NULL) return count == 0;
+
+   SDL_mutexP(lock);
+   const bool done = count == 0;
+   SDL_mutexV(lock);
+   return done;
+}
+
+int JobSystem::countCores()
+{
+#ifdef _WIN32
+   SYSTEM_INFO systemInfo;
+   GetSystemInfo(&systemInfo);
+   return static_cast<int>(systemInfo.dwNumberOfProcessors);
+#else
+   const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+   return cores > 0 ? static_cast<int>(cores) : 1;
+#endif
+}
+
+void JobSystem::initialize()
+{
+   if(lock != NULL) return;
+
+   lock = SDL_CreateMutex();
+   jobQueued = SDL_CreateCond();
+   jobDone = SDL_CreateCond();
+   queuedCount = 0;
+   stopping = false;
+
+   // Until the workers are started, the main thread's deque is the only one
+   Worker* mainWorker = new Worker();
+   mainWorker->thread = NULL;
+   mainWorker->threadId = SDL_ThreadID();
+   mainWorker->slot = 0;
+   mainWorker->dequeLock = SDL_CreateMutex();
+   workers.push_back(mainWorker);
+}
+
+int JobSystem::runWorker(void* data)
+{
+   Worker* worker = static_cast<Worker*>(data);
+   workerLoop(*worker);
+   return 0;
+}
+
+void JobSystem::workerLoop(Worker& worker)
+{
+   // The worker sets its own ID, so that it is known before the worker runs (and submits) any jobs
+   worker.threadId = SDL_ThreadID();
+
+   for(;;)
+   {
+      Job* job = takeJob(worker);
+      if(job != NULL)
+      {
+         runJob(job, worker.slot);
+         continue;
+      }
+
+      SDL_mutexP(lock);
+      while(!stopping && queuedCount == 0)
+      {
+         SDL_CondWait(jobQueued, lock);
+      }
+
+      const bool stopped = stopping;
+      SDL_mutexV(lock);
+
+      if(stopped)
+      {
+         break;
+      }
+   }
+}
+
+JobSystem::Worker& JobSystem::getCallingWorker()
+{
+   // Any thread that isn't a worker (not just the main thread) queues its jobs in the main thread's deque
+   const unsigned long threadId = SDL_ThreadID();
+   for(int i = 0; i < static_cast<int>(workers.size()) - 1; ++i)
+   {
+      if(workers[i]->thread != NULL && workers[i]->threadId == threadId)
+      {
+         return *workers[i];
+      }
+   }
+
+   return *workers.back();
+}
+
+void JobSystem::queue(Worker& worker, Job* job)
+{
+   SDL_mutexP(worker.dequeLock);
+   worker.deque.push_back(job);
+   SDL_mutexV(worker.dequeLock);
+
+   SDL_mutexP(lock);
+   ++queuedCount;
+   ++doneCount;
+   SDL_CondSignal(jobQueued);
+
+   // The main thread may be waiting to run the queued job itself
+   SDL_CondBroadcast(jobDone);
+   SDL_mutexV(lock);
+}
+
+JobSystem::Job* JobSystem::takeJob(Worker& worker)
+{
+   Job* job = NULL;
+
+   // The newest job in a worker's own deque is the one most likely to share what the worker just touched
+   SDL_mutexP(worker.dequeLock);
+   if(!worker.deque.empty())
+   {
+      job = worker.deque.back();
+      worker.deque.pop_back();
+   }
+   SDL_mutexV(worker.dequeLock);
+
+   // Stealing starts from the next deque along, so that the workers don't all pile onto the same one,
+   // and takes the oldest job, which the deque's owner is the least likely to get to soon
+   for(unsigned int i = 1; job == NULL && i < workers.size(); ++i)
+   {
+      Worker& victim = *workers[(worker.slot + i) % workers.size()];
+      SDL_mutexP(victim.dequeLock);
+      if(!victim.deque.empty())
+      {
+         job = victim.deque.front();
+         victim.deque.pop_front();
+      }
+      SDL_mutexV(victim.dequeLock);
+   }
+
+   if(job != NULL)
+   {
+      SDL_mutexP(lock);
+      --queuedCount;
+      SDL_mutexV(lock);
+   }
+
+   return job;
+}
+
+bool JobSystem::takeQueuedJob(Job* job)
+{
+   bool found = false;
+   for(unsigned int i = 0; !found && i < workers.size(); ++i)
+   {
+      Worker& worker = *workers[i];
+      SDL_mutexP(worker.dequeLock);
+      std::deque<Job*>::iterator queuedJob = std::find(worker.deque.begin(), worker.deque.end(), job);
+      if(queuedJob != worker.deque.end())
+      {
+         worker.deque.erase(queuedJob);
+         found = true;
+      }
+      SDL_mutexV(worker.dequeLock);
+   }
+
+   if(found)
+   {
+      SDL_mutexP(lock);
+      --queuedCount;
+      SDL_mutexV(lock);
+   }
+
+   return found;
+}
+
+JobSystem::Job* JobSystem::takeCountedJob(const Counter& counter)
+{
+   Job* job = NULL;
+   for(unsigned int i = 0; job == NULL && i < workers.size(); ++i)
+   {
+      Worker& worker = *workers[i];
+      SDL_mutexP(worker.dequeLock);
+      for(std::deque<Job*>::iterator iter = worker.deque.begin(); iter != worker.deque.end(); ++iter)
+      {
+         if((*iter)->counter == &counter)
+         {
+            job = *iter;
+            worker.deque.erase(iter);
+            break;
+         }
+      }
+      SDL_mutexV(worker.dequeLock);
+   }
+
+   if(job != NULL)
+   {
+      SDL_mutexP(lock);
+      --queuedCount;
+      SDL_mutexV(lock);
+   }
+
+   return job;
+}
+
+void JobSystem::runJob(Job* job, int slot)
+{
+   job->run(slot);
+
+   if(job->finalizedOnMainThread)
+   {
+      SDL_mutexP(lock);
+      job->ran = true;
+      finalizeQueue.push_back(job);
+      ++doneCount;
+      SDL_CondBroadcast(jobDone);
+      SDL_mutexV(lock);
+   }
+   else
+   {
+      finishJob(job);
+   }
+}
+
+void JobSystem::finishJob(Job* job)
+{
+   // The job goes before its counter can be seen to be done, since the counter's owner may go right after that
+   Counter* counter = job->counter;
+   delete job;
+
+   std::vector<Job*> releasedJobs;
+
+   SDL_mutexP(lock);
+   if(counter != NULL && --counter->count == 0)
+   {
+      releasedJobs.swap(counter->dependents);
+      for(std::vector<Job*>::iterator iter = releasedJobs.begin(); iter != releasedJobs.end(); ++iter)
+      {
+         (*iter)->dependency = NULL;
+      }
+   }
+
+   ++doneCount;
+   SDL_CondBroadcast(jobDone);
+   SDL_mutexV(lock);
+
+   if(!releasedJobs.empty())
+   {
+      Worker& worker = getCallingWorker();
+      for(std::vector<Job*>::iterator iter = releasedJobs.begin(); iter != releasedJobs.end(); ++iter)
+      {
+         queue(worker, *iter);
+      }
+   }
+}
+
+void JobSystem::finalizeJob(Job* job)
+{
+   job->finalize();
+   finishJob(job);
+}
+
+void JobSystem::start()
+{
+   initialize();
+   if(workerCount > 0) return;
+
+   // The main thread has a core of its own, so the workers get the rest
+   const int count = std::max(MIN_WORKER_COUNT, std::min(MAX_WORKER_COUNT, countCores() - 1));
+
+   // Nothing else is looking at the deques yet, so the workers can go in ahead of the main thread's deque
+   Worker* mainWorker = workers.back();
+   workers.pop_back();
+   for(int i = 0; i < count; ++i)
+   {
+      Worker* worker = new Worker();
+      worker->thread = NULL;
+      worker->threadId = 0;
+      worker->slot = i;
+      worker->dequeLock = SDL_CreateMutex();
+      workers.push_back(worker);
+   }
+
+   mainWorker->slot = count;
+   workers.push_back(mainWorker);
+
+   // A worker that fails to start keeps its (empty) deque, so that the slots stay as they are
+   for(int i = 0; i < count; ++i)
+   {
+      workers[i]->thread = SDL_CreateThread(runWorker, workers[i]);
+      if(workers[i]->thread == NULL)
+      {
+         DEBUG("Failed to start job worker thread: %s", SDL_GetError());
+         break;
+      }
+
+      ++workerCount;
+   }
+
+   DEBUG("Started %d job worker threads", workerCount);
+}
+
+void JobSystem::stop()
+{
+   if(lock == NULL) return;
+
+   SDL_mutexP(lock);
+   stopping = true;
+   SDL_CondBroadcast(jobQueued);
+   SDL_mutexV(lock);
+
+   for(std::vector<Worker*>::iterator iter = workers.begin(); iter != workers.end(); ++iter)
+   {
+      if((*iter)->thread != NULL)
+      {
+         SDL_WaitThread((*iter)->thread, NULL);
+         (*iter)->thread = NULL;
+      }
+   }
+
+   workerCount = 0;
+
+   // Only the calling thread is left, so it finishes everything that is left, including the jobs that those jobs release
+   Worker& mainWorker = *workers.back();
+   for(;;)
+   {
+      Job* job = takeJob(mainWorker);
+      if(job != NULL)
+      {
+         runJob(job, mainWorker.slot);
+         continue;
+      }
+
+      if(finalizeQueue.empty())
+      {
+         break;
+      }
+
+      job = finalizeQueue.front();
+      finalizeQueue.pop_front();
+      finalizeJob(job);
+   }
+
+   for(std::vector<Worker*>::iterator iter = workers.begin(); iter != workers.end(); ++iter)
+   {
+      SDL_DestroyMutex((*iter)->dequeLock);
+      delete *iter;
+   }
+
+   workers.clear();
+
+   SDL_DestroyCond(jobDone);
+   SDL_DestroyCond(jobQueued);
+   SDL_DestroyMutex(lock);
+   jobDone = NULL;
+   jobQueued = NULL;
+   lock = NULL;
+   stopping = false;
+}
+
+int JobSystem::getWorkerCount()
+{
+   return workerCount;
+}
+
+int JobSystem::getSlotCount()
+{
+   return static_cast<int>(workers.size());
+}
+
+void JobSystem::submit(Job* job, Counter* counter, Counter* dependency)
+{
+   initialize();
+
+   job->counter = counter;
+
+   SDL_mutexP(lock);
+   if(counter != NULL)
+   {
+      ++counter->count;
+   }
+
+   if(dependency != NULL && dependency->count > 0)
+   {
+      // The job is queued by whichever job finishes the dependency off
+      job->dependency = dependency;
+      dependency->dependents.push_back(job);
+      SDL_mutexV(lock);
+      return;
+   }
+   SDL_mutexV(lock);
+
+   queue(getCallingWorker(), job);
+}
+
+void JobSystem::finalizeJobs()
+{
+   if(lock == NULL) return;
+
+   Worker& mainWorker = getCallingWorker();
+   if(workerCount == 0)
+   {
+      Job* job;
+      while((job = takeJob(mainWorker)) != NULL)
+      {
+         runJob(job, mainWorker.slot);
+      }
+   }
+
+   // Jobs are taken off the queue one at a time, since finalizing a job can wait on (and finalize) another one.
+   // Only the jobs that had already run are finalized, so that jobs finishing in the meantime can't keep the main thread here.
+   SDL_mutexP(lock);
+   std::list<Job*>::size_type remaining = finalizeQueue.size();
+   while(remaining > 0 && !finalizeQueue.empty())
+   {
+      Job* job = finalizeQueue.front();
+      finalizeQueue.pop_front();
+      --remaining;
+      SDL_mutexV(lock);
+
+      finalizeJob(job);
+
+      SDL_mutexP(lock);
+   }
+   SDL_mutexV(lock);
+}
+
+void JobSystem::wait(Counter& counter)
+{
+   if(lock == NULL) return;
+
+   const int slot = getCallingWorker().slot;
+
+   SDL_mutexP(lock);
+   while(counter.count > 0)
+   {
+      const unsigned long seenDoneCount = doneCount;
+
+      // Without any workers, the counted jobs may be waiting on jobs that only the calling thread can run
+      Job* ranJob = NULL;
+      for(std::list<Job*>::iterator iter = finalizeQueue.begin(); iter != finalizeQueue.end(); ++iter)
+      {
+         if((*iter)->counter == &counter || workerCount == 0)
+         {
+            ranJob = *iter;
+            finalizeQueue.erase(iter);
+            break;
+         }
+      }
+      SDL_mutexV(lock);
+
+      if(ranJob != NULL)
+      {
+         finalizeJob(ranJob);
+      }
+      else
+      {
+         Job* queuedJob = workerCount == 0 ? takeJob(getCallingWorker()) : takeCountedJob(counter);
+         if(queuedJob != NULL)
+         {
+            runJob(queuedJob, slot);
+         }
+         else
+         {
+            // Every counted job is running on a worker (or waiting on one that is), so there is nothing to do until one is done
+            SDL_mutexP(lock);
+            while(counter.count > 0 && doneCount == seenDoneCount)
+            {
+               SDL_CondWait(jobDone, lock);
+            }
+            SDL_mutexV(lock);
+         }
+      }
+
+      SDL_mutexP(lock);
+   }
+   SDL_mutexV(lock);
+}
+
+void JobSystem::wait(Job* job)
+{
+   if(takeQueuedJob(job))
+   {
+      // No worker has started on the job, so it is quicker to run it here than to wait
+      runJob(job, getCallingWorker().slot);
+   }
+
+   SDL_mutexP(lock);
+   while(!job->ran)
+   {
+      SDL_CondWait(jobDone, lock);
+   }
+
+   finalizeQueue.remove(job);
+   SDL_mutexV(lock);
+
+   finalizeJob(job);
+}
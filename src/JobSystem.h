@@ -0,0 +1,324 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <vector>
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+/**
+ * A pool of worker threads (one for each core but the main thread's) that the rest of the engine hands its
+ * background work to as jobs, instead of each system starting threads of its own.
+ *
+ * Each worker keeps its own deque of jobs: it takes the jobs it queued itself from the back of its deque,
+ * and once its deque is empty it steals from the front of the others' deques. The main thread has a deque of its own,
+ * which the workers steal from, so jobs queued from the main thread go to whichever worker is free first.
+ *
+ * Jobs can be counted with a Counter, so that their owner can wait for all of them to finish,
+ * and a job can depend on a counter, so that it isn't queued until every job counted by the counter is done.
+ *
+ * Part of a job can be left to finalize on the main thread (such as uploading what it loaded to OpenGL),
+ * once the job has run. Jobs that finalize on the main thread are finalized once per frame (see finalizeJobs),
+ * so a job can signal a script's task from its finalize function, and the script can block on the job like any other task.
+ *
+ * Each thread that runs jobs has a slot (the workers have the first slots, and the main thread has the last one, getSlotCount() - 1),
+ * which jobs can use to keep scratch space for each thread without locking it.
+ */
+class JobSystem
+{
+   public:
+      class Counter;
+
+      /**
+       * A piece of work to be run on a worker thread. The job system deletes each job once it is done with it.
+       */
+      class Job
+      {
+         friend class JobSystem;
+
+         /** Whether or not the job is finalized on the main thread once it has run. */
+         const bool finalizedOnMainThread;
+
+         /** The counter that counts the job, or NULL if it isn't counted. */
+         Counter* counter;
+
+         /** The counter that the job is waiting on before it can be queued, or NULL if it isn't waiting on one. */
+         Counter* dependency;
+
+         /** Whether or not the job has run (only touched with the job system's lock held). */
+         bool ran;
+
+         public:
+            /**
+             * Constructor.
+             *
+             * @param finalizedOnMainThread true iff the job has work to finalize on the main thread once it has run.
+             */
+            Job(bool finalizedOnMainThread);
+
+            /**
+             * Does the job's work, on whichever thread it is run on.
+             *
+             * @param slot The slot of the thread running the job.
+             */
+            virtual void run(int slot) = 0;
+
+            /**
+             * Finishes the job on the main thread, after it has run.
+             * This is only called for jobs that are finalized on the main thread.
+             */
+            virtual void finalize();
+
+            /**
+             * Destructor.
+             */
+            virtual ~Job();
+      };
+
+      /**
+       * Counts the jobs that have been submitted with it and aren't done yet.
+       * A counter must outlive the jobs it counts, so its owner waits on it before deleting it.
+       */
+      class Counter
+      {
+         friend class JobSystem;
+
+         /** The number of jobs counted that aren't done (only touched with the job system's lock held). */
+         int count;
+
+         /** The jobs waiting for the count to reach zero before they can be queued. */
+         std::vector<Job*> dependents;
+
+         /** Counters can't be copied. */
+         Counter(const Counter&);
+
+         /** Counters can't be copied. */
+         Counter& operator=(const Counter&);
+
+         public:
+            /**
+             * Constructor.
+             */
+            Counter();
+
+            /**
+             * @return true iff every job counted by the counter is done.
+             */
+            bool isDone() const;
+      };
+
+   private:
+      /** A thread that runs jobs, and the deque of jobs that it queued. */
+      struct Worker
+      {
+         /** The worker's thread, or NULL for the main thread. */
+         SDL_Thread* thread;
+
+         /** The ID of the thread. */
+         unsigned long threadId;
+
+         /** The worker's slot. */
+         int slot;
+
+         /** Guards the deque. */
+         SDL_mutex* dequeLock;
+
+         /** The jobs queued by the thread, taken by it from the back and stolen by other threads from the front. */
+         std::deque<Job*> deque;
+      };
+
+      /** The most workers that are started, no matter how many cores there are. */
+      static const int MAX_WORKER_COUNT;
+
+      /** The fewest workers that are started, no matter how few cores there are. */
+      static const int MIN_WORKER_COUNT;
+
+      /** The workers, followed by the stand-in worker that holds the main thread's deque. */
+      static std::vector<Worker*> workers;
+
+      /** The number of worker threads running. */
+      static int workerCount;
+
+      /** Guards the counters, the finalize queue, the queued job count, whether or not jobs have run, and the stopping flag. */
+      static SDL_mutex* lock;
+
+      /** Signalled when jobs are queued, or when the workers must stop. */
+      static SDL_cond* jobQueued;
+
+      /** Signalled when jobs have run, or when counters are done. */
+      static SDL_cond* jobDone;
+
+      /** The number of jobs in the deques. */
+      static int queuedCount;
+
+      /** The number of times that a job has been queued, has run or is done, so that a waiting thread can tell if anything has happened since it last looked. */
+      static unsigned long doneCount;
+
+      /** Whether or not the workers have been asked to stop. */
+      static bool stopping;
+
+      /** The jobs that have run, waiting to be finalized on the main thread, in the order they ran. */
+      static std::list<Job*> finalizeQueue;
+
+      /** Counters are checked with the job system's lock held. */
+      friend class Counter;
+
+      /**
+       * @return The number of processor cores in the machine.
+       */
+      static int countCores();
+
+      /**
+       * Creates the lock, the signals and the main thread's deque, if they haven't been created yet.
+       */
+      static void initialize();
+
+      /**
+       * The entry point for worker threads.
+       *
+       * @param data The worker that the thread belongs to.
+       *
+       * @return The exit code of the thread.
+       */
+      static int runWorker(void* data);
+
+      /**
+       * Runs jobs, from its own deque or stolen from the others, until the job system is stopped.
+       *
+       * @param worker The worker running the jobs.
+       */
+      static void workerLoop(Worker& worker);
+
+      /**
+       * @return The worker (or the main thread's stand-in worker) of the calling thread.
+       */
+      static Worker& getCallingWorker();
+
+      /**
+       * Adds a job to the back of a worker's deque, and wakes up a worker to take it.
+       *
+       * @param worker The worker whose deque the job goes in.
+       * @param job The job to queue.
+       */
+      static void queue(Worker& worker, Job* job);
+
+      /**
+       * Takes a job off the back of a worker's own deque, or steals one off the front of another deque if its own is empty.
+       *
+       * @param worker The worker looking for a job.
+       *
+       * @return The job, or NULL if every deque is empty.
+       */
+      static Job* takeJob(Worker& worker);
+
+      /**
+       * Takes a particular job out of whichever deque it is in.
+       *
+       * @param job The job to take.
+       *
+       * @return true iff the job was in a deque.
+       */
+      static bool takeQueuedJob(Job* job);
+
+      /**
+       * Takes a job counted by a counter out of whichever deque it is in.
+       *
+       * @param counter The counter.
+       *
+       * @return The job, or NULL if none of the counter's jobs are in a deque.
+       */
+      static Job* takeCountedJob(const Counter& counter);
+
+      /**
+       * Runs a job, then hands it to the main thread to finalize, or finishes it if it has nothing to finalize.
+       *
+       * @param job The job, which has been taken out of its deque.
+       * @param slot The slot of the thread running the job.
+       */
+      static void runJob(Job* job, int slot);
+
+      /**
+       * Counts a job as done, queues the jobs that were waiting on its counter if its counter is done, and deletes it.
+       * Must be called with the lock held.
+       *
+       * @param job The job.
+       */
+      static void finishJob(Job* job);
+
+      /**
+       * Finalizes a job that has run and been taken out of the finalize queue, and finishes it.
+       *
+       * @param job The job.
+       */
+      static void finalizeJob(Job* job);
+
+   public:
+      /**
+       * Starts the worker threads. Jobs submitted before the job system is started (or if it can't start any workers)
+       * are run on the main thread when finalizeJobs is called.
+       * This must be called on the main thread, which is the thread that finalizes jobs from then on.
+       */
+      static void start();
+
+      /**
+       * Stops the worker threads, waiting for them to finish their current jobs.
+       * The jobs still queued are run on the calling thread, and every job is finalized, so that no submitted job is lost.
+       */
+      static void stop();
+
+      /**
+       * @return The number of worker threads running, which is 0 if the job system isn't running.
+       */
+      static int getWorkerCount();
+
+      /**
+       * @return The number of slots that the threads running jobs can have (one more than the number of workers, for the main thread).
+       */
+      static int getSlotCount();
+
+      /**
+       * Hands a job to the workers. The job system takes ownership of the job.
+       * Jobs submitted by a worker go in its own deque, so that it takes them before the jobs it would steal.
+       *
+       * @param job The job to submit.
+       * @param counter The counter to count the job with until it is done, or NULL to not count it.
+       * @param dependency A counter that must be done before the job can be queued, or NULL to queue it right away.
+       */
+      static void submit(Job* job, Counter* counter = NULL, Counter* dependency = NULL);
+
+      /**
+       * Finalizes the jobs that have run since the last call, on the main thread, in the order they ran.
+       * If there are no worker threads, the queued jobs are run first.
+       * This should happen once per frame, before anything is drawn.
+       */
+      static void finalizeJobs();
+
+      /**
+       * Waits on the main thread until every job counted by a counter is done.
+       * The counted jobs that haven't been started yet are run on the main thread instead of waited for,
+       * and the counted jobs that have run are finalized right away; no other jobs are run or finalized.
+       *
+       * @param counter The counter to wait on.
+       */
+      static void wait(Counter& counter);
+
+      /**
+       * Waits on the main thread until a job that is finalized on the main thread has run, then finalizes it.
+       * If the job hasn't been started yet, it is run on the main thread instead of waited for.
+       *
+       * @param job The job to wait for, which mustn't depend on a counter. The job is deleted before this returns.
+       */
+      static void wait(Job* job);
+};
+
+#endif
@@ -53,6 +53,7 @@ extern "C"
 #define LUAW_STORAGE_KEY "__storage"
 #define LUAW_COUNT_KEY "__counts"
 #define LUAW_HOLDS_KEY "__holds"
+#define LUAW_CACHE_KEY "__cache"
 #define LUAW_WRAPPER_KEY "LuaWrapper"
 
 // These are the default allocator and deallocator. If you would prefer an
@@ -208,14 +209,38 @@ T* luaW_check(lua_State* L, int index, bool strict = false)
 // Pushes a userdata of type T onto the stack. If this object already exists in
 // the Lua environment, it will assign the existing store to it. Otherwise, a
 // new storage table will be created for it.
+//
+// If a userdata of type T for this object is still alive, that same userdata
+// is pushed again instead of a new one being allocated. Each type's metatable
+// keeps a weak-valued cache of its userdata (LUAW_CACHE_KEY or "__cache"),
+// keyed by identifier, so the cache never keeps a userdata from being
+// collected.
 template <typename T>
 void luaW_push(lua_State* L, T* obj)
 {
-    luaW_Userdata* ud = (luaW_Userdata*)lua_newuserdata(L, sizeof(luaW_Userdata)); // ... obj
+    luaL_getmetatable(L, LuaWrapper<T>::classname); // ... mt
+    lua_getfield(L, -1, LUAW_CACHE_KEY); // ... mt mt.cache
+    LuaWrapper<T>::identifier(L, obj); // ... mt mt.cache id
+    lua_rawget(L, -2); // ... mt mt.cache obj
+    if (!lua_isnil(L, -1))
+    {
+        lua_replace(L, -3); // ... obj mt.cache
+        lua_pop(L, 1); // ... obj
+        return;
+    }
+    lua_pop(L, 1); // ... mt mt.cache
+
+    luaW_Userdata* ud = (luaW_Userdata*)lua_newuserdata(L, sizeof(luaW_Userdata)); // ... mt mt.cache obj
     ud->data = obj;
     ud->cast = LuaWrapper<T>::cast;
-    luaL_getmetatable(L, LuaWrapper<T>::classname); // ... obj mt
-    lua_setmetatable(L, -2); // ... obj
+    lua_pushvalue(L, -3); // ... mt mt.cache obj mt
+    lua_setmetatable(L, -2); // ... mt mt.cache obj
+    LuaWrapper<T>::identifier(L, obj); // ... mt mt.cache obj id
+    lua_pushvalue(L, -2); // ... mt mt.cache obj id obj
+    lua_rawset(L, -4); // ... mt mt.cache obj
+    lua_replace(L, -3); // ... obj mt.cache
+    lua_pop(L, 1); // ... obj
+
     luaW_getregistry(L, LUAW_WRAPPER_KEY); // ... obj LuaWrapper
     lua_getfield(L, -1, LUAW_COUNT_KEY); // ... obj LuaWrapper LuaWrapper.counts
     LuaWrapper<T>::identifier(L, obj); // ... obj LuaWrapper LuaWrapper.counts id
@@ -585,6 +610,15 @@ void luaW_register(lua_State* L, const char* classname, const luaL_reg* table, c
     luaL_newmetatable(L, LuaWrapper<T>::classname); // T mt
     lua_newtable(L); // T mt {}
     lua_setfield(L, -2, LUAW_EXTENDS_KEY); // T mt
+
+    // Set up the userdata cache, with weak values so that it doesn't keep
+    // userdata from being collected
+    lua_newtable(L); // T mt {}
+    lua_newtable(L); // T mt {} cachemt
+    lua_pushstring(L, "v"); // T mt {} cachemt "v"
+    lua_setfield(L, -2, "__mode"); // T mt {} cachemt
+    lua_setmetatable(L, -2); // T mt {}
+    lua_setfield(L, -2, LUAW_CACHE_KEY); // T mt
     luaL_register(L, NULL, defaultmetatable); // T mt
     luaL_register(L, NULL, metatable); // T mt
     lua_setfield(L, -2, "metatable"); // T
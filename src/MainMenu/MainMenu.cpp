@@ -6,6 +6,7 @@
 
 #include "MainMenu.h"
 #include "GraphicsUtil.h"
+#include "ScreenTransition.h"
 
 #include "TileEngine.h"
 
@@ -15,11 +16,15 @@
 
 #include "Container.h"
 #include "Label.h"
+#include "Icon.h"
 #include "OpenGLTTF.h"
 #include "StringListModel.h"
 #include "ListBox.h"
+#include "MenuShell.h"
 
 #include "ExecutionStack.h"
+#include "InputQueue.h"
+#include "StartupTimeline.h"
 #include "SDL_image.h"
 #include "DebugUtils.h"
 
@@ -35,21 +40,53 @@ enum MainMenuActions
 	MENU_PROTOTYPE_ACTION,
 };
 
-MainMenu::MainMenu(ExecutionStack& executionStack) : GameState(executionStack)
+// The font that the title and the menu options are drawn in
+static const char* TITLE_FONT_PATH = "data/fonts/FairyDustB.ttf";
+
+MainMenu::MainMenu(ExecutionStack& executionStack) : GameState(executionStack), music(NULL), reselectSound(NULL), chooseSound(NULL),
+   titleLabel(NULL), actionsListBox(NULL), bg(NULL), titleOps(NULL), titleFont(NULL), actionsFont(NULL),
+   menuLoaded(false), menuShown(false), newGamePending(false), newGamePrefetched(false), menuPlayerData(NULL), menuShell(NULL)
 {
    try
    {
-      bg = new gcn::Icon("data/images/splash.jpg");
-      bg->setDimension(top->getDimension());
+      // The font file is read in the background while the splash is decoded
+      ResourceLoader::request(TITLE_FONT_PATH, ResourceLoader::FONT);
+
+      const int splashPhase = StartupTimeline::begin("splash");
+      // The splash is painted much larger than the screen, so it is loaded from the smallest of its variants that fills the screen
+      bg = new edwt::Icon();
+      bg->setImage("data/images/splash.jpg", top->getWidth(), top->getHeight());
       top->add(bg,0,0);
+      StartupTimeline::end(splashPhase);
+   }
+   catch (gcn::Exception e)
+   {
+      DEBUG(e.getMessage());
+      DEBUG(IMG_GetError());
+   }
+}
+
+void MainMenu::loadMenu()
+{
+   const int menuPhase = StartupTimeline::begin("title menu");
+   menuLoaded = true;
+
+   try
+   {
+      // The sounds and music load in the background while the fonts are set up
+      ResourceLoader::request("choose", ResourceLoader::SOUND);
+      ResourceLoader::request("reselect", ResourceLoader::SOUND);
+      #ifndef MUSIC_OFF
+      ResourceLoader::request("title.mp3", ResourceLoader::MUSIC);
+      #endif
 
       populateOpsList();
 
       titleLabel = new edwt::Label("Exodus Draconis Engine");
       actionsListBox = new edwt::ListBox(titleOps);
 
-      titleFont = new edwt::OpenGLTrueTypeFont("data/fonts/FairyDustB.ttf", 64);
-      actionsFont = new edwt::OpenGLTrueTypeFont("data/fonts/FairyDustB.ttf", 32);
+      titleFont = new edwt::OpenGLTrueTypeFont(TITLE_FONT_PATH, 64);
+      actionsFont = new edwt::OpenGLTrueTypeFont(TITLE_FONT_PATH, 32);
 
       titleLabel->setForegroundColor(0x666655);
       titleLabel->setFont(titleFont);
@@ -68,20 +105,28 @@ MainMenu::MainMenu(ExecutionStack& executionStack) : GameState(executionStack)
       actionsListBox->setOpaque(false);
 
       chooseSound = ResourceLoader::getSound("choose");
+      chooseSound->acquire();
       reselectSound = ResourceLoader::getSound("reselect");
+      reselectSound->acquire();
 
       top->add(titleLabel, 400 - titleLabel->getWidth() / 2, 50);
       top->add(actionsListBox, 400 - actionsListBox->getWidth() / 2, 600 - (actionsListBox->getHeight() + 50));
 
       #ifndef MUSIC_OFF
       music = ResourceLoader::getMusic("title.mp3");
+      music->acquire();
       #endif
+
+      // The menu is loaded while it is on top of the stack, so it was activated before its list box was there to focus
+      actionsListBox->requestFocus();
    }
    catch (gcn::Exception e)
    {
       DEBUG(e.getMessage());
       DEBUG(IMG_GetError());
    }
+
+   StartupTimeline::end(menuPhase);
 }
 
 void MainMenu::activate()
@@ -90,7 +135,10 @@ void MainMenu::activate()
 
    try
    {
-      actionsListBox->requestFocus();
+      if(actionsListBox != NULL)
+      {
+         actionsListBox->requestFocus();
+      }
    }
    catch (gcn::Exception e)
    {
@@ -111,16 +159,38 @@ void MainMenu::populateOpsList()
    titleOps->add("Quit", QUIT_GAME_ACTION);
 }
 
-bool MainMenu::step()
+bool MainMenu::step(long timePassed)
 {
+   if(GraphicsUtil::getInstance()->getTransition()->isActive())
+   {
+      // Keep stepping (without waiting for input) until the fade is done
+      return true;
+   }
+
    if(finished) return false;
 
+   if(!menuShown)
+   {
+      // The splash (and then the menu, once it has loaded) is drawn before the menu starts waiting for input
+      menuShown = menuLoaded;
+      return true;
+   }
+
+   if(newGamePending)
+   {
+      newGamePending = false;
+      startNewGame();
+      return true;
+   }
+
    bool done = false;
 
 #ifndef MUSIC_OFF
    music->play();
 #endif
 
+   // Nothing is drawn while the menu waits for input, so the last frame drawn is shown before it waits
+   GraphicsUtil::getInstance()->presentFrame();
    waitForInputEvent(done);
 
    return !done;
@@ -174,55 +244,50 @@ void MainMenu::action(const gcn::ActionEvent& event)
 
 void MainMenu::waitForInputEvent(bool& finishState)
 {
-   SDL_Event event;
-
-   /* Check for events */
-   SDL_WaitEvent(&event);
+   InputQueue::Input input;
+   InputQueue::wait(input);
 
-   switch (event.type)
+   if((input.action == InputQueue::CANCEL && input.pressed) || input.event.type == SDL_QUIT)
    {
-      case SDL_KEYDOWN:
-      {
-         switch(event.key.keysym.sym)
-         {
-            case SDLK_ESCAPE:
-            {
-               finishState = true;
-               return;
-            }
-            default:
-            {
-               break;
-            }
-         }
-
-         break;
-      }
-      case SDL_QUIT:
-      {
-          finishState = true;
-          return;
-      }
-      default:
-      {
-          break;
-      }
+      finishState = true;
+      return;
    }
 
    // If the main menu didn't consume this event, then propagate to the generic input handling
-   handleEvent(event);
+   handleEvent(input.event);
 }
 
 void MainMenu::draw()
 {
-   /* Don't run too fast */
-   SDL_Delay (1);
+}
+
+void MainMenu::idle(long timeAvailable)
+{
+   if(menuLoaded)
+   {
+      if(!newGamePrefetched)
+      {
+         prefetchNewGame();
+      }
+
+      return;
+   }
+
+   // The splash has been drawn, so it is shown while the rest of the title screen loads
+   GraphicsUtil::getInstance()->presentFrame();
+   loadMenu();
 }
 
 MainMenu::~MainMenu()
 {
    Music::fadeOutMusic(1000);
-   GraphicsUtil::getInstance()->FadeToColor(0.0f, 0.0f, 0.0f, 1000);
+
+   if(music != NULL) music->release();
+   if(reselectSound != NULL) reselectSound->release();
+   if(chooseSound != NULL) chooseSound->release();
+
+   delete menuShell;
+   delete menuPlayerData;
 
    delete bg;
    delete actionsListBox;
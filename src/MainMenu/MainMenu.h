@@ -15,11 +15,14 @@ namespace edwt
    class StringListModel;
    class ListBox;
    class Label;
+   class Icon;
    class OpenGLTrueTypeFont;
 };
 
 class Music;
 class Sound;
+class PlayerData;
+class MenuShell;
 
 /**
  * Provides the title screen functionality, including the game logo, backdrop, 
@@ -46,7 +49,7 @@ class MainMenu: public GameState, public gcn::ActionListener, public gcn::Select
    edwt::ListBox* actionsListBox;
 
    /** The container for the background image */
-   gcn::Icon* bg;
+   edwt::Icon* bg;
 
    /** The list model holding the options for the title screen */
    edwt::StringListModel* titleOps;
@@ -57,11 +60,34 @@ class MainMenu: public GameState, public gcn::ActionListener, public gcn::Select
    /** The font for the title screen menu options */
    edwt::OpenGLTrueTypeFont* actionsFont;
 
+   /** Whether or not the title, menu options, sounds and music have been loaded */
+   bool menuLoaded;
+
+   /** Whether or not the menu has been drawn since it was loaded, so that it can start waiting for input */
+   bool menuShown;
+
+   /** Whether or not a new game should start once the screen has faded out */
+   bool newGamePending;
+
+   /** Whether or not the resources that a new game starts with have been requested */
+   bool newGamePrefetched;
+
+   /** The player data shown by the menu prototype (or NULL until the prototype is first opened). */
+   PlayerData* menuPlayerData;
+
+   /** The in-game menu shown by the menu prototype, which is only built the first time it is opened (NULL until then). */
+   MenuShell* menuShell;
+
    /**
     * Populate the title screen list with required options
     */
    void populateOpsList();
 
+   /**
+    * Loads the title, menu options, sounds and music, once the splash has been shown.
+    */
+   void loadMenu();
+
    /**
     * Wait for and handle the input event.
     *
@@ -77,6 +103,16 @@ class MainMenu: public GameState, public gcn::ActionListener, public gcn::Select
    void AboutAction();
    void QuitAction();
 
+   /**
+    * Starts a new game (once the screen has faded out after 'New Game' was selected).
+    */
+   void startNewGame();
+
+   /**
+    * Requests the resources that a new game starts with, so that they load while the title screen waits for input.
+    */
+   void prefetchNewGame();
+
    protected:
       /**
        * Waits a millisecond between draws (no rush on a title screen)
@@ -87,15 +123,25 @@ class MainMenu: public GameState, public gcn::ActionListener, public gcn::Select
        * Perform logic for the title screen.
        * NOTE: this method will spin infinitely until user input is received.
        * Since the screen is static, there is no need to refresh without input.
+       * While the screen is fading, input is ignored so that the fade keeps playing.
        *
        * @return true iff the title screen is not finished running (no quit event)
        */
-      bool step();
+      bool step(long timePassed);
+
+      /**
+       * Shows the splash as soon as it has been drawn for the first time, then loads the rest of the title screen.
+       * Once the title screen is up, the resources that a new game starts with are requested in the background.
+       *
+       * @param timeAvailable The time (in milliseconds) left before the next frame is due.
+       */
+      void idle(long timeAvailable);
 
    public:
       /**
        * Constructor.
-       * Initializes the title screen widgets, font, image and sounds.
+       * Loads the splash, and starts reading the title screen's font in the background;
+       * the rest of the title screen is loaded once the splash is on screen.
        *
        * @param executionStack The execution stack that the state belongs to.
        */
@@ -7,6 +7,7 @@
 #include "MainMenu.h"
 #include "ExecutionStack.h"
 #include "GraphicsUtil.h"
+#include "ScreenTransition.h"
 #include "Music.h"
 #include "Sound.h"
 
@@ -14,23 +15,44 @@
 #include "MenuShell.h"
 #include "HomeMenu.h"
 #include "PlayerData.h"
+#include "ResourceLoader.h"
 
 #define CHAP1 "chapter1"
 #define SAVE_GAME "data/savegames/savegamejson.edd"
 //Actions for each of the list ops in the title screen
 
 /**
- * 'New Game' was selected. Push a TileEngine state and fade to black.
+ * 'New Game' was selected. Fade to black, then start the game.
  * [this will eventually change to a chapter selection list, with the fade
  * and pushed state (field or battle) changing based on the chapter].
  */
 void MainMenu::NewGameAction()
 {
-   TileEngine* tileEngine = new TileEngine(executionStack, CHAP1);
-   executionStack.pushState(tileEngine);
    chooseSound->play();
    Music::fadeOutMusic(1000);
-   GraphicsUtil::getInstance()->FadeToColor(0.0f, 0.0f, 0.0f, 1000);
+   GraphicsUtil::getInstance()->getTransition()->start(ScreenTransition::FADE, 0.0f, 0.0f, 0.0f, true, 1000);
+   newGamePending = true;
+}
+
+/**
+ * The screen has faded out after 'New Game' was selected. Push a TileEngine state and fade it in.
+ */
+void MainMenu::startNewGame()
+{
+   TileEngine* tileEngine = new TileEngine(executionStack, CHAP1);
+   executionStack.pushState(tileEngine);
+   GraphicsUtil::getInstance()->getTransition()->start(ScreenTransition::FADE, 0.0f, 0.0f, 0.0f, false, 1000);
+}
+
+/**
+ * The title screen is up and waiting for input. Request the resources that the new game's first map was entered with
+ * in earlier sessions (as traced into the prefetch manifest), so that they are loaded by the workers while the menu is idle,
+ * and only their textures are left to upload (on the main thread, once frames are drawn again) when 'New Game' is selected.
+ */
+void MainMenu::prefetchNewGame()
+{
+   newGamePrefetched = true;
+   ResourceLoader::prefetchChapter(CHAP1);
 }
 
 /**
@@ -39,13 +61,31 @@ void MainMenu::NewGameAction()
  */
 void MainMenu::MenuPrototypeAction()
 {
-   PlayerData* playerData = new PlayerData();
-   playerData->load(SAVE_GAME);
+   // The prototype's save game is only read once, and each run of the prototype starts from a copy of it
+   static PlayerData prototypeData;
+   if(prototypeData.getFilePath().empty())
+   {
+      prototypeData.load(SAVE_GAME);
+   }
+
+   if(menuPlayerData == NULL)
+   {
+      menuPlayerData = new PlayerData();
+   }
+
+   menuPlayerData->copyFrom(prototypeData);
 
-   /** \todo This is never deleted, causing a memory leak. */
-   MenuShell* menuShell = new MenuShell(*playerData);
+   // The menu's widgets are kept from one opening to the next, and only brought up to date with the player data
+   if(menuShell == NULL)
+   {
+      menuShell = new MenuShell(*menuPlayerData);
+   }
+   else
+   {
+      menuShell->refresh(*menuPlayerData);
+   }
 
-   HomeMenu* menu = new HomeMenu(executionStack, *menuShell, *playerData);
+   HomeMenu* menu = new HomeMenu(executionStack, *menuShell, *menuPlayerData);
    executionStack.pushState(menu);
 }
 
@@ -79,5 +119,5 @@ void MainMenu::QuitAction()
    finished = true;
    chooseSound->play();
    Music::fadeOutMusic(1000);
-   GraphicsUtil::getInstance()->FadeToColor(0.0f, 0.0f, 0.0f, 1000);
+   GraphicsUtil::getInstance()->getTransition()->start(ScreenTransition::FADE, 0.0f, 0.0f, 0.0f, true, 1000);
 }
@@ -0,0 +1,217 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "MemoryTracker.h"
+#include "Atomics.h"
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_MAIN;
+
+// Each allocation is prefixed with its size and tag, padded to keep the memory handed out suitably aligned
+static const size_t ALLOCATION_HEADER_SIZE = 16;
+
+// In the same order as the tags
+static const char* TAG_NAMES[] = { "untagged", "TileEngine", "Pathfinder", "sounds", "regions", "tilesets", "music", "sprites", "images", "fonts", "Lua", "guichan", "audio" };
+
+// The C++ standard dropped exception specifications, but older standards want them on a replaced operator new
+#if __cplusplus >= 201103L
+   #define THROWS_BAD_ALLOC
+#else
+   #define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#endif
+
+#ifdef _MSC_VER
+   #define THREAD_LOCAL __declspec(thread)
+#else
+   #define THREAD_LOCAL __thread
+#endif
+
+/** What is kept in front of each allocation. */
+struct AllocationHeader
+{
+   /** The number of bytes that were asked for. */
+   size_t size;
+
+   /** The subsystem that the allocation is counted towards. */
+   int tag;
+};
+
+/** The subsystem that allocations on this thread are counted towards. */
+static THREAD_LOCAL int currentTag = MemoryTracker::UNTAGGED;
+
+/** The memory (in bytes) held by each subsystem. */
+static volatile long liveBytes[MemoryTracker::TAG_COUNT];
+
+/** The number of allocations made through operator new, by every thread. */
+static volatile unsigned long allocationCount = 0;
+
+MemoryTracker::Scope::Scope(Tag tag) : previousTag(currentTag)
+{
+   currentTag = tag;
+}
+
+MemoryTracker::Scope::~Scope()
+{
+   currentTag = previousTag;
+}
+
+void* MemoryTracker::allocate(size_t size)
+{
+   char* block = static_cast<char*>(malloc(size + ALLOCATION_HEADER_SIZE));
+   if(block == NULL) return NULL;
+
+   AllocationHeader* header = reinterpret_cast<AllocationHeader*>(block);
+   header->size = size;
+   header->tag = currentTag;
+
+   Atomics::add(&liveBytes[header->tag], static_cast<long>(size));
+   Atomics::increment(&allocationCount);
+   return block + ALLOCATION_HEADER_SIZE;
+}
+
+void MemoryTracker::deallocate(void* memory)
+{
+   if(memory == NULL) return;
+
+   char* block = static_cast<char*>(memory) - ALLOCATION_HEADER_SIZE;
+   const AllocationHeader* header = reinterpret_cast<const AllocationHeader*>(block);
+   Atomics::add(&liveBytes[header->tag], -static_cast<long>(header->size));
+   free(block);
+}
+
+void MemoryTracker::addExternalBytes(Tag tag, long bytes)
+{
+   Atomics::add(&liveBytes[tag], bytes);
+}
+
+long MemoryTracker::getLiveBytes(Tag tag)
+{
+   return liveBytes[tag];
+}
+
+long MemoryTracker::getTotalLiveBytes()
+{
+   long total = 0;
+   for(int tag = 0; tag < TAG_COUNT; ++tag)
+   {
+      total += liveBytes[tag];
+   }
+
+   return total;
+}
+
+unsigned long MemoryTracker::getTotalAllocationCount()
+{
+   return allocationCount;
+}
+
+const char* MemoryTracker::getTagName(Tag tag)
+{
+   return TAG_NAMES[tag];
+}
+
+void MemoryTracker::describe(std::vector<std::string>& lines)
+{
+   // The resources get a line of their own, so that neither line runs off the edge of the console
+   std::stringstream subsystemsLine;
+   subsystemsLine << "Heap: " << getTotalLiveBytes() / 1024 << "KB;";
+   const Tag subsystems[] = { TILE_ENGINE, PATHFINDER, LUA, GUI, AUDIO, UNTAGGED };
+   for(unsigned int i = 0; i < sizeof(subsystems) / sizeof(subsystems[0]); ++i)
+   {
+      subsystemsLine << (i == 0 ? " " : ", ") << getTagName(subsystems[i]) << ' ' << getLiveBytes(subsystems[i]) / 1024 << "KB";
+   }
+
+   lines.push_back(subsystemsLine.str());
+
+   std::stringstream resourcesLine;
+   resourcesLine << "Heap (resources):";
+   for(int tag = SOUND_RESOURCES; tag <= FONT_RESOURCES; ++tag)
+   {
+      resourcesLine << (tag == SOUND_RESOURCES ? " " : ", ") << getTagName(static_cast<Tag>(tag)) << ' ' << liveBytes[tag] / 1024 << "KB";
+   }
+
+   lines.push_back(resourcesLine.str());
+}
+
+void MemoryTracker::reportLeaks(const char* when, Tag firstTag, Tag lastTag)
+{
+   bool leaked = false;
+   for(int tag = firstTag; tag <= lastTag; ++tag)
+   {
+      const long bytes = liveBytes[tag];
+      if(bytes != 0)
+      {
+         LOG_WARNING("%s: %s still holds %ld bytes.", when, getTagName(static_cast<Tag>(tag)), bytes);
+         leaked = true;
+      }
+   }
+
+   if(!leaked)
+   {
+      DEBUG("%s: no memory left over.", when);
+   }
+}
+
+// Every program built from the engine's sources counts its allocations through the tracker
+void* operator new(size_t size) THROWS_BAD_ALLOC
+{
+   void* memory = MemoryTracker::allocate(size > 0 ? size : 1);
+   if(memory == NULL)
+   {
+      throw std::bad_alloc();
+   }
+
+   return memory;
+}
+
+void* operator new[](size_t size) THROWS_BAD_ALLOC
+{
+   return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+   return MemoryTracker::allocate(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+   return MemoryTracker::allocate(size > 0 ? size : 1);
+}
+
+void operator delete(void* memory) throw()
+{
+   MemoryTracker::deallocate(memory);
+}
+
+void operator delete[](void* memory) throw()
+{
+   MemoryTracker::deallocate(memory);
+}
+
+// Compilers with sized deallocation call these instead of the unsized forms, which would let those deletes go around the tracker
+void operator delete(void* memory, size_t) throw()
+{
+   MemoryTracker::deallocate(memory);
+}
+
+void operator delete[](void* memory, size_t) throw()
+{
+   MemoryTracker::deallocate(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) throw()
+{
+   MemoryTracker::deallocate(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) throw()
+{
+   MemoryTracker::deallocate(memory);
+}
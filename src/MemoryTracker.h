@@ -0,0 +1,157 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Accounts for the heap memory that each of the engine's subsystems holds.
+ *
+ * Every allocation made through operator new is tagged with the subsystem that made it, which is whichever
+ * subsystem's Scope is innermost on the allocating thread at the time (or UNTAGGED, outside of every scope).
+ * The tag is kept with the allocation, so freeing it takes its bytes off the subsystem that allocated it,
+ * whichever thread or subsystem frees it.
+ *
+ * Memory that doesn't come through operator new (such as the Lua VM's, which has an allocator of its own)
+ * can be counted towards a subsystem by the code that allocates it.
+ *
+ * The counts are kept with atomic operations, so allocations can be made and freed on any thread.
+ */
+class MemoryTracker
+{
+   public:
+      /** The subsystems that memory is counted towards. */
+      enum Tag
+      {
+         /** Memory allocated outside of every subsystem's scope. */
+         UNTAGGED,
+         /** The tile engine's own state, such as its maps, actors and scripts' tasks. */
+         TILE_ENGINE,
+         /** The pathfinder's search structures and the paths that it finds. */
+         PATHFINDER,
+         /** Sound effects loaded by the resource loader. */
+         SOUND_RESOURCES,
+         /** Regions loaded by the resource loader. */
+         REGION_RESOURCES,
+         /** Tilesets loaded by the resource loader. */
+         TILESET_RESOURCES,
+         /** Music loaded by the resource loader. */
+         MUSIC_RESOURCES,
+         /** Spritesheets loaded by the resource loader. */
+         SPRITESHEET_RESOURCES,
+         /** GUI images loaded by the resource loader. */
+         IMAGE_RESOURCES,
+         /** Font files loaded by the resource loader. */
+         FONT_RESOURCES,
+         /** The Lua VM's heap. */
+         LUA,
+         /** Guichan's widgets and the GUI's drawing. */
+         GUI,
+         /** The audio system. */
+         AUDIO,
+         /** The number of tags. */
+         TAG_COUNT
+      };
+
+      /**
+       * Counts the allocations made on the current thread towards a subsystem for as long as the scope lasts.
+       * Scopes can be nested; the innermost scope's subsystem is the one that allocations are counted towards.
+       */
+      class Scope
+      {
+         /** The tag of the enclosing scope, which is put back when this scope ends. */
+         const int previousTag;
+
+         /** Scopes can't be copied. */
+         Scope(const Scope&);
+
+         /** Scopes can't be copied. */
+         Scope& operator=(const Scope&);
+
+         public:
+            /**
+             * Constructor.
+             *
+             * @param tag The subsystem to count allocations towards.
+             */
+            Scope(Tag tag);
+
+            /**
+             * Destructor.
+             */
+            ~Scope();
+      };
+
+      /**
+       * Allocates memory for operator new, counting it towards the current scope's subsystem.
+       *
+       * @param size The number of bytes to allocate.
+       *
+       * @return The memory, or NULL if it couldn't be allocated.
+       */
+      static void* allocate(size_t size);
+
+      /**
+       * Frees memory for operator delete, taking it off the subsystem that allocated it.
+       *
+       * @param memory The memory to free, which was allocated by allocate() (or NULL).
+       */
+      static void deallocate(void* memory);
+
+      /**
+       * Counts memory that was allocated (or freed) without going through operator new towards a subsystem.
+       *
+       * @param tag The subsystem that holds the memory.
+       * @param bytes The number of bytes allocated, or minus the number of bytes freed.
+       */
+      static void addExternalBytes(Tag tag, long bytes);
+
+      /**
+       * @param tag A subsystem.
+       *
+       * @return The memory (in bytes) that the subsystem holds.
+       */
+      static long getLiveBytes(Tag tag);
+
+      /**
+       * @return The memory (in bytes) that every subsystem holds, together.
+       */
+      static long getTotalLiveBytes();
+
+      /**
+       * @return The number of allocations that have been made through operator new, by every subsystem.
+       */
+      static unsigned long getTotalAllocationCount();
+
+      /**
+       * @param tag A subsystem.
+       *
+       * @return The name of the subsystem, as shown in reports.
+       */
+      static const char* getTagName(Tag tag);
+
+      /**
+       * Describes the memory that each subsystem holds, for the debug console.
+       *
+       * @param lines Filled with the lines of the description.
+       */
+      static void describe(std::vector<std::string>& lines);
+
+      /**
+       * Logs the subsystems in a range that still hold memory, after the point where they should have let go of all of it.
+       *
+       * @param when Where in the engine's shutdown the report is made, for the log.
+       * @param firstTag The first subsystem to report on.
+       * @param lastTag The last subsystem to report on.
+       */
+      static void reportLeaks(const char* when, Tag firstTag, Tag lastTag);
+};
+
+#endif
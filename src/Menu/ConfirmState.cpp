@@ -7,6 +7,7 @@
 #include "ConfirmState.h"
 #include "ConfirmStateListener.h"
 #include "Container.h"
+#include "InputQueue.h"
 #include "SDL.h"
 
 #include "DebugUtils.h"
@@ -71,14 +72,12 @@ void ConfirmState::action(const gcn::ActionEvent& event)
    finished = true;
 }
 
-bool ConfirmState::step()
+bool ConfirmState::step(long timePassed)
 {
-   SDL_Event event;
-
-   /* Check for events */
-   if(SDL_PollEvent(&event))
+   InputQueue::Input input;
+   while(!finished && InputQueue::poll(input))
    {
-      handleEvent(event);
+      handleEvent(input.event);
    }
 
    return !finished;
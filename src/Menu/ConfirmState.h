@@ -70,7 +70,7 @@ class ConfirmState : public GameState, public gcn::ActionListener
        */
       void action(const gcn::ActionEvent& event);
 
-      bool step();
+      bool step(long timePassed);
       void draw();
    
       ~ConfirmState();
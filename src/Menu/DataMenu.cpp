@@ -42,13 +42,12 @@ void DataMenu::refresh()
       std::string filename(entry->d_name);
       if(filename.length() > 4 && filename.substr(filename.length() - 4, 4) == ".edd")
       {
-         PlayerData* data = new PlayerData();
-         
          /** \todo Extract HARDCODED path into a constant. */
          std::string path = "data/savegames/" + filename;
-         data->load(path);
-         
-         saveGames.push_back(data);
+
+         // Only the summary at the front of each save game is read, so that the menu opens quickly with many save games
+         saveGames.push_back(SaveGameSummary());
+         saveGames.back().load(path);
       }
    }
    
@@ -59,7 +58,7 @@ void DataMenu::refresh()
 
 void DataMenu::moduleSelected(int index, const std::string& eventId)
 {
-   selectedSavePath = saveGames[index]->getFilePath();
+   selectedSavePath = saveGames[index].getFilePath();
    executionStack.pushState(new ConfirmState(executionStack, top, *this, "Save Game?", selectedSavePath));
 }
 
@@ -10,6 +10,7 @@
 #include "MenuState.h"
 #include "ModuleSelectListener.h"
 #include "ConfirmStateListener.h"
+#include "SaveGameSummary.h"
 
 #include <vector>
 
@@ -26,7 +27,8 @@ class DataMenu : public MenuState, public edwt::ModuleSelectListener, public Con
    /** The player data that the menu interacts with. */
    PlayerData& playerData;
    
-   std::vector<PlayerData*> saveGames;
+   /** The summaries of the save games in the savegames folder. */
+   std::vector<SaveGameSummary> saveGames;
    
    /** Selected save game when the confirmation dialog is raised */
    std::string selectedSavePath;
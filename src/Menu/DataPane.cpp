@@ -7,7 +7,7 @@
 #include "DataPane.h"
 #include "ItemData.h"
 #include "Item.h"
-#include "PlayerData.h"
+#include "SaveGameSummary.h"
 #include "ListBox.h"
 #include "StringListModel.h"
 #include "SaveGameModule.h"
@@ -22,13 +22,13 @@ DataPane::DataPane(const gcn::Rectangle& rect) : MenuPane(rect), moduleSelectLis
    addActionListener(this);
 }
 
-void DataPane::setSaveGames(std::vector<PlayerData*> saveGames)
+void DataPane::setSaveGames(const std::vector<SaveGameSummary>& saveGames)
 {
    clearModules();
 
-   for(std::vector<PlayerData*>::iterator iter = saveGames.begin(); iter != saveGames.end(); ++iter)
+   for(std::vector<SaveGameSummary>::const_iterator iter = saveGames.begin(); iter != saveGames.end(); ++iter)
    {
-      saveGameModules.push_back(new SaveGameModule(**iter));
+      saveGameModules.push_back(new SaveGameModule(*iter));
    }
    
    const int moduleHeight = 200;
@@ -16,8 +16,8 @@ namespace edwt
    class ModuleSelectListener;
 };
 
-class PlayerData;
 class SaveGameModule;
+class SaveGameSummary;
 
 /**
  * The pane to display when showing the items menu state.
@@ -51,9 +51,9 @@ class DataPane : public MenuPane, public gcn::ActionListener
       /**
        * Set the save games to display.
        *
-       * @param saveGames The savegames to set and display in the pane.
+       * @param saveGames The summaries of the savegames to set and display in the pane.
        */
-      void setSaveGames(std::vector<PlayerData*> saveGames);
+      void setSaveGames(const std::vector<SaveGameSummary>& saveGames);
 
       void setModuleSelectListener(edwt::ModuleSelectListener* listener);
    
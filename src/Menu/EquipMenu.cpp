@@ -17,8 +17,7 @@ const int debugFlag = DEBUG_MENU;
 EquipMenu::EquipMenu(ExecutionStack& executionStack, MenuShell& menuShell, PlayerData& playerData, const std::string& characterName) : MenuState(executionStack, menuShell), playerData(playerData), characterName(characterName)
 {
    // Initialize the equipment pane using the character slots.
-   std::vector<EquipSlot*> characterSlots = playerData.getPartyCharacter(characterName)->getEquipment().getSlots();
-   equipSlots.assign(characterSlots.begin(), characterSlots.end());
+   setEquipSlots();
    EquipPane* equipPane = new EquipPane(equipSlots, equippableItems, menuShell.getDimension());
 
    // The equipment menu will listen for slot selection and item selection
@@ -58,8 +57,7 @@ void EquipMenu::moduleSelected(int index, const std::string& eventId)
       // An equipment slot was selected to change.
       DEBUG("Equipment slot %d selected.", index);
       selectedSlot = equipSlots[index];
-      ItemList acceptedItems = playerData.getItemsByTypes(selectedSlot->acceptedTypes);
-      equippableItems.setItems(acceptedItems);
+      equippableItems.setItems(playerData.getItemsByTypes(selectedSlot->acceptedTypes));
       
       ((EquipPane*)menuPane)->invalidate();
    }
@@ -68,12 +66,24 @@ void EquipMenu::moduleSelected(int index, const std::string& eventId)
 void EquipMenu::setCharacter(const std::string& charName)
 {
    characterName = charName;
-   std::vector<EquipSlot*> characterSlots = playerData.getPartyCharacter(characterName)->getEquipment().getSlots();
-   equipSlots.assign(characterSlots.begin(), characterSlots.end());
+   setEquipSlots();
 
    ((EquipPane*)menuPane)->invalidate();
 }
 
+void EquipMenu::setEquipSlots()
+{
+   EquipData& equipment = playerData.getPartyCharacter(characterName)->getEquipment();
+   const int slotCount = equipment.getSlotCount();
+
+   equipSlots.clear();
+   equipSlots.reserve(slotCount);
+   for(int i = 0; i < slotCount; ++i)
+   {
+      equipSlots.push_back(&equipment.getSlot(i));
+   }
+}
+
 EquipMenu::~EquipMenu()
 {
 }
@@ -41,6 +41,11 @@ class EquipMenu : public MenuState, public edwt::ModuleSelectListener
    
    /** The name of the character to display equipment info for. */
    std::string characterName;
+
+   /**
+    * Fill the list of equipment slots with the slots of the displayed character.
+    */
+   void setEquipSlots();
    
    public:
       /**
@@ -7,6 +7,7 @@
 #include "EquipPane.h"
 #include "EquipSlot.h"
 #include "ModuleSelectListener.h"
+#include "GraphicsUtil.h"
 #include "Item.h"
 #include "ItemListModel.h"
 
@@ -140,6 +141,9 @@ void EquipPane::refresh()
 void EquipPane::invalidate()
 {
    invalidated = true;
+
+   // The pane refreshes itself in its logic, which only runs once the GUI knows it has changed
+   GraphicsUtil::getInstance()->invalidateGUI();
 }
 
 void EquipPane::logic()
@@ -29,6 +29,7 @@
 #include "HomePane.h"
 
 #include "ExecutionStack.h"
+#include "InputQueue.h"
 #include "SDL_image.h"
 #include "DebugUtils.h"
 
@@ -41,7 +42,7 @@ HomeMenu::HomeMenu(ExecutionStack& executionStack, MenuShell& menuShell, PlayerD
    pane->setModuleSelectListener(this);
 }
 
-bool HomeMenu::step()
+bool HomeMenu::step(long timePassed)
 {
    if(finished) return false;
 
@@ -54,37 +55,19 @@ bool HomeMenu::step()
 
 void HomeMenu::pollInputEvent(bool& finishState)
 {
-   SDL_Event event;
-
-   /* Check for events */
-   if(SDL_PollEvent(&event))
+   InputQueue::Input input;
+   while(InputQueue::poll(input))
    {
-      switch (event.type)
+      if(input.action == InputQueue::CANCEL && input.pressed)
       {
-         case SDL_KEYDOWN:
-         {
-            switch(event.key.keysym.sym)
-            {
-               case SDLK_ESCAPE:
-               {
-                  finishState = true;
-                  return;
-               }
-               default:
-               {
-                  break;
-               }
-            }
-            break;
-         }
-         default:
-         {
-             break;
-         }
+         finishState = true;
+
+         // The rest of the input is left for the state below
+         return;
       }
 
       // If the main HomeMenu didn't consume this event, then propagate to the generic input handling
-      handleEvent(event);
+      handleEvent(input.event);
    }
 }
 
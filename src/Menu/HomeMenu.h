@@ -63,7 +63,7 @@ class HomeMenu: public MenuState, public edwt::ModuleSelectListener, public gcn:
        *
        * @return true iff the title screen is not finished running (no quit event)
        */
-      bool step();
+      bool step(long timePassed);
 
    public:
       /**
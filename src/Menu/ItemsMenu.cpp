@@ -16,8 +16,7 @@ const int debugFlag = DEBUG_MENU;
 
 ItemsMenu::ItemsMenu(ExecutionStack& executionStack, MenuShell& menuShell, PlayerData& playerData) : MenuState(executionStack, menuShell), playerData(playerData)
 {
-   ItemList inventory = playerData.getInventory();
-   inventoryList.setItems(inventory);
+   inventoryList.setItems(playerData.getInventory());
    ItemsPane* pane = new ItemsPane(inventoryList, menuShell.getDimension());
    pane->setModuleSelectListener(this);
 
@@ -27,7 +26,7 @@ ItemsMenu::ItemsMenu(ExecutionStack& executionStack, MenuShell& menuShell, Playe
 void ItemsMenu::moduleSelected(int index, const std::string& eventId)
 {
    const Item* item = inventoryList.getItemAt(index);
-   DEBUG("Item selected: %s", item->getName().c_str());
+   DEBUG("Item selected: %s", item->getName());
 }
 
 ItemsMenu::~ItemsMenu()
@@ -11,6 +11,7 @@
 #include "ListBox.h"
 #include "ItemListModel.h"
 #include "ModuleSelectListener.h"
+#include "GraphicsUtil.h"
 
 #include "DebugUtils.h"
 
@@ -58,6 +59,9 @@ void ItemsPane::logic()
 void ItemsPane::invalidate()
 {
    invalidated = true;
+
+   // The pane refreshes itself in its logic, which only runs once the GUI knows it has changed
+   GraphicsUtil::getInstance()->invalidateGUI();
 }
 
 void ItemsPane::refresh()
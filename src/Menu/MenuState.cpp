@@ -11,6 +11,7 @@
 #include "MenuPane.h"
 #include "Container.h"
 #include "TabbedArea.h"
+#include "InputQueue.h"
 #include <SDL.h>
 #include "DebugUtils.h"
 
@@ -40,11 +41,8 @@ void MenuState::activate()
    menuPane->setVisible(true);
 }
 
-bool MenuState::step()
+bool MenuState::step(long timePassed)
 {
-   /* Don't run too fast */
-   SDL_Delay (1);
-
    if(finished) return false;
    bool done = false;
 
@@ -54,38 +52,20 @@ bool MenuState::step()
 }
 
 void MenuState::pollInputEvent(bool& finishState)
-{  
-   /* Check for events */
-   SDL_Event event;
-   if(SDL_PollEvent(&event))
+{
+   InputQueue::Input input;
+   while(InputQueue::poll(input))
    {
-      switch (event.type)
+      if(input.action == InputQueue::CANCEL && input.pressed)
       {
-         case SDL_KEYDOWN:
-         {
-            switch(event.key.keysym.sym)
-            {
-               case SDLK_ESCAPE:
-               {
-                  finishState = true;
-                  return;
-               }
-               default:
-               {
-                  break;
-               }
-            }
-
-            break;
-         }
-         default:
-         {
-            break;
-         }
+         finishState = true;
+
+         // The rest of the input is left for the state below
+         return;
       }
 
-      // If the menu pane didn't consume this event at all, then propagate to the generic input handling
-      handleEvent(event);
+      // If the menu pane didn't consume this event, then propagate to the generic input handling
+      handleEvent(input.event);
    }
 }
 
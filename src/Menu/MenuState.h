@@ -75,7 +75,7 @@ class MenuState : public GameState, public edwt::TabChangeListener
       /**
        * Processes for events common to all menu states, such as "cancel" actions.
        */
-      virtual bool step();
+      virtual bool step(long timePassed);
    
       /**
        * Common menu drawing code should go here.
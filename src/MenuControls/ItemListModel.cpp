@@ -9,14 +9,33 @@
 #include "Item.h"
 #include <sstream>
 
-void ItemListModel::setItems(ItemList& newList)
+ItemListModel::ItemListModel() : revision(0)
+{
+}
+
+void ItemListModel::setItems(const ItemList& newList)
 {
    itemList.assign(newList.begin(), newList.end());
+
+   columnTexts.clear();
+   columnTexts.reserve(itemList.size() * NUM_COLUMNS);
+   for(ItemList::const_iterator iter = itemList.begin(); iter != itemList.end(); ++iter)
+   {
+      std::stringstream quantity;
+      quantity << iter->second;
+
+      columnTexts.push_back(ItemData::getInstance()->getItem(iter->first)->getName());
+      columnTexts.push_back(quantity.str());
+   }
+
+   ++revision;
 }
 
 void ItemListModel::clear()
 {
    itemList.clear();
+   columnTexts.clear();
+   ++revision;
 }
 
 int ItemListModel::getNumberOfElements()
@@ -24,14 +43,19 @@ int ItemListModel::getNumberOfElements()
    return itemList.size();
 }
 
-std::string ItemListModel::getElementAt(int i)
+unsigned int ItemListModel::getNumberOfColumnsAt(int i)
 {
-   std::stringstream stream;
-   stream << getItemAt(i)->getName();
-   stream << '\t';
-   stream << itemList[i].second;
+   return NUM_COLUMNS;
+}
 
-   return stream.str();
+const std::string& ItemListModel::getColumnAt(int i, unsigned int column)
+{
+   return columnTexts[i * NUM_COLUMNS + column];
+}
+
+unsigned int ItemListModel::getRevision() const
+{
+   return revision;
 }
 
 const Item* ItemListModel::getItemAt(int i)
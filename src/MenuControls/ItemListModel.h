@@ -8,20 +8,33 @@
 #define ITEM_LIST_MODEL_H
 
 #include "ItemList.h"
-#include "guichan.hpp"
+#include "ColumnListModel.h"
+#include <string>
 #include <vector>
 
 class Item;
 
-class ItemListModel : public gcn::ListModel
+class ItemListModel : public edwt::ColumnListModel
 {
+   /** The number of columns shown for each item: its name and its quantity. */
+   static const unsigned int NUM_COLUMNS = 2;
+
    ItemList itemList;
+
+   /** The text of each item's columns, one item after another, worked out whenever the items are set. */
+   std::vector<std::string> columnTexts;
+
+   /** The number of times the items have been set or cleared. */
+   unsigned int revision;
    
    public:
-      void setItems(ItemList& newList);
+      ItemListModel();
+      void setItems(const ItemList& newList);
       void clear();
       int getNumberOfElements();
-      std::string getElementAt(int i);
+      unsigned int getNumberOfColumnsAt(int i);
+      const std::string& getColumnAt(int i, unsigned int column);
+      unsigned int getRevision() const;
       const Item* getItemAt(int i);
 };
 
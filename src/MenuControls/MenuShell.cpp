@@ -6,6 +6,7 @@
 
 #include "MenuShell.h"
 #include "TabbedArea.h"
+#include "Icon.h"
 #include "guichan.hpp"
 #include "GraphicsUtil.h"
 #include "PlayerData.h"
@@ -22,7 +23,7 @@
 
 const int debugFlag = DEBUG_MENU;
 
-MenuShell::MenuShell(PlayerData& playerData) : activeState(NULL)
+MenuShell::MenuShell(PlayerData& playerData) : selectSound(NULL), actionsListBox(NULL), activeState(NULL)
 {
    try
    {
@@ -32,8 +33,9 @@ MenuShell::MenuShell(PlayerData& playerData) : activeState(NULL)
       const gcn::Color menuBackgroundColor(50, 50, 50, 150);
       const gcn::Rectangle menuAreaRect(0, 0, getWidth() * 0.8 - 5, getHeight() - 10);
 
-      bg = new gcn::Icon("data/images/menubg.jpg");
+      bg = new edwt::Icon("data/images/menubg.jpg");
       selectSound = ResourceLoader::getSound("reselect");
+      selectSound->acquire();
 
       menuTabs = new edwt::TabbedArea();
       menuArea = new edwt::Container();
@@ -46,12 +48,7 @@ MenuShell::MenuShell(PlayerData& playerData) : activeState(NULL)
       menuTabs->setDimension(menuAreaRect);
 
       menuTabs->addTab("Party", menuArea);
-
-      CharacterList party = playerData.getParty();
-      for (CharacterList::iterator iter = party.begin(); iter != party.end(); ++iter)
-      {
-         menuTabs->addTab((*iter)->getName(), menuArea);
-      }
+      refresh(playerData);
 
       populateOpsList();
       actionsListBox = new edwt::ListBox(listOps);
@@ -76,6 +73,41 @@ MenuShell::MenuShell(PlayerData& playerData) : activeState(NULL)
    }
 }
 
+void MenuShell::refresh(PlayerData& playerData)
+{
+   // The previous menu state is gone, so it mustn't hear about the tabs changing
+   setActiveState(NULL);
+
+   std::vector<std::string> names;
+   const CharacterList& party = playerData.getParty();
+   for (CharacterList::const_iterator iter = party.begin(); iter != party.end(); ++iter)
+   {
+      names.push_back((*iter)->getName());
+   }
+
+   if(names != partyTabNames)
+   {
+      for(std::vector<std::string>::size_type i = 0; i < partyTabNames.size(); ++i)
+      {
+         menuTabs->removeTabWithIndex(1);
+      }
+
+      for(std::vector<std::string>::const_iterator iter = names.begin(); iter != names.end(); ++iter)
+      {
+         menuTabs->addTab(*iter, menuArea);
+      }
+
+      partyTabNames.swap(names);
+   }
+
+   menuTabs->gcn::TabbedArea::setSelectedTab(0u);
+
+   if(actionsListBox != NULL)
+   {
+      actionsListBox->setSelected(0);
+   }
+}
+
 void MenuShell::populateOpsList()
 {
    listOps = new edwt::StringListModel();
@@ -124,6 +156,8 @@ void MenuShell::valueChanged(const gcn::SelectionEvent& event)
 
 MenuShell::~MenuShell()
 {
+   if(selectSound != NULL) selectSound->release();
+
    delete menuArea;
    delete menuTabs;
    delete listOps;
@@ -9,14 +9,12 @@
 
 #include "Container.h"
 #include "MenuAction.h"
-
-namespace gcn
-{
-   class Icon;
-};
+#include <string>
+#include <vector>
 
 namespace edwt
 {
+   class Icon;
    class TabbedArea;
    class ListBox;
    class StringListModel;
@@ -42,7 +40,7 @@ class MenuShell : public edwt::Container, public gcn::ActionListener, public gcn
    Sound* selectSound;
 
    /** Background for the menu */
-   gcn::Icon* bg;
+   edwt::Icon* bg;
 
    /** The list box for all options in the menu */
    edwt::ListBox* actionsListBox;
@@ -58,6 +56,9 @@ class MenuShell : public edwt::Container, public gcn::ActionListener, public gcn
 
    /** The active menu state */
    MenuState* activeState;
+
+   /** The names of the party members that have tabs, in the order of their tabs (after the "Party" tab). */
+   std::vector<std::string> partyTabNames;
    
    /**
     * Populate the action list with required options
@@ -72,6 +73,16 @@ class MenuShell : public edwt::Container, public gcn::ActionListener, public gcn
        */
       MenuShell(PlayerData& playerData);
 
+      /**
+       * Brings the menu shell up to date with the player data before the menu is opened again,
+       * so that the shell can be kept instead of being built again for every opening.
+       * Only the character tabs depend on the player data, and they are only rebuilt if the party has changed.
+       * The first tab and the first option are selected again, and no menu state is active until one sets its pane.
+       *
+       * @param playerData The player data model accessed by this menu.
+       */
+      void refresh(PlayerData& playerData);
+
       /**
        * Push a menu pane to the central part of the menu shell.
        *
@@ -7,26 +7,63 @@
 #include "SaveGameModule.h"
 
 #include "PlayerData.h"
-#include "Character.h"
+#include "SaveGameSummary.h"
+#include <iomanip>
+#include <sstream>
 #include "Container.h"
 #include "Label.h"
 #include "Icon.h"
 
-SaveGameModule::SaveGameModule(PlayerData& playerData) : playerData(playerData)
+SaveGameModule::SaveGameModule(const SaveGameSummary& summary)
 {
-   setNumberOfColumns(PlayerData::PARTY_SIZE);
-   setHorizontalSpacing(10);
-   setPadding(5, 5, 5, 5);
+   portraits = new gcn::contrib::AdjustingContainer();
+   portraits->setNumberOfColumns(PlayerData::PARTY_SIZE);
+   portraits->setHorizontalSpacing(10);
+   portraits->setOpaque(false);
 
-   CharacterList party = playerData.getParty();
-   for(CharacterList::iterator iter = party.begin(); iter != party.end(); ++iter)
+   const std::vector<std::string>& portraitPaths = summary.getPortraitPaths();
+   for(std::vector<std::string>::const_iterator iter = portraitPaths.begin(); iter != portraitPaths.end(); ++iter)
    {
-      edwt::Icon* characterPicture = new edwt::Icon((*iter)->getPortraitPath());
+      edwt::Icon* characterPicture = new edwt::Icon(*iter);
 
-      add(characterPicture);
+      portraits->add(characterPicture);
       characterPortraits.push_back(characterPicture);
    }
-   
+
+   std::string location = summary.getRegion();
+   if(!summary.getMap().empty())
+   {
+      location += (location.empty() ? "" : " - ") + summary.getMap();
+   }
+
+   const Uint32 playTime = summary.getPlayTime();
+   std::stringstream playTimeSummary;
+   playTimeSummary << playTime / 3600 << ':' << std::setfill('0') << std::setw(2) << playTime / 60 % 60
+         << ':' << std::setw(2) << playTime % 60;
+
+   locationLabel = new edwt::Label(location);
+   playTimeLabel = new edwt::Label(playTimeSummary.str());
+   locationLabel->setForegroundColor(0xFFFFFF);
+   playTimeLabel->setForegroundColor(0xFFFFFF);
+
+   details = new gcn::contrib::AdjustingContainer();
+   details->setNumberOfColumns(1);
+   details->setColumnAlignment(0, gcn::contrib::AdjustingContainer::LEFT);
+   details->add(locationLabel);
+   details->add(playTimeLabel);
+   details->setOpaque(false);
+
+   setNumberOfColumns(2);
+   setColumnAlignment(0, gcn::contrib::AdjustingContainer::LEFT);
+   setColumnAlignment(1, gcn::contrib::AdjustingContainer::RIGHT);
+   setHorizontalSpacing(10);
+   setPadding(5, 5, 5, 5);
+
+   add(portraits);
+   add(details);
+
+   portraits->adjustContent();
+   details->adjustContent();
    adjustContent();
    setOpaque(false);
    
@@ -44,4 +81,9 @@ SaveGameModule::~SaveGameModule()
    {
       delete *iter;
    }
+
+   delete portraits;
+   delete locationLabel;
+   delete playTimeLabel;
+   delete details;
 }
@@ -4,8 +4,8 @@
  *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
  */
 
-#ifndef CHARACTER_MODULE_H
-#define CHARACTER_MODULE_H
+#ifndef SAVE_GAME_MODULE_H
+#define SAVE_GAME_MODULE_H
 
 #include "guichan.hpp"
 
@@ -16,32 +16,37 @@ namespace edwt
    class Label;
 };
 
-class PlayerData;
+class SaveGameSummary;
 
 /**
- * A GUI element used to display summarized character information in a small area of a menu.
+ * A GUI element used to display summarized save game information in a small area of a menu.
  *
  * @author Noam Chitayat
  */
 class SaveGameModule : public gcn::contrib::AdjustingContainer, public gcn::MouseListener
 {
-   /** The player save data to show. */
-   PlayerData& playerData;
-   
-   /** Path to the save game file. */
-   const std::string path;
+   /** The container holding the portraits of the characters. */
+   gcn::contrib::AdjustingContainer* portraits;
 
    /** The icons holding the portraits of the characters. */
    std::vector<edwt::Icon*> characterPortraits;
 
+   /** The container holding the location and play time of the save game. */
+   gcn::contrib::AdjustingContainer* details;
+
+   /** The label showing where the game was saved. */
+   edwt::Label* locationLabel;
+
+   /** The label showing how long the game has been played for. */
+   edwt::Label* playTimeLabel;
+
    public:
       /**
-       * Constructor for creating an empty character module.
+       * Constructor.
        *
-       * @param playerData The player data contained in the save game.
-       * @param path The path to the save game file.
+       * @param summary The summary of the save game to show.
        */
-      SaveGameModule(PlayerData& playerData);
+      SaveGameModule(const SaveGameSummary& summary);
 
       /**
        * @param event The mouse click event to handle.
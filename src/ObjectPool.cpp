@@ -0,0 +1,131 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ObjectPool.h"
+#include "MemoryTracker.h"
+#include <new>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_MAIN;
+
+// Every member of a pooled object (pointers, longs, floats and containers) is aligned to at most this many bytes
+static const size_t BLOCK_ALIGNMENT = sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double);
+
+// Enough for every actor on a busy map to have a few orders (or every script a few tasks) in flight before a second chunk is needed
+static const size_t BLOCKS_PER_CHUNK = 64;
+
+/**
+ * @param objectSize The size of the objects to store in the blocks (in bytes).
+ * @param minimumSize The smallest that a block can be (in bytes).
+ *
+ * @return The size of the blocks (in bytes), which is a multiple of the block alignment.
+ */
+static size_t getBlockSize(size_t objectSize, size_t minimumSize)
+{
+   const size_t size = objectSize < minimumSize ? minimumSize : objectSize;
+   return (size + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+}
+
+ObjectPool::ObjectPool(const char* name, size_t objectSize) : name(name), blockSize(getBlockSize(objectSize, sizeof(FreeBlock))),
+   freeList(NULL), liveCount(0), allocationCount(0), heapAllocationCount(0)
+{
+   getRegisteredPools().push_back(this);
+}
+
+std::vector<ObjectPool*>& ObjectPool::getRegisteredPools()
+{
+   // Never destroyed, like the pools themselves, so that it outlives every pooled object
+   static std::vector<ObjectPool*>* pools = new std::vector<ObjectPool*>();
+   return *pools;
+}
+
+void ObjectPool::grow()
+{
+   // The chunks are kept for as long as the program runs, so they aren't counted towards whichever subsystem made the pool grow
+   MemoryTracker::Scope memoryScope(MemoryTracker::UNTAGGED);
+   char* chunk = static_cast<char*>(::operator new(blockSize * BLOCKS_PER_CHUNK));
+   chunks.push_back(chunk);
+
+   // Thread the blocks onto the free list back to front, so that they are handed out in address order
+   for(size_t i = BLOCKS_PER_CHUNK; i > 0; --i)
+   {
+      FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + (i - 1) * blockSize);
+      block->next = freeList;
+      freeList = block;
+   }
+
+   DEBUG("Pool of %s grew to %d blocks.", name, getCapacity());
+}
+
+void* ObjectPool::allocate(size_t size)
+{
+   ++allocationCount;
+
+   if(size > blockSize)
+   {
+      ++heapAllocationCount;
+      return ::operator new(size);
+   }
+
+   if(freeList == NULL)
+   {
+      grow();
+   }
+
+   FreeBlock* block = freeList;
+   freeList = block->next;
+   ++liveCount;
+   return block;
+}
+
+void ObjectPool::release(void* block, size_t size)
+{
+   if(block == NULL)
+   {
+      return;
+   }
+
+   if(size > blockSize)
+   {
+      ::operator delete(block);
+      return;
+   }
+
+   FreeBlock* freeBlock = static_cast<FreeBlock*>(block);
+   freeBlock->next = freeList;
+   freeList = freeBlock;
+   --liveCount;
+}
+
+const char* ObjectPool::getName() const
+{
+   return name;
+}
+
+int ObjectPool::getLiveCount() const
+{
+   return liveCount;
+}
+
+int ObjectPool::getCapacity() const
+{
+   return static_cast<int>(chunks.size() * BLOCKS_PER_CHUNK);
+}
+
+unsigned long ObjectPool::getAllocationCount() const
+{
+   return allocationCount;
+}
+
+unsigned long ObjectPool::getHeapAllocationCount() const
+{
+   return heapAllocationCount;
+}
+
+const std::vector<ObjectPool*>& ObjectPool::getPools()
+{
+   return getRegisteredPools();
+}
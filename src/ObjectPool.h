@@ -0,0 +1,130 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * A pool of equally sized blocks of memory, which one kind of small, short-lived object (such as an order or a task) is allocated from.
+ * Rather than going to the heap for every object, deleted objects leave their blocks on a free list for the next object of the same kind to take.
+ * A pooled class allocates from its pool in its own operator new, and hands the memory back in its operator delete.
+ *
+ * The blocks are carved out of chunks, which are only allocated when the free list runs dry.
+ * The chunks are kept until the game exits, so the pool only ever grows to the most objects
+ * of its kind that were alive at once.
+ *
+ * Each pool counts its allocations, so that the performance HUD can show whether or not
+ * the game has settled into reusing its blocks.
+ *
+ * Pooled objects are only created and deleted on the main thread, so the pool isn't thread-safe.
+ */
+class ObjectPool
+{
+   /** A free block, which holds the link to the next free block. */
+   struct FreeBlock
+   {
+      /** The next free block, or NULL if this is the last one. */
+      FreeBlock* next;
+   };
+
+   /** The name of the kind of object that the pool allocates, for the performance HUD. */
+   const char* name;
+
+   /** The size of each block (in bytes), rounded up so that every block starts aligned. */
+   const size_t blockSize;
+
+   /** The chunks that the blocks have been carved out of. */
+   std::vector<char*> chunks;
+
+   /** The first free block, or NULL if every block is in use. */
+   FreeBlock* freeList;
+
+   /** The number of blocks handed out that haven't been handed back. */
+   int liveCount;
+
+   /** The number of objects allocated from the pool since the game started. */
+   unsigned long allocationCount;
+
+   /** The number of objects too large for the pool's blocks, which were allocated from the heap instead. */
+   unsigned long heapAllocationCount;
+
+   /**
+    * Carves a new chunk into blocks, and puts them on the free list.
+    */
+   void grow();
+
+   /**
+    * @return Every pool that has been created, in the order they were created.
+    */
+   static std::vector<ObjectPool*>& getRegisteredPools();
+
+   /** Pools can't be copied. */
+   ObjectPool(const ObjectPool&);
+
+   /** Pools can't be copied. */
+   ObjectPool& operator=(const ObjectPool&);
+
+   public:
+      /**
+       * Constructor. The pool starts out without any blocks.
+       * Pools are meant to last until the game exits, so a pool is never destroyed once it has been created.
+       *
+       * @param name The name of the kind of object that the pool allocates (such as "tasks").
+       * @param objectSize The size of the objects that the pool allocates (in bytes).
+       */
+      ObjectPool(const char* name, size_t objectSize);
+
+      /**
+       * @param size The size of the object to allocate (in bytes).
+       *
+       * @return A block of memory for the object. Objects larger than the pool's blocks
+       *         (such as those of a class derived from the pooled one) are allocated from the heap.
+       */
+      void* allocate(size_t size);
+
+      /**
+       * Hands a block back to the pool.
+       *
+       * @param block The block returned by allocate, or NULL.
+       * @param size The size that the block was allocated with (in bytes).
+       */
+      void release(void* block, size_t size);
+
+      /**
+       * @return The name of the kind of object that the pool allocates.
+       */
+      const char* getName() const;
+
+      /**
+       * @return The number of objects allocated from the pool that haven't been deleted.
+       */
+      int getLiveCount() const;
+
+      /**
+       * @return The number of blocks that the pool has carved out of its chunks.
+       */
+      int getCapacity() const;
+
+      /**
+       * @return The number of objects allocated from the pool since the game started.
+       */
+      unsigned long getAllocationCount() const;
+
+      /**
+       * @return The number of objects that were too large for the pool's blocks, and went to the heap instead.
+       */
+      unsigned long getHeapAllocationCount() const;
+
+      /**
+       * @return Every pool that has been created, in the order they were created.
+       */
+      static const std::vector<ObjectPool*>& getPools();
+};
+
+#endif
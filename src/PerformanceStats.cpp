@@ -0,0 +1,68 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "PerformanceStats.h"
+#include "GLState.h"
+#include <SDL.h>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_GRAPHICS;
+
+// Long enough to even out the odd slow frame, short enough that the rate follows what is on screen
+static const unsigned long RATE_WINDOW = 500;
+
+unsigned long PerformanceStats::lastFrameEnd = 0;
+unsigned long PerformanceStats::lastFrameTime = 0;
+unsigned long PerformanceStats::drawCallsAtFrameEnd = 0;
+unsigned long PerformanceStats::textureBindsAtFrameEnd = 0;
+unsigned long PerformanceStats::lastFrameDrawCalls = 0;
+unsigned long PerformanceStats::lastFrameTextureBinds = 0;
+unsigned long PerformanceStats::rateWindowStart = 0;
+int PerformanceStats::rateWindowFrames = 0;
+double PerformanceStats::framesPerSecond = 0;
+
+void PerformanceStats::endFrame()
+{
+   const unsigned long now = SDL_GetTicks();
+   lastFrameTime = now - lastFrameEnd;
+   lastFrameEnd = now;
+
+   const unsigned long drawCalls = GLState::getDrawCallCount();
+   const unsigned long textureBinds = GLState::getTextureBindCount();
+   lastFrameDrawCalls = drawCalls - drawCallsAtFrameEnd;
+   lastFrameTextureBinds = textureBinds - textureBindsAtFrameEnd;
+   drawCallsAtFrameEnd = drawCalls;
+   textureBindsAtFrameEnd = textureBinds;
+
+   ++rateWindowFrames;
+   if(now - rateWindowStart >= RATE_WINDOW)
+   {
+      framesPerSecond = rateWindowFrames * 1000.0 / (now - rateWindowStart);
+      rateWindowStart = now;
+      rateWindowFrames = 0;
+   }
+}
+
+double PerformanceStats::getFramesPerSecond()
+{
+   return framesPerSecond;
+}
+
+unsigned long PerformanceStats::getLastFrameTime()
+{
+   return lastFrameTime;
+}
+
+unsigned long PerformanceStats::getLastFrameDrawCalls()
+{
+   return lastFrameDrawCalls;
+}
+
+unsigned long PerformanceStats::getLastFrameTextureBinds()
+{
+   return lastFrameTextureBinds;
+}
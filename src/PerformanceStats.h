@@ -0,0 +1,74 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PERFORMANCE_STATS_H
+#define PERFORMANCE_STATS_H
+
+/**
+ * Keeps the live numbers that the engine reports about each drawn frame: how often frames are drawn,
+ * how long the last one took, and how many draw calls and texture binds went into it.
+ *
+ * The draw calls and texture binds are counted by GLState as the frame is drawn, and are rolled up into
+ * the numbers for the last frame when the frame ends. Guichan draws the GUI with its own OpenGL calls,
+ * so those calls aren't counted.
+ */
+class PerformanceStats
+{
+   /** The time (in milliseconds) at which the last frame ended. */
+   static unsigned long lastFrameEnd;
+
+   /** The time (in milliseconds) taken by the last frame, from the end of the frame before it. */
+   static unsigned long lastFrameTime;
+
+   /** The draw calls counted by GLState when the last frame ended. */
+   static unsigned long drawCallsAtFrameEnd;
+
+   /** The texture binds counted by GLState when the last frame ended. */
+   static unsigned long textureBindsAtFrameEnd;
+
+   /** The number of draw calls made during the last frame. */
+   static unsigned long lastFrameDrawCalls;
+
+   /** The number of textures bound during the last frame. */
+   static unsigned long lastFrameTextureBinds;
+
+   /** The time (in milliseconds) at which the frame rate started being measured again. */
+   static unsigned long rateWindowStart;
+
+   /** The number of frames drawn since the frame rate started being measured again. */
+   static int rateWindowFrames;
+
+   /** The frame rate measured over the last full window. */
+   static double framesPerSecond;
+
+   public:
+      /**
+       * Marks the end of a drawn frame, and rolls the counts made during it into the numbers for the last frame.
+       */
+      static void endFrame();
+
+      /**
+       * @return The number of frames drawn each second, measured over the last half second or so.
+       */
+      static double getFramesPerSecond();
+
+      /**
+       * @return The time (in milliseconds) taken by the last frame.
+       */
+      static unsigned long getLastFrameTime();
+
+      /**
+       * @return The number of draw calls made by the engine during the last frame.
+       */
+      static unsigned long getLastFrameDrawCalls();
+
+      /**
+       * @return The number of textures bound by the engine during the last frame.
+       */
+      static unsigned long getLastFrameTextureBinds();
+};
+
+#endif
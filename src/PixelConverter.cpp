@@ -0,0 +1,264 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "PixelConverter.h"
+#include <SDL.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_CONVERTER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PIXEL_CONVERTER_NEON
+#include <arm_neon.h>
+#endif
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+/**
+ * @param shift The shift of a colour channel within a pixel.
+ * @param bytesPerPixel The number of bytes in each pixel.
+ *
+ * @return The index of the channel's byte within the pixel, as the pixel is laid out in memory.
+ */
+static int getChannelByte(int shift, int bytesPerPixel)
+{
+   // Big-endian machines keep the lowest channel in the pixel's last byte
+   const int byteNum = shift / 8;
+   return SDL_BYTEORDER == SDL_BIG_ENDIAN ? bytesPerPixel - 1 - byteNum : byteNum;
+}
+
+void PixelConverter::swapRedBlue(const unsigned char* src, unsigned char* dst, int count, bool opaque)
+{
+   int pixelNum = 0;
+
+#if defined(PIXEL_CONVERTER_SSE2)
+   // Each 32-bit lane holds one pixel, with its first byte at the bottom
+   const __m128i greenAlpha = _mm_set1_epi32(0xFF00FF00);
+   const __m128i redBlue = _mm_set1_epi32(0x00FF00FF);
+   const __m128i alpha = _mm_set1_epi32(opaque ? 0xFF000000 : 0);
+   for(; pixelNum + 4 <= count; pixelNum += 4)
+   {
+      const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pixelNum * 4));
+      const __m128i outerBytes = _mm_and_si128(pixels, redBlue);
+      __m128i swapped = _mm_or_si128(_mm_and_si128(pixels, greenAlpha), _mm_or_si128(_mm_slli_epi32(outerBytes, 16), _mm_srli_epi32(outerBytes, 16)));
+      swapped = _mm_or_si128(swapped, alpha);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pixelNum * 4), swapped);
+   }
+#elif defined(PIXEL_CONVERTER_NEON)
+   for(; pixelNum + 16 <= count; pixelNum += 16)
+   {
+      uint8x16x4_t pixels = vld4q_u8(src + pixelNum * 4);
+      const uint8x16_t red = pixels.val[2];
+      pixels.val[2] = pixels.val[0];
+      pixels.val[0] = red;
+      if(opaque)
+      {
+         pixels.val[3] = vdupq_n_u8(0xFF);
+      }
+
+      vst4q_u8(dst + pixelNum * 4, pixels);
+   }
+#endif
+
+   for(; pixelNum < count; ++pixelNum)
+   {
+      const unsigned char* srcPixel = src + pixelNum * 4;
+      unsigned char* dstPixel = dst + pixelNum * 4;
+      dstPixel[0] = srcPixel[2];
+      dstPixel[1] = srcPixel[1];
+      dstPixel[2] = srcPixel[0];
+      dstPixel[3] = opaque ? 0xFF : srcPixel[3];
+   }
+}
+
+void PixelConverter::makeOpaque(const unsigned char* src, unsigned char* dst, int count)
+{
+   int pixelNum = 0;
+
+#if defined(PIXEL_CONVERTER_SSE2)
+   const __m128i alpha = _mm_set1_epi32(0xFF000000);
+   for(; pixelNum + 4 <= count; pixelNum += 4)
+   {
+      const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pixelNum * 4));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + pixelNum * 4), _mm_or_si128(pixels, alpha));
+   }
+#elif defined(PIXEL_CONVERTER_NEON)
+   for(; pixelNum + 16 <= count; pixelNum += 16)
+   {
+      uint8x16x4_t pixels = vld4q_u8(src + pixelNum * 4);
+      pixels.val[3] = vdupq_n_u8(0xFF);
+      vst4q_u8(dst + pixelNum * 4, pixels);
+   }
+#endif
+
+   for(; pixelNum < count; ++pixelNum)
+   {
+      memcpy(dst + pixelNum * 4, src + pixelNum * 4, 3);
+      dst[pixelNum * 4 + 3] = 0xFF;
+   }
+}
+
+void PixelConverter::expandRGB(const unsigned char* src, unsigned char* dst, int count, bool swapped)
+{
+   int pixelNum = 0;
+
+#if defined(PIXEL_CONVERTER_NEON)
+   for(; pixelNum + 16 <= count; pixelNum += 16)
+   {
+      const uint8x16x3_t srcPixels = vld3q_u8(src + pixelNum * 3);
+      uint8x16x4_t dstPixels;
+      dstPixels.val[0] = srcPixels.val[swapped ? 2 : 0];
+      dstPixels.val[1] = srcPixels.val[1];
+      dstPixels.val[2] = srcPixels.val[swapped ? 0 : 2];
+      dstPixels.val[3] = vdupq_n_u8(0xFF);
+      vst4q_u8(dst + pixelNum * 4, dstPixels);
+   }
+#endif
+
+   // SSE2 has no byte shuffle, so moving between 3 and 4 byte pixels is left to the compiler
+   const int redByte = swapped ? 2 : 0;
+   const int blueByte = swapped ? 0 : 2;
+   for(; pixelNum < count; ++pixelNum)
+   {
+      const unsigned char* srcPixel = src + pixelNum * 3;
+      unsigned char* dstPixel = dst + pixelNum * 4;
+      dstPixel[0] = srcPixel[redByte];
+      dstPixel[1] = srcPixel[1];
+      dstPixel[2] = srcPixel[blueByte];
+      dstPixel[3] = 0xFF;
+   }
+}
+
+void PixelConverter::expandPaletted(const unsigned char* src, unsigned char* dst, int count, const unsigned int* palette)
+{
+   for(int pixelNum = 0; pixelNum < count; ++pixelNum)
+   {
+      memcpy(dst + pixelNum * 4, &palette[src[pixelNum]], 4);
+   }
+}
+
+void PixelConverter::blitToRGBA(SDL_Surface* image, std::vector<unsigned char>& stagingPixels)
+{
+   Uint32 rmask, gmask, bmask, amask;
+
+/* SDL interprets each pixel as a 32-bit number,
+   so our masks must depend on the endianness
+   (byte order) of the machine */
+
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+   rmask = 0xff000000;
+   gmask = 0x00ff0000;
+   bmask = 0x0000ff00;
+   amask = 0x000000ff;
+#else
+   rmask = 0x000000ff;
+   gmask = 0x0000ff00;
+   bmask = 0x00ff0000;
+   amask = 0xff000000;
+#endif
+
+   // The blit leaves whatever is underneath any pixels it skips, which used to be a fresh (transparent) surface
+   std::fill(stagingPixels.begin(), stagingPixels.begin() + image->w * image->h * 4, 0);
+
+   SDL_Surface* rgbSurface = SDL_CreateRGBSurfaceFrom(&stagingPixels[0], image->w, image->h, 32, image->w * 4,
+                                 rmask, gmask, bmask, amask);
+
+   if(!rgbSurface)
+   {
+      // Problem converting the image; throw an exception
+      T_T(std::string("Unable to convert image: ") + SDL_GetError());
+   }
+
+   SDL_BlitSurface(image, 0, rgbSurface, 0);
+
+   // The surface only wraps the staging buffer, so this leaves the pixels be
+   SDL_FreeSurface(rgbSurface);
+}
+
+const unsigned char* PixelConverter::toRGBA(SDL_Surface* image, std::vector<unsigned char>& stagingPixels, int& pitch)
+{
+   const SDL_PixelFormat* format = image->format;
+   const int bytesPerPixel = format->BytesPerPixel;
+   const int width = image->w;
+   const int height = image->h;
+
+   const bool byteChannels = format->Rloss == 0 && format->Gloss == 0 && format->Bloss == 0 && (format->Amask == 0 || format->Aloss == 0);
+   const int redByte = getChannelByte(format->Rshift, bytesPerPixel);
+   const int greenByte = getChannelByte(format->Gshift, bytesPerPixel);
+   const int blueByte = getChannelByte(format->Bshift, bytesPerPixel);
+   const bool hasAlpha = format->Amask != 0;
+   const bool inOrder = redByte == 0 && greenByte == 1 && blueByte == 2;
+   const bool swapped = redByte == 2 && greenByte == 1 && blueByte == 0;
+   const bool colorKeyed = (image->flags & SDL_SRCCOLORKEY) != 0;
+
+   if(bytesPerPixel == 4 && byteChannels && inOrder && hasAlpha && !colorKeyed && getChannelByte(format->Ashift, bytesPerPixel) == 3)
+   {
+      DEBUG("Image is already RGBA; using its pixels as they are.");
+      pitch = image->pitch;
+      return static_cast<const unsigned char*>(image->pixels);
+   }
+
+   if(stagingPixels.size() < static_cast<size_t>(width * height * 4))
+   {
+      stagingPixels.resize(width * height * 4);
+   }
+
+   pitch = width * 4;
+
+   unsigned int palette[256];
+   const bool paletted = bytesPerPixel == 1 && format->palette != NULL;
+   if(paletted)
+   {
+      memset(palette, 0, sizeof(palette));
+      for(int colorNum = 0; colorNum < format->palette->ncolors && colorNum < 256; ++colorNum)
+      {
+         const SDL_Color& color = format->palette->colors[colorNum];
+         const unsigned char rgba[] = { color.r, color.g, color.b, 0xFF };
+         memcpy(&palette[colorNum], rgba, 4);
+      }
+
+      // The colour key marks the transparent palette entry
+      if(colorKeyed)
+      {
+         palette[format->colorkey & 0xFF] = 0;
+      }
+   }
+   else if(colorKeyed || !byteChannels || (bytesPerPixel != 3 && bytesPerPixel != 4) || !(inOrder || swapped)
+         || (hasAlpha && getChannelByte(format->Ashift, bytesPerPixel) != 3))
+   {
+      DEBUG("Converting image from an uncommon pixel format with a blit.");
+      blitToRGBA(image, stagingPixels);
+      return &stagingPixels[0];
+   }
+
+   for(int y = 0; y < height; ++y)
+   {
+      const unsigned char* srcRow = static_cast<const unsigned char*>(image->pixels) + y * image->pitch;
+      unsigned char* dstRow = &stagingPixels[y * pitch];
+
+      if(paletted)
+      {
+         expandPaletted(srcRow, dstRow, width, palette);
+      }
+      else if(bytesPerPixel == 3)
+      {
+         expandRGB(srcRow, dstRow, width, swapped);
+      }
+      else if(swapped)
+      {
+         swapRedBlue(srcRow, dstRow, width, !hasAlpha);
+      }
+      else
+      {
+         makeOpaque(srcRow, dstRow, width);
+      }
+   }
+
+   return &stagingPixels[0];
+}
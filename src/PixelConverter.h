@@ -0,0 +1,85 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PIXEL_CONVERTER_H
+#define PIXEL_CONVERTER_H
+
+#include <vector>
+
+struct SDL_Surface;
+
+/**
+ * The PixelConverter gets the pixels of a loaded image as 32-bit RGBA (one byte per channel, in that order),
+ * which is the format that images are uploaded to OpenGL in.
+ * Images that are already RGBA are used as they are. The formats that images are commonly loaded in
+ * (BGRA, RGB, BGR and paletted) are converted straight into a staging buffer, using SSE2 or NEON
+ * where the compiler targets them; anything else is converted with an SDL blit.
+ */
+class PixelConverter
+{
+   /**
+    * Copies 32-bit pixels, swapping their first and third bytes (red and blue).
+    *
+    * @param src The source pixels.
+    * @param dst The destination pixels.
+    * @param count The number of pixels.
+    * @param opaque Whether to make the fourth byte (alpha) of each pixel opaque.
+    */
+   static void swapRedBlue(const unsigned char* src, unsigned char* dst, int count, bool opaque);
+
+   /**
+    * Copies 32-bit pixels, making the fourth byte (alpha) of each pixel opaque.
+    *
+    * @param src The source pixels.
+    * @param dst The destination pixels.
+    * @param count The number of pixels.
+    */
+   static void makeOpaque(const unsigned char* src, unsigned char* dst, int count);
+
+   /**
+    * Expands 24-bit pixels into opaque 32-bit pixels.
+    *
+    * @param src The source pixels.
+    * @param dst The destination pixels.
+    * @param count The number of pixels.
+    * @param swapped Whether the source pixels are in BGR order.
+    */
+   static void expandRGB(const unsigned char* src, unsigned char* dst, int count, bool swapped);
+
+   /**
+    * Looks up 8-bit palette indices.
+    *
+    * @param src The source palette indices.
+    * @param dst The destination pixels.
+    * @param count The number of pixels.
+    * @param palette The RGBA colour of each palette index, as a 32-bit number in memory order.
+    */
+   static void expandPaletted(const unsigned char* src, unsigned char* dst, int count, const unsigned int* palette);
+
+   /**
+    * Converts an image with an SDL blit, for formats without a conversion of their own.
+    *
+    * @param image The image to convert.
+    * @param stagingPixels The buffer holding the converted pixels.
+    */
+   static void blitToRGBA(SDL_Surface* image, std::vector<unsigned char>& stagingPixels);
+
+   public:
+      /**
+       * Gets the pixels of an image as 32-bit RGBA.
+       * This doesn't touch the OpenGL context, so it can be called from any thread.
+       *
+       * @param image The image to convert.
+       * @param stagingPixels A buffer to convert the pixels into, if they aren't RGBA already.
+       *                      The buffer is only grown, so it can be reused between images.
+       * @param pitch The parameter used to return the number of bytes in each row of pixels.
+       *
+       * @return The image's RGBA pixels, which are either the image's own or in the staging buffer.
+       */
+      static const unsigned char* toRGBA(SDL_Surface* image, std::vector<unsigned char>& stagingPixels, int& pitch);
+};
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "AutosaveLog.h"
+#include "SaveGameFormat.h"
+#include "MappedFile.h"
+#include "SDL_endian.h"
+#include <cstdio>
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PLAYER;
+
+// Compacting rewrites the whole save game, so it shouldn't happen at every few map changes, but replaying
+// a long log makes loading slower
+const int AutosaveLog::COMPACTION_INTERVAL = 32;
+
+// The magic, the version and the checkpoint number
+static const std::size_t LOG_HEADER_SIZE = sizeof(SaveGameFormat::LOG_MAGIC) + 2 * sizeof(Uint32);
+
+/**
+ * Write a 32-bit little-endian number to a file.
+ *
+ * @return true iff the number was written.
+ */
+static bool writeNumber(FILE* output, Uint32 value)
+{
+   const Uint32 littleEndianValue = SDL_SwapLE32(value);
+   return fwrite(&littleEndianValue, sizeof(littleEndianValue), 1, output) == 1;
+}
+
+/**
+ * Read a 32-bit little-endian number.
+ */
+static Uint32 readNumber(const char* data)
+{
+   Uint32 value;
+   memcpy(&value, data, sizeof(value));
+   return SDL_SwapLE32(value);
+}
+
+CheckpointState::CheckpointState() : playTime(0)
+{
+}
+
+AutosaveLog::AutosaveLog() : checkpointCount(0)
+{
+}
+
+std::string AutosaveLog::getLogPath(const std::string& basePath)
+{
+   return basePath + ".log";
+}
+
+bool AutosaveLog::read(const std::string& basePath, Uint32 checkpoint, std::vector<std::string>& checkpoints)
+{
+   const std::string logPath = getLogPath(basePath);
+
+   MappedFile logFile;
+   try
+   {
+      logFile.open(logPath);
+   }
+   catch(const Exception&)
+   {
+      return false;
+   }
+
+   const char* position = logFile.getData();
+   const char* const end = position + logFile.getSize();
+   if(logFile.getSize() < LOG_HEADER_SIZE || memcmp(position, SaveGameFormat::LOG_MAGIC, sizeof(SaveGameFormat::LOG_MAGIC)) != 0)
+   {
+      DEBUG("Autosave log %s is not an autosave log.", logPath.c_str());
+      return false;
+   }
+
+   position += sizeof(SaveGameFormat::LOG_MAGIC);
+   const Uint32 version = readNumber(position);
+   const Uint32 logCheckpoint = readNumber(position + sizeof(Uint32));
+   position += 2 * sizeof(Uint32);
+
+   if(version != SaveGameFormat::LOG_VERSION || logCheckpoint != checkpoint)
+   {
+      DEBUG("Autosave log %s doesn't belong to save game %s.", logPath.c_str(), basePath.c_str());
+      return false;
+   }
+
+   while(static_cast<std::size_t>(end - position) >= sizeof(Uint32))
+   {
+      const Uint32 length = readNumber(position);
+      position += sizeof(Uint32);
+      if(length > static_cast<std::size_t>(end - position))
+      {
+         DEBUG("Last checkpoint in autosave log %s was cut off; ignoring it.", logPath.c_str());
+         break;
+      }
+
+      checkpoints.push_back(std::string(position, length));
+      position += length;
+   }
+
+   return true;
+}
+
+void AutosaveLog::start(const std::string& basePath, Uint32 checkpoint, const CheckpointState& state)
+{
+   this->basePath.clear();
+   checkpointCount = 0;
+   lastState = state;
+
+   const std::string logPath = getLogPath(basePath);
+   FILE* output = fopen(logPath.c_str(), "wb");
+   if(output == NULL)
+   {
+      DEBUG("Failed to open autosave log %s for writing.", logPath.c_str());
+      return;
+   }
+
+   bool written = fwrite(SaveGameFormat::LOG_MAGIC, sizeof(SaveGameFormat::LOG_MAGIC), 1, output) == 1
+         && writeNumber(output, SaveGameFormat::LOG_VERSION) && writeNumber(output, checkpoint);
+   written = fclose(output) == 0 && written;
+
+   if(!written)
+   {
+      DEBUG("Failed to start autosave log %s.", logPath.c_str());
+      remove(logPath.c_str());
+      return;
+   }
+
+   this->basePath = basePath;
+}
+
+void AutosaveLog::discard(const std::string& basePath)
+{
+   remove(getLogPath(basePath).c_str());
+   if(this->basePath == basePath)
+   {
+      this->basePath.clear();
+   }
+}
+
+void AutosaveLog::stop()
+{
+   basePath.clear();
+}
+
+bool AutosaveLog::needsCompaction(const std::string& basePath) const
+{
+   return this->basePath != basePath || checkpointCount >= COMPACTION_INTERVAL;
+}
+
+bool AutosaveLog::append(const std::string& checkpointData, const CheckpointState& state)
+{
+   const std::string logPath = getLogPath(basePath);
+   FILE* output = fopen(logPath.c_str(), "ab");
+   if(output == NULL)
+   {
+      DEBUG("Failed to open autosave log %s for appending.", logPath.c_str());
+      basePath.clear();
+      return false;
+   }
+
+   // The log isn't synced to the disk; a checkpoint lost or cut off in a crash only loses the progress since the one before it
+   bool written = writeNumber(output, checkpointData.size())
+         && fwrite(checkpointData.data(), 1, checkpointData.size(), output) == checkpointData.size();
+   written = fclose(output) == 0 && written;
+
+   if(!written)
+   {
+      // A checkpoint after a partly written one would be read as part of it, so the log can't be appended to anymore
+      DEBUG("Failed to append to autosave log %s.", logPath.c_str());
+      basePath.clear();
+      return false;
+   }
+
+   ++checkpointCount;
+   lastState = state;
+   return true;
+}
+
+const CheckpointState& AutosaveLog::getLastState() const
+{
+   return lastState;
+}
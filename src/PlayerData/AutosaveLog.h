@@ -0,0 +1,152 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef AUTOSAVE_LOG_H
+#define AUTOSAVE_LOG_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "SDL_stdinc.h"
+
+/**
+ * The state of a quest, as far as checkpoints keep track of it.
+ */
+struct QuestState
+{
+   bool completed;
+   bool optional;
+   std::string description;
+};
+
+/**
+ * What the player data looked like at a checkpoint, kept so that the next checkpoint
+ * only has to hold what changed since then.
+ */
+struct CheckpointState
+{
+   /** The quantity of each item held, by item number. */
+   std::map<int, int> inventory;
+
+   /** The state of every quest in the quest log, by its path from the top-level quest. */
+   std::map<std::string, QuestState> quests;
+
+   std::string region;
+   std::string map;
+
+   /** The time the game had been played for, in seconds. */
+   Uint32 playTime;
+
+   /** The encoded party and reserve characters, only compared to find out whether any of them changed. */
+   std::string characters;
+
+   /** The encoded random number streams, only compared to find out whether any of them were drawn from. */
+   std::string randomStreams;
+
+   /**
+    * Constructor for the state of empty player data.
+    */
+   CheckpointState();
+};
+
+/**
+ * The log of checkpoints that autosaves write next to a save game (see SaveGameFormat.h).
+ * Writing the whole save game at every map change would be wasteful, so each autosave only appends the changes
+ * since the one before it to the log. Every so often, the log is compacted: the whole save game is written out again,
+ * and a new, empty log is started for it. When the save game is loaded, its log is replayed over it.
+ */
+class AutosaveLog
+{
+   /** The path of the save game that the log is being written for, or the empty string if there isn't one. */
+   std::string basePath;
+
+   /** The number of checkpoints appended to the log since it was started. */
+   int checkpointCount;
+
+   /** What the player data looked like at the last checkpoint. */
+   CheckpointState lastState;
+
+   /** Logs can't be copied. */
+   AutosaveLog(const AutosaveLog&);
+
+   /** Logs can't be copied. */
+   AutosaveLog& operator=(const AutosaveLog&);
+
+   public:
+      /** The number of checkpoints that a log holds before it is compacted into a whole save game. */
+      static const int COMPACTION_INTERVAL;
+
+      /**
+       * Constructor. No log is being written until start() is called.
+       */
+      AutosaveLog();
+
+      /**
+       * @param basePath The path of a save game.
+       *
+       * @return The path of the save game's autosave log.
+       */
+      static std::string getLogPath(const std::string& basePath);
+
+      /**
+       * Read the checkpoints from the autosave log of a save game.
+       *
+       * @param basePath The path of the save game.
+       * @param checkpoint The checkpoint number of the save game, which the log must have been started on.
+       * @param checkpoints Filled with the checkpoints in the log (each a binary save game holding a checkpoint record),
+       *                    in the order they were written.
+       *
+       * @return true iff the save game has a log that belongs to it.
+       */
+      static bool read(const std::string& basePath, Uint32 checkpoint, std::vector<std::string>& checkpoints);
+
+      /**
+       * Start a new, empty log for a save game that has just been written in whole.
+       *
+       * @param basePath The path of the save game.
+       * @param checkpoint The checkpoint number written into the save game.
+       * @param state What the player data saved in the save game looks like.
+       */
+      void start(const std::string& basePath, Uint32 checkpoint, const CheckpointState& state);
+
+      /**
+       * Delete the log of a save game that has been written in whole without starting a new one.
+       *
+       * @param basePath The path of the save game.
+       */
+      void discard(const std::string& basePath);
+
+      /**
+       * Stop appending to the log, such as when the player data is replaced, so that the next autosave
+       * writes the whole save game. The log is left as it is, since it still belongs to its save game.
+       */
+      void stop();
+
+      /**
+       * @param basePath The path of the save game to autosave to.
+       *
+       * @return true iff the next autosave to the save game has to write the whole save game,
+       *         either because its log isn't being written or because the log is due to be compacted.
+       */
+      bool needsCompaction(const std::string& basePath) const;
+
+      /**
+       * Append a checkpoint to the log. If the log can't be written, the next autosave will write the whole save game.
+       *
+       * @param checkpointData The checkpoint (a binary save game holding a checkpoint record).
+       * @param state What the player data looks like at the checkpoint.
+       *
+       * @return true iff the checkpoint was appended.
+       */
+      bool append(const std::string& checkpointData, const CheckpointState& state);
+
+      /**
+       * @return What the player data looked like at the last checkpoint.
+       */
+      const CheckpointState& getLastState() const;
+};
+
+#endif
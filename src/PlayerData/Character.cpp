@@ -6,16 +6,21 @@
 
 #include "Character.h"
 #include "SaveGameItemNames.h"
+#include "SaveGameDecoder.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
 #include "json.h"
 
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_PLAYER;
 
-Character::Character(const std::string& name) : name(name)
+Character::Character(const std::string& name)
+   : name(name), strength(0), intelligence(0), vitality(0), reflex(0), focus(0), endurance(0), agility(0), maxHP(0), maxSP(0), hp(0), sp(0)
 {
 }
 
 Character::Character(Json::Value& charToLoad)
+   : vitality(0), reflex(0), focus(0), endurance(0), agility(0)
 {
    name = charToLoad[NAME_ATTRIBUTE].asString();
    hp = charToLoad[HP_ATTRIBUTE].asInt();
@@ -29,6 +34,36 @@ Character::Character(Json::Value& charToLoad)
    parsePortraitData(charToLoad);
 }
 
+Character::Character(SaveGameDecoder& characterRecord)
+   : strength(0), intelligence(0), vitality(0), reflex(0), focus(0), endurance(0), agility(0), maxHP(0), maxSP(0), hp(0), sp(0)
+{
+   unsigned int tag;
+   while(characterRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::CharacterField::NAME: name = characterRecord.readString(); break;
+         case SaveGameFormat::CharacterField::HP: hp = characterRecord.readInt(); break;
+         case SaveGameFormat::CharacterField::SP: sp = characterRecord.readInt(); break;
+         case SaveGameFormat::CharacterField::MAX_HP: maxHP = characterRecord.readInt(); break;
+         case SaveGameFormat::CharacterField::MAX_SP: maxSP = characterRecord.readInt(); break;
+         case SaveGameFormat::CharacterField::STRENGTH: strength = characterRecord.readInt(); break;
+         case SaveGameFormat::CharacterField::INTELLIGENCE: intelligence = characterRecord.readInt(); break;
+         case SaveGameFormat::CharacterField::PORTRAIT_PATH: portraitPath = characterRecord.readString(); break;
+         case SaveGameFormat::CharacterField::EQUIPMENT:
+         {
+            SaveGameDecoder equipmentRecord = characterRecord.readMessage();
+            equipment.load(equipmentRecord);
+            break;
+         }
+         default:
+         {
+            characterRecord.skipField();
+         }
+      }
+   }
+}
+
 void Character::parsePortraitData(Json::Value& charToLoad)
 {
    Json::Value& portraitData = charToLoad[PORTRAIT_ELEMENT];
@@ -52,6 +87,23 @@ void Character::serialize(Json::Value& characterSet) const
    characterSet.append(characterNode);
 }
 
+void Character::serialize(SaveGameEncoder& characterRecord) const
+{
+   characterRecord.writeString(SaveGameFormat::CharacterField::NAME, name);
+   characterRecord.writeInt(SaveGameFormat::CharacterField::HP, hp);
+   characterRecord.writeInt(SaveGameFormat::CharacterField::SP, sp);
+   characterRecord.writeInt(SaveGameFormat::CharacterField::MAX_HP, maxHP);
+   characterRecord.writeInt(SaveGameFormat::CharacterField::MAX_SP, maxSP);
+   characterRecord.writeInt(SaveGameFormat::CharacterField::STRENGTH, strength);
+   characterRecord.writeInt(SaveGameFormat::CharacterField::INTELLIGENCE, intelligence);
+
+   SaveGameEncoder equipmentRecord(characterRecord);
+   equipment.serialize(equipmentRecord);
+   characterRecord.writeMessage(SaveGameFormat::CharacterField::EQUIPMENT, equipmentRecord);
+
+   characterRecord.writeString(SaveGameFormat::CharacterField::PORTRAIT_PATH, portraitPath);
+}
+
 void Character::serializePortraitData(Json::Value& characterNode) const
 {
    Json::Value portraitNode(Json::objectValue);
@@ -59,6 +111,21 @@ void Character::serializePortraitData(Json::Value& characterNode) const
    characterNode[PORTRAIT_ELEMENT] = portraitNode;
 }
 
+CharacterStats Character::getStats() const
+{
+   CharacterStats stats;
+   stats.strength = strength;
+   stats.intelligence = intelligence;
+   stats.vitality = vitality;
+   stats.reflex = reflex;
+   stats.focus = focus;
+   stats.endurance = endurance;
+   stats.agility = agility;
+   stats.maxHP = maxHP;
+   stats.maxSP = maxSP;
+   return stats;
+}
+
 int Character::getMaxHP() const
 {
    return maxHP;
@@ -91,7 +158,6 @@ int Character::getIntelligence() const
 
 int Character::getVitality() const
 {
-
    return vitality;
 }
 
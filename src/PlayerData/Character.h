@@ -9,12 +9,16 @@
 
 #include <string>
 #include "EquipData.h"
+#include "CharacterStats.h"
 
 namespace Json
 {
    class Value;
 };
 
+class SaveGameDecoder;
+class SaveGameEncoder;
+
 /**
  * A model holding the data for a character that can be used by the player.
  * All relevant attributes, skills and equipment should be held in this class.
@@ -75,6 +79,13 @@ class Character
        * @param charToLoad The JSON node containing the character data to load.
        */
       Character(Json::Value& charToLoad);
+
+      /**
+       * Constructor used to load an existing character from a binary savegame.
+       *
+       * @param characterRecord The record containing the character data to load.
+       */
+      Character(SaveGameDecoder& characterRecord);
    
       /**
        * Serialize the character data into a JSON output.
@@ -82,6 +93,13 @@ class Character
        * @param characterSet The character array to serialize the character into.
        */
       void serialize(Json::Value& characterSet) const;
+
+      /**
+       * Serialize the character data into a binary savegame record.
+       *
+       * @param characterRecord The record to serialize the character into.
+       */
+      void serialize(SaveGameEncoder& characterRecord) const;
    
       /**
        * @return The name of the character.
@@ -109,6 +127,11 @@ class Character
       int getEndurance() const;
       int getAgility() const;
       
+      /**
+       * @return The character's stats, gathered into one block.
+       */
+      CharacterStats getStats() const;
+
       /**
        * @return The character's equipment information.
        */
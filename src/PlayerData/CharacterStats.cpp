@@ -0,0 +1,12 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "CharacterStats.h"
+
+CharacterStats::CharacterStats()
+   : strength(0), intelligence(0), vitality(0), reflex(0), focus(0), endurance(0), agility(0), maxHP(0), maxSP(0)
+{
+}
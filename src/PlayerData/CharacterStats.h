@@ -0,0 +1,34 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef CHARACTER_STATS_H
+#define CHARACTER_STATS_H
+
+/**
+ * A block of character stats, such as a character's own stats or those of a combatant in a simulated battle.
+ */
+struct CharacterStats
+{
+   // Character status attributes
+   int strength;
+   int intelligence;
+   int vitality;
+   int reflex;
+   int focus;
+   int endurance;
+   int agility;
+
+   // Maximum health and stamina of the character.
+   int maxHP;
+   int maxSP;
+
+   /**
+    * Constructor. All the stats start at zero.
+    */
+   CharacterStats();
+};
+
+#endif
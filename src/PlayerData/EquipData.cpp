@@ -6,6 +6,9 @@
 
 #include "EquipData.h"
 #include "SaveGameItemNames.h"
+#include "SaveGameDecoder.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
 #include "json.h"
 #include "ItemData.h"
 #include "Item.h"
@@ -13,6 +16,22 @@
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_PLAYER;
 
+// The slots are listed by member instead of being collected into a new list each time, so looking at them costs nothing
+EquipSlot EquipData::* const EquipData::FIXED_SLOTS[] =
+{
+   &EquipData::head,
+   &EquipData::body,
+   &EquipData::primaryWeapon,
+   &EquipData::primaryOffhand,
+   &EquipData::secondaryWeapon,
+   &EquipData::secondaryOffhand,
+   &EquipData::garment,
+   &EquipData::feet
+};
+
+// Accessory slots are numbered after all of the fixed slots
+const int EquipData::FIXED_SLOT_COUNT = sizeof(FIXED_SLOTS) / sizeof(FIXED_SLOTS[0]);
+
 EquipData::EquipData()
 {
 }
@@ -62,29 +81,93 @@ void EquipData::serialize(Json::Value& outputJson) const
    {
       accessories[i].serialize(accessoriesNode[i]);
    }
+
+   outputJson["Accessories"] = accessoriesNode;
 }
 
-EquipData::~EquipData()
+void EquipData::load(SaveGameDecoder& equipmentRecord)
 {
+   accessories.clear();
+
+   unsigned int tag;
+   while(equipmentRecord.nextField(tag))
+   {
+      EquipSlot* slot;
+      switch(tag)
+      {
+         case SaveGameFormat::EquipmentField::HEAD: slot = &head; break;
+         case SaveGameFormat::EquipmentField::BODY: slot = &body; break;
+         case SaveGameFormat::EquipmentField::PRIMARY_WEAPON: slot = &primaryWeapon; break;
+         case SaveGameFormat::EquipmentField::PRIMARY_OFFHAND: slot = &primaryOffhand; break;
+         case SaveGameFormat::EquipmentField::SECONDARY_WEAPON: slot = &secondaryWeapon; break;
+         case SaveGameFormat::EquipmentField::SECONDARY_OFFHAND: slot = &secondaryOffhand; break;
+         case SaveGameFormat::EquipmentField::GARMENT: slot = &garment; break;
+         case SaveGameFormat::EquipmentField::FEET: slot = &feet; break;
+         case SaveGameFormat::EquipmentField::ACCESSORY:
+         {
+            accessories.push_back(EquipSlot());
+            slot = &accessories.back();
+            break;
+         }
+         default:
+         {
+            equipmentRecord.skipField();
+            continue;
+         }
+      }
+
+      SaveGameDecoder slotRecord = equipmentRecord.readMessage();
+      slot->load(slotRecord);
+   }
 }
 
-std::vector<EquipSlot*> EquipData::getSlots()
+/**
+ * Serializes an equipment slot into a field of an equipment record.
+ *
+ * @param equipmentRecord The record to add the slot to.
+ * @param tag The tag of the slot's field.
+ * @param slot The slot to serialize.
+ */
+static void serializeSlot(SaveGameEncoder& equipmentRecord, unsigned int tag, const EquipSlot& slot)
 {
-   std::vector<EquipSlot*> slots;
-   slots.push_back(&head);
-   slots.push_back(&body);
-   slots.push_back(&primaryWeapon);
-   slots.push_back(&primaryOffhand);
-   slots.push_back(&secondaryWeapon);
-   slots.push_back(&secondaryOffhand);
-   slots.push_back(&garment);
-   slots.push_back(&feet);
-   
-   for(std::vector<EquipSlot>::iterator iter = accessories.begin(); iter != accessories.end(); ++iter)
+   SaveGameEncoder slotRecord(equipmentRecord);
+   slot.serialize(slotRecord);
+   equipmentRecord.writeMessage(tag, slotRecord);
+}
+
+void EquipData::serialize(SaveGameEncoder& equipmentRecord) const
+{
+   serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::HEAD, head);
+   serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::BODY, body);
+   serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::PRIMARY_WEAPON, primaryWeapon);
+   serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::PRIMARY_OFFHAND, primaryOffhand);
+   serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::SECONDARY_WEAPON, secondaryWeapon);
+   serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::SECONDARY_OFFHAND, secondaryOffhand);
+   serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::GARMENT, garment);
+   serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::FEET, feet);
+
+   for(std::vector<EquipSlot>::const_iterator iter = accessories.begin(); iter != accessories.end(); ++iter)
    {
-      slots.push_back(&(*iter));
+      serializeSlot(equipmentRecord, SaveGameFormat::EquipmentField::ACCESSORY, *iter);
    }
-   
-   return slots;
+}
+
+EquipData::~EquipData()
+{
+}
+
+int EquipData::getSlotCount() const
+{
+   return FIXED_SLOT_COUNT + accessories.size();
+}
+
+EquipSlot& EquipData::getSlot(int index)
+{
+   return index < FIXED_SLOT_COUNT ? this->*FIXED_SLOTS[index] : accessories[index - FIXED_SLOT_COUNT];
+}
+
+const EquipSlot& EquipData::getSlot(int index) const
+{
+   return index < FIXED_SLOT_COUNT ? this->*FIXED_SLOTS[index] : accessories[index - FIXED_SLOT_COUNT];
 }
 
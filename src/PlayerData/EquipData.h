@@ -17,6 +17,8 @@ namespace Json
 };
 
 class Item;
+class SaveGameDecoder;
+class SaveGameEncoder;
 
 /**
  * A data structure used for representing the equipment of a character, in terms of the equipment slots
@@ -52,6 +54,12 @@ class EquipData
 
    /** The accessories equipped by the character. Characters can equip multiple accessories. */
    std::vector<EquipSlot> accessories;
+
+   /** The slots that every set of equipment has, in the order they are listed in. */
+   static EquipSlot EquipData::* const FIXED_SLOTS[];
+
+   /** The number of slots that every set of equipment has. */
+   static const int FIXED_SLOT_COUNT;
    
    public:
       /**
@@ -72,6 +80,20 @@ class EquipData
        * @param outputJson The JSON node to serialize the equipment into.
        */
       void serialize(Json::Value& outputJson) const;
+
+      /**
+       * Load equipment and slot data for this equipment set from a binary savegame.
+       *
+       * @param equipmentRecord The record containing the data for this equipment set.
+       */
+      void load(SaveGameDecoder& equipmentRecord);
+
+      /**
+       * Serialize the equipment set into a binary savegame record.
+       *
+       * @param equipmentRecord The record to serialize the equipment into.
+       */
+      void serialize(SaveGameEncoder& equipmentRecord) const;
    
       /**
        * Destructor.
@@ -79,9 +101,27 @@ class EquipData
       ~EquipData();
 
       /**
-       * @return The list of equipment slots on the character.
+       * @return The number of equipment slots on the character (including accessory slots).
+       */
+      int getSlotCount() const;
+
+      /**
+       * Get one of the character's equipment slots. The fixed slots come first, followed by the accessory slots.
+       *
+       * @param index The index of the slot (0 to getSlotCount() - 1).
+       *
+       * @return The equipment slot at the given index.
+       */
+      EquipSlot& getSlot(int index);
+
+      /**
+       * Get one of the character's equipment slots. The fixed slots come first, followed by the accessory slots.
+       *
+       * @param index The index of the slot (0 to getSlotCount() - 1).
+       *
+       * @return The equipment slot at the given index.
        */
-      std::vector<EquipSlot*> getSlots();
+      const EquipSlot& getSlot(int index) const;
 };
 
 #endif
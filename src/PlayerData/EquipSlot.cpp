@@ -7,6 +7,9 @@
 #include "EquipSlot.h"
 #include "ItemData.h"
 #include "Item.h"
+#include "SaveGameDecoder.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
 #include "json.h"
 
 EquipSlot::EquipSlot() : equipped(NULL), acceptedTypes(NULL), enabled(true)
@@ -70,6 +73,57 @@ void EquipSlot::serialize(Json::Value& slotNode) const
    }
 }
 
+void EquipSlot::load(SaveGameDecoder& slotRecord)
+{
+   unsigned int tag;
+   while(slotRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::EquipSlotField::EQUIPPED:
+         {
+            equipped = ItemData::getInstance()->getItem(slotRecord.readUnsigned());
+            break;
+         }
+         case SaveGameFormat::EquipSlotField::ACCEPTED_TYPES:
+         {
+            std::vector<Uint32> types;
+            slotRecord.readPacked(types);
+            acceptedTypes.assign(types.begin(), types.end());
+            break;
+         }
+         case SaveGameFormat::EquipSlotField::DISABLED:
+         {
+            enabled = !slotRecord.readBool();
+            break;
+         }
+         default:
+         {
+            slotRecord.skipField();
+         }
+      }
+   }
+}
+
+void EquipSlot::serialize(SaveGameEncoder& slotRecord) const
+{
+   if(equipped != NULL)
+   {
+      slotRecord.writeUnsigned(SaveGameFormat::EquipSlotField::EQUIPPED, equipped->getId());
+   }
+
+   if(!acceptedTypes.empty())
+   {
+      const std::vector<Uint32> types(acceptedTypes.begin(), acceptedTypes.end());
+      slotRecord.writePacked(SaveGameFormat::EquipSlotField::ACCEPTED_TYPES, &types[0], types.size());
+   }
+
+   if(!enabled)
+   {
+      slotRecord.writeBool(SaveGameFormat::EquipSlotField::DISABLED, true);
+   }
+}
+
 EquipSlot::~EquipSlot()
 {
 }
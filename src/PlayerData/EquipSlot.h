@@ -16,6 +16,8 @@ namespace Json
 };
 
 class Item;
+class SaveGameDecoder;
+class SaveGameEncoder;
 
 /**
  * An equipment slot. Can have an item equipped in it, and can have restrictions on the 
@@ -56,6 +58,20 @@ struct EquipSlot
     * @param slotNode The JSON node into which the slot information should be saved.
     */
    void serialize(Json::Value& slotNode) const;
+
+   /**
+    * Load in slot information from a binary savegame.
+    *
+    * @param slotRecord The record containing the slot information.
+    */
+   void load(SaveGameDecoder& slotRecord);
+
+   /**
+    * Serialize the slot information into a binary savegame record.
+    *
+    * @param slotRecord The record into which the slot information should be saved.
+    */
+   void serialize(SaveGameEncoder& slotRecord) const;
       
    /**
     * Destructor.
@@ -0,0 +1,298 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "FlagStore.h"
+#include "SaveGameDecoder.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
+#include "json.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PLAYER;
+
+// Returned for the string of a flag that doesn't hold one
+static const std::string NO_STRING;
+
+FlagStore::FlagStore()
+{
+}
+
+FlagStore::Key FlagStore::getKey(const std::string& name)
+{
+   std::map<std::string, Key>::iterator iter = keys.lower_bound(name);
+   if(iter != keys.end() && iter->first == name)
+   {
+      return iter->second;
+   }
+
+   const Key key = names.size();
+   keys.insert(iter, std::make_pair(name, key));
+   names.push_back(name);
+
+   Flag flag;
+   flag.type = UNSET;
+   flag.dirty = false;
+   flag.value = 0;
+   flags.push_back(flag);
+
+   return key;
+}
+
+bool FlagStore::isKey(Key key) const
+{
+   return key < flags.size();
+}
+
+const std::string& FlagStore::getName(Key key) const
+{
+   return names[key];
+}
+
+FlagStore::Type FlagStore::getType(Key key) const
+{
+   return static_cast<Type>(flags[key].type);
+}
+
+bool FlagStore::getBool(Key key) const
+{
+   const Flag& flag = flags[key];
+   return flag.type == STRING || flag.value != 0;
+}
+
+int FlagStore::getInt(Key key) const
+{
+   const Flag& flag = flags[key];
+   return flag.type == INT ? flag.value : 0;
+}
+
+const std::string& FlagStore::getString(Key key) const
+{
+   const Flag& flag = flags[key];
+   return flag.type == STRING ? stringValues[flag.value] : NO_STRING;
+}
+
+void FlagStore::markDirty(Key key)
+{
+   Flag& flag = flags[key];
+   if(!flag.dirty)
+   {
+      flag.dirty = true;
+      dirtyKeys.push_back(key);
+   }
+}
+
+void FlagStore::releaseString(Flag& flag)
+{
+   if(flag.type == STRING)
+   {
+      stringValues[flag.value].clear();
+      freeStringValues.push_back(flag.value);
+   }
+}
+
+void FlagStore::setBool(Key key, bool value)
+{
+   Flag& flag = flags[key];
+   if(flag.type == BOOL && (flag.value != 0) == value)
+   {
+      return;
+   }
+
+   releaseString(flag);
+   flag.type = BOOL;
+   flag.value = value;
+   markDirty(key);
+}
+
+void FlagStore::setInt(Key key, int value)
+{
+   Flag& flag = flags[key];
+   if(flag.type == INT && flag.value == value)
+   {
+      return;
+   }
+
+   releaseString(flag);
+   flag.type = INT;
+   flag.value = value;
+   markDirty(key);
+}
+
+void FlagStore::setString(Key key, const std::string& value)
+{
+   Flag& flag = flags[key];
+   if(flag.type == STRING)
+   {
+      if(stringValues[flag.value] == value)
+      {
+         return;
+      }
+
+      stringValues[flag.value] = value;
+   }
+   else if(!freeStringValues.empty())
+   {
+      flag.type = STRING;
+      flag.value = freeStringValues.back();
+      freeStringValues.pop_back();
+      stringValues[flag.value] = value;
+   }
+   else
+   {
+      flag.type = STRING;
+      flag.value = stringValues.size();
+      stringValues.push_back(value);
+   }
+
+   markDirty(key);
+}
+
+void FlagStore::unset(Key key)
+{
+   Flag& flag = flags[key];
+   if(flag.type == UNSET)
+   {
+      return;
+   }
+
+   releaseString(flag);
+   flag.type = UNSET;
+   flag.value = 0;
+   markDirty(key);
+}
+
+void FlagStore::assign(const FlagStore& flags)
+{
+   if(&flags == this)
+   {
+      return;
+   }
+
+   for(Key key = 0; key < this->flags.size(); ++key)
+   {
+      unset(key);
+   }
+
+   for(Key key = 0; key < flags.flags.size(); ++key)
+   {
+      switch(flags.getType(key))
+      {
+         case BOOL: setBool(getKey(flags.names[key]), flags.getBool(key)); break;
+         case INT: setInt(getKey(flags.names[key]), flags.getInt(key)); break;
+         case STRING: setString(getKey(flags.names[key]), flags.getString(key)); break;
+         default: break;
+      }
+   }
+}
+
+void FlagStore::load(Json::Value& flagsNode)
+{
+   if(!flagsNode.isObject())
+   {
+      return;
+   }
+
+   const Json::Value::Members flagNames = flagsNode.getMemberNames();
+   for(Json::Value::Members::const_iterator iter = flagNames.begin(); iter != flagNames.end(); ++iter)
+   {
+      const Json::Value& value = flagsNode[*iter];
+      const Key key = getKey(*iter);
+      if(value.isBool())
+      {
+         setBool(key, value.asBool());
+      }
+      else if(value.isInt())
+      {
+         setInt(key, value.asInt());
+      }
+      else if(value.isString())
+      {
+         setString(key, value.asString());
+      }
+      else
+      {
+         DEBUG("Flag %s has a value that flags can't hold.", iter->c_str());
+      }
+   }
+}
+
+void FlagStore::load(SaveGameDecoder& flagRecord)
+{
+   std::string name;
+   Type type = UNSET;
+   int value = 0;
+   std::string stringValue;
+
+   unsigned int tag;
+   while(flagRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::FlagField::NAME: name = flagRecord.readString(); break;
+         case SaveGameFormat::FlagField::BOOL_VALUE: type = BOOL; value = flagRecord.readBool(); break;
+         case SaveGameFormat::FlagField::INT_VALUE: type = INT; value = flagRecord.readInt(); break;
+         case SaveGameFormat::FlagField::STRING_VALUE: type = STRING; stringValue = flagRecord.readString(); break;
+         default:
+         {
+            flagRecord.skipField();
+         }
+      }
+   }
+
+   const Key key = getKey(name);
+   switch(type)
+   {
+      case BOOL: setBool(key, value != 0); break;
+      case INT: setInt(key, value); break;
+      case STRING: setString(key, stringValue); break;
+      default: unset(key);
+   }
+}
+
+void FlagStore::serialize(SaveGameEncoder& record, unsigned int tag) const
+{
+   for(Key key = 0; key < flags.size(); ++key)
+   {
+      if(flags[key].type != UNSET)
+      {
+         serializeFlag(record, tag, key);
+      }
+   }
+}
+
+void FlagStore::serializeChanges(SaveGameEncoder& record, unsigned int tag) const
+{
+   for(std::vector<Key>::const_iterator iter = dirtyKeys.begin(); iter != dirtyKeys.end(); ++iter)
+   {
+      serializeFlag(record, tag, *iter);
+   }
+}
+
+void FlagStore::serializeFlag(SaveGameEncoder& record, unsigned int tag, Key key) const
+{
+   const Flag& flag = flags[key];
+
+   SaveGameEncoder flagRecord(record);
+   flagRecord.writeString(SaveGameFormat::FlagField::NAME, names[key]);
+   switch(flag.type)
+   {
+      case BOOL: flagRecord.writeBool(SaveGameFormat::FlagField::BOOL_VALUE, flag.value != 0); break;
+      case INT: flagRecord.writeInt(SaveGameFormat::FlagField::INT_VALUE, flag.value); break;
+      case STRING: flagRecord.writeString(SaveGameFormat::FlagField::STRING_VALUE, stringValues[flag.value]); break;
+   }
+
+   record.writeMessage(tag, flagRecord);
+}
+
+void FlagStore::clearDirty()
+{
+   for(std::vector<Key>::const_iterator iter = dirtyKeys.begin(); iter != dirtyKeys.end(); ++iter)
+   {
+      flags[*iter].dirty = false;
+   }
+
+   dirtyKeys.clear();
+}
@@ -0,0 +1,211 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef FLAG_STORE_H
+#define FLAG_STORE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "SDL_stdinc.h"
+
+namespace Json
+{
+   class Value;
+};
+
+class SaveGameDecoder;
+class SaveGameEncoder;
+
+/**
+ * The game-state flags that scripts set (such as whether the player has talked to an NPC yet), saved with the player data.
+ * Each flag holds a boolean, a number or a string, or is unset.
+ *
+ * Flag names are interned: each name is given a key once, and the flag is reached through its key from then on,
+ * so scripts can look their keys up once (when they load) instead of looking the name up at every check.
+ * Keys stay valid for as long as the store does, even if the flag is unset.
+ *
+ * The store keeps track of the flags that changed since the last autosave checkpoint, so that checkpoints
+ * only have to hold those flags.
+ */
+class FlagStore
+{
+   public:
+      /** The key of a flag. */
+      typedef Uint32 Key;
+
+      /** The kinds of values that a flag can hold. */
+      enum Type
+      {
+         UNSET,
+         BOOL,
+         INT,
+         STRING
+      };
+
+   private:
+      /** The value of a flag. */
+      struct Flag
+      {
+         /** The kind of value the flag holds (a Type). */
+         Uint8 type;
+
+         /** True iff the flag changed since the dirty flags were last cleared. */
+         bool dirty;
+
+         /** The flag's boolean or number, or the index of its string in the string values. */
+         int value;
+      };
+
+      /** The key of each flag name. */
+      std::map<std::string, Key> keys;
+
+      /** The name of each flag, by key. */
+      std::vector<std::string> names;
+
+      /** The value of each flag, by key. */
+      std::vector<Flag> flags;
+
+      /** The values of the flags that hold strings, kept apart so that every other flag stays small. */
+      std::vector<std::string> stringValues;
+
+      /** The indices of the string values that no flag is using anymore. */
+      std::vector<int> freeStringValues;
+
+      /** The keys of the flags that changed since the dirty flags were last cleared. */
+      std::vector<Key> dirtyKeys;
+
+      /**
+       * Mark a flag as changed.
+       */
+      void markDirty(Key key);
+
+      /**
+       * Give up a flag's string value (if it has one), so that the flag can hold another kind of value.
+       */
+      void releaseString(Flag& flag);
+
+      /**
+       * Serialize one flag into a record as a flag record.
+       *
+       * @param record The record to add the flag to.
+       * @param tag The tag of the field to write the flag record into.
+       * @param key The key of the flag.
+       */
+      void serializeFlag(SaveGameEncoder& record, unsigned int tag, Key key) const;
+
+   public:
+      /**
+       * Constructor. The store starts out with no flags.
+       */
+      FlagStore();
+
+      /**
+       * Get the key of a flag, giving the flag a key if it doesn't have one yet.
+       *
+       * @param name The name of the flag.
+       *
+       * @return The key of the flag.
+       */
+      Key getKey(const std::string& name);
+
+      /**
+       * @return true iff the key was given out by this store.
+       */
+      bool isKey(Key key) const;
+
+      /**
+       * @return The name of a flag.
+       */
+      const std::string& getName(Key key) const;
+
+      /**
+       * @return The kind of value that a flag holds.
+       */
+      Type getType(Key key) const;
+
+      /**
+       * @return The flag's boolean value. A number flag is true iff it isn't 0, a string flag is always true
+       *         and an unset flag is false.
+       */
+      bool getBool(Key key) const;
+
+      /**
+       * @return The flag's number, or 0 if it doesn't hold a number.
+       */
+      int getInt(Key key) const;
+
+      /**
+       * @return The flag's string, or the empty string if it doesn't hold a string.
+       */
+      const std::string& getString(Key key) const;
+
+      /**
+       * Set a flag to a boolean value.
+       */
+      void setBool(Key key, bool value);
+
+      /**
+       * Set a flag to a number.
+       */
+      void setInt(Key key, int value);
+
+      /**
+       * Set a flag to a string.
+       */
+      void setString(Key key, const std::string& value);
+
+      /**
+       * Unset a flag. The flag keeps its key.
+       */
+      void unset(Key key);
+
+      /**
+       * Take on the values of another store's flags. Unlike copying the store, this keeps the keys
+       * that this store has given out, so scripts that looked up their keys in this store can keep using them.
+       *
+       * @param flags The store to take the values from.
+       */
+      void assign(const FlagStore& flags);
+
+      /**
+       * Load every flag in a JSON save game's flags node (an object holding the value of each flag by name).
+       *
+       * @param flagsNode The JSON node containing the flags.
+       */
+      void load(Json::Value& flagsNode);
+
+      /**
+       * Load a flag from a binary savegame. A record with no value unsets the flag.
+       *
+       * @param flagRecord The flag record.
+       */
+      void load(SaveGameDecoder& flagRecord);
+
+      /**
+       * Serialize every flag that is set into a binary savegame record, one flag record for each.
+       *
+       * @param record The record to add the flags to.
+       * @param tag The tag of the fields to write the flag records into.
+       */
+      void serialize(SaveGameEncoder& record, unsigned int tag) const;
+
+      /**
+       * Serialize every flag that changed since the dirty flags were last cleared (including flags that were unset)
+       * into a binary savegame record, one flag record for each.
+       *
+       * @param record The record to add the flags to.
+       * @param tag The tag of the fields to write the flag records into.
+       */
+      void serializeChanges(SaveGameEncoder& record, unsigned int tag) const;
+
+      /**
+       * Forget which flags changed, such as once the changes have been saved.
+       */
+      void clearDirty();
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Inventory.h"
+#include <cstddef>
+
+// Enough for the contents of a typical item bag, so that most games never have to grow the table
+static const size_t INITIAL_BUCKET_COUNT = 64;
+
+Inventory::Inventory() : buckets(INITIAL_BUCKET_COUNT)
+{
+}
+
+std::vector<Inventory::Slot>& Inventory::getBucket(int itemNum)
+{
+   return buckets[static_cast<unsigned int>(itemNum) & (buckets.size() - 1)];
+}
+
+const std::vector<Inventory::Slot>& Inventory::getBucket(int itemNum) const
+{
+   return buckets[static_cast<unsigned int>(itemNum) & (buckets.size() - 1)];
+}
+
+Inventory::Slot* Inventory::findSlot(int itemNum)
+{
+   std::vector<Slot>& bucket = getBucket(itemNum);
+   for(std::vector<Slot>::iterator slot = bucket.begin(); slot != bucket.end(); ++slot)
+   {
+      if(slot->itemNum == itemNum)
+      {
+         return &*slot;
+      }
+   }
+
+   return NULL;
+}
+
+const Inventory::Slot* Inventory::findSlot(int itemNum) const
+{
+   const std::vector<Slot>& bucket = getBucket(itemNum);
+   for(std::vector<Slot>::const_iterator slot = bucket.begin(); slot != bucket.end(); ++slot)
+   {
+      if(slot->itemNum == itemNum)
+      {
+         return &*slot;
+      }
+   }
+
+   return NULL;
+}
+
+void Inventory::grow()
+{
+   std::vector<std::vector<Slot> > oldBuckets(buckets.size() * 2);
+   oldBuckets.swap(buckets);
+
+   for(std::vector<std::vector<Slot> >::const_iterator bucket = oldBuckets.begin(); bucket != oldBuckets.end(); ++bucket)
+   {
+      for(std::vector<Slot>::const_iterator slot = bucket->begin(); slot != bucket->end(); ++slot)
+      {
+         getBucket(slot->itemNum).push_back(*slot);
+      }
+   }
+}
+
+bool Inventory::add(int itemNum, int quantity)
+{
+   if(quantity < 1)
+   {
+      return false;
+   }
+
+   const Slot* existingSlot = findSlot(itemNum);
+   if(existingSlot != NULL)
+   {
+      items[existingSlot->position].second += quantity;
+      return true;
+   }
+
+   Slot newSlot;
+   newSlot.itemNum = itemNum;
+   newSlot.position = items.size();
+   getBucket(itemNum).push_back(newSlot);
+   items.push_back(std::pair<int, int>(itemNum, quantity));
+
+   // Keeping at most one item per bucket on average keeps the buckets short
+   if(items.size() > buckets.size())
+   {
+      grow();
+   }
+
+   return true;
+}
+
+bool Inventory::remove(int itemNum, int quantity)
+{
+   if(quantity < 1)
+   {
+      return false;
+   }
+
+   const Slot* slot = findSlot(itemNum);
+   if(slot == NULL || items[slot->position].second < quantity)
+   {
+      return false;
+   }
+
+   const ItemList::size_type position = slot->position;
+   items[position].second -= quantity;
+   if(items[position].second == 0)
+   {
+      std::vector<Slot>& bucket = getBucket(itemNum);
+      for(std::vector<Slot>::iterator iter = bucket.begin(); iter != bucket.end(); ++iter)
+      {
+         if(iter->itemNum == itemNum)
+         {
+            // The order within a bucket doesn't matter, so the last slot fills the gap
+            *iter = bucket.back();
+            bucket.pop_back();
+            break;
+         }
+      }
+
+      // The menus list the items in the order they were picked up, so the items after this one move up to close the gap
+      items.erase(items.begin() + position);
+      for(ItemList::size_type i = position; i < items.size(); ++i)
+      {
+         --findSlot(items[i].first)->position;
+      }
+   }
+
+   return true;
+}
+
+int Inventory::getQuantity(int itemNum) const
+{
+   const Slot* slot = findSlot(itemNum);
+   return slot != NULL ? items[slot->position].second : 0;
+}
+
+const ItemList& Inventory::getItems() const
+{
+   return items;
+}
+
+void Inventory::reserve(ItemList::size_type count)
+{
+   items.reserve(count);
+}
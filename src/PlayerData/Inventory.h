@@ -0,0 +1,115 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <vector>
+#include "ItemList.h"
+
+/**
+ * The player's item bag: the items held, in the order they were first picked up, each with its quantity.
+ * Along with the list, the inventory keeps a hash table of where each item is in the list,
+ * so adding, removing and counting an item never has to search the list for it.
+ */
+class Inventory
+{
+   /** Where an item is in the list. */
+   struct Slot
+   {
+      /** The item number. */
+      int itemNum;
+
+      /** The position of the item in the list. */
+      ItemList::size_type position;
+   };
+
+   /** The items held, each with its quantity. */
+   ItemList items;
+
+   /** The buckets of the slot table. There is always a power of two of them, so that an item number can be masked down to a bucket. */
+   std::vector<std::vector<Slot> > buckets;
+
+   /**
+    * @param itemNum An item number.
+    *
+    * @return The bucket that the item's slot belongs in.
+    */
+   std::vector<Slot>& getBucket(int itemNum);
+
+   /**
+    * @param itemNum An item number.
+    *
+    * @return The bucket that the item's slot belongs in.
+    */
+   const std::vector<Slot>& getBucket(int itemNum) const;
+
+   /**
+    * @param itemNum An item number.
+    *
+    * @return The slot of the item, or NULL if the item isn't held.
+    */
+   Slot* findSlot(int itemNum);
+
+   /**
+    * @param itemNum An item number.
+    *
+    * @return The slot of the item, or NULL if the item isn't held.
+    */
+   const Slot* findSlot(int itemNum) const;
+
+   /**
+    * Spreads the slots over twice as many buckets.
+    */
+   void grow();
+
+   public:
+      /**
+       * Constructor. The inventory starts out empty.
+       */
+      Inventory();
+
+      /**
+       * Adds to the quantity of an item held.
+       *
+       * @param itemNum The item number.
+       * @param quantity The number of the item to add.
+       *
+       * @return true iff the items were added (which they aren't if the quantity isn't positive).
+       */
+      bool add(int itemNum, int quantity);
+
+      /**
+       * Takes away from the quantity of an item held. An item that runs out is taken out of the list.
+       *
+       * @param itemNum The item number.
+       * @param quantity The number of the item to remove.
+       *
+       * @return true iff the items were removed (which they aren't if fewer than that many are held).
+       */
+      bool remove(int itemNum, int quantity);
+
+      /**
+       * @param itemNum The item number.
+       *
+       * @return The quantity of the item held (0 if none are).
+       */
+      int getQuantity(int itemNum) const;
+
+      /**
+       * @return The items held, in the order they were first picked up, each with its quantity.
+       */
+      const ItemList& getItems() const;
+
+      /**
+       * Makes room for a number of items, such as before loading an inventory.
+       *
+       * @param count The number of different items that the inventory will hold.
+       */
+      void reserve(ItemList::size_type count);
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "LuaFlagStore.h"
+#include "FlagStore.h"
+
+#include "LuaWrapper.hpp"
+
+// Include the Lua libraries. Since they are written in clean C, the functions
+// need to be included in this fashion to work with the C++ code.
+extern "C"
+{
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+}
+
+/**
+ * Find the key of the flag named by a function argument. Scripts can pass either a key from flags:key(), which costs
+ * nothing to look up, or the flag's name, which is looked up (and interned) each time.
+ *
+ * @param luaVM The Lua VM making the call.
+ * @param flags The flag store.
+ * @param index The index of the argument.
+ * @param key Returns the key of the flag.
+ *
+ * @return true iff the argument names a flag.
+ */
+static bool toKey(lua_State* luaVM, FlagStore& flags, int index, FlagStore::Key& key)
+{
+   switch(lua_type(luaVM, index))
+   {
+      case LUA_TNUMBER:
+      {
+         key = lua_tointeger(luaVM, index);
+         return flags.isKey(key);
+      }
+      case LUA_TSTRING:
+      {
+         key = flags.getKey(lua_tostring(luaVM, index));
+         return true;
+      }
+      default:
+      {
+         return false;
+      }
+   }
+}
+
+static int FlagStoreL_Key(lua_State* luaVM)
+{
+   int nargs = lua_gettop(luaVM);
+
+   switch(nargs)
+   {
+      case 2:
+      {
+         FlagStore* flags = luaW_check<FlagStore>(luaVM, 1);
+         if(flags != NULL && lua_type(luaVM, 2) == LUA_TSTRING)
+         {
+            lua_pushinteger(luaVM, flags->getKey(lua_tostring(luaVM, 2)));
+            return 1;
+         }
+         break;
+      }
+   }
+
+   lua_pushnil(luaVM);
+   return 1;
+}
+
+static int FlagStoreL_Get(lua_State* luaVM)
+{
+   int nargs = lua_gettop(luaVM);
+
+   switch(nargs)
+   {
+      case 2:
+      {
+         FlagStore* flags = luaW_check<FlagStore>(luaVM, 1);
+         FlagStore::Key key;
+         if(flags != NULL && toKey(luaVM, *flags, 2, key))
+         {
+            switch(flags->getType(key))
+            {
+               case FlagStore::BOOL: lua_pushboolean(luaVM, flags->getBool(key)); return 1;
+               case FlagStore::INT: lua_pushinteger(luaVM, flags->getInt(key)); return 1;
+               case FlagStore::STRING: lua_pushstring(luaVM, flags->getString(key).c_str()); return 1;
+               default: break;
+            }
+         }
+         break;
+      }
+   }
+
+   lua_pushnil(luaVM);
+   return 1;
+}
+
+static int FlagStoreL_Set(lua_State* luaVM)
+{
+   int nargs = lua_gettop(luaVM);
+
+   switch(nargs)
+   {
+      case 2:
+      case 3:
+      {
+         FlagStore* flags = luaW_check<FlagStore>(luaVM, 1);
+         FlagStore::Key key;
+         if(flags != NULL && toKey(luaVM, *flags, 2, key))
+         {
+            switch(lua_type(luaVM, 3))
+            {
+               case LUA_TBOOLEAN: flags->setBool(key, lua_toboolean(luaVM, 3) != 0); break;
+               case LUA_TNUMBER: flags->setInt(key, lua_tointeger(luaVM, 3)); break;
+               case LUA_TSTRING: flags->setString(key, lua_tostring(luaVM, 3)); break;
+
+               // Setting a flag to nil (or leaving out the value) unsets it
+               default: flags->unset(key); break;
+            }
+         }
+         break;
+      }
+   }
+
+   return 0;
+}
+
+static luaL_reg flagStoreMetatable[] =
+{
+   { "key", FlagStoreL_Key },
+   { "get", FlagStoreL_Get },
+   { "set", FlagStoreL_Set },
+   { NULL, NULL }
+};
+
+void luaopen_FlagStore(lua_State* luaVM)
+{
+   luaW_register<FlagStore>(luaVM, "FlagStore", NULL, flagStoreMetatable, NULL, NULL);
+}
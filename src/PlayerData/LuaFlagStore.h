@@ -4,9 +4,11 @@
  *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
  */
 
-#include <list>
+#ifndef LUA_FLAG_STORE_H
+#define LUA_FLAG_STORE_H
 
-/**
- * Holds integers (frame numbers) in a list to represent a specific animation sequence.
- */
-typedef std::list<int> FrameSequence;
+struct lua_State;
+
+void luaopen_FlagStore(lua_State* luaVM);
+
+#endif
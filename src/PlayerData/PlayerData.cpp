@@ -9,8 +9,16 @@
 #include "Character.h"
 #include "ItemData.h"
 #include "Item.h"
-#include <fstream>
+#include "PlayerDataSnapshot.h"
+#include "SaveGameDecoder.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
+#include "SaveGameSummary.h"
+#include "SaveGameWriter.h"
+#include "MappedFile.h"
 #include "json.h"
+#include <algorithm>
+#include <ctime>
 
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_PLAYER;
@@ -18,7 +26,51 @@ const int debugFlag = DEBUG_PLAYER;
 // Uncomment this line to turn off encryption of savegames
 // #define DISABLE_ENCRYPTION
 
-PlayerData::PlayerData() : partyLeader(NULL), rootQuest("root")
+// Autosaves go with the other save games, so that they can be loaded from the Data menu
+static const char* const AUTOSAVE_PATH = "data/savegames/autosave.edd";
+
+/**
+ * @return The path of the quest that the quest at a path is a subquest of (empty for the top-level quest).
+ */
+static std::string getParentPath(const std::string& questPath)
+{
+   const std::string::size_type lastSeparator = questPath.rfind('/');
+   return lastSeparator == std::string::npos ? std::string() : questPath.substr(0, lastSeparator);
+}
+
+/**
+ * Serialize the items whose quantities changed between two checkpoints into a checkpoint record.
+ */
+static void serializeInventoryChanges(SaveGameEncoder& checkpointRecord, const std::map<int, int>& previous, const std::map<int, int>& current)
+{
+   std::vector<Uint32> changes;
+   for(std::map<int, int>::const_iterator iter = current.begin(); iter != current.end(); ++iter)
+   {
+      std::map<int, int>::const_iterator previousQuantity = previous.find(iter->first);
+      if(previousQuantity == previous.end() || previousQuantity->second != iter->second)
+      {
+         changes.push_back(iter->first);
+         changes.push_back(iter->second);
+      }
+   }
+
+   for(std::map<int, int>::const_iterator iter = previous.begin(); iter != previous.end(); ++iter)
+   {
+      if(current.find(iter->first) == current.end())
+      {
+         // Items that ran out are written with no quantity
+         changes.push_back(iter->first);
+         changes.push_back(0);
+      }
+   }
+
+   if(!changes.empty())
+   {
+      checkpointRecord.writePacked(SaveGameFormat::CheckpointField::INVENTORY, &changes[0], changes.size());
+   }
+}
+
+PlayerData::PlayerData() : partyLeader(NULL), rootQuest("root"), playTime(0), unrecordedPlayTime(0), checkpoint(0)
 {
 }
 
@@ -30,6 +82,75 @@ PlayerData::~PlayerData()
    }
 }
 
+void PlayerData::copyFrom(const PlayerData& playerData)
+{
+   if(&playerData == this)
+   {
+      return;
+   }
+
+   const CharacterList& characters = playerData.charactersEncountered;
+   for(CharacterList::size_type i = 0; i < characters.size(); ++i)
+   {
+      if(i < charactersEncountered.size())
+      {
+         *charactersEncountered[i] = *characters[i];
+      }
+      else
+      {
+         charactersEncountered.push_back(new Character(*characters[i]));
+      }
+   }
+
+   for(CharacterList::size_type i = characters.size(); i < charactersEncountered.size(); ++i)
+   {
+      delete charactersEncountered[i];
+   }
+
+   charactersEncountered.resize(characters.size());
+
+   party.clear();
+   for(CharacterList::const_iterator iter = playerData.party.begin(); iter != playerData.party.end(); ++iter)
+   {
+      party.push_back(getCopiedCharacter(playerData, *iter));
+   }
+
+   reserve.clear();
+   for(CharacterList::const_iterator iter = playerData.reserve.begin(); iter != playerData.reserve.end(); ++iter)
+   {
+      reserve.push_back(getCopiedCharacter(playerData, *iter));
+   }
+
+   partyLeader = getCopiedCharacter(playerData, playerData.partyLeader);
+
+   filePath = playerData.filePath;
+   inventory = playerData.inventory;
+   rootQuest = playerData.rootQuest;
+   currChapter = playerData.currChapter;
+   saveLocation = playerData.saveLocation;
+   randomStreams = playerData.randomStreams;
+   playTime = playerData.playTime;
+   unrecordedPlayTime = playerData.unrecordedPlayTime;
+   checkpoint = playerData.checkpoint;
+
+   flags.assign(playerData.flags);
+   flags.clearDirty();
+
+   autosaveLog.stop();
+}
+
+Character* PlayerData::getCopiedCharacter(const PlayerData& playerData, const Character* character) const
+{
+   if(character == NULL)
+   {
+      return NULL;
+   }
+
+   const CharacterList& characters = playerData.charactersEncountered;
+   const CharacterList::size_type index = std::find(characters.begin(), characters.end(), character) - characters.begin();
+   return charactersEncountered[index];
+}
+
 const std::string& PlayerData::getFilePath()
 {
    return filePath;
@@ -39,16 +160,28 @@ void PlayerData::load(const std::string& path)
 {
    DEBUG("Loading save file %s", path.c_str());
 
-   std::ifstream input(path.c_str());
-   if(!input)
+   // A save to this file may not have been written out yet
+   SaveGameWriter::waitForSave(path);
+
+   MappedFile saveFile;
+   saveFile.open(path);
+
+   if(SaveGameDecoder::isSaveGame(saveFile.getData(), saveFile.getSize()))
    {
-      T_T("Failed to open save game file for reading.");
+      SaveGameDecoder playerDataRecord(saveFile.getData(), saveFile.getSize());
+      parseSaveGame(playerDataRecord);
+      replayAutosaveLog(path);
+
+      // The flags were only loaded, not changed
+      flags.clearDirty();
+      filePath = path;
+      return;
    }
 
+   // Save games written before the binary format are JSON
+   Json::Reader reader;
    Json::Value jsonRoot;
-   input >> jsonRoot;
-   
-   if(jsonRoot.isNull())
+   if(!reader.parse(saveFile.getData(), saveFile.getData() + saveFile.getSize(), jsonRoot, false) || jsonRoot.isNull())
    {
       DEBUG("Unexpected root element name.");
       T_T("Failed to parse save data.");
@@ -58,10 +191,251 @@ void PlayerData::load(const std::string& path)
    parseQuestLog(jsonRoot);
    parseInventory(jsonRoot);
    parseLocation(jsonRoot);
+   parseRandomStreams(jsonRoot);
+   playTime = jsonRoot.get(PLAY_TIME_ATTRIBUTE, Json::Value(0u)).asUInt();
+   flags.load(jsonRoot[FLAGS_ELEMENT]);
+   flags.clearDirty();
    
    filePath = path;
 }
 
+void PlayerData::parseSaveGame(SaveGameDecoder& playerDataRecord)
+{
+   unsigned int tag;
+   while(playerDataRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::PlayerDataField::PARTY:
+         case SaveGameFormat::PlayerDataField::RESERVE:
+         {
+            SaveGameDecoder characterRecord = playerDataRecord.readMessage();
+            Character* currCharacter = new Character(characterRecord);
+            charactersEncountered.push_back(currCharacter);
+            (tag == SaveGameFormat::PlayerDataField::PARTY ? party : reserve).push_back(currCharacter);
+            break;
+         }
+         case SaveGameFormat::PlayerDataField::INVENTORY:
+         {
+            std::vector<Uint32> itemsHeld;
+            playerDataRecord.readPacked(itemsHeld);
+            inventory.reserve(inventory.getItems().size() + itemsHeld.size() / 2);
+            for(std::vector<Uint32>::size_type i = 0; i + 1 < itemsHeld.size(); i += 2)
+            {
+               inventory.add(itemsHeld[i], itemsHeld[i + 1]);
+            }
+            break;
+         }
+         case SaveGameFormat::PlayerDataField::QUEST_LOG:
+         {
+            SaveGameDecoder questRecord = playerDataRecord.readMessage();
+            rootQuest.load(questRecord);
+            break;
+         }
+         case SaveGameFormat::PlayerDataField::RANDOM_STREAMS:
+         {
+            SaveGameDecoder randomRecord = playerDataRecord.readMessage();
+            randomStreams.load(randomRecord);
+            break;
+         }
+         case SaveGameFormat::PlayerDataField::PLAY_TIME:
+         {
+            playTime = playerDataRecord.readUnsigned();
+            break;
+         }
+         case SaveGameFormat::PlayerDataField::CHECKPOINT:
+         {
+            checkpoint = playerDataRecord.readUnsigned();
+            break;
+         }
+         case SaveGameFormat::PlayerDataField::FLAG:
+         {
+            SaveGameDecoder flagRecord = playerDataRecord.readMessage();
+            flags.load(flagRecord);
+            break;
+         }
+         default:
+         {
+            playerDataRecord.skipField();
+         }
+      }
+   }
+
+   DEBUG("Loaded %d characters, %d kinds of items and the quest log from binary save data.",
+         static_cast<int>(charactersEncountered.size()), static_cast<int>(inventory.getItems().size()));
+}
+
+void PlayerData::replayAutosaveLog(const std::string& path)
+{
+   std::vector<std::string> checkpoints;
+   if(!AutosaveLog::read(path, checkpoint, checkpoints))
+   {
+      return;
+   }
+
+   DEBUG("Replaying %d autosave checkpoints over save game %s.", static_cast<int>(checkpoints.size()), path.c_str());
+   for(std::vector<std::string>::const_iterator iter = checkpoints.begin(); iter != checkpoints.end(); ++iter)
+   {
+      try
+      {
+         SaveGameDecoder checkpointRecord(iter->data(), iter->size());
+         parseCheckpoint(checkpointRecord);
+      }
+      catch(const Exception&)
+      {
+         // Each checkpoint builds on the ones before it, so none of the checkpoints after a corrupt one can be used
+         DEBUG("Autosave checkpoint %d is corrupt; ignoring the rest of the autosave log.", static_cast<int>(iter - checkpoints.begin()));
+         break;
+      }
+   }
+}
+
+void PlayerData::parseCheckpoint(SaveGameDecoder& checkpointRecord)
+{
+   bool charactersReplaced = false;
+
+   unsigned int tag;
+   while(checkpointRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::CheckpointField::PARTY:
+         case SaveGameFormat::CheckpointField::RESERVE:
+         {
+            if(!charactersReplaced)
+            {
+               clearCharacters();
+               charactersReplaced = true;
+            }
+
+            SaveGameDecoder characterRecord = checkpointRecord.readMessage();
+            Character* currCharacter = new Character(characterRecord);
+            charactersEncountered.push_back(currCharacter);
+            (tag == SaveGameFormat::CheckpointField::PARTY ? party : reserve).push_back(currCharacter);
+            break;
+         }
+         case SaveGameFormat::CheckpointField::INVENTORY:
+         {
+            std::vector<Uint32> itemChanges;
+            checkpointRecord.readPacked(itemChanges);
+            for(std::vector<Uint32>::size_type i = 0; i + 1 < itemChanges.size(); i += 2)
+            {
+               const int itemNum = itemChanges[i];
+               const int quantity = itemChanges[i + 1];
+               const int heldQuantity = inventory.getQuantity(itemNum);
+               if(quantity > heldQuantity)
+               {
+                  inventory.add(itemNum, quantity - heldQuantity);
+               }
+               else if(quantity < heldQuantity)
+               {
+                  inventory.remove(itemNum, heldQuantity - quantity);
+               }
+            }
+            break;
+         }
+         case SaveGameFormat::CheckpointField::QUEST_LOG:
+         {
+            SaveGameDecoder questRecord = checkpointRecord.readMessage();
+            rootQuest.load(questRecord);
+            break;
+         }
+         case SaveGameFormat::CheckpointField::RANDOM_STREAMS:
+         {
+            SaveGameDecoder randomRecord = checkpointRecord.readMessage();
+            randomStreams.load(randomRecord);
+            break;
+         }
+         case SaveGameFormat::CheckpointField::PLAY_TIME: playTime = checkpointRecord.readUnsigned(); break;
+         case SaveGameFormat::CheckpointField::REGION: saveLocation.region = checkpointRecord.readString(); break;
+         case SaveGameFormat::CheckpointField::MAP: saveLocation.map = checkpointRecord.readString(); break;
+         case SaveGameFormat::CheckpointField::COMPLETED_QUEST:
+         {
+            const std::string& questPath = checkpointRecord.readString();
+            Quest* quest = rootQuest.getQuest(questPath);
+            if(quest == NULL)
+            {
+               DEBUG("Autosave checkpoint completes quest %s, which isn't in the quest log.", questPath.c_str());
+               break;
+            }
+
+            quest->complete();
+            break;
+         }
+         case SaveGameFormat::CheckpointField::NEW_QUEST:
+         {
+            SaveGameDecoder newQuestRecord = checkpointRecord.readMessage();
+            parseNewQuest(newQuestRecord);
+            break;
+         }
+         case SaveGameFormat::CheckpointField::FLAG:
+         {
+            SaveGameDecoder flagRecord = checkpointRecord.readMessage();
+            flags.load(flagRecord);
+            break;
+         }
+         default:
+         {
+            checkpointRecord.skipField();
+         }
+      }
+   }
+}
+
+void PlayerData::parseNewQuest(SaveGameDecoder& newQuestRecord)
+{
+   std::string parentPath;
+   Quest* quest = NULL;
+
+   unsigned int tag;
+   while(newQuestRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::NewQuestField::PARENT_PATH: parentPath = newQuestRecord.readString(); break;
+         case SaveGameFormat::NewQuestField::QUEST:
+         {
+            SaveGameDecoder questRecord = newQuestRecord.readMessage();
+            delete quest;
+            quest = new Quest(questRecord);
+            break;
+         }
+         default:
+         {
+            newQuestRecord.skipField();
+         }
+      }
+   }
+
+   if(quest == NULL)
+   {
+      return;
+   }
+
+   Quest* parent = parentPath.empty() ? &rootQuest : rootQuest.getQuest(parentPath);
+   if(parent == NULL)
+   {
+      DEBUG("Autosave checkpoint adds quest %s to quest %s, which isn't in the quest log.", quest->getName().c_str(), parentPath.c_str());
+      delete quest;
+      return;
+   }
+
+   parent->addQuest(quest);
+}
+
+void PlayerData::clearCharacters()
+{
+   for(CharacterList::iterator iter = charactersEncountered.begin(); iter != charactersEncountered.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   charactersEncountered.clear();
+   party.clear();
+   reserve.clear();
+   partyLeader = NULL;
+}
+
 void PlayerData::parseCharactersAndParty(Json::Value& rootElement)
 {
    Json::Value& charactersElement = rootElement[CHARACTER_LIST_ELEMENT];
@@ -100,30 +474,6 @@ void PlayerData::parseCharactersAndParty(Json::Value& rootElement)
    }
 }
 
-void PlayerData::serializeCharactersAndParty(Json::Value& outputJson) const
-{
-   Json::Value charactersNode(Json::objectValue);
-   
-   Json::Value partyNode(Json::arrayValue);
-   for(CharacterList::const_iterator iter = party.begin(); iter != party.end(); ++iter)
-   {
-      Character* character = *iter;
-      character->serialize(partyNode);
-   }
-   
-   Json::Value reserveNode(Json::arrayValue);
-   for(CharacterList::const_iterator iter = reserve.begin(); iter != reserve.end(); ++iter)
-   {
-      Character* character = *iter;
-      character->serialize(reserveNode);
-   }
-   
-   charactersNode[PARTY_ELEMENT] = partyNode;
-   charactersNode[RESERVE_ELEMENT] = reserveNode;
-   
-   outputJson[CHARACTER_LIST_ELEMENT] = charactersNode;
-}
-
 void PlayerData::parseQuestLog(Json::Value& rootElement)
 {
    DEBUG("Loading quest log...");
@@ -131,11 +481,6 @@ void PlayerData::parseQuestLog(Json::Value& rootElement)
    rootQuest.load(questLog);
 }
 
-void PlayerData::serializeQuestLog(Json::Value& outputJson) const
-{
-   outputJson[QUEST_ELEMENT] = rootQuest.serialize();
-}
-
 void PlayerData::parseInventory(Json::Value& rootElement)
 {
    DEBUG("Loading inventory data...");
@@ -145,31 +490,10 @@ void PlayerData::parseInventory(Json::Value& rootElement)
       int itemNum, itemQuantity;
       itemNum = (*iter)[ITEM_NUM_ATTRIBUTE].asInt();
       itemQuantity = (*iter)[ITEM_QUANTITY_ATTRIBUTE].asInt();
-      inventory.push_back(std::pair<int,int>(itemNum, itemQuantity));
+      inventory.add(itemNum, itemQuantity);
    }
 }
 
-void PlayerData::serializeInventory(Json::Value& outputJson) const
-{
-   Json::Value inventoryNode(Json::arrayValue);
-   for(ItemList::const_iterator iter = inventory.begin(); iter != inventory.end(); ++iter)
-   {
-      int itemNumber = iter->first;
-      int itemQuantity = iter->second;
-      
-      if(itemQuantity > 0)
-      {
-         Json::Value itemEntry(Json::objectValue);
-         itemEntry[ITEM_NUM_ATTRIBUTE] = itemNumber;
-         itemEntry[ITEM_QUANTITY_ATTRIBUTE] = itemQuantity;
-         
-         inventoryNode.append(itemEntry);
-      }
-   }
-   
-   outputJson[INVENTORY_ELEMENT] = inventoryNode;
-}
-
 void PlayerData::parseLocation(Json::Value& rootElement)
 {
    Json::Value& location = rootElement[SAVE_STATE_ELEMENT];
@@ -191,32 +515,206 @@ void PlayerData::parseLocation(Json::Value& rootElement)
    }
 }
 
-void PlayerData::serializeLocation(Json::Value& outputJson) const
+void PlayerData::parseRandomStreams(Json::Value& rootElement)
 {
-   /**
-    * \todo Determine format for current location and then correctly serialize
-    */
+   randomStreams.load(rootElement[RANDOM_ELEMENT]);
 }
 
 void PlayerData::save(const std::string& path)
 {
-   Json::Value playerDataNode(Json::objectValue);
-   serializeCharactersAndParty(playerDataNode);
-   serializeInventory(playerDataNode);
-   serializeQuestLog(playerDataNode);
-   serializeLocation(playerDataNode);
+   DEBUG("Queueing save to file %s", path.c_str());
+   writeSave(path);
 
-   DEBUG("Saving to file %s", path.c_str());
+   // The save game's autosave log only held changes to the save game that is being replaced
+   autosaveLog.discard(path);
+   filePath = path;
+}
 
-   std::ofstream output(path.c_str());
-   if(!output)
+void PlayerData::autosave()
+{
+   CheckpointState state;
+   getCheckpointState(state);
+
+   bool appended = false;
+   if(!autosaveLog.needsCompaction(AUTOSAVE_PATH))
    {
-      T_T("Failed to open save game file for writing.");
+      SaveGameEncoder checkpointRecord;
+      serializeCheckpoint(checkpointRecord, autosaveLog.getLastState(), state);
+
+      SaveGameEncoder noSummary;
+      appended = autosaveLog.append(checkpointRecord.finish(noSummary), state);
    }
 
-   output << playerDataNode;
-   
-   filePath = path;
+   if(!appended)
+   {
+      DEBUG("Compacting autosave into save game %s", AUTOSAVE_PATH);
+      writeSave(AUTOSAVE_PATH);
+      autosaveLog.start(AUTOSAVE_PATH, checkpoint, state);
+   }
+
+   // Flags are tracked by what changed since the last autosave, since they aren't kept in the checkpoint state;
+   // a manual save doesn't clear them, so the next checkpoint still has every change since this one
+   flags.clearDirty();
+}
+
+void PlayerData::writeSave(const std::string& path)
+{
+   // Checkpoint numbers follow the clock, so that a log left by another game saved to the same file won't match
+   checkpoint = std::max(checkpoint + 1, static_cast<Uint32>(time(NULL)));
+   SaveGameWriter::write(new PlayerDataSnapshot(party, reserve, inventory.getItems(), rootQuest, randomStreams, flags, getSummary(), checkpoint), path);
+}
+
+void PlayerData::getCheckpointState(CheckpointState& state) const
+{
+   const ItemList& itemsHeld = inventory.getItems();
+   for(ItemList::const_iterator iter = itemsHeld.begin(); iter != itemsHeld.end(); ++iter)
+   {
+      state.inventory[iter->first] = iter->second;
+   }
+
+   std::map<std::string, const Quest*> quests;
+   rootQuest.getSubquestPaths(quests);
+   for(std::map<std::string, const Quest*>::const_iterator iter = quests.begin(); iter != quests.end(); ++iter)
+   {
+      QuestState& questState = state.quests.insert(state.quests.end(), std::make_pair(iter->first, QuestState()))->second;
+      questState.completed = iter->second->isCompleted();
+      questState.optional = iter->second->isOptional();
+      questState.description = iter->second->getDescription();
+   }
+
+   state.region = saveLocation.region;
+   state.map = saveLocation.map;
+   state.playTime = playTime;
+
+   SaveGameEncoder noSummary;
+
+   SaveGameEncoder charactersRecord;
+   serializeCharacters(charactersRecord);
+   state.characters = charactersRecord.finish(noSummary);
+
+   SaveGameEncoder randomRecord;
+   randomStreams.serialize(randomRecord);
+   state.randomStreams = randomRecord.finish(noSummary);
+}
+
+void PlayerData::serializeCheckpoint(SaveGameEncoder& checkpointRecord, const CheckpointState& previous, const CheckpointState& current) const
+{
+   if(current.region != previous.region || current.map != previous.map)
+   {
+      checkpointRecord.writeString(SaveGameFormat::CheckpointField::REGION, current.region);
+      checkpointRecord.writeString(SaveGameFormat::CheckpointField::MAP, current.map);
+   }
+
+   checkpointRecord.writeUnsigned(SaveGameFormat::CheckpointField::PLAY_TIME, current.playTime);
+
+   if(current.characters != previous.characters)
+   {
+      serializeCharacters(checkpointRecord);
+   }
+
+   serializeInventoryChanges(checkpointRecord, previous.inventory, current.inventory);
+   serializeQuestChanges(checkpointRecord, previous.quests, current.quests);
+   flags.serializeChanges(checkpointRecord, SaveGameFormat::CheckpointField::FLAG);
+
+   if(current.randomStreams != previous.randomStreams)
+   {
+      SaveGameEncoder randomRecord(checkpointRecord);
+      randomStreams.serialize(randomRecord);
+      checkpointRecord.writeMessage(SaveGameFormat::CheckpointField::RANDOM_STREAMS, randomRecord);
+   }
+}
+
+void PlayerData::serializeQuestChanges(SaveGameEncoder& checkpointRecord,
+      const std::map<std::string, QuestState>& previous, const std::map<std::string, QuestState>& current) const
+{
+   typedef std::map<std::string, QuestState> QuestStates;
+
+   std::vector<std::string> completedQuests;
+   std::vector<std::string> newQuests;
+   bool questLogChanged = false;
+
+   for(QuestStates::const_iterator iter = current.begin(); iter != current.end() && !questLogChanged; ++iter)
+   {
+      QuestStates::const_iterator previousState = previous.find(iter->first);
+      if(previousState == previous.end())
+      {
+         // The subquests of a new quest are written along with it
+         const std::string parentPath = getParentPath(iter->first);
+         if(parentPath.empty() || previous.find(parentPath) != previous.end())
+         {
+            newQuests.push_back(iter->first);
+         }
+      }
+      else if(previousState->second.optional != iter->second.optional || previousState->second.description != iter->second.description
+            || previousState->second.completed > iter->second.completed)
+      {
+         questLogChanged = true;
+      }
+      else if(previousState->second.completed != iter->second.completed)
+      {
+         completedQuests.push_back(iter->first);
+      }
+   }
+
+   for(QuestStates::const_iterator iter = previous.begin(); iter != previous.end() && !questLogChanged; ++iter)
+   {
+      if(current.find(iter->first) != current.end())
+      {
+         continue;
+      }
+
+      // Completing a quest takes its subquests out of the quest log; a quest that went any other way means the log changed
+      std::string ancestorPath = getParentPath(iter->first);
+      while(!ancestorPath.empty() && current.find(ancestorPath) == current.end())
+      {
+         ancestorPath = getParentPath(ancestorPath);
+      }
+
+      questLogChanged = ancestorPath.empty() || std::find(completedQuests.begin(), completedQuests.end(), ancestorPath) == completedQuests.end();
+   }
+
+   if(questLogChanged)
+   {
+      SaveGameEncoder questRecord(checkpointRecord);
+      rootQuest.serialize(questRecord);
+      checkpointRecord.writeMessage(SaveGameFormat::CheckpointField::QUEST_LOG, questRecord);
+      return;
+   }
+
+   // Completing a quest takes out its subquests, so completions go first, or they would take out new subquests too
+   for(std::vector<std::string>::const_iterator iter = completedQuests.begin(); iter != completedQuests.end(); ++iter)
+   {
+      checkpointRecord.writeString(SaveGameFormat::CheckpointField::COMPLETED_QUEST, *iter);
+   }
+
+   for(std::vector<std::string>::const_iterator iter = newQuests.begin(); iter != newQuests.end(); ++iter)
+   {
+      SaveGameEncoder newQuestRecord(checkpointRecord);
+      newQuestRecord.writeString(SaveGameFormat::NewQuestField::PARENT_PATH, getParentPath(*iter));
+
+      SaveGameEncoder questRecord(newQuestRecord);
+      rootQuest.getQuest(*iter)->serialize(questRecord);
+      newQuestRecord.writeMessage(SaveGameFormat::NewQuestField::QUEST, questRecord);
+
+      checkpointRecord.writeMessage(SaveGameFormat::CheckpointField::NEW_QUEST, newQuestRecord);
+   }
+}
+
+void PlayerData::serializeCharacters(SaveGameEncoder& record) const
+{
+   for(CharacterList::const_iterator iter = party.begin(); iter != party.end(); ++iter)
+   {
+      SaveGameEncoder characterRecord(record);
+      (*iter)->serialize(characterRecord);
+      record.writeMessage(SaveGameFormat::CheckpointField::PARTY, characterRecord);
+   }
+
+   for(CharacterList::const_iterator iter = reserve.begin(); iter != reserve.end(); ++iter)
+   {
+      SaveGameEncoder characterRecord(record);
+      (*iter)->serialize(characterRecord);
+      record.writeMessage(SaveGameFormat::CheckpointField::RESERVE, characterRecord);
+   }
 }
 
 void PlayerData::addNewCharacter(Character* newCharacter)
@@ -257,82 +755,91 @@ CharacterList PlayerData::getParty() const
 
 const ItemList& PlayerData::getInventory() const
 {
-   return inventory;
+   return inventory.getItems();
 }
 
-ItemList PlayerData::getItemsByTypes(std::vector<int> acceptedTypes) const
+const ItemList& PlayerData::getItemsByTypes(const std::vector<int>& acceptedTypes) const
 {
    /**
     * \todo This method needs to properly filter through the inventory by type,
     * This must be done once item type is loaded into the Item structure.
     */
-   return inventory;
+   return inventory.getItems();
 }
 
 bool PlayerData::addToInventory(const Item* item, int quantity)
 {
-   if(quantity < 1)
-   {
-      return false;
-   }
-   
-   int itemId = item->getId();
-   for(ItemList::iterator iter = inventory.begin(); iter != inventory.end(); ++iter)
-   {
-      if(iter->first == itemId)
-      {
-         iter->second += quantity;
-         return true;
-      }
-   }
-   
-   inventory.push_back(std::pair<int, int>(item->getId(), quantity));
-   return true;
+   return inventory.add(item->getId(), quantity);
 }
 
 bool PlayerData::removeFromInventory(const Item* item, int quantity)
 {
-   if(quantity < 1)
+   // If the item isn't in the inventory in sufficient quantity, nothing is removed
+   return inventory.remove(item->getId(), quantity);
+}
+
+int PlayerData::getItemQuantity(const Item* item) const
+{
+   return inventory.getQuantity(item->getId());
+}
+
+bool PlayerData::changeEquipment(Character* character, EquipSlot* slot, const Item* newEquipment)
+{
+   if(slot->equipped != NULL)
    {
-      return false;
+      addToInventory(slot->equipped);
    }
 
-   int itemId = item->getId();
-   for(ItemList::iterator iter = inventory.begin(); iter != inventory.end(); ++iter)
+   if(newEquipment != NULL)
    {
-      int& existingQuantity = iter->second;
-      if(iter->first == itemId)
-      {
-         if(existingQuantity >= quantity)
-         {
-            // If the item is in the inventory in sufficient quantity, remove 'quantity' items
-            // and return true.
-            existingQuantity -= quantity;
-            if(existingQuantity == 0)
-            {
-               inventory.erase(iter);
-            }
+      removeFromInventory(newEquipment);
+   }
 
-            return true;
-         }
+   // The equipment goes through the character so that the character's stats follow it
+   return character->equip(*slot, newEquipment);
+}
 
-         break;
-      }
-   }
-   
-   // If the item is not in inventory, return false.
-   return false;
+Quest* PlayerData::getRootQuest()
+{
+   return &rootQuest;
 }
 
-bool PlayerData::changeEquipment(Character* character, EquipSlot* slot, const Item* newEquipment)
+RandomStreams& PlayerData::getRandomStreams()
 {
-   addToInventory(slot->equipped);
-   removeFromInventory(newEquipment);
-   slot->equipped = newEquipment;
-   return true;
+   return randomStreams;
 }
 
-Quest* PlayerData::getRootQuest()
+FlagStore& PlayerData::getFlags()
 {
-   return &rootQuest;
+   return flags;
+}
+
+void PlayerData::setLocation(const std::string& region, const std::string& map)
+{
+   saveLocation.region = region;
+   saveLocation.map = map;
+}
+
+void PlayerData::addPlayTime(long timePassed)
+{
+   unrecordedPlayTime += timePassed;
+   playTime += unrecordedPlayTime / 1000;
+   unrecordedPlayTime %= 1000;
+}
+
+Uint32 PlayerData::getPlayTime() const
+{
+   return playTime;
+}
+
+SaveGameSummary PlayerData::getSummary() const
+{
+   std::vector<std::string> portraitPaths;
+   portraitPaths.reserve(party.size());
+   for(CharacterList::const_iterator iter = party.begin(); iter != party.end(); ++iter)
+   {
+      portraitPaths.push_back((*iter)->getPortraitPath());
+   }
+
+   return SaveGameSummary(portraitPaths, saveLocation.region, saveLocation.map, playTime);
 }
@@ -11,10 +11,17 @@
 #include <string>
 #include <vector>
 
-#include "ItemList.h"
+#include "AutosaveLog.h"
+#include "FlagStore.h"
+#include "Inventory.h"
 #include "Quest.h"
+#include "RandomStreams.h"
+#include "SDL_stdinc.h"
 
 class Character;
+class SaveGameDecoder;
+class SaveGameEncoder;
+class SaveGameSummary;
 class Item;
 struct EquipSlot;
 
@@ -67,7 +74,7 @@ class PlayerData
    Character* partyLeader;
 
    /** All the items that are in the player's item bag. Includes usables, keys, and unused equipment. */
-   ItemList inventory;
+   Inventory inventory;
 
    /** The top-level quest for the game. Contains all the quests that the player can complete. */
    Quest rootQuest;
@@ -77,18 +84,120 @@ class PlayerData
 
    /** The location of the last save point used. */
    SaveLocation saveLocation;
+
+   /** The game's random number streams, which are saved so that a loaded game draws the same numbers it would have. */
+   RandomStreams randomStreams;
+
+   /** The game-state flags set by scripts. */
+   FlagStore flags;
+
+   /** The time the game has been played for, in seconds. */
+   Uint32 playTime;
+
+   /** The time played (in milliseconds) that hasn't yet added up to a second of play time. */
+   long unrecordedPlayTime;
+
+   /** The number that ties the last save game written or loaded to its autosave log. */
+   Uint32 checkpoint;
+
+   /** The log that autosaves append their checkpoints to. */
+   AutosaveLog autosaveLog;
    
+   /**
+    * Loads all of the player data from a binary save game.
+    *
+    * @param playerDataRecord The player data record of the save game.
+    */
+   void parseSaveGame(SaveGameDecoder& playerDataRecord);
+
+   /**
+    * Applies the changes in the autosave log of a save game that has just been loaded.
+    *
+    * @param path The path of the save game.
+    */
+   void replayAutosaveLog(const std::string& path);
+
+   /**
+    * Applies the changes held in an autosave checkpoint.
+    *
+    * @param checkpointRecord The checkpoint record.
+    */
+   void parseCheckpoint(SaveGameDecoder& checkpointRecord);
+
+   /**
+    * Adds a quest from an autosave checkpoint to the quest log.
+    *
+    * @param newQuestRecord The new quest record.
+    */
+   void parseNewQuest(SaveGameDecoder& newQuestRecord);
+
+   /**
+    * Deletes every character, so that the characters can be replaced.
+    */
+   void clearCharacters();
+
+   /**
+    * Queue the whole player data to be written to a save game, under a new checkpoint number.
+    *
+    * @param path The path to save the player data to.
+    */
+   void writeSave(const std::string& path);
+
+   /**
+    * Take down what the player data looks like now, so that the next autosave checkpoint can hold only what changed.
+    *
+    * @param state Filled with the state of the player data.
+    */
+   void getCheckpointState(CheckpointState& state) const;
+
+   /**
+    * Serialize what changed between two autosave checkpoints into a checkpoint record.
+    *
+    * @param checkpointRecord The record to serialize the changes into.
+    * @param previous The state of the player data at the previous checkpoint.
+    * @param current The state of the player data now.
+    */
+   void serializeCheckpoint(SaveGameEncoder& checkpointRecord, const CheckpointState& previous, const CheckpointState& current) const;
+
+   /**
+    * Serialize the changes to the quest log into a checkpoint record. Quests that were completed or added are
+    * written on their own; if the quest log changed in any other way, the whole quest log is written.
+    *
+    * @param checkpointRecord The record to serialize the changes into.
+    * @param previous The quests at the previous checkpoint.
+    * @param current The quests now.
+    */
+   void serializeQuestChanges(SaveGameEncoder& checkpointRecord,
+         const std::map<std::string, QuestState>& previous, const std::map<std::string, QuestState>& current) const;
+
+   /**
+    * Serialize the party and reserve characters into a record.
+    *
+    * @param record The record to serialize the characters into.
+    */
+   void serializeCharacters(SaveGameEncoder& record) const;
+
+   /**
+    * Find the copy of one of another player data's characters, once its characters have been copied by copyFrom().
+    *
+    * @param playerData The player data that the characters were copied from.
+    * @param character One of its characters (or NULL).
+    *
+    * @return The copy of the character (or NULL, if the character was NULL).
+    */
+   Character* getCopiedCharacter(const PlayerData& playerData, const Character* character) const;
+
+   /** Player data owns its characters, so it can only be copied with copyFrom(). */
+   PlayerData(const PlayerData&);
+
+   /** Player data owns its characters, so it can only be copied with copyFrom(). */
+   PlayerData& operator=(const PlayerData&);
+
    void parseCharactersAndParty(Json::Value& rootElement);
-   void serializeCharactersAndParty(Json::Value& outputJson) const;
-    
    void parseQuestLog(Json::Value& rootElement);
-   void serializeQuestLog(Json::Value& outputJson) const;
-    
    void parseInventory(Json::Value& rootElement);
-   void serializeInventory(Json::Value& outputJson) const;
-    
    void parseLocation(Json::Value& rootElement);
-   void serializeLocation(Json::Value& outputJson) const;
+   void parseRandomStreams(Json::Value& rootElement);
     
    public:
       static const int PARTY_SIZE = 4;
@@ -104,18 +213,40 @@ class PlayerData
       const std::string& getFilePath();
 
       /**
-       * Load the player data from a file.
+       * Load the player data from a file, along with the changes in its autosave log if it has one.
        *
        * @param filePath The path to load the player data from.
        */
       void load(const std::string& path);
 
+      /**
+       * Replace all of the player data with a copy of another player data, without reading any files.
+       * Used to start over from a template (such as for a new game, or between scripted test runs)
+       * without loading the template's save game again each time.
+       *
+       * The Character objects that this player data already has are reused for the copies, and its flags
+       * keep their keys, so copying into the same player data over and over doesn't allocate them again.
+       * Any autosave log that was being written is left behind, so the next autosave writes the whole save game.
+       *
+       * @param playerData The player data to copy.
+       */
+      void copyFrom(const PlayerData& playerData);
+
       /**
        * Save the player data to a file and set a new default file path.
+       * Only a snapshot of the player data is taken here; it is serialized and written
+       * to the file in the background by the SaveGameWriter, so the game can carry on right away.
        *
        * @param filePath The path to save the player data to.
        */
       void save(const std::string& path);
+
+      /**
+       * Autosave the player data. Only what changed since the last autosave is appended to the autosave log,
+       * unless the log is due to be compacted, in which case the whole player data is saved.
+       * Unlike save(), this doesn't change the file path of the player data.
+       */
+      void autosave();
    
       void addNewCharacter(Character* newCharacter);
       Character* getPartyLeader() const;
@@ -123,15 +254,57 @@ class PlayerData
 
 	   CharacterList getParty() const;
 	   const ItemList& getInventory() const;
-      ItemList getItemsByTypes(std::vector<int> acceptedTypes) const;
+      const ItemList& getItemsByTypes(const std::vector<int>& acceptedTypes) const;
    
       bool addToInventory(const Item* item, int quantity = 1);
       bool removeFromInventory(const Item* item, int quantity = 1);
+
+      /**
+       * @param item An item.
+       *
+       * @return The quantity of the item in the player's item bag (0 if there are none).
+       */
+      int getItemQuantity(const Item* item) const;
    
       bool changeEquipment(Character* character, EquipSlot* slot, const Item* newEquipment);
 
       Quest* getRootQuest();
 
+      /**
+       * Set where the player is in the world, which is where the game is saved from.
+       *
+       * @param region The name of the region that the player is in.
+       * @param map The name of the map that the player is on.
+       */
+      void setLocation(const std::string& region, const std::string& map);
+
+      /**
+       * Add to the time the game has been played for.
+       *
+       * @param timePassed The time played, in milliseconds.
+       */
+      void addPlayTime(long timePassed);
+
+      /**
+       * @return The time the game has been played for, in seconds.
+       */
+      Uint32 getPlayTime() const;
+
+      /**
+       * @return The summary shown for this player data on the Load and Save screens.
+       */
+      SaveGameSummary getSummary() const;
+
+      /**
+       * @return The game's random number streams.
+       */
+      RandomStreams& getRandomStreams();
+
+      /**
+       * @return The game-state flags set by scripts.
+       */
+      FlagStore& getFlags();
+
       ~PlayerData();
 };
 
@@ -0,0 +1,98 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "PlayerDataSnapshot.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PLAYER;
+
+PlayerDataSnapshot::PlayerDataSnapshot(const std::vector<Character*>& party, const std::vector<Character*>& reserve, const ItemList& inventory,
+      const Quest& rootQuest, const RandomStreams& randomStreams, const FlagStore& flags, const SaveGameSummary& summary, Uint32 checkpoint)
+   : inventory(inventory), rootQuest(rootQuest), randomStreams(randomStreams), flags(flags), summary(summary), checkpoint(checkpoint)
+{
+   this->party.reserve(party.size());
+   for(std::vector<Character*>::const_iterator iter = party.begin(); iter != party.end(); ++iter)
+   {
+      this->party.push_back(**iter);
+   }
+
+   this->reserve.reserve(reserve.size());
+   for(std::vector<Character*>::const_iterator iter = reserve.begin(); iter != reserve.end(); ++iter)
+   {
+      this->reserve.push_back(**iter);
+   }
+}
+
+void PlayerDataSnapshot::serialize(SaveGameEncoder& playerDataRecord) const
+{
+   serializeCharactersAndParty(playerDataRecord);
+   serializeInventory(playerDataRecord);
+   serializeQuestLog(playerDataRecord);
+   serializeRandomStreams(playerDataRecord);
+   playerDataRecord.writeUnsigned(SaveGameFormat::PlayerDataField::PLAY_TIME, summary.getPlayTime());
+   playerDataRecord.writeUnsigned(SaveGameFormat::PlayerDataField::CHECKPOINT, checkpoint);
+   flags.serialize(playerDataRecord, SaveGameFormat::PlayerDataField::FLAG);
+}
+
+void PlayerDataSnapshot::serializeSummary(SaveGameEncoder& summaryRecord) const
+{
+   summary.serialize(summaryRecord);
+}
+
+void PlayerDataSnapshot::serializeCharactersAndParty(SaveGameEncoder& playerDataRecord) const
+{
+   for(std::vector<Character>::const_iterator iter = party.begin(); iter != party.end(); ++iter)
+   {
+      SaveGameEncoder characterRecord(playerDataRecord);
+      iter->serialize(characterRecord);
+      playerDataRecord.writeMessage(SaveGameFormat::PlayerDataField::PARTY, characterRecord);
+   }
+
+   for(std::vector<Character>::const_iterator iter = reserve.begin(); iter != reserve.end(); ++iter)
+   {
+      SaveGameEncoder characterRecord(playerDataRecord);
+      iter->serialize(characterRecord);
+      playerDataRecord.writeMessage(SaveGameFormat::PlayerDataField::RESERVE, characterRecord);
+   }
+}
+
+void PlayerDataSnapshot::serializeQuestLog(SaveGameEncoder& playerDataRecord) const
+{
+   SaveGameEncoder questRecord(playerDataRecord);
+   rootQuest.serialize(questRecord);
+   playerDataRecord.writeMessage(SaveGameFormat::PlayerDataField::QUEST_LOG, questRecord);
+}
+
+void PlayerDataSnapshot::serializeInventory(SaveGameEncoder& playerDataRecord) const
+{
+   std::vector<Uint32> itemsHeld;
+   itemsHeld.reserve(inventory.size() * 2);
+   for(ItemList::const_iterator iter = inventory.begin(); iter != inventory.end(); ++iter)
+   {
+      int itemNumber = iter->first;
+      int itemQuantity = iter->second;
+
+      if(itemQuantity > 0)
+      {
+         itemsHeld.push_back(itemNumber);
+         itemsHeld.push_back(itemQuantity);
+      }
+   }
+
+   if(!itemsHeld.empty())
+   {
+      playerDataRecord.writePacked(SaveGameFormat::PlayerDataField::INVENTORY, &itemsHeld[0], itemsHeld.size());
+   }
+}
+
+void PlayerDataSnapshot::serializeRandomStreams(SaveGameEncoder& playerDataRecord) const
+{
+   SaveGameEncoder randomRecord(playerDataRecord);
+   randomStreams.serialize(randomRecord);
+   playerDataRecord.writeMessage(SaveGameFormat::PlayerDataField::RANDOM_STREAMS, randomRecord);
+}
@@ -0,0 +1,89 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PLAYER_DATA_SNAPSHOT_H
+#define PLAYER_DATA_SNAPSHOT_H
+
+#include <vector>
+
+#include "Character.h"
+#include "FlagStore.h"
+#include "ItemList.h"
+#include "Quest.h"
+#include "RandomStreams.h"
+#include "SaveGameSummary.h"
+
+class SaveGameEncoder;
+
+/**
+ * A copy of everything in the player's game data that is saved, taken at the moment the game is saved.
+ * The snapshot shares nothing that the game can change afterwards (the only thing it refers to is the game's items,
+ * which never change), so once it is taken, it can be serialized and written out on another thread
+ * while the game carries on.
+ */
+class PlayerDataSnapshot
+{
+   /** The characters in the main party. */
+   std::vector<Character> party;
+
+   /** The characters who are available to switch into the party. */
+   std::vector<Character> reserve;
+
+   /** All the items that are in the player's item bag. */
+   ItemList inventory;
+
+   /** The top-level quest for the game. */
+   Quest rootQuest;
+
+   /** The game's random number streams. */
+   RandomStreams randomStreams;
+
+   /** The game-state flags set by scripts. */
+   FlagStore flags;
+
+   /** What the Load and Save screens show for the save game. */
+   SaveGameSummary summary;
+
+   /** The number that ties the save game to its autosave log. */
+   Uint32 checkpoint;
+
+   void serializeCharactersAndParty(SaveGameEncoder& playerDataRecord) const;
+   void serializeQuestLog(SaveGameEncoder& playerDataRecord) const;
+   void serializeInventory(SaveGameEncoder& playerDataRecord) const;
+   void serializeRandomStreams(SaveGameEncoder& playerDataRecord) const;
+
+   public:
+      /**
+       * Constructor. Copies the player's game data.
+       *
+       * @param party The characters in the main party.
+       * @param reserve The characters who are available to switch into the party.
+       * @param inventory The items in the player's item bag.
+       * @param rootQuest The top-level quest for the game.
+       * @param randomStreams The game's random number streams.
+       * @param flags The game-state flags set by scripts.
+       * @param summary What the Load and Save screens show for the save game.
+       * @param checkpoint The number that ties the save game to its autosave log.
+       */
+      PlayerDataSnapshot(const std::vector<Character*>& party, const std::vector<Character*>& reserve, const ItemList& inventory,
+            const Quest& rootQuest, const RandomStreams& randomStreams, const FlagStore& flags, const SaveGameSummary& summary, Uint32 checkpoint);
+
+      /**
+       * Serialize the player data into a binary save game (see SaveGameFormat.h).
+       *
+       * @param playerDataRecord The top-level record of the save game.
+       */
+      void serialize(SaveGameEncoder& playerDataRecord) const;
+
+      /**
+       * Serialize the summary of the save game into the summary record of a binary save game.
+       *
+       * @param summaryRecord The summary record of the save game.
+       */
+      void serializeSummary(SaveGameEncoder& summaryRecord) const;
+};
+
+#endif
@@ -5,32 +5,209 @@
  */
 
 #include "Quest.h"
+#include "QuestTable.h"
 #include "SaveGameItemNames.h"
+#include "SaveGameDecoder.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
 #include "json.h"
 
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_PLAYER;
 
+// Path hashes are 64-bit FNV-1a (like resource keys), worked out a character at a time,
+// so that the hash of a quest's path carries on from the hash of its parent's path
+static const Uint64 EMPTY_PATH_HASH = 14695981039346656037ULL;
+
+// The FNV-1a prime for 64-bit hashes
+static const Uint64 PATH_HASH_PRIME = 1099511628211ULL;
+
+/**
+ * @return The hash of a path, with one more character on the end.
+ */
+static Uint64 hashCharacter(Uint64 pathHash, unsigned char character)
+{
+   return (pathHash ^ character) * PATH_HASH_PRIME;
+}
+
+/**
+ * @return The hash of a path, with "/" and a relative path on the end.
+ */
+static Uint64 hashRelativePath(Uint64 pathHash, const std::string& relativePath)
+{
+   pathHash = hashCharacter(pathHash, '/');
+   for(std::string::const_iterator iter = relativePath.begin(); iter != relativePath.end(); ++iter)
+   {
+      pathHash = hashCharacter(pathHash, *iter);
+   }
+
+   return pathHash;
+}
+
 Quest::Quest(const std::string& name, const std::string& description, bool optional, bool completed)
-   : name(name), optional(optional), completed(completed)
+   : name(name), optional(optional), completed(completed), parent(NULL), pathHash(EMPTY_PATH_HASH), index(NULL)
 {
 }
 
-Quest::Quest(Json::Value& questJson)
+Quest::Quest(Json::Value& questJson) : optional(false), completed(false), parent(NULL), pathHash(EMPTY_PATH_HASH), index(NULL)
 {
    load(questJson);
 }
 
+Quest::Quest(const Quest& quest)
+   : name(quest.name), description(quest.description), optional(quest.optional), completed(quest.completed),
+     parent(NULL), pathHash(EMPTY_PATH_HASH), index(NULL)
+{
+   copySubquests(quest);
+}
+
+Quest& Quest::operator=(const Quest& quest)
+{
+   if(&quest == this)
+   {
+      return *this;
+   }
+
+   // The quest's tree changes entirely, so it is indexed again the next time a quest is looked up by path
+   dropTreeIndex();
+
+   for(QuestLog::iterator i = subquests.begin(); i != subquests.end(); ++i)
+   {
+      delete i->second;
+   }
+
+   subquests.clear();
+
+   name = quest.name;
+   description = quest.description;
+   optional = quest.optional;
+   completed = quest.completed;
+   copySubquests(quest);
+   return *this;
+}
+
+void Quest::copySubquests(const Quest& quest)
+{
+   for(QuestLog::const_iterator iter = quest.subquests.begin(); iter != quest.subquests.end(); ++iter)
+   {
+      Quest* subquest = new Quest(*iter->second);
+      subquest->parent = this;
+
+      // The subquests are copied in name order, so each one goes at the end of the log without searching it
+      subquests.insert(subquests.end(), QuestLog::value_type(iter->first, subquest));
+   }
+}
+
+Quest::Quest(SaveGameDecoder& questRecord) : optional(false), completed(false), parent(NULL), pathHash(EMPTY_PATH_HASH), index(NULL)
+{
+   load(questRecord);
+}
+
 Quest::~Quest()
 {
    for(QuestLog::iterator i  = subquests.begin(); i != subquests.end(); ++i)
    {
       delete i->second;
    }
+
+   delete index;
+}
+
+QuestTable* Quest::getTreeIndex() const
+{
+   const Quest* topLevelQuest = this;
+   while(topLevelQuest->parent != NULL)
+   {
+      topLevelQuest = topLevelQuest->parent;
+   }
+
+   return topLevelQuest->index;
+}
+
+QuestTable& Quest::buildTreeIndex() const
+{
+   const Quest* topLevelQuest = this;
+   while(topLevelQuest->parent != NULL)
+   {
+      topLevelQuest = topLevelQuest->parent;
+   }
+
+   if(topLevelQuest->index == NULL)
+   {
+      topLevelQuest->index = new QuestTable();
+      topLevelQuest->pathHash = EMPTY_PATH_HASH;
+      for(QuestLog::const_iterator iter = topLevelQuest->subquests.begin(); iter != topLevelQuest->subquests.end(); ++iter)
+      {
+         iter->second->addToIndex(*topLevelQuest->index);
+      }
+
+      DEBUG("Indexed %d quests under quest %s.", static_cast<int>(topLevelQuest->index->size()), topLevelQuest->name.c_str());
+   }
+
+   return *topLevelQuest->index;
+}
+
+void Quest::dropTreeIndex()
+{
+   Quest* topLevelQuest = this;
+   while(topLevelQuest->parent != NULL)
+   {
+      topLevelQuest = topLevelQuest->parent;
+   }
+
+   delete topLevelQuest->index;
+   topLevelQuest->index = NULL;
+}
+
+void Quest::addToIndex(QuestTable& table)
+{
+   pathHash = hashRelativePath(parent->pathHash, name);
+   table.insert(pathHash, this);
+
+   for(QuestLog::const_iterator iter = subquests.begin(); iter != subquests.end(); ++iter)
+   {
+      iter->second->addToIndex(table);
+   }
+}
+
+void Quest::removeFromIndex(QuestTable& table) const
+{
+   table.erase(pathHash, this);
+
+   for(QuestLog::const_iterator iter = subquests.begin(); iter != subquests.end(); ++iter)
+   {
+      iter->second->removeFromIndex(table);
+   }
+}
+
+bool Quest::isAtPath(const Quest* ancestor, const std::string& questPath) const
+{
+   // Match the names of this quest and its parents against the parts of the path, from the end of the path back
+   const Quest* quest = this;
+   std::string::size_type partEnd = questPath.size();
+   for(;;)
+   {
+      const std::string::size_type separator = partEnd == 0 ? std::string::npos : questPath.rfind('/', partEnd - 1);
+      const std::string::size_type partStart = separator == std::string::npos ? 0 : separator + 1;
+      if(quest == NULL || quest == ancestor || questPath.compare(partStart, partEnd - partStart, quest->name) != 0)
+      {
+         return false;
+      }
+
+      quest = quest->parent;
+      if(separator == std::string::npos)
+      {
+         return quest == ancestor;
+      }
+
+      partEnd = separator;
+   }
 }
 
 void Quest::load(Json::Value& questTree)
 {
+   dropTreeIndex();
+
    name = questTree[NAME_ATTRIBUTE].asString();
    Json::Value& descriptionElement = questTree[DESCRIPTION_ELEMENT];
    description = descriptionElement.isString() ? descriptionElement.asString() : "";
@@ -42,6 +219,7 @@ void Quest::load(Json::Value& questTree)
    for(Json::Value::iterator iter = subquestNode.begin(); iter != subquestNode.end(); ++iter)
    {
       Quest* subquest = new Quest(*iter);
+      subquest->parent = this;
       subquests[subquest->getName()] = subquest;
    }
 }
@@ -71,15 +249,117 @@ Json::Value Quest::serialize() const
    return questNode;
 }
 
+void Quest::load(SaveGameDecoder& questRecord)
+{
+   dropTreeIndex();
+
+   // The loaded subquests replace the ones from before (such as when an autosave checkpoint replaces the quest log)
+   for(QuestLog::iterator i = subquests.begin(); i != subquests.end(); ++i)
+   {
+      delete i->second;
+   }
+
+   subquests.clear();
+
+   unsigned int tag;
+   while(questRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::QuestField::NAME: name = questRecord.readString(); break;
+         case SaveGameFormat::QuestField::DESCRIPTION: description = questRecord.readString(); break;
+         case SaveGameFormat::QuestField::COMPLETED: completed = questRecord.readBool(); break;
+         case SaveGameFormat::QuestField::IS_OPTIONAL: optional = questRecord.readBool(); break;
+         case SaveGameFormat::QuestField::SUBQUEST:
+         {
+            SaveGameDecoder subquestRecord = questRecord.readMessage();
+            Quest* subquest = new Quest(subquestRecord);
+            subquest->parent = this;
+
+            // Subquests are saved in name order, so each one goes at the end of the log without searching it
+            if(subquests.insert(subquests.end(), QuestLog::value_type(subquest->name, subquest))->second != subquest)
+            {
+               DEBUG("Found quest %s twice in quest %s.", subquest->name.c_str(), name.c_str());
+               delete subquest;
+            }
+            break;
+         }
+         default:
+         {
+            questRecord.skipField();
+         }
+      }
+   }
+}
+
+void Quest::serialize(SaveGameEncoder& questRecord) const
+{
+   questRecord.writeString(SaveGameFormat::QuestField::NAME, name);
+
+   if(!description.empty())
+   {
+      questRecord.writeString(SaveGameFormat::QuestField::DESCRIPTION, description);
+   }
+
+   questRecord.writeBool(SaveGameFormat::QuestField::COMPLETED, completed);
+   questRecord.writeBool(SaveGameFormat::QuestField::IS_OPTIONAL, optional);
+
+   for(QuestLog::const_iterator iter = subquests.begin(); iter != subquests.end(); ++iter)
+   {
+      SaveGameEncoder subquestRecord(questRecord);
+      iter->second->serialize(subquestRecord);
+      questRecord.writeMessage(SaveGameFormat::QuestField::SUBQUEST, subquestRecord);
+   }
+}
+
 void Quest::addQuest(Quest* quest)
 {
    DEBUG("Adding quest %s to quest %s.", quest->name.c_str(), name.c_str());
-   subquests[quest->name] = quest;
+   QuestTable* table = getTreeIndex();
+
+   Quest*& subquest = subquests[quest->name];
+   if(table != NULL && subquest != NULL)
+   {
+      subquest->removeFromIndex(*table);
+   }
+
+   // The quest joins this quest's tree, so the index of its own tree (if it had one) is no use anymore
+   delete quest->index;
+   quest->index = NULL;
+
+   subquest = quest;
+   quest->parent = this;
+   if(table != NULL)
+   {
+      quest->addToIndex(*table);
+   }
 }
 
 Quest* Quest::getQuest(const std::string& questPath) const
 {
    DEBUG("In quest %s, looking for subquest: %s", name.c_str(), questPath.c_str());
+   QuestTable& table = buildTreeIndex();
+
+   Quest* quest = table.find(hashRelativePath(pathHash, questPath));
+   if(quest == NULL)
+   {
+      DEBUG("Failed to find subquest: %s", questPath.c_str());
+      return NULL;
+   }
+
+   if(quest->isAtPath(this, questPath))
+   {
+      DEBUG("Found quest %s in quest %s", questPath.c_str(), name.c_str());
+      return quest;
+   }
+
+   // Another quest's path has the same hash, so only the tree can tell which quest is on this path
+   DEBUG("Quest path %s has the same hash as another quest's path; searching the quest tree instead.", questPath.c_str());
+   return searchTree(questPath);
+}
+
+Quest* Quest::searchTree(const std::string& questPath) const
+{
    std::string::size_type endOfRootQuest = questPath.find_first_of("/");
    if(endOfRootQuest == std::string::npos)
    {
@@ -103,7 +383,7 @@ Quest* Quest::getQuest(const std::string& questPath) const
    std::map<std::string, Quest*>::const_iterator subquestIter = subquests.find(rootQuestName);
    if(subquestIter != subquests.end())
    {
-      return subquestIter->second->getQuest(relativeQuestPath);
+      return subquestIter->second->searchTree(relativeQuestPath);
    }
 
    // The quest tree to descend wasn't found; this quest does not exist
@@ -114,14 +394,39 @@ Quest* Quest::getQuest(const std::string& questPath) const
 void Quest::complete()
 {
    completed = true;
+
+   QuestTable* table = getTreeIndex();
+   if(table != NULL)
+   {
+      for(QuestLog::const_iterator iter = subquests.begin(); iter != subquests.end(); ++iter)
+      {
+         iter->second->removeFromIndex(*table);
+      }
+   }
+
    subquests.clear();
 }
 
+void Quest::getSubquestPaths(std::map<std::string, const Quest*>& quests, const std::string& questPath) const
+{
+   for(QuestLog::const_iterator iter = subquests.begin(); iter != subquests.end(); ++iter)
+   {
+      const std::string subquestPath = questPath.empty() ? iter->first : questPath + '/' + iter->first;
+      quests[subquestPath] = iter->second;
+      iter->second->getSubquestPaths(quests, subquestPath);
+   }
+}
+
 bool Quest::isCompleted() const
 {
    return completed;
 }
 
+bool Quest::isOptional() const
+{
+   return optional;
+}
+
 std::string Quest::getName() const
 {
    return name;
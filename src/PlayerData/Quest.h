@@ -9,12 +9,17 @@
 
 #include <string>
 #include <map>
+#include "SDL_stdinc.h"
 
 namespace Json
 {
    class Value;
 };
 
+class QuestTable;
+class SaveGameDecoder;
+class SaveGameEncoder;
+
 /**
  * A quest is a task assigned to the player to complete, and is used as a device to help move the game plot forward.
  * Quest objects track all the data needed to allow scripts (and the player) to track progress. This data includes
@@ -36,6 +41,10 @@ namespace Json
  *
  * As a result, subquests can be used to record progress through an overarching quest.
  *
+ * Scripts look quests up by path (such as "chapter1/findSword") all the time, so besides the tree, the top-level quest
+ * keeps every quest in its tree in a flat QuestTable, organized by the hash of its full path. Each quest links back
+ * to its parent quest, so that a quest found by its hash can be checked against the path that was asked for.
+ *
  * @author Noam Chitayat
  */
 class Quest
@@ -71,6 +80,74 @@ class Quest
     */
    QuestLog subquests;
 
+   /**
+    * The quest that this quest is a subquest of, or NULL for a top-level quest.
+    */
+   Quest* parent;
+
+   /**
+    * The hash of the quest's path from the top-level quest.
+    * Only kept up to date while the top-level quest has an index.
+    */
+   mutable Uint64 pathHash;
+
+   /**
+    * For a top-level quest, the index of every quest in its tree, or NULL until a quest is first looked up by path.
+    */
+   mutable QuestTable* index;
+
+   /**
+    * @return The index of the quest's tree, or NULL if it hasn't been built.
+    */
+   QuestTable* getTreeIndex() const;
+
+   /**
+    * @return The index of the quest's tree, which is built if it hasn't been already.
+    */
+   QuestTable& buildTreeIndex() const;
+
+   /**
+    * Throws away the index of the quest's tree, so that it is built again the next time it is needed.
+    */
+   void dropTreeIndex();
+
+   /**
+    * Adds the quest and its subquests to the index of its tree, working out their path hashes from their parents'.
+    *
+    * @param table The index of the quest's tree.
+    */
+   void addToIndex(QuestTable& table);
+
+   /**
+    * Removes the quest and its subquests from the index of its tree.
+    *
+    * @param table The index of the quest's tree.
+    */
+   void removeFromIndex(QuestTable& table) const;
+
+   /**
+    * @param ancestor A quest in the tree.
+    * @param questPath A "/"-delimited path from the ancestor.
+    *
+    * @return true iff this quest is the one at the path from the ancestor.
+    */
+   bool isAtPath(const Quest* ancestor, const std::string& questPath) const;
+
+   /**
+    * Recursively searches the tree for the subquest on the path specified, without using the index.
+    *
+    * @param questPath A "/"-delimited path from the quest to the requested subquest.
+    * @return The quest at the path specified by questPath, or NULL if it could not be found.
+    */
+   Quest* searchTree(const std::string& questPath) const;
+
+   /**
+    * Add copies of another quest's subquests to this quest's log.
+    *
+    * @param quest The quest whose subquests are copied.
+    */
+   void copySubquests(const Quest& quest);
+
    
    public:   
       /**
@@ -89,6 +166,28 @@ class Quest
        * @param questJson The JSON data to load from.
        */
       Quest(Json::Value& questJson);
+
+      /**
+       * Copy constructor. Copies the quest along with all of its subquests.
+       *
+       * @param quest The quest to copy.
+       */
+      Quest(const Quest& quest);
+
+      /**
+       * Replaces the quest and all of its subquests with copies of another quest and its subquests.
+       * The quest stays where it is in its own tree.
+       *
+       * @param quest The quest to copy.
+       */
+      Quest& operator=(const Quest& quest);
+
+      /**
+       * Constructor. Initializes quest by decoding a binary savegame record.
+       *
+       * @param questRecord The record to load from.
+       */
+      Quest(SaveGameDecoder& questRecord);
    
       /**
        * Destructor.
@@ -110,23 +209,50 @@ class Quest
        */
       Json::Value serialize() const;
 
+      /**
+       * Decodes a binary savegame record into the Quest.
+       *
+       * @param questRecord The record to load from.
+       */
+      void load(SaveGameDecoder& questRecord);
+
+      /**
+       * Serializes the quest and its subquests into a binary savegame record.
+       *
+       * @param questRecord The record to serialize the quest into.
+       */
+      void serialize(SaveGameEncoder& questRecord) const;
+
       /**
        * Add a subquest to this quest's log.
        */
       void addQuest(Quest* quest);
    
       /**
-       * Recursively searches for the subquest on the path specified.
+       * Finds the subquest on the path specified, using the index of the quest's tree.
        *
        * @param questPath A "/"-delimited path from the quest to the requested subquest.
        * @return The quest at the path specified by questPath, or NULL if it could not be found.
        */
       Quest* getQuest(const std::string& questPath) const;
    
+      /**
+       * List every quest in this quest's tree, not including this quest.
+       *
+       * @param quests Filled with each quest, by its "/"-delimited path (as used by getQuest).
+       * @param questPath The path of this quest, which the paths of its subquests are added to (empty by default).
+       */
+      void getSubquestPaths(std::map<std::string, const Quest*>& quests, const std::string& questPath = "") const;
+
       /**
        * @return true iff the quest has been completed.
        */
       bool isCompleted() const;
+
+      /**
+       * @return true iff the quest is optional.
+       */
+      bool isOptional() const;
    
       /**
        * Completes the quest.
@@ -0,0 +1,100 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "QuestTable.h"
+
+// Enough for the quests of a chapter or two, so that most games never have to grow the table
+static const size_t INITIAL_BUCKET_COUNT = 64;
+
+QuestTable::QuestTable() : buckets(INITIAL_BUCKET_COUNT), count(0)
+{
+}
+
+std::vector<QuestTable::Entry>& QuestTable::getBucket(Uint64 pathHash)
+{
+   return buckets[pathHash & (buckets.size() - 1)];
+}
+
+const std::vector<QuestTable::Entry>& QuestTable::getBucket(Uint64 pathHash) const
+{
+   return buckets[pathHash & (buckets.size() - 1)];
+}
+
+void QuestTable::grow()
+{
+   std::vector<std::vector<Entry> > oldBuckets(buckets.size() * 2);
+   oldBuckets.swap(buckets);
+
+   for(std::vector<std::vector<Entry> >::const_iterator bucket = oldBuckets.begin(); bucket != oldBuckets.end(); ++bucket)
+   {
+      for(std::vector<Entry>::const_iterator entry = bucket->begin(); entry != bucket->end(); ++entry)
+      {
+         getBucket(entry->pathHash).push_back(*entry);
+      }
+   }
+}
+
+Quest* QuestTable::find(Uint64 pathHash) const
+{
+   const std::vector<Entry>& bucket = getBucket(pathHash);
+   for(std::vector<Entry>::const_iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->pathHash == pathHash)
+      {
+         return entry->quest;
+      }
+   }
+
+   return NULL;
+}
+
+void QuestTable::insert(Uint64 pathHash, Quest* quest)
+{
+   std::vector<Entry>& bucket = getBucket(pathHash);
+   for(std::vector<Entry>::iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->pathHash == pathHash)
+      {
+         entry->quest = quest;
+         return;
+      }
+   }
+
+   Entry newEntry;
+   newEntry.pathHash = pathHash;
+   newEntry.quest = quest;
+   bucket.push_back(newEntry);
+
+   // Keeping at most one quest per bucket on average keeps the buckets short
+   if(++count > buckets.size())
+   {
+      grow();
+   }
+}
+
+void QuestTable::erase(Uint64 pathHash, const Quest* quest)
+{
+   std::vector<Entry>& bucket = getBucket(pathHash);
+   for(std::vector<Entry>::iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->pathHash == pathHash)
+      {
+         if(entry->quest == quest)
+         {
+            // The order within a bucket doesn't matter, so the last entry fills the gap
+            *entry = bucket.back();
+            bucket.pop_back();
+            --count;
+         }
+         return;
+      }
+   }
+}
+
+size_t QuestTable::size() const
+{
+   return count;
+}
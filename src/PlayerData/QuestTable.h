@@ -0,0 +1,93 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef QUEST_TABLE_H
+#define QUEST_TABLE_H
+
+#include <vector>
+#include "SDL_stdinc.h"
+
+class Quest;
+
+/**
+ * A flat hash table of every quest in a quest tree, organized by the hash of each quest's full path
+ * from the top-level quest. The hashes are worked out as the quests are added to the tree, so finding a quest
+ * by its path takes one look into the bucket picked out by the hash, instead of a string comparison
+ * (and a new string for each part of the path) at every level of the tree.
+ */
+class QuestTable
+{
+   /** A quest stored in the table. */
+   struct Entry
+   {
+      /** The hash of the quest's path. */
+      Uint64 pathHash;
+
+      /** The quest. */
+      Quest* quest;
+   };
+
+   /** The buckets of the table. There is always a power of two of them, so that a hash can be masked down to a bucket. */
+   std::vector<std::vector<Entry> > buckets;
+
+   /** The number of quests in the table. */
+   size_t count;
+
+   /**
+    * @param pathHash The hash of a quest path.
+    *
+    * @return The bucket that the hash belongs in.
+    */
+   std::vector<Entry>& getBucket(Uint64 pathHash);
+
+   /**
+    * @param pathHash The hash of a quest path.
+    *
+    * @return The bucket that the hash belongs in.
+    */
+   const std::vector<Entry>& getBucket(Uint64 pathHash) const;
+
+   /**
+    * Spreads the quests over twice as many buckets.
+    */
+   void grow();
+
+   public:
+      /**
+       * Constructor. The table starts out empty.
+       */
+      QuestTable();
+
+      /**
+       * @param pathHash The hash of a quest path.
+       *
+       * @return The quest whose path has the hash, or NULL if the table doesn't hold one.
+       */
+      Quest* find(Uint64 pathHash) const;
+
+      /**
+       * Adds a quest to the table, in place of any quest whose path had the same hash.
+       *
+       * @param pathHash The hash of the quest's path.
+       * @param quest The quest.
+       */
+      void insert(Uint64 pathHash, Quest* quest);
+
+      /**
+       * Removes a quest from the table, if it is still the quest stored for its path. The quest itself isn't deleted.
+       *
+       * @param pathHash The hash of the quest's path.
+       * @param quest The quest.
+       */
+      void erase(Uint64 pathHash, const Quest* quest);
+
+      /**
+       * @return The number of quests in the table.
+       */
+      size_t size() const;
+};
+
+#endif
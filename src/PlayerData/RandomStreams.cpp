@@ -0,0 +1,297 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "RandomStreams.h"
+#include "SaveGameItemNames.h"
+#include "SaveGameDecoder.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
+#include "json.h"
+#include <algorithm>
+#include <ctime>
+#include <vector>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PLAYER;
+
+const char* RandomStreams::DEFAULT_STREAM = "default";
+
+// The number of words in a stream's state, which is always saved in full
+static const int STATE_SIZE = 4;
+
+/**
+ * @param value A 32-bit value.
+ * @param shift The number of bits to rotate by.
+ *
+ * @return The value rotated left by the given number of bits.
+ */
+static inline Uint32 rotateLeft(Uint32 value, int shift)
+{
+   return (value << shift) | (value >> (32 - shift));
+}
+
+/**
+ * Steps a SplitMix32 generator, which spreads a single seed out into a well-mixed generator state.
+ *
+ * @param seed The generator's state, which is advanced.
+ *
+ * @return The next value from the generator.
+ */
+static Uint32 splitMix(Uint32& seed)
+{
+   Uint32 value = (seed += 0x9E3779B9u);
+   value = (value ^ (value >> 16)) * 0x85EBCA6Bu;
+   value = (value ^ (value >> 13)) * 0xC2B2AE35u;
+   return value ^ (value >> 16);
+}
+
+/**
+ * @param name A stream name.
+ *
+ * @return The FNV-1a hash of the name, which sets apart the streams that start from the same master seed.
+ */
+static Uint32 hashName(const std::string& name)
+{
+   Uint32 hash = 2166136261u;
+   for(std::string::const_iterator iter = name.begin(); iter != name.end(); ++iter)
+   {
+      hash = (hash ^ static_cast<unsigned char>(*iter)) * 16777619u;
+   }
+
+   return hash;
+}
+
+Uint32 RandomStreams::initialSeed = static_cast<Uint32>(time(NULL));
+
+RandomStreams::RandomStreams() : masterSeed(initialSeed)
+{
+}
+
+void RandomStreams::setInitialSeed(Uint32 seed)
+{
+   initialSeed = seed;
+}
+
+Uint32 RandomStreams::getInitialSeed()
+{
+   return initialSeed;
+}
+
+void RandomStreams::seedStream(Stream& stream, Uint32 seed)
+{
+   for(int i = 0; i < STATE_SIZE; ++i)
+   {
+      stream.state[i] = splitMix(seed);
+   }
+
+   // xoshiro can't leave the all-zero state, so it must never start in it
+   if((stream.state[0] | stream.state[1] | stream.state[2] | stream.state[3]) == 0)
+   {
+      stream.state[0] = 1;
+   }
+}
+
+Uint32 RandomStreams::nextBits(Stream& stream)
+{
+   Uint32* s = stream.state;
+   const Uint32 result = rotateLeft(s[1] * 5, 7) * 9;
+   const Uint32 t = s[1] << 9;
+
+   s[2] ^= s[0];
+   s[3] ^= s[1];
+   s[1] ^= s[2];
+   s[0] ^= s[3];
+   s[2] ^= t;
+   s[3] = rotateLeft(s[3], 11);
+
+   return result;
+}
+
+int RandomStreams::nextInt(Stream& stream, int min, int max)
+{
+   if(max <= min) return min;
+
+   // Draws below the threshold are thrown out, leaving a whole number of copies of the range to take the remainder of
+   const Uint32 range = static_cast<Uint32>(max) - static_cast<Uint32>(min);
+   const Uint32 threshold = (0u - range) % range;
+
+   Uint32 bits;
+   do
+   {
+      bits = nextBits(stream);
+   }
+   while(bits < threshold);
+
+   return static_cast<int>(static_cast<Uint32>(min) + bits % range);
+}
+
+RandomStreams::Stream& RandomStreams::getStream(const std::string& streamName)
+{
+   std::map<std::string, Stream>::iterator iter = streams.find(streamName);
+   if(iter == streams.end())
+   {
+      iter = streams.insert(std::make_pair(streamName, Stream())).first;
+      seedStream(iter->second, masterSeed ^ hashName(streamName));
+   }
+
+   return iter->second;
+}
+
+void RandomStreams::seed(Uint32 seed)
+{
+   DEBUG("Seeding random streams with %u", seed);
+   masterSeed = seed;
+   streams.clear();
+}
+
+void RandomStreams::seed(const std::string& streamName, Uint32 seed)
+{
+   seedStream(streams[streamName], seed);
+}
+
+int RandomStreams::nextInt(const std::string& streamName, int min, int max)
+{
+   return nextInt(getStream(streamName), min, max);
+}
+
+double RandomStreams::nextDouble(const std::string& streamName)
+{
+   return nextBits(getStream(streamName)) / 4294967296.0;
+}
+
+void RandomStreams::fill(const std::string& streamName, int min, int max, int* values, int count)
+{
+   Stream& stream = getStream(streamName);
+   for(int i = 0; i < count; ++i)
+   {
+      values[i] = nextInt(stream, min, max);
+   }
+}
+
+void RandomStreams::fill(const std::string& streamName, double* values, int count)
+{
+   Stream& stream = getStream(streamName);
+   for(int i = 0; i < count; ++i)
+   {
+      values[i] = nextBits(stream) / 4294967296.0;
+   }
+}
+
+void RandomStreams::load(Json::Value& randomJson)
+{
+   streams.clear();
+   if(randomJson.isNull()) return;
+
+   DEBUG("Loading random streams...");
+   masterSeed = randomJson[SEED_ATTRIBUTE].asUInt();
+
+   Json::Value& streamsNode = randomJson[STREAMS_ELEMENT];
+   const Json::Value::Members streamNames = streamsNode.getMemberNames();
+   for(Json::Value::Members::const_iterator iter = streamNames.begin(); iter != streamNames.end(); ++iter)
+   {
+      Json::Value& stateNode = streamsNode[*iter];
+      if(!stateNode.isArray() || static_cast<int>(stateNode.size()) != STATE_SIZE)
+      {
+         DEBUG("Random stream %s has an invalid state, and will start over from the seed.", iter->c_str());
+         continue;
+      }
+
+      Stream stream;
+      for(int i = 0; i < STATE_SIZE; ++i)
+      {
+         stream.state[i] = stateNode[i].asUInt();
+      }
+
+      if((stream.state[0] | stream.state[1] | stream.state[2] | stream.state[3]) != 0)
+      {
+         streams[*iter] = stream;
+      }
+   }
+}
+
+Json::Value RandomStreams::serialize() const
+{
+   Json::Value randomNode(Json::objectValue);
+   randomNode[SEED_ATTRIBUTE] = Json::Value(static_cast<Json::UInt>(masterSeed));
+
+   Json::Value streamsNode(Json::objectValue);
+   for(std::map<std::string, Stream>::const_iterator iter = streams.begin(); iter != streams.end(); ++iter)
+   {
+      Json::Value stateNode(Json::arrayValue);
+      for(int i = 0; i < STATE_SIZE; ++i)
+      {
+         stateNode.append(Json::Value(static_cast<Json::UInt>(iter->second.state[i])));
+      }
+
+      streamsNode[iter->first] = stateNode;
+   }
+
+   randomNode[STREAMS_ELEMENT] = streamsNode;
+   return randomNode;
+}
+
+void RandomStreams::load(SaveGameDecoder& randomRecord)
+{
+   streams.clear();
+
+   DEBUG("Loading random streams...");
+   unsigned int tag;
+   while(randomRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::RandomStreamsField::SEED:
+         {
+            masterSeed = randomRecord.readUnsigned();
+            break;
+         }
+         case SaveGameFormat::RandomStreamsField::STREAM:
+         {
+            SaveGameDecoder streamRecord = randomRecord.readMessage();
+            std::string streamName;
+            std::vector<Uint32> state;
+
+            unsigned int streamTag;
+            while(streamRecord.nextField(streamTag))
+            {
+               switch(streamTag)
+               {
+                  case SaveGameFormat::RandomStreamField::NAME: streamName = streamRecord.readString(); break;
+                  case SaveGameFormat::RandomStreamField::STATE: streamRecord.readPacked(state); break;
+                  default: streamRecord.skipField();
+               }
+            }
+
+            if(static_cast<int>(state.size()) != STATE_SIZE || (state[0] | state[1] | state[2] | state[3]) == 0)
+            {
+               DEBUG("Random stream %s has an invalid state, and will start over from the seed.", streamName.c_str());
+               break;
+            }
+
+            Stream& stream = streams[streamName];
+            std::copy(state.begin(), state.end(), stream.state);
+            break;
+         }
+         default:
+         {
+            randomRecord.skipField();
+         }
+      }
+   }
+}
+
+void RandomStreams::serialize(SaveGameEncoder& randomRecord) const
+{
+   randomRecord.writeUnsigned(SaveGameFormat::RandomStreamsField::SEED, masterSeed);
+
+   for(std::map<std::string, Stream>::const_iterator iter = streams.begin(); iter != streams.end(); ++iter)
+   {
+      SaveGameEncoder streamRecord(randomRecord);
+      streamRecord.writeString(SaveGameFormat::RandomStreamField::NAME, iter->first);
+      streamRecord.writePacked(SaveGameFormat::RandomStreamField::STATE, iter->second.state, STATE_SIZE);
+      randomRecord.writeMessage(SaveGameFormat::RandomStreamsField::STREAM, streamRecord);
+   }
+}
@@ -0,0 +1,186 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef RANDOM_STREAMS_H
+#define RANDOM_STREAMS_H
+
+#include "SDL_stdinc.h"
+#include <map>
+#include <string>
+
+namespace Json
+{
+   class Value;
+};
+
+class SaveGameDecoder;
+class SaveGameEncoder;
+
+/**
+ * The game's random number generator, which hands out random numbers from any number of named streams.
+ *
+ * Each stream is a separate xoshiro128** generator, so that drawing numbers for one purpose (such as where an NPC
+ * wanders to) doesn't change the numbers drawn for another (such as a battle's outcome). A stream that hasn't been
+ * seeded on its own starts from the master seed and the stream's name, so the same master seed always gives the
+ * same numbers in every stream, which lets a run of the game be played back exactly (as for performance tests).
+ *
+ * The state of every stream is saved along with the player data, so that a loaded game carries on drawing the
+ * same numbers that it would have if it had never been saved.
+ */
+class RandomStreams
+{
+   /** The state of a stream's generator. */
+   struct Stream
+   {
+      Uint32 state[4];
+   };
+
+   /** The master seed that new sets of streams start with. */
+   static Uint32 initialSeed;
+
+   /** The seed that streams start from unless they are seeded on their own. */
+   Uint32 masterSeed;
+
+   /** The streams that have been drawn from or seeded, by name. */
+   std::map<std::string, Stream> streams;
+
+   /**
+    * Seeds a stream's generator.
+    *
+    * @param stream The stream to seed.
+    * @param seed The seed.
+    */
+   static void seedStream(Stream& stream, Uint32 seed);
+
+   /**
+    * @param stream The stream to draw from.
+    *
+    * @return The next 32 random bits from the stream.
+    */
+   static Uint32 nextBits(Stream& stream);
+
+   /**
+    * @param stream The stream to draw from.
+    * @param min The smallest number that can be drawn.
+    * @param max The number above the largest number that can be drawn.
+    *
+    * @return A number from min up to (but not including) max, drawn without bias, or min if max isn't above min.
+    */
+   static int nextInt(Stream& stream, int min, int max);
+
+   /**
+    * @param streamName The name of a stream.
+    *
+    * @return The stream, which is started from the master seed if it hasn't been drawn from before.
+    */
+   Stream& getStream(const std::string& streamName);
+
+   public:
+      /** The name of the stream that numbers are drawn from when no stream is named. */
+      static const char* DEFAULT_STREAM;
+
+      /**
+       * Constructor. The master seed is the initial seed, which is taken from the current time unless it is set otherwise,
+       * so that a new game doesn't play out like the last one.
+       */
+      RandomStreams();
+
+      /**
+       * Sets the master seed that sets of streams created from now on start with,
+       * such as to play back the random numbers of a recorded session.
+       *
+       * @param seed The initial master seed.
+       */
+      static void setInitialSeed(Uint32 seed);
+
+      /**
+       * @return The master seed that sets of streams created from now on start with.
+       */
+      static Uint32 getInitialSeed();
+
+      /**
+       * Sets the master seed, and starts every stream over from it.
+       *
+       * @param seed The new master seed.
+       */
+      void seed(Uint32 seed);
+
+      /**
+       * Starts a single stream over from a seed of its own.
+       *
+       * @param streamName The name of the stream.
+       * @param seed The seed for the stream.
+       */
+      void seed(const std::string& streamName, Uint32 seed);
+
+      /**
+       * @param streamName The name of the stream to draw from.
+       * @param min The smallest number that can be drawn.
+       * @param max The number above the largest number that can be drawn.
+       *
+       * @return A number from min up to (but not including) max, or min if max isn't above min.
+       */
+      int nextInt(const std::string& streamName, int min, int max);
+
+      /**
+       * @param streamName The name of the stream to draw from.
+       *
+       * @return A number from 0 up to (but not including) 1.
+       */
+      double nextDouble(const std::string& streamName);
+
+      /**
+       * Draws many numbers from a stream at once, for systems (such as spawners) that need a batch of numbers per step.
+       *
+       * @param streamName The name of the stream to draw from.
+       * @param min The smallest number that can be drawn.
+       * @param max The number above the largest number that can be drawn.
+       * @param values The array to fill with the drawn numbers.
+       * @param count The number of numbers to draw.
+       */
+      void fill(const std::string& streamName, int min, int max, int* values, int count);
+
+      /**
+       * Draws many numbers from 0 up to (but not including) 1 from a stream at once.
+       *
+       * @param streamName The name of the stream to draw from.
+       * @param values The array to fill with the drawn numbers.
+       * @param count The number of numbers to draw.
+       */
+      void fill(const std::string& streamName, double* values, int count);
+
+      /**
+       * Restores the master seed and the stream states from saved JSON data.
+       * Streams that weren't saved start over from the master seed.
+       *
+       * @param randomJson The JSON data to load from.
+       */
+      void load(Json::Value& randomJson);
+
+      /**
+       * Serializes the master seed and the state of every stream into JSON.
+       *
+       * @return The serialized JSON for the streams.
+       */
+      Json::Value serialize() const;
+
+      /**
+       * Restores the master seed and the stream states from a binary savegame record.
+       * Streams that weren't saved start over from the master seed.
+       *
+       * @param randomRecord The record to load from.
+       */
+      void load(SaveGameDecoder& randomRecord);
+
+      /**
+       * Serializes the master seed and the state of every stream into a binary savegame record.
+       *
+       * @param randomRecord The record to serialize the streams into.
+       */
+      void serialize(SaveGameEncoder& randomRecord) const;
+};
+
+#endif
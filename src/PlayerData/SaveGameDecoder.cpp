@@ -0,0 +1,219 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "SaveGameDecoder.h"
+#include "SaveGameFormat.h"
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PLAYER;
+
+// A varint of a 32-bit number never takes more than 5 bytes
+static const int MAX_VARINT_BYTES = 5;
+
+// The summary record doesn't use the string table, so the decoders that read it look strings up in an empty one
+static const std::vector<std::string> NO_STRINGS;
+
+bool SaveGameDecoder::isSaveGame(const char* data, std::size_t size)
+{
+   return size >= sizeof(SaveGameFormat::MAGIC) && memcmp(data, SaveGameFormat::MAGIC, sizeof(SaveGameFormat::MAGIC)) == 0;
+}
+
+SaveGameDecoder SaveGameDecoder::readHeader(const char* data, std::size_t size, Uint32& version)
+{
+   if(!isSaveGame(data, size))
+   {
+      T_T("Save game file is not a binary save game.");
+   }
+
+   SaveGameDecoder header(data + sizeof(SaveGameFormat::MAGIC), data + size, &NO_STRINGS);
+   version = header.readVarint();
+   if(version > SaveGameFormat::VERSION)
+   {
+      DEBUG("Save game was written with format version %u, but only version %u can be read.", version, SaveGameFormat::VERSION);
+      T_T("Save game file was written by a later version of the game.");
+   }
+
+   return header;
+}
+
+bool SaveGameDecoder::hasSummary(const char* data, std::size_t size)
+{
+   Uint32 version;
+   readHeader(data, size, version);
+   return version >= SaveGameFormat::SUMMARY_VERSION;
+}
+
+SaveGameDecoder SaveGameDecoder::readSummary(const char* data, std::size_t size)
+{
+   Uint32 version;
+   SaveGameDecoder header = readHeader(data, size, version);
+   if(version < SaveGameFormat::SUMMARY_VERSION)
+   {
+      T_T("Save game file has no summary.");
+   }
+
+   header.wireType = SaveGameFormat::LENGTH_DELIMITED;
+   return header.readMessage();
+}
+
+SaveGameDecoder::SaveGameDecoder(const char* data, std::size_t size)
+   : position(data), end(data + size), strings(&ownStrings), wireType(SaveGameFormat::VARINT)
+{
+   Uint32 version;
+   position = readHeader(data, size, version).position;
+
+   if(version >= SaveGameFormat::SUMMARY_VERSION)
+   {
+      // The summary is only read by the Load and Save screens
+      const Uint32 summaryLength = readVarint();
+      if(summaryLength > static_cast<std::size_t>(end - position))
+      {
+         T_T("Save game file is corrupt.");
+      }
+
+      position += summaryLength;
+   }
+
+   const Uint32 stringCount = readVarint();
+   if(stringCount > static_cast<std::size_t>(end - position))
+   {
+      T_T("Save game file is corrupt.");
+   }
+
+   ownStrings.resize(stringCount);
+   for(Uint32 i = 0; i < stringCount; ++i)
+   {
+      const Uint32 length = readVarint();
+      if(length > static_cast<std::size_t>(end - position))
+      {
+         T_T("Save game file is corrupt.");
+      }
+
+      ownStrings[i].assign(position, length);
+      position += length;
+   }
+}
+
+SaveGameDecoder::SaveGameDecoder(const char* begin, const char* end, const std::vector<std::string>* strings)
+   : position(begin), end(end), strings(strings), wireType(SaveGameFormat::VARINT)
+{
+}
+
+Uint32 SaveGameDecoder::readVarint()
+{
+   Uint32 value = 0;
+   for(int byte = 0; byte < MAX_VARINT_BYTES && position != end; ++byte)
+   {
+      const unsigned char bits = static_cast<unsigned char>(*position++);
+      value |= static_cast<Uint32>(bits & 0x7F) << (7 * byte);
+      if((bits & 0x80) == 0)
+      {
+         return value;
+      }
+   }
+
+   T_T("Save game file is corrupt.");
+}
+
+void SaveGameDecoder::checkWireType(int expectedType) const
+{
+   if(wireType != expectedType)
+   {
+      T_T("Save game file is corrupt.");
+   }
+}
+
+bool SaveGameDecoder::nextField(unsigned int& tag)
+{
+   if(position == end)
+   {
+      return false;
+   }
+
+   const Uint32 key = readVarint();
+   tag = key >> SaveGameFormat::TAG_SHIFT;
+   wireType = key & ((1 << SaveGameFormat::TAG_SHIFT) - 1);
+   return true;
+}
+
+Uint32 SaveGameDecoder::readUnsigned()
+{
+   checkWireType(SaveGameFormat::VARINT);
+   return readVarint();
+}
+
+int SaveGameDecoder::readInt()
+{
+   const Uint32 bits = readUnsigned();
+   return static_cast<int>((bits >> 1) ^ (0u - (bits & 1)));
+}
+
+bool SaveGameDecoder::readBool()
+{
+   return readUnsigned() != 0;
+}
+
+const std::string& SaveGameDecoder::readString()
+{
+   const Uint32 index = readUnsigned();
+   if(index >= strings->size())
+   {
+      T_T("Save game file is corrupt.");
+   }
+
+   return (*strings)[index];
+}
+
+std::string SaveGameDecoder::readBytes()
+{
+   SaveGameDecoder bytes = readMessage();
+   return std::string(bytes.position, bytes.end);
+}
+
+void SaveGameDecoder::readPacked(std::vector<Uint32>& values)
+{
+   SaveGameDecoder packed = readMessage();
+   while(packed.position != packed.end)
+   {
+      values.push_back(packed.readVarint());
+   }
+}
+
+SaveGameDecoder SaveGameDecoder::readMessage()
+{
+   checkWireType(SaveGameFormat::LENGTH_DELIMITED);
+   const Uint32 length = readVarint();
+   if(length > static_cast<std::size_t>(end - position))
+   {
+      T_T("Save game file is corrupt.");
+   }
+
+   const char* const begin = position;
+   position += length;
+   return SaveGameDecoder(begin, position, strings);
+}
+
+void SaveGameDecoder::skipField()
+{
+   switch(wireType)
+   {
+      case SaveGameFormat::VARINT:
+      {
+         readVarint();
+         break;
+      }
+      case SaveGameFormat::LENGTH_DELIMITED:
+      {
+         readMessage();
+         break;
+      }
+      default:
+      {
+         T_T("Save game file is corrupt.");
+      }
+   }
+}
@@ -0,0 +1,158 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SAVE_GAME_DECODER_H
+#define SAVE_GAME_DECODER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "SDL_stdinc.h"
+
+/**
+ * Reads a record of a binary save game (see SaveGameFormat.h) in place, one field at a time.
+ * The top-level decoder reads the header and string table of the file, and the decoders of nested records
+ * (returned by readMessage) share its string table, so they must not outlive it.
+ *
+ * A save game that doesn't decode (such as a truncated file, or a field stored in the wrong way)
+ * throws an exception, like a save game that doesn't parse.
+ */
+class SaveGameDecoder
+{
+   /** The next byte to read. */
+   const char* position;
+
+   /** The end of the record. */
+   const char* end;
+
+   /** The string table of a top-level decoder. */
+   std::vector<std::string> ownStrings;
+
+   /** The string table that strings are looked up in. */
+   const std::vector<std::string>* strings;
+
+   /** The wire type of the field being read. */
+   int wireType;
+
+   /**
+    * Constructor for the decoder of a nested record.
+    *
+    * @param begin The start of the record.
+    * @param end The end of the record.
+    * @param strings The string table of the save game.
+    */
+   SaveGameDecoder(const char* begin, const char* end, const std::vector<std::string>* strings);
+
+   /**
+    * @return The next varint in the record.
+    */
+   Uint32 readVarint();
+
+   /**
+    * Reads the header of a save game, checking that it can be read.
+    *
+    * @param data The contents of the save game file.
+    * @param size The size of the file.
+    *
+    * @return A decoder for the rest of the file, and the format version that the file was written with.
+    */
+   static SaveGameDecoder readHeader(const char* data, std::size_t size, Uint32& version);
+
+   /**
+    * Checks that the field being read is stored in the expected way.
+    *
+    * @param expectedType The wire type that the field should have.
+    */
+   void checkWireType(int expectedType) const;
+
+   public:
+      /**
+       * @param data The contents of a file.
+       * @param size The size of the file.
+       *
+       * @return true iff the file is a binary save game (rather than a JSON one).
+       */
+      static bool isSaveGame(const char* data, std::size_t size);
+
+      /**
+       * @param data The contents of a binary save game file.
+       * @param size The size of the file.
+       *
+       * @return true iff the save game has a summary record (save games written with the first version of the format don't).
+       */
+      static bool hasSummary(const char* data, std::size_t size);
+
+      /**
+       * Reads only the header of a save game, without its string table or player data.
+       *
+       * @param data The contents of a binary save game file that has a summary record, which must outlive the decoder.
+       * @param size The size of the file.
+       *
+       * @return A decoder for the summary record of the save game.
+       */
+      static SaveGameDecoder readSummary(const char* data, std::size_t size);
+
+      /**
+       * Constructor for a top-level decoder. Reads the header and the string table of a save game, skipping its summary.
+       *
+       * @param data The contents of the save game file, which must outlive the decoder.
+       * @param size The size of the file.
+       */
+      SaveGameDecoder(const char* data, std::size_t size);
+
+      /**
+       * Moves on to the next field of the record.
+       *
+       * @param tag Set to the tag of the field.
+       *
+       * @return true iff there was another field in the record.
+       */
+      bool nextField(unsigned int& tag);
+
+      /**
+       * @return The value of the current field, as an unsigned number.
+       */
+      Uint32 readUnsigned();
+
+      /**
+       * @return The value of the current field, as a signed number.
+       */
+      int readInt();
+
+      /**
+       * @return The value of the current field, as a boolean.
+       */
+      bool readBool();
+
+      /**
+       * @return The value of the current field, as a string.
+       */
+      const std::string& readString();
+
+      /**
+       * @return The value of the current field, as a string whose characters are stored in the field (see SaveGameEncoder::writeBytes).
+       */
+      std::string readBytes();
+
+      /**
+       * Reads the value of the current field as a packed list of unsigned numbers.
+       *
+       * @param values The numbers are added to the back of this list.
+       */
+      void readPacked(std::vector<Uint32>& values);
+
+      /**
+       * @return A decoder for the nested record held by the current field.
+       */
+      SaveGameDecoder readMessage();
+
+      /**
+       * Skips the value of the current field, such as for a field that isn't known.
+       */
+      void skipField();
+};
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PLAYER;
+
+SaveGameEncoder::SaveGameEncoder() : strings(&ownStrings)
+{
+}
+
+SaveGameEncoder::SaveGameEncoder(SaveGameEncoder& parent) : strings(parent.strings)
+{
+}
+
+void SaveGameEncoder::appendVarint(std::string& output, Uint32 value)
+{
+   while(value >= 0x80)
+   {
+      output += static_cast<char>((value & 0x7F) | 0x80);
+      value >>= 7;
+   }
+
+   output += static_cast<char>(value);
+}
+
+void SaveGameEncoder::writeKey(unsigned int tag, int wireType)
+{
+   appendVarint(fields, (tag << SaveGameFormat::TAG_SHIFT) | wireType);
+}
+
+void SaveGameEncoder::writeUnsigned(unsigned int tag, Uint32 value)
+{
+   writeKey(tag, SaveGameFormat::VARINT);
+   appendVarint(fields, value);
+}
+
+void SaveGameEncoder::writeInt(unsigned int tag, int value)
+{
+   const Uint32 bits = static_cast<Uint32>(value);
+   writeUnsigned(tag, (bits << 1) ^ (value < 0 ? 0xFFFFFFFFu : 0));
+}
+
+void SaveGameEncoder::writeBool(unsigned int tag, bool value)
+{
+   writeUnsigned(tag, value ? 1 : 0);
+}
+
+void SaveGameEncoder::writeString(unsigned int tag, const std::string& value)
+{
+   std::map<std::string, Uint32>::iterator entry = strings->indices.find(value);
+   if(entry == strings->indices.end())
+   {
+      entry = strings->indices.insert(std::make_pair(value, static_cast<Uint32>(strings->strings.size()))).first;
+      strings->strings.push_back(&entry->first);
+   }
+
+   writeUnsigned(tag, entry->second);
+}
+
+void SaveGameEncoder::writeBytes(unsigned int tag, const std::string& value)
+{
+   writeKey(tag, SaveGameFormat::LENGTH_DELIMITED);
+   appendVarint(fields, value.size());
+   fields += value;
+}
+
+void SaveGameEncoder::writePacked(unsigned int tag, const Uint32* values, std::size_t count)
+{
+   std::string packed;
+   for(std::size_t i = 0; i < count; ++i)
+   {
+      appendVarint(packed, values[i]);
+   }
+
+   writeKey(tag, SaveGameFormat::LENGTH_DELIMITED);
+   appendVarint(fields, packed.size());
+   fields += packed;
+}
+
+void SaveGameEncoder::writeMessage(unsigned int tag, const SaveGameEncoder& message)
+{
+   writeKey(tag, SaveGameFormat::LENGTH_DELIMITED);
+   appendVarint(fields, message.fields.size());
+   fields += message.fields;
+}
+
+std::string SaveGameEncoder::finish(const SaveGameEncoder& summaryRecord) const
+{
+   std::string output(SaveGameFormat::MAGIC, sizeof(SaveGameFormat::MAGIC));
+   appendVarint(output, SaveGameFormat::VERSION);
+
+   appendVarint(output, summaryRecord.fields.size());
+   output += summaryRecord.fields;
+
+   appendVarint(output, strings->strings.size());
+   for(std::vector<const std::string*>::const_iterator iter = strings->strings.begin(); iter != strings->strings.end(); ++iter)
+   {
+      appendVarint(output, (*iter)->size());
+      output += **iter;
+   }
+
+   DEBUG("Encoded save game with %d strings and %d bytes of fields", static_cast<int>(strings->strings.size()), static_cast<int>(fields.size()));
+
+   output += fields;
+   return output;
+}
@@ -0,0 +1,127 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SAVE_GAME_ENCODER_H
+#define SAVE_GAME_ENCODER_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+#include "SDL_stdinc.h"
+
+/**
+ * Writes a record of a binary save game (see SaveGameFormat.h).
+ * The player data is written into a top-level encoder, and each nested record is written into an encoder of its own
+ * (made from the encoder of the record that holds it) before being added to its parent as a field.
+ * Every encoder made from the same top-level encoder shares its string table.
+ */
+class SaveGameEncoder
+{
+   /** The strings of a save game, each stored once. */
+   struct StringTable
+   {
+      /** The index of each string in the table. */
+      std::map<std::string, Uint32> indices;
+
+      /** The strings in the order they were added (pointing into the keys of the indices). */
+      std::vector<const std::string*> strings;
+   };
+
+   /** The string table of a top-level encoder. */
+   StringTable ownStrings;
+
+   /** The string table that this encoder adds its strings to. */
+   StringTable* strings;
+
+   /** The encoded fields of the record. */
+   std::string fields;
+
+   /**
+    * Appends a varint.
+    *
+    * @param output The bytes to append to.
+    * @param value The number to append.
+    */
+   static void appendVarint(std::string& output, Uint32 value);
+
+   /**
+    * Appends the key of a field to the record.
+    *
+    * @param tag The field's tag.
+    * @param wireType The way that the field's value is stored.
+    */
+   void writeKey(unsigned int tag, int wireType);
+
+   SaveGameEncoder(const SaveGameEncoder&);
+   SaveGameEncoder& operator=(const SaveGameEncoder&);
+
+   public:
+      /**
+       * Constructor for a top-level encoder, with a string table of its own.
+       */
+      SaveGameEncoder();
+
+      /**
+       * Constructor for the encoder of a nested record.
+       *
+       * @param parent The encoder of the record that will hold this one, whose string table is shared.
+       */
+      SaveGameEncoder(SaveGameEncoder& parent);
+
+      /**
+       * Adds an unsigned number field.
+       */
+      void writeUnsigned(unsigned int tag, Uint32 value);
+
+      /**
+       * Adds a signed number field.
+       */
+      void writeInt(unsigned int tag, int value);
+
+      /**
+       * Adds a boolean field.
+       */
+      void writeBool(unsigned int tag, bool value);
+
+      /**
+       * Adds a string field, storing the string in the string table if it isn't there yet.
+       */
+      void writeString(unsigned int tag, const std::string& value);
+
+      /**
+       * Adds a string field holding the characters of the string, rather than its index in the string table.
+       * Used for the summary record, which is read without the string table.
+       */
+      void writeBytes(unsigned int tag, const std::string& value);
+
+      /**
+       * Adds a packed list of unsigned numbers as one field.
+       *
+       * @param tag The field's tag.
+       * @param values The numbers.
+       * @param count The number of numbers.
+       */
+      void writePacked(unsigned int tag, const Uint32* values, std::size_t count);
+
+      /**
+       * Adds a nested record as a field.
+       *
+       * @param tag The field's tag.
+       * @param message The encoder that the nested record was written into.
+       */
+      void writeMessage(unsigned int tag, const SaveGameEncoder& message);
+
+      /**
+       * @param summaryRecord The encoder that the summary record was written into.
+       *
+       * @return The whole save game file: the header, the summary record, the string table,
+       *         and the record written into this (top-level) encoder.
+       */
+      std::string finish(const SaveGameEncoder& summaryRecord) const;
+};
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SAVE_GAME_FORMAT_H
+#define SAVE_GAME_FORMAT_H
+
+#include "SDL_stdinc.h"
+
+/**
+ * The layout of binary save game (.edd) files, which are written by SaveGameEncoder and read by SaveGameDecoder.
+ * Save games written before this format are JSON, and are still loaded as JSON.
+ *
+ * Every number in the file is a varint: 7 bits at a time, least significant bits first,
+ * with the top bit of each byte set on every byte but the last. Signed numbers are zigzag encoded first
+ * (0, -1, 1, -2... become 0, 1, 2, 3...), so that small negative numbers stay small too. The file is laid out as:
+ *
+ * - The characters in MAGIC, then the format version.
+ * - The length of the summary record, then the summary record (since version 2). The summary holds what the
+ *   Load and Save screens show for the save, and comes before everything else so that it can be read without
+ *   reading the rest of the file. It doesn't use the string table; its strings are stored in LENGTH_DELIMITED fields.
+ * - The string table: the number of strings, then the length and characters of each string.
+ *   Every string in the save (names, descriptions, paths) is stored here once, and referred to by its index.
+ * - The player data record, which runs to the end of the file.
+ *
+ * A record is a list of fields, each made of a key (the field's tag shifted left by 3, combined with its wire type)
+ * and a value. A VARINT field's value is one varint (strings are varints too, holding their indices in the string table),
+ * and a LENGTH_DELIMITED field's value is a length followed by that many bytes, which hold a nested record,
+ * a packed list of varints, or (in the summary record) the characters of a string. A field can appear more than once in a record to hold a list of values.
+ *
+ * Fields whose tags aren't known are skipped, so new fields can be added to the format (with new tags)
+ * without changing its version; the version only changes if the meaning of an existing field does.
+ *
+ * A save game can have an autosave log (see AutosaveLog.h) next to it, holding the changes made to the player data
+ * since the save game was written. The log is laid out as:
+ *
+ * - The characters in LOG_MAGIC, then the log format version and the checkpoint number of the save game that
+ *   the log was started on, each as a 32-bit little-endian number. A log whose checkpoint number doesn't match
+ *   the save game's belongs to an older save game, and is ignored.
+ * - The checkpoints, each made of its length (a 32-bit little-endian number) followed by a binary save game
+ *   whose player data record is a checkpoint record: it holds only what changed since the checkpoint before it.
+ *   A checkpoint that runs past the end of the log was cut off while it was being written, and is ignored.
+ */
+namespace SaveGameFormat
+{
+   /** The characters that every binary save game file starts with. */
+   static const char MAGIC[4] = { 'E', 'D', 'D', '\0' };
+
+   /** The version of the format; files written with a later version can't be loaded. */
+   static const Uint32 VERSION = 2;
+
+   /** The first version of the format whose files have a summary record. */
+   static const Uint32 SUMMARY_VERSION = 2;
+
+   /** The characters that every autosave log starts with. */
+   static const char LOG_MAGIC[4] = { 'E', 'D', 'A', '\0' };
+
+   /** The version of the autosave log format; logs written with any other version are ignored. */
+   static const Uint32 LOG_VERSION = 1;
+
+   /** The number of bits that a field's tag is shifted left by in its key, to make room for the wire type. */
+   static const int TAG_SHIFT = 3;
+
+   /** The ways in which a field's value can be stored. */
+   enum WireType
+   {
+      VARINT = 0,
+      LENGTH_DELIMITED = 2
+   };
+
+   /** The fields of the player data record. */
+   namespace PlayerDataField
+   {
+      enum
+      {
+         /** A character in the party (a Character record). */
+         PARTY = 1,
+
+         /** A character in the reserve (a Character record). */
+         RESERVE = 2,
+
+         /** The item bag, as a packed list of item numbers, each followed by its quantity. */
+         INVENTORY = 3,
+
+         /** The top-level quest (a Quest record). */
+         QUEST_LOG = 4,
+
+         /** The random number streams (a RandomStreams record). */
+         RANDOM_STREAMS = 5,
+
+         /** The time the game has been played for, in seconds. */
+         PLAY_TIME = 6,
+
+         /** The number that ties the save game to its autosave log. */
+         CHECKPOINT = 7,
+
+         /** A game-state flag that is set (a Flag record). Appears once for each flag. */
+         FLAG = 8
+      };
+   };
+
+   /**
+    * The fields of a checkpoint record in an autosave log. Only the fields for what changed are written,
+    * and they are applied in the order they appear.
+    */
+   namespace CheckpointField
+   {
+      enum
+      {
+         /**
+          * A character in the party (a Character record). If any character changed, every character
+          * in the party and the reserve is written, replacing the characters from before.
+          */
+         PARTY = 1,
+
+         /** A character in the reserve (a Character record). Only written along with the party. */
+         RESERVE = 2,
+
+         /** The items whose quantities changed, as a packed list of item numbers, each followed by its new quantity. */
+         INVENTORY = 3,
+
+         /** The whole top-level quest (a Quest record), if the quest log changed in a way that the other quest fields can't hold. */
+         QUEST_LOG = 4,
+
+         /** The random number streams (a RandomStreams record). */
+         RANDOM_STREAMS = 5,
+
+         /** The time the game has been played for, in seconds. */
+         PLAY_TIME = 6,
+
+         REGION = 7,
+         MAP = 8,
+
+         /** The path of a quest that was completed. Written before any NEW_QUEST fields. */
+         COMPLETED_QUEST = 9,
+
+         /** A quest that was added to the quest log (a NewQuest record). */
+         NEW_QUEST = 10,
+
+         /** A game-state flag that changed (a Flag record, with no value if the flag was unset). */
+         FLAG = 11
+      };
+   };
+
+   /** The fields of a new quest record in a checkpoint. */
+   namespace NewQuestField
+   {
+      enum
+      {
+         /** The path of the quest that the new quest was added to (empty for the top-level quest). */
+         PARENT_PATH = 1,
+
+         /** The new quest (a Quest record). */
+         QUEST = 2
+      };
+   };
+
+   /** The fields of a game-state flag record. A flag record holds at most one of the value fields. */
+   namespace FlagField
+   {
+      enum
+      {
+         NAME = 1,
+         BOOL_VALUE = 2,
+         INT_VALUE = 3,
+         STRING_VALUE = 4
+      };
+   };
+
+   /** The fields of the summary record. */
+   namespace SummaryField
+   {
+      enum
+      {
+         /** The portrait of a character in the party. Appears once for each character, in party order. */
+         PORTRAIT_PATH = 1,
+
+         REGION = 2,
+         MAP = 3,
+
+         /** The time the game has been played for, in seconds. */
+         PLAY_TIME = 4
+      };
+   };
+
+   /** The fields of a character record. */
+   namespace CharacterField
+   {
+      enum
+      {
+         NAME = 1,
+         HP = 2,
+         SP = 3,
+         MAX_HP = 4,
+         MAX_SP = 5,
+         STRENGTH = 6,
+         INTELLIGENCE = 7,
+
+         /** The character's equipment (an Equipment record). */
+         EQUIPMENT = 8,
+
+         PORTRAIT_PATH = 9
+      };
+   };
+
+   /** The fields of an equipment record, each of which is an EquipSlot record. */
+   namespace EquipmentField
+   {
+      enum
+      {
+         HEAD = 1,
+         BODY = 2,
+         PRIMARY_WEAPON = 3,
+         PRIMARY_OFFHAND = 4,
+         SECONDARY_WEAPON = 5,
+         SECONDARY_OFFHAND = 6,
+         GARMENT = 7,
+         FEET = 8,
+
+         /** An accessory slot. Appears once for each accessory slot, in order. */
+         ACCESSORY = 9
+      };
+   };
+
+   /** The fields of an equipment slot record. */
+   namespace EquipSlotField
+   {
+      enum
+      {
+         /** The item number of the equipped item, if there is one. */
+         EQUIPPED = 1,
+
+         /** The accepted item types, as a packed list. */
+         ACCEPTED_TYPES = 2,
+
+         /** Present (and true) iff the slot is disabled. */
+         DISABLED = 3
+      };
+   };
+
+   /** The fields of a quest record. */
+   namespace QuestField
+   {
+      enum
+      {
+         NAME = 1,
+         DESCRIPTION = 2,
+         COMPLETED = 3,
+         // Not OPTIONAL, which windows.h defines as a macro
+         IS_OPTIONAL = 4,
+
+         /** A subquest (a Quest record). */
+         SUBQUEST = 5
+      };
+   };
+
+   /** The fields of a random number streams record. */
+   namespace RandomStreamsField
+   {
+      enum
+      {
+         SEED = 1,
+
+         /** A stream that has been drawn from or seeded (a RandomStream record). */
+         STREAM = 2
+      };
+   };
+
+   /** The fields of a random number stream record. */
+   namespace RandomStreamField
+   {
+      enum
+      {
+         NAME = 1,
+
+         /** The words of the stream's generator state, as a packed list. */
+         STATE = 2
+      };
+   };
+};
+
+#endif
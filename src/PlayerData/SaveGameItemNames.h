@@ -43,4 +43,12 @@ static const char* MAP_ATTRIBUTE = "map";
 static const char* X_ATTRIBUTE = "x";
 static const char* Y_ATTRIBUTE = "y";
 
+static const char* PLAY_TIME_ATTRIBUTE = "playTime";
+
+static const char* FLAGS_ELEMENT = "Flags";
+
+static const char* RANDOM_ELEMENT = "Random";
+static const char* SEED_ATTRIBUTE = "seed";
+static const char* STREAMS_ELEMENT = "Streams";
+
 #endif
@@ -0,0 +1,133 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "SaveGameSummary.h"
+#include "PlayerData.h"
+#include "SaveGameDecoder.h"
+#include "SaveGameEncoder.h"
+#include "SaveGameFormat.h"
+#include "SaveGameWriter.h"
+#include "MappedFile.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PLAYER;
+
+SaveGameSummary::SaveGameSummary() : playTime(0)
+{
+}
+
+SaveGameSummary::SaveGameSummary(const std::vector<std::string>& portraitPaths, const std::string& region, const std::string& map, Uint32 playTime)
+   : portraitPaths(portraitPaths), region(region), map(map), playTime(playTime)
+{
+}
+
+void SaveGameSummary::load(const std::string& path)
+{
+   // A save to this file may not have been written out yet
+   SaveGameWriter::waitForSave(path);
+
+   MappedFile saveFile;
+   saveFile.open(path);
+
+   if(SaveGameDecoder::isSaveGame(saveFile.getData(), saveFile.getSize())
+         && SaveGameDecoder::hasSummary(saveFile.getData(), saveFile.getSize()))
+   {
+      // Only the pages of the file that hold the summary are ever read in
+      SaveGameDecoder summaryRecord = SaveGameDecoder::readSummary(saveFile.getData(), saveFile.getSize());
+      parse(summaryRecord);
+   }
+   else
+   {
+      DEBUG("Save game %s has no summary; loading the whole save game to summarize it.", path.c_str());
+      saveFile.close();
+
+      PlayerData playerData;
+      playerData.load(path);
+      *this = playerData.getSummary();
+   }
+
+   filePath = path;
+}
+
+void SaveGameSummary::parse(SaveGameDecoder& summaryRecord)
+{
+   unsigned int tag;
+   while(summaryRecord.nextField(tag))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::SummaryField::PORTRAIT_PATH:
+         {
+            portraitPaths.push_back(summaryRecord.readBytes());
+            break;
+         }
+         case SaveGameFormat::SummaryField::REGION:
+         {
+            region = summaryRecord.readBytes();
+            break;
+         }
+         case SaveGameFormat::SummaryField::MAP:
+         {
+            map = summaryRecord.readBytes();
+            break;
+         }
+         case SaveGameFormat::SummaryField::PLAY_TIME:
+         {
+            playTime = summaryRecord.readUnsigned();
+            break;
+         }
+         default:
+         {
+            summaryRecord.skipField();
+         }
+      }
+   }
+}
+
+void SaveGameSummary::serialize(SaveGameEncoder& summaryRecord) const
+{
+   for(std::vector<std::string>::const_iterator iter = portraitPaths.begin(); iter != portraitPaths.end(); ++iter)
+   {
+      summaryRecord.writeBytes(SaveGameFormat::SummaryField::PORTRAIT_PATH, *iter);
+   }
+
+   if(!region.empty())
+   {
+      summaryRecord.writeBytes(SaveGameFormat::SummaryField::REGION, region);
+   }
+
+   if(!map.empty())
+   {
+      summaryRecord.writeBytes(SaveGameFormat::SummaryField::MAP, map);
+   }
+
+   summaryRecord.writeUnsigned(SaveGameFormat::SummaryField::PLAY_TIME, playTime);
+}
+
+const std::string& SaveGameSummary::getFilePath() const
+{
+   return filePath;
+}
+
+const std::vector<std::string>& SaveGameSummary::getPortraitPaths() const
+{
+   return portraitPaths;
+}
+
+const std::string& SaveGameSummary::getRegion() const
+{
+   return region;
+}
+
+const std::string& SaveGameSummary::getMap() const
+{
+   return map;
+}
+
+Uint32 SaveGameSummary::getPlayTime() const
+{
+   return playTime;
+}
@@ -0,0 +1,103 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SAVE_GAME_SUMMARY_H
+#define SAVE_GAME_SUMMARY_H
+
+#include <string>
+#include <vector>
+#include "SDL_stdinc.h"
+
+class SaveGameDecoder;
+class SaveGameEncoder;
+
+/**
+ * What the Load and Save screens show for a save game: the party's portraits, where the game was saved and how long
+ * it has been played for. The summary is written at the front of the save game (see SaveGameFormat.h),
+ * so the screens can list every save game without loading any of them.
+ */
+class SaveGameSummary
+{
+   /** The path to the save game file. */
+   std::string filePath;
+
+   /** The portraits of the characters in the party, in party order. */
+   std::vector<std::string> portraitPaths;
+
+   /** The region that the game was saved in. */
+   std::string region;
+
+   /** The map that the game was saved on. */
+   std::string map;
+
+   /** The time the game has been played for, in seconds. */
+   Uint32 playTime;
+
+   /**
+    * Reads the summary record of a binary save game.
+    *
+    * @param summaryRecord The summary record.
+    */
+   void parse(SaveGameDecoder& summaryRecord);
+
+   public:
+      /**
+       * Constructor for an empty summary.
+       */
+      SaveGameSummary();
+
+      /**
+       * Constructor.
+       *
+       * @param portraitPaths The portraits of the characters in the party, in party order.
+       * @param region The region that the game is being saved in.
+       * @param map The map that the game is being saved on.
+       * @param playTime The time the game has been played for, in seconds.
+       */
+      SaveGameSummary(const std::vector<std::string>& portraitPaths, const std::string& region, const std::string& map, Uint32 playTime);
+
+      /**
+       * Load the summary of a save game. Only the summary at the front of the file is read, unless the save game
+       * was written before save games had summaries, in which case the whole save game is loaded to summarize it.
+       *
+       * @param path The path to the save game file.
+       */
+      void load(const std::string& path);
+
+      /**
+       * Serialize the summary into the summary record of a binary save game.
+       *
+       * @param summaryRecord The summary record.
+       */
+      void serialize(SaveGameEncoder& summaryRecord) const;
+
+      /**
+       * @return The path to the save game file that this summary was loaded from.
+       */
+      const std::string& getFilePath() const;
+
+      /**
+       * @return The portraits of the characters in the party, in party order.
+       */
+      const std::vector<std::string>& getPortraitPaths() const;
+
+      /**
+       * @return The region that the game was saved in.
+       */
+      const std::string& getRegion() const;
+
+      /**
+       * @return The map that the game was saved on.
+       */
+      const std::string& getMap() const;
+
+      /**
+       * @return The time the game has been played for, in seconds.
+       */
+      Uint32 getPlayTime() const;
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "SaveGameWriter.h"
+#include "PlayerDataSnapshot.h"
+#include "SaveGameEncoder.h"
+#include "EventBus.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include <cstdio>
+
+#ifdef _WIN32
+   #include <windows.h>
+   #include <io.h>
+#else
+   #include <unistd.h>
+#endif
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PLAYER;
+
+SDL_Thread* SaveGameWriter::thread = NULL;
+SDL_mutex* SaveGameWriter::lock = NULL;
+SDL_cond* SaveGameWriter::saveRequested = NULL;
+SDL_cond* SaveGameWriter::saveWritten = NULL;
+bool SaveGameWriter::stopping = false;
+std::list<SaveGameWriter::PendingSave> SaveGameWriter::pendingSaves;
+std::string SaveGameWriter::currentPath;
+
+int SaveGameWriter::runWriter(void* /*data*/)
+{
+   writerLoop();
+   return 0;
+}
+
+void SaveGameWriter::writerLoop()
+{
+   SDL_mutexP(lock);
+   for(;;)
+   {
+      while(!stopping && pendingSaves.empty())
+      {
+         SDL_CondWait(saveRequested, lock);
+      }
+
+      // Saves that are already queued are still written when stopping, since the player thinks they are saved
+      if(pendingSaves.empty())
+      {
+         break;
+      }
+
+      PendingSave save = pendingSaves.front();
+      pendingSaves.pop_front();
+      currentPath = save.path;
+      SDL_mutexV(lock);
+
+      const bool written = writeNow(*save.snapshot, save.path);
+      delete save.snapshot;
+      EventBus::post(EventBus::SAVE_WRITTEN, written ? 1 : 0, save.path.c_str());
+
+      SDL_mutexP(lock);
+      currentPath.clear();
+      SDL_CondBroadcast(saveWritten);
+   }
+   SDL_mutexV(lock);
+}
+
+bool SaveGameWriter::start()
+{
+   if(lock == NULL)
+   {
+      lock = SDL_CreateMutex();
+      saveRequested = SDL_CreateCond();
+      saveWritten = SDL_CreateCond();
+   }
+
+   if(thread == NULL)
+   {
+      stopping = false;
+      thread = SDL_CreateThread(runWriter, NULL);
+      if(thread == NULL)
+      {
+         DEBUG("Failed to start save game writer thread: %s", SDL_GetError());
+         return false;
+      }
+   }
+
+   return true;
+}
+
+bool SaveGameWriter::isPending(const std::string& path)
+{
+   if(currentPath == path)
+   {
+      return true;
+   }
+
+   for(std::list<PendingSave>::const_iterator iter = pendingSaves.begin(); iter != pendingSaves.end(); ++iter)
+   {
+      if(iter->path == path)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void SaveGameWriter::write(PlayerDataSnapshot* snapshot, const std::string& path)
+{
+   if(!start())
+   {
+      const bool written = writeNow(*snapshot, path);
+      delete snapshot;
+      EventBus::post(EventBus::SAVE_WRITTEN, written ? 1 : 0, path.c_str());
+      return;
+   }
+
+   PendingSave save;
+   save.snapshot = snapshot;
+   save.path = path;
+
+   SDL_mutexP(lock);
+   for(std::list<PendingSave>::iterator iter = pendingSaves.begin(); iter != pendingSaves.end(); ++iter)
+   {
+      if(iter->path == path)
+      {
+         // The older save would only be overwritten by this one, so there is no point writing it
+         delete iter->snapshot;
+         pendingSaves.erase(iter);
+         break;
+      }
+   }
+
+   pendingSaves.push_back(save);
+   SDL_CondSignal(saveRequested);
+   SDL_mutexV(lock);
+}
+
+bool SaveGameWriter::writeNow(const PlayerDataSnapshot& snapshot, const std::string& path)
+{
+   SaveGameEncoder summaryRecord;
+   snapshot.serializeSummary(summaryRecord);
+
+   SaveGameEncoder playerDataRecord;
+   snapshot.serialize(playerDataRecord);
+   const std::string saveText = playerDataRecord.finish(summaryRecord);
+
+   DEBUG("Saving to file %s", path.c_str());
+
+   const std::string tempPath = path + ".tmp";
+   FILE* output = fopen(tempPath.c_str(), "wb");
+   if(output == NULL)
+   {
+      DEBUG("Failed to open save game file %s for writing.", tempPath.c_str());
+      return false;
+   }
+
+   // The save has to be on the disk before it replaces the old one, or a crash could still leave neither of them
+   bool written = fwrite(saveText.data(), 1, saveText.size(), output) == saveText.size() && fflush(output) == 0;
+#ifdef _WIN32
+   written = written && _commit(_fileno(output)) == 0;
+#else
+   written = written && fsync(fileno(output)) == 0;
+#endif
+   written = fclose(output) == 0 && written;
+
+   if(written)
+   {
+#ifdef _WIN32
+      written = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+      written = rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+   }
+
+   if(!written)
+   {
+      DEBUG("Failed to write save game file %s; the previous save game was kept.", path.c_str());
+      remove(tempPath.c_str());
+      return false;
+   }
+
+   return true;
+}
+
+void SaveGameWriter::waitForSave(const std::string& path)
+{
+   if(lock == NULL) return;
+
+   SDL_mutexP(lock);
+   while(isPending(path))
+   {
+      SDL_CondWait(saveWritten, lock);
+   }
+   SDL_mutexV(lock);
+}
+
+void SaveGameWriter::stop()
+{
+   if(thread != NULL)
+   {
+      SDL_mutexP(lock);
+      stopping = true;
+      SDL_CondBroadcast(saveRequested);
+      SDL_mutexV(lock);
+
+      SDL_WaitThread(thread, NULL);
+      thread = NULL;
+   }
+}
@@ -0,0 +1,122 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SAVE_GAME_WRITER_H
+#define SAVE_GAME_WRITER_H
+
+#include <list>
+#include <string>
+
+class PlayerDataSnapshot;
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+/**
+ * A thread that serializes and writes save games away from the main thread, so that saving doesn't hold up the game.
+ * Saves are handed to the writer as snapshots of the player data, and written out in the order they were made.
+ *
+ * Each save is written to a temporary file beside the save game, which then replaces the save game in one step,
+ * so a save game is never left half-written, even if the game stops in the middle of writing it.
+ * Once each save is written (or fails to be), an EventBus::SAVE_WRITTEN event is posted for the main thread.
+ */
+class SaveGameWriter
+{
+   /** A save waiting to be written. */
+   struct PendingSave
+   {
+      /** The player data to save. */
+      PlayerDataSnapshot* snapshot;
+
+      /** The path to save the player data to. */
+      std::string path;
+   };
+
+   /** The writer's thread, or NULL if it isn't running. */
+   static SDL_Thread* thread;
+
+   /** Guards the queue of saves, the path being written and the stopping flag. */
+   static SDL_mutex* lock;
+
+   /** Signalled when a save is added to the queue, or when the writer must stop. */
+   static SDL_cond* saveRequested;
+
+   /** Signalled whenever the writer finishes writing a save. */
+   static SDL_cond* saveWritten;
+
+   /** Whether or not the writer has been asked to stop. */
+   static bool stopping;
+
+   /** The saves waiting to be written, in the order they will be written. */
+   static std::list<PendingSave> pendingSaves;
+
+   /** The path of the save being written, or the empty string if the writer is idle. */
+   static std::string currentPath;
+
+   /**
+    * The entry point for the writer thread.
+    *
+    * @param data Unused.
+    *
+    * @return The exit code of the thread.
+    */
+   static int runWriter(void* data);
+
+   /**
+    * Writes saves from the queue until the writer is stopped and the queue is empty.
+    */
+   static void writerLoop();
+
+   /**
+    * Starts the writer thread, if it isn't already running.
+    *
+    * @return true iff the thread is running.
+    */
+   static bool start();
+
+   /**
+    * @param path The path of a save game.
+    *
+    * @return true iff a save to the path is being written or waiting to be written. Must be called with the lock held.
+    */
+   static bool isPending(const std::string& path);
+
+   public:
+      /**
+       * Hands a save to the writer thread, to be written once the saves ahead of it are written.
+       * A save to the same path that hasn't been started yet is dropped in favour of this one.
+       * If the writer thread can't be started, the save is written right away instead.
+       *
+       * @param snapshot The player data to save. The writer takes ownership of the snapshot.
+       * @param path The path to save the player data to.
+       */
+      static void write(PlayerDataSnapshot* snapshot, const std::string& path);
+
+      /**
+       * Serializes player data and writes it to a save game on the calling thread,
+       * through a temporary file that replaces the save game once it is completely written.
+       *
+       * @param snapshot The player data to save.
+       * @param path The path to save the player data to.
+       *
+       * @return true iff the save game was written. If it wasn't, the previous save game at the path is left as it was.
+       */
+      static bool writeNow(const PlayerDataSnapshot& snapshot, const std::string& path);
+
+      /**
+       * Waits until every save to a path has been written, so that the save game can be read back.
+       *
+       * @param path The path of the save game.
+       */
+      static void waitForSave(const std::string& path);
+
+      /**
+       * Writes all the saves that are waiting to be written, then stops the writer thread.
+       */
+      static void stop();
+};
+
+#endif
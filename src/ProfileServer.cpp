@@ -0,0 +1,453 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ProfileServer.h"
+
+// Winsock has to come before anything that brings in windows.h
+#ifdef _WIN32
+   #include <winsock2.h>
+#else
+   #include <sys/types.h>
+   #include <sys/socket.h>
+   #include <sys/select.h>
+   #include <netinet/in.h>
+   #include <netinet/tcp.h>
+   #include <unistd.h>
+#endif
+
+#include "ProfileStreamFormat.h"
+#include "Atomics.h"
+#include "FrameProfiler.h"
+#include "MemoryTracker.h"
+#include "PerformanceStats.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include <algorithm>
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EXEC_STACK;
+
+#ifdef _WIN32
+   typedef SOCKET SocketHandle;
+   static const SocketHandle NO_SOCKET = INVALID_SOCKET;
+   #define closeSocket closesocket
+#else
+   typedef int SocketHandle;
+   static const SocketHandle NO_SOCKET = -1;
+   #define closeSocket close
+#endif
+
+// A viewer that goes away mid-frame would otherwise kill the engine with SIGPIPE
+#ifdef MSG_NOSIGNAL
+   static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+   static const int SEND_FLAGS = 0;
+#endif
+
+// How long (in milliseconds) the server thread waits on the network or for a message before checking whether it has been stopped
+static const int WAIT_TIME = 250;
+
+// The longest name that fits in a STRING record
+static const size_t MAX_NAME_LENGTH = 255;
+
+// The most names that a connection can be given IDs for
+static const size_t MAX_NAMES = 65535;
+
+// The ID given to names that don't fit in a connection's IDs
+static const Uint16 UNNAMED_ID = 65535;
+
+static SocketHandle listenSocket = NO_SOCKET;
+
+std::vector<char> ProfileServer::buffers[BUFFER_COUNT];
+unsigned long ProfileServer::bufferConnections[BUFFER_COUNT] = { 0, 0, 0 };
+int ProfileServer::packingBuffer = 0;
+volatile unsigned long ProfileServer::handedBuffer = 1;
+int ProfileServer::sendingBuffer = 2;
+volatile unsigned long ProfileServer::connectionCount = 0;
+volatile bool ProfileServer::viewerConnected = false;
+volatile bool ProfileServer::running = false;
+unsigned long ProfileServer::packedConnection = 0;
+std::map<const char*, Uint16> ProfileServer::nameIds;
+bool ProfileServer::namesLost = false;
+Uint32 ProfileServer::frameNumber = 0;
+std::vector<std::pair<const char*, float> > ProfileServer::counters;
+SDL_Thread* ProfileServer::thread = NULL;
+SDL_semaphore* ProfileServer::messageReady = NULL;
+
+/**
+ * Adds a number to a message in little-endian byte order.
+ *
+ * @param message The message to add to.
+ * @param number The number to add.
+ * @param size The number of bytes to add it in.
+ */
+static void writeNumber(std::vector<char>& message, Uint32 number, int size)
+{
+   for(int byte = 0; byte < size; ++byte)
+   {
+      message.push_back(static_cast<char>((number >> (byte * 8)) & 0xFF));
+   }
+}
+
+/**
+ * Overwrites a number in a message in little-endian byte order.
+ *
+ * @param message The message to write to.
+ * @param offset The offset of the number to overwrite.
+ * @param number The number to write.
+ */
+static void writeNumberAt(std::vector<char>& message, size_t offset, Uint32 number)
+{
+   for(int byte = 0; byte < 4; ++byte)
+   {
+      message[offset + byte] = static_cast<char>((number >> (byte * 8)) & 0xFF);
+   }
+}
+
+/**
+ * Adds a 32-bit float to a message in little-endian byte order.
+ *
+ * @param message The message to add to.
+ * @param value The value to add.
+ */
+static void writeFloat(std::vector<char>& message, float value)
+{
+   Uint32 bits;
+   memcpy(&bits, &value, sizeof(bits));
+   writeNumber(message, bits, 4);
+}
+
+/**
+ * Waits until a socket can be read from (or accepted on) or written to.
+ *
+ * @param socket The socket to wait on.
+ * @param writing true to wait until the socket can be written to.
+ *
+ * @return true iff the socket is ready, or false if the wait timed out or failed.
+ */
+static bool waitForSocket(SocketHandle socket, bool writing)
+{
+   fd_set sockets;
+   FD_ZERO(&sockets);
+   FD_SET(socket, &sockets);
+
+   timeval timeout;
+   timeout.tv_sec = 0;
+   timeout.tv_usec = WAIT_TIME * 1000;
+
+   // The first argument is ignored by Winsock
+   const int ready = select(static_cast<int>(socket) + 1, writing ? NULL : &sockets, writing ? &sockets : NULL, NULL, &timeout);
+   return ready > 0;
+}
+
+/**
+ * Sends data over a socket, waiting for the network as needed.
+ *
+ * @param socket The socket to send over.
+ * @param data The data to send.
+ * @param size The size of the data (in bytes).
+ * @param running The flag that is cleared once the server is asked to stop, which stops the send.
+ *
+ * @return true iff all of the data was sent.
+ */
+static bool sendAll(SocketHandle socket, const char* data, size_t size, const volatile bool& running)
+{
+   while(size > 0)
+   {
+      if(!running) return false;
+      if(!waitForSocket(socket, true)) continue;
+
+      const int sent = send(socket, data, static_cast<int>(size), SEND_FLAGS);
+      if(sent <= 0) return false;
+
+      data += sent;
+      size -= sent;
+   }
+
+   return true;
+}
+
+bool ProfileServer::start(int port)
+{
+   if(thread != NULL)
+   {
+      return true;
+   }
+
+#ifdef _WIN32
+   WSADATA winsockData;
+   if(WSAStartup(MAKEWORD(2, 2), &winsockData) != 0)
+   {
+      LOG_WARNING("Failed to start Winsock for the profile server.");
+      return false;
+   }
+#endif
+
+   listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+   if(listenSocket == NO_SOCKET)
+   {
+      LOG_WARNING("Failed to create the profile server's socket.");
+      return false;
+   }
+
+   // A server restarted right after a viewer disconnected can take the port back without waiting out the old connection
+   const int reuse = 1;
+   setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+   sockaddr_in address;
+   memset(&address, 0, sizeof(address));
+   address.sin_family = AF_INET;
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   address.sin_port = htons(static_cast<unsigned short>(port));
+
+   if(bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, 1) != 0)
+   {
+      LOG_WARNING("Failed to listen for profile viewers on port %d.", port);
+      closeSocket(listenSocket);
+      listenSocket = NO_SOCKET;
+      return false;
+   }
+
+   if(messageReady == NULL)
+   {
+      messageReady = SDL_CreateSemaphore(0);
+   }
+
+   running = true;
+   thread = SDL_CreateThread(serve, NULL);
+   if(thread == NULL)
+   {
+      LOG_WARNING("Failed to start profile server thread: %s", SDL_GetError());
+      running = false;
+      closeSocket(listenSocket);
+      listenSocket = NO_SOCKET;
+      return false;
+   }
+
+   DEBUG("Profile server listening on port %d.", port);
+   return true;
+}
+
+void ProfileServer::stop()
+{
+   if(thread != NULL)
+   {
+      running = false;
+      SDL_SemPost(messageReady);
+      SDL_WaitThread(thread, NULL);
+      thread = NULL;
+
+      closeSocket(listenSocket);
+      listenSocket = NO_SOCKET;
+
+#ifdef _WIN32
+      WSACleanup();
+#endif
+   }
+}
+
+int ProfileServer::serve(void*)
+{
+   // The greeting never changes, so it is put together once
+   std::vector<char> greeting(ProfileStreamFormat::MAGIC, ProfileStreamFormat::MAGIC + sizeof(ProfileStreamFormat::MAGIC));
+   writeNumber(greeting, ProfileStreamFormat::VERSION, 4);
+
+   while(running)
+   {
+      if(!waitForSocket(listenSocket, false)) continue;
+
+      const SocketHandle viewer = accept(listenSocket, NULL, NULL);
+      if(viewer == NO_SOCKET) continue;
+
+      // Each message is sent as soon as it is handed over, rather than held back to fill up a packet
+      const int noDelay = 1;
+      setsockopt(viewer, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+#ifdef SO_NOSIGPIPE
+      const int noSignal = 1;
+      setsockopt(viewer, SOL_SOCKET, SO_NOSIGPIPE, reinterpret_cast<const char*>(&noSignal), sizeof(noSignal));
+#endif
+
+      if(!sendAll(viewer, &greeting[0], greeting.size(), running))
+      {
+         closeSocket(viewer);
+         continue;
+      }
+
+      // Messages packed for the last viewer use names that this one hasn't been given, so they are skipped
+      const unsigned long connection = connectionCount + 1;
+      connectionCount = connection;
+      Atomics::memoryBarrier();
+      viewerConnected = true;
+      DEBUG("Profile viewer connected.");
+
+      while(running)
+      {
+         if(SDL_SemWaitTimeout(messageReady, WAIT_TIME) != 0 || (handedBuffer & FRESH_BUFFER) == 0) continue;
+
+         sendingBuffer = static_cast<int>(Atomics::exchange(&handedBuffer, sendingBuffer) & ~FRESH_BUFFER);
+         if(bufferConnections[sendingBuffer] != connection) continue;
+
+         const std::vector<char>& message = buffers[sendingBuffer];
+         if(!sendAll(viewer, &message[0], message.size(), running)) break;
+      }
+
+      viewerConnected = false;
+      closeSocket(viewer);
+      DEBUG("Profile viewer disconnected.");
+   }
+
+   return 0;
+}
+
+bool ProfileServer::isStreaming()
+{
+   return viewerConnected;
+}
+
+void ProfileServer::addCounter(const char* name, double value)
+{
+   if(!viewerConnected) return;
+
+   // A counter added more than once in a frame (such as by each of the frame's steps) keeps its last value
+   for(std::vector<std::pair<const char*, float> >::iterator counter = counters.begin(); counter != counters.end(); ++counter)
+   {
+      if(counter->first == name)
+      {
+         counter->second = static_cast<float>(value);
+         return;
+      }
+   }
+
+   counters.push_back(std::make_pair(name, static_cast<float>(value)));
+}
+
+Uint16 ProfileServer::getNameId(std::vector<char>& message, const char* name)
+{
+   std::map<const char*, Uint16>::const_iterator knownName = nameIds.find(name);
+   if(knownName != nameIds.end())
+   {
+      return knownName->second;
+   }
+
+   if(nameIds.size() >= MAX_NAMES)
+   {
+      return UNNAMED_ID;
+   }
+
+   const Uint16 nameId = static_cast<Uint16>(nameIds.size());
+   nameIds[name] = nameId;
+
+   const size_t length = std::min(strlen(name), MAX_NAME_LENGTH);
+   message.push_back(static_cast<char>(ProfileStreamFormat::STRING));
+   writeNumber(message, nameId, 2);
+   message.push_back(static_cast<char>(length));
+   message.insert(message.end(), name, name + length);
+
+   return nameId;
+}
+
+void ProfileServer::packFrame()
+{
+   std::vector<char>& message = buffers[packingBuffer];
+   message.clear();
+
+   // The size of the message is filled in once the rest of it is packed
+   writeNumber(message, 0, 4);
+
+   const FrameProfiler::FrameRecord* frame = NULL;
+   if(FrameProfiler::enabled && FrameProfiler::framesRecorded > 0)
+   {
+      frame = &FrameProfiler::frames[(FrameProfiler::currentFrame + FrameProfiler::FRAME_HISTORY - 1) % FrameProfiler::FRAME_HISTORY];
+   }
+
+   message.push_back(static_cast<char>(ProfileStreamFormat::FRAME));
+   writeNumber(message, frameNumber++, 4);
+   writeNumber(message, frame != NULL ? static_cast<Uint32>(frame->duration) : static_cast<Uint32>(PerformanceStats::getLastFrameTime() * 1000), 4);
+
+   if(namesLost)
+   {
+      // The viewer never got the message that gave some of the names, so all of them are given again (with the same IDs)
+      for(std::map<const char*, Uint16>::const_iterator name = nameIds.begin(); name != nameIds.end(); ++name)
+      {
+         const size_t length = std::min(strlen(name->first), MAX_NAME_LENGTH);
+         message.push_back(static_cast<char>(ProfileStreamFormat::STRING));
+         writeNumber(message, name->second, 2);
+         message.push_back(static_cast<char>(length));
+         message.insert(message.end(), name->first, name->first + length);
+      }
+
+      namesLost = false;
+   }
+
+   if(frame != NULL)
+   {
+      for(std::vector<FrameProfiler::ZoneRecord>::const_iterator zone = frame->zones.begin(); zone != frame->zones.end(); ++zone)
+      {
+         const Uint16 nameId = getNameId(message, zone->name);
+         message.push_back(static_cast<char>(ProfileStreamFormat::ZONE));
+         writeNumber(message, nameId, 2);
+         message.push_back(static_cast<char>(std::min(zone->depth, 255)));
+         writeNumber(message, static_cast<Uint32>(std::max(0.0, zone->startTime - frame->startTime)), 4);
+         writeNumber(message, static_cast<Uint32>(zone->duration), 4);
+      }
+   }
+
+   for(std::vector<std::pair<const char*, float> >::const_iterator counter = counters.begin(); counter != counters.end(); ++counter)
+   {
+      const Uint16 nameId = getNameId(message, counter->first);
+      message.push_back(static_cast<char>(ProfileStreamFormat::COUNTER));
+      writeNumber(message, nameId, 2);
+      writeFloat(message, counter->second);
+   }
+
+   for(int tag = 0; tag < MemoryTracker::TAG_COUNT; ++tag)
+   {
+      const MemoryTracker::Tag memoryTag = static_cast<MemoryTracker::Tag>(tag);
+      const Uint16 nameId = getNameId(message, MemoryTracker::getTagName(memoryTag));
+      message.push_back(static_cast<char>(ProfileStreamFormat::MEMORY));
+      writeNumber(message, nameId, 2);
+      writeNumber(message, static_cast<Uint32>(std::max(0L, MemoryTracker::getLiveBytes(memoryTag)) / 1024), 4);
+   }
+
+   writeNumberAt(message, 0, static_cast<Uint32>(message.size() - 4));
+}
+
+void ProfileServer::publishFrame()
+{
+   if(viewerConnected)
+   {
+      const unsigned long connection = connectionCount;
+      if(connection != packedConnection)
+      {
+         // A new viewer hasn't been given any names, and counts frames from the first one it is sent
+         nameIds.clear();
+         namesLost = false;
+         frameNumber = 0;
+         packedConnection = connection;
+      }
+
+      addCounter("frames per second", PerformanceStats::getFramesPerSecond());
+      addCounter("draw calls", PerformanceStats::getLastFrameDrawCalls());
+      addCounter("texture binds", PerformanceStats::getLastFrameTextureBinds());
+      addCounter("heap allocations", MemoryTracker::getTotalAllocationCount());
+
+      packFrame();
+      bufferConnections[packingBuffer] = connection;
+
+      // If the server thread never took the last message, the names that it gave are lost along with it
+      const unsigned long lastBuffer = Atomics::exchange(&handedBuffer, packingBuffer | FRESH_BUFFER);
+      if((lastBuffer & FRESH_BUFFER) != 0)
+      {
+         namesLost = true;
+      }
+
+      packingBuffer = static_cast<int>(lastBuffer & ~FRESH_BUFFER);
+      SDL_SemPost(messageReady);
+   }
+
+   counters.clear();
+}
@@ -0,0 +1,144 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PROFILE_SERVER_H
+#define PROFILE_SERVER_H
+
+#include "SDL_stdinc.h"
+#include <map>
+#include <utility>
+#include <vector>
+
+struct SDL_Thread;
+struct SDL_semaphore;
+
+/**
+ * Streams the engine's profile to a viewer connected over a local TCP port, for builds that run without a console
+ * to show the debug overlays on (such as on test rigs).
+ *
+ * Once per frame, while a viewer is connected, the main thread packs the last frame's zones (see FrameProfiler),
+ * the counters added to it (such as the frame rate, the number of threads in the scheduler and the size of the Lua heap)
+ * and the memory held by each subsystem (see MemoryTracker) into a message (see ProfileStreamFormat).
+ * The messages are handed to the server's own thread through three buffers that are swapped without taking a lock,
+ * so the main thread never waits on the network: if the viewer falls behind, it is sent the latest frame and the ones
+ * in between are skipped. While no viewer is connected, nothing is packed at all.
+ *
+ * The server only listens on the loopback address, and serves one viewer at a time.
+ */
+class ProfileServer
+{
+   /** The number of buffers that messages are handed over in. */
+   static const int BUFFER_COUNT = 3;
+
+   /** The bit set on the handed-over buffer's index while it holds a message that the server thread hasn't taken. */
+   static const unsigned long FRESH_BUFFER = 4;
+
+   /** The buffers that messages are handed over in. */
+   static std::vector<char> buffers[BUFFER_COUNT];
+
+   /** The connection that the message in each buffer was packed for. */
+   static unsigned long bufferConnections[BUFFER_COUNT];
+
+   /** The buffer that the main thread packs messages into. */
+   static int packingBuffer;
+
+   /** The buffer that is handed over between the threads, along with FRESH_BUFFER. */
+   static volatile unsigned long handedBuffer;
+
+   /** The buffer that the server thread sends messages from. */
+   static int sendingBuffer;
+
+   /** The number of viewers that have connected, which identifies the current connection. */
+   static volatile unsigned long connectionCount;
+
+   /** true iff a viewer is connected. */
+   static volatile bool viewerConnected;
+
+   /** true until the server is asked to stop. */
+   static volatile bool running;
+
+   /** The connection that the main thread last packed a message for. */
+   static unsigned long packedConnection;
+
+   /** The IDs given to names on the current connection, by the names' pointers. */
+   static std::map<const char*, Uint16> nameIds;
+
+   /** true iff a message was skipped since the names were last given, so they have to be given again. */
+   static bool namesLost;
+
+   /** The number of frames packed for the current connection. */
+   static Uint32 frameNumber;
+
+   /** The counters added to the current frame. */
+   static std::vector<std::pair<const char*, float> > counters;
+
+   /** The server's thread, or NULL if the server isn't running. */
+   static SDL_Thread* thread;
+
+   /** Signalled each time a message is handed over. */
+   static SDL_semaphore* messageReady;
+
+   /**
+    * Gives the ID of a name, adding a STRING record that gives the name first if the viewer hasn't been given it.
+    *
+    * @param message The message to add the record to.
+    * @param name The name.
+    *
+    * @return The ID of the name.
+    */
+   static Uint16 getNameId(std::vector<char>& message, const char* name);
+
+   /**
+    * Packs the last frame's profile into the packing buffer.
+    */
+   static void packFrame();
+
+   /**
+    * Accepts viewers and sends them messages until the server is stopped.
+    *
+    * @param data Unused.
+    *
+    * @return 0.
+    */
+   static int serve(void* data);
+
+   public:
+      /**
+       * Starts the server.
+       *
+       * @param port The port to listen on.
+       *
+       * @return true iff the server was started.
+       */
+      static bool start(int port);
+
+      /**
+       * Stops the server, closing the viewer's connection.
+       */
+      static void stop();
+
+      /**
+       * @return true iff a viewer is connected, so the frame's counters are worth adding.
+       */
+      static bool isStreaming();
+
+      /**
+       * Adds a counter to the current frame's profile, if a viewer is connected.
+       * A counter that was already added to the frame takes the new value.
+       *
+       * @param name The name of the counter (which must be a string literal, since only its pointer is kept).
+       * @param value The counter's value.
+       */
+      static void addCounter(const char* name, double value);
+
+      /**
+       * Hands the profile of the frame that just finished over to the server thread, if a viewer is connected.
+       * Called on the main thread at the start of each frame, once the profiler has started recording the new frame.
+       */
+      static void publishFrame();
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PROFILE_STREAM_FORMAT_H
+#define PROFILE_STREAM_FORMAT_H
+
+#include "SDL_stdinc.h"
+
+/**
+ * The layout of the stream that the profile server (see ProfileServer) sends to a viewer connected to it.
+ * Every number in the stream is in little-endian byte order, and nothing in it is padded. The stream is laid out as:
+ *
+ * - The greeting below.
+ * - A message for each frame that the viewer is sent (frames that come faster than the viewer reads them are skipped):
+ *   a Uint32 holding the size of the rest of the message, then the message's records, each of which is
+ *   a Uint8 RecordType followed by the record's fields.
+ *
+ * The records are named by ID rather than by name, and a STRING record gives the name of each ID before the ID is first used.
+ * IDs are only good for the connection that they were given on.
+ */
+namespace ProfileStreamFormat
+{
+   /** The characters that every profile stream starts with. */
+   static const char MAGIC[4] = { 'E', 'D', 'P', '\0' };
+
+   /** The version of the format; viewers must reject streams with any other version. */
+   static const Uint32 VERSION = 1;
+
+   /** The start of every profile stream. */
+   struct Greeting
+   {
+      /** The characters in MAGIC. */
+      char magic[4];
+
+      /** The format version that the stream is written with. */
+      Uint32 version;
+   };
+
+   /** The kinds of records in a message. */
+   enum RecordType
+   {
+      /**
+       * The first record of every message: the Uint32 number of the frame (counted from when the viewer connected)
+       * and the Uint32 time that the frame took (in microseconds).
+       */
+      FRAME = 1,
+
+      /** The Uint16 ID of a name, the Uint8 length of the name, and then its characters (without a terminator). */
+      STRING = 2,
+
+      /**
+       * A zone run during the frame (see FrameProfiler): the Uint16 ID of its name, the Uint8 number of zones that it ran inside of,
+       * and the Uint32 times (in microseconds) that it started at (from the start of the frame) and took.
+       */
+      ZONE = 3,
+
+      /** A counter's value at the end of the frame: the Uint16 ID of its name, and its value as a 32-bit float. */
+      COUNTER = 4,
+
+      /** The memory held by a subsystem (see MemoryTracker): the Uint16 ID of its tag's name, and the Uint32 number of kilobytes held. */
+      MEMORY = 5
+   };
+};
+
+#endif
@@ -21,4 +21,9 @@ namespace shapes
                 || other.bottom < top
                 );
    }
+
+   bool Rectangle::contains(const Point2D& point) const
+   {
+      return point.x >= left && point.x <= right && point.y >= top && point.y <= bottom;
+   }
 };
\ No newline at end of file
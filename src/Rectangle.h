@@ -23,6 +23,7 @@ namespace shapes
       Rectangle(int top, int left, int bottom, int right);
 
       bool intersects(const Rectangle& other) const;
+      bool contains(const Point2D& point) const;
    };
 };
 
@@ -0,0 +1,371 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "RenderTarget.h"
+#include "GLState.h"
+#include "GraphicsUtil.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+bool RenderTarget::functionsLoaded = false;
+bool RenderTarget::targetsSupported = false;
+GLuint RenderTarget::boundFramebuffer = 0;
+bool RenderTarget::boundDepthBuffer = false;
+int RenderTarget::screenDepthBits = -1;
+
+// The framebuffer object and separate blending functions aren't part of OpenGL 1.1, so they have to be looked up from the driver
+static PFNGLGENFRAMEBUFFERSEXTPROC genFramebuffers = NULL;
+static PFNGLBINDFRAMEBUFFEREXTPROC bindFramebuffer = NULL;
+static PFNGLFRAMEBUFFERTEXTURE2DEXTPROC framebufferTexture2D = NULL;
+static PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC checkFramebufferStatus = NULL;
+static PFNGLDELETEFRAMEBUFFERSEXTPROC deleteFramebuffers = NULL;
+static PFNGLBLENDFUNCSEPARATEEXTPROC blendFuncSeparate = NULL;
+static PFNGLGENRENDERBUFFERSEXTPROC genRenderbuffers = NULL;
+static PFNGLBINDRENDERBUFFEREXTPROC bindRenderbuffer = NULL;
+static PFNGLRENDERBUFFERSTORAGEEXTPROC renderbufferStorage = NULL;
+static PFNGLFRAMEBUFFERRENDERBUFFEREXTPROC framebufferRenderbuffer = NULL;
+static PFNGLDELETERENDERBUFFERSEXTPROC deleteRenderbuffers = NULL;
+
+void RenderTarget::loadFunctions()
+{
+   functionsLoaded = true;
+
+   const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+   if(extensions == NULL || strstr(extensions, "GL_EXT_framebuffer_object") == NULL || strstr(extensions, "GL_EXT_blend_func_separate") == NULL)
+   {
+      DEBUG("Framebuffer objects are not supported; offscreen layers will be drawn straight to the screen.");
+      return;
+   }
+
+   genFramebuffers = reinterpret_cast<PFNGLGENFRAMEBUFFERSEXTPROC>(GraphicsUtil::getProcAddress("glGenFramebuffersEXT"));
+   bindFramebuffer = reinterpret_cast<PFNGLBINDFRAMEBUFFEREXTPROC>(GraphicsUtil::getProcAddress("glBindFramebufferEXT"));
+   framebufferTexture2D = reinterpret_cast<PFNGLFRAMEBUFFERTEXTURE2DEXTPROC>(GraphicsUtil::getProcAddress("glFramebufferTexture2DEXT"));
+   checkFramebufferStatus = reinterpret_cast<PFNGLCHECKFRAMEBUFFERSTATUSEXTPROC>(GraphicsUtil::getProcAddress("glCheckFramebufferStatusEXT"));
+   deleteFramebuffers = reinterpret_cast<PFNGLDELETEFRAMEBUFFERSEXTPROC>(GraphicsUtil::getProcAddress("glDeleteFramebuffersEXT"));
+   blendFuncSeparate = reinterpret_cast<PFNGLBLENDFUNCSEPARATEEXTPROC>(GraphicsUtil::getProcAddress("glBlendFuncSeparateEXT"));
+
+   // Depth buffers come with framebuffer objects, but layers simply go without them if these are missing
+   genRenderbuffers = reinterpret_cast<PFNGLGENRENDERBUFFERSEXTPROC>(GraphicsUtil::getProcAddress("glGenRenderbuffersEXT"));
+   bindRenderbuffer = reinterpret_cast<PFNGLBINDRENDERBUFFEREXTPROC>(GraphicsUtil::getProcAddress("glBindRenderbufferEXT"));
+   renderbufferStorage = reinterpret_cast<PFNGLRENDERBUFFERSTORAGEEXTPROC>(GraphicsUtil::getProcAddress("glRenderbufferStorageEXT"));
+   framebufferRenderbuffer = reinterpret_cast<PFNGLFRAMEBUFFERRENDERBUFFEREXTPROC>(GraphicsUtil::getProcAddress("glFramebufferRenderbufferEXT"));
+   deleteRenderbuffers = reinterpret_cast<PFNGLDELETERENDERBUFFERSEXTPROC>(GraphicsUtil::getProcAddress("glDeleteRenderbuffersEXT"));
+
+   targetsSupported = genFramebuffers != NULL && bindFramebuffer != NULL && framebufferTexture2D != NULL
+         && checkFramebufferStatus != NULL && deleteFramebuffers != NULL && blendFuncSeparate != NULL;
+   DEBUG("Framebuffer objects are %s", targetsSupported ? "supported" : "missing functions; offscreen layers will be drawn straight to the screen.");
+}
+
+RenderTarget::RenderTarget(int width, int height, bool smooth, bool depth) : width(width), height(height), smooth(smooth), depth(depth),
+      texture(0), framebuffer(0), depthBuffer(0), previousFramebuffer(0), previousDepthBuffer(false), drawnWidth(width), drawnHeight(height)
+{
+   textureWidth = 1;
+   while(textureWidth < width) textureWidth <<= 1;
+
+   textureHeight = 1;
+   while(textureHeight < height) textureHeight <<= 1;
+}
+
+bool RenderTarget::isSupported()
+{
+   if(!functionsLoaded)
+   {
+      loadFunctions();
+   }
+
+   return targetsSupported;
+}
+
+bool RenderTarget::hasDepthBuffer()
+{
+   if(boundFramebuffer != 0)
+   {
+      return boundDepthBuffer;
+   }
+
+   if(screenDepthBits < 0)
+   {
+      // The screen's buffers are set when the window is created, so they only need to be asked for once
+      GLint bits = 0;
+      glGetIntegerv(GL_DEPTH_BITS, &bits);
+      screenDepthBits = bits;
+      DEBUG("The screen has a %d-bit depth buffer.", screenDepthBits);
+   }
+
+   return screenDepthBits > 0;
+}
+
+void RenderTarget::useLayerBlending()
+{
+   if(isSupported())
+   {
+      // Colours are weighted by their alpha as usual, but alpha simply accumulates,
+      // so that whatever ends up in the layer is already premultiplied
+      blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+      GLState::forgetBlendFunction();
+   }
+}
+
+void RenderTarget::create()
+{
+   glGenTextures(1, &texture);
+   GLState::bindTexture(texture);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, smooth ? GL_LINEAR : GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, smooth ? GL_LINEAR : GL_NEAREST);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+   genFramebuffers(1, &framebuffer);
+   bindFramebuffer(GL_FRAMEBUFFER_EXT, framebuffer);
+   framebufferTexture2D(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, GL_TEXTURE_2D, texture, 0);
+
+   if(depth && genRenderbuffers != NULL && bindRenderbuffer != NULL && renderbufferStorage != NULL
+         && framebufferRenderbuffer != NULL && deleteRenderbuffers != NULL)
+   {
+      // The depth buffer covers the whole texture, since a scaled layer is drawn into part of it
+      genRenderbuffers(1, &depthBuffer);
+      bindRenderbuffer(GL_RENDERBUFFER_EXT, depthBuffer);
+      renderbufferStorage(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, textureWidth, textureHeight);
+      bindRenderbuffer(GL_RENDERBUFFER_EXT, 0);
+      framebufferRenderbuffer(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, depthBuffer);
+
+      if(checkFramebufferStatus(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT)
+      {
+         DEBUG("Unable to attach a depth buffer to a %dx%d offscreen layer; it will go without one.", width, height);
+         framebufferRenderbuffer(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT, GL_RENDERBUFFER_EXT, 0);
+         deleteRenderbuffers(1, &depthBuffer);
+         depthBuffer = 0;
+      }
+   }
+
+   if(checkFramebufferStatus(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT)
+   {
+      bindFramebuffer(GL_FRAMEBUFFER_EXT, boundFramebuffer);
+      T_T("Unable to create an offscreen layer: the framebuffer object is incomplete.");
+   }
+
+   bindFramebuffer(GL_FRAMEBUFFER_EXT, boundFramebuffer);
+   DEBUG("Created %dx%d offscreen layer.", width, height);
+}
+
+void RenderTarget::begin(float scale)
+{
+   bind(scale);
+
+   // The screen is cleared to transparent black as well, so the clear colour doesn't need to be changed (or read back).
+   glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void RenderTarget::resume()
+{
+   bind(1.0f);
+}
+
+void RenderTarget::bind(float scale)
+{
+   if(framebuffer == 0)
+   {
+      create();
+   }
+
+   previousFramebuffer = boundFramebuffer;
+   previousDepthBuffer = boundDepthBuffer;
+   boundFramebuffer = framebuffer;
+   boundDepthBuffer = depthBuffer != 0;
+   bindFramebuffer(GL_FRAMEBUFFER_EXT, framebuffer);
+
+   drawnWidth = scale < 1.0f ? static_cast<int>(width * scale + 0.5f) : width;
+   drawnHeight = scale < 1.0f ? static_cast<int>(height * scale + 0.5f) : height;
+
+   // Map the layer's pixels the same way the screen's are mapped, whatever size the layer is (and however much of it is drawn into)
+   glPushAttrib(GL_VIEWPORT_BIT);
+   glViewport(0, 0, drawnWidth, drawnHeight);
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+   glOrtho(0.0, width, height, 0.0, -1.0, 1.0);
+   glMatrixMode(GL_MODELVIEW);
+}
+
+void RenderTarget::end()
+{
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+   glPopAttrib();
+
+   boundFramebuffer = previousFramebuffer;
+   boundDepthBuffer = previousDepthBuffer;
+   bindFramebuffer(GL_FRAMEBUFFER_EXT, boundFramebuffer);
+}
+
+void RenderTarget::capture()
+{
+   if(framebuffer == 0)
+   {
+      create();
+   }
+
+   // The screen's rows run from the bottom up too, so they land in the texture the same way as the layer's own drawing
+   GLState::bindTexture(texture);
+   glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+   drawnWidth = width;
+   drawnHeight = height;
+}
+
+void RenderTarget::draw() const
+{
+   // The modelview matrix may still hold a drawing offset, but the layer always lines up with the screen
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   draw(0, 0);
+
+   glPopMatrix();
+}
+
+void RenderTarget::drawQuad(int x, int y, int drawWidth, int drawHeight) const
+{
+   const float right = float(drawnWidth) / textureWidth;
+   const float top = float(drawnHeight) / textureHeight;
+
+   GLState::setTexturing(true);
+   GLState::setTextureMode(GL_REPLACE);
+   GLState::bindTexture(texture);
+
+   // The layer's rows run from the bottom of the layer up, so it is drawn flipped
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glTexCoord2f(0.0f, top);
+      glVertex3i(x, y, 0);
+
+      glTexCoord2f(right, top);
+      glVertex3i(x + drawWidth, y, 0);
+
+      glTexCoord2f(right, 0.0f);
+      glVertex3i(x + drawWidth, y + drawHeight, 0);
+
+      glTexCoord2f(0.0f, 0.0f);
+      glVertex3i(x, y + drawHeight, 0);
+   glEnd();
+}
+
+void RenderTarget::draw(int x, int y) const
+{
+   if(texture == 0) return;
+
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   const bool blendEnabled = GLState::isBlending();
+
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+   drawQuad(x, y, width, height);
+
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+void RenderTarget::drawWrapped(int sourceX, int sourceY, int x, int y, int drawWidth, int drawHeight) const
+{
+   if(texture == 0) return;
+
+   // The texture repeats (as textures do by default), so coordinates past its edges wrap around to the other side
+   const float left = float(sourceX) / textureWidth;
+   const float right = float(sourceX + drawWidth) / textureWidth;
+   const float top = float(height - sourceY) / textureHeight;
+   const float bottom = float(height - sourceY - drawHeight) / textureHeight;
+
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   const bool blendEnabled = GLState::isBlending();
+
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+   GLState::setTexturing(true);
+   GLState::setTextureMode(GL_REPLACE);
+   GLState::bindTexture(texture);
+
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glTexCoord2f(left, top);
+      glVertex3i(x, y, 0);
+
+      glTexCoord2f(right, top);
+      glVertex3i(x + drawWidth, y, 0);
+
+      glTexCoord2f(right, bottom);
+      glVertex3i(x + drawWidth, y + drawHeight, 0);
+
+      glTexCoord2f(left, bottom);
+      glVertex3i(x, y + drawHeight, 0);
+   glEnd();
+
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+void RenderTarget::drawOpaque(int drawWidth, int drawHeight) const
+{
+   if(texture == 0) return;
+
+   const bool blendEnabled = GLState::isBlending();
+
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   GLState::setBlending(false);
+   drawQuad(0, 0, drawWidth, drawHeight);
+
+   glPopMatrix();
+
+   GLState::setBlending(blendEnabled);
+}
+
+void RenderTarget::multiply(int drawWidth, int drawHeight) const
+{
+   if(texture == 0) return;
+
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   const bool blendEnabled = GLState::isBlending();
+
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_DST_COLOR, GL_ZERO);
+   drawQuad(0, 0, drawWidth, drawHeight);
+
+   glPopMatrix();
+
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+RenderTarget::~RenderTarget()
+{
+   if(framebuffer != 0)
+   {
+      deleteFramebuffers(1, &framebuffer);
+   }
+
+   if(depthBuffer != 0)
+   {
+      deleteRenderbuffers(1, &depthBuffer);
+   }
+
+   if(texture != 0)
+   {
+      glDeleteTextures(1, &texture);
+   }
+}
@@ -0,0 +1,210 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+typedef unsigned int GLuint;
+
+/**
+ * An offscreen layer that can be drawn into once and then drawn onto the screen as many times as needed.
+ * The layer is a texture attached to a framebuffer object. Its colours are kept premultiplied by their alpha,
+ * so that the layer looks the same drawn over the screen as its contents would have drawn straight onto it.
+ *
+ * A layer can also have a depth buffer of its own, for drawing that is ordered by the depth test (see SpriteBatch).
+ *
+ * Render targets need framebuffer objects and separate alpha blending from the driver; where those
+ * are missing, isSupported() is false and callers should draw straight to the screen instead.
+ * Render targets may only be used while the OpenGL context is current.
+ */
+class RenderTarget
+{
+   /** Whether or not the framebuffer object functions have been looked up. */
+   static bool functionsLoaded;
+
+   /** Whether or not the driver supports framebuffer objects and separate alpha blending. */
+   static bool targetsSupported;
+
+   /**
+    * Looks up the framebuffer object and separate alpha blending functions, if the driver supports them.
+    */
+   static void loadFunctions();
+
+   /** The framebuffer object that drawing is redirected into, or 0 if drawing goes to the screen. */
+   static GLuint boundFramebuffer;
+
+   /** Whether or not the layer that drawing is redirected into has a depth buffer. */
+   static bool boundDepthBuffer;
+
+   /** The number of bits in the screen's depth buffer, or a negative number if it hasn't been asked for yet. */
+   static int screenDepthBits;
+
+   /** The width of the layer (in pixels). */
+   int width;
+
+   /** The height of the layer (in pixels). */
+   int height;
+
+   /** The width and height of the layer's texture, rounded up to powers of two. */
+   int textureWidth, textureHeight;
+
+   /** Whether or not the layer is filtered smoothly when it is drawn at a different size. */
+   bool smooth;
+
+   /** Whether or not the layer should have a depth buffer. */
+   bool depth;
+
+   /** The texture holding the layer, or 0 if one hasn't been created. */
+   GLuint texture;
+
+   /** The framebuffer object that draws into the texture, or 0 if one hasn't been created. */
+   GLuint framebuffer;
+
+   /** The depth buffer attached to the framebuffer object, or 0 if the layer doesn't have one. */
+   GLuint depthBuffer;
+
+   /** The framebuffer object that drawing went to before begin() redirected it, so that end() can put it back. */
+   GLuint previousFramebuffer;
+
+   /** Whether or not the framebuffer object that drawing went to before begin() has a depth buffer. */
+   bool previousDepthBuffer;
+
+   /** The size of the part of the layer that was last drawn into (in pixels), which is what gets drawn out of it. */
+   int drawnWidth, drawnHeight;
+
+   /**
+    * Creates the layer's texture and framebuffer object, along with its depth buffer if it should have one.
+    */
+   void create();
+
+   /**
+    * Redirects drawing into the layer (creating it first if need be), without clearing it.
+    *
+    * @param scale The fraction of the layer's width and height to draw into.
+    */
+   void bind(float scale);
+
+   /**
+    * Draws the part of the layer's texture that was last drawn into (flipped, since its rows run from the bottom up)
+    * over an area, with whatever blending is in effect.
+    *
+    * @param x The x-coordinate of the area's top-left corner (in pixels).
+    * @param y The y-coordinate of the area's top-left corner (in pixels).
+    * @param drawWidth The width of the area (in pixels).
+    * @param drawHeight The height of the area (in pixels).
+    */
+   void drawQuad(int x, int y, int drawWidth, int drawHeight) const;
+
+   /** Render targets can't be copied. */
+   RenderTarget(const RenderTarget&);
+
+   /** Render targets can't be copied. */
+   RenderTarget& operator=(const RenderTarget&);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param width The width of the layer (in pixels).
+       * @param height The height of the layer (in pixels).
+       * @param smooth true iff the layer should be filtered smoothly when it is stretched (such as a layer drawn at a lower resolution than the screen).
+       * @param depth true iff the layer should have a depth buffer. If the driver can't attach one, the layer goes without.
+       */
+      RenderTarget(int width, int height, bool smooth = false, bool depth = false);
+
+      /**
+       * @return true iff the driver can draw into render targets.
+       */
+      static bool isSupported();
+
+      /**
+       * @return true iff whatever drawing goes to right now (a layer, or the screen) has a depth buffer.
+       */
+      static bool hasDepthBuffer();
+
+      /**
+       * Sets the blend function so that alpha blended drawing into the layer keeps its colours premultiplied.
+       * This has to be set again after anything else changes the blend function.
+       */
+      static void useLayerBlending();
+
+      /**
+       * Clears the layer and redirects drawing into it, until end() is called.
+       * While drawing into the layer, pixel coordinates are relative to the layer's top-left corner;
+       * the modelview matrix is left as it was. Layers can be drawn into while drawing into another layer.
+       *
+       * @param scale The fraction of the layer's width and height to draw into. Drawing keeps the same coordinates,
+       *              but lands on fewer pixels, and the smaller picture is stretched back over the layer's size when it is drawn.
+       */
+      void begin(float scale = 1.0f);
+
+      /**
+       * Redirects drawing into the layer as begin() does, but without clearing it, so that parts of it can be drawn over.
+       */
+      void resume();
+
+      /**
+       * Redirects drawing back to wherever it went before begin() was called (the screen, or another layer).
+       */
+      void end();
+
+      /**
+       * Copies what has been drawn on the screen so far into the layer, in place of what it held.
+       * The layer should be the size of the screen.
+       */
+      void capture();
+
+      /**
+       * Draws the layer over the screen, at the origin.
+       */
+      void draw() const;
+
+      /**
+       * Draws the layer with its top-left corner at a point, offset by the current modelview matrix.
+       *
+       * @param x The x-coordinate to draw the layer at (in pixels).
+       * @param y The y-coordinate to draw the layer at (in pixels).
+       */
+      void draw(int x, int y) const;
+
+      /**
+       * Draws part of the layer over an area the same size, with its top-left corner at a point, offset by the current modelview matrix.
+       * The part is taken from the layer as if the layer repeated in every direction, so it can wrap around the layer's edges;
+       * this only lines up for layers that are the size of their textures (with powers of two for their width and height).
+       *
+       * @param sourceX The x-coordinate of the part's top-left corner within the layer (in pixels).
+       * @param sourceY The y-coordinate of the part's top-left corner within the layer (in pixels).
+       * @param x The x-coordinate to draw the part at (in pixels).
+       * @param y The y-coordinate to draw the part at (in pixels).
+       * @param drawWidth The width of the part (in pixels).
+       * @param drawHeight The height of the part (in pixels).
+       */
+      void drawWrapped(int sourceX, int sourceY, int x, int y, int drawWidth, int drawHeight) const;
+
+      /**
+       * Draws the layer stretched over an area at the origin, in place of what was there (without blending).
+       *
+       * @param drawWidth The width of the area to stretch the layer over (in pixels).
+       * @param drawHeight The height of the area to stretch the layer over (in pixels).
+       */
+      void drawOpaque(int drawWidth, int drawHeight) const;
+
+      /**
+       * Multiplies the colours on the screen by the layer's colours, stretching the layer over an area at the origin.
+       * Where the layer is white, the screen is left as it is; where it is black, the screen is blacked out.
+       *
+       * @param drawWidth The width of the area to stretch the layer over (in pixels).
+       * @param drawHeight The height of the area to stretch the layer over (in pixels).
+       */
+      void multiply(int drawWidth, int drawHeight) const;
+
+      /**
+       * Destructor. Releases the layer's texture, framebuffer object and depth buffer.
+       */
+      ~RenderTarget();
+};
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "AssetArchive.h"
+#include "AssetArchiveFormat.h"
+#include <SDL.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_RES_LOAD;
+
+MappedFile AssetArchive::archive;
+const AssetArchiveFormat::Entry* AssetArchive::index = NULL;
+std::size_t AssetArchive::entryCount = 0;
+const char* AssetArchive::paths = NULL;
+bool AssetArchive::looseFilesFirst = false;
+
+/**
+ * Orders index entries by their paths, the same way that the asset packer sorts them.
+ */
+class EntryPathLess
+{
+   const char* paths;
+
+   static int compare(const char* left, std::size_t leftLength, const char* right, std::size_t rightLength)
+   {
+      const int result = memcmp(left, right, std::min(leftLength, rightLength));
+      return result != 0 ? result : (leftLength < rightLength ? -1 : (leftLength > rightLength ? 1 : 0));
+   }
+
+   public:
+      EntryPathLess(const char* paths) : paths(paths) {}
+
+      bool operator()(const AssetArchiveFormat::Entry& entry, const std::string& path) const
+      {
+         return compare(paths + SDL_SwapLE32(entry.pathOffset), SDL_SwapLE32(entry.pathLength), path.data(), path.length()) < 0;
+      }
+};
+
+void AssetArchive::mount(const std::string& archivePath)
+{
+   unmount();
+
+   archive.open(archivePath);
+   const char* const data = archive.getData();
+   const std::size_t fileSize = archive.getSize();
+
+   AssetArchiveFormat::Header header;
+   if(fileSize < sizeof(header))
+   {
+      archive.close();
+      T_T(std::string("Asset archive is too short: ") + archivePath);
+   }
+
+   memcpy(&header, data, sizeof(header));
+   const Uint32 version = SDL_SwapLE32(header.version);
+   const std::size_t count = SDL_SwapLE32(header.entryCount);
+   const std::size_t indexOffset = SDL_SwapLE32(header.indexOffset);
+   const std::size_t pathsOffset = SDL_SwapLE32(header.pathsOffset);
+
+   if(memcmp(header.magic, AssetArchiveFormat::MAGIC, sizeof(header.magic)) != 0 || version != AssetArchiveFormat::VERSION
+         || SDL_SwapLE32(header.fileSize) != fileSize || indexOffset % sizeof(Uint32) != 0
+         || indexOffset + count * sizeof(AssetArchiveFormat::Entry) > fileSize || pathsOffset > fileSize)
+   {
+      archive.close();
+      T_T(std::string("File is not an asset archive for this version of the engine, and must be repacked: ") + archivePath);
+   }
+
+   index = reinterpret_cast<const AssetArchiveFormat::Entry*>(data + indexOffset);
+   entryCount = count;
+   paths = data + pathsOffset;
+
+   for(std::size_t i = 0; i < entryCount; ++i)
+   {
+      if(pathsOffset + SDL_SwapLE32(index[i].pathOffset) + SDL_SwapLE32(index[i].pathLength) > fileSize
+            || SDL_SwapLE32(index[i].dataOffset) + SDL_SwapLE32(index[i].dataSize) > fileSize)
+      {
+         unmount();
+         T_T(std::string("Asset archive has a file that runs past its end: ") + archivePath);
+      }
+   }
+
+   DEBUG("Mounted asset archive %s with %d files.", archivePath.c_str(), static_cast<int>(entryCount));
+}
+
+void AssetArchive::unmount()
+{
+   index = NULL;
+   entryCount = 0;
+   paths = NULL;
+   archive.close();
+}
+
+bool AssetArchive::isMounted()
+{
+   return index != NULL;
+}
+
+void AssetArchive::setLooseFilesFirst(bool enabled)
+{
+   looseFilesFirst = enabled;
+}
+
+std::string AssetArchive::getPath(const AssetArchiveFormat::Entry& entry)
+{
+   return std::string(paths + SDL_SwapLE32(entry.pathOffset), SDL_SwapLE32(entry.pathLength));
+}
+
+const AssetArchiveFormat::Entry* AssetArchive::findEntry(const std::string& path)
+{
+   if(index == NULL) return NULL;
+
+   const AssetArchiveFormat::Entry* const end = index + entryCount;
+   const AssetArchiveFormat::Entry* entry = std::lower_bound(index, end, path, EntryPathLess(paths));
+   if(entry == end || SDL_SwapLE32(entry->pathLength) != path.length()
+         || memcmp(paths + SDL_SwapLE32(entry->pathOffset), path.data(), path.length()) != 0)
+   {
+      return NULL;
+   }
+
+   return entry;
+}
+
+bool AssetArchive::isLooseFile(const std::string& path)
+{
+   struct stat fileStatus;
+   return stat(path.c_str(), &fileStatus) == 0 && (fileStatus.st_mode & S_IFMT) == S_IFREG;
+}
+
+bool AssetArchive::find(const std::string& path, const char*& data, std::size_t& size)
+{
+   const AssetArchiveFormat::Entry* entry = findEntry(path);
+   if(entry == NULL || (looseFilesFirst && isLooseFile(path)))
+   {
+      return false;
+   }
+
+   data = archive.getData() + SDL_SwapLE32(entry->dataOffset);
+   size = SDL_SwapLE32(entry->dataSize);
+   return true;
+}
+
+SDL_RWops* AssetArchive::open(const std::string& path)
+{
+   const char* data;
+   std::size_t size;
+   if(find(path, data, size))
+   {
+      return SDL_RWFromConstMem(data, size);
+   }
+
+   return SDL_RWFromFile(path.c_str(), "rb");
+}
+
+bool AssetArchive::read(const std::string& path, std::vector<char>& contents)
+{
+   const char* data;
+   std::size_t size;
+   if(find(path, data, size))
+   {
+      contents.assign(data, data + size);
+      return true;
+   }
+
+   std::ifstream input(path.c_str(), std::ios::in | std::ios::binary);
+   if(!input.seekg(0, std::ios::end))
+   {
+      return false;
+   }
+
+   const std::streamoff fileSize = input.tellg();
+   if(fileSize < 0)
+   {
+      return false;
+   }
+
+   contents.resize(static_cast<std::size_t>(fileSize));
+   input.seekg(0, std::ios::beg);
+   return contents.empty() || input.read(&contents[0], contents.size());
+}
+
+bool AssetArchive::listDirectory(const std::string& directory, std::vector<std::string>& fileNames)
+{
+   fileNames.clear();
+   bool found = false;
+
+   if(index != NULL)
+   {
+      // The index is sorted by path, so the directory's files all follow the first path that starts with it
+      const AssetArchiveFormat::Entry* const end = index + entryCount;
+      for(const AssetArchiveFormat::Entry* entry = std::lower_bound(index, end, directory, EntryPathLess(paths)); entry != end; ++entry)
+      {
+         const std::string path = getPath(*entry);
+         if(path.compare(0, directory.length(), directory) != 0)
+         {
+            break;
+         }
+
+         found = true;
+         if(path.find('/', directory.length()) == std::string::npos)
+         {
+            fileNames.push_back(path.substr(directory.length()));
+         }
+      }
+   }
+
+   DIR* directoryStream = opendir(directory.c_str());
+   if(directoryStream != NULL)
+   {
+      found = true;
+      while(struct dirent* directoryEntry = readdir(directoryStream))
+      {
+         const std::string fileName(directoryEntry->d_name);
+         if(fileName != "." && fileName != "..")
+         {
+            fileNames.push_back(fileName);
+         }
+      }
+
+      closedir(directoryStream);
+   }
+
+   std::sort(fileNames.begin(), fileNames.end());
+   fileNames.erase(std::unique(fileNames.begin(), fileNames.end()), fileNames.end());
+   return found;
+}
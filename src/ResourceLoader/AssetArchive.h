@@ -0,0 +1,140 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+struct SDL_RWops;
+
+namespace AssetArchiveFormat
+{
+   struct Entry;
+};
+
+/**
+ * Serves the game's data files out of a single packed asset archive (.edp), written by the asset packer.
+ * The archive is mapped into memory once, when it is mounted, so loading an asset costs a binary search
+ * of the archive's index instead of opening a file, which is what dominates load times on slow disks and network shares.
+ *
+ * Files that aren't in the archive (or every file, if no archive is mounted) are read from the file system as before.
+ * For development, loose files can also be set to take the place of the archived files with the same paths,
+ * so that an edited file is picked up without repacking the archive.
+ *
+ * The archive is mounted before anything is loaded, and doesn't change afterwards,
+ * so assets can be read from any thread.
+ */
+class AssetArchive
+{
+   /** The mapped archive. */
+   static MappedFile archive;
+
+   /** The index of the archive, or NULL if no archive is mounted. */
+   static const AssetArchiveFormat::Entry* index;
+
+   /** The number of files in the archive. */
+   static std::size_t entryCount;
+
+   /** The paths of the files in the archive. */
+   static const char* paths;
+
+   /** Whether or not loose files take the place of the archived files with the same paths. */
+   static bool looseFilesFirst;
+
+   /**
+    * @param entry An entry in the index.
+    *
+    * @return The path of the entry's file.
+    */
+   static std::string getPath(const AssetArchiveFormat::Entry& entry);
+
+   /**
+    * @param path The path of a file.
+    *
+    * @return The index entry for the file, or NULL if the file isn't in the archive.
+    */
+   static const AssetArchiveFormat::Entry* findEntry(const std::string& path);
+
+   /**
+    * @param path The path of a file.
+    *
+    * @return true iff a loose file exists at the path.
+    */
+   static bool isLooseFile(const std::string& path);
+
+   public:
+      /**
+       * Mounts an asset archive, unmounting the archive that was mounted before.
+       * This must happen before any assets are loaded.
+       *
+       * @param archivePath The path to the archive.
+       */
+      static void mount(const std::string& archivePath);
+
+      /**
+       * Unmounts the archive, so that every file is read from the file system.
+       */
+      static void unmount();
+
+      /**
+       * @return true iff an archive is mounted.
+       */
+      static bool isMounted();
+
+      /**
+       * Sets whether or not loose files take the place of the archived files with the same paths.
+       * This costs a check of the file system for every file opened, so it is only meant for development.
+       *
+       * @param enabled true iff loose files should be used ahead of the archive.
+       */
+      static void setLooseFilesFirst(bool enabled);
+
+      /**
+       * Finds the contents of a file in the mounted archive, unless a loose file is set to take its place.
+       *
+       * @param path The path of the file.
+       * @param data Set to the contents of the file, which stay valid until the archive is unmounted.
+       * @param size Set to the size of the file (in bytes).
+       *
+       * @return true iff the file is served from the archive.
+       */
+      static bool find(const std::string& path, const char*& data, std::size_t& size);
+
+      /**
+       * Opens a file for reading through SDL, from the archive or the file system.
+       *
+       * @param path The path of the file.
+       *
+       * @return The opened file, which must be closed by the caller, or NULL if the file can't be opened.
+       */
+      static SDL_RWops* open(const std::string& path);
+
+      /**
+       * Reads the whole of a file, from the archive or the file system.
+       *
+       * @param path The path of the file.
+       * @param contents Filled with the contents of the file.
+       *
+       * @return true iff the file was read.
+       */
+      static bool read(const std::string& path, std::vector<char>& contents);
+
+      /**
+       * Lists the files directly inside a directory, in the archive and on the file system.
+       *
+       * @param directory The path of the directory, ending with a slash.
+       * @param fileNames Filled with the names of the files (without the directory's path), sorted and without duplicates.
+       *
+       * @return true iff the directory exists, in the archive or on the file system.
+       */
+      static bool listDirectory(const std::string& directory, std::vector<std::string>& fileNames);
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ASSET_ARCHIVE_FORMAT_H
+#define ASSET_ARCHIVE_FORMAT_H
+
+#include "SDL_stdinc.h"
+
+/**
+ * The layout of asset archive (.edp) files, which are written by the asset packer and mounted by AssetArchive.
+ * Every number in the file is stored in little-endian byte order. The file is laid out as:
+ *
+ * - The header below.
+ * - The index: an Entry for every file in the archive, sorted by path (comparing the path bytes as unsigned characters),
+ *   so that a file can be found with a binary search.
+ * - The paths of the files, one after another, without terminators. Paths are relative to the game's directory
+ *   and separated by forward slashes (such as "data/tilesets/forest.png"), the same as the paths the engine opens.
+ * - The contents of the files, each starting on an ALIGNMENT-byte boundary, so that the contents can be
+ *   used straight from the mapped archive (compiled maps point straight into their tiles, for instance).
+ */
+namespace AssetArchiveFormat
+{
+   /** The characters that every asset archive starts with. */
+   static const char MAGIC[4] = { 'E', 'D', 'P', '\0' };
+
+   /** The version of the format; archives written with any other version must be repacked. */
+   static const Uint32 VERSION = 1;
+
+   /** The boundary (in bytes) that the contents of every file start on. */
+   static const Uint32 ALIGNMENT = 16;
+
+   /** The header at the start of every asset archive. */
+   struct Header
+   {
+      /** The characters in MAGIC. */
+      char magic[4];
+
+      /** The format version that the archive was written with. */
+      Uint32 version;
+
+      /** The number of files in the archive. */
+      Uint32 entryCount;
+
+      /** The file offset of the index. */
+      Uint32 indexOffset;
+
+      /** The file offset of the paths. */
+      Uint32 pathsOffset;
+
+      /** The size of the whole archive. */
+      Uint32 fileSize;
+   };
+
+   /** The index entry for a file in the archive. */
+   struct Entry
+   {
+      /** The offset of the file's path, from the start of the paths. */
+      Uint32 pathOffset;
+
+      /** The length of the file's path. */
+      Uint32 pathLength;
+
+      /** The file offset of the file's contents. */
+      Uint32 dataOffset;
+
+      /** The size of the file's contents. */
+      Uint32 dataSize;
+   };
+};
+
+#endif
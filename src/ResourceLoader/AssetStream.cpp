@@ -0,0 +1,73 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "AssetStream.h"
+#include "AssetArchive.h"
+
+void AssetStream::MemoryBuffer::setData(const char* data, std::size_t size)
+{
+   // The buffer is only ever read from, so the memory is never written through the non-const pointers
+   char* start = const_cast<char*>(data);
+   setg(start, start, start + size);
+}
+
+AssetStream::MemoryBuffer::pos_type AssetStream::MemoryBuffer::seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode)
+{
+   off_type base;
+   if(direction == std::ios_base::beg)
+   {
+      base = 0;
+   }
+   else if(direction == std::ios_base::cur)
+   {
+      base = gptr() - eback();
+   }
+   else
+   {
+      base = egptr() - eback();
+   }
+
+   return seekpos(pos_type(base + offset), mode);
+}
+
+AssetStream::MemoryBuffer::pos_type AssetStream::MemoryBuffer::seekpos(pos_type position, std::ios_base::openmode mode)
+{
+   const off_type offset = off_type(position);
+   if((mode & std::ios_base::in) == 0 || offset < 0 || offset > egptr() - eback())
+   {
+      return pos_type(off_type(-1));
+   }
+
+   setg(eback(), eback() + offset, egptr());
+   return position;
+}
+
+AssetStream::AssetStream(const std::string& path, std::ios_base::openmode mode) : std::istream(NULL), opened(false)
+{
+   const char* data;
+   std::size_t size;
+   if(AssetArchive::find(path, data, size))
+   {
+      memoryBuffer.setData(data, size);
+      rdbuf(&memoryBuffer);
+      opened = true;
+   }
+   else
+   {
+      opened = fileBuffer.open(path.c_str(), mode | std::ios::in) != NULL;
+      rdbuf(&fileBuffer);
+   }
+
+   if(!opened)
+   {
+      setstate(std::ios::failbit);
+   }
+}
+
+bool AssetStream::is_open() const
+{
+   return opened;
+}
@@ -0,0 +1,70 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ASSET_STREAM_H
+#define ASSET_STREAM_H
+
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <string>
+
+/**
+ * An input stream over one of the game's data files, which reads the file straight out of
+ * the mounted asset archive if it holds the file, or from the file system otherwise (see AssetArchive).
+ * It can be used anywhere an std::ifstream was used to read a data file.
+ */
+class AssetStream : public std::istream
+{
+   /** A read-only stream buffer over a block of memory, which supports seeking. */
+   class MemoryBuffer : public std::streambuf
+   {
+      protected:
+         pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode mode);
+         pos_type seekpos(pos_type position, std::ios_base::openmode mode);
+
+      public:
+         /**
+          * Points the buffer at a block of memory, which must outlive the buffer.
+          *
+          * @param data The start of the memory.
+          * @param size The size of the memory (in bytes).
+          */
+         void setData(const char* data, std::size_t size);
+   };
+
+   /** The buffer over the file, if it is read from the file system. */
+   std::filebuf fileBuffer;
+
+   /** The buffer over the file's contents in the archive, if it is read from the archive. */
+   MemoryBuffer memoryBuffer;
+
+   /** Whether or not the file was opened. */
+   bool opened;
+
+   /** Asset streams can't be copied. */
+   AssetStream(const AssetStream&);
+
+   /** Asset streams can't be copied. */
+   AssetStream& operator=(const AssetStream&);
+
+   public:
+      /**
+       * Constructor. Opens a data file for reading; if the file can't be opened, the stream starts out failed.
+       *
+       * @param path The path of the file.
+       * @param mode The mode to open a file from the file system in.
+       */
+      AssetStream(const std::string& path, std::ios_base::openmode mode = std::ios::in);
+
+      /**
+       * @return true iff the file was opened.
+       */
+      bool is_open() const;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "BakeManifest.h"
+#include "AssetStream.h"
+#include <sstream>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_RES_LOAD;
+
+// The same as the version that the asset baker writes
+const int BakeManifest::VERSION = 1;
+
+/**
+ * Reads the rest of a manifest line, after the single space that separates it from the words before it.
+ *
+ * @param line The line being read.
+ *
+ * @return The rest of the line.
+ */
+static std::string readRestOfLine(std::istringstream& line)
+{
+   line.get();
+
+   std::string rest;
+   std::getline(line, rest);
+   return rest;
+}
+
+bool BakeManifest::load(const std::string& path)
+{
+   bakedPaths.clear();
+
+   AssetStream in(path);
+   if(!in.is_open())
+   {
+      return false;
+   }
+
+   int version = 0;
+   int missingCount = 0;
+   std::string sourcePath;
+   std::string text;
+   int lineNum = 0;
+   while(std::getline(in, text))
+   {
+      ++lineNum;
+
+      // Manifests edited on Windows may end their lines with carriage returns
+      if(!text.empty() && text[text.length() - 1] == '\r')
+      {
+         text.erase(text.length() - 1);
+      }
+
+      if(text.empty() || text[0] == '#') continue;
+
+      std::istringstream line(text);
+      std::string keyword;
+      line >> keyword;
+
+      if(keyword == "version")
+      {
+         line >> version;
+         if(version != VERSION)
+         {
+            DEBUG("Bake manifest %s has version %d, and must be baked again by this version of the engine's tools.", path.c_str(), version);
+            bakedPaths.clear();
+            return false;
+         }
+      }
+      else if(keyword == "asset" && version == VERSION)
+      {
+         std::string hash;
+         line >> hash;
+         sourcePath = readRestOfLine(line);
+      }
+      else if(keyword == "output" && !sourcePath.empty())
+      {
+         const std::string bakedPath = readRestOfLine(line);
+
+         // A manifest copied without its baked files would otherwise send the loaders to files that aren't there
+         if(AssetStream(bakedPath).is_open())
+         {
+            bakedPaths[sourcePath] = bakedPath;
+         }
+         else
+         {
+            ++missingCount;
+         }
+
+         sourcePath.clear();
+      }
+      else
+      {
+         DEBUG("Skipping unreadable line %d of bake manifest %s", lineNum, path.c_str());
+      }
+   }
+
+   DEBUG("Read bake manifest %s with %d baked assets (%d missing).", path.c_str(), static_cast<int>(bakedPaths.size()), missingCount);
+   return true;
+}
+
+bool BakeManifest::find(const std::string& sourcePath, std::string& bakedPath) const
+{
+   std::map<std::string, std::string>::const_iterator iter = bakedPaths.find(sourcePath);
+   if(iter == bakedPaths.end())
+   {
+      return false;
+   }
+
+   bakedPath = iter->second;
+   return true;
+}
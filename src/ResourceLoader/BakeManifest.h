@@ -0,0 +1,59 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef BAKE_MANIFEST_H
+#define BAKE_MANIFEST_H
+
+#include <map>
+#include <string>
+
+/**
+ * A bake manifest lists the assets that the offline asset baker (eden_bake) has compiled ahead of time, by the path
+ * of the raw asset (the source) that each was compiled from. The engine loads a baked asset in place of its source
+ * whenever the manifest lists it, and falls back to the source (or a loose compiled file beside it) otherwise.
+ *
+ * Manifests are kept as text, one record per line:
+ *
+ *    version <manifest version>
+ *    asset <input hash> <source path>
+ *    output <baked path>
+ *
+ * where each output line belongs to the asset line above it. The input hash covers everything that went into
+ * the baked asset, and only matters to the baker, which compiles an asset again once its hash changes.
+ * Blank lines and lines starting with # are skipped. The baker writes the manifest after every bake,
+ * so a source that has been edited since needs to be baked again before the engine sees the change.
+ */
+class BakeManifest
+{
+   /** The version of the manifest's layout; manifests written with any other version are ignored. */
+   static const int VERSION;
+
+   /** The path of each baked asset, by the path of its source. */
+   std::map<std::string, std::string> bakedPaths;
+
+   public:
+      /**
+       * Reads a manifest, replacing the assets listed by any manifest read before.
+       * Assets whose baked files can't be opened are left out, so that their sources are used instead.
+       *
+       * @param path The path of the manifest file.
+       *
+       * @return true iff the manifest was read.
+       */
+      bool load(const std::string& path);
+
+      /**
+       * Looks up the baked asset compiled from a source.
+       *
+       * @param sourcePath The path of the source, as the engine would open it.
+       * @param bakedPath The string to put the path of the baked asset in, if there is one.
+       *
+       * @return true iff the source has a baked asset.
+       */
+      bool find(const std::string& sourcePath, std::string& bakedPath) const;
+};
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "FileWatcher.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_RES_LOAD;
+
+// Room for a burst of changes, such as an editor saving a whole directory of files at once
+static const size_t BUFFER_SIZE = 16 << 10;
+
+FileWatcher::FileWatcher() : descriptor(-1), directoryHandle(NULL), pendingRead(NULL), buffer(BUFFER_SIZE)
+{
+}
+
+#if defined(_WIN32)
+
+/**
+ * Starts reading the next batch of changes to a directory in the background.
+ *
+ * @param directoryHandle The handle of the directory.
+ * @param pendingRead The overlapped read to start.
+ * @param buffer The buffer to read the changes into.
+ *
+ * @return true iff the read was started.
+ */
+static bool readChanges(HANDLE directoryHandle, OVERLAPPED* pendingRead, std::vector<char>& buffer)
+{
+   ResetEvent(pendingRead->hEvent);
+   return ReadDirectoryChangesW(directoryHandle, &buffer[0], buffer.size(), TRUE,
+         FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, NULL, pendingRead, NULL) != 0;
+}
+
+bool FileWatcher::watch(const std::string& directory)
+{
+   HANDLE handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+         NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+   if(handle == INVALID_HANDLE_VALUE)
+   {
+      DEBUG("Unable to watch directory %s for changes (error %lu).", directory.c_str(), GetLastError());
+      return false;
+   }
+
+   OVERLAPPED* read = new OVERLAPPED();
+   read->hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+   root = directory;
+   directoryHandle = handle;
+   pendingRead = read;
+
+   if(!readChanges(handle, read, buffer))
+   {
+      DEBUG("Unable to watch directory %s for changes (error %lu).", directory.c_str(), GetLastError());
+      return false;
+   }
+
+   DEBUG("Watching directory %s for changes.", directory.c_str());
+   return true;
+}
+
+void FileWatcher::poll(std::vector<std::string>& changedPaths)
+{
+   if(pendingRead == NULL) return;
+
+   HANDLE handle = static_cast<HANDLE>(directoryHandle);
+   OVERLAPPED* read = static_cast<OVERLAPPED*>(pendingRead);
+
+   DWORD length;
+   while(GetOverlappedResult(handle, read, &length, FALSE))
+   {
+      // A read of nothing means that more changed than fit in the buffer, and the changes were lost
+      const char* cursor = length > 0 ? &buffer[0] : NULL;
+      while(cursor != NULL)
+      {
+         const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(cursor);
+         if(info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+         {
+            const int nameLength = info->FileNameLength / sizeof(WCHAR);
+            const int pathLength = WideCharToMultiByte(CP_UTF8, 0, info->FileName, nameLength, NULL, 0, NULL, NULL);
+
+            std::string path(pathLength, '\0');
+            WideCharToMultiByte(CP_UTF8, 0, info->FileName, nameLength, &path[0], pathLength, NULL, NULL);
+            std::replace(path.begin(), path.end(), '\\', '/');
+            changedPaths.push_back(root + '/' + path);
+         }
+
+         cursor = info->NextEntryOffset != 0 ? cursor + info->NextEntryOffset : NULL;
+      }
+
+      if(!readChanges(handle, read, buffer))
+      {
+         DEBUG("Stopped watching directory %s for changes (error %lu).", root.c_str(), GetLastError());
+         break;
+      }
+   }
+}
+
+FileWatcher::~FileWatcher()
+{
+   HANDLE handle = static_cast<HANDLE>(directoryHandle);
+   OVERLAPPED* read = static_cast<OVERLAPPED*>(pendingRead);
+
+   if(handle != NULL)
+   {
+      // The read has to be finished before its buffer can go
+      CancelIo(handle);
+      DWORD length;
+      GetOverlappedResult(handle, read, &length, TRUE);
+      CloseHandle(handle);
+   }
+
+   if(read != NULL)
+   {
+      CloseHandle(read->hEvent);
+      delete read;
+   }
+}
+
+#elif defined(__linux__)
+
+/**
+ * Watches a directory and every directory under it, since inotify only watches the directories it is given.
+ *
+ * @param descriptor The inotify instance.
+ * @param path The path of the directory.
+ * @param directories The path of each watched directory, by its watch.
+ */
+static void watchDirectory(int descriptor, const std::string& path, std::map<int, std::string>& directories)
+{
+   const int watch = inotify_add_watch(descriptor, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+   if(watch < 0)
+   {
+      DEBUG("Unable to watch directory %s for changes: %s", path.c_str(), strerror(errno));
+      return;
+   }
+
+   directories[watch] = path;
+
+   DIR* dir = opendir(path.c_str());
+   if(dir == NULL) return;
+
+   struct dirent* entry;
+   while((entry = readdir(dir)) != NULL)
+   {
+      if(entry->d_name[0] == '.') continue;
+
+      const std::string childPath = path + '/' + entry->d_name;
+      struct stat fileInfo;
+      if(stat(childPath.c_str(), &fileInfo) == 0 && S_ISDIR(fileInfo.st_mode))
+      {
+         watchDirectory(descriptor, childPath, directories);
+      }
+   }
+
+   closedir(dir);
+}
+
+bool FileWatcher::watch(const std::string& directory)
+{
+   descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   if(descriptor < 0)
+   {
+      DEBUG("Unable to watch directory %s for changes: %s", directory.c_str(), strerror(errno));
+      return false;
+   }
+
+   root = directory;
+   watchDirectory(descriptor, directory, directories);
+
+   DEBUG("Watching %d directories under %s for changes.", static_cast<int>(directories.size()), directory.c_str());
+   return !directories.empty();
+}
+
+void FileWatcher::poll(std::vector<std::string>& changedPaths)
+{
+   if(descriptor < 0) return;
+
+   ssize_t length;
+   while((length = read(descriptor, &buffer[0], buffer.size())) > 0)
+   {
+      const char* cursor = &buffer[0];
+      while(cursor < &buffer[0] + length)
+      {
+         const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(cursor);
+         cursor += sizeof(struct inotify_event) + event->len;
+
+         std::map<int, std::string>::const_iterator directory = directories.find(event->wd);
+         if(directory == directories.end() || event->len == 0) continue;
+
+         const std::string path = directory->second + '/' + event->name;
+         if(event->mask & IN_ISDIR)
+         {
+            // New directories are watched too, along with whatever they already hold
+            watchDirectory(descriptor, path, directories);
+         }
+         else if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+         {
+            // Files are only reported once they have been written out in full
+            changedPaths.push_back(path);
+         }
+      }
+   }
+}
+
+FileWatcher::~FileWatcher()
+{
+   if(descriptor >= 0)
+   {
+      close(descriptor);
+   }
+}
+
+#else
+
+bool FileWatcher::watch(const std::string& directory)
+{
+   DEBUG("Unable to watch directory %s for changes: this platform can't watch files.", directory.c_str());
+   return false;
+}
+
+void FileWatcher::poll(std::vector<std::string>& changedPaths)
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Watches a directory (and every directory under it) for files that are written or moved into place,
+ * so that resources can be reloaded when their files are edited while the game runs.
+ *
+ * The watcher never blocks; changes are collected by the operating system as they happen,
+ * and handed over whenever the watcher is polled. Files are watched with inotify on Linux, and with
+ * ReadDirectoryChangesW on Windows. On other platforms, nothing can be watched.
+ */
+class FileWatcher
+{
+   /** The path of the watched directory, without a trailing slash. */
+   std::string root;
+
+   /** The inotify instance that reports the changes (on Linux), or -1 if there isn't one. */
+   int descriptor;
+
+   /** The path of each watched directory, by its inotify watch (on Linux). */
+   std::map<int, std::string> directories;
+
+   /** The handle of the watched directory (on Windows), or NULL if there isn't one. */
+   void* directoryHandle;
+
+   /** The overlapped read of the directory's changes that is in progress (on Windows), or NULL if there isn't one. */
+   void* pendingRead;
+
+   /** The buffer that the changes are read into. */
+   std::vector<char> buffer;
+
+   /** File watchers can't be copied. */
+   FileWatcher(const FileWatcher&);
+
+   /** File watchers can't be copied. */
+   FileWatcher& operator=(const FileWatcher&);
+
+   public:
+      /**
+       * Constructor. The watcher starts out watching nothing.
+       */
+      FileWatcher();
+
+      /**
+       * Starts watching a directory and every directory under it.
+       *
+       * @param directory The path of the directory to watch, with forward slashes and without a trailing slash.
+       *
+       * @return true iff the directory is being watched.
+       */
+      bool watch(const std::string& directory);
+
+      /**
+       * Collects the files that have been written or moved into place since the last poll.
+       * The same file may be listed more than once.
+       *
+       * @param changedPaths The list to add the paths of the changed files to, starting with the watched directory's path
+       *                     and separated by forward slashes.
+       */
+      void poll(std::vector<std::string>& changedPaths);
+
+      /**
+       * Destructor. Stops watching the directory.
+       */
+      ~FileWatcher();
+};
+
+#endif
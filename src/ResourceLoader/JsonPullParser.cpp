@@ -0,0 +1,446 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "JsonPullParser.h"
+#include "AssetArchive.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_RES_LOAD;
+
+// Longer than any number that can be told apart from its neighbours as a double
+static const size_t MAX_NUMBER_LENGTH = 64;
+
+/**
+ * @param c A character.
+ *
+ * @return true iff the character can be part of a number.
+ */
+static bool isNumberCharacter(char c)
+{
+   return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+JsonPullParser::JsonPullParser(const char* data, size_t size) : data(data), end(data + size), cursor(data)
+{
+   skipByteOrderMark();
+}
+
+JsonPullParser::JsonPullParser(const std::string& path) : data(NULL), end(NULL), cursor(NULL)
+{
+   std::size_t size;
+   if(!AssetArchive::find(path, data, size))
+   {
+      if(!AssetArchive::read(path, contents))
+      {
+         T_T(std::string("Error opening file: ") + path);
+      }
+
+      data = contents.empty() ? NULL : &contents[0];
+      size = contents.size();
+   }
+
+   end = data + size;
+   cursor = data;
+   skipByteOrderMark();
+}
+
+void JsonPullParser::skipByteOrderMark()
+{
+   if(end - cursor >= 3 && memcmp(cursor, "\xEF\xBB\xBF", 3) == 0)
+   {
+      cursor += 3;
+   }
+}
+
+void JsonPullParser::skipWhitespace()
+{
+   while(cursor < end)
+   {
+      if(*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')
+      {
+         ++cursor;
+      }
+      else if(*cursor == '/' && cursor + 1 < end && cursor[1] == '/')
+      {
+         cursor = std::find(cursor, end, '\n');
+      }
+      else if(*cursor == '/' && cursor + 1 < end && cursor[1] == '*')
+      {
+         const char commentEnd[] = "*/";
+         const char* closing = std::search(cursor + 2, end, commentEnd, commentEnd + 2);
+         cursor = closing == end ? end : closing + 2;
+      }
+      else
+      {
+         break;
+      }
+   }
+}
+
+void JsonPullParser::fail(const char* problem) const
+{
+   std::stringstream message;
+   message << "JSON parse error on line " << std::count(data, cursor, '\n') + 1 << ": " << problem;
+   T_T(message.str());
+}
+
+void JsonPullParser::expect(char expected)
+{
+   skipWhitespace();
+   if(cursor == end || *cursor != expected)
+   {
+      fail((std::string("expected '") + expected + "'").c_str());
+   }
+
+   ++cursor;
+}
+
+void JsonPullParser::expectKeyword(const char* keyword)
+{
+   const size_t length = strlen(keyword);
+   if(static_cast<size_t>(end - cursor) < length || memcmp(cursor, keyword, length) != 0)
+   {
+      fail("unexpected characters");
+   }
+
+   cursor += length;
+}
+
+JsonPullParser::ValueType JsonPullParser::peek()
+{
+   skipWhitespace();
+   if(cursor == end) return NONE;
+
+   switch(*cursor)
+   {
+      case '{': return OBJECT;
+      case '[': return ARRAY;
+      case '"': return STRING;
+      case 't':
+      case 'f': return BOOLEAN;
+      case 'n': return NULL_VALUE;
+      case '-': return NUMBER;
+      default: return *cursor >= '0' && *cursor <= '9' ? NUMBER : NONE;
+   }
+}
+
+bool JsonPullParser::nextInContainer(char close)
+{
+   if(containers.empty())
+   {
+      fail("read past the end of the outermost value");
+   }
+
+   skipWhitespace();
+   if(cursor < end && *cursor == close)
+   {
+      ++cursor;
+      containers.pop_back();
+      return false;
+   }
+
+   if(containers.back())
+   {
+      expect(',');
+   }
+
+   containers.back() = true;
+   return true;
+}
+
+void JsonPullParser::beginObject()
+{
+   expect('{');
+   containers.push_back(false);
+}
+
+bool JsonPullParser::nextKey(std::string& key)
+{
+   if(!nextInContainer('}'))
+   {
+      return false;
+   }
+
+   readString(key);
+   expect(':');
+   return true;
+}
+
+void JsonPullParser::beginArray()
+{
+   expect('[');
+   containers.push_back(false);
+}
+
+bool JsonPullParser::hasNextElement()
+{
+   return nextInContainer(']');
+}
+
+unsigned int JsonPullParser::readHexDigits()
+{
+   if(end - cursor < 4)
+   {
+      fail("incomplete unicode escape");
+   }
+
+   unsigned int value = 0;
+   for(int i = 0; i < 4; ++i, ++cursor)
+   {
+      const char digit = *cursor;
+      value <<= 4;
+      if(digit >= '0' && digit <= '9') value |= digit - '0';
+      else if(digit >= 'a' && digit <= 'f') value |= digit - 'a' + 10;
+      else if(digit >= 'A' && digit <= 'F') value |= digit - 'A' + 10;
+      else fail("invalid unicode escape");
+   }
+
+   return value;
+}
+
+void JsonPullParser::readString(std::string& value)
+{
+   expect('"');
+   value.clear();
+
+   for(;;)
+   {
+      // Copy the run of plain characters in one go, since most strings don't have any escapes
+      const char* runEnd = cursor;
+      while(runEnd < end && *runEnd != '"' && *runEnd != '\\')
+      {
+         ++runEnd;
+      }
+
+      value.append(cursor, runEnd);
+      cursor = runEnd;
+
+      if(cursor == end)
+      {
+         fail("unterminated string");
+      }
+
+      if(*cursor++ == '"')
+      {
+         return;
+      }
+
+      if(cursor == end)
+      {
+         fail("unterminated string");
+      }
+
+      const char escape = *cursor++;
+      switch(escape)
+      {
+         case '"':
+         case '\\':
+         case '/': value += escape; break;
+         case 'b': value += '\b'; break;
+         case 'f': value += '\f'; break;
+         case 'n': value += '\n'; break;
+         case 'r': value += '\r'; break;
+         case 't': value += '\t'; break;
+         case 'u':
+         {
+            unsigned int codePoint = readHexDigits();
+            if(codePoint >= 0xD800 && codePoint <= 0xDBFF)
+            {
+               // A character outside the basic plane is escaped as a pair of surrogates
+               if(end - cursor < 2 || cursor[0] != '\\' || cursor[1] != 'u')
+               {
+                  fail("unpaired unicode surrogate");
+               }
+
+               cursor += 2;
+               const unsigned int lowSurrogate = readHexDigits();
+               if(lowSurrogate < 0xDC00 || lowSurrogate > 0xDFFF)
+               {
+                  fail("unpaired unicode surrogate");
+               }
+
+               codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+            }
+
+            // Strings are kept in UTF-8
+            if(codePoint < 0x80)
+            {
+               value += static_cast<char>(codePoint);
+            }
+            else if(codePoint < 0x800)
+            {
+               value += static_cast<char>(0xC0 | (codePoint >> 6));
+               value += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else if(codePoint < 0x10000)
+            {
+               value += static_cast<char>(0xE0 | (codePoint >> 12));
+               value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+               value += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            else
+            {
+               value += static_cast<char>(0xF0 | (codePoint >> 18));
+               value += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+               value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+               value += static_cast<char>(0x80 | (codePoint & 0x3F));
+            }
+            break;
+         }
+         default:
+         {
+            fail("invalid escape in string");
+         }
+      }
+   }
+}
+
+std::string JsonPullParser::readString()
+{
+   std::string value;
+   readString(value);
+   return value;
+}
+
+double JsonPullParser::readDouble()
+{
+   if(peek() != NUMBER)
+   {
+      fail("expected a number");
+   }
+
+   const char* numberEnd = cursor;
+   while(numberEnd < end && isNumberCharacter(*numberEnd))
+   {
+      ++numberEnd;
+   }
+
+   if(static_cast<size_t>(numberEnd - cursor) >= MAX_NUMBER_LENGTH)
+   {
+      fail("number is too long");
+   }
+
+   // The data isn't terminated, so the number is copied out to be converted
+   char number[MAX_NUMBER_LENGTH];
+   std::copy(cursor, numberEnd, number);
+   number[numberEnd - cursor] = '\0';
+
+   char* convertedEnd;
+   const double value = strtod(number, &convertedEnd);
+   if(convertedEnd != number + (numberEnd - cursor))
+   {
+      fail("invalid number");
+   }
+
+   cursor = numberEnd;
+   return value;
+}
+
+int JsonPullParser::readInt()
+{
+   if(peek() != NUMBER)
+   {
+      fail("expected a number");
+   }
+
+   // Most numbers in the data are small integers, which are worked out here without converting them from a copy
+   const char* digit = cursor;
+   const bool negative = *digit == '-';
+   if(negative) ++digit;
+
+   long value = 0;
+   const char* digitsStart = digit;
+   while(digit < end && *digit >= '0' && *digit <= '9' && digit - digitsStart < 9)
+   {
+      value = value * 10 + (*digit - '0');
+      ++digit;
+   }
+
+   if(digit == digitsStart || (digit < end && isNumberCharacter(*digit)))
+   {
+      return static_cast<int>(readDouble());
+   }
+
+   cursor = digit;
+   return static_cast<int>(negative ? -value : value);
+}
+
+bool JsonPullParser::readBool()
+{
+   if(peek() != BOOLEAN)
+   {
+      fail("expected true or false");
+   }
+
+   const bool value = *cursor == 't';
+   expectKeyword(value ? "true" : "false");
+   return value;
+}
+
+void JsonPullParser::skipValue()
+{
+   switch(peek())
+   {
+      case OBJECT:
+      {
+         std::string key;
+         beginObject();
+         while(nextKey(key))
+         {
+            skipValue();
+         }
+         break;
+      }
+      case ARRAY:
+      {
+         beginArray();
+         while(hasNextElement())
+         {
+            skipValue();
+         }
+         break;
+      }
+      case STRING:
+      {
+         std::string value;
+         readString(value);
+         break;
+      }
+      case NUMBER:
+      {
+         readDouble();
+         break;
+      }
+      case BOOLEAN:
+      {
+         readBool();
+         break;
+      }
+      case NULL_VALUE:
+      {
+         expectKeyword("null");
+         break;
+      }
+      case NONE:
+      {
+         fail("expected a value");
+      }
+   }
+}
+
+void JsonPullParser::finish()
+{
+   skipWhitespace();
+   if(cursor != end || !containers.empty())
+   {
+      fail("unexpected data after the end of the outermost value");
+   }
+}
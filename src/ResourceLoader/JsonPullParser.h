@@ -0,0 +1,200 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef JSON_PULL_PARSER_H
+#define JSON_PULL_PARSER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Reads JSON data one value at a time, straight out of the file's contents, so that the data can be
+ * filled into the engine's own structures as it is read instead of being built into a document tree first.
+ *
+ * The caller walks the data in the order it appears in the file. An object is read with beginObject(),
+ * then nextKey() until it returns false; an array is read with beginArray(), then hasNextElement() until it
+ * returns false. The value after each key or element must be read (or skipped with skipValue()) before moving on.
+ * Comments (which jsoncpp accepts, and which the data files use) are skipped along with whitespace.
+ *
+ * Anything that doesn't match the data (such as reading a string where there is a number) throws an exception
+ * that gives the line that the problem is on.
+ */
+class JsonPullParser
+{
+   public:
+      /** The types of value that can come next in the data. */
+      enum ValueType
+      {
+         OBJECT,
+         ARRAY,
+         STRING,
+         NUMBER,
+         BOOLEAN,
+         NULL_VALUE,
+         /** There is nothing readable next (the end of the data, or something that isn't JSON). */
+         NONE,
+      };
+
+   private:
+      /** The contents of the file being read, if the parser had to read them into memory itself. */
+      std::vector<char> contents;
+
+      /** The data being read. */
+      const char* data;
+
+      /** The end of the data. */
+      const char* end;
+
+      /** The next character to read. */
+      const char* cursor;
+
+      /**
+       * Whether or not a value has already been read from each of the objects and arrays being read,
+       * innermost last, so that the values after the first are known to need commas before them.
+       */
+      std::vector<bool> containers;
+
+      /**
+       * Skips the UTF-8 byte order mark that some editors start files with, if the data starts with one.
+       */
+      void skipByteOrderMark();
+
+      /**
+       * Skips whitespace and comments.
+       */
+      void skipWhitespace();
+
+      /**
+       * Throws an exception for a problem at the current position in the data.
+       *
+       * @param problem A description of the problem.
+       */
+      void fail(const char* problem) const;
+
+      /**
+       * Reads the given character, after any whitespace.
+       *
+       * @param expected The character that must come next.
+       */
+      void expect(char expected);
+
+      /**
+       * Reads the comma before the next value in the innermost object or array, if a value has already been read from it,
+       * unless the object or array ends instead.
+       *
+       * @param close The character that closes the innermost object or array.
+       *
+       * @return true iff there is another value in the object or array; false if it has ended (and the end has been read).
+       */
+      bool nextInContainer(char close);
+
+      /**
+       * Reads four hexadecimal digits (from a \\u escape).
+       *
+       * @return The number that the digits make up.
+       */
+      unsigned int readHexDigits();
+
+      /**
+       * Reads the given keyword (such as true or false).
+       *
+       * @param keyword The keyword that must come next.
+       */
+      void expectKeyword(const char* keyword);
+
+      /** Parsers can't be copied. */
+      JsonPullParser(const JsonPullParser&);
+
+      /** Parsers can't be copied. */
+      JsonPullParser& operator=(const JsonPullParser&);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param data The JSON data to read, which must outlive the parser.
+       * @param size The size of the data (in bytes).
+       */
+      JsonPullParser(const char* data, size_t size);
+
+      /**
+       * Constructor. Reads a JSON file straight out of the asset archive if it is archived,
+       * or reads it into memory from the file system otherwise.
+       *
+       * @param path The path to the JSON file.
+       */
+      JsonPullParser(const std::string& path);
+
+      /**
+       * @return The type of the next value in the data, without reading it.
+       */
+      ValueType peek();
+
+      /**
+       * Reads the start of an object.
+       */
+      void beginObject();
+
+      /**
+       * Reads the key of the next member of the object being read, leaving its value to be read next.
+       *
+       * @param key The parameter used to return the member's key.
+       *
+       * @return true iff there is another member; false if the object has ended.
+       */
+      bool nextKey(std::string& key);
+
+      /**
+       * Reads the start of an array.
+       */
+      void beginArray();
+
+      /**
+       * Checks for another element in the array being read, leaving the element to be read next.
+       *
+       * @return true iff there is another element; false if the array has ended.
+       */
+      bool hasNextElement();
+
+      /**
+       * Reads a string.
+       *
+       * @param value The parameter used to return the string.
+       */
+      void readString(std::string& value);
+
+      /**
+       * @return The string that comes next.
+       */
+      std::string readString();
+
+      /**
+       * @return The number that comes next.
+       */
+      double readDouble();
+
+      /**
+       * @return The number that comes next, which is truncated to an integer if it has a fraction.
+       */
+      int readInt();
+
+      /**
+       * @return The boolean that comes next.
+       */
+      bool readBool();
+
+      /**
+       * Reads the next value (including everything in it, if it is an object or array) without keeping it.
+       */
+      void skipValue();
+
+      /**
+       * Checks that nothing but whitespace and comments is left in the data.
+       */
+      void finish();
+};
+
+#endif
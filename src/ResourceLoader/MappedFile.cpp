@@ -0,0 +1,131 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "MappedFile.h"
+#include "AssetArchive.h"
+#include <fstream>
+
+#ifndef _WIN32
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_RES_LOAD;
+
+MappedFile::MappedFile() : data(NULL), size(0), mapped(false), archived(false)
+{
+}
+
+void MappedFile::open(const std::string& path)
+{
+   close();
+
+#ifndef _WIN32
+   const int fileDescriptor = ::open(path.c_str(), O_RDONLY);
+   if(fileDescriptor >= 0)
+   {
+      struct stat fileStatus;
+      if(fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0)
+      {
+         void* mapping = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+         if(mapping != MAP_FAILED)
+         {
+            data = static_cast<const char*>(mapping);
+            size = fileStatus.st_size;
+            mapped = true;
+         }
+      }
+
+      // The mapping stays valid after the file is closed
+      ::close(fileDescriptor);
+
+      if(mapped)
+      {
+         return;
+      }
+   }
+
+   DEBUG("Failed to map file %s; reading it instead", path.c_str());
+#endif
+
+   std::ifstream input(path.c_str(), std::ios::in | std::ios::binary);
+   if(!input)
+   {
+      T_T(std::string("Error opening file: ") + path);
+   }
+
+   input.seekg(0, std::ios::end);
+   const std::streamoff fileSize = input.tellg();
+   input.seekg(0, std::ios::beg);
+
+   char* buffer = new char[fileSize > 0 ? static_cast<std::size_t>(fileSize) : 1];
+   if(!input.read(buffer, fileSize))
+   {
+      delete [] buffer;
+      T_T(std::string("Error reading from file: ") + path);
+   }
+
+   data = buffer;
+   size = static_cast<std::size_t>(fileSize);
+}
+
+void MappedFile::openAsset(const std::string& path)
+{
+   close();
+
+   const char* archivedData;
+   std::size_t archivedSize;
+   if(AssetArchive::find(path, archivedData, archivedSize))
+   {
+      data = archivedData;
+      size = archivedSize;
+      archived = true;
+      return;
+   }
+
+   open(path);
+}
+
+void MappedFile::close()
+{
+   if(data == NULL) return;
+
+#ifndef _WIN32
+   if(mapped)
+   {
+      munmap(const_cast<char*>(data), size);
+   }
+   else
+#endif
+   // Archived data belongs to the archive's mapping, which stays open for as long as the archive is mounted
+   if(!archived)
+   {
+      delete [] data;
+   }
+
+   data = NULL;
+   size = 0;
+   mapped = false;
+   archived = false;
+}
+
+const char* MappedFile::getData() const
+{
+   return data;
+}
+
+std::size_t MappedFile::getSize() const
+{
+   return size;
+}
+
+MappedFile::~MappedFile()
+{
+   close();
+}
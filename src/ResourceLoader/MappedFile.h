@@ -0,0 +1,81 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+/**
+ * A read-only view of a whole file in memory. Where the platform supports it, the file is
+ * memory-mapped, so that its pages are only read from disk as they are touched;
+ * otherwise, the file is read into memory with a single read.
+ */
+class MappedFile
+{
+   /** The contents of the file, or NULL if no file is open. */
+   const char* data;
+
+   /** The size of the file (in bytes). */
+   std::size_t size;
+
+   /** Whether or not the data was memory-mapped (as opposed to read into an allocated buffer). */
+   bool mapped;
+
+   /** Whether or not the data belongs to the mounted asset archive, so that it isn't released along with the file. */
+   bool archived;
+
+   /** Mapped files can't be copied. */
+   MappedFile(const MappedFile&);
+
+   /** Mapped files can't be copied. */
+   MappedFile& operator=(const MappedFile&);
+
+   public:
+      /**
+       * Constructor. No file is open until open() is called.
+       */
+      MappedFile();
+
+      /**
+       * Opens a file, closing the file that was open before.
+       *
+       * @param path The path to the file to open.
+       */
+      void open(const std::string& path);
+
+      /**
+       * Opens one of the game's data files, closing the file that was open before.
+       * If the mounted asset archive holds the file, its contents are used straight from the archive;
+       * otherwise, the file is opened as in open().
+       *
+       * @param path The path of the data file.
+       */
+      void openAsset(const std::string& path);
+
+      /**
+       * Closes the file. Any pointers into its data are no longer valid.
+       */
+      void close();
+
+      /**
+       * @return The contents of the file, or NULL if no file is open.
+       */
+      const char* getData() const;
+
+      /**
+       * @return The size of the file (in bytes).
+       */
+      std::size_t getSize() const;
+
+      /**
+       * Destructor.
+       */
+      ~MappedFile();
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "PrefetchManifest.h"
+#include "AssetStream.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_RES_LOAD;
+
+// Listed in the same order as the ResourceType enum
+const char* const PrefetchManifest::TYPE_NAMES[] = { "sound", "region", "tileset", "music", "spritesheet", "image", "font" };
+
+/**
+ * Reads the rest of a manifest line, after the single space that separates it from the keyword before it.
+ *
+ * @param line The line being read.
+ *
+ * @return The rest of the line.
+ */
+static std::string readRestOfLine(std::istringstream& line)
+{
+   line.get();
+
+   std::string rest;
+   std::getline(line, rest);
+   return rest;
+}
+
+bool PrefetchManifest::load(const std::string& path)
+{
+   AssetStream in(path);
+   if(!in.is_open())
+   {
+      return false;
+   }
+
+   const int typeCount = sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]);
+   std::string mapName;
+   std::string text;
+   int lineNum = 0;
+   while(std::getline(in, text))
+   {
+      ++lineNum;
+
+      // Manifests edited on Windows may end their lines with carriage returns
+      if(!text.empty() && text[text.length() - 1] == '\r')
+      {
+         text.erase(text.length() - 1);
+      }
+
+      if(text.empty() || text[0] == '#') continue;
+
+      std::istringstream line(text);
+      std::string keyword;
+      line >> keyword;
+
+      if(keyword == "map")
+      {
+         mapName = readRestOfLine(line);
+         maps[mapName];
+      }
+      else if(keyword == "resource" && !mapName.empty())
+      {
+         std::string typeName;
+         line >> typeName;
+
+         const int type = std::find(TYPE_NAMES, TYPE_NAMES + typeCount, typeName) - TYPE_NAMES;
+         if(type < typeCount)
+         {
+            addResource(mapName, static_cast<ResourceLoader::ResourceType>(type), readRestOfLine(line));
+         }
+         else
+         {
+            DEBUG("Unknown resource type %s on line %d of prefetch manifest %s", typeName.c_str(), lineNum, path.c_str());
+         }
+      }
+      else if(keyword == "next" && !mapName.empty())
+      {
+         addTransition(mapName, readRestOfLine(line));
+      }
+      else
+      {
+         DEBUG("Skipping unreadable line %d of prefetch manifest %s", lineNum, path.c_str());
+      }
+   }
+
+   DEBUG("Read prefetch manifest %s with %d maps.", path.c_str(), static_cast<int>(maps.size()));
+   return true;
+}
+
+bool PrefetchManifest::save(const std::string& path) const
+{
+   std::ofstream out(path.c_str());
+   if(!out)
+   {
+      return false;
+   }
+
+   out << "# Resources used on each map, and the maps visited after it, as traced from play sessions" << std::endl;
+   for(std::map<std::string, MapRecord>::const_iterator mapIter = maps.begin(); mapIter != maps.end(); ++mapIter)
+   {
+      out << std::endl << "map " << mapIter->first << std::endl;
+
+      const MapRecord& record = mapIter->second;
+      for(std::vector<ResourceEntry>::const_iterator resourceIter = record.resources.begin(); resourceIter != record.resources.end(); ++resourceIter)
+      {
+         out << "resource " << TYPE_NAMES[resourceIter->first] << ' ' << resourceIter->second << std::endl;
+      }
+
+      for(std::vector<std::string>::const_iterator nextIter = record.nextMaps.begin(); nextIter != record.nextMaps.end(); ++nextIter)
+      {
+         out << "next " << *nextIter << std::endl;
+      }
+   }
+
+   return out.good();
+}
+
+void PrefetchManifest::addResource(const std::string& mapName, ResourceLoader::ResourceType type, const std::string& name)
+{
+   std::vector<ResourceEntry>& resources = maps[mapName].resources;
+   const ResourceEntry entry(type, name);
+   if(std::find(resources.begin(), resources.end(), entry) == resources.end())
+   {
+      resources.push_back(entry);
+   }
+}
+
+void PrefetchManifest::addTransition(const std::string& fromMap, const std::string& toMap)
+{
+   std::vector<std::string>& nextMaps = maps[fromMap].nextMaps;
+   if(std::find(nextMaps.begin(), nextMaps.end(), toMap) == nextMaps.end())
+   {
+      nextMaps.push_back(toMap);
+   }
+}
+
+const PrefetchManifest::MapRecord* PrefetchManifest::getMap(const std::string& mapName) const
+{
+   std::map<std::string, MapRecord>::const_iterator mapIter = maps.find(mapName);
+   return mapIter != maps.end() ? &mapIter->second : NULL;
+}
@@ -0,0 +1,98 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PREFETCH_MANIFEST_H
+#define PREFETCH_MANIFEST_H
+
+#include "ResourceLoader.h"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A prefetch manifest records, for each map (named as "region/map"), the resources that were used
+ * while the player was on it, and the maps that the player went on to from it. The manifest is traced
+ * from play sessions (see ResourceLoader::traceResources), and used at runtime to request the resources of the
+ * maps that can come next as soon as the player enters a map, so that they are loaded by the time they are needed.
+ *
+ * Manifests are kept as text, one record per line, in the order that things were first seen:
+ *
+ *    map <region>/<map>
+ *    resource <type> <name>
+ *    next <region>/<map>
+ *
+ * where each resource and next line belongs to the map line above it, and the type is one of
+ * sound, region, tileset, music or spritesheet. Blank lines and lines starting with # are skipped.
+ */
+class PrefetchManifest
+{
+   public:
+      /** A resource, by its type and name. */
+      typedef std::pair<ResourceLoader::ResourceType, std::string> ResourceEntry;
+
+      /** What is known about a map. */
+      struct MapRecord
+      {
+         /** The resources used while the player was on the map, in the order they were first used. */
+         std::vector<ResourceEntry> resources;
+
+         /** The maps that the player went on to from the map, in the order they were first visited. */
+         std::vector<std::string> nextMaps;
+      };
+
+   private:
+      /** The name that each type of resource is written with, in the same order as the ResourceType enum. */
+      static const char* const TYPE_NAMES[];
+
+      /** The record of each map, by its name. */
+      std::map<std::string, MapRecord> maps;
+
+   public:
+      /**
+       * Reads a manifest, adding its records to the ones already held.
+       *
+       * @param path The path of the manifest file.
+       *
+       * @return true iff the manifest was read.
+       */
+      bool load(const std::string& path);
+
+      /**
+       * Writes out the manifest.
+       *
+       * @param path The path of the manifest file.
+       *
+       * @return true iff the manifest was written.
+       */
+      bool save(const std::string& path) const;
+
+      /**
+       * Records that a resource was used on a map, unless it has been recorded already.
+       *
+       * @param mapName The name of the map.
+       * @param type The type of the resource.
+       * @param name The name of the resource.
+       */
+      void addResource(const std::string& mapName, ResourceLoader::ResourceType type, const std::string& name);
+
+      /**
+       * Records that the player went from one map on to another, unless it has been recorded already.
+       *
+       * @param fromMap The name of the map that the player left.
+       * @param toMap The name of the map that the player entered.
+       */
+      void addTransition(const std::string& fromMap, const std::string& toMap);
+
+      /**
+       * @param mapName The name of a map.
+       *
+       * @return The record of the map, or NULL if nothing is known about it.
+       */
+      const MapRecord* getMap(const std::string& mapName) const;
+};
+
+#endif
@@ -5,8 +5,9 @@
  */
 
 #include "Resource.h"
+#include <SDL.h>
 
-Resource::Resource(const ResourceKey& name) : initialized(false), name(name)
+Resource::Resource(const ResourceKey& name) : initialized(false), name(name), references(0), lastUsed(0), revision(0)
 {
 }
 
@@ -21,9 +22,69 @@ void Resource::initialize(const char* path)
    initialized = true;
 }
 
+void Resource::prepare(const char* /*path*/)
+{
+}
+
 std::string Resource::getResourceName()
 {
-   return std::string(name);
+   return name.getName();
+}
+
+const ResourceKey& Resource::getKey() const
+{
+   return name;
+}
+
+void Resource::acquire()
+{
+   ++references;
+   markUsed();
+}
+
+void Resource::release()
+{
+   --references;
+   markUsed();
+}
+
+bool Resource::isInUse()
+{
+   return references > 0;
+}
+
+void Resource::markUsed()
+{
+   lastUsed = SDL_GetTicks();
+}
+
+unsigned long Resource::getLastUsed() const
+{
+   return lastUsed;
+}
+
+void Resource::swapData(Resource& /*other*/)
+{
+}
+
+void Resource::invalidate(const char* /*path*/)
+{
+}
+
+bool Resource::canReload()
+{
+   return false;
+}
+
+void Resource::replaceWith(Resource& replacement)
+{
+   swapData(replacement);
+   ++revision;
+}
+
+unsigned int Resource::getRevision() const
+{
+   return revision;
 }
 
 Resource::~Resource()
@@ -28,6 +28,14 @@
  * The ResourceLoader may attempt to reload the Resource from time to time if
  * it is in a zombie state.
  *
+ * Anything that holds on to a resource past the call that got it (such as a sprite holding its
+ * spritesheet) acquires the resource, and releases it once it is done. The ResourceLoader may evict
+ * resources that nobody holds and that aren't otherwise in use, once its memory budget is used up.
+ *
+ * Some resources can be reloaded in place when their files change (see replaceWith), so that everything
+ * holding them picks up the change without letting go of them. Holders that work anything out from a
+ * resource's data (such as a map's tile vertices) check the resource's revision to tell when to work it out again.
+ *
  * @author Noam Chitayat
  */
 class Resource
@@ -41,13 +49,30 @@ class Resource
    /**
     * The name of the resource.
     */
-   const ResourceKey& name;
+   const ResourceKey name;
+
+   /** The number of holders using the resource, which keep it from being evicted. */
+   int references;
+
+   /** The time that the resource was last used (in milliseconds since SDL was initialized). */
+   unsigned long lastUsed;
+
+   /** The number of times the resource has been reloaded in place. */
+   unsigned int revision;
 
    /**
     * Loading function for initialization of the resource from file.
     */
    virtual void load(const char* path) = 0;
 
+   /**
+    * Swaps the loaded data of this resource with that of another resource of the same type.
+    * This is only called for resources that can be reloaded (see canReload).
+    *
+    * @param other The resource to swap data with.
+    */
+   virtual void swapData(Resource& other);
+
    public:
       /**
        * Constructor.
@@ -62,6 +87,16 @@ class Resource
        */
       void initialize(const char* path);
 
+      /**
+       * Does the part of loading the resource that can be done ahead of time on a background thread,
+       * such as reading and decoding its files, so that less is left for initialize() to do.
+       * This must not touch the OpenGL context or anything else shared with the main thread.
+       * Resources that have nothing to prepare leave all of their loading to initialize().
+       *
+       * @param path The path to the resource's data.
+       */
+      virtual void prepare(const char* path);
+
       /**
        * @return true iff this resource has already been successfully loaded.
        */
@@ -73,7 +108,67 @@ class Resource
       std::string getResourceName();
 
       /**
-       * @return the size that the resource takes up in memory.
+       * @return the key that this Resource is stored under.
+       */
+      const ResourceKey& getKey() const;
+
+      /**
+       * Marks the resource as being held, so that it isn't evicted until it is released.
+       * Every call must be matched by a call to release().
+       */
+      void acquire();
+
+      /**
+       * Lets go of a hold placed on the resource by acquire().
+       */
+      void release();
+
+      /**
+       * @return true iff the resource is held or otherwise being used (such as a sound that is playing),
+       *         so that it can't be evicted.
+       */
+      virtual bool isInUse();
+
+      /**
+       * Records that the resource has just been used, so that it is evicted after resources that were used less recently.
+       */
+      void markUsed();
+
+      /**
+       * @return The time that the resource was last used (in milliseconds since SDL was initialized).
+       */
+      unsigned long getLastUsed() const;
+
+      /**
+       * Forgets anything loaded from the resource's files that is kept outside of the resource
+       * (such as its images' space in the texture atlas), so that loading the resource again reads its files afresh.
+       * The resource keeps using what it has already loaded until it is replaced.
+       *
+       * @param path The path to the resource's data.
+       */
+      virtual void invalidate(const char* path);
+
+      /**
+       * @return true iff the resource can be given freshly loaded data right now (see replaceWith).
+       *         Resources that can't be reloaded in place (or can't be at the moment, such as a sound that is playing) return false.
+       */
+      virtual bool canReload();
+
+      /**
+       * Takes the data of a freshly loaded copy of the resource, and leaves the old data in the copy, to be deleted along with it.
+       * Everything holding the resource keeps the same pointer to it throughout.
+       *
+       * @param replacement A copy of the resource, loaded from its changed files.
+       */
+      void replaceWith(Resource& replacement);
+
+      /**
+       * @return The number of times the resource has been reloaded in place, which changes whenever its data is replaced.
+       */
+      unsigned int getRevision() const;
+
+      /**
+       * @return the size that the resource takes up in memory (in bytes), including its textures.
        */
       virtual size_t getSize() = 0;
 
@@ -0,0 +1,67 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ResourceKey.h"
+
+Uint64 ResourceKey::hash(const char* name)
+{
+   // FNV-1a spreads short, similar names (like "npc1" and "npc2") well, and only needs a multiply per character
+   Uint64 result = 14695981039346656037ULL;
+   for(const unsigned char* character = reinterpret_cast<const unsigned char*>(name); *character != '\0'; ++character)
+   {
+      result ^= *character;
+      result *= 1099511628211ULL;
+   }
+
+   return result;
+}
+
+ResourceKey::ResourceKey() : id(hash(""))
+{
+}
+
+ResourceKey::ResourceKey(const char* name) : name(name), id(hash(name))
+{
+}
+
+ResourceKey::ResourceKey(const std::string& name) : name(name), id(hash(name.c_str()))
+{
+}
+
+Uint64 ResourceKey::getId() const
+{
+   return id;
+}
+
+const std::string& ResourceKey::getName() const
+{
+   return name;
+}
+
+const char* ResourceKey::c_str() const
+{
+   return name.c_str();
+}
+
+ResourceKey::operator const std::string&() const
+{
+   return name;
+}
+
+bool ResourceKey::operator==(const ResourceKey& other) const
+{
+   return id == other.id && name == other.name;
+}
+
+bool ResourceKey::operator!=(const ResourceKey& other) const
+{
+   return !(*this == other);
+}
+
+bool ResourceKey::operator<(const ResourceKey& other) const
+{
+   return id != other.id ? id < other.id : name < other.name;
+}
@@ -8,10 +8,87 @@
 #define RESOURCE_KEY_H
 
 #include <string>
+#include "SDL_stdinc.h"
 
 /**
  * A ResourceKey uniquely identifies a Resource.
+ *
+ * Along with its name, a key holds a 64-bit hash of the name, which is worked out once when the key
+ * is created. Looking a resource up by its key hashes straight to it, and comparing two keys only
+ * compares their names when their hashes match, so a key that is kept around (such as in a static)
+ * costs nothing but a table lookup each time it is used.
  */
-typedef std::string ResourceKey;
+class ResourceKey
+{
+   /** The name of the resource. */
+   std::string name;
+
+   /** The hash of the name. */
+   Uint64 id;
+
+   /**
+    * @param name The name of a resource.
+    *
+    * @return The 64-bit FNV-1a hash of the name.
+    */
+   static Uint64 hash(const char* name);
+
+   public:
+      /**
+       * Constructor. Creates the key for an empty name.
+       */
+      ResourceKey();
+
+      /**
+       * Constructor.
+       *
+       * @param name The name of the resource.
+       */
+      ResourceKey(const char* name);
+
+      /**
+       * Constructor.
+       *
+       * @param name The name of the resource.
+       */
+      ResourceKey(const std::string& name);
+
+      /**
+       * @return The hash of the resource's name.
+       */
+      Uint64 getId() const;
+
+      /**
+       * @return The name of the resource.
+       */
+      const std::string& getName() const;
+
+      /**
+       * @return The name of the resource, as a C string.
+       */
+      const char* c_str() const;
+
+      /**
+       * @return The name of the resource.
+       */
+      operator const std::string&() const;
+
+      /**
+       * @return true iff both keys are for the same name.
+       */
+      bool operator==(const ResourceKey& other) const;
+
+      /**
+       * @return true iff the keys are for different names.
+       */
+      bool operator!=(const ResourceKey& other) const;
+
+      /**
+       * Orders keys by their hashes (and by their names, if their hashes match), so that keys can be kept in sorted containers.
+       *
+       * @return true iff this key comes before the other key.
+       */
+      bool operator<(const ResourceKey& other) const;
+};
 
 #endif
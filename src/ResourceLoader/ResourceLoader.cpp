@@ -6,30 +6,90 @@
 
 #include "ResourceLoader.h"
 
+#include "AudioSystem.h"
 #include "Music.h"
 #include "Sound.h"
 #include "Tileset.h"
 #include "XRegion.h"
 #include "Spritesheet.h"
+#include "GuiImage.h"
+#include "FontFile.h"
+#include "FileWatcher.h"
+#include "PrefetchManifest.h"
+#include "FrameProfiler.h"
+#include "MemoryTracker.h"
+#include "Task.h"
 
+#include <SDL.h>
+#include <algorithm>
 #include <fstream>
 
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_RES_LOAD;
 
-const std::string ResourceLoader::PATHS[] = {"data/sounds/", "data/regions/", "data/tilesets/", "data/music/", "data/sprites/"};
-const std::string ResourceLoader::EXTENSIONS[] = {".wav", "/", "", "", ""};
+// GUI images and font files are named by their whole paths, since that is how widgets and save games already refer to them
+const std::string ResourceLoader::PATHS[] = {"data/sounds/", "data/regions/", "data/tilesets/", "data/music/", "data/sprites/", "", ""};
+const std::string ResourceLoader::EXTENSIONS[] = {".wav", "/", "", "", "", "", ""};
 
-std::map<ResourceKey, Resource*> ResourceLoader::resources;
+ResourceTable ResourceLoader::resources[ResourceLoader::TYPE_COUNT];
 
-std::string ResourceLoader::getPath(ResourceKey name, ResourceType type)
+// Sounds and regions are small, so their budgets only keep a long session from collecting every one it visits;
+// tilesets and spritesheets are mostly texture, and get enough room for a few regions' worth of images.
+// Music is decoded ahead of time (up to Music::MAX_DECODED_SIZE a song), so it gets room for the song that is playing and the next one.
+// GUI images get room for the menu backgrounds and the party's portraits, so that reopening a menu finds them still loaded.
+// The game only uses a couple of font files, and they are small, so their budget just keeps the menu's font from being read again.
+size_t ResourceLoader::budgets[] = {16 << 20, 16 << 20, 64 << 20, 32 << 20, 32 << 20, 16 << 20, 4 << 20};
+
+// The memory that each type of resource allocates as it is created and loaded is counted towards a subsystem of its own
+static const MemoryTracker::Tag MEMORY_TAGS[] = {MemoryTracker::SOUND_RESOURCES, MemoryTracker::REGION_RESOURCES, MemoryTracker::TILESET_RESOURCES,
+      MemoryTracker::MUSIC_RESOURCES, MemoryTracker::SPRITESHEET_RESOURCES, MemoryTracker::IMAGE_RESOURCES, MemoryTracker::FONT_RESOURCES};
+
+JobSystem::Counter ResourceLoader::requestCounter;
+volatile bool ResourceLoader::discardingRequests = false;
+std::map<Resource*, ResourceLoader::Request*> ResourceLoader::pendingRequests;
+
+// Editors and exporters often write a resource's files one after another (such as a tileset's image, then its data),
+// so a resource is only reloaded once its files have been left alone for a moment
+const unsigned long ResourceLoader::RELOAD_DELAY = 250;
+
+FileWatcher* ResourceLoader::fileWatcher = NULL;
+std::map<std::pair<ResourceLoader::ResourceType, ResourceKey>, unsigned long> ResourceLoader::staleResources;
+
+PrefetchManifest* ResourceLoader::manifest = NULL;
+std::string ResourceLoader::manifestPath;
+bool ResourceLoader::tracing = false;
+bool ResourceLoader::changingMap = false;
+std::string ResourceLoader::tracedMap;
+std::vector<std::pair<ResourceLoader::ResourceType, ResourceKey> > ResourceLoader::mapChangeResources;
+bool ResourceLoader::prefetching = false;
+
+// The start of a chapter is traced as a map of its own, under a name that no "region/map" name can have
+static const std::string CHAPTER_START_PREFIX = "chapter:";
+
+BakeManifest ResourceLoader::bakedAssets;
+
+std::string ResourceLoader::getPath(const ResourceKey& name, ResourceType type)
 {
-   return PATHS[type] + name + EXTENSIONS[type];
+   // Paths are only built when a resource is loaded from file, which costs far more than building them
+   std::string path;
+   path.reserve(PATHS[type].length() + name.getName().length() + EXTENSIONS[type].length());
+   path += PATHS[type];
+   path += name.getName();
+   path += EXTENSIONS[type];
+   return path;
 }
 
-Resource* ResourceLoader::loadNewResource(ResourceKey name, ResourceType type)
+Resource* ResourceLoader::createResource(const ResourceKey& name, ResourceType type)
 {
+   MemoryTracker::Scope memoryScope(MEMORY_TAGS[type]);
+
+   if(type == MUSIC || type == SOUND)
+   {
+      // Sounds and music are decoded into the device's format, so the device has to be open before they can load
+      AudioSystem::finishOpening();
+   }
+
    // Construct a new resource instance based on the resource type
    Resource* newResource = NULL;
    switch(type)
@@ -64,18 +124,39 @@ Resource* ResourceLoader::loadNewResource(ResourceKey name, ResourceType type)
          newResource = new Spritesheet(name);
          break;
       }
+      case IMAGE:
+      {
+         // Create a resource to hold a GUI image
+         newResource = new GuiImage(name);
+         break;
+      }
+      case FONT:
+      {
+         // Create a resource to hold a font file
+         newResource = new FontFile(name);
+         break;
+      }
    }
 
+   return newResource;
+}
+
+Resource* ResourceLoader::loadNewResource(const ResourceKey& name, ResourceType type)
+{
+   Resource* newResource = createResource(name, type);
+
    // Try to load the data for this resource from file
    tryInitialize(newResource, name, type);
 
-   // Place the new resource into the resource map and return it
-   resources[name] = newResource;
+   // Place the new resource into the resource table and return it
+   resources[type].insert(name, newResource);
    return newResource;
 }
 
-void ResourceLoader::tryInitialize(Resource* resource, ResourceKey name, ResourceType type)
+void ResourceLoader::tryInitialize(Resource* resource, const ResourceKey& name, ResourceType type)
 {
+   MemoryTracker::Scope memoryScope(MEMORY_TAGS[type]);
+   PROFILE_EVENT("resource load", name.c_str());
    DEBUG("Trying to initialize resource %s", name.c_str());
    // Get the path to the data for this resource
    std::string path = getPath(name, type);
@@ -93,20 +174,30 @@ void ResourceLoader::tryInitialize(Resource* resource, ResourceKey name, Resourc
    }
 }
 
-Resource* ResourceLoader::getResource(ResourceKey name, ResourceType type)
+Resource* ResourceLoader::getResource(const ResourceKey& name, ResourceType type)
 {
-   Resource* resource = NULL;
+   PROFILE_ZONE("ResourceLoader::getResource");
+   trace(name, type);
 
-   if(resources.find(name) == resources.end())
+   Resource* resource = resources[type].find(name);
+   Request* pendingRequest = NULL;
+
+   if(resource == NULL)
    {
-      // If the resource is not already in the resource map, it is not
+      // If the resource is not already in the resource table, it is not
       // currently being cached. Construct a resource and load the data.
       resource = loadNewResource(name, type);
    }
+   else if((pendingRequest = findRequest(resource)) != NULL)
+   {
+      // The resource was requested ahead of time, but it is needed now
+      DEBUG("Resource %s is needed before it has finished loading; waiting for it.", name.c_str());
+      PROFILE_EVENT("resource wait", name.c_str());
+      waitForRequest(pendingRequest);
+   }
    else
    {
       // If the resource is cached, check that it is already initialized.
-      resource = resources[name];
       if(!resource->isInitialized())
       {
          // If it is not (because of a prior failure to initialize),
@@ -115,41 +206,524 @@ Resource* ResourceLoader::getResource(ResourceKey name, ResourceType type)
       }
    }
 
+   resource->markUsed();
    return resource;
 }
 
-Music* ResourceLoader::getMusic(ResourceKey name)
+Music* ResourceLoader::getMusic(const ResourceKey& name)
 {
    return static_cast<Music*>(getResource(name, MUSIC));
 }
 
-Sound* ResourceLoader::getSound(ResourceKey name)
+Sound* ResourceLoader::getSound(const ResourceKey& name)
 {
    return static_cast<Sound*>(getResource(name, SOUND));
 }
 
-Tileset* ResourceLoader::getTileset(ResourceKey name)
+Tileset* ResourceLoader::getTileset(const ResourceKey& name)
 {
    return static_cast<Tileset*>(getResource(name, TILESET));
 }
 
-Region* ResourceLoader::getRegion(ResourceKey name)
+Region* ResourceLoader::getRegion(const ResourceKey& name)
 {
    return static_cast<Region*>(getResource(name, REGION));
 }
 
-Spritesheet* ResourceLoader::getSpritesheet(ResourceKey name)
+Spritesheet* ResourceLoader::getSpritesheet(const ResourceKey& name)
 {
    return static_cast<Spritesheet*>(getResource(name, SPRITESHEET));
 }
 
+GuiImage* ResourceLoader::getGuiImage(const ResourceKey& name)
+{
+   return static_cast<GuiImage*>(getResource(name, IMAGE));
+}
+
+FontFile* ResourceLoader::getFontFile(const ResourceKey& name)
+{
+   return static_cast<FontFile*>(getResource(name, FONT));
+}
+
+ResourceLoader::Request::Request() : JobSystem::Job(true), resource(NULL), type(SOUND)
+{
+}
+
+void ResourceLoader::Request::run(int /*slot*/)
+{
+   if(!discardingRequests)
+   {
+      prepare(*this);
+   }
+}
+
+void ResourceLoader::Request::finalize()
+{
+   finishRequest(this);
+
+   for(std::vector<Task*>::iterator iter = tasks.begin(); iter != tasks.end(); ++iter)
+   {
+      (*iter)->signal();
+   }
+}
+
+void ResourceLoader::discardRequests()
+{
+   // The requests that no worker has started on are run and finalized here, without being prepared or finished
+   discardingRequests = true;
+   JobSystem::wait(requestCounter);
+   discardingRequests = false;
+}
+
+void ResourceLoader::prepare(Request& request)
+{
+   MemoryTracker::Scope memoryScope(MEMORY_TAGS[request.type]);
+   const std::string path = getPath(request.name, request.type);
+
+   try
+   {
+      request.resource->prepare(path.c_str());
+   }
+   catch(Exception& e)
+   {
+      // Loading the resource on the main thread will fail (or succeed) on its own
+      DEBUG("Failed to prepare resource %s.\n\tReason: %s", path.c_str(), e.getMessage().c_str());
+   }
+}
+
+void ResourceLoader::finishRequest(Request* request)
+{
+   pendingRequests.erase(request->resource);
+
+   // The resources of discarded requests are left uninitialized, since they are about to be freed
+   if(!discardingRequests)
+   {
+      DEBUG("Finishing background load of resource %s.", request->name.c_str());
+      tryInitialize(request->resource, request->name, request->type);
+   }
+}
+
+ResourceLoader::Request* ResourceLoader::findRequest(Resource* resource)
+{
+   std::map<Resource*, Request*>::iterator request = pendingRequests.find(resource);
+   return request == pendingRequests.end() ? NULL : request->second;
+}
+
+void ResourceLoader::waitForRequest(Request* request)
+{
+   // The job system prepares the resource here if no worker has started on it, then finalizes the request
+   JobSystem::wait(request);
+}
+
+Resource* ResourceLoader::request(const ResourceKey& name, ResourceType type, Task* task)
+{
+   trace(name, type);
+
+   Resource* existingResource = resources[type].find(name);
+   if(existingResource != NULL)
+   {
+      Request* pendingRequest = findRequest(existingResource);
+      if(pendingRequest != NULL)
+      {
+         if(task != NULL)
+         {
+            pendingRequest->tasks.push_back(task);
+         }
+
+         return existingResource;
+      }
+
+      if(existingResource->isInitialized())
+      {
+         if(task != NULL)
+         {
+            task->signal();
+         }
+
+         return existingResource;
+      }
+   }
+
+   if(JobSystem::getWorkerCount() == 0)
+   {
+      Resource* resource = getResource(name, type);
+      if(task != NULL)
+      {
+         task->signal();
+      }
+
+      return resource;
+   }
+
+   // Resources that failed to load before get another attempt, just as they would in getResource
+   Resource* resource = existingResource;
+   if(resource == NULL)
+   {
+      resource = createResource(name, type);
+      resources[type].insert(name, resource);
+   }
+
+   resource->markUsed();
+
+   Request* request = new Request();
+   request->resource = resource;
+   request->name = name;
+   request->type = type;
+   if(task != NULL)
+   {
+      request->tasks.push_back(task);
+   }
+
+   pendingRequests[resource] = request;
+
+   DEBUG("Queueing resource %s to be loaded in the background.", name.c_str());
+   JobSystem::submit(request, &requestCounter);
+
+   return resource;
+}
+
+bool ResourceLoader::isLoading(const ResourceKey& name, ResourceType type)
+{
+   Resource* resource = resources[type].find(name);
+   return resource != NULL && findRequest(resource) != NULL;
+}
+
+bool ResourceLoader::watchFiles(const std::string& directory)
+{
+   if(fileWatcher == NULL)
+   {
+      fileWatcher = new FileWatcher();
+      if(!fileWatcher->watch(directory))
+      {
+         delete fileWatcher;
+         fileWatcher = NULL;
+      }
+   }
+
+   return fileWatcher != NULL;
+}
+
+bool ResourceLoader::loadManifest(const std::string& path, bool traceResources)
+{
+   if(manifest == NULL)
+   {
+      manifest = new PrefetchManifest();
+   }
+
+   manifestPath = path;
+   tracing = traceResources;
+
+   // A traced manifest adds to what earlier sessions recorded
+   const bool loaded = manifest->load(path);
+   if(!loaded)
+   {
+      DEBUG("No prefetch manifest found at %s.", path.c_str());
+   }
+
+   return loaded;
+}
+
+bool ResourceLoader::loadBakeManifest(const std::string& path)
+{
+   const bool loaded = bakedAssets.load(path);
+   if(!loaded)
+   {
+      DEBUG("No bake manifest found at %s; every asset will be loaded from its source.", path.c_str());
+   }
+
+   return loaded;
+}
+
+bool ResourceLoader::findBakedAsset(const std::string& sourcePath, std::string& bakedPath)
+{
+   return bakedAssets.find(sourcePath, bakedPath);
+}
+
+void ResourceLoader::trace(const ResourceKey& name, ResourceType type)
+{
+   if(!tracing || prefetching) return;
+
+   if(changingMap || tracedMap.empty())
+   {
+      mapChangeResources.push_back(std::make_pair(type, name));
+   }
+   else
+   {
+      manifest->addResource(tracedMap, type, name);
+   }
+}
+
+void ResourceLoader::beginMapChange()
+{
+   changingMap = true;
+}
+
+void ResourceLoader::beginChapter(const std::string& chapterName)
+{
+   if(tracing)
+   {
+      // Nothing loaded before the chapter started is needed for it
+      mapChangeResources.clear();
+      tracedMap = CHAPTER_START_PREFIX + chapterName;
+   }
+
+   changingMap = true;
+}
+
+void ResourceLoader::prefetchChapter(const std::string& chapterName)
+{
+   prefetchNextMaps(CHAPTER_START_PREFIX + chapterName);
+}
+
+void ResourceLoader::enterMap(const std::string& mapName)
+{
+   if(tracing)
+   {
+      // Whatever was loaded on the way into the map is needed to enter it
+      for(std::vector<std::pair<ResourceType, ResourceKey> >::const_iterator iter = mapChangeResources.begin(); iter != mapChangeResources.end(); ++iter)
+      {
+         manifest->addResource(mapName, iter->first, iter->second.getName());
+      }
+
+      if(!tracedMap.empty() && tracedMap != mapName)
+      {
+         manifest->addTransition(tracedMap, mapName);
+      }
+
+      mapChangeResources.clear();
+      tracedMap = mapName;
+   }
+
+   changingMap = false;
+   prefetchNextMaps(mapName);
+}
+
+void ResourceLoader::prefetchNextMaps(const std::string& mapName)
+{
+   const PrefetchManifest::MapRecord* record = manifest != NULL ? manifest->getMap(mapName) : NULL;
+   if(record == NULL) return;
+
+   prefetching = true;
+   for(std::vector<std::string>::const_iterator nextIter = record->nextMaps.begin(); nextIter != record->nextMaps.end(); ++nextIter)
+   {
+      const PrefetchManifest::MapRecord* nextRecord = manifest->getMap(*nextIter);
+      if(nextRecord == NULL) continue;
+
+      DEBUG("Prefetching %d resources for map %s.", static_cast<int>(nextRecord->resources.size()), nextIter->c_str());
+      for(std::vector<PrefetchManifest::ResourceEntry>::const_iterator resourceIter = nextRecord->resources.begin(); resourceIter != nextRecord->resources.end(); ++resourceIter)
+      {
+         request(resourceIter->second, resourceIter->first);
+      }
+   }
+
+   prefetching = false;
+}
+
+void ResourceLoader::markStale(const std::string& path)
+{
+   std::vector<Resource*> typeResources;
+   for(int type = 0; type < TYPE_COUNT; ++type)
+   {
+      if(path.compare(0, PATHS[type].length(), PATHS[type]) != 0) continue;
+
+      typeResources.clear();
+      resources[type].getResources(typeResources);
+      for(std::vector<Resource*>::iterator iter = typeResources.begin(); iter != typeResources.end(); ++iter)
+      {
+         // A resource's files are at its path, or at its path with an extension added, or in its directory (for regions)
+         const std::string resourcePath = getPath((*iter)->getKey(), static_cast<ResourceType>(type));
+         if(path.compare(0, resourcePath.length(), resourcePath) == 0
+               && (path.length() == resourcePath.length() || path[resourcePath.length()] == '.' || resourcePath[resourcePath.length() - 1] == '/'))
+         {
+            DEBUG("Resource %s is stale, since %s changed.", (*iter)->getKey().c_str(), path.c_str());
+            staleResources[std::make_pair(static_cast<ResourceType>(type), (*iter)->getKey())] = SDL_GetTicks();
+         }
+      }
+   }
+}
+
+void ResourceLoader::reloadStaleResources()
+{
+   std::vector<std::string> changedPaths;
+   fileWatcher->poll(changedPaths);
+   for(std::vector<std::string>::const_iterator iter = changedPaths.begin(); iter != changedPaths.end(); ++iter)
+   {
+      markStale(*iter);
+   }
+
+   const unsigned long now = SDL_GetTicks();
+   std::map<std::pair<ResourceType, ResourceKey>, unsigned long>::iterator iter = staleResources.begin();
+   while(iter != staleResources.end())
+   {
+      const ResourceType type = iter->first.first;
+      const ResourceKey& name = iter->first.second;
+      Resource* resource = resources[type].find(name);
+
+      if(resource == NULL)
+      {
+         // The resource was evicted, so it will read its new files whenever it is loaded again
+         staleResources.erase(iter++);
+      }
+      else if(now - iter->second < RELOAD_DELAY || findRequest(resource) != NULL
+            || (resource->isInitialized() && !resource->canReload()))
+      {
+         ++iter;
+      }
+      else
+      {
+         reload(resource, name, type);
+         staleResources.erase(iter++);
+      }
+   }
+}
+
+void ResourceLoader::reload(Resource* resource, const ResourceKey& name, ResourceType type)
+{
+   const std::string path = getPath(name, type);
+   resource->invalidate(path.c_str());
+
+   if(!resource->isInitialized())
+   {
+      // A resource that failed to load has no data for anything to be using, so it is simply loaded again
+      tryInitialize(resource, name, type);
+      return;
+   }
+
+   DEBUG("Reloading resource %s, since its files have changed.", name.c_str());
+   Resource* replacement = createResource(name, type);
+   tryInitialize(replacement, name, type);
+
+   if(replacement->isInitialized())
+   {
+      resource->replaceWith(*replacement);
+   }
+   else
+   {
+      DEBUG("Keeping the old data of resource %s, since its new files failed to load.", name.c_str());
+   }
+
+   delete replacement;
+}
+
+void ResourceLoader::finishRequests()
+{
+   PROFILE_ZONE("ResourceLoader::finishRequests");
+
+   if(fileWatcher != NULL)
+   {
+      reloadStaleResources();
+   }
+
+   reclaim();
+}
+
+void ResourceLoader::reclaim()
+{
+   std::vector<Resource*> typeResources;
+   std::vector<std::pair<unsigned long, Resource*> > candidates;
+
+   for(int type = 0; type < TYPE_COUNT; ++type)
+   {
+      typeResources.clear();
+      resources[type].getResources(typeResources);
+
+      size_t memoryUsed = 0;
+      for(std::vector<Resource*>::iterator iter = typeResources.begin(); iter != typeResources.end(); ++iter)
+      {
+         memoryUsed += (*iter)->getSize();
+      }
+
+      if(memoryUsed <= budgets[type]) continue;
+
+      candidates.clear();
+      for(std::vector<Resource*>::iterator iter = typeResources.begin(); iter != typeResources.end(); ++iter)
+      {
+         if(!(*iter)->isInUse() && findRequest(*iter) == NULL)
+         {
+            candidates.push_back(std::make_pair((*iter)->getLastUsed(), *iter));
+         }
+      }
+
+      // Evict the least recently used resources first, until the type fits in its budget
+      std::sort(candidates.begin(), candidates.end());
+      for(std::vector<std::pair<unsigned long, Resource*> >::iterator iter = candidates.begin(); iter != candidates.end() && memoryUsed > budgets[type]; ++iter)
+      {
+         Resource* resource = iter->second;
+         const size_t size = resource->getSize();
+         DEBUG("Evicting resource %s (%u bytes), which hasn't been used recently.", resource->getKey().c_str(), static_cast<unsigned int>(size));
+
+         memoryUsed -= std::min(size, memoryUsed);
+         resources[type].erase(resource->getKey());
+         delete resource;
+      }
+   }
+}
+
+void ResourceLoader::setBudget(ResourceType type, size_t bytes)
+{
+   budgets[type] = bytes;
+}
+
+size_t ResourceLoader::getMemoryUsed(ResourceType type)
+{
+   std::vector<Resource*> typeResources;
+   resources[type].getResources(typeResources);
+
+   size_t memoryUsed = 0;
+   for(std::vector<Resource*>::iterator iter = typeResources.begin(); iter != typeResources.end(); ++iter)
+   {
+      memoryUsed += (*iter)->getSize();
+   }
+
+   return memoryUsed;
+}
+
 void ResourceLoader::freeAll()
 {
-   // Iterate through the resource map and clear out all of the cached resources
-   for(std::map<ResourceKey, Resource*>::iterator i = resources.begin(); i != resources.end(); ++i)
+   // The workers may still be preparing resources that are about to be deleted
+   discardRequests();
+
+   if(manifest != NULL)
+   {
+      if(tracing && !manifest->save(manifestPath))
+      {
+         DEBUG("Failed to write prefetch manifest %s.", manifestPath.c_str());
+      }
+
+      delete manifest;
+      manifest = NULL;
+   }
+
+   tracing = false;
+   changingMap = false;
+   tracedMap.clear();
+   mapChangeResources.clear();
+
+   delete fileWatcher;
+   fileWatcher = NULL;
+   staleResources.clear();
+
+   // Regions go first, since their maps release the tilesets and spritesheets they hold as they are deleted
+   std::vector<Resource*> allResources;
+   resources[REGION].getResources(allResources);
+   for(int type = 0; type < TYPE_COUNT; ++type)
+   {
+      if(type != REGION)
+      {
+         resources[type].getResources(allResources);
+      }
+   }
+
+   // Iterate through the resource tables and clear out all of the cached resources
+   for(std::vector<Resource*>::iterator i = allResources.begin(); i != allResources.end(); ++i)
+   {
+      delete (*i);
+   }
+
+   for(int type = 0; type < TYPE_COUNT; ++type)
    {
-      delete (i->second);
+      resources[type].clear();
    }
 
-   resources.clear();
+   MemoryTracker::reportLeaks("ResourceLoader::freeAll", MemoryTracker::SOUND_RESOURCES, MemoryTracker::FONT_RESOURCES);
 }
@@ -7,9 +7,14 @@
 #ifndef RESOURCE_LOADER_H
 #define RESOURCE_LOADER_H
 
+#include <list>
 #include <map>
 #include <string>
+#include <vector>
+#include "BakeManifest.h"
 #include "ResourceKey.h"
+#include "ResourceTable.h"
+#include "JobSystem.h"
 #include "SDL_mixer.h"
 
 class Resource;
@@ -18,34 +23,123 @@ class Sound;
 class Region;
 class Tileset;
 class Spritesheet;
+class GuiImage;
+class FontFile;
+class FileWatcher;
+class PrefetchManifest;
+class Task;
 
 /**
  * Responsible for loading (eventually caching and even preloading!) data resources such as
  * tilesets, maps, music, and anything else loaded from the file system for use in the game.
  *
+ * Resources can also be requested ahead of their first use (such as by a script, during a scene),
+ * so that they don't hitch the frame they are first used in. A requested resource is handed back
+ * right away, uninitialized; a job on one of the job system's workers prepares it (reading and decoding its files),
+ * and the main thread finishes loading it (including anything that touches the OpenGL context)
+ * when the job is finalized at the start of a later frame. Getting a resource that is still being prepared waits for it.
+ *
+ * Each type of resource is kept in a hash table of its own, so resources of different types can share a name.
+ * The resource tables themselves are only ever touched on the main thread.
+ *
+ * Each type of resource has a memory budget. Once the resources of a type take up more memory than
+ * their budget, the ones that nobody holds (see Resource::acquire) are evicted, starting with the least
+ * recently used, until the type fits within its budget again. An evicted resource is simply loaded
+ * again the next time it is needed.
+ *
+ * While the data directory is being watched (see watchFiles), resources whose files change are reloaded
+ * in place at the start of a frame, once their files have settled. Resources that can't be reloaded in place
+ * (see Resource::canReload) are left as they are, and pick up their new files the next time they are loaded.
+ *
+ * With a prefetch manifest loaded (see loadManifest), entering a map requests the resources that were used on the maps
+ * that the player has gone on to from it before. The manifest is traced from play sessions: while tracing, the resources
+ * used on each map are recorded (along with the maps visited after it), and written out when the resources are freed.
+ * The start of each chapter is traced like a map of its own (see beginChapter), which leads on to the chapter's first map,
+ * so the first map's resources can be prefetched before the chapter has even started (see prefetchChapter).
+ *
+ * With a bake manifest loaded (see loadBakeManifest), the assets that the asset baker has compiled ahead of time
+ * are loaded in place of the raw assets they were compiled from (see findBakedAsset).
+ *
  * @author Noam Chitayat
  */
 class ResourceLoader
 {
+   public:
+      /**
+       * The ResourceLoader handles loading and caching of multiple
+       * types of resources. This enum contains the types of resources
+       * available.
+       */
+      enum ResourceType
+      {
+         /** Sound effects to be played during gameplay */
+         SOUND,
+         /** Locations and maps navigated via the TileEngine */
+         REGION,
+         /** Sets of tiles that may be drawn via the TileEngine */
+         TILESET,
+         /** Pieces of music to be played in the game background */
+         MUSIC,
+         /** Sheets of sprites that can be drawn on screen to represent moving objects */
+         SPRITESHEET,
+         /** Images shown by the GUI, such as menu backgrounds and character portraits */
+         IMAGE,
+         /** True Type font files, shared by every size of font opened from them */
+         FONT,
+      };
+
+   private:
+   /** The number of types of resources in the ResourceType enum. */
+   static const int TYPE_COUNT = 7;
+
    /**
-    * The ResourceLoader handles loading and caching of multiple
-    * types of resources. This enum contains the types of resources
-    * available.
+    * A resource that has been requested, but hasn't finished loading.
+    * The resource is prepared when the request is run as a job, and finished when the job is finalized on the main thread.
     */
-   enum ResourceType
+   struct Request : public JobSystem::Job
    {
-      /** Sound effects to be played during gameplay */
-      SOUND,
-      /** Locations and maps navigated via the TileEngine */
-      REGION,
-      /** Sets of tiles that may be drawn via the TileEngine */
-      TILESET,
-      /** Pieces of music to be played in the game background */
-      MUSIC,
-      /** Sheets of sprites that can be drawn on screen to represent moving objects */
-      SPRITESHEET,
+      /** The requested resource. */
+      Resource* resource;
+
+      /** The name of the resource. */
+      ResourceKey name;
+
+      /** The type of the resource. */
+      ResourceType type;
+
+      /** The tasks of the scripts waiting for the resource to finish loading. */
+      std::vector<Task*> tasks;
+
+      /**
+       * Constructor.
+       */
+      Request();
+
+      /**
+       * Prepares the resource, unless the requests are being discarded.
+       *
+       * @param slot Unused.
+       */
+      void run(int slot);
+
+      /**
+       * Finishes loading the prepared resource, forgets the request, and signals the tasks waiting on it.
+       */
+      void finalize();
    };
 
+   /** Requests are prepared and finished through the loader. */
+   friend struct Request;
+
+   /** Counts the requests that haven't been finished yet. */
+   static JobSystem::Counter requestCounter;
+
+   /** Whether or not the requests are being discarded, in which case they are neither prepared nor finished. */
+   static volatile bool discardingRequests;
+
+   /** Every request that hasn't been finished yet, by its resource (only touched on the main thread). */
+   static std::map<Resource*, Request*> pendingRequests;
+
    /** 
     *  A list of paths to various kinds of resources, in the same order as the
     *  ResourceType enum.
@@ -58,8 +152,104 @@ class ResourceLoader
     */
    static const std::string EXTENSIONS[];
 
-   /** A map to hold all the currently loaded resources, organized by key */
-   static std::map<ResourceKey, Resource*> resources;
+   /** A table for each type of resource to hold all the currently loaded resources of that type, organized by key */
+   static ResourceTable resources[TYPE_COUNT];
+
+   /** The memory budget for each kind of resource (in bytes), in the same order as the ResourceType enum. */
+   static size_t budgets[];
+
+   /** The time (in milliseconds) that a resource's files have to go unchanged before the resource is reloaded. */
+   static const unsigned long RELOAD_DELAY;
+
+   /** The watcher of the data directory, or NULL if files aren't being watched. */
+   static FileWatcher* fileWatcher;
+
+   /** The type and name of each loaded resource whose files have changed, along with the time they last changed. */
+   static std::map<std::pair<ResourceType, ResourceKey>, unsigned long> staleResources;
+
+   /** The prefetch manifest, or NULL if none has been loaded. */
+   static PrefetchManifest* manifest;
+
+   /** The path of the prefetch manifest, which a traced manifest is written back to. */
+   static std::string manifestPath;
+
+   /** Whether or not resource use is being traced into the manifest. */
+   static bool tracing;
+
+   /** Whether or not the player is between maps, in which case the traced resources are held until the next map is known. */
+   static bool changingMap;
+
+   /** The map that traced resources are recorded on, or empty if no map has been entered yet. */
+   static std::string tracedMap;
+
+   /** The resources used since the player started changing maps, which belong to the map being entered. */
+   static std::vector<std::pair<ResourceType, ResourceKey> > mapChangeResources;
+
+   /** Whether or not the resources of the maps that can come next are being requested (which aren't traced). */
+   static bool prefetching;
+
+   /** The assets baked ahead of time, which is empty if no bake manifest has been loaded. */
+   static BakeManifest bakedAssets;
+
+   /**
+    * Records the use of a resource in the prefetch manifest, if resource use is being traced.
+    *
+    * @param name The name of the resource.
+    * @param type The type of resource.
+    */
+   static void trace(const ResourceKey& name, ResourceType type);
+
+   /**
+    * Requests the resources of the maps that the player has gone on to from a map before.
+    *
+    * @param mapName The name of the map.
+    */
+   static void prefetchNextMaps(const std::string& mapName);
+
+   /**
+    * Marks the loaded resources that a changed file belongs to as stale.
+    *
+    * @param path The path of the changed file.
+    */
+   static void markStale(const std::string& path);
+
+   /**
+    * Collects the files that have changed since the last frame, and reloads the stale resources whose files have settled.
+    */
+   static void reloadStaleResources();
+
+   /**
+    * Reloads a resource from its files, replacing its data in place if it was loaded.
+    * If the files fail to load, the resource keeps its old data.
+    *
+    * @param resource The resource to reload.
+    * @param name The name of the resource.
+    * @param type The type of resource.
+    */
+   static void reload(Resource* resource, const ResourceKey& name, ResourceType type);
+
+   /**
+    * Evicts the least recently used resources that aren't in use or loading,
+    * from every type of resource that takes up more memory than its budget.
+    */
+   static void reclaim();
+
+   /**
+    * @param resource A resource.
+    *
+    * @return The unfinished request for the resource, or NULL if it isn't loading in the background.
+    */
+   static Request* findRequest(Resource* resource);
+
+   /**
+    * Constructs an uninitialized resource of a given type.
+    *
+    * @param name The name of the resource.
+    * @param type The ResourceType of the resource.
+    *
+    * @return A pointer to the created resource.
+    */
+   static Resource* createResource(const ResourceKey& name, ResourceType type);
 
    /**
     * Create a resource specified by the given unique key-type pair, and load
@@ -71,7 +261,7 @@ class ResourceLoader
     *
     * @return A pointer to the created resource.
     */
-   static Resource* loadNewResource(ResourceKey name, ResourceType type);
+   static Resource* loadNewResource(const ResourceKey& name, ResourceType type);
 
    /**
     * Attempts to initialize the resource by loading its data from file.
@@ -82,7 +272,7 @@ class ResourceLoader
     * @param name The name of the resource.
     * @param type The type of resource.
     */
-   static void tryInitialize(Resource* resource, ResourceKey name, ResourceType type);
+   static void tryInitialize(Resource* resource, const ResourceKey& name, ResourceType type);
 
    /**
     * Get the path to a certain resource based on its name and type.
@@ -92,7 +282,7 @@ class ResourceLoader
     *
     * @return A relative path to the resource "name"
     */
-   static std::string getPath(ResourceKey name, ResourceType type);
+   static std::string getPath(const ResourceKey& name, ResourceType type);
 
    /**
     * Get a resource of a certain name and type. If the resource is not cached
@@ -103,9 +293,152 @@ class ResourceLoader
     *
     * @return A pointer to the resource requested.
     */
-   static Resource* getResource(ResourceKey name, ResourceType type);
+   static Resource* getResource(const ResourceKey& name, ResourceType type);
+
+   /**
+    * Discards every request that hasn't been finished, waiting for the ones that are being prepared.
+    * The requested resources are left uninitialized.
+    */
+   static void discardRequests();
+
+   /**
+    * Prepares a requested resource. If the resource fails to prepare, it is left for initialize() to load from scratch.
+    *
+    * @param request The request holding the resource.
+    */
+   static void prepare(Request& request);
+
+   /**
+    * Finishes loading a prepared resource and forgets its request.
+    *
+    * @param request The request holding the resource, which is deleted by the job system once it is finalized.
+    */
+   static void finishRequest(Request* request);
+
+   /**
+    * Finishes loading a requested resource right away, preparing it on the calling thread
+    * if no worker has started on it, or waiting for its worker to finish with it otherwise.
+    *
+    * @param request The request holding the resource, which is deleted.
+    */
+   static void waitForRequest(Request* request);
 
    public:
+      /**
+       * Requests a resource ahead of its first use, so that it loads in the background.
+       * If the job system has no workers, the resource is loaded right away.
+       *
+       * @param name The name of the resource.
+       * @param type The type of resource.
+       * @param task A task to signal once the resource has finished loading (or failed to), or NULL if nothing waits on it.
+       *
+       * @return The requested resource, which stays uninitialized until it has finished loading.
+       */
+      static Resource* request(const ResourceKey& name, ResourceType type, Task* task = NULL);
+
+      /**
+       * @param name The name of a resource.
+       * @param type The type of resource.
+       *
+       * @return true iff the resource has been requested but hasn't finished loading.
+       */
+      static bool isLoading(const ResourceKey& name, ResourceType type);
+
+      /**
+       * Starts watching the data directory, so that resources are reloaded whenever their files change.
+       *
+       * @param directory The path of the data directory.
+       *
+       * @return true iff the directory is being watched.
+       */
+      static bool watchFiles(const std::string& directory);
+
+      /**
+       * Loads a prefetch manifest, so that the resources of the maps that can come next are requested whenever a map is entered.
+       *
+       * @param path The path of the manifest, which doesn't have to exist yet if it is being traced.
+       * @param traceResources Whether or not to record the resources used on each map into the manifest,
+       *                       which is written back to its path when the resources are freed.
+       *
+       * @return true iff the manifest was read.
+       */
+      static bool loadManifest(const std::string& path, bool traceResources);
+
+      /**
+       * Loads the bake manifest written by the asset baker, so that baked assets are used in place of their sources.
+       * If it can't be read, every asset is loaded from its source.
+       *
+       * @param path The path of the manifest.
+       *
+       * @return true iff the manifest was read.
+       */
+      static bool loadBakeManifest(const std::string& path);
+
+      /**
+       * Looks up the baked asset compiled from a raw asset, so that a loader can open it in place of the raw asset.
+       * The baked asset is in the format of the offline compiler that made it (such as a compiled map, for a Tiled map).
+       *
+       * @param sourcePath The path of the raw asset.
+       * @param bakedPath The string to put the path of the baked asset in, if there is one.
+       *
+       * @return true iff the raw asset has been baked.
+       */
+      static bool findBakedAsset(const std::string& sourcePath, std::string& bakedPath);
+
+      /**
+       * Tells the loader that the player is leaving the current map, so that the resources used
+       * from now on are traced as belonging to the map being entered.
+       */
+      static void beginMapChange();
+
+      /**
+       * Tells the loader that a chapter is starting, so that the resources used from now on are traced as belonging
+       * to the first map entered, and the chapter's start is traced as leading on to that map.
+       *
+       * @param chapterName The name of the chapter.
+       */
+      static void beginChapter(const std::string& chapterName);
+
+      /**
+       * Requests the resources of the map that a chapter has started on before,
+       * so that starting the chapter finds them loaded (or at least on their way).
+       *
+       * @param chapterName The name of the chapter.
+       */
+      static void prefetchChapter(const std::string& chapterName);
+
+      /**
+       * Tells the loader that the player has entered a map, which traces the transition from the previous one,
+       * and requests the resources of any maps that the player has gone on to from this one before.
+       *
+       * @param mapName The name of the map, as "region/map".
+       */
+      static void enterMap(const std::string& mapName);
+
+      /**
+       * Reloads the resources whose files have changed (if files are being watched),
+       * and evicts unused resources from any type of resource that is over its memory budget.
+       * This should happen once per frame, before anything is drawn, and after the job system's jobs are finalized
+       * (see JobSystem::finalizeJobs), which finishes loading the requested resources that have been prepared since the last frame.
+       */
+      static void finishRequests();
+
+      /**
+       * Sets the memory budget for a type of resource. Resources that are in use are never evicted,
+       * so the resources of a type may still take up more than their budget.
+       *
+       * @param type The type of resource.
+       * @param bytes The most memory that unused resources of the type are kept around in (in bytes).
+       */
+      static void setBudget(ResourceType type, size_t bytes);
+
+      /**
+       * @param type The type of resource.
+       *
+       * @return The memory taken up by the loaded resources of the type (in bytes).
+       */
+      static size_t getMemoryUsed(ResourceType type);
+
       /**
        * Get a music resource with the specified filename.
        * The extension must also be specified since music
@@ -113,31 +446,42 @@ class ResourceLoader
        *
        * @return The piece of music given by the specified name.
        */
-      static Music* getMusic(ResourceKey name);
+      static Music* getMusic(const ResourceKey& name);
 
       /**
        * @return The sound effect given by the specified name.
        */
-      static Sound* getSound(ResourceKey name);
+      static Sound* getSound(const ResourceKey& name);
 
       /**
        * @return The tileset given by the specified name.
        */
-      static Tileset* getTileset(ResourceKey name);
+      static Tileset* getTileset(const ResourceKey& name);
 
       /**
        * @return The spritesheet given by the specified name.
        */
-      static Spritesheet* getSpritesheet(ResourceKey name);
+      static Spritesheet* getSpritesheet(const ResourceKey& name);
 
       /**
        * @return The region data given by the specified name.
        */
-      static Region* getRegion(ResourceKey name);
+      static Region* getRegion(const ResourceKey& name);
+
+      /**
+       * @return The GUI image at the specified path.
+       */
+      static GuiImage* getGuiImage(const ResourceKey& name);
+
+      /**
+       * @return The font file at the specified path.
+       */
+      static FontFile* getFontFile(const ResourceKey& name);
 
       /**
        * Free all of the memory taken up by the resources, deleting all the
-       * Resources along the way.
+       * Resources along the way. Resources that are still loading are discarded, and files stop being watched.
+       * A traced prefetch manifest is written out first.
        */
       static void freeAll();
 };
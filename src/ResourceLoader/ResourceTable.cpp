@@ -0,0 +1,115 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ResourceTable.h"
+
+// Enough for the resources of a small region, so that most games never have to grow the table
+static const size_t INITIAL_BUCKET_COUNT = 64;
+
+ResourceTable::ResourceTable() : buckets(INITIAL_BUCKET_COUNT), count(0)
+{
+}
+
+std::vector<ResourceTable::Entry>& ResourceTable::getBucket(const ResourceKey& key)
+{
+   return buckets[key.getId() & (buckets.size() - 1)];
+}
+
+const std::vector<ResourceTable::Entry>& ResourceTable::getBucket(const ResourceKey& key) const
+{
+   return buckets[key.getId() & (buckets.size() - 1)];
+}
+
+void ResourceTable::grow()
+{
+   std::vector<std::vector<Entry> > oldBuckets(buckets.size() * 2);
+   oldBuckets.swap(buckets);
+
+   for(std::vector<std::vector<Entry> >::const_iterator bucket = oldBuckets.begin(); bucket != oldBuckets.end(); ++bucket)
+   {
+      for(std::vector<Entry>::const_iterator entry = bucket->begin(); entry != bucket->end(); ++entry)
+      {
+         getBucket(entry->key).push_back(*entry);
+      }
+   }
+}
+
+Resource* ResourceTable::find(const ResourceKey& key) const
+{
+   const std::vector<Entry>& bucket = getBucket(key);
+   for(std::vector<Entry>::const_iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->key == key)
+      {
+         return entry->resource;
+      }
+   }
+
+   return NULL;
+}
+
+void ResourceTable::insert(const ResourceKey& key, Resource* resource)
+{
+   std::vector<Entry>& bucket = getBucket(key);
+   for(std::vector<Entry>::iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->key == key)
+      {
+         entry->resource = resource;
+         return;
+      }
+   }
+
+   Entry newEntry;
+   newEntry.key = key;
+   newEntry.resource = resource;
+   bucket.push_back(newEntry);
+
+   // Keeping at most one resource per bucket on average keeps the buckets short
+   if(++count > buckets.size())
+   {
+      grow();
+   }
+}
+
+void ResourceTable::erase(const ResourceKey& key)
+{
+   std::vector<Entry>& bucket = getBucket(key);
+   for(std::vector<Entry>::iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->key == key)
+      {
+         // The order within a bucket doesn't matter, so the last entry fills the gap
+         *entry = bucket.back();
+         bucket.pop_back();
+         --count;
+         return;
+      }
+   }
+}
+
+void ResourceTable::getResources(std::vector<Resource*>& resources) const
+{
+   resources.reserve(resources.size() + count);
+   for(std::vector<std::vector<Entry> >::const_iterator bucket = buckets.begin(); bucket != buckets.end(); ++bucket)
+   {
+      for(std::vector<Entry>::const_iterator entry = bucket->begin(); entry != bucket->end(); ++entry)
+      {
+         resources.push_back(entry->resource);
+      }
+   }
+}
+
+size_t ResourceTable::size() const
+{
+   return count;
+}
+
+void ResourceTable::clear()
+{
+   std::vector<std::vector<Entry> >(INITIAL_BUCKET_COUNT).swap(buckets);
+   count = 0;
+}
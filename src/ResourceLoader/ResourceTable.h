@@ -0,0 +1,103 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef RESOURCE_TABLE_H
+#define RESOURCE_TABLE_H
+
+#include <vector>
+#include "ResourceKey.h"
+
+class Resource;
+
+/**
+ * A hash table of resources, organized by key. Each key is hashed once when it is created,
+ * so finding a resource takes one look into the bucket picked out by the key's hash,
+ * instead of a string comparison at every level of a tree.
+ */
+class ResourceTable
+{
+   /** A resource stored in the table. */
+   struct Entry
+   {
+      /** The key of the resource. */
+      ResourceKey key;
+
+      /** The resource. */
+      Resource* resource;
+   };
+
+   /** The buckets of the table. There is always a power of two of them, so that a hash can be masked down to a bucket. */
+   std::vector<std::vector<Entry> > buckets;
+
+   /** The number of resources in the table. */
+   size_t count;
+
+   /**
+    * @param key A resource key.
+    *
+    * @return The bucket that the key belongs in.
+    */
+   std::vector<Entry>& getBucket(const ResourceKey& key);
+
+   /**
+    * @param key A resource key.
+    *
+    * @return The bucket that the key belongs in.
+    */
+   const std::vector<Entry>& getBucket(const ResourceKey& key) const;
+
+   /**
+    * Spreads the resources over twice as many buckets.
+    */
+   void grow();
+
+   public:
+      /**
+       * Constructor. The table starts out empty.
+       */
+      ResourceTable();
+
+      /**
+       * @param key The key of a resource.
+       *
+       * @return The resource with the key, or NULL if the table doesn't hold it.
+       */
+      Resource* find(const ResourceKey& key) const;
+
+      /**
+       * Adds a resource to the table, in place of any resource that had the same key.
+       *
+       * @param key The key of the resource.
+       * @param resource The resource.
+       */
+      void insert(const ResourceKey& key, Resource* resource);
+
+      /**
+       * Removes a resource from the table. The resource itself isn't deleted.
+       *
+       * @param key The key of the resource.
+       */
+      void erase(const ResourceKey& key);
+
+      /**
+       * Adds every resource in the table to a list, in no particular order.
+       *
+       * @param resources The list to add the resources to.
+       */
+      void getResources(std::vector<Resource*>& resources) const;
+
+      /**
+       * @return The number of resources in the table.
+       */
+      size_t size() const;
+
+      /**
+       * Removes every resource from the table. The resources themselves aren't deleted.
+       */
+      void clear();
+};
+
+#endif
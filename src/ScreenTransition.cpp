@@ -0,0 +1,130 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ScreenTransition.h"
+#include "GLState.h"
+#include "Task.h"
+#include "SDL_opengl.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+ScreenTransition::ScreenTransition() : style(FADE), red(0.0f), green(0.0f), blue(0.0f),
+      covering(false), duration(0), elapsed(0), active(false), task(NULL)
+{
+}
+
+void ScreenTransition::start(Style style, float red, float green, float blue, bool covering, long duration, Task* task)
+{
+   signalTask();
+
+   this->style = style;
+   this->red = red;
+   this->green = green;
+   this->blue = blue;
+   this->covering = covering;
+   this->duration = duration;
+   this->task = task;
+   elapsed = 0;
+   active = true;
+
+   DEBUG("Starting a %ld ms screen transition (%s).", duration, covering ? "covering" : "uncovering");
+
+   // A transition with no length finishes right away
+   step(0);
+}
+
+void ScreenTransition::step(long timePassed)
+{
+   if(!active) return;
+
+   elapsed += timePassed;
+   if(elapsed >= duration)
+   {
+      elapsed = duration;
+      active = false;
+      signalTask();
+   }
+}
+
+void ScreenTransition::stop()
+{
+   covering = false;
+   elapsed = duration;
+   active = false;
+   signalTask();
+}
+
+bool ScreenTransition::isActive() const
+{
+   return active;
+}
+
+void ScreenTransition::signalTask()
+{
+   if(task != NULL)
+   {
+      Task* finishedTask = task;
+      task = NULL;
+      finishedTask->signal();
+   }
+}
+
+float ScreenTransition::getCoverage() const
+{
+   const float progress = duration > 0 ? float(elapsed) / duration : 1.0f;
+   return covering ? progress : 1.0f - progress;
+}
+
+void ScreenTransition::draw(int width, int height) const
+{
+   const float coverage = getCoverage();
+   if(coverage <= 0.0f) return;
+
+   float right = float(width);
+   float alpha = 1.0f;
+   if(style == WIPE)
+   {
+      right *= coverage;
+   }
+   else
+   {
+      alpha = coverage;
+   }
+
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   const bool blendEnabled = GLState::isBlending();
+
+   GLState::setTexturing(false);
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+   // The modelview matrix may still hold a drawing offset, but the transition always covers the screen
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glColor4f(red, green, blue, alpha);
+      glVertex3f(0.0f, 0.0f, 0.0f);
+      glVertex3f(right, 0.0f, 0.0f);
+      glVertex3f(right, float(height), 0.0f);
+      glVertex3f(0.0f, float(height), 0.0f);
+      glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+   glEnd();
+
+   glPopMatrix();
+
+   GLState::setTexturing(true);
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+ScreenTransition::~ScreenTransition()
+{
+}
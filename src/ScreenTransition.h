@@ -0,0 +1,119 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SCREEN_TRANSITION_H
+#define SCREEN_TRANSITION_H
+
+#include <cstddef>
+
+class Task;
+
+/**
+ * A ScreenTransition covers the screen with a colour (or uncovers it) over the course of many frames,
+ * drawn over everything else at the end of each frame. Unlike a blocking fade, the game keeps stepping,
+ * taking input and running scripts while the transition plays.
+ *
+ * Once a transition has covered the screen, the screen stays covered until another transition uncovers it,
+ * so that whatever changes behind it (such as a new map being loaded) isn't seen.
+ * A transition can carry a Task, which is signalled when the transition finishes, so that scripts can wait on it.
+ */
+class ScreenTransition
+{
+   public:
+      /** The ways that the colour can cover the screen. */
+      enum Style
+      {
+         /** The colour fades in (or out) over the whole screen at once. */
+         FADE,
+
+         /** The colour sweeps across the screen from left to right. */
+         WIPE,
+      };
+
+   private:
+      /** The way the colour covers the screen. */
+      Style style;
+
+      /** The colour covering the screen. */
+      float red, green, blue;
+
+      /** true iff the transition covers the screen, rather than uncovering it. */
+      bool covering;
+
+      /** The length of the transition (in milliseconds). */
+      long duration;
+
+      /** The amount of time that the transition has played for (in milliseconds). */
+      long elapsed;
+
+      /** true iff the transition is still playing. */
+      bool active;
+
+      /** The task to signal when the transition finishes, or NULL if there is none. */
+      Task* task;
+
+      /**
+       * @return How much of the screen is covered (from 0 to 1).
+       */
+      float getCoverage() const;
+
+      /**
+       * Signals the transition's task, if it has one.
+       */
+      void signalTask();
+
+   public:
+      /**
+       * Constructor. The screen starts out uncovered.
+       */
+      ScreenTransition();
+
+      /**
+       * Starts a new transition, replacing the current one.
+       * If the current transition is still playing, its task is signalled right away.
+       *
+       * @param style The way the colour covers the screen.
+       * @param red   The amount of red   (0.0f <= red <= 1.0f)
+       * @param green The amount of green (0.0f <= green <= 1.0f)
+       * @param blue  The amount of blue  (0.0f <= blue <= 1.0f)
+       * @param covering true iff the screen should be covered by the colour, or false to uncover it.
+       * @param duration The length of the transition (in milliseconds).
+       * @param task The task to signal when the transition finishes, or NULL if there is none.
+       */
+      void start(Style style, float red, float green, float blue, bool covering, long duration, Task* task = NULL);
+
+      /**
+       * Plays the transition forward.
+       *
+       * @param timePassed The amount of game time (in milliseconds) that has passed.
+       */
+      void step(long timePassed);
+
+      /**
+       * Stops the transition and uncovers the screen, signalling the transition's task if it is still playing.
+       */
+      void stop();
+
+      /**
+       * @return true iff the transition is still playing.
+       */
+      bool isActive() const;
+
+      /**
+       * Draws the colour over whatever part of the screen is covered.
+       *
+       * @param width The width of the screen (in pixels).
+       * @param height The height of the screen (in pixels).
+       */
+      void draw(int width, int height) const;
+
+      /**
+       * Destructor.
+       */
+      ~ScreenTransition();
+};
+
+#endif
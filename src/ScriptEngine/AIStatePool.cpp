@@ -0,0 +1,390 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "AIStatePool.h"
+#include "SDL_mutex.h"
+#include <cstring>
+
+// Include the Lua libraries. Since they are written in clean C, the functions
+// need to be included in this fashion to work with the C++ code.
+extern "C"
+{
+   #include <lua.h>
+   #include <lualib.h>
+   #include <lauxlib.h>
+}
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SCRIPT_ENG;
+
+// Far more than deciding where to wander to takes, but little enough that a runaway loop doesn't hold up a worker for long
+const int AIStatePool::MAX_INSTRUCTIONS = 1000000;
+
+// The registry key of the table holding each loaded script's idle function (or false if it couldn't be loaded), by path
+static const char* IDLE_FUNCTIONS_KEY = "AIIdleFunctions";
+
+// The registry key of the metatable shared by the NPC snapshots handed to idle functions
+static const char* SNAPSHOT_METATABLE_KEY = "AINPCSnapshot";
+
+// The name of each MovementDirection as an idle function gives it, in the same order as the enum
+static const char* DIRECTION_NAMES[] = { "none", "up", "down", "left", "right", "up_left", "up_right", "down_left", "down_right" };
+
+class AIStatePool::IdleJob : public JobSystem::Job
+{
+   /** The pool that the idle function runs for. */
+   AIStatePool& pool;
+
+   /** The job to run. */
+   AIStatePool::Job* job;
+
+   public:
+      IdleJob(AIStatePool& pool, AIStatePool::Job* job) : JobSystem::Job(false), pool(pool), job(job)
+      {
+      }
+
+      void run(int slot)
+      {
+         pool.runIdleFunction(job, slot);
+      }
+};
+
+AIStatePool::AIStatePool() : callingThreadWorker(NULL), stopping(false)
+{
+   lock = SDL_CreateMutex();
+}
+
+AIStatePool::Worker* AIStatePool::createWorker()
+{
+   Worker* worker = new Worker();
+   worker->pool = this;
+   worker->currentJob = NULL;
+
+   // Idle functions get the pure parts of the standard library, and nothing that can reach outside of the state
+   lua_State* luaVM = luaL_newstate();
+   const lua_CFunction libraries[] = { luaopen_base, luaopen_table, luaopen_string, luaopen_math };
+   for(unsigned int i = 0; i < sizeof(libraries) / sizeof(libraries[0]); ++i)
+   {
+      lua_pushcfunction(luaVM, libraries[i]);
+      lua_call(luaVM, 0, 0);
+   }
+
+   lua_newtable(luaVM);
+   lua_setfield(luaVM, LUA_REGISTRYINDEX, IDLE_FUNCTIONS_KEY);
+
+   // The order functions find the job to add to through the worker they belong to
+   lua_newtable(luaVM);
+   lua_newtable(luaVM);
+   lua_pushlightuserdata(luaVM, worker);
+   lua_pushcclosure(luaVM, orderMove, 1);
+   lua_setfield(luaVM, -2, "move");
+   lua_pushlightuserdata(luaVM, worker);
+   lua_pushcclosure(luaVM, orderStand, 1);
+   lua_setfield(luaVM, -2, "stand");
+   lua_setfield(luaVM, -2, "__index");
+   lua_setfield(luaVM, LUA_REGISTRYINDEX, SNAPSHOT_METATABLE_KEY);
+
+   worker->luaVM = luaVM;
+   return worker;
+}
+
+void AIStatePool::deleteWorker(Worker* worker)
+{
+   lua_close(worker->luaVM);
+   delete worker;
+}
+
+void AIStatePool::runIdleFunction(Job* job, int slot)
+{
+   SDL_mutexP(lock);
+   const bool discarded = stopping;
+   SDL_mutexV(lock);
+
+   if(discarded)
+   {
+      delete job;
+      return;
+   }
+
+   // Only the thread with the slot touches the slot's worker, so its state can be created without a lock
+   if(workers[slot] == NULL)
+   {
+      workers[slot] = createWorker();
+   }
+
+   runJob(*workers[slot], *job);
+
+   SDL_mutexP(lock);
+   if(stopping)
+   {
+      delete job;
+   }
+   else
+   {
+      completedJobs.push_back(job);
+   }
+   SDL_mutexV(lock);
+}
+
+bool AIStatePool::pushIdleFunction(Worker& worker, const Job& job)
+{
+   lua_State* luaVM = worker.luaVM;
+   lua_getfield(luaVM, LUA_REGISTRYINDEX, IDLE_FUNCTIONS_KEY);
+   lua_getfield(luaVM, -1, job.scriptPath.c_str());
+
+   if(lua_isnil(luaVM, -1))
+   {
+      lua_pop(luaVM, 1);
+
+      // Run the script in an environment of its own, which can still read the globals of the state
+      const std::string chunkName = "@" + job.scriptPath;
+      if(luaL_loadbuffer(luaVM, job.bytecode->data(), job.bytecode->size(), chunkName.c_str()) == 0)
+      {
+         lua_newtable(luaVM);
+         lua_newtable(luaVM);
+         lua_pushvalue(luaVM, LUA_GLOBALSINDEX);
+         lua_setfield(luaVM, -2, "__index");
+         lua_setmetatable(luaVM, -2);
+         lua_pushvalue(luaVM, -1);
+         lua_insert(luaVM, -3);
+         lua_setfenv(luaVM, -2);
+
+         if(lua_pcall(luaVM, 0, 0, 0) == 0)
+         {
+            lua_getfield(luaVM, -1, "aiIdle");
+         }
+         else
+         {
+            DEBUG("Error loading AI script %s: %s", job.scriptPath.c_str(), lua_tostring(luaVM, -1));
+            lua_pushnil(luaVM);
+         }
+
+         lua_remove(luaVM, -2);
+      }
+      else
+      {
+         DEBUG("Error loading AI script %s: %s", job.scriptPath.c_str(), lua_tostring(luaVM, -1));
+         lua_pop(luaVM, 1);
+         lua_pushnil(luaVM);
+      }
+
+      // A script that can't be loaded is remembered, so it isn't loaded again for every job
+      if(!lua_isfunction(luaVM, -1))
+      {
+         lua_pop(luaVM, 1);
+         lua_pushboolean(luaVM, false);
+      }
+
+      lua_pushvalue(luaVM, -1);
+      lua_setfield(luaVM, -3, job.scriptPath.c_str());
+   }
+
+   lua_remove(luaVM, -2);
+   if(!lua_isfunction(luaVM, -1))
+   {
+      lua_pop(luaVM, 1);
+      return false;
+   }
+
+   return true;
+}
+
+void AIStatePool::runJob(Worker& worker, Job& job)
+{
+   lua_State* luaVM = worker.luaVM;
+   job.failed = !pushIdleFunction(worker, job);
+   if(job.failed) return;
+
+   lua_createtable(luaVM, 0, 3);
+   lua_pushstring(luaVM, job.npcName.c_str());
+   lua_setfield(luaVM, -2, "name");
+   lua_pushinteger(luaVM, job.x);
+   lua_setfield(luaVM, -2, "x");
+   lua_pushinteger(luaVM, job.y);
+   lua_setfield(luaVM, -2, "y");
+   lua_getfield(luaVM, LUA_REGISTRYINDEX, SNAPSHOT_METATABLE_KEY);
+   lua_setmetatable(luaVM, -2);
+
+   lua_createtable(luaVM, 0, 3);
+   lua_pushinteger(luaVM, job.time);
+   lua_setfield(luaVM, -2, "time");
+   lua_pushinteger(luaVM, job.playerX);
+   lua_setfield(luaVM, -2, "playerX");
+   lua_pushinteger(luaVM, job.playerY);
+   lua_setfield(luaVM, -2, "playerY");
+
+   worker.currentJob = &job;
+   lua_sethook(luaVM, abortHook, LUA_MASKCOUNT, MAX_INSTRUCTIONS);
+
+   if(lua_pcall(luaVM, 2, 1, 0) == 0)
+   {
+      job.waitTime = lua_isnumber(luaVM, -1) ? static_cast<long>(lua_tonumber(luaVM, -1)) : 0;
+   }
+   else
+   {
+      DEBUG("Error running AI idle function for %s: %s", job.npcName.c_str(), lua_tostring(luaVM, -1));
+      job.failed = true;
+   }
+
+   lua_sethook(luaVM, NULL, 0, 0);
+   worker.currentJob = NULL;
+   lua_settop(luaVM, 0);
+}
+
+void AIStatePool::abortHook(lua_State* luaVM, lua_Debug* /*debugInfo*/)
+{
+   luaL_error(luaVM, "AI idle function ran for too long");
+}
+
+int AIStatePool::orderMove(lua_State* luaVM)
+{
+   Worker* worker = static_cast<Worker*>(lua_touserdata(luaVM, lua_upvalueindex(1)));
+
+   Order order;
+   order.type = Order::MOVE;
+   order.x = luaL_checkint(luaVM, 2);
+   order.y = luaL_checkint(luaVM, 3);
+   order.direction = NONE;
+   worker->currentJob->orders.push_back(order);
+   return 0;
+}
+
+int AIStatePool::orderStand(lua_State* luaVM)
+{
+   Worker* worker = static_cast<Worker*>(lua_touserdata(luaVM, lua_upvalueindex(1)));
+   const char* directionName = luaL_checkstring(luaVM, 2);
+
+   Order order;
+   order.type = Order::STAND;
+   order.x = 0;
+   order.y = 0;
+   order.direction = NONE;
+   for(int direction = UP; direction < NUM_DIRECTIONS; ++direction)
+   {
+      if(strcmp(directionName, DIRECTION_NAMES[direction]) == 0)
+      {
+         order.direction = static_cast<MovementDirection>(direction);
+      }
+   }
+
+   if(order.direction == NONE)
+   {
+      return luaL_argerror(luaVM, 2, "not a direction");
+   }
+
+   worker->currentJob->orders.push_back(order);
+   return 0;
+}
+
+void AIStatePool::start()
+{
+   stop();
+
+   stopping = false;
+   if(JobSystem::getWorkerCount() > 0)
+   {
+      // Loading the standard libraries into a state isn't free, so states are only created for the slots that run idle functions
+      workers.assign(JobSystem::getSlotCount(), NULL);
+   }
+
+   DEBUG("Running AI idle functions on %d job workers", JobSystem::getWorkerCount());
+}
+
+void AIStatePool::stop()
+{
+   SDL_mutexP(lock);
+   stopping = true;
+   SDL_mutexV(lock);
+
+   JobSystem::wait(idleRuns);
+
+   for(std::vector<Worker*>::iterator iter = workers.begin(); iter != workers.end(); ++iter)
+   {
+      if(*iter != NULL)
+      {
+         deleteWorker(*iter);
+      }
+   }
+
+   workers.clear();
+
+   for(std::list<Job*>::iterator iter = jobQueue.begin(); iter != jobQueue.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   for(std::list<Job*>::iterator iter = completedJobs.begin(); iter != completedJobs.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   jobQueue.clear();
+   completedJobs.clear();
+}
+
+bool AIStatePool::hasScript(const std::string& scriptPath) const
+{
+   return scripts.find(scriptPath) != scripts.end();
+}
+
+void AIStatePool::addScript(const std::string& scriptPath, const std::string& bytecode)
+{
+   // Queued jobs point at the bytecode, so a script's bytecode can't change once it has been added
+   scripts.insert(std::make_pair(scriptPath, bytecode));
+}
+
+void AIStatePool::queueJob(Job* job)
+{
+   job->orders.clear();
+   job->waitTime = 0;
+   job->failed = false;
+   job->bytecode = &scripts.find(job->scriptPath)->second;
+
+   if(!workers.empty())
+   {
+      JobSystem::submit(new IdleJob(*this, job), &idleRuns);
+      return;
+   }
+
+   jobQueue.push_back(job);
+}
+
+void AIStatePool::work()
+{
+   if(!workers.empty()) return;
+
+   // Without any workers, nothing else touches the queues, so there is no need to lock them
+   while(!jobQueue.empty())
+   {
+      if(callingThreadWorker == NULL)
+      {
+         callingThreadWorker = createWorker();
+      }
+
+      Job* job = jobQueue.front();
+      jobQueue.pop_front();
+      runJob(*callingThreadWorker, *job);
+      completedJobs.push_back(job);
+   }
+}
+
+void AIStatePool::collectCompletedJobs(std::list<Job*>& jobs)
+{
+   SDL_mutexP(lock);
+   jobs.splice(jobs.end(), completedJobs);
+   SDL_mutexV(lock);
+}
+
+AIStatePool::~AIStatePool()
+{
+   stop();
+
+   if(callingThreadWorker != NULL)
+   {
+      deleteWorker(callingThreadWorker);
+   }
+
+   SDL_DestroyMutex(lock);
+}
@@ -0,0 +1,271 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef AI_STATE_POOL_H
+#define AI_STATE_POOL_H
+
+#include "MovementDirection.h"
+#include "JobSystem.h"
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+struct lua_State;
+struct lua_Debug;
+struct SDL_mutex;
+
+/**
+ * Runs the pure idle functions of NPC scripts as jobs on the job system's workers, each with its own Lua state, apart from the main Lua VM.
+ *
+ * An NPC script marks its idle logic as pure by defining an aiIdle function instead of an idle function.
+ * A pure idle function only gets to read a snapshot of the world: it is called with a table describing the NPC
+ * (its name, and its x and y location in pixels) and a table describing the world (the time in milliseconds,
+ * and the player's playerX and playerY location in pixels), and it can only emit orders for the NPC through
+ * npc:move(x, y) and npc:stand(direction) (where the direction is "up", "down", "left", "right", "up_left",
+ * "up_right", "down_left" or "down_right"). It can return the time (in milliseconds) to wait before it is run again.
+ * The orders are handed back to the main thread, which applies them to the NPC, so many NPCs can decide what
+ * to do next at once across the machine's cores without the main VM ever being touched off the main thread.
+ *
+ * Each of the job system's slots gets a state of its own the first time an idle function runs on it. A state loads an NPC script
+ * (from the bytecode that the main VM compiled it to) the first time it runs one of the script's jobs, into an environment of its own
+ * so that scripts can't see each other's globals.
+ *
+ * Finished jobs are handed back through a completion queue that the main thread drains once per frame.
+ * If the job system has no worker threads, the jobs are instead run on the calling thread whenever work() is called.
+ */
+class AIStatePool
+{
+   public:
+      /** An order emitted for an NPC by its idle function. */
+      struct Order
+      {
+         /** The kinds of orders that an idle function can emit. */
+         enum Type
+         {
+            /** Move to a location. */
+            MOVE,
+            /** Stand facing a direction. */
+            STAND
+         };
+
+         /** The kind of order. */
+         Type type;
+
+         /** The x coordinate (in pixels) to move to. */
+         int x;
+
+         /** The y coordinate (in pixels) to move to. */
+         int y;
+
+         /** The direction to stand facing. */
+         MovementDirection direction;
+      };
+
+      /** A run of an NPC's idle function, along with the orders it emitted. */
+      struct Job
+      {
+         /** The name of the NPC that the job runs for. */
+         std::string npcName;
+
+         /** The path of the NPC's script, which must have been added to the pool. */
+         std::string scriptPath;
+
+         /** The x coordinate (in pixels) of the NPC when the job was queued. */
+         int x;
+
+         /** The y coordinate (in pixels) of the NPC when the job was queued. */
+         int y;
+
+         /** The game time (in milliseconds) when the job was queued. */
+         long time;
+
+         /** The x coordinate (in pixels) of the player when the job was queued. */
+         int playerX;
+
+         /** The y coordinate (in pixels) of the player when the job was queued. */
+         int playerY;
+
+         /** The orders that the idle function emitted, once the job is complete. */
+         std::vector<Order> orders;
+
+         /** The time (in milliseconds) that the idle function asked to wait before it runs again, or 0 if it didn't. */
+         long waitTime;
+
+         /** True iff the idle function failed (or the script couldn't be loaded). */
+         bool failed;
+
+         /** The bytecode of the NPC's script, which is filled in when the job is queued. */
+         const std::string* bytecode;
+      };
+
+   private:
+      /** The job system job that runs an idle function on a worker. */
+      class IdleJob;
+      friend class IdleJob;
+
+      /** The number of instructions that an idle function can run before it is stopped. */
+      static const int MAX_INSTRUCTIONS;
+
+      /** A Lua state that idle functions are run in, and the job being run in it. */
+      struct Worker
+      {
+         /** The pool that the worker belongs to. */
+         AIStatePool* pool;
+
+         /** The worker's own Lua state. */
+         lua_State* luaVM;
+
+         /** The job being run by the worker, for the order functions to add to. */
+         Job* currentJob;
+      };
+
+      /** The bytecode of each NPC script with a pure idle function, by path. */
+      std::map<std::string, std::string> scripts;
+
+      /** The worker for each of the job system's slots (NULL until an idle function runs on the slot), or empty if the jobs run on the calling thread. */
+      std::vector<Worker*> workers;
+
+      /** Counts the idle functions handed to the job system that haven't finished yet. */
+      JobSystem::Counter idleRuns;
+
+      /** The worker used to run jobs on the calling thread when there are no worker threads. */
+      Worker* callingThreadWorker;
+
+      /** Guards the completion queue and the stopping flag. */
+      SDL_mutex* lock;
+
+      /** Whether or not the pool has been asked to stop, so that idle functions that haven't finished are discarded. */
+      bool stopping;
+
+      /** The jobs waiting to be run on the calling thread, in the order they were queued. */
+      std::list<Job*> jobQueue;
+
+      /** The jobs that have finished, but haven't been collected yet. */
+      std::list<Job*> completedJobs;
+
+      /**
+       * Runs a job on one of the job system's threads, with the worker for the thread's slot, unless the pool is stopping.
+       *
+       * @param job The job to run.
+       * @param slot The slot of the thread running the job.
+       */
+      void runIdleFunction(Job* job, int slot);
+
+      /**
+       * Creates a worker, along with its Lua state.
+       *
+       * @return The new worker.
+       */
+      Worker* createWorker();
+
+      /**
+       * Closes a worker's Lua state and deletes the worker.
+       *
+       * @param worker The worker, which mustn't be running a job any more.
+       */
+      static void deleteWorker(Worker* worker);
+
+      /**
+       * Pushes a script's idle function onto a worker's stack, loading the script into the worker's state if it hasn't been yet.
+       *
+       * @param worker The worker.
+       * @param job The job that needs the idle function.
+       *
+       * @return true iff the idle function was pushed; nothing is pushed otherwise.
+       */
+      static bool pushIdleFunction(Worker& worker, const Job& job);
+
+      /**
+       * Runs a job on a worker.
+       *
+       * @param worker The worker.
+       * @param job The job to run.
+       */
+      static void runJob(Worker& worker, Job& job);
+
+      /**
+       * Stops an idle function that has run for too long (a Lua count hook).
+       */
+      static void abortHook(lua_State* luaVM, lua_Debug* debugInfo);
+
+      /**
+       * Adds a movement order to the worker's current job (npc:move(x, y) in an idle function).
+       */
+      static int orderMove(lua_State* luaVM);
+
+      /**
+       * Adds a standing order to the worker's current job (npc:stand(direction) in an idle function).
+       */
+      static int orderStand(lua_State* luaVM);
+
+      /** AI state pools can't be copied. */
+      AIStatePool(const AIStatePool&);
+
+      /** AI state pools can't be copied. */
+      AIStatePool& operator=(const AIStatePool&);
+
+   public:
+      /**
+       * Constructor.
+       */
+      AIStatePool();
+
+      /**
+       * Sets up a worker for each of the job system's slots.
+       */
+      void start();
+
+      /**
+       * Waits for the idle functions that are running to finish, closes the workers' states,
+       * and discards all jobs that are queued or haven't been collected.
+       */
+      void stop();
+
+      /**
+       * @param scriptPath The path of an NPC script.
+       *
+       * @return true iff the script has been added to the pool.
+       */
+      bool hasScript(const std::string& scriptPath) const;
+
+      /**
+       * Adds an NPC script with a pure idle function, so that jobs can run it.
+       * A script that has already been added is kept as it is.
+       *
+       * @param scriptPath The path of the script.
+       * @param bytecode The bytecode that the script was compiled to.
+       */
+      void addScript(const std::string& scriptPath, const std::string& bytecode);
+
+      /**
+       * Hands a job to the job system, or adds it to the back of the calling thread's queue if there are no workers.
+       * The pool takes ownership of the job.
+       *
+       * @param job The job to queue, whose script must have been added to the pool.
+       */
+      void queueJob(Job* job);
+
+      /**
+       * Runs the queued jobs on the calling thread if there are no worker threads to run them.
+       */
+      void work();
+
+      /**
+       * Moves every finished job to the back of the given list.
+       * The caller takes ownership of the jobs, and must delete them.
+       *
+       * @param jobs The list to add the finished jobs to.
+       */
+      void collectCompletedJobs(std::list<Job*>& jobs);
+
+      /**
+       * Destructor.
+       */
+      ~AIStatePool();
+};
+
+#endif
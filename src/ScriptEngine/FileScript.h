@@ -20,13 +20,13 @@ class FileScript : public Script
    public:
       /**
        * Constructor.
-       * Creates a new Lua thread by forking the main VM, and then
-       * loads the specified script file onto the new thread's stack.
+       * Takes a Lua thread from the pool, and then
+       * loads the specified script file onto the thread's stack.
        *
-       * @param luaVM The main Lua stack to fork a thread from.
+       * @param threadPool The pool to take the script's thread from.
        * @param scriptPath The path to a script that should be run on this thread.
        */
-      FileScript(lua_State* luaVM, const std::string& scriptPath);
+      FileScript(ScriptThreadPool& threadPool, const std::string& scriptPath);
 
       /**
        * Destructor.
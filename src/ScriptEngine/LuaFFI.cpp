@@ -0,0 +1,97 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "LuaFFI.h"
+#include "TileEngine.h"
+#include "Actor.h"
+#include "Point2D.h"
+#include "LuaWrapper.hpp"
+#include <cstring>
+
+// Include the Lua libraries. Since they are written in clean C, the functions
+// need to be included in this fashion to work with the C++ code.
+extern "C"
+{
+   #include <lua.h>
+   #include <lualib.h>
+   #include <lauxlib.h>
+}
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SCRIPT_ENG;
+
+#ifdef EDEN_USE_LUAJIT
+
+// The FFI finds the engine's functions among the executable's own symbols, so they have to be exported from it
+#ifdef _WIN32
+   #define EDEN_FFI_EXPORT extern "C" __declspec(dllexport)
+#else
+   #define EDEN_FFI_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+/**
+ * The FFI version of TileEngine:tilesToPixels.
+ *
+ * @param tiles A number of tiles.
+ *
+ * @return The length of the tiles (in pixels).
+ */
+EDEN_FFI_EXPORT int eden_tilesToPixels(int tiles)
+{
+   return TileEngine::TILE_SIZE * tiles;
+}
+
+/**
+ * The FFI version of Actor:getLocation.
+ *
+ * @param actorData The payload of the actor's userdata (which the FFI passes for a userdata argument).
+ *                  The fast path is only installed on Actor's metatable, so this is always the userdata of an Actor
+ *                  (or one of its subclasses), unless a script goes out of its way to call it on something else.
+ * @param location Returns the actor's location, x first.
+ */
+EDEN_FFI_EXPORT void eden_getActorLocation(const void* actorData, int* location)
+{
+   // Cast toward Actor the same way that luaW_to does, since a subclass's object can't be cast through a void pointer
+   luaW_Userdata userdata = *static_cast<const luaW_Userdata*>(actorData);
+   while(userdata.cast != LuaWrapper<Actor>::cast)
+   {
+      userdata = userdata.cast(userdata);
+   }
+
+   const shapes::Point2D actorLocation = static_cast<Actor*>(userdata.data)->getLocation();
+   location[0] = actorLocation.x;
+   location[1] = actorLocation.y;
+}
+
+// The location is returned through one buffer that is reused for every call, so that calls don't allocate
+static const char* FAST_PATHS =
+   "local ffi = require('ffi')\n"
+   "ffi.cdef[[\n"
+   "int eden_tilesToPixels(int tiles);\n"
+   "void eden_getActorLocation(const void* actorData, int* location);\n"
+   "]]\n"
+   "local C = ffi.C\n"
+   "local location = ffi.new('int[2]')\n"
+   "TileEngine.metatable.tilesToPixels = function(self, tiles) return C.eden_tilesToPixels(tiles) end\n"
+   "Actor.metatable.getLocation = function(self) C.eden_getActorLocation(self, location) return location[0], location[1] end\n";
+
+void luaopen_FFI(lua_State* luaVM)
+{
+   if(luaL_loadbuffer(luaVM, FAST_PATHS, strlen(FAST_PATHS), "=FFI fast paths") != 0 || lua_pcall(luaVM, 0, 0, 0) != 0)
+   {
+      // The C API bindings are still in place, so scripts keep working, only slower
+      DEBUG("Unable to install the FFI fast paths: %s", lua_tostring(luaVM, -1));
+      lua_pop(luaVM, 1);
+   }
+}
+
+#else
+
+void luaopen_FFI(lua_State* /*luaVM*/)
+{
+}
+
+#endif
@@ -0,0 +1,26 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef LUA_FFI_H
+#define LUA_FFI_H
+
+struct lua_State;
+
+/**
+ * Replaces the bindings that scripts call most often for read-only data (such as an actor's location,
+ * or the pixel size of a number of tiles) with versions that call into the engine through LuaJIT's FFI,
+ * which the JIT compiler can compile into the traces of the scripts that call them,
+ * instead of through the Lua C API (which always stops the JIT compiler).
+ * Every other binding stays on the LuaWrapper path.
+ *
+ * Only builds that are made with EDEN_USE_LUAJIT have the FFI; in any other build, the bindings are left as they are.
+ * Must be called after the TileEngine and Actor classes are registered.
+ *
+ * @param luaVM The Lua VM to install the fast paths in.
+ */
+void luaopen_FFI(lua_State* luaVM);
+
+#endif
@@ -6,6 +6,8 @@
 
 #include "NPCScript.h"
 #include "NPC.h"
+#include "Scheduler.h"
+#include "ScriptEnvironments.h"
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_NPC;
@@ -23,14 +25,19 @@ extern "C"
 
 const char* NPCScript::FUNCTION_NAMES[] = { "idle", "activate" };
 
-NPCScript::NPCScript(lua_State* luaVM, const std::string& scriptPath, NPC* npc) : Script(scriptPath), npc(npc), activated(false), finished(false)
+NPCScript::NPCScript(ScriptThreadPool& threadPool, Scheduler& scheduler, const ScriptEnvironments& environments, int environment, const std::string& scriptPath, NPC* npc) : Script(scriptPath, threadPool), scheduler(scheduler), environments(environments), environment(environment), npc(npc), npcRef(LUA_NOREF), pureIdle(false), activated(false), finished(false), pooled(false)
 {
-   luaStack = lua_newthread(luaVM);
 
    // Run through the script to gather all the NPC functions
    DEBUG("Script ID %d loading functions from %s", getId(), scriptPath.c_str());
 
-   int result = luaL_dofile(luaStack, scriptPath.c_str());
+   int result = loadFile(scriptPath);
+   if(result == 0)
+   {
+      // The script runs in its map's environment, along with the map's other scripts
+      setEnvironment(environments, environment);
+      result = lua_pcall(luaStack, 0, LUA_MULTRET, 0);
+   }
 
    if(result != 0)
    {
@@ -38,8 +45,8 @@ NPCScript::NPCScript(lua_State* luaVM, const std::string& scriptPath, NPC* npc)
    }
 
    // All the below code simply takes all the global functions that the script
-   // created, and pushes them into a table that uses this NPC's unique
-   // identifier. Then it removes those global functions for safety.
+   // created, and keeps a reference to each of them for this NPC.
+   // Then it removes those global functions for safety.
 
    // Sure, this would be much easier to do in the Lua script itself, but
    // I want to have absolutely no boilerplate code or metatable BS inside the
@@ -51,39 +58,44 @@ NPCScript::NPCScript(lua_State* luaVM, const std::string& scriptPath, NPC* npc)
 
    functionExists = new bool[NUM_FUNCTIONS];
 
-   // Create a table for this NPC's functions
-   lua_createtable(luaStack, 0, NUM_FUNCTIONS);
+   // The functions are looked up where the script defined them, and the references are kept in the map's environment
+   // (if the script runs in one), so that they are released in bulk when the environment is dropped
+   const bool inEnvironment = environments.push(luaStack, environment);
+   if(!inEnvironment)
+   {
+      lua_pushvalue(luaStack, LUA_GLOBALSINDEX);
+   }
+
+   const int globals = lua_gettop(luaStack);
+   const int references = inEnvironment ? globals : LUA_REGISTRYINDEX;
 
    for(int i = 0; i < NUM_FUNCTIONS; ++i)
    {
       DEBUG("Checking for function %s.", FUNCTION_NAMES[i]);
 
-      // Push the function name into the table
-      lua_pushstring(luaStack, FUNCTION_NAMES[i]);
-
       // Push the function pointer onto the stack
-      lua_getglobal(luaStack, FUNCTION_NAMES[i]);
+      lua_getfield(luaStack, globals, FUNCTION_NAMES[i]);
 
-      // Do a type-check here and push an empty function if needed
+      // Do a type-check here and skip the function if needed
       if(!lua_isfunction(luaStack, -1))
       {
-         // Pop off the bad value and the function name
-         lua_pop(luaStack, 2);
+         // Pop off the bad value
+         lua_pop(luaStack, 1);
 
          // This function is not available for the NPC
          functionExists[i] = false;
+         functionRefs[i] = LUA_NOREF;
 
          DEBUG("%s was not found to be a function!", FUNCTION_NAMES[i]);
       }
       else
       {
-         // Grabs the table explicitly, and uses the string function name as a key
-         // to push in the global function we found (pops string and function off the stack)
-         lua_settable(luaStack, -3);
+         // Keep a reference to the global function we found (pops the function off the stack)
+         functionRefs[i] = luaL_ref(luaStack, references);
 
-         // Remove the function from the global table so nobody else accidentally runs into it
+         // Remove the function from the globals so nobody else accidentally runs into it
          lua_pushnil(luaStack);
-         lua_setglobal(luaStack, FUNCTION_NAMES[i]);
+         lua_setfield(luaStack, globals, FUNCTION_NAMES[i]);
 
          // The function is valid for the NPC
          functionExists[i] = true;
@@ -92,29 +104,71 @@ NPCScript::NPCScript(lua_State* luaVM, const std::string& scriptPath, NPC* npc)
       }
    }
 
-   // Push the table into the global space with the file path as the name
-   lua_setglobal(luaStack, scriptName.c_str());
+   // A pure idle function runs in a Lua state of its own, so it is only noted (and removed) here
+   lua_getfield(luaStack, globals, "aiIdle");
+   pureIdle = lua_isfunction(luaStack, -1) && getCompiledBytecode(scriptPath) != NULL;
+   lua_pop(luaStack, 1);
+   if(pureIdle)
+   {
+      lua_pushnil(luaStack);
+      lua_setfield(luaStack, globals, "aiIdle");
+      DEBUG("Function aiIdle was found, so the idle logic of %s will run apart from the main VM", npc->getName().c_str());
+   }
+
+   // Push the NPC once, and keep it around to pass to each of its functions
+   luaW_push<Actor>(luaStack, npc);
+   npcRef = luaL_ref(luaStack, references);
 
+   // Leave nothing that the chunk returned on the stack that the functions run on
+   lua_settop(luaStack, 0);
 }
 
-bool NPCScript::callFunction(NPCFunction function)
+bool NPCScript::pushReferences()
 {
-   if(functionExists[function])
+   if(environment == ScriptEnvironments::NO_ENVIRONMENT)
+   {
+      lua_pushvalue(luaStack, LUA_REGISTRYINDEX);
+      return true;
+   }
+
+   return environments.push(luaStack, environment);
+}
+
+void NPCScript::releaseThread()
+{
+   // If the NPC's map has been left, its references went with the map's environment
+   if(luaStack != NULL && pushReferences())
    {
-      // Load the table of Lua functions for this NPC
-      lua_getglobal(luaStack, scriptName.c_str());
+      for(int i = 0; i < NUM_FUNCTIONS; ++i)
+      {
+         luaL_unref(luaStack, -1, functionRefs[i]);
+         functionRefs[i] = LUA_NOREF;
+      }
+
+      luaL_unref(luaStack, -1, npcRef);
+      npcRef = LUA_NOREF;
+      lua_pop(luaStack, 1);
+   }
 
-      // Grab the function name
-      const char* functionName = FUNCTION_NAMES[function];
+   Script::releaseThread();
+}
 
-      DEBUG("NPC %s running function %s", npc->getName().c_str(), functionName);
+bool NPCScript::callFunction(NPCFunction function)
+{
+   if(functionExists[function])
+   {
+      TRACE("NPC %s running function %s", npc->getName().c_str(), FUNCTION_NAMES[function]);
 
-      // Get the function from the NPC function table and push it on the stack
-      lua_pushstring(luaStack, functionName);
-      lua_gettable(luaStack, -2);
+      // Once the NPC's map has been left, its functions are gone along with the map's environment
+      if(!pushReferences())
+      {
+         return true;
+      }
 
-      // Push NPC as argument
-      luaW_push<Actor>(luaStack, npc);
+      // Push the function, and the NPC as its argument
+      lua_rawgeti(luaStack, -1, functionRefs[function]);
+      lua_rawgeti(luaStack, -2, npcRef);
+      lua_remove(luaStack, -3);
 
       // Run the script
       return runScript(1);
@@ -123,9 +177,30 @@ bool NPCScript::callFunction(NPCFunction function)
    return true;
 }
 
+bool NPCScript::hasPureIdle() const
+{
+   return pureIdle;
+}
+
+const std::string& NPCScript::getPureIdleBytecode() const
+{
+   return *getCompiledBytecode(scriptName);
+}
+
 bool NPCScript::resume(long timePassed)
 {
-   if(finished) return true;
+   if(finished)
+   {
+      releaseThread();
+      return true;
+   }
+
+   if(pooled)
+   {
+      // The NPC isn't on the map, so there is nothing to run until it is spawned again
+      scheduler.suspend();
+      return false;
+   }
    
    if(activated)
    {
@@ -135,36 +210,68 @@ bool NPCScript::resume(long timePassed)
 
    if(running)
    {
-      DEBUG("NPC Thread %d resuming running script.", getId());
+      TRACE("NPC Thread %d resuming running script.", getId());
       runScript();
    }
    else
    {
-      if(npc->isIdle())
+      // A pure idle function is run by the tile engine instead
+      if(npc->isIdle() && !pureIdle)
       {
          callFunction(IDLE);
       }
    }
 
+   // Once the NPC is done responding to the player, it goes back to being part of the scenery
+   if(!running && !activated && getPriority() != Thread::AMBIENT)
+   {
+      scheduler.setPriority(this, Thread::AMBIENT);
+   }
+
+   // If the script isn't waiting on anything and there is nothing for it to run,
+   // then sleep until the NPC runs out of orders or is activated
+   if(!running && !activated && !(functionExists[IDLE] && !pureIdle && npc->isIdle()))
+   {
+      scheduler.suspend();
+   }
+
    return false;
 }
 
 void NPCScript::activate()
 {
+   // The player is waiting on the NPC's response, so it isn't put off with the ambient threads
    activated = true;
+   scheduler.setPriority(this, Thread::INTERACTIVE);
+   scheduler.wake(this);
+}
+
+void NPCScript::ordersFinished()
+{
+   scheduler.wake(this);
 }
 
 void NPCScript::finish()
 {
    finished = true;
+   scheduler.wake(this);
 }
 
-NPCScript::~NPCScript()
+bool NPCScript::setPooled(bool isPooled)
 {
-   /** \todo Check if this cleanup is appropriate. */
-   // Set the function table to nil so that it gets garbage collected
-   // lua_pushnil(luaStack);
-   // lua_setglobal(luaStack, scriptPath.c_str());
+   if(isPooled && (running || finished))
+   {
+      return false;
+   }
 
+   pooled = isPooled;
+   activated = false;
+   scheduler.wake(this);
+   return true;
+}
+
+NPCScript::~NPCScript()
+{
+   // The function references are released along with the thread, since the Lua VM may be gone by now
    delete [] functionExists;
 }
@@ -10,6 +10,8 @@
 #include "Script.h"
 
 class NPC;
+class Scheduler;
+class ScriptEnvironments;
 
 /**
  * An NPCScript is a type of Script that holds functions that determine
@@ -20,6 +22,18 @@ class NPC;
  * the NPC is busy and runs the NPC's idle script function if it is not doing
  * anything.
  *
+ * An NPC script that has nothing to do (because its NPC is busy with orders, or it has
+ * no idle function) suspends itself in the scheduler instead of checking again on every run.
+ * It is woken up by the events that can give it something to do: the NPC running out of orders,
+ * being activated, or being finished.
+ *
+ * NPC scripts are ambient threads in the scheduler, so they are the first to be put off when a run is short of time,
+ * except while the NPC is responding to being activated, since the player is waiting on it then.
+ *
+ * An NPC script can define an aiIdle function instead of an idle function, to mark its idle logic as pure.
+ * A pure idle function only reads a snapshot of the world and emits orders, so it isn't run on the
+ * script's own thread; the tile engine runs it apart from the main Lua VM (see AIStatePool).
+ *
  * The NPCScript and NPC need to be separate entities, because otherwise the
  * Scheduler could block the NPC in its entirety if the script executes a
  * blocking instruction.
@@ -58,27 +72,73 @@ class NPCScript : public Script
     */
    bool* functionExists;
 
+   /** The scheduler running this script. */
+   Scheduler& scheduler;
+
+   /** The environments of the script's VM. */
+   const ScriptEnvironments& environments;
+
+   /** The number of the environment of the NPC's map, which the script runs in. */
+   int environment;
+
    /** The NPC controlled by this script's execution. */
    NPC* npc;
 
+   /**
+    * The references to each of the NPC's functions, indexed using the NPCFunction enum.
+    * The references are kept in the environment of the NPC's map (or in the registry, if the script runs in the globals),
+    * so they are released along with the environment once the map is left.
+    * Only valid for the functions that exist.
+    */
+   int functionRefs[NUM_FUNCTIONS];
+
+   /**
+    * The reference to the NPC's Actor userdata (kept alongside the function references), which is pushed once and
+    * then handed to each function call.
+    */
+   int npcRef;
+
+   /** True iff the script defined a pure idle function (aiIdle), which is run by the tile engine instead of on this thread. */
+   bool pureIdle;
+
    /** True iff the NPC script received a signal to call the NPC's activate function. */
    bool activated;
 
    /** True iff the NPC script is finished and should be unscheduled. */
    bool finished;
 
+   /** True iff the NPC is waiting in the tile engine's pool to be spawned again, so the script's functions shouldn't run. */
+   bool pooled;
+
+   /**
+    * Pushes the table that the script's references are kept in.
+    *
+    * @return true iff the table was pushed, or false (with nothing pushed) if the environment of the NPC's map has been dropped.
+    */
+   bool pushReferences();
+
+   protected:
+      /**
+       * Releases the NPC's functions and Actor userdata, then hands the script's thread back to the pool.
+       */
+      void releaseThread();
+
    public:
       /**
        * Constructor.
-       * Creates a new Lua thread by forking the main VM, and then
-       * loads the specified script file's NPC functions into the Lua environment.
-       * The functions are then moved from the environment globals table into
-       * a unique table specifically reserved for this NPC.
+       * Takes a Lua thread from the pool, and then
+       * loads the specified script file's NPC functions into the environment of the NPC's map.
+       * The functions are then removed from the environment and
+       * kept as references reserved for this NPC.
        *
-       * @param luaVM The main Lua stack to fork a thread from.
+       * @param threadPool The pool to take the script's thread from.
+       * @param scheduler The scheduler that runs the script.
+       * @param environments The environments of the script's VM.
+       * @param environment The number of the environment of the NPC's map.
        * @param scriptPath The path to a script that should be run on this thread.
+       * @param npc The NPC controlled by the script.
        */
-      NPCScript(lua_State* luaVM, const std::string& scriptPath, NPC* npc);
+      NPCScript(ScriptThreadPool& threadPool, Scheduler& scheduler, const ScriptEnvironments& environments, int environment, const std::string& scriptPath, NPC* npc);
 
       /**
        * Call a function on this NPC's script.
@@ -90,6 +150,17 @@ class NPCScript : public Script
        */
       bool callFunction(NPCFunction function);
 
+      /**
+       * @return true iff the script defined a pure idle function (aiIdle), which should be run apart from the main Lua VM.
+       */
+      bool hasPureIdle() const;
+
+      /**
+       * @return The bytecode of the script, for loading its pure idle function into another Lua state.
+       *         Only valid if the script has a pure idle function.
+       */
+      const std::string& getPureIdleBytecode() const;
+
       /**
        * Either resume the NPC's script if it is running, or run the script's
        * idle function if the NPC isn't doing anything.
@@ -107,12 +178,30 @@ class NPCScript : public Script
        */
       void activate();
 
+      /**
+       * Signal that the NPC has finished all of its orders, so that the
+       * script can run the NPC's idle function again.
+       */
+      void ordersFinished();
+
       /**
        * Signal that the NPC is finished, and its thread should no longer
        * execute.
        */
       void finish();
 
+      /**
+       * Puts the script to sleep while its NPC waits in the tile engine's pool, or wakes it up
+       * (to run the NPC's idle function) once the NPC is spawned again.
+       * A script can't be pooled in the middle of a run, since it would carry on
+       * with the NPC wherever it happens to be spawned next.
+       *
+       * @param isPooled true iff the NPC is being put into the pool.
+       *
+       * @return true iff the script was pooled or unpooled.
+       */
+      bool setPooled(bool isPooled);
+
       /**
        * Destructor.
        */
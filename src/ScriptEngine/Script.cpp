@@ -5,6 +5,14 @@
  */
 
 #include "Script.h"
+#include "AssetArchive.h"
+#include "ScriptEnvironments.h"
+#include "ScriptThreadPool.h"
+#include "ScriptSampler.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
 
 // Include the Lua libraries. Since they are written in clean C, the functions
 // need to be included in this fashion to work with the C++ code.
@@ -18,8 +26,105 @@ extern "C"
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_SCRIPT_ENG;
 
-Script::Script(const std::string& name) : scriptName(name), running(false)
+Script* Script::resumingScript = NULL;
+std::map<std::string, Script::CompiledChunk> Script::compiledChunks;
+
+Script::Script(const std::string& name, ScriptThreadPool& threadPool) : hookInterval(INSTRUCTIONS_PER_SLICE), sliceInstructions(0), sampledNameId(-1), threadPool(threadPool), scriptName(name), running(false)
+{
+   luaStack = threadPool.acquireThread(threadRef);
+}
+
+void Script::setEnvironment(const ScriptEnvironments& environments, int environment)
+{
+   // Until the script first runs, its stack holds nothing but the loaded chunk (or the error that loading it failed with)
+   if(!running && lua_isfunction(luaStack, 1) && environments.push(luaStack, environment))
+   {
+      lua_setfenv(luaStack, 1);
+   }
+}
+
+void Script::releaseThread()
+{
+   if(luaStack != NULL)
+   {
+      threadPool.releaseThread(luaStack, threadRef);
+      luaStack = NULL;
+   }
+}
+
+int Script::writeBytecode(lua_State* /*luaStack*/, const void* data, size_t size, void* bytecode)
+{
+   static_cast<std::string*>(bytecode)->append(static_cast<const char*>(data), size);
+   return 0;
+}
+
+int Script::loadFile(const std::string& path)
+{
+   // The '@' marks the chunk name as a file name, so that Lua reports errors the same way it does for luaL_loadfile
+   const std::string chunkName = "@" + path;
+
+   // Work out what the file is served from, so that a compiled chunk is only used if it was compiled from the same source
+   CompiledChunk source;
+   source.modificationTime = 0;
+   source.fileSize = -1;
+
+   std::size_t archivedSize = 0;
+   if(!AssetArchive::find(path, source.archivedSource, archivedSize))
+   {
+      source.archivedSource = NULL;
+
+      struct stat fileStatus;
+      if(stat(path.c_str(), &fileStatus) == 0)
+      {
+         source.modificationTime = fileStatus.st_mtime;
+         source.fileSize = fileStatus.st_size;
+      }
+   }
+
+   std::map<std::string, CompiledChunk>::const_iterator compiled = compiledChunks.find(path);
+   if(compiled != compiledChunks.end() && compiled->second.archivedSource == source.archivedSource
+         && (source.archivedSource != NULL || (compiled->second.modificationTime == source.modificationTime && compiled->second.fileSize == source.fileSize)))
+   {
+      // Lua tells compiled chunks apart from source by their signature
+      const std::string& bytecode = compiled->second.bytecode;
+      return luaL_loadbuffer(luaStack, bytecode.data(), bytecode.size(), chunkName.c_str());
+   }
+
+   int result;
+   if(source.archivedSource != NULL)
+   {
+      result = luaL_loadbuffer(luaStack, source.archivedSource, archivedSize, chunkName.c_str());
+   }
+   else
+   {
+      std::vector<char> contents;
+      if(!AssetArchive::read(path, contents))
+      {
+         lua_pushfstring(luaStack, "cannot open %s", path.c_str());
+         return LUA_ERRFILE;
+      }
+
+      result = luaL_loadbuffer(luaStack, contents.empty() ? "" : &contents[0], contents.size(), chunkName.c_str());
+   }
+
+   if(result == 0)
+   {
+      // Keep the compiled chunk (which is on top of the stack) for the next time the file is loaded
+      source.bytecode.clear();
+      if(lua_dump(luaStack, writeBytecode, &source.bytecode) == 0)
+      {
+         DEBUG("Compiled %s into %d bytes of bytecode.", path.c_str(), static_cast<int>(source.bytecode.size()));
+         compiledChunks[path] = source;
+      }
+   }
+
+   return result;
+}
+
+const std::string* Script::getCompiledBytecode(const std::string& path)
 {
+   std::map<std::string, CompiledChunk>::const_iterator compiled = compiledChunks.find(path);
+   return compiled != compiledChunks.end() ? &compiled->second.bytecode : NULL;
 }
 
 bool Script::runScript(int numArgs)
@@ -31,21 +136,38 @@ bool Script::runScript(int numArgs)
 
    running = true;
 
-   DEBUG("Resuming script with name %s, thread ID %d...", scriptName.c_str(), threadId);
-   DEBUG("Lua Thread Address: 0x%x", luaStack);
+   TRACE("Resuming script with name %s, thread ID %d...", scriptName.c_str(), threadId);
+   TRACE("Lua Thread Address: 0x%x", luaStack);
+
+   // The hook is only set while the script is resumed, since yielding from it anywhere else
+   // (such as in a protected call on the script's stack) would be an error
+   preempted = false;
+   Script* const previousScript = resumingScript;
+   resumingScript = this;
+
+   // While the scripts are sampled, the hook fires more often than once a slice, and counts the slice out itself
+   const bool sampled = ScriptSampler::isEnabled();
+   hookInterval = sampled ? std::min(ScriptSampler::getInterval(), INSTRUCTIONS_PER_SLICE) : INSTRUCTIONS_PER_SLICE;
+   sliceInstructions = 0;
+   sampledNameId = sampled ? ScriptSampler::getNameId(scriptName.c_str()) : -1;
+   lua_sethook(luaStack, preemptHook, LUA_MASKCOUNT, hookInterval);
 
    int returnCode = lua_resume(luaStack, numArgs);
+
+   lua_sethook(luaStack, NULL, 0, 0);
+   resumingScript = previousScript;
+
    switch(returnCode)
    {
       case 0:
       {
-         DEBUG("Script %d finished.", threadId);
+         TRACE("Script %d finished.", threadId);
          running = false;
          return true;
       }
       case LUA_YIELD:
       {
-         DEBUG("Script %d yielded.", threadId);
+         TRACE(preempted ? "Script %d was preempted." : "Script %d yielded.", threadId);
          return false;
       }
       default:
@@ -53,17 +175,74 @@ bool Script::runScript(int numArgs)
          // An error occurred: Print out the error message
          DEBUG("Error running script: %s", lua_tostring(luaStack, -1));
          running = false;
+         releaseThread();
          T_T("An error occured running this script.");
       }
    }
 }
 
+void Script::preemptHook(lua_State* luaStack, lua_Debug* /*debugInfo*/)
+{
+   if(resumingScript == NULL || resumingScript->luaStack != luaStack)
+   {
+      return;
+   }
+
+   if(resumingScript->sampledNameId >= 0)
+   {
+      ScriptSampler::sample(luaStack, resumingScript->sampledNameId);
+   }
+
+   resumingScript->sliceInstructions += resumingScript->hookInterval;
+   if(resumingScript->sliceInstructions >= INSTRUCTIONS_PER_SLICE && isAtResumedCallLevel(luaStack))
+   {
+      resumingScript->preempted = true;
+      lua_yield(luaStack, 0);
+   }
+}
+
+bool Script::isAtResumedCallLevel(lua_State* luaStack)
+{
+   lua_Debug debugInfo;
+   for(int level = 0; lua_getstack(luaStack, level, &debugInfo); ++level)
+   {
+      lua_getinfo(luaStack, "Sn", &debugInfo);
+
+      // Tail calls leave no frame behind, so they are skipped over; C functions are where Lua can't yield past
+      if(strcmp(debugInfo.what, "tail") == 0) continue;
+      if(strcmp(debugInfo.what, "C") == 0) return false;
+
+      // The outermost function was started by the resume itself
+      lua_Debug callerInfo;
+      if(!lua_getstack(luaStack, level + 1, &callerInfo)) return true;
+
+      // Lua only names the functions that were called by a call instruction, so a nameless function was called another way
+      // (such as a metamethod). Generic for loops call their iterators through a C call, under a hidden local's name.
+      if(debugInfo.namewhat[0] == '\0' || (debugInfo.name != NULL && debugInfo.name[0] == '('))
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
 bool Script::resume(long /*timePassed*/)
 {
    bool result = runScript();
+   if(result)
+   {
+      releaseThread();
+   }
+
    return result;
 }
 
+std::string Script::getName()
+{
+   return scriptName;
+}
+
 int Script::yield()
 {
    return lua_yield(luaStack, 0);
@@ -8,18 +8,109 @@
 #define SCRIPT_H
 
 #include "Thread.h"
+#include <ctime>
+#include <map>
 #include <string>
 
+class ScriptEnvironments;
+class ScriptThreadPool;
 struct lua_State;
+struct lua_Debug;
 
 /**
  * A Script is a type of Thread that runs a Lua coroutine. As such, the Script
  * object can resume or yield a Lua thread of execution.
  *
+ * The script's Lua thread comes from a ScriptThreadPool, and is handed back as soon as the script finishes
+ * (rather than when the script is deleted, which can be after the Lua VM is closed).
+ *
+ * While a script runs, a Lua count hook preempts it every INSTRUCTIONS_PER_SLICE instructions, so that a long
+ * (or endless) loop in a script can't stall the game. A preempted script is left to be resumed where it left off,
+ * when the scheduler has time for it. Lua can't yield across a C call, so a script that uses up its slice inside a protected call,
+ * a metamethod, a generic for's iterator or a callback from C (such as a table.sort comparator) overruns its slice until
+ * it returns to the script's own functions, and long loops there should be avoided. While the scripts are being sampled (see ScriptSampler),
+ * the same hook fires every sampling interval, and only preempts the script once it has run a whole slice.
+ *
+ * Script files are only compiled the first time that they are loaded. The compiled chunks are kept in memory,
+ * so that scripts that are loaded again (such as when a map is entered again and its NPCs are spawned) skip
+ * reading and compiling their source. A loose script file is compiled again if it changes on disk.
+ *
  * @author Noam Chitayat
  */
 class Script : public Thread
 {
+   /** The number of Lua instructions that a script can run before it is preempted. */
+   static const int INSTRUCTIONS_PER_SLICE = 10000;
+
+   /** The script whose Lua thread is being resumed, or NULL if none is. */
+   static Script* resumingScript;
+
+   /**
+    * The Lua count hook set while a script runs, which yields the script's coroutine to preempt it.
+    *
+    * @param luaStack The Lua thread of the running script.
+    * @param debugInfo The hook event.
+    */
+   static void preemptHook(lua_State* luaStack, lua_Debug* debugInfo);
+
+   /**
+    * Checks whether a running script could yield from the count hook, which it can only do if every function on its stack
+    * was called straight from its caller's Lua code, without a C call in between.
+    * Lua doesn't say how deep in C calls a thread is, so functions whose calls can't be told apart from C calls
+    * (such as the targets of tail calls) count as C calls, and the script waits until they return.
+    *
+    * @param luaStack The Lua thread of the running script.
+    *
+    * @return true iff the script is running at the C call level that it was resumed at.
+    */
+   static bool isAtResumedCallLevel(lua_State* luaStack);
+
+   /** The number of instructions between calls to the count hook during the current resume. */
+   int hookInterval;
+
+   /** The number of instructions that the script has run since it was last resumed, as counted by the hook. */
+   int sliceInstructions;
+
+   /** The sampler's ID for the script's name, if the current resume is being sampled, or -1 otherwise. */
+   int sampledNameId;
+
+   /** A compiled script file, as dumped by Lua. */
+   struct CompiledChunk
+   {
+      /** The bytecode of the chunk. */
+      std::string bytecode;
+
+      /** The archived contents that the chunk was compiled from, or NULL if it was compiled from a loose file. */
+      const char* archivedSource;
+
+      /** The modification time of the loose file that the chunk was compiled from. */
+      time_t modificationTime;
+
+      /** The size of the loose file that the chunk was compiled from (in bytes). */
+      long fileSize;
+   };
+
+   /** The compiled script files, by path. */
+   static std::map<std::string, CompiledChunk> compiledChunks;
+
+   /**
+    * Adds a piece of a dumped chunk to its bytecode (a Lua chunk writer).
+    *
+    * @param luaStack The Lua thread dumping the chunk.
+    * @param data The piece of the chunk.
+    * @param size The size of the piece (in bytes).
+    * @param bytecode The std::string that the bytecode is collected in.
+    *
+    * @return 0, to keep the dump going.
+    */
+   static int writeBytecode(lua_State* luaStack, const void* data, size_t size, void* bytecode);
+
+   /** The pool that the script's thread comes from. */
+   ScriptThreadPool& threadPool;
+
+   /** The registry reference that anchors the script's thread. */
+   int threadRef;
+
    protected:
       /** The stack and execution thread of this script. */
       lua_State* luaStack;
@@ -41,11 +132,46 @@ class Script : public Thread
        */
       bool runScript(int numArgs = 0);
 
+      /**
+       * Loads a Lua script file as a function on top of the script's stack, as luaL_loadfile does,
+       * but reading the file through the asset archive if it holds the file.
+       * The file is only compiled if it hasn't been compiled before, or has changed since.
+       *
+       * @param path The path to the script file.
+       *
+       * @return 0 on success, or a Lua error code (with the error message on top of the stack) otherwise.
+       */
+      int loadFile(const std::string& path);
+
+      /**
+       * @param path The path to a script file.
+       *
+       * @return The bytecode that the file was compiled to when it was last loaded, or NULL if it hasn't been loaded.
+       */
+      static const std::string* getCompiledBytecode(const std::string& path);
+
+      /**
+       * Hands the script's thread back to the pool. The script can't be run after this.
+       */
+      virtual void releaseThread();
+
    public:
       /**
-       * Constructor.
+       * Constructor. Takes a Lua thread for the script from the pool.
+       *
+       * @param name The name of the script.
+       * @param threadPool The pool to take the script's thread from.
        */
-      Script(const std::string& name);
+      Script(const std::string& name, ScriptThreadPool& threadPool);
+
+      /**
+       * Runs the script's chunk in an environment instead of the VM's globals, so that the globals it sets
+       * are kept in the environment. This has no effect once the script has started running.
+       *
+       * @param environments The environments of the script's VM.
+       * @param environment The number of the environment to run in.
+       */
+      void setEnvironment(const ScriptEnvironments& environments, int environment);
 
       /**
        * Performs a Lua resume on the thread.
@@ -54,6 +180,11 @@ class Script : public Thread
        */
       bool resume(long timePassed);
 
+      /**
+       * @return The name of the script.
+       */
+      std::string getName();
+
       /**
        * Yield the thread
        *
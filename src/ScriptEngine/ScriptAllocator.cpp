@@ -0,0 +1,207 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ScriptAllocator.h"
+#include "MemoryTracker.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SCRIPT_ENG;
+
+// Keeps every small block aligned well enough for any of Lua's values
+const size_t ScriptAllocator::SIZE_CLASS_STEP = 16;
+
+// Covers the strings, tables, closures and upvalues that make up most of what scripts allocate
+const size_t ScriptAllocator::MAX_SMALL_BLOCK_SIZE = 256;
+
+// Big enough to hold dozens of the largest small blocks, without leaving much unused in a size class that is rarely used
+const size_t ScriptAllocator::PAGE_SIZE = 16 << 10;
+
+ScriptAllocator::ScriptAllocator() :
+   freeLists(MAX_SMALL_BLOCK_SIZE / SIZE_CLASS_STEP, static_cast<FreeBlock*>(NULL)),
+   bytesInUse(0),
+   peakBytesInUse(0),
+   memoryLimit(0),
+   frameAllocations(0),
+   lastFrameAllocations(0),
+   frameBytesAllocated(0),
+   lastFrameBytesAllocated(0),
+   trackedBytesInUse(0)
+{
+}
+
+void* ScriptAllocator::allocate(void* allocator, void* ptr, size_t oldSize, size_t newSize)
+{
+   return static_cast<ScriptAllocator*>(allocator)->reallocate(ptr, oldSize, newSize);
+}
+
+size_t ScriptAllocator::getSizeClass(size_t size)
+{
+   return (size - 1) / SIZE_CLASS_STEP;
+}
+
+void* ScriptAllocator::allocateSmallBlock(size_t sizeClass)
+{
+   if(freeLists[sizeClass] == NULL)
+   {
+      char* page = static_cast<char*>(malloc(PAGE_SIZE));
+      if(page == NULL) return NULL;
+
+      pages.push_back(page);
+
+      // Thread the whole page onto the free list, so that its blocks come out in address order
+      const size_t blockSize = (sizeClass + 1) * SIZE_CLASS_STEP;
+      const size_t numBlocks = PAGE_SIZE / blockSize;
+      for(size_t i = numBlocks; i > 0; --i)
+      {
+         FreeBlock* block = reinterpret_cast<FreeBlock*>(page + (i - 1) * blockSize);
+         block->next = freeLists[sizeClass];
+         freeLists[sizeClass] = block;
+      }
+   }
+
+   FreeBlock* block = freeLists[sizeClass];
+   freeLists[sizeClass] = block->next;
+   return block;
+}
+
+void ScriptAllocator::freeSmallBlock(void* block, size_t sizeClass)
+{
+   FreeBlock* freeBlock = static_cast<FreeBlock*>(block);
+   freeBlock->next = freeLists[sizeClass];
+   freeLists[sizeClass] = freeBlock;
+}
+
+void* ScriptAllocator::reallocate(void* ptr, size_t oldSize, size_t newSize)
+{
+   // Lua passes a meaningless old size along with a new block
+   if(ptr == NULL) oldSize = 0;
+
+   if(newSize == 0)
+   {
+      if(ptr != NULL)
+      {
+         if(oldSize <= MAX_SMALL_BLOCK_SIZE)
+         {
+            freeSmallBlock(ptr, getSizeClass(oldSize));
+         }
+         else
+         {
+            free(ptr);
+         }
+
+         bytesInUse -= oldSize;
+      }
+
+      return NULL;
+   }
+
+   // Only a block that grows can go over the cap, since Lua can't handle a block failing to shrink
+   if(memoryLimit > 0 && newSize > oldSize && bytesInUse + (newSize - oldSize) > memoryLimit)
+   {
+      LOG_WARNING("Script memory limit of %d bytes reached.", static_cast<int>(memoryLimit));
+      return NULL;
+   }
+
+   const bool wasSmall = ptr != NULL && oldSize <= MAX_SMALL_BLOCK_SIZE;
+   const bool isSmall = newSize <= MAX_SMALL_BLOCK_SIZE;
+   void* block;
+
+   if(wasSmall && isSmall && getSizeClass(oldSize) == getSizeClass(newSize))
+   {
+      // The block already has room for its new size
+      block = ptr;
+   }
+   else if(!wasSmall && !isSmall)
+   {
+      block = realloc(ptr, newSize);
+      if(block == NULL) return NULL;
+   }
+   else
+   {
+      // The block moves between a size class and the heap, or between two size classes
+      block = isSmall ? allocateSmallBlock(getSizeClass(newSize)) : malloc(newSize);
+      if(block == NULL) return NULL;
+
+      if(ptr != NULL)
+      {
+         memcpy(block, ptr, std::min(oldSize, newSize));
+         if(wasSmall)
+         {
+            freeSmallBlock(ptr, getSizeClass(oldSize));
+         }
+         else
+         {
+            free(ptr);
+         }
+      }
+   }
+
+   bytesInUse = bytesInUse - oldSize + newSize;
+   peakBytesInUse = std::max(peakBytesInUse, bytesInUse);
+
+   if(newSize > oldSize)
+   {
+      ++frameAllocations;
+      frameBytesAllocated += newSize - oldSize;
+   }
+
+   return block;
+}
+
+void ScriptAllocator::setMemoryLimit(size_t bytes)
+{
+   memoryLimit = bytes;
+}
+
+size_t ScriptAllocator::getMemoryLimit() const
+{
+   return memoryLimit;
+}
+
+size_t ScriptAllocator::getBytesInUse() const
+{
+   return bytesInUse;
+}
+
+size_t ScriptAllocator::getPeakBytesInUse() const
+{
+   return peakBytesInUse;
+}
+
+void ScriptAllocator::endFrame()
+{
+   lastFrameAllocations = frameAllocations;
+   lastFrameBytesAllocated = frameBytesAllocated;
+   frameAllocations = 0;
+   frameBytesAllocated = 0;
+
+   // The tracker is told about the VM's memory once a frame, rather than on each of the VM's many allocations
+   MemoryTracker::addExternalBytes(MemoryTracker::LUA, static_cast<long>(bytesInUse) - static_cast<long>(trackedBytesInUse));
+   trackedBytesInUse = bytesInUse;
+}
+
+unsigned long ScriptAllocator::getLastFrameAllocations() const
+{
+   return lastFrameAllocations;
+}
+
+size_t ScriptAllocator::getLastFrameBytesAllocated() const
+{
+   return lastFrameBytesAllocated;
+}
+
+ScriptAllocator::~ScriptAllocator()
+{
+   MemoryTracker::addExternalBytes(MemoryTracker::LUA, -static_cast<long>(trackedBytesInUse));
+
+   for(std::vector<char*>::iterator iter = pages.begin(); iter != pages.end(); ++iter)
+   {
+      free(*iter);
+   }
+}
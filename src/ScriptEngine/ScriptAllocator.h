@@ -0,0 +1,179 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SCRIPT_ALLOCATOR_H
+#define SCRIPT_ALLOCATOR_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * The memory allocator for the Lua VM (passed to lua_newstate along with the allocator itself).
+ *
+ * Scripts make a great many small allocations (strings, tables, closures and the coroutines that they run on)
+ * that are freed again soon after. Blocks up to MAX_SMALL_BLOCK_SIZE bytes are rounded up to a size class,
+ * and carved out of pages that the allocator keeps for the VM; freed blocks go onto a free list for their size
+ * class to be handed out again, so small blocks never go through malloc and don't fragment the heap.
+ * Larger blocks go straight to realloc and free.
+ *
+ * The Lua VM is only ever used from the main thread, so the free lists need no locking.
+ *
+ * The allocator counts the memory that the VM uses and the allocations it makes each frame, and can cap the memory
+ * that scripts use: an allocation that would go over the cap fails, which Lua raises as a memory error in the script.
+ * The memory that the VM uses is passed on to the MemoryTracker at the end of each frame.
+ *
+ * The pages are only freed when the allocator is destroyed, which must be after the VM is closed.
+ */
+class ScriptAllocator
+{
+   /** A free block, which holds a link to the next free block of its size class. */
+   struct FreeBlock
+   {
+      FreeBlock* next;
+   };
+
+   /** The size of each size class apart from the next. */
+   static const size_t SIZE_CLASS_STEP;
+
+   /** The largest block (in bytes) that comes out of the size classes. */
+   static const size_t MAX_SMALL_BLOCK_SIZE;
+
+   /** The size (in bytes) of each page that small blocks are carved out of. */
+   static const size_t PAGE_SIZE;
+
+   /** The free blocks of each size class. */
+   std::vector<FreeBlock*> freeLists;
+
+   /** The pages that small blocks are carved out of. */
+   std::vector<char*> pages;
+
+   /** The memory (in bytes) that the VM has allocated and not yet freed. */
+   size_t bytesInUse;
+
+   /** The most memory (in bytes) that the VM has had allocated at once. */
+   size_t peakBytesInUse;
+
+   /** The most memory (in bytes) that the VM can have allocated at once, or 0 if there is no cap. */
+   size_t memoryLimit;
+
+   /** The number of allocations made since the frame began. */
+   unsigned long frameAllocations;
+
+   /** The number of allocations made in the last frame. */
+   unsigned long lastFrameAllocations;
+
+   /** The memory (in bytes) allocated since the frame began. */
+   size_t frameBytesAllocated;
+
+   /** The memory (in bytes) allocated in the last frame. */
+   size_t lastFrameBytesAllocated;
+
+   /** The memory (in bytes) that the VM had allocated when the memory tracker was last told about it. */
+   size_t trackedBytesInUse;
+
+   /**
+    * @param size The size (in bytes) of a small block.
+    *
+    * @return The index of the size class that the block falls into.
+    */
+   static size_t getSizeClass(size_t size);
+
+   /**
+    * Takes a block out of the free list for a size class, carving a new page into blocks first if the list is empty.
+    *
+    * @param sizeClass The index of the size class.
+    *
+    * @return The block.
+    */
+   void* allocateSmallBlock(size_t sizeClass);
+
+   /**
+    * Puts a block back onto the free list for its size class.
+    *
+    * @param block The block.
+    * @param sizeClass The index of the size class.
+    */
+   void freeSmallBlock(void* block, size_t sizeClass);
+
+   /**
+    * Allocates, resizes or frees a block, as Lua's allocator function does.
+    *
+    * @param ptr The block to resize or free, or NULL to allocate a new one.
+    * @param oldSize The size (in bytes) of the block, if there is one.
+    * @param newSize The size (in bytes) that the block needs to be, or 0 to free it.
+    *
+    * @return The block, or NULL if it was freed or couldn't be allocated.
+    */
+   void* reallocate(void* ptr, size_t oldSize, size_t newSize);
+
+   /** Script allocators can't be copied. */
+   ScriptAllocator(const ScriptAllocator&);
+
+   /** Script allocators can't be copied. */
+   ScriptAllocator& operator=(const ScriptAllocator&);
+
+   public:
+      /**
+       * Constructor.
+       */
+      ScriptAllocator();
+
+      /**
+       * The allocator function to hand to lua_newstate, which calls on the allocator passed to it as its user data.
+       *
+       * @param allocator The ScriptAllocator that the VM was created with.
+       * @param ptr The block to resize or free, or NULL to allocate a new one.
+       * @param oldSize The size (in bytes) of the block, if there is one.
+       * @param newSize The size (in bytes) that the block needs to be, or 0 to free it.
+       *
+       * @return The block, or NULL if it was freed or couldn't be allocated.
+       */
+      static void* allocate(void* allocator, void* ptr, size_t oldSize, size_t newSize);
+
+      /**
+       * Sets the most memory that the VM can have allocated at once.
+       *
+       * @param bytes The cap (in bytes), or 0 to let the VM use as much memory as it likes.
+       */
+      void setMemoryLimit(size_t bytes);
+
+      /**
+       * @return The most memory (in bytes) that the VM can have allocated at once, or 0 if there is no cap.
+       */
+      size_t getMemoryLimit() const;
+
+      /**
+       * @return The memory (in bytes) that the VM has allocated and not yet freed.
+       */
+      size_t getBytesInUse() const;
+
+      /**
+       * @return The most memory (in bytes) that the VM has had allocated at once.
+       */
+      size_t getPeakBytesInUse() const;
+
+      /**
+       * Finishes counting the allocations made in a frame, and starts counting them for the next one.
+       */
+      void endFrame();
+
+      /**
+       * @return The number of allocations made in the last frame.
+       */
+      unsigned long getLastFrameAllocations() const;
+
+      /**
+       * @return The memory (in bytes) allocated in the last frame.
+       */
+      size_t getLastFrameBytesAllocated() const;
+
+      /**
+       * Destructor. Frees the pages that small blocks were carved out of.
+       */
+      ~ScriptAllocator();
+};
+
+#endif
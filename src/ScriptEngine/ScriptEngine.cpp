@@ -9,21 +9,31 @@
 #include "PlayerData.h"
 #include "Scheduler.h"
 #include "ResourceLoader.h"
+#include "StringTable.h"
 #include "Music.h"
 #include "Sound.h"
-#include "Timer.h"
+#include "GraphicsUtil.h"
 #include "NPC.h"
 #include "FileScript.h"
 #include "StringScript.h"
+#include "StringScriptCache.h"
+#include "ScriptThreadPool.h"
+#include "ScriptEnvironments.h"
 #include "ScriptFactory.h"
+#include "TimelinePlayer.h"
 
 #include "LuaPlayerCharacter.h"
 #include "LuaActor.h"
 #include "LuaTileEngine.h"
 
 #include "LuaQuest.h"
+#include "LuaFlagStore.h"
+#include "LuaFFI.h"
 
 #include "LuaWrapper.hpp"
+#include "FrameProfiler.h"
+#include <SDL.h>
+#include <algorithm>
 
 // Include the Lua libraries. Since they are written in clean C, the functions
 // need to be included in this fashion to work with the C++ code.
@@ -37,10 +47,33 @@ extern "C"
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_SCRIPT_ENG;
 
+// Most frames make less garbage than this, so cycles don't run back to back while a map is quiet
+const int ScriptEngine::IDLE_COLLECTION_THRESHOLD = 50;
+
+// Small enough that a step never runs noticeably past the end of the idle time
+const int ScriptEngine::IDLE_COLLECTION_STEP_SIZE = 8;
+
+// Well past the idle threshold, so that allocations only start a cycle mid-frame when the idle time keeps running out
+const int ScriptEngine::DEFAULT_GC_PAUSE = 300;
+
+/**
+ * Reports an error raised outside of any protected call, just before Lua aborts.
+ *
+ * @param luaVM The Lua VM that raised the error.
+ *
+ * @return 0, since there is nothing to recover.
+ */
+static int panic(lua_State* luaVM)
+{
+   DEBUG("Unprotected error in call to Lua API: %s", lua_tostring(luaVM, -1));
+   return 0;
+}
+
 ScriptEngine::ScriptEngine(TileEngine& tileEngine, PlayerData& playerData, Scheduler& scheduler)
-                                  : tileEngine(tileEngine), playerData(playerData), scheduler(scheduler)
+                                  : tileEngine(tileEngine), playerData(playerData), scheduler(scheduler), threadPool(NULL), stringScripts(NULL), environments(NULL),
+                                    mapEnvironment(ScriptEnvironments::NO_ENVIRONMENT), collectingGarbage(false), heapSizeAfterCollection(0), heapSize(0), peakHeapSize(0)
 {
-   luaVM = luaL_newstate();
+   luaVM = lua_newstate(ScriptAllocator::allocate, &allocator);
 
    if(luaVM == NULL)
    {
@@ -48,17 +81,20 @@ ScriptEngine::ScriptEngine(TileEngine& tileEngine, PlayerData& playerData, Sched
       T_T("Unable to initialize Lua state machine");
    }
 
+   // As luaL_newstate would, report errors that escape every protected call
+   lua_atpanic(luaVM, panic);
+
    //initialize standard Lua libraries
    luaL_openlibs(luaVM);
 
+   setGarbageCollectorPause(DEFAULT_GC_PAUSE);
+
+   threadPool = new ScriptThreadPool(luaVM);
+   stringScripts = new StringScriptCache(luaVM);
+   environments = new ScriptEnvironments(luaVM);
+
    // register game functions with Lua
    registerFunctions();
-
-   // Push this engine instance as a global pointer for the Lua VM
-   // This allows global C functions in our API to reference this instance
-   // (thus eliminating the need for a global ScriptEngine instance or singleton)
-   lua_pushlightuserdata(luaVM, this);
-   lua_setglobal(luaVM, SCRIPT_ENG_LUA_NAME);
    
    luaopen_TileEngine(luaVM);
    luaW_push<TileEngine>(luaVM, &tileEngine);
@@ -73,6 +109,12 @@ ScriptEngine::ScriptEngine(TileEngine& tileEngine, PlayerData& playerData, Sched
    luaopen_Quest(luaVM);
    luaW_push<Quest>(luaVM, playerData.getRootQuest());
    lua_setglobal(luaVM, "quests");
+
+   luaopen_FlagStore(luaVM);
+   luaW_push<FlagStore>(luaVM, &playerData.getFlags());
+   lua_setglobal(luaVM, "flags");
+
+   luaopen_FFI(luaVM);
 }
 
 int ScriptEngine::narrate(lua_State* luaStack)
@@ -131,6 +173,92 @@ int ScriptEngine::say(lua_State* luaStack)
    return callResult;
 }
 
+int ScriptEngine::conversation(lua_State* luaStack)
+{
+   int nargs = lua_gettop(luaStack);
+
+   int callResult = 0;
+
+   if(nargs > 0)
+   {
+      luaL_checktype(luaStack, 1, LUA_TTABLE);
+
+      // A conversation is waited on unless the script asks not to
+      bool waitForFinish = true;
+      if(nargs == 2)
+      {
+         waitForFinish = (lua_toboolean(luaStack, 2) == 1);
+      }
+
+      // Each line is either a string to say, or a table holding the line (as text) with an optional
+      // speaker (whose name is put in front of the line) and narrate flag
+      std::vector<TileEngine::ConversationLine> lines(lua_objlen(luaStack, 1));
+      for(unsigned int i = 0; i < lines.size(); ++i)
+      {
+         lua_rawgeti(luaStack, 1, i + 1);
+         TileEngine::ConversationLine& line = lines[i];
+         line.narrated = false;
+
+         if(lua_istable(luaStack, -1))
+         {
+            lua_getfield(luaStack, -1, "speaker");
+            if(lua_isstring(luaStack, -1))
+            {
+               line.speech.append(lua_tostring(luaStack, -1)).append(": ");
+            }
+
+            lua_getfield(luaStack, -2, "text");
+            line.speech.append(luaL_checkstring(luaStack, -1));
+
+            lua_getfield(luaStack, -3, "narrate");
+            line.narrated = (lua_toboolean(luaStack, -1) == 1);
+            lua_pop(luaStack, 3);
+         }
+         else
+         {
+            line.speech = luaL_checkstring(luaStack, -1);
+         }
+
+         lua_pop(luaStack, 1);
+      }
+
+      // The whole conversation is queued up at once, so the script only blocks (and resumes) once for all of it
+      Task* task = Task::getNextTask(scheduler);
+      if(waitForFinish)
+      {
+         callResult = scheduler.block(task);
+      }
+
+      DEBUG("Starting a conversation of %d lines", static_cast<int>(lines.size()));
+      tileEngine.dialogueConverse(lines, task);
+   }
+
+   return callResult;
+}
+
+int ScriptEngine::localize(lua_State* luaStack)
+{
+   const std::string id = luaL_checkstring(luaStack, 1);
+
+   // A missing string shows up as its ID, so that untranslated text is easy to spot without stopping the game
+   std::string text;
+   if(!StringTable::lookup(id, text))
+   {
+      DEBUG("String %s is missing from language %s.", id.c_str(), StringTable::getLanguage().c_str());
+      text = id;
+   }
+
+   lua_pushlstring(luaStack, text.data(), text.length());
+   return 1;
+}
+
+int ScriptEngine::setLanguage(lua_State* luaStack)
+{
+   const char* language = luaL_checkstring(luaStack, 1);
+   lua_pushboolean(luaStack, StringTable::setLanguage(language));
+   return 1;
+}
+
 int ScriptEngine::playSound(lua_State* luaStack)
 {
    int nargs = lua_gettop(luaStack);
@@ -141,16 +269,32 @@ int ScriptEngine::playSound(lua_State* luaStack)
       std::string soundName(lua_tostring(luaStack, 1));
       DEBUG("Playing sound: %s", soundName.c_str());
 
-      if(nargs == 2)
+      if(nargs >= 2)
       {
          waitForFinish = (lua_toboolean(luaStack, 2) == 1);
       }
 
       Task* task = Task::getNextTask(scheduler);
 
-      DEBUG("Playing sound: %s", soundName.c_str());
       Sound* sound = ResourceLoader::getSound(soundName);
-      sound->play(task);
+
+      // Scripts can place the sound on the map (in pixels), so that it is heard from where it happens,
+      // or play it from an actor (or an actor's handle), so that it follows the actor around
+      if(nargs >= 4)
+      {
+         sound->playAt(static_cast<int>(luaL_checkinteger(luaStack, 3)), static_cast<int>(luaL_checkinteger(luaStack, 4)), task);
+      }
+      else if(nargs == 3)
+      {
+         const ActorTable::ActorHandle emitter = lua_type(luaStack, 3) == LUA_TNUMBER
+               ? static_cast<ActorTable::ActorHandle>(lua_tonumber(luaStack, 3))
+               : tileEngine.getActorHandle(luaW_check<Actor>(luaStack, 3));
+         sound->playFrom(emitter, task);
+      }
+      else
+      {
+         sound->play(task);
+      }
 
       if(waitForFinish)
       {
@@ -171,7 +315,15 @@ int ScriptEngine::playMusic(lua_State* luaStack)
       DEBUG("Playing music: %s", musicName.c_str());
 
       Music* song = ResourceLoader::getMusic(musicName);
-      song->play();
+
+      // Scripts can give the song's loop points (in sample frames), so that a theme loops without a gap
+      if(nargs > 2)
+      {
+         song->setLoop(static_cast<Uint32>(luaL_checkinteger(luaStack, 3)), nargs > 3 ? static_cast<Uint32>(luaL_checkinteger(luaStack, 4)) : 0);
+      }
+
+      // The song crossfades in over the given time (in ms), if there is one
+      song->play(nargs > 1 ? static_cast<int>(luaL_checkinteger(luaStack, 2)) : 0);
    }
 
    return 0;
@@ -190,21 +342,140 @@ int ScriptEngine::stopMusic(lua_State* luaStack)
    return 0;
 }
 
+int ScriptEngine::prefetch(lua_State* luaStack)
+{
+   // Resources are named the same way in scripts as their directories are under data/
+   static const char* TYPE_NAMES[] = { "sound", "region", "tileset", "music", "spritesheet" };
+   static const ResourceLoader::ResourceType TYPES[] = { ResourceLoader::SOUND, ResourceLoader::REGION,
+         ResourceLoader::TILESET, ResourceLoader::MUSIC, ResourceLoader::SPRITESHEET };
+
+   int nargs = lua_gettop(luaStack);
+   bool waitForFinish = false;
+
+   if(nargs >= 2)
+   {
+      std::string typeName(lua_tostring(luaStack, 1));
+      std::string resourceName(lua_tostring(luaStack, 2));
+      if(nargs >= 3)
+      {
+         waitForFinish = (lua_toboolean(luaStack, 3) == 1);
+      }
+
+      for(unsigned int i = 0; i < sizeof(TYPES) / sizeof(TYPES[0]); ++i)
+      {
+         if(typeName == TYPE_NAMES[i])
+         {
+            DEBUG("Prefetching %s: %s", typeName.c_str(), resourceName.c_str());
+
+            // A script that waits for the resource blocks until the request is finished on the main thread
+            int callResult = 0;
+            Task* task = NULL;
+            if(waitForFinish)
+            {
+               task = Task::getNextTask(scheduler);
+               callResult = scheduler.block(task);
+            }
+
+            ResourceLoader::request(resourceName, TYPES[i], task);
+            return callResult;
+         }
+      }
+
+      DEBUG("Cannot prefetch unknown resource type: %s", typeName.c_str());
+   }
+
+   return 0;
+}
+
 int ScriptEngine::delay(lua_State* luaStack)
 {
    long timeToWait = (long)lua_tonumber(luaStack, 1);
-   DEBUG("Waiting %d milliseconds", timeToWait);
-   
-   Timer* waitTimer = new Timer(timeToWait);
-   scheduler.start(waitTimer);
-   
-   return scheduler.join(waitTimer);
+   TRACE("Waiting %d milliseconds", timeToWait);
+
+   return scheduler.sleep(timeToWait);
+}
+
+int ScriptEngine::startTransition(lua_State* luaStack, ScreenTransition::Style style, bool covering)
+{
+   int nargs = lua_gettop(luaStack);
+   bool waitForFinish = false;
+
+   if(nargs > 0)
+   {
+      long duration = (long)lua_tonumber(luaStack, 1);
+      if(nargs == 2)
+      {
+         waitForFinish = (lua_toboolean(luaStack, 2) == 1);
+      }
+
+      Task* task = Task::getNextTask(scheduler);
+
+      DEBUG("Starting a screen transition for %ld milliseconds", duration);
+      GraphicsUtil::getInstance()->getTransition()->start(style, 0.0f, 0.0f, 0.0f, covering, duration, task);
+
+      if(waitForFinish)
+      {
+         return scheduler.block(task);
+      }
+   }
+
+   return 0;
+}
+
+int ScriptEngine::fadeOut(lua_State* luaStack)
+{
+   return startTransition(luaStack, ScreenTransition::FADE, true);
+}
+
+int ScriptEngine::fadeIn(lua_State* luaStack)
+{
+   return startTransition(luaStack, ScreenTransition::FADE, false);
+}
+
+int ScriptEngine::wipeOut(lua_State* luaStack)
+{
+   return startTransition(luaStack, ScreenTransition::WIPE, true);
+}
+
+int ScriptEngine::wipeIn(lua_State* luaStack)
+{
+   return startTransition(luaStack, ScreenTransition::WIPE, false);
+}
+
+int ScriptEngine::playTimeline(lua_State* luaStack)
+{
+   int nargs = lua_gettop(luaStack);
+   bool waitForFinish = false;
+
+   if(nargs > 0)
+   {
+      std::string timelineName(luaL_checkstring(luaStack, 1));
+      if(nargs == 2)
+      {
+         waitForFinish = (lua_toboolean(luaStack, 2) == 1);
+      }
+
+      DEBUG("Playing timeline: %s", timelineName.c_str());
+      TimelinePlayer* player = new TimelinePlayer(tileEngine, *this, timelineName);
+
+      // The cutscene is timed to the frame, so its thread gets its turn even when the scheduler is short of time
+      scheduler.setPriority(player, Thread::CRITICAL);
+      scheduler.start(player);
+
+      if(waitForFinish)
+      {
+         return scheduler.join(player);
+      }
+   }
+
+   return 0;
 }
 
 int ScriptEngine::generateRandom(lua_State* luaStack)
 {
    int nargs = lua_gettop(luaStack);
    int min, max;
+   const char* streamName = RandomStreams::DEFAULT_STREAM;
    
    switch(nargs)
    {
@@ -214,6 +485,11 @@ int ScriptEngine::generateRandom(lua_State* luaStack)
          max = (int)luaL_checknumber(luaStack, 1);
          break;
       }
+      case 3:
+      {
+         streamName = luaL_checkstring(luaStack, 3);
+         // Fall through to read the range
+      }
       case 2:
       {
          min = (int)luaL_checknumber(luaStack, 1);
@@ -222,19 +498,30 @@ int ScriptEngine::generateRandom(lua_State* luaStack)
       }
       default:
       {
-         /** \todo Error case. */
-         min = 0;
-         max = 0;
-         break;
+         return luaL_error(luaStack, "random expects (max), (min, max) or (min, max, stream)");
       }
    }
    
-   /** \todo Random number generation is currently unseeded. Use a good seed. */
-   lua_pushnumber(luaStack, (rand() % (max - min)) + min);
+   lua_pushnumber(luaStack, playerData.getRandomStreams().nextInt(streamName, min, max));
 
    return 1;
 }
 
+int ScriptEngine::seedRandom(lua_State* luaStack)
+{
+   if(lua_gettop(luaStack) >= 2)
+   {
+      const char* streamName = luaL_checkstring(luaStack, 1);
+      playerData.getRandomStreams().seed(streamName, static_cast<Uint32>(luaL_checknumber(luaStack, 2)));
+   }
+   else
+   {
+      playerData.getRandomStreams().seed(static_cast<Uint32>(luaL_checknumber(luaStack, 1)));
+   }
+
+   return 0;
+}
+
 int ScriptEngine::setRegion(lua_State* luaStack)
 {
    int nargs = lua_gettop(luaStack);
@@ -257,18 +544,29 @@ int ScriptEngine::setRegion(lua_State* luaStack)
 
 NPCScript* ScriptEngine::getNPCScript(NPC* npc, const std::string& regionName, const std::string& mapName, const std::string& npcName)
 {
-   return ScriptFactory::getNPCScript(luaVM, npc, regionName, mapName, npcName);
+   return ScriptFactory::getNPCScript(*threadPool, scheduler, *environments, mapEnvironment, npc, regionName, mapName, npcName);
+}
+
+void ScriptEngine::enterMapEnvironment()
+{
+   if(mapEnvironment != ScriptEnvironments::NO_ENVIRONMENT)
+   {
+      environments->drop(mapEnvironment);
+   }
+
+   mapEnvironment = environments->create();
 }
 
 int ScriptEngine::runMapScript(const std::string& regionName, const std::string& mapName)
 {
-   Script* mapScript = ScriptFactory::getMapScript(luaVM, regionName, mapName);
+   Script* mapScript = ScriptFactory::getMapScript(*threadPool, regionName, mapName);
+   mapScript->setEnvironment(*environments, mapEnvironment);
    return runScript(mapScript);
 }
 
 int ScriptEngine::runChapterScript(const std::string& chapterName)
 {
-   Script* chapterScript = ScriptFactory::getChapterScript(luaVM, chapterName);
+   Script* chapterScript = ScriptFactory::getChapterScript(*threadPool, chapterName);
    return runScript(chapterScript);
 }
 
@@ -287,7 +585,7 @@ int ScriptEngine::runScript(Script* script)
 int ScriptEngine::runScriptString(const std::string& scriptString)
 {
    DEBUG("Running script string: %s", scriptString.c_str());
-   StringScript* newScript = new StringScript(luaVM, scriptString);
+   StringScript* newScript = new StringScript(*threadPool, *stringScripts, scriptString);
    scheduler.start(newScript);
 
    if(scheduler.hasRunningThread())
@@ -298,6 +596,27 @@ int ScriptEngine::runScriptString(const std::string& scriptString)
    return 0;
 }
 
+Thread* ScriptEngine::startScriptString(const std::string& scriptString)
+{
+   DEBUG("Starting script string: %s", scriptString.c_str());
+   StringScript* newScript = new StringScript(*threadPool, *stringScripts, scriptString);
+   scheduler.start(newScript);
+   return newScript;
+}
+
+bool ScriptEngine::compileScriptString(const std::string& scriptString)
+{
+   // The compiled function stays in the string script cache, so only the copy pushed here is popped
+   const bool compiled = stringScripts->pushFunction(luaVM, scriptString) == 0;
+   if(!compiled)
+   {
+      DEBUG("Unable to compile script string %s: %s", scriptString.c_str(), lua_tostring(luaVM, -1));
+   }
+
+   lua_pop(luaVM, 1);
+   return compiled;
+}
+
 void ScriptEngine::callFunction(lua_State* thread, const char* funcName)
 {
    // push the function onto the stack and then resume the thread from the
@@ -311,8 +630,74 @@ std::string ScriptEngine::getScriptPath(const std::string& scriptName)
    return scriptName + ".lua";
 }
 
+void ScriptEngine::stepGarbageCollector(long timeAvailable)
+{
+   heapSize = lua_gc(luaVM, LUA_GCCOUNT, 0);
+   if(!collectingGarbage && heapSize >= heapSizeAfterCollection + heapSizeAfterCollection * IDLE_COLLECTION_THRESHOLD / 100)
+   {
+      collectingGarbage = true;
+   }
+
+   if(collectingGarbage && timeAvailable > 0)
+   {
+      PROFILE_EVENT("gc step", NULL);
+      const Uint32 deadline = SDL_GetTicks() + static_cast<Uint32>(timeAvailable);
+      while(SDL_GetTicks() < deadline)
+      {
+         // A step returns 1 when it finishes a cycle
+         if(lua_gc(luaVM, LUA_GCSTEP, IDLE_COLLECTION_STEP_SIZE) == 1)
+         {
+            collectingGarbage = false;
+            heapSize = heapSizeAfterCollection = lua_gc(luaVM, LUA_GCCOUNT, 0);
+            break;
+         }
+      }
+   }
+
+   peakHeapSize = std::max(peakHeapSize, heapSize);
+   allocator.endFrame();
+}
+
+void ScriptEngine::collectAllGarbage()
+{
+   PROFILE_EVENT("gc full", NULL);
+   lua_gc(luaVM, LUA_GCCOLLECT, 0);
+   collectingGarbage = false;
+   heapSize = heapSizeAfterCollection = lua_gc(luaVM, LUA_GCCOUNT, 0);
+   DEBUG("Collected Lua garbage; the heap is down to %dKB.", heapSize);
+}
+
+void ScriptEngine::setGarbageCollectorPause(int pause)
+{
+   lua_gc(luaVM, LUA_GCSETPAUSE, pause);
+}
+
+void ScriptEngine::setGarbageCollectorStepMultiplier(int stepMultiplier)
+{
+   lua_gc(luaVM, LUA_GCSETSTEPMUL, stepMultiplier);
+}
+
+ScriptAllocator& ScriptEngine::getAllocator()
+{
+   return allocator;
+}
+
+int ScriptEngine::getHeapSize() const
+{
+   return heapSize;
+}
+
+int ScriptEngine::getPeakHeapSize() const
+{
+   return peakHeapSize;
+}
+
 ScriptEngine::~ScriptEngine()
 {
+   delete environments;
+   delete stringScripts;
+   delete threadPool;
+
    if(luaVM)
    {
       DEBUG("Destroying Lua state machine...");
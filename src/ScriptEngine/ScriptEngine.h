@@ -11,20 +11,24 @@
 #include <string>
 #include "Singleton.h"
 #include "Task.h"
+#include "ScreenTransition.h"
+#include "ScriptAllocator.h"
 
 // We will need to talk to the tile engine and player data from Lua
 class TileEngine;
 class PlayerData;
 
 class Scheduler;
+class Thread;
 class NPC;
 class Script;
 class NPCScript;
+class StringScriptCache;
+class ScriptEnvironments;
+class ScriptThreadPool;
 
 struct lua_State;
 
-#define SCRIPT_ENG_LUA_NAME ","
-
 /**
  * The ScriptEngine encapsulates the use of the Lua interpreter to run scripts,
  * create Lua coroutines, and bind the game functionality to the Lua scripts
@@ -49,11 +53,72 @@ class ScriptEngine
     */
    Scheduler& scheduler;
 
+   /**
+    * The allocator for all of the Lua VM's memory
+    */
+   ScriptAllocator allocator;
+
    /**
     * The main Lua execution thread and stack
     */
    lua_State* luaVM;
 
+   /**
+    * The pool of Lua threads that the scripts run on
+    */
+   ScriptThreadPool* threadPool;
+
+   /**
+    * The compiled string scripts
+    */
+   StringScriptCache* stringScripts;
+
+   /**
+    * The environments that the scripts of each map run in
+    */
+   ScriptEnvironments* environments;
+
+   /**
+    * The number of the environment of the current map, which its map script and NPCs run in
+    */
+   int mapEnvironment;
+
+   /**
+    * The percentage that the Lua heap has to grow by since the last finished collection
+    * before the collector starts a new cycle in the idle time at the end of a frame
+    */
+   static const int IDLE_COLLECTION_THRESHOLD;
+
+   /**
+    * The step size (in kilobytes) of each garbage collection step taken in idle time
+    */
+   static const int IDLE_COLLECTION_STEP_SIZE;
+
+   /**
+    * The pause that the garbage collector is set to unless it is set otherwise
+    */
+   static const int DEFAULT_GC_PAUSE;
+
+   /**
+    * True iff a garbage collection cycle was started in idle time and hasn't finished yet
+    */
+   bool collectingGarbage;
+
+   /**
+    * The size of the Lua heap (in kilobytes) when the last garbage collection cycle finished
+    */
+   int heapSizeAfterCollection;
+
+   /**
+    * The size of the Lua heap (in kilobytes) at the end of the last frame
+    */
+   int heapSize;
+
+   /**
+    * The largest size of the Lua heap (in kilobytes) at the end of a frame
+    */
+   int peakHeapSize;
+
    /**
     * Register some functions in Lua's global space using Lua bindings
     */
@@ -71,6 +136,16 @@ class ScriptEngine
     */
    int runScript(Script* script);
 
+   /**
+    * Starts a black screen transition from a Lua call, which takes the length of the transition
+    * (in milliseconds) and optionally whether the calling script should wait for it to finish.
+    *
+    * @param luaStack The Lua stack holding the call's arguments.
+    * @param style The way the screen is covered.
+    * @param covering true iff the screen should be covered, or false to uncover it.
+    */
+   int startTransition(lua_State* luaStack, ScreenTransition::Style style, bool covering);
+
    public:
       /** 
        * Constructor. Initializes a Lua VM and initializes members as needed.
@@ -91,6 +166,12 @@ class ScriptEngine
        */
       NPCScript* getNPCScript(NPC* npc, const std::string& regionName, const std::string& mapName, const std::string& npcName);
 
+      /**
+       * Drops the environment of the map being left, so that everything its scripts left behind can be collected,
+       * and starts a new environment for the scripts of the map being entered.
+       */
+      void enterMapEnvironment();
+
       /**
        * Run a specified map script.
        *
@@ -113,6 +194,24 @@ class ScriptEngine
        */
       int runScriptString(const std::string& scriptString);
 
+      /**
+       * Start a string of script, without waiting for it to finish.
+       *
+       * @param scriptString The Lua code in the string.
+       *
+       * @return The script's thread, which the scheduler deletes once it finishes.
+       */
+      Thread* startScriptString(const std::string& scriptString);
+
+      /**
+       * Compile a string of script ahead of time, so that running it later doesn't have to.
+       *
+       * @param scriptString The Lua code in the string.
+       *
+       * @return true iff the string compiled.
+       */
+      bool compileScriptString(const std::string& scriptString);
+
       /**
        * Set the tile engine to send commands to.
        *
@@ -134,6 +233,53 @@ class ScriptEngine
        */
       void callFunction(lua_State* thread, const char* funcName);
 
+      /**
+       * Steps the Lua garbage collector for as long as the given time allows,
+       * so that collection happens in the time left over at the end of a frame instead of in the middle of one.
+       * A new collection cycle is only started once the heap has grown enough since the last one.
+       * Also records the size of the Lua heap for the frame.
+       *
+       * @param timeAvailable The time (in milliseconds) that can be spent collecting garbage.
+       */
+      void stepGarbageCollector(long timeAvailable);
+
+      /**
+       * Runs a full garbage collection cycle, such as while a new map is loaded,
+       * when a pause won't be noticed.
+       */
+      void collectAllGarbage();
+
+      /**
+       * Sets how long the garbage collector waits before it starts a new cycle on its own
+       * (as lua_gc's LUA_GCSETPAUSE does).
+       *
+       * @param pause The size that the heap has to grow to (as a percentage of its size after the last collection).
+       */
+      void setGarbageCollectorPause(int pause);
+
+      /**
+       * Sets how much the garbage collector collects for each step it takes on its own
+       * (as lua_gc's LUA_GCSETSTEPMUL does).
+       *
+       * @param stepMultiplier The speed of the collector relative to memory allocation (as a percentage).
+       */
+      void setGarbageCollectorStepMultiplier(int stepMultiplier);
+
+      /**
+       * @return The allocator for the Lua VM's memory, which counts the memory that scripts use and can cap it.
+       */
+      ScriptAllocator& getAllocator();
+
+      /**
+       * @return The size of the Lua heap (in kilobytes) at the end of the last frame.
+       */
+      int getHeapSize() const;
+
+      /**
+       * @return The largest size of the Lua heap (in kilobytes) at the end of a frame.
+       */
+      int getPeakHeapSize() const;
+
       /** 
        * Destructor. Cleans up used memory and closes the Lua VM,
        * disposing of any memory used by the Lua scripts.
@@ -145,12 +291,22 @@ class ScriptEngine
       /////////////////////////////////////////////////////////
       int narrate(lua_State* luaStack);
       int say(lua_State* luaStack);
+      int conversation(lua_State* luaStack);
+      int localize(lua_State* luaStack);
+      int setLanguage(lua_State* luaStack);
       int playSound(lua_State* luaStack);
       int playMusic(lua_State* luaStack);
       int fadeMusic(lua_State* luaStack);
       int stopMusic(lua_State* luaStack);
+      int prefetch(lua_State* luaStack);
       int delay(lua_State* luaStack);
       int generateRandom(lua_State* luaStack);
+      int seedRandom(lua_State* luaStack);
+      int fadeOut(lua_State* luaStack);
+      int fadeIn(lua_State* luaStack);
+      int wipeOut(lua_State* luaStack);
+      int wipeIn(lua_State* luaStack);
+      int playTimeline(lua_State* luaStack);
 
       ///////////////// Tile engine functions /////////////////
       int setRegion(lua_State* luaStack);
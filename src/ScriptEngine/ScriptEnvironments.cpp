@@ -0,0 +1,75 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ScriptEnvironments.h"
+
+// Include the Lua libraries. Since they are written in clean C, the functions
+// need to be included in this fashion to work with the C++ code.
+extern "C"
+{
+   #include <lua.h>
+   #include <lualib.h>
+   #include <lauxlib.h>
+}
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SCRIPT_ENG;
+
+ScriptEnvironments::ScriptEnvironments(lua_State* luaVM) : luaVM(luaVM), nextEnvironment(NO_ENVIRONMENT + 1)
+{
+   lua_newtable(luaVM);
+   environmentsRef = luaL_ref(luaVM, LUA_REGISTRYINDEX);
+
+   // Reads fall through to the globals, and the __metatable field keeps scripts from getting at (or swapping out) the shared metatable
+   lua_createtable(luaVM, 0, 2);
+   lua_pushvalue(luaVM, LUA_GLOBALSINDEX);
+   lua_setfield(luaVM, -2, "__index");
+   lua_pushboolean(luaVM, false);
+   lua_setfield(luaVM, -2, "__metatable");
+   metatableRef = luaL_ref(luaVM, LUA_REGISTRYINDEX);
+}
+
+int ScriptEnvironments::create()
+{
+   const int environment = nextEnvironment++;
+
+   lua_rawgeti(luaVM, LUA_REGISTRYINDEX, environmentsRef);
+   lua_newtable(luaVM);
+   lua_rawgeti(luaVM, LUA_REGISTRYINDEX, metatableRef);
+   lua_setmetatable(luaVM, -2);
+   lua_rawseti(luaVM, -2, environment);
+   lua_pop(luaVM, 1);
+
+   DEBUG("Created script environment %d", environment);
+   return environment;
+}
+
+void ScriptEnvironments::drop(int environment)
+{
+   lua_rawgeti(luaVM, LUA_REGISTRYINDEX, environmentsRef);
+   lua_pushnil(luaVM);
+   lua_rawseti(luaVM, -2, environment);
+   lua_pop(luaVM, 1);
+
+   DEBUG("Dropped script environment %d", environment);
+}
+
+bool ScriptEnvironments::push(lua_State* thread, int environment) const
+{
+   if(environment == NO_ENVIRONMENT) return false;
+
+   lua_rawgeti(thread, LUA_REGISTRYINDEX, environmentsRef);
+   lua_rawgeti(thread, -1, environment);
+   lua_remove(thread, -2);
+
+   if(!lua_istable(thread, -1))
+   {
+      lua_pop(thread, 1);
+      return false;
+   }
+
+   return true;
+}
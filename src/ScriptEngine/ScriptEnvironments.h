@@ -0,0 +1,83 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SCRIPT_ENVIRONMENTS_H
+#define SCRIPT_ENVIRONMENTS_H
+
+struct lua_State;
+
+/**
+ * Keeps the tables of globals that the scripts of each map (the map's script and its NPCs' scripts) run in,
+ * so that the functions and tables that a map's scripts leave behind don't pile up in the VM's globals.
+ *
+ * Every environment shares one metatable, which reads through to the VM's globals (so the standard library,
+ * the game's functions and the chapter's globals can all be seen) and can't be read or replaced by the scripts.
+ * Globals that a map's scripts set land in the map's environment instead.
+ *
+ * The environments are kept in a table in the Lua registry, keyed by the number that create() hands out.
+ * Dropping an environment only clears its entry, so the collector takes the environment, along with everything
+ * that was stored in it (including the references that NPC scripts keep in it), once no function runs in it anymore.
+ *
+ * The environments belong to the Lua VM that they were created for, and must be destroyed before the VM is closed.
+ */
+class ScriptEnvironments
+{
+   /** The main Lua VM that the environments are created in. */
+   lua_State* luaVM;
+
+   /** The registry reference of the table of environments, keyed by their numbers. */
+   int environmentsRef;
+
+   /** The registry reference of the metatable shared by every environment. */
+   int metatableRef;
+
+   /** The number of the next environment to be created. */
+   int nextEnvironment;
+
+   /** Script environments can't be copied. */
+   ScriptEnvironments(const ScriptEnvironments&);
+
+   /** Script environments can't be copied. */
+   ScriptEnvironments& operator=(const ScriptEnvironments&);
+
+   public:
+      /** The number of no environment, which leaves scripts running in the VM's globals. */
+      static const int NO_ENVIRONMENT = 0;
+
+      /**
+       * Constructor.
+       *
+       * @param luaVM The main Lua VM to create the environments in.
+       */
+      ScriptEnvironments(lua_State* luaVM);
+
+      /**
+       * Creates an empty environment.
+       *
+       * @return The number of the new environment.
+       */
+      int create();
+
+      /**
+       * Drops an environment, so that it can be collected once nothing runs in it anymore.
+       * Its number is no longer valid after this.
+       *
+       * @param environment The number of the environment.
+       */
+      void drop(int environment);
+
+      /**
+       * Pushes an environment onto a thread's stack.
+       *
+       * @param thread The thread to push the environment onto.
+       * @param environment The number of the environment.
+       *
+       * @return true iff the environment was pushed, or false (with nothing pushed) if it has been dropped or is NO_ENVIRONMENT.
+       */
+      bool push(lua_State* thread, int environment) const;
+};
+
+#endif
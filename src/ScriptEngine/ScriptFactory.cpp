@@ -17,31 +17,24 @@ std::string ScriptFactory::getPath(const std::string& name, ScriptType type)
    return PATHS[type] + name + EXTENSION;
 }
 
-Script* ScriptFactory::createScript(lua_State* luaVM, const std::string& name, ScriptType type, NPC* npc)
+Script* ScriptFactory::createScript(ScriptThreadPool& threadPool, const std::string& name, ScriptType type)
 {
-   std::string path = getPath(name, type);
-
-   if(type == NPC_SCRIPT && npc != NULL)
-   {
-      return new NPCScript(luaVM, path, npc);
-   }
-
-   return new FileScript(luaVM, path);
+   return new FileScript(threadPool, getPath(name, type));
 }
 
-NPCScript* ScriptFactory::getNPCScript(lua_State* luaVM, NPC* npc, const std::string& regionName, const std::string& mapName, const std::string& npcName)
+NPCScript* ScriptFactory::getNPCScript(ScriptThreadPool& threadPool, Scheduler& scheduler, const ScriptEnvironments& environments, int environment, NPC* npc, const std::string& regionName, const std::string& mapName, const std::string& npcName)
 {
    std::string scriptName = regionName + '/' + mapName + '/' + npcName;
-   return static_cast<NPCScript*>(createScript(luaVM, scriptName, NPC_SCRIPT, npc));
+   return new NPCScript(threadPool, scheduler, environments, environment, getPath(scriptName, NPC_SCRIPT), npc);
 }
 
-Script* ScriptFactory::getMapScript(lua_State* luaVM, const std::string& regionName, const std::string& mapName)
+Script* ScriptFactory::getMapScript(ScriptThreadPool& threadPool, const std::string& regionName, const std::string& mapName)
 {
    std::string scriptName = regionName + '/' + mapName;
-   return createScript(luaVM, scriptName, MAP_SCRIPT);
+   return createScript(threadPool, scriptName, MAP_SCRIPT);
 }
 
-Script* ScriptFactory::getChapterScript(lua_State* luaVM, const std::string& name)
+Script* ScriptFactory::getChapterScript(ScriptThreadPool& threadPool, const std::string& name)
 {
-    return createScript(luaVM, name, CHAPTER_SCRIPT);
+    return createScript(threadPool, name, CHAPTER_SCRIPT);
 }
@@ -10,9 +10,11 @@
 #include <string>
 
 class NPC;
+class Scheduler;
 class Script;
 class NPCScript;
-struct lua_State;
+class ScriptEnvironments;
+class ScriptThreadPool;
 
 /**
  * The ScriptFactory is a factory class that loads FileScripts and NPCScripts
@@ -55,12 +57,11 @@ class ScriptFactory
    /**
     * Load a script specified by the given name.
     *
-    * @param luaVM The Lua VM used to create the script.
+    * @param threadPool The pool to take the script's thread from.
     * @param name The name of the script to be loaded.
     * @param type The ScriptType of the script to be loaded.
-    * @param npc If the script is an NPC script, an NPC to bind it to
     */
-   static Script* createScript(lua_State* luaVM, const std::string& name, ScriptType type, NPC* npc = NULL);
+   static Script* createScript(ScriptThreadPool& threadPool, const std::string& name, ScriptType type);
 
    /**
     * Get the path to a certain resource based on its name and type.
@@ -74,31 +75,35 @@ class ScriptFactory
 
    public:
       /**
-       * @param luaVM The Lua VM to be used to load the script
+       * @param threadPool The pool to take the script's thread from
+       * @param scheduler The scheduler that runs the script
+       * @param environments The environments of the script's VM
+       * @param environment The number of the environment of the NPC's map
+       * @param npc The NPC to bind the script to
        * @param regionName The name of the region containing the map
        * @param mapName The name of the map containing the NPC
        * @param npcName The name of an NPC
        *
        * @return The NPC script associated with the NPC requested
        */
-      static NPCScript* getNPCScript(lua_State* luaVM, NPC* npc, const std::string& regionName, const std::string& mapName, const std::string& npcName);
+      static NPCScript* getNPCScript(ScriptThreadPool& threadPool, Scheduler& scheduler, const ScriptEnvironments& environments, int environment, NPC* npc, const std::string& regionName, const std::string& mapName, const std::string& npcName);
 
       /**
-       * @param luaVM The Lua VM to be used to load the script
+       * @param threadPool The pool to take the script's thread from
        * @param regionName The name of the region containing the map
        * @param mapName The name of the map associated with the script
        *
        * @return The map script given by the specified region-map pairing
        */
-      static Script* getMapScript(lua_State* luaVM, const std::string& regionName, const std::string& mapName);
+      static Script* getMapScript(ScriptThreadPool& threadPool, const std::string& regionName, const std::string& mapName);
 
       /**
-       * @param luaVM The Lua VM to be used to load the script
+       * @param threadPool The pool to take the script's thread from
        * @param name The name of the chapter to load the intro script for
        *
        * @return The chapter script given by the specified chapter name
        */
-      static Script* getChapterScript(lua_State* luaVM, const std::string& name);
+      static Script* getChapterScript(ScriptThreadPool& threadPool, const std::string& name);
 };
 
 #endif
@@ -19,15 +19,16 @@ extern "C"
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_SCRIPT_ENG;
 
+// Each function is registered as a closure that holds this engine instance as its upvalue
+// (thus eliminating the need for a global ScriptEngine instance or singleton, or a global lookup on each call)
 #define REGISTER(luaName, function) DEBUG("Registering function: %s", luaName); \
-                                    lua_register(luaVM, luaName, function)
+                                    lua_pushlightuserdata(luaVM, this); \
+                                    lua_pushcclosure(luaVM, function, 1); \
+                                    lua_setglobal(luaVM, luaName)
 
 static ScriptEngine* getEngine(lua_State* luaVM)
 {
-   lua_getglobal(luaVM, SCRIPT_ENG_LUA_NAME);
-   ScriptEngine* engine = static_cast<ScriptEngine*>(lua_touserdata(luaVM, lua_gettop(luaVM)));
-   lua_pop(luaVM, 1);
-   return engine;
+   return static_cast<ScriptEngine*>(lua_touserdata(luaVM, lua_upvalueindex(1)));
 }
 
 static int luaNarrate(lua_State* luaVM)
@@ -40,6 +41,21 @@ static int luaSay(lua_State* luaVM)
    return getEngine(luaVM)->say(luaVM);
 }
 
+static int luaConversation(lua_State* luaVM)
+{
+   return getEngine(luaVM)->conversation(luaVM);
+}
+
+static int luaLocalize(lua_State* luaVM)
+{
+   return getEngine(luaVM)->localize(luaVM);
+}
+
+static int luaSetLanguage(lua_State* luaVM)
+{
+   return getEngine(luaVM)->setLanguage(luaVM);
+}
+
 static int luaSetRegion(lua_State* luaVM)
 {
    return getEngine(luaVM)->setRegion(luaVM);
@@ -60,6 +76,11 @@ static int luaStopMusic(lua_State* luaVM)
    return getEngine(luaVM)->stopMusic(luaVM);
 }
 
+static int luaPrefetch(lua_State* luaVM)
+{
+   return getEngine(luaVM)->prefetch(luaVM);
+}
+
 static int luaDelay(lua_State* luaVM)
 {
    return getEngine(luaVM)->delay(luaVM);
@@ -70,15 +91,55 @@ static int luaRandom(lua_State* luaVM)
    return getEngine(luaVM)->generateRandom(luaVM);
 }
 
+static int luaSeedRandom(lua_State* luaVM)
+{
+   return getEngine(luaVM)->seedRandom(luaVM);
+}
+
+static int luaFadeOut(lua_State* luaVM)
+{
+   return getEngine(luaVM)->fadeOut(luaVM);
+}
+
+static int luaFadeIn(lua_State* luaVM)
+{
+   return getEngine(luaVM)->fadeIn(luaVM);
+}
+
+static int luaWipeOut(lua_State* luaVM)
+{
+   return getEngine(luaVM)->wipeOut(luaVM);
+}
+
+static int luaWipeIn(lua_State* luaVM)
+{
+   return getEngine(luaVM)->wipeIn(luaVM);
+}
+
+static int luaPlayTimeline(lua_State* luaVM)
+{
+   return getEngine(luaVM)->playTimeline(luaVM);
+}
+
 void ScriptEngine::registerFunctions()
 {
    REGISTER("narrate", luaNarrate);
    REGISTER("say", luaSay);
+   REGISTER("conversation", luaConversation);
+   REGISTER("localize", luaLocalize);
+   REGISTER("setLanguage", luaSetLanguage);
    REGISTER("playSound", luaPlaySound);
    REGISTER("playMusic", luaPlayMusic);
    REGISTER("stopMusic", luaStopMusic);
+   REGISTER("prefetch", luaPrefetch);
    REGISTER("delay", luaDelay);
    REGISTER("random", luaRandom);
+   REGISTER("seedRandom", luaSeedRandom);
+   REGISTER("fadeOut", luaFadeOut);
+   REGISTER("fadeIn", luaFadeIn);
+   REGISTER("wipeOut", luaWipeOut);
+   REGISTER("wipeIn", luaWipeIn);
+   REGISTER("playTimeline", luaPlayTimeline);
 
    // Tile Engine functions
    REGISTER("setRegion", luaSetRegion);
@@ -0,0 +1,198 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ScriptSampler.h"
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+extern "C"
+{
+   #include <lua.h>
+}
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SCRIPT_ENG;
+
+// The number of lines listed by describe, which fits in the debug console alongside the totals
+static const int DESCRIBED_LINE_COUNT = 10;
+
+int ScriptSampler::interval = 0;
+std::vector<ScriptSampler::Sample> ScriptSampler::samples;
+int ScriptSampler::nextSample = 0;
+unsigned long ScriptSampler::sampleCount = 0;
+std::deque<std::string> ScriptSampler::names;
+std::map<const char*, int, ScriptSampler::NameLess> ScriptSampler::nameIds;
+
+void ScriptSampler::setEnabled(bool enable, int instructionInterval)
+{
+   if(enable)
+   {
+      // The ring is only allocated while the sampler is on, so builds that never sample don't hold it
+      interval = std::max(1, instructionInterval);
+      samples.resize(SAMPLE_CAPACITY);
+      nextSample = 0;
+      sampleCount = 0;
+      DEBUG("Sampling scripts every %d instructions.", interval);
+   }
+   else
+   {
+      interval = 0;
+   }
+}
+
+bool ScriptSampler::isEnabled()
+{
+   return interval > 0;
+}
+
+int ScriptSampler::getInterval()
+{
+   return interval;
+}
+
+int ScriptSampler::getNameId(const char* name)
+{
+   std::map<const char*, int, NameLess>::const_iterator knownName = nameIds.find(name);
+   if(knownName != nameIds.end())
+   {
+      return knownName->second;
+   }
+
+   const int nameId = static_cast<int>(names.size());
+   names.push_back(name);
+   nameIds[names.back().c_str()] = nameId;
+   return nameId;
+}
+
+void ScriptSampler::sample(lua_State* luaStack, int scriptNameId)
+{
+   if(interval <= 0) return;
+
+   // The stack is walked from the running function outwards, so its frames are filled in from the back
+   Frame stack[MAX_DEPTH];
+   int depth = 0;
+   lua_Debug debugInfo;
+   for(int level = 0; depth < MAX_DEPTH - 1 && lua_getstack(luaStack, level, &debugInfo); ++level)
+   {
+      lua_getinfo(luaStack, "Sl", &debugInfo);
+      Frame& frame = stack[MAX_DEPTH - 1 - depth];
+      frame.sourceId = getNameId(debugInfo.short_src);
+      frame.line = debugInfo.currentline;
+      ++depth;
+   }
+
+   Sample& sample = samples[nextSample];
+   sample.depth = depth + 1;
+   sample.frames[0].sourceId = scriptNameId;
+   sample.frames[0].line = -1;
+   std::copy(stack + MAX_DEPTH - depth, stack + MAX_DEPTH, sample.frames + 1);
+
+   nextSample = (nextSample + 1) % SAMPLE_CAPACITY;
+   ++sampleCount;
+}
+
+std::string ScriptSampler::describeFrame(const Frame& frame)
+{
+   std::stringstream text;
+   text << names[frame.sourceId];
+   if(frame.line >= 0)
+   {
+      text << ':' << frame.line;
+   }
+
+   return text.str();
+}
+
+void ScriptSampler::collapseStacks(std::map<std::string, int>& stacks)
+{
+   const int recordedSamples = static_cast<int>(std::min(sampleCount, static_cast<unsigned long>(SAMPLE_CAPACITY)));
+   for(int i = 0; i < recordedSamples; ++i)
+   {
+      const Sample& sample = samples[i];
+
+      std::string stack;
+      for(int frame = 0; frame < sample.depth; ++frame)
+      {
+         // Collapsed stacks separate their frames with semicolons, and their count with a space
+         std::string frameText = describeFrame(sample.frames[frame]);
+         std::replace(frameText.begin(), frameText.end(), ';', ',');
+         std::replace(frameText.begin(), frameText.end(), ' ', '_');
+
+         if(frame > 0) stack += ';';
+         stack += frameText;
+      }
+
+      ++stacks[stack];
+   }
+}
+
+void ScriptSampler::describe(std::vector<std::string>& lines)
+{
+   const int recordedSamples = static_cast<int>(std::min(sampleCount, static_cast<unsigned long>(SAMPLE_CAPACITY)));
+   if(recordedSamples == 0)
+   {
+      lines.push_back("No scripts have been sampled.");
+      return;
+   }
+
+   // Each sample counts towards the line that was running when it was taken
+   std::map<std::string, int> lineSamples;
+   for(int i = 0; i < recordedSamples; ++i)
+   {
+      const Sample& sample = samples[i];
+      ++lineSamples[describeFrame(sample.frames[sample.depth - 1])];
+   }
+
+   std::vector<std::pair<int, std::string> > linesBySamples;
+   for(std::map<std::string, int>::const_iterator iter = lineSamples.begin(); iter != lineSamples.end(); ++iter)
+   {
+      linesBySamples.push_back(std::make_pair(iter->second, iter->first));
+   }
+
+   std::sort(linesBySamples.begin(), linesBySamples.end(), std::greater<std::pair<int, std::string> >());
+
+   std::stringstream totals;
+   totals << sampleCount << " samples every " << interval << " instructions";
+   if(sampleCount > static_cast<unsigned long>(recordedSamples))
+   {
+      totals << " (the last " << recordedSamples << " are kept)";
+   }
+
+   lines.push_back(totals.str());
+
+   const int describedLines = std::min(static_cast<int>(linesBySamples.size()), DESCRIBED_LINE_COUNT);
+   for(int i = 0; i < describedLines; ++i)
+   {
+      std::stringstream line;
+      line << std::fixed << std::setprecision(1);
+      line << linesBySamples[i].second << ": " << linesBySamples[i].first << " samples ("
+           << linesBySamples[i].first * 100.0 / recordedSamples << "%)";
+      lines.push_back(line.str());
+   }
+}
+
+bool ScriptSampler::writeCollapsedStacks(const std::string& path)
+{
+   std::ofstream output(path.c_str(), std::ios::out | std::ios::trunc);
+   if(!output)
+   {
+      DEBUG("Unable to write script samples to %s.", path.c_str());
+      return false;
+   }
+
+   std::map<std::string, int> stacks;
+   collapseStacks(stacks);
+   for(std::map<std::string, int>::const_iterator iter = stacks.begin(); iter != stacks.end(); ++iter)
+   {
+      output << iter->first << ' ' << iter->second << '\n';
+   }
+
+   DEBUG("Wrote %d script stacks to %s.", static_cast<int>(stacks.size()), path.c_str());
+   return true;
+}
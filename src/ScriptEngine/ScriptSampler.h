@@ -0,0 +1,154 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SCRIPT_SAMPLER_H
+#define SCRIPT_SAMPLER_H
+
+#include <cstring>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+struct lua_State;
+
+/**
+ * Finds the Lua functions that the scripts spend their time in, by sampling the scripts' call stacks as they run.
+ *
+ * While the sampler is enabled, the count hook that preempts running scripts (see Script) also fires every
+ * so many Lua instructions (the interval), and each time it fires, the sampler records the call stack of the running script
+ * as the source and current line of each of its functions, under the name of the script. The samples are kept in a ring
+ * of SAMPLE_CAPACITY samples, so that the sampler holds the same memory however long it runs, and the oldest samples
+ * make way for the newest ones. Stacks deeper than MAX_DEPTH functions keep their innermost functions.
+ *
+ * The samples can be summed up by line (such as in the debug console), or written out as collapsed stacks
+ * (one line per distinct stack, with the number of samples taken in it), which flame graph tools
+ * (such as flamegraph.pl or speedscope) draw as they are.
+ *
+ * Sampling only costs anything when the hook fires, so a large enough interval (such as the default) can be left
+ * running in test builds. A disabled sampler costs nothing but a check of whether or not it is enabled as each script is resumed.
+ */
+class ScriptSampler
+{
+   /** The number of samples that are kept. */
+   static const int SAMPLE_CAPACITY = 4096;
+
+   /** The most functions (counting the script itself) that are kept in a sample. */
+   static const int MAX_DEPTH = 24;
+
+   /** A function on a sampled stack. */
+   struct Frame
+   {
+      /** The ID of the function's source (or of the script's name, for the outermost frame). */
+      int sourceId;
+
+      /** The line that the function was running, or -1 if it isn't known (such as in a C function). */
+      int line;
+   };
+
+   /** A sampled stack. */
+   struct Sample
+   {
+      /** The number of frames in the sample. */
+      int depth;
+
+      /** The frames of the stack, from the script out to the function that was running. */
+      Frame frames[MAX_DEPTH];
+   };
+
+   /** Orders names by their characters instead of by their pointers. */
+   struct NameLess
+   {
+      bool operator()(const char* first, const char* second) const { return strcmp(first, second) < 0; }
+   };
+
+   /** The number of instructions between samples, or 0 if the sampler is disabled. */
+   static int interval;
+
+   /** The ring of samples. */
+   static std::vector<Sample> samples;
+
+   /** The index in the ring that the next sample is recorded at. */
+   static int nextSample;
+
+   /** The number of samples recorded since the sampler was enabled. */
+   static unsigned long sampleCount;
+
+   /** The names of the sources and scripts, by ID (in a deque, so that their characters stay put as names are added). */
+   static std::deque<std::string> names;
+
+   /** The IDs of the sources and scripts, by name. */
+   static std::map<const char*, int, NameLess> nameIds;
+
+   /**
+    * @param frame A function on a sampled stack.
+    *
+    * @return The function's source and line, as shown in a collapsed stack.
+    */
+   static std::string describeFrame(const Frame& frame);
+
+   /**
+    * Sums up the samples by stack.
+    *
+    * @param stacks The parameter used to return the number of samples taken in each stack, as collapsed stacks.
+    */
+   static void collapseStacks(std::map<std::string, int>& stacks);
+
+   public:
+      /** The interval used when none is given, which samples a busy script about a thousand times a second. */
+      static const int DEFAULT_INTERVAL = 1000;
+
+      /**
+       * Starts or stops sampling. Enabling the sampler clears the samples taken before.
+       *
+       * @param enable true to start sampling, false to stop.
+       * @param instructionInterval The number of Lua instructions between samples.
+       */
+      static void setEnabled(bool enable, int instructionInterval = DEFAULT_INTERVAL);
+
+      /**
+       * @return true iff the scripts are being sampled.
+       */
+      static bool isEnabled();
+
+      /**
+       * @return The number of Lua instructions between samples.
+       */
+      static int getInterval();
+
+      /**
+       * @param name The name of a source or a script.
+       *
+       * @return The ID of the name.
+       */
+      static int getNameId(const char* name);
+
+      /**
+       * Records the call stack of a running script.
+       *
+       * @param luaStack The Lua thread of the script.
+       * @param scriptNameId The ID of the script's name.
+       */
+      static void sample(lua_State* luaStack, int scriptNameId);
+
+      /**
+       * Describes the lines that the most samples were taken in.
+       *
+       * @param lines The list to add the lines of the description to.
+       */
+      static void describe(std::vector<std::string>& lines);
+
+      /**
+       * Writes the samples out as collapsed stacks.
+       *
+       * @param path The path of the file to write.
+       *
+       * @return true iff the stacks were written.
+       */
+      static bool writeCollapsedStacks(const std::string& path);
+};
+
+#endif
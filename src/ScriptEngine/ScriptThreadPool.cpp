@@ -0,0 +1,57 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ScriptThreadPool.h"
+
+// Include the Lua libraries. Since they are written in clean C, the functions
+// need to be included in this fashion to work with the C++ code.
+extern "C"
+{
+   #include <lua.h>
+   #include <lualib.h>
+   #include <lauxlib.h>
+}
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SCRIPT_ENG;
+
+// More than the scripts that a busy scene runs at once, so that idle threads are only let go after an unusual burst
+static const size_t MAX_IDLE_THREADS = 64;
+
+ScriptThreadPool::ScriptThreadPool(lua_State* luaVM) : luaVM(luaVM)
+{
+}
+
+lua_State* ScriptThreadPool::acquireThread(int& threadRef)
+{
+   if(!idleThreads.empty())
+   {
+      const std::pair<lua_State*, int> idleThread = idleThreads.back();
+      idleThreads.pop_back();
+      threadRef = idleThread.second;
+      return idleThread.first;
+   }
+
+   // The reference pops the thread off the main stack, and anchors it until it is discarded
+   lua_State* thread = lua_newthread(luaVM);
+   threadRef = luaL_ref(luaVM, LUA_REGISTRYINDEX);
+   DEBUG("Forked Lua thread 0x%x for the script thread pool", thread);
+   return thread;
+}
+
+void ScriptThreadPool::releaseThread(lua_State* thread, int threadRef)
+{
+   // Only a thread that finished cleanly can start running a new function; one that yielded or failed can't be reset
+   if(lua_status(thread) == 0 && idleThreads.size() < MAX_IDLE_THREADS)
+   {
+      lua_settop(thread, 0);
+      idleThreads.push_back(std::make_pair(thread, threadRef));
+   }
+   else
+   {
+      luaL_unref(luaVM, LUA_REGISTRYINDEX, threadRef);
+   }
+}
@@ -0,0 +1,67 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SCRIPT_THREAD_POOL_H
+#define SCRIPT_THREAD_POOL_H
+
+#include <utility>
+#include <vector>
+
+struct lua_State;
+
+/**
+ * Hands out the Lua threads (coroutines) that scripts run on, and takes them back for reuse once the scripts finish,
+ * so that the many short-lived scripts that scenes start don't each fork (and later leave behind for the collector)
+ * a new thread from the main VM.
+ *
+ * Every thread that the pool hands out is anchored by a reference in the Lua registry for as long as it is in use
+ * (or idle in the pool), so the collector can't take it while a script is still running on it.
+ * A thread that a script failed on is dead, and is discarded instead of being reused.
+ *
+ * The pool belongs to the Lua VM that it was created for, and must be destroyed before the VM is closed.
+ */
+class ScriptThreadPool
+{
+   /** The main Lua VM that threads are forked from. */
+   lua_State* luaVM;
+
+   /** The threads that are free to be reused, each with the registry reference that anchors it. */
+   std::vector<std::pair<lua_State*, int> > idleThreads;
+
+   /** Script thread pools can't be copied. */
+   ScriptThreadPool(const ScriptThreadPool&);
+
+   /** Script thread pools can't be copied. */
+   ScriptThreadPool& operator=(const ScriptThreadPool&);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param luaVM The main Lua VM to fork threads from.
+       */
+      ScriptThreadPool(lua_State* luaVM);
+
+      /**
+       * Gets a thread to run a script on, reusing an idle thread if there is one.
+       *
+       * @param threadRef Set to the registry reference that anchors the thread, to hand back along with the thread.
+       *
+       * @return The thread, with an empty stack.
+       */
+      lua_State* acquireThread(int& threadRef);
+
+      /**
+       * Hands back a thread that is done with, which is reused if the script on it finished,
+       * or discarded otherwise (such as if the script failed, or is still in the middle of a run).
+       *
+       * @param thread The thread.
+       * @param threadRef The thread's registry reference.
+       */
+      void releaseThread(lua_State* thread, int threadRef);
+};
+
+#endif
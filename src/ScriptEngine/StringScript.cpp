@@ -5,6 +5,8 @@
  */
 
 #include "StringScript.h"
+#include "StringScriptCache.h"
+#include "ObjectPool.h"
 
 // Include the Lua libraries. Since they are written in clean C, the functions
 // need to be included in this fashion to work with the C++ code.
@@ -15,10 +17,26 @@ extern "C"
    #include <lauxlib.h>
 }
 
-StringScript::StringScript(lua_State* luaVM, const std::string& scriptString) : Script(scriptString)
+StringScript::StringScript(ScriptThreadPool& threadPool, StringScriptCache& cache, const std::string& scriptString) : Script(scriptString, threadPool)
 {
-   luaStack = lua_newthread(luaVM);
-   luaL_loadstring(luaStack, scriptString.c_str());
+   cache.pushFunction(luaStack, scriptString);
+}
+
+ObjectPool& StringScript::getPool()
+{
+   // Never destroyed, so that a script deleted while the game shuts down still has a pool to go back to
+   static ObjectPool* pool = new ObjectPool("string scripts", sizeof(StringScript));
+   return *pool;
+}
+
+void* StringScript::operator new(size_t size)
+{
+   return getPool().allocate(size);
+}
+
+void StringScript::operator delete(void* block, size_t size)
+{
+   getPool().release(block, size);
 }
 
 StringScript::~StringScript()
@@ -9,24 +9,40 @@
 
 #include "Script.h"
 
+class StringScriptCache;
+class ObjectPool;
+
 /**
  * A StringScript is a type of Script that runs Lua code supplied as a string of
  * instructions.
  *
+ * String scripts are compiled through a StringScriptCache, so a string that has been run before
+ * isn't compiled again. They are run for every trigger and menu action, so they are allocated from a pool.
+ *
  * @author Noam Chitayat
  */
 class StringScript : public Script
 {
+   /** @return The pool that string scripts are allocated from. */
+   static ObjectPool& getPool();
+
    public:
       /**
        * Constructor.
-       * Creates a new Lua thread by forking the main VM, and then
-       * loads the specified script string into the new thread's stack.
+       * Takes a Lua thread from the pool, and then
+       * pushes the compiled script string onto the thread's stack.
        *
-       * @param luaVM The main Lua stack to fork a thread from.
+       * @param threadPool The pool to take the script's thread from.
+       * @param cache The cache to get the compiled script from.
        * @param scriptString The Lua code that should be run on this thread.
        */
-      StringScript(lua_State* luaVM, const std::string& scriptString);
+      StringScript(ScriptThreadPool& threadPool, StringScriptCache& cache, const std::string& scriptString);
+
+      /** Allocates the script from the pool of string scripts. */
+      static void* operator new(size_t size);
+
+      /** Hands the script's memory back to the pool of string scripts. */
+      static void operator delete(void* block, size_t size);
 
       /**
        * Destructor.
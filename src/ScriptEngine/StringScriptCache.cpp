@@ -0,0 +1,55 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "StringScriptCache.h"
+
+// Include the Lua libraries. Since they are written in clean C, the functions
+// need to be included in this fashion to work with the C++ code.
+extern "C"
+{
+   #include <lua.h>
+   #include <lualib.h>
+   #include <lauxlib.h>
+}
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SCRIPT_ENG;
+
+StringScriptCache::StringScriptCache(lua_State* luaVM)
+{
+   lua_newtable(luaVM);
+   functionsRef = luaL_ref(luaVM, LUA_REGISTRYINDEX);
+}
+
+int StringScriptCache::pushFunction(lua_State* thread, const std::string& scriptString)
+{
+   lua_rawgeti(thread, LUA_REGISTRYINDEX, functionsRef);
+   lua_pushlstring(thread, scriptString.data(), scriptString.length());
+   lua_rawget(thread, -2);
+
+   if(lua_isfunction(thread, -1))
+   {
+      // Leave only the cached function on the stack
+      lua_remove(thread, -2);
+      return 0;
+   }
+
+   lua_pop(thread, 1);
+
+   // The string is also used as the chunk's name, as luaL_loadstring does
+   DEBUG("Compiling script string: %s", scriptString.c_str());
+   const int result = luaL_loadbuffer(thread, scriptString.data(), scriptString.length(), scriptString.c_str());
+   if(result == 0)
+   {
+      lua_pushlstring(thread, scriptString.data(), scriptString.length());
+      lua_pushvalue(thread, -2);
+      lua_rawset(thread, -4);
+   }
+
+   // Leave only the function (or the error message) on the stack
+   lua_remove(thread, -2);
+   return result;
+}
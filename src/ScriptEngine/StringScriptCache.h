@@ -0,0 +1,53 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef STRING_SCRIPT_CACHE_H
+#define STRING_SCRIPT_CACHE_H
+
+#include <string>
+
+struct lua_State;
+
+/**
+ * Keeps the compiled string scripts (such as the scripts embedded in lines of dialogue,
+ * or commands entered into the debug console), so that running the same string again is cheap.
+ *
+ * Each script string is only compiled the first time that it is run. The compiled function is kept in a table
+ * in the Lua registry, keyed by the string, and is shared by every script that runs the string.
+ *
+ * The cache belongs to the Lua VM that it was created for, and must be destroyed before the VM is closed.
+ */
+class StringScriptCache
+{
+   /** The registry reference of the table of compiled functions, keyed by their script strings. */
+   int functionsRef;
+
+   /** String script caches can't be copied. */
+   StringScriptCache(const StringScriptCache&);
+
+   /** String script caches can't be copied. */
+   StringScriptCache& operator=(const StringScriptCache&);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param luaVM The main Lua VM to run the string scripts in.
+       */
+      StringScriptCache(lua_State* luaVM);
+
+      /**
+       * Pushes the compiled function for a script string onto a thread's stack, compiling it if it hasn't been compiled before.
+       *
+       * @param thread The thread to push the function onto.
+       * @param scriptString The Lua code in the string.
+       *
+       * @return 0 on success, or a Lua error code (with the error message pushed instead of the function) otherwise.
+       */
+      int pushFunction(lua_State* thread, const std::string& scriptString);
+};
+
+#endif
@@ -5,36 +5,81 @@
  */
 
 #include "Animation.h"
+#include <algorithm>
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_SPRITE;
 
-#define MILLISECONDS_PER_FRAME 100
+unsigned long Animation::sharedClock = 0;
 
-Animation::Animation(const std::string& name, const FrameSequence& frameSequence) 
-                                : name(name), frameSequence(frameSequence), curr(frameSequence.begin()), timeToNextAnimation(MILLISECONDS_PER_FRAME)
+/**
+ * Orders a time within an animation before the steps that start after it.
+ *
+ * @param time A time within the animation (in milliseconds).
+ * @param step A step of the animation.
+ *
+ * @return true iff the step starts after the given time.
+ */
+static bool startsAfter(long time, const AnimationFrame& step)
+{
+   return time < step.startTime;
+}
+
+Animation::Animation() : steps(NULL), numSteps(0), curr(0), timeToNextAnimation(0), shared(false), loopTime(0)
 {}
 
+void Animation::advanceSharedClock(long timePassed)
+{
+   sharedClock += timePassed;
+}
+
+void Animation::play(const AnimationFrame* newSteps, int newNumSteps, bool onSharedClock)
+{
+   steps = newNumSteps > 0 ? newSteps : NULL;
+   numSteps = steps != NULL ? newNumSteps : 0;
+   curr = 0;
+   timeToNextAnimation = steps != NULL ? steps[0].duration : 0;
+   shared = steps != NULL && onSharedClock;
+   loopTime = steps != NULL ? steps[numSteps - 1].startTime + steps[numSteps - 1].duration : 0;
+}
+
+void Animation::stop()
+{
+   play(NULL, 0);
+}
+
+bool Animation::isPlaying() const
+{
+   return steps != NULL;
+}
+
+bool Animation::isShared() const
+{
+   return shared;
+}
+
 void Animation::update(long timePassed)
 {
+   if(steps == NULL || shared) return;
+
    timeToNextAnimation -= timePassed;
    while(timeToNextAnimation < 0)
    {
-      if(++curr == frameSequence.end()) curr = frameSequence.begin();
-      timeToNextAnimation += MILLISECONDS_PER_FRAME;
+      if(++curr == numSteps) curr = 0;
+      timeToNextAnimation += steps[curr].duration;
    }
 }
 
 int Animation::getIndex() const
 {
-   return *curr;
-}
+   if(steps == NULL) return -1;
 
-const std::string& Animation::getName() const
-{
-   return name;
-}
+   if(shared)
+   {
+      // Find the last step that starts at or before the current point in the loop
+      const long loopPosition = static_cast<long>(sharedClock % loopTime);
+      return (std::upper_bound(steps, steps + numSteps, loopPosition, startsAfter) - 1)->frameIndex;
+   }
 
-Animation::~Animation()
-{
+   return steps[curr].frameIndex;
 }
@@ -7,40 +7,83 @@
 #ifndef ANIMATION_H
 #define ANIMATION_H
 
-#include "FrameSequence.h"
+#include "AnimationFrame.h"
 
 /**
  * An Animation iterates through different frame indices based on the time that
- * has passed between game loop frames. It iterates through a circularly linked
- * list loaded by the Spritesheet, and updates its position in the list based
+ * has passed between game loop frames. It loops through the steps of an animation
+ * loaded by the Spritesheet, and updates its position in the steps based
  * on game loop steps.
+ *
+ * An animation can instead be played on the shared clock, which every sprite on the map reads from.
+ * Every sprite playing the same animation on the shared clock shows the same frame, which is worked
+ * out from the clock when it is drawn, so such animations need no stepping at all. This suits scenery
+ * (such as torches or water) that would loop in step anyway.
  */
 class Animation
 {
-   /** The name of this animation. */
-   const std::string& name;
+   /** The time (in milliseconds) on the shared clock. */
+   static unsigned long sharedClock;
+
+   /** The steps of the animation being played, or NULL if none is. */
+   const AnimationFrame* steps;
    
-   /** The sequence of frames in this animation. */
-   const FrameSequence& frameSequence;
+   /** The number of steps in the animation. */
+   int numSteps;
    
-   /** The current frame that we are at in the list. */
-   FrameSequence::const_iterator curr;
+   /** The step that we are at in the animation. */
+   int curr;
    
    /** The time left until the Animation needs to move to the next frame. */
    long timeToNextAnimation;
+
+   /** Whether the animation follows the shared clock (rather than its own time). */
+   bool shared;
+
+   /** The time (in milliseconds) that the animation takes to loop once. */
+   long loopTime;
    
 public:
+   /**
+    * Moves the shared clock forward, which moves along every animation played on it.
+    *
+    * @param timePassed The amount of time that has passed.
+    */
+   static void advanceSharedClock(long timePassed);
+
    /**
     * Constructor.
-    * Creates an animation with a given linked list of frame indices.
+    * Creates an animation that isn't playing anything.
+    */
+   Animation();
+   
+   /**
+    * Starts playing an animation from its first step.
     *
-    * @param frameSequence The sequence of frames in a given animation.
+    * @param steps The steps of the animation, which must stay valid while it plays.
+    * @param numSteps The number of steps in the animation.
+    * @param onSharedClock true to play the animation on the shared clock, rather than from its first step.
     */
-   Animation(const std::string& animation, const FrameSequence& frameSequence);
+   void play(const AnimationFrame* steps, int numSteps, bool onSharedClock = false);
+   
+   /**
+    * Stops playing the animation.
+    */
+   void stop();
+   
+   /**
+    * @return true iff an animation is being played.
+    */
+   bool isPlaying() const;
+
+   /**
+    * @return true iff the animation is played on the shared clock.
+    */
+   bool isShared() const;
    
    /**
     * Updates the animation based on the time that has passed since the
-    * last call.
+    * last call. Animations on the shared clock are left alone.
     *
     * @param timePassed The amount of time that has passed.
     */
@@ -51,16 +94,6 @@ public:
     *         is currently on).
     */
    int getIndex() const;
-   
-   /**
-    * @return name The name of the animation.
-    */
-   const std::string& getName() const;
-   
-   /**
-    * Destructor.
-    */
-   ~Animation();
 };
 
 #endif
@@ -0,0 +1,26 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ANIMATION_FRAME_H
+#define ANIMATION_FRAME_H
+
+/**
+ * A single step of an animation sequence: the frame to show, and how long to show it for.
+ * The steps of every animation in a spritesheet are laid out one after another in a single array.
+ */
+struct AnimationFrame
+{
+   /** The index of the frame within the spritesheet. */
+   int frameIndex;
+
+   /** The time (in milliseconds) that the frame is shown before the animation moves on. */
+   long duration;
+
+   /** The time (in milliseconds) from the start of the animation at which the frame is first shown. */
+   long startTime;
+};
+
+#endif
@@ -6,130 +6,147 @@
 
 #include "Sprite.h"
 #include "Spritesheet.h"
-#include "Animation.h"
 #include "ResourceLoader.h"
+#include "SpriteBatch.h"
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_SPRITE;
 
-Sprite::Sprite(Spritesheet* sheet) : sheet(sheet), frameIndex(0), animation(NULL), currDirection(NONE)
+Sprite::Sprite(Spritesheet* sheet) : sheet(sheet), frameIndex(0), currNameHandle(-1), animated(false), currDirection(NONE), tint(SpriteBatch::UNTINTED), sheetRevision(sheet != NULL ? sheet->getRevision() : 0)
 {
+   if(sheet != NULL) sheet->acquire();
 }
 
 void Sprite::clearCurrentFrame()
 {
-   if(animation)
-   {
-      delete animation;
-      animation = NULL;
-   }
+   animation.stop();
 
    // Default to frame 0 for now.
    frameIndex = 0;
 
    currDirection = NONE;
    currName = "";
+   currNameHandle = -1;
+   animated = false;
 }
 
 void Sprite::setSheet(Spritesheet* newSheet)
 {
+   // The new sheet is acquired first, in case it is the same as the old one
+   if(newSheet != NULL) newSheet->acquire();
+   if(sheet != NULL) sheet->release();
    sheet = newSheet;
+   sheetRevision = sheet != NULL ? sheet->getRevision() : 0;
 
    // A new sheet invalidates the current frame information.
    clearCurrentFrame();
 }
 
-std::string Sprite::toDirectionString(MovementDirection direction)
-{
-   switch(direction)
-   {
-      case UP:
-      case UP_LEFT:
-      case UP_RIGHT:
-      {
-         return "_up";
-      }
-      case DOWN:
-      case DOWN_LEFT:
-      case DOWN_RIGHT:
-      {
-         return "_down";
-      }
-      case LEFT:
-      {
-         return "_left";
-      }
-      case RIGHT:
-      {
-         return "_right";
-      }
-      case NONE:
-      default:
-      {
-         return "";
-      }
-   }
-}
-
 void Sprite::setFrame(const std::string& frameName, MovementDirection direction)
 {
-   if(animation == NULL && frameName == currName && direction == currDirection) return;
+   const bool sameName = !animated && frameName == currName;
+   if(sameName && direction == currDirection) return;
 
-   int newFrameIndex;
-   
-   if(direction == NONE || (newFrameIndex = sheet->getFrameIndex(frameName + toDirectionString(direction))) < 0)
-   {
-      newFrameIndex = sheet->getFrameIndex(frameName);
-   }
+   // The name is only looked up when it changes; turning to face another way just picks another of its variants
+   const int nameHandle = sameName ? currNameHandle : sheet->findFrameName(frameName);
+   const int newFrameIndex = sheet->getFrameIndex(nameHandle, direction);
    
    if(newFrameIndex < 0)
    {
       //DEBUG("Failed to find sprite frame.");
    }
 
-   clearCurrentFrame();
-   currName = frameName;
+   animation.stop();
+   if(!sameName) currName = frameName;
+   currNameHandle = nameHandle;
+   animated = false;
    currDirection = direction;
    frameIndex = newFrameIndex;
 }
 
-void Sprite::setAnimation(const std::string& animationName, MovementDirection direction)
+void Sprite::setAnimation(const std::string& animationName, MovementDirection direction, bool sharedClock)
 {
-   if(animation != NULL && animationName == currName && direction == currDirection) return;
+   const bool sameName = animated && animationName == currName;
+   if(sameName && direction == currDirection && sharedClock == animation.isShared()) return;
 
-   Animation* newAnimation;
+   const int nameHandle = sameName ? currNameHandle : sheet->findAnimationName(animationName);
+   const int animationIndex = sheet->getAnimationIndex(nameHandle, direction);
 
-   if(direction == NULL || (newAnimation = sheet->getAnimation(animationName + toDirectionString(direction))) == NULL)
-   {
-      newAnimation = sheet->getAnimation(animationName);
-   }
-
-   if(newAnimation == NULL)
+   int numSteps;
+   const AnimationFrame* steps = sheet->getAnimationSteps(animationIndex, numSteps);
+   if(steps == NULL)
    {
       DEBUG("Failed to find animation.");
    }
 
-   clearCurrentFrame();
-   currName = animationName;
+   if(!sameName) currName = animationName;
+   currNameHandle = nameHandle;
+   animated = true;
    currDirection = direction;
-   animation = newAnimation;
+   frameIndex = 0;
+   animation.play(steps, numSteps, sharedClock);
+}
+
+void Sprite::reloadFrame()
+{
+   const std::string name = currName;
+   const MovementDirection direction = currDirection;
+   const bool wasAnimated = animated;
+   const bool wasShared = animation.isShared();
+
+   clearCurrentFrame();
+   sheetRevision = sheet->getRevision();
+
+   if(wasAnimated)
+   {
+      setAnimation(name, direction, wasShared);
+   }
+   else
+   {
+      setFrame(name, direction);
+   }
 }
 
 void Sprite::step(long timePassed)
 {
-   if(animation != NULL)
+   // The old frames are kept around when the sheet is reloaded, so the sprite can wait until now to catch up
+   if(sheet != NULL && sheet->getRevision() != sheetRevision)
    {
-      animation->update(timePassed);
+      reloadFrame();
    }
+
+   animation.update(timePassed);
+}
+
+void Sprite::setTint(float r, float g, float b)
+{
+   tint = SpriteBatch::getTint(r, g, b);
 }
 
 void Sprite::draw(int x, int y) const
 {
-   int indexToDraw = animation != NULL ? animation->getIndex() : frameIndex;
-   sheet->draw(x, y, indexToDraw);
+   int indexToDraw = animation.isPlaying() ? animation.getIndex() : frameIndex;
+   sheet->draw(x, y, indexToDraw, tint);
+}
+
+bool Sprite::isAnimated() const
+{
+   return animated;
+}
+
+const Spritesheet* Sprite::getSheet() const
+{
+   return sheet;
+}
+
+void Sprite::bake(int x, int y, StaticSpriteBatch& batch) const
+{
+   int indexToDraw = animation.isPlaying() ? animation.getIndex() : frameIndex;
+   sheet->bake(x, y, indexToDraw, batch);
 }
 
 Sprite::~Sprite()
 {
    clearCurrentFrame();
+   if(sheet != NULL) sheet->release();
 }
@@ -9,10 +9,11 @@
 
 #include <string>
 
+#include "Animation.h"
 #include "MovementDirection.h"
 
 class Spritesheet;
-class Animation;
+class StaticSpriteBatch;
 
 /**
  * A sprite is a movable object that can go through different animations or
@@ -24,24 +25,34 @@ class Sprite
    /** The spritesheet containing this sprite's frames. */
    Spritesheet* sheet;
 
-   /** The index of the current static frame within the sheet. -1 if an animation is used instead. */
+   /** The index of the current static frame within the sheet. Unused if an animation is playing instead. */
    int frameIndex;
    
-   /** The animation structure to use to animate this sprite. NULL if a static frame is used instead. */
-   Animation* animation;
+   /** The animation structure to use to animate this sprite. Not playing if a static frame is used instead. */
+   Animation animation;
    
    /** The name of the current frame/animation being used. */
    std::string currName;
+
+   /** The spritesheet's handle for the current frame/animation name, or -1 if the name isn't in the spritesheet. */
+   int currNameHandle;
+
+   /** Whether the current name is an animation (rather than a static frame). */
+   bool animated;
    
    /** The direction that the current frame/animation is facing. */
    MovementDirection currDirection;
-   
+
+   /** The tint that the sprite is drawn with, as packed by SpriteBatch::getTint. */
+   unsigned int tint;
+
+   /** The revision of the spritesheet that the current frame/animation was looked up in. */
+   unsigned int sheetRevision;
+
    /**
-    * @param direction A direction to convert to a string.
-    *
-    * @return The string to append to a frame or animation for a given direction.
+    * Looks the current frame/animation up again by name, after the spritesheet has been reloaded.
     */
-   std::string toDirectionString(MovementDirection direction);
+   void reloadFrame();
 
    public:
 
@@ -77,8 +88,21 @@ class Sprite
        *
        * @param animationName The name of the animation.
        * @param direction The direction that the new sprite should face.
+       * @param sharedClock true to play the animation on the shared clock (see Animation), in step with
+       *                    every other sprite playing it there, rather than from its first frame.
        */
-      void setAnimation(const std::string& animationName, MovementDirection direction);
+      void setAnimation(const std::string& animationName, MovementDirection direction, bool sharedClock = false);
+
+      /**
+       * Set the colour that the sprite's frames are multiplied by when they are drawn,
+       * so that one spritesheet can be drawn in different colours.
+       * A tint of white (1, 1, 1) draws the frames in their own colours.
+       *
+       * @param r The red element of the tint (0 to 1).
+       * @param g The green element of the tint (0 to 1).
+       * @param b The blue element of the tint (0 to 1).
+       */
+      void setTint(float r, float g, float b);
 
       /**
        * A logic step for the sprite. Currently just advances the animation if
@@ -96,6 +120,26 @@ class Sprite
        */
       void draw(int x, int y) const;
 
+      /**
+       * @return true iff the sprite shows an animation, rather than a static frame.
+       */
+      bool isAnimated() const;
+
+      /**
+       * @return The spritesheet containing the sprite's frames.
+       */
+      const Spritesheet* getSheet() const;
+
+      /**
+       * Adds the sprite's current frame to a static batch at the specified location, instead of drawing it on each frame.
+       * The frame is baked untinted.
+       *
+       * @param x The x-location to draw at.
+       * @param y The y-location to draw at.
+       * @param batch The static batch to add the frame to.
+       */
+      void bake(int x, int y, StaticSpriteBatch& batch) const;
+
       /**
        * Destructor.
        */
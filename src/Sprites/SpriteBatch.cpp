@@ -0,0 +1,261 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "SpriteBatch.h"
+#include "StaticSpriteBatch.h"
+#include "GLState.h"
+#include "GPUPassTimer.h"
+#include "RenderTarget.h"
+#include "SDL_opengl.h"
+#include <algorithm>
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SPRITE;
+
+// Byte-sized digits keep the counts for each pass small enough to stay in the cache, with at most four passes per key
+const int SpriteBatch::RADIX_BITS = 8;
+
+// Far more than the height of the screen (along with the sprites hanging off its edges),
+// while still leaving several steps of a 16-bit depth buffer between neighbouring pixel rows
+const float SpriteBatch::DEPTH_RANGE = 4096.0f;
+
+// The same cutoff as a pixel that rounds to either drawn or not
+const float SpriteBatch::ALPHA_CUTOFF = 0.5f;
+
+SpriteBatch::SpriteBatch() : vertexBuffer(VertexBuffer::DYNAMIC), depthVertexBuffer(VertexBuffer::DYNAMIC, true), xOffset(0), yOffset(0)
+{
+}
+
+unsigned int SpriteBatch::getTextureKey(const Quad& quad)
+{
+   return quad.texture;
+}
+
+unsigned int SpriteBatch::getTintKey(const Quad& quad)
+{
+   return quad.tint;
+}
+
+unsigned int SpriteBatch::getTint(float r, float g, float b)
+{
+   const unsigned int red = static_cast<unsigned int>(std::min(std::max(r, 0.0f), 1.0f) * 255.0f + 0.5f);
+   const unsigned int green = static_cast<unsigned int>(std::min(std::max(g, 0.0f), 1.0f) * 255.0f + 0.5f);
+   const unsigned int blue = static_cast<unsigned int>(std::min(std::max(b, 0.0f), 1.0f) * 255.0f + 0.5f);
+   return (red << 24) | (green << 16) | (blue << 8) | 0xFF;
+}
+
+unsigned int SpriteBatch::getDepthKey(const Quad& quad)
+{
+   // Adding zero turns a depth of -0 into 0, so that the two sort together
+   const float depth = quad.depth + 0.0f;
+   unsigned int bits;
+   memcpy(&bits, &depth, sizeof(bits));
+
+   // Flip the sign bit of positive depths and every bit of negative ones, so that the keys order the same way as the depths do
+   return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+void SpriteBatch::radixSort(unsigned int (*getKey)(const Quad&))
+{
+   const int radixSize = 1 << RADIX_BITS;
+   const int quadCount = quads.size();
+   sortBuffer.resize(quadCount, quads.front());
+
+   std::vector<int> digitStarts(radixSize);
+   for(int shift = 0; shift < 32; shift += RADIX_BITS)
+   {
+      digitStarts.assign(radixSize, 0);
+      for(int quadNum = 0; quadNum < quadCount; ++quadNum)
+      {
+         ++digitStarts[(getKey(quads[quadNum]) >> shift) & (radixSize - 1)];
+      }
+
+      // When every quad has the same digit, this pass wouldn't move anything
+      bool allSameDigit = false;
+      int digitStart = 0;
+      for(int digit = 0; digit < radixSize; ++digit)
+      {
+         const int digitCount = digitStarts[digit];
+         allSameDigit = allSameDigit || digitCount == quadCount;
+         digitStarts[digit] = digitStart;
+         digitStart += digitCount;
+      }
+
+      if(allSameDigit) continue;
+
+      for(int quadNum = 0; quadNum < quadCount; ++quadNum)
+      {
+         const int digit = (getKey(quads[quadNum]) >> shift) & (radixSize - 1);
+         sortBuffer[digitStarts[digit]++] = quads[quadNum];
+      }
+
+      quads.swap(sortBuffer);
+   }
+}
+
+void SpriteBatch::setOffset(int xOffset, int yOffset)
+{
+   this->xOffset = xOffset;
+   this->yOffset = yOffset;
+}
+
+void SpriteBatch::addQuad(GLuint texture, float destLeft, float destTop, float destRight, float destBottom,
+      float textureLeft, float textureTop, float textureRight, float textureBottom, unsigned int tint)
+{
+   destLeft += xOffset;
+   destRight += xOffset;
+   destTop += yOffset;
+   destBottom += yOffset;
+
+   quads.push_back(Quad(texture, tint, destBottom, pendingVertices.size() / VertexBuffer::FLOATS_PER_VERTEX));
+
+   // The same corners, in the same order, as the quads that sprites used to draw one at a time
+   const float quad[] =
+   {
+      destLeft, destTop, textureLeft, textureTop,
+      destRight, destTop, textureRight, textureTop,
+      destRight, destBottom, textureRight, textureBottom,
+      destLeft, destBottom, textureLeft, textureBottom
+   };
+
+   pendingVertices.insert(pendingVertices.end(), quad, quad + sizeof(quad) / sizeof(quad[0]));
+}
+
+void SpriteBatch::addStaticBatch(const StaticSpriteBatch& batch)
+{
+   if(!batch.isDrawable()) return;
+
+   const StaticDraw staticDraw = { &batch, xOffset, yOffset };
+   staticDraws.push_back(staticDraw);
+}
+
+void SpriteBatch::drawStaticBatches() const
+{
+   GLState::setTextureMode(GL_REPLACE);
+   for(std::vector<StaticDraw>::const_iterator iter = staticDraws.begin(); iter != staticDraws.end(); ++iter)
+   {
+      // The static quads' depths are in pixels on the map, so they are moved by the offset and scaled just as the quads' depths are
+      glPushMatrix();
+      glTranslatef(static_cast<float>(iter->xOffset), static_cast<float>(iter->yOffset), iter->yOffset / DEPTH_RANGE);
+      glScalef(1.0f, 1.0f, 1.0f / DEPTH_RANGE);
+      iter->batch->draw();
+      glPopMatrix();
+   }
+}
+
+void SpriteBatch::arrangeVertices(bool withDepth)
+{
+   const int floatsPerQuad = 4 * VertexBuffer::FLOATS_PER_VERTEX;
+   sortedVertices.clear();
+   sortedVertices.reserve(withDepth ? quads.size() * 4 * VertexBuffer::FLOATS_PER_DEPTH_VERTEX : pendingVertices.size());
+   for(std::vector<Quad>::const_iterator iter = quads.begin(); iter != quads.end(); ++iter)
+   {
+      std::vector<float>::const_iterator quadVertices = pendingVertices.begin() + iter->firstVertex * VertexBuffer::FLOATS_PER_VERTEX;
+      if(!withDepth)
+      {
+         sortedVertices.insert(sortedVertices.end(), quadVertices, quadVertices + floatsPerQuad);
+         continue;
+      }
+
+      // The projection looks down the z-axis, so quads lower on the screen get higher z-coordinates to come out nearer
+      const float z = std::min(std::max(iter->depth / DEPTH_RANGE, -1.0f), 1.0f);
+      for(int vertex = 0; vertex < 4; ++vertex, quadVertices += VertexBuffer::FLOATS_PER_VERTEX)
+      {
+         const float depthVertex[] = { quadVertices[0], quadVertices[1], z, quadVertices[2], quadVertices[3] };
+         sortedVertices.insert(sortedVertices.end(), depthVertex, depthVertex + VertexBuffer::FLOATS_PER_DEPTH_VERTEX);
+      }
+   }
+}
+
+void SpriteBatch::flush()
+{
+   if(quads.empty() && staticDraws.empty()) return;
+   PROFILE_GPU_PASS("Sprites");
+
+   // Sorting by tint and then by texture groups the quads by texture (and by tint within each texture).
+   // Without a depth buffer, sorting by depth last leaves them in depth order, grouped within each depth instead.
+   // Quads with the same texture and tint (and depth) keep the order they were added in.
+   const bool depthTested = RenderTarget::hasDepthBuffer();
+   VertexBuffer& buffer = depthTested ? depthVertexBuffer : vertexBuffer;
+   if(!quads.empty())
+   {
+      radixSort(SpriteBatch::getTintKey);
+      radixSort(SpriteBatch::getTextureKey);
+      if(!depthTested)
+      {
+         radixSort(SpriteBatch::getDepthKey);
+      }
+
+      arrangeVertices(depthTested);
+      buffer.setVertices(sortedVertices);
+   }
+
+   if(depthTested)
+   {
+      // Quads at the same depth are drawn over each other in the order they are drawn in, as they would be without the depth test
+      glClear(GL_DEPTH_BUFFER_BIT);
+      glEnable(GL_DEPTH_TEST);
+      glDepthFunc(GL_LEQUAL);
+      glEnable(GL_ALPHA_TEST);
+      glAlphaFunc(GL_GREATER, ALPHA_CUTOFF);
+   }
+
+   // The modelview matrix may still hold a drawing offset, but the offset was already added to the quads
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   // The static batches go first, so that the quads at the same depth are drawn over them
+   if(depthTested)
+   {
+      drawStaticBatches();
+   }
+
+   int runStart = 0;
+   bool tinted = false;
+   const int quadCount = quads.size();
+   for(int quadNum = 1; quadNum <= quadCount; ++quadNum)
+   {
+      if(quadNum == quadCount || quads[quadNum].texture != quads[runStart].texture || quads[quadNum].tint != quads[runStart].tint)
+      {
+         const unsigned int tint = quads[runStart].tint;
+         if(tint != UNTINTED)
+         {
+            // Tinted quads multiply their texture by the current colour
+            GLState::setTextureMode(GL_MODULATE);
+            glColor4ub(tint >> 24, (tint >> 16) & 0xFF, (tint >> 8) & 0xFF, tint & 0xFF);
+            tinted = true;
+         }
+         else
+         {
+            GLState::setTextureMode(GL_REPLACE);
+         }
+
+         GLState::bindTexture(quads[runStart].texture);
+         buffer.drawQuads(runStart * 4, (quadNum - runStart) * 4);
+         runStart = quadNum;
+      }
+   }
+
+   if(tinted)
+   {
+      glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+      GLState::setTextureMode(GL_REPLACE);
+   }
+
+   if(depthTested)
+   {
+      glDisable(GL_ALPHA_TEST);
+      glDisable(GL_DEPTH_TEST);
+   }
+
+   glPopMatrix();
+
+   quads.clear();
+   pendingVertices.clear();
+   staticDraws.clear();
+}
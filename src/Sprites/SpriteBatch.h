@@ -0,0 +1,203 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include "VertexBuffer.h"
+#include <vector>
+
+class StaticSpriteBatch;
+typedef unsigned int GLuint;
+
+/**
+ * The SpriteBatch collects the sprite quads drawn over the course of a frame, and draws them all at once.
+ * Sprites lower on the screen, whether they belong to actors or obstacles, are drawn over the ones above them:
+ * each quad's depth is its bottom edge (the foot of its sprite).
+ *
+ * Where whatever is being drawn into has a depth buffer (see RenderTarget::hasDepthBuffer), each quad's depth
+ * is passed to the GPU with its vertices, and the depth test does the ordering. The quads are only sorted by
+ * texture and tint then, so that every quad with the same texture and tint is drawn with one draw call, however the
+ * sprites are spread over the screen. The depth test needs each pixel to be either drawn or not, so pixels that are
+ * less than half opaque are left out (by the alpha test), and the rest are blended over whatever is already beneath them.
+ * Each flush clears the depth buffer first, so the quads of one flush never hide behind those of another.
+ *
+ * Without a depth buffer, the quads are sorted by depth, and within each depth by texture and tint, and drawn in that order.
+ *
+ * The sorts are stable radix sorts, so their cost grows linearly with the number of quads.
+ * The whole frame's quads are uploaded into a single dynamic vertex buffer, and each run of quads that
+ * share a texture and tint is drawn with one draw call.
+ *
+ * A tint is a colour that a quad's texture is multiplied by, so that one spritesheet can be drawn in
+ * several colours (such as recoloured NPCs) without keeping a texture for each colour.
+ *
+ * Since the quads are drawn after the fact, the drawing offset in effect when a quad is added
+ * is applied to the quad right away.
+ *
+ * Quads that never change (such as the frames of a map's obstacles) can be built into a StaticSpriteBatch once instead,
+ * and the static batch added to the sprite batch on each frame, to be drawn with the depth test along with the quads
+ * (and under the drawing offset in effect when it was added). Static batches can only be ordered by the depth test,
+ * so they can only be added while there is a depth buffer.
+ */
+class SpriteBatch
+{
+   /** A quad waiting to be drawn. */
+   struct Quad
+   {
+      /** The texture to draw the quad with. */
+      GLuint texture;
+
+      /** The tint to multiply the texture by, packed as in getTint. */
+      unsigned int tint;
+
+      /** The depth of the quad; quads with lower depths are drawn first. */
+      float depth;
+
+      /** The index of the quad's first vertex among the batch's pending vertices. */
+      int firstVertex;
+
+      Quad(GLuint texture, unsigned int tint, float depth, int firstVertex) : texture(texture), tint(tint), depth(depth), firstVertex(firstVertex) {}
+   };
+
+   /** A static batch waiting to be drawn. */
+   struct StaticDraw
+   {
+      /** The static batch. */
+      const StaticSpriteBatch* batch;
+
+      /** The drawing offset in effect when the batch was added (in pixels). */
+      int xOffset, yOffset;
+   };
+
+   /** The number of bits of the sort keys that each radix sort pass sorts by. */
+   static const int RADIX_BITS;
+
+   /** The span of quad depths (in pixels) that is spread over the depth buffer's range. */
+   static const float DEPTH_RANGE;
+
+   /** The alpha that a pixel has to be over to be drawn, while the depth test orders the quads. */
+   static const float ALPHA_CUTOFF;
+
+   /** The quads added since the last flush, in the order they were added. */
+   std::vector<Quad> quads;
+
+   /** The space that the quads are moved into by each radix sort pass. */
+   std::vector<Quad> sortBuffer;
+
+   /** The vertices of the quads added since the last flush, with VertexBuffer::FLOATS_PER_VERTEX floats per vertex. */
+   std::vector<float> pendingVertices;
+
+   /** The static batches added since the last flush. */
+   std::vector<StaticDraw> staticDraws;
+
+   /** The vertices of the quads in the order that they are drawn. */
+   std::vector<float> sortedVertices;
+
+   /** The buffer that the sorted vertices are uploaded to each frame, when they are drawn in depth order. */
+   VertexBuffer vertexBuffer;
+
+   /** The buffer that the sorted vertices are uploaded to each frame (with their depths), when the depth test orders them. */
+   VertexBuffer depthVertexBuffer;
+
+   /** The x-offset to add to the quads (in pixels). */
+   int xOffset;
+
+   /** The y-offset to add to the quads (in pixels). */
+   int yOffset;
+
+   /**
+    * @return The key that orders quads by their textures.
+    */
+   static unsigned int getTextureKey(const Quad& quad);
+
+   /**
+    * @return The key that orders quads by their tints.
+    */
+   static unsigned int getTintKey(const Quad& quad);
+
+   /**
+    * @return The key that orders quads by their depths.
+    */
+   static unsigned int getDepthKey(const Quad& quad);
+
+   /**
+    * Sorts the quads by a key, keeping the order of quads with the same key.
+    *
+    * @param getKey The function that gives the key of each quad.
+    */
+   void radixSort(unsigned int (*getKey)(const Quad&));
+
+   /**
+    * Copies the vertices of the sorted quads into the order they are drawn in.
+    *
+    * @param withDepth true iff each vertex should have its quad's depth (as a z-coordinate for the depth test).
+    */
+   void arrangeVertices(bool withDepth);
+
+   /**
+    * Draws the static batches added since the last flush, once the depth test is set up.
+    */
+   void drawStaticBatches() const;
+
+   public:
+      /** The tint of quads drawn in their texture's own colours. */
+      static const unsigned int UNTINTED = 0xFFFFFFFF;
+
+      /**
+       * @param r The red element of the tint (0 to 1).
+       * @param g The green element of the tint (0 to 1).
+       * @param b The blue element of the tint (0 to 1).
+       *
+       * @return The tint, packed to be passed to addQuad.
+       */
+      static unsigned int getTint(float r, float g, float b);
+
+      /**
+       * Constructor.
+       */
+      SpriteBatch();
+
+      /**
+       * Sets the offset to add to the quads added from now on.
+       *
+       * @param xOffset The x-offset (in pixels).
+       * @param yOffset The y-offset (in pixels).
+       */
+      void setOffset(int xOffset, int yOffset);
+
+      /**
+       * Adds a textured quad to the batch. The depth of the quad is its bottom edge.
+       *
+       * @param texture The texture to draw the quad with.
+       * @param destLeft The left edge of the quad (in pixels).
+       * @param destTop The top edge of the quad (in pixels).
+       * @param destRight The right edge of the quad (in pixels).
+       * @param destBottom The bottom edge of the quad (in pixels).
+       * @param textureLeft The left texture coordinate.
+       * @param textureTop The top texture coordinate.
+       * @param textureRight The right texture coordinate.
+       * @param textureBottom The bottom texture coordinate.
+       * @param tint The tint to multiply the texture by (UNTINTED to leave it as it is).
+       */
+      void addQuad(GLuint texture, float destLeft, float destTop, float destRight, float destBottom,
+            float textureLeft, float textureTop, float textureRight, float textureBottom, unsigned int tint = UNTINTED);
+
+      /**
+       * Adds a static batch to be drawn at the next flush, under the current drawing offset.
+       * There must be a depth buffer (see RenderTarget::hasDepthBuffer), and the static batch must last until the flush.
+       *
+       * @param batch The static batch, which must have been built.
+       */
+      void addStaticBatch(const StaticSpriteBatch& batch);
+
+      /**
+       * Draws every quad (and static batch) added since the last flush, and empties the batch.
+       * The depth test and alpha test are only turned on while the quads are drawn.
+       */
+      void flush();
+};
+
+#endif
@@ -1,16 +0,0 @@
-/*
- *  This file is covered by the Ruby license. See LICENSE.txt for more details.
- *
- *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
- */
-
-#include "SpriteFrame.h"
-
-SpriteFrame::SpriteFrame()
-{
-}
-
-SpriteFrame::SpriteFrame(int left, int top, int right, int bottom)
-                 : left(left), top(top), right(right), bottom(bottom)
-{
-}
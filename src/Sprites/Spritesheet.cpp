@@ -7,12 +7,12 @@
 #include "Spritesheet.h"
 #include "SDL_opengl.h"
 #include "GraphicsUtil.h"
-#include "SpriteFrame.h"
-#include "Animation.h"
-#include <queue>
-#include <fstream>
-#include <sstream>
-#include "json.h"
+#include "SpriteBatch.h"
+#include "StaticSpriteBatch.h"
+#include "JsonPullParser.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
 
 #include "DebugUtils.h"
 
@@ -28,18 +28,130 @@ const std::string Spritesheet::DATA_EXTENSION = ".eds";
  */
 const std::string Spritesheet::UNTITLED_LINE = "untitled";
 
-Spritesheet::Spritesheet(ResourceKey name) : Resource(name), frameList(NULL), numFrames(0)
+// Ten frames a second, which is the pace that the spritesheets are drawn for
+const long Spritesheet::DEFAULT_FRAME_DURATION = 100;
+
+// Listed in the order of the DirectionVariant values
+const char* const Spritesheet::DIRECTION_SUFFIXES[NUM_DIRECTION_VARIANTS] = { "", "_up", "_down", "_left", "_right" };
+
+/**
+ * Orders name index entries by name, for searching the index.
+ */
+struct NameOrder
+{
+   template<typename Entry> bool operator()(const Entry& lhs, const std::string& rhs) const { return lhs.name < rhs; }
+   template<typename Entry> bool operator()(const std::string& lhs, const Entry& rhs) const { return lhs < rhs.name; }
+};
+
+Spritesheet::Spritesheet(ResourceKey name) : Resource(name), width(0), height(0)
 {
 }
 
+Spritesheet::DirectionVariant Spritesheet::getDirectionVariant(MovementDirection direction)
+{
+   switch(direction)
+   {
+      case UP:
+      case UP_LEFT:
+      case UP_RIGHT:
+      {
+         return FACING_UP;
+      }
+      case DOWN:
+      case DOWN_LEFT:
+      case DOWN_RIGHT:
+      {
+         return FACING_DOWN;
+      }
+      case LEFT:
+      {
+         return FACING_LEFT;
+      }
+      case RIGHT:
+      {
+         return FACING_RIGHT;
+      }
+      case NONE:
+      default:
+      {
+         return UNDIRECTED;
+      }
+   }
+}
+
+void Spritesheet::buildNameIndex(const std::vector<std::string>& names, NameIndex& index)
+{
+   // Every name gets an entry, and so does every name that only exists with a direction suffix on it
+   std::map<std::string, NameEntry> entries;
+   for(int i = 0; i < static_cast<int>(names.size()); ++i)
+   {
+      const std::string& name = names[i];
+      if(name.empty()) continue;
+
+      for(int variant = UNDIRECTED; variant < NUM_DIRECTION_VARIANTS; ++variant)
+      {
+         const size_t suffixLength = strlen(DIRECTION_SUFFIXES[variant]);
+         if(variant != UNDIRECTED && (name.length() <= suffixLength || name.compare(name.length() - suffixLength, suffixLength, DIRECTION_SUFFIXES[variant]) != 0))
+         {
+            continue;
+         }
+
+         const std::string baseName = name.substr(0, name.length() - suffixLength);
+         std::map<std::string, NameEntry>::iterator entryIter = entries.find(baseName);
+         if(entryIter == entries.end())
+         {
+            NameEntry entry;
+            entry.name = baseName;
+            std::fill(entry.variants, entry.variants + NUM_DIRECTION_VARIANTS, -1);
+            entryIter = entries.insert(std::make_pair(baseName, entry)).first;
+         }
+
+         if(variant == UNDIRECTED && entryIter->second.variants[UNDIRECTED] >= 0)
+         {
+            DEBUG("Duplicated name %s in spritesheet.", name.c_str());
+            T_T("Parse error reading spritesheet.");
+         }
+
+         entryIter->second.variants[variant] = i;
+      }
+   }
+
+   index.clear();
+   index.reserve(entries.size());
+   for(std::map<std::string, NameEntry>::iterator entryIter = entries.begin(); entryIter != entries.end(); ++entryIter)
+   {
+      // Directions without their own variant fall back to the undirected one
+      NameEntry& entry = entryIter->second;
+      for(int variant = UNDIRECTED + 1; variant < NUM_DIRECTION_VARIANTS; ++variant)
+      {
+         if(entry.variants[variant] < 0) entry.variants[variant] = entry.variants[UNDIRECTED];
+      }
+
+      // The map is already in name order, so the index comes out sorted
+      index.push_back(entry);
+   }
+}
+
+int Spritesheet::findName(const NameIndex& index, const std::string& name)
+{
+   NameIndex::const_iterator entryIter = std::lower_bound(index.begin(), index.end(), name, NameOrder());
+   if(entryIter != index.end() && entryIter->name == name)
+   {
+      return entryIter - index.begin();
+   }
+
+   return -1;
+}
+
 void Spritesheet::load(const char* path)
 {
-   // Load the image itself into a texture using GraphicsUtil
+   // Reserve the image's space in the texture atlas using GraphicsUtil; the image itself is
+   // decoded in the background, so the sprite is transparent for the frame or two until it arrives
    std::string imgPath(path);
    imgPath += IMG_EXTENSION;
 
    DEBUG("Loading spritesheet image \"%s\"...", imgPath.c_str());
-   GraphicsUtil::getInstance()->loadGLTexture(imgPath.c_str(), texture, width, height);
+   textureRegion = GraphicsUtil::getInstance()->streamAtlasTexture(imgPath.c_str(), width, height);
 
    // Load in the spritesheet data file, which tells the engine where
    // each frame is in the image
@@ -47,255 +159,357 @@ void Spritesheet::load(const char* path)
    dataPath += DATA_EXTENSION;
    DEBUG("Loading spritesheet data \"%s\"...", dataPath.c_str());
 
-   std::ifstream input(dataPath.c_str());
-   if(!input.is_open())
-   {
-      T_T(std::string("Error opening file: ") + dataPath);
-   }
-   
-   // Read in the JSON data in the file
-   Json::Value jsonRoot;
-   input >> jsonRoot;
-   
-   if(jsonRoot.isNull())
+   // The data is read straight into the frames and animations, without building a document out of it first
+   JsonPullParser parser(dataPath);
+   if(parser.peek() != JsonPullParser::OBJECT)
    {
       DEBUG("Unexpected root element name.");
       T_T("Failed to parse spritesheet data.");
    }
-   
-   parseFrames(jsonRoot);
-   parseAnimations(jsonRoot);
+
+   // Animations refer to frames by name, so they are only put together once every frame has been read
+   ParsedAnimations parsedAnimations;
+
+   std::string key;
+   parser.beginObject();
+   while(parser.nextKey(key))
+   {
+      if(key == "frames" && frames.empty())
+      {
+         parseFrames(parser);
+      }
+      else if(key == "animations")
+      {
+         parseAnimations(parser, parsedAnimations);
+      }
+      else
+      {
+         parser.skipValue();
+      }
+   }
+
+   parser.finish();
+
+   // This spritesheet is well-formed only if there are frames in the spritesheet
+   if(frames.empty())
+   {
+      DEBUG("No frames found in spritesheet.");
+      T_T("Empty (invalid) spritesheet constructed.");
+   }
+
+   buildAnimations(parsedAnimations);
 
    DEBUG("Spritesheet constructed!");
 }
 
-void Spritesheet::parseFrames(Json::Value& rootElement)
+void Spritesheet::parseFrames(JsonPullParser& parser)
 {
-   // Get the frames array in the spritesheet data
-   Json::Value& framesElement = rootElement["frames"];
-   numFrames = framesElement.size();
-   
-   // This spritesheet is well-formed only if the "frames" element is a non-empty array
-   // (i.e. there are frames in the spritesheet)
-   if(!framesElement.isArray() || numFrames <= 0)
+   if(parser.peek() != JsonPullParser::ARRAY)
    {
       DEBUG("No frames found in spritesheet.");
       T_T("Empty (invalid) spritesheet constructed.");
    }
 
    DEBUG("Loading frames...");
-   frameList = new SpriteFrame[numFrames];
-   for(int i = 0; i < numFrames; ++i)
+   std::vector<std::string> names;
+   std::string key;
+   std::string frameName;
+
+   parser.beginArray();
+   while(parser.hasNextElement())
    {
-      Json::Value& currFrame = framesElement[i];
-      
-      // Get the current frame name
-      std::string frameName = currFrame["name"].asString();
-      if(frameName == UNTITLED_LINE)
+      int left = 0;
+      int top = 0;
+      int right = 0;
+      int bottom = 0;
+      frameName.clear();
+
+      parser.beginObject();
+      while(parser.nextKey(key))
       {
-         // Skip untitled frames.
-         continue;
-      }
-      
-      // Make sure this frame name has not already been used in this file
-      if(frameIndices.find(frameName) != frameIndices.end())
-      {
-         DEBUG("Duplicated name %s in spritesheet.", frameName.c_str());
-         T_T("Parse error reading spritesheet.");
+         if(key == "name") parser.readString(frameName);
+         else if(key == "left") left = parser.readInt();
+         else if(key == "top") top = parser.readInt();
+         else if(key == "right") right = parser.readInt();
+         else if(key == "bottom") bottom = parser.readInt();
+         else parser.skipValue();
       }
-      else
+
+      // The texture coordinates are worked out now, so that drawing a frame is just a matter of adding its quad to the batch
+      FrameQuad frame = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+      if(frameName == UNTITLED_LINE)
       {
-         DEBUG("Adding frame %s...", frameName.c_str());
+         // Skip untitled frames (which still take up their place in the frame list).
+         frames.push_back(frame);
+         names.push_back(std::string());
+         continue;
       }
 
-      // Get the frame rectangle coordinates
-      int left = currFrame["left"].asInt();
-      int top = currFrame["top"].asInt();
-      int right = currFrame["right"].asInt();
-      int bottom = currFrame["bottom"].asInt();
+      frame.width = float(right - left);
+      frame.height = float(bottom - top);
+      frame.left = textureRegion.mapU(left / float(width));
+      frame.top = textureRegion.mapV(top / float(height));
+      frame.right = textureRegion.mapU(right / float(width));
+      frame.bottom = textureRegion.mapV(bottom / float(height));
+      frames.push_back(frame);
+      names.push_back(frameName);
 
-      frameList[i] = SpriteFrame(left, top, right, bottom);
       DEBUG("Frame %s loaded in with coordinates %d, %d, %d, %d",
             frameName.c_str(), left, top, right, bottom);
+   }
 
-      frameIndices[frameName] = i;
+   if(frames.empty())
+   {
+      DEBUG("No frames found in spritesheet.");
+      T_T("Empty (invalid) spritesheet constructed.");
    }
 
+   // Make sure that no frame name is used twice in this file, and index the names
+   buildNameIndex(names, frameNames);
+
    DEBUG("Frames loaded.");
 }
 
-void Spritesheet::parseAnimations(Json::Value& rootElement)
+void Spritesheet::parseAnimations(JsonPullParser& parser, ParsedAnimations& parsedAnimations)
 {
-   Json::Value& animsElement = rootElement["animations"];
-   int numAnimations = animsElement.size();
-
-   if(!animsElement.isArray() || numAnimations <= 0)
+   if(parser.peek() != JsonPullParser::ARRAY)
    {
       DEBUG("No animations found in spritesheet.");
+      parser.skipValue();
       return;
    }
-   
-   for(int i = 0; i < numAnimations; ++i)
+
+   std::string key;
+   parser.beginArray();
+   while(parser.hasNextElement())
    {
-      Json::Value& currAnimation = animsElement[i];
+      ParsedAnimation animation;
+      bool hasFrames = false;
+
+      parser.beginObject();
+      while(parser.nextKey(key))
+      {
+         if(key == "name")
+         {
+            parser.readString(animation.name);
+         }
+         else if(key == "frames" && parser.peek() == JsonPullParser::ARRAY)
+         {
+            hasFrames = true;
+            parser.beginArray();
+            while(parser.hasNextElement())
+            {
+               animation.frameNames.push_back(parser.readString());
+            }
+         }
+         else if(key == "durations" && parser.peek() == JsonPullParser::ARRAY)
+         {
+            // Optionally, each frame of the animation can be shown for its own time (in milliseconds)
+            parser.beginArray();
+            while(parser.hasNextElement())
+            {
+               animation.durations.push_back(parser.readInt());
+            }
+         }
+         else
+         {
+            parser.skipValue();
+         }
+      }
 
-      // Get the name of the animation
-      std::string animationName = currAnimation["name"].asString();
-      if(animationName == UNTITLED_LINE)
+      if(animation.name == UNTITLED_LINE)
       {
          // Skip untitled animations
          continue;
       }
-      
-      // Make sure this animation name has not already been used in this file
-      if(animationList.find(animationName) != animationList.end())
+
+      if(!hasFrames || animation.frameNames.empty())
       {
-         DEBUG("Duplicated animation name %s in spritesheet.", animationName.c_str());
+         // There should be no such thing as an animation without a non-empty array of frames
+         DEBUG("Encountered malformed animation %s.", animation.name.c_str());
          T_T("Parse error reading spritesheet.");
       }
-      
-      // Get the frames of the animation
-      FrameSequence* frameSequence = new FrameSequence();
 
-      Json::Value& frameArray = currAnimation["frames"];
-      int sequenceLength = frameArray.size();
-      if(!frameArray.isArray() || sequenceLength <= 0)
+      if(!animation.durations.empty() && animation.durations.size() != animation.frameNames.size())
       {
-         // There should be no such thing as an animation without a non-empty array of frames
-         DEBUG("Encountered malformed animation %s.", animationName.c_str());
+         DEBUG("Animation %s has %d frames but %d durations.", animation.name.c_str(),
+               static_cast<int>(animation.frameNames.size()), static_cast<int>(animation.durations.size()));
          T_T("Parse error reading spritesheet.");
       }
 
-      for(int i = 0; i < sequenceLength; ++i)
-      {
-         // Get the name of the next frame in the animation
-         std::string frameName = frameArray[i].asString();
+      parsedAnimations.push_back(ParsedAnimation());
+      parsedAnimations.back().name.swap(animation.name);
+      parsedAnimations.back().frameNames.swap(animation.frameNames);
+      parsedAnimations.back().durations.swap(animation.durations);
+   }
+}
+
+void Spritesheet::buildAnimations(const ParsedAnimations& parsedAnimations)
+{
+   std::vector<std::string> names;
+   names.reserve(parsedAnimations.size());
+
+   for(ParsedAnimations::const_iterator animationIter = parsedAnimations.begin(); animationIter != parsedAnimations.end(); ++animationIter)
+   {
+      const std::string& animationName = animationIter->name;
+      const std::vector<std::string>& animationFrameNames = animationIter->frameNames;
+
+      // The animation's steps go on the end of the step array
+      AnimationRange range;
+      range.firstStep = animationSteps.size();
+      range.numSteps = animationFrameNames.size();
 
+      long startTime = 0;
+      for(int i = 0; i < range.numSteps; ++i)
+      {
          // Ensure that the frame exists in the frame list and grab the associated frame index
-         std::map<std::string, int>::const_iterator frameIndexIter = frameIndices.find(frameName);
-         if(frameIndexIter == frameIndices.end())
+         const int frameNameHandle = findName(frameNames, animationFrameNames[i]);
+         const int frameIndex = frameNameHandle < 0 ? -1 : frameNames[frameNameHandle].variants[UNDIRECTED];
+         if(frameIndex < 0)
          {
-            DEBUG("Found invalid frame name '%s' in animation %s", frameName.c_str(), animationName.c_str());
+            DEBUG("Found invalid frame name '%s' in animation %s", animationFrameNames[i].c_str(), animationName.c_str());
             T_T("Parse error reading spritesheet.");
          }
-         
-         int frameIndex = frameIndexIter->second;
 
          DEBUG("Animation %s: Adding node with index %d", animationName.c_str(), frameIndex);
 
-         // Add the retrieved frame index into the sequence of frames
-         frameSequence->push_back(frameIndex);
+         AnimationFrame step;
+         step.frameIndex = frameIndex;
+         step.duration = animationIter->durations.empty() ? DEFAULT_FRAME_DURATION : std::max(animationIter->durations[i], 1L);
+         step.startTime = startTime;
+         animationSteps.push_back(step);
+
+         startTime += step.duration;
       }
 
-      // Bind the animation name to the next available animation index
-      animationList[animationName] = frameSequence;
+      animations.push_back(range);
+      names.push_back(animationName);
    }
+
+   // Make sure that no animation name is used twice in this file, and index the names
+   buildNameIndex(names, animationNames);
 }
 
-int Spritesheet::getFrameIndex(const std::string& frameName) const
+int Spritesheet::findFrameName(const std::string& frameName) const
 {
-   std::map<std::string, int>::const_iterator frameIndex = frameIndices.find(frameName);
-   if(frameIndex != frameIndices.end() && frameIndex->second < numFrames)
+   return findName(frameNames, frameName);
+}
+
+int Spritesheet::getFrameIndex(int frameNameHandle, MovementDirection direction) const
+{
+   if(frameNameHandle < 0 || frameNameHandle >= static_cast<int>(frameNames.size()))
    {
-      return frameIndex->second;
+      return -1;
    }
 
-   return -1;
+   return frameNames[frameNameHandle].variants[getDirectionVariant(direction)];
 }
 
-Animation* Spritesheet::getAnimation(const std::string& animationName) const
+int Spritesheet::findAnimationName(const std::string& animationName) const
 {
-   std::map<std::string, const FrameSequence*>::const_iterator animFrames = animationList.find(animationName);
-   if(animFrames != animationList.end())
+   return findName(animationNames, animationName);
+}
+
+int Spritesheet::getAnimationIndex(int animationNameHandle, MovementDirection direction) const
+{
+   if(animationNameHandle < 0 || animationNameHandle >= static_cast<int>(animationNames.size()))
    {
-      return new Animation(animationName, *(animFrames->second));
+      return -1;
    }
 
-   return NULL;
+   return animationNames[animationNameHandle].variants[getDirectionVariant(direction)];
 }
 
+const AnimationFrame* Spritesheet::getAnimationSteps(int animationIndex, int& numSteps) const
+{
+   if(animationIndex < 0 || animationIndex >= static_cast<int>(animations.size()))
+   {
+      numSteps = 0;
+      return NULL;
+   }
+
+   const AnimationRange& range = animations[animationIndex];
+   numSteps = range.numSteps;
+   return &animationSteps[range.firstStep];
+}
 
-void Spritesheet::draw(const int x, const int y, const int frameIndex) const
+void Spritesheet::draw(const int x, const int y, const int frameIndex, const unsigned int tint) const
 {
-   if(frameList == NULL)
+   if(frames.empty())
    {
       // Don't draw if the spritesheet was not initialized
       // (i.e. there was a failure constructing this spritesheet)
       return;
    }
 
-   if(frameIndex < 0 || frameIndex > numFrames)
+   if(frameIndex < 0 || frameIndex >= static_cast<int>(frames.size()))
    {
       DEBUG("Spritesheet frame index %d out of bounds!", frameIndex);
       return;
    }
 
-   SpriteFrame f = frameList[frameIndex];
-
-   /**
-    * \todo We can do all these calculations when the frames are initialized
-    *       in order to optimize the drawing code a bit more!
-    */
-   int frameHeight = f.bottom - f.top;
-   int frameWidth = f.right - f.left;
+   const FrameQuad& f = frames[frameIndex];
 
-   float frameTop = f.top / float(height);
-   float frameBottom = f.bottom / float(height);
-   float frameLeft = f.left / float(width);
-   float frameRight = f.right / float(width);
-   
    float destLeft = float(x);
    float destBottom = float(y);
-   float destRight = destLeft + frameWidth;
-   float destTop = destBottom - frameHeight;
+   float destRight = destLeft + f.width;
+   float destTop = destBottom - f.height;
 
-   // NOTE: Alpha testing doesn't do transparency; it either draws a pixel or it doesn't
-   // If we want fades or something like that, we would need to use alpha blending
-
-   /** \todo Alpha testing is currently bugged. Investigate and fix. */
-
-   // Retain old alpha test state, function and threshold
-   //int oldAlphaFunction;
-   //float oldAlphaThreshold;
-   //glGetIntegerv(GL_ALPHA_TEST_FUNC, &oldAlphaFunction);
-   //glGetFloatv(GL_ALPHA_TEST_REF, &oldAlphaThreshold);
-
-   //bool alphaTestEnabled = glIsEnabled(GL_ALPHA_TEST);
+   // The quad is drawn along with the rest of the frame's sprites, just before the GUI,
+   // and the batch turns on the alpha test itself while the depth test orders the sprites
+   GraphicsUtil::getInstance()->getSpriteBatch()->addQuad(textureRegion.texture, destLeft, destTop, destRight, destBottom,
+         f.left, f.top, f.right, f.bottom, tint);
+}
 
-   // Enable alpha testing
-   //glEnable(GL_ALPHA_TEST);
+void Spritesheet::bake(const int x, const int y, const int frameIndex, StaticSpriteBatch& batch) const
+{
+   if(frameIndex < 0 || frameIndex >= static_cast<int>(frames.size()))
+   {
+      DEBUG("Spritesheet frame index %d out of bounds!", frameIndex);
+      return;
+   }
 
-   // Set the alpha blending evaluation function
-   //glAlphaFunc(GL_GREATER, 0.1);
+   const FrameQuad& f = frames[frameIndex];
+   const float destLeft = float(x);
+   const float destBottom = float(y);
+   batch.addQuad(textureRegion.texture, destLeft, destBottom - f.height, destLeft + f.width, destBottom, f.left, f.top, f.right, f.bottom);
+}
 
-   glBindTexture(GL_TEXTURE_2D, texture);
+void Spritesheet::invalidate(const char* path)
+{
+   GraphicsUtil::getInstance()->forgetAtlasTexture((std::string(path) + IMG_EXTENSION).c_str());
+}
 
-   glBegin(GL_QUADS);
-      glTexCoord2f(frameLeft, frameTop); glVertex3f(destLeft, destTop, 0.0f);
-      glTexCoord2f(frameRight, frameTop); glVertex3f(destRight, destTop, 0.0f);
-      glTexCoord2f(frameRight, frameBottom); glVertex3f(destRight, destBottom, 0.0f);
-      glTexCoord2f(frameLeft, frameBottom); glVertex3f(destLeft, destBottom, 0.0f);
-   glEnd();
+bool Spritesheet::canReload()
+{
+   return true;
+}
 
-   // We're done with alpha testing, return to default state
-   //glAlphaFunc(oldAlphaFunction, oldAlphaThreshold);
-   //if(!alphaTestEnabled) glDisable(GL_ALPHA_TEST);
+void Spritesheet::swapData(Resource& other)
+{
+   Spritesheet& otherSheet = static_cast<Spritesheet&>(other);
+   std::swap(textureRegion, otherSheet.textureRegion);
+   std::swap(width, otherSheet.width);
+   std::swap(height, otherSheet.height);
+   frames.swap(otherSheet.frames);
+   frameNames.swap(otherSheet.frameNames);
+   animations.swap(otherSheet.animations);
+   animationNames.swap(otherSheet.animationNames);
+
+   // The old animation steps stay with this spritesheet, since its sprites may still be playing them
+   retiredAnimationSteps.push_back(std::vector<AnimationFrame>());
+   retiredAnimationSteps.back().swap(animationSteps);
+   animationSteps.swap(otherSheet.animationSteps);
 }
 
 size_t Spritesheet::getSize()
 {
-   return sizeof(Spritesheet);
+   // The spritesheet's image is kept as a 32-bit texture, alongside its frames and animations
+   return sizeof(*this) + width * height * 4 + frames.size() * sizeof(FrameQuad)
+         + (frameNames.size() + animationNames.size()) * sizeof(NameEntry)
+         + animationSteps.size() * sizeof(AnimationFrame) + animations.size() * sizeof(AnimationRange);
 }
 
 Spritesheet::~Spritesheet()
 {
-   // Delete the frame lists for the animations
-   std::map<std::string, const FrameSequence*>::iterator iter;
-   for(iter = animationList.begin(); iter != animationList.end(); ++iter)
-   {
-      delete iter->second;
-   }
-
-   // Delete all the static frames
-   delete [] frameList;
 }
@@ -8,19 +8,15 @@
 #define SPRITESHEET_H
 
 #include "Resource.h"
-#include "FrameSequence.h"
-#include <map>
+#include "AnimationFrame.h"
+#include "MovementDirection.h"
+#include "TextureAtlas.h"
+#include <list>
 #include <string>
+#include <vector>
 
-namespace Json
-{
-   class Value;
-};
-
-struct SpriteFrame;
-class Animation;
-
-typedef unsigned int GLuint;
+class JsonPullParser;
+class StaticSpriteBatch;
 
 /**
  * The Spritesheet class represents an entire spritesheet image. It holds a
@@ -28,6 +24,11 @@ typedef unsigned int GLuint;
  * each of the frames, and a listing of animations.
  * This additional frame and animation data is specified by a related .EDS file.
  *
+ * Once loaded, the frames and animations are kept in flat tables: the frames with their texture
+ * coordinates already worked out, and the steps of every animation in one array. Frame and animation
+ * names are looked up once (in sorted name indices) to get a handle, and each handle already knows the
+ * frame or animation to use for every direction, so sprites can change direction without any string work.
+ *
  * @author Noam Chitayat
  */
 class Spritesheet : public Resource
@@ -46,8 +47,77 @@ class Spritesheet : public Resource
     */
    static const std::string UNTITLED_LINE;
 
-   /** The spritesheet texture */
-   GLuint texture;
+   /** The time (in milliseconds) that each step of an animation is shown, unless the animation gives its own durations. */
+   static const long DEFAULT_FRAME_DURATION;
+
+   /** The directions that a frame or animation can have its own variant for. */
+   enum DirectionVariant
+   {
+      UNDIRECTED,
+      FACING_UP,
+      FACING_DOWN,
+      FACING_LEFT,
+      FACING_RIGHT,
+      NUM_DIRECTION_VARIANTS
+   };
+
+   /** The suffix that names each direction's variant of a frame or animation (such as "walk_up" for walking upward). */
+   static const char* const DIRECTION_SUFFIXES[NUM_DIRECTION_VARIANTS];
+
+   /** A frame, ready to be added to the sprite batch. */
+   struct FrameQuad
+   {
+      /** The size of the frame (in pixels). */
+      float width, height;
+
+      /** The edges of the frame within the texture atlas page. */
+      float left, top, right, bottom;
+   };
+
+   /** The run of steps in the animation step array that make up one animation. */
+   struct AnimationRange
+   {
+      /** The index of the animation's first step. */
+      int firstStep;
+
+      /** The number of steps in the animation. */
+      int numSteps;
+   };
+
+   /** An entry in a name index. */
+   struct NameEntry
+   {
+      /** The name of the frame or animation. */
+      std::string name;
+
+      /**
+       * The index of the frame or animation to use for each direction (or -1 if there isn't one).
+       * Directions without their own variant use the undirected one.
+       */
+      int variants[NUM_DIRECTION_VARIANTS];
+   };
+
+   /** A name index, sorted by name. */
+   typedef std::vector<NameEntry> NameIndex;
+
+   /** An animation as it appears in the spritesheet data, before its frame names are resolved. */
+   struct ParsedAnimation
+   {
+      /** The name of the animation. */
+      std::string name;
+
+      /** The names of the animation's frames. */
+      std::vector<std::string> frameNames;
+
+      /** The time that each frame is shown for (empty if the animation uses the default). */
+      std::vector<long> durations;
+   };
+
+   /** The animations in the spritesheet data, in the order they appear. */
+   typedef std::vector<ParsedAnimation> ParsedAnimations;
+
+   /** The region of the texture atlas that holds the spritesheet */
+   TextureAtlas::Region textureRegion;
 
    /** Width (in pixels) */
    int width;
@@ -55,20 +125,49 @@ class Spritesheet : public Resource
    /** Height (in pixels) */
    int height;
 
-   /** The array of frames, which hold locations of different sprites in the sheet. */
-   SpriteFrame* frameList;
+   /** The frames, which hold locations of different sprites in the sheet. */
+   std::vector<FrameQuad> frames;
+
+   /** The index of frame names. */
+   NameIndex frameNames;
 
-   /** The number of frames available in the spritesheet. */
-   int numFrames;
+   /** The steps of every animation, one animation after another. */
+   std::vector<AnimationFrame> animationSteps;
 
-   /** The mapping of frame names to their indices in the frameList array. */
-   std::map<std::string, int> frameIndices;
+   /** The runs of animationSteps that make up each animation. */
+   std::vector<AnimationRange> animations;
 
-   /** The number of animations available in the spritesheet. */
-   int numAnimations;
+   /** The index of animation names. */
+   NameIndex animationNames;
+
+   /**
+    * The animation steps that the spritesheet had before it was reloaded.
+    * Sprites may still be playing them until they next step, so they are kept until the spritesheet is deleted.
+    */
+   std::list<std::vector<AnimationFrame> > retiredAnimationSteps;
 
-   /** The mapping of animation names to their frame lists. */
-   std::map<std::string, const FrameSequence*> animationList;
+   /**
+    * @param direction A direction of movement.
+    *
+    * @return The variant of a frame or animation to use for the direction.
+    */
+   static DirectionVariant getDirectionVariant(MovementDirection direction);
+
+   /**
+    * Builds a name index, including the variants for each direction.
+    *
+    * @param names The name of each frame or animation, by its index (empty names are left out).
+    * @param index The parameter used to return the name index.
+    */
+   static void buildNameIndex(const std::vector<std::string>& names, NameIndex& index);
+
+   /**
+    * @param index The name index to search.
+    * @param name The name to look up.
+    *
+    * @return The position of the name in the index, or -1 if it isn't there.
+    */
+   static int findName(const NameIndex& index, const std::string& name);
 
    /**
     * Loads the spritesheet image into an OpenGL texture, and loads the
@@ -81,16 +180,32 @@ class Spritesheet : public Resource
    /**
     * Loads the sprite frames from the spritesheet data. 
     *
-    * @param rootElement The element containing the sprite frames.
+    * @param parser The parser reading the spritesheet data, which is at the array of sprite frames.
     */
-   void parseFrames(Json::Value& rootElement);
+   void parseFrames(JsonPullParser& parser);
    
    /**
-    * Loads the sprite animations from the spritesheet data. 
+    * Reads the sprite animations from the spritesheet data, leaving them to be put together once all the frames are loaded.
     *
-    * @param rootElement The element containing the sprite frames.
+    * @param parser The parser reading the spritesheet data, which is at the array of sprite animations.
+    * @param parsedAnimations The list to add the animations to.
     */
-   void parseAnimations(Json::Value& rootElement);
+   void parseAnimations(JsonPullParser& parser, ParsedAnimations& parsedAnimations);
+
+   /**
+    * Puts together the sprite animations from the names of their frames.
+    *
+    * @param parsedAnimations The animations read from the spritesheet data.
+    */
+   void buildAnimations(const ParsedAnimations& parsedAnimations);
+
+   /**
+    * Implementation of method in Resource class.
+    * Swaps the spritesheet's image, frames and animations.
+    *
+    * @param other The spritesheet to swap data with.
+    */
+   void swapData(Resource& other);
 
    public:
       /**
@@ -102,36 +217,95 @@ class Spritesheet : public Resource
 
       /**
        * Draws a given frame at a specified location.
+       * The frame is added to the graphics sprite batch, and appears on screen when the batch is flushed.
        *
        * @param x The x-location to draw at.
        * @param y The y-location to draw at.
        * @param frameIndex The frame to draw.
+       * @param tint The tint to draw the frame with, as packed by SpriteBatch::getTint.
        */
-      void draw(const int x, const int y, const int frameIndex) const;
+      void draw(const int x, const int y, const int frameIndex, const unsigned int tint) const;
 
       /**
-       * Get the index of a frame specified by the frame name.
+       * Adds a given frame at a specified location to a static batch, instead of drawing it on each frame.
+       * The frame's texture coordinates are baked into the batch, so the batch has to be built again if the spritesheet is reloaded.
        *
-       * @param frameName The name of the frame to get.
+       * @param x The x-location to draw at.
+       * @param y The y-location to draw at.
+       * @param frameIndex The frame to add.
+       * @param batch The static batch to add the frame to.
+       */
+      void bake(const int x, const int y, const int frameIndex, StaticSpriteBatch& batch) const;
+
+      /**
+       * Looks up the name of a frame.
+       *
+       * @param frameName The name of the frame.
        *
-       * @return An index into the frame requested.
+       * @return A handle to the name, for getFrameIndex, or -1 if there is no frame with that name (in any direction).
        */
-      int getFrameIndex(const std::string& frameName) const;
+      int findFrameName(const std::string& frameName) const;
 
       /**
-       * Get a new animation list specified by the animation name.
+       * Get the index of the frame to draw for a frame name and direction.
+       *
+       * @param frameNameHandle The handle returned by findFrameName.
+       * @param direction The direction that the frame should face. If there is no frame for the direction,
+       *                  the undirected frame is used.
        *
-       * @param animationName The name of the animation to get.
+       * @return An index into the frame requested, or -1 if there isn't one.
+       */
+      int getFrameIndex(int frameNameHandle, MovementDirection direction) const;
+
+      /**
+       * Looks up the name of an animation.
+       *
+       * @param animationName The name of the animation.
+       *
+       * @return A handle to the name, for getAnimationIndex, or -1 if there is no animation with that name (in any direction).
+       */
+      int findAnimationName(const std::string& animationName) const;
+
+      /**
+       * Get the index of the animation to play for an animation name and direction.
+       *
+       * @param animationNameHandle The handle returned by findAnimationName.
+       * @param direction The direction that the animation should face. If there is no animation for the direction,
+       *                  the undirected animation is used.
+       *
+       * @return An index into the animation requested, or -1 if there isn't one.
+       */
+      int getAnimationIndex(int animationNameHandle, MovementDirection direction) const;
+
+      /**
+       * Get the steps of an animation.
+       *
+       * @param animationIndex The index of the animation (from getAnimationIndex).
+       * @param numSteps The parameter used to return the number of steps in the animation.
+       *
+       * @return The animation's steps, which stay valid until the spritesheet is deleted.
+       */
+      const AnimationFrame* getAnimationSteps(int animationIndex, int& numSteps) const;
+
+      /**
+       * Implementation of method in Resource class.
+       * Forgets the spritesheet image's space in the texture atlas, so that the image is loaded afresh.
+       *
+       * @param path The path to the spritesheet image and data (without their extensions).
+       */
+      void invalidate(const char* path);
+
+      /**
+       * Implementation of method in Resource class.
        *
-       * @return An animation structure that can outputs a frame index for the
-       *         amount of time that has passed.
+       * @return true, since sprites look their frames up again when their spritesheet is reloaded.
        */
-      Animation* getAnimation(const std::string& animationName) const;
+      bool canReload();
 
       /**
        * Implementation of method in Resource class.
        *
-       * @return The size of the spritesheet resource in memory.
+       * @return The size of the spritesheet resource in memory, including its texture.
        */
       size_t getSize();
 
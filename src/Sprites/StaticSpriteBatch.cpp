@@ -0,0 +1,93 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "StaticSpriteBatch.h"
+#include "GLState.h"
+#include "VertexBuffer.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_SPRITE;
+
+StaticSpriteBatch::StaticSpriteBatch() : buffer(NULL)
+{
+}
+
+bool StaticSpriteBatch::isBefore(const Quad& first, const Quad& second)
+{
+   return first.texture < second.texture;
+}
+
+void StaticSpriteBatch::addQuad(GLuint texture, float destLeft, float destTop, float destRight, float destBottom,
+      float textureLeft, float textureTop, float textureRight, float textureBottom)
+{
+   quads.push_back(Quad(texture, pendingVertices.size() / VertexBuffer::FLOATS_PER_DEPTH_VERTEX));
+
+   // The depth is kept in pixels, and the sprite batch scales it into the depth buffer's range as the batch is drawn
+   const float quad[] =
+   {
+      destLeft, destTop, destBottom, textureLeft, textureTop,
+      destRight, destTop, destBottom, textureRight, textureTop,
+      destRight, destBottom, destBottom, textureRight, textureBottom,
+      destLeft, destBottom, destBottom, textureLeft, textureBottom
+   };
+
+   pendingVertices.insert(pendingVertices.end(), quad, quad + sizeof(quad) / sizeof(quad[0]));
+}
+
+void StaticSpriteBatch::build()
+{
+   // The depth test orders the quads, so they only need to be grouped by texture
+   std::stable_sort(quads.begin(), quads.end(), isBefore);
+
+   const int floatsPerQuad = 4 * VertexBuffer::FLOATS_PER_DEPTH_VERTEX;
+   std::vector<float> vertices;
+   vertices.reserve(pendingVertices.size());
+
+   runs.clear();
+   for(std::vector<Quad>::const_iterator iter = quads.begin(); iter != quads.end(); ++iter)
+   {
+      if(runs.empty() || runs.back().texture != iter->texture)
+      {
+         const TextureRun run = { iter->texture, static_cast<int>(vertices.size() / VertexBuffer::FLOATS_PER_DEPTH_VERTEX), 0 };
+         runs.push_back(run);
+      }
+
+      std::vector<float>::const_iterator quadVertices = pendingVertices.begin() + iter->firstVertex * VertexBuffer::FLOATS_PER_DEPTH_VERTEX;
+      vertices.insert(vertices.end(), quadVertices, quadVertices + floatsPerQuad);
+      runs.back().vertexCount += 4;
+   }
+
+   if(buffer == NULL)
+   {
+      buffer = new VertexBuffer(VertexBuffer::STATIC, true);
+   }
+
+   buffer->setVertices(vertices);
+   DEBUG("Built %d static sprite quads with %d textures.", static_cast<int>(quads.size()), static_cast<int>(runs.size()));
+
+   quads.clear();
+   pendingVertices.clear();
+}
+
+bool StaticSpriteBatch::isDrawable() const
+{
+   return buffer != NULL && !runs.empty();
+}
+
+void StaticSpriteBatch::draw() const
+{
+   for(std::vector<TextureRun>::const_iterator iter = runs.begin(); iter != runs.end(); ++iter)
+   {
+      GLState::bindTexture(iter->texture);
+      buffer->drawQuads(iter->firstVertex, iter->vertexCount);
+   }
+}
+
+StaticSpriteBatch::~StaticSpriteBatch()
+{
+   delete buffer;
+}
@@ -0,0 +1,126 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef STATIC_SPRITE_BATCH_H
+#define STATIC_SPRITE_BATCH_H
+
+#include <vector>
+
+class VertexBuffer;
+typedef unsigned int GLuint;
+
+/**
+ * A set of sprite quads that never change (such as the frames of a map's obstacles), built into a static vertex buffer once
+ * and then drawn as part of the sprite batch (see SpriteBatch::addStaticBatch) on every frame, without adding them again.
+ *
+ * Like the sprite batch's own quads, each quad's depth is its bottom edge, and the depth test orders the quads
+ * against the sprite batch's quads, so the static quads can still be drawn over the actors walking behind them.
+ * The quads are grouped by texture when the batch is built, so each texture is drawn with one draw call.
+ * Static quads are always drawn untinted.
+ *
+ * The quads are placed on the map (in pixels), and the sprite batch moves them by the drawing offset as they are drawn.
+ */
+class StaticSpriteBatch
+{
+   friend class SpriteBatch;
+
+   /** A quad waiting to be built into the buffer. */
+   struct Quad
+   {
+      /** The texture to draw the quad with. */
+      GLuint texture;
+
+      /** The index of the quad's first vertex among the batch's pending vertices. */
+      int firstVertex;
+
+      Quad(GLuint texture, int firstVertex) : texture(texture), firstVertex(firstVertex) {}
+   };
+
+   /** A run of quads in the buffer that share a texture. */
+   struct TextureRun
+   {
+      /** The texture that the run is drawn with. */
+      GLuint texture;
+
+      /** The index of the run's first vertex in the buffer. */
+      int firstVertex;
+
+      /** The number of vertices in the run. */
+      int vertexCount;
+   };
+
+   /** The quads added since the batch was last built, in the order they were added. */
+   std::vector<Quad> quads;
+
+   /** The vertices of the quads added since the batch was last built, with VertexBuffer::FLOATS_PER_DEPTH_VERTEX floats per vertex. */
+   std::vector<float> pendingVertices;
+
+   /** The runs of quads in the buffer, one for each texture. */
+   std::vector<TextureRun> runs;
+
+   /** The buffer that the quads are built into, or NULL if the batch hasn't been built. */
+   VertexBuffer* buffer;
+
+   /**
+    * @return true iff the first quad's texture comes before the second's.
+    */
+   static bool isBefore(const Quad& first, const Quad& second);
+
+   /**
+    * Draws the built quads, one draw call per texture. Called by the sprite batch once it has set up the depth test.
+    */
+   void draw() const;
+
+   /**
+    * StaticSpriteBatches can't be copied.
+    */
+   StaticSpriteBatch(const StaticSpriteBatch&);
+
+   /**
+    * StaticSpriteBatches can't be copied.
+    */
+   StaticSpriteBatch& operator=(const StaticSpriteBatch&);
+
+   public:
+      /**
+       * Constructor.
+       */
+      StaticSpriteBatch();
+
+      /**
+       * Adds a textured quad to the batch, to be drawn once the batch is built. The depth of the quad is its bottom edge.
+       *
+       * @param texture The texture to draw the quad with.
+       * @param destLeft The left edge of the quad (in pixels).
+       * @param destTop The top edge of the quad (in pixels).
+       * @param destRight The right edge of the quad (in pixels).
+       * @param destBottom The bottom edge of the quad (in pixels).
+       * @param textureLeft The left texture coordinate.
+       * @param textureTop The top texture coordinate.
+       * @param textureRight The right texture coordinate.
+       * @param textureBottom The bottom texture coordinate.
+       */
+      void addQuad(GLuint texture, float destLeft, float destTop, float destRight, float destBottom,
+            float textureLeft, float textureTop, float textureRight, float textureBottom);
+
+      /**
+       * Builds the quads added so far into the batch's vertex buffer, in place of the quads that were built before.
+       * The OpenGL context must be current.
+       */
+      void build();
+
+      /**
+       * @return true iff the batch has been built with at least one quad.
+       */
+      bool isDrawable() const;
+
+      /**
+       * Destructor.
+       */
+      ~StaticSpriteBatch();
+};
+
+#endif
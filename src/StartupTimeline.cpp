@@ -0,0 +1,86 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "StartupTimeline.h"
+#include "EngineClock.h"
+#include <iomanip>
+#include <sstream>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_MAIN;
+
+// Static constructors run before main, so this is as close to launch as the engine can get
+static const double LAUNCH_TIME = EngineClock::getTime();
+
+std::vector<StartupTimeline::Phase> StartupTimeline::phases;
+bool StartupTimeline::finished = false;
+
+double StartupTimeline::getTime()
+{
+   return EngineClock::getTime() - LAUNCH_TIME;
+}
+
+int StartupTimeline::begin(const char* name)
+{
+   if(finished) return -1;
+
+   Phase phase = { name, getTime(), -1.0 };
+   phases.push_back(phase);
+   return static_cast<int>(phases.size()) - 1;
+}
+
+void StartupTimeline::end(int phase)
+{
+   if(finished || phase < 0) return;
+
+   phases[phase].end = getTime();
+}
+
+void StartupTimeline::add(const char* name, double start, double end)
+{
+   if(finished) return;
+
+   Phase phase = { name, start, end };
+   phases.push_back(phase);
+}
+
+void StartupTimeline::finish()
+{
+   if(finished) return;
+
+   add("first frame", 0, getTime());
+   finished = true;
+
+   std::vector<std::string> lines;
+   describe(lines);
+   for(std::vector<std::string>::const_iterator iter = lines.begin(); iter != lines.end(); ++iter)
+   {
+      DEBUG("Startup: %s", iter->c_str());
+   }
+}
+
+void StartupTimeline::describe(std::vector<std::string>& lines)
+{
+   for(std::vector<Phase>::const_iterator iter = phases.begin(); iter != phases.end(); ++iter)
+   {
+      std::stringstream line;
+      line << std::fixed << std::setprecision(1);
+      line << std::left << std::setw(20) << iter->name << std::right
+           << std::setw(8) << iter->start / 1000.0 << " ms to ";
+
+      if(iter->end < 0)
+      {
+         line << "     ...";
+      }
+      else
+      {
+         line << std::setw(8) << iter->end / 1000.0 << " ms (" << (iter->end - iter->start) / 1000.0 << " ms)";
+      }
+
+      lines.push_back(line.str());
+   }
+}
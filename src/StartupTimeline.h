@@ -0,0 +1,86 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef STARTUP_TIMELINE_H
+#define STARTUP_TIMELINE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Records how long each phase of starting the game takes, from launch until the first frame has been drawn.
+ *
+ * Phases are timed on the main thread with begin and end. Phases that run in the background (such as opening the audio device)
+ * time themselves and are added once the main thread picks up their results, so the timeline shows which phases overlapped.
+ * Once the first frame is done, the timeline is finished and logged, and phases begun after that aren't recorded.
+ */
+class StartupTimeline
+{
+   /** A phase of startup. */
+   struct Phase
+   {
+      /** The name of the phase (which must be a string literal, since only its pointer is kept). */
+      const char* name;
+
+      /** The time that the phase started (in microseconds since launch). */
+      double start;
+
+      /** The time that the phase ended (in microseconds since launch), or a negative time if it hasn't ended yet. */
+      double end;
+   };
+
+   /** The phases of startup, in the order they were begun. */
+   static std::vector<Phase> phases;
+
+   /** true iff the first frame has been drawn, which ends the timeline. */
+   static bool finished;
+
+   public:
+      /**
+       * @return The time since launch (in microseconds). This is safe to call from any thread.
+       */
+      static double getTime();
+
+      /**
+       * Starts timing a phase of startup on the main thread.
+       *
+       * @param name The name of the phase (which must be a string literal).
+       *
+       * @return The phase number to end the phase with, or -1 if the timeline is already finished.
+       */
+      static int begin(const char* name);
+
+      /**
+       * Stops timing a phase of startup.
+       *
+       * @param phase The phase number returned when the phase was begun.
+       */
+      static void end(int phase);
+
+      /**
+       * Adds a phase that was timed on another thread.
+       *
+       * @param name The name of the phase (which must be a string literal).
+       * @param start The time that the phase started (from getTime).
+       * @param end The time that the phase ended (from getTime).
+       */
+      static void add(const char* name, double start, double end);
+
+      /**
+       * Ends the timeline once the first frame has been drawn, and logs each of its phases.
+       * Later calls do nothing.
+       */
+      static void finish();
+
+      /**
+       * Describes when each phase of startup began and ended, and how long it took.
+       *
+       * @param lines The list to add the lines of the description to.
+       */
+      static void describe(std::vector<std::string>& lines);
+};
+
+#endif
@@ -0,0 +1,317 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "TextureAtlas.h"
+#include "GLState.h"
+#include "GraphicsUtil.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+// A 2048x2048 page holds dozens of spritesheets and tilesets, and every OpenGL driver we run on supports it
+const int TextureAtlas::PAGE_SIZE = 2048;
+
+// One pixel is all that linear filtering reaches past an image's edge when it is drawn at its own size
+const int TextureAtlas::PADDING = 1;
+
+bool TextureAtlas::functionsLoaded = false;
+bool TextureAtlas::pixelBuffersSupported = false;
+
+// The pixel buffer object functions aren't part of OpenGL 1.1, so they have to be looked up from the driver
+static PFNGLGENBUFFERSARBPROC genBuffers = NULL;
+static PFNGLBINDBUFFERARBPROC bindBuffer = NULL;
+static PFNGLBUFFERDATAARBPROC bufferData = NULL;
+static PFNGLMAPBUFFERARBPROC mapBuffer = NULL;
+static PFNGLUNMAPBUFFERARBPROC unmapBuffer = NULL;
+static PFNGLDELETEBUFFERSARBPROC deleteBuffers = NULL;
+
+void TextureAtlas::loadFunctions()
+{
+   functionsLoaded = true;
+
+   const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+   if(extensions == NULL || strstr(extensions, "GL_ARB_pixel_buffer_object") == NULL)
+   {
+      DEBUG("Pixel buffer objects are not supported; images will be uploaded directly.");
+      return;
+   }
+
+   genBuffers = reinterpret_cast<PFNGLGENBUFFERSARBPROC>(GraphicsUtil::getProcAddress("glGenBuffersARB"));
+   bindBuffer = reinterpret_cast<PFNGLBINDBUFFERARBPROC>(GraphicsUtil::getProcAddress("glBindBufferARB"));
+   bufferData = reinterpret_cast<PFNGLBUFFERDATAARBPROC>(GraphicsUtil::getProcAddress("glBufferDataARB"));
+   mapBuffer = reinterpret_cast<PFNGLMAPBUFFERARBPROC>(GraphicsUtil::getProcAddress("glMapBufferARB"));
+   unmapBuffer = reinterpret_cast<PFNGLUNMAPBUFFERARBPROC>(GraphicsUtil::getProcAddress("glUnmapBufferARB"));
+   deleteBuffers = reinterpret_cast<PFNGLDELETEBUFFERSARBPROC>(GraphicsUtil::getProcAddress("glDeleteBuffersARB"));
+
+   pixelBuffersSupported = genBuffers != NULL && bindBuffer != NULL && bufferData != NULL
+         && mapBuffer != NULL && unmapBuffer != NULL && deleteBuffers != NULL;
+   DEBUG("Pixel buffer objects are %s", pixelBuffersSupported ? "supported" : "missing functions; images will be uploaded directly.");
+}
+
+TextureAtlas::TextureAtlas() : pageSize(0), pixelBuffer(0)
+{
+}
+
+int TextureAtlas::createPage(int size)
+{
+   Page page;
+   page.size = size;
+   page.nextShelfTop = 0;
+
+   glGenTextures(1, &page.texture);
+   GLState::bindTexture(page.texture);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+   // Start the page out transparent, so that the space between images draws nothing
+   const std::vector<unsigned char> blankPixels(size * size * 4, 0);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, &blankPixels[0]);
+
+   DEBUG("Created %dx%d texture atlas page %d.", size, size, static_cast<int>(pages.size()));
+   pages.push_back(page);
+   return pages.size() - 1;
+}
+
+void TextureAtlas::allocate(int width, int height, int& pageNum, int& x, int& y)
+{
+   if(pageSize == 0)
+   {
+      GLint maxTextureSize;
+      glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+      pageSize = std::min(PAGE_SIZE, static_cast<int>(maxTextureSize));
+   }
+
+   if(width > pageSize || height > pageSize)
+   {
+      // The image gets a page of its own, which nothing else is placed on
+      pageNum = createPage(std::max(width, height));
+      pages[pageNum].nextShelfTop = pages[pageNum].size;
+      x = 0;
+      y = 0;
+      return;
+   }
+
+   // Use the shelf that the image fits in with the least height to spare
+   Shelf* bestShelf = NULL;
+   int bestPageNum = -1;
+   int bestSpareHeight = INT_MAX;
+   for(int currPageNum = 0; currPageNum < static_cast<int>(pages.size()); ++currPageNum)
+   {
+      Page& page = pages[currPageNum];
+      for(std::vector<Shelf>::iterator iter = page.shelves.begin(); iter != page.shelves.end(); ++iter)
+      {
+         const int spareHeight = iter->height - height;
+         if(spareHeight >= 0 && spareHeight < bestSpareHeight && iter->usedWidth + width <= page.size)
+         {
+            bestShelf = &*iter;
+            bestPageNum = currPageNum;
+            bestSpareHeight = spareHeight;
+         }
+      }
+   }
+
+   if(bestShelf == NULL)
+   {
+      // Otherwise, start a new shelf on the first page with room for it
+      for(int currPageNum = 0; currPageNum < static_cast<int>(pages.size()) && bestShelf == NULL; ++currPageNum)
+      {
+         Page& page = pages[currPageNum];
+         if(page.nextShelfTop + height <= page.size)
+         {
+            page.shelves.push_back(Shelf(page.nextShelfTop, height));
+            page.nextShelfTop += height;
+            bestShelf = &page.shelves.back();
+            bestPageNum = currPageNum;
+         }
+      }
+   }
+
+   if(bestShelf == NULL)
+   {
+      // Every page is full, so the shelf goes on a new page
+      bestPageNum = createPage(pageSize);
+      Page& page = pages[bestPageNum];
+      page.shelves.push_back(Shelf(0, height));
+      page.nextShelfTop = height;
+      bestShelf = &page.shelves.back();
+   }
+
+   pageNum = bestPageNum;
+   x = bestShelf->usedWidth;
+   y = bestShelf->top;
+   bestShelf->usedWidth += width;
+}
+
+const TextureAtlas::Region* TextureAtlas::find(const std::string& path) const
+{
+   std::map<std::string, Entry>::const_iterator entry = entries.find(path);
+   return entry == entries.end() ? NULL : &entry->second.region;
+}
+
+const TextureAtlas::Region& TextureAtlas::reserve(const std::string& path, int width, int height)
+{
+   std::map<std::string, Entry>::const_iterator existingEntry = entries.find(path);
+   if(existingEntry != entries.end())
+   {
+      return existingEntry->second.region;
+   }
+
+   Entry entry;
+   entry.paddedWidth = width + 2 * PADDING;
+   entry.paddedHeight = height + 2 * PADDING;
+   allocate(entry.paddedWidth, entry.paddedHeight, entry.pageNum, entry.x, entry.y);
+   const Page& page = pages[entry.pageNum];
+
+   entry.region.texture = page.texture;
+   entry.region.left = float(entry.x + PADDING) / page.size;
+   entry.region.top = float(entry.y + PADDING) / page.size;
+   entry.region.right = float(entry.x + PADDING + width) / page.size;
+   entry.region.bottom = float(entry.y + PADDING + height) / page.size;
+
+   DEBUG("Placed %s (%dx%d) at (%d, %d) on texture atlas page %d.", path.c_str(), width, height, entry.x + PADDING, entry.y + PADDING, entry.pageNum);
+   return entries.insert(std::make_pair(path, entry)).first->second.region;
+}
+
+void TextureAtlas::padImage(const unsigned char* pixels, int pitch, int width, int height, std::vector<unsigned char>& paddedPixels)
+{
+   // Copy the image into the middle of a padded image, repeating its edge pixels out into the border
+   const int paddedWidth = width + 2 * PADDING;
+   const int paddedHeight = height + 2 * PADDING;
+   paddedPixels.resize(paddedWidth * paddedHeight * 4);
+   for(int paddedY = 0; paddedY < paddedHeight; ++paddedY)
+   {
+      const int imageY = std::min(std::max(paddedY - PADDING, 0), height - 1);
+      const unsigned char* imageRow = pixels + imageY * pitch;
+      unsigned char* paddedRow = &paddedPixels[paddedY * paddedWidth * 4];
+
+      memcpy(paddedRow + PADDING * 4, imageRow, width * 4);
+      for(int border = 0; border < PADDING; ++border)
+      {
+         memcpy(paddedRow + border * 4, imageRow, 4);
+         memcpy(paddedRow + (PADDING + width + border) * 4, imageRow + (width - 1) * 4, 4);
+      }
+   }
+}
+
+void TextureAtlas::upload(const std::string& path, const std::vector<unsigned char>& paddedPixels)
+{
+   if(!functionsLoaded)
+   {
+      loadFunctions();
+   }
+
+   std::map<std::string, Entry>::const_iterator entryIter = entries.find(path);
+   if(entryIter == entries.end())
+   {
+      T_T(std::string("No space was reserved in the texture atlas for image: ") + path);
+   }
+
+   const Entry& entry = entryIter->second;
+   GLState::bindTexture(pages[entry.pageNum].texture);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+   if(!pixelBuffersSupported)
+   {
+      glTexSubImage2D(GL_TEXTURE_2D, 0, entry.x, entry.y, entry.paddedWidth, entry.paddedHeight, GL_RGBA, GL_UNSIGNED_BYTE, &paddedPixels[0]);
+      return;
+   }
+
+   if(pixelBuffer == 0)
+   {
+      genBuffers(1, &pixelBuffer);
+   }
+
+   // Orphaning the buffer's old storage lets the driver keep copying the last upload while this one is written
+   bindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, pixelBuffer);
+   bufferData(GL_PIXEL_UNPACK_BUFFER_ARB, paddedPixels.size(), NULL, GL_STREAM_DRAW_ARB);
+
+   void* stagingPixels = mapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+   if(stagingPixels != NULL)
+   {
+      memcpy(stagingPixels, &paddedPixels[0], paddedPixels.size());
+      unmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB);
+
+      // With a pixel buffer bound, the last argument is an offset into the buffer
+      glTexSubImage2D(GL_TEXTURE_2D, 0, entry.x, entry.y, entry.paddedWidth, entry.paddedHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      bindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+   }
+   else
+   {
+      bindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, entry.x, entry.y, entry.paddedWidth, entry.paddedHeight, GL_RGBA, GL_UNSIGNED_BYTE, &paddedPixels[0]);
+   }
+}
+
+const TextureAtlas::Region& TextureAtlas::addTexture(const std::string& path, GLuint texture, int width, int height)
+{
+   const Region* existingRegion = find(path);
+   if(existingRegion != NULL)
+   {
+      glDeleteTextures(1, &texture);
+      return *existingRegion;
+   }
+
+   // The page is full from the start, so nothing else is placed on it
+   Page page;
+   page.texture = texture;
+   page.size = std::max(width, height);
+   page.nextShelfTop = page.size;
+   pages.push_back(page);
+
+   Entry entry;
+   entry.region.texture = texture;
+   entry.pageNum = pages.size() - 1;
+   entry.x = 0;
+   entry.y = 0;
+   entry.paddedWidth = width;
+   entry.paddedHeight = height;
+
+   DEBUG("Gave %s (%dx%d) texture atlas page %d to itself.", path.c_str(), width, height, entry.pageNum);
+   return entries.insert(std::make_pair(path, entry)).first->second.region;
+}
+
+const TextureAtlas::Region& TextureAtlas::add(const std::string& path, const unsigned char* pixels, int pitch, int width, int height)
+{
+   const Region* existingRegion = find(path);
+   if(existingRegion != NULL)
+   {
+      return *existingRegion;
+   }
+
+   const Region& region = reserve(path, width, height);
+
+   std::vector<unsigned char> paddedPixels;
+   padImage(pixels, pitch, width, height, paddedPixels);
+   upload(path, paddedPixels);
+
+   return region;
+}
+
+void TextureAtlas::forget(const std::string& path)
+{
+   if(entries.erase(path) > 0)
+   {
+      DEBUG("Forgot the texture atlas space given to %s.", path.c_str());
+   }
+}
+
+TextureAtlas::~TextureAtlas()
+{
+   for(std::vector<Page>::iterator iter = pages.begin(); iter != pages.end(); ++iter)
+   {
+      glDeleteTextures(1, &iter->texture);
+   }
+
+   if(pixelBuffer != 0)
+   {
+      deleteBuffers(1, &pixelBuffer);
+   }
+}
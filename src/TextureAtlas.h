@@ -0,0 +1,266 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+typedef unsigned int GLuint;
+
+/**
+ * The TextureAtlas packs images into a few large shared textures (pages), so that sprites and tiles
+ * from different images can be drawn without switching textures in between.
+ * Images are placed on shelves (rows of images with similar heights) within each page, with a one pixel
+ * border around each image that repeats its edge pixels, so that filtering at the image's edges
+ * doesn't pick up its neighbours. Images too big to share a page get a page to themselves.
+ *
+ * Images are keyed by their paths, so an image that is loaded again (when its resource is reloaded)
+ * reuses the space it was given the first time. Pages are only released when the atlas is destroyed.
+ * An image whose file has changed can be forgotten, so that loading it again gives it new space;
+ * the old space keeps the old pixels, so anything still drawing from it is unaffected.
+ *
+ * Space for an image can be reserved before its pixels are ready, so that an image decoded in the
+ * background can be drawn right away; the reserved space is transparent until the pixels are uploaded.
+ * Where the OpenGL driver supports pixel buffer objects, uploads are staged through one, so that the
+ * driver can copy the pixels into the page without stalling the calling thread.
+ */
+class TextureAtlas
+{
+   public:
+      /** The part of a page that holds an image. */
+      struct Region
+      {
+         /** The page texture that holds the image. */
+         GLuint texture;
+
+         /** The left edge of the image within the page texture. */
+         float left;
+
+         /** The top edge of the image within the page texture. */
+         float top;
+
+         /** The right edge of the image within the page texture. */
+         float right;
+
+         /** The bottom edge of the image within the page texture. */
+         float bottom;
+
+         Region() : texture(0), left(0.0f), top(0.0f), right(1.0f), bottom(1.0f) {}
+
+         /**
+          * @param u A horizontal texture coordinate within the image (0 to 1).
+          *
+          * @return The matching texture coordinate within the page.
+          */
+         float mapU(float u) const { return left + u * (right - left); }
+
+         /**
+          * @param v A vertical texture coordinate within the image (0 to 1).
+          *
+          * @return The matching texture coordinate within the page.
+          */
+         float mapV(float v) const { return top + v * (bottom - top); }
+      };
+
+   private:
+      /** The width and height (in pixels) of the pages, unless the driver can't make textures that big. */
+      static const int PAGE_SIZE;
+
+      /** The width (in pixels) of the border around each image. */
+      static const int PADDING;
+
+      /** Whether or not the pixel buffer object functions have been looked up. */
+      static bool functionsLoaded;
+
+      /** Whether or not the driver supports pixel buffer objects. */
+      static bool pixelBuffersSupported;
+
+      /**
+       * Looks up the pixel buffer object functions, if the driver supports them.
+       */
+      static void loadFunctions();
+
+      /** A row of images within a page. */
+      struct Shelf
+      {
+         /** The y-coordinate of the top of the shelf (in pixels). */
+         int top;
+
+         /** The height of the shelf (in pixels). */
+         int height;
+
+         /** The width of the shelf that has been filled (in pixels). */
+         int usedWidth;
+
+         Shelf(int top, int height) : top(top), height(height), usedWidth(0) {}
+      };
+
+      /** A shared texture that images are packed into. */
+      struct Page
+      {
+         /** The page texture. */
+         GLuint texture;
+
+         /** The width and height of the page (in pixels). */
+         int size;
+
+         /** The shelves on the page, from top to bottom. */
+         std::vector<Shelf> shelves;
+
+         /** The y-coordinate (in pixels) where the next shelf would go. */
+         int nextShelfTop;
+      };
+
+      /** The space given to an image. */
+      struct Entry
+      {
+         /** The region that holds the image. */
+         Region region;
+
+         /** The index of the page that holds the image. */
+         int pageNum;
+
+         /** The x-coordinate of the padded image within the page (in pixels). */
+         int x;
+
+         /** The y-coordinate of the padded image within the page (in pixels). */
+         int y;
+
+         /** The width of the padded image (in pixels). */
+         int paddedWidth;
+
+         /** The height of the padded image (in pixels). */
+         int paddedHeight;
+      };
+
+      /** The width and height (in pixels) of the pages. Zero until the first page is made. */
+      int pageSize;
+
+      /** The pages that have been made. */
+      std::vector<Page> pages;
+
+      /** The space given to each image, keyed by the image's path. */
+      std::map<std::string, Entry> entries;
+
+      /** The pixel buffer object that uploads are staged through, or 0 if one hasn't been created. */
+      GLuint pixelBuffer;
+
+      /**
+       * Makes a new page.
+       *
+       * @param size The width and height of the page (in pixels).
+       *
+       * @return The index of the new page.
+       */
+      int createPage(int size);
+
+      /**
+       * Finds space for a padded image on the existing pages, or on a new page if there isn't any.
+       *
+       * @param width The width of the padded image (in pixels).
+       * @param height The height of the padded image (in pixels).
+       * @param pageNum The parameter used to return the index of the page holding the space.
+       * @param x The parameter used to return the x-coordinate of the space (in pixels).
+       * @param y The parameter used to return the y-coordinate of the space (in pixels).
+       */
+      void allocate(int width, int height, int& pageNum, int& x, int& y);
+
+      /** Atlases can't be copied. */
+      TextureAtlas(const TextureAtlas&);
+
+      /** Atlases can't be copied. */
+      TextureAtlas& operator=(const TextureAtlas&);
+
+   public:
+      /**
+       * Constructor.
+       */
+      TextureAtlas();
+
+      /**
+       * @param path The path of an image.
+       *
+       * @return The region that holds the image, or NULL if the image isn't in the atlas.
+       */
+      const Region* find(const std::string& path) const;
+
+      /**
+       * Reserves space for an image in the atlas, unless an image with the same path is already in it.
+       * The space stays transparent until the image's pixels are uploaded.
+       *
+       * @param path The path of the image.
+       * @param width The width of the image (in pixels).
+       * @param height The height of the image (in pixels).
+       *
+       * @return The region of the atlas that holds the image.
+       */
+      const Region& reserve(const std::string& path, int width, int height);
+
+      /**
+       * Copies an image into a padded image, repeating its edge pixels out into the border around it.
+       * This doesn't touch the atlas, so it can be called from any thread.
+       *
+       * @param pixels The image's pixels, as 32-bit RGBA, row by row.
+       * @param pitch The number of bytes in each row of pixels.
+       * @param width The width of the image (in pixels).
+       * @param height The height of the image (in pixels).
+       * @param paddedPixels The parameter used to return the padded image's pixels.
+       */
+      static void padImage(const unsigned char* pixels, int pitch, int width, int height, std::vector<unsigned char>& paddedPixels);
+
+      /**
+       * Uploads the pixels of an image into the space reserved for it.
+       *
+       * @param path The path of the image, which must already have space in the atlas.
+       * @param paddedPixels The padded image's pixels, as made by padImage.
+       */
+      void upload(const std::string& path, const std::vector<unsigned char>& paddedPixels);
+
+      /**
+       * Gives an image that was loaded into a texture of its own (such as a compressed image)
+       * a page to itself, unless an image with the same path is already in the atlas.
+       * The atlas takes ownership of the texture.
+       *
+       * @param path The path of the image.
+       * @param texture The texture holding the image, and nothing else.
+       * @param width The width of the image (in pixels).
+       * @param height The height of the image (in pixels).
+       *
+       * @return The region of the atlas that holds the image.
+       */
+      const Region& addTexture(const std::string& path, GLuint texture, int width, int height);
+
+      /**
+       * Places an image in the atlas, unless an image with the same path is already in it.
+       *
+       * @param path The path of the image.
+       * @param pixels The image's pixels, as 32-bit RGBA, row by row.
+       * @param pitch The number of bytes in each row of pixels.
+       * @param width The width of the image (in pixels).
+       * @param height The height of the image (in pixels).
+       *
+       * @return The region of the atlas that holds the image.
+       */
+      const Region& add(const std::string& path, const unsigned char* pixels, int pitch, int width, int height);
+
+      /**
+       * Forgets the space given to an image, so that the image is placed afresh the next time it is added.
+       * The space itself isn't reused, so regions that point into it can still be drawn.
+       *
+       * @param path The path of the image.
+       */
+      void forget(const std::string& path);
+
+      /**
+       * Destructor. Releases the page textures and the pixel buffer.
+       */
+      ~TextureAtlas();
+};
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "TextureLoader.h"
+#include "GraphicsUtil.h"
+#include "PixelConverter.h"
+#include <SDL.h>
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include "AssetStream.h"
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS | DEBUG_RES_LOAD;
+
+// Decoding a spritesheet takes a few milliseconds, and new NPCs tend to arrive a few at a time,
+// so a couple of decoders is enough to have their images ready within a frame or two.
+const int TextureLoader::DECODER_COUNT = 2;
+
+TextureLoader::TextureLoader(TextureAtlas& atlas) : atlas(atlas), stopping(false)
+{
+   lock = SDL_CreateMutex();
+   jobAvailable = SDL_CreateCond();
+}
+
+int TextureLoader::runDecoder(void* data)
+{
+   static_cast<TextureLoader*>(data)->decoderLoop();
+   return 0;
+}
+
+void TextureLoader::decoderLoop()
+{
+   std::vector<unsigned char> stagingPixels;
+
+   SDL_mutexP(lock);
+   for(;;)
+   {
+      while(!stopping && jobQueue.empty())
+      {
+         SDL_CondWait(jobAvailable, lock);
+      }
+
+      if(stopping)
+      {
+         break;
+      }
+
+      Job* job = jobQueue.front();
+      jobQueue.pop_front();
+      SDL_mutexV(lock);
+
+      decode(*job, stagingPixels);
+
+      SDL_mutexP(lock);
+      decodedJobs.push_back(job);
+   }
+   SDL_mutexV(lock);
+}
+
+void TextureLoader::decode(Job& job, std::vector<unsigned char>& stagingPixels)
+{
+   SDL_Surface* image = NULL;
+   try
+   {
+      image = GraphicsUtil::loadImage(job.path.c_str());
+      job.failed = image->w != job.width || image->h != job.height;
+      if(!job.failed)
+      {
+         int pitch;
+         const unsigned char* pixels = PixelConverter::toRGBA(image, stagingPixels, pitch);
+         TextureAtlas::padImage(pixels, pitch, job.width, job.height, job.paddedPixels);
+      }
+
+      SDL_FreeSurface(image);
+   }
+   catch(Exception& e)
+   {
+      DEBUG("Failed to decode image %s.\n\tReason: %s", job.path.c_str(), e.getMessage().c_str());
+      SDL_FreeSurface(image);
+      job.failed = true;
+   }
+}
+
+bool TextureLoader::readImageSize(const std::string& path, int& w, int& h)
+{
+   // A PNG file starts with an 8-byte signature, followed by the IHDR chunk's length and type,
+   // and then the image's width and height as big-endian 32-bit numbers
+   static const unsigned char PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+   unsigned char header[24];
+
+   AssetStream input(path, std::ios::in | std::ios::binary);
+   if(!input.read(reinterpret_cast<char*>(header), sizeof(header))
+         || memcmp(header, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) != 0
+         || memcmp(header + 12, "IHDR", 4) != 0)
+   {
+      return false;
+   }
+
+   w = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+   h = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+   return w > 0 && h > 0;
+}
+
+void TextureLoader::start()
+{
+   stop();
+
+   stopping = false;
+   for(int i = 0; i < DECODER_COUNT; ++i)
+   {
+      SDL_Thread* decoder = SDL_CreateThread(runDecoder, this);
+      if(decoder == NULL)
+      {
+         DEBUG("Failed to start image decoder thread: %s", SDL_GetError());
+         break;
+      }
+
+      decoders.push_back(decoder);
+   }
+
+   DEBUG("Started %d image decoder threads", static_cast<int>(decoders.size()));
+}
+
+void TextureLoader::stop()
+{
+   SDL_mutexP(lock);
+   stopping = true;
+   SDL_CondBroadcast(jobAvailable);
+   SDL_mutexV(lock);
+
+   for(std::vector<SDL_Thread*>::iterator iter = decoders.begin(); iter != decoders.end(); ++iter)
+   {
+      SDL_WaitThread(*iter, NULL);
+   }
+
+   decoders.clear();
+
+   for(std::list<Job*>::iterator iter = jobQueue.begin(); iter != jobQueue.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   for(std::list<Job*>::iterator iter = decodedJobs.begin(); iter != decodedJobs.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   jobQueue.clear();
+   decodedJobs.clear();
+}
+
+const TextureAtlas::Region* TextureLoader::load(const char* path, int& w, int& h)
+{
+   if(!readImageSize(path, w, h))
+   {
+      return NULL;
+   }
+
+   const TextureAtlas::Region* existingRegion = atlas.find(path);
+   if(existingRegion != NULL)
+   {
+      return existingRegion;
+   }
+
+   const TextureAtlas::Region& region = atlas.reserve(path, w, h);
+
+   Job* job = new Job();
+   job->path = path;
+   job->width = w;
+   job->height = h;
+   job->failed = false;
+
+   if(decoders.empty())
+   {
+      // Without any decoders, nothing else touches the queues, so the image can be uploaded right away
+      std::vector<unsigned char> stagingPixels;
+      decode(*job, stagingPixels);
+      decodedJobs.push_back(job);
+      uploadDecodedImages();
+      return &region;
+   }
+
+   DEBUG("Queueing image %s (%dx%d) to be decoded.", path, w, h);
+   SDL_mutexP(lock);
+   jobQueue.push_back(job);
+   SDL_CondSignal(jobAvailable);
+   SDL_mutexV(lock);
+
+   return &region;
+}
+
+void TextureLoader::uploadDecodedImages()
+{
+   std::list<Job*> jobs;
+   SDL_mutexP(lock);
+   jobs.swap(decodedJobs);
+   SDL_mutexV(lock);
+
+   for(std::list<Job*>::iterator iter = jobs.begin(); iter != jobs.end(); ++iter)
+   {
+      // An image that was forgotten by the atlas while it was decoding (because its file changed) is dropped
+      if(!(*iter)->failed && atlas.find((*iter)->path) != NULL)
+      {
+         DEBUG("Uploading decoded image %s.", (*iter)->path.c_str());
+         atlas.upload((*iter)->path, (*iter)->paddedPixels);
+      }
+
+      delete *iter;
+   }
+}
+
+TextureLoader::~TextureLoader()
+{
+   stop();
+   SDL_DestroyCond(jobAvailable);
+   SDL_DestroyMutex(lock);
+}
@@ -0,0 +1,158 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include "TextureAtlas.h"
+#include <list>
+#include <string>
+#include <vector>
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+/**
+ * The TextureLoader decodes images on a pool of background threads, so that the first use of a
+ * spritesheet doesn't stall the frame it happens in.
+ * When an image is requested, its size is read from the image file's header and space is reserved
+ * for it in the texture atlas right away; the space stays transparent until the decoded pixels
+ * are uploaded, which the main thread does once per frame.
+ *
+ * Images that aren't PNGs can't be sized without decoding them, so they are left for the caller
+ * to load itself. If no decoder threads can be started, images are decoded on the calling thread.
+ */
+class TextureLoader
+{
+   /** An image to decode, along with its decoded pixels. */
+   struct Job
+   {
+      /** The path of the image. */
+      std::string path;
+
+      /** The width of the image read from its header (in pixels). */
+      int width;
+
+      /** The height of the image read from its header (in pixels). */
+      int height;
+
+      /** The padded pixels of the image, once it has been decoded. */
+      std::vector<unsigned char> paddedPixels;
+
+      /** Whether or not the image failed to decode. */
+      bool failed;
+   };
+
+   /** The number of decoder threads to start. */
+   static const int DECODER_COUNT;
+
+   /** The atlas that the images are uploaded into. */
+   TextureAtlas& atlas;
+
+   /** The running decoder threads. */
+   std::vector<SDL_Thread*> decoders;
+
+   /** Guards the job queues and the stopping flag. */
+   SDL_mutex* lock;
+
+   /** Signalled when jobs are added to the queue, or when the decoders must stop. */
+   SDL_cond* jobAvailable;
+
+   /** Whether or not the decoders have been asked to stop. */
+   bool stopping;
+
+   /** The images waiting to be decoded, in the order they were requested. */
+   std::list<Job*> jobQueue;
+
+   /** The images that have been decoded, but haven't been uploaded yet. */
+   std::list<Job*> decodedJobs;
+
+   /**
+    * The entry point for decoder threads.
+    *
+    * @param data The loader that the thread belongs to.
+    *
+    * @return The exit code of the thread.
+    */
+   static int runDecoder(void* data);
+
+   /**
+    * Decodes images from the queue until the loader is stopped.
+    */
+   void decoderLoop();
+
+   /**
+    * Decodes an image and pads it for the atlas.
+    * If the image can't be decoded, or its size doesn't match its header, the job is marked as failed.
+    *
+    * @param job The job holding the image to decode.
+    * @param stagingPixels The decoding thread's buffer for converting images to RGBA, kept between images.
+    */
+   static void decode(Job& job, std::vector<unsigned char>& stagingPixels);
+
+   /**
+    * Reads the size of a PNG image from its header, without decoding it.
+    *
+    * @param path The file path to the image.
+    * @param w The parameter used to return image width.
+    * @param h The parameter used to return image height.
+    *
+    * @return true iff the file is a PNG image and its size was read.
+    */
+   static bool readImageSize(const std::string& path, int& w, int& h);
+
+   /** Loaders can't be copied. */
+   TextureLoader(const TextureLoader&);
+
+   /** Loaders can't be copied. */
+   TextureLoader& operator=(const TextureLoader&);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param atlas The atlas that the images are uploaded into.
+       */
+      TextureLoader(TextureAtlas& atlas);
+
+      /**
+       * Starts the decoder threads.
+       */
+      void start();
+
+      /**
+       * Stops the decoder threads, waiting for them to finish their current images,
+       * and discards every image that hasn't been uploaded yet.
+       */
+      void stop();
+
+      /**
+       * Reserves space in the atlas for an image, and queues the image to be decoded in the background.
+       * If the image is already in the atlas, its existing region is returned.
+       *
+       * @param path The file path to the image.
+       * @param w The parameter used to return image width.
+       * @param h The parameter used to return image height.
+       *
+       * @return The region of the atlas that holds (or will hold) the image,
+       *         or NULL if the image's size can't be read from its header.
+       */
+      const TextureAtlas::Region* load(const char* path, int& w, int& h);
+
+      /**
+       * Uploads every image decoded since the last call into the atlas.
+       * This must be called from the thread that owns the OpenGL context.
+       */
+      void uploadDecodedImages();
+
+      /**
+       * Destructor.
+       */
+      ~TextureLoader();
+};
+
+#endif
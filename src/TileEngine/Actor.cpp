@@ -1,36 +1,63 @@
 #include "Actor.h"
+#include "ActorTable.h"
 #include "ResourceLoader.h"
 #include "EntityGrid.h"
 #include "Sprite.h"
 #include "TileEngine.h"
 #include "Actor_Orders.h"
+#include "LightMap.h"
+#include <cmath>
+
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_NPC;
 
 Actor::Actor(const std::string& name, const std::string& sheetName, EntityGrid& entityGrid, int x, int y, double movementSpeed, MovementDirection direction)
-   : name(name), width(32), height(32), pixelLoc(x, y), movementSpeed(movementSpeed), currDirection(direction), entityGrid(entityGrid)
+   : name(name), table(entityGrid.getActorTable()), width(32), height(32), lightRadius(0), lightRed(1.0f), lightGreen(1.0f), lightBlue(1.0f), entityGrid(entityGrid)
 {
+   id = table.add(this, shapes::Point2D(x, y), static_cast<float>(movementSpeed), direction);
+
    Spritesheet* sheet = ResourceLoader::getSpritesheet(sheetName);
    sprite = new Sprite(sheet);
 }
 
 Actor::~Actor()
 {
-   flushOrders();
    delete sprite;
+   if(id != ActorTable::INVALID_ACTOR)
+   {
+      flushOrders();
+      table.remove(id);
+   }
 }
 
 void Actor::flushOrders()
 {
-   while(!orders.empty())
+   while(!isIdle())
    {
-      Order* order = orders.front();
-      orders.pop();
-      delete order;
+      delete table.popOrder(id);
    }
 }
 
+void Actor::wake()
+{
+   table.wake(id);
+}
+
+void Actor::leaveTable()
+{
+   flushOrders();
+   table.remove(id);
+   id = ActorTable::INVALID_ACTOR;
+}
+
+void Actor::rejoinTable(int x, int y, double movementSpeed, MovementDirection direction)
+{
+   id = table.add(this, shapes::Point2D(x, y), static_cast<float>(movementSpeed), direction);
+   lightRadius = 0;
+   sprite->setTint(1.0f, 1.0f, 1.0f);
+}
+
 std::string Actor::getName() const
 {
    return name;
@@ -48,35 +75,69 @@ int Actor::getHeight() const
 
 void Actor::step(long timePassed)
 {
+   table.beginStep(id);
    sprite->step(timePassed);
    
-   if(!isIdle())
+   Order* currentOrder = table.getCurrentOrder(id);
+   if(currentOrder != NULL && currentOrder->perform(timePassed))
    {
-      Order* currentOrder = orders.front();
-      if(currentOrder->perform(timePassed))
-      {
-         orders.pop();
-         delete currentOrder;
-      }
+      delete table.popOrder(id);
+   }
+}
+
+void Actor::proposeMovement()
+{
+   Order* currentOrder = table.getCurrentOrder(id);
+   if(currentOrder != NULL)
+   {
+      currentOrder->proposeMovement();
    }
 }
 
-void Actor::draw()
+shapes::Point2D Actor::getDrawLocation(float interpolation) const
+{
+   const shapes::Point2D& pixelLoc = table.getLocation(id);
+   const shapes::Point2D& prevPixelLoc = table.getPreviousLocation(id);
+   const int xDistance = pixelLoc.x - prevPixelLoc.x;
+   const int yDistance = pixelLoc.y - prevPixelLoc.y;
+
+   // An actor that moved more than a tile in one step was placed there rather than walking, so it isn't drawn in between
+   if(abs(xDistance) > TileEngine::TILE_SIZE || abs(yDistance) > TileEngine::TILE_SIZE)
+   {
+      return pixelLoc;
+   }
+
+   return shapes::Point2D(prevPixelLoc.x + static_cast<int>(floor(xDistance * interpolation + 0.5f)),
+                          prevPixelLoc.y + static_cast<int>(floor(yDistance * interpolation + 0.5f)));
+}
+
+void Actor::draw(float interpolation)
 {
    if(sprite)
    {
-      sprite->draw(pixelLoc.x, pixelLoc.y + TileEngine::TILE_SIZE);
+      const shapes::Point2D drawLocation = getDrawLocation(interpolation);
+      sprite->draw(drawLocation.x, drawLocation.y + TileEngine::TILE_SIZE);
    }
    
-   if(!orders.empty())
+   Order* currentOrder = table.getCurrentOrder(id);
+   if(currentOrder != NULL)
    {
-      orders.front()->draw();
+      currentOrder->draw();
+   }
+}
+
+void Actor::drawLight(LightMap& lightMap, float interpolation) const
+{
+   if(lightRadius > 0)
+   {
+      const shapes::Point2D drawLocation = getDrawLocation(interpolation);
+      lightMap.addFrameLight(drawLocation.x + width / 2, drawLocation.y + height / 2, lightRadius, lightRed, lightGreen, lightBlue);
    }
 }
 
 bool Actor::isIdle() const
 {
-   return orders.empty();
+   return table.getCurrentOrder(id) == NULL;
 }
 
 void Actor::move(int x, int y)
@@ -85,7 +146,21 @@ void Actor::move(int x, int y)
    {
       DEBUG("Sending move order to %s: %d,%d", name.c_str(), x, y);
       shapes::Point2D dst(x, y);
-      orders.push(new MoveOrder(*this, dst, entityGrid));
+      table.pushOrder(id, new MoveOrder(*this, dst, entityGrid));
+   }
+   else
+   {
+      DEBUG("%d,%d is not a place!!!", x, y);
+   }
+}
+
+void Actor::follow(int x, int y)
+{
+   if(entityGrid.withinMap(x,y))
+   {
+      DEBUG("Sending follow order to %s: %d,%d", name.c_str(), x, y);
+      shapes::Point2D goal(x, y);
+      table.pushOrder(id, new FollowOrder(*this, goal, entityGrid));
    }
    else
    {
@@ -95,7 +170,7 @@ void Actor::move(int x, int y)
 
 void Actor::stand(MovementDirection direction)
 {
-   orders.push(new StandOrder(*this, direction));
+   table.pushOrder(id, new StandOrder(*this, direction));
 }
 
 void Actor::faceActor(Actor* other)
@@ -139,42 +214,70 @@ void Actor::setSpritesheet(const std::string& sheetName)
    sprite->setSheet(sheet);
 }
 
+void Actor::setTint(float r, float g, float b)
+{
+   sprite->setTint(r, g, b);
+}
+
+void Actor::setLight(int radius, float r, float g, float b)
+{
+   lightRadius = radius;
+   lightRed = r;
+   lightGreen = g;
+   lightBlue = b;
+}
+
 void Actor::setFrame(const std::string& frameName)
 {
-   sprite->setFrame(frameName, currDirection);
+   sprite->setFrame(frameName, table.getDirection(id));
 }
 
 void Actor::setAnimation(const std::string& animationName)
 {
-   sprite->setAnimation(animationName, currDirection);
+   sprite->setAnimation(animationName, table.getDirection(id));
 }
 
 void Actor::setLocation(shapes::Point2D location)
 {
-   pixelLoc = location;
+   table.setLocation(id, location);
 }
 
 shapes::Point2D Actor::getLocation() const
 {
-   return pixelLoc;
+   return table.getLocation(id);
 }
 
 void Actor::setDirection(MovementDirection direction)
 {
-   currDirection = direction;
+   table.setDirection(id, direction);
 }
 
 MovementDirection Actor::getDirection() const
 {
-   return currDirection;
+   return table.getDirection(id);
 }
 
 void Actor::setMovementSpeed(float speed)
 {
-   movementSpeed = speed;
+   table.setMovementSpeed(id, speed);
 }
 
 float Actor::getMovementSpeed() const
 {
-   return movementSpeed;
+   return table.getMovementSpeed(id);
+}
+
+long Actor::getStepDistance() const
+{
+   return table.getStepDistance(id);
+}
+
+void Actor::saveStepDistance(long distance)
+{
+   table.saveStepDistance(id, distance);
+}
+
+bool Actor::isSimulatedCoarsely() const
+{
+   return table.isCoarse(id);
 }
\ No newline at end of file
@@ -1,45 +1,49 @@
 #ifndef ACTOR_H
 #define ACTOR_H
 
-#include <queue>
 #include <string>
 
 #include "MovementDirection.h"
 #include "Point2D.h"
 
+class ActorTable;
 class EntityGrid;
+class LightMap;
 class Sprite;
 class Spritesheet;
 
 class Actor
 {
+   friend class ActorTable;
+
    /**
     * A class for asynchronous Actor instructions.
     */
    class Order;
    class MoveOrder;
+   class FollowOrder;
    class StandOrder;
 
    /** The Actor's name */
    const std::string name;
-   
-   /** A queue of orders for the actor to perform */
-   std::queue<Order*> orders;
+
+   /** The table holding the actor's location, direction, movement speed and orders, along with those of the other actors on its grid */
+   ActorTable& table;
+
+   /** The actor's ID in the table, which the table changes when it moves the actor to fill a gap (or -1 while the actor is out of the table) */
+   int id;
 
    /** The width of the actor (in pixels) */
    int width;
    
    /** The height of the actor (in pixels) */
    int height;
-   
-   /** The current location of the actor (in pixels) */
-   shapes::Point2D pixelLoc;
-   
-   /** The movement speed of the actor */
-   float movementSpeed;
-   
-   /** The direction that the actor is currently facing */
-   MovementDirection currDirection;
+
+   /** The distance that the light carried by the actor reaches (in pixels), or 0 if it doesn't carry one */
+   int lightRadius;
+
+   /** The colour of the light carried by the actor */
+   float lightRed, lightGreen, lightBlue;
    
    protected:
       /** The Actor's associated sprite, which is drawn on screen. */
@@ -74,12 +78,43 @@ class Actor
        */
       void flushOrders();
 
+      /**
+       * Wakes the actor up if it has been parked (see ActorTable), so that it is stepped again.
+       */
+      void wake();
+
+      /**
+       * Takes the actor out of the actor table, after flushing its orders, so that it can be kept aside for reuse.
+       * The actor must already have been taken off the grid. Until it rejoins the table,
+       * the actor has no location or orders, so it can't be stepped, drawn or ordered around.
+       */
+      void leaveTable();
+
+      /**
+       * Adds the actor back into the actor table after leaveTable, starting over as though it had just been created.
+       *
+       * @param x The x-location (in pixels) where the actor starts off.
+       * @param y The y-location (in pixels) where the actor starts off.
+       * @param movementSpeed The speed of the actor's movement.
+       * @param direction The starting direction of the actor.
+       */
+      void rejoinTable(int x, int y, double movementSpeed, MovementDirection direction);
+
 public:
       /**
        * @return The name of this Actor.
        */
       std::string getName() const;
 
+      /**
+       * Finds where to draw the actor between its location before and after its last logic step.
+       *
+       * @param interpolation How far (from 0 to 1) the frame falls between the last logic step and the next one.
+       *
+       * @return The location to draw the actor at (in pixels).
+       */
+      shapes::Point2D getDrawLocation(float interpolation) const;
+
       /**
        * @return The height of this Actor (in pixels).
        */
@@ -97,12 +132,30 @@ public:
        * @param timePassed The amount of time that has passed since the last frame.
        */
       virtual void step(long timePassed);
+
+      /**
+       * Proposes the actor's next move to the EntityGrid, if the current order is about to start one.
+       * This must be called for every actor, followed by EntityGrid::resolveMovements,
+       * before any of the actors are stepped.
+       */
+      virtual void proposeMovement();
       
       /**
        * This function draws the actor in its current location with its current
        * sprite animation frame.
+       *
+       * @param interpolation How far (from 0 to 1) the frame falls between the last logic step and the next one.
        */
-      virtual void draw();
+      virtual void draw(float interpolation);
+
+      /**
+       * Adds the light carried by the actor (if it carries one) to the lights drawn in the next frame,
+       * centered on where the actor is drawn.
+       *
+       * @param lightMap The light map lighting the actor's map.
+       * @param interpolation How far (from 0 to 1) the frame falls between the last logic step and the next one.
+       */
+      void drawLight(LightMap& lightMap, float interpolation) const;
 
       /**
        * @return true iff the NPC is not chewing on any instructions
@@ -131,6 +184,16 @@ public:
        * @param y The y coordinate (in pixels) for the actor to move to
        */
       void move(int x, int y);
+
+      /**
+       * This function enqueues an instruction to follow the shared flow field towards a goal.
+       * Unlike a movement instruction, the actor doesn't plan its own path, so any number
+       * of actors can head for the same goal for the cost of a single search.
+       *
+       * @param x The x coordinate (in pixels) of the goal
+       * @param y The y coordinate (in pixels) of the goal
+       */
+      void follow(int x, int y);
       
       /**
        * This function changes the actor's spritesheet.
@@ -138,6 +201,28 @@ public:
        * @param sheetName The name of the spritesheet to get.
        */
       void setSpritesheet(const std::string& sheetName);
+
+      /**
+       * This function changes the colour that the actor's sprite is tinted with,
+       * so that actors can share a spritesheet while looking different.
+       * A tint of white (1, 1, 1) draws the sprite in its own colours.
+       *
+       * @param r The red element of the tint (0 to 1).
+       * @param g The green element of the tint (0 to 1).
+       * @param b The blue element of the tint (0 to 1).
+       */
+      void setTint(float r, float g, float b);
+
+      /**
+       * This function gives the actor a light to carry around with it (such as a lantern),
+       * which lights the map around the actor when the map is dark.
+       *
+       * @param radius The distance that the light reaches (in pixels), or 0 to take the light away.
+       * @param r The red element of the light's colour (0 to 1).
+       * @param g The green element of the light's colour (0 to 1).
+       * @param b The blue element of the light's colour (0 to 1).
+       */
+      void setLight(int radius, float r, float g, float b);
       
       /**
        * This function changes the actor's frame.
@@ -192,6 +277,24 @@ public:
        * @return The current movement speed of the actor.
        */
       float getMovementSpeed() const;
+
+      /**
+       * @return The distance (in pixels) that the actor can cover during the current logic step at its movement speed.
+       */
+      long getStepDistance() const;
+
+      /**
+       * Carries distance that the actor couldn't use during this step into the next one.
+       *
+       * @param distance The unused distance (in pixels).
+       */
+      void saveStepDistance(long distance);
+
+      /**
+       * @return true iff the actor is far enough from the screen that its orders can
+       *         skip ahead instead of moving it a pixel at a time.
+       */
+      bool isSimulatedCoarsely() const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,208 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ActorIndex.h"
+#include "Actor.h"
+#include "Point2D.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_ENTITY_GRID;
+
+// A cell fits a few actors side by side, so most queries only touch a handful of cells
+const int ActorIndex::CELL_SIZE = 64;
+
+ActorIndex::ActorIndex() : cellsWide(0), cellsHigh(0)
+{
+}
+
+void ActorIndex::resize(int pixelWidth, int pixelHeight)
+{
+   cellsWide = std::max(1, (pixelWidth + CELL_SIZE - 1) / CELL_SIZE);
+   cellsHigh = std::max(1, (pixelHeight + CELL_SIZE - 1) / CELL_SIZE);
+
+   cells.clear();
+   cells.resize(cellsWide * cellsHigh);
+   actorAreas.clear();
+}
+
+shapes::Rectangle ActorIndex::getCellRange(const shapes::Rectangle& area) const
+{
+   return shapes::Rectangle(std::max(0, area.top / CELL_SIZE),
+                            std::max(0, area.left / CELL_SIZE),
+                            std::min(cellsHigh - 1, area.bottom / CELL_SIZE),
+                            std::min(cellsWide - 1, area.right / CELL_SIZE));
+}
+
+void ActorIndex::addToCells(Actor* actor, const shapes::Rectangle& area)
+{
+   const shapes::Rectangle cellRange = getCellRange(area);
+   for(int cellY = cellRange.top; cellY <= cellRange.bottom; ++cellY)
+   {
+      for(int cellX = cellRange.left; cellX <= cellRange.right; ++cellX)
+      {
+         cells[cellY * cellsWide + cellX].push_back(Entry(actor, area));
+      }
+   }
+}
+
+void ActorIndex::removeFromCells(Actor* actor, const shapes::Rectangle& area)
+{
+   const shapes::Rectangle cellRange = getCellRange(area);
+   for(int cellY = cellRange.top; cellY <= cellRange.bottom; ++cellY)
+   {
+      for(int cellX = cellRange.left; cellX <= cellRange.right; ++cellX)
+      {
+         // Cells only hold a few actors, and their order doesn't matter
+         std::vector<Entry>& cell = cells[cellY * cellsWide + cellX];
+         for(std::vector<Entry>::iterator iter = cell.begin(); iter != cell.end(); ++iter)
+         {
+            if(iter->actor == actor)
+            {
+               *iter = cell.back();
+               cell.pop_back();
+               break;
+            }
+         }
+      }
+   }
+}
+
+void ActorIndex::update(Actor* actor, const shapes::Point2D& location)
+{
+   if(cells.empty()) return;
+
+   const shapes::Rectangle area(location.y, location.x, location.y + actor->getHeight() - 1, location.x + actor->getWidth() - 1);
+
+   std::map<Actor*, shapes::Rectangle>::iterator actorArea = actorAreas.find(actor);
+   if(actorArea != actorAreas.end())
+   {
+      removeFromCells(actor, actorArea->second);
+      actorArea->second = area;
+   }
+   else
+   {
+      actorAreas.insert(std::make_pair(actor, area));
+   }
+
+   addToCells(actor, area);
+}
+
+void ActorIndex::remove(Actor* actor)
+{
+   std::map<Actor*, shapes::Rectangle>::iterator actorArea = actorAreas.find(actor);
+   if(actorArea == actorAreas.end()) return;
+
+   removeFromCells(actor, actorArea->second);
+   actorAreas.erase(actorArea);
+}
+
+bool ActorIndex::getArea(Actor* actor, shapes::Rectangle& area) const
+{
+   std::map<Actor*, shapes::Rectangle>::const_iterator actorArea = actorAreas.find(actor);
+   if(actorArea == actorAreas.end()) return false;
+
+   area = actorArea->second;
+   return true;
+}
+
+void ActorIndex::findActorsInArea(const shapes::Rectangle& area, std::vector<Actor*>& actors) const
+{
+   if(cells.empty()) return;
+
+   const shapes::Rectangle cellRange = getCellRange(area);
+   for(int cellY = cellRange.top; cellY <= cellRange.bottom; ++cellY)
+   {
+      for(int cellX = cellRange.left; cellX <= cellRange.right; ++cellX)
+      {
+         const std::vector<Entry>& cell = cells[cellY * cellsWide + cellX];
+         for(std::vector<Entry>::const_iterator iter = cell.begin(); iter != cell.end(); ++iter)
+         {
+            if(!iter->area.intersects(area)) continue;
+
+            // An actor filed under several cells is only reported from the first of them that the search visits
+            const shapes::Rectangle actorCells = getCellRange(iter->area);
+            if(cellX == std::max(actorCells.left, cellRange.left) && cellY == std::max(actorCells.top, cellRange.top))
+            {
+               actors.push_back(iter->actor);
+            }
+         }
+      }
+   }
+}
+
+long ActorIndex::getSquaredDistance(const shapes::Point2D& point, const shapes::Rectangle& area)
+{
+   const long xDistance = point.x < area.left ? area.left - point.x : (point.x > area.right ? point.x - area.right : 0);
+   const long yDistance = point.y < area.top ? area.top - point.y : (point.y > area.bottom ? point.y - area.bottom : 0);
+   return xDistance * xDistance + yDistance * yDistance;
+}
+
+void ActorIndex::findActorsInRadius(const shapes::Point2D& center, int radius, std::vector<Actor*>& actors) const
+{
+   std::vector<Actor*> candidates;
+   findActorsInArea(shapes::Rectangle(center.y - radius, center.x - radius, center.y + radius, center.x + radius), candidates);
+
+   const long squaredRadius = long(radius) * radius;
+   for(std::vector<Actor*>::const_iterator iter = candidates.begin(); iter != candidates.end(); ++iter)
+   {
+      if(getSquaredDistance(center, actorAreas.find(*iter)->second) <= squaredRadius)
+      {
+         actors.push_back(*iter);
+      }
+   }
+}
+
+Actor* ActorIndex::findNearestActor(const shapes::Point2D& point, int maxRadius, const Actor* excludedActor) const
+{
+   if(cells.empty()) return NULL;
+
+   const int centerCellX = std::min(std::max(point.x / CELL_SIZE, 0), cellsWide - 1);
+   const int centerCellY = std::min(std::max(point.y / CELL_SIZE, 0), cellsHigh - 1);
+   const long squaredRadius = long(maxRadius) * maxRadius;
+
+   Actor* nearestActor = NULL;
+   long nearestDistance = squaredRadius;
+
+   const int maxRing = std::max(cellsWide, cellsHigh);
+   for(int ring = 0; ring <= maxRing; ++ring)
+   {
+      for(int cellY = centerCellY - ring; cellY <= centerCellY + ring; ++cellY)
+      {
+         if(cellY < 0 || cellY >= cellsHigh) continue;
+
+         // Only the cells on the border of the ring are new; the cells inside it were searched by earlier rings
+         const bool borderRow = cellY == centerCellY - ring || cellY == centerCellY + ring;
+         const int cellXStep = borderRow ? 1 : std::max(1, 2 * ring);
+         for(int cellX = centerCellX - ring; cellX <= centerCellX + ring; cellX += cellXStep)
+         {
+            if(cellX < 0 || cellX >= cellsWide) continue;
+
+            const std::vector<Entry>& cell = cells[cellY * cellsWide + cellX];
+            for(std::vector<Entry>::const_iterator iter = cell.begin(); iter != cell.end(); ++iter)
+            {
+               if(iter->actor == excludedActor) continue;
+
+               const long distance = getSquaredDistance(point, iter->area);
+               if(distance <= nearestDistance)
+               {
+                  nearestActor = iter->actor;
+                  nearestDistance = distance;
+               }
+            }
+         }
+      }
+
+      // Anything in the next ring out is at least this far from the point
+      const long ringDistance = long(ring) * CELL_SIZE;
+      if(ringDistance * ringDistance > nearestDistance)
+      {
+         break;
+      }
+   }
+
+   return nearestActor;
+}
@@ -0,0 +1,146 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ACTOR_INDEX_H
+#define ACTOR_INDEX_H
+
+#include <map>
+#include <vector>
+#include "Rectangle.h"
+
+class Actor;
+
+namespace shapes
+{
+   struct Point2D;
+};
+
+/**
+ * The ActorIndex buckets the actors on a map into a uniform grid of cells, so that
+ * queries for the actors near a point or within an area only look at the cells they cover,
+ * instead of every actor on the map. An actor is filed under every cell that its area overlaps.
+ *
+ * The index tracks the locations that it is given, which are the locations reserved
+ * for the actors in the entity grid rather than the points they are drawn at mid-step.
+ */
+class ActorIndex
+{
+   /** The width and height (in pixels) of each cell. */
+   static const int CELL_SIZE;
+
+   /** An actor filed in a cell, along with the area it was filed with. */
+   struct Entry
+   {
+      /** The indexed actor. */
+      Actor* actor;
+
+      /** The area covered by the actor (with inclusive edge coordinates in pixels). */
+      shapes::Rectangle area;
+
+      Entry(Actor* actor, const shapes::Rectangle& area) : actor(actor), area(area) {}
+   };
+
+   /** The number of cells across the width of the map. */
+   int cellsWide;
+
+   /** The number of cells down the height of the map. */
+   int cellsHigh;
+
+   /** The actors filed in each cell, stored row by row. */
+   std::vector<std::vector<Entry> > cells;
+
+   /** The area that each indexed actor was filed with. */
+   std::map<Actor*, shapes::Rectangle> actorAreas;
+
+   /**
+    * @param area An area of the map (with inclusive edge coordinates in pixels).
+    *
+    * @return The cells covered by the area, clamped to the map (with inclusive edge coordinates in cells).
+    */
+   shapes::Rectangle getCellRange(const shapes::Rectangle& area) const;
+
+   /**
+    * Files an actor under every cell covered by the given area.
+    */
+   void addToCells(Actor* actor, const shapes::Rectangle& area);
+
+   /**
+    * Removes an actor from every cell covered by the given area.
+    */
+   void removeFromCells(Actor* actor, const shapes::Rectangle& area);
+
+   /**
+    * @return The squared distance (in pixels) from a point to the closest point in an area.
+    */
+   static long getSquaredDistance(const shapes::Point2D& point, const shapes::Rectangle& area);
+
+   public:
+      /**
+       * Constructor.
+       */
+      ActorIndex();
+
+      /**
+       * Removes every actor and resizes the index to cover a map.
+       *
+       * @param pixelWidth The width of the map (in pixels).
+       * @param pixelHeight The height of the map (in pixels).
+       */
+      void resize(int pixelWidth, int pixelHeight);
+
+      /**
+       * Adds an actor to the index, or moves it if it is already indexed.
+       *
+       * @param actor The actor to index.
+       * @param location The location of the actor (in pixels).
+       */
+      void update(Actor* actor, const shapes::Point2D& location);
+
+      /**
+       * Removes an actor from the index.
+       *
+       * @param actor The actor to remove.
+       */
+      void remove(Actor* actor);
+
+      /**
+       * @param actor An actor.
+       * @param area The parameter used to return the area that the actor was filed with (with inclusive edge coordinates in pixels).
+       *
+       * @return true iff the actor is indexed.
+       */
+      bool getArea(Actor* actor, shapes::Rectangle& area) const;
+
+      /**
+       * Finds the actors overlapping an area.
+       *
+       * @param area The area to search (with inclusive edge coordinates in pixels).
+       * @param actors The actors found are added to the back of this list.
+       */
+      void findActorsInArea(const shapes::Rectangle& area, std::vector<Actor*>& actors) const;
+
+      /**
+       * Finds the actors with any part of their area within a given distance of a point.
+       *
+       * @param center The point to search around (in pixels).
+       * @param radius The distance to search within (in pixels).
+       * @param actors The actors found are added to the back of this list.
+       */
+      void findActorsInRadius(const shapes::Point2D& center, int radius, std::vector<Actor*>& actors) const;
+
+      /**
+       * Finds the actor closest to a point, searching outwards one ring of cells at a time.
+       *
+       * @param point The point to search around (in pixels).
+       * @param maxRadius The furthest distance to search (in pixels).
+       * @param excludedActor An actor to leave out of the search (such as the actor doing the search), or NULL.
+       *
+       * @return The closest actor within the radius, or NULL if there is none.
+       */
+      Actor* findNearestActor(const shapes::Point2D& point, int maxRadius, const Actor* excludedActor) const;
+};
+
+#endif
@@ -0,0 +1,439 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ActorTable.h"
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_NPC;
+
+// Enough for the actors on a busy map without spreading the names over a lot of empty buckets
+static const size_t INITIAL_NAME_BUCKET_COUNT = 64;
+
+// Enough for a short script of orders before the ring has to grow
+static const unsigned int INITIAL_ORDER_SLOTS = 4;
+
+// Enough slots for 65536 actors at once, leaving 65535 generations before a slot's handles repeat
+static const int HANDLE_SLOT_BITS = 16;
+static const ActorTable::ActorHandle HANDLE_SLOT_MASK = (1u << HANDLE_SLOT_BITS) - 1;
+static const unsigned int HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_SLOT_BITS)) - 1;
+
+// Fine enough that even a slow actor's speed is kept to within a fraction of a percent,
+// while a long step at a run still fits in a 32-bit long
+static const int SUBPIXEL_BITS = 16;
+static const long SUBPIXEL_MASK = (1L << SUBPIXEL_BITS) - 1;
+
+/**
+ * @param speed A movement speed (in pixels per millisecond).
+ *
+ * @return The speed in fixed point.
+ */
+static long toFixedPoint(float speed)
+{
+   return static_cast<long>(speed * (1L << SUBPIXEL_BITS) + 0.5f);
+}
+
+/**
+ * Hashes a name with FNV-1a, which spreads short, similar names (like "npc1" and "npc2") well.
+ *
+ * @param name The name to hash.
+ *
+ * @return The hash of the name.
+ */
+static unsigned int hashName(const std::string& name)
+{
+   unsigned int hash = 2166136261u;
+   for(std::string::const_iterator iter = name.begin(); iter != name.end(); ++iter)
+   {
+      hash = (hash ^ static_cast<unsigned char>(*iter)) * 16777619u;
+   }
+
+   return hash;
+}
+
+ActorTable::ActorTable() : nameBuckets(INITIAL_NAME_BUCKET_COUNT), nameCount(0)
+{
+}
+
+std::vector<ActorTable::NameEntry>& ActorTable::getNameBucket(const std::string& name)
+{
+   return nameBuckets[hashName(name) & (nameBuckets.size() - 1)];
+}
+
+const std::vector<ActorTable::NameEntry>& ActorTable::getNameBucket(const std::string& name) const
+{
+   return nameBuckets[hashName(name) & (nameBuckets.size() - 1)];
+}
+
+void ActorTable::growNameIndex()
+{
+   std::vector<std::vector<NameEntry> > oldBuckets(nameBuckets.size() * 2);
+   oldBuckets.swap(nameBuckets);
+
+   for(std::vector<std::vector<NameEntry> >::const_iterator bucket = oldBuckets.begin(); bucket != oldBuckets.end(); ++bucket)
+   {
+      for(std::vector<NameEntry>::const_iterator entry = bucket->begin(); entry != bucket->end(); ++entry)
+      {
+         getNameBucket(entry->name).push_back(*entry);
+      }
+   }
+}
+
+void ActorTable::addName(const std::string& name, ActorId id)
+{
+   std::vector<NameEntry>& bucket = getNameBucket(name);
+   for(std::vector<NameEntry>::iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->name == name)
+      {
+         entry->id = id;
+         return;
+      }
+   }
+
+   NameEntry entry;
+   entry.name = name;
+   entry.id = id;
+   bucket.push_back(entry);
+
+   ++nameCount;
+   if(nameCount > nameBuckets.size())
+   {
+      growNameIndex();
+   }
+}
+
+void ActorTable::renumberName(const std::string& name, ActorId oldId, ActorId newId)
+{
+   std::vector<NameEntry>& bucket = getNameBucket(name);
+   for(std::vector<NameEntry>::iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->name == name && entry->id == oldId)
+      {
+         if(newId == INVALID_ACTOR)
+         {
+            *entry = bucket.back();
+            bucket.pop_back();
+            --nameCount;
+         }
+         else
+         {
+            entry->id = newId;
+         }
+
+         return;
+      }
+   }
+}
+
+ActorTable::ActorHandle ActorTable::allocateHandle(ActorId id)
+{
+   unsigned int slot;
+   if(freeHandleSlots.empty())
+   {
+      slot = static_cast<unsigned int>(handleTargets.size());
+      if(slot > HANDLE_SLOT_MASK)
+      {
+         T_T("Too many actors in the actor table to give out a handle.");
+      }
+
+      handleTargets.push_back(INVALID_ACTOR);
+
+      // Generations start at 1, so that no handle is ever INVALID_HANDLE
+      handleGenerations.push_back(1);
+   }
+   else
+   {
+      slot = freeHandleSlots.back();
+      freeHandleSlots.pop_back();
+   }
+
+   handleTargets[slot] = id;
+   return (handleGenerations[slot] << HANDLE_SLOT_BITS) | slot;
+}
+
+void ActorTable::releaseHandle(ActorHandle handle)
+{
+   const unsigned int slot = handle & HANDLE_SLOT_MASK;
+   handleTargets[slot] = INVALID_ACTOR;
+
+   unsigned int& generation = handleGenerations[slot];
+   generation = (generation + 1) & HANDLE_GENERATION_MASK;
+   if(generation == 0)
+   {
+      generation = 1;
+   }
+
+   freeHandleSlots.push_back(slot);
+}
+
+ActorTable::ActorId ActorTable::add(Actor* actor, const shapes::Point2D& location, float movementSpeed, MovementDirection direction)
+{
+   const ActorId id = static_cast<ActorId>(actors.size());
+
+   actors.push_back(actor);
+   locations.push_back(location);
+   previousLocations.push_back(location);
+   directions.push_back(direction);
+   movementSpeeds.push_back(toFixedPoint(movementSpeed));
+   movementProgress.push_back(0);
+   stepDistances.push_back(0);
+   orderRings.push_back(OrderRing());
+   awakeSlots.push_back(-1);
+   coarseFlags.push_back(false);
+   handles.push_back(allocateHandle(id));
+
+   addName(actor->getName(), id);
+   wake(id);
+   return id;
+}
+
+void ActorTable::remove(ActorId id)
+{
+   if(orderRings[id].count > 0)
+   {
+      T_T("Actor removed from the actor table with orders still queued.");
+   }
+
+   renumberName(actors[id]->getName(), id, INVALID_ACTOR);
+   park(id);
+   releaseHandle(handles[id]);
+
+   const ActorId lastId = static_cast<ActorId>(actors.size()) - 1;
+   if(id != lastId)
+   {
+      actors[id] = actors[lastId];
+      locations[id] = locations[lastId];
+      previousLocations[id] = previousLocations[lastId];
+      directions[id] = directions[lastId];
+      movementSpeeds[id] = movementSpeeds[lastId];
+      movementProgress[id] = movementProgress[lastId];
+      stepDistances[id] = stepDistances[lastId];
+      orderRings[id].slots.swap(orderRings[lastId].slots);
+      orderRings[id].first = orderRings[lastId].first;
+      orderRings[id].count = orderRings[lastId].count;
+      coarseFlags[id] = coarseFlags[lastId];
+      awakeSlots[id] = awakeSlots[lastId];
+      if(awakeSlots[id] >= 0)
+      {
+         awakeActors[awakeSlots[id]] = id;
+      }
+
+      handles[id] = handles[lastId];
+      handleTargets[handles[id] & HANDLE_SLOT_MASK] = id;
+
+      actors[id]->id = id;
+      renumberName(actors[id]->getName(), lastId, id);
+   }
+
+   actors.pop_back();
+   locations.pop_back();
+   previousLocations.pop_back();
+   directions.pop_back();
+   movementSpeeds.pop_back();
+   movementProgress.pop_back();
+   stepDistances.pop_back();
+   orderRings.pop_back();
+   awakeSlots.pop_back();
+   coarseFlags.pop_back();
+   handles.pop_back();
+}
+
+int ActorTable::size() const
+{
+   return static_cast<int>(actors.size());
+}
+
+Actor* ActorTable::getActor(ActorId id) const
+{
+   return actors[id];
+}
+
+ActorTable::ActorId ActorTable::getId(const Actor* actor) const
+{
+   return actor->id;
+}
+
+ActorTable::ActorId ActorTable::find(const std::string& name) const
+{
+   const std::vector<NameEntry>& bucket = getNameBucket(name);
+   for(std::vector<NameEntry>::const_iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+   {
+      if(entry->name == name)
+      {
+         return entry->id;
+      }
+   }
+
+   return INVALID_ACTOR;
+}
+
+ActorTable::ActorHandle ActorTable::getHandle(ActorId id) const
+{
+   return handles[id];
+}
+
+ActorTable::ActorId ActorTable::resolve(ActorHandle handle) const
+{
+   const unsigned int slot = handle & HANDLE_SLOT_MASK;
+   if(slot >= handleTargets.size() || handleGenerations[slot] != handle >> HANDLE_SLOT_BITS)
+   {
+      return INVALID_ACTOR;
+   }
+
+   return handleTargets[slot];
+}
+
+const shapes::Point2D& ActorTable::getLocation(ActorId id) const
+{
+   return locations[id];
+}
+
+void ActorTable::setLocation(ActorId id, const shapes::Point2D& location)
+{
+   locations[id] = location;
+}
+
+const shapes::Point2D& ActorTable::getPreviousLocation(ActorId id) const
+{
+   return previousLocations[id];
+}
+
+void ActorTable::beginStep(ActorId id)
+{
+   previousLocations[id] = locations[id];
+}
+
+MovementDirection ActorTable::getDirection(ActorId id) const
+{
+   return directions[id];
+}
+
+void ActorTable::setDirection(ActorId id, MovementDirection direction)
+{
+   directions[id] = direction;
+}
+
+float ActorTable::getMovementSpeed(ActorId id) const
+{
+   return static_cast<float>(movementSpeeds[id]) / (1L << SUBPIXEL_BITS);
+}
+
+void ActorTable::setMovementSpeed(ActorId id, float speed)
+{
+   movementSpeeds[id] = toFixedPoint(speed);
+}
+
+void ActorTable::integrateMovement(long timePassed)
+{
+   // A straight run over the arrays with no branches, so that the compiler is free to vectorize it
+   const size_t count = actors.size();
+   for(size_t i = 0; i < count; ++i)
+   {
+      const long progress = movementProgress[i] + movementSpeeds[i] * timePassed;
+      stepDistances[i] = progress >> SUBPIXEL_BITS;
+      movementProgress[i] = progress & SUBPIXEL_MASK;
+   }
+}
+
+long ActorTable::getStepDistance(ActorId id) const
+{
+   return stepDistances[id];
+}
+
+void ActorTable::saveStepDistance(ActorId id, long distance)
+{
+   movementProgress[id] += distance << SUBPIXEL_BITS;
+}
+
+void ActorTable::pushOrder(ActorId id, Actor::Order* order)
+{
+   OrderRing& ring = orderRings[id];
+   if(ring.count == ring.slots.size())
+   {
+      // Unroll the ring into a larger one, so that the queued orders start at the first slot
+      std::vector<Actor::Order*> slots(ring.slots.empty() ? INITIAL_ORDER_SLOTS : ring.slots.size() * 2, static_cast<Actor::Order*>(NULL));
+      for(unsigned int i = 0; i < ring.count; ++i)
+      {
+         slots[i] = ring.slots[(ring.first + i) & (ring.slots.size() - 1)];
+      }
+
+      ring.slots.swap(slots);
+      ring.first = 0;
+   }
+
+   ring.slots[(ring.first + ring.count) & (ring.slots.size() - 1)] = order;
+   ++ring.count;
+
+   // An actor with something to do can't stay parked
+   wake(id);
+}
+
+Actor::Order* ActorTable::getCurrentOrder(ActorId id) const
+{
+   const OrderRing& ring = orderRings[id];
+   return ring.count > 0 ? ring.slots[ring.first] : NULL;
+}
+
+Actor::Order* ActorTable::popOrder(ActorId id)
+{
+   OrderRing& ring = orderRings[id];
+   Actor::Order* order = ring.slots[ring.first];
+   ring.slots[ring.first] = NULL;
+   ring.first = (ring.first + 1) & (ring.slots.size() - 1);
+   --ring.count;
+   return order;
+}
+
+void ActorTable::wake(ActorId id)
+{
+   if(awakeSlots[id] < 0)
+   {
+      awakeSlots[id] = static_cast<int>(awakeActors.size());
+      awakeActors.push_back(id);
+   }
+}
+
+void ActorTable::park(ActorId id)
+{
+   const int slot = awakeSlots[id];
+   if(slot >= 0)
+   {
+      // A parked actor isn't stepped, so it is settled where it stands instead of being drawn partway through its last step
+      previousLocations[id] = locations[id];
+
+      const ActorId lastAwake = awakeActors.back();
+      awakeActors[slot] = lastAwake;
+      awakeSlots[lastAwake] = slot;
+      awakeActors.pop_back();
+      awakeSlots[id] = -1;
+   }
+}
+
+bool ActorTable::isAwake(ActorId id) const
+{
+   return awakeSlots[id] >= 0;
+}
+
+int ActorTable::getAwakeCount() const
+{
+   return static_cast<int>(awakeActors.size());
+}
+
+ActorTable::ActorId ActorTable::getAwakeActor(int index) const
+{
+   return awakeActors[index];
+}
+
+void ActorTable::setCoarse(ActorId id, bool coarse)
+{
+   coarseFlags[id] = coarse;
+}
+
+bool ActorTable::isCoarse(ActorId id) const
+{
+   return coarseFlags[id];
+}
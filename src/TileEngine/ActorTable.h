@@ -0,0 +1,413 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef ACTOR_TABLE_H
+#define ACTOR_TABLE_H
+
+#include <string>
+#include <vector>
+#include "Actor.h"
+
+/**
+ * The ActorTable keeps the state that the actors on an entity grid touch on every step
+ * (their locations, directions, speeds and queued orders) in arrays of components, with one element
+ * for each actor, so that stepping the actors runs along the arrays instead of hopping between
+ * separately allocated actors. Each actor is filed under a dense ID, which is its index into the arrays.
+ *
+ * Movement is integrated for every actor at once, at the start of each logic step, in fixed point.
+ * Each actor's speed is added up (with sub-pixel precision) into the whole number of pixels that the actor
+ * can cover during the step, and the fraction of a pixel left over is carried into the next step.
+ * The player character and the NPCs' orders all move by the distances worked out this way.
+ *
+ * When an actor is removed, the last actor in the table takes its place (and its ID), so that the arrays
+ * never have holes in them. IDs are therefore only good until the next actor is removed; anything that
+ * keeps hold of an actor for longer should keep its handle instead. A handle stays the same for as long as
+ * the actor is in the table, and is never mistaken for a later actor once the actor has been removed
+ * (its slot's generation is moved on, so that the old handle no longer resolves), which lets scripts
+ * hold on to handles across frames and resolve them without looking anything up by name.
+ *
+ * The actors are also indexed by name, in a hash table, for the scripts that still look them up that way.
+ * If two actors have the same name, the name finds the one that was added last.
+ *
+ * Actors that have nothing to do (no orders, and nowhere near the screen) can be parked, so that they
+ * aren't stepped at all until they are needed again. The table keeps a dense list of the actors that are
+ * awake, so that the cost of stepping the actors follows how many of them are active rather than how many
+ * there are on the map. Queueing up an order for a parked actor wakes it up.
+ */
+class ActorTable
+{
+   public:
+      /** The index of an actor in the table. */
+      typedef int ActorId;
+
+      /** The ID returned when an actor can't be found. */
+      static const ActorId INVALID_ACTOR = -1;
+
+      /**
+       * A stable reference to an actor in the table. The low bits pick a slot of the handle table,
+       * and the high bits hold the generation of the slot when the handle was given out.
+       */
+      typedef unsigned int ActorHandle;
+
+      /** A handle that never refers to an actor. */
+      static const ActorHandle INVALID_HANDLE = 0;
+
+   private:
+      /** The orders queued up for an actor, in a ring that only allocates when it has to grow. */
+      struct OrderRing
+      {
+         /** The slots of the ring. There is always a power of two of them (or none), so that positions can be masked down to a slot. */
+         std::vector<Actor::Order*> slots;
+
+         /** The slot of the order being performed. */
+         unsigned int first;
+
+         /** The number of queued orders. */
+         unsigned int count;
+
+         OrderRing() : first(0), count(0) {}
+      };
+
+      /** An actor filed under its name. */
+      struct NameEntry
+      {
+         /** The name of the actor. */
+         std::string name;
+
+         /** The ID of the actor. */
+         ActorId id;
+      };
+
+      /** The actors, by ID. */
+      std::vector<Actor*> actors;
+
+      /** The current location of each actor (in pixels), by ID. */
+      std::vector<shapes::Point2D> locations;
+
+      /** The location of each actor before its last logic step (in pixels), by ID. */
+      std::vector<shapes::Point2D> previousLocations;
+
+      /** The direction that each actor is facing, by ID. */
+      std::vector<MovementDirection> directions;
+
+      /** The movement speed of each actor (in fixed point pixels per millisecond), by ID. */
+      std::vector<long> movementSpeeds;
+
+      /** The fraction of a pixel (in fixed point) that each actor has covered beyond its step distance, by ID. */
+      std::vector<long> movementProgress;
+
+      /** The distance (in pixels) that each actor can cover during the current step, by ID. */
+      std::vector<long> stepDistances;
+
+      /** The orders queued up for each actor, by ID. */
+      std::vector<OrderRing> orderRings;
+
+      /** The position of each actor in the list of awake actors (or -1 if it is parked), by ID. */
+      std::vector<int> awakeSlots;
+
+      /** The IDs of the actors that are awake, in no particular order. */
+      std::vector<ActorId> awakeActors;
+
+      /** Whether each actor is far enough from the screen to be simulated coarsely, by ID. */
+      std::vector<bool> coarseFlags;
+
+      /** The handle of each actor, by ID. */
+      std::vector<ActorHandle> handles;
+
+      /** The ID of the actor that each handle slot refers to (or INVALID_ACTOR if the slot is free), by slot. */
+      std::vector<ActorId> handleTargets;
+
+      /** The current generation of each handle slot, by slot. Handles from earlier generations are stale. */
+      std::vector<unsigned int> handleGenerations;
+
+      /** The handle slots that aren't in use, to be given out again before new slots are added. */
+      std::vector<unsigned int> freeHandleSlots;
+
+      /** The buckets of the name index. There is always a power of two of them, so that a hash can be masked down to a bucket. */
+      std::vector<std::vector<NameEntry> > nameBuckets;
+
+      /** The number of names in the name index. */
+      size_t nameCount;
+
+      /**
+       * @param name The name of an actor.
+       *
+       * @return The bucket of the name index that the name belongs in.
+       */
+      std::vector<NameEntry>& getNameBucket(const std::string& name);
+
+      /**
+       * @param name The name of an actor.
+       *
+       * @return The bucket of the name index that the name belongs in.
+       */
+      const std::vector<NameEntry>& getNameBucket(const std::string& name) const;
+
+      /**
+       * Spreads the names over twice as many buckets.
+       */
+      void growNameIndex();
+
+      /**
+       * Files an actor under its name, in place of any actor that was filed under the name before.
+       *
+       * @param name The name of the actor.
+       * @param id The ID of the actor.
+       */
+      void addName(const std::string& name, ActorId id);
+
+      /**
+       * Points a name at a new ID, if it is filed under the given ID.
+       *
+       * @param name The name of the actor.
+       * @param oldId The ID that the name may be filed under.
+       * @param newId The ID to file the name under instead, or INVALID_ACTOR to remove the name.
+       */
+      void renumberName(const std::string& name, ActorId oldId, ActorId newId);
+
+      /**
+       * Gives out a handle for an actor, reusing a free handle slot if there is one.
+       *
+       * @param id The ID of the actor.
+       *
+       * @return The new handle of the actor.
+       */
+      ActorHandle allocateHandle(ActorId id);
+
+      /**
+       * Frees an actor's handle slot, and moves the slot on to its next generation so that the handle goes stale.
+       *
+       * @param handle The handle of an actor that is being removed.
+       */
+      void releaseHandle(ActorHandle handle);
+
+      /** Tables can't be copied. */
+      ActorTable(const ActorTable&);
+
+      /** Tables can't be copied. */
+      ActorTable& operator=(const ActorTable&);
+
+   public:
+      /**
+       * Constructor. The table starts out empty.
+       */
+      ActorTable();
+
+      /**
+       * Adds an actor to the table.
+       *
+       * @param actor The actor to add.
+       * @param location The starting location of the actor (in pixels).
+       * @param movementSpeed The movement speed of the actor.
+       * @param direction The direction that the actor starts out facing.
+       *
+       * @return The ID of the actor.
+       */
+      ActorId add(Actor* actor, const shapes::Point2D& location, float movementSpeed, MovementDirection direction);
+
+      /**
+       * Removes an actor from the table. The actor's orders must have been flushed first.
+       * The last actor in the table is moved into the removed actor's place, and is given its ID.
+       *
+       * @param id The ID of the actor to remove.
+       */
+      void remove(ActorId id);
+
+      /**
+       * @return The number of actors in the table. The actors' IDs run from 0 up to this number.
+       */
+      int size() const;
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return The actor.
+       */
+      Actor* getActor(ActorId id) const;
+
+      /**
+       * @param actor An actor in the table.
+       *
+       * @return The ID of the actor.
+       */
+      ActorId getId(const Actor* actor) const;
+
+      /**
+       * @param name The name of an actor.
+       *
+       * @return The ID of the actor added last with the name, or INVALID_ACTOR if there is none.
+       */
+      ActorId find(const std::string& name) const;
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return The handle of the actor, which stays the same for as long as the actor is in the table.
+       */
+      ActorHandle getHandle(ActorId id) const;
+
+      /**
+       * @param handle A handle that was given out by the table.
+       *
+       * @return The current ID of the actor with the handle, or INVALID_ACTOR if the actor has been removed.
+       */
+      ActorId resolve(ActorHandle handle) const;
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return The current location of the actor (in pixels).
+       */
+      const shapes::Point2D& getLocation(ActorId id) const;
+
+      /**
+       * @param id The ID of an actor.
+       * @param location The new location of the actor (in pixels).
+       */
+      void setLocation(ActorId id, const shapes::Point2D& location);
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return The location of the actor before its last logic step (in pixels).
+       */
+      const shapes::Point2D& getPreviousLocation(ActorId id) const;
+
+      /**
+       * Records the actor's current location as where it was before its logic step, at the start of the step.
+       *
+       * @param id The ID of an actor.
+       */
+      void beginStep(ActorId id);
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return The direction that the actor is facing.
+       */
+      MovementDirection getDirection(ActorId id) const;
+
+      /**
+       * @param id The ID of an actor.
+       * @param direction The direction that the actor faces.
+       */
+      void setDirection(ActorId id, MovementDirection direction);
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return The movement speed of the actor.
+       */
+      float getMovementSpeed(ActorId id) const;
+
+      /**
+       * @param id The ID of an actor.
+       * @param speed The movement speed of the actor.
+       */
+      void setMovementSpeed(ActorId id, float speed);
+
+      /**
+       * Works out how far each actor can move during a logic step, at its movement speed.
+       * This must be called once at the start of each step, before any of the actors are stepped.
+       *
+       * @param timePassed The amount of time that the step covers.
+       */
+      void integrateMovement(long timePassed);
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return The distance (in pixels) that the actor can cover during the current step.
+       */
+      long getStepDistance(ActorId id) const;
+
+      /**
+       * Carries distance that the actor couldn't use during this step into the next one,
+       * such as while it waits for a move to be granted.
+       *
+       * @param id The ID of an actor.
+       * @param distance The unused distance (in pixels).
+       */
+      void saveStepDistance(ActorId id, long distance);
+
+      /**
+       * Queues up an order for an actor, behind the orders that it already has.
+       *
+       * @param id The ID of an actor.
+       * @param order The order, which the actor takes ownership of.
+       */
+      void pushOrder(ActorId id, Actor::Order* order);
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return The order that the actor is performing, or NULL if it has none.
+       */
+      Actor::Order* getCurrentOrder(ActorId id) const;
+
+      /**
+       * Takes the order that the actor is performing off the front of its queue, without deleting it.
+       *
+       * @param id The ID of an actor, which must have an order.
+       *
+       * @return The order that was taken off the queue.
+       */
+      Actor::Order* popOrder(ActorId id);
+
+      /**
+       * Wakes an actor up, so that it is stepped again. Actors start out awake.
+       *
+       * @param id The ID of an actor.
+       */
+      void wake(ActorId id);
+
+      /**
+       * Parks an actor, so that it isn't stepped until it is woken up.
+       * The actor is settled at its current location, as though its last step had finished.
+       *
+       * @param id The ID of an actor.
+       */
+      void park(ActorId id);
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return true iff the actor is awake.
+       */
+      bool isAwake(ActorId id) const;
+
+      /**
+       * @return The number of actors that are awake.
+       */
+      int getAwakeCount() const;
+
+      /**
+       * @param index The position of an actor in the list of awake actors (from 0 up to getAwakeCount).
+       *              Waking an actor adds it to the end of the list, and parking an actor moves
+       *              the last actor in the list into its place.
+       *
+       * @return The ID of the awake actor.
+       */
+      ActorId getAwakeActor(int index) const;
+
+      /**
+       * Sets whether or not an actor is simulated coarsely. Nobody can see a coarsely simulated actor,
+       * so its orders can skip ahead instead of moving it a pixel at a time. Actors start out simulated in full.
+       *
+       * @param id The ID of an actor.
+       * @param coarse true iff the actor can be simulated coarsely.
+       */
+      void setCoarse(ActorId id, bool coarse);
+
+      /**
+       * @param id The ID of an actor.
+       *
+       * @return true iff the actor can be simulated coarsely.
+       */
+      bool isCoarse(ActorId id) const;
+};
+
+#endif
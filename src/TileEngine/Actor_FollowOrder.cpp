@@ -0,0 +1,199 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Actor.h"
+#include "Actor_Orders.h"
+#include "ObjectPool.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_NPC;
+
+Actor::FollowOrder::FollowOrder(Actor& actor, const shapes::Point2D& goal, EntityGrid& entityGrid)
+: Order(actor), movementProposed(false), movementBegun(false), goal(goal), entityGrid(entityGrid)
+{
+}
+
+Actor::FollowOrder::~FollowOrder()
+{
+   if(movementBegun)
+   {
+      entityGrid.abortMovement(&actor, lastWaypoint, nextWaypoint);
+   }
+}
+
+ObjectPool& Actor::FollowOrder::getPool()
+{
+   // Never destroyed, so that an order deleted while the game shuts down still has a pool to go back to
+   static ObjectPool* pool = new ObjectPool("follow orders", sizeof(FollowOrder));
+   return *pool;
+}
+
+void* Actor::FollowOrder::operator new(size_t size)
+{
+   return getPool().allocate(size);
+}
+
+void Actor::FollowOrder::operator delete(void* block, size_t size)
+{
+   getPool().release(block, size);
+}
+
+void Actor::FollowOrder::updateDirection(MovementDirection newDirection, bool moving)
+{
+   actor.setDirection(newDirection);
+   if(moving)
+   {
+      actor.setAnimation(WALKING_PREFIX);
+   }
+   else
+   {
+      actor.setFrame(STANDING_PREFIX);
+   }
+}
+
+void Actor::FollowOrder::proposeMovement()
+{
+   if(movementBegun) return;
+
+   const shapes::Point2D location = actor.getLocation();
+   shapes::Point2D waypoint;
+   if(!entityGrid.findFlowWaypoint(goal, location, actor.getWidth(), actor.getHeight(), waypoint))
+   {
+      // The order finishes when it is performed
+      return;
+   }
+
+   lastWaypoint = location;
+   nextWaypoint = waypoint;
+   movementProposed = true;
+   entityGrid.proposeMovement(&actor, lastWaypoint, nextWaypoint, movementBegun);
+}
+
+bool Actor::FollowOrder::perform(long /*timePassed*/)
+{
+   shapes::Point2D location = actor.getLocation();
+   long distanceCovered = actor.getStepDistance();
+
+   // loop infinitely
+   //      if not moving towards a waypoint
+   //          look up the next waypoint in the flow field
+   //          if there is none, the Actor is at the goal (or can't reach it)
+   //             end task
+   //          if the waypoint wasn't proposed this frame
+   //             save the remaining distance, end frame (it is proposed at the start of the next frame)
+   //          if the proposal was turned down (another entity is in the way)
+   //             if the Actor would be standing on the goal at the waypoint
+   //                end task
+   //             wait, end frame
+   //
+   //      if waypoint is within step
+   //          move to waypoint
+   //          free previous waypoint
+   //      else
+   //          move as close as possible to waypoint
+   //          break
+   //
+   // end frame
+
+   for(;;)
+   {
+      if(!movementBegun)
+      {
+         shapes::Point2D waypoint;
+         if(!entityGrid.findFlowWaypoint(goal, location, actor.getWidth(), actor.getHeight(), waypoint))
+         {
+            DEBUG("Finished following flow field to %d,%d", goal.x, goal.y);
+            updateDirection(actor.getDirection(), false);
+            actor.setLocation(location);
+            return true;
+         }
+
+         if(!movementProposed)
+         {
+            // Moves are only granted along with every other actor's moves at the start of a frame,
+            // so hold on to the rest of this frame's movement until the next waypoint is granted
+            actor.saveStepDistance(distanceCovered);
+            actor.setLocation(location);
+            return false;
+         }
+
+         movementProposed = false;
+         updateDirection(actor.getDirection(), false);
+         actor.setLocation(location);
+
+         // If the goal itself is taken (for instance, by the player the crowd is converging on),
+         // this is as close as the Actor can get. Otherwise, wait for the way to clear.
+         return goal.x >= nextWaypoint.x && goal.x < nextWaypoint.x + actor.getWidth()
+            && goal.y >= nextWaypoint.y && goal.y < nextWaypoint.y + actor.getHeight();
+      }
+
+      if(movementProposed)
+      {
+         movementProposed = false;
+
+         // For now, when the Actor must move diagonally, it will always face up or down
+         MovementDirection newDirection = actor.getDirection();
+         if(location.y < nextWaypoint.y)
+         {
+            newDirection = DOWN;
+         }
+         else if(location.y > nextWaypoint.y)
+         {
+            newDirection = UP;
+         }
+         else if(location.x < nextWaypoint.x)
+         {
+            newDirection = RIGHT;
+         }
+         else if(location.x > nextWaypoint.x)
+         {
+            newDirection = LEFT;
+         }
+
+         updateDirection(newDirection, true);
+      }
+
+      const long stepDistance = std::max(abs(location.x - nextWaypoint.x), abs(location.y - nextWaypoint.y));
+
+      if (distanceCovered < stepDistance)
+      {
+         // The Actor will not be able to make it to the next waypoint in this frame
+         // Move towards the waypoint as much as possible.
+         if(location.x < nextWaypoint.x)
+         {
+            location.x += distanceCovered;
+            if(location.x > nextWaypoint.x) location.x = nextWaypoint.x;
+         }
+         else if(location.x > nextWaypoint.x)
+         {
+            location.x -= distanceCovered;
+            if(location.x < nextWaypoint.x) location.x = nextWaypoint.x;
+         }
+
+         if(location.y < nextWaypoint.y)
+         {
+            location.y += distanceCovered;
+            if(location.y > nextWaypoint.y) location.y = nextWaypoint.y;
+         }
+         else if(location.y > nextWaypoint.y)
+         {
+            location.y -= distanceCovered;
+            if(location.y < nextWaypoint.y) location.y = nextWaypoint.y;
+         }
+
+         // Movement for this frame is finished
+         actor.setLocation(location);
+         return false;
+      }
+
+      // The Actor can reach the next waypoint in this frame
+      distanceCovered -= stepDistance;
+
+      entityGrid.endMovement(&actor, lastWaypoint, nextWaypoint);
+      movementBegun = false;
+      location = nextWaypoint;
+   }
+}
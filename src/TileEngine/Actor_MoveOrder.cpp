@@ -6,6 +6,8 @@
 
 #include "Actor.h"
 #include "Actor_Orders.h"
+#include "ObjectPool.h"
+#include "GLState.h"
 #include "SDL_opengl.h"
 #include "TileEngine.h"
 #include "Map.h"
@@ -15,19 +17,51 @@ const int debugFlag = DEBUG_NPC;
 
 //#define DRAW_PATH
 
+// Obstacles and actors in the way rarely clear up in less than a quarter of a second,
+// and once a destination has been out of reach for a while, a few seconds between attempts is plenty
+const long Actor::MoveOrder::INITIAL_RETRY_DELAY = 250;
+const long Actor::MoveOrder::MAX_RETRY_DELAY = 4000;
+
+// Most actors in the way are only crossing the path, and have moved on within a few steps;
+// waiting them out is much cheaper than searching for a way around them
+const long Actor::MoveOrder::RIGHT_OF_WAY_PATIENCE = 1000;
+const long Actor::MoveOrder::GIVE_WAY_PATIENCE = 250;
+
 Actor::MoveOrder::MoveOrder(Actor& actor, const shapes::Point2D& destination, EntityGrid& entityGrid)
-: Order(actor), pathInitialized(false), movementBegun(false), dst(destination), entityGrid(entityGrid), cumulativeDistanceCovered(0)
+: Order(actor), pathInitialized(false), movementProposed(false), movementBegun(false), dst(destination), entityGrid(entityGrid), pathIndex(0), pathRequest(Pathfinder::INVALID_PATH_REQUEST), retryInterval(0), retryDelay(0), skipBlocked(false), blockedTime(0)
 {	
 }
 
 Actor::MoveOrder::~MoveOrder()
 {
+   if(pathRequest != Pathfinder::INVALID_PATH_REQUEST)
+   {
+      entityGrid.cancelPathRequest(pathRequest);
+   }
+
    if(movementBegun)
    {
       entityGrid.abortMovement(&actor, lastWaypoint, nextWaypoint);
    }
 }
 
+ObjectPool& Actor::MoveOrder::getPool()
+{
+   // Never destroyed, so that an order deleted while the game shuts down still has a pool to go back to
+   static ObjectPool* pool = new ObjectPool("move orders", sizeof(MoveOrder));
+   return *pool;
+}
+
+void* Actor::MoveOrder::operator new(size_t size)
+{
+   return getPool().allocate(size);
+}
+
+void Actor::MoveOrder::operator delete(void* block, size_t size)
+{
+   getPool().release(block, size);
+}
+
 void Actor::MoveOrder::updateDirection(MovementDirection newDirection, bool moving)
 {
    actor.setDirection(newDirection);
@@ -44,7 +78,7 @@ void Actor::MoveOrder::updateDirection(MovementDirection newDirection, bool movi
 void Actor::MoveOrder::updateNextWaypoint(shapes::Point2D location, MovementDirection& direction)
 {
    lastWaypoint = location;
-   nextWaypoint = path.front();
+   nextWaypoint = path[pathIndex];
    
    // Set the direction based on where the next tile is relative to the current location.
    // For now, when the Actor must move diagonally, it will always face up or down
@@ -66,32 +100,109 @@ void Actor::MoveOrder::updateNextWaypoint(shapes::Point2D location, MovementDire
    }
 }
 
+bool Actor::MoveOrder::skipAhead(shapes::Point2D& location, long& distanceCovered)
+{
+   unsigned int targetIndex = pathIndex;
+   shapes::Point2D target = location;
+   long distanceLeft = distanceCovered;
+   while(targetIndex < path.size())
+   {
+      const long stepDistance = std::max(abs(target.x - path[targetIndex].x), abs(target.y - path[targetIndex].y));
+      if(stepDistance > distanceLeft)
+      {
+         break;
+      }
+
+      distanceLeft -= stepDistance;
+      target = path[targetIndex];
+      ++targetIndex;
+   }
+
+   if(targetIndex == pathIndex)
+   {
+      // Save the distance up until the actor can reach the next waypoint
+      actor.saveStepDistance(distanceCovered);
+      distanceCovered = 0;
+      return false;
+   }
+
+   // Only the tiles at the waypoint reached are claimed; the actor passes over the tiles along the way unseen
+   actor.setLocation(location);
+   if(!entityGrid.changeActorLocation(&actor, target))
+   {
+      // Something is in the way, so walk to the next waypoint in full, and let its proposal reroute the actor if need be
+      TRACE("Skipping ahead to %d,%d was blocked", target.x, target.y);
+      skipBlocked = true;
+      actor.saveStepDistance(distanceCovered);
+      distanceCovered = 0;
+      return false;
+   }
+
+   location = target;
+   pathIndex = targetIndex;
+   distanceCovered = distanceLeft;
+   return true;
+}
+
+long Actor::MoveOrder::getPatience(const Actor* actorInTheWay) const
+{
+   // An actor standing still may never move, so it is only waited on briefly
+   if(actorInTheWay->isIdle())
+   {
+      return GIVE_WAY_PATIENCE;
+   }
+
+   // Two moving actors in each other's way (such as head-on in a corridor) would wait each other out,
+   // so the right of way goes to the one whose move is resolved first, and the other gives way
+   const shapes::Point2D location = actor.getLocation();
+   const shapes::Point2D otherLocation = actorInTheWay->getLocation();
+   const bool resolvedFirst = location.y < otherLocation.y || (location.y == otherLocation.y && location.x < otherLocation.x);
+   return resolvedFirst ? RIGHT_OF_WAY_PATIENCE : GIVE_WAY_PATIENCE;
+}
+
+void Actor::MoveOrder::proposeMovement()
+{
+   if(!pathInitialized || movementBegun || pathRequest != Pathfinder::INVALID_PATH_REQUEST || pathIndex == path.size())
+   {
+      return;
+   }
+
+   // A coarsely simulated actor skips ahead when it is performed, instead of proposing each move
+   if(actor.isSimulatedCoarsely() && !skipBlocked)
+   {
+      return;
+   }
+
+   // Remember the move now, so that it can be aborted properly even if the order is dropped before it is performed
+   lastWaypoint = actor.getLocation();
+   nextWaypoint = path[pathIndex];
+   movementProposed = true;
+   entityGrid.proposeMovement(&actor, lastWaypoint, nextWaypoint, movementBegun);
+}
+
 bool Actor::MoveOrder::perform(long timePassed)
 {
    shapes::Point2D location = actor.getLocation();
    MovementDirection newDirection = actor.getDirection();
-   const float vel = actor.getMovementSpeed();
-   cumulativeDistanceCovered +=timePassed * vel;   
-   long distanceCovered = 0;
-   if(cumulativeDistanceCovered > 1.0)
-   {
-	   distanceCovered = floor(cumulativeDistanceCovered);
-	   cumulativeDistanceCovered -= distanceCovered;
-   }
-   // If first run, get the best computed path (RFW), end frame
+   long distanceCovered = actor.getStepDistance();
+   // If first run, request the best computed path, end frame
+   // If a requested path isn't ready yet, stand still and end frame
    // loop infinitely
    //      if there is no next vertex
    //          if Actor is at the destination
    //             end task
+   //          else if the last requested path came back empty and the retry delay hasn't passed
+   //             end frame
    //          else
-   //             create a rerouted path (A*)
+   //             request a rerouted path (A*)
    //             end frame
    //          
    //      face next vertex
    //      if vertex isn't yet acquired
-   //          try acquire vertex
-   //          if acquire failed
-   //             create a rerouted path (A*)
+   //          if vertex wasn't proposed this frame
+   //             save the remaining distance, end frame (it is proposed at the start of the next frame)
+   //          if the proposal was turned down
+   //             request a rerouted path (A*)
    //             end frame
    //
    //      if vertex is within step
@@ -105,41 +216,118 @@ bool Actor::MoveOrder::perform(long timePassed)
 
    if(!pathInitialized)
    {
-      DEBUG("Finding an ideal path from %d,%d to %d,%d", location.x, location.y, dst.x, dst.y);  
-      path = entityGrid.findBestPath(location, dst);
+      TRACE("Requesting an ideal path from %d,%d to %d,%d", location.x, location.y, dst.x, dst.y);  
+      pathRequest = entityGrid.requestBestPath(location, dst);
       pathInitialized = true;
       return false;
    }
 
+   if(pathRequest != Pathfinder::INVALID_PATH_REQUEST)
+   {
+      EntityGrid::Path foundPath;
+      if(!entityGrid.collectPath(pathRequest, foundPath))
+      {
+         // The path is still being computed, so keep standing in place
+         return false;
+      }
+
+      // Straight runs are reserved and walked as a single step, which saves occupying and freeing every tile along the way
+      entityGrid.compactPath(location, foundPath).swap(path);
+      pathIndex = 0;
+      pathRequest = Pathfinder::INVALID_PATH_REQUEST;
+      skipBlocked = false;
+
+      if(path.empty() && location != dst)
+      {
+         // The destination is out of reach for now, so back off instead of searching again every frame
+         retryInterval = retryInterval == 0 ? INITIAL_RETRY_DELAY : std::min(retryInterval * 2, MAX_RETRY_DELAY);
+         retryDelay = retryInterval;
+         DEBUG("No path found to %d,%d; retrying in %ldms", dst.x, dst.y, retryDelay);
+      }
+      else
+      {
+         retryInterval = 0;
+         retryDelay = 0;
+      }
+   }
+
    for(;;)
    {
-      if(path.empty())
+      if(pathIndex == path.size())
       {
          updateDirection(actor.getDirection(), false);
          actor.setLocation(location);
          if(location != dst)
          {
-            path = entityGrid.findReroutedPath(location, dst, actor.getWidth(), actor.getHeight());
+            if(retryDelay > 0)
+            {
+               retryDelay -= timePassed;
+               return false;
+            }
+
+            pathRequest = entityGrid.requestReroutedPath(location, dst, actor.getWidth(), actor.getHeight());
             return false;
          }
 
          return true;
       }
       
+      if(!movementBegun && !movementProposed && !skipBlocked && actor.isSimulatedCoarsely())
+      {
+         if(!skipAhead(location, distanceCovered))
+         {
+            actor.setLocation(location);
+            return false;
+         }
+
+         continue;
+      }
+
       if(!movementBegun)
       {
-         movementBegun = entityGrid.beginMovement(&actor, path.front());
-         if(!movementBegun)
+         if(!movementProposed)
          {
-            path = entityGrid.findReroutedPath(location, dst, actor.getWidth(), actor.getHeight());
+            // Moves are only granted along with every other actor's moves at the start of a frame,
+            // so hold on to the rest of this frame's movement until the next waypoint is granted
+            actor.saveStepDistance(distanceCovered);
+            actor.setLocation(location);
+            return false;
+         }
+
+         // The proposed move was turned down, so something is in the way
+         movementProposed = false;
+
+         const Actor* actorInTheWay = entityGrid.findActorInTheWay(&actor, lastWaypoint, nextWaypoint);
+         if(actorInTheWay != NULL && blockedTime < getPatience(actorInTheWay))
+         {
+            // Stand still and propose the move again next frame, in case the other actor has moved on by then
+            blockedTime += timePassed;
             updateDirection(actor.getDirection(), false);
             actor.setLocation(location);
             return false;
          }
 
-         DEBUG("Next waypoint: %d,%d", nextWaypoint.x, nextWaypoint.y);
+         if(actorInTheWay != NULL)
+         {
+            TRACE("Gave up waiting after %ldms; looking for a way around", blockedTime);
+         }
+
+         blockedTime = 0;
+         path.clear();
+         pathIndex = 0;
+         pathRequest = entityGrid.requestReroutedPath(location, dst, actor.getWidth(), actor.getHeight());
+         updateDirection(actor.getDirection(), false);
+         actor.setLocation(location);
+         return false;
+      }
+
+      if(movementProposed)
+      {
+         movementProposed = false;
+         blockedTime = 0;
          updateNextWaypoint(location, newDirection);
          updateDirection(newDirection, true);
+         TRACE("Next waypoint: %d,%d", nextWaypoint.x, nextWaypoint.y);
       }
       
       const long stepDistance = std::max(abs(location.x - nextWaypoint.x), abs(location.y - nextWaypoint.y));
@@ -178,13 +366,14 @@ bool Actor::MoveOrder::perform(long timePassed)
       // The Actor can reach the next waypoint in this frame
       distanceCovered -= stepDistance;
       
-      DEBUG("Reached waypoint %d,%d", nextWaypoint.x, nextWaypoint.y);
+      TRACE("Reached waypoint %d,%d", nextWaypoint.x, nextWaypoint.y);
       entityGrid.endMovement(&actor, lastWaypoint, nextWaypoint);
       movementBegun = false;
+      skipBlocked = false;
 
       // Update the current waypoint and dequeue it from the path
       location = nextWaypoint;
-      path.pop_front();
+      ++pathIndex;
    }
 
    return false;
@@ -193,18 +382,19 @@ bool Actor::MoveOrder::perform(long timePassed)
 void Actor::MoveOrder::draw()
 {
 #if DRAW_PATH
-   if(path.empty()) return;
+   if(pathIndex == path.size()) return;
 
-   glDisable(GL_TEXTURE_2D);
+   GLState::setTexturing(false);
    glColor3f(1.0f, 0.0f, 0.0f);
+   GLState::countDrawCall();
    glBegin(GL_LINE_STRIP);
-   for(EntityGrid::Path::const_iterator iter = path.begin(); iter != path.end(); ++iter)
+   for(EntityGrid::WaypointList::const_iterator iter = path.begin() + pathIndex; iter != path.end(); ++iter)
    {
       shapes::Point2D point(iter->x + TileEngine::TILE_SIZE / 2, iter->y + TileEngine::TILE_SIZE / 2);
       glVertex3d(point.x, point.y, 0);
    }
    glEnd();
    
-   glEnable(GL_TEXTURE_2D);
+   GLState::setTexturing(true);
 #endif
 }
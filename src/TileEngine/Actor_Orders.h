@@ -7,8 +7,11 @@
 #ifndef ACTOR_ORDER_H
 #define ACTOR_ORDER_H
 
+#include <cstddef>
 #include "EntityGrid.h"
 
+class ObjectPool;
+
 class Actor::Order
 {
    protected:
@@ -16,6 +19,11 @@ class Actor::Order
       Order(Actor& actor) : actor(actor) {}
    
    public:
+      /**
+       * Proposes the order's next move to the entity grid, if it is about to start one.
+       * The proposals from every actor are resolved together before any of the orders are performed.
+       */
+      virtual void proposeMovement() {}
       virtual bool perform(long timePassed) = 0;
       virtual void draw() {}
       virtual ~Order() {}
@@ -25,32 +33,124 @@ class Actor::StandOrder : public Actor::Order
 {
    MovementDirection direction;
 
+   /** @return The pool that stand orders are allocated from. */
+   static ObjectPool& getPool();
+
    public:
       StandOrder(Actor& actor, MovementDirection direction);
       bool perform(long timePassed);
+
+      /** Allocates the order from the pool of stand orders. */
+      static void* operator new(size_t size);
+
+      /** Hands the order's memory back to the pool of stand orders. */
+      static void operator delete(void* block, size_t size);
 };
 
 class Actor::MoveOrder : public Actor::Order
 {
+   /** The time (in milliseconds) to wait before asking for another path after the first failed path request. */
+   static const long INITIAL_RETRY_DELAY;
+
+   /** The longest time (in milliseconds) to wait before asking for another path. */
+   static const long MAX_RETRY_DELAY;
+
+   /** The time (in milliseconds) to wait for a moving actor in the way to move on, for an actor with the right of way. */
+   static const long RIGHT_OF_WAY_PATIENCE;
+
+   /** The time (in milliseconds) to wait for an actor in the way to move on, for an actor that gives way. */
+   static const long GIVE_WAY_PATIENCE;
+
    bool pathInitialized;
+   bool movementProposed;
    bool movementBegun;
    const shapes::Point2D dst;
    shapes::Point2D lastWaypoint;
    shapes::Point2D nextWaypoint;
    EntityGrid& entityGrid;
-   EntityGrid::Path path;
+   EntityGrid::WaypointList path;
+
+   /** The index of the next waypoint along the path. */
+   unsigned int pathIndex;
 
-   /** Total distance for the character to move. */
-   float cumulativeDistanceCovered;
+   /** The handle of the path request being waited on, if any. */
+   EntityGrid::PathRequestId pathRequest;
+
+   /** The time (in milliseconds) to wait between path requests, which doubles every time a request comes back empty. */
+   long retryInterval;
+
+   /** The time (in milliseconds) left to wait before asking for another path. */
+   long retryDelay;
+
+   /** Set when skipping ahead was blocked, so that the next waypoint is walked to (and proposed) in full. */
+   bool skipBlocked;
+
+   /** The time (in milliseconds) that the actor has been waiting for another actor to get out of its way. */
+   long blockedTime;
+
+   /**
+    * @param actorInTheWay The actor standing in the way of the next move.
+    *
+    * @return The time (in milliseconds) to wait for the actor to move on, before looking for a way around it.
+    */
+   long getPatience(const Actor* actorInTheWay) const;
 
    void updateDirection(MovementDirection newDirection, bool moving);
    void updateNextWaypoint(shapes::Point2D location, MovementDirection& direction);
 
+   /**
+    * Moves a coarsely simulated actor straight to the furthest waypoint that it can reach with the distance it has covered,
+    * claiming only the tiles at that waypoint. If it can't reach the next waypoint yet, the distance is saved up.
+    *
+    * @param location The location of the actor, which is updated to the waypoint reached.
+    * @param distanceCovered The distance covered by the actor during this step, which is updated to the distance left over.
+    *
+    * @return true iff the actor moved.
+    */
+   bool skipAhead(shapes::Point2D& location, long& distanceCovered);
+
+   /** @return The pool that move orders are allocated from. */
+   static ObjectPool& getPool();
+
    public:
       MoveOrder(Actor& actor, const shapes::Point2D& destination, EntityGrid& entityGrid);
       ~MoveOrder();
+      void proposeMovement();
       bool perform(long timePassed);
       void draw();
+
+      /** Allocates the order from the pool of move orders. */
+      static void* operator new(size_t size);
+
+      /** Hands the order's memory back to the pool of move orders. */
+      static void operator delete(void* block, size_t size);
+};
+
+class Actor::FollowOrder : public Actor::Order
+{
+   bool movementProposed;
+   bool movementBegun;
+   const shapes::Point2D goal;
+   shapes::Point2D lastWaypoint;
+   shapes::Point2D nextWaypoint;
+   EntityGrid& entityGrid;
+
+   void updateDirection(MovementDirection newDirection, bool moving);
+
+   /** @return The pool that follow orders are allocated from. */
+   static ObjectPool& getPool();
+
+   public:
+      FollowOrder(Actor& actor, const shapes::Point2D& goal, EntityGrid& entityGrid);
+      ~FollowOrder();
+      void proposeMovement();
+      bool perform(long timePassed);
+
+      /** Allocates the order from the pool of follow orders. */
+      static void* operator new(size_t size);
+
+      /** Hands the order's memory back to the pool of follow orders. */
+      static void operator delete(void* block, size_t size);
 };
 
 const std::string WALKING_PREFIX = "walk";
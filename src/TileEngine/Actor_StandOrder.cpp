@@ -6,11 +6,29 @@
 
 #include "Actor.h"
 #include "Actor_Orders.h"
+#include "ObjectPool.h"
 
 Actor::StandOrder::StandOrder(Actor& actor, MovementDirection direction) : Order(actor), direction(direction)
 {
 }
 
+ObjectPool& Actor::StandOrder::getPool()
+{
+   // Never destroyed, so that an order deleted while the game shuts down still has a pool to go back to
+   static ObjectPool* pool = new ObjectPool("stand orders", sizeof(StandOrder));
+   return *pool;
+}
+
+void* Actor::StandOrder::operator new(size_t size)
+{
+   return getPool().allocate(size);
+}
+
+void Actor::StandOrder::operator delete(void* block, size_t size)
+{
+   getPool().release(block, size);
+}
+
 bool Actor::StandOrder::perform(long timePassed)
 {
    actor.setDirection(direction);
@@ -0,0 +1,68 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Camera.h"
+#include "TileEngine.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_TILE_ENG;
+
+Camera::Camera() : xOffset(0), yOffset(0), viewWidth(0), viewHeight(0), mapWidth(0), mapHeight(0)
+{
+}
+
+int Camera::getOffset(int point, int mapSize, int viewSize)
+{
+   if(mapSize < viewSize)
+   {
+      return (viewSize - mapSize) >> 1;
+   }
+
+   // The offset runs from 0 (showing the map's near edge) to viewSize - mapSize (showing its far edge)
+   return std::max(viewSize - mapSize, std::min((viewSize >> 1) - point, 0));
+}
+
+void Camera::setBounds(int mapWidth, int mapHeight, int viewWidth, int viewHeight)
+{
+   this->viewWidth = viewWidth;
+   this->viewHeight = viewHeight;
+   this->mapWidth = mapWidth;
+   this->mapHeight = mapHeight;
+
+   xOffset = getOffset(0, mapWidth, viewWidth);
+   yOffset = getOffset(0, mapHeight, viewHeight);
+}
+
+void Camera::centerOn(int x, int y)
+{
+   xOffset = getOffset(x, mapWidth, viewWidth);
+   yOffset = getOffset(y, mapHeight, viewHeight);
+}
+
+int Camera::getXOffset() const
+{
+   return xOffset;
+}
+
+int Camera::getYOffset() const
+{
+   return yOffset;
+}
+
+shapes::Rectangle Camera::getVisibleArea(int margin) const
+{
+   // The view shows the part of the map that falls on the screen after the offset is applied
+   return shapes::Rectangle(-yOffset - margin, -xOffset - margin,
+         viewHeight - yOffset - 1 + margin, viewWidth - xOffset - 1 + margin);
+}
+
+shapes::Rectangle Camera::getVisibleTiles() const
+{
+   const shapes::Rectangle visibleArea = getVisibleArea();
+   return shapes::Rectangle(visibleArea.top / TileEngine::TILE_SIZE, visibleArea.left / TileEngine::TILE_SIZE,
+         visibleArea.bottom / TileEngine::TILE_SIZE, visibleArea.right / TileEngine::TILE_SIZE);
+}
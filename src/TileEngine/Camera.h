@@ -0,0 +1,98 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "Rectangle.h"
+
+/**
+ * The camera determines which part of the current map falls on the screen.
+ * It holds the offset that the map's elements are drawn at, and the areas of the map
+ * (in tiles and in pixels) that are visible through it, so that the tile engine
+ * only draws and loads what the player can actually see.
+ * Maps larger than the view scroll to follow a point (such as the player), without showing past the map's edges.
+ */
+class Camera
+{
+   /** The x-offset to draw elements of the map at. */
+   int xOffset;
+
+   /** The y-offset to draw elements of the map at. */
+   int yOffset;
+
+   /** The width of the view (in pixels). */
+   int viewWidth;
+
+   /** The height of the view (in pixels). */
+   int viewHeight;
+
+   /** The width of the map (in pixels). */
+   int mapWidth;
+
+   /** The height of the map (in pixels). */
+   int mapHeight;
+
+   /**
+    * Works out the offset along one axis that puts a point in the middle of the view, as far as the map's edges allow.
+    *
+    * @param point The coordinate of the point on the map (in pixels).
+    * @param mapSize The size of the map along the axis (in pixels).
+    * @param viewSize The size of the view along the axis (in pixels).
+    *
+    * @return The offset to draw elements of the map at.
+    */
+   static int getOffset(int point, int mapSize, int viewSize);
+
+   public:
+      /**
+       * Constructor.
+       */
+      Camera();
+
+      /**
+       * Resizes the view, and centers any map dimension smaller than the view within it.
+       *
+       * @param mapWidth The width of the map (in pixels).
+       * @param mapHeight The height of the map (in pixels).
+       * @param viewWidth The width of the view (in pixels).
+       * @param viewHeight The height of the view (in pixels).
+       */
+      void setBounds(int mapWidth, int mapHeight, int viewWidth, int viewHeight);
+
+      /**
+       * Scrolls the view to put a point in its middle. Along the dimensions where the map is larger than the view,
+       * the view stops at the map's edges; along the others, the map stays centered.
+       *
+       * @param x The x-coordinate of the point on the map (in pixels).
+       * @param y The y-coordinate of the point on the map (in pixels).
+       */
+      void centerOn(int x, int y);
+
+      /**
+       * @return The x-offset to draw elements of the map at.
+       */
+      int getXOffset() const;
+
+      /**
+       * @return The y-offset to draw elements of the map at.
+       */
+      int getYOffset() const;
+
+      /**
+       * @param margin The distance (in pixels) to extend the area by on every side.
+       *
+       * @return The area of the map that is in view (with inclusive edge coordinates in pixels).
+       */
+      shapes::Rectangle getVisibleArea(int margin = 0) const;
+
+      /**
+       * @return The tiles of the map that are in view (with inclusive edge coordinates in tiles).
+       */
+      shapes::Rectangle getVisibleTiles() const;
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "CollisionTree.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_ENTITY_GRID;
+
+// About as many rectangle tests as it takes to descend one more level, so a leaf is never much dearer than a split
+const int CollisionTree::LEAF_SIZE = 4;
+
+// Splitting at the median halves every group, so even a million volumes only take 20 levels
+const int CollisionTree::MAX_DEPTH = 64;
+
+bool CollisionTree::isLeftOf(const Volume& lhs, const Volume& rhs)
+{
+   return lhs.area.left + lhs.area.right < rhs.area.left + rhs.area.right;
+}
+
+bool CollisionTree::isAbove(const Volume& lhs, const Volume& rhs)
+{
+   return lhs.area.top + lhs.area.bottom < rhs.area.top + rhs.area.bottom;
+}
+
+void CollisionTree::build(const std::vector<Volume>& mapVolumes)
+{
+   volumes = mapVolumes;
+   nodes.clear();
+   if(volumes.empty()) return;
+
+   // A tree split at the median has fewer than two nodes for every volume
+   nodes.reserve(2 * volumes.size());
+   buildNode(0, static_cast<int>(volumes.size()), 0);
+
+   DEBUG("Built collision tree of %d nodes over %d volumes.", static_cast<int>(nodes.size()), static_cast<int>(volumes.size()));
+}
+
+void CollisionTree::buildNode(int firstVolume, int endVolume, int depth)
+{
+   const int nodeNum = static_cast<int>(nodes.size());
+   nodes.push_back(Node());
+
+   Node node;
+   node.firstVolume = firstVolume;
+   node.volumeCount = endVolume - firstVolume;
+   node.bounds = volumes[firstVolume].area;
+   for(int volumeNum = firstVolume; volumeNum < endVolume; ++volumeNum)
+   {
+      const shapes::Rectangle& area = volumes[volumeNum].area;
+      node.bounds.top = std::min(node.bounds.top, area.top);
+      node.bounds.left = std::min(node.bounds.left, area.left);
+      node.bounds.bottom = std::max(node.bounds.bottom, area.bottom);
+      node.bounds.right = std::max(node.bounds.right, area.right);
+      node.kinds |= 1 << volumes[volumeNum].kind;
+   }
+
+   // Leaves are kept shallow enough for the queries' fixed stack
+   if(node.volumeCount > LEAF_SIZE && depth < MAX_DEPTH - 1)
+   {
+      // Splitting the longer side down the middle keeps the children's bounds from overlapping much
+      const int middleVolume = firstVolume + node.volumeCount / 2;
+      const bool splitAcross = node.bounds.right - node.bounds.left >= node.bounds.bottom - node.bounds.top;
+      std::nth_element(volumes.begin() + firstVolume, volumes.begin() + middleVolume, volumes.begin() + endVolume, splitAcross ? isLeftOf : isAbove);
+
+      buildNode(firstVolume, middleVolume, depth + 1);
+      node.secondChild = static_cast<int>(nodes.size());
+      buildNode(middleVolume, endVolume, depth + 1);
+   }
+
+   nodes[nodeNum] = node;
+}
+
+bool CollisionTree::isEmpty() const
+{
+   return nodes.empty();
+}
+
+bool CollisionTree::intersects(const shapes::Rectangle& area, Kind kind) const
+{
+   if(nodes.empty()) return false;
+
+   const int kindBit = 1 << kind;
+   int stack[MAX_DEPTH];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+   while(stackSize > 0)
+   {
+      const int nodeNum = stack[--stackSize];
+      const Node& node = nodes[nodeNum];
+      if((node.kinds & kindBit) == 0 || !node.bounds.intersects(area)) continue;
+
+      if(node.secondChild >= 0)
+      {
+         stack[stackSize++] = node.secondChild;
+         stack[stackSize++] = nodeNum + 1;
+         continue;
+      }
+
+      for(int volumeNum = node.firstVolume; volumeNum < node.firstVolume + node.volumeCount; ++volumeNum)
+      {
+         if(volumes[volumeNum].kind == kind && volumes[volumeNum].area.intersects(area))
+         {
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+void CollisionTree::findIntersecting(const shapes::Rectangle& area, Kind kind, std::vector<const Volume*>& found) const
+{
+   if(nodes.empty()) return;
+
+   const int kindBit = 1 << kind;
+   int stack[MAX_DEPTH];
+   int stackSize = 0;
+   stack[stackSize++] = 0;
+   while(stackSize > 0)
+   {
+      const int nodeNum = stack[--stackSize];
+      const Node& node = nodes[nodeNum];
+      if((node.kinds & kindBit) == 0 || !node.bounds.intersects(area)) continue;
+
+      if(node.secondChild >= 0)
+      {
+         stack[stackSize++] = node.secondChild;
+         stack[stackSize++] = nodeNum + 1;
+         continue;
+      }
+
+      for(int volumeNum = node.firstVolume; volumeNum < node.firstVolume + node.volumeCount; ++volumeNum)
+      {
+         if(volumes[volumeNum].kind == kind && volumes[volumeNum].area.intersects(area))
+         {
+            found.push_back(&volumes[volumeNum]);
+         }
+      }
+   }
+}
@@ -0,0 +1,135 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef COLLISION_TREE_H
+#define COLLISION_TREE_H
+
+#include <string>
+#include <vector>
+#include "Rectangle.h"
+
+/**
+ * The CollisionTree is a bounding volume hierarchy over the rectangles on a map that don't line up with its tiles,
+ * such as fences, tables and trigger zones. It is built once, when the map is loaded, and never changes.
+ *
+ * Each node of the tree bounds a group of volumes, and is split into two halves (along the longer side of the group)
+ * until the groups are small enough to test one volume at a time. A query only descends into the nodes whose bounds it overlaps,
+ * so exact collision checks against the volumes cost about as much as a few rectangle tests, however many volumes the map has.
+ *
+ * The nodes are stored depth first, with each node's first child right after it, so a query walks the array mostly in order.
+ */
+class CollisionTree
+{
+   public:
+      /** What a volume is for. */
+      enum Kind
+      {
+         /** The volume blocks movement, like an obstacle that isn't aligned to the grid. */
+         SOLID,
+         /** The volume doesn't block movement, but scripts can ask what is inside it. */
+         TRIGGER
+      };
+
+      /** A rectangle on the map. */
+      struct Volume
+      {
+         /** The area of the volume (with inclusive edge coordinates in pixels). */
+         shapes::Rectangle area;
+
+         /** What the volume is for. */
+         Kind kind;
+
+         /** The name of the volume, as given in the map file. */
+         std::string name;
+
+         Volume(const shapes::Rectangle& area, Kind kind, const std::string& name) : area(area), kind(kind), name(name) {}
+      };
+
+   private:
+      /** The most volumes kept in a leaf, below which testing each volume is cheaper than splitting the group. */
+      static const int LEAF_SIZE;
+
+      /** The deepest that a query can descend, which is far more than a tree split down the middle ever gets. */
+      static const int MAX_DEPTH;
+
+      /** A node of the tree, bounding a group of volumes. */
+      struct Node
+      {
+         /** The bounds of every volume under the node (with inclusive edge coordinates in pixels). */
+         shapes::Rectangle bounds;
+
+         /** The index of the node's second child, or -1 if the node is a leaf. The first child is the next node. */
+         int secondChild;
+
+         /** The index of the first volume under the node. */
+         int firstVolume;
+
+         /** The number of volumes under the node. */
+         int volumeCount;
+
+         /** The kinds of the volumes under the node, as a set of bits (1 << kind), so that queries for one kind skip the others. */
+         int kinds;
+
+         Node() : bounds(0, 0, -1, -1), secondChild(-1), firstVolume(0), volumeCount(0), kinds(0) {}
+      };
+
+      /** The volumes, in the order that the leaves hold them. */
+      std::vector<Volume> volumes;
+
+      /** The nodes of the tree, depth first. The root is the first node. */
+      std::vector<Node> nodes;
+
+      /**
+       * Builds the node for a group of volumes, and the nodes under it.
+       *
+       * @param firstVolume The index of the first volume in the group.
+       * @param endVolume The index after the last volume in the group.
+       * @param depth The depth of the node.
+       */
+      void buildNode(int firstVolume, int endVolume, int depth);
+
+      /**
+       * @return true iff a volume's centre is to the left of another's.
+       */
+      static bool isLeftOf(const Volume& lhs, const Volume& rhs);
+
+      /**
+       * @return true iff a volume's centre is above another's.
+       */
+      static bool isAbove(const Volume& lhs, const Volume& rhs);
+
+   public:
+      /**
+       * Builds the tree over a set of volumes, replacing whatever it held.
+       *
+       * @param mapVolumes The volumes on the map.
+       */
+      void build(const std::vector<Volume>& mapVolumes);
+
+      /**
+       * @return true iff the tree holds no volumes.
+       */
+      bool isEmpty() const;
+
+      /**
+       * @param area An area (with inclusive edge coordinates in pixels).
+       * @param kind The kind of volume to look for.
+       *
+       * @return true iff any volume of the kind overlaps the area.
+       */
+      bool intersects(const shapes::Rectangle& area, Kind kind) const;
+
+      /**
+       * Finds the volumes of a kind that overlap an area.
+       *
+       * @param area The area to search (with inclusive edge coordinates in pixels).
+       * @param kind The kind of volume to look for.
+       * @param found The volumes found are added to the back of this list.
+       */
+      void findIntersecting(const shapes::Rectangle& area, Kind kind, std::vector<const Volume*>& found) const;
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "CompiledMap.h"
+#include "CompiledMapFormat.h"
+#include "Tileset.h"
+#include "Obstacle.h"
+#include "ResourceLoader.h"
+#include "SDL_endian.h"
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_RES_LOAD;
+
+CompiledMap::CompiledMap(const std::string& name, const std::string& filePath)
+{
+   mapName = name;
+
+   DEBUG("Loading compiled map file %s", filePath.c_str());
+
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+   // The tiles are used straight from the file, so they must already be in the machine's byte order
+   T_T("Compiled maps can only be loaded on little-endian machines.");
+#endif
+
+   mapFile.openAsset(filePath);
+   const char* const data = mapFile.getData();
+   const std::size_t fileSize = mapFile.getSize();
+
+   CompiledMapFormat::Header header;
+   if(fileSize < sizeof(header))
+   {
+      T_T("Compiled map file is too short.");
+   }
+
+   memcpy(&header, data, sizeof(header));
+   if(memcmp(header.magic, CompiledMapFormat::MAGIC, sizeof(header.magic)) != 0)
+   {
+      T_T("File is not a compiled map.");
+   }
+
+   if(header.version != CompiledMapFormat::VERSION || header.chunkSize != CHUNK_SIZE)
+   {
+      DEBUG("Compiled map has version %u and chunk size %d", header.version, header.chunkSize);
+      T_T("Compiled map was written for a different version of the engine and must be recompiled.");
+   }
+
+   // The whole header is checked before anything is sized from it, so that a corrupt file can't ask for a huge (or negative) map
+   if(header.fileSize != fileSize || header.width <= 0 || header.height <= 0
+         || header.tilesOffset > fileSize || header.tilesOffset % sizeof(Sint32) != 0 || header.passabilityOffset > fileSize)
+   {
+      T_T("Compiled map file is corrupt.");
+   }
+
+   // The chunk counts are checked against the chunks that fit in the file by division, so that they can't overflow
+   const std::size_t chunksAcross = (static_cast<std::size_t>(header.width) + CHUNK_SIZE - 1) / CHUNK_SIZE;
+   const std::size_t chunksDown = (static_cast<std::size_t>(header.height) + CHUNK_SIZE - 1) / CHUNK_SIZE;
+   const std::size_t chunksInFile = (fileSize - header.tilesOffset) / (CHUNK_SIZE * CHUNK_SIZE * sizeof(Sint32));
+   if(chunksAcross > chunksInFile || chunksDown > chunksInFile / chunksAcross
+         || (static_cast<std::size_t>(header.width) * header.height + 7) / 8 > fileSize - header.passabilityOffset)
+   {
+      T_T("Compiled map file is corrupt.");
+   }
+
+   width = header.width;
+   height = header.height;
+   initializeChunks();
+
+   std::size_t offset = header.propertiesOffset;
+   for(Uint32 i = 0; i < header.propertyCount; ++i)
+   {
+      const std::string propertyName = readString(offset);
+      properties[propertyName] = readString(offset);
+   }
+
+   tilesetName = getProperty("tilesetName");
+   tileset = tilesetName.empty() ? NULL : ResourceLoader::getTileset(tilesetName);
+
+   if(tileset == NULL)
+   {
+      T_T("Map doesn't contain a tileset.");
+   }
+
+   tileset->acquire();
+
+   offset = header.obstaclesOffset;
+   for(Uint32 i = 0; i < header.obstacleCount; ++i)
+   {
+      const std::string obstacleSheetName = readString(offset);
+      const std::string obstacleSpriteType = readString(offset);
+      const std::string obstacleSpriteName = readString(offset);
+      const int obstacleWidth = static_cast<Sint32>(readNumber(offset));
+      const int obstacleHeight = static_cast<Sint32>(readNumber(offset));
+      const int tileX = static_cast<Sint32>(readNumber(offset));
+      const int tileY = static_cast<Sint32>(readNumber(offset));
+
+      Spritesheet* obstacleSheet = ResourceLoader::getSpritesheet(obstacleSheetName);
+      obstacles.push_back(new Obstacle(tileX, tileY, obstacleWidth, obstacleHeight, obstacleSheet, obstacleSpriteType, obstacleSpriteName));
+   }
+
+   // The passability bitset is laid out the same way as the map's own, so it is used straight from the file too
+   passibility = reinterpret_cast<const unsigned char*>(data + header.passabilityOffset);
+
+   // The file stays mapped for as long as the map exists, so the chunks can point right into it.
+   // This is done last, since the map can't release chunks that it doesn't own if loading fails.
+   const int* const tiles = reinterpret_cast<const int*>(data + header.tilesOffset);
+   for(std::size_t chunkNum = 0; chunkNum < chunks.size(); ++chunkNum)
+   {
+      chunks[chunkNum] = const_cast<int*>(tiles + chunkNum * CHUNK_SIZE * CHUNK_SIZE);
+   }
+
+   DEBUG("Compiled map loaded.");
+}
+
+Uint32 CompiledMap::readNumber(std::size_t& offset) const
+{
+   if(offset + sizeof(Uint32) > mapFile.getSize())
+   {
+      T_T("Compiled map file is corrupt.");
+   }
+
+   Uint32 number;
+   memcpy(&number, mapFile.getData() + offset, sizeof(number));
+   offset += sizeof(number);
+   return SDL_SwapLE32(number);
+}
+
+std::string CompiledMap::readString(std::size_t& offset) const
+{
+   const Uint32 length = readNumber(offset);
+   if(offset + length > mapFile.getSize())
+   {
+      T_T("Compiled map file is corrupt.");
+   }
+
+   const std::string result(mapFile.getData() + offset, length);
+   offset += length;
+   return result;
+}
+
+CompiledMap::~CompiledMap()
+{
+   // The chunks belong to the mapped file, not the map
+   chunks.assign(chunks.size(), static_cast<int*>(NULL));
+}
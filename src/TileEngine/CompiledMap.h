@@ -0,0 +1,60 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef COMPILED_MAP_H
+#define COMPILED_MAP_H
+
+#include <string>
+#include "Map.h"
+#include "MappedFile.h"
+#include "SDL_stdinc.h"
+
+/**
+ * A map loaded from a compiled map (.edm) file, as written by the map compiler.
+ * The file is mapped into memory, and the map's chunks point straight into it,
+ * so loading the map only costs reading the header, properties and passability.
+ * The operating system pages the tiles in as they are drawn, so the map doesn't stream its own chunks.
+ */
+class CompiledMap : public Map
+{
+   /** The contents of the compiled map file. */
+   MappedFile mapFile;
+
+   /**
+    * Reads a little-endian 32-bit number from the file.
+    *
+    * @param offset The file offset of the number, which is moved past it.
+    *
+    * @return The number.
+    */
+   Uint32 readNumber(std::size_t& offset) const;
+
+   /**
+    * Reads a string (a 32-bit length followed by its characters) from the file.
+    *
+    * @param offset The file offset of the string, which is moved past it.
+    *
+    * @return The string.
+    */
+   std::string readString(std::size_t& offset) const;
+
+   public:
+
+      /**
+       * Constructor. Loads map data from a compiled map file.
+       *
+       * @param name The name of the map.
+       * @param filePath The path to the compiled map file.
+       */
+      CompiledMap(const std::string& name, const std::string& filePath);
+
+      /**
+       * Destructor.
+       */
+      ~CompiledMap();
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef COMPILED_MAP_FORMAT_H
+#define COMPILED_MAP_FORMAT_H
+
+#include "SDL_stdinc.h"
+
+/**
+ * The layout of compiled map (.edm) files, which are written by the map compiler and loaded by CompiledMap.
+ * Every number in the file is stored in little-endian byte order. The file is laid out as:
+ *
+ * - The header below.
+ * - The map properties: for each property, a 32-bit name length, the name, a 32-bit value length and the value.
+ * - The tiles (4-byte aligned): a 32-bit tile number for every tile, grouped into chunks of
+ *   chunkSize x chunkSize tiles in chunk order, so that each chunk can be used straight from the file.
+ *   Tiles of partial chunks past the edges of the map are -1.
+ * - The obstacles: for each obstacle, its spritesheet name, sprite type and sprite name
+ *   (each as a 32-bit length followed by the characters), then its 32-bit width, height, x and y (in tiles).
+ * - The passability bitset: one bit per tile in row order, set iff the tile is passable.
+ *   Bit i of the bitset is bit (i % 8) of byte (i / 8).
+ */
+namespace CompiledMapFormat
+{
+   /** The characters that every compiled map file starts with. */
+   static const char MAGIC[4] = { 'E', 'D', 'M', '\0' };
+
+   /** The version of the format; files written with any other version must be recompiled. */
+   static const Uint32 VERSION = 1;
+
+   /** The width and height (in tiles) of the chunks that tiles are grouped into. */
+   static const Sint32 CHUNK_SIZE = 32;
+
+   /** The header at the start of every compiled map file. */
+   struct Header
+   {
+      /** The characters in MAGIC. */
+      char magic[4];
+
+      /** The format version that the file was written with. */
+      Uint32 version;
+
+      /** Width (in tiles) of the map. */
+      Sint32 width;
+
+      /** Height (in tiles) of the map. */
+      Sint32 height;
+
+      /** The width and height (in tiles) of the map's chunks. */
+      Sint32 chunkSize;
+
+      /** The number of map properties. */
+      Uint32 propertyCount;
+
+      /** The file offset of the map properties. */
+      Uint32 propertiesOffset;
+
+      /** The file offset of the tiles. */
+      Uint32 tilesOffset;
+
+      /** The number of obstacles. */
+      Uint32 obstacleCount;
+
+      /** The file offset of the obstacles. */
+      Uint32 obstaclesOffset;
+
+      /** The file offset of the passability bitset. */
+      Uint32 passabilityOffset;
+
+      /** The size of the whole file. */
+      Uint32 fileSize;
+   };
+}
+
+#endif
@@ -9,17 +9,33 @@
 #include "Container.h"
 #include "Scheduler.h"
 #include "ScriptEngine.h"
+#include "GraphicsUtil.h"
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_DIA_CONTR;
 
-DialogueController::DialogueThread::DialogueThread(DialogueController& controller) : dialogueController(controller)
+DialogueController::RevealSequence::RevealSequence(DialogueController& controller) : dialogueController(controller), embeddedScript(NULL)
 {
 }
 
-bool DialogueController::DialogueThread::resume(long timePassed)
+bool DialogueController::RevealSequence::step(long timePassed)
 {
-   return dialogueController.resume(timePassed);
+   SEQUENCE_BEGIN();
+
+   for(;;)
+   {
+      embeddedScript = dialogueController.resume(timePassed);
+      if(embeddedScript != NULL)
+      {
+         SEQUENCE_JOIN(embeddedScript);
+      }
+      else
+      {
+         SEQUENCE_YIELD();
+      }
+   }
+
+   SEQUENCE_END();
 }
 
 DialogueController::DialogueController(edwt::Container& top, Scheduler& scheduler, ScriptEngine& engine)
@@ -28,7 +44,8 @@ DialogueController::DialogueController(edwt::Container& top, Scheduler& schedule
    initMainDialogue();
    clearDialogue();
 
-   scheduler.start(new DialogueThread(*this));
+   // The player is reading the dialogue, so it is revealed by a sequence, which gets its step even when the scheduler is short of time
+   scheduler.start(new RevealSequence(*this));
 }
 
 void DialogueController::initMainDialogue()
@@ -45,16 +62,13 @@ void DialogueController::initMainDialogue()
 
 void DialogueController::addLine(LineType type, const char* speech, Task* task)
 {
-   Line* nextLine = new Line(type, speech, task);
+   lines.push_back(Line(type, speech, task));
+   lines.back().compileScripts(scriptEngine);
    if(currLine == NULL)
    {
-      currLine = nextLine;
+      currLine = &lines.front();
       setDialogue(type);
    }
-   else
-   {
-      lineQueue.push(nextLine);
-   }
 }
 
 void DialogueController::narrate(const char* speech, Task* task)
@@ -92,6 +106,13 @@ void DialogueController::setDialogue(LineType type)
          mainDialogue->setVisible(true);
       }   
    }
+
+   // The line is only split into rows and measured once; it is revealed from here by changing how much of it is drawn
+   mainDialogue->setText(currLine->dialogue);
+   mainDialogue->setRevealedLength(0);
+   charsShown = 0;
+
+   GraphicsUtil::getInstance()->invalidateGUI();
 }
 
 void DialogueController::setFastModeEnabled(bool enabled)
@@ -104,34 +125,34 @@ void DialogueController::setFastModeEnabled(bool enabled)
    fastMode = enabled;
 }
 
-void DialogueController::advanceDialogue()
+Thread* DialogueController::advanceDialogue()
 {
-   // See if we ran over any embedded scripts that we should execute
-   unsigned int openIndex, closeIndex;
-   if(currLine->getNextBracketPair(openIndex, closeIndex))
+   // See if we ran over an embedded script that we should execute; the text stops there until
+   // the script is done, and then any other script found at that point is run in turn
+   Thread* embeddedScript = NULL;
+   unsigned int scriptOffset;
+   if(currLine->getNextScriptOffset(scriptOffset) && scriptOffset <= charsToShow)
    {
-      // If there is a bracket pair coming up and we're past the point of the
-      // open bracket, then extract the script string and run it
-      if(openIndex <= charsToShow)
-      {
-         charsToShow = openIndex;
-         std::string script = currLine->removeNextScriptString();
-         scriptEngine.runScriptString(script);
-      }
+      charsToShow = scriptOffset;
+      embeddedScript = scriptEngine.startScriptString(currLine->popNextScript());
    }
 
-   std::string dialogue = currLine->dialogue;
-
    // If we have run to the end of the dialogue, we show all the text
    // and signal that the associated task is done.
-   if(dialogue.size() <= charsToShow)
+   if(currLine->dialogue.size() <= charsToShow)
    {
-      charsToShow = dialogue.size();
+      charsToShow = currLine->dialogue.size();
    }
 
    // Display the necessary piece of text in the text box
-   dialogue = dialogue.substr(0, charsToShow);
-   mainDialogue->setText(dialogue);
+   if(charsToShow != charsShown)
+   {
+      mainDialogue->setRevealedLength(charsToShow);
+      charsShown = charsToShow;
+      GraphicsUtil::getInstance()->invalidateGUI();
+   }
+
+   return embeddedScript;
 }
 
 bool DialogueController::dialogueComplete()
@@ -148,15 +169,21 @@ void DialogueController::clearDialogue()
 {
    dialogueTime = getMillisecondsPerCharacter();
    charsToShow = 0;
+   charsShown = 0;
 
    if(currLine)
    {
-      currLine->task->signal();
-      delete currLine;
+      if(currLine->task)
+      {
+         currLine->task->signal();
+      }
+
+      lines.pop_front();
       currLine = NULL;
    }
 
    mainDialogue->setText("");
+   GraphicsUtil::getInstance()->invalidateGUI();
 }
 
 int DialogueController::getMillisecondsPerCharacter()
@@ -180,20 +207,16 @@ bool DialogueController::nextLine()
    // If the dialogue is finished, clear the dialogue box and 
    // move on to the next line
    clearDialogue();
-   if(lineQueue.empty())
-   {
-      currLine = NULL;
-   }
-   else
+   if(!lines.empty())
    {
-      currLine = lineQueue.front();
-      lineQueue.pop();
+      currLine = &lines.front();
+      setDialogue(currLine->type);
    }
 
    return true;
 }
 
-bool DialogueController::resume(long timePassed)
+Thread* DialogueController::resume(long timePassed)
 {
    if(hasDialogue() && !dialogueComplete())
    {
@@ -204,84 +227,87 @@ bool DialogueController::resume(long timePassed)
          ++charsToShow;
       }
 
-      advanceDialogue();
+      return advanceDialogue();
    }
 
-   return false;
+   return NULL;
 }
 
-DialogueController::Line::Line(LineType type, const std::string& dialogue, Task* task)
-                    : type(type), dialogue(dialogue), task(task)
+DialogueController::Line::Line(LineType type, const std::string& speech, Task* task)
+                    : nextMarker(0), type(type), task(task)
 {
-   int openIndex = 0;
-   int closeIndex = 0;
+   std::string::size_type start = 0;
 
    for(;;)
    {
-      int nextOpenIndex = dialogue.find('<', openIndex+1);
-      int nextCloseIndex = dialogue.find('>', closeIndex+1);
+      const std::string::size_type openIndex = speech.find('<', start);
+      const std::string::size_type closeIndex = speech.find('>', start);
 
-      if(nextOpenIndex < 0)
+      if(openIndex == std::string::npos)
       {
-         if(nextCloseIndex >= 0)
+         if(closeIndex != std::string::npos)
          {
             T_T("Extra '>' character detected in dialogue line."
                 " Please balance your dialogue script brackets (< and >).");
          }
 
+         dialogue.append(speech, start, std::string::npos);
          break;
       }
-      else if(nextCloseIndex < 0)
+      else if(closeIndex == std::string::npos)
       {
          T_T("Found '<' without matching '>' in dialogue line."
             " Please balance your dialogue script brackets ('<' and '>').");
       }
-      else if(nextCloseIndex < nextOpenIndex)
+      else if(closeIndex < openIndex)
       {
          T_T("Found extra '>' character in dialogue line."
             " Please balance your dialogue script brackets ('<' and '>').");
       }
-      else if(nextOpenIndex < closeIndex)
+      else if(speech.find('<', openIndex + 1) < closeIndex)
       {
          T_T("Found nested '<' character in dialogue line."
             " Please revise the line to remove nested brackets ('<' and '>').");
       }
-      else
-      {
-         openIndex = nextOpenIndex;
-         closeIndex = nextCloseIndex;
-         openScriptBrackets.push(openIndex);
-         closeScriptBrackets.push(closeIndex);
-         DEBUG("Found embedded script starting at %d, ending at %d", openIndex, closeIndex); 
-      }
+
+      // The script is taken out of the dialogue here, so it is noted by where it falls in what is left
+      dialogue.append(speech, start, openIndex - start);
+      scriptMarkers.push_back(ScriptMarker(dialogue.size(), speech.substr(openIndex + 1, closeIndex - openIndex - 1)));
+      DEBUG("Found embedded script %s at %d", scriptMarkers.back().script.c_str(), scriptMarkers.back().glyphOffset);
+
+      start = closeIndex + 1;
    }
 }
 
-bool DialogueController::Line::getNextBracketPair(unsigned int& openIndex, unsigned int& closeIndex)
+DialogueController::Line::ScriptMarker::ScriptMarker(unsigned int glyphOffset, const std::string& script)
+                    : glyphOffset(glyphOffset), script(script)
 {
-   if(openScriptBrackets.empty())
+}
+
+void DialogueController::Line::compileScripts(ScriptEngine& scriptEngine)
+{
+   for(std::vector<ScriptMarker>::const_iterator iter = scriptMarkers.begin(); iter != scriptMarkers.end(); ++iter)
    {
-      return false;
+      scriptEngine.compileScriptString(iter->script);
    }
+}
 
-   openIndex = openScriptBrackets.front();
-   closeIndex = closeScriptBrackets.front();
+bool DialogueController::Line::getNextScriptOffset(unsigned int& glyphOffset) const
+{
+   if(nextMarker >= scriptMarkers.size())
+   {
+      return false;
+   }
 
+   glyphOffset = scriptMarkers[nextMarker].glyphOffset;
    return true;
 }
 
-std::string DialogueController::Line::removeNextScriptString()
+const std::string& DialogueController::Line::popNextScript()
 {
-   unsigned int openIndex, closeIndex;
-   getNextBracketPair(openIndex, closeIndex);
-
-   openScriptBrackets.pop();
-   closeScriptBrackets.pop();
-
-   const int scriptLength = closeIndex - openIndex;
-   std::string script = dialogue.substr(openIndex + 1, scriptLength - 1);
-   dialogue.replace(openIndex, scriptLength + 1, "");
+   const std::string& script = scriptMarkers[nextMarker].script;
+   ++nextMarker;
 
-   DEBUG("Extracting script %s, leaving dialogue %s", script.c_str(), dialogue.c_str());
+   DEBUG("Running embedded script %s", script.c_str());
    return script;
 }
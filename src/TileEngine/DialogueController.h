@@ -7,10 +7,11 @@
 #ifndef DIALOGUE_CONTROLLER_H
 #define DIALOGUE_CONTROLLER_H
 
-#include <queue>
+#include <deque>
 #include <string>
+#include <vector>
 
-#include "Thread.h"
+#include "Sequence.h"
 #include "Task.h"
 
 namespace edwt
@@ -44,25 +45,32 @@ class DialogueController
    typedef edwt::TextBox DialogueBox;
 
    
-   class DialogueThread : public Thread
+   /**
+    * Reveals the dialogue over time, waiting for each embedded script to finish before the dialogue goes on.
+    */
+   class RevealSequence : public Sequence
    {
       DialogueController& dialogueController;
-      
-      public:
+
+      /** The embedded script that the dialogue is waiting for, or NULL if it isn't waiting for one. */
+      Thread* embeddedScript;
+
+      protected:
          /**
-          * Constructor.
+          * Resumes the associated dialogue controller, until the game ends.
           *
-          * @param dialogueController The dialogue controller that this thread should control.
+          * @param timePassed The number of milliseconds that has passed since the last frame.
+          * @return false only, since the dialogue is revealed until end-of-life
           */
-         DialogueThread(DialogueController& dialogueController);
-         
+         bool step(long timePassed);
+
+      public:
          /**
-          * Resumes the associated dialogue controller.
+          * Constructor.
           *
-          * @param timePassed The number of milliseconds that has passed since the last frame.
-          * @return the result of the parent dialogue controller's resumption
+          * @param dialogueController The dialogue controller that this sequence should control.
           */
-         bool resume(long time);
+         RevealSequence(DialogueController& dialogueController);
    };
 
    /**
@@ -84,45 +92,68 @@ class DialogueController
     */
    class Line
    {
-      /** A queue of upcoming open script brackets ('<' characters) */
-      std::queue<int> openScriptBrackets;
+      /** An embedded script, and where it falls in the dialogue. */
+      struct ScriptMarker
+      {
+         /** The number of characters of the dialogue to show before the script runs. */
+         unsigned int glyphOffset;
+
+         /** The Lua code of the script. */
+         std::string script;
 
-      /** A queue of upcoming close script brackets ('>' characters) */
-      std::queue<int> closeScriptBrackets;
+         ScriptMarker(unsigned int glyphOffset, const std::string& script);
+      };
+
+      /** The embedded scripts, in the order that they are found in the dialogue. */
+      std::vector<ScriptMarker> scriptMarkers;
+
+      /** The index of the next embedded script to run. */
+      unsigned int nextMarker;
 
       public:
          /** The type of line (how it should be displayed) */
          LineType type;
    
-         /** The dialogue itself. */
+         /** The dialogue itself, with the embedded scripts taken out. */
          std::string dialogue;
    
-         /** The task ID waiting on this particular line of dialogue */
+         /** The task ID waiting on this particular line of dialogue (NULL if nothing waits on it) */
          Task* task;
    
          /**
-          *  Constructor. Initializes values and indexes the locations of
-          *  embedded scripts in the line of dialogue for later use.
+          *  Constructor. Initializes values and takes the embedded scripts
+          *  out of the line of dialogue (noting where they were) for later use.
+          */
+         Line(LineType type, const std::string& speech, Task* task);
+
+         /**
+          *  Compiles the embedded scripts ahead of time, so that running them
+          *  as the line is revealed is only a lookup.
+          *
+          *  @param scriptEngine The script engine that will run the scripts.
           */
-         Line(LineType type, const std::string& dialogue, Task* task);
+         void compileScripts(ScriptEngine& scriptEngine);
 
          /**
-          *  Gets the next embdedded script bracket pair.
+          *  Gets where the next embedded script was found.
           *
-          *  @return true iff there are embedded script brackets left in the string
+          *  @return true iff there are embedded scripts left to run
           */
-         bool getNextBracketPair(unsigned int& openIndex, unsigned int& closeIndex);
+         bool getNextScriptOffset(unsigned int& glyphOffset) const;
 
          /**
-          *  Gets the next embedded script and removes it from the dialogue line.
+          *  Gets the next embedded script and moves past it.
           *
-          *  @return the script string removed from the dialogue line
+          *  @return the next embedded script
           */
-         std::string removeNextScriptString();
+         const std::string& popNextScript();
    };
 
-   /** The queue to hold all the pending dialogue sequences. */
-   std::queue<Line*> lineQueue;
+   /**
+    * The current line of dialogue (at the front, if there is one) and the pending ones after it.
+    * The lines are stored by value, so that a conversation queued all at once doesn't allocate each of its lines.
+    */
+   std::deque<Line> lines;
 
    /** The script engine to call when embedded instructions are found */
    ScriptEngine& scriptEngine;
@@ -144,12 +175,17 @@ class DialogueController
     */
    unsigned int charsToShow;
 
+   /**
+    * The number of characters that the dialogue box was last told to show.
+    */
+   unsigned int charsShown;
+
    /**
     * True iff the user has indicated that dialogue should flow more quickly.
     */
    bool fastMode;
 
-   /** The current line of dialogue */
+   /** The current line of dialogue (the front of the lines), or NULL if there is none */
    Line* currLine;
 
    /**
@@ -164,12 +200,17 @@ class DialogueController
 
    /**
     * Refresh the dialogue box to show enough letters on the screen for the amount of time passed.
+    * The whole line is laid out when it is first shown, so this only changes how much of it is revealed.
+    * The text stops at the next embedded script, if it has been reached, and the script is started.
+    *
+    * @return The embedded script that was started, or NULL if none was reached.
     */
-   void advanceDialogue();
+   Thread* advanceDialogue();
 
    /**
     * Set the current line to be a narration or speech;
-    * alter the dialogue box accordingly.
+    * alter the dialogue box accordingly, and lay out the current line's text in it
+    * (hidden until it is revealed by advanceDialogue).
     *
     * @param type The type of line that will be shown.
     */
@@ -181,7 +222,7 @@ class DialogueController
     *
     * @param type The type of line that will be enqueued.
     * @param speech The speech to enqueue in the dialogue controller. 
-    * @param task The ticket to be signalled when the line is finished
+    * @param task The ticket to be signalled when the line is finished (or NULL)
     */
    void addLine(LineType type, const char* speech, Task* task);
 
@@ -225,7 +266,7 @@ class DialogueController
        * Enqueue a line of speech said by a character.
        *
        * @param speech The dialogue that will be said.
-       * @param task The ticket of this speech instruction
+       * @param task The ticket of this speech instruction (or NULL)
        */
       void say(const char* speech, Task* task);
    
@@ -233,7 +274,7 @@ class DialogueController
        * Enqueue a line of speech narrated or thought by a character.
        *
        * @param speech The dialogue that will be narrated.
-       * @param task The ticket of this narration instruction
+       * @param task The ticket of this narration instruction (or NULL)
        */
       void narrate(const char* speech, Task* task);
 
@@ -250,9 +291,9 @@ class DialogueController
        * of dialogue to reveal (it is shown letter by letter over time)
        *
        * @param timePassed The number of milliseconds that has passed since the last frame.
-       * @return false only, since this Thread does not end until end-of-life
+       * @return The embedded script that the rest of the line has to wait for, or NULL if there isn't one.
        */
-      bool resume(long time);
+      Thread* resume(long timePassed);
 
 };
 
@@ -12,30 +12,36 @@
 #include "TileState.h"
 #include "Rectangle.h"
 #include "Actor.h"
-#include "SDL_opengl.h"
+#include "FrameProfiler.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_ENTITY_GRID;
 
-//#define DRAW_ENTITY_GRID
-
 // Movement tile size can be set to a divisor of drawn tile size to increase the pathfinding graph size
-// For now, no need for the additional granularity
-const int EntityGrid::MOVEMENT_TILE_SIZE = 16;
+// Maps can ask for finer granularity with the 'movementTileSize' property, but most have no need for it
+const int EntityGrid::DEFAULT_MOVEMENT_TILE_SIZE = 16;
+
+// Four drawn tiles, so that most actor and obstacle footprints fall under one or two coarse cells
+const int EntityGrid::PASSABILITY_PYRAMID_CELL_SIZE = 128;
+
+const int EntityGrid::OCCUPANCY_WORD_BITS = sizeof(EntityGrid::OccupancyWord) * CHAR_BIT;
 
 const float EntityGrid::ROOT_2 = 1.41421356f;
 const float EntityGrid::INFINITY = std::numeric_limits<float>::infinity();
 
-EntityGrid::EntityGrid() : map(NULL), collisionMap(NULL)
+EntityGrid::EntityGrid() : movementTileSize(DEFAULT_MOVEMENT_TILE_SIZE), map(NULL), collisionMap(NULL), collisionRowCapacity(0), collisionTileCapacity(0), occupancyRowWords(0), debugOverlay(NO_OVERLAY)
 {
 }
 
 shapes::Rectangle EntityGrid::getCollisionMapEdges(const shapes::Rectangle& area) const
 {
-   int collisionMapLeft = area.left/MOVEMENT_TILE_SIZE;
-   int collisionMapRight = (area.right - 1)/MOVEMENT_TILE_SIZE;
-   int collisionMapTop = area.top/MOVEMENT_TILE_SIZE;
-   int collisionMapBottom = (area.bottom - 1)/MOVEMENT_TILE_SIZE;
+   int collisionMapLeft = area.left/movementTileSize;
+   int collisionMapRight = (area.right - 1)/movementTileSize;
+   int collisionMapTop = area.top/movementTileSize;
+   int collisionMapBottom = (area.bottom - 1)/movementTileSize;
 
    return shapes::Rectangle(collisionMapTop, collisionMapLeft, collisionMapBottom, collisionMapRight);
 }
@@ -50,20 +56,50 @@ void EntityGrid::setMapData(const Map* newMapData)
    map = newMapData;   
    if(map == NULL) return;
 
-   const int collisionTileRatio = TileEngine::TILE_SIZE / MOVEMENT_TILE_SIZE;
+   // The debug overlay is put aside while the map is read in, and coloured from scratch once it has been
+   const DebugOverlay shownOverlay = debugOverlay;
+   setDebugOverlay(NO_OVERLAY);
+
+   movementTileSize = DEFAULT_MOVEMENT_TILE_SIZE;
+   const std::string movementTileSizeProperty = map->getProperty("movementTileSize");
+   if(!movementTileSizeProperty.empty())
+   {
+      const int requestedTileSize = atoi(movementTileSizeProperty.c_str());
+      if(requestedTileSize > 0 && TileEngine::TILE_SIZE % requestedTileSize == 0)
+      {
+         movementTileSize = requestedTileSize;
+      }
+      else
+      {
+         DEBUG("Ignoring movement tile size %s, which does not divide the drawn tile size.", movementTileSizeProperty.c_str());
+      }
+   }
+
+   const int collisionTileRatio = TileEngine::TILE_SIZE / movementTileSize;
    collisionMapWidth = map->getWidth() * collisionTileRatio;
    collisionMapHeight = map->getHeight() * collisionTileRatio;
 
-   bool** passibilityMap = map->getPassibilityMatrix();
-   collisionMap = new TileState*[collisionMapHeight];
+   occupancyRowWords = (collisionMapWidth + OCCUPANCY_WORD_BITS - 1) / OCCUPANCY_WORD_BITS;
+   occupancyBits.assign(collisionMapHeight * occupancyRowWords, 0);
+
+   // The map's packed passibility is read as it is, one bit per drawn tile
+   const unsigned char* passibility = map->getPassibility();
+   const int mapWidth = map->getWidth();
+   reserveCollisionMap(collisionMapWidth, collisionMapHeight);
    for(int y = 0; y < collisionMapHeight; ++y)
    {
-      TileState* row = collisionMap[y] = new TileState[collisionMapWidth];
+      TileState* row = collisionMap[y];
       for(int x = 0; x < collisionMapWidth; ++x)
       {
-         bool passible = passibilityMap[y / collisionTileRatio][x / collisionTileRatio];
+         const int tileIndex = (y / collisionTileRatio) * mapWidth + x / collisionTileRatio;
+         bool passible = (passibility[tileIndex >> 3] & (1 << (tileIndex & 7))) != 0;
          row[x].entityType = passible ? TileState::FREE : TileState::OBSTACLE;
          row[x].entity = NULL;
+
+         if(!passible)
+         {
+            occupancyBits[y * occupancyRowWords + x / OCCUPANCY_WORD_BITS] |= OccupancyWord(1) << (x % OCCUPANCY_WORD_BITS);
+         }
       }
    }
 
@@ -72,10 +108,54 @@ void EntityGrid::setMapData(const Map* newMapData)
    for(iter = obstacles.begin(); iter != obstacles.end(); ++iter)
    {
       Obstacle* o = *iter;
-      addObstacle(shapes::Point2D(o->getTileX() * MOVEMENT_TILE_SIZE, o->getTileY() * MOVEMENT_TILE_SIZE), o->getWidth(), o->getHeight());
+      // Obstacles are placed and sized in drawn tiles, so that they cover the same area at any movement granularity
+      occupyArea(shapes::Point2D(o->getTileX() * TileEngine::TILE_SIZE, o->getTileY() * TileEngine::TILE_SIZE), o->getWidth() * TileEngine::TILE_SIZE, o->getHeight() * TileEngine::TILE_SIZE, TileState(TileState::OBSTACLE));
+   }
+
+   // The tiles that a solid volume covers completely are obstacles like any other, so that the pathfinder routes around them;
+   // the tiles on its edges stay free, and the tree is checked for them instead
+   const std::vector<CollisionTree::Volume>& volumes = map->getCollisionVolumes();
+   collisionTree.build(volumes);
+   for(std::vector<CollisionTree::Volume>::const_iterator iter = volumes.begin(); iter != volumes.end(); ++iter)
+   {
+      if(iter->kind != CollisionTree::SOLID) continue;
+
+      const shapes::Rectangle coveredTiles(std::max((iter->area.top + movementTileSize - 1) / movementTileSize, 0),
+                                           std::max((iter->area.left + movementTileSize - 1) / movementTileSize, 0),
+                                           std::min((iter->area.bottom + 1) / movementTileSize - 1, collisionMapHeight - 1),
+                                           std::min((iter->area.right + 1) / movementTileSize - 1, collisionMapWidth - 1));
+      if(coveredTiles.left <= coveredTiles.right && coveredTiles.top <= coveredTiles.bottom)
+      {
+         setArea(coveredTiles, TileState(TileState::OBSTACLE));
+      }
    }
 
-   pathfinder.initialize(collisionMap, MOVEMENT_TILE_SIZE, collisionMapWidth, collisionMapHeight);
+   int pyramidLevelCount = 1;
+   for(int cellSize = movementTileSize; cellSize < PASSABILITY_PYRAMID_CELL_SIZE; cellSize *= 2)
+   {
+      ++pyramidLevelCount;
+   }
+
+   passabilityPyramid.build(collisionMap, collisionMapWidth, collisionMapHeight, pyramidLevelCount);
+
+   const std::string searchMode = map->getProperty("pathfinding");
+   if(searchMode == "jps")
+   {
+      pathfinder.setSearchMode(Pathfinder::JUMP_POINT_SEARCH);
+   }
+   else if(searchMode == "astar")
+   {
+      pathfinder.setSearchMode(Pathfinder::A_STAR_SEARCH);
+   }
+   else
+   {
+      pathfinder.setSearchMode(Pathfinder::getDefaultSearchMode());
+   }
+
+   pathfinder.initialize(collisionMap, &passabilityPyramid, movementTileSize, collisionMapWidth, collisionMapHeight);
+   actorIndex.resize(collisionMapWidth * movementTileSize, collisionMapHeight * movementTileSize);
+   triggerZones.resize(collisionMapWidth * movementTileSize, collisionMapHeight * movementTileSize);
+   setDebugOverlay(shownOverlay);
 }
 
 std::string EntityGrid::getName() const
@@ -85,6 +165,16 @@ std::string EntityGrid::getName() const
    T_T("Requested map name when map does not exist.");
 }
 
+ActorTable& EntityGrid::getActorTable()
+{
+   return actorTable;
+}
+
+const ActorTable& EntityGrid::getActorTable() const
+{
+   return actorTable;
+}
+
 int EntityGrid::getWidth() const
 {
    if(map) return map->getWidth();
@@ -109,13 +199,20 @@ bool EntityGrid::withinMap(const int x, const int y) const
    return map != NULL && x >= 0 && x < getWidth() * TileEngine::TILE_SIZE && y >= 0 && y < getHeight() * TileEngine::TILE_SIZE;
 }
 
-void EntityGrid::step(long timePassed)
+void EntityGrid::step(long timePassed, const shapes::Rectangle& visibleArea)
 {
-   if(map) map->step(timePassed);
+   if(map) map->step(timePassed, visibleArea);
+}
+
+void EntityGrid::processPathRequests()
+{
+   PROFILE_ZONE("EntityGrid::processPathRequests");
+   pathfinder.processPathRequests();
 }
 
 EntityGrid::Path EntityGrid::findBestPath(const shapes::Point2D& src, const shapes::Point2D& dst)
 {
+   PROFILE_ZONE("EntityGrid::findBestPath");
    return pathfinder.findBestPath(src, dst);
 }
 
@@ -124,14 +221,96 @@ EntityGrid::Path EntityGrid::findReroutedPath(const shapes::Point2D& src, const
    return pathfinder.findReroutedPath(*this, src, dst, width, height);
 }
 
+bool EntityGrid::findFlowWaypoint(const shapes::Point2D& goal, const shapes::Point2D& location, int width, int height, shapes::Point2D& waypoint)
+{
+   return pathfinder.findFlowWaypoint(goal, location, width, height, waypoint);
+}
+
+EntityGrid::PathRequestId EntityGrid::requestBestPath(const shapes::Point2D& src, const shapes::Point2D& dst)
+{
+   return pathfinder.requestBestPath(src, dst);
+}
+
+EntityGrid::PathRequestId EntityGrid::requestReroutedPath(const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height)
+{
+   return pathfinder.requestReroutedPath(*this, src, dst, width, height);
+}
+
+bool EntityGrid::collectPath(PathRequestId requestId, Path& path)
+{
+   return pathfinder.collectPath(requestId, path);
+}
+
+EntityGrid::WaypointList EntityGrid::compactPath(const shapes::Point2D& src, const Path& path) const
+{
+   return pathfinder.compactPath(src, path);
+}
+
+void EntityGrid::cancelPathRequest(PathRequestId requestId)
+{
+   pathfinder.cancelPathRequest(requestId);
+}
+
+unsigned long EntityGrid::getPathQueryCount() const
+{
+   return pathfinder.getQueryCount();
+}
+
+unsigned long EntityGrid::getPathExpansionCount() const
+{
+   return pathfinder.getExpansionCount();
+}
+
 bool EntityGrid::addObstacle(const shapes::Point2D& area, int width, int height)
 {
-   return occupyArea(area, width, height, TileState(TileState::OBSTACLE));
+   if(occupyArea(area, width, height, TileState(TileState::OBSTACLE)))
+   {
+      const shapes::Rectangle areaRect = getCollisionMapEdges(shapes::Rectangle(area, width, height));
+      passabilityPyramid.update(collisionMap, areaRect);
+      pathfinder.invalidateStaticPaths(areaRect, true);
+      return true;
+   }
+
+   return false;
+}
+
+bool EntityGrid::removeObstacle(const shapes::Point2D& area, int width, int height)
+{
+   if(collisionMap == NULL) return false;
+
+   const shapes::Rectangle areaRect = getCollisionMapEdges(shapes::Rectangle(area, width, height));
+   if(areaRect.left < 0 || areaRect.top < 0 || areaRect.right >= collisionMapWidth || areaRect.bottom >= collisionMapHeight)
+   {
+      return false;
+   }
+
+   for(int collisionMapY = areaRect.top; collisionMapY <= areaRect.bottom; ++collisionMapY)
+   {
+      for(int collisionMapX = areaRect.left; collisionMapX <= areaRect.right; ++collisionMapX)
+      {
+         if(collisionMap[collisionMapY][collisionMapX].entityType != TileState::OBSTACLE)
+         {
+            DEBUG("Couldn't remove obstacle from tiles %d,%d to %d,%d", areaRect.left, areaRect.top, areaRect.right, areaRect.bottom);
+            return false;
+         }
+      }
+   }
+
+   setArea(areaRect, TileState(TileState::FREE));
+   passabilityPyramid.update(collisionMap, areaRect);
+   pathfinder.invalidateStaticPaths(areaRect, false);
+   return true;
 }
 
 bool EntityGrid::addActor(Actor* actor, const shapes::Point2D& area)
 {
-   return occupyArea(area, actor->getWidth(), actor->getHeight(), TileState(TileState::ACTOR, actor));
+   if(occupyArea(area, actor->getWidth(), actor->getHeight(), TileState(TileState::ACTOR, actor)))
+   {
+      indexActor(actor, area);
+      return true;
+   }
+
+   return false;
 }
 
 bool EntityGrid::changeActorLocation(Actor* actor, const shapes::Point2D& dst)
@@ -140,6 +319,7 @@ bool EntityGrid::changeActorLocation(Actor* actor, const shapes::Point2D& dst)
    if(occupyArea(dst, actor->getWidth(), actor->getHeight(), actorState))
    {
       freeArea(actor->getLocation(), dst, actor->getWidth(), actor->getHeight(), actorState);
+      indexActor(actor, dst);
       return true;
    }
 
@@ -149,6 +329,7 @@ bool EntityGrid::changeActorLocation(Actor* actor, const shapes::Point2D& dst)
 void EntityGrid::removeActor(Actor* actor)
 {
    freeArea(actor->getLocation(), actor->getWidth(), actor->getHeight());
+   unindexActor(actor);
 }
 
 Actor* EntityGrid::getAdjacentActor(Actor* actor) const
@@ -168,7 +349,7 @@ Actor* EntityGrid::getAdjacentActor(Actor* actor) const
       case LEFT:
       case DOWN_LEFT:
       {
-         adjacentLocation.x -= MOVEMENT_TILE_SIZE;
+         adjacentLocation.x -= movementTileSize;
          break;
       }
       case UP_RIGHT:
@@ -190,7 +371,7 @@ Actor* EntityGrid::getAdjacentActor(Actor* actor) const
       case UP:
       case UP_LEFT:
       {
-         adjacentLocation.y -= MOVEMENT_TILE_SIZE;
+         adjacentLocation.y -= movementTileSize;
          break;
       }
       case DOWN_LEFT:
@@ -206,10 +387,10 @@ Actor* EntityGrid::getAdjacentActor(Actor* actor) const
       }
    }
 
-   int rectLeft = std::max(0, adjacentLocation.x/MOVEMENT_TILE_SIZE);
-   int rectRight = std::min(collisionMapWidth, (adjacentLocation.x + width - 1)/MOVEMENT_TILE_SIZE);
-   int rectTop = std::max(0, adjacentLocation.y/MOVEMENT_TILE_SIZE);
-   int rectBottom = std::min(collisionMapHeight, (adjacentLocation.y + height - 1)/MOVEMENT_TILE_SIZE);
+   int rectLeft = std::max(0, adjacentLocation.x/movementTileSize);
+   int rectRight = std::min(collisionMapWidth, (adjacentLocation.x + width - 1)/movementTileSize);
+   int rectTop = std::max(0, adjacentLocation.y/movementTileSize);
+   int rectBottom = std::min(collisionMapHeight, (adjacentLocation.y + height - 1)/movementTileSize);
    
    for(int rectY = rectTop; rectY <= rectBottom; ++rectY)
    {
@@ -226,7 +407,7 @@ Actor* EntityGrid::getAdjacentActor(Actor* actor) const
    return NULL;
 }
 
-bool EntityGrid::canOccupyArea(const shapes::Point2D& area, int width, int height, TileState state) const
+bool EntityGrid::canOccupyArea(const shapes::Point2D& area, int width, int height, const TileState& state) const
 {
    if(collisionMap == NULL || state.entityType == TileState::FREE)
    {
@@ -235,24 +416,42 @@ bool EntityGrid::canOccupyArea(const shapes::Point2D& area, int width, int heigh
    
    shapes::Rectangle areaRect = getCollisionMapEdges(shapes::Rectangle(area, width, height));
    
-   if(areaRect.right >= collisionMapWidth || areaRect.bottom >= collisionMapHeight)
+   if(areaRect.left < 0 || areaRect.top < 0 || areaRect.right >= collisionMapWidth || areaRect.bottom >= collisionMapHeight)
    {
       return false;
    }
-   
-   for(int collisionMapY = areaRect.top; collisionMapY <=  areaRect.bottom; ++collisionMapY)
+
+   // Nothing but another obstacle can be placed over an obstacle, which the pyramid can rule out a block at a time
+   if(state.entityType != TileState::OBSTACLE && (passabilityPyramid.containsObstacle(areaRect) || overlapsSolidVolume(area, width, height)))
    {
-      for(int collisionMapX = areaRect.left; collisionMapX <= areaRect.right; ++collisionMapX)
+      return false;
+   }
+
+   return canOccupyTiles(areaRect, state);
+}
+
+bool EntityGrid::canOccupyTiles(const shapes::Rectangle& tiles, TileState state) const
+{
+   const int firstWord = tiles.left / OCCUPANCY_WORD_BITS;
+   const int lastWord = tiles.right / OCCUPANCY_WORD_BITS;
+   for(int collisionMapY = tiles.top; collisionMapY <= tiles.bottom; ++collisionMapY)
+   {
+      const OccupancyWord* rowBits = &occupancyBits[collisionMapY * occupancyRowWords];
+      for(int word = firstWord; word <= lastWord; ++word)
       {
-         // We cannot occupy the point if it is reserved by an entity other than the entity attempting to occupy it.
-         // For instance, we cannot occupy a tile already occupied by an obstacle or a different character.
-         const TileState& collisionTile = collisionMap[collisionMapY][collisionMapX];
-         if(collisionTile.entityType != TileState::FREE)
+         // Free tiles can always be occupied, so only the tiles with their bits set need a closer look.
+         OccupancyWord bits = rowBits[word] & getOccupancyMask(word, tiles.left, tiles.right);
+         for(int collisionMapX = word * OCCUPANCY_WORD_BITS; bits != 0; ++collisionMapX, bits >>= 1)
          {
+            if((bits & 1) == 0) continue;
+
+            // We cannot occupy the point if it is reserved by an entity other than the entity attempting to occupy it.
+            // For instance, we cannot occupy a tile already occupied by an obstacle or a different character.
+            const TileState& collisionTile = collisionMap[collisionMapY][collisionMapX];
             if(collisionTile.entityType != state.entityType || collisionTile.entity != state.entity)
             {
                return false;
-            } 
+            }
          }
       }
    }
@@ -266,13 +465,13 @@ bool EntityGrid::occupyArea(const shapes::Point2D& area, int width, int height,
 
    if(canOccupyArea(area, width, height, state))
    {
-      DEBUG("Occupying tiles from %d,%d to %d,%d", areaRect.left, areaRect.top, areaRect.right, areaRect.bottom);
+      TRACE("Occupying tiles from %d,%d to %d,%d", areaRect.left, areaRect.top, areaRect.right, areaRect.bottom);
       
       setArea(areaRect, state);
       return true;
    }
 
-   DEBUG("Couldn't occupy tiles from %d,%d to %d,%d", areaRect.left, areaRect.top, areaRect.right, areaRect.bottom);
+   TRACE("Couldn't occupy tiles from %d,%d to %d,%d", areaRect.left, areaRect.top, areaRect.right, areaRect.bottom);
    return false;
 }
 
@@ -280,7 +479,7 @@ void EntityGrid::freeArea(const shapes::Point2D& locationToFree, int width, int
 {
    shapes::Rectangle rectToFree = getCollisionMapEdges(shapes::Rectangle(locationToFree, width, height));
    
-   DEBUG("Freeing tiles from %d,%d to %d,%d", rectToFree.left, rectToFree.top, rectToFree.right, rectToFree.bottom);
+   TRACE("Freeing tiles from %d,%d to %d,%d", rectToFree.left, rectToFree.top, rectToFree.right, rectToFree.bottom);
    
    setArea(rectToFree, TileState(TileState::FREE));
 }
@@ -299,19 +498,140 @@ bool EntityGrid::isAreaFree(const shapes::Point2D& area, int width, int height)
 
    shapes::Rectangle areaRect = getCollisionMapEdges(shapes::Rectangle(area, width, height));
 
-   for(int collisionMapY = areaRect.top; collisionMapY < areaRect.bottom; ++collisionMapY)
+   if(areaRect.left < 0 || areaRect.top < 0 || areaRect.right >= collisionMapWidth || areaRect.bottom >= collisionMapHeight)
+   {
+      return false;
+   }
+
+   // We cannot occupy the area if any of it is reserved by an obstacle or a character.
+   return !passabilityPyramid.containsObstacle(areaRect) && !overlapsSolidVolume(area, width, height) && isAreaUnoccupied(areaRect);
+}
+
+void EntityGrid::findTriggerVolumes(const shapes::Point2D& area, int width, int height, std::vector<std::string>& names) const
+{
+   std::vector<const CollisionTree::Volume*> triggers;
+   collisionTree.findIntersecting(shapes::Rectangle(area.y, area.x, area.y + height - 1, area.x + width - 1), CollisionTree::TRIGGER, triggers);
+   for(std::vector<const CollisionTree::Volume*>::const_iterator iter = triggers.begin(); iter != triggers.end(); ++iter)
+   {
+      names.push_back((*iter)->name);
+   }
+}
+
+bool EntityGrid::findTriggerVolume(const std::string& name, shapes::Rectangle& area) const
+{
+   if(map == NULL) return false;
+
+   const std::vector<CollisionTree::Volume>& volumes = map->getCollisionVolumes();
+   for(std::vector<CollisionTree::Volume>::const_iterator iter = volumes.begin(); iter != volumes.end(); ++iter)
    {
-      for(int collisionMapX = areaRect.left; collisionMapX < areaRect.right; ++collisionMapX)
+      if(iter->kind == CollisionTree::TRIGGER && iter->name == name)
       {
-         // We cannot occupy the point if it is reserved by an obstacle or a character.
-         const TileState& collisionTile = collisionMap[collisionMapY][collisionMapX];
-         if(collisionTile.entityType != TileState::FREE)
+         area = iter->area;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+TriggerZones& EntityGrid::getTriggerZones()
+{
+   return triggerZones;
+}
+
+bool EntityGrid::overlapsSolidVolume(const shapes::Point2D& area, int width, int height) const
+{
+   return !collisionTree.isEmpty() && collisionTree.intersects(shapes::Rectangle(area.y, area.x, area.y + height - 1, area.x + width - 1), CollisionTree::SOLID);
+}
+
+bool EntityGrid::getOverlapDistances(int start, int size, int direction, int axisDistance, int volumeMin, int volumeMax, int& first, int& last)
+{
+   if(direction == 0 || axisDistance == 0)
+   {
+      first = 0;
+      last = INT_MAX;
+      return start <= volumeMax && start + size - 1 >= volumeMin;
+   }
+
+   // The distances gone along the axis at which the entity overlaps the volume
+   first = direction > 0 ? volumeMin - (start + size - 1) : start - volumeMax;
+   last = direction > 0 ? volumeMax - start : start + size - 1 - volumeMin;
+   if(last < 0 || first > axisDistance) return false;
+
+   // Once the entity has gone the axis distance, it stays put (and keeps overlapping, if it overlaps there)
+   first = std::max(first, 0);
+   if(last >= axisDistance) last = INT_MAX;
+   return true;
+}
+
+int EntityGrid::getDistanceToSolidVolume(const shapes::Point2D& source, int width, int height, int xDirection, int yDirection, int xDistance, int yDistance, int distance) const
+{
+   const shapes::Point2D destination(source.x + xDirection * std::min(distance, xDistance),
+                                     source.y + yDirection * std::min(distance, yDistance));
+   const shapes::Rectangle sweptArea = getSweptArea(source, destination, width, height);
+
+   std::vector<const CollisionTree::Volume*> volumes;
+   collisionTree.findIntersecting(shapes::Rectangle(sweptArea.top, sweptArea.left, sweptArea.bottom - 1, sweptArea.right - 1), CollisionTree::SOLID, volumes);
+
+   for(std::vector<const CollisionTree::Volume*>::const_iterator iter = volumes.begin(); iter != volumes.end(); ++iter)
+   {
+      const shapes::Rectangle& volume = (*iter)->area;
+      int firstX, lastX, firstY, lastY;
+      if(!getOverlapDistances(source.x, width, xDirection, xDistance, volume.left, volume.right, firstX, lastX)) continue;
+      if(!getOverlapDistances(source.y, height, yDirection, yDistance, volume.top, volume.bottom, firstY, lastY)) continue;
+
+      // The entity overlaps the volume once it overlaps along both axes at once
+      const int firstOverlap = std::max(firstX, firstY);
+      if(firstOverlap == 0 || firstOverlap > std::min(lastX, lastY)) continue;
+
+      distance = std::min(distance, firstOverlap - 1);
+   }
+
+   return distance;
+}
+
+EntityGrid::OccupancyWord EntityGrid::getOccupancyMask(int word, int left, int right)
+{
+   const int wordLeft = word * OCCUPANCY_WORD_BITS;
+   const int firstBit = std::max(left - wordLeft, 0);
+   const int lastBit = std::min(right - wordLeft, OCCUPANCY_WORD_BITS - 1);
+
+   // Build the mask from the top down, so that a full word doesn't need a shift by the word size
+   const OccupancyWord allBits = ~OccupancyWord(0);
+   return (allBits >> (OCCUPANCY_WORD_BITS - 1 - lastBit)) & (allBits << firstBit);
+}
+
+void EntityGrid::setAreaOccupancy(const shapes::Rectangle& area, bool occupied)
+{
+   const int firstWord = area.left / OCCUPANCY_WORD_BITS;
+   const int lastWord = area.right / OCCUPANCY_WORD_BITS;
+   for(int collisionMapY = area.top; collisionMapY <= area.bottom; ++collisionMapY)
+   {
+      OccupancyWord* rowBits = &occupancyBits[collisionMapY * occupancyRowWords];
+      for(int word = firstWord; word <= lastWord; ++word)
+      {
+         const OccupancyWord mask = getOccupancyMask(word, area.left, area.right);
+         rowBits[word] = occupied ? (rowBits[word] | mask) : (rowBits[word] & ~mask);
+      }
+   }
+}
+
+bool EntityGrid::isAreaUnoccupied(const shapes::Rectangle& area) const
+{
+   const int firstWord = area.left / OCCUPANCY_WORD_BITS;
+   const int lastWord = area.right / OCCUPANCY_WORD_BITS;
+   for(int collisionMapY = area.top; collisionMapY <= area.bottom; ++collisionMapY)
+   {
+      const OccupancyWord* rowBits = &occupancyBits[collisionMapY * occupancyRowWords];
+      for(int word = firstWord; word <= lastWord; ++word)
+      {
+         if(rowBits[word] & getOccupancyMask(word, area.left, area.right))
          {
             return false;
          }
       }
    }
-   
+
    return true;
 }
 
@@ -326,71 +646,294 @@ void EntityGrid::moveToClosestPoint(Actor* actor, int xDirection, int yDirection
    const int actorWidth = actor->getWidth();
    const int actorHeight = actor->getHeight();
    
-   const int mapPixelWidth = (collisionMapWidth - 1) * MOVEMENT_TILE_SIZE;
-   const int mapPixelHeight = (collisionMapHeight - 1) * MOVEMENT_TILE_SIZE; 
-   
-   shapes::Point2D lastAvailablePoint = source;
-   
-   while(distance > 0)
+   const int mapPixelWidth = (collisionMapWidth - 1) * movementTileSize;
+   const int mapPixelHeight = (collisionMapHeight - 1) * movementTileSize; 
+
+   // Clamp the movement along each axis to the map dimensions
+   int xDistance = 0;
+   if(xDirection != 0)
    {
-      int distanceTraversed = std::min(distance, MOVEMENT_TILE_SIZE / 2);
-      distance -= distanceTraversed;
-      
-      // Get the next point for movement, and clamp it to the map dimensions
-      shapes::Point2D nextPoint;
-      nextPoint.x = lastAvailablePoint.x + xDirection * distanceTraversed;
-      nextPoint.x = std::max(nextPoint.x, 0);
-      nextPoint.x = std::min(nextPoint.x, mapPixelWidth - MOVEMENT_TILE_SIZE);
+      const int destinationX = std::min(std::max(source.x + xDirection * distance, 0), mapPixelWidth - movementTileSize);
+      xDistance = std::max((destinationX - source.x) * xDirection, 0);
+   }
 
-      nextPoint.y = lastAvailablePoint.y + yDirection * distanceTraversed;
-      nextPoint.y = std::max(nextPoint.y, 0);
-      nextPoint.y = std::min(nextPoint.y, mapPixelHeight - MOVEMENT_TILE_SIZE);
+   int yDistance = 0;
+   if(yDirection != 0)
+   {
+      const int destinationY = std::min(std::max(source.y + yDirection * distance, 0), mapPixelHeight - movementTileSize);
+      yDistance = std::max((destinationY - source.y) * yDirection, 0);
+   }
+
+   // The actor's footprint only changes when its leading edge crosses into a new column or row of tiles,
+   // so rather than testing the whole footprint at regular intervals, walk from one crossing to the next
+   // and only test the strip of tiles entered at each crossing.
+   const int totalDistance = std::max(xDistance, yDistance);
+   int distanceTravelled = 0;
+   while(distanceTravelled < totalDistance)
+   {
+      const shapes::Point2D location(source.x + xDirection * std::min(distanceTravelled, xDistance),
+                                     source.y + yDirection * std::min(distanceTravelled, yDistance));
+      const shapes::Rectangle footprint = getCollisionMapEdges(shapes::Rectangle(location, actorWidth, actorHeight));
 
-      if(lastAvailablePoint == nextPoint)
+      int nextColumnDistance = totalDistance + 1;
+      if(xDirection != 0 && distanceTravelled < xDistance)
       {
-         // We haven't moved any further, so we are at a dead end
-         break;
+         nextColumnDistance = distanceTravelled + (xDirection > 0
+               ? (footprint.right + 1) * movementTileSize - (location.x + actorWidth - 1)
+               : location.x - footprint.left * movementTileSize + 1);
+         if(nextColumnDistance > xDistance) nextColumnDistance = totalDistance + 1;
       }
 
-      if(!canOccupyArea(nextPoint, actorWidth, actorHeight, actorState))
+      int nextRowDistance = totalDistance + 1;
+      if(yDirection != 0 && distanceTravelled < yDistance)
       {
+         nextRowDistance = distanceTravelled + (yDirection > 0
+               ? (footprint.bottom + 1) * movementTileSize - (location.y + actorHeight - 1)
+               : location.y - footprint.top * movementTileSize + 1);
+         if(nextRowDistance > yDistance) nextRowDistance = totalDistance + 1;
+      }
+
+      const int crossingDistance = std::min(nextColumnDistance, nextRowDistance);
+      if(crossingDistance > totalDistance)
+      {
+         // The footprint stays on the same tiles for the rest of the way
+         distanceTravelled = totalDistance;
          break;
       }
 
-      lastAvailablePoint = nextPoint;      
-   }
+      const shapes::Point2D crossing(source.x + xDirection * std::min(crossingDistance, xDistance),
+                                     source.y + yDirection * std::min(crossingDistance, yDistance));
+      const shapes::Rectangle nextFootprint = getCollisionMapEdges(shapes::Rectangle(crossing, actorWidth, actorHeight));
+      if(nextFootprint.left < 0 || nextFootprint.top < 0 || nextFootprint.right >= collisionMapWidth || nextFootprint.bottom >= collisionMapHeight)
+      {
+         distanceTravelled = crossingDistance - 1;
+         break;
+      }
 
-   if(lastAvailablePoint != source)
-   {
-      if(!occupyArea(lastAvailablePoint, actor->getWidth(), actor->getHeight(), actorState))
+      bool blocked = false;
+      if(crossingDistance == nextColumnDistance)
       {
-         // If updating failed, just stick with the start location
-         occupyArea(source, actorWidth, actorHeight, actorState);
+         const int column = xDirection > 0 ? nextFootprint.right : nextFootprint.left;
+         blocked = !canOccupyTiles(shapes::Rectangle(nextFootprint.top, column, nextFootprint.bottom, column), actorState);
       }
-      else
+
+      if(!blocked && crossingDistance == nextRowDistance)
       {
-         // If we moved, update the map accordingly
-         freeArea(source, lastAvailablePoint, actorWidth, actorHeight, actorState);
+         const int row = yDirection > 0 ? nextFootprint.bottom : nextFootprint.top;
+         blocked = !canOccupyTiles(shapes::Rectangle(row, nextFootprint.left, row, nextFootprint.right), actorState);
+      }
 
-         actor->setLocation(lastAvailablePoint);
+      if(blocked)
+      {
+         // Stop just short of the tiles in the way
+         distanceTravelled = crossingDistance - 1;
+         break;
       }
+
+      distanceTravelled = crossingDistance;
+   }
+
+   // The tiles only hold the parts of solid volumes that cover them completely, so the edges of the volumes are swept against exactly
+   if(distanceTravelled > 0 && !collisionTree.isEmpty())
+   {
+      distanceTravelled = getDistanceToSolidVolume(source, actorWidth, actorHeight, xDirection, yDirection, xDistance, yDistance, distanceTravelled);
    }
+
+   const shapes::Point2D destination(source.x + xDirection * std::min(distanceTravelled, xDistance),
+                                     source.y + yDirection * std::min(distanceTravelled, yDistance));
+
+   if(destination != source)
+   {
+      // Every tile under the new footprint was already checked, so the actor can be moved directly
+      freeArea(source, destination, actorWidth, actorHeight, actorState);
+
+      actor->setLocation(destination);
+      indexActor(actor, destination);
+   }
+}
+
+bool EntityGrid::isLateralMovement(const shapes::Point2D& src, const shapes::Point2D& dst)
+{
+   return src.x == dst.x || src.y == dst.y;
+}
+
+shapes::Rectangle EntityGrid::getSweptArea(const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height)
+{
+   const shapes::Point2D topLeft(std::min(src.x, dst.x), std::min(src.y, dst.y));
+   return shapes::Rectangle(topLeft, std::abs(src.x - dst.x) + width, std::abs(src.y - dst.y) + height);
 }
 
-bool EntityGrid::beginMovement(Actor* actor, const shapes::Point2D& dst)
+bool EntityGrid::beginMovement(Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst)
 {
-   return occupyArea(dst, actor->getWidth(), actor->getHeight(), TileState(TileState::ACTOR, actor));
+   const TileState actorState(TileState::ACTOR, actor);
+   bool granted;
+   if(!isLateralMovement(src, dst))
+   {
+      granted = occupyArea(dst, actor->getWidth(), actor->getHeight(), actorState);
+   }
+   else
+   {
+      // Reserve every tile between the source and the destination, since the actor passes through all of them
+      const shapes::Rectangle sweptArea = getSweptArea(src, dst, actor->getWidth(), actor->getHeight());
+      granted = occupyArea(shapes::Point2D(sweptArea.left, sweptArea.top), sweptArea.right - sweptArea.left, sweptArea.bottom - sweptArea.top, actorState);
+   }
+
+   if(!granted && debugOverlay == CONGESTION_OVERLAY)
+   {
+      addOverlayHeat(getCollisionMapEdges(isLateralMovement(src, dst)
+            ? getSweptArea(src, dst, actor->getWidth(), actor->getHeight())
+            : shapes::Rectangle(dst, actor->getWidth(), actor->getHeight())));
+   }
+
+   return granted;
+}
+
+void EntityGrid::proposeMovement(Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst, bool& granted)
+{
+   granted = false;
+
+   MovementProposal proposal = { actor, src, dst, &granted };
+   movementProposals.push_back(proposal);
+}
+
+bool EntityGrid::isResolvedBefore(const MovementProposal& lhs, const MovementProposal& rhs)
+{
+   // Actors never overlap, so no two of them can be moving from the same location
+   return lhs.src.y < rhs.src.y || (lhs.src.y == rhs.src.y && lhs.src.x < rhs.src.x);
+}
+
+void EntityGrid::resolveMovements()
+{
+   // When two moves compete for the same tiles, the first one resolved wins
+   std::sort(movementProposals.begin(), movementProposals.end(), isResolvedBefore);
+
+   for(std::vector<MovementProposal>::const_iterator iter = movementProposals.begin(); iter != movementProposals.end(); ++iter)
+   {
+      *iter->granted = beginMovement(iter->actor, iter->src, iter->dst);
+   }
+
+   movementProposals.clear();
+}
+
+Actor* EntityGrid::findActorInTheWay(const Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst) const
+{
+   if(collisionMap == NULL)
+   {
+      return NULL;
+   }
+
+   // Check the same tiles that beginMovement tried to reserve
+   const shapes::Rectangle tiles = getCollisionMapEdges(isLateralMovement(src, dst)
+         ? getSweptArea(src, dst, actor->getWidth(), actor->getHeight())
+         : shapes::Rectangle(dst, actor->getWidth(), actor->getHeight()));
+
+   Actor* actorInTheWay = NULL;
+   for(int collisionMapY = tiles.top; collisionMapY <= tiles.bottom; ++collisionMapY)
+   {
+      for(int collisionMapX = tiles.left; collisionMapX <= tiles.right; ++collisionMapX)
+      {
+         const TileState& collisionTile = collisionMap[collisionMapY][collisionMapX];
+         if(collisionTile.entityType == TileState::OBSTACLE)
+         {
+            // An obstacle won't get out of the way, whatever else is there
+            return NULL;
+         }
+
+         if(collisionTile.entityType == TileState::ACTOR && collisionTile.entity != actor && actorInTheWay == NULL)
+         {
+            actorInTheWay = static_cast<Actor*>(collisionTile.entity);
+         }
+      }
+   }
+
+   return actorInTheWay;
 }
 
 void EntityGrid::abortMovement(Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst)
 {
-   freeArea(src, actor->getLocation(), actor->getWidth(), actor->getHeight(), TileState(TileState::ACTOR, actor));
-   freeArea(dst, actor->getLocation(), actor->getWidth(), actor->getHeight(), TileState(TileState::ACTOR, actor));
+   const TileState actorState(TileState::ACTOR, actor);
+   if(!isLateralMovement(src, dst))
+   {
+      freeArea(src, actor->getLocation(), actor->getWidth(), actor->getHeight(), actorState);
+      freeArea(dst, actor->getLocation(), actor->getWidth(), actor->getHeight(), actorState);
+   }
+   else
+   {
+      setArea(getCollisionMapEdges(getSweptArea(src, dst, actor->getWidth(), actor->getHeight())), TileState(TileState::FREE));
+      setArea(getCollisionMapEdges(shapes::Rectangle(actor->getLocation(), actor->getWidth(), actor->getHeight())), actorState);
+   }
+
+   indexActor(actor, actor->getLocation());
 }
 
 void EntityGrid::endMovement(Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst)
 {
-   freeArea(src, dst, actor->getWidth(), actor->getHeight(), TileState(TileState::ACTOR, actor));
+   const TileState actorState(TileState::ACTOR, actor);
+   if(!isLateralMovement(src, dst))
+   {
+      freeArea(src, dst, actor->getWidth(), actor->getHeight(), actorState);
+   }
+   else
+   {
+      setArea(getCollisionMapEdges(getSweptArea(src, dst, actor->getWidth(), actor->getHeight())), TileState(TileState::FREE));
+      setArea(getCollisionMapEdges(shapes::Rectangle(dst, actor->getWidth(), actor->getHeight())), actorState);
+   }
+
+   indexActor(actor, dst);
+}
+
+/**
+ * @param actorTable The table of actors on the map.
+ * @param actor An actor.
+ *
+ * @return The actor's handle, or INVALID_HANDLE if it isn't in the table.
+ */
+static ActorTable::ActorHandle getActorHandle(const ActorTable& actorTable, const Actor* actor)
+{
+   const ActorTable::ActorId id = actorTable.getId(actor);
+   return id == ActorTable::INVALID_ACTOR ? ActorTable::INVALID_HANDLE : actorTable.getHandle(id);
+}
+
+void EntityGrid::indexActor(Actor* actor, const shapes::Point2D& location)
+{
+   if(triggerZones.isEmpty())
+   {
+      actorIndex.update(actor, location);
+      return;
+   }
+
+   shapes::Rectangle previousArea(0, 0, -1, -1);
+   const bool wasIndexed = actorIndex.getArea(actor, previousArea);
+   actorIndex.update(actor, location);
+
+   const shapes::Rectangle currentArea(location.y, location.x, location.y + actor->getHeight() - 1, location.x + actor->getWidth() - 1);
+   triggerZones.actorMoved(getActorHandle(actorTable, actor), wasIndexed ? &previousArea : NULL, &currentArea);
+}
+
+void EntityGrid::unindexActor(Actor* actor)
+{
+   shapes::Rectangle previousArea(0, 0, -1, -1);
+   if(!triggerZones.isEmpty() && actorIndex.getArea(actor, previousArea))
+   {
+      triggerZones.actorMoved(getActorHandle(actorTable, actor), &previousArea, NULL);
+   }
+
+   actorIndex.remove(actor);
+}
+
+void EntityGrid::findActorsInArea(const shapes::Rectangle& area, std::vector<Actor*>& actors) const
+{
+   actorIndex.findActorsInArea(area, actors);
+}
+
+void EntityGrid::findActorsInRadius(const shapes::Point2D& center, int radius, std::vector<Actor*>& actors) const
+{
+   actorIndex.findActorsInRadius(center, radius, actors);
+}
+
+Actor* EntityGrid::findNearestActor(const shapes::Point2D& point, int maxRadius, const Actor* excludedActor) const
+{
+   return actorIndex.findNearestActor(point, maxRadius, excludedActor);
 }
 
 void EntityGrid::setArea(const shapes::Rectangle& area, TileState state)
@@ -404,83 +947,180 @@ void EntityGrid::setArea(const shapes::Rectangle& area, TileState state)
          collisionMap[collisionMapY][collisionMapX] = state;
       }
    }
+
+   setAreaOccupancy(area, state.entityType != TileState::FREE);
+   pathfinder.markCollisionGridChanged();
+   refreshOverlay(area);
 }
 
-void EntityGrid::draw()
+void EntityGrid::draw(const shapes::Rectangle& visibleArea)
 {
    if(map == NULL) return;
 
-#ifndef DRAW_ENTITY_GRID
-   map->draw();
-#else
-   for(int y = 0; y < collisionMapHeight; ++y)
+   map->draw(shapes::Rectangle(visibleArea.top / TileEngine::TILE_SIZE, visibleArea.left / TileEngine::TILE_SIZE,
+         visibleArea.bottom / TileEngine::TILE_SIZE, visibleArea.right / TileEngine::TILE_SIZE));
+}
+
+void EntityGrid::setDebugOverlay(DebugOverlay overlay)
+{
+   debugOverlay = overlay;
+   resetOverlay();
+}
+
+EntityGrid::DebugOverlay EntityGrid::getDebugOverlay() const
+{
+   return debugOverlay;
+}
+
+void EntityGrid::resetOverlay()
+{
+   const bool drawingHeat = debugOverlay == EXPANSION_OVERLAY || debugOverlay == PATH_CACHE_OVERLAY || debugOverlay == CONGESTION_OVERLAY;
+   if(map == NULL || debugOverlay == NO_OVERLAY)
    {
-      for(int x = 0; x < collisionMapWidth; ++x)
+      overlay.resize(0, 0);
+      overlayHeat.clear();
+      pathfinder.setHeatMaps(NULL, NULL);
+      return;
+   }
+
+   overlay.resize(collisionMapWidth, collisionMapHeight);
+   if(drawingHeat)
+   {
+      overlayHeat.assign(collisionMapWidth * collisionMapHeight, 0);
+   }
+   else
+   {
+      overlayHeat.clear();
+   }
+
+   pathfinder.setHeatMaps(debugOverlay == EXPANSION_OVERLAY ? &overlayHeat : NULL, debugOverlay == PATH_CACHE_OVERLAY ? &overlayHeat : NULL);
+   refreshOverlay(shapes::Rectangle(0, 0, collisionMapHeight - 1, collisionMapWidth - 1));
+}
+
+void EntityGrid::refreshOverlay(const shapes::Rectangle& area)
+{
+   if(debugOverlay != OCCUPANCY_OVERLAY) return;
+
+   for(int y = area.top; y <= area.bottom; ++y)
+   {
+      for(int x = area.left; x <= area.right; ++x)
       {
-         float destLeft = float(x * MOVEMENT_TILE_SIZE);
-         float destRight = float((x + 1) * MOVEMENT_TILE_SIZE);
-         float destTop = float(y * MOVEMENT_TILE_SIZE);
-         float destBottom = float((y + 1) * MOVEMENT_TILE_SIZE);
-         
-         glDisable(GL_TEXTURE_2D);
-         glBegin(GL_QUADS);
-         
-         switch(collisionMap[y][x].entityType)
+         const TileState& tile = collisionMap[y][x];
+         switch(tile.entityType)
          {
             case TileState::FREE:
             {
-               glColor3f(0.0f, 0.5f, 0.0f);
+               overlay.setCell(x, y, 0, 128, 0, 64);
                break;
             }
-            case NPC_CHARACTER:
+            case TileState::ACTOR:
             {
-               if(collisionMap[y][x].entity == NULL)
+               // A tile reserved for a move (with no actor on it yet) is told apart from one that an actor stands on
+               if(tile.entity == NULL)
                {
-                  glColor3f(0.5f, 0.0f, 0.0f);
+                  overlay.setCell(x, y, 128, 0, 0, 160);
                }
                else
                {
-                  glColor3f(0.0f, 0.0f, 0.5f);
+                  overlay.setCell(x, y, 0, 0, 128, 160);
                }
                break;
             }
-            case PLAYER_CHARACTER:
-            {
-               glColor3f(0.6f, 0.6f, 0.85f);
-               break;
-            }
             case TileState::OBSTACLE:
             default:
             {
-               glColor3f(0.5f, 0.5f, 0.0f);
+               overlay.setCell(x, y, 128, 128, 0, 160);
                break;
             }
          }
-         
-         glVertex3f(destLeft, destTop, 0.0f);
-         glVertex3f(destRight, destTop, 0.0f);
-         glVertex3f(destRight, destBottom, 0.0f);
-         glVertex3f(destLeft, destBottom, 0.0f);
-         glColor3f(1.0f, 1.0f, 1.0f);
-         glEnd();
-         glEnable(GL_TEXTURE_2D);
       }
    }
-#endif
 }
 
-void EntityGrid::deleteCollisionMap()
+void EntityGrid::addOverlayHeat(const shapes::Rectangle& area)
 {
-   if(collisionMap)
+   if(overlayHeat.empty()) return;
+
+   const int top = std::max(area.top, 0);
+   const int left = std::max(area.left, 0);
+   const int bottom = std::min(area.bottom, collisionMapHeight - 1);
+   const int right = std::min(area.right, collisionMapWidth - 1);
+   for(int y = top; y <= bottom; ++y)
    {
-      for(int i = 0; i < collisionMapHeight; ++i)
+      for(int x = left; x <= right; ++x)
       {
-         delete [] collisionMap[i];
+         unsigned short& heat = overlayHeat[y * collisionMapWidth + x];
+         if(heat < USHRT_MAX) ++heat;
       }
-      
+   }
+}
+
+void EntityGrid::drawDebugOverlay()
+{
+   if(map == NULL || debugOverlay == NO_OVERLAY) return;
+
+   if(!overlayHeat.empty())
+   {
+      // The heat is scaled against the hottest tile, so the whole layer is coloured again as the counts grow;
+      // only the rows whose colours actually change are uploaded
+      const unsigned short peakHeat = *std::max_element(overlayHeat.begin(), overlayHeat.end());
+      for(int y = 0; y < collisionMapHeight; ++y)
+      {
+         for(int x = 0; x < collisionMapWidth; ++x)
+         {
+            const unsigned short heat = overlayHeat[y * collisionMapWidth + x];
+            if(heat == 0)
+            {
+               overlay.setCell(x, y, 0, 0, 0, 0);
+               continue;
+            }
+
+            // Cool tiles are blue and the hottest are red, getting more opaque as they heat up
+            const int scaledHeat = heat * 255 / peakHeat;
+            overlay.setCell(x, y, static_cast<unsigned char>(scaledHeat), 0, static_cast<unsigned char>(255 - scaledHeat), static_cast<unsigned char>(96 + scaledHeat / 2));
+         }
+      }
+   }
+
+   overlay.draw(movementTileSize);
+}
+
+void EntityGrid::reserveCollisionMap(int width, int height)
+{
+   const int tileCount = width * height;
+   if(collisionMap == NULL || height > collisionRowCapacity || tileCount > collisionTileCapacity)
+   {
+      deleteCollisionMap();
+
+      collisionRowCapacity = std::max(height, 1);
+      collisionTileCapacity = std::max(tileCount, 1);
+      collisionMap = new TileState*[collisionRowCapacity];
+      collisionMap[0] = new TileState[collisionTileCapacity];
+      DEBUG("Allocated room for a %dx%d collision map", width, height);
+   }
+
+   // Every tile in the grid is overwritten as the map is read in, so the tiles left over from the last map don't need clearing
+   TileState* tiles = collisionMap[0];
+   for(int y = 0; y < height; ++y)
+   {
+      collisionMap[y] = tiles + y * width;
+   }
+}
+
+void EntityGrid::deleteCollisionMap()
+{
+   if(collisionMap)
+   {
+      delete [] collisionMap[0];
       delete [] collisionMap;
       collisionMap = NULL;
    }
+
+   collisionRowCapacity = 0;
+   collisionTileCapacity = 0;
+   occupancyBits.clear();
+   passabilityPyramid.clear();
+   collisionTree.build(std::vector<CollisionTree::Volume>());
 }
 
 EntityGrid::~EntityGrid()
@@ -11,6 +11,13 @@
 #include <vector>
 #include "MovementDirection.h"
 #include "Pathfinder.h"
+#include "Pathfinder_OccupancyMap.h"
+#include "ActorIndex.h"
+#include "ActorTable.h"
+#include "CollisionTree.h"
+#include "GridOverlay.h"
+#include "PassabilityPyramid.h"
+#include "TriggerZones.h"
 
 class Obstacle;
 class Map;
@@ -26,12 +33,18 @@ struct TileState;
  *
  * @author Noam Chitayat
  */
-class EntityGrid
+class EntityGrid : public Pathfinder::OccupancyMap
 {
    friend class Pathfinder;
    
-   /** The size of a movement tile (used to control pathfinding granularity) */
-   static const int MOVEMENT_TILE_SIZE;
+   /** The size of a movement tile, unless the map asks for a different granularity. */
+   static const int DEFAULT_MOVEMENT_TILE_SIZE;
+
+   /** The size (in pixels) of the cells in the coarsest level of the passability pyramid. */
+   static const int PASSABILITY_PYRAMID_CELL_SIZE;
+
+   /** The size of a movement tile (used to control pathfinding granularity). Always a divisor of the drawn tile size. */
+   int movementTileSize;
 
    /** The square root of 2. */
    static const float ROOT_2;
@@ -44,6 +57,49 @@ class EntityGrid
 
    /** The pathfinding component used to navigate in this map. */
    Pathfinder pathfinder;
+
+   /** The spatial index of the actors on the map, used to answer proximity queries. */
+   ActorIndex actorIndex;
+
+   /** The state of the actors on the map, kept together so that they can be stepped in one pass. */
+   ActorTable actorTable;
+
+   /** A summary of where the obstacles are at coarser resolutions, so large areas can be checked a block at a time. */
+   PassabilityPyramid passabilityPyramid;
+
+   /**
+    * The obstacles and trigger zones of the map that don't line up with its movement tiles.
+    * The tiles that solid volumes cover completely are marked as obstacles in the collision map as well,
+    * so that the tree only has to be checked for the edges of the volumes.
+    */
+   CollisionTree collisionTree;
+
+   /** The areas that scripts are watching for actors coming and going. */
+   TriggerZones triggerZones;
+
+   /** A move proposed by an actor, waiting to be resolved along with the moves of every other actor. */
+   struct MovementProposal
+   {
+      /** The actor that is moving. */
+      Actor* actor;
+
+      /** The coordinates of the source (in pixels). */
+      shapes::Point2D src;
+
+      /** The coordinates of the destination (in pixels). */
+      shapes::Point2D dst;
+
+      /** Set to true if the move is allowed. */
+      bool* granted;
+   };
+
+   /** The moves proposed since the last time they were resolved. */
+   std::vector<MovementProposal> movementProposals;
+
+   /**
+    * @return true iff the lhs proposal should be resolved before the rhs proposal.
+    */
+   static bool isResolvedBefore(const MovementProposal& lhs, const MovementProposal& rhs);
    
    /** The width of the pathfinder map. */
    int collisionMapWidth;
@@ -51,14 +107,72 @@ class EntityGrid
    /** The height of the pathfinder map. */
    int collisionMapHeight;
 
-   /** The map of entities and states for each of the tiles. */
+   /**
+    * The map of entities and states for each of the tiles.
+    * The rows all point into a single row-major block of tiles.
+    */
    TileState** collisionMap;
 
+   /** The number of rows that the collision map has room for. */
+   int collisionRowCapacity;
+
+   /** The number of tiles that the collision map has room for. */
+   int collisionTileCapacity;
+
+   /** A word of occupancy bits, with one bit per tile. */
+   typedef unsigned int OccupancyWord;
+
+   /** The number of tiles covered by each word of occupancy bits. */
+   static const int OCCUPANCY_WORD_BITS;
+
+   /**
+    * One bit per tile, set iff the tile isn't free. Each row is padded out to a whole number of words.
+    * This lets most occupancy checks test a whole row of an area with a single mask, without touching the tile states at all.
+    */
+   std::vector<OccupancyWord> occupancyBits;
+
+   /** The number of words of occupancy bits in each row. */
+   int occupancyRowWords;
+
+   /**
+    * Makes room in the map of tile states for a grid of the given size, and points its rows into the block of tiles.
+    * The storage is only reallocated if the grid is bigger than any grid before it, so moving between maps
+    * reuses the same storage instead of freeing and allocating it on every transition.
+    *
+    * @param width The width of the grid (in tiles).
+    * @param height The height of the grid (in tiles).
+    */
+   void reserveCollisionMap(int width, int height);
+
    /**
     * Clean up the map of tile states.
     */
    void deleteCollisionMap();
 
+   /**
+    * @param word The index of the word within its row.
+    * @param left The leftmost tile of the range (in tiles).
+    * @param right The rightmost tile of the range (in tiles).
+    *
+    * @return The bits of the given word that cover the tiles between left and right, inclusive.
+    */
+   static OccupancyWord getOccupancyMask(int word, int left, int right);
+
+   /**
+    * Sets or clears the occupancy bits for an area.
+    *
+    * @param area The area to update (with edge coordinates in tiles)
+    * @param occupied true iff the tiles in the area are not free
+    */
+   void setAreaOccupancy(const shapes::Rectangle& area, bool occupied);
+
+   /**
+    * @param area The area to check, which must lie within the map (with edge coordinates in tiles)
+    *
+    * @return true iff every tile in the area is free.
+    */
+   bool isAreaUnoccupied(const shapes::Rectangle& area) const;
+
    /**
     * @param area The pixel-coordinate rectangle to determine boundaries for.
     *
@@ -76,7 +190,60 @@ class EntityGrid
     *
     * @return true if the area can be successfully occupied, false if there was something else in the area.
     */
-   bool canOccupyArea(const shapes::Point2D& area, int width, int height, TileState state) const;
+   bool canOccupyArea(const shapes::Point2D& area, int width, int height, const TileState& state) const;
+
+   /**
+    * Checks if a block of tiles is available.
+    *
+    * @param tiles The tiles to check, which must lie within the map (with edge coordinates in tiles)
+    * @param state The new state of the tiles (entity and type)
+    *
+    * @return true iff every tile in the block is free or already belongs to the given entity.
+    */
+   bool canOccupyTiles(const shapes::Rectangle& tiles, TileState state) const;
+
+   /**
+    * @param area The coordinates of the top-left corner of the area (in pixels)
+    * @param width The width of the area (in pixels)
+    * @param height The height of the area (in pixels)
+    *
+    * @return true iff any of the map's solid volumes overlaps the area.
+    */
+   bool overlapsSolidVolume(const shapes::Point2D& area, int width, int height) const;
+
+   /**
+    * Works out the range of distances along a move at which a moving entity overlaps a volume along one axis.
+    * The entity moves in the given direction until it has gone the axis distance, then stays put for the rest of the move.
+    *
+    * @param start The entity's coordinate along the axis at the start of the move (in pixels).
+    * @param size The entity's size along the axis (in pixels).
+    * @param direction The direction of the move along the axis (-1, 0 or 1).
+    * @param axisDistance The distance that the entity moves along the axis (in pixels).
+    * @param volumeMin The volume's first coordinate along the axis (in pixels).
+    * @param volumeMax The volume's last coordinate along the axis (in pixels).
+    * @param first The parameter used to return the first distance along the move at which the entity overlaps the volume.
+    * @param last The parameter used to return the last distance along the move at which the entity overlaps the volume (INT_MAX if it never stops overlapping).
+    *
+    * @return true iff the entity overlaps the volume along the axis at any point of the move.
+    */
+   static bool getOverlapDistances(int start, int size, int direction, int axisDistance, int volumeMin, int volumeMax, int& first, int& last);
+
+   /**
+    * Finds how far an entity can go along a move before it runs into one of the map's solid volumes.
+    * Volumes that the entity overlaps at the start of the move don't stop it, so that it can move out of them.
+    *
+    * @param source The coordinates of the top-left corner of the entity at the start of the move (in pixels).
+    * @param width The width of the entity (in pixels).
+    * @param height The height of the entity (in pixels).
+    * @param xDirection The horizontal direction of the move (-1, 0 or 1).
+    * @param yDirection The vertical direction of the move (-1, 0 or 1).
+    * @param xDistance The distance that the entity moves horizontally (in pixels).
+    * @param yDistance The distance that the entity moves vertically (in pixels).
+    * @param distance The distance that the move goes on for (the greater of xDistance and yDistance, or less).
+    *
+    * @return The distance (up to the given distance) that the entity can go without overlapping a solid volume.
+    */
+   int getDistanceToSolidVolume(const shapes::Point2D& source, int width, int height, int xDirection, int yDirection, int xDistance, int yDistance, int distance) const;
    
    /**
     * If an area is available, occupy it and set the tiles within it to the new state. 
@@ -119,10 +286,69 @@ class EntityGrid
     */
    void setArea(const shapes::Rectangle& area, TileState state);
 
+   /**
+    * @param src The coordinates of the source (in pixels).
+    * @param dst The coordinates of the destination (in pixels).
+    *
+    * @return true iff the movement from the source to the destination is purely horizontal or vertical.
+    */
+   static bool isLateralMovement(const shapes::Point2D& src, const shapes::Point2D& dst);
+
+   /**
+    * @param src The coordinates of the source (in pixels).
+    * @param dst The coordinates of the destination (in pixels).
+    * @param width The width of the moving entity.
+    * @param height The height of the moving entity.
+    *
+    * @return The area covering the entity at both the source and the destination (in pixels),
+    *         which is the area swept by the entity if the movement is lateral.
+    */
+   static shapes::Rectangle getSweptArea(const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height);
+
+   /**
+    * Files an actor in the actor index at a new location, and tells the trigger zones about the move.
+    *
+    * @param actor The actor.
+    * @param location The location reserved for the actor (in pixels).
+    */
+   void indexActor(Actor* actor, const shapes::Point2D& location);
+
+   /**
+    * Takes an actor out of the actor index, and tells the trigger zones that it has left the map.
+    *
+    * @param actor The actor.
+    */
+   void unindexActor(Actor* actor);
+
    public:
       /** A set of waypoints to move through in order to go from one point to another. */
       typedef std::list<shapes::Point2D> Path;
 
+      /** A compacted set of waypoints, stored contiguously for the entity following them. */
+      typedef Pathfinder::WaypointList WaypointList;
+
+      /** A handle to a path request, used to collect the path once it has been found. */
+      typedef Pathfinder::PathRequestId PathRequestId;
+
+      /** The layers that can be drawn over the map for debugging, with a colour for each movement tile. */
+      enum DebugOverlay
+      {
+         /** Nothing is drawn over the map. */
+         NO_OVERLAY,
+
+         /** What is on each tile of the collision map (free, an actor, an actor's reservation, or an obstacle). */
+         OCCUPANCY_OVERLAY,
+
+         /** How often each tile has been expanded by the path searches run on the main thread. */
+         EXPANSION_OVERLAY,
+
+         /** How often a cached path from or to each tile has been reused. */
+         PATH_CACHE_OVERLAY,
+
+         /** How often a move onto each tile has been turned down because something was in the way. */
+         CONGESTION_OVERLAY
+      };
+
       /**
        * Constructor.
        */
@@ -145,6 +371,16 @@ class EntityGrid
        * @return The name of the map.
        */
       std::string getName() const;
+
+      /**
+       * @return The table holding the state of the actors on the map.
+       */
+      ActorTable& getActorTable();
+
+      /**
+       * @return The table holding the state of the actors on the map.
+       */
+      const ActorTable& getActorTable() const;
       
       /**
        * @return The width of the map.
@@ -173,8 +409,17 @@ class EntityGrid
 
       /**
        * Process logic for the map and its obstacles.
+       *
+       * @param timePassed The amount of time that has passed since the last frame.
+       * @param visibleArea The tiles that are on screen. Obstacles away from them are left alone.
+       */
+      void step(long timePassed, const shapes::Rectangle& visibleArea);
+
+      /**
+       * Collects paths found by the pathfinding workers, and dispatches any queued path requests.
+       * This must be called at the start of each frame, before any entities move.
        */
-      void step(long timePassed);
+      void processPathRequests();
    
       /**
        * Finds an ideal path from the source coordinates to the destination.
@@ -198,6 +443,80 @@ class EntityGrid
        * @return The shortest unobstructed path from the source point to the destination point.
        */
       Path findReroutedPath(const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height);
+
+      /**
+       * Finds the next waypoint for an entity following the shared flow field towards a goal.
+       *
+       * @param goal The coordinates of the goal (in pixels).
+       * @param location The current coordinates of the entity (in pixels).
+       * @param width The width of the moving entity.
+       * @param height The height of the moving entity.
+       * @param waypoint Set to the coordinates of the next waypoint (in pixels), if there is one.
+       *
+       * @return true iff there is a next waypoint; false if the entity has reached the goal or cannot reach it.
+       */
+      bool findFlowWaypoint(const shapes::Point2D& goal, const shapes::Point2D& location, int width, int height, shapes::Point2D& waypoint);
+
+      /**
+       * Queues a request for an ideal path from the source coordinates to the destination.
+       *
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       *
+       * @return A handle used to collect the path once it is ready.
+       */
+      PathRequestId requestBestPath(const shapes::Point2D& src, const shapes::Point2D& dst);
+
+      /**
+       * Queues a request for the shortest path from the source coordinates to the destination
+       * around all obstacles and entities. The search is spread out over as many frames as it needs.
+       *
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param width The width of the moving entity.
+       * @param height The width of the moving entity.
+       *
+       * @return A handle used to collect the path once it is ready.
+       */
+      PathRequestId requestReroutedPath(const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height);
+
+      /**
+       * Collects the path for a path request if it is ready.
+       * Once a path has been collected, its handle is no longer valid.
+       *
+       * @param requestId The handle of the path request.
+       * @param path Set to the path found, if the request is complete.
+       *
+       * @return true iff the path request is no longer pending.
+       */
+      bool collectPath(PathRequestId requestId, Path& path);
+
+      /**
+       * Merges the straight lateral runs of a path into single waypoints.
+       *
+       * @param src The coordinates of the start of the path (in pixels).
+       * @param path The waypoints of the path, with the source excluded.
+       *
+       * @return The compacted waypoints.
+       */
+      WaypointList compactPath(const shapes::Point2D& src, const Path& path) const;
+
+      /**
+       * Cancels a path request. Its handle is no longer valid afterwards.
+       *
+       * @param requestId The handle of the path request.
+       */
+      void cancelPathRequest(PathRequestId requestId);
+
+      /**
+       * @return The number of paths that have been asked for on this grid, found straight away or requested.
+       */
+      unsigned long getPathQueryCount() const;
+
+      /**
+       * @return The number of tiles expanded by the path searches run on the main thread for this grid.
+       */
+      unsigned long getPathExpansionCount() const;
       
       /**
        * Checks an area for obstacles or entities.
@@ -209,6 +528,29 @@ class EntityGrid
        * @return true iff a given area is entirely free of obstacles and entities.
        */
       bool isAreaFree(const shapes::Point2D& area, int width, int height) const;
+
+      /**
+       * Finds the trigger zones of the map that overlap an area.
+       *
+       * @param area The coordinates of the top-left corner of the area (in pixels)
+       * @param width The width of the area (in pixels)
+       * @param height The height of the area (in pixels)
+       * @param names The names of the trigger zones found are added to the back of this list.
+       */
+      void findTriggerVolumes(const shapes::Point2D& area, int width, int height, std::vector<std::string>& names) const;
+
+      /**
+       * @param name The name of one of the map's trigger zones.
+       * @param area The parameter used to return the area of the trigger zone (with inclusive edge coordinates in pixels).
+       *
+       * @return true iff the map has a trigger zone with the name.
+       */
+      bool findTriggerVolume(const std::string& name, shapes::Rectangle& area) const;
+
+      /**
+       * @return The areas that scripts are watching on this map, which are all removed when the map changes.
+       */
+      TriggerZones& getTriggerZones();
    
       /**
        * Add an obstacle and occupy the tiles under it.
@@ -222,6 +564,18 @@ class EntityGrid
        */
       bool addObstacle(const shapes::Point2D& area, int width, int height);
 
+      /**
+       * Remove an obstacle and free the tiles under it.
+       * NOTE: This is an all-or-nothing operation, which means that if any tile in the area is not an obstacle, the entire area will be unmodified.
+       *
+       * @param area The coordinates of the top-left corner of the obstacle (in pixels)
+       * @param width The width of the obstacle (in pixels)
+       * @param height The height of the obstacle (in pixels)
+       *
+       * @return true if the obstacle has been successfully removed from the area, false if there was something other than an obstacle in the area.
+       */
+      bool removeObstacle(const shapes::Point2D& area, int width, int height);
+
       /**
        * Add an Actor and occupy the tiles under it.
        * NOTE: This is an all-or-nothing operation, which means that if there is anything blocking the area from being occupied, the entire area will be unmodified. If the area can be occupied, it will be occupied completely.
@@ -261,6 +615,45 @@ class EntityGrid
        */
       Actor* getAdjacentActor(Actor* actor) const;
 
+      /**
+       * Finds the actors overlapping an area of the map.
+       *
+       * @param area The area to search (with inclusive edge coordinates in pixels).
+       * @param actors The actors found are added to the back of this list.
+       */
+      void findActorsInArea(const shapes::Rectangle& area, std::vector<Actor*>& actors) const;
+
+      /**
+       * Finds the actors with any part of their area within a given distance of a point.
+       *
+       * @param center The point to search around (in pixels).
+       * @param radius The distance to search within (in pixels).
+       * @param actors The actors found are added to the back of this list.
+       */
+      void findActorsInRadius(const shapes::Point2D& center, int radius, std::vector<Actor*>& actors) const;
+
+      /**
+       * Finds the actor closest to a point.
+       *
+       * @param point The point to search around (in pixels).
+       * @param maxRadius The furthest distance to search (in pixels).
+       * @param excludedActor An actor to leave out of the search (such as the actor doing the search), or NULL.
+       *
+       * @return The closest actor within the radius, or NULL if there is none.
+       */
+      Actor* findNearestActor(const shapes::Point2D& point, int maxRadius, const Actor* excludedActor) const;
+
+      /**
+       * Finds out what is in the way of a move that couldn't be begun.
+       *
+       * @param actor The actor that is moving.
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       *
+       * @return The actor in the way, or NULL if the way is blocked by an obstacle (or isn't blocked at all).
+       */
+      Actor* findActorInTheWay(const Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst) const;
+
       /**
        * Given the distance the entity can move and the direction, moves as far as possible until an obstacle is encountered.
        *
@@ -273,15 +666,38 @@ class EntityGrid
    
       /**
        * Request permission from the EntityGrid to move an Actor from the source to the given destination.
+       * The destination may be several tiles away if it is directly horizontal or vertical from the actor,
+       * in which case every tile between the two is reserved for the movement; diagonal moves must be one tile at a time.
        * NOTE: After the actor has completed this movement, endMovement MUST be called in order to notify the EntityGrid to perform the appropriate clean-up.
        *
        * @param actor The actor that is moving.
+       * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
        *
        * @return true iff the actor can move from the source to the destination.
        */
-      bool beginMovement(Actor* actor, const shapes::Point2D& dst);
+      bool beginMovement(Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst);
       
+      /**
+       * Proposes a move for an Actor from the source to the given destination, to be resolved by the next call to resolveMovements.
+       * Proposed moves are resolved in an order that depends only on where the actors are,
+       * so the outcome doesn't depend on the order in which the actors made their proposals.
+       * NOTE: If the move is granted, endMovement or abortMovement MUST be called afterwards, just as with beginMovement.
+       *
+       * @param actor The actor that is moving.
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param granted Cleared now, and set to true by resolveMovements if the move is granted.
+       *                It must stay valid until then.
+       */
+      void proposeMovement(Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst, bool& granted);
+
+      /**
+       * Resolves every proposed move in a single pass over the grid, granting each move whose
+       * destination is still free once the moves ahead of it have been granted.
+       */
+      void resolveMovements();
+
       /**
        * Notifies the EntityGrid that the actor failed to complete movement from the source to the given destination and occupies some area between the source and destination.
        *
@@ -301,14 +717,65 @@ class EntityGrid
       void endMovement(Actor* actor, const shapes::Point2D& src, const shapes::Point2D& dst);
    
       /**
-       * Draw the collision map for diagnostic purposes.
+       * Draw the part of the map that falls within the visible area.
+       *
+       * @param visibleArea The area of the map that is visible (with inclusive edge coordinates in pixels).
+       */
+      void draw(const shapes::Rectangle& visibleArea);
+
+      /**
+       * Chooses the layer drawn over the map for debugging. The counts behind the heat layers
+       * (expansions, path cache hits and congestion) are only kept while their layer is chosen,
+       * and start from nothing each time it is.
+       *
+       * @param overlay The layer to draw, or NO_OVERLAY to stop drawing one.
+       */
+      void setDebugOverlay(DebugOverlay overlay);
+
+      /**
+       * @return The layer drawn over the map for debugging.
        */
-      void draw();
+      DebugOverlay getDebugOverlay() const;
+
+      /**
+       * Draws the debug overlay over the whole map, in a single quad.
+       * The sprite batch must be flushed first, so that the overlay is drawn over the batched sprites.
+       */
+      void drawDebugOverlay();
 
       /**
        * Destructor.
        */
       ~EntityGrid();
+
+   private:
+      /** The layer drawn over the map for debugging. */
+      DebugOverlay debugOverlay;
+
+      /** The colours of the debug overlay's tiles. */
+      GridOverlay overlay;
+
+      /** The counts behind the debug overlay's heat layer (indexed by tile number), which are empty unless a heat layer is drawn. */
+      std::vector<unsigned short> overlayHeat;
+
+      /**
+       * Colours the debug overlay's tiles in an area to match what is on them, if the occupancy layer is drawn.
+       *
+       * @param area The area to colour (with edge coordinates in tiles).
+       */
+      void refreshOverlay(const shapes::Rectangle& area);
+
+      /**
+       * Sizes the debug overlay (and the counts behind its heat layer) to the collision map, and colours all of it from scratch.
+       */
+      void resetOverlay();
+
+      /**
+       * Adds to the counts behind the debug overlay's heat layer in an area.
+       *
+       * @param area The area to count (with edge coordinates in tiles), which is clamped to the map.
+       */
+      void addOverlayHeat(const shapes::Rectangle& area);
 };
 
 #endif
@@ -0,0 +1,125 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "GridOverlay.h"
+#include "GLState.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <algorithm>
+
+GridOverlay::GridOverlay() : width(0), height(0), textureWidth(0), textureHeight(0), firstDirtyRow(0), lastDirtyRow(-1), texture(0)
+{
+}
+
+void GridOverlay::resize(int width, int height)
+{
+   if(texture != 0)
+   {
+      glDeleteTextures(1, &texture);
+      texture = 0;
+   }
+
+   this->width = width;
+   this->height = height;
+   pixels.assign(width * height * 4, 0);
+
+   textureWidth = 1;
+   while(textureWidth < width) textureWidth <<= 1;
+
+   textureHeight = 1;
+   while(textureHeight < height) textureHeight <<= 1;
+
+   firstDirtyRow = 0;
+   lastDirtyRow = height - 1;
+}
+
+void GridOverlay::setCell(int x, int y, unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha)
+{
+   unsigned char* pixel = &pixels[(y * width + x) * 4];
+   if(pixel[0] == red && pixel[1] == green && pixel[2] == blue && pixel[3] == alpha) return;
+
+   pixel[0] = red;
+   pixel[1] = green;
+   pixel[2] = blue;
+   pixel[3] = alpha;
+
+   firstDirtyRow = std::min(firstDirtyRow, y);
+   lastDirtyRow = std::max(lastDirtyRow, y);
+}
+
+void GridOverlay::upload()
+{
+   if(texture == 0)
+   {
+      // The parts of the texture past the grid are never drawn, so they are left transparent
+      const std::vector<unsigned char> emptyPixels(textureWidth * textureHeight * 4, 0);
+      glGenTextures(1, &texture);
+      GLState::bindTexture(texture);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, &emptyPixels[0]);
+   }
+
+   if(firstDirtyRow > lastDirtyRow) return;
+
+   // The changed rows are uploaded whole, since a row of cells is small next to the cost of a separate upload for each change
+   GLState::bindTexture(texture);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstDirtyRow, width, lastDirtyRow - firstDirtyRow + 1,
+         GL_RGBA, GL_UNSIGNED_BYTE, &pixels[firstDirtyRow * width * 4]);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+   firstDirtyRow = height;
+   lastDirtyRow = -1;
+}
+
+void GridOverlay::draw(int cellSize)
+{
+   if(width == 0 || height == 0) return;
+
+   upload();
+
+   const float right = static_cast<float>(width * cellSize);
+   const float bottom = static_cast<float>(height * cellSize);
+   const float textureRight = static_cast<float>(width) / textureWidth;
+   const float textureBottom = static_cast<float>(height) / textureHeight;
+
+   const bool blendEnabled = GLState::isBlending();
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+   GLState::setTexturing(true);
+   GLState::bindTexture(texture);
+   GLState::setTextureMode(GL_MODULATE);
+   glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glTexCoord2f(0.0f, 0.0f);
+      glVertex2f(0.0f, 0.0f);
+      glTexCoord2f(textureRight, 0.0f);
+      glVertex2f(right, 0.0f);
+      glTexCoord2f(textureRight, textureBottom);
+      glVertex2f(right, bottom);
+      glTexCoord2f(0.0f, textureBottom);
+      glVertex2f(0.0f, bottom);
+   glEnd();
+
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+GridOverlay::~GridOverlay()
+{
+   if(texture != 0)
+   {
+      glDeleteTextures(1, &texture);
+   }
+}
@@ -0,0 +1,88 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef GRID_OVERLAY_H
+#define GRID_OVERLAY_H
+
+#include <vector>
+
+typedef unsigned int GLuint;
+
+/**
+ * A grid of coloured cells laid over the map for debugging (such as the collision map, or the pathfinder's work on each tile),
+ * with one texel for each cell.
+ *
+ * The cells are kept in memory and changed one at a time as whatever they show changes. The rows changed since the overlay
+ * was last drawn are uploaded into its texture as it is drawn, so the whole grid costs a single quad however big the map is.
+ */
+class GridOverlay
+{
+   /** The size of the grid (in cells). */
+   int width, height;
+
+   /** The width and height of the texture, rounded up to powers of two. */
+   int textureWidth, textureHeight;
+
+   /** The colour of each cell (as RGBA), row by row. */
+   std::vector<unsigned char> pixels;
+
+   /** The first and last rows changed since the texture was last uploaded (nothing has changed if the first is past the last). */
+   int firstDirtyRow, lastDirtyRow;
+
+   /** The texture holding the cells, or 0 if it hasn't been created yet. */
+   GLuint texture;
+
+   /**
+    * Copies the changed rows into the texture, creating the texture if needed.
+    */
+   void upload();
+
+   /** Grid overlays can't be copied. */
+   GridOverlay(const GridOverlay&);
+
+   /** Grid overlays can't be copied. */
+   GridOverlay& operator=(const GridOverlay&);
+
+   public:
+      /**
+       * Constructor.
+       */
+      GridOverlay();
+
+      /**
+       * Resizes the grid, and makes every cell transparent.
+       *
+       * @param width The width of the grid (in cells).
+       * @param height The height of the grid (in cells).
+       */
+      void resize(int width, int height);
+
+      /**
+       * Sets the colour of a cell.
+       *
+       * @param x The x-coordinate of the cell, which must lie within the grid.
+       * @param y The y-coordinate of the cell, which must lie within the grid.
+       * @param red The red component of the colour.
+       * @param green The green component of the colour.
+       * @param blue The blue component of the colour.
+       * @param alpha The opacity of the colour (0 to leave the cell out).
+       */
+      void setCell(int x, int y, unsigned char red, unsigned char green, unsigned char blue, unsigned char alpha);
+
+      /**
+       * Draws the grid over the map, with each cell covering a square of the map.
+       *
+       * @param cellSize The size of each cell's square (in pixels).
+       */
+      void draw(int cellSize);
+
+      /**
+       * Destructor. Releases the texture.
+       */
+      ~GridOverlay();
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "LightMap.h"
+#include "RenderTarget.h"
+#include "GraphicsUtil.h"
+#include "GLState.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <cmath>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+// Light changes slowly across the screen and the layer is filtered smoothly when it is stretched,
+// so adding it up at half the screen's resolution doesn't show, and only touches a quarter of the pixels.
+const int LightMap::DOWNSAMPLE = 2;
+
+// The falloff is stretched over the whole light, and is filtered smoothly, so a small texture is enough
+const int LightMap::FALLOFF_SIZE = 64;
+
+LightMap::LightMap() : ambientRed(1.0f), ambientGreen(1.0f), ambientBlue(1.0f), layer(NULL), falloffTexture(0)
+{
+}
+
+bool LightMap::isEnabled() const
+{
+   return ambientRed < 1.0f || ambientGreen < 1.0f || ambientBlue < 1.0f;
+}
+
+void LightMap::setAmbientLight(float r, float g, float b)
+{
+   ambientRed = r;
+   ambientGreen = g;
+   ambientBlue = b;
+}
+
+void LightMap::addLight(int x, int y, int radius, float r, float g, float b)
+{
+   const Light light = { x, y, radius, r, g, b };
+   lights.push_back(light);
+}
+
+void LightMap::addFrameLight(int x, int y, int radius, float r, float g, float b)
+{
+   const Light light = { x, y, radius, r, g, b };
+   frameLights.push_back(light);
+}
+
+void LightMap::clear()
+{
+   lights.clear();
+   frameLights.clear();
+   setAmbientLight(1.0f, 1.0f, 1.0f);
+}
+
+void LightMap::createFalloffTexture()
+{
+   std::vector<unsigned char> pixels(FALLOFF_SIZE * FALLOFF_SIZE * 4);
+   const float center = (FALLOFF_SIZE - 1) / 2.0f;
+
+   for(int y = 0; y < FALLOFF_SIZE; ++y)
+   {
+      for(int x = 0; x < FALLOFF_SIZE; ++x)
+      {
+         // The light fades with the square of the distance to its edge, which looks softer than a straight fade
+         const float dx = (x - center) / center;
+         const float dy = (y - center) / center;
+         float intensity = 1.0f - sqrtf(dx * dx + dy * dy);
+         intensity = intensity > 0.0f ? intensity * intensity : 0.0f;
+
+         unsigned char* pixel = &pixels[(y * FALLOFF_SIZE + x) * 4];
+         pixel[0] = pixel[1] = pixel[2] = static_cast<unsigned char>(intensity * 255.0f + 0.5f);
+         pixel[3] = 0xFF;
+      }
+   }
+
+   glGenTextures(1, &falloffTexture);
+   GLState::bindTexture(falloffTexture);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, FALLOFF_SIZE, FALLOFF_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
+void LightMap::drawLights(const std::vector<Light>& lightList, const shapes::Rectangle& visibleArea)
+{
+   for(std::vector<Light>::const_iterator iter = lightList.begin(); iter != lightList.end(); ++iter)
+   {
+      const shapes::Rectangle lightArea(iter->y - iter->radius, iter->x - iter->radius, iter->y + iter->radius, iter->x + iter->radius);
+      if(!lightArea.intersects(visibleArea))
+      {
+         continue;
+      }
+
+      glColor3f(iter->red, iter->green, iter->blue);
+
+      glTexCoord2f(0.0f, 0.0f);
+      glVertex3i(lightArea.left, lightArea.top, 0);
+
+      glTexCoord2f(1.0f, 0.0f);
+      glVertex3i(lightArea.right, lightArea.top, 0);
+
+      glTexCoord2f(1.0f, 1.0f);
+      glVertex3i(lightArea.right, lightArea.bottom, 0);
+
+      glTexCoord2f(0.0f, 1.0f);
+      glVertex3i(lightArea.left, lightArea.bottom, 0);
+   }
+}
+
+void LightMap::drawAmbientLight() const
+{
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   GLState::setTexturing(false);
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_DST_COLOR, GL_ZERO);
+   glColor3f(ambientRed, ambientGreen, ambientBlue);
+
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glVertex3i(0, 0, 0);
+      glVertex3i(GraphicsUtil::width, 0, 0);
+      glVertex3i(GraphicsUtil::width, GraphicsUtil::height, 0);
+      glVertex3i(0, GraphicsUtil::height, 0);
+   glEnd();
+
+   glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+   GLState::setTexturing(true);
+   glPopMatrix();
+}
+
+void LightMap::draw(int xOffset, int yOffset, const shapes::Rectangle& visibleArea)
+{
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   const bool blendEnabled = GLState::isBlending();
+
+   if(!RenderTarget::isSupported())
+   {
+      drawAmbientLight();
+      frameLights.clear();
+
+      GLState::setBlending(blendEnabled);
+      GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+      return;
+   }
+
+   const int layerWidth = GraphicsUtil::width / DOWNSAMPLE;
+   const int layerHeight = GraphicsUtil::height / DOWNSAMPLE;
+
+   if(layer == NULL)
+   {
+      DEBUG("Creating %dx%d light layer.", layerWidth, layerHeight);
+      layer = new RenderTarget(layerWidth, layerHeight, true);
+   }
+
+   if(falloffTexture == 0)
+   {
+      createFalloffTexture();
+   }
+
+   layer->begin();
+
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+
+   // Every pixel starts out lit by the ambient light...
+   GLState::setTexturing(false);
+   GLState::setBlending(false);
+   glColor3f(ambientRed, ambientGreen, ambientBlue);
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glVertex3i(0, 0, 0);
+      glVertex3i(layerWidth, 0, 0);
+      glVertex3i(layerWidth, layerHeight, 0);
+      glVertex3i(0, layerHeight, 0);
+   glEnd();
+
+   // ...and each light adds its colour on top, in the same coordinates that the map was drawn in
+   glScalef(1.0f / DOWNSAMPLE, 1.0f / DOWNSAMPLE, 1.0f);
+   glTranslated(xOffset, yOffset, 0);
+
+   GLState::setTexturing(true);
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_ONE, GL_ONE);
+   GLState::setTextureMode(GL_MODULATE);
+   GLState::bindTexture(falloffTexture);
+
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      drawLights(lights, visibleArea);
+      drawLights(frameLights, visibleArea);
+   glEnd();
+
+   glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+   GLState::setTextureMode(GL_REPLACE);
+   glPopMatrix();
+
+   layer->end();
+   frameLights.clear();
+
+   layer->multiply(layerWidth * DOWNSAMPLE, layerHeight * DOWNSAMPLE);
+
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+LightMap::~LightMap()
+{
+   delete layer;
+
+   if(falloffTexture != 0)
+   {
+      glDeleteTextures(1, &falloffTexture);
+   }
+}
@@ -0,0 +1,146 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef LIGHT_MAP_H
+#define LIGHT_MAP_H
+
+#include <vector>
+#include "Rectangle.h"
+
+class RenderTarget;
+typedef unsigned int GLuint;
+
+/**
+ * Lights the map once it has been drawn. The map is darkened to an ambient light level,
+ * and brightened back up around lights (such as torches, or a lantern that the player carries).
+ *
+ * The light that falls on the screen is added up in an offscreen layer at a lower resolution than the screen,
+ * by drawing every light in view as a single (batched) quad on top of the ambient light.
+ * The layer is then stretched over the screen in one pass that multiplies the scene by it,
+ * so lighting costs one quad per light and one quad for the screen, however many tiles the lights cover.
+ *
+ * Where the driver doesn't support render targets, the scene is only darkened to the ambient light.
+ */
+class LightMap
+{
+   /** The factor that the light layer's resolution is reduced by, compared to the screen's. */
+   static const int DOWNSAMPLE;
+
+   /** The width and height of the texture holding the falloff of a light (in pixels). */
+   static const int FALLOFF_SIZE;
+
+   /** A round light on the map. */
+   struct Light
+   {
+      /** The center of the light (in pixels). */
+      int x, y;
+
+      /** The distance that the light reaches (in pixels). */
+      int radius;
+
+      /** The colour of the light at its center. */
+      float red, green, blue;
+   };
+
+   /** The colour of the ambient light that falls everywhere on the map. */
+   float ambientRed, ambientGreen, ambientBlue;
+
+   /** The lights placed on the map. */
+   std::vector<Light> lights;
+
+   /** The lights that are only drawn in the next frame (such as lights that move with an actor). */
+   std::vector<Light> frameLights;
+
+   /** The layer that the light falling on the screen is added up in, or NULL if it hasn't been created. */
+   RenderTarget* layer;
+
+   /** The texture holding the falloff of a light from its center to its edge, or 0 if it hasn't been created. */
+   GLuint falloffTexture;
+
+   /**
+    * Creates the texture holding the falloff of a light.
+    */
+   void createFalloffTexture();
+
+   /**
+    * Adds the quads for the lights in a list that fall within an area to the quads being drawn.
+    *
+    * @param lightList The lights to draw.
+    * @param visibleArea The area of the map in view (with inclusive edge coordinates in pixels).
+    */
+   static void drawLights(const std::vector<Light>& lightList, const shapes::Rectangle& visibleArea);
+
+   /**
+    * Draws the ambient light over the screen, multiplying the colours on the screen by it.
+    */
+   void drawAmbientLight() const;
+
+   public:
+      /**
+       * Constructor. The map starts out fully lit, with no lights.
+       */
+      LightMap();
+
+      /**
+       * @return true iff the map is darker than fully lit, so that it has to be lit once it is drawn.
+       */
+      bool isEnabled() const;
+
+      /**
+       * Sets the colour of the ambient light that falls everywhere on the map.
+       * An ambient light of white (1, 1, 1) leaves the map fully lit, and turns lighting off.
+       *
+       * @param r The red element of the ambient light (0 to 1).
+       * @param g The green element of the ambient light (0 to 1).
+       * @param b The blue element of the ambient light (0 to 1).
+       */
+      void setAmbientLight(float r, float g, float b);
+
+      /**
+       * Places a light on the map.
+       *
+       * @param x The x-coordinate of the light's center (in pixels).
+       * @param y The y-coordinate of the light's center (in pixels).
+       * @param radius The distance that the light reaches (in pixels).
+       * @param r The red element of the light's colour (0 to 1).
+       * @param g The green element of the light's colour (0 to 1).
+       * @param b The blue element of the light's colour (0 to 1).
+       */
+      void addLight(int x, int y, int radius, float r, float g, float b);
+
+      /**
+       * Adds a light that is only drawn in the next frame, such as a light that moves with an actor.
+       *
+       * @param x The x-coordinate of the light's center (in pixels).
+       * @param y The y-coordinate of the light's center (in pixels).
+       * @param radius The distance that the light reaches (in pixels).
+       * @param r The red element of the light's colour (0 to 1).
+       * @param g The green element of the light's colour (0 to 1).
+       * @param b The blue element of the light's colour (0 to 1).
+       */
+      void addFrameLight(int x, int y, int radius, float r, float g, float b);
+
+      /**
+       * Removes all of the lights placed on the map, and returns the map to being fully lit.
+       */
+      void clear();
+
+      /**
+       * Lights the scene drawn on the screen, and forgets the lights added for the frame.
+       *
+       * @param xOffset The x-offset that the map was drawn at.
+       * @param yOffset The y-offset that the map was drawn at.
+       * @param visibleArea The area of the map in view (with inclusive edge coordinates in pixels).
+       */
+      void draw(int xOffset, int yOffset, const shapes::Rectangle& visibleArea);
+
+      /**
+       * Destructor. Releases the light layer and falloff texture.
+       */
+      ~LightMap();
+};
+
+#endif
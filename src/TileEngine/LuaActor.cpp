@@ -32,6 +32,27 @@ static int ActorL_Move(lua_State* luaVM)
    return 0;
 }
 
+static int ActorL_Follow(lua_State* luaVM)
+{
+   int nargs = lua_gettop(luaVM);
+   
+   switch(nargs)
+   {
+      case 3:
+      {
+         Actor* actor = luaW_check<Actor>(luaVM, 1);
+         if (actor)
+         {
+            int x = lua_tointeger(luaVM, 2);
+            int y = lua_tointeger(luaVM, 3);
+            actor->follow(x, y);
+         }
+         break;
+      }
+   }
+   return 0;
+}
+
 static int ActorL_SetSprite(lua_State* luaVM)
 {
    int nargs = lua_gettop(luaVM);
@@ -95,6 +116,53 @@ static int ActorL_SetSpritesheet(lua_State* luaVM)
    return 0;
 }
 
+static int ActorL_SetTint(lua_State* luaVM)
+{
+   int nargs = lua_gettop(luaVM);
+   
+   switch(nargs)
+   {
+      case 4:
+      {
+         Actor* actor = luaW_check<Actor>(luaVM, 1);
+         if (actor)
+         {
+            float r = static_cast<float>(lua_tonumber(luaVM, 2));
+            float g = static_cast<float>(lua_tonumber(luaVM, 3));
+            float b = static_cast<float>(lua_tonumber(luaVM, 4));
+            actor->setTint(r, g, b);
+         }
+         break;
+      }
+   }
+   
+   return 0;
+}
+
+static int ActorL_SetLight(lua_State* luaVM)
+{
+   int nargs = lua_gettop(luaVM);
+   
+   switch(nargs)
+   {
+      case 5:
+      {
+         Actor* actor = luaW_check<Actor>(luaVM, 1);
+         if (actor)
+         {
+            int radius = lua_tointeger(luaVM, 2);
+            float r = static_cast<float>(lua_tonumber(luaVM, 3));
+            float g = static_cast<float>(lua_tonumber(luaVM, 4));
+            float b = static_cast<float>(lua_tonumber(luaVM, 5));
+            actor->setLight(radius, r, g, b);
+         }
+         break;
+      }
+   }
+   
+   return 0;
+}
+
 static int ActorL_LookAt(lua_State* luaVM)
 {
    int nargs = lua_gettop(luaVM);
@@ -114,13 +182,31 @@ static int ActorL_LookAt(lua_State* luaVM)
    return 0;
 }
 
+static int ActorL_GetLocation(lua_State* luaVM)
+{
+   Actor* actor = luaW_check<Actor>(luaVM, 1);
+   if (actor)
+   {
+      const shapes::Point2D location = actor->getLocation();
+      lua_pushinteger(luaVM, location.x);
+      lua_pushinteger(luaVM, location.y);
+      return 2;
+   }
+
+   return 0;
+}
+
 static luaL_reg actorMetatable[] =
 {
    { "move", ActorL_Move },
+   { "follow", ActorL_Follow },
    { "setSprite", ActorL_SetSprite },
    { "setAnimation", ActorL_SetAnimation },
    { "setSpritesheet", ActorL_SetSpritesheet },
+   { "setTint", ActorL_SetTint },
+   { "setLight", ActorL_SetLight },
    { "lookAt", ActorL_LookAt },
+   { "getLocation", ActorL_GetLocation },
    { NULL, NULL }
 };
 
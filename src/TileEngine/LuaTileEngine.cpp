@@ -1,7 +1,9 @@
 #include "LuaTileEngine.h"
 #include "TileEngine.h"
 #include "NPC.h"
+#include "LightMap.h"
 #include "Point2D.h"
+#include "Rectangle.h"
 #include "LuaWrapper.hpp"
 
 // Include the Lua libraries. Since they are written in clean C, the functions
@@ -42,7 +44,88 @@ static int TileEngineL_AddNPC(lua_State* luaVM)
    }
    
    luaW_push<Actor>(luaVM, npc);
-   return 1;
+   if(npc == NULL)
+   {
+      return 1;
+   }
+
+   // Hand back the NPC's handle as well, so that the script can keep it instead of looking the NPC up by name
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   lua_pushnumber(luaVM, tileEngine->getActorHandle(npc));
+   return 2;
+}
+
+static int TileEngineL_AddNPCs(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   luaL_checktype(luaVM, 2, LUA_TTABLE);
+   if (!tileEngine)
+   {
+      return 0;
+   }
+
+   // Each NPC is described by a table of the form { name = ..., spritesheet = ..., x = ..., y = ... }
+   const int npcCount = static_cast<int>(lua_objlen(luaVM, 2));
+   std::vector<TileEngine::NPCDefinition> definitions(npcCount);
+   for(int i = 0; i < npcCount; ++i)
+   {
+      lua_rawgeti(luaVM, 2, i + 1);
+      luaL_checktype(luaVM, -1, LUA_TTABLE);
+      lua_getfield(luaVM, -1, "name");
+      lua_getfield(luaVM, -2, "spritesheet");
+      lua_getfield(luaVM, -3, "x");
+      lua_getfield(luaVM, -4, "y");
+
+      TileEngine::NPCDefinition& definition = definitions[i];
+      definition.name = luaL_checkstring(luaVM, -4);
+      definition.spritesheetName = luaL_checkstring(luaVM, -3);
+      definition.location = shapes::Point2D(luaL_checkint(luaVM, -2), luaL_checkint(luaVM, -1));
+      lua_pop(luaVM, 5);
+   }
+
+   std::vector<NPC*> npcs;
+   tileEngine->addNPCs(definitions, npcs);
+
+   // Hand back the NPCs and their handles in two lists, in the order they were described (with false for the NPCs that couldn't be placed)
+   lua_createtable(luaVM, npcCount, 0);
+   lua_createtable(luaVM, npcCount, 0);
+   for(int i = 0; i < npcCount; ++i)
+   {
+      if(npcs[i] != NULL)
+      {
+         luaW_push<Actor>(luaVM, npcs[i]);
+         lua_rawseti(luaVM, -3, i + 1);
+         lua_pushnumber(luaVM, tileEngine->getActorHandle(npcs[i]));
+         lua_rawseti(luaVM, -2, i + 1);
+      }
+      else
+      {
+         lua_pushboolean(luaVM, 0);
+         lua_rawseti(luaVM, -3, i + 1);
+         lua_pushboolean(luaVM, 0);
+         lua_rawseti(luaVM, -2, i + 1);
+      }
+   }
+
+   return 2;
+}
+
+static int TileEngineL_RemoveNPC(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      // NPCs can be removed by handle, so that a script never removes an NPC that has already gone
+      NPC* npc = lua_type(luaVM, 2) == LUA_TNUMBER
+            ? tileEngine->resolveNPC(static_cast<ActorTable::ActorHandle>(lua_tonumber(luaVM, 2)))
+            : tileEngine->resolveNPC(tileEngine->getActorHandle(luaW_check<Actor>(luaVM, 2)));
+      if (npc)
+      {
+         tileEngine->removeNPC(npc);
+      }
+   }
+
+   return 0;
 }
 
 static int TileEngineL_GetNPC(lua_State* luaVM)
@@ -52,13 +135,21 @@ static int TileEngineL_GetNPC(lua_State* luaVM)
    
    switch(nargs)
    {
-      case 5:
+      case 2:
       {
          TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
          if (tileEngine)
          {
-            std::string npcName(lua_tostring(luaVM, 2));
-            npc = tileEngine->getNPC(npcName);
+            if(lua_type(luaVM, 2) == LUA_TNUMBER)
+            {
+               // Handles resolve straight to the NPC, without building a string or hashing a name
+               npc = tileEngine->resolveNPC(static_cast<ActorTable::ActorHandle>(lua_tonumber(luaVM, 2)));
+            }
+            else
+            {
+               std::string npcName(luaL_checkstring(luaVM, 2));
+               npc = tileEngine->getNPC(npcName);
+            }
          }
       }
    }
@@ -67,6 +158,476 @@ static int TileEngineL_GetNPC(lua_State* luaVM)
    return 1;
 }
 
+static int TileEngineL_GetHandle(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   Actor* actor = luaW_check<Actor>(luaVM, 2);
+   if (tileEngine && actor)
+   {
+      lua_pushnumber(luaVM, tileEngine->getActorHandle(actor));
+      return 1;
+   }
+
+   return 0;
+}
+
+/**
+ * Pushes a list of actors onto the Lua stack as an array.
+ */
+static void pushActorList(lua_State* luaVM, const std::vector<Actor*>& actors)
+{
+   lua_createtable(luaVM, actors.size(), 0);
+   for(unsigned int i = 0; i < actors.size(); ++i)
+   {
+      luaW_push<Actor>(luaVM, actors[i]);
+      lua_rawseti(luaVM, -2, i + 1);
+   }
+}
+
+static int TileEngineL_GetActorsInArea(lua_State* luaVM)
+{
+   std::vector<Actor*> actors;
+
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      int x = luaL_checkint(luaVM, 2);
+      int y = luaL_checkint(luaVM, 3);
+      int width = luaL_checkint(luaVM, 4);
+      int height = luaL_checkint(luaVM, 5);
+
+      tileEngine->findActorsInArea(shapes::Rectangle(y, x, y + height - 1, x + width - 1), actors);
+   }
+
+   pushActorList(luaVM, actors);
+   return 1;
+}
+
+static int TileEngineL_GetActorsInRadius(lua_State* luaVM)
+{
+   std::vector<Actor*> actors;
+
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      int x = luaL_checkint(luaVM, 2);
+      int y = luaL_checkint(luaVM, 3);
+      int radius = luaL_checkint(luaVM, 4);
+
+      tileEngine->findActorsInRadius(shapes::Point2D(x, y), radius, actors);
+   }
+
+   pushActorList(luaVM, actors);
+   return 1;
+}
+
+static int TileEngineL_GetNearestActor(lua_State* luaVM)
+{
+   Actor* actor = NULL;
+
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      int x = luaL_checkint(luaVM, 2);
+      int y = luaL_checkint(luaVM, 3);
+      int radius = luaL_checkint(luaVM, 4);
+
+      // Scripts searching around one of the actors can pass it in to leave it out of the search
+      Actor* excludedActor = lua_gettop(luaVM) >= 5 ? luaW_check<Actor>(luaVM, 5) : NULL;
+      actor = tileEngine->findNearestActor(shapes::Point2D(x, y), radius, excludedActor);
+   }
+
+   luaW_push<Actor>(luaVM, actor);
+   return 1;
+}
+
+/**
+ * Reads a list of actors (or their handles) from a table on the Lua stack. The whole list is read before anything is
+ * done with it, so an entry that is neither an actor nor a handle raises an error without any of the actors being touched.
+ * Handles that no longer resolve (such as those of NPCs that have been removed) and false entries (such as addNPCs
+ * hands back for the NPCs it couldn't place) are read as NULL.
+ */
+static void readActorList(lua_State* luaVM, TileEngine* tileEngine, int index, std::vector<Actor*>& actors)
+{
+   luaL_checktype(luaVM, index, LUA_TTABLE);
+   const int actorCount = static_cast<int>(lua_objlen(luaVM, index));
+   actors.reserve(actorCount);
+   for(int i = 1; i <= actorCount; ++i)
+   {
+      lua_rawgeti(luaVM, index, i);
+      if(lua_type(luaVM, -1) == LUA_TNUMBER)
+      {
+         actors.push_back(tileEngine->resolveActor(static_cast<ActorTable::ActorHandle>(lua_tonumber(luaVM, -1))));
+      }
+      else if(lua_type(luaVM, -1) == LUA_TBOOLEAN && !lua_toboolean(luaVM, -1))
+      {
+         actors.push_back(NULL);
+      }
+      else
+      {
+         Actor* actor = luaW_to<Actor>(luaVM, -1);
+         if(actor == NULL)
+         {
+            luaL_error(luaVM, "entry %d of the actor list is neither an actor nor a handle", i);
+         }
+
+         actors.push_back(actor);
+      }
+
+      lua_pop(luaVM, 1);
+   }
+}
+
+static int TileEngineL_MoveActors(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (!tileEngine)
+   {
+      return 0;
+   }
+
+   std::vector<Actor*> actors;
+   readActorList(luaVM, tileEngine, 2, actors);
+
+   // The destinations are a flat list of the form { x1, y1, x2, y2, ... }, so that no table is built for each actor
+   luaL_checktype(luaVM, 3, LUA_TTABLE);
+   luaL_argcheck(luaVM, lua_objlen(luaVM, 3) >= actors.size() * 2, 3, "expected an x and a y for every actor");
+
+   std::vector<TileEngine::ActorMove> moves;
+   moves.reserve(actors.size());
+   for(unsigned int i = 0; i < actors.size(); ++i)
+   {
+      lua_rawgeti(luaVM, 3, i * 2 + 1);
+      lua_rawgeti(luaVM, 3, i * 2 + 2);
+      TileEngine::ActorMove move;
+      move.actor = actors[i];
+      move.destination = shapes::Point2D(luaL_checkint(luaVM, -2), luaL_checkint(luaVM, -1));
+      lua_pop(luaVM, 2);
+
+      if(move.actor != NULL)
+      {
+         moves.push_back(move);
+      }
+   }
+
+   tileEngine->moveActors(moves);
+   return 0;
+}
+
+static int TileEngineL_SetActorAnimations(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (!tileEngine)
+   {
+      return 0;
+   }
+
+   std::vector<Actor*> actors;
+   readActorList(luaVM, tileEngine, 2, actors);
+
+   // Either every actor plays the same animation, or there is a list with an animation for each actor
+   const bool sharedAnimation = lua_type(luaVM, 3) != LUA_TTABLE;
+   if(!sharedAnimation)
+   {
+      luaL_argcheck(luaVM, lua_objlen(luaVM, 3) == actors.size(), 3, "expected an animation for every actor");
+   }
+
+   const std::string sharedName = sharedAnimation ? luaL_checkstring(luaVM, 3) : "";
+   std::vector<Actor*> animatedActors;
+   std::vector<std::string> animationNames;
+   animatedActors.reserve(actors.size());
+   if(sharedAnimation)
+   {
+      animationNames.push_back(sharedName);
+   }
+
+   for(unsigned int i = 0; i < actors.size(); ++i)
+   {
+      if(!sharedAnimation)
+      {
+         lua_rawgeti(luaVM, 3, i + 1);
+         const char* animationName = luaL_checkstring(luaVM, -1);
+         if(actors[i] != NULL)
+         {
+            animationNames.push_back(animationName);
+         }
+
+         lua_pop(luaVM, 1);
+      }
+
+      if(actors[i] != NULL)
+      {
+         animatedActors.push_back(actors[i]);
+      }
+   }
+
+   if(!animatedActors.empty())
+   {
+      tileEngine->setActorAnimations(animatedActors, animationNames);
+   }
+
+   return 0;
+}
+
+static int TileEngineL_GetActorLocations(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (!tileEngine)
+   {
+      return 0;
+   }
+
+   std::vector<Actor*> actors;
+   readActorList(luaVM, tileEngine, 2, actors);
+
+   std::vector<shapes::Point2D> locations;
+   tileEngine->getActorLocations(actors, locations);
+
+   // The locations are written into the table passed in (if there is one), so that a script querying every frame
+   // can reuse one table; they are a flat list of the form { x1, y1, x2, y2, ... }, with false for the actors that are gone
+   if(lua_type(luaVM, 3) == LUA_TTABLE)
+   {
+      lua_pushvalue(luaVM, 3);
+   }
+   else
+   {
+      lua_createtable(luaVM, actors.size() * 2, 0);
+   }
+
+   for(unsigned int i = 0; i < actors.size(); ++i)
+   {
+      if(actors[i] != NULL)
+      {
+         lua_pushinteger(luaVM, locations[i].x);
+         lua_rawseti(luaVM, -2, i * 2 + 1);
+         lua_pushinteger(luaVM, locations[i].y);
+         lua_rawseti(luaVM, -2, i * 2 + 2);
+      }
+      else
+      {
+         lua_pushboolean(luaVM, 0);
+         lua_rawseti(luaVM, -2, i * 2 + 1);
+         lua_pushboolean(luaVM, 0);
+         lua_rawseti(luaVM, -2, i * 2 + 2);
+      }
+   }
+
+   return 1;
+}
+
+static int TileEngineL_AddObstacle(lua_State* luaVM)
+{
+   bool added = false;
+
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      int x = luaL_checkint(luaVM, 2);
+      int y = luaL_checkint(luaVM, 3);
+      int width = luaL_checkint(luaVM, 4);
+      int height = luaL_checkint(luaVM, 5);
+      added = tileEngine->addObstacle(shapes::Point2D(x, y), width, height);
+   }
+
+   lua_pushboolean(luaVM, added);
+   return 1;
+}
+
+static int TileEngineL_RemoveObstacle(lua_State* luaVM)
+{
+   bool removed = false;
+
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      int x = luaL_checkint(luaVM, 2);
+      int y = luaL_checkint(luaVM, 3);
+      int width = luaL_checkint(luaVM, 4);
+      int height = luaL_checkint(luaVM, 5);
+      removed = tileEngine->removeObstacle(shapes::Point2D(x, y), width, height);
+   }
+
+   lua_pushboolean(luaVM, removed);
+   return 1;
+}
+
+static int TileEngineL_AddTrigger(lua_State* luaVM)
+{
+   TriggerZones::TriggerId trigger = TriggerZones::INVALID_TRIGGER;
+
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      // A trigger zone is either laid out in the map file and named, or given as an area
+      if(lua_type(luaVM, 2) == LUA_TSTRING)
+      {
+         trigger = tileEngine->addTrigger(std::string(lua_tostring(luaVM, 2)));
+      }
+      else
+      {
+         int x = luaL_checkint(luaVM, 2);
+         int y = luaL_checkint(luaVM, 3);
+         int width = luaL_checkint(luaVM, 4);
+         int height = luaL_checkint(luaVM, 5);
+
+         trigger = tileEngine->addTrigger(shapes::Rectangle(y, x, y + height - 1, x + width - 1));
+      }
+   }
+
+   if(trigger == TriggerZones::INVALID_TRIGGER)
+   {
+      lua_pushnil(luaVM);
+   }
+   else
+   {
+      lua_pushnumber(luaVM, trigger);
+   }
+
+   return 1;
+}
+
+static int TileEngineL_RemoveTrigger(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      tileEngine->removeTrigger(static_cast<TriggerZones::TriggerId>(luaL_checknumber(luaVM, 2)));
+   }
+
+   return 0;
+}
+
+static int TileEngineL_WaitForTrigger(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      return tileEngine->waitForTrigger(static_cast<TriggerZones::TriggerId>(luaL_checknumber(luaVM, 2)));
+   }
+
+   return 0;
+}
+
+static int TileEngineL_WaitUntilIdle(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   Actor* actor = luaW_check<Actor>(luaVM, 2);
+   if (tileEngine && actor)
+   {
+      return tileEngine->waitUntilIdle(actor);
+   }
+
+   return 0;
+}
+
+static int TileEngineL_WaitUntilAllIdle(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      std::vector<Actor*> actors;
+      readActorList(luaVM, tileEngine, 2, actors);
+      return tileEngine->waitUntilIdle(actors, true);
+   }
+
+   return 0;
+}
+
+static int TileEngineL_WaitUntilAnyIdle(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      std::vector<Actor*> actors;
+      readActorList(luaVM, tileEngine, 2, actors);
+      return tileEngine->waitUntilIdle(actors, false);
+   }
+
+   return 0;
+}
+
+static int TileEngineL_WaitUntilArrived(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   Actor* actor = luaW_check<Actor>(luaVM, 2);
+   if (tileEngine && actor)
+   {
+      const shapes::Point2D point(luaL_checkint(luaVM, 3), luaL_checkint(luaVM, 4));
+      const int radius = luaL_optint(luaVM, 5, 0);
+      luaL_argcheck(luaVM, radius >= 0, 5, "radius must not be negative");
+      return tileEngine->waitUntilArrived(actor, point, radius);
+   }
+
+   return 0;
+}
+
+static int TileEngineL_WaitUntilFlag(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      // The flag can be a key from flags:key() or the flag's name, as with the flag store's own functions
+      FlagStore& flags = tileEngine->getFlags();
+      FlagStore::Key key;
+      if(lua_type(luaVM, 2) == LUA_TNUMBER)
+      {
+         key = static_cast<FlagStore::Key>(lua_tointeger(luaVM, 2));
+         luaL_argcheck(luaVM, flags.isKey(key), 2, "not a flag key");
+      }
+      else
+      {
+         key = flags.getKey(luaL_checkstring(luaVM, 2));
+      }
+
+      // The kind of value waited for follows the Lua type of the value (nil waits for the flag to be unset)
+      switch(lua_type(luaVM, 3))
+      {
+         case LUA_TNONE:
+         case LUA_TNIL:
+         {
+            return tileEngine->waitUntilFlag(key, FlagStore::UNSET, 0);
+         }
+         case LUA_TBOOLEAN:
+         {
+            return tileEngine->waitUntilFlag(key, FlagStore::BOOL, lua_toboolean(luaVM, 3));
+         }
+         case LUA_TNUMBER:
+         {
+            return tileEngine->waitUntilFlag(key, FlagStore::INT, lua_tointeger(luaVM, 3));
+         }
+         case LUA_TSTRING:
+         {
+            return tileEngine->waitUntilFlag(key, FlagStore::STRING, 0, lua_tostring(luaVM, 3));
+         }
+         default:
+         {
+            luaL_argerror(luaVM, 3, "expected nil, a boolean, a number or a string");
+         }
+      }
+   }
+
+   return 0;
+}
+
+static int TileEngineL_GetTriggerEvent(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      // Hands back the actor that came or went (nil if it has been removed since) and whether it came in, or nothing if the zone has no events
+      Actor* actor;
+      bool entered;
+      if(tileEngine->takeTriggerEvent(static_cast<TriggerZones::TriggerId>(luaL_checknumber(luaVM, 2)), actor, entered))
+      {
+         luaW_push<Actor>(luaVM, actor);
+         lua_pushboolean(luaVM, entered);
+         return 2;
+      }
+   }
+
+   return 0;
+}
+
 static int TileEngineL_TilesToPixels(lua_State* luaVM)
 {
    TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
@@ -80,11 +641,251 @@ static int TileEngineL_TilesToPixels(lua_State* luaVM)
    return 0;
 }
 
+static int TileEngineL_SetAmbientLight(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      float r = static_cast<float>(luaL_checknumber(luaVM, 2));
+      float g = static_cast<float>(luaL_checknumber(luaVM, 3));
+      float b = static_cast<float>(luaL_checknumber(luaVM, 4));
+      tileEngine->getLightMap().setAmbientLight(r, g, b);
+   }
+
+   return 0;
+}
+
+static int TileEngineL_AddLight(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      int x = luaL_checkint(luaVM, 2);
+      int y = luaL_checkint(luaVM, 3);
+      int radius = luaL_checkint(luaVM, 4);
+      float r = static_cast<float>(luaL_checknumber(luaVM, 5));
+      float g = static_cast<float>(luaL_checknumber(luaVM, 6));
+      float b = static_cast<float>(luaL_checknumber(luaVM, 7));
+      tileEngine->getLightMap().addLight(x, y, radius, r, g, b);
+   }
+
+   return 0;
+}
+
+static int TileEngineL_ClearLights(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      tileEngine->getLightMap().clear();
+   }
+
+   return 0;
+}
+
+/**
+ * @param luaVM The Lua state, with a table at the given index.
+ * @param index The index of the table on the Lua stack.
+ * @param name The name of a field of the table.
+ * @param defaultValue The value to use if the table doesn't have the field.
+ *
+ * @return The number in the field, or the default value.
+ */
+static float getNumberField(lua_State* luaVM, int index, const char* name, float defaultValue)
+{
+   lua_getfield(luaVM, index, name);
+   const float value = lua_isnil(luaVM, -1) ? defaultValue : static_cast<float>(luaL_checknumber(luaVM, -1));
+   lua_pop(luaVM, 1);
+   return value;
+}
+
+static int TileEngineL_AddParticleEmitter(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   luaL_checktype(luaVM, 2, LUA_TTABLE);
+   if (!tileEngine)
+   {
+      return 0;
+   }
+
+   // The emitter is described by a table of the form { x = ..., y = ..., width = ..., height = ..., actor = ..., screen = ...,
+   // rate = ..., lifetime = ..., duration = ..., vx = ..., vy = ..., spreadX = ..., spreadY = ..., gravity = ..., size = ...,
+   // r = ..., g = ..., b = ..., a = ..., shape = "dots" or "streaks" }, where every field is optional
+   ParticleSystem::EmitterSettings settings;
+   settings.x = static_cast<int>(getNumberField(luaVM, 2, "x", static_cast<float>(settings.x)));
+   settings.y = static_cast<int>(getNumberField(luaVM, 2, "y", static_cast<float>(settings.y)));
+   settings.width = static_cast<int>(getNumberField(luaVM, 2, "width", static_cast<float>(settings.width)));
+   settings.height = static_cast<int>(getNumberField(luaVM, 2, "height", static_cast<float>(settings.height)));
+   settings.rate = getNumberField(luaVM, 2, "rate", settings.rate);
+   settings.lifetime = static_cast<long>(getNumberField(luaVM, 2, "lifetime", static_cast<float>(settings.lifetime)));
+   settings.duration = static_cast<long>(getNumberField(luaVM, 2, "duration", static_cast<float>(settings.duration)));
+   settings.velocityX = getNumberField(luaVM, 2, "vx", settings.velocityX);
+   settings.velocityY = getNumberField(luaVM, 2, "vy", settings.velocityY);
+   settings.velocitySpreadX = getNumberField(luaVM, 2, "spreadX", settings.velocitySpreadX);
+   settings.velocitySpreadY = getNumberField(luaVM, 2, "spreadY", settings.velocitySpreadY);
+   settings.gravity = getNumberField(luaVM, 2, "gravity", settings.gravity);
+   settings.size = getNumberField(luaVM, 2, "size", settings.size);
+   settings.red = getNumberField(luaVM, 2, "r", settings.red);
+   settings.green = getNumberField(luaVM, 2, "g", settings.green);
+   settings.blue = getNumberField(luaVM, 2, "b", settings.blue);
+   settings.alpha = getNumberField(luaVM, 2, "a", settings.alpha);
+
+   // The emitter can follow an actor, given either as the actor or its handle
+   lua_getfield(luaVM, 2, "actor");
+   if(lua_type(luaVM, -1) == LUA_TNUMBER)
+   {
+      settings.actor = static_cast<ActorTable::ActorHandle>(lua_tonumber(luaVM, -1));
+   }
+   else if(!lua_isnil(luaVM, -1))
+   {
+      settings.actor = tileEngine->getActorHandle(luaW_check<Actor>(luaVM, -1));
+   }
+
+   lua_getfield(luaVM, 2, "screen");
+   settings.coversScreen = lua_toboolean(luaVM, -1) != 0;
+
+   lua_getfield(luaVM, 2, "shape");
+   if(!lua_isnil(luaVM, -1))
+   {
+      const std::string shape(luaL_checkstring(luaVM, -1));
+      settings.shape = shape == "streaks" ? ParticleSystem::STREAKS : ParticleSystem::DOTS;
+   }
+
+   lua_pop(luaVM, 3);
+
+   lua_pushnumber(luaVM, tileEngine->getParticles().addEmitter(settings));
+   return 1;
+}
+
+static int TileEngineL_RemoveParticleEmitter(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      // By default the emitter just stops spawning, so that the particles already out die out on their own
+      const ParticleSystem::EmitterId emitter = static_cast<ParticleSystem::EmitterId>(luaL_checknumber(luaVM, 2));
+      if(lua_toboolean(luaVM, 3))
+      {
+         tileEngine->getParticles().removeEmitter(emitter);
+      }
+      else
+      {
+         tileEngine->getParticles().stopEmitter(emitter);
+      }
+   }
+
+   return 0;
+}
+
+static int TileEngineL_ClearParticles(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      tileEngine->getParticles().clear();
+   }
+
+   return 0;
+}
+
+static int TileEngineL_SetPerspective(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   luaL_checktype(luaVM, 2, LUA_TTABLE);
+   if (tileEngine)
+   {
+      // The camera is described by a table of the form { tilt = ..., rotation = ..., zoom = ..., x = ..., y = ... }, where every field is optional;
+      // without x and y, the camera looks at whatever the flat camera would have centered on
+      PerspectiveLayerRenderer::View view;
+      view.tilt = getNumberField(luaVM, 2, "tilt", view.tilt);
+      view.rotation = getNumberField(luaVM, 2, "rotation", view.rotation);
+      view.zoom = getNumberField(luaVM, 2, "zoom", view.zoom);
+
+      lua_getfield(luaVM, 2, "x");
+      lua_getfield(luaVM, 2, "y");
+      const bool followCamera = lua_isnil(luaVM, -2) && lua_isnil(luaVM, -1);
+      lua_pop(luaVM, 2);
+
+      view.x = getNumberField(luaVM, 2, "x", view.x);
+      view.y = getNumberField(luaVM, 2, "y", view.y);
+      tileEngine->setPerspective(view, followCamera);
+   }
+
+   return 0;
+}
+
+static int TileEngineL_ClearPerspective(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      tileEngine->clearPerspective();
+   }
+
+   return 0;
+}
+
+static int TileEngineL_ShowMinimap(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      int x = luaL_checkint(luaVM, 2);
+      int y = luaL_checkint(luaVM, 3);
+      int width = luaL_checkint(luaVM, 4);
+      int height = luaL_checkint(luaVM, 5);
+      tileEngine->showMinimap(shapes::Rectangle(y, x, y + height - 1, x + width - 1));
+   }
+
+   return 0;
+}
+
+static int TileEngineL_HideMinimap(lua_State* luaVM)
+{
+   TileEngine* tileEngine = luaW_check<TileEngine>(luaVM, 1);
+   if (tileEngine)
+   {
+      tileEngine->hideMinimap();
+   }
+
+   return 0;
+}
+
 static luaL_reg tileEngineMetatable[] =
 {
    { "addNPC", TileEngineL_AddNPC },
+   { "addNPCs", TileEngineL_AddNPCs },
+   { "removeNPC", TileEngineL_RemoveNPC },
    { "getNPC", TileEngineL_GetNPC },
+   { "getHandle", TileEngineL_GetHandle },
+   { "getActorsInArea", TileEngineL_GetActorsInArea },
+   { "getActorsInRadius", TileEngineL_GetActorsInRadius },
+   { "getNearestActor", TileEngineL_GetNearestActor },
+   { "moveActors", TileEngineL_MoveActors },
+   { "setActorAnimations", TileEngineL_SetActorAnimations },
+   { "getActorLocations", TileEngineL_GetActorLocations },
+   { "addObstacle", TileEngineL_AddObstacle },
+   { "removeObstacle", TileEngineL_RemoveObstacle },
+   { "addTrigger", TileEngineL_AddTrigger },
+   { "removeTrigger", TileEngineL_RemoveTrigger },
+   { "waitForTrigger", TileEngineL_WaitForTrigger },
+   { "waitUntilIdle", TileEngineL_WaitUntilIdle },
+   { "waitUntilAllIdle", TileEngineL_WaitUntilAllIdle },
+   { "waitUntilAnyIdle", TileEngineL_WaitUntilAnyIdle },
+   { "waitUntilArrived", TileEngineL_WaitUntilArrived },
+   { "waitUntilFlag", TileEngineL_WaitUntilFlag },
+   { "getTriggerEvent", TileEngineL_GetTriggerEvent },
    { "tilesToPixels", TileEngineL_TilesToPixels },
+   { "setAmbientLight", TileEngineL_SetAmbientLight },
+   { "addLight", TileEngineL_AddLight },
+   { "clearLights", TileEngineL_ClearLights },
+   { "addParticleEmitter", TileEngineL_AddParticleEmitter },
+   { "removeParticleEmitter", TileEngineL_RemoveParticleEmitter },
+   { "clearParticles", TileEngineL_ClearParticles },
+   { "setPerspective", TileEngineL_SetPerspective },
+   { "clearPerspective", TileEngineL_ClearPerspective },
+   { "showMinimap", TileEngineL_ShowMinimap },
+   { "hideMinimap", TileEngineL_HideMinimap },
    { NULL, NULL }
 };
 
@@ -5,25 +5,48 @@
  */
 
 #include "Map.h"
+#include "Map_ChunkLoader.h"
 #include "Tileset.h"
+#include "GLState.h"
+#include "FrameProfiler.h"
+#include "GPUPassTimer.h"
+#include "GraphicsUtil.h"
 #include "Obstacle.h"
 #include "Pathfinder.h"
+#include "RenderTarget.h"
 #include "ResourceLoader.h"
+#include "SpriteBatch.h"
+#include "Spritesheet.h"
+#include "StaticSpriteBatch.h"
 #include "TileEngine.h"
 #include "DebugUtils.h"
 
 #include <sstream>
+#include <algorithm>
 
 const int debugFlag = DEBUG_RES_LOAD;
 
 //#define DRAW_PASSIBILITY
 
-Map::Map()
+// A chunk of 32x32 tiles is 1024 pixels across, so a screen is covered by a handful of chunks,
+// while each chunk is still big enough that reading it costs far more than seeking to it
+const int Map::CHUNK_SIZE = 32;
+
+// One ring of chunks past the edges of the screen keeps the next chunks ready well before they scroll into view
+const int Map::CHUNK_STREAMING_RADIUS = 1;
+
+// Obstacle sprites are rarely more than a couple of tiles bigger than the tiles they block
+const int Map::OBSTACLE_DRAW_MARGIN = 2;
+
+Map::Map() : obstaclesBaked(false), streaming(false), streamedChunkArea(0, 0, -1, -1), tileset(NULL), layerCount(1), lowerLayerCount(1), chunksWide(0), chunksHigh(0), tilesetRevision(0), streamable(false), passibility(NULL), width(0), height(0)
 {
+   chunkLoader = new ChunkLoader(*this);
 }
 
-Map::Map(std::ifstream& in)
+Map::Map(std::istream& in) : obstaclesBaked(false), streaming(false), streamedChunkArea(0, 0, -1, -1), layerCount(1), lowerLayerCount(1), tilesetRevision(0), streamable(false), passibility(NULL)
 {
+   chunkLoader = new ChunkLoader(*this);
+
    /**
     * \todo Regions shouldn't assume that files are well-formed.
     *       Find and report errors if the file isn't formed ideally.
@@ -38,17 +61,22 @@ Map::Map(std::ifstream& in)
    in >> height;
 
    tileset = ResourceLoader::getTileset(tilesetName);
+   tileset->acquire();
 
-   tileMap = new int*[height];
+   // The region file can't be read back a chunk at a time, so every chunk stays loaded
+   initializeChunks();
+   for(int chunkNum = 0; chunkNum < chunksWide * chunksHigh; ++chunkNum)
+   {
+      chunks[chunkNum] = new int[CHUNK_SIZE * CHUNK_SIZE];
+   }
 
    for(int i = 0; i < height; ++i)
    {
-      tileMap[i] = new int[width];
       for(int j = 0; j < width; ++j)
       {
          if(in)
          {
-            in >> tileMap[i][j];
+            in >> chunks[getChunkNum(j, i)][getChunkOffset(j, i)];
          }
          else
          {
@@ -80,25 +108,103 @@ Map::Map(std::ifstream& in)
       obstacles.push_back(new Obstacle(tileX, tileY, obstacleWidth, obstacleHeight, obstacleSheet, obstacleSpriteType, obstacleSpriteName));
    }
 
-   initializePassibilityMatrix();
+   initializePassibility();
 
    DEBUG("Map loaded.");
 }
 
 bool Map::isPassible(int x, int y) const
 {
-   return tileset->isPassible(tileMap[y][x]);
+   const int tileIndex = y * width + x;
+   return (passibility[tileIndex >> 3] & (1 << (tileIndex & 7))) != 0;
+}
+
+void Map::initializeChunks()
+{
+   chunksWide = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+   chunksHigh = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+   chunks.assign(chunksWide * chunksHigh, static_cast<int*>(NULL));
+
+   for(std::vector<TileLayerRenderer*>::iterator iter = layerRenderers.begin(); iter != layerRenderers.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   for(std::vector<PerspectiveLayerRenderer*>::iterator iter = perspectiveRenderers.begin(); iter != perspectiveRenderers.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   perspectiveRenderers.clear();
+
+   // Every layer after the floor is drawn over other tiles, so it blends with them
+   layerRenderers.clear();
+   for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+   {
+      layerRenderers.push_back(new TileLayerRenderer(layerNum > 0));
+      layerRenderers.back()->resize(chunksWide, chunksHigh);
+   }
+}
+
+int Map::getChunkNum(int x, int y) const
+{
+   return (y / CHUNK_SIZE) * chunksWide + x / CHUNK_SIZE;
+}
+
+int Map::getChunkOffset(int x, int y)
+{
+   return (y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE;
+}
+
+int Map::getTile(int x, int y) const
+{
+   return chunks[getChunkNum(x, y)][getChunkOffset(x, y)];
 }
 
-void Map::initializePassibilityMatrix()
+void Map::readChunk(int /*chunkX*/, int /*chunkY*/, int* /*tiles*/) const
 {
-   passibilityMap = new bool*[height];
+   T_T("Map tiles can't be read back from the map data.");
+}
+
+int* Map::loadChunk(int chunkNum) const
+{
+   int* tiles = new int[CHUNK_SIZE * CHUNK_SIZE * layerCount];
+   try
+   {
+      readChunk(chunkNum % chunksWide, chunkNum / chunksWide, tiles);
+   }
+   catch(Exception& e)
+   {
+      delete [] tiles;
+      throw;
+   }
+
+   return tiles;
+}
+
+void Map::allocatePassibility()
+{
+   passibilityBits.assign((width * height + 7) / 8, 0);
+   passibility = passibilityBits.empty() ? NULL : &passibilityBits[0];
+}
+
+void Map::setPassible(int x, int y)
+{
+   const int tileIndex = y * width + x;
+   passibilityBits[tileIndex >> 3] |= 1 << (tileIndex & 7);
+}
+
+void Map::initializePassibility()
+{
+   allocatePassibility();
    for(int y = 0; y < height; ++y)
    {
-      passibilityMap[y] = new bool[width];
       for(int x = 0; x < width; ++x)
       {
-         passibilityMap[y][x] = isPassible(x, y);
+         if(tileset->isPassible(getTile(x, y)))
+         {
+            setPassible(x, y);
+         }
       }
    }
 }
@@ -118,33 +224,277 @@ int Map::getHeight() const
    return height;
 }
 
+std::string Map::getProperty(const std::string& name) const
+{
+   std::map<std::string, std::string>::const_iterator iter = properties.find(name);
+   return iter != properties.end() ? iter->second : "";
+}
+
 const std::vector<Obstacle*> Map::getObstacles() const
 {
    return obstacles;
 }
 
-bool** Map::getPassibilityMatrix() const
+const std::vector<CollisionTree::Volume>& Map::getCollisionVolumes() const
 {
-   return passibilityMap;
+   return collisionVolumes;
 }
 
-void Map::step(long timePassed) const
+const unsigned char* Map::getPassibility() const
 {
+   return passibility;
+}
+
+bool Map::isFootprintInView(const shapes::Rectangle& footprint, const shapes::Rectangle& visibleArea)
+{
+   // Obstacle sprites are anchored to the bottom-left of their footprint, but can hang past it
+   const shapes::Rectangle obstacleArea(visibleArea.top - OBSTACLE_DRAW_MARGIN, visibleArea.left - OBSTACLE_DRAW_MARGIN,
+         visibleArea.bottom + OBSTACLE_DRAW_MARGIN, visibleArea.right + OBSTACLE_DRAW_MARGIN);
+
+   return footprint.intersects(obstacleArea);
+}
+
+bool Map::isObstacleInView(const Obstacle* obstacle, const shapes::Rectangle& visibleArea)
+{
+   const shapes::Rectangle footprint(obstacle->getTileY(), obstacle->getTileX(),
+         obstacle->getTileY() + obstacle->getHeight() - 1, obstacle->getTileX() + obstacle->getWidth() - 1);
+   return isFootprintInView(footprint, visibleArea);
+}
+
+void Map::step(long timePassed, const shapes::Rectangle& visibleArea) const
+{
+   tileset->step(timePassed);
+
    std::vector<Obstacle*>::const_iterator iter;
    for(iter = obstacles.begin(); iter != obstacles.end(); ++iter)
    {
-      (*iter)->step(timePassed);
+      if(obstaclesBaked && !(*iter)->isAnimated()) continue;
+
+      if(isObstacleInView(*iter, visibleArea))
+      {
+         (*iter)->step(timePassed);
+      }
    }
 }
 
-void Map::draw() const
+void Map::streamChunks(const shapes::Rectangle& visibleArea) const
 {
-   for(int i = 0; i < width; ++i)
+   if(!streamable) return;
+
+   if(!streaming)
+   {
+      // Without a loader thread, the chunks around the visible area are read on this thread instead
+      chunkLoader->start();
+      streaming = true;
+   }
+
+   const int visibleLeft = std::max(visibleArea.left / CHUNK_SIZE, 0);
+   const int visibleTop = std::max(visibleArea.top / CHUNK_SIZE, 0);
+   const int visibleRight = std::min(visibleArea.right / CHUNK_SIZE, chunksWide - 1);
+   const int visibleBottom = std::min(visibleArea.bottom / CHUNK_SIZE, chunksHigh - 1);
+
+   const shapes::Rectangle loadArea(
+         std::max(visibleTop - CHUNK_STREAMING_RADIUS, 0),
+         std::max(visibleLeft - CHUNK_STREAMING_RADIUS, 0),
+         std::min(visibleBottom + CHUNK_STREAMING_RADIUS, chunksHigh - 1),
+         std::min(visibleRight + CHUNK_STREAMING_RADIUS, chunksWide - 1));
+
+   // Chunks are released a ring further out than they are loaded, so that walking back and forth
+   // over a chunk boundary doesn't read the same chunks over and over
+   const shapes::Rectangle keepArea(
+         std::max(loadArea.top - 1, 0),
+         std::max(loadArea.left - 1, 0),
+         std::min(loadArea.bottom + 1, chunksHigh - 1),
+         std::min(loadArea.right + 1, chunksWide - 1));
+
+   std::list<ChunkLoader::LoadedChunk> loadedChunks;
+   chunkLoader->collectLoadedChunks(loadedChunks);
+   for(std::list<ChunkLoader::LoadedChunk>::iterator iter = loadedChunks.begin(); iter != loadedChunks.end(); ++iter)
    {
-      for(int j = 0; j < height; ++j)
+      const int chunkX = iter->chunkNum % chunksWide;
+      const int chunkY = iter->chunkNum / chunksWide;
+      if(chunks[iter->chunkNum] == NULL && chunkX >= keepArea.left && chunkX <= keepArea.right && chunkY >= keepArea.top && chunkY <= keepArea.bottom)
       {
+         chunks[iter->chunkNum] = iter->tiles;
+      }
+      else
+      {
+         delete [] iter->tiles;
+      }
+   }
+
+   if(loadArea.left == streamedChunkArea.left && loadArea.top == streamedChunkArea.top
+         && loadArea.right == streamedChunkArea.right && loadArea.bottom == streamedChunkArea.bottom)
+   {
+      // Everything in range is either loaded or already queued
+      return;
+   }
+
+   streamedChunkArea = loadArea;
+
+   for(int chunkY = 0; chunkY < chunksHigh; ++chunkY)
+   {
+      for(int chunkX = 0; chunkX < chunksWide; ++chunkX)
+      {
+         const int chunkNum = chunkY * chunksWide + chunkX;
+         if(chunks[chunkNum] != NULL && (chunkX < keepArea.left || chunkX > keepArea.right || chunkY < keepArea.top || chunkY > keepArea.bottom))
+         {
+            delete [] chunks[chunkNum];
+            chunks[chunkNum] = NULL;
+            for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+            {
+               layerRenderers[layerNum]->releaseChunk(chunkNum);
+            }
+
+            for(std::vector<PerspectiveLayerRenderer*>::const_iterator iter = perspectiveRenderers.begin(); iter != perspectiveRenderers.end(); ++iter)
+            {
+               (*iter)->releaseChunk(chunkNum);
+            }
+         }
+      }
+   }
+
+   // The visible chunks are needed for this frame's drawing, so they can't wait for the loader
+   for(int chunkY = visibleTop; chunkY <= visibleBottom; ++chunkY)
+   {
+      for(int chunkX = visibleLeft; chunkX <= visibleRight; ++chunkX)
+      {
+         const int chunkNum = chunkY * chunksWide + chunkX;
+         if(chunks[chunkNum] == NULL)
+         {
+            chunks[chunkNum] = loadChunk(chunkNum);
+         }
+      }
+   }
+
+   // Queue the rest of the chunks in range, starting with the ring closest to the visible area
+   std::vector<int> chunksToLoad;
+   for(int distance = 1; distance <= CHUNK_STREAMING_RADIUS; ++distance)
+   {
+      for(int chunkY = loadArea.top; chunkY <= loadArea.bottom; ++chunkY)
+      {
+         for(int chunkX = loadArea.left; chunkX <= loadArea.right; ++chunkX)
+         {
+            const int xDistance = std::max(visibleLeft - chunkX, chunkX - visibleRight);
+            const int yDistance = std::max(visibleTop - chunkY, chunkY - visibleBottom);
+            const int chunkNum = chunkY * chunksWide + chunkX;
+            if(std::max(xDistance, yDistance) == distance && chunks[chunkNum] == NULL)
+            {
+               chunksToLoad.push_back(chunkNum);
+            }
+         }
+      }
+   }
+
+   if(chunkLoader->isRunning())
+   {
+      chunkLoader->setChunkQueue(chunksToLoad);
+   }
+   else
+   {
+      for(std::vector<int>::const_iterator iter = chunksToLoad.begin(); iter != chunksToLoad.end(); ++iter)
+      {
+         chunks[*iter] = loadChunk(*iter);
+      }
+   }
+
+   DEBUG("Streaming chunks %d,%d to %d,%d of map %s", loadArea.left, loadArea.top, loadArea.right, loadArea.bottom, mapName.c_str());
+}
+
+void Map::releaseChunks() const
+{
+   if(!streamable) return;
+
+   chunkLoader->stop();
+   streaming = false;
+   streamedChunkArea = shapes::Rectangle(0, 0, -1, -1);
+
+   for(std::vector<int*>::iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
+   {
+      delete [] *iter;
+      *iter = NULL;
+   }
+
+   for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+   {
+      layerRenderers[layerNum]->resize(chunksWide, chunksHigh);
+   }
+
+   for(std::vector<PerspectiveLayerRenderer*>::const_iterator iter = perspectiveRenderers.begin(); iter != perspectiveRenderers.end(); ++iter)
+   {
+      (*iter)->resize(width, height, CHUNK_SIZE);
+   }
+}
+
+void Map::checkTilesetRevision() const
+{
+   if(tileset->getRevision() == tilesetRevision) return;
+
+   // The tileset was reloaded, so every chunk is rebuilt with its new texture coordinates and animations
+   DEBUG("Rebuilding the tiles of map %s, since its tileset was reloaded.", mapName.c_str());
+   tilesetRevision = tileset->getRevision();
+   for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+   {
+      layerRenderers[layerNum]->resize(chunksWide, chunksHigh);
+   }
+
+   for(std::vector<PerspectiveLayerRenderer*>::const_iterator iter = perspectiveRenderers.begin(); iter != perspectiveRenderers.end(); ++iter)
+   {
+      (*iter)->resize(width, height, CHUNK_SIZE);
+   }
+}
+
+void Map::drawLayers(int firstLayer, int endLayer, const shapes::Rectangle& visibleArea) const
+{
+   const int visibleLeft = std::max(visibleArea.left, 0);
+   const int visibleTop = std::max(visibleArea.top, 0);
+   const int visibleRight = std::min(visibleArea.right, width - 1);
+   const int visibleBottom = std::min(visibleArea.bottom, height - 1);
+   if(visibleLeft > visibleRight || visibleTop > visibleBottom) return;
+
+   const shapes::Rectangle visibleChunks(visibleTop / CHUNK_SIZE, visibleLeft / CHUNK_SIZE, visibleBottom / CHUNK_SIZE, visibleRight / CHUNK_SIZE);
+
+   checkTilesetRevision();
+
+   PROFILE_GPU_PASS("Map layers");
+   for(int layerNum = firstLayer; layerNum < endLayer; ++layerNum)
+   {
+      TileLayerRenderer& layerRenderer = *layerRenderers[layerNum];
+      for(int chunkY = visibleChunks.top; chunkY <= visibleChunks.bottom; ++chunkY)
+      {
+         for(int chunkX = visibleChunks.left; chunkX <= visibleChunks.right; ++chunkX)
+         {
+            const int chunkNum = chunkY * chunksWide + chunkX;
+            const int* tiles = chunks[chunkNum];
+            if(tiles == NULL || layerRenderer.isChunkBuilt(chunkNum)) continue;
+
+            const int chunkLeft = chunkX * CHUNK_SIZE;
+            const int chunkTop = chunkY * CHUNK_SIZE;
+            const int chunkWidth = std::min(CHUNK_SIZE, width - chunkLeft);
+            const int chunkHeight = std::min(CHUNK_SIZE, height - chunkTop);
+            layerRenderer.buildChunk(chunkNum, *tileset, tiles + layerNum * CHUNK_SIZE * CHUNK_SIZE, CHUNK_SIZE, chunkLeft, chunkTop, chunkWidth, chunkHeight);
+         }
+      }
+
+      layerRenderer.draw(*tileset, visibleChunks, shapes::Rectangle(visibleTop, visibleLeft, visibleBottom, visibleRight));
+   }
+}
+
+void Map::draw(const shapes::Rectangle& visibleArea) const
+{
+   PROFILE_ZONE("Map::draw");
+
 #ifdef DRAW_PASSIBILITY
-         if(passibilityMap[j][i])
+   const int visibleLeft = std::max(visibleArea.left, 0);
+   const int visibleTop = std::max(visibleArea.top, 0);
+   const int visibleRight = std::min(visibleArea.right, width - 1);
+   const int visibleBottom = std::min(visibleArea.bottom, height - 1);
+
+   for(int i = visibleLeft; i <= visibleRight; ++i)
+   {
+      for(int j = visibleTop; j <= visibleBottom; ++j)
+      {
+         if(isPassible(i, j))
          {
             Tileset::drawColorToTile(i, j, 0.0f, 1.0f, 0.0f);
          }
@@ -152,32 +502,306 @@ void Map::draw() const
          {
             Tileset::drawColorToTile(i, j, 1.0f, 0.0f, 0.0f);
          }
+      }
+   }
+
+   GLState::setTexturing(true);
 #else
-         tileset->draw(i, j, tileMap[j][i]);
+   drawLayers(0, lowerLayerCount, visibleArea);
 #endif
+
+   drawObstacles(visibleArea);
+}
+
+void Map::bakeObstacles() const
+{
+   releaseObstacleBatches();
+   obstacleBatches.resize(chunksWide * chunksHigh);
+
+   std::vector<Obstacle*>::const_iterator iter;
+   for(iter = obstacles.begin(); iter != obstacles.end(); ++iter)
+   {
+      const Obstacle* obstacle = *iter;
+      if(obstacle->isAnimated()) continue;
+
+      // Stepping the obstacle catches its frame up with a reloaded spritesheet before it is baked
+      obstacle->step(0);
+
+      const Spritesheet* sheet = obstacle->getSpritesheet();
+      bool sheetKnown = false;
+      for(std::vector<std::pair<const Spritesheet*, unsigned int> >::const_iterator sheetIter = bakedSheets.begin(); sheetIter != bakedSheets.end(); ++sheetIter)
+      {
+         sheetKnown = sheetKnown || sheetIter->first == sheet;
+      }
+
+      if(!sheetKnown)
+      {
+         bakedSheets.push_back(std::make_pair(sheet, sheet->getRevision()));
+      }
+
+      // Obstacles are only placed on the map, but a stray one is kept with the nearest chunk rather than dropped
+      const int chunkX = std::min(std::max(obstacle->getTileX() / CHUNK_SIZE, 0), chunksWide - 1);
+      const int chunkY = std::min(std::max(obstacle->getTileY() / CHUNK_SIZE, 0), chunksHigh - 1);
+      ObstacleBatch& obstacleBatch = obstacleBatches[chunkY * chunksWide + chunkX];
+
+      const shapes::Rectangle footprint(obstacle->getTileY(), obstacle->getTileX(),
+            obstacle->getTileY() + obstacle->getHeight() - 1, obstacle->getTileX() + obstacle->getWidth() - 1);
+      if(obstacleBatch.batch == NULL)
+      {
+         obstacleBatch.batch = new StaticSpriteBatch();
+         obstacleBatch.footprint = footprint;
       }
+      else
+      {
+         obstacleBatch.footprint = shapes::Rectangle(std::min(obstacleBatch.footprint.top, footprint.top), std::min(obstacleBatch.footprint.left, footprint.left),
+               std::max(obstacleBatch.footprint.bottom, footprint.bottom), std::max(obstacleBatch.footprint.right, footprint.right));
+      }
+
+      obstacle->bake(*obstacleBatch.batch);
+   }
+
+   for(std::vector<ObstacleBatch>::iterator batchIter = obstacleBatches.begin(); batchIter != obstacleBatches.end(); ++batchIter)
+   {
+      if(batchIter->batch != NULL)
+      {
+         batchIter->batch->build();
+      }
+   }
+
+   obstaclesBaked = true;
+}
+
+void Map::releaseObstacleBatches() const
+{
+   for(std::vector<ObstacleBatch>::iterator iter = obstacleBatches.begin(); iter != obstacleBatches.end(); ++iter)
+   {
+      delete iter->batch;
+   }
+
+   obstacleBatches.clear();
+   bakedSheets.clear();
+   obstaclesBaked = false;
+}
+
+bool Map::haveObstacleSheetsChanged() const
+{
+   for(std::vector<std::pair<const Spritesheet*, unsigned int> >::const_iterator iter = bakedSheets.begin(); iter != bakedSheets.end(); ++iter)
+   {
+      if(iter->first->getRevision() != iter->second)
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void Map::drawObstacles(const shapes::Rectangle& visibleArea) const
+{
+   const bool batched = RenderTarget::hasDepthBuffer();
+   if(batched)
+   {
+      if(!obstaclesBaked || haveObstacleSheetsChanged())
+      {
+         bakeObstacles();
+      }
+
+      SpriteBatch* spriteBatch = GraphicsUtil::getInstance()->getSpriteBatch();
+      for(std::vector<ObstacleBatch>::const_iterator iter = obstacleBatches.begin(); iter != obstacleBatches.end(); ++iter)
+      {
+         if(iter->batch != NULL && isFootprintInView(iter->footprint, visibleArea))
+         {
+            spriteBatch->addStaticBatch(*iter->batch);
+         }
+      }
+   }
+   else if(obstaclesBaked)
+   {
+      releaseObstacleBatches();
    }
 
    std::vector<Obstacle*>::const_iterator iter;
    for(iter = obstacles.begin(); iter != obstacles.end(); ++iter)
    {
-      (*iter)->draw();
+      if(batched && !(*iter)->isAnimated()) continue;
+
+      if(isObstacleInView(*iter, visibleArea))
+      {
+         (*iter)->draw();
+      }
+   }
+}
+
+bool Map::hasUpperLayers() const
+{
+   return lowerLayerCount < layerCount;
+}
+
+void Map::drawUpperLayers(const shapes::Rectangle& visibleArea) const
+{
+#ifndef DRAW_PASSIBILITY
+   drawLayers(lowerLayerCount, layerCount, visibleArea);
+#endif
+}
+
+const Tileset& Map::getTileset() const
+{
+   return *tileset;
+}
+
+void Map::bakeMinimap(const std::vector<unsigned char>& tileColours, const shapes::Rectangle& area, std::vector<unsigned char>& pixels) const
+{
+   const int areaWidth = area.right - area.left + 1;
+   const int areaHeight = area.bottom - area.top + 1;
+   const int tileCount = static_cast<int>(tileColours.size() / 4);
+   pixels.assign(areaWidth * areaHeight * 4, 0);
+
+   for(int chunkY = area.top / CHUNK_SIZE; chunkY <= area.bottom / CHUNK_SIZE; ++chunkY)
+   {
+      for(int chunkX = area.left / CHUNK_SIZE; chunkX <= area.right / CHUNK_SIZE; ++chunkX)
+      {
+         const int chunkNum = chunkY * chunksWide + chunkX;
+
+         // Streamable maps release their chunks from the main thread, so their tiles are read afresh instead of from the loaded chunks
+         int* readTiles = NULL;
+         if(streamable)
+         {
+            try
+            {
+               readTiles = loadChunk(chunkNum);
+            }
+            catch(Exception& e)
+            {
+               DEBUG("Failed to read map chunk %d for the minimap: %s", chunkNum, e.getMessage().c_str());
+               continue;
+            }
+         }
+
+         const int* tiles = streamable ? readTiles : chunks[chunkNum];
+         if(tiles == NULL) continue;
+
+         const int chunkLeft = chunkX * CHUNK_SIZE;
+         const int chunkTop = chunkY * CHUNK_SIZE;
+         const int left = std::max(area.left, chunkLeft);
+         const int top = std::max(area.top, chunkTop);
+         const int right = std::min(area.right, chunkLeft + CHUNK_SIZE - 1);
+         const int bottom = std::min(area.bottom, chunkTop + CHUNK_SIZE - 1);
+
+         for(int y = top; y <= bottom; ++y)
+         {
+            for(int x = left; x <= right; ++x)
+            {
+               // Each layer's colour is laid over the layers under it, keeping the colour premultiplied by alpha along the way
+               unsigned int red = 0, green = 0, blue = 0, alpha = 0;
+               const int tileOffset = (y - chunkTop) * CHUNK_SIZE + (x - chunkLeft);
+               for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+               {
+                  const int tileNum = tiles[layerNum * CHUNK_SIZE * CHUNK_SIZE + tileOffset];
+                  if(tileNum < 0 || tileNum >= tileCount) continue;
+
+                  const unsigned char* colour = &tileColours[tileNum * 4];
+                  const unsigned int coverage = colour[3];
+                  red = (colour[0] * coverage + red * (255 - coverage)) / 255;
+                  green = (colour[1] * coverage + green * (255 - coverage)) / 255;
+                  blue = (colour[2] * coverage + blue * (255 - coverage)) / 255;
+                  alpha = coverage + alpha * (255 - coverage) / 255;
+               }
+
+               if(alpha == 0) continue;
+
+               unsigned char* pixel = &pixels[((y - area.top) * areaWidth + (x - area.left)) * 4];
+               pixel[0] = static_cast<unsigned char>(std::min(red * 255 / alpha, 255u));
+               pixel[1] = static_cast<unsigned char>(std::min(green * 255 / alpha, 255u));
+               pixel[2] = static_cast<unsigned char>(std::min(blue * 255 / alpha, 255u));
+               pixel[3] = static_cast<unsigned char>(alpha);
+            }
+         }
+
+         delete [] readTiles;
+      }
+   }
+}
+
+void Map::drawPerspective(const PerspectiveLayerRenderer::View& view, int screenWidth, int screenHeight) const
+{
+   PROFILE_ZONE("Map::drawPerspective");
+   PROFILE_GPU_PASS("Map layers");
+
+   if(perspectiveRenderers.empty())
+   {
+      for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+      {
+         perspectiveRenderers.push_back(new PerspectiveLayerRenderer(layerNum > 0));
+         perspectiveRenderers.back()->resize(width, height, CHUNK_SIZE);
+      }
+   }
+
+   checkTilesetRevision();
+
+   PerspectiveLayerRenderer::beginView(view, screenWidth, screenHeight);
+   for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+   {
+      // The camera can see far past the visible area, so every chunk that is loaded is copied into the layer's texture
+      PerspectiveLayerRenderer& layerRenderer = *perspectiveRenderers[layerNum];
+      for(int chunkNum = 0; chunkNum < chunksWide * chunksHigh; ++chunkNum)
+      {
+         const int* tiles = chunks[chunkNum];
+         if(tiles == NULL || layerRenderer.isChunkBuilt(chunkNum)) continue;
+
+         layerRenderer.buildChunk(chunkNum, *tileset, tiles + layerNum * CHUNK_SIZE * CHUNK_SIZE, CHUNK_SIZE);
+      }
+
+      layerRenderer.draw(*tileset);
    }
+
+   PerspectiveLayerRenderer::endView();
+}
+
+size_t Map::getSize() const
+{
+   size_t size = sizeof(Map) + obstacles.size() * sizeof(Obstacle);
+
+   for(std::vector<int*>::const_iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
+   {
+      if(*iter != NULL)
+      {
+         size += CHUNK_SIZE * CHUNK_SIZE * layerCount * sizeof(int);
+      }
+   }
+
+   size += passibilityBits.size();
+
+   return size;
 }
 
 Map::~Map()
 {
-   for(int i = 0; i < width; ++i)
+   delete chunkLoader;
+
+   if(tileset != NULL)
+   {
+      tileset->release();
+   }
+
+   for(std::vector<TileLayerRenderer*>::iterator iter = layerRenderers.begin(); iter != layerRenderers.end(); ++iter)
    {
-      delete [] tileMap[i];
-      delete [] passibilityMap[i];
+      delete *iter;
    }
 
+   for(std::vector<PerspectiveLayerRenderer*>::iterator iter = perspectiveRenderers.begin(); iter != perspectiveRenderers.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   for(std::vector<int*>::iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
+   {
+      delete [] *iter;
+   }
+
+   releaseObstacleBatches();
+
    for (unsigned int i = 0; i < obstacles.size(); i++)
    {
       delete obstacles[i];
    }
-
-   delete [] tileMap;
-   delete [] passibilityMap;
 }
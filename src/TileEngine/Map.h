@@ -8,11 +8,18 @@
 #define MAP_H
 
 #include <fstream>
+#include <map>
 #include <string>
 #include <vector>
+#include "CollisionTree.h"
+#include "PerspectiveLayerRenderer.h"
+#include "Rectangle.h"
+#include "TileLayerRenderer.h"
 
 class Tileset;
 class Obstacle;
+class Spritesheet;
+class StaticSpriteBatch;
 
 /**
  * A map is a subset of a Region consisting of a single rectangular set of tiles
@@ -24,7 +31,114 @@ class Obstacle;
  */
 class Map
 {
+   class ChunkLoader;
+   friend class ChunkLoader;
+
+   /** The distance (in tiles) past the visible area that obstacles are still drawn within, since their sprites can overhang their footprint. */
+   static const int OBSTACLE_DRAW_MARGIN;
+
+   /**
+    * @param obstacle An obstacle on the map.
+    * @param visibleArea The tiles that are on screen.
+    *
+    * @return true iff the obstacle's sprite could be drawn on screen.
+    */
+   static bool isObstacleInView(const Obstacle* obstacle, const shapes::Rectangle& visibleArea);
+
+   /**
+    * @param footprint The tiles taken up by one or more obstacles (with inclusive edge coordinates in tiles).
+    * @param visibleArea The tiles that are on screen.
+    *
+    * @return true iff the sprites of obstacles with the given footprint could be drawn on screen.
+    */
+   static bool isFootprintInView(const shapes::Rectangle& footprint, const shapes::Rectangle& visibleArea);
+
+   /** The static obstacles whose footprints start in a chunk, baked together. */
+   struct ObstacleBatch
+   {
+      /** The baked frames of the obstacles, or NULL if no static obstacles start in the chunk. */
+      StaticSpriteBatch* batch;
+
+      /** The tiles taken up by the obstacles (with inclusive edge coordinates in tiles). */
+      shapes::Rectangle footprint;
+
+      ObstacleBatch() : batch(NULL), footprint(0, 0, -1, -1) {}
+   };
+
+   /** Whether or not the map's static obstacles are currently baked into obstacleBatches. */
+   mutable bool obstaclesBaked;
+
+   /** The baked static obstacles, indexed by the number of the chunk that each obstacle's top-left tile is in. */
+   mutable std::vector<ObstacleBatch> obstacleBatches;
+
+   /** The spritesheets of the baked obstacles, and the revision of each that was baked, so that they are baked again when a sheet is reloaded. */
+   mutable std::vector<std::pair<const Spritesheet*, unsigned int> > bakedSheets;
+
+   /** The loader that reads chunks in the background for maps that stream their tiles. */
+   ChunkLoader* chunkLoader;
+
+   /** Whether or not the chunk loader has been started for the current streaming session. */
+   mutable bool streaming;
+
+   /** The area of chunks (with edge coordinates in chunks) that were last loaded or queued for loading. */
+   mutable shapes::Rectangle streamedChunkArea;
+
+   /**
+    * Reads the tiles of a chunk through readChunk.
+    *
+    * @param chunkNum The number of the chunk to read.
+    *
+    * @return The tiles of the chunk, which must be deleted by the caller.
+    */
+   int* loadChunk(int chunkNum) const;
+
+   /**
+    * Draws the loaded tiles of a range of the map's layers that fall within the visible area.
+    *
+    * @param firstLayer The first layer to draw.
+    * @param endLayer The layer after the last layer to draw.
+    * @param visibleArea The area of the map that is visible (with inclusive edge coordinates in tiles).
+    */
+   void drawLayers(int firstLayer, int endLayer, const shapes::Rectangle& visibleArea) const;
+
+   /**
+    * Makes every layer rebuild its chunks if the tileset has been reloaded since they were built.
+    */
+   void checkTilesetRevision() const;
+
+   /**
+    * Bakes the frames of every obstacle that isn't animated into the obstacle batch of its chunk,
+    * in place of any obstacle batches baked before. The OpenGL context must be current.
+    */
+   void bakeObstacles() const;
+
+   /**
+    * Deletes the obstacle batches, so that the static obstacles are drawn one at a time again until they are baked.
+    */
+   void releaseObstacleBatches() const;
+
+   /**
+    * @return true iff one of the baked obstacles' spritesheets has been reloaded since the obstacles were baked.
+    */
+   bool haveObstacleSheetsChanged() const;
+
+   /**
+    * Adds the obstacles that fall within the visible area to the sprite batch.
+    * Where there is a depth buffer, the static obstacles are added as their chunks' obstacle batches (which are baked the first time
+    * they are needed), and only the animated obstacles are drawn one at a time. Without a depth buffer, every obstacle is drawn one at a time, since
+    * the obstacle batches can only be ordered against the actors by the depth test.
+    *
+    * @param visibleArea The area of the map that is visible (with inclusive edge coordinates in tiles).
+    */
+   void drawObstacles(const shapes::Rectangle& visibleArea) const;
+
    protected:
+      /** The width and height (in tiles) of the square chunks that the map's tiles are stored in. */
+      static const int CHUNK_SIZE;
+
+      /** The number of chunks around the visible area to keep loaded, so that tiles are ready before they come into view. */
+      static const int CHUNK_STREAMING_RADIUS;
+
       /**
        * The delimiter for map data read from file.
        */
@@ -39,15 +153,58 @@ class Map
       /** Tileset in use by this map */
       Tileset* tileset;
 
-      /** The tiles of the map (as numbers referring to points in the Tileset) */
-      int** tileMap;
+      /**
+       * The tiles of each chunk of the map (as numbers referring to points in the Tileset), indexed by chunk number.
+       * Each chunk holds the tiles of every layer, one layer after another. Empty tiles are -1.
+       * Chunks that aren't loaded are NULL.
+       */
+      mutable std::vector<int*> chunks;
+
+      /** The number of tile layers in the map. The first layer is the floor, which determines the map's passibility. */
+      int layerCount;
+
+      /** The number of layers drawn under the obstacles and actors; the layers after them are drawn over the obstacles and actors. */
+      int lowerLayerCount;
+
+      /** Width (in chunks) of this map */
+      int chunksWide;
 
-      /** The passibility of the map */
-      bool** passibilityMap;
+      /** Height (in chunks) of this map */
+      int chunksHigh;
+
+      /** Draws the loaded chunks of each layer. A chunk's quads are built the first time it is drawn after being loaded. */
+      mutable std::vector<TileLayerRenderer*> layerRenderers;
+
+      /** Draws each layer as a plane seen in perspective. These are only created once the map is first drawn in perspective. */
+      mutable std::vector<PerspectiveLayerRenderer*> perspectiveRenderers;
+
+      /** The revision of the tileset that the layers' chunks were built from, so that they are rebuilt when it is reloaded. */
+      mutable unsigned int tilesetRevision;
+
+      /**
+       * Whether or not the map can read its tiles back through readChunk.
+       * Maps that can't keep all of their chunks loaded for as long as they exist.
+       */
+      bool streamable;
+
+      /** The storage for the map's passibility, if the map works it out itself (rather than reading it straight from its file). */
+      std::vector<unsigned char> passibilityBits;
+
+      /**
+       * The passibility of the map, packed one bit per tile in row order (bit i % 8 of byte i / 8, where i = y * width + x),
+       * which is set iff the tile is passible. NULL until the map is loaded.
+       */
+      const unsigned char* passibility;
+
+      /** The custom properties of the map, mapped by property name */
+      std::map<std::string, std::string> properties;
 
       /** The list of the map's obstacles */
       std::vector<Obstacle*> obstacles;
 
+      /** The obstacles and trigger zones of the map that don't line up with its tiles. */
+      std::vector<CollisionTree::Volume> collisionVolumes;
+
       /** Width (in tiles) of this map */
       int width;
 
@@ -55,14 +212,63 @@ class Map
       int height;
 
       /**
-       * @return true iff the tile at this location of the map is passible
+       * Sets up an empty chunk list for the map's width, height and number of layers. No chunks are loaded.
        */
-      bool isPassible(int x, int y) const;
+      void initializeChunks();
 
       /**
-       * Creates a 2-dimensional map that corresponds to the passibility of this Map
+       * @param x The x-coordinate of a tile on the map.
+       * @param y The y-coordinate of a tile on the map.
+       *
+       * @return The number of the chunk containing the tile.
+       */
+      int getChunkNum(int x, int y) const;
+
+      /**
+       * @param x The x-coordinate of a tile on the map.
+       * @param y The y-coordinate of a tile on the map.
+       *
+       * @return The index of the tile within its chunk's tiles.
+       */
+      static int getChunkOffset(int x, int y);
+
+      /**
+       * @param x The x-coordinate of a tile on the map, whose chunk must be loaded.
+       * @param y The y-coordinate of a tile on the map, whose chunk must be loaded.
+       *
+       * @return The tile number at this location of the map's floor layer.
+       */
+      int getTile(int x, int y) const;
+
+      /**
+       * Reads the tiles of a chunk from the map's source.
+       * This is called from the chunk loader's thread as well as the main thread,
+       * so it must not change the map.
+       *
+       * @param chunkX The x-coordinate (in chunks) of the chunk to read.
+       * @param chunkY The y-coordinate (in chunks) of the chunk to read.
+       * @param tiles The tiles of the chunk to fill in, with CHUNK_SIZE tiles per row and CHUNK_SIZE rows per layer.
        */
-      void initializePassibilityMatrix();
+      virtual void readChunk(int chunkX, int chunkY, int* tiles) const;
+
+      /**
+       * Allocates the passibility of this Map, with every tile impassible.
+       */
+      void allocatePassibility();
+
+      /**
+       * Marks a tile of the map as passible.
+       *
+       * @param x The x-coordinate (in tiles) of the tile.
+       * @param y The y-coordinate (in tiles) of the tile.
+       */
+      void setPassible(int x, int y);
+
+      /**
+       * Works out the passibility of this Map from the default passibility of its floor tiles in the tileset.
+       * All of the map's chunks must be loaded.
+       */
+      void initializePassibility();
 
       /**
        * Default constructor.
@@ -79,7 +285,7 @@ class Map
        * @param in The region file stream, currently pointing at the
        *           beginning of this Map's data.
        */
-      Map(std::ifstream& in);
+      Map(std::istream& in);
 
       /**
        * @return The name of this map.
@@ -96,26 +302,117 @@ class Map
        */
       int getHeight() const;
 
+      /**
+       * @param name The name of a custom map property.
+       *
+       * @return The value of the property, or an empty string if the map doesn't have it.
+       */
+      std::string getProperty(const std::string& name) const;
+
       /**
        * @return The list of obstacles for this map
        */
       const std::vector<Obstacle*> getObstacles() const;
 
       /**
-       * @return The passibility map of the 
+       * @return The obstacles and trigger zones of the map that don't line up with its tiles (with inclusive edge coordinates in pixels).
        */
-      bool** getPassibilityMatrix() const;
+      const std::vector<CollisionTree::Volume>& getCollisionVolumes() const;
 
       /**
-       * Perform logic for the obstacles on the map.
+       * @param x The x-coordinate (in tiles) of a tile.
+       * @param y The y-coordinate (in tiles) of a tile.
+       *
+       * @return true iff the tile at this location of the map is passible
+       */
+      bool isPassible(int x, int y) const;
+
+      /**
+       * @return The passibility of the map, packed one bit per tile in row order (bit i % 8 of byte i / 8,
+       *         where i = y * width + x), which is set iff the tile is passible.
+       */
+      const unsigned char* getPassibility() const;
+
+      /**
+       * Perform logic for the obstacles on the map. Only the obstacles that could be drawn are stepped,
+       * since their animations run on the shared clock and only need to catch up with reloaded spritesheets.
+       * Baked obstacles aren't stepped at all, since they are baked again when their spritesheets are reloaded.
        * \todo This function should be removed, since this map data should be stateless.
+       *
+       * @param timePassed The amount of time that has passed since the last frame.
+       * @param visibleArea The tiles that are on screen.
        */
-      void step(long timePassed) const;
+      void step(long timePassed, const shapes::Rectangle& visibleArea) const;
 
       /**
-       * Draw an entire map's tiles.
+       * Loads the chunks in and around the visible area of the map, and releases chunks that have moved out of range.
+       * Chunks in the visible area are read right away if they aren't loaded yet,
+       * and the chunks around it are read in the background.
+       * Maps that aren't streamable always have all of their chunks loaded, so this does nothing for them.
+       *
+       * @param visibleArea The area of the map that is visible (with edge coordinates in tiles).
+       */
+      void streamChunks(const shapes::Rectangle& visibleArea) const;
+
+      /**
+       * Stops loading chunks and releases the loaded chunks of a streamable map, once it is no longer in use.
+       * The chunks are loaded again by the next call to streamChunks.
+       */
+      void releaseChunks() const;
+
+      /**
+       * Draw the map's loaded tiles in the layers under the actors, and its obstacles, that fall within the visible area.
+       * The obstacles are added to the sprite batch, to be sorted by depth along with the actors.
+       * Where there is a depth buffer, the obstacles that aren't animated are baked into static batches for each chunk,
+       * which are added to the sprite batch whole instead of adding each obstacle on every frame.
+       *
+       * @param visibleArea The area of the map that is visible (with inclusive edge coordinates in tiles).
+       */
+      void draw(const shapes::Rectangle& visibleArea) const;
+
+      /**
+       * @return The size that the map takes up in memory (in bytes), counting only the chunks that are loaded.
+       */
+      size_t getSize() const;
+
+      /**
+       * @return true iff the map has layers that are drawn over the obstacles and actors.
+       */
+      bool hasUpperLayers() const;
+
+      /**
+       * Draw the map's loaded tiles in the layers over the actors (such as roofs and treetops) that fall within the visible area.
+       * The sprite batch must be flushed first, so that the obstacles and actors are drawn underneath.
+       *
+       * @param visibleArea The area of the map that is visible (with inclusive edge coordinates in tiles).
+       */
+      void drawUpperLayers(const shapes::Rectangle& visibleArea) const;
+
+      /**
+       * Draw all of the map's loaded layers (but not its obstacles) as planes seen through a perspective camera,
+       * with one draw call per layer. The driver must support it (see PerspectiveLayerRenderer::isSupported).
+       *
+       * @param view How the camera looks at the map.
+       * @param screenWidth The width of the screen (in pixels).
+       * @param screenHeight The height of the screen (in pixels).
+       */
+      void drawPerspective(const PerspectiveLayerRenderer::View& view, int screenWidth, int screenHeight) const;
+
+      /**
+       * @return The tileset that the map's tiles are drawn from.
+       */
+      const Tileset& getTileset() const;
+
+      /**
+       * Works out the colour of each tile in an area of the map, for its minimap, by laying the average colours
+       * of the tiles in each layer over each other. This doesn't touch the OpenGL context or change the map,
+       * so it can be called from a worker thread while the map is in use.
+       *
+       * @param tileColours The average colour of each tile in the tileset (see Tileset::getTileColours).
+       * @param area The area of the map (with inclusive edge coordinates in tiles, within the map).
+       * @param pixels The parameter used to return the colours of the area's tiles (as RGBA), row by row.
        */
-      void draw() const;
+      void bakeMinimap(const std::vector<unsigned char>& tileColours, const shapes::Rectangle& area, std::vector<unsigned char>& pixels) const;
 
       /**
        * Destructor.
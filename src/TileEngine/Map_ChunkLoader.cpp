@@ -0,0 +1,143 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Map_ChunkLoader.h"
+#include "SDL_thread.h"
+#include "SDL_mutex.h"
+#include "Exception.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_RES_LOAD;
+
+Map::ChunkLoader::ChunkLoader(const Map& map) : map(map), thread(NULL), stopping(false), currentChunkNum(-1)
+{
+   lock = SDL_CreateMutex();
+   chunkRequested = SDL_CreateCond();
+}
+
+int Map::ChunkLoader::runLoader(void* data)
+{
+   static_cast<ChunkLoader*>(data)->loaderLoop();
+   return 0;
+}
+
+void Map::ChunkLoader::loaderLoop()
+{
+   SDL_mutexP(lock);
+   for(;;)
+   {
+      while(!stopping && chunkQueue.empty())
+      {
+         SDL_CondWait(chunkRequested, lock);
+      }
+
+      if(stopping)
+      {
+         break;
+      }
+
+      currentChunkNum = chunkQueue.front();
+      chunkQueue.pop_front();
+      SDL_mutexV(lock);
+
+      LoadedChunk chunk;
+      chunk.chunkNum = currentChunkNum;
+      try
+      {
+         chunk.tiles = map.loadChunk(currentChunkNum);
+      }
+      catch(Exception& e)
+      {
+         // Leave the chunk unloaded; if it comes into view, it will be read (and the error reported) on the main thread
+         DEBUG("Failed to load map chunk %d: %s", currentChunkNum, e.getMessage().c_str());
+         chunk.tiles = NULL;
+      }
+
+      SDL_mutexP(lock);
+      if(chunk.tiles != NULL)
+      {
+         loadedChunks.push_back(chunk);
+      }
+
+      currentChunkNum = -1;
+   }
+   SDL_mutexV(lock);
+}
+
+bool Map::ChunkLoader::start()
+{
+   stop();
+
+   stopping = false;
+   thread = SDL_CreateThread(runLoader, this);
+   if(thread == NULL)
+   {
+      DEBUG("Failed to start map chunk loader thread: %s", SDL_GetError());
+      return false;
+   }
+
+   return true;
+}
+
+bool Map::ChunkLoader::isRunning() const
+{
+   return thread != NULL;
+}
+
+void Map::ChunkLoader::stop()
+{
+   if(thread != NULL)
+   {
+      SDL_mutexP(lock);
+      stopping = true;
+      SDL_CondBroadcast(chunkRequested);
+      SDL_mutexV(lock);
+
+      SDL_WaitThread(thread, NULL);
+      thread = NULL;
+   }
+
+   for(std::list<LoadedChunk>::iterator iter = loadedChunks.begin(); iter != loadedChunks.end(); ++iter)
+   {
+      delete [] iter->tiles;
+   }
+
+   chunkQueue.clear();
+   loadedChunks.clear();
+}
+
+void Map::ChunkLoader::setChunkQueue(const std::vector<int>& chunkNums)
+{
+   SDL_mutexP(lock);
+   chunkQueue.clear();
+   for(std::vector<int>::const_iterator iter = chunkNums.begin(); iter != chunkNums.end(); ++iter)
+   {
+      if(*iter != currentChunkNum)
+      {
+         chunkQueue.push_back(*iter);
+      }
+   }
+
+   if(!chunkQueue.empty())
+   {
+      SDL_CondSignal(chunkRequested);
+   }
+   SDL_mutexV(lock);
+}
+
+void Map::ChunkLoader::collectLoadedChunks(std::list<LoadedChunk>& chunks)
+{
+   SDL_mutexP(lock);
+   chunks.splice(chunks.end(), loadedChunks);
+   SDL_mutexV(lock);
+}
+
+Map::ChunkLoader::~ChunkLoader()
+{
+   stop();
+   SDL_DestroyCond(chunkRequested);
+   SDL_DestroyMutex(lock);
+}
@@ -0,0 +1,122 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef MAP_CHUNK_LOADER_H
+#define MAP_CHUNK_LOADER_H
+
+#include "Map.h"
+#include <list>
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+/**
+ * A thread that reads the chunks of a streamable map away from the main thread.
+ * Chunks to read are handed to the loader through a queue, and the chunks it has read are
+ * handed back through a list that the main thread drains once per frame.
+ */
+class Map::ChunkLoader
+{
+   public:
+      /** A chunk that has been read, waiting to be collected. */
+      struct LoadedChunk
+      {
+         /** The number of the chunk. */
+         int chunkNum;
+
+         /** The tiles of the chunk. */
+         int* tiles;
+      };
+
+   private:
+      /** The map whose chunks are read. */
+      const Map& map;
+
+      /** The loader's thread, or NULL if it isn't running. */
+      SDL_Thread* thread;
+
+      /** Guards the chunk queues and the stopping flag. */
+      SDL_mutex* lock;
+
+      /** Signalled when chunks are added to the queue, or when the loader must stop. */
+      SDL_cond* chunkRequested;
+
+      /** Whether or not the loader has been asked to stop. */
+      bool stopping;
+
+      /** The numbers of the chunks waiting to be read, in the order they will be read. */
+      std::list<int> chunkQueue;
+
+      /** The number of the chunk being read, or -1 if the loader is idle. */
+      int currentChunkNum;
+
+      /** The chunks that have been read, but haven't been collected yet. */
+      std::list<LoadedChunk> loadedChunks;
+
+      /**
+       * The entry point for the loader thread.
+       *
+       * @param data The loader that the thread belongs to.
+       *
+       * @return The exit code of the thread.
+       */
+      static int runLoader(void* data);
+
+      /**
+       * Reads chunks from the queue until the loader is stopped.
+       */
+      void loaderLoop();
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param map The map whose chunks are read.
+       */
+      ChunkLoader(const Map& map);
+
+      /**
+       * Starts the loader thread.
+       *
+       * @return true iff the thread was started.
+       */
+      bool start();
+
+      /**
+       * @return true iff the loader thread is running.
+       */
+      bool isRunning() const;
+
+      /**
+       * Stops the loader thread, waiting for it to finish the chunk it is reading,
+       * and discards all chunks that are queued or haven't been collected.
+       */
+      void stop();
+
+      /**
+       * Replaces the chunks waiting to be read with a new list.
+       * A chunk that is already being read is left out of the queue, since it will be collected soon anyway.
+       *
+       * @param chunkNums The numbers of the chunks to read, in the order they should be read.
+       */
+      void setChunkQueue(const std::vector<int>& chunkNums);
+
+      /**
+       * Moves every chunk that has been read to the back of the given list.
+       * The caller takes ownership of the chunks' tiles, and must delete them.
+       *
+       * @param chunks The list to add the loaded chunks to.
+       */
+      void collectLoadedChunks(std::list<LoadedChunk>& chunks);
+
+      /**
+       * Destructor.
+       */
+      ~ChunkLoader();
+};
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Minimap.h"
+#include "Actor.h"
+#include "ActorTable.h"
+#include "Map.h"
+#include "Tileset.h"
+#include "TileEngine.h"
+#include "GLState.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_TILE_ENG;
+
+// Big enough to pick out on a minimap that is a few hundred pixels across
+const float Minimap::MARKER_SIZE = 3.0f;
+
+class Minimap::BakeJob : public JobSystem::Job
+{
+   /** The minimap that the area is baked for. */
+   Minimap& minimap;
+
+   /** The map being baked. */
+   const Map& map;
+
+   /** The average colour of each tile in the map's tileset, copied so that the tileset can be reloaded while the job runs. */
+   const std::vector<unsigned char> tileColours;
+
+   /** The area of the map to bake (with inclusive edge coordinates in tiles). */
+   const shapes::Rectangle area;
+
+   /** The baked colours of the area's tiles. */
+   std::vector<unsigned char> pixels;
+
+   public:
+      BakeJob(Minimap& minimap, const Map& map, const shapes::Rectangle& area) : JobSystem::Job(true),
+         minimap(minimap), map(map), tileColours(map.getTileset().getTileColours()), area(area)
+      {
+      }
+
+      void run(int /*slot*/)
+      {
+         map.bakeMinimap(tileColours, area, pixels);
+      }
+
+      void finalize()
+      {
+         minimap.upload(area, pixels);
+      }
+};
+
+Minimap::Minimap() : map(NULL), tilesetRevision(0), width(0), height(0), textureWidth(0), textureHeight(0), texture(0)
+{
+}
+
+void Minimap::setMap(const Map* map)
+{
+   JobSystem::wait(bakeCounter);
+
+   if(texture != 0)
+   {
+      glDeleteTextures(1, &texture);
+      texture = 0;
+   }
+
+   this->map = map;
+   if(map == NULL) return;
+
+   width = map->getWidth();
+   height = map->getHeight();
+
+   textureWidth = 1;
+   while(textureWidth < width) textureWidth <<= 1;
+
+   textureHeight = 1;
+   while(textureHeight < height) textureHeight <<= 1;
+
+   DEBUG("Baking the minimap of map %s", map->getName().c_str());
+   refresh(shapes::Rectangle(0, 0, height - 1, width - 1));
+}
+
+void Minimap::refresh(const shapes::Rectangle& area)
+{
+   if(map == NULL) return;
+
+   const shapes::Rectangle clampedArea(std::max(area.top, 0), std::max(area.left, 0), std::min(area.bottom, height - 1), std::min(area.right, width - 1));
+   if(clampedArea.left > clampedArea.right || clampedArea.top > clampedArea.bottom) return;
+
+   JobSystem::wait(bakeCounter);
+   tilesetRevision = map->getTileset().getRevision();
+   JobSystem::submit(new BakeJob(*this, *map, clampedArea), &bakeCounter);
+}
+
+void Minimap::upload(const shapes::Rectangle& area, const std::vector<unsigned char>& pixels)
+{
+   if(texture == 0)
+   {
+      // The parts of the texture past the map are never drawn, so they are left transparent
+      const std::vector<unsigned char> emptyPixels(textureWidth * textureHeight * 4, 0);
+      glGenTextures(1, &texture);
+      GLState::bindTexture(texture);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, &emptyPixels[0]);
+   }
+
+   GLState::bindTexture(texture);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, area.left, area.top, area.right - area.left + 1, area.bottom - area.top + 1,
+         GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Minimap::draw(int x, int y, int drawWidth, int drawHeight, const ActorTable& actorTable, const Actor* player)
+{
+   if(map == NULL) return;
+
+   if(map->getTileset().getRevision() != tilesetRevision)
+   {
+      // The tileset was reloaded, so its tiles' colours may have changed
+      refresh(shapes::Rectangle(0, 0, height - 1, width - 1));
+   }
+
+   if(texture == 0) return;
+
+   const float right = static_cast<float>(x + drawWidth);
+   const float bottom = static_cast<float>(y + drawHeight);
+   const float textureRight = static_cast<float>(width) / textureWidth;
+   const float textureBottom = static_cast<float>(height) / textureHeight;
+
+   const bool blendEnabled = GLState::isBlending();
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+   GLState::setTexturing(true);
+   GLState::bindTexture(texture);
+   GLState::setTextureMode(GL_MODULATE);
+   glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glTexCoord2f(0.0f, 0.0f);
+      glVertex2f(static_cast<float>(x), static_cast<float>(y));
+      glTexCoord2f(textureRight, 0.0f);
+      glVertex2f(right, static_cast<float>(y));
+      glTexCoord2f(textureRight, textureBottom);
+      glVertex2f(right, bottom);
+      glTexCoord2f(0.0f, textureBottom);
+      glVertex2f(static_cast<float>(x), bottom);
+   glEnd();
+
+   // Each actor is marked at its middle, scaled down from the map's pixels to the minimap's
+   const float scaleX = static_cast<float>(drawWidth) / (width * TileEngine::TILE_SIZE);
+   const float scaleY = static_cast<float>(drawHeight) / (height * TileEngine::TILE_SIZE);
+
+   GLState::setTexturing(false);
+   glPointSize(MARKER_SIZE);
+
+   GLState::countDrawCall();
+   glBegin(GL_POINTS);
+      for(int id = 0; id < actorTable.size(); ++id)
+      {
+         const Actor* actor = actorTable.getActor(id);
+         const shapes::Point2D& location = actorTable.getLocation(id);
+         if(actor == player)
+         {
+            glColor4f(1.0f, 0.25f, 0.25f, 1.0f);
+         }
+         else
+         {
+            glColor4f(1.0f, 1.0f, 0.5f, 1.0f);
+         }
+
+         glVertex2f(x + (location.x + actor->getWidth() / 2.0f) * scaleX, y + (location.y + actor->getHeight() / 2.0f) * scaleY);
+      }
+   glEnd();
+
+   glPointSize(1.0f);
+   glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+   GLState::setTexturing(true);
+
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+Minimap::~Minimap()
+{
+   JobSystem::wait(bakeCounter);
+
+   if(texture != 0)
+   {
+      glDeleteTextures(1, &texture);
+   }
+}
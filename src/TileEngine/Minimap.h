@@ -0,0 +1,110 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <vector>
+#include "JobSystem.h"
+#include "Rectangle.h"
+
+typedef unsigned int GLuint;
+
+class Actor;
+class ActorTable;
+class Map;
+
+/**
+ * A small picture of the whole map, with one pixel for each tile, drawn on the screen with the actors marked on it.
+ *
+ * Each pixel is the average colour of the tile in each of the map's layers (worked out once for each tileset, when it loads),
+ * laid over each other. The map is baked into the minimap's texture on a worker thread when it is set, so drawing the
+ * minimap only costs a quad, and an area of the map can be baked again (such as when its tiles change) without the rest.
+ * The actors are drawn over the minimap as points each frame.
+ */
+class Minimap
+{
+   class BakeJob;
+   friend class BakeJob;
+
+   /** The width of the points that mark the actors (in pixels). */
+   static const float MARKER_SIZE;
+
+   /** The map that the minimap shows, or NULL if there isn't one. */
+   const Map* map;
+
+   /** The revision of the map's tileset that the minimap was baked from, so that it is baked again when the tileset is reloaded. */
+   unsigned int tilesetRevision;
+
+   /** The size of the map (in tiles). */
+   int width, height;
+
+   /** The width and height of the texture, rounded up to powers of two. */
+   int textureWidth, textureHeight;
+
+   /** The texture holding the baked map, or 0 if nothing has been baked into it yet. */
+   GLuint texture;
+
+   /** Counts the bakes that haven't been uploaded yet. */
+   JobSystem::Counter bakeCounter;
+
+   /**
+    * Copies the baked colours of an area of the map into the texture, creating the texture if needed.
+    * This is called on the main thread once the area has been baked.
+    *
+    * @param area The area of the map (with inclusive edge coordinates in tiles).
+    * @param pixels The colours of the area's tiles (as RGBA), row by row.
+    */
+   void upload(const shapes::Rectangle& area, const std::vector<unsigned char>& pixels);
+
+   /** Minimaps can't be copied. */
+   Minimap(const Minimap&);
+
+   /** Minimaps can't be copied. */
+   Minimap& operator=(const Minimap&);
+
+   public:
+      /**
+       * Constructor.
+       */
+      Minimap();
+
+      /**
+       * Sets the map that the minimap shows, and starts baking all of it in the background.
+       * Any bakes of the last map are finished first, since they read from it.
+       *
+       * @param map The map to show, or NULL to show nothing (such as before the map's region is freed).
+       */
+      void setMap(const Map* map);
+
+      /**
+       * Bakes an area of the map again in the background, such as once its tiles have changed.
+       * The earlier bakes are finished first if they haven't been, so that the bakes land in order.
+       *
+       * @param area The area of the map (with inclusive edge coordinates in tiles), which is clamped to the map.
+       */
+      void refresh(const shapes::Rectangle& area);
+
+      /**
+       * Draws the minimap stretched over an area of the screen, with a point for each actor.
+       * The sprite batch must be flushed first, so that the minimap is drawn over the batched sprites.
+       *
+       * @param x The x-coordinate of the area's top-left corner (in pixels).
+       * @param y The y-coordinate of the area's top-left corner (in pixels).
+       * @param drawWidth The width of the area (in pixels).
+       * @param drawHeight The height of the area (in pixels).
+       * @param actorTable The actors on the map.
+       * @param player The player's actor, which is marked in a colour of its own.
+       */
+      void draw(int x, int y, int drawWidth, int drawHeight, const ActorTable& actorTable, const Actor* player);
+
+      /**
+       * Destructor. Finishes any bakes still running, and releases the texture.
+       */
+      ~Minimap();
+};
+
+#endif
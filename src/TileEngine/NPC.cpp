@@ -16,11 +16,15 @@
 
 const int debugFlag = DEBUG_NPC;
 
+// The NPCs walk at a stroll by default (in pixels per millisecond)
+static const float NPC_MOVEMENT_SPEED = 0.1f;
+
 NPC::NPC(ScriptEngine& engine, Scheduler& scheduler, const std::string& name, const std::string& sheetName, EntityGrid& entityGrid,
                        const std::string& regionName,
-                       int x, int y) : Actor(name, sheetName, entityGrid, x, y, 0.1f, DOWN)
+                       int x, int y) : Actor(name, sheetName, entityGrid, x, y, NPC_MOVEMENT_SPEED, DOWN)
 {
    npcThread = engine.getNPCScript(this, regionName, entityGrid.getMapData()->getName(), name);
+   scheduler.setPriority(npcThread, Thread::AMBIENT);
    scheduler.start(npcThread);
    DEBUG("NPC %s has a Thread with ID %d", name.c_str(), npcThread->getId());
 }
@@ -33,6 +37,42 @@ NPC::~NPC()
 void NPC::activate()
 {
    flushOrders();
+   wake();
    npcThread->activate();
 }
 
+NPCScript* NPC::getScript() const
+{
+   return npcThread;
+}
+
+bool NPC::despawn()
+{
+   if(!npcThread->setPooled(true))
+   {
+      return false;
+   }
+
+   entityGrid.removeActor(this);
+   leaveTable();
+   return true;
+}
+
+void NPC::respawn(const std::string& sheetName, int x, int y)
+{
+   rejoinTable(x, y, NPC_MOVEMENT_SPEED, DOWN);
+   setSpritesheet(sheetName);
+   npcThread->setPooled(false);
+}
+
+void NPC::step(long timePassed)
+{
+   const bool wasIdle = isIdle();
+   Actor::step(timePassed);
+
+   if(!wasIdle && isIdle())
+   {
+      npcThread->ordersFinished();
+   }
+}
+
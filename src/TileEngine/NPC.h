@@ -75,6 +75,39 @@ class NPC : public Actor
        * player, etc.  
        */
       void activate();
+
+      /**
+       * @return The NPC's script.
+       */
+      NPCScript* getScript() const;
+
+      /**
+       * Takes the NPC off the map, so that it can be kept in a pool and spawned again later
+       * without loading its script or sprite over again. The NPC's orders are flushed,
+       * and its script sleeps until the NPC is spawned again.
+       * An NPC whose script is in the middle of a run can't be despawned.
+       *
+       * @return true iff the NPC was taken off the map.
+       */
+      bool despawn();
+
+      /**
+       * Spawns a despawned NPC again, as though it had just been created.
+       * The NPC still has to be added to the grid.
+       *
+       * @param sheetName The name of the spritesheet to use for rendering the NPC.
+       * @param x The x-location (in pixels) where the NPC will start off.
+       * @param y The y-location (in pixels) where the NPC will start off.
+       */
+      void respawn(const std::string& sheetName, int x, int y);
+
+      /**
+       * Performs a logic step of the NPC, and lets the NPC's script know
+       * if the step finished the NPC's last order.
+       *
+       * @param timePassed The amount of time that has passed since the last frame.
+       */
+      void step(long timePassed);
    
       /**
        * Destructor.
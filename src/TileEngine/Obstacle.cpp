@@ -19,7 +19,8 @@ Obstacle::Obstacle(const int tileX, const int tileY, const int width, const int
 
    if(spriteType == "anim")
    {
-      sprite->setAnimation(spriteName, NONE);
+      // Obstacles only ever loop their animation, so they can all share one clock instead of keeping their own time
+      sprite->setAnimation(spriteName, NONE, true);
    }
    else if(spriteType == "frame")
    {
@@ -41,6 +42,21 @@ void Obstacle::draw() const
    sprite->draw(tileCoords.x * TileEngine::TILE_SIZE, (tileCoords.y + height) * TileEngine::TILE_SIZE);
 }
 
+void Obstacle::bake(StaticSpriteBatch& batch) const
+{
+   sprite->bake(tileCoords.x * TileEngine::TILE_SIZE, (tileCoords.y + height) * TileEngine::TILE_SIZE, batch);
+}
+
+bool Obstacle::isAnimated() const
+{
+   return sprite->isAnimated();
+}
+
+const Spritesheet* Obstacle::getSpritesheet() const
+{
+   return sprite->getSheet();
+}
+
 int Obstacle::getTileX() const
 {
    return tileCoords.x;
@@ -14,6 +14,7 @@
 
 class Sprite;
 class Spritesheet;
+class StaticSpriteBatch;
 
 class Obstacle
 {
@@ -29,6 +30,25 @@ class Obstacle
 
      void step(long timePassed) const;
      void draw() const;
+
+     /**
+      * Adds the obstacle's frame to a static batch, in place of drawing it on each frame.
+      * Only obstacles that aren't animated can be baked.
+      *
+      * @param batch The static batch to add the obstacle's frame to.
+      */
+     void bake(StaticSpriteBatch& batch) const;
+
+     /**
+      * @return true iff the obstacle shows an animation, rather than a static frame.
+      */
+     bool isAnimated() const;
+
+     /**
+      * @return The spritesheet containing the obstacle's sprite.
+      */
+     const Spritesheet* getSpritesheet() const;
+
      int getTileX() const;
      int getTileY() const;
 	  int getWidth() const;
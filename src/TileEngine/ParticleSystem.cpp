@@ -0,0 +1,449 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ParticleSystem.h"
+#include "Actor.h"
+#include "GLState.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PARTICLE_SYSTEM_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PARTICLE_SYSTEM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+// Enough for a downpour over the whole screen, at a few hundred kilobytes of arrays
+const int ParticleSystem::MAX_PARTICLES_PER_EMITTER = 16384;
+
+// The width of an SSE or NEON register in floats; the arrays are padded to a multiple of it
+const int ParticleSystem::PARTICLE_LANES = 4;
+
+// About two frames' worth of movement, which reads as motion blur without smearing slow particles into lines
+const float ParticleSystem::STREAK_TIME = 1.0f / 30.0f;
+
+// Dots are only a few pixels wide, and the texture is filtered smoothly when it is stretched
+const int ParticleSystem::DOT_TEXTURE_SIZE = 16;
+
+// Any seed but zero works for xorshift, and the particles don't need to be the same from one run to the next
+static const unsigned int RANDOM_SEED = 0x9E3779B9;
+
+bool ParticleSystem::pointSpritesChecked = false;
+bool ParticleSystem::pointSpritesSupported = false;
+
+ParticleSystem::EmitterSettings::EmitterSettings() : x(0), y(0), width(0), height(0), actor(ActorTable::INVALID_HANDLE), coversScreen(false),
+   rate(10.0f), lifetime(1000), duration(0), velocityX(0.0f), velocityY(0.0f), velocitySpreadX(0.0f), velocitySpreadY(0.0f), gravity(0.0f),
+   size(4.0f), red(1.0f), green(1.0f), blue(1.0f), alpha(1.0f), shape(DOTS)
+{
+}
+
+ParticleSystem::ParticleSystem() : nextId(INVALID_EMITTER + 1), randomState(RANDOM_SEED), dotTexture(0)
+{
+}
+
+float ParticleSystem::nextRandom()
+{
+   // The particles are only for show, so they use a generator of their own instead of one of the game's random streams,
+   // which would make the game's rolls depend on how many particles were spawned
+   randomState ^= randomState << 13;
+   randomState ^= randomState >> 17;
+   randomState ^= randomState << 5;
+   return (randomState >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+ParticleSystem::EmitterId ParticleSystem::addEmitter(const EmitterSettings& settings)
+{
+   Emitter* emitter = new Emitter();
+   emitter->settings = settings;
+   emitter->settings.lifetime = std::max(settings.lifetime, 1L);
+   emitter->spawnDebt = 0.0f;
+   emitter->timeLeft = settings.duration > 0 ? settings.duration : -1;
+   emitter->stopped = false;
+   emitter->count = 0;
+
+   const EmitterId id = nextId++;
+   emitters.insert(std::make_pair(id, emitter));
+
+   DEBUG("Added particle emitter %u spawning %f particles per second", id, settings.rate);
+   return id;
+}
+
+void ParticleSystem::stopEmitter(EmitterId id)
+{
+   std::map<EmitterId, Emitter*>::iterator emitter = emitters.find(id);
+   if(emitter != emitters.end())
+   {
+      emitter->second->stopped = true;
+   }
+}
+
+void ParticleSystem::removeEmitter(EmitterId id)
+{
+   std::map<EmitterId, Emitter*>::iterator emitter = emitters.find(id);
+   if(emitter != emitters.end())
+   {
+      delete emitter->second;
+      emitters.erase(emitter);
+   }
+}
+
+void ParticleSystem::clear()
+{
+   for(std::map<EmitterId, Emitter*>::iterator iter = emitters.begin(); iter != emitters.end(); ++iter)
+   {
+      delete iter->second;
+   }
+
+   emitters.clear();
+}
+
+int ParticleSystem::getParticleCount() const
+{
+   int particleCount = 0;
+   for(std::map<EmitterId, Emitter*>::const_iterator iter = emitters.begin(); iter != emitters.end(); ++iter)
+   {
+      particleCount += iter->second->count;
+   }
+
+   return particleCount;
+}
+
+void ParticleSystem::integrate(Emitter& emitter, float seconds)
+{
+   if(emitter.count == 0) return;
+
+   float* x = &emitter.x[0];
+   float* y = &emitter.y[0];
+   float* velocityX = &emitter.velocityX[0];
+   float* velocityY = &emitter.velocityY[0];
+   float* lifeLeft = &emitter.lifeLeft[0];
+
+   const float gravityStep = emitter.settings.gravity * seconds;
+   const float milliseconds = seconds * 1000.0f;
+
+   // The arrays are padded to a whole number of lanes, so the last lane can run past the live particles
+   const int paddedCount = (emitter.count + PARTICLE_LANES - 1) / PARTICLE_LANES * PARTICLE_LANES;
+   int particleNum = 0;
+
+#if defined(PARTICLE_SYSTEM_SSE)
+   const __m128 time = _mm_set1_ps(seconds);
+   const __m128 gravity = _mm_set1_ps(gravityStep);
+   const __m128 age = _mm_set1_ps(milliseconds);
+   for(; particleNum < paddedCount; particleNum += PARTICLE_LANES)
+   {
+      const __m128 newVelocityY = _mm_add_ps(_mm_loadu_ps(velocityY + particleNum), gravity);
+      _mm_storeu_ps(velocityY + particleNum, newVelocityY);
+      _mm_storeu_ps(x + particleNum, _mm_add_ps(_mm_loadu_ps(x + particleNum), _mm_mul_ps(_mm_loadu_ps(velocityX + particleNum), time)));
+      _mm_storeu_ps(y + particleNum, _mm_add_ps(_mm_loadu_ps(y + particleNum), _mm_mul_ps(newVelocityY, time)));
+      _mm_storeu_ps(lifeLeft + particleNum, _mm_sub_ps(_mm_loadu_ps(lifeLeft + particleNum), age));
+   }
+#elif defined(PARTICLE_SYSTEM_NEON)
+   const float32x4_t gravity = vdupq_n_f32(gravityStep);
+   const float32x4_t age = vdupq_n_f32(milliseconds);
+   for(; particleNum < paddedCount; particleNum += PARTICLE_LANES)
+   {
+      const float32x4_t newVelocityY = vaddq_f32(vld1q_f32(velocityY + particleNum), gravity);
+      vst1q_f32(velocityY + particleNum, newVelocityY);
+      vst1q_f32(x + particleNum, vmlaq_n_f32(vld1q_f32(x + particleNum), vld1q_f32(velocityX + particleNum), seconds));
+      vst1q_f32(y + particleNum, vmlaq_n_f32(vld1q_f32(y + particleNum), newVelocityY, seconds));
+      vst1q_f32(lifeLeft + particleNum, vsubq_f32(vld1q_f32(lifeLeft + particleNum), age));
+   }
+#endif
+
+   for(; particleNum < emitter.count; ++particleNum)
+   {
+      velocityY[particleNum] += gravityStep;
+      x[particleNum] += velocityX[particleNum] * seconds;
+      y[particleNum] += velocityY[particleNum] * seconds;
+      lifeLeft[particleNum] -= milliseconds;
+   }
+
+   // The last live particle takes the place of each one that died, so the live particles stay at the front
+   particleNum = 0;
+   while(particleNum < emitter.count)
+   {
+      if(lifeLeft[particleNum] > 0.0f)
+      {
+         ++particleNum;
+         continue;
+      }
+
+      const int lastParticle = --emitter.count;
+      x[particleNum] = x[lastParticle];
+      y[particleNum] = y[lastParticle];
+      velocityX[particleNum] = velocityX[lastParticle];
+      velocityY[particleNum] = velocityY[lastParticle];
+      lifeLeft[particleNum] = lifeLeft[lastParticle];
+   }
+}
+
+void ParticleSystem::spawn(Emitter& emitter, long timePassed, int originX, int originY, int areaWidth, int areaHeight)
+{
+   if(emitter.stopped) return;
+
+   const EmitterSettings& settings = emitter.settings;
+   emitter.spawnDebt += settings.rate * timePassed / 1000.0f;
+   const int dueCount = static_cast<int>(emitter.spawnDebt);
+   emitter.spawnDebt -= dueCount;
+
+   if(emitter.timeLeft >= 0)
+   {
+      emitter.timeLeft -= timePassed;
+      emitter.stopped = emitter.timeLeft <= 0;
+   }
+
+   const int spawnCount = std::min(dueCount, MAX_PARTICLES_PER_EMITTER - emitter.count);
+   if(spawnCount <= 0) return;
+
+   const int neededSize = emitter.count + spawnCount;
+   if(neededSize > static_cast<int>(emitter.x.size()))
+   {
+      // The arrays grow by doubling (up to the cap) so that an emitter that ramps up doesn't reallocate every step
+      int newSize = std::max(neededSize, static_cast<int>(emitter.x.size()) * 2);
+      newSize = std::min((newSize + PARTICLE_LANES - 1) / PARTICLE_LANES * PARTICLE_LANES, MAX_PARTICLES_PER_EMITTER);
+      emitter.x.resize(newSize, 0.0f);
+      emitter.y.resize(newSize, 0.0f);
+      emitter.velocityX.resize(newSize, 0.0f);
+      emitter.velocityY.resize(newSize, 0.0f);
+      emitter.lifeLeft.resize(newSize, 0.0f);
+   }
+
+   const float left = static_cast<float>(originX + settings.x);
+   const float top = static_cast<float>(originY + settings.y);
+   const float halfWidth = areaWidth * 0.5f;
+   const float halfHeight = areaHeight * 0.5f;
+   for(int particleNum = emitter.count; particleNum < neededSize; ++particleNum)
+   {
+      emitter.x[particleNum] = left + halfWidth + nextRandom() * halfWidth;
+      emitter.y[particleNum] = top + halfHeight + nextRandom() * halfHeight;
+      emitter.velocityX[particleNum] = settings.velocityX + nextRandom() * settings.velocitySpreadX;
+      emitter.velocityY[particleNum] = settings.velocityY + nextRandom() * settings.velocitySpreadY;
+      emitter.lifeLeft[particleNum] = static_cast<float>(settings.lifetime);
+   }
+
+   emitter.count = neededSize;
+}
+
+void ParticleSystem::step(long timePassed, const ActorTable& actorTable, const shapes::Rectangle& visibleArea)
+{
+   const float seconds = timePassed / 1000.0f;
+
+   std::map<EmitterId, Emitter*>::iterator iter = emitters.begin();
+   while(iter != emitters.end())
+   {
+      Emitter& emitter = *iter->second;
+      integrate(emitter, seconds);
+
+      int originX = 0;
+      int originY = 0;
+      int areaWidth = emitter.settings.width;
+      int areaHeight = emitter.settings.height;
+      if(emitter.settings.actor != ActorTable::INVALID_HANDLE)
+      {
+         // An emitter that follows an actor stops once the actor leaves the map, and its particles are left to die out
+         const ActorTable::ActorId id = actorTable.resolve(emitter.settings.actor);
+         if(id == ActorTable::INVALID_ACTOR)
+         {
+            emitter.stopped = true;
+         }
+         else
+         {
+            const Actor* actor = actorTable.getActor(id);
+            const shapes::Point2D& location = actorTable.getLocation(id);
+            originX = location.x + actor->getWidth() / 2;
+            originY = location.y + actor->getHeight() / 2;
+         }
+      }
+      else if(emitter.settings.coversScreen)
+      {
+         originX = visibleArea.left;
+         originY = visibleArea.top;
+         if(areaWidth <= 0) areaWidth = visibleArea.right - visibleArea.left + 1;
+         if(areaHeight <= 0) areaHeight = visibleArea.bottom - visibleArea.top + 1;
+      }
+
+      spawn(emitter, timePassed, originX, originY, areaWidth, areaHeight);
+
+      if(emitter.stopped && emitter.count == 0)
+      {
+         DEBUG("Particle emitter %u has finished", iter->first);
+         delete iter->second;
+         emitters.erase(iter++);
+      }
+      else
+      {
+         ++iter;
+      }
+   }
+}
+
+void ParticleSystem::createDotTexture()
+{
+   std::vector<unsigned char> pixels(DOT_TEXTURE_SIZE * DOT_TEXTURE_SIZE * 4);
+   const float center = (DOT_TEXTURE_SIZE - 1) / 2.0f;
+
+   for(int y = 0; y < DOT_TEXTURE_SIZE; ++y)
+   {
+      for(int x = 0; x < DOT_TEXTURE_SIZE; ++x)
+      {
+         // A white dot that fades out towards its edge, to be tinted by each particle's colour
+         const float dx = (x - center) / center;
+         const float dy = (y - center) / center;
+         const float opacity = std::max(1.0f - sqrtf(dx * dx + dy * dy), 0.0f);
+
+         unsigned char* pixel = &pixels[(y * DOT_TEXTURE_SIZE + x) * 4];
+         pixel[0] = pixel[1] = pixel[2] = 0xFF;
+         pixel[3] = static_cast<unsigned char>(opacity * 255.0f + 0.5f);
+      }
+   }
+
+   glGenTextures(1, &dotTexture);
+   GLState::bindTexture(dotTexture);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, DOT_TEXTURE_SIZE, DOT_TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
+void ParticleSystem::drawEmitter(const Emitter& emitter)
+{
+   if(emitter.count == 0) return;
+
+   const EmitterSettings& settings = emitter.settings;
+   const bool streaks = settings.shape == STREAKS;
+   const int verticesPerParticle = streaks ? 2 : 1;
+   const int vertexCount = emitter.count * verticesPerParticle;
+   vertices.resize(vertexCount * 2);
+   colours.resize(vertexCount * 4);
+
+   const unsigned char red = static_cast<unsigned char>(std::min(std::max(settings.red, 0.0f), 1.0f) * 255.0f);
+   const unsigned char green = static_cast<unsigned char>(std::min(std::max(settings.green, 0.0f), 1.0f) * 255.0f);
+   const unsigned char blue = static_cast<unsigned char>(std::min(std::max(settings.blue, 0.0f), 1.0f) * 255.0f);
+
+   // Particles fade out over their lifetime
+   const float opacityScale = std::min(std::max(settings.alpha, 0.0f), 1.0f) * 255.0f / settings.lifetime;
+
+   float* vertex = &vertices[0];
+   unsigned char* colour = &colours[0];
+   for(int particleNum = 0; particleNum < emitter.count; ++particleNum)
+   {
+      const float x = emitter.x[particleNum];
+      const float y = emitter.y[particleNum];
+      const unsigned char opacity = static_cast<unsigned char>(std::min(emitter.lifeLeft[particleNum] * opacityScale, 255.0f));
+
+      *vertex++ = x;
+      *vertex++ = y;
+      *colour++ = red;
+      *colour++ = green;
+      *colour++ = blue;
+      *colour++ = opacity;
+
+      if(streaks)
+      {
+         // The tail trails behind the particle and fades out completely
+         *vertex++ = x - emitter.velocityX[particleNum] * STREAK_TIME;
+         *vertex++ = y - emitter.velocityY[particleNum] * STREAK_TIME;
+         *colour++ = red;
+         *colour++ = green;
+         *colour++ = blue;
+         *colour++ = 0;
+      }
+   }
+
+   glVertexPointer(2, GL_FLOAT, 0, &vertices[0]);
+   glColorPointer(4, GL_UNSIGNED_BYTE, 0, &colours[0]);
+
+   GLState::countDrawCall();
+   if(streaks)
+   {
+      GLState::setTexturing(false);
+      glLineWidth(settings.size);
+      glDrawArrays(GL_LINES, 0, vertexCount);
+      glLineWidth(1.0f);
+   }
+   else if(pointSpritesSupported)
+   {
+      if(dotTexture == 0)
+      {
+         createDotTexture();
+      }
+
+      GLState::setTexturing(true);
+      GLState::bindTexture(dotTexture);
+      GLState::setTextureMode(GL_MODULATE);
+
+      glEnable(GL_POINT_SPRITE_ARB);
+      glTexEnvi(GL_POINT_SPRITE_ARB, GL_COORD_REPLACE_ARB, GL_TRUE);
+      glPointSize(settings.size);
+      glDrawArrays(GL_POINTS, 0, vertexCount);
+      glDisable(GL_POINT_SPRITE_ARB);
+   }
+   else
+   {
+      // Without point sprites, dots are drawn as plain squares
+      GLState::setTexturing(false);
+      glPointSize(settings.size);
+      glDrawArrays(GL_POINTS, 0, vertexCount);
+   }
+}
+
+void ParticleSystem::draw()
+{
+   if(emitters.empty()) return;
+
+   if(!pointSpritesChecked)
+   {
+      pointSpritesChecked = true;
+      const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+      pointSpritesSupported = extensions != NULL && strstr(extensions, "GL_ARB_point_sprite") != NULL;
+      DEBUG("Point sprites are %s", pointSpritesSupported ? "supported" : "not supported; particles will be drawn as plain points.");
+   }
+
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   const bool blendEnabled = GLState::isBlending();
+   const bool texturingEnabled = GLState::isTexturing();
+
+   GLState::setBlending(true);
+   GLState::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+   // Particles are drawn from arrays of positions and colours, without the texture coordinates that the vertex buffers use
+   GLState::setVertexArrays(false);
+   glEnableClientState(GL_VERTEX_ARRAY);
+   glEnableClientState(GL_COLOR_ARRAY);
+
+   for(std::map<EmitterId, Emitter*>::const_iterator iter = emitters.begin(); iter != emitters.end(); ++iter)
+   {
+      drawEmitter(*iter->second);
+   }
+
+   glDisableClientState(GL_COLOR_ARRAY);
+   glDisableClientState(GL_VERTEX_ARRAY);
+   glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+   GLState::setTexturing(texturingEnabled);
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+ParticleSystem::~ParticleSystem()
+{
+   clear();
+
+   if(dotTexture != 0)
+   {
+      glDeleteTextures(1, &dotTexture);
+   }
+}
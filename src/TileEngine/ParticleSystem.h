@@ -0,0 +1,258 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <map>
+#include <vector>
+#include "ActorTable.h"
+#include "Rectangle.h"
+
+typedef unsigned int GLuint;
+
+/**
+ * Simulates and draws the particles of weather (like rain and snow) and effects (like sparks and smoke),
+ * which are far too many and too short-lived to be actors or obstacles with sprites of their own.
+ *
+ * Particles are spawned by emitters, which sit at a point on the map, follow an actor, or cover the screen (for weather).
+ * Each emitter keeps its particles as separate arrays of positions, velocities and lifetimes, so that they are all moved
+ * with the same few vector instructions, four particles at a time. Dead particles are swapped out for the last live ones,
+ * so the live particles always fill the front of the arrays.
+ *
+ * Each emitter's particles are drawn in a single draw call, straight from the arrays: as point sprites (or plain points,
+ * where the driver doesn't support point sprites), or as streaks along their velocity (for rain).
+ */
+class ParticleSystem
+{
+   public:
+      /** Identifies an emitter. */
+      typedef unsigned int EmitterId;
+
+      /** The ID that no emitter has. */
+      static const EmitterId INVALID_EMITTER = 0;
+
+      /** The way that an emitter's particles are drawn. */
+      enum Shape
+      {
+         /** A soft round dot. */
+         DOTS,
+         /** A line trailing behind the particle along its velocity, which fades out towards its tail. */
+         STREAKS
+      };
+
+      /** How an emitter spawns its particles and what they look like. */
+      struct EmitterSettings
+      {
+         /**
+          * The area that particles are spawned in (in pixels): its top-left corner and size.
+          * The corner is relative to the actor's center if the emitter follows an actor,
+          * and relative to the top-left corner of the screen if the emitter covers the screen.
+          */
+         int x, y, width, height;
+
+         /** The actor that the emitter follows, or INVALID_HANDLE if it stays put. */
+         ActorTable::ActorHandle actor;
+
+         /** Whether or not the emitter moves with the screen, so that its area stays in view (its size is the screen's, unless given). */
+         bool coversScreen;
+
+         /** The number of particles spawned each second. */
+         float rate;
+
+         /** The time that each particle lives for (in milliseconds). */
+         long lifetime;
+
+         /** The time that the emitter spawns particles for (in milliseconds), or 0 for as long as it exists. */
+         long duration;
+
+         /** The velocity that particles start with (in pixels per second). */
+         float velocityX, velocityY;
+
+         /** The furthest that each particle's starting velocity varies from the emitter's (in pixels per second). */
+         float velocitySpreadX, velocitySpreadY;
+
+         /** The downward acceleration of the particles (in pixels per second per second). */
+         float gravity;
+
+         /** The width of the particles (in pixels). */
+         float size;
+
+         /** The colour of the particles when they are spawned (0 to 1). They fade out over their lifetime. */
+         float red, green, blue, alpha;
+
+         /** The way that the particles are drawn. */
+         Shape shape;
+
+         /**
+          * Constructor. The default emitter spawns ten white dots a second at one point, which float in place for a second.
+          */
+         EmitterSettings();
+      };
+
+   private:
+      /** The most particles that one emitter keeps alive at once. */
+      static const int MAX_PARTICLES_PER_EMITTER;
+
+      /** The number of particles moved together in each step of the update. */
+      static const int PARTICLE_LANES;
+
+      /** The length of a streak, as the time it takes the particle to travel it (in seconds). */
+      static const float STREAK_TIME;
+
+      /** The width and height of the texture that dots are drawn with (in pixels). */
+      static const int DOT_TEXTURE_SIZE;
+
+      /** An emitter, along with its particles. */
+      struct Emitter
+      {
+         /** How the emitter spawns its particles and what they look like. */
+         EmitterSettings settings;
+
+         /** The fraction of a particle left over from the last spawn, which is spawned once it adds up to a whole one. */
+         float spawnDebt;
+
+         /** The time that the emitter has left to spawn particles for (in milliseconds), or -1 for as long as it exists. */
+         long timeLeft;
+
+         /** Whether or not the emitter has stopped spawning particles, and is removed once the last of them dies. */
+         bool stopped;
+
+         /** The number of live particles, which fill the front of the arrays. */
+         int count;
+
+         /** The arrays of the particles' positions (in pixels), velocities (in pixels per second) and times left to live (in milliseconds), padded to a whole number of lanes. */
+         std::vector<float> x, y, velocityX, velocityY, lifeLeft;
+      };
+
+      /** The emitters, mapped by ID. */
+      std::map<EmitterId, Emitter*> emitters;
+
+      /** The ID that the next emitter is given. */
+      EmitterId nextId;
+
+      /** The state of the generator for the particles' spawn points and velocities. */
+      unsigned int randomState;
+
+      /** The positions of the vertices being drawn (in pixels). */
+      std::vector<float> vertices;
+
+      /** The colours of the vertices being drawn. */
+      std::vector<unsigned char> colours;
+
+      /** The texture that dots are drawn with, or 0 if it hasn't been created. */
+      GLuint dotTexture;
+
+      /** Whether or not the driver has been checked for point sprites. */
+      static bool pointSpritesChecked;
+
+      /** Whether or not the driver supports point sprites. */
+      static bool pointSpritesSupported;
+
+      /**
+       * @return A random number from -1 to 1.
+       */
+      float nextRandom();
+
+      /**
+       * Moves the particles, ages them, and takes out the particles that have died.
+       *
+       * @param emitter The emitter whose particles are moved.
+       * @param seconds The time passed (in seconds).
+       */
+      static void integrate(Emitter& emitter, float seconds);
+
+      /**
+       * Spawns the particles due from an emitter.
+       *
+       * @param emitter The emitter.
+       * @param timePassed The time passed (in milliseconds).
+       * @param originX The x-coordinate (in pixels) that the emitter's area is relative to.
+       * @param originY The y-coordinate (in pixels) that the emitter's area is relative to.
+       * @param areaWidth The width of the area to spawn particles in (in pixels).
+       * @param areaHeight The height of the area to spawn particles in (in pixels).
+       */
+      void spawn(Emitter& emitter, long timePassed, int originX, int originY, int areaWidth, int areaHeight);
+
+      /**
+       * Creates the texture that dots are drawn with.
+       */
+      void createDotTexture();
+
+      /**
+       * Draws the particles of an emitter.
+       *
+       * @param emitter The emitter.
+       */
+      void drawEmitter(const Emitter& emitter);
+
+      /** Particle systems can't be copied. */
+      ParticleSystem(const ParticleSystem&);
+
+      /** Particle systems can't be copied. */
+      ParticleSystem& operator=(const ParticleSystem&);
+
+   public:
+      /**
+       * Constructor.
+       */
+      ParticleSystem();
+
+      /**
+       * Adds an emitter.
+       *
+       * @param settings How the emitter spawns its particles and what they look like.
+       *
+       * @return The ID of the new emitter.
+       */
+      EmitterId addEmitter(const EmitterSettings& settings);
+
+      /**
+       * Stops an emitter from spawning more particles. The emitter is removed once its particles have all died.
+       *
+       * @param id The ID of the emitter.
+       */
+      void stopEmitter(EmitterId id);
+
+      /**
+       * Removes an emitter right away, along with its particles.
+       *
+       * @param id The ID of the emitter.
+       */
+      void removeEmitter(EmitterId id);
+
+      /**
+       * Removes every emitter and particle, such as when the map changes.
+       */
+      void clear();
+
+      /**
+       * @return The number of live particles.
+       */
+      int getParticleCount() const;
+
+      /**
+       * Moves the particles, and spawns new ones.
+       *
+       * @param timePassed The time passed since the last step (in milliseconds).
+       * @param actorTable The actors on the map, which emitters can follow.
+       * @param visibleArea The area of the map in view (with inclusive edge coordinates in pixels).
+       */
+      void step(long timePassed, const ActorTable& actorTable, const shapes::Rectangle& visibleArea);
+
+      /**
+       * Draws the particles, in the coordinates that the map is drawn in.
+       * The sprite batch must be flushed first, so that the particles are drawn over the batched sprites.
+       */
+      void draw();
+
+      /**
+       * Destructor. Releases the dot texture.
+       */
+      ~ParticleSystem();
+};
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "PassabilityPyramid.h"
+#include "TileState.h"
+#include "Rectangle.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_ENTITY_GRID;
+
+void PassabilityPyramid::build(TileState** grid, int width, int height, int levelCount)
+{
+   levels.clear();
+   if(grid == NULL || width <= 0 || height <= 0) return;
+
+   levels.resize(std::max(levelCount, 1));
+
+   for(int levelNum = 0; levelNum < static_cast<int>(levels.size()); ++levelNum)
+   {
+      Level& level = levels[levelNum];
+      level.width = levelNum == 0 ? width : (levels[levelNum - 1].width + 1) / 2;
+      level.height = levelNum == 0 ? height : (levels[levelNum - 1].height + 1) / 2;
+      level.cells.assign(level.width * level.height, ALL_FREE);
+   }
+
+   update(grid, shapes::Rectangle(0, 0, height - 1, width - 1));
+
+   DEBUG("Built passability pyramid with %d levels for a %dx%d grid", static_cast<int>(levels.size()), width, height);
+}
+
+void PassabilityPyramid::summarizeCell(int levelNum, int x, int y)
+{
+   const Level& finerLevel = levels[levelNum - 1];
+   const int right = std::min(2 * x + 1, finerLevel.width - 1);
+   const int bottom = std::min(2 * y + 1, finerLevel.height - 1);
+
+   bool anyFree = false;
+   bool anyBlocked = false;
+   for(int finerY = 2 * y; finerY <= bottom; ++finerY)
+   {
+      for(int finerX = 2 * x; finerX <= right; ++finerX)
+      {
+         switch(finerLevel.cells[finerY * finerLevel.width + finerX])
+         {
+            case ALL_FREE:
+               anyFree = true;
+               break;
+            case ALL_BLOCKED:
+               anyBlocked = true;
+               break;
+            default:
+               anyFree = anyBlocked = true;
+               break;
+         }
+      }
+   }
+
+   Level& level = levels[levelNum];
+   level.cells[y * level.width + x] = anyFree ? (anyBlocked ? MIXED : ALL_FREE) : ALL_BLOCKED;
+}
+
+void PassabilityPyramid::update(TileState** grid, const shapes::Rectangle& area)
+{
+   if(levels.empty()) return;
+
+   Level& finestLevel = levels[0];
+   for(int y = area.top; y <= area.bottom; ++y)
+   {
+      for(int x = area.left; x <= area.right; ++x)
+      {
+         finestLevel.cells[y * finestLevel.width + x] = grid[y][x].entityType == TileState::OBSTACLE ? ALL_BLOCKED : ALL_FREE;
+      }
+   }
+
+   // Each level up only needs the cells above the changed cells of the level below
+   int left = area.left;
+   int top = area.top;
+   int right = area.right;
+   int bottom = area.bottom;
+   for(int levelNum = 1; levelNum < static_cast<int>(levels.size()); ++levelNum)
+   {
+      left /= 2;
+      top /= 2;
+      right /= 2;
+      bottom /= 2;
+
+      for(int y = top; y <= bottom; ++y)
+      {
+         for(int x = left; x <= right; ++x)
+         {
+            summarizeCell(levelNum, x, y);
+         }
+      }
+   }
+}
+
+bool PassabilityPyramid::cellContainsObstacle(int levelNum, int x, int y, const shapes::Rectangle& area) const
+{
+   const Level& level = levels[levelNum];
+   const unsigned char state = level.cells[y * level.width + x];
+   if(state == ALL_FREE) return false;
+
+   // The caller only asks about cells that overlap the area, so a blocked cell must block part of it
+   if(state == ALL_BLOCKED) return true;
+
+   const int cellLeft = x << levelNum;
+   const int cellTop = y << levelNum;
+   const int cellRight = ((x + 1) << levelNum) - 1;
+   const int cellBottom = ((y + 1) << levelNum) - 1;
+   if(area.left <= cellLeft && area.top <= cellTop && area.right >= cellRight && area.bottom >= cellBottom)
+   {
+      // Some of the tiles beneath the cell are blocked, and the area covers all of them
+      return true;
+   }
+
+   const int finerLevelNum = levelNum - 1;
+   const Level& finerLevel = levels[finerLevelNum];
+   const int finerLeft = std::max(2 * x, area.left >> finerLevelNum);
+   const int finerTop = std::max(2 * y, area.top >> finerLevelNum);
+   const int finerRight = std::min(std::min(2 * x + 1, finerLevel.width - 1), area.right >> finerLevelNum);
+   const int finerBottom = std::min(std::min(2 * y + 1, finerLevel.height - 1), area.bottom >> finerLevelNum);
+   for(int finerY = finerTop; finerY <= finerBottom; ++finerY)
+   {
+      for(int finerX = finerLeft; finerX <= finerRight; ++finerX)
+      {
+         if(cellContainsObstacle(finerLevelNum, finerX, finerY, area))
+         {
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+bool PassabilityPyramid::containsObstacle(const shapes::Rectangle& area) const
+{
+   if(levels.empty()) return false;
+
+   const int coarsestLevelNum = levels.size() - 1;
+   const Level& coarsestLevel = levels[coarsestLevelNum];
+   const int right = std::min(area.right >> coarsestLevelNum, coarsestLevel.width - 1);
+   const int bottom = std::min(area.bottom >> coarsestLevelNum, coarsestLevel.height - 1);
+   for(int y = area.top >> coarsestLevelNum; y <= bottom; ++y)
+   {
+      for(int x = area.left >> coarsestLevelNum; x <= right; ++x)
+      {
+         if(cellContainsObstacle(coarsestLevelNum, x, y, area))
+         {
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+void PassabilityPyramid::clear()
+{
+   levels.clear();
+}
@@ -0,0 +1,110 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PASSABILITY_PYRAMID_H
+#define PASSABILITY_PYRAMID_H
+
+#include <vector>
+
+struct TileState;
+
+namespace shapes
+{
+   struct Rectangle;
+};
+
+/**
+ * The PassabilityPyramid summarizes where the obstacles on a collision grid are, at a series of
+ * coarser and coarser resolutions. The finest level has one cell per collision tile, and each
+ * cell of the next level covers a 2x2 block of cells from the level below it.
+ *
+ * Every cell records whether the tiles beneath it are all free, all blocked, or a mix of the two,
+ * so queries over large areas can accept or reject whole blocks of tiles at once, and the cost of
+ * a query depends far less on how finely the map is divided into collision tiles.
+ */
+class PassabilityPyramid
+{
+   /** The state of a cell, summarizing the tiles beneath it. */
+   enum CellState
+   {
+      /** None of the tiles beneath the cell are obstacles. */
+      ALL_FREE,
+
+      /** All of the tiles beneath the cell are obstacles. */
+      ALL_BLOCKED,
+
+      /** Some, but not all, of the tiles beneath the cell are obstacles. */
+      MIXED
+   };
+
+   /** A single resolution of the pyramid. */
+   struct Level
+   {
+      /** The number of cells across the width of the level. */
+      int width;
+
+      /** The number of cells down the height of the level. */
+      int height;
+
+      /** The state of each cell, stored row by row. */
+      std::vector<unsigned char> cells;
+   };
+
+   /** The levels of the pyramid, from the finest (one cell per tile) to the coarsest. */
+   std::vector<Level> levels;
+
+   /**
+    * Recomputes the state of a cell from the state of the cells beneath it.
+    *
+    * @param levelNum The level of the cell (must be above the finest level).
+    * @param x The x-coordinate of the cell (in cells).
+    * @param y The y-coordinate of the cell (in cells).
+    */
+   void summarizeCell(int levelNum, int x, int y);
+
+   /**
+    * @param levelNum The level of the cell to check.
+    * @param x The x-coordinate of the cell (in cells).
+    * @param y The y-coordinate of the cell (in cells).
+    * @param area The area to check (with inclusive edge coordinates in tiles).
+    *
+    * @return true iff any of the tiles beneath the cell within the area are obstacles.
+    */
+   bool cellContainsObstacle(int levelNum, int x, int y, const shapes::Rectangle& area) const;
+
+   public:
+      /**
+       * Builds the pyramid for a collision grid.
+       *
+       * @param grid The collision grid, stored row by row.
+       * @param width The width of the grid (in tiles).
+       * @param height The height of the grid (in tiles).
+       * @param levelCount The number of levels to build, including the finest level.
+       */
+      void build(TileState** grid, int width, int height, int levelCount);
+
+      /**
+       * Updates the pyramid after tiles on the collision grid have been changed.
+       *
+       * @param grid The collision grid that the pyramid was built for.
+       * @param area The tiles that changed (with inclusive edge coordinates in tiles).
+       */
+      void update(TileState** grid, const shapes::Rectangle& area);
+
+      /**
+       * @param area The area to check (with inclusive edge coordinates in tiles), which must lie within the grid.
+       *
+       * @return true iff any tile within the area is an obstacle.
+       */
+      bool containsObstacle(const shapes::Rectangle& area) const;
+
+      /**
+       * Discards every level of the pyramid.
+       */
+      void clear();
+};
+
+#endif
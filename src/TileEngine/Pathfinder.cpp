@@ -5,9 +5,20 @@
  */
 
 #include "Pathfinder.h"
-#include "EntityGrid.h"
+#include "Pathfinder_ClusterGraph.h"
+#include "Pathfinder_SearchSpace.h"
+#include "Pathfinder_RerouteSearch.h"
+#include "Pathfinder_JumpPointSearch.h"
+#include "Pathfinder_OccupancyMap.h"
+#include "Pathfinder_WorkerPool.h"
+#include "Pathfinder_FlowField.h"
+#include "Pathfinder_LandmarkTable.h"
+#include "Pathfinder_ComponentMap.h"
 #include "Point2D.h"
+#include "Rectangle.h"
 #include "TileState.h"
+#include "MemoryTracker.h"
+#include <climits>
 #include <limits>
 #include <algorithm>
 
@@ -17,364 +28,792 @@ const int debugFlag = DEBUG_PATHFINDER;
 const float Pathfinder::ROOT_2 = 1.41421356f;
 const float Pathfinder::INFINITY = std::numeric_limits<float>::infinity();
 
-shapes::Point2D Pathfinder::tileNumToCoords(int tileNum)
+// Paths are cheap to store compared to the searches that produce them,
+// so keep enough of them around to cover the destinations of a busy map.
+const unsigned int Pathfinder::PATH_CACHE_CAPACITY = 256;
+
+// Each flow field costs a byte per tile, and there are rarely more than
+// a few crowds heading for different goals at the same time.
+const unsigned int Pathfinder::FLOW_FIELD_CAPACITY = 8;
+
+// Long runs hold on to every tile they cross until they are finished,
+// so keep them short enough not to hold up other entities for long.
+const int Pathfinder::MAX_WAYPOINT_SPAN = 4;
+
+// Enough for a search across a small map to finish within a frame,
+// while keeping the cost of a frame full of long searches bounded.
+const int Pathfinder::PATH_EXPANSIONS_PER_FRAME = 2000;
+
+// Half a cluster is enough room to get around most obstacles near the border between two clusters,
+// while keeping a direct search far cheaper than one over the whole grid.
+const int Pathfinder::LOCAL_SEARCH_MARGIN = 4;
+
+// About two clusters' worth of steps, so that each search can straighten out the bends at an entrance on either side of it.
+const int Pathfinder::PATH_SMOOTHING_WINDOW = 16;
+
+Pathfinder::SearchMode Pathfinder::defaultSearchMode = Pathfinder::A_STAR_SEARCH;
+
+const Pathfinder::NeighbourOffset Pathfinder::NEIGHBOUR_OFFSETS[Pathfinder::NUM_NEIGHBOURS] =
 {
-   div_t result = div(tileNum, collisionGridWidth);
-   return shapes::Point2D(result.rem, result.quot);
+   { 0, -1, false },
+   { -1, 0, false },
+   { 1, 0, false },
+   { 0, 1, false },
+   { -1, -1, true },
+   { 1, -1, true },
+   { -1, 1, true },
+   { 1, 1, true }
+};
+
+Pathfinder::Pathfinder() : cacheHitHeat(NULL), collisionSnapshot(NULL), collisionGridVersion(0), collisionGrid(NULL), passabilityPyramid(NULL), collisionGridWidth(0), collisionGridHeight(0), searchMode(defaultSearchMode), nextPathRequestId(INVALID_PATH_REQUEST), queryCount(0)
+{
+   MemoryTracker::Scope memoryScope(MemoryTracker::PATHFINDER);
+   clusterGraph = new ClusterGraph(*this);
+   landmarkTable = new LandmarkTable(*this);
+   componentMap = new ComponentMap(*this);
+   searchSpace = new SearchSpace();
+   workerPool = new WorkerPool(*this);
 }
 
-shapes::Point2D Pathfinder::tileNumToPixels(int tileNum)
+void Pathfinder::initialize(TileState** grid, const PassabilityPyramid* pyramid, int tileSize, int gridWidth, int gridHeight)
 {
-   shapes::Point2D p = tileNumToCoords(tileNum);
-   return p * movementTileSize;
+   MemoryTracker::Scope memoryScope(MemoryTracker::PATHFINDER);
+   clearPathRequests();
+   clearPathCache();
+   clearFlowFields();
+   movementTileSize = tileSize;
+   collisionGrid = grid;
+   passabilityPyramid = pyramid;
+   collisionGridWidth = gridWidth;
+   collisionGridHeight = gridHeight;
+   searchSpace->resize(gridWidth * gridHeight);
+   componentMap->build();
+   landmarkTable->build();
+   clusterGraph->initialize();
+   workerPool->start(gridWidth * gridHeight);
 }
 
-int Pathfinder::coordsToTileNum(const shapes::Point2D& tileLocation)
+Pathfinder::SearchMode Pathfinder::getDefaultSearchMode()
 {
-   return (tileLocation.y * collisionGridWidth + tileLocation.x);
+   return defaultSearchMode;
 }
 
-int Pathfinder::pixelsToTileNum(const shapes::Point2D& pixelLocation)
+void Pathfinder::setDefaultSearchMode(SearchMode mode)
 {
-   return coordsToTileNum(pixelLocation / movementTileSize);
+   defaultSearchMode = mode;
 }
 
-Pathfinder::Pathfinder() : distanceMatrix(NULL), successorMatrix(NULL), collisionGrid(NULL), collisionGridWidth(0), collisionGridHeight(0)
+void Pathfinder::setSearchMode(SearchMode mode)
 {
+   searchMode = mode;
 }
 
-void Pathfinder::initialize(TileState** grid, int tileSize, int gridWidth, int gridHeight)
+void Pathfinder::markCollisionGridChanged()
 {
-   deleteRoyFloydWarshallMatrices();
-   movementTileSize = tileSize;
-   collisionGrid = grid;
-   collisionGridWidth = gridWidth;
-   collisionGridHeight = gridHeight;
-   initRoyFloydWarshallMatrices();
+   ++collisionGridVersion;
+}
+
+void Pathfinder::invalidateStaticPaths(const shapes::Rectangle& area, bool areaBlocked)
+{
+   if(collisionGrid == NULL) return;
+
+   componentMap->update(area);
+   repairPathCache(area, areaBlocked);
+   clearFlowFields();
+
+   // New obstacles only make paths longer, so the landmark distances are still lower bounds
+   if(!areaBlocked)
+   {
+      landmarkTable->invalidate();
+   }
+
+   clusterGraph->rebuild(area);
+}
+
+void Pathfinder::clearPathCache()
+{
+   pathCache.clear();
+   pathCacheIndex.clear();
+}
+
+void Pathfinder::clearFlowFields()
+{
+   for(std::list<CachedFlowField>::iterator iter = flowFieldCache.begin(); iter != flowFieldCache.end(); ++iter)
+   {
+      delete iter->field;
+   }
+
+   flowFieldCache.clear();
+   flowFieldCacheIndex.clear();
 }
 
-void Pathfinder::initRoyFloydWarshallMatrices()
+const Pathfinder::FlowField& Pathfinder::getFlowField(int goalTileNum, int footprintWidth, int footprintHeight)
 {
-   const int NUM_TILES = collisionGridWidth * collisionGridHeight;
-   
-   distanceMatrix = new float*[NUM_TILES];
-   successorMatrix = new int*[NUM_TILES];
+   const FlowFieldKey key(goalTileNum, std::make_pair(footprintWidth, footprintHeight));
+
+   std::map<FlowFieldKey, std::list<CachedFlowField>::iterator>::iterator indexIter = flowFieldCacheIndex.find(key);
+   if(indexIter != flowFieldCacheIndex.end())
+   {
+      // Move the field to the front of the cache to mark it as the most recently used field
+      flowFieldCache.splice(flowFieldCache.begin(), flowFieldCache, indexIter->second);
+      return *indexIter->second->field;
+   }
+
+   CachedFlowField cachedField;
+   cachedField.key = key;
+   cachedField.field = new FlowField(*this, goalTileNum, footprintWidth, footprintHeight);
+   flowFieldCache.push_front(cachedField);
+   flowFieldCacheIndex[key] = flowFieldCache.begin();
+
+   if(flowFieldCache.size() > FLOW_FIELD_CAPACITY)
+   {
+      DEBUG("Evicting flow field for goal tile %d", flowFieldCache.back().key.first);
+      delete flowFieldCache.back().field;
+      flowFieldCacheIndex.erase(flowFieldCache.back().key);
+      flowFieldCache.pop_back();
+   }
+
+   return *flowFieldCache.front().field;
+}
+
+bool Pathfinder::findFlowWaypoint(const shapes::Point2D& goal, const shapes::Point2D& location, int width, int height, shapes::Point2D& waypoint)
+{
+   MemoryTracker::Scope memoryScope(MemoryTracker::PATHFINDER);
+   if(collisionGrid == NULL) return false;
+
+   const int gridPixelWidth = collisionGridWidth * movementTileSize;
+   const int gridPixelHeight = collisionGridHeight * movementTileSize;
+   if(location.x < 0 || location.y < 0 || location.x >= gridPixelWidth || location.y >= gridPixelHeight
+      || goal.x < 0 || goal.y < 0 || goal.x >= gridPixelWidth || goal.y >= gridPixelHeight)
+   {
+      return false;
+   }
+
+   const shapes::Point2D tile = location / movementTileSize;
+   if(tile * movementTileSize != location)
+   {
+      // Line up with the grid before following the field
+      waypoint = tile * movementTileSize;
+      return true;
+   }
 
-   for(int i = 0; i < NUM_TILES; ++i)
+   const int footprintWidth = (width - 1) / movementTileSize + 1;
+   const int footprintHeight = (height - 1) / movementTileSize + 1;
+   const NeighbourOffset* step = getFlowField(pixelsToTileNum(goal), footprintWidth, footprintHeight).getNextStep(coordsToTileNum(tile));
+   if(step == NULL)
    {
-      distanceMatrix[i] = new float[NUM_TILES];
-      successorMatrix[i] = new int[NUM_TILES];
+      return false;
    }
 
-   shapes::Point2D aTile;
-   shapes::Point2D bTile;
+   waypoint = shapes::Point2D(tile.x + step->x, tile.y + step->y) * movementTileSize;
+   return true;
+}
 
-   for(int a = 0; a < NUM_TILES; ++a)
+void Pathfinder::repairPathCache(const shapes::Rectangle& area, bool areaBlocked)
+{
+   std::list<CachedPath>::iterator iter = pathCache.begin();
+   while(iter != pathCache.end())
    {
-      aTile = tileNumToCoords(a);
-      for(int b = 0; b < NUM_TILES; ++b)
+      bool stale = false;
+
+      if(areaBlocked)
       {
-         if(a == b)
+         // Blocking tiles only makes other paths more expensive, so a path
+         // that avoids the area entirely remains the best path.
+         if(!iter->path.empty())
          {
-            distanceMatrix[a][b] = 0;
-            successorMatrix[a][b] = -1;
-         }
-         else
-         {
-            bTile = tileNumToCoords(b);
-
-            bool xAdjacent = aTile.x - 1 <= bTile.x && bTile.x <= aTile.x + 1;
-            bool yAdjacent = aTile.y - 1 <= bTile.y && bTile.y <= aTile.y + 1;
-            
-            bool adjacent = xAdjacent && yAdjacent;
-            
-            if(!adjacent 
-               || collisionGrid[aTile.y][aTile.x].entityType == TileState::OBSTACLE 
-               || collisionGrid[bTile.y][bTile.x].entityType == TileState::OBSTACLE)
-            {
-               distanceMatrix[a][b] = INFINITY;
-               successorMatrix[a][b] = -1;
-            }
-            else
+            stale = area.contains(tileNumToCoords(iter->key.first));
+            for(Path::const_iterator waypoint = iter->path.begin(); !stale && waypoint != iter->path.end(); ++waypoint)
             {
-               successorMatrix[a][b] = b;
-               if(aTile.x != bTile.x && aTile.y != bTile.y)
-               {
-                  distanceMatrix[a][b] = ROOT_2;
-               }
-               else
-               {
-                  distanceMatrix[a][b] = 1;
-               }
+               stale = area.contains(*waypoint / movementTileSize);
             }
          }
       }
+      else if(iter->key.first != iter->key.second)
+      {
+         // Clearing tiles can only create shortcuts through the area, so a path
+         // is still the best path if no route through the area can beat it.
+         stale = iter->path.empty() || iter->cost > getDetourLowerBound(iter->key.first, iter->key.second, area);
+      }
+
+      if(stale)
+      {
+         DEBUG("Evicting stale cached path from tile %d to tile %d", iter->key.first, iter->key.second);
+         pathCacheIndex.erase(iter->key);
+         iter = pathCache.erase(iter);
+      }
+      else
+      {
+         ++iter;
+      }
    }
+}
+
+float Pathfinder::getPathCost(int srcTileNum, const std::list<shapes::Point2D>& path) const
+{
+   float cost = 0;
+   shapes::Point2D prevTile = tileNumToCoords(srcTileNum);
+   for(Path::const_iterator iter = path.begin(); iter != path.end(); ++iter)
+   {
+      const shapes::Point2D tile = *iter / movementTileSize;
+      cost += (tile.x != prevTile.x && tile.y != prevTile.y) ? ROOT_2 : 1.0f;
+      prevTile = tile;
+   }
+
+   return cost;
+}
+
+float Pathfinder::getDetourLowerBound(int srcTileNum, int dstTileNum, const shapes::Rectangle& area) const
+{
+   const int left = std::max(area.left, 0);
+   const int top = std::max(area.top, 0);
+   const int right = std::min(area.right, collisionGridWidth - 1);
+   const int bottom = std::min(area.bottom, collisionGridHeight - 1);
 
-   for(int i = 0; i < NUM_TILES; ++i)
+   float lowerBound = INFINITY;
+   for(int y = top; y <= bottom; ++y)
    {
-      for(int a = 0; a < NUM_TILES; ++a)
+      for(int x = left; x <= right; ++x)
       {
-         for(int b = 0; b < NUM_TILES; ++b)
-         {
-            float distance = distanceMatrix[a][i] + distanceMatrix[i][b];
-            if(distance < distanceMatrix[a][b])
-            {
-               distanceMatrix[a][b] = distance;
-               successorMatrix[a][b] = successorMatrix[a][i];
-            }
-         }
+         const int tileNum = coordsToTileNum(shapes::Point2D(x, y));
+         lowerBound = std::min(lowerBound, getOctileDistance(srcTileNum, tileNum) + getOctileDistance(tileNum, dstTileNum));
       }
    }
+
+   return lowerBound;
 }
 
 Pathfinder::Path Pathfinder::findBestPath(const shapes::Point2D& src, const shapes::Point2D& dst)
 {
-   return findRFWPath(src, dst);
+   MemoryTracker::Scope memoryScope(MemoryTracker::PATHFINDER);
+   ++queryCount;
+   return findCachedPath(src, dst);
 }
 
-Pathfinder::Path Pathfinder::findReroutedPath(const EntityGrid& entityGrid, const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height)
+Pathfinder::Path Pathfinder::findReroutedPath(const OccupancyMap& occupancy, const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height)
 {
-   return findAStarPath(entityGrid, src, dst, width, height);
+   MemoryTracker::Scope memoryScope(MemoryTracker::PATHFINDER);
+   ++queryCount;
+   if(collisionGrid == NULL) return Path();
+
+   const TileState& entityState = collisionGrid[src.y / movementTileSize][src.x / movementTileSize];
+
+   if(!occupancy.canOccupyArea(dst, width, height, entityState)) return Path();
+
+   // No amount of searching will get around static obstacles that wall off the destination
+   const int srcTileNum = pixelsToTileNum(src);
+   const int dstTileNum = pixelsToTileNum(dst);
+   if(!componentMap->isConnected(srcTileNum, dstTileNum)) return Path();
+
+   RerouteSearch* search = createReroutedSearch(searchMode, *searchSpace, occupancy, entityState, width, height, srcTileNum, dstTileNum);
+
+   int expansionBudget = std::numeric_limits<int>::max();
+   search->advance(expansionBudget);
+   Path path = search->getPath();
+   delete search;
+
+   return path;
 }
 
-class Pathfinder::AStarPoint : public shapes::Point2D
+Pathfinder::RerouteSearch* Pathfinder::createReroutedSearch(SearchMode mode, SearchSpace& space, const OccupancyMap& occupancy, const TileState& entityState, int width, int height, int srcTileNum, int dstTileNum)
 {
-   private:
-      const AStarPoint* parent;
-      
-      float gCost;
-      float hCost;
+   if(mode == JUMP_POINT_SEARCH)
+   {
+      return new JumpPointSearch(*this, space, occupancy, entityState, width, height, srcTileNum, dstTileNum);
+   }
 
-      float fCost;
+   return new AStarSearch(*this, space, occupancy, entityState, width, height, srcTileNum, dstTileNum);
+}
 
-   public:
-      AStarPoint(const AStarPoint* parent, int x, int y, float gCost, float hCost) : shapes::Point2D(x,y), parent(parent), gCost(gCost), hCost(hCost), fCost(gCost + hCost) {}
+Pathfinder::WaypointList Pathfinder::compactPath(const shapes::Point2D& src, const Path& path) const
+{
+   WaypointList waypoints;
+   waypoints.reserve(path.size());
 
-      void setParent(const AStarPoint* newParent)
-      {
-         parent = newParent;
-      }
-   
-      void setGCost(float newCost)
+   shapes::Point2D runStart = src;
+   for(Path::const_iterator iter = path.begin(); iter != path.end(); ++iter)
+   {
+      if(!waypoints.empty())
       {
-         gCost = newCost;
-         fCost = gCost + hCost;
+         // Extend the current run if the next waypoint carries on in the same lateral direction
+         shapes::Point2D& runEnd = waypoints.back();
+         const bool continuesColumn = runStart.x == runEnd.x && runEnd.x == iter->x && (iter->y - runEnd.y) * (runEnd.y - runStart.y) > 0;
+         const bool continuesRow = runStart.y == runEnd.y && runEnd.y == iter->y && (iter->x - runEnd.x) * (runEnd.x - runStart.x) > 0;
+         const int span = std::max(std::abs(iter->x - runStart.x), std::abs(iter->y - runStart.y));
+
+         if((continuesColumn || continuesRow) && span <= MAX_WAYPOINT_SPAN * movementTileSize)
+         {
+            runEnd = *iter;
+            continue;
+         }
+
+         runStart = runEnd;
       }
-      
-      void setHCost(float newCost)
+
+      waypoints.push_back(*iter);
+   }
+
+   return waypoints;
+}
+
+Pathfinder::PathRequestId Pathfinder::requestBestPath(const shapes::Point2D& src, const shapes::Point2D& dst)
+{
+   PathRequest request;
+   request.rerouted = false;
+   request.occupancy = NULL;
+   request.src = src;
+   request.dst = dst;
+   request.width = 0;
+   request.height = 0;
+   return queuePathRequest(request);
+}
+
+Pathfinder::PathRequestId Pathfinder::requestReroutedPath(const OccupancyMap& occupancy, const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height)
+{
+   PathRequest request;
+   request.rerouted = true;
+   request.occupancy = &occupancy;
+   request.src = src;
+   request.dst = dst;
+   request.width = width;
+   request.height = height;
+   return queuePathRequest(request);
+}
+
+Pathfinder::PathRequestId Pathfinder::queuePathRequest(const PathRequest& request)
+{
+   MemoryTracker::Scope memoryScope(MemoryTracker::PATHFINDER);
+   ++queryCount;
+   ++nextPathRequestId;
+   if(nextPathRequestId == INVALID_PATH_REQUEST)
+   {
+      ++nextPathRequestId;
+   }
+
+   PathRequest& queuedRequest = pathRequests[nextPathRequestId];
+   queuedRequest = request;
+   queuedRequest.complete = false;
+   pendingRequests.push_back(nextPathRequestId);
+
+   return nextPathRequestId;
+}
+
+bool Pathfinder::collectPath(PathRequestId requestId, Path& path)
+{
+   std::map<PathRequestId, PathRequest>::iterator requestIter = pathRequests.find(requestId);
+   if(requestIter == pathRequests.end())
+   {
+      path.clear();
+      return true;
+   }
+
+   if(!requestIter->second.complete)
+   {
+      return false;
+   }
+
+   path.swap(requestIter->second.path);
+   pathRequests.erase(requestIter);
+   return true;
+}
+
+void Pathfinder::cancelPathRequest(PathRequestId requestId)
+{
+   std::map<PathRequestId, PathRequest>::iterator requestIter = pathRequests.find(requestId);
+   if(requestIter == pathRequests.end()) return;
+
+   // A search that has already been dispatched keeps running, but its result is discarded when it comes back
+   if(!requestIter->second.complete)
+   {
+      pendingRequests.remove(requestId);
+   }
+
+   pathRequests.erase(requestIter);
+}
+
+void Pathfinder::clearPathRequests()
+{
+   workerPool->stop();
+   pendingRequests.clear();
+   pathRequests.clear();
+
+   if(collisionSnapshot != NULL)
+   {
+      collisionSnapshot->release();
+      collisionSnapshot = NULL;
+   }
+}
+
+Pathfinder::CollisionSnapshot* Pathfinder::getCollisionSnapshot()
+{
+   if(collisionSnapshot == NULL || collisionSnapshot->getVersion() != collisionGridVersion)
+   {
+      if(collisionSnapshot != NULL)
       {
-         hCost = newCost;
-         fCost = gCost + hCost;
+         collisionSnapshot->release();
       }
-      
-      const AStarPoint* getParent() const
+
+      collisionSnapshot = new CollisionSnapshot(collisionGrid, movementTileSize, collisionGridWidth, collisionGridHeight, collisionGridVersion);
+   }
+
+   collisionSnapshot->retain();
+   return collisionSnapshot;
+}
+
+bool Pathfinder::dispatchReroutedRequest(PathRequestId requestId, const PathRequest& request)
+{
+   if(collisionGrid == NULL) return false;
+
+   const TileState& entityState = collisionGrid[request.src.y / movementTileSize][request.src.x / movementTileSize];
+
+   if(!request.occupancy->canOccupyArea(request.dst, request.width, request.height, entityState)) return false;
+   if(!componentMap->isConnected(pixelsToTileNum(request.src), pixelsToTileNum(request.dst))) return false;
+
+   WorkerPool::Job* job = new WorkerPool::Job();
+   job->requestId = requestId;
+   job->snapshot = getCollisionSnapshot();
+   job->searchMode = searchMode;
+   job->entityState = entityState;
+   job->width = request.width;
+   job->height = request.height;
+   job->srcTileNum = pixelsToTileNum(request.src);
+   job->dstTileNum = pixelsToTileNum(request.dst);
+
+   workerPool->queueJob(job);
+   return true;
+}
+
+void Pathfinder::receiveCompletedSearches()
+{
+   std::list<WorkerPool::Job*> completedJobs;
+   workerPool->collectCompletedJobs(completedJobs);
+
+   for(std::list<WorkerPool::Job*>::iterator iter = completedJobs.begin(); iter != completedJobs.end(); ++iter)
+   {
+      WorkerPool::Job* job = *iter;
+      std::map<PathRequestId, PathRequest>::iterator requestIter = pathRequests.find(job->requestId);
+      if(requestIter != pathRequests.end())
       {
-         return parent;
+         requestIter->second.path.swap(job->path);
+         requestIter->second.complete = true;
       }
-   
-      float getGCost() const
+
+      delete job;
+   }
+}
+
+void Pathfinder::processPathRequests()
+{
+   MemoryTracker::Scope memoryScope(MemoryTracker::PATHFINDER);
+   receiveCompletedSearches();
+
+   int expansionBudget = PATH_EXPANSIONS_PER_FRAME;
+   while(expansionBudget > 0 && !pendingRequests.empty())
+   {
+      const PathRequestId requestId = pendingRequests.front();
+      pendingRequests.pop_front();
+      PathRequest& request = pathRequests[requestId];
+
+      if(!request.rerouted)
       {
-         return gCost;
+         // Best paths are usually cached, and otherwise found hierarchically,
+         // so they are cheap enough to answer in one go on the main thread.
+         request.path = findCachedPath(request.src, request.dst);
+         request.complete = true;
+         --expansionBudget;
       }
-      
-      float getHCost() const
+      else if(!dispatchReroutedRequest(requestId, request))
       {
-         return hCost;
+         request.complete = true;
       }
+   }
 
-      float getFCost() const
-      {
-         return fCost;
-      }
-   
-      struct IsLowerPriority
-      {
-         bool operator()(const AStarPoint* lhs, const AStarPoint* rhs) const
-         {
-            // We consider lhs to have a lower priority if it has a higher total f() cost.
-            // In case of a tie, this point will have lower priority if it has a lower g() cost,
-            // indicating that it is not as deep in the search tree.
-            return lhs->fCost > rhs->fCost || (lhs->fCost == rhs->fCost && lhs->gCost < rhs->gCost);
-         }
-      };
-   
-      struct ArePointsEqual
-      {
-         const shapes::Point2D& point;
-         
-         bool operator()(const AStarPoint* other) const
-         {
-            return point == *other;
-         }
-      };
-};
+   // If the workers couldn't be started, the searches run here instead
+   workerPool->work(expansionBudget);
+   receiveCompletedSearches();
 
-Pathfinder::Path Pathfinder::findAStarPath(const EntityGrid& entityGrid, const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height)
-{
-   if(collisionGrid == NULL) return Path();
+   // A stale landmark table is rebuilt a search at a time, so that opening a passage doesn't stall a frame
+   landmarkTable->rebuildStep();
+}
 
-   const TileState& entityState = collisionGrid[src.y / movementTileSize][src.x / movementTileSize];
+unsigned long Pathfinder::getExpansionCount() const
+{
+   return searchSpace->getExpansionCount();
+}
 
-   if(!entityGrid.canOccupyArea(dst, width, height, entityState)) return Path();
+unsigned long Pathfinder::getQueryCount() const
+{
+   return queryCount;
+}
 
-   shapes::Point2D destinationPoint(dst.x / movementTileSize, dst.y / movementTileSize);
+void Pathfinder::setHeatMaps(std::vector<unsigned short>* expansionHeat, std::vector<unsigned short>* cacheHitHeat)
+{
+   searchSpace->setHeatMap(expansionHeat);
+   this->cacheHitHeat = cacheHitHeat;
+}
 
-   std::vector<AStarPoint*> openSet;
-   std::vector<const AStarPoint*> closedSet;
-   
-   const int NUM_TILES = collisionGridWidth*collisionGridHeight;
-   std::vector<bool> discovered(NUM_TILES, false);
-   const shapes::Point2D srcTile(src.x / movementTileSize, src.y / movementTileSize);
-   
-   openSet.push_back(new AStarPoint(NULL, srcTile.x, srcTile.y, 0, 0));
-   std::push_heap(openSet.begin(), openSet.end(), AStarPoint::IsLowerPriority());         
+Pathfinder::Path Pathfinder::findCachedPath(const shapes::Point2D& src, const shapes::Point2D& dst)
+{
+   if(collisionGrid == NULL) return Path();
 
-   const int sourceTileNum = pixelsToTileNum(src);
-   const int destinationTileNum = pixelsToTileNum(dst);
+   const int gridPixelWidth = collisionGridWidth * movementTileSize;
+   const int gridPixelHeight = collisionGridHeight * movementTileSize;
+   if(src.x < 0 || src.y < 0 || src.x >= gridPixelWidth || src.y >= gridPixelHeight
+      || dst.x < 0 || dst.y < 0 || dst.x >= gridPixelWidth || dst.y >= gridPixelHeight)
+   {
+      return Path();
+   }
 
-   discovered[sourceTileNum] = true;
+   const PathKey key(pixelsToTileNum(src), pixelsToTileNum(dst));
 
-   Path path;
-      
-   while(!openSet.empty())
+   std::map<PathKey, std::list<CachedPath>::iterator>::iterator indexIter = pathCacheIndex.find(key);
+   if(indexIter != pathCacheIndex.end())
    {
-      // Get the lowest-cost point in the open set, and remove it from the open set
-      const AStarPoint* cheapestPoint = openSet.front();
-      std::pop_heap(openSet.begin(), openSet.end(), AStarPoint::IsLowerPriority());
-      openSet.pop_back();
-      closedSet.push_back(cheapestPoint);
+      // Move the path to the front of the cache to mark it as the most recently used path
+      pathCache.splice(pathCache.begin(), pathCache, indexIter->second);
 
-      if(*cheapestPoint == destinationPoint)
+      if(cacheHitHeat != NULL)
       {
-         DEBUG("Found goal point %d,%d", cheapestPoint->x, cheapestPoint->y);
-         const AStarPoint* curr = cheapestPoint;
-         while(curr != NULL)
-         {
-            path.push_front(shapes::Point2D(curr->x * movementTileSize, curr->y * movementTileSize));
-            curr = curr->getParent();
-         }
-         break;
+         unsigned short& srcHeat = (*cacheHitHeat)[key.first];
+         unsigned short& dstHeat = (*cacheHitHeat)[key.second];
+         if(srcHeat < USHRT_MAX) ++srcHeat;
+         if(dstHeat < USHRT_MAX) ++dstHeat;
       }
-      
-      DEBUG("Evaluating point %d,%d", cheapestPoint->x, cheapestPoint->y);
-
-      // Evaluate all the existing laterally adjacent points,
-      // adding 1 as the cost of reaching the point from our current cheapest point.
-      const std::vector<shapes::Point2D> lateralPoints = shapes::Point2D::getLaterallyAdjacentPoints(*cheapestPoint, collisionGridWidth, collisionGridHeight);
-      evaluateAdjacentNodes(entityGrid, entityState, lateralPoints, cheapestPoint, 1.0f, destinationTileNum, openSet, discovered, width, height);
 
-      // Evaluate all the existing diagonally adjacent points,
-      // adding the square root of 2 as the cost of reaching the point from our current cheapest point.
-      const std::vector<shapes::Point2D> diagonalPoints = shapes::Point2D::getDiagonallyAdjacentPoints(*cheapestPoint, collisionGridWidth, collisionGridHeight);
-      evaluateAdjacentNodes(entityGrid, entityState, diagonalPoints, cheapestPoint, ROOT_2, destinationTileNum, openSet, discovered, width, height, true);
-   }
-   
-   for(std::vector<AStarPoint*>::const_iterator iter = openSet.begin(); iter != openSet.end(); ++iter)
-   {
-      delete *iter;
+      return indexIter->second->path;
    }
-   
-   for(std::vector<const AStarPoint*>::const_iterator iter = closedSet.begin(); iter != closedSet.end(); ++iter)
+
+   CachedPath cachedPath;
+   cachedPath.key = key;
+   pathCache.push_front(cachedPath);
+   pathCache.front().path = findStaticPath(key.first, key.second);
+   pathCache.front().cost = getPathCost(key.first, pathCache.front().path);
+   pathCacheIndex[key] = pathCache.begin();
+
+   if(pathCache.size() > PATH_CACHE_CAPACITY)
    {
-      delete *iter;
+      DEBUG("Evicting cached path from tile %d to tile %d", pathCache.back().key.first, pathCache.back().key.second);
+      pathCacheIndex.erase(pathCache.back().key);
+      pathCache.pop_back();
    }
-   
-   return path;
+
+   return pathCache.front().path;
 }
 
-void Pathfinder::evaluateAdjacentNodes(const EntityGrid& entityGrid, const TileState& entityState, const std::vector<shapes::Point2D>& adjacentNodes, const AStarPoint* evaluatedPoint, float traversalCost, int destinationTileNum, std::vector<AStarPoint*>& openSet, std::vector<bool>& discovered, int width, int height, bool diagonalMovement)
+Pathfinder::Path Pathfinder::findStaticPath(int srcTileNum, int dstTileNum)
 {
-   for(std::vector<shapes::Point2D>::const_iterator iter = adjacentNodes.begin(); iter != adjacentNodes.end(); ++iter)
+   Path path;
+
+   const shapes::Point2D srcTile = tileNumToCoords(srcTileNum);
+   const shapes::Point2D dstTile = tileNumToCoords(dstTileNum);
+   if(srcTileNum == dstTileNum
+      || collisionGrid[srcTile.y][srcTile.x].entityType == TileState::OBSTACLE
+      || collisionGrid[dstTile.y][dstTile.x].entityType == TileState::OBSTACLE)
    {
-      int adjacentTileNum = coordsToTileNum(*iter);
-      float tileGCost = evaluatedPoint->getGCost() + traversalCost;
-      float tileHCost = distanceMatrix[adjacentTileNum][destinationTileNum];
-      if(!discovered[adjacentTileNum])
-      {
-         discovered[adjacentTileNum] = true;
-         const int x = iter->x;
-         const int y = iter->y;
-         
-         bool freeTile = entityGrid.canOccupyArea(shapes::Point2D(x, y) * movementTileSize, width, height, entityState);
+      return path;
+   }
 
-         if(diagonalMovement)
-         {
-            freeTile = freeTile && entityGrid.canOccupyArea(shapes::Point2D(evaluatedPoint->x, y), width, height, entityState)
-                                && entityGrid.canOccupyArea(shapes::Point2D(x, evaluatedPoint->y), width, height, entityState);
-         }
+   if(!componentMap->isConnected(srcTileNum, dstTileNum))
+   {
+      DEBUG("Tile %d cannot be reached from tile %d.", dstTileNum, srcTileNum);
+      return path;
+   }
 
-         if(freeTile)
+   const int srcClusterNum = clusterGraph->getClusterNum(srcTileNum);
+   const int dstClusterNum = clusterGraph->getClusterNum(dstTileNum);
+   if(srcClusterNum != dstClusterNum)
+   {
+      if(clusterGraph->areClustersAdjacent(srcClusterNum, dstClusterNum))
+      {
+         // The best path between neighbouring clusters rarely goes far out of its way, and often crosses
+         // the border between them away from its transitions, so search the area around both clusters directly
+         const shapes::Rectangle& srcBounds = clusterGraph->getClusterBounds(srcClusterNum);
+         const shapes::Rectangle& dstBounds = clusterGraph->getClusterBounds(dstClusterNum);
+         const shapes::Rectangle bounds(std::max(std::min(srcBounds.top, dstBounds.top) - LOCAL_SEARCH_MARGIN, 0),
+                                        std::max(std::min(srcBounds.left, dstBounds.left) - LOCAL_SEARCH_MARGIN, 0),
+                                        std::min(std::max(srcBounds.bottom, dstBounds.bottom) + LOCAL_SEARCH_MARGIN, collisionGridHeight - 1),
+                                        std::min(std::max(srcBounds.right, dstBounds.right) + LOCAL_SEARCH_MARGIN, collisionGridWidth - 1));
+         if(findLocalPath(srcTileNum, dstTileNum, bounds, &path) != INFINITY)
          {
-            DEBUG("Pushing point %d,%d onto open set with g()=%f and f()=%f.", iter->x, iter->y, tileGCost, tileGCost + tileHCost);
-            openSet.push_back(new AStarPoint(evaluatedPoint, iter->x, iter->y, tileGCost, tileHCost));
-            std::push_heap(openSet.begin(), openSet.end(), AStarPoint::IsLowerPriority());
+            return path;
          }
       }
-      else
+
+      path = findHierarchicalPath(srcTileNum, dstTileNum);
+      if(!path.empty())
       {
-         AStarPoint::ArePointsEqual equality = { *iter };
-         std::vector<AStarPoint*>::const_iterator tileInOpenSet = std::find_if(openSet.begin(), openSet.end(), equality);
-         if(tileInOpenSet != openSet.end() && (*tileInOpenSet)->getGCost() > tileGCost)
-         {
-            DEBUG("Altering cost of discovered point %d, %d to g()=%f and f()=%f", iter->x, iter->y, tileGCost, tileGCost + tileHCost);
-            (*tileInOpenSet)->setGCost(tileGCost);
-            (*tileInOpenSet)->setParent(evaluatedPoint);
-            std::make_heap(openSet.begin(), openSet.end(), AStarPoint::IsLowerPriority());
-         }
+         return path;
       }
+
+      // The cluster entrances don't cover every possible crossing (such as cutting diagonally
+      // through the corner of a cluster), so fall back to a full search before giving up.
+      DEBUG("No hierarchical path found from tile %d to tile %d.", srcTileNum, dstTileNum);
    }
+
+   findLocalPath(srcTileNum, dstTileNum, shapes::Rectangle(0, 0, collisionGridHeight - 1, collisionGridWidth - 1), &path);
+   return path;
 }
 
-Pathfinder::Path Pathfinder::findRFWPath(const shapes::Point2D& src, const shapes::Point2D& dst)
+Pathfinder::Path Pathfinder::findHierarchicalPath(int srcTileNum, int dstTileNum)
 {
    Path path;
 
-   int srcTileNum = pixelsToTileNum(src);
-   const int dstTileNum = pixelsToTileNum(dst);
+   std::vector<int> abstractPath;
+   if(!clusterGraph->findAbstractPath(srcTileNum, dstTileNum, abstractPath))
+   {
+      return path;
+   }
 
-   for(;;)
+   for(unsigned int i = 1; i < abstractPath.size(); ++i)
    {
-      int nextTile = successorMatrix[srcTileNum][dstTileNum];
-      if(nextTile == -1)
+      const int fromTileNum = abstractPath[i - 1];
+      const int toTileNum = abstractPath[i];
+      const int clusterNum = clusterGraph->getClusterNum(fromTileNum);
+
+      if(clusterNum == clusterGraph->getClusterNum(toTileNum))
       {
-         break;
+         // Refine the step between two nodes in the same cluster with a search bounded by the cluster
+         findLocalPath(fromTileNum, toTileNum, clusterGraph->getClusterBounds(clusterNum), &path);
+      }
+      else
+      {
+         // Steps between clusters always cross to the adjacent tile on the other side of an entrance
+         path.push_back(tileNumToPixels(toTileNum));
       }
-      
-      path.push_back(shapes::Point2D(tileNumToPixels(nextTile)));
-      srcTileNum = nextTile;
    }
 
+   smoothPath(srcTileNum, path);
    return path;
 }
 
-void Pathfinder::deleteRoyFloydWarshallMatrices()
+void Pathfinder::smoothPath(int srcTileNum, Path& path)
 {
-   const int numTiles = collisionGridWidth * collisionGridHeight;
-   if(distanceMatrix)
+   std::vector<int> tileNums(1, srcTileNum);
+   for(Path::const_iterator iter = path.begin(); iter != path.end(); ++iter)
    {
-      for(int i = 0; i < numTiles; ++i)
+      tileNums.push_back(pixelsToTileNum(*iter));
+   }
+
+   // The second pass starts half a window in, so that the ends of the first pass's stretches get straightened out too
+   for(int pass = 0; pass < 2; ++pass)
+   {
+      std::vector<int> smoothedTileNums(1, srcTileNum);
+      const int lastStep = tileNums.size() - 1;
+      int start = 0;
+      while(start < lastStep)
       {
-         delete [] distanceMatrix[i];
+         const int end = std::min(start + (pass == 1 && start == 0 ? PATH_SMOOTHING_WINDOW / 2 : PATH_SMOOTHING_WINDOW), lastStep);
+
+         // The stretch itself always lies within the search's bounds, so the search never does worse than the stretch
+         shapes::Rectangle bounds(collisionGridHeight, collisionGridWidth, -1, -1);
+         for(int i = start; i <= end; ++i)
+         {
+            const shapes::Point2D tile = tileNumToCoords(tileNums[i]);
+            bounds.left = std::min(bounds.left, tile.x - 1);
+            bounds.top = std::min(bounds.top, tile.y - 1);
+            bounds.right = std::max(bounds.right, tile.x + 1);
+            bounds.bottom = std::max(bounds.bottom, tile.y + 1);
+         }
+
+         bounds.left = std::max(bounds.left, 0);
+         bounds.top = std::max(bounds.top, 0);
+         bounds.right = std::min(bounds.right, collisionGridWidth - 1);
+         bounds.bottom = std::min(bounds.bottom, collisionGridHeight - 1);
+
+         Path stretch;
+         if(findLocalPath(tileNums[start], tileNums[end], bounds, &stretch) == INFINITY)
+         {
+            smoothedTileNums.insert(smoothedTileNums.end(), tileNums.begin() + start + 1, tileNums.begin() + end + 1);
+         }
+
+         for(Path::const_iterator iter = stretch.begin(); iter != stretch.end(); ++iter)
+         {
+            smoothedTileNums.push_back(pixelsToTileNum(*iter));
+         }
+
+         start = end;
       }
 
-      delete [] distanceMatrix;
-      distanceMatrix = NULL;
+      tileNums.swap(smoothedTileNums);
    }
 
-   if(successorMatrix)
+   path.clear();
+   for(unsigned int i = 1; i < tileNums.size(); ++i)
    {
-      for(int i = 0; i < numTiles; ++i)
+      path.push_back(tileNumToPixels(tileNums[i]));
+   }
+}
+
+float Pathfinder::getStaticDistanceEstimate(int srcTileNum, int dstTileNum) const
+{
+   return std::max(getOctileDistance(srcTileNum, dstTileNum), landmarkTable->getLowerBound(srcTileNum, dstTileNum));
+}
+
+float Pathfinder::findLocalPath(int srcTileNum, int dstTileNum, const shapes::Rectangle& bounds, Path* path)
+{
+   if(srcTileNum == dstTileNum) return 0;
+
+   searchSpace->beginSearch();
+   searchSpace->open(srcTileNum, -1, 0, getStaticDistanceEstimate(srcTileNum, dstTileNum));
+
+   while(!searchSpace->isOpenSetEmpty())
+   {
+      const int currTileNum = searchSpace->popCheapest();
+
+      if(currTileNum == dstTileNum)
       {
-         delete [] successorMatrix[i];
+         if(path != NULL)
+         {
+            Path segment;
+            for(int tileNum = dstTileNum; tileNum != srcTileNum; tileNum = searchSpace->getParent(tileNum))
+            {
+               segment.push_front(tileNumToPixels(tileNum));
+            }
+
+            path->splice(path->end(), segment);
+         }
+
+         return searchSpace->getGCost(dstTileNum);
       }
 
-      delete [] successorMatrix;
-      successorMatrix = NULL;
+      const shapes::Point2D currTile = tileNumToCoords(currTileNum);
+      const float currGCost = searchSpace->getGCost(currTileNum);
+      for(int i = 0; i < NUM_NEIGHBOURS; ++i)
+      {
+         const NeighbourOffset& offset = NEIGHBOUR_OFFSETS[i];
+         const int x = currTile.x + offset.x;
+         const int y = currTile.y + offset.y;
+         if(x < bounds.left || y < bounds.top || x > bounds.right || y > bounds.bottom) continue;
+
+         const int adjacentTileNum = coordsToTileNum(shapes::Point2D(x, y));
+         const float tileGCost = currGCost + (offset.diagonal ? ROOT_2 : 1.0f);
+
+         if(searchSpace->isDiscovered(adjacentTileNum))
+         {
+            searchSpace->decreaseCost(adjacentTileNum, currTileNum, tileGCost);
+         }
+         else if(collisionGrid[y][x].entityType == TileState::OBSTACLE)
+         {
+            // Only static obstacles block the path; entities are routed around when the path is followed.
+            searchSpace->close(adjacentTileNum);
+         }
+         else
+         {
+            searchSpace->open(adjacentTileNum, currTileNum, tileGCost, getStaticDistanceEstimate(adjacentTileNum, dstTileNum));
+         }
+      }
    }
+
+   return INFINITY;
 }
 
 Pathfinder::~Pathfinder()
 {
-   deleteRoyFloydWarshallMatrices();
+   clearPathRequests();
+   clearFlowFields();
+   delete workerPool;
+   delete searchSpace;
+   delete landmarkTable;
+   delete componentMap;
+   delete clusterGraph;
 }
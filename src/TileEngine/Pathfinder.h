@@ -7,17 +7,20 @@
 #ifndef PATHFINDER_H
 #define PATHFINDER_H
 
+#include <cstdlib>
+#include <algorithm>
 #include <list>
+#include <map>
 #include <vector>
+#include "Point2D.h"
 
 class Actor;
-class EntityGrid;
 class Map;
 class Obstacle;
+class PassabilityPyramid;
 
 namespace shapes
 {
-   struct Point2D;
    struct Rectangle;
 };
 
@@ -38,17 +41,174 @@ class Pathfinder
    /** Floating-point notation for infinity. */
    static const float INFINITY;
 
-   /** The Roy-Floyd-Warshall distance matrix. This 2D array holds best-path distances between all tiles. */
-   float** distanceMatrix;
+   /**
+    * A hierarchical abstraction of the collision grid, used to find best paths across large maps.
+    */
+   class ClusterGraph;
+   friend class ClusterGraph;
+
+   /**
+    * The distances from a few landmark tiles to every tile, used to bound the cost of static paths.
+    */
+   class LandmarkTable;
+   friend class LandmarkTable;
+
+   /**
+    * The connected regions of open tiles on the grid, used to turn down queries between tiles that can't reach each other.
+    */
+   class ComponentMap;
+   friend class ComponentMap;
+
+   /**
+    * The reusable node storage and open set for A* searches on the grid.
+    */
+   class SearchSpace;
+
+   /**
+    * A resumable search for a path around obstacles and entities for a single moving entity.
+    */
+   class RerouteSearch;
+   friend class RerouteSearch;
+
+   /**
+    * A plain A* search over the grid for a single moving entity.
+    */
+   class AStarSearch;
+   friend class AStarSearch;
+
+   /**
+    * A Jump Point Search over the grid for a single moving entity.
+    */
+   class JumpPointSearch;
+   friend class JumpPointSearch;
+
+   /**
+    * An immutable copy of the collision grid, read by searches running on worker threads.
+    */
+   class CollisionSnapshot;
+
+   /**
+    * A pool of threads that run rerouting searches away from the main thread.
+    */
+   class WorkerPool;
+   friend class WorkerPool;
+
+   /**
+    * The directions of the best paths from every tile to a single goal.
+    */
+   class FlowField;
+   friend class FlowField;
+
+   /** An offset from a tile to one of its neighbours. */
+   struct NeighbourOffset
+   {
+      /** The horizontal offset (in tiles). */
+      int x;
+
+      /** The vertical offset (in tiles). */
+      int y;
+
+      /** Whether or not the neighbour is diagonally adjacent. */
+      bool diagonal;
+   };
+
+   /** The number of neighbours of each tile. */
+   static const int NUM_NEIGHBOURS = 8;
+
+   /** The offsets to each of the neighbours of a tile, with the lateral neighbours first. */
+   static const NeighbourOffset NEIGHBOUR_OFFSETS[NUM_NEIGHBOURS];
+
+   /** The maximum number of static best paths kept in the path cache. */
+   static const unsigned int PATH_CACHE_CAPACITY;
+
+   /** A (source tile number, destination tile number) pair identifying a cached path. */
+   typedef std::pair<int, int> PathKey;
+
+   /** A path stored in the cache, along with the tiles it connects. */
+   struct CachedPath
+   {
+      /** The source and destination tiles of the path. */
+      PathKey key;
+
+      /** The waypoints of the path (in pixels). */
+      std::list<shapes::Point2D> path;
+
+      /** The cost of the path (in tiles). */
+      float cost;
+   };
+
+   /** The cached static paths, sorted from most recently used to least recently used. */
+   std::list<CachedPath> pathCache;
+
+   /** An index into the path cache, used to find a cached path by its (source, destination) key. */
+   std::map<PathKey, std::list<CachedPath>::iterator> pathCacheIndex;
+
+   /** The number of times a cached path from (and to) each tile has been reused, or NULL if they aren't being counted. */
+   std::vector<unsigned short>* cacheHitHeat;
+
+   /** The maximum number of flow fields kept in the flow field cache. */
+   static const unsigned int FLOW_FIELD_CAPACITY;
+
+   /** A (goal tile number, (footprint width, footprint height)) key identifying a flow field. */
+   typedef std::pair<int, std::pair<int, int> > FlowFieldKey;
+
+   /** A flow field stored in the cache, along with its key. */
+   struct CachedFlowField
+   {
+      /** The goal and footprint of the flow field. */
+      FlowFieldKey key;
+
+      /** The flow field. */
+      FlowField* field;
+   };
+
+   /** The cached flow fields, sorted from most recently used to least recently used. */
+   std::list<CachedFlowField> flowFieldCache;
+
+   /** An index into the flow field cache, used to find a flow field by its key. */
+   std::map<FlowFieldKey, std::list<CachedFlowField>::iterator> flowFieldCacheIndex;
+
+   /** The longest straight run of tiles (in tiles) that a single compacted waypoint may cover. */
+   static const int MAX_WAYPOINT_SPAN;
+
+   /** The maximum number of node expansions spent on path requests in a single frame. */
+   static const int PATH_EXPANSIONS_PER_FRAME;
+
+   /** How far (in tiles) past a pair of neighbouring clusters a direct search between them may look for a way around obstacles. */
+   static const int LOCAL_SEARCH_MARGIN;
+
+   /** The number of steps of a hierarchical path that each of the searches smoothing it covers. */
+   static const int PATH_SMOOTHING_WINDOW;
+
+   /** The cluster abstraction of the grid, used for hierarchical best-path searches. */
+   ClusterGraph* clusterGraph;
+
+   /** The landmark distances used as the heuristic for static path searches. */
+   LandmarkTable* landmarkTable;
+
+   /** The connected regions of the grid, used to reject path queries that can't succeed. */
+   ComponentMap* componentMap;
+
+   /** The node storage shared by every search on the main thread. */
+   SearchSpace* searchSpace;
+
+   /** The workers that run the searches for rerouted path requests. */
+   WorkerPool* workerPool;
+
+   /** The latest snapshot of the collision grid handed to the workers, if any. */
+   CollisionSnapshot* collisionSnapshot;
+
+   /** The version of the collision grid, which changes every time a tile changes. */
+   unsigned int collisionGridVersion;
 
-   /** The Roy-Floyd-Warshall successor matrix. This 2D array holds the best tile to move to, given a source and a destination. */
-   int** successorMatrix;
-   
    /** The size (in pixels) of each tile. */
    int movementTileSize;
    
    /** The grid to compute paths on. */
    TileState** collisionGrid;
+
+   /** A summary of the obstacles on the grid at coarser resolutions, if one is kept alongside the grid. */
+   const PassabilityPyramid* passabilityPyramid;
    
    /** The width (in tiles) of the grid. */
    int collisionGridWidth;
@@ -61,44 +221,132 @@ class Pathfinder
     *
     * @param The tile number when counting the tiles from left to right, then top to bottom.
     */
-   inline shapes::Point2D tileNumToPixels(int tileNum);
+   inline shapes::Point2D tileNumToPixels(int tileNum) const;
    
    /**
     * Convert pixel coordinates into a tile number.
     *
     * @param pixelLocation The coordinates of the location (in pixels)
     */
-   inline int pixelsToTileNum(const shapes::Point2D& pixelLocation);
+   inline int pixelsToTileNum(const shapes::Point2D& pixelLocation) const;
    
    /**
     * Convert a tile number into tile coordinates.
     *
     * @param The tile number when counting the tiles from left to right, then top to bottom.
     */
-   inline shapes::Point2D tileNumToCoords(int tileNum);
+   inline shapes::Point2D tileNumToCoords(int tileNum) const;
    
    /**
     * Convert tile coordinates into a tile number.
     *
     * @param tileLocation The coordinates of the location (in tiles)
     */
-   inline int coordsToTileNum(const shapes::Point2D& tileLocation);
+   inline int coordsToTileNum(const shapes::Point2D& tileLocation) const;
    
-   /** 
-    * Runs the Roy-Floyd-Warshall algorithm on the initialized entity grid
-    * to initialize the distance matrix and the successor matrix.
+   /**
+    * Computes the octile distance between two tiles, which is the cost of the
+    * shortest path between them on an unobstructed 8-connected grid.
+    *
+    * @param srcTileNum The tile number of the first tile.
+    * @param dstTileNum The tile number of the second tile.
+    *
+    * @return The octile distance between the two tiles (in tiles).
+    */
+   inline float getOctileDistance(int srcTileNum, int dstTileNum) const;
+
+   /**
+    * Computes the heuristic used by searches around static obstacles,
+    * which is the tighter of the octile distance and the landmark bound.
+    *
+    * @param srcTileNum The tile number of the first tile.
+    * @param dstTileNum The tile number of the second tile.
+    *
+    * @return A lower bound on the cost of the best static path between the two tiles (in tiles).
+    */
+   float getStaticDistanceEstimate(int srcTileNum, int dstTileNum) const;
+
+   /**
+    * Empties the static path cache.
+    */
+   void clearPathCache();
+
+   /**
+    * Empties the flow field cache.
+    */
+   void clearFlowFields();
+
+   /**
+    * Finds the flow field for a goal and entity footprint, building it if it isn't cached.
+    *
+    * @param goalTileNum The tile number of the goal.
+    * @param footprintWidth The width of the entity footprint (in tiles).
+    * @param footprintHeight The height of the entity footprint (in tiles).
+    *
+    * @return The flow field.
+    */
+   const FlowField& getFlowField(int goalTileNum, int footprintWidth, int footprintHeight);
+
+   /**
+    * Evicts the cached paths that may no longer be the best paths after an area of the grid changed.
+    * Cached paths that provably keep their cost and optimality are left in place.
+    *
+    * @param area The area which changed (with edge coordinates in tiles).
+    * @param areaBlocked true if obstacles were added to the area, false if they were removed.
+    */
+   void repairPathCache(const shapes::Rectangle& area, bool areaBlocked);
+
+   /**
+    * @param srcTileNum The tile number of the source of the path.
+    * @param path The waypoints of the path, with the source tile excluded.
+    *
+    * @return The cost of moving along the path (in tiles).
     */
-   void initRoyFloydWarshallMatrices();
+   float getPathCost(int srcTileNum, const std::list<shapes::Point2D>& path) const;
 
    /**
-    * Clean up the distance and successor matrices.
+    * Finds a lower bound on the cost of any path between two tiles that passes through an area.
+    *
+    * @param srcTileNum The tile number of the source.
+    * @param dstTileNum The tile number of the destination.
+    * @param area The area that the path must pass through (with edge coordinates in tiles).
+    *
+    * @return The smallest octile distance of a route from the source to the destination by way of a tile in the area.
     */
-   void deleteRoyFloydWarshallMatrices();
+   float getDetourLowerBound(int srcTileNum, int dstTileNum, const shapes::Rectangle& area) const;
    
    public:
       /** A set of waypoints to move through in order to go from one point to another. */
       typedef std::list<shapes::Point2D> Path;
 
+      /** A compacted set of waypoints, stored contiguously for the entity following them. */
+      typedef std::vector<shapes::Point2D> WaypointList;
+
+      /** A handle to a path request, used to collect the path once it has been found. */
+      typedef unsigned int PathRequestId;
+
+      /** A handle that doesn't refer to any path request. */
+      static const PathRequestId INVALID_PATH_REQUEST = 0;
+
+      /**
+       * The source of occupancy information for a rerouting search,
+       * either the live entity grid or a snapshot of it.
+       */
+      class OccupancyMap;
+
+      /** The algorithms available for finding rerouted paths around entities. */
+      enum SearchMode
+      {
+         /** Plain A* search, expanding every tile along the way. */
+         A_STAR_SEARCH,
+
+         /**
+          * Jump Point Search, which skips over runs of open tiles on the uniform-cost grid.
+          * This expands far fewer nodes than A* in large open areas.
+          */
+         JUMP_POINT_SEARCH
+      };
+
       /**
        * Constructor.
        */
@@ -108,11 +356,47 @@ class Pathfinder
        * Initializes the pathfinder for the given entity grid.
        *
        * @param grid The entity grid to perform pathfinding computations on.
+       * @param pyramid The passability pyramid kept up to date for the grid, or NULL if there is none.
        * @param tileSize The size (in pixels) of each tile.
        * @param gridWidth The width of the grid.
        * @param gridHeight The height of the grid.
        */
-      void initialize(TileState** grid, int tileSize, int gridWidth, int gridHeight);
+      void initialize(TileState** grid, const PassabilityPyramid* pyramid, int tileSize, int gridWidth, int gridHeight);
+
+      /**
+       * @return The search mode used by pathfinders for maps that don't specify one.
+       */
+      static SearchMode getDefaultSearchMode();
+
+      /**
+       * Sets the search mode used by pathfinders for maps that don't specify one.
+       *
+       * @param mode The new default search mode.
+       */
+      static void setDefaultSearchMode(SearchMode mode);
+
+      /**
+       * Sets the search mode used to find rerouted paths on this grid.
+       *
+       * @param mode The new search mode.
+       */
+      void setSearchMode(SearchMode mode);
+
+      /**
+       * Notifies the pathfinder that tiles on the grid have changed,
+       * so that later rerouted path requests are searched on an up-to-date snapshot.
+       */
+      void markCollisionGridChanged();
+
+      /**
+       * Notifies the pathfinder that the static obstacles on the grid have changed,
+       * so that the affected cached best paths and parts of the cluster abstraction are rebuilt.
+       * Removing obstacles also makes the landmark heuristic stale, and it is rebuilt over the next few calls to processPathRequests.
+       *
+       * @param area The area which changed (with edge coordinates in tiles).
+       * @param areaBlocked true if obstacles were added to the area, false if they were removed from it.
+       */
+      void invalidateStaticPaths(const shapes::Rectangle& area, bool areaBlocked);
       
       /**
        * Finds an ideal path from the source coordinates to the destination.
@@ -128,7 +412,7 @@ class Pathfinder
        * Finds the shortest path from the source coordinates to the destination
        * around all obstacles and entities.
        *
-       * @param entityGrid The entity grid container.
+       * @param occupancy The live occupancy of the grid (usually the entity grid container).
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
        * @param width The width of the moving entity.
@@ -136,7 +420,110 @@ class Pathfinder
        *
        * @return The shortest unobstructed path from the source point to the destination point.
        */
-      Path findReroutedPath(const EntityGrid& entityGrid, const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height);
+      Path findReroutedPath(const OccupancyMap& occupancy, const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height);
+
+      /**
+       * Finds the next waypoint along the flow field towards a goal, for an entity that is
+       * following the field rather than an individual path. Entities heading for the same goal
+       * share a single field, so each step costs a lookup no matter how many entities follow it.
+       * The field only routes around static obstacles; it is up to the entity to wait for other entities to move out of the way.
+       *
+       * @param goal The coordinates of the goal (in pixels).
+       * @param location The current coordinates of the entity (in pixels).
+       * @param width The width of the moving entity.
+       * @param height The height of the moving entity.
+       * @param waypoint Set to the coordinates of the next waypoint (in pixels), if there is one.
+       *
+       * @return true iff there is a next waypoint; false if the entity has reached the goal or cannot reach it.
+       */
+      bool findFlowWaypoint(const shapes::Point2D& goal, const shapes::Point2D& location, int width, int height, shapes::Point2D& waypoint);
+
+      /**
+       * Compacts a path by merging each straight lateral run of waypoints into a single waypoint at the end of the run,
+       * so that an entity can reserve and move through the whole run at once.
+       * Diagonal steps are left alone, since the area swept by a diagonal run isn't a rectangle.
+       *
+       * @param src The coordinates of the start of the path (in pixels).
+       * @param path The waypoints of the path, with the source excluded.
+       *
+       * @return The compacted waypoints, which visit the same tiles as the original path.
+       */
+      WaypointList compactPath(const shapes::Point2D& src, const Path& path) const;
+
+      /**
+       * Queues a request for an ideal path from the source coordinates to the destination.
+       * The path is found during a later call to processPathRequests.
+       *
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       *
+       * @return A handle used to collect the path once it is ready.
+       */
+      PathRequestId requestBestPath(const shapes::Point2D& src, const shapes::Point2D& dst);
+
+      /**
+       * Queues a request for the shortest path from the source coordinates to the destination
+       * around all obstacles and entities. The search runs on a worker thread (or, if there are none,
+       * is spread out over as many calls to processPathRequests as it needs), and routes around
+       * entities based on their locations when the request is dispatched.
+       *
+       * @param occupancy The live occupancy of the grid (usually the entity grid container), which must outlive the request.
+       * @param src The coordinates of the source (in pixels).
+       * @param dst The coordinates of the destination (in pixels).
+       * @param width The width of the moving entity.
+       * @param height The height of the moving entity.
+       *
+       * @return A handle used to collect the path once it is ready.
+       */
+      PathRequestId requestReroutedPath(const OccupancyMap& occupancy, const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height);
+
+      /**
+       * Collects the path for a path request if it is ready.
+       * Once a path has been collected, its handle is no longer valid.
+       *
+       * @param requestId The handle of the path request.
+       * @param path Set to the path found, if the request is complete.
+       *             Requests that were cancelled or are unknown produce an empty path.
+       *
+       * @return true iff the path request is no longer pending.
+       */
+      bool collectPath(PathRequestId requestId, Path& path);
+
+      /**
+       * Cancels a path request. Its handle is no longer valid afterwards.
+       *
+       * @param requestId The handle of the path request.
+       */
+      void cancelPathRequest(PathRequestId requestId);
+
+      /**
+       * Collects the results of finished searches, and then works on the queued path requests
+       * in the order they were made, until they are all dispatched or the per-frame node expansion budget runs out.
+       * This must be called once per frame, before any entities move.
+       */
+      void processPathRequests();
+
+      /**
+       * @return The number of tiles expanded by the searches run on the calling thread since the pathfinder was created.
+       *         Searches run by the worker threads are not counted.
+       */
+      unsigned long getExpansionCount() const;
+
+      /**
+       * @return The number of paths that have been asked for (found straight away or requested) since the pathfinder was created.
+       */
+      unsigned long getQueryCount() const;
+
+      /**
+       * Counts the pathfinder's work on each tile, for drawing over the map while debugging.
+       * The counts stop at the largest value that they can hold.
+       *
+       * @param expansionHeat The list to count the times that each tile is expanded into (indexed by tile number),
+       *                      or NULL to stop counting them. Only the searches run on the calling thread are counted.
+       * @param cacheHitHeat The list to count the times that a cached path is reused into, against its source and destination tiles,
+       *                     or NULL to stop counting them.
+       */
+      void setHeatMaps(std::vector<unsigned short>* expansionHeat, std::vector<unsigned short>* cacheHitHeat);
       
       /**
        * Destructor.
@@ -144,6 +531,86 @@ class Pathfinder
       ~Pathfinder();
 
    private:
+      /** The search mode used by pathfinders for maps that don't specify one. */
+      static SearchMode defaultSearchMode;
+
+      /** The search mode used to find rerouted paths on this grid. */
+      SearchMode searchMode;
+
+      /** A queued request for a path. */
+      struct PathRequest
+      {
+         /** Whether the request is for a rerouted path (true) or a best path (false). */
+         bool rerouted;
+
+         /** The live occupancy of the grid, used to check the destination of rerouted paths. */
+         const OccupancyMap* occupancy;
+
+         /** The coordinates of the source (in pixels). */
+         shapes::Point2D src;
+
+         /** The coordinates of the destination (in pixels). */
+         shapes::Point2D dst;
+
+         /** The width of the moving entity. */
+         int width;
+
+         /** The height of the moving entity. */
+         int height;
+
+         /** Whether or not the path has been found. */
+         bool complete;
+
+         /** The path found, once the request is complete. */
+         Path path;
+      };
+
+      /** The path requests that haven't been collected yet, indexed by their handles. */
+      std::map<PathRequestId, PathRequest> pathRequests;
+
+      /** The handles of the path requests that haven't been dispatched yet, in the order that they were made. */
+      std::list<PathRequestId> pendingRequests;
+
+      /** The handle to give to the next path request. */
+      PathRequestId nextPathRequestId;
+
+      /** The number of paths that have been asked for, found straight away or requested. */
+      unsigned long queryCount;
+
+      /**
+       * Adds a path request to the back of the queue.
+       *
+       * @param request The path request.
+       *
+       * @return The handle of the new request.
+       */
+      PathRequestId queuePathRequest(const PathRequest& request);
+
+      /**
+       * Removes every path request, and discards the searches running for them.
+       */
+      void clearPathRequests();
+
+      /**
+       * Hands a rerouted path request to the workers, along with a snapshot of the collision grid.
+       *
+       * @param requestId The handle of the path request.
+       * @param request The path request.
+       *
+       * @return true iff a search was dispatched; false if the moving entity can't fit at the destination.
+       */
+      bool dispatchReroutedRequest(PathRequestId requestId, const PathRequest& request);
+
+      /**
+       * Stores the paths from the searches that the workers have finished in their requests.
+       */
+      void receiveCompletedSearches();
+
+      /**
+       * @return A snapshot of the current collision grid. The caller must release its reference when done with it.
+       */
+      CollisionSnapshot* getCollisionSnapshot();
+
       /**
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
@@ -153,53 +620,112 @@ class Pathfinder
       Path getStraightPath(const shapes::Point2D& src, const shapes::Point2D& dst);
 
       /**
-       * Uses the successor matrix computed on Pathfinder construction to determine the best path.
-       * This path does not take into account moving entities like Actors or the player, and does not take dynamically added obstacles into account.
+       * Finds the best path between two tiles around static obstacles, using the path cache if possible.
+       * This path does not take into account moving entities like Actors or the player.
        *
        * @param src The coordinates of the source (in pixels).
        * @param dst The coordinates of the destination (in pixels).
        *
-       * @return The best path computed by the Roy-Floyd-Warshall algorithm. 
+       * @return The best path around static obstacles, with the source tile excluded.
        */
-      Path findRFWPath(const shapes::Point2D& src, const shapes::Point2D& dst);
+      Path findCachedPath(const shapes::Point2D& src, const shapes::Point2D& dst);
 
       /**
-       * Uses the A* algorithm to dynamically find the best possible path. Uses the Roy-Floyd-Warshall distance matrix as a heuristic when determining the best path.
-       * This path will route around any dynamically added obstacles or moving entities based on their locations when this function is called.
+       * Finds the best path between two tiles around static obstacles only.
+       * Tiles within the same cluster or neighbouring clusters are connected by a direct A* search;
+       * otherwise, the path is found using the cluster abstraction.
        *
-       * @param entityGrid The entity grid container.
-       * @param src The coordinates of the source (in pixels).
-       * @param dst The coordinates of the destination (in pixels).
-       * @param width The width of the moving entity.
-       * @param height The height of the moving entity.
+       * @param srcTileNum The tile number of the source.
+       * @param dstTileNum The tile number of the destination.
+       *
+       * @return The best path around static obstacles, with the source tile excluded.
+       *         If the destination is unreachable, the path is empty.
+       */
+      Path findStaticPath(int srcTileNum, int dstTileNum);
+
+      /**
+       * Uses hierarchical A* (HPA*) to find a path between two tiles in different clusters.
+       * A path through cluster entrances is found first, and then each step within a cluster is refined locally.
+       *
+       * @param srcTileNum The tile number of the source.
+       * @param dstTileNum The tile number of the destination.
        *
-       * @return The best path computed by the A* algorithm.
+       * @return The refined path around static obstacles, with the source tile excluded.
+       *         If the destination is unreachable, the path is empty.
        */
-      Path findAStarPath(const EntityGrid& entityGrid, const shapes::Point2D& src, const shapes::Point2D& dst, int width, int height);
+      Path findHierarchicalPath(int srcTileNum, int dstTileNum);
 
       /**
-       * A node used in A* search.
+       * Shortens a refined hierarchical path, which bends towards the cluster entrances it was routed through.
+       * Overlapping stretches of the path are searched again within the area around them, and replaced with the best paths found.
+       *
+       * @param srcTileNum The tile number of the source of the path.
+       * @param path The path to smooth, with the source tile excluded.
        */
-      class AStarPoint;
-      
+      void smoothPath(int srcTileNum, Path& path);
+
       /**
-       * Evaluate a group of neighbour nodes in A* search.
-       * Alters costs in the open set if cheaper paths are found,
-       * and adds undiscovered tiles to the open set.
-       *
-       * @param entityGrid The entity grid container.
-       * @param entityState The state of the entity trying to move to the nodes.
-       * @param adjacentNodes The neighbour nodes to evaluate.
-       * @param evaluatedPoint The point that is currently being evaluated.
-       * @param traversalCost The cost to move from evaluatedPoint to any of the adjacent nodes.
-       * @param destinationTileNum The tile number of the goal point.
-       * @param openSet The open set used to accumulate undiscovered points.
-       * @param discovered A mapping from tile numbers to whether or not they have been discovered.
-       * @param width The entity width.
-       * @param height The entity height.
-       * @param diagonalNodes Whether or not the nodes being evaluated are diagonal from the evaluated point.
-       */
-      void evaluateAdjacentNodes(const EntityGrid& entityGrid, const TileState& entityState, const std::vector<shapes::Point2D>& adjacentNodes, const AStarPoint* evaluatedPoint, float traversalCost, int destinationTileNum, std::vector<AStarPoint*>& openSet, std::vector<bool>& discovered, int width, int height, bool diagonalNodes = false);
+       * Uses the A* algorithm to find the best path between two tiles around static obstacles,
+       * without leaving the given bounds.
+       *
+       * @param srcTileNum The tile number of the source.
+       * @param dstTileNum The tile number of the destination.
+       * @param bounds The area that the path must stay within (with edge coordinates in tiles).
+       * @param path If not NULL, the path found is appended to this path, with the source tile excluded.
+       *
+       * @return The cost of the path found, or infinity if the destination cannot be reached within the bounds.
+       */
+      float findLocalPath(int srcTileNum, int dstTileNum, const shapes::Rectangle& bounds, Path* path);
+
+      /**
+       * Creates a search for the shortest path between two tiles around all obstacles and entities.
+       * This may be called from worker threads, so it must not change the state of the pathfinder.
+       *
+       * @param mode The search algorithm to use.
+       * @param space The node storage for the search to use.
+       * @param occupancy The occupancy of the grid to search.
+       * @param entityState The state of the moving entity.
+       * @param width The width of the moving entity.
+       * @param height The height of the moving entity.
+       * @param srcTileNum The tile number of the source.
+       * @param dstTileNum The tile number of the destination.
+       *
+       * @return The new search, which must be deleted by the caller.
+       */
+      RerouteSearch* createReroutedSearch(SearchMode mode, SearchSpace& space, const OccupancyMap& occupancy, const TileState& entityState, int width, int height, int srcTileNum, int dstTileNum);
 };
 
+inline shapes::Point2D Pathfinder::tileNumToCoords(int tileNum) const
+{
+   div_t result = div(tileNum, collisionGridWidth);
+   return shapes::Point2D(result.rem, result.quot);
+}
+
+inline shapes::Point2D Pathfinder::tileNumToPixels(int tileNum) const
+{
+   shapes::Point2D p = tileNumToCoords(tileNum);
+   return p * movementTileSize;
+}
+
+inline int Pathfinder::coordsToTileNum(const shapes::Point2D& tileLocation) const
+{
+   return (tileLocation.y * collisionGridWidth + tileLocation.x);
+}
+
+inline int Pathfinder::pixelsToTileNum(const shapes::Point2D& pixelLocation) const
+{
+   return coordsToTileNum(pixelLocation / movementTileSize);
+}
+
+inline float Pathfinder::getOctileDistance(int srcTileNum, int dstTileNum) const
+{
+   const shapes::Point2D srcTile = tileNumToCoords(srcTileNum);
+   const shapes::Point2D dstTile = tileNumToCoords(dstTileNum);
+
+   const int xDistance = std::abs(srcTile.x - dstTile.x);
+   const int yDistance = std::abs(srcTile.y - dstTile.y);
+
+   return std::max(xDistance, yDistance) + (ROOT_2 - 1.0f) * std::min(xDistance, yDistance);
+}
+
 #endif
@@ -0,0 +1,296 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_ClusterGraph.h"
+#include "Pathfinder_SearchSpace.h"
+#include "TileState.h"
+#include "FrameArena.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PATHFINDER;
+
+// With 16px movement tiles, a cluster covers a 4x4 block of map tiles
+const int Pathfinder::ClusterGraph::CLUSTER_SIZE = 8;
+const int Pathfinder::ClusterGraph::WIDE_ENTRANCE_SIZE = 6;
+
+// Paths across a wide entrance are then never more than a tile out of their way,
+// without multiplying the searches between the entrances of each cluster
+const int Pathfinder::ClusterGraph::WIDE_ENTRANCE_SPACING = 3;
+
+Pathfinder::ClusterGraph::ClusterGraph(Pathfinder& pathfinder) : pathfinder(pathfinder), clustersWide(0), clustersHigh(0)
+{
+}
+
+void Pathfinder::ClusterGraph::initialize()
+{
+   clusters.clear();
+
+   const int gridWidth = pathfinder.collisionGridWidth;
+   const int gridHeight = pathfinder.collisionGridHeight;
+
+   clustersWide = (gridWidth + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+   clustersHigh = (gridHeight + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+   for(int clusterY = 0; clusterY < clustersHigh; ++clusterY)
+   {
+      for(int clusterX = 0; clusterX < clustersWide; ++clusterX)
+      {
+         const int top = clusterY * CLUSTER_SIZE;
+         const int left = clusterX * CLUSTER_SIZE;
+         const int bottom = std::min(top + CLUSTER_SIZE, gridHeight) - 1;
+         const int right = std::min(left + CLUSTER_SIZE, gridWidth) - 1;
+         clusters.push_back(Cluster(shapes::Rectangle(top, left, bottom, right)));
+      }
+   }
+
+   for(int clusterNum = 0; clusterNum < (int)clusters.size(); ++clusterNum)
+   {
+      buildCluster(clusterNum);
+   }
+
+   DEBUG("Built %d pathfinding clusters.", clusters.size());
+}
+
+void Pathfinder::ClusterGraph::rebuild(const shapes::Rectangle& area)
+{
+   if(clusters.empty()) return;
+
+   // Tiles along the edge of the area may be part of an entrance into a neighbouring cluster,
+   // so the area is widened by a tile on each side before finding the affected clusters.
+   const int left = std::max(area.left - 1, 0) / CLUSTER_SIZE;
+   const int right = std::min(area.right + 1, pathfinder.collisionGridWidth - 1) / CLUSTER_SIZE;
+   const int top = std::max(area.top - 1, 0) / CLUSTER_SIZE;
+   const int bottom = std::min(area.bottom + 1, pathfinder.collisionGridHeight - 1) / CLUSTER_SIZE;
+
+   for(int clusterY = top; clusterY <= bottom; ++clusterY)
+   {
+      for(int clusterX = left; clusterX <= right; ++clusterX)
+      {
+         DEBUG("Rebuilding pathfinding cluster %d,%d", clusterX, clusterY);
+         buildCluster(clusterY * clustersWide + clusterX);
+      }
+   }
+}
+
+void Pathfinder::ClusterGraph::buildCluster(int clusterNum)
+{
+   Cluster& cluster = clusters[clusterNum];
+   cluster.nodes.clear();
+
+   const int clusterX = clusterNum % clustersWide;
+   const int clusterY = clusterNum / clustersWide;
+   const shapes::Rectangle& bounds = cluster.bounds;
+   const int width = bounds.right - bounds.left + 1;
+   const int height = bounds.bottom - bounds.top + 1;
+
+   if(clusterX > 0)
+   {
+      addTransitions(cluster, shapes::Point2D(bounds.left, bounds.top), shapes::Point2D(0, 1), shapes::Point2D(-1, 0), height);
+   }
+
+   if(clusterX < clustersWide - 1)
+   {
+      addTransitions(cluster, shapes::Point2D(bounds.right, bounds.top), shapes::Point2D(0, 1), shapes::Point2D(1, 0), height);
+   }
+
+   if(clusterY > 0)
+   {
+      addTransitions(cluster, shapes::Point2D(bounds.left, bounds.top), shapes::Point2D(1, 0), shapes::Point2D(0, -1), width);
+   }
+
+   if(clusterY < clustersHigh - 1)
+   {
+      addTransitions(cluster, shapes::Point2D(bounds.left, bounds.bottom), shapes::Point2D(1, 0), shapes::Point2D(0, 1), width);
+   }
+
+   // Connect every pair of entrances that can reach one another without leaving the cluster
+   std::vector<int> entrances;
+   for(NodeList::const_iterator iter = cluster.nodes.begin(); iter != cluster.nodes.end(); ++iter)
+   {
+      entrances.push_back(iter->first);
+   }
+
+   for(unsigned int i = 0; i < entrances.size(); ++i)
+   {
+      for(unsigned int j = i + 1; j < entrances.size(); ++j)
+      {
+         const float cost = pathfinder.findLocalPath(entrances[i], entrances[j], bounds, NULL);
+         if(cost != Pathfinder::INFINITY)
+         {
+            cluster.nodes[entrances[i]].push_back(Edge(entrances[j], cost));
+            cluster.nodes[entrances[j]].push_back(Edge(entrances[i], cost));
+         }
+      }
+   }
+}
+
+void Pathfinder::ClusterGraph::addTransitions(Cluster& cluster, const shapes::Point2D& start, const shapes::Point2D& step, const shapes::Point2D& crossing, int length)
+{
+   // Find each run of border tiles that are open on both sides of the border.
+   // Narrow runs get a single transition in the middle, and wide runs get one at each end and every few tiles in between.
+   // Both clusters sharing a border scan it in the same order, so their transitions always match up.
+   int runStart = -1;
+   for(int i = 0; i <= length; ++i)
+   {
+      bool open = false;
+      if(i < length)
+      {
+         const shapes::Point2D tile(start.x + step.x * i, start.y + step.y * i);
+         const shapes::Point2D neighbourTile(tile.x + crossing.x, tile.y + crossing.y);
+         open = !isObstacle(pathfinder.coordsToTileNum(tile)) && !isObstacle(pathfinder.coordsToTileNum(neighbourTile));
+      }
+
+      if(open && runStart < 0)
+      {
+         runStart = i;
+      }
+      else if(!open && runStart >= 0)
+      {
+         const int runLength = i - runStart;
+         std::vector<int> transitions;
+         if(runLength >= WIDE_ENTRANCE_SIZE)
+         {
+            for(int transition = runStart; transition < i - 1; transition += WIDE_ENTRANCE_SPACING)
+            {
+               transitions.push_back(transition);
+            }
+
+            transitions.push_back(i - 1);
+         }
+         else
+         {
+            transitions.push_back(runStart + runLength / 2);
+         }
+
+         for(std::vector<int>::const_iterator iter = transitions.begin(); iter != transitions.end(); ++iter)
+         {
+            const shapes::Point2D tile(start.x + step.x * *iter, start.y + step.y * *iter);
+            addTransition(cluster, tile, shapes::Point2D(tile.x + crossing.x, tile.y + crossing.y));
+         }
+
+         runStart = -1;
+      }
+   }
+}
+
+void Pathfinder::ClusterGraph::addTransition(Cluster& cluster, const shapes::Point2D& tile, const shapes::Point2D& neighbourTile)
+{
+   cluster.nodes[pathfinder.coordsToTileNum(tile)].push_back(Edge(pathfinder.coordsToTileNum(neighbourTile), 1.0f));
+}
+
+bool Pathfinder::ClusterGraph::isObstacle(int tileNum) const
+{
+   const shapes::Point2D tile = pathfinder.tileNumToCoords(tileNum);
+   return pathfinder.collisionGrid[tile.y][tile.x].entityType == TileState::OBSTACLE;
+}
+
+int Pathfinder::ClusterGraph::getClusterNum(int tileNum) const
+{
+   const shapes::Point2D tile = pathfinder.tileNumToCoords(tileNum);
+   return (tile.y / CLUSTER_SIZE) * clustersWide + (tile.x / CLUSTER_SIZE);
+}
+
+const shapes::Rectangle& Pathfinder::ClusterGraph::getClusterBounds(int clusterNum) const
+{
+   return clusters[clusterNum].bounds;
+}
+
+bool Pathfinder::ClusterGraph::areClustersAdjacent(int firstClusterNum, int secondClusterNum) const
+{
+   const int xDistance = abs(firstClusterNum % clustersWide - secondClusterNum % clustersWide);
+   const int yDistance = abs(firstClusterNum / clustersWide - secondClusterNum / clustersWide);
+   return xDistance <= 1 && yDistance <= 1;
+}
+
+bool Pathfinder::ClusterGraph::findAbstractPath(int srcTileNum, int dstTileNum, std::vector<int>& abstractPath) const
+{
+   const Cluster& srcCluster = clusters[getClusterNum(srcTileNum)];
+   const Cluster& dstCluster = clusters[getClusterNum(dstTileNum)];
+
+   // The edges and costs of the abstract search only last as long as the search, so they are kept in the frame arena
+   typedef std::vector<Edge, FrameAllocator<Edge> > FrameEdgeList;
+   typedef std::map<int, float, std::less<int>, FrameAllocator<std::pair<const int, float> > > FrameCostMap;
+
+   // Temporarily connect the source and destination to the entrances of their clusters
+   FrameEdgeList srcEdges;
+   for(NodeList::const_iterator iter = srcCluster.nodes.begin(); iter != srcCluster.nodes.end(); ++iter)
+   {
+      const float cost = pathfinder.findLocalPath(srcTileNum, iter->first, srcCluster.bounds, NULL);
+      if(cost != Pathfinder::INFINITY)
+      {
+         srcEdges.push_back(Edge(iter->first, cost));
+      }
+   }
+
+   FrameCostMap dstCosts;
+   for(NodeList::const_iterator iter = dstCluster.nodes.begin(); iter != dstCluster.nodes.end(); ++iter)
+   {
+      const float cost = pathfinder.findLocalPath(iter->first, dstTileNum, dstCluster.bounds, NULL);
+      if(cost != Pathfinder::INFINITY)
+      {
+         dstCosts[iter->first] = cost;
+      }
+   }
+
+   if(srcEdges.empty() || dstCosts.empty()) return false;
+
+   // Entrance nodes are identified by their tile numbers, so the abstract search can share the grid's search space
+   SearchSpace& searchSpace = *pathfinder.searchSpace;
+   searchSpace.beginSearch();
+   searchSpace.open(srcTileNum, -1, 0, pathfinder.getStaticDistanceEstimate(srcTileNum, dstTileNum));
+
+   FrameEdgeList edges;
+   while(!searchSpace.isOpenSetEmpty())
+   {
+      const int currTileNum = searchSpace.popCheapest();
+
+      if(currTileNum == dstTileNum)
+      {
+         for(int tileNum = dstTileNum; tileNum != -1; tileNum = searchSpace.getParent(tileNum))
+         {
+            abstractPath.push_back(tileNum);
+         }
+
+         std::reverse(abstractPath.begin(), abstractPath.end());
+         return true;
+      }
+
+      edges.clear();
+      if(currTileNum == srcTileNum)
+      {
+         edges = srcEdges;
+      }
+
+      const NodeList& clusterNodes = clusters[getClusterNum(currTileNum)].nodes;
+      NodeList::const_iterator node = clusterNodes.find(currTileNum);
+      if(node != clusterNodes.end())
+      {
+         edges.insert(edges.end(), node->second.begin(), node->second.end());
+      }
+
+      FrameCostMap::const_iterator dstCost = dstCosts.find(currTileNum);
+      if(dstCost != dstCosts.end())
+      {
+         edges.push_back(Edge(dstTileNum, dstCost->second));
+      }
+
+      const float currGCost = searchSpace.getGCost(currTileNum);
+      for(FrameEdgeList::const_iterator iter = edges.begin(); iter != edges.end(); ++iter)
+      {
+         const float tileGCost = currGCost + iter->cost;
+         if(searchSpace.isDiscovered(iter->dstTileNum))
+         {
+            searchSpace.decreaseCost(iter->dstTileNum, currTileNum, tileGCost);
+         }
+         else
+         {
+            searchSpace.open(iter->dstTileNum, currTileNum, tileGCost, pathfinder.getStaticDistanceEstimate(iter->dstTileNum, dstTileNum));
+         }
+      }
+   }
+
+   return false;
+}
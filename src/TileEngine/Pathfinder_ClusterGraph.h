@@ -0,0 +1,160 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_CLUSTER_GRAPH_H
+#define PATHFINDER_CLUSTER_GRAPH_H
+
+#include "Pathfinder.h"
+#include "Rectangle.h"
+
+/**
+ * The ClusterGraph divides the collision grid into square clusters of tiles and finds the entrances
+ * between neighbouring clusters. Each entrance tile becomes a node in an abstract graph, with edges
+ * to the entrances of the neighbouring cluster and to every other entrance reachable within its own cluster.
+ *
+ * Searching this much smaller graph first lets the Pathfinder cross a large map
+ * without expanding every tile along the way (HPA*).
+ */
+class Pathfinder::ClusterGraph
+{
+   /** The width and height (in tiles) of each cluster. */
+   static const int CLUSTER_SIZE;
+
+   /** Entrances at least this wide get a transition at each end and along the way, instead of a single transition in the middle. */
+   static const int WIDE_ENTRANCE_SIZE;
+
+   /** The distance (in tiles) between the transitions along a wide entrance. */
+   static const int WIDE_ENTRANCE_SPACING;
+
+   /** An edge in the abstract graph. */
+   struct Edge
+   {
+      /** The tile number that the edge leads to. */
+      int dstTileNum;
+
+      /** The cost of moving along this edge. */
+      float cost;
+
+      Edge(int dstTileNum, float cost) : dstTileNum(dstTileNum), cost(cost) {}
+   };
+
+   /** A mapping from the tile numbers of entrance nodes to their outgoing edges. */
+   typedef std::map<int, std::vector<Edge> > NodeList;
+
+   /** A square area of the grid and the entrance nodes within it. */
+   struct Cluster
+   {
+      /** The tiles covered by the cluster (with edge coordinates in tiles). */
+      shapes::Rectangle bounds;
+
+      /** The entrance nodes of the cluster. */
+      NodeList nodes;
+
+      Cluster(const shapes::Rectangle& bounds) : bounds(bounds) {}
+   };
+
+   /** The pathfinder that owns this graph. */
+   Pathfinder& pathfinder;
+
+   /** The number of clusters across the width of the grid. */
+   int clustersWide;
+
+   /** The number of clusters across the height of the grid. */
+   int clustersHigh;
+
+   /** The clusters, counted from left to right, then top to bottom. */
+   std::vector<Cluster> clusters;
+
+   /**
+    * Recomputes the entrances and edges of a single cluster.
+    *
+    * @param clusterNum The number of the cluster to rebuild.
+    */
+   void buildCluster(int clusterNum);
+
+   /**
+    * Adds the transitions between a cluster and one of its neighbours to the cluster's nodes.
+    *
+    * @param cluster The cluster to add transitions to.
+    * @param start The first tile of the cluster's border with the neighbour (in tiles).
+    * @param step The offset between consecutive tiles along the border (in tiles).
+    * @param crossing The offset from a border tile to the matching tile across the border (in tiles).
+    * @param length The length of the border (in tiles).
+    */
+   void addTransitions(Cluster& cluster, const shapes::Point2D& start, const shapes::Point2D& step, const shapes::Point2D& crossing, int length);
+
+   /**
+    * Adds a transition between a tile of a cluster and the matching tile across its border.
+    *
+    * @param cluster The cluster to add the transition to.
+    * @param tile The entrance tile within the cluster (in tiles).
+    * @param neighbourTile The entrance tile across the cluster border (in tiles).
+    */
+   void addTransition(Cluster& cluster, const shapes::Point2D& tile, const shapes::Point2D& neighbourTile);
+
+   /**
+    * @param tileNum The tile number to check.
+    *
+    * @return true iff the tile is blocked by a static obstacle.
+    */
+   bool isObstacle(int tileNum) const;
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param pathfinder The pathfinder that owns this graph.
+       */
+      ClusterGraph(Pathfinder& pathfinder);
+
+      /**
+       * Builds all the clusters for the pathfinder's current grid.
+       */
+      void initialize();
+
+      /**
+       * Rebuilds the clusters touching a changed area of the grid.
+       * The clusters across the borders of the area are also rebuilt, since their entrances may have changed.
+       *
+       * @param area The area which changed (with edge coordinates in tiles).
+       */
+      void rebuild(const shapes::Rectangle& area);
+
+      /**
+       * @param tileNum A tile number.
+       *
+       * @return The number of the cluster containing the tile.
+       */
+      int getClusterNum(int tileNum) const;
+
+      /**
+       * @param clusterNum A cluster number.
+       *
+       * @return The tiles covered by the cluster (with edge coordinates in tiles).
+       */
+      const shapes::Rectangle& getClusterBounds(int clusterNum) const;
+
+      /**
+       * @param firstClusterNum A cluster number.
+       * @param secondClusterNum Another cluster number.
+       *
+       * @return true iff the clusters are the same, or touch along a side or at a corner.
+       */
+      bool areClustersAdjacent(int firstClusterNum, int secondClusterNum) const;
+
+      /**
+       * Finds the sequence of entrance nodes to travel through in order to get from one tile to another.
+       *
+       * @param srcTileNum The tile number of the source.
+       * @param dstTileNum The tile number of the destination.
+       * @param abstractPath Filled with the tile numbers along the abstract path, starting with the source and ending with the destination.
+       *
+       * @return true iff an abstract path was found.
+       */
+      bool findAbstractPath(int srcTileNum, int dstTileNum, std::vector<int>& abstractPath) const;
+};
+
+#endif
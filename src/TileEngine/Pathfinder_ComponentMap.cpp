@@ -0,0 +1,99 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_ComponentMap.h"
+#include "Rectangle.h"
+#include "TileState.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PATHFINDER;
+
+const int Pathfinder::ComponentMap::NO_COMPONENT = -1;
+
+Pathfinder::ComponentMap::ComponentMap(Pathfinder& pathfinder) : pathfinder(pathfinder), nextLabel(0)
+{
+}
+
+void Pathfinder::ComponentMap::labelComponent(int srcTileNum, int firstLabel, std::vector<int>& pendingTiles)
+{
+   const int label = nextLabel++;
+   labels[srcTileNum] = label;
+   pendingTiles.push_back(srcTileNum);
+
+   while(!pendingTiles.empty())
+   {
+      const shapes::Point2D currTile = pathfinder.tileNumToCoords(pendingTiles.back());
+      pendingTiles.pop_back();
+
+      for(int i = 0; i < NUM_NEIGHBOURS; ++i)
+      {
+         const int x = currTile.x + NEIGHBOUR_OFFSETS[i].x;
+         const int y = currTile.y + NEIGHBOUR_OFFSETS[i].y;
+         if(x < 0 || y < 0 || x >= pathfinder.collisionGridWidth || y >= pathfinder.collisionGridHeight) continue;
+         if(pathfinder.collisionGrid[y][x].entityType == TileState::OBSTACLE) continue;
+
+         const int adjacentTileNum = pathfinder.coordsToTileNum(shapes::Point2D(x, y));
+         if(labels[adjacentTileNum] >= firstLabel) continue;
+
+         labels[adjacentTileNum] = label;
+         pendingTiles.push_back(adjacentTileNum);
+      }
+   }
+}
+
+void Pathfinder::ComponentMap::build()
+{
+   const int numTiles = pathfinder.collisionGridWidth * pathfinder.collisionGridHeight;
+   labels.assign(numTiles, NO_COMPONENT);
+   nextLabel = 0;
+
+   std::vector<int> pendingTiles;
+   for(int tileNum = 0; tileNum < numTiles; ++tileNum)
+   {
+      const shapes::Point2D tile = pathfinder.tileNumToCoords(tileNum);
+      if(labels[tileNum] == NO_COMPONENT && pathfinder.collisionGrid[tile.y][tile.x].entityType != TileState::OBSTACLE)
+      {
+         labelComponent(tileNum, 0, pendingTiles);
+      }
+   }
+
+   DEBUG("Found %d connected regions on the grid", nextLabel);
+}
+
+void Pathfinder::ComponentMap::update(const shapes::Rectangle& area)
+{
+   // Any region split or joined by the change touches the area or the ring of tiles around it
+   const int left = std::max(area.left - 1, 0);
+   const int top = std::max(area.top - 1, 0);
+   const int right = std::min(area.right + 1, pathfinder.collisionGridWidth - 1);
+   const int bottom = std::min(area.bottom + 1, pathfinder.collisionGridHeight - 1);
+
+   const int firstLabel = nextLabel;
+   std::vector<int> pendingTiles;
+   for(int y = top; y <= bottom; ++y)
+   {
+      for(int x = left; x <= right; ++x)
+      {
+         const int tileNum = pathfinder.coordsToTileNum(shapes::Point2D(x, y));
+         if(pathfinder.collisionGrid[y][x].entityType == TileState::OBSTACLE)
+         {
+            labels[tileNum] = NO_COMPONENT;
+         }
+         else if(labels[tileNum] < firstLabel)
+         {
+            labelComponent(tileNum, firstLabel, pendingTiles);
+         }
+      }
+   }
+
+   DEBUG("Relabelled %d connected regions around tiles %d,%d to %d,%d", nextLabel - firstLabel, area.left, area.top, area.right, area.bottom);
+}
+
+bool Pathfinder::ComponentMap::isConnected(int srcTileNum, int dstTileNum) const
+{
+   return labels[srcTileNum] != NO_COMPONENT && labels[srcTileNum] == labels[dstTileNum];
+}
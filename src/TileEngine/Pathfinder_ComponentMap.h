@@ -0,0 +1,72 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_COMPONENT_MAP_H
+#define PATHFINDER_COMPONENT_MAP_H
+
+#include "Pathfinder.h"
+
+/**
+ * The ComponentMap labels every open tile on the grid with the connected region of open tiles
+ * that it belongs to, so that a path query between two regions can be turned down at once,
+ * instead of searching every tile that the source can reach before giving up.
+ *
+ * Regions are connected the same way that static paths are, through any of a tile's eight
+ * neighbours. Rerouted paths can't cut past the corners of obstacles, so tiles in the same region
+ * may still be unreachable from each other for them, but tiles in different regions never are.
+ */
+class Pathfinder::ComponentMap
+{
+   /** The label of tiles that belong to no region (obstacles). */
+   static const int NO_COMPONENT;
+
+   /** The pathfinder whose grid the map covers. */
+   Pathfinder& pathfinder;
+
+   /** The region label of each tile, indexed by tile number. */
+   std::vector<int> labels;
+
+   /** The next unused region label. Labels are never reused, so each relabelled region gets a fresh one. */
+   int nextLabel;
+
+   /**
+    * Gives a fresh label to every open tile that can be reached from the given tile.
+    * Tiles that were already given a label at least as new as firstLabel are not revisited.
+    *
+    * @param srcTileNum The tile number of the tile to start from.
+    * @param firstLabel The first label handed out in the current labelling pass.
+    * @param pendingTiles Scratch storage used for the flood fill.
+    */
+   void labelComponent(int srcTileNum, int firstLabel, std::vector<int>& pendingTiles);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param pathfinder The pathfinder whose grid the map covers.
+       */
+      ComponentMap(Pathfinder& pathfinder);
+
+      /**
+       * Labels every region of the pathfinder's current grid.
+       */
+      void build();
+
+      /**
+       * Relabels the regions touching an area of the grid after it has been blocked or cleared.
+       * Only the regions adjacent to the area are visited, since no other region can be split or joined by the change.
+       *
+       * @param area The area that changed (with edge coordinates in tiles).
+       */
+      void update(const shapes::Rectangle& area);
+
+      /**
+       * @return true iff both tiles are open and belong to the same region.
+       */
+      bool isConnected(int srcTileNum, int dstTileNum) const;
+};
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_FlowField.h"
+#include "Pathfinder_SearchSpace.h"
+#include "TileState.h"
+#include "PassabilityPyramid.h"
+#include "Rectangle.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PATHFINDER;
+
+const unsigned char Pathfinder::FlowField::NO_DIRECTION = 0xFF;
+
+Pathfinder::FlowField::FlowField(Pathfinder& pathfinder, int goalTileNum, int footprintWidth, int footprintHeight)
+: goalTileNum(goalTileNum), footprintWidth(footprintWidth), footprintHeight(footprintHeight)
+{
+   directions.assign(pathfinder.collisionGridWidth * pathfinder.collisionGridHeight, NO_DIRECTION);
+   build(pathfinder);
+}
+
+bool Pathfinder::FlowField::isPassable(const Pathfinder& pathfinder, int x, int y) const
+{
+   if(x < 0 || y < 0 || x + footprintWidth > pathfinder.collisionGridWidth || y + footprintHeight > pathfinder.collisionGridHeight)
+   {
+      return false;
+   }
+
+   if(pathfinder.passabilityPyramid != NULL)
+   {
+      return !pathfinder.passabilityPyramid->containsObstacle(shapes::Rectangle(y, x, y + footprintHeight - 1, x + footprintWidth - 1));
+   }
+
+   for(int footprintY = y; footprintY < y + footprintHeight; ++footprintY)
+   {
+      for(int footprintX = x; footprintX < x + footprintWidth; ++footprintX)
+      {
+         if(pathfinder.collisionGrid[footprintY][footprintX].entityType == TileState::OBSTACLE)
+         {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+void Pathfinder::FlowField::build(Pathfinder& pathfinder)
+{
+   const shapes::Point2D goalTile = pathfinder.tileNumToCoords(goalTileNum);
+   if(!isPassable(pathfinder, goalTile.x, goalTile.y))
+   {
+      DEBUG("Flow field goal tile %d is blocked.", goalTileNum);
+      return;
+   }
+
+   // Moves cost the same in both directions, so searching outwards from the goal
+   // finds the best path from every tile to the goal at once.
+   SearchSpace& searchSpace = *pathfinder.searchSpace;
+   searchSpace.beginSearch();
+   searchSpace.open(goalTileNum, -1, 0, 0);
+
+   while(!searchSpace.isOpenSetEmpty())
+   {
+      const int currTileNum = searchSpace.popCheapest();
+      const shapes::Point2D currTile = pathfinder.tileNumToCoords(currTileNum);
+      const float currGCost = searchSpace.getGCost(currTileNum);
+
+      for(int i = 0; i < NUM_NEIGHBOURS; ++i)
+      {
+         const NeighbourOffset& offset = NEIGHBOUR_OFFSETS[i];
+         const int x = currTile.x + offset.x;
+         const int y = currTile.y + offset.y;
+         if(x < 0 || y < 0 || x >= pathfinder.collisionGridWidth || y >= pathfinder.collisionGridHeight) continue;
+
+         const int adjacentTileNum = pathfinder.coordsToTileNum(shapes::Point2D(x, y));
+         if(searchSpace.isClosed(adjacentTileNum)) continue;
+
+         // Entities following the field can't cut past the corner of an obstacle
+         if(offset.diagonal && (!isPassable(pathfinder, currTile.x, y) || !isPassable(pathfinder, x, currTile.y))) continue;
+
+         const float tileGCost = currGCost + (offset.diagonal ? ROOT_2 : 1.0f);
+         if(searchSpace.isDiscovered(adjacentTileNum))
+         {
+            searchSpace.decreaseCost(adjacentTileNum, currTileNum, tileGCost);
+         }
+         else if(isPassable(pathfinder, x, y))
+         {
+            searchSpace.open(adjacentTileNum, currTileNum, tileGCost, 0);
+         }
+         else
+         {
+            searchSpace.close(adjacentTileNum);
+         }
+      }
+   }
+
+   // Every tile reached by the search steps towards the tile that it was reached from
+   const int numTiles = directions.size();
+   for(int tileNum = 0; tileNum < numTiles; ++tileNum)
+   {
+      if(!searchSpace.isDiscovered(tileNum)) continue;
+
+      const int parentTileNum = searchSpace.getParent(tileNum);
+      if(parentTileNum == -1) continue;
+
+      const shapes::Point2D tile = pathfinder.tileNumToCoords(tileNum);
+      const shapes::Point2D parentTile = pathfinder.tileNumToCoords(parentTileNum);
+      for(int i = 0; i < NUM_NEIGHBOURS; ++i)
+      {
+         if(tile.x + NEIGHBOUR_OFFSETS[i].x == parentTile.x && tile.y + NEIGHBOUR_OFFSETS[i].y == parentTile.y)
+         {
+            directions[tileNum] = i;
+            break;
+         }
+      }
+   }
+
+   DEBUG("Built flow field for goal tile %d", goalTileNum);
+}
+
+const Pathfinder::NeighbourOffset* Pathfinder::FlowField::getNextStep(int tileNum) const
+{
+   const unsigned char direction = directions[tileNum];
+   return direction == NO_DIRECTION ? NULL : &NEIGHBOUR_OFFSETS[direction];
+}
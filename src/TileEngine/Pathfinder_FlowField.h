@@ -0,0 +1,67 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_FLOW_FIELD_H
+#define PATHFINDER_FLOW_FIELD_H
+
+#include "Pathfinder.h"
+
+/**
+ * A flow field stores, for every tile on the grid, the direction of the first step
+ * along the best path from that tile to a single goal tile, around static obstacles.
+ * It is built once with a Dijkstra search outwards from the goal, after which any number
+ * of entities heading to the same goal can look up their next step in constant time.
+ *
+ * Fields are built for a particular entity footprint, so that every step leads to a tile
+ * where the entity's entire area fits between obstacles.
+ */
+class Pathfinder::FlowField
+{
+   /** The direction stored for tiles that have no next step (the goal itself, or unreachable tiles). */
+   static const unsigned char NO_DIRECTION;
+
+   /** The tile number of the goal. */
+   const int goalTileNum;
+
+   /** The width of the entity footprint (in tiles). */
+   const int footprintWidth;
+
+   /** The height of the entity footprint (in tiles). */
+   const int footprintHeight;
+
+   /** The index into NEIGHBOUR_OFFSETS of the next step from each tile, or NO_DIRECTION. */
+   std::vector<unsigned char> directions;
+
+   /**
+    * @return true iff an entity with the field's footprint fits on the grid at the given tile without overlapping a static obstacle.
+    */
+   bool isPassable(const Pathfinder& pathfinder, int x, int y) const;
+
+   /**
+    * Runs the Dijkstra search from the goal to fill in the directions for every tile.
+    */
+   void build(Pathfinder& pathfinder);
+
+   public:
+      /**
+       * Constructor. Builds the field for the given goal and footprint.
+       *
+       * @param pathfinder The pathfinder whose grid the field covers.
+       * @param goalTileNum The tile number of the goal.
+       * @param footprintWidth The width of the entity footprint (in tiles).
+       * @param footprintHeight The height of the entity footprint (in tiles).
+       */
+      FlowField(Pathfinder& pathfinder, int goalTileNum, int footprintWidth, int footprintHeight);
+
+      /**
+       * @param tileNum The tile number of the tile to step from.
+       *
+       * @return The offset of the next step towards the goal, or NULL if the tile is the goal or cannot reach it.
+       */
+      const NeighbourOffset* getNextStep(int tileNum) const;
+};
+
+#endif
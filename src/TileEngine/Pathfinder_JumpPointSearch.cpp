@@ -0,0 +1,177 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_JumpPointSearch.h"
+#include "Pathfinder_SearchSpace.h"
+#include "Pathfinder_OccupancyMap.h"
+#include "TileState.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PATHFINDER;
+
+Pathfinder::JumpPointSearch::JumpPointSearch(Pathfinder& pathfinder, SearchSpace& searchSpace, const OccupancyMap& occupancyMap, const TileState& entityState, int width, int height, int srcTileNum, int dstTileNum)
+: RerouteSearch(pathfinder, searchSpace, occupancyMap, entityState, width, height, srcTileNum, dstTileNum), dstTile(pathfinder.tileNumToCoords(dstTileNum))
+{
+}
+
+int Pathfinder::JumpPointSearch::jump(int x, int y, int xDirection, int yDirection) const
+{
+   for(;;)
+   {
+      if(!canOccupy(x, y))
+      {
+         return -1;
+      }
+
+      if(x == dstTile.x && y == dstTile.y)
+      {
+         return pathfinder.coordsToTileNum(dstTile);
+      }
+
+      if(xDirection != 0 && yDirection != 0)
+      {
+         // A diagonal run stops wherever a straight run branching off of it would find a jump point
+         if(jump(x + xDirection, y, xDirection, 0) != -1 || jump(x, y + yDirection, 0, yDirection) != -1)
+         {
+            return pathfinder.coordsToTileNum(shapes::Point2D(x, y));
+         }
+
+         // Diagonal moves can't cut past the corner of a blocked tile
+         if(!canOccupy(x + xDirection, y) || !canOccupy(x, y + yDirection))
+         {
+            return -1;
+         }
+      }
+      else if(xDirection != 0)
+      {
+         // A horizontal run stops where a tile above or below opens up after being blocked
+         if((canOccupy(x, y - 1) && !canOccupy(x - xDirection, y - 1))
+            || (canOccupy(x, y + 1) && !canOccupy(x - xDirection, y + 1)))
+         {
+            return pathfinder.coordsToTileNum(shapes::Point2D(x, y));
+         }
+      }
+      else
+      {
+         // A vertical run stops where a tile to the left or right opens up after being blocked
+         if((canOccupy(x - 1, y) && !canOccupy(x - 1, y - yDirection))
+            || (canOccupy(x + 1, y) && !canOccupy(x + 1, y - yDirection)))
+         {
+            return pathfinder.coordsToTileNum(shapes::Point2D(x, y));
+         }
+      }
+
+      x += xDirection;
+      y += yDirection;
+   }
+}
+
+int Pathfinder::JumpPointSearch::findSuccessorDirections(const shapes::Point2D& tile, const shapes::Point2D& parentTile, bool hasParent, shapes::Point2D directions[NUM_NEIGHBOURS]) const
+{
+   int numDirections = 0;
+
+   if(!hasParent)
+   {
+      // The source tile searches in every direction
+      for(int i = 0; i < NUM_NEIGHBOURS; ++i)
+      {
+         directions[numDirections++] = shapes::Point2D(NEIGHBOUR_OFFSETS[i].x, NEIGHBOUR_OFFSETS[i].y);
+      }
+
+      return numDirections;
+   }
+
+   const int xDirection = (tile.x > parentTile.x) - (tile.x < parentTile.x);
+   const int yDirection = (tile.y > parentTile.y) - (tile.y < parentTile.y);
+   const int x = tile.x;
+   const int y = tile.y;
+
+   if(xDirection != 0 && yDirection != 0)
+   {
+      const bool verticalWalkable = canOccupy(x, y + yDirection);
+      const bool horizontalWalkable = canOccupy(x + xDirection, y);
+
+      if(verticalWalkable) directions[numDirections++] = shapes::Point2D(0, yDirection);
+      if(horizontalWalkable) directions[numDirections++] = shapes::Point2D(xDirection, 0);
+      if(verticalWalkable && horizontalWalkable) directions[numDirections++] = shapes::Point2D(xDirection, yDirection);
+   }
+   else if(xDirection != 0)
+   {
+      const bool nextWalkable = canOccupy(x + xDirection, y);
+      const bool topWalkable = canOccupy(x, y - 1);
+      const bool bottomWalkable = canOccupy(x, y + 1);
+
+      if(nextWalkable)
+      {
+         directions[numDirections++] = shapes::Point2D(xDirection, 0);
+         if(topWalkable) directions[numDirections++] = shapes::Point2D(xDirection, -1);
+         if(bottomWalkable) directions[numDirections++] = shapes::Point2D(xDirection, 1);
+      }
+
+      if(topWalkable) directions[numDirections++] = shapes::Point2D(0, -1);
+      if(bottomWalkable) directions[numDirections++] = shapes::Point2D(0, 1);
+   }
+   else
+   {
+      const bool nextWalkable = canOccupy(x, y + yDirection);
+      const bool leftWalkable = canOccupy(x - 1, y);
+      const bool rightWalkable = canOccupy(x + 1, y);
+
+      if(nextWalkable)
+      {
+         directions[numDirections++] = shapes::Point2D(0, yDirection);
+         if(leftWalkable) directions[numDirections++] = shapes::Point2D(-1, yDirection);
+         if(rightWalkable) directions[numDirections++] = shapes::Point2D(1, yDirection);
+      }
+
+      if(leftWalkable) directions[numDirections++] = shapes::Point2D(-1, 0);
+      if(rightWalkable) directions[numDirections++] = shapes::Point2D(1, 0);
+   }
+
+   return numDirections;
+}
+
+void Pathfinder::JumpPointSearch::expand(int tileNum)
+{
+   const shapes::Point2D tile = pathfinder.tileNumToCoords(tileNum);
+   TRACE("Evaluating jump point %d,%d", tile.x, tile.y);
+
+   shapes::Point2D directions[NUM_NEIGHBOURS];
+   const int parentTileNum = searchSpace.getParent(tileNum);
+   const shapes::Point2D parentTile = parentTileNum != -1 ? pathfinder.tileNumToCoords(parentTileNum) : tile;
+   const int numDirections = findSuccessorDirections(tile, parentTile, parentTileNum != -1, directions);
+
+   const float gCost = searchSpace.getGCost(tileNum);
+   for(int i = 0; i < numDirections; ++i)
+   {
+      const shapes::Point2D& direction = directions[i];
+      const int x = tile.x + direction.x;
+      const int y = tile.y + direction.y;
+
+      // A diagonal first step is subject to the same corner rule as the rest of a diagonal run
+      if(direction.x != 0 && direction.y != 0 && (!canOccupy(x, tile.y) || !canOccupy(tile.x, y)))
+      {
+         continue;
+      }
+
+      const int jumpPointTileNum = jump(x, y, direction.x, direction.y);
+      if(jumpPointTileNum == -1 || searchSpace.isClosed(jumpPointTileNum))
+      {
+         continue;
+      }
+
+      // Jump points are always reached along a straight or diagonal line, so the octile distance is exact
+      const float jumpPointGCost = gCost + pathfinder.getOctileDistance(tileNum, jumpPointTileNum);
+      if(searchSpace.isDiscovered(jumpPointTileNum))
+      {
+         searchSpace.decreaseCost(jumpPointTileNum, tileNum, jumpPointGCost);
+      }
+      else
+      {
+         searchSpace.open(jumpPointTileNum, tileNum, jumpPointGCost, pathfinder.getOctileDistance(jumpPointTileNum, dstTileNum));
+      }
+   }
+}
@@ -0,0 +1,57 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_JUMP_POINT_SEARCH_H
+#define PATHFINDER_JUMP_POINT_SEARCH_H
+
+#include "Pathfinder_RerouteSearch.h"
+
+/**
+ * Jump Point Search finds the same paths as A* on a uniform-cost grid, but only adds
+ * "jump points" to the open set: tiles where the best path might turn because an obstacle
+ * forces it to. Straight and diagonal runs of open tiles between jump points are skipped over
+ * without being pushed through the open set, which makes searches across open areas much cheaper.
+ *
+ * As in the rest of the Pathfinder, diagonal moves are only allowed when both of the tiles beside the diagonal are free,
+ * and a tile is only considered walkable if the moving entity's entire area fits on it.
+ */
+class Pathfinder::JumpPointSearch : public Pathfinder::RerouteSearch
+{
+   /** The destination tile (in tiles). */
+   const shapes::Point2D dstTile;
+
+   /**
+    * Moves from a tile in the given direction until a jump point, the destination, or a blocked tile is found.
+    *
+    * @param x The x-coordinate of the first tile to check (in tiles).
+    * @param y The y-coordinate of the first tile to check (in tiles).
+    * @param xDirection The horizontal direction of travel (-1, 0 or 1).
+    * @param yDirection The vertical direction of travel (-1, 0 or 1).
+    *
+    * @return The tile number of the jump point found, or -1 if the travel direction is blocked.
+    */
+   int jump(int x, int y, int xDirection, int yDirection) const;
+
+   /**
+    * Finds the directions that must be searched from a tile, given the direction it was reached from.
+    *
+    * @param tile The tile being expanded (in tiles).
+    * @param parentTile The tile that the expanded tile was reached from (in tiles).
+    * @param hasParent Whether or not the expanded tile has a parent (false for the source tile).
+    * @param directions Filled with the directions to search in.
+    *
+    * @return The number of directions found.
+    */
+   int findSuccessorDirections(const shapes::Point2D& tile, const shapes::Point2D& parentTile, bool hasParent, shapes::Point2D directions[NUM_NEIGHBOURS]) const;
+
+   protected:
+      void expand(int tileNum);
+
+   public:
+      JumpPointSearch(Pathfinder& pathfinder, SearchSpace& searchSpace, const OccupancyMap& occupancyMap, const TileState& entityState, int width, int height, int srcTileNum, int dstTileNum);
+};
+
+#endif
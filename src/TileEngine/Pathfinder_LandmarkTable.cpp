@@ -0,0 +1,205 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_LandmarkTable.h"
+#include "Pathfinder_SearchSpace.h"
+#include "TileState.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PATHFINDER;
+
+// A few well-spread landmarks capture most of the benefit;
+// each extra one costs another search over the grid whenever obstacles are removed.
+const int Pathfinder::LandmarkTable::LANDMARK_COUNT = 4;
+
+Pathfinder::LandmarkTable::LandmarkTable(Pathfinder& pathfinder) : pathfinder(pathfinder), numTiles(0), stale(false), seedSearched(false)
+{
+}
+
+void Pathfinder::LandmarkTable::findDistances(int srcTileNum, std::vector<float>& result) const
+{
+   result.assign(numTiles, Pathfinder::INFINITY);
+
+   // Use the same moves as the static path searches, so that the distances bound their costs
+   SearchSpace& searchSpace = *pathfinder.searchSpace;
+   searchSpace.beginSearch();
+   searchSpace.open(srcTileNum, -1, 0, 0);
+
+   while(!searchSpace.isOpenSetEmpty())
+   {
+      const int currTileNum = searchSpace.popCheapest();
+      const shapes::Point2D currTile = pathfinder.tileNumToCoords(currTileNum);
+      const float currGCost = searchSpace.getGCost(currTileNum);
+      result[currTileNum] = currGCost;
+
+      for(int i = 0; i < NUM_NEIGHBOURS; ++i)
+      {
+         const NeighbourOffset& offset = NEIGHBOUR_OFFSETS[i];
+         const int x = currTile.x + offset.x;
+         const int y = currTile.y + offset.y;
+         if(x < 0 || y < 0 || x >= pathfinder.collisionGridWidth || y >= pathfinder.collisionGridHeight) continue;
+
+         const int adjacentTileNum = pathfinder.coordsToTileNum(shapes::Point2D(x, y));
+         const float tileGCost = currGCost + (offset.diagonal ? ROOT_2 : 1.0f);
+
+         if(searchSpace.isDiscovered(adjacentTileNum))
+         {
+            searchSpace.decreaseCost(adjacentTileNum, currTileNum, tileGCost);
+         }
+         else if(pathfinder.collisionGrid[y][x].entityType == TileState::OBSTACLE)
+         {
+            searchSpace.close(adjacentTileNum);
+         }
+         else
+         {
+            searchSpace.open(adjacentTileNum, currTileNum, tileGCost, 0);
+         }
+      }
+   }
+}
+
+void Pathfinder::LandmarkTable::beginRebuild()
+{
+   numTiles = pathfinder.collisionGridWidth * pathfinder.collisionGridHeight;
+   pendingLandmarks.clear();
+   pendingDistances.clear();
+   closestDistances.assign(numTiles, Pathfinder::INFINITY);
+   seedSearched = false;
+}
+
+void Pathfinder::LandmarkTable::finishRebuild()
+{
+   landmarks.swap(pendingLandmarks);
+   distances.swap(pendingDistances);
+   pendingLandmarks.clear();
+   pendingDistances.clear();
+   closestDistances.clear();
+   stale = false;
+
+   DEBUG("Placed %d landmarks on a grid of %d tiles", static_cast<int>(landmarks.size()), numTiles);
+}
+
+void Pathfinder::LandmarkTable::build()
+{
+   beginRebuild();
+   stale = true;
+   while(stale)
+   {
+      rebuildStep();
+   }
+}
+
+void Pathfinder::LandmarkTable::invalidate()
+{
+   stale = true;
+   beginRebuild();
+}
+
+bool Pathfinder::LandmarkTable::isStale() const
+{
+   return stale;
+}
+
+void Pathfinder::LandmarkTable::rebuildStep()
+{
+   if(!stale) return;
+
+   std::vector<float> landmarkDistances;
+   if(!seedSearched)
+   {
+      // Start from the farthest tile from an arbitrary open tile, which tends to sit on the edge of the map
+      int seedTileNum = -1;
+      for(int tileNum = 0; tileNum < numTiles; ++tileNum)
+      {
+         const shapes::Point2D tile = pathfinder.tileNumToCoords(tileNum);
+         if(pathfinder.collisionGrid[tile.y][tile.x].entityType != TileState::OBSTACLE)
+         {
+            seedTileNum = tileNum;
+            break;
+         }
+      }
+
+      if(seedTileNum == -1)
+      {
+         finishRebuild();
+         return;
+      }
+
+      findDistances(seedTileNum, closestDistances);
+      seedSearched = true;
+      return;
+   }
+
+   // Prefer a tile that no landmark can reach yet, so that every region of the map gets a landmark.
+   // Otherwise, pick the tile that is farthest from all of the landmarks so far.
+   int nextLandmark = -1;
+   float farthestDistance = 0;
+   for(int tileNum = 0; tileNum < numTiles; ++tileNum)
+   {
+      if(closestDistances[tileNum] == Pathfinder::INFINITY)
+      {
+         const shapes::Point2D tile = pathfinder.tileNumToCoords(tileNum);
+         if(pathfinder.collisionGrid[tile.y][tile.x].entityType == TileState::OBSTACLE) continue;
+
+         nextLandmark = tileNum;
+         break;
+      }
+
+      if(closestDistances[tileNum] > farthestDistance)
+      {
+         farthestDistance = closestDistances[tileNum];
+         nextLandmark = tileNum;
+      }
+   }
+
+   if(nextLandmark == -1)
+   {
+      finishRebuild();
+      return;
+   }
+
+   findDistances(nextLandmark, landmarkDistances);
+   pendingLandmarks.push_back(nextLandmark);
+   pendingDistances.insert(pendingDistances.end(), landmarkDistances.begin(), landmarkDistances.end());
+
+   if(pendingLandmarks.size() == 1)
+   {
+      // The tile that the first landmark was found from isn't a landmark itself
+      closestDistances = landmarkDistances;
+   }
+   else
+   {
+      for(int tileNum = 0; tileNum < numTiles; ++tileNum)
+      {
+         closestDistances[tileNum] = std::min(closestDistances[tileNum], landmarkDistances[tileNum]);
+      }
+   }
+
+   if(static_cast<int>(pendingLandmarks.size()) >= LANDMARK_COUNT)
+   {
+      finishRebuild();
+   }
+}
+
+float Pathfinder::LandmarkTable::getLowerBound(int srcTileNum, int dstTileNum) const
+{
+   float lowerBound = 0;
+   if(stale) return lowerBound;
+
+   const int landmarkCount = landmarks.size();
+   for(int i = 0; i < landmarkCount; ++i)
+   {
+      const float srcDistance = distances[i * numTiles + srcTileNum];
+      const float dstDistance = distances[i * numTiles + dstTileNum];
+
+      // A landmark that can't reach both tiles says nothing about the distance between them
+      if(srcDistance == Pathfinder::INFINITY || dstDistance == Pathfinder::INFINITY) continue;
+
+      lowerBound = std::max(lowerBound, std::abs(srcDistance - dstDistance));
+   }
+
+   return lowerBound;
+}
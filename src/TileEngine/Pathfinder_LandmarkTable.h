@@ -0,0 +1,118 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_LANDMARK_TABLE_H
+#define PATHFINDER_LANDMARK_TABLE_H
+
+#include "Pathfinder.h"
+
+/**
+ * The LandmarkTable stores the cost of the best static path from a handful of landmark tiles
+ * to every other tile on the grid. By the triangle inequality, the difference between two tiles'
+ * distances to a landmark is a lower bound on the cost of travelling between them, which makes
+ * for a much tighter A* heuristic than the octile distance on maps with walls and corridors (ALT).
+ *
+ * The table costs a fixed number of floats per tile, so its size grows linearly with the map.
+ *
+ * Adding obstacles only makes paths longer, so the distances stay lower bounds and the table is kept as it is.
+ * Removing obstacles can make paths shorter than the distances say, so the table goes stale: it gives no bound
+ * (leaving the octile distance as the heuristic) while it is rebuilt in the background of the following frames,
+ * one landmark search per frame (see rebuildStep).
+ */
+class Pathfinder::LandmarkTable
+{
+   /** The number of landmarks to place on the grid. */
+   static const int LANDMARK_COUNT;
+
+   /** The pathfinder that owns this table. */
+   Pathfinder& pathfinder;
+
+   /** The number of tiles in the grid. */
+   int numTiles;
+
+   /** The tile numbers of the landmarks. */
+   std::vector<int> landmarks;
+
+   /**
+    * The cost of the best static path from each landmark to each tile, or infinity if the tile is unreachable.
+    * The distances to the first landmark are stored first, followed by the distances to the second landmark, and so on.
+    */
+   std::vector<float> distances;
+
+   /** Whether or not obstacles have been removed since the distances were found, so that they may not be lower bounds any more. */
+   bool stale;
+
+   /** The landmarks placed so far by the rebuild in progress. */
+   std::vector<int> pendingLandmarks;
+
+   /** The distances from the landmarks placed so far by the rebuild in progress, stored in the same way as the distances. */
+   std::vector<float> pendingDistances;
+
+   /** The distance from each tile to the closest landmark placed so far by the rebuild in progress. */
+   std::vector<float> closestDistances;
+
+   /** Whether or not the rebuild in progress has searched from the tile that its first landmark is found from. */
+   bool seedSearched;
+
+   /**
+    * Starts placing the landmarks again for the pathfinder's current grid, discarding any rebuild in progress.
+    */
+   void beginRebuild();
+
+   /**
+    * Replaces the table's landmarks and distances with those of the finished rebuild.
+    */
+   void finishRebuild();
+
+   /**
+    * Runs a Dijkstra search around static obstacles from a tile to find its distance to every other tile.
+    *
+    * @param srcTileNum The tile number of the tile to search from.
+    * @param result Filled with the distance to every tile, indexed by tile number.
+    */
+   void findDistances(int srcTileNum, std::vector<float>& result) const;
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param pathfinder The pathfinder whose grid the table covers.
+       */
+      LandmarkTable(Pathfinder& pathfinder);
+
+      /**
+       * Places the landmarks and computes their distances for the pathfinder's current grid, all at once.
+       * Each landmark is placed on the tile that is farthest from the landmarks placed before it,
+       * and tiles that none of them can reach are given landmarks of their own where possible.
+       */
+      void build();
+
+      /**
+       * Marks the table as stale after obstacles were removed from the grid, and starts rebuilding it.
+       */
+      void invalidate();
+
+      /**
+       * @return true iff the table is stale and being rebuilt.
+       */
+      bool isStale() const;
+
+      /**
+       * Runs the next search of the rebuild, which places one landmark (or finds the tile that the first one is found from).
+       * Once the last landmark is placed, the new distances replace the stale ones.
+       */
+      void rebuildStep();
+
+      /**
+       * @param srcTileNum The tile number of the source.
+       * @param dstTileNum The tile number of the destination.
+       *
+       * @return A lower bound on the cost of the best static path between the two tiles, or 0 if the table is stale.
+       */
+      float getLowerBound(int srcTileNum, int dstTileNum) const;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_OccupancyMap.h"
+#include "SDL_mutex.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PATHFINDER;
+
+Pathfinder::OccupancyMap::~OccupancyMap()
+{
+}
+
+Pathfinder::CollisionSnapshot::CollisionSnapshot(const TileState* const* grid, int tileSize, int width, int height, unsigned int version)
+: version(version), tileSize(tileSize), width(width), height(height), referenceCount(1)
+{
+   tiles.reserve(width * height);
+   for(int y = 0; y < height; ++y)
+   {
+      tiles.insert(tiles.end(), grid[y], grid[y] + width);
+   }
+
+   lock = SDL_CreateMutex();
+   DEBUG("Took snapshot of collision grid version %u", version);
+}
+
+unsigned int Pathfinder::CollisionSnapshot::getVersion() const
+{
+   return version;
+}
+
+void Pathfinder::CollisionSnapshot::retain()
+{
+   SDL_mutexP(lock);
+   ++referenceCount;
+   SDL_mutexV(lock);
+}
+
+void Pathfinder::CollisionSnapshot::release()
+{
+   SDL_mutexP(lock);
+   const bool lastReference = --referenceCount == 0;
+   SDL_mutexV(lock);
+
+   if(lastReference)
+   {
+      delete this;
+   }
+}
+
+bool Pathfinder::CollisionSnapshot::canOccupyArea(const shapes::Point2D& area, int areaWidth, int areaHeight, const TileState& state) const
+{
+   if(state.entityType == TileState::FREE)
+   {
+      return false;
+   }
+
+   // Same edges as EntityGrid::getCollisionMapEdges
+   const int left = area.x / tileSize;
+   const int top = area.y / tileSize;
+   const int right = (area.x + areaWidth - 1) / tileSize;
+   const int bottom = (area.y + areaHeight - 1) / tileSize;
+
+   if(right >= width || bottom >= height)
+   {
+      return false;
+   }
+
+   for(int y = top; y <= bottom; ++y)
+   {
+      const TileState* row = &tiles[y * width];
+      for(int x = left; x <= right; ++x)
+      {
+         const TileState& tile = row[x];
+         if(tile.entityType != TileState::FREE && (tile.entityType != state.entityType || tile.entity != state.entity))
+         {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+Pathfinder::CollisionSnapshot::~CollisionSnapshot()
+{
+   SDL_DestroyMutex(lock);
+}
@@ -0,0 +1,105 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_OCCUPANCY_MAP_H
+#define PATHFINDER_OCCUPANCY_MAP_H
+
+#include "Pathfinder.h"
+#include "TileState.h"
+
+struct SDL_mutex;
+
+/**
+ * The source of occupancy information for a rerouting search.
+ */
+class Pathfinder::OccupancyMap
+{
+   public:
+      /**
+       * Checks an area for obstacles or entities other than the moving entity.
+       *
+       * @param area The coordinates of the top-left corner of the area (in pixels)
+       * @param width The width of the area (in pixels)
+       * @param height The height of the area (in pixels)
+       * @param state The state of the moving entity.
+       *
+       * @return true iff the area can be occupied by the moving entity.
+       */
+      virtual bool canOccupyArea(const shapes::Point2D& area, int width, int height, const TileState& state) const = 0;
+
+      /**
+       * Destructor.
+       */
+      virtual ~OccupancyMap();
+};
+
+/**
+ * An immutable copy of the collision grid, taken at a particular version of the grid.
+ * Searches running on worker threads read from a snapshot so that the main thread can keep
+ * moving entities around in the meantime.
+ *
+ * Snapshots are reference counted, since a single snapshot is shared by every search
+ * dispatched while the grid stays unchanged.
+ */
+class Pathfinder::CollisionSnapshot : public Pathfinder::OccupancyMap
+{
+   /** The version of the collision grid that this snapshot was taken from. */
+   const unsigned int version;
+
+   /** The size (in pixels) of each tile. */
+   const int tileSize;
+
+   /** The width (in tiles) of the grid. */
+   const int width;
+
+   /** The height (in tiles) of the grid. */
+   const int height;
+
+   /** The tiles of the grid, stored row by row. */
+   std::vector<TileState> tiles;
+
+   /** Guards the reference count, which is changed from several threads. */
+   SDL_mutex* lock;
+
+   /** The number of owners of this snapshot. */
+   int referenceCount;
+
+   /**
+    * Destructor. Snapshots are destroyed when their last reference is released.
+    */
+   ~CollisionSnapshot();
+
+   public:
+      /**
+       * Constructor. Copies the collision grid, and starts off with a single reference.
+       *
+       * @param grid The collision grid to copy.
+       * @param tileSize The size (in pixels) of each tile.
+       * @param width The width (in tiles) of the grid.
+       * @param height The height (in tiles) of the grid.
+       * @param version The current version of the collision grid.
+       */
+      CollisionSnapshot(const TileState* const* grid, int tileSize, int width, int height, unsigned int version);
+
+      /**
+       * @return The version of the collision grid that this snapshot was taken from.
+       */
+      unsigned int getVersion() const;
+
+      /**
+       * Adds a reference to the snapshot.
+       */
+      void retain();
+
+      /**
+       * Removes a reference to the snapshot, destroying it if there are none left.
+       */
+      void release();
+
+      bool canOccupyArea(const shapes::Point2D& area, int width, int height, const TileState& state) const;
+};
+
+#endif
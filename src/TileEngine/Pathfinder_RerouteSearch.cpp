@@ -0,0 +1,132 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_RerouteSearch.h"
+#include "Pathfinder_SearchSpace.h"
+#include "Pathfinder_OccupancyMap.h"
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PATHFINDER;
+
+Pathfinder::RerouteSearch::RerouteSearch(Pathfinder& pathfinder, SearchSpace& searchSpace, const OccupancyMap& occupancyMap, const TileState& entityState, int width, int height, int srcTileNum, int dstTileNum)
+: finished(false), pathfinder(pathfinder), searchSpace(searchSpace), occupancyMap(occupancyMap), entityState(entityState), width(width), height(height), srcTileNum(srcTileNum), dstTileNum(dstTileNum)
+{
+   searchSpace.beginSearch();
+   searchSpace.open(srcTileNum, -1, 0, pathfinder.getOctileDistance(srcTileNum, dstTileNum));
+}
+
+bool Pathfinder::RerouteSearch::canOccupy(int x, int y) const
+{
+   if(x < 0 || y < 0 || x >= pathfinder.collisionGridWidth || y >= pathfinder.collisionGridHeight)
+   {
+      return false;
+   }
+
+   return occupancyMap.canOccupyArea(shapes::Point2D(x, y) * pathfinder.movementTileSize, width, height, entityState);
+}
+
+bool Pathfinder::RerouteSearch::advance(int& expansionBudget)
+{
+   while(!finished && expansionBudget > 0)
+   {
+      if(searchSpace.isOpenSetEmpty())
+      {
+         DEBUG("No path found from tile %d to tile %d.", srcTileNum, dstTileNum);
+         finished = true;
+         break;
+      }
+
+      // Get the lowest-cost tile in the open set, and remove it from the open set
+      const int cheapestTileNum = searchSpace.popCheapest();
+      --expansionBudget;
+
+      if(cheapestTileNum == dstTileNum)
+      {
+         TRACE("Found goal tile %d", cheapestTileNum);
+         buildPath();
+         finished = true;
+         break;
+      }
+
+      expand(cheapestTileNum);
+   }
+
+   return finished;
+}
+
+void Pathfinder::RerouteSearch::buildPath()
+{
+   shapes::Point2D tile = pathfinder.tileNumToCoords(dstTileNum);
+   path.push_front(tile * pathfinder.movementTileSize);
+
+   for(int parentTileNum = searchSpace.getParent(dstTileNum); parentTileNum != -1; parentTileNum = searchSpace.getParent(parentTileNum))
+   {
+      const shapes::Point2D parentTile = pathfinder.tileNumToCoords(parentTileNum);
+      const int xDirection = (parentTile.x > tile.x) - (parentTile.x < tile.x);
+      const int yDirection = (parentTile.y > tile.y) - (parentTile.y < tile.y);
+      while(tile != parentTile)
+      {
+         tile.x += xDirection;
+         tile.y += yDirection;
+         path.push_front(tile * pathfinder.movementTileSize);
+      }
+   }
+}
+
+const Pathfinder::Path& Pathfinder::RerouteSearch::getPath() const
+{
+   return path;
+}
+
+Pathfinder::RerouteSearch::~RerouteSearch()
+{
+}
+
+Pathfinder::AStarSearch::AStarSearch(Pathfinder& pathfinder, SearchSpace& searchSpace, const OccupancyMap& occupancyMap, const TileState& entityState, int width, int height, int srcTileNum, int dstTileNum)
+: RerouteSearch(pathfinder, searchSpace, occupancyMap, entityState, width, height, srcTileNum, dstTileNum)
+{
+}
+
+void Pathfinder::AStarSearch::expand(int tileNum)
+{
+   const shapes::Point2D tile = pathfinder.tileNumToCoords(tileNum);
+   TRACE("Evaluating point %d,%d", tile.x, tile.y);
+
+   const float gCost = searchSpace.getGCost(tileNum);
+   for(int i = 0; i < NUM_NEIGHBOURS; ++i)
+   {
+      const NeighbourOffset& offset = NEIGHBOUR_OFFSETS[i];
+      const int x = tile.x + offset.x;
+      const int y = tile.y + offset.y;
+      if(x < 0 || y < 0 || x >= pathfinder.collisionGridWidth || y >= pathfinder.collisionGridHeight) continue;
+
+      const int adjacentTileNum = pathfinder.coordsToTileNum(shapes::Point2D(x, y));
+      if(searchSpace.isClosed(adjacentTileNum)) continue;
+
+      // Moving diagonally sweeps across the two tiles beside the diagonal, so they must be free as well.
+      // If they aren't, the tile may still be reached laterally, so it is left as it is.
+      if(offset.diagonal && (!canOccupy(tile.x, y) || !canOccupy(x, tile.y))) continue;
+
+      const float tileGCost = gCost + (offset.diagonal ? ROOT_2 : 1.0f);
+      if(searchSpace.isDiscovered(adjacentTileNum))
+      {
+         if(searchSpace.decreaseCost(adjacentTileNum, tileNum, tileGCost))
+         {
+            TRACE("Altering cost of discovered point %d, %d to g()=%f", x, y, tileGCost);
+         }
+      }
+      else if(canOccupy(x, y))
+      {
+         const float tileHCost = pathfinder.getOctileDistance(adjacentTileNum, dstTileNum);
+         TRACE("Pushing point %d,%d onto open set with g()=%f and f()=%f.", x, y, tileGCost, tileGCost + tileHCost);
+         searchSpace.open(adjacentTileNum, tileNum, tileGCost, tileHCost);
+      }
+      else
+      {
+         searchSpace.close(adjacentTileNum);
+      }
+   }
+}
@@ -0,0 +1,118 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_REROUTE_SEARCH_H
+#define PATHFINDER_REROUTE_SEARCH_H
+
+#include "Pathfinder.h"
+#include "TileState.h"
+
+/**
+ * A search for a path around obstacles and entities for a single moving entity.
+ * The search can be advanced a few node expansions at a time, so that a long search
+ * can be spread out over several frames instead of stalling any one of them.
+ */
+class Pathfinder::RerouteSearch
+{
+   /** Whether or not the search has finished. */
+   bool finished;
+
+   /** The path found, once the search has finished. */
+   Path path;
+
+   /**
+    * Builds the path from the source to the destination out of the parent links in the search space.
+    * Every tile along the way gets a waypoint, even if consecutive nodes in the search are further apart.
+    */
+   void buildPath();
+
+   protected:
+      /** The pathfinder running the search. */
+      Pathfinder& pathfinder;
+
+      /** The node storage used by the search. */
+      SearchSpace& searchSpace;
+
+      /** The occupancy of the grid being searched. */
+      const OccupancyMap& occupancyMap;
+
+      /** The state of the moving entity. */
+      const TileState entityState;
+
+      /** The width of the moving entity (in pixels). */
+      const int width;
+
+      /** The height of the moving entity (in pixels). */
+      const int height;
+
+      /** The tile number of the source. */
+      const int srcTileNum;
+
+      /** The tile number of the destination. */
+      const int dstTileNum;
+
+      /**
+       * Constructor. Starts a new search in the search space.
+       *
+       * @param pathfinder The pathfinder running the search.
+       * @param searchSpace The node storage to use. It must not be used by any other search until this one finishes.
+       * @param occupancyMap The occupancy of the grid to search.
+       * @param entityState The state of the moving entity.
+       * @param width The width of the moving entity (in pixels).
+       * @param height The height of the moving entity (in pixels).
+       * @param srcTileNum The tile number of the source.
+       * @param dstTileNum The tile number of the destination.
+       */
+      RerouteSearch(Pathfinder& pathfinder, SearchSpace& searchSpace, const OccupancyMap& occupancyMap, const TileState& entityState, int width, int height, int srcTileNum, int dstTileNum);
+
+      /**
+       * @return true iff the moving entity can occupy the area beginning at the given tile.
+       */
+      bool canOccupy(int x, int y) const;
+
+      /**
+       * Expands a tile that was just removed from the open set.
+       *
+       * @param tileNum The tile number of the tile to expand.
+       */
+      virtual void expand(int tileNum) = 0;
+
+   public:
+      /**
+       * Runs the search for up to the given number of node expansions.
+       *
+       * @param expansionBudget The number of node expansions allowed.
+       *                        This is decreased by the number of nodes that were expanded.
+       *
+       * @return true iff the search has finished.
+       */
+      bool advance(int& expansionBudget);
+
+      /**
+       * @return The path from the source to the destination, with a waypoint (in pixels) at every tile along the way,
+       *         including the source. If the search hasn't finished, or the destination can't be reached, the path is empty.
+       */
+      const Path& getPath() const;
+
+      /**
+       * Destructor.
+       */
+      virtual ~RerouteSearch();
+};
+
+/**
+ * A plain A* search that expands every tile along the way.
+ */
+class Pathfinder::AStarSearch : public Pathfinder::RerouteSearch
+{
+   protected:
+      void expand(int tileNum);
+
+   public:
+      AStarSearch(Pathfinder& pathfinder, SearchSpace& searchSpace, const OccupancyMap& occupancyMap, const TileState& entityState, int width, int height, int srcTileNum, int dstTileNum);
+};
+
+#endif
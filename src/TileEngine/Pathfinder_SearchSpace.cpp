@@ -0,0 +1,174 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_SearchSpace.h"
+#include <climits>
+
+const int Pathfinder::SearchSpace::CLOSED = -1;
+
+Pathfinder::SearchSpace::SearchSpace() : generation(0), expansionCount(0), heatMap(NULL)
+{
+}
+
+void Pathfinder::SearchSpace::resize(int numTiles)
+{
+   Node undiscoveredNode = { 0, 0, -1, CLOSED, 0 };
+   nodes.assign(numTiles, undiscoveredNode);
+
+   openHeap.clear();
+   openHeap.reserve(numTiles);
+   generation = 0;
+}
+
+void Pathfinder::SearchSpace::beginSearch()
+{
+   openHeap.clear();
+   ++generation;
+
+   if(generation == 0)
+   {
+      // The generation counter wrapped around, so nodes from a very old search
+      // could be mistaken for nodes in this one. Reset all the nodes to be safe.
+      for(std::vector<Node>::iterator iter = nodes.begin(); iter != nodes.end(); ++iter)
+      {
+         iter->generation = 0;
+      }
+
+      generation = 1;
+   }
+}
+
+bool Pathfinder::SearchSpace::isHigherPriority(int lhsTileNum, int rhsTileNum) const
+{
+   // The lhs tile has a higher priority if it has a lower total f() cost.
+   // In case of a tie, it has a higher priority if it has a higher g() cost,
+   // indicating that it is deeper in the search tree.
+   const Node& lhs = nodes[lhsTileNum];
+   const Node& rhs = nodes[rhsTileNum];
+   return lhs.fCost < rhs.fCost || (lhs.fCost == rhs.fCost && lhs.gCost > rhs.gCost);
+}
+
+void Pathfinder::SearchSpace::siftUp(int heapIndex)
+{
+   const int tileNum = openHeap[heapIndex];
+   while(heapIndex > 0)
+   {
+      const int parentIndex = (heapIndex - 1) / 2;
+      const int parentTileNum = openHeap[parentIndex];
+      if(!isHigherPriority(tileNum, parentTileNum))
+      {
+         break;
+      }
+
+      openHeap[heapIndex] = parentTileNum;
+      nodes[parentTileNum].heapIndex = heapIndex;
+      heapIndex = parentIndex;
+   }
+
+   openHeap[heapIndex] = tileNum;
+   nodes[tileNum].heapIndex = heapIndex;
+}
+
+void Pathfinder::SearchSpace::siftDown(int heapIndex)
+{
+   const int heapSize = openHeap.size();
+   const int tileNum = openHeap[heapIndex];
+   for(;;)
+   {
+      int childIndex = heapIndex * 2 + 1;
+      if(childIndex >= heapSize)
+      {
+         break;
+      }
+
+      if(childIndex + 1 < heapSize && isHigherPriority(openHeap[childIndex + 1], openHeap[childIndex]))
+      {
+         ++childIndex;
+      }
+
+      const int childTileNum = openHeap[childIndex];
+      if(!isHigherPriority(childTileNum, tileNum))
+      {
+         break;
+      }
+
+      openHeap[heapIndex] = childTileNum;
+      nodes[childTileNum].heapIndex = heapIndex;
+      heapIndex = childIndex;
+   }
+
+   openHeap[heapIndex] = tileNum;
+   nodes[tileNum].heapIndex = heapIndex;
+}
+
+void Pathfinder::SearchSpace::open(int tileNum, int parent, float gCost, float hCost)
+{
+   Node& node = nodes[tileNum];
+   node.gCost = gCost;
+   node.fCost = gCost + hCost;
+   node.parent = parent;
+   node.generation = generation;
+
+   openHeap.push_back(tileNum);
+   siftUp(openHeap.size() - 1);
+}
+
+void Pathfinder::SearchSpace::close(int tileNum)
+{
+   Node& node = nodes[tileNum];
+   node.parent = -1;
+   node.heapIndex = CLOSED;
+   node.generation = generation;
+}
+
+bool Pathfinder::SearchSpace::decreaseCost(int tileNum, int parent, float gCost)
+{
+   Node& node = nodes[tileNum];
+   if(node.heapIndex == CLOSED || node.gCost <= gCost)
+   {
+      return false;
+   }
+
+   // The heuristic estimate for the tile doesn't change, so the f() cost drops by as much as the g() cost
+   node.fCost -= node.gCost - gCost;
+   node.gCost = gCost;
+   node.parent = parent;
+   siftUp(node.heapIndex);
+   return true;
+}
+
+int Pathfinder::SearchSpace::popCheapest()
+{
+   const int cheapestTileNum = openHeap.front();
+   nodes[cheapestTileNum].heapIndex = CLOSED;
+   ++expansionCount;
+
+   if(heatMap != NULL)
+   {
+      unsigned short& heat = (*heatMap)[cheapestTileNum];
+      if(heat < USHRT_MAX) ++heat;
+   }
+
+   const int lastTileNum = openHeap.back();
+   openHeap.pop_back();
+   if(!openHeap.empty())
+   {
+      openHeap.front() = lastTileNum;
+      siftDown(0);
+   }
+
+   return cheapestTileNum;
+}
+
+unsigned long Pathfinder::SearchSpace::getExpansionCount() const
+{
+   return expansionCount;
+}
+
+void Pathfinder::SearchSpace::setHeatMap(std::vector<unsigned short>* heatMap)
+{
+   this->heatMap = heatMap;
+}
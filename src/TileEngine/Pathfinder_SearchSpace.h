@@ -0,0 +1,196 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_SEARCH_SPACE_H
+#define PATHFINDER_SEARCH_SPACE_H
+
+#include "Pathfinder.h"
+
+/**
+ * The SearchSpace holds the per-tile bookkeeping for A* searches on a grid.
+ * Nodes are preallocated for every tile and reused between searches; a node belongs
+ * to the current search only if its generation matches the search generation, so starting
+ * a new search never has to clear or reallocate anything.
+ * The open set is a binary heap of tile numbers, and each node remembers its
+ * position in the heap so that its cost can be lowered in O(log n) time.
+ */
+class Pathfinder::SearchSpace
+{
+   /** The heap index of a node that has been removed from the open set. */
+   static const int CLOSED;
+
+   /** The search bookkeeping for a single tile. */
+   struct Node
+   {
+      /** The cost of the best known path from the source to this tile. */
+      float gCost;
+
+      /** The estimated cost of the best path from the source to the destination through this tile. */
+      float fCost;
+
+      /** The tile number of the tile preceding this one along the best known path. */
+      int parent;
+
+      /** The position of this node within the open set, or CLOSED if it is no longer in the open set. */
+      int heapIndex;
+
+      /** The search that this node was last discovered in. */
+      unsigned int generation;
+   };
+
+   /** The nodes for every tile, indexed by tile number. */
+   std::vector<Node> nodes;
+
+   /** The open set, stored as a binary heap of tile numbers. */
+   std::vector<int> openHeap;
+
+   /** The generation number of the current search. */
+   unsigned int generation;
+
+   /** The number of tiles removed from the open set over every search made with this storage. */
+   unsigned long expansionCount;
+
+   /** The number of times each tile has been expanded, or NULL if they aren't being counted. */
+   std::vector<unsigned short>* heatMap;
+
+   /**
+    * @return true iff the lhs tile should be expanded before the rhs tile.
+    */
+   bool isHigherPriority(int lhsTileNum, int rhsTileNum) const;
+
+   /**
+    * Moves a node up the heap until the heap property is restored.
+    *
+    * @param heapIndex The current position of the node in the heap.
+    */
+   void siftUp(int heapIndex);
+
+   /**
+    * Moves a node down the heap until the heap property is restored.
+    *
+    * @param heapIndex The current position of the node in the heap.
+    */
+   void siftDown(int heapIndex);
+
+   public:
+      /**
+       * Constructor.
+       */
+      SearchSpace();
+
+      /**
+       * Allocates nodes for a grid of the given size.
+       *
+       * @param numTiles The number of tiles in the grid.
+       */
+      void resize(int numTiles);
+
+      /**
+       * Starts a new search, discarding the state of any previous search.
+       */
+      void beginSearch();
+
+      /**
+       * @return true iff the tile has been discovered in the current search.
+       */
+      bool isDiscovered(int tileNum) const;
+
+      /**
+       * @return true iff the tile has been discovered and removed from the open set in the current search.
+       */
+      bool isClosed(int tileNum) const;
+
+      /**
+       * @return The cost of the best known path to the tile in the current search.
+       */
+      float getGCost(int tileNum) const;
+
+      /**
+       * @return The tile preceding the given tile on the best known path, or -1 for the source tile.
+       */
+      int getParent(int tileNum) const;
+
+      /**
+       * Adds an undiscovered tile to the open set.
+       *
+       * @param tileNum The tile to add.
+       * @param parent The tile preceding the tile on the best known path, or -1 for the source tile.
+       * @param gCost The cost of the best known path to the tile.
+       * @param hCost The estimated cost from the tile to the destination.
+       */
+      void open(int tileNum, int parent, float gCost, float hCost);
+
+      /**
+       * Marks an undiscovered tile as discovered without ever adding it to the open set.
+       * This is used to skip tiles that can't be entered.
+       *
+       * @param tileNum The tile to close.
+       */
+      void close(int tileNum);
+
+      /**
+       * Lowers the path cost of a tile in the open set if the new path is cheaper than the best known path.
+       *
+       * @param tileNum The tile to update.
+       * @param parent The tile preceding the tile on the new path.
+       * @param gCost The cost of the new path to the tile.
+       *
+       * @return true iff the tile's cost was lowered.
+       */
+      bool decreaseCost(int tileNum, int parent, float gCost);
+
+      /**
+       * @return true iff there are no more tiles in the open set.
+       */
+      bool isOpenSetEmpty() const;
+
+      /**
+       * Removes the cheapest tile from the open set and closes it.
+       *
+       * @return The tile number of the cheapest tile.
+       */
+      int popCheapest();
+
+      /**
+       * @return The number of tiles expanded (removed from the open set) over every search made with this storage.
+       */
+      unsigned long getExpansionCount() const;
+
+      /**
+       * Counts the times that each tile is expanded from now on, stopping at the largest count that the list can hold.
+       *
+       * @param heatMap The list to count the expansions into (indexed by tile number, and big enough for every tile),
+       *                or NULL to stop counting them.
+       */
+      void setHeatMap(std::vector<unsigned short>* heatMap);
+};
+
+inline bool Pathfinder::SearchSpace::isDiscovered(int tileNum) const
+{
+   return nodes[tileNum].generation == generation;
+}
+
+inline bool Pathfinder::SearchSpace::isClosed(int tileNum) const
+{
+   return isDiscovered(tileNum) && nodes[tileNum].heapIndex == CLOSED;
+}
+
+inline float Pathfinder::SearchSpace::getGCost(int tileNum) const
+{
+   return nodes[tileNum].gCost;
+}
+
+inline int Pathfinder::SearchSpace::getParent(int tileNum) const
+{
+   return nodes[tileNum].parent;
+}
+
+inline bool Pathfinder::SearchSpace::isOpenSetEmpty() const
+{
+   return openHeap.empty();
+}
+
+#endif
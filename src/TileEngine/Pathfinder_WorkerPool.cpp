@@ -0,0 +1,217 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "Pathfinder_WorkerPool.h"
+#include "Pathfinder_OccupancyMap.h"
+#include "Pathfinder_RerouteSearch.h"
+#include "Pathfinder_SearchSpace.h"
+#include "MemoryTracker.h"
+#include "SDL_mutex.h"
+#include <limits>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_PATHFINDER;
+
+class Pathfinder::WorkerPool::SearchJob : public JobSystem::Job
+{
+   /** The pool that the search runs for. */
+   WorkerPool& pool;
+
+   /** The job to search for. */
+   WorkerPool::Job* job;
+
+   public:
+      SearchJob(WorkerPool& pool, WorkerPool::Job* job) : JobSystem::Job(false), pool(pool), job(job)
+      {
+      }
+
+      void run(int slot)
+      {
+         pool.runSearch(job, slot);
+      }
+};
+
+Pathfinder::WorkerPool::WorkerPool(Pathfinder& pathfinder)
+: pathfinder(pathfinder), stopping(false), callingThreadJob(NULL), callingThreadSearch(NULL)
+{
+   lock = SDL_CreateMutex();
+   callingThreadSearchSpace = new SearchSpace();
+}
+
+void Pathfinder::WorkerPool::runSearch(Job* job, int slot)
+{
+   MemoryTracker::Scope memoryScope(MemoryTracker::PATHFINDER);
+   SDL_mutexP(lock);
+   const bool discarded = stopping;
+   SDL_mutexV(lock);
+
+   if(discarded)
+   {
+      deleteJob(job);
+      return;
+   }
+
+   // No other search uses the slot's node storage while this one runs on its thread
+   RerouteSearch* search = beginSearch(*job, *searchSpaces[slot]);
+   int expansionBudget = std::numeric_limits<int>::max();
+   search->advance(expansionBudget);
+
+   SDL_mutexP(lock);
+   if(stopping)
+   {
+      delete search;
+      deleteJob(job);
+   }
+   else
+   {
+      completeJob(job, search);
+   }
+   SDL_mutexV(lock);
+}
+
+Pathfinder::RerouteSearch* Pathfinder::WorkerPool::beginSearch(const Job& job, SearchSpace& searchSpace) const
+{
+   return pathfinder.createReroutedSearch(job.searchMode, searchSpace, *job.snapshot, job.entityState, job.width, job.height, job.srcTileNum, job.dstTileNum);
+}
+
+void Pathfinder::WorkerPool::completeJob(Job* job, RerouteSearch* search)
+{
+   job->path = search->getPath();
+   delete search;
+
+   job->snapshot->release();
+   job->snapshot = NULL;
+
+   completedJobs.push_back(job);
+}
+
+void Pathfinder::WorkerPool::deleteJob(Job* job)
+{
+   if(job->snapshot != NULL)
+   {
+      job->snapshot->release();
+   }
+
+   delete job;
+}
+
+void Pathfinder::WorkerPool::start(int numTiles)
+{
+   stop();
+
+   callingThreadSearchSpace->resize(numTiles);
+
+   stopping = false;
+   if(JobSystem::getWorkerCount() > 0 && searchSpaces.empty())
+   {
+      // Any of the job system's threads may run a search, including the main thread when it waits on the searches
+      for(int i = 0; i < JobSystem::getSlotCount(); ++i)
+      {
+         searchSpaces.push_back(new SearchSpace());
+      }
+   }
+
+   // The search spaces are kept from map to map, so resizing them reuses the nodes they already hold
+   for(std::vector<SearchSpace*>::iterator iter = searchSpaces.begin(); iter != searchSpaces.end(); ++iter)
+   {
+      (*iter)->resize(numTiles);
+   }
+
+   DEBUG("Running rerouting searches on %d job workers", JobSystem::getWorkerCount());
+}
+
+void Pathfinder::WorkerPool::stop()
+{
+   SDL_mutexP(lock);
+   stopping = true;
+   SDL_mutexV(lock);
+
+   JobSystem::wait(searches);
+
+   delete callingThreadSearch;
+   callingThreadSearch = NULL;
+
+   if(callingThreadJob != NULL)
+   {
+      deleteJob(callingThreadJob);
+      callingThreadJob = NULL;
+   }
+
+   for(std::list<Job*>::iterator iter = jobQueue.begin(); iter != jobQueue.end(); ++iter)
+   {
+      deleteJob(*iter);
+   }
+
+   for(std::list<Job*>::iterator iter = completedJobs.begin(); iter != completedJobs.end(); ++iter)
+   {
+      deleteJob(*iter);
+   }
+
+   jobQueue.clear();
+   completedJobs.clear();
+}
+
+void Pathfinder::WorkerPool::queueJob(Job* job)
+{
+   if(!searchSpaces.empty())
+   {
+      JobSystem::submit(new SearchJob(*this, job), &searches);
+      return;
+   }
+
+   jobQueue.push_back(job);
+}
+
+void Pathfinder::WorkerPool::work(int& expansionBudget)
+{
+   if(!searchSpaces.empty()) return;
+
+   // Without any workers, nothing else touches the queues, so there is no need to lock them
+   while(expansionBudget > 0)
+   {
+      if(callingThreadSearch == NULL)
+      {
+         if(jobQueue.empty())
+         {
+            break;
+         }
+
+         callingThreadJob = jobQueue.front();
+         jobQueue.pop_front();
+         callingThreadSearch = beginSearch(*callingThreadJob, *callingThreadSearchSpace);
+      }
+
+      if(!callingThreadSearch->advance(expansionBudget))
+      {
+         // Out of budget for this frame; pick up where the search left off next time
+         break;
+      }
+
+      completeJob(callingThreadJob, callingThreadSearch);
+      callingThreadJob = NULL;
+      callingThreadSearch = NULL;
+   }
+}
+
+void Pathfinder::WorkerPool::collectCompletedJobs(std::list<Job*>& jobs)
+{
+   SDL_mutexP(lock);
+   jobs.splice(jobs.end(), completedJobs);
+   SDL_mutexV(lock);
+}
+
+Pathfinder::WorkerPool::~WorkerPool()
+{
+   stop();
+
+   for(std::vector<SearchSpace*>::iterator iter = searchSpaces.begin(); iter != searchSpaces.end(); ++iter)
+   {
+      delete *iter;
+   }
+
+   delete callingThreadSearchSpace;
+   SDL_DestroyMutex(lock);
+}
@@ -0,0 +1,177 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PATHFINDER_WORKER_POOL_H
+#define PATHFINDER_WORKER_POOL_H
+
+#include "Pathfinder.h"
+#include "TileState.h"
+#include "JobSystem.h"
+
+struct SDL_mutex;
+
+/**
+ * Runs rerouting searches away from the main thread, as jobs on the job system's workers.
+ * Finished jobs are handed back through a completion queue that the main thread drains once per frame.
+ *
+ * If the job system has no worker threads, the jobs are instead run on the calling thread,
+ * a few node expansions at a time, whenever work() is called.
+ */
+class Pathfinder::WorkerPool
+{
+   public:
+      /** A rerouting search to run, along with its result. */
+      struct Job
+      {
+         /** The handle of the path request that the job answers. */
+         PathRequestId requestId;
+
+         /** The collision grid to search on. The job holds a reference to it until the search finishes. */
+         CollisionSnapshot* snapshot;
+
+         /** The search algorithm to use. */
+         SearchMode searchMode;
+
+         /** The state of the moving entity. */
+         TileState entityState;
+
+         /** The width of the moving entity (in pixels). */
+         int width;
+
+         /** The height of the moving entity (in pixels). */
+         int height;
+
+         /** The tile number of the source. */
+         int srcTileNum;
+
+         /** The tile number of the destination. */
+         int dstTileNum;
+
+         /** The path found, once the job is complete. */
+         Path path;
+      };
+
+   private:
+      /** The job system job that runs a search on a worker. */
+      class SearchJob;
+      friend class SearchJob;
+
+      /** The pathfinder that the searches run for. */
+      Pathfinder& pathfinder;
+
+      /** The node storage used by the searches on each of the job system's slots, or empty if the searches run on the calling thread. */
+      std::vector<SearchSpace*> searchSpaces;
+
+      /** Counts the searches handed to the job system that haven't finished yet. */
+      JobSystem::Counter searches;
+
+      /** Guards the completion queue and the stopping flag. */
+      SDL_mutex* lock;
+
+      /** Whether or not the pool has been asked to stop, so that searches that haven't finished are discarded. */
+      bool stopping;
+
+      /** The jobs waiting to be run on the calling thread, in the order they were queued. */
+      std::list<Job*> jobQueue;
+
+      /** The jobs that have finished, but haven't been collected yet. */
+      std::list<Job*> completedJobs;
+
+      /** The node storage used to run jobs on the calling thread when there are no workers. */
+      SearchSpace* callingThreadSearchSpace;
+
+      /** The job being run on the calling thread, if any. */
+      Job* callingThreadJob;
+
+      /** The search for the job being run on the calling thread, if any. */
+      RerouteSearch* callingThreadSearch;
+
+      /**
+       * Runs the search for a job on one of the job system's threads, unless the pool is stopping.
+       *
+       * @param job The job to search for.
+       * @param slot The slot of the thread running the search.
+       */
+      void runSearch(Job* job, int slot);
+
+      /**
+       * Begins the search for a job.
+       *
+       * @param job The job to search for.
+       * @param searchSpace The node storage to search with.
+       *
+       * @return The new search, which must be deleted by the caller.
+       */
+      RerouteSearch* beginSearch(const Job& job, SearchSpace& searchSpace) const;
+
+      /**
+       * Stores the result of a finished search in its job, and moves the job to the completion queue.
+       *
+       * @param job The finished job.
+       * @param search The finished search, which is deleted.
+       */
+      void completeJob(Job* job, RerouteSearch* search);
+
+      /**
+       * Deletes a job, releasing its snapshot if it still holds one.
+       *
+       * @param job The job to delete.
+       */
+      static void deleteJob(Job* job);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param pathfinder The pathfinder that the searches run for.
+       */
+      WorkerPool(Pathfinder& pathfinder);
+
+      /**
+       * Prepares the node storage for the searches, one for each of the job system's slots.
+       * The storage is kept when the pool is restarted for another map, and only grows if the new grid is bigger.
+       *
+       * @param numTiles The number of tiles in the grid being searched.
+       */
+      void start(int numTiles);
+
+      /**
+       * Waits for the searches that are running to finish,
+       * and discards all jobs that are queued or haven't been collected.
+       */
+      void stop();
+
+      /**
+       * Hands a job to the job system, or adds it to the back of the calling thread's queue if there are no workers.
+       * The pool takes ownership of the job.
+       *
+       * @param job The job to queue.
+       */
+      void queueJob(Job* job);
+
+      /**
+       * Runs queued jobs on the calling thread if there are no worker threads to run them.
+       *
+       * @param expansionBudget The number of node expansions allowed.
+       *                        This is decreased by the number of nodes that were expanded.
+       */
+      void work(int& expansionBudget);
+
+      /**
+       * Moves every finished job to the back of the given list.
+       * The caller takes ownership of the jobs, and must delete them.
+       *
+       * @param jobs The list to add the finished jobs to.
+       */
+      void collectCompletedJobs(std::list<Job*>& jobs);
+
+      /**
+       * Destructor.
+       */
+      ~WorkerPool();
+};
+
+#endif
@@ -0,0 +1,398 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "PerspectiveLayerRenderer.h"
+#include "Tileset.h"
+#include "TileEngine.h"
+#include "GLState.h"
+#include "GraphicsUtil.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <algorithm>
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+bool PerspectiveLayerRenderer::functionsLoaded = false;
+bool PerspectiveLayerRenderer::shadersSupported = false;
+
+// A moderate field of view (60 degrees), so that the horizon isn't stretched at steep tilts; kept as the tangent of half of it
+static const double HALF_VIEW_TANGENT = 0.57735026918962576;
+
+// Just short of edge on, where the plane would disappear into a line
+static const float MAX_TILT = 85.0f;
+
+// The near and far planes, as fractions of the camera's distance from the map; far enough to reach the horizon at the steepest tilt
+static const double NEAR_DISTANCE = 0.05;
+static const double FAR_DISTANCE = 64.0;
+
+// The shader functions and multitexturing aren't part of OpenGL 1.1, so they have to be looked up from the driver
+static PFNGLCREATESHADEROBJECTARBPROC createShaderObject = NULL;
+static PFNGLSHADERSOURCEARBPROC shaderSource = NULL;
+static PFNGLCOMPILESHADERARBPROC compileShader = NULL;
+static PFNGLCREATEPROGRAMOBJECTARBPROC createProgramObject = NULL;
+static PFNGLATTACHOBJECTARBPROC attachObject = NULL;
+static PFNGLLINKPROGRAMARBPROC linkProgram = NULL;
+static PFNGLUSEPROGRAMOBJECTARBPROC useProgramObject = NULL;
+static PFNGLGETOBJECTPARAMETERIVARBPROC getObjectParameteriv = NULL;
+static PFNGLGETINFOLOGARBPROC getInfoLog = NULL;
+static PFNGLDELETEOBJECTARBPROC deleteObject = NULL;
+static PFNGLGETUNIFORMLOCATIONARBPROC getUniformLocation = NULL;
+static PFNGLUNIFORM1IARBPROC uniform1i = NULL;
+static PFNGLUNIFORM2FARBPROC uniform2f = NULL;
+static PFNGLUNIFORM4FARBPROC uniform4f = NULL;
+static PFNGLACTIVETEXTUREARBPROC activeTexture = NULL;
+
+// The shader program that draws the plane, and the locations of its uniforms
+static GLhandleARB program = 0;
+static GLint tileTextureLocation = -1;
+static GLint tilesetTextureLocation = -1;
+static GLint tileScaleLocation = -1;
+static GLint tilesetRegionLocation = -1;
+
+// The plane's texture coordinates are its positions in tiles, which the fragment shader passes through the tile texture
+static const char* VERTEX_SHADER =
+   "varying vec2 tilePosition;\n"
+   "void main()\n"
+   "{\n"
+   "   tilePosition = gl_MultiTexCoord0.xy;\n"
+   "   gl_FrontColor = gl_Color;\n"
+   "   gl_Position = ftransform();\n"
+   "}\n";
+
+// Each texel of the tile texture holds a tile's column and row in the tileset, or no alpha for an empty tile
+static const char* FRAGMENT_SHADER =
+   "uniform sampler2D tiles;\n"
+   "uniform sampler2D tileset;\n"
+   "uniform vec2 tileScale;\n"
+   "uniform vec4 tilesetRegion;\n"
+   "varying vec2 tilePosition;\n"
+   "void main()\n"
+   "{\n"
+   "   vec2 tile = floor(tilePosition);\n"
+   "   vec4 entry = texture2D(tiles, (tile + 0.5) * tileScale);\n"
+   "   if(entry.a < 0.5) discard;\n"
+   "   vec2 tilesetTile = floor(entry.rg * 255.0 + 0.5);\n"
+   "   gl_FragColor = texture2D(tileset, tilesetRegion.xy + (tilesetTile + fract(tilePosition)) * tilesetRegion.zw) * gl_Color;\n"
+   "}\n";
+
+/**
+ * Compiles a shader, logging why if it fails.
+ *
+ * @param type The type of shader.
+ * @param source The shader's source code.
+ *
+ * @return The shader object, or 0 if it didn't compile.
+ */
+static GLhandleARB buildShader(GLenum type, const char* source)
+{
+   GLhandleARB shader = createShaderObject(type);
+   shaderSource(shader, 1, &source, NULL);
+   compileShader(shader);
+
+   GLint compiled = 0;
+   getObjectParameteriv(shader, GL_OBJECT_COMPILE_STATUS_ARB, &compiled);
+   if(!compiled)
+   {
+      char log[1024];
+      getInfoLog(shader, sizeof(log), NULL, log);
+      DEBUG("Unable to compile the perspective shader: %s", log);
+      deleteObject(shader);
+      return 0;
+   }
+
+   return shader;
+}
+
+PerspectiveLayerRenderer::View::View() : x(0.0f), y(0.0f), tilt(0.0f), rotation(0.0f), zoom(1.0f)
+{
+}
+
+void PerspectiveLayerRenderer::loadFunctions()
+{
+   functionsLoaded = true;
+
+   const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+   if(extensions == NULL || strstr(extensions, "GL_ARB_shader_objects") == NULL || strstr(extensions, "GL_ARB_vertex_shader") == NULL
+         || strstr(extensions, "GL_ARB_fragment_shader") == NULL || strstr(extensions, "GL_ARB_multitexture") == NULL)
+   {
+      DEBUG("Shaders are not supported; maps will not be drawn in perspective.");
+      return;
+   }
+
+   createShaderObject = reinterpret_cast<PFNGLCREATESHADEROBJECTARBPROC>(GraphicsUtil::getProcAddress("glCreateShaderObjectARB"));
+   shaderSource = reinterpret_cast<PFNGLSHADERSOURCEARBPROC>(GraphicsUtil::getProcAddress("glShaderSourceARB"));
+   compileShader = reinterpret_cast<PFNGLCOMPILESHADERARBPROC>(GraphicsUtil::getProcAddress("glCompileShaderARB"));
+   createProgramObject = reinterpret_cast<PFNGLCREATEPROGRAMOBJECTARBPROC>(GraphicsUtil::getProcAddress("glCreateProgramObjectARB"));
+   attachObject = reinterpret_cast<PFNGLATTACHOBJECTARBPROC>(GraphicsUtil::getProcAddress("glAttachObjectARB"));
+   linkProgram = reinterpret_cast<PFNGLLINKPROGRAMARBPROC>(GraphicsUtil::getProcAddress("glLinkProgramARB"));
+   useProgramObject = reinterpret_cast<PFNGLUSEPROGRAMOBJECTARBPROC>(GraphicsUtil::getProcAddress("glUseProgramObjectARB"));
+   getObjectParameteriv = reinterpret_cast<PFNGLGETOBJECTPARAMETERIVARBPROC>(GraphicsUtil::getProcAddress("glGetObjectParameterivARB"));
+   getInfoLog = reinterpret_cast<PFNGLGETINFOLOGARBPROC>(GraphicsUtil::getProcAddress("glGetInfoLogARB"));
+   deleteObject = reinterpret_cast<PFNGLDELETEOBJECTARBPROC>(GraphicsUtil::getProcAddress("glDeleteObjectARB"));
+   getUniformLocation = reinterpret_cast<PFNGLGETUNIFORMLOCATIONARBPROC>(GraphicsUtil::getProcAddress("glGetUniformLocationARB"));
+   uniform1i = reinterpret_cast<PFNGLUNIFORM1IARBPROC>(GraphicsUtil::getProcAddress("glUniform1iARB"));
+   uniform2f = reinterpret_cast<PFNGLUNIFORM2FARBPROC>(GraphicsUtil::getProcAddress("glUniform2fARB"));
+   uniform4f = reinterpret_cast<PFNGLUNIFORM4FARBPROC>(GraphicsUtil::getProcAddress("glUniform4fARB"));
+   activeTexture = reinterpret_cast<PFNGLACTIVETEXTUREARBPROC>(GraphicsUtil::getProcAddress("glActiveTextureARB"));
+
+   if(createShaderObject == NULL || shaderSource == NULL || compileShader == NULL || createProgramObject == NULL || attachObject == NULL
+         || linkProgram == NULL || useProgramObject == NULL || getObjectParameteriv == NULL || getInfoLog == NULL || deleteObject == NULL
+         || getUniformLocation == NULL || uniform1i == NULL || uniform2f == NULL || uniform4f == NULL || activeTexture == NULL)
+   {
+      DEBUG("Shaders are missing functions; maps will not be drawn in perspective.");
+      return;
+   }
+
+   GLhandleARB vertexShader = buildShader(GL_VERTEX_SHADER_ARB, VERTEX_SHADER);
+   GLhandleARB fragmentShader = buildShader(GL_FRAGMENT_SHADER_ARB, FRAGMENT_SHADER);
+   if(vertexShader == 0 || fragmentShader == 0)
+   {
+      return;
+   }
+
+   program = createProgramObject();
+   attachObject(program, vertexShader);
+   attachObject(program, fragmentShader);
+   linkProgram(program);
+
+   // The shaders are freed along with the program, which lasts as long as the context
+   deleteObject(vertexShader);
+   deleteObject(fragmentShader);
+
+   GLint linked = 0;
+   getObjectParameteriv(program, GL_OBJECT_LINK_STATUS_ARB, &linked);
+   if(!linked)
+   {
+      char log[1024];
+      getInfoLog(program, sizeof(log), NULL, log);
+      DEBUG("Unable to link the perspective shader: %s", log);
+      deleteObject(program);
+      program = 0;
+      return;
+   }
+
+   tileTextureLocation = getUniformLocation(program, "tiles");
+   tilesetTextureLocation = getUniformLocation(program, "tileset");
+   tileScaleLocation = getUniformLocation(program, "tileScale");
+   tilesetRegionLocation = getUniformLocation(program, "tilesetRegion");
+
+   shadersSupported = true;
+   DEBUG("Shaders are supported; maps can be drawn in perspective.");
+}
+
+bool PerspectiveLayerRenderer::isSupported()
+{
+   if(!functionsLoaded)
+   {
+      loadFunctions();
+   }
+
+   return shadersSupported;
+}
+
+PerspectiveLayerRenderer::PerspectiveLayerRenderer(bool blended) : blended(blended), width(0), height(0), chunkSize(1),
+   textureWidth(0), textureHeight(0), chunksWide(0), tileTexture(0)
+{
+}
+
+void PerspectiveLayerRenderer::resize(int width, int height, int chunkSize)
+{
+   this->width = width;
+   this->height = height;
+   this->chunkSize = chunkSize;
+
+   chunksWide = (width + chunkSize - 1) / chunkSize;
+   const int chunksHigh = (height + chunkSize - 1) / chunkSize;
+   builtChunks.assign(chunksWide * chunksHigh, false);
+
+   textureWidth = 1;
+   while(textureWidth < width) textureWidth <<= 1;
+
+   textureHeight = 1;
+   while(textureHeight < height) textureHeight <<= 1;
+
+   // The texture is created again at the new size the next time a chunk is built
+   if(tileTexture != 0)
+   {
+      glDeleteTextures(1, &tileTexture);
+      tileTexture = 0;
+   }
+}
+
+bool PerspectiveLayerRenderer::isChunkBuilt(int chunkNum) const
+{
+   return builtChunks[chunkNum];
+}
+
+void PerspectiveLayerRenderer::getChunkArea(int chunkNum, int& left, int& top, int& chunkWidth, int& chunkHeight) const
+{
+   left = chunkNum % chunksWide * chunkSize;
+   top = chunkNum / chunksWide * chunkSize;
+   chunkWidth = std::min(chunkSize, width - left);
+   chunkHeight = std::min(chunkSize, height - top);
+}
+
+void PerspectiveLayerRenderer::create()
+{
+   // Every tile starts out empty, with no alpha
+   const std::vector<unsigned char> texels(textureWidth * textureHeight * 4, 0);
+
+   glGenTextures(1, &tileTexture);
+   GLState::bindTexture(tileTexture);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+
+   DEBUG("Created %dx%d perspective tile texture.", textureWidth, textureHeight);
+}
+
+void PerspectiveLayerRenderer::upload(int chunkNum, const std::vector<unsigned char>& texels)
+{
+   if(tileTexture == 0)
+   {
+      create();
+   }
+
+   int left, top, chunkWidth, chunkHeight;
+   getChunkArea(chunkNum, left, top, chunkWidth, chunkHeight);
+
+   GLState::bindTexture(tileTexture);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, left, top, chunkWidth, chunkHeight, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void PerspectiveLayerRenderer::buildChunk(int chunkNum, Tileset& tileset, const int* tiles, int stride)
+{
+   int left, top, chunkWidth, chunkHeight;
+   getChunkArea(chunkNum, left, top, chunkWidth, chunkHeight);
+
+   const int tilesetWidth = tileset.getWidth();
+   const int tileCount = tilesetWidth * tileset.getHeight();
+
+   std::vector<unsigned char> texels(chunkWidth * chunkHeight * 4, 0);
+   for(int y = 0; y < chunkHeight; ++y)
+   {
+      for(int x = 0; x < chunkWidth; ++x)
+      {
+         // Empty tiles, and tiles past the end of the tileset, are left without alpha so that nothing is drawn there
+         const int tileNum = tiles[y * stride + x];
+         if(tileNum < 0 || tileNum >= tileCount) continue;
+
+         unsigned char* texel = &texels[(y * chunkWidth + x) * 4];
+         texel[0] = static_cast<unsigned char>(std::min(tileNum % tilesetWidth, 255));
+         texel[1] = static_cast<unsigned char>(std::min(tileNum / tilesetWidth, 255));
+         texel[3] = 0xFF;
+      }
+   }
+
+   upload(chunkNum, texels);
+   builtChunks[chunkNum] = true;
+}
+
+void PerspectiveLayerRenderer::releaseChunk(int chunkNum)
+{
+   if(!builtChunks[chunkNum]) return;
+
+   int left, top, chunkWidth, chunkHeight;
+   getChunkArea(chunkNum, left, top, chunkWidth, chunkHeight);
+
+   upload(chunkNum, std::vector<unsigned char>(chunkWidth * chunkHeight * 4, 0));
+   builtChunks[chunkNum] = false;
+}
+
+void PerspectiveLayerRenderer::beginView(const View& view, int screenWidth, int screenHeight)
+{
+   // At a zoom of 1, the camera sits where a pixel of the map looking straight down is a pixel of the screen
+   const double distance = screenHeight / 2.0 / HALF_VIEW_TANGENT / std::max(view.zoom, 0.01f);
+   const double nearDistance = distance * NEAR_DISTANCE;
+   const double nearTop = nearDistance * HALF_VIEW_TANGENT;
+   const double nearRight = nearTop * screenWidth / screenHeight;
+
+   glMatrixMode(GL_PROJECTION);
+   glPushMatrix();
+   glLoadIdentity();
+   glFrustum(-nearRight, nearRight, -nearTop, nearTop, nearDistance, distance * FAR_DISTANCE);
+
+   // The map is turned around the point being looked at, flipped so its rows run down the screen, and then tilted away
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+   glLoadIdentity();
+   glTranslated(0.0, 0.0, -distance);
+   glRotatef(-std::min(std::max(view.tilt, 0.0f), MAX_TILT), 1.0f, 0.0f, 0.0f);
+   glScalef(1.0f, -1.0f, 1.0f);
+   glRotatef(view.rotation, 0.0f, 0.0f, 1.0f);
+   glTranslatef(-view.x, -view.y, 0.0f);
+}
+
+void PerspectiveLayerRenderer::endView()
+{
+   glMatrixMode(GL_PROJECTION);
+   glPopMatrix();
+   glMatrixMode(GL_MODELVIEW);
+   glPopMatrix();
+}
+
+void PerspectiveLayerRenderer::draw(Tileset& tileset) const
+{
+   if(tileTexture == 0 || !isSupported()) return;
+
+   const bool blendEnabled = GLState::isBlending();
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   if(blended)
+   {
+      GLState::setBlending(true);
+      GLState::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+   }
+
+   // The tile texture goes on the second texture unit, behind GLState's back, so the tileset stays bound on the first
+   activeTexture(GL_TEXTURE1_ARB);
+   glBindTexture(GL_TEXTURE_2D, tileTexture);
+   activeTexture(GL_TEXTURE0_ARB);
+   GLState::setTexturing(true);
+   tileset.bindTexture();
+
+   const TextureAtlas::Region& region = tileset.getTextureRegion();
+   useProgramObject(program);
+   uniform1i(tileTextureLocation, 1);
+   uniform1i(tilesetTextureLocation, 0);
+   uniform2f(tileScaleLocation, 1.0f / textureWidth, 1.0f / textureHeight);
+   uniform4f(tilesetRegionLocation, region.left, region.top,
+         (region.right - region.left) / tileset.getWidth(), (region.bottom - region.top) / tileset.getHeight());
+
+   const float right = float(width * TileEngine::TILE_SIZE);
+   const float bottom = float(height * TileEngine::TILE_SIZE);
+
+   GLState::countDrawCall();
+   glBegin(GL_QUADS);
+      glTexCoord2f(0.0f, 0.0f);
+      glVertex2f(0.0f, 0.0f);
+      glTexCoord2f(float(width), 0.0f);
+      glVertex2f(right, 0.0f);
+      glTexCoord2f(float(width), float(height));
+      glVertex2f(right, bottom);
+      glTexCoord2f(0.0f, float(height));
+      glVertex2f(0.0f, bottom);
+   glEnd();
+
+   useProgramObject(0);
+
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+PerspectiveLayerRenderer::~PerspectiveLayerRenderer()
+{
+   if(tileTexture != 0)
+   {
+      glDeleteTextures(1, &tileTexture);
+   }
+}
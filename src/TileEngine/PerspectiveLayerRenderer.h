@@ -0,0 +1,189 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef PERSPECTIVE_LAYER_RENDERER_H
+#define PERSPECTIVE_LAYER_RENDERER_H
+
+#include <vector>
+
+typedef unsigned int GLuint;
+
+class Tileset;
+
+/**
+ * Draws a layer of map tiles as a single textured plane seen through a perspective camera,
+ * which can tilt the map away from the screen, turn it, and zoom in and out on it (in the style of "Mode 7").
+ * This is meant for overworld and flight sequences, where the whole map is in view at once.
+ *
+ * The layer's tiles are kept in a texture with one texel per tile, holding the tile's column and row in the tileset
+ * (and no alpha where the layer is empty). The plane is drawn as one quad, and a fragment shader looks up the tile
+ * under each pixel in that texture and then samples the tile's pixel from the tileset, so the camera's cost is
+ * one draw call per layer whatever it shows. The chunks of the layer are copied into the texture as they are loaded.
+ *
+ * Animated tiles show their first frame. The renderer needs GLSL shaders and multitexturing from the driver;
+ * where those are missing, isSupported() is false and callers should draw the map flat instead.
+ */
+class PerspectiveLayerRenderer
+{
+   /** Whether or not the shader functions have been looked up, and the shaders built. */
+   static bool functionsLoaded;
+
+   /** Whether or not the driver supports the shaders, and they were built successfully. */
+   static bool shadersSupported;
+
+   /**
+    * Looks up the shader and multitexturing functions, and builds the shader program, if the driver supports them.
+    */
+   static void loadFunctions();
+
+   /** Whether or not the layer's tiles blend with the tiles drawn before them. */
+   bool blended;
+
+   /** The size of the layer (in tiles). */
+   int width, height;
+
+   /** The width and height of the layer's chunks (in tiles). */
+   int chunkSize;
+
+   /** The width and height of the tile texture, rounded up to powers of two. */
+   int textureWidth, textureHeight;
+
+   /** The width of the layer (in chunks). */
+   int chunksWide;
+
+   /** Whether or not each chunk of the layer (stored row by row) has been copied into the tile texture. */
+   std::vector<bool> builtChunks;
+
+   /** The texture holding the layer's tiles, or 0 if it hasn't been created. */
+   GLuint tileTexture;
+
+   /**
+    * Creates the tile texture, with every tile empty.
+    */
+   void create();
+
+   /**
+    * Copies the texels for a chunk of the layer into the tile texture, creating the texture if needed.
+    *
+    * @param chunkNum The number of the chunk.
+    * @param texels The texels of the chunk's tiles that are on the map, row by row.
+    */
+   void upload(int chunkNum, const std::vector<unsigned char>& texels);
+
+   /**
+    * Gets the area of the map that a chunk covers.
+    *
+    * @param chunkNum The number of the chunk.
+    * @param left The parameter used to return the x-coordinate of the chunk's top-left tile (in tiles).
+    * @param top The parameter used to return the y-coordinate of the chunk's top-left tile (in tiles).
+    * @param chunkWidth The parameter used to return the number of tile columns in the chunk that are on the map.
+    * @param chunkHeight The parameter used to return the number of tile rows in the chunk that are on the map.
+    */
+   void getChunkArea(int chunkNum, int& left, int& top, int& chunkWidth, int& chunkHeight) const;
+
+   /** Renderers can't be copied. */
+   PerspectiveLayerRenderer(const PerspectiveLayerRenderer&);
+
+   /** Renderers can't be copied. */
+   PerspectiveLayerRenderer& operator=(const PerspectiveLayerRenderer&);
+
+   public:
+      /** How the perspective camera looks at the map. */
+      struct View
+      {
+         /** The point on the map (in pixels) that the camera looks at, which is drawn in the middle of the screen. */
+         float x, y;
+
+         /** How far the map is tilted away from the screen (in degrees), from 0 (looking straight down) to under 90 (looking out at the horizon). */
+         float tilt;
+
+         /** How far the map is turned clockwise around the point that the camera looks at (in degrees). */
+         float rotation;
+
+         /** How much larger the map is drawn than it is when looking straight down at it from the default height. */
+         float zoom;
+
+         /**
+          * Constructor. The default view looks straight down at the top-left corner of the map, drawing it the size it is drawn flat.
+          */
+         View();
+      };
+
+      /**
+       * @return true iff the driver can draw layers in perspective.
+       */
+      static bool isSupported();
+
+      /**
+       * Constructor.
+       *
+       * @param blended true iff the layer is drawn over other layers, so that its tiles blend with the tiles behind them.
+       */
+      PerspectiveLayerRenderer(bool blended = false);
+
+      /**
+       * Sets the size of the layer, emptying the tile texture.
+       *
+       * @param width The width of the layer (in tiles).
+       * @param height The height of the layer (in tiles).
+       * @param chunkSize The width and height of the layer's chunks (in tiles).
+       */
+      void resize(int width, int height, int chunkSize);
+
+      /**
+       * @param chunkNum The number of a chunk in the layer.
+       *
+       * @return true iff the chunk has been copied into the tile texture.
+       */
+      bool isChunkBuilt(int chunkNum) const;
+
+      /**
+       * Copies the tiles of a chunk of the layer into the tile texture.
+       *
+       * @param chunkNum The number of the chunk.
+       * @param tileset The tileset that the tiles are drawn from.
+       * @param tiles The tiles of the chunk, row by row.
+       * @param stride The number of tiles in each row of the tiles.
+       */
+      void buildChunk(int chunkNum, Tileset& tileset, const int* tiles, int stride);
+
+      /**
+       * Empties the tiles of a chunk in the tile texture, such as when the chunk is released.
+       *
+       * @param chunkNum The number of the chunk.
+       */
+      void releaseChunk(int chunkNum);
+
+      /**
+       * Sets up the projection and modelview matrices to look at the map through a perspective camera.
+       * They must be put back with endView once the map has been drawn.
+       *
+       * @param view How the camera looks at the map.
+       * @param screenWidth The width of the screen (in pixels).
+       * @param screenHeight The height of the screen (in pixels).
+       */
+      static void beginView(const View& view, int screenWidth, int screenHeight);
+
+      /**
+       * Puts back the projection and modelview matrices that beginView replaced.
+       */
+      static void endView();
+
+      /**
+       * Draws the layer as a plane covering the map, with a single draw call.
+       * The perspective camera must have been set up with beginView.
+       *
+       * @param tileset The tileset that the tiles are drawn from.
+       */
+      void draw(Tileset& tileset) const;
+
+      /**
+       * Destructor. Releases the tile texture.
+       */
+      ~PerspectiveLayerRenderer();
+};
+
+#endif
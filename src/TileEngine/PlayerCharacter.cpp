@@ -9,6 +9,7 @@
 #include "TileEngine.h"
 #include "Pathfinder.h"
 #include "EntityGrid.h"
+#include "InputQueue.h"
 
 #include <SDL.h>
 
@@ -18,8 +19,11 @@ const int debugFlag = DEBUG_TILE_ENG;
 const std::string PlayerCharacter::WALKING_PREFIX = "walk";
 const std::string PlayerCharacter::STANDING_PREFIX = "stand";
 
+// The player walks twice as fast as the NPCs do by default (in pixels per millisecond)
+static const float PLAYER_MOVEMENT_SPEED = 0.2f;
+
 PlayerCharacter::PlayerCharacter(EntityGrid& map, const std::string& sheetName)
-                                              : Actor("player", sheetName, map, 0, 0, 1.0f, DOWN), active(false), cumulativeDistanceCovered(0)
+                                              : Actor("player", sheetName, map, 0, 0, PLAYER_MOVEMENT_SPEED, DOWN), active(false)
 {
 }
 
@@ -49,27 +53,30 @@ void PlayerCharacter::step(long timePassed)
    int xDirection = 0;
    int yDirection = 0;
 
-   Uint8 *keystate = SDL_GetKeyState(NULL);
-   if(!keystate[SDLK_UP] && keystate[SDLK_DOWN])
+   const bool up = InputQueue::isHeld(InputQueue::MOVE_UP);
+   const bool down = InputQueue::isHeld(InputQueue::MOVE_DOWN);
+   const bool left = InputQueue::isHeld(InputQueue::MOVE_LEFT);
+   const bool right = InputQueue::isHeld(InputQueue::MOVE_RIGHT);
+   if(!up && down)
    {
       // Positive velocity in the y-axis
       direction = DOWN;
       yDirection = 1;      
    }
-   else if(keystate[SDLK_UP] && !keystate[SDLK_DOWN])
+   else if(up && !down)
    {
       // Negative velocity in the y-axis
       direction = UP;
       yDirection = -1;
    }
 
-   if(!keystate[SDLK_LEFT] && keystate[SDLK_RIGHT])
+   if(!left && right)
    {
       // Positive velocity in the x-axis
       direction = direction == UP ? UP_RIGHT : direction == DOWN ? DOWN_RIGHT : RIGHT;
       xDirection = 1;
    }
-   else if(keystate[SDLK_LEFT] && !keystate[SDLK_RIGHT])
+   else if(left && !right)
    {
       // Negative velocity in the x-axis
       direction = direction == UP ? UP_LEFT : direction == DOWN ? DOWN_LEFT : LEFT;
@@ -81,17 +88,9 @@ void PlayerCharacter::step(long timePassed)
    if(moving)
    {
       flushOrders();
-	  /** \todo This algorithm is different from Actor_MoveOrder.cpp, synchronize. */
-	  cumulativeDistanceCovered += getMovementSpeed() * (timePassed / 5.0);
-      int distanceTraversed = 0;
-	  if(cumulativeDistanceCovered > 1.0)
-	  {
-		  distanceTraversed = floor(cumulativeDistanceCovered);
-		  cumulativeDistanceCovered -= distanceTraversed;
-	  }
       sprite->setAnimation(WALKING_PREFIX, direction);
       setDirection(direction);
-      entityGrid.moveToClosestPoint(this, xDirection, yDirection, distanceTraversed);
+      entityGrid.moveToClosestPoint(this, xDirection, yDirection, getStepDistance());
    }
    else if(isIdle())
    {
@@ -101,10 +100,18 @@ void PlayerCharacter::step(long timePassed)
    Actor::step(timePassed);
 }
 
-void PlayerCharacter::draw()
+void PlayerCharacter::proposeMovement()
+{
+   if(active)
+   {
+      Actor::proposeMovement();
+   }
+}
+
+void PlayerCharacter::draw(float interpolation)
 {
    if(active)
    {
-      Actor::draw();
+      Actor::draw(interpolation);
    }
 }
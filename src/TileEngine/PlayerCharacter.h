@@ -27,9 +27,6 @@ class PlayerCharacter : public Actor
    
    /** True iff the player entity is active on the map. */
    bool active;
-  
-   /** Total distance for the character to move. */
-   float cumulativeDistanceCovered;
 
    public:   
       /**
@@ -55,11 +52,18 @@ class PlayerCharacter : public Actor
        * as well as updating the location based on the speed.
        */
       void step(long timePassed);
+
+      /**
+       * Proposes the player character's next scripted move, if it is active on the map.
+       */
+      void proposeMovement();
    
       /**
        * Draws the player character at the playerLocation coordinates.
+       *
+       * @param interpolation How far (from 0 to 1) the frame falls between the last logic step and the next one.
        */
-      void draw();
+      void draw(float interpolation);
 };
 
 #endif
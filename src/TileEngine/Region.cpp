@@ -6,7 +6,7 @@
 
 #include "Region.h"
 #include "Map.h"
-#include <fstream>
+#include "AssetStream.h"
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_RES_LOAD;
@@ -22,8 +22,7 @@ void Region::load(const char* path)
     *       Find and report errors if the file isn't formed ideally.
     */
 
-   std::ifstream in;
-   in.open(path);
+   AssetStream in(path);
    if(!in.is_open())
    {
       T_T(std::string("Error opening file: ") + path);
@@ -74,9 +73,19 @@ Map* Region::getMap(const std::string& name)
    return areas[name];
 }
 
+void Region::prefetchNextMap()
+{
+}
+
 size_t Region::getSize()
 {
-   return sizeof(this);
+   size_t size = sizeof(*this);
+   for(std::map<std::string, Map*>::const_iterator i = areas.begin(); i != areas.end(); ++i)
+   {
+      size += i->second->getSize();
+   }
+
+   return size;
 }
 
 Region::~Region()
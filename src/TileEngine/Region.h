@@ -51,14 +51,20 @@ class Region : public Resource
       std::string getName();
 
       /** @return the starting map (first map loaded) for this Region. */
-      Map* getStartingMap();
+      virtual Map* getStartingMap();
 
       /**
        * @param name The name of the Map to retrieve.
        *
        * @return the Map with the specified name.
        */
-      Map* getMap(const std::string& name);
+      virtual Map* getMap(const std::string& name);
+
+      /**
+       * Loads the next map waiting to be prefetched, if the region loads its maps on demand.
+       * This is meant to be called once per frame, so that no single frame pays for more than one map.
+       */
+      virtual void prefetchNextMap();
 
       /**
        * Implementation of method in Resource class.
@@ -7,44 +7,220 @@
 #include "TileEngine.h"
 #include "ScriptEngine.h"
 #include "NPC.h"
+#include "NPCScript.h"
 #include "PlayerCharacter.h"
 #include "PlayerData.h"
 #include "Scheduler.h"
+#include "Task.h"
+#include "CompositeCondition.h"
 #include "Container.h"
 #include "GraphicsUtil.h"
+#include "ScreenTransition.h"
+#include "SpriteBatch.h"
+#include "Animation.h"
+#include "ExecutionStack.h"
+#include "InputQueue.h"
+#include "FrameProfiler.h"
+#include "EngineClock.h"
+#include "FrameCapture.h"
+#include "GPUPassTimer.h"
 #include "ResourceLoader.h"
 #include "Region.h"
 #include "Map.h"
 #include "Pathfinder.h"
 #include "DebugConsoleWindow.h"
+#include "TextBox.h"
+#include "PerformanceStats.h"
+#include "ProfileServer.h"
+#include "ScriptSampler.h"
+#include "ObjectPool.h"
+#include "MemoryTracker.h"
+#include "Sound.h"
 #include "DialogueController.h"
 #include "OpenGLTTF.h"
 #include "stdlib.h"
+#include <iomanip>
+#include <sstream>
 
 #include "DebugUtils.h"
 const int debugFlag = DEBUG_TILE_ENG;
 
 const int TileEngine::TILE_SIZE = 32;
 
+// Actors are indexed by the tiles they have reserved, but are drawn up to a tile away from them mid-step,
+// with sprites that can stand a tile taller than the actor
+static const int ACTOR_DRAW_MARGIN = 2 * TileEngine::TILE_SIZE;
+
+// Lights carried by actors can reach into view from a few tiles away
+static const int ACTOR_LIGHT_MARGIN = 8 * TileEngine::TILE_SIZE;
+
+// Wider than the draw margin, so that idle actors are woken (and animating) before they come into view
+static const int ACTOR_WAKE_MARGIN = 4 * TileEngine::TILE_SIZE;
+
+// Wider than the wake margin by the longest run between two waypoints, so that an actor skipping ahead
+// along its path is back to moving a pixel at a time before it can come into view
+static const int ACTOR_DETAIL_MARGIN = 8 * TileEngine::TILE_SIZE;
+
+// A pure idle function that doesn't give an NPC anything to do (or ask for a wait) is run again about every few frames, instead of on every step
+static const long DEFAULT_THINK_INTERVAL = 100;
+
+// Often enough to follow what is going on, without redrawing the GUI on every frame just for the numbers
+static const long PERF_HUD_REFRESH_INTERVAL = 250;
+
+// The resource types listed by /perf, and the names that they are listed under
+static const ResourceLoader::ResourceType RESOURCE_TYPES[] = { ResourceLoader::SOUND, ResourceLoader::REGION, ResourceLoader::TILESET, ResourceLoader::MUSIC, ResourceLoader::SPRITESHEET, ResourceLoader::IMAGE, ResourceLoader::FONT };
+static const char* RESOURCE_TYPE_NAMES[] = { "sounds", "regions", "tilesets", "music", "sprites", "images", "fonts" };
+static const int RESOURCE_TYPE_COUNT = sizeof(RESOURCE_TYPES) / sizeof(RESOURCE_TYPES[0]);
+
+class TileEngine::ActorIdleCondition : public WaitCondition
+{
+   /** The actors on the current map. */
+   const ActorTable& actorTable;
+
+   /** The handle of the actor being waited on. */
+   const ActorTable::ActorHandle handle;
+
+   public:
+      ActorIdleCondition(const ActorTable& actorTable, ActorTable::ActorHandle handle) : actorTable(actorTable), handle(handle)
+      {
+      }
+
+      bool isMet() const
+      {
+         // An actor that has left the map will never finish its orders, so the script isn't left waiting on it
+         const ActorTable::ActorId id = actorTable.resolve(handle);
+         return id == ActorTable::INVALID_ACTOR || actorTable.getCurrentOrder(id) == NULL;
+      }
+};
+
+class TileEngine::ActorArrivalCondition : public WaitCondition
+{
+   /** The actors on the current map. */
+   const ActorTable& actorTable;
+
+   /** The handle of the actor being waited on. */
+   const ActorTable::ActorHandle handle;
+
+   /** The point that the actor should reach (in pixels). */
+   const shapes::Point2D point;
+
+   /** The square of the distance from the point that counts as reaching it. */
+   const int squaredRadius;
+
+   public:
+      ActorArrivalCondition(const ActorTable& actorTable, ActorTable::ActorHandle handle, const shapes::Point2D& point, int radius) :
+         actorTable(actorTable), handle(handle), point(point), squaredRadius(radius * radius)
+      {
+      }
+
+      bool isMet() const
+      {
+         const ActorTable::ActorId id = actorTable.resolve(handle);
+         if(id == ActorTable::INVALID_ACTOR) return true;
+
+         const shapes::Point2D& location = actorTable.getLocation(id);
+         const int xDistance = location.x - point.x;
+         const int yDistance = location.y - point.y;
+         return xDistance * xDistance + yDistance * yDistance <= squaredRadius;
+      }
+};
+
+class TileEngine::FlagCondition : public WaitCondition
+{
+   /** The player's flags. */
+   const FlagStore& flags;
+
+   /** The key of the flag being waited on. */
+   const FlagStore::Key key;
+
+   /** The kind of value being waited for. */
+   const FlagStore::Type type;
+
+   /** The boolean or number being waited for. */
+   const int value;
+
+   /** The string being waited for. */
+   const std::string stringValue;
+
+   public:
+      FlagCondition(const FlagStore& flags, FlagStore::Key key, FlagStore::Type type, int value, const std::string& stringValue) :
+         flags(flags), key(key), type(type), value(value), stringValue(stringValue)
+      {
+      }
+
+      bool isMet() const
+      {
+         switch(type)
+         {
+            case FlagStore::BOOL:
+               return flags.getBool(key) == (value != 0);
+            case FlagStore::INT:
+               return flags.getType(key) == FlagStore::INT && flags.getInt(key) == value;
+            case FlagStore::STRING:
+               return flags.getType(key) == FlagStore::STRING && flags.getString(key) == stringValue;
+            case FlagStore::UNSET:
+            default:
+               return flags.getType(key) == FlagStore::UNSET;
+         }
+      }
+};
+
 TileEngine::TileEngine(ExecutionStack& executionStack, const std::string& chapterName, const std::string& playerDataPath)
-: GameState(executionStack), xMapOffset(0), yMapOffset(0)
+: GameState(executionStack), currRegion(NULL), departedMap(NULL), perfHudAge(0), stepPathQueries(0), stepPathExpansions(0), cameraHeld(false), cameraFocus(0, 0), perspectiveEnabled(false), perspectiveFollowsCamera(false), minimapArea(0, 0, -1, -1), aiTime(0)
 {
+   MemoryTracker::Scope memoryScope(MemoryTracker::TILE_ENGINE);
+   aiStates.start();
+
+   // Everything loaded from here until the first map is entered is traced as needed to start the chapter
+   ResourceLoader::beginChapter(chapterName);
+
    playerActor = new PlayerCharacter(entityGrid, "npc1");
    scriptEngine = new ScriptEngine(*this, playerData, scheduler);
    dialogue = new DialogueController(*top, scheduler, *scriptEngine);
    consoleWindow = new edwt::DebugConsoleWindow(top, top->getWidth(), top->getHeight() * 0.2);
+
+   perfHud = new edwt::TextBox();
+   perfHud->setOpaque(false);
+   perfHud->setEditable(false);
+   perfHud->setFocusable(false);
+   perfHud->setVisible(false);
+   perfHud->setWidth(top->getWidth() / 2);
+   top->add(perfHud, 0, 0);
+
+   Sound::setEmitterLocator(&TileEngine::locateSoundEmitter, this);
+   EventBus::subscribe(EventBus::DEBUG_COMMAND, &TileEngine::debugCommandPosted, this);
+   EventBus::subscribe(EventBus::SAVE_WRITTEN, &TileEngine::saveWritten, this);
    
-   time = SDL_GetTicks();
    loadPlayerData(playerDataPath);
    startChapter(chapterName);
 }
 
 TileEngine::~TileEngine()
 {
+   // A transition started by a script can't outlive the scheduler its task signals,
+   // and whatever state comes next shouldn't be left behind a covered screen
+   GraphicsUtil::getInstance()->getTransition()->stop();
+
+   // Sounds still playing from actors stay where they were last heard once the actors are gone
+   Sound::setEmitterLocator(NULL, NULL);
+
+   EventBus::unsubscribe(EventBus::DEBUG_COMMAND, &TileEngine::debugCommandPosted, this);
+   EventBus::unsubscribe(EventBus::SAVE_WRITTEN, &TileEngine::saveWritten, this);
+
+   delete perfHud;
+   GraphicsUtil::getInstance()->setAnimating(consoleWindow, false);
    delete consoleWindow;
    delete dialogue;
+   clearNPCPool();
+
    delete scriptEngine;
    delete playerActor;
+
+   minimap.setMap(NULL);
+   if(currRegion != NULL)
+   {
+      currRegion->release();
+   }
 }
 
 void TileEngine::loadPlayerData(const std::string& path)
@@ -75,21 +251,64 @@ void TileEngine::dialogueSay(const char* speech, Task* task)
    dialogue->say(speech, task);
 }
 
+void TileEngine::dialogueConverse(const std::vector<ConversationLine>& conversation, Task* task)
+{
+   if(conversation.empty())
+   {
+      task->signal();
+      return;
+   }
+
+   // Only the last line of the conversation has anything waiting on it
+   for(std::vector<ConversationLine>::const_iterator line = conversation.begin(); line != conversation.end(); ++line)
+   {
+      Task* lineTask = line + 1 == conversation.end() ? task : NULL;
+      if(line->narrated)
+      {
+         dialogue->narrate(line->speech.c_str(), lineTask);
+      }
+      else
+      {
+         dialogue->say(line->speech.c_str(), lineTask);
+      }
+   }
+}
+
 bool TileEngine::setRegion(const std::string& regionName, const std::string& mapName)
 {
    DEBUG("Loading region: %s", regionName.c_str());
-   currRegion = ResourceLoader::getRegion(regionName);
+   ResourceLoader::beginMapChange();
+   Region* newRegion = ResourceLoader::getRegion(regionName);
+   newRegion->acquire();
+
+   // The minimap may still be baking one of the last region's maps, which can't be freed until it is done
+   minimap.setMap(NULL);
+   if(currRegion != NULL) currRegion->release();
+   currRegion = newRegion;
    DEBUG("Loaded region: %s", currRegion->getName().c_str());
 
    setMap(mapName);
 
+   // The maps of the last region may be freed along with it, so their tiles can't wait for the next step
+   releaseDepartedMap();
+
    DEBUG("Running map script: %s/%s", regionName.c_str(), entityGrid.getName().c_str());
    return true;
 }
 
 void TileEngine::setMap(std::string mapName)
 {
+   ResourceLoader::beginMapChange();
    playerActor->removeFromMap();
+   const Map* previousMap = entityGrid.getMapData();
+
+   // The pooled NPCs' functions live in the last map's script environment, which the next map's scripts don't share
+   clearNPCPool();
+   scriptEngine->enterMapEnvironment();
+
+   // Lights are placed by the map's script, so they don't carry over to the next map
+   lightMap.clear();
+   particles.clear();
 
    DEBUG("Setting map...");
    if(!mapName.empty())
@@ -105,20 +324,62 @@ void TileEngine::setMap(std::string mapName)
    }
 
    DEBUG("Map set to: %s", mapName.c_str());
+   playerData.setLocation(currRegion->getName(), mapName);
+
+   // Map transitions are where the game autosaves
+   playerData.autosave();
+
+   if(previousMap != NULL && previousMap != entityGrid.getMapData())
+   {
+      // The region keeps its maps around, but only the current map needs its tiles loaded.
+      // Stopping the old map's chunk loader and freeing its tiles is left to the next step, so it isn't added to the transition's frame
+      releaseDepartedMap();
+      departedMap = previousMap;
+   }
 
    recalculateMapOffsets();
+   streamMapChunks();
+   minimap.setMap(entityGrid.getMapData());
+
+   // The maps that the player has gone on to from here before start loading now, while this one is played
+   ResourceLoader::enterMap(currRegion->getName() + '/' + mapName);
+
+   // The screen is changing anyway, so the garbage left behind by the last map is collected now instead of mid-scene
+   scriptEngine->collectAllGarbage();
 }
 
 void TileEngine::recalculateMapOffsets()
 {
-   const int mapPixelWidth = entityGrid.getWidth() * TILE_SIZE;
-   const int mapPixelHeight = entityGrid.getHeight() * TILE_SIZE;
+   camera.setBounds(entityGrid.getWidth() * TILE_SIZE, entityGrid.getHeight() * TILE_SIZE, GraphicsUtil::width, GraphicsUtil::height);
+}
+
+void TileEngine::followPlayer(const shapes::Point2D& playerLocation)
+{
+   if(cameraHeld)
+   {
+      camera.centerOn(cameraFocus.x, cameraFocus.y);
+      return;
+   }
+
+   camera.centerOn(playerLocation.x + playerActor->getWidth() / 2, playerLocation.y + playerActor->getHeight() / 2);
+}
+
+void TileEngine::streamMapChunks()
+{
+   const Map* map = entityGrid.getMapData();
+   if(map == NULL) return;
+
+   map->streamChunks(camera.getVisibleTiles());
+}
 
-   xMapOffset = mapPixelWidth < GraphicsUtil::width ? 
-              (GraphicsUtil::width - mapPixelWidth) >> 1 : 0;
+void TileEngine::releaseDepartedMap()
+{
+   if(departedMap != NULL && departedMap != entityGrid.getMapData())
+   {
+      departedMap->releaseChunks();
+   }
 
-   yMapOffset = mapPixelHeight < GraphicsUtil::height ?
-              (GraphicsUtil::height - mapPixelHeight) >> 1 : 0;
+   departedMap = NULL;
 }
 
 void TileEngine::toggleDebugConsole()
@@ -128,6 +389,7 @@ void TileEngine::toggleDebugConsole()
    {
       // Hide the console window
       consoleWindow->setVisible(false);
+      GraphicsUtil::getInstance()->setAnimating(consoleWindow, false);
    }
    else
    {
@@ -135,19 +397,50 @@ void TileEngine::toggleDebugConsole()
       top->moveToTop(consoleWindow);
       consoleWindow->setVisible(true);
       consoleWindow->requestFocus();
+
+      // Output from the worker threads is picked up by the console's logic, so it runs while the console is open
+      GraphicsUtil::getInstance()->setAnimating(consoleWindow, true);
    }
+
+   GraphicsUtil::getInstance()->invalidateGUI();
 }
 
-NPC* TileEngine::addNPC(const std::string& npcName, const std::string& spritesheetName, shapes::Point2D npcLocation)
+void TileEngine::clearNPCPool()
+{
+   for(std::multimap<std::string, NPC*>::iterator pooledNPC = npcPool.begin(); pooledNPC != npcPool.end(); ++pooledNPC)
+   {
+      delete pooledNPC->second;
+   }
+
+   npcPool.clear();
+}
+
+std::string TileEngine::getNPCPoolKey(const std::string& npcName) const
+{
+   // The same path that the NPC's script is loaded from, so that a pooled NPC only ever comes back with its own script
+   return currRegion->getName() + '/' + entityGrid.getName() + '/' + npcName;
+}
+
+NPC* TileEngine::spawnNPC(const std::string& npcName, const std::string& spritesheetName, const shapes::Point2D& npcLocation)
 {
    NPC* npcToAdd = NULL;
    
    if(entityGrid.isAreaFree(npcLocation, 32, 32))
    {
-      npcToAdd = new NPC(*scriptEngine, scheduler, npcName, spritesheetName,
-                                 entityGrid, currRegion->getName(),
-                                 npcLocation.x, npcLocation.y);
-      npcList[npcName] = npcToAdd;
+      std::multimap<std::string, NPC*>::iterator pooledNPC = npcPool.find(getNPCPoolKey(npcName));
+      if(pooledNPC != npcPool.end())
+      {
+         npcToAdd = pooledNPC->second;
+         npcPool.erase(pooledNPC);
+         npcToAdd->respawn(spritesheetName, npcLocation.x, npcLocation.y);
+      }
+      else
+      {
+         npcToAdd = new NPC(*scriptEngine, scheduler, npcName, spritesheetName,
+                                    entityGrid, currRegion->getName(),
+                                    npcLocation.x, npcLocation.y);
+      }
+
       entityGrid.addActor(npcToAdd, npcLocation);
    }
    else
@@ -158,173 +451,1196 @@ NPC* TileEngine::addNPC(const std::string& npcName, const std::string& spriteshe
    return npcToAdd;
 }
 
+NPC* TileEngine::addNPC(const std::string& npcName, const std::string& spritesheetName, shapes::Point2D npcLocation)
+{
+   return spawnNPC(npcName, spritesheetName, npcLocation);
+}
+
+void TileEngine::addNPCs(const std::vector<NPCDefinition>& definitions, std::vector<NPC*>& npcs)
+{
+   npcs.reserve(npcs.size() + definitions.size());
+   for(std::vector<NPCDefinition>::const_iterator definition = definitions.begin(); definition != definitions.end(); ++definition)
+   {
+      npcs.push_back(spawnNPC(definition->name, definition->spritesheetName, definition->location));
+   }
+
+   DEBUG("Added a batch of %d NPCs (%d waiting in the pool).", static_cast<int>(definitions.size()), static_cast<int>(npcPool.size()));
+}
+
+void TileEngine::removeNPC(NPC* npc)
+{
+   const std::string npcName = npc->getName();
+   if(npc->despawn())
+   {
+      npcPool.insert(std::make_pair(getNPCPoolKey(npcName), npc));
+   }
+   else
+   {
+      DEBUG("NPC %s is in the middle of running its script, so it is deleted instead of pooled.", npcName.c_str());
+      entityGrid.removeActor(npc);
+      delete npc;
+   }
+}
+
 NPC* TileEngine::getNPC(const std::string& npcName) const
 {
-   std::map<std::string, NPC*>::const_iterator npcIterator = npcList.find(npcName);
-   if(npcIterator != npcList.end())
+   const ActorTable& actorTable = entityGrid.getActorTable();
+   const ActorTable::ActorId id = actorTable.find(npcName);
+   if(id == ActorTable::INVALID_ACTOR)
    {
-      return npcIterator->second;
+      return NULL;
    }
 
-   return NULL;
+   // Every actor in the table but the player character is an NPC
+   Actor* actor = actorTable.getActor(id);
+   return actor == playerActor ? NULL : static_cast<NPC*>(actor);
 }
 
-PlayerCharacter* TileEngine::getPlayerCharacter() const
+ActorTable::ActorHandle TileEngine::getActorHandle(const Actor* actor) const
 {
-   return playerActor;
+   // Actors that have been removed from the map (such as pooled NPCs) have no handle
+   const ActorTable& actorTable = entityGrid.getActorTable();
+   const ActorTable::ActorId id = actorTable.getId(actor);
+   if(id == ActorTable::INVALID_ACTOR)
+   {
+      return ActorTable::INVALID_HANDLE;
+   }
+
+   return actorTable.getHandle(id);
 }
 
-void TileEngine::stepNPCs(long timePassed)
+bool TileEngine::locateSoundEmitter(void* context, unsigned int emitter, int& x, int& y)
+{
+   const ActorTable& actorTable = static_cast<TileEngine*>(context)->entityGrid.getActorTable();
+   const ActorTable::ActorId id = actorTable.resolve(emitter);
+   if(id == ActorTable::INVALID_ACTOR)
+   {
+      return false;
+   }
+
+   const Actor* actor = actorTable.getActor(id);
+   const shapes::Point2D& location = actorTable.getLocation(id);
+   x = location.x + actor->getWidth() / 2;
+   y = location.y + actor->getHeight() / 2;
+   return true;
+}
+
+NPC* TileEngine::resolveNPC(ActorTable::ActorHandle handle) const
+{
+   Actor* actor = resolveActor(handle);
+   return actor == playerActor ? NULL : static_cast<NPC*>(actor);
+}
+
+Actor* TileEngine::resolveActor(ActorTable::ActorHandle handle) const
 {
-   std::map<std::string, NPC*>::iterator iter;
+   const ActorTable& actorTable = entityGrid.getActorTable();
+   const ActorTable::ActorId id = actorTable.resolve(handle);
+   return id == ActorTable::INVALID_ACTOR ? NULL : actorTable.getActor(id);
+}
 
-   for(iter = npcList.begin(); iter != npcList.end(); ++iter)
+void TileEngine::moveActors(const std::vector<ActorMove>& moves)
+{
+   for(std::vector<ActorMove>::const_iterator move = moves.begin(); move != moves.end(); ++move)
    {
-      NPC* currNPC = iter->second;
-      currNPC->step(timePassed);
+      move->actor->move(move->destination.x, move->destination.y);
    }
 }
 
-void TileEngine::drawNPCs()
+void TileEngine::setActorAnimations(const std::vector<Actor*>& actors, const std::vector<std::string>& animationNames)
 {
-   std::map<std::string, NPC*>::iterator iter;
+   const bool sharedAnimation = animationNames.size() == 1;
+   for(unsigned int i = 0; i < actors.size(); ++i)
+   {
+      actors[i]->setAnimation(animationNames[sharedAnimation ? 0 : i]);
+   }
+}
 
-   for(iter = npcList.begin(); iter != npcList.end(); ++iter)
+void TileEngine::getActorLocations(const std::vector<Actor*>& actors, std::vector<shapes::Point2D>& locations) const
+{
+   locations.reserve(locations.size() + actors.size());
+   for(std::vector<Actor*>::const_iterator actor = actors.begin(); actor != actors.end(); ++actor)
    {
-      NPC* currNPC = iter->second;
-      currNPC->draw();
+      locations.push_back(*actor != NULL ? (*actor)->getLocation() : shapes::Point2D(0, 0));
    }
 }
 
-void TileEngine::draw()
+void TileEngine::findActorsInArea(const shapes::Rectangle& area, std::vector<Actor*>& actors) const
 {
-   GraphicsUtil::getInstance()->setOffset(xMapOffset, yMapOffset);
-      // Draw the map and NPCs against an offset (to center all the map elements)
-      if(entityGrid.getMapData() != NULL)
-      {
-         entityGrid.draw();
-      }
-      else
+   entityGrid.findActorsInArea(area, actors);
+}
+
+void TileEngine::findActorsInRadius(const shapes::Point2D& center, int radius, std::vector<Actor*>& actors) const
+{
+   entityGrid.findActorsInRadius(center, radius, actors);
+}
+
+Actor* TileEngine::findNearestActor(const shapes::Point2D& point, int maxRadius, const Actor* excludedActor) const
+{
+   return entityGrid.findNearestActor(point, maxRadius, excludedActor);
+}
+
+bool TileEngine::addObstacle(const shapes::Point2D& location, int width, int height)
+{
+   return entityGrid.addObstacle(location, width, height);
+}
+
+bool TileEngine::removeObstacle(const shapes::Point2D& location, int width, int height)
+{
+   return entityGrid.removeObstacle(location, width, height);
+}
+
+TriggerZones::TriggerId TileEngine::addTrigger(const shapes::Rectangle& area)
+{
+   return entityGrid.getTriggerZones().add(area);
+}
+
+TriggerZones::TriggerId TileEngine::addTrigger(const std::string& name)
+{
+   shapes::Rectangle area(0, 0, -1, -1);
+   if(!entityGrid.findTriggerVolume(name, area))
+   {
+      DEBUG("Map has no trigger zone named %s", name.c_str());
+      return TriggerZones::INVALID_TRIGGER;
+   }
+
+   return entityGrid.getTriggerZones().add(area);
+}
+
+void TileEngine::removeTrigger(TriggerZones::TriggerId trigger)
+{
+   entityGrid.getTriggerZones().remove(trigger);
+}
+
+int TileEngine::waitForTrigger(TriggerZones::TriggerId trigger)
+{
+   Task* task = Task::getNextTask(scheduler);
+   if(!entityGrid.getTriggerZones().wait(trigger, task))
+   {
+      // The event is already there to be taken, so the task is finished without anything waiting on it
+      task->signal();
+      return 0;
+   }
+
+   return scheduler.block(task);
+}
+
+int TileEngine::waitUntilIdle(const Actor* actor)
+{
+   return scheduler.waitUntil(new ActorIdleCondition(entityGrid.getActorTable(), getActorHandle(actor)));
+}
+
+int TileEngine::waitUntilIdle(const std::vector<Actor*>& actors, bool waitForAll)
+{
+   CompositeCondition* condition = new CompositeCondition(waitForAll ? CompositeCondition::ALL : CompositeCondition::ANY);
+   for(std::vector<Actor*>::const_iterator actor = actors.begin(); actor != actors.end(); ++actor)
+   {
+      // Actors that have left the map are idle already, so they can be left out when waiting on all of them
+      if(*actor != NULL || !waitForAll)
       {
-         GraphicsUtil::getInstance()->clearBuffer();
+         const ActorTable::ActorHandle handle = *actor != NULL ? getActorHandle(*actor) : ActorTable::INVALID_HANDLE;
+         condition->add(new ActorIdleCondition(entityGrid.getActorTable(), handle));
       }
+   }
 
-      drawNPCs();
-      playerActor->draw();
-   GraphicsUtil::getInstance()->resetOffset();
+   return scheduler.waitUntil(condition);
+}
+
+int TileEngine::waitUntilArrived(const Actor* actor, const shapes::Point2D& point, int radius)
+{
+   return scheduler.waitUntil(new ActorArrivalCondition(entityGrid.getActorTable(), getActorHandle(actor), point, radius));
 }
 
-bool TileEngine::step()
+int TileEngine::waitUntilFlag(FlagStore::Key key, FlagStore::Type type, int value, const std::string& stringValue)
 {
-   long prevTime = time;
-   time = SDL_GetTicks();
+   return scheduler.waitUntil(new FlagCondition(playerData.getFlags(), key, type, value, stringValue));
+}
 
-   long timePassed = time - prevTime;
-   if(timePassed > 32)
+bool TileEngine::takeTriggerEvent(TriggerZones::TriggerId trigger, Actor*& actor, bool& entered)
+{
+   TriggerZones::Event event;
+   if(!entityGrid.getTriggerZones().takeEvent(trigger, event))
    {
-      timePassed = 32;
+      return false;
    }
 
-   bool done = false;
-   scheduler.runThreads(timePassed);
+   const ActorTable& actorTable = entityGrid.getActorTable();
+   const ActorTable::ActorId id = actorTable.resolve(event.actor);
+   actor = id == ActorTable::INVALID_ACTOR ? NULL : actorTable.getActor(id);
+   entered = event.entered;
+   return true;
+}
 
-   handleInputEvents(done);
+PlayerCharacter* TileEngine::getPlayerCharacter() const
+{
+   return playerActor;
+}
 
-   playerActor->step(timePassed);
+FlagStore& TileEngine::getFlags()
+{
+   return playerData.getFlags();
+}
 
-   entityGrid.step(timePassed);
+void TileEngine::resolveMovements()
+{
+   playerActor->proposeMovement();
 
-   stepNPCs(timePassed);
+   // Parked actors have no orders, so they have no moves to propose
+   const ActorTable& actorTable = entityGrid.getActorTable();
+   for(int i = 0; i < actorTable.getAwakeCount(); ++i)
+   {
+      Actor* actor = actorTable.getActor(actorTable.getAwakeActor(i));
+      if(actor != playerActor)
+      {
+         actor->proposeMovement();
+      }
+   }
 
-   return !done;
+   entityGrid.resolveMovements();
 }
 
-void TileEngine::handleInputEvents(bool& finishState)
+void TileEngine::stepNPCs(long timePassed)
 {
-   SDL_Event event;
+   ActorTable& actorTable = entityGrid.getActorTable();
+   const shapes::Rectangle activeArea = camera.getVisibleArea(ACTOR_WAKE_MARGIN);
 
-   while(SDL_PollEvent(&event))
+   std::vector<Actor*> nearbyActors;
+   entityGrid.findActorsInArea(activeArea, nearbyActors);
+   for(std::vector<Actor*>::const_iterator iter = nearbyActors.begin(); iter != nearbyActors.end(); ++iter)
    {
-      switch (event.type)
+      actorTable.wake(actorTable.getId(*iter));
+   }
+
+   for(int i = 0; i < actorTable.getAwakeCount(); ++i)
+   {
+      Actor* actor = actorTable.getActor(actorTable.getAwakeActor(i));
+      if(actor != playerActor)
       {
-         case SDL_USEREVENT:
-         {
-            switch(event.user.code)
-            {
-               case DEBUG_CONSOLE_EVENT:
-               {
-                  std::string* script = (std::string*)event.user.data1;
-                  scriptEngine->runScriptString(*script);
-
-                  // This assumes that, once the debug event is consumed here, it is not used anymore
-                  delete script;
-               }
-            }
-         }
-         case SDL_KEYDOWN:
+         actor->step(timePassed);
+      }
+   }
+
+   // Park the actors that are out of sight with nothing to do, until they are given orders or come near the screen,
+   // and let the busy ones further out skip ahead along their paths on the next step.
+   // Parking moves the last awake actor into the parked actor's place, so the list is walked from the back.
+   const shapes::Rectangle detailArea = camera.getVisibleArea(ACTOR_DETAIL_MARGIN);
+   for(int i = actorTable.getAwakeCount() - 1; i >= 0; --i)
+   {
+      const ActorTable::ActorId id = actorTable.getAwakeActor(i);
+      Actor* actor = actorTable.getActor(id);
+      if(actor == playerActor)
+      {
+         continue;
+      }
+
+      const shapes::Rectangle footprint(actor->getLocation(), actor->getWidth(), actor->getHeight());
+      actorTable.setCoarse(id, !footprint.intersects(detailArea));
+      if(actor->isIdle() && !footprint.intersects(activeArea))
+      {
+         actorTable.park(id);
+      }
+   }
+}
+
+void TileEngine::stepNPCAI(long timePassed)
+{
+   aiTime += timePassed;
+
+   std::list<AIStatePool::Job*> finishedJobs;
+   aiStates.collectCompletedJobs(finishedJobs);
+
+   for(std::list<AIStatePool::Job*>::iterator iter = finishedJobs.begin(); iter != finishedJobs.end(); ++iter)
+   {
+      AIStatePool::Job* job = *iter;
+      npcsThinking.erase(job->npcName);
+
+      // The NPC may have been given something else to do (such as by being activated) while its function ran
+      NPC* npc = getNPC(job->npcName);
+      if(npc != NULL && npc->isIdle() && !job->failed)
+      {
+         for(std::vector<AIStatePool::Order>::const_iterator order = job->orders.begin(); order != job->orders.end(); ++order)
          {
-            switch(event.key.keysym.sym)
+            if(order->type == AIStatePool::Order::MOVE)
             {
-               case SDLK_SPACE:
-               {
-                  dialogue->setFastModeEnabled(true);
-                  dialogue->nextLine();
-                  return;
-               }
-               case SDLK_ESCAPE:
-               {
-                  finishState = true;
-                  return;
-               }
-               case SDLK_BACKQUOTE:
-               {
-                  toggleDebugConsole();
-                  return;
-               }
-               default:
-               {
-                  break;
-               }
+               npc->move(order->x, order->y);
             }
-            break;
-         }
-         case SDL_KEYUP:
-         {
-            switch(event.key.keysym.sym)
+            else
             {
-               case SDLK_SPACE:
-               {
-                  if(dialogue->hasDialogue())
-                  {
-                     dialogue->setFastModeEnabled(false);
-                  }
-                  else
-                  {
-                     action();
-                  }
-                  return;
-               }
-               default:
-               {
-                  break;
-               }
+               npc->stand(order->direction);
             }
-            break;
-         }
-         case SDL_QUIT:
-         {
-            finishState = true;
-            return;
-         }
-         default:
-         {
-            break;
          }
       }
-   }
 
-   // If the tile engine didn't consume this event, then propagate to the generic input handling
-   handleEvent(event);
+      long waitTime = job->waitTime;
+      if(waitTime <= 0 && (job->failed || job->orders.empty()))
+      {
+         waitTime = DEFAULT_THINK_INTERVAL;
+      }
+
+      nextThinkTimes[job->npcName] = aiTime + waitTime;
+      delete job;
+   }
+
+   const shapes::Point2D playerLocation = playerActor->getLocation();
+
+   const ActorTable& actorTable = entityGrid.getActorTable();
+   for(ActorTable::ActorId id = 0; id < actorTable.size(); ++id)
+   {
+      Actor* actor = actorTable.getActor(id);
+      if(actor == playerActor)
+      {
+         continue;
+      }
+
+      NPC* npc = static_cast<NPC*>(actor);
+      const std::string npcName = npc->getName();
+      NPCScript* script = npc->getScript();
+      if(!script->hasPureIdle() || !npc->isIdle() || npcsThinking.find(npcName) != npcsThinking.end())
+      {
+         continue;
+      }
+
+      std::map<std::string, long>::const_iterator nextThinkTime = nextThinkTimes.find(npcName);
+      if(nextThinkTime != nextThinkTimes.end() && nextThinkTime->second > aiTime)
+      {
+         continue;
+      }
+
+      const std::string scriptPath = script->getName();
+      if(!aiStates.hasScript(scriptPath))
+      {
+         aiStates.addScript(scriptPath, script->getPureIdleBytecode());
+      }
+
+      const shapes::Point2D location = npc->getLocation();
+
+      AIStatePool::Job* job = new AIStatePool::Job();
+      job->npcName = npcName;
+      job->scriptPath = scriptPath;
+      job->x = location.x;
+      job->y = location.y;
+      job->time = aiTime;
+      job->playerX = playerLocation.x;
+      job->playerY = playerLocation.y;
+      aiStates.queueJob(job);
+
+      npcsThinking.insert(npcName);
+   }
+
+   aiStates.work();
+}
+
+void TileEngine::drawNPCs(float interpolation)
+{
+   std::vector<Actor*> visibleActors;
+   entityGrid.findActorsInArea(camera.getVisibleArea(ACTOR_DRAW_MARGIN), visibleActors);
+
+   std::vector<Actor*>::iterator iter;
+
+   for(iter = visibleActors.begin(); iter != visibleActors.end(); ++iter)
+   {
+      // The player character is drawn over the NPCs
+      if(*iter != playerActor)
+      {
+         (*iter)->draw(interpolation);
+      }
+   }
+}
+
+void TileEngine::drawLighting(float interpolation)
+{
+   std::vector<Actor*> litActors;
+   entityGrid.findActorsInArea(camera.getVisibleArea(ACTOR_LIGHT_MARGIN), litActors);
+
+   for(std::vector<Actor*>::iterator iter = litActors.begin(); iter != litActors.end(); ++iter)
+   {
+      (*iter)->drawLight(lightMap, interpolation);
+   }
+
+   // The lights multiply whatever is on the screen, so the batched sprites have to be out first
+   GraphicsUtil::getInstance()->getSpriteBatch()->flush();
+   lightMap.draw(camera.getXOffset(), camera.getYOffset(), camera.getVisibleArea());
+}
+
+LightMap& TileEngine::getLightMap()
+{
+   return lightMap;
+}
+
+ParticleSystem& TileEngine::getParticles()
+{
+   return particles;
+}
+
+void TileEngine::drawPerspective()
+{
+   PerspectiveLayerRenderer::View view = perspectiveView;
+   if(perspectiveFollowsCamera)
+   {
+      const shapes::Rectangle visibleArea = camera.getVisibleArea();
+      view.x = (visibleArea.left + visibleArea.right + 1) / 2.0f;
+      view.y = (visibleArea.top + visibleArea.bottom + 1) / 2.0f;
+   }
+
+   // The plane doesn't reach the edges of the screen once it is tilted or turned
+   GraphicsUtil* graphics = GraphicsUtil::getInstance();
+   graphics->clearBuffer();
+   entityGrid.getMapData()->drawPerspective(view, graphics->getWidth(), graphics->getHeight());
+}
+
+void TileEngine::setPerspective(const PerspectiveLayerRenderer::View& view, bool followCamera)
+{
+   perspectiveView = view;
+   perspectiveFollowsCamera = followCamera;
+   perspectiveEnabled = true;
+}
+
+void TileEngine::clearPerspective()
+{
+   perspectiveEnabled = false;
+}
+
+void TileEngine::showMinimap(const shapes::Rectangle& area)
+{
+   minimapArea = area;
+}
+
+void TileEngine::hideMinimap()
+{
+   minimapArea = shapes::Rectangle(0, 0, -1, -1);
+}
+
+void TileEngine::holdCamera(const shapes::Point2D& point)
+{
+   cameraHeld = true;
+   cameraFocus = point;
+}
+
+void TileEngine::releaseCamera()
+{
+   cameraHeld = false;
+}
+
+void TileEngine::draw()
+{
+   PROFILE_ZONE("TileEngine::draw");
+   MemoryTracker::Scope memoryScope(MemoryTracker::TILE_ENGINE);
+
+   // Actors are drawn part of the way between their last two logic steps, depending on when the frame falls
+   const float interpolation = executionStack.getFramePacer().getInterpolation();
+
+   if(perspectiveEnabled && entityGrid.getMapData() != NULL && PerspectiveLayerRenderer::isSupported())
+   {
+      drawPerspective();
+      return;
+   }
+
+   // The camera follows the player where the player is drawn, so that the player doesn't shake against the scrolling map
+   followPlayer(playerActor->getDrawLocation(interpolation));
+   GraphicsUtil::getInstance()->setOffset(camera.getXOffset(), camera.getYOffset());
+      // Draw the map and NPCs against an offset (to center all the map elements)
+      if(entityGrid.getMapData() != NULL)
+      {
+         entityGrid.draw(camera.getVisibleArea());
+      }
+      else
+      {
+         GraphicsUtil::getInstance()->clearBuffer();
+      }
+
+      drawNPCs(interpolation);
+      playerActor->draw(interpolation);
+
+      // Layers over the actors (such as roofs) can only be drawn once the batched obstacle and actor sprites are out
+      const Map* map = entityGrid.getMapData();
+      if(map != NULL && map->hasUpperLayers())
+      {
+         GraphicsUtil::getInstance()->getSpriteBatch()->flush();
+         map->drawUpperLayers(camera.getVisibleTiles());
+      }
+
+      // Particles are drawn straight from their own arrays, over the roofs so that the weather falls on everything
+      if(particles.getParticleCount() > 0)
+      {
+         GraphicsUtil::getInstance()->getSpriteBatch()->flush();
+         particles.draw();
+      }
+
+      if(lightMap.isEnabled())
+      {
+         drawLighting(interpolation);
+      }
+
+      // The debug overlay goes over everything else on the map, so that the tiles under the actors and roofs show through
+      if(entityGrid.getDebugOverlay() != EntityGrid::NO_OVERLAY)
+      {
+         GraphicsUtil::getInstance()->getSpriteBatch()->flush();
+         entityGrid.drawDebugOverlay();
+      }
+   GraphicsUtil::getInstance()->resetOffset();
+
+   if(minimapArea.right >= minimapArea.left && minimapArea.bottom >= minimapArea.top)
+   {
+      GraphicsUtil::getInstance()->getSpriteBatch()->flush();
+      minimap.draw(minimapArea.left, minimapArea.top, minimapArea.right - minimapArea.left + 1, minimapArea.bottom - minimapArea.top + 1,
+            entityGrid.getActorTable(), playerActor);
+   }
+}
+
+bool TileEngine::step(long timePassed)
+{
+   PROFILE_ZONE("TileEngine::step");
+   MemoryTracker::Scope memoryScope(MemoryTracker::TILE_ENGINE);
+
+   bool done = false;
+   playerData.addPlayTime(timePassed);
+   const unsigned long pathQueries = entityGrid.getPathQueryCount();
+   const unsigned long pathExpansions = entityGrid.getPathExpansionCount();
+
+   entityGrid.processPathRequests();
+
+   // The sounds that finished since the last step signal their tasks before the scripts waiting on them are run
+   Sound::processFinishedChannels();
+   scheduler.runThreads(timePassed);
+
+   handleInputEvents(done);
+
+   resolveMovements();
+
+   Animation::advanceSharedClock(timePassed);
+   entityGrid.getActorTable().integrateMovement(timePassed);
+
+   playerActor->step(timePassed);
+   followPlayer(playerActor->getLocation());
+
+   entityGrid.step(timePassed, camera.getVisibleTiles());
+
+   stepNPCs(timePassed);
+
+   stepNPCAI(timePassed);
+
+   // Emitters that follow actors spawn from where the actors have moved to
+   const shapes::Rectangle visibleArea = camera.getVisibleArea();
+   particles.step(timePassed, entityGrid.getActorTable(), visibleArea);
+
+   // Sounds on the map are heard from the middle of the screen, and are moved together once everyone has moved
+   Sound::setListener((visibleArea.left + visibleArea.right) / 2, (visibleArea.top + visibleArea.bottom) / 2);
+   Sound::updatePositions();
+
+   streamMapChunks();
+   releaseDepartedMap();
+
+   if(currRegion != NULL)
+   {
+      currRegion->prefetchNextMap();
+   }
+
+   stepPathQueries = entityGrid.getPathQueryCount() - pathQueries;
+   stepPathExpansions = entityGrid.getPathExpansionCount() - pathExpansions;
+   refreshPerformanceHud(timePassed);
+   streamPerformanceCounters();
+
+   return !done;
+}
+
+void TileEngine::idle(long timeAvailable)
+{
+   scriptEngine->stepGarbageCollector(timeAvailable);
+}
+
+void TileEngine::describePerformance(const std::string& subsystem, std::vector<std::string>& lines) const
+{
+   const bool all = subsystem.empty();
+
+   if(all || subsystem == "fps")
+   {
+      std::stringstream line;
+      line << std::fixed << std::setprecision(1) << PerformanceStats::getFramesPerSecond() << " fps, "
+           << PerformanceStats::getLastFrameTime() << " ms last frame";
+      lines.push_back(line.str());
+   }
+
+   if(all || subsystem == "gl")
+   {
+      std::stringstream line;
+      line << "GL: " << PerformanceStats::getLastFrameDrawCalls() << " draw calls, "
+           << PerformanceStats::getLastFrameTextureBinds() << " texture binds last frame, scene at "
+           << static_cast<int>(GraphicsUtil::getInstance()->getSceneScale() * 100.0f + 0.5f) << "% resolution";
+      lines.push_back(line.str());
+   }
+
+   if(all || subsystem == "gpu")
+   {
+      GPUPassTimer::describe(lines);
+   }
+
+   if(all || subsystem == "threads")
+   {
+      const Scheduler::ThreadCounts counts = scheduler.countThreads();
+      std::stringstream line;
+      line << "Threads: " << counts.ready << " ready, " << counts.waiting << " waiting, " << counts.sleeping << " sleeping, "
+           << counts.suspended << " suspended, " << counts.starting << " starting, " << counts.finished << " finished";
+      lines.push_back(line.str());
+   }
+
+   if(all || subsystem == "lua")
+   {
+      std::stringstream line;
+      line << "Lua heap: " << scriptEngine->getHeapSize() << "KB (peak " << scriptEngine->getPeakHeapSize() << "KB)";
+      lines.push_back(line.str());
+   }
+
+   if(all || subsystem == "memory")
+   {
+      MemoryTracker::describe(lines);
+   }
+
+   if(all || subsystem == "resources")
+   {
+      std::stringstream line;
+      line << "Resources:";
+      for(int i = 0; i < RESOURCE_TYPE_COUNT; ++i)
+      {
+         line << (i == 0 ? " " : ", ") << RESOURCE_TYPE_NAMES[i] << ' ' << ResourceLoader::getMemoryUsed(RESOURCE_TYPES[i]) / 1024 << "KB";
+      }
+
+      lines.push_back(line.str());
+   }
+
+   if(all || subsystem == "particles")
+   {
+      std::stringstream line;
+      line << "Particles: " << particles.getParticleCount() << " live";
+      lines.push_back(line.str());
+   }
+
+   if(all || subsystem == "paths")
+   {
+      std::stringstream line;
+      line << "Paths: " << stepPathQueries << " queries, " << stepPathExpansions << " expansions last step";
+      lines.push_back(line.str());
+   }
+
+   if(all || subsystem == "pools")
+   {
+      // Once the game has settled, the live counts should stay under the capacities, and nothing should go to the heap
+      const std::vector<ObjectPool*>& pools = ObjectPool::getPools();
+      std::stringstream line;
+      line << "Pools:";
+      for(std::vector<ObjectPool*>::const_iterator iter = pools.begin(); iter != pools.end(); ++iter)
+      {
+         line << (iter == pools.begin() ? " " : ", ") << (*iter)->getName() << ' ' << (*iter)->getLiveCount() << '/' << (*iter)->getCapacity()
+              << " (" << (*iter)->getAllocationCount() << " allocated, " << (*iter)->getHeapAllocationCount() << " from the heap)";
+      }
+
+      lines.push_back(line.str());
+   }
+}
+
+void TileEngine::refreshPerformanceHud(long timePassed)
+{
+   if(!perfHud->isVisible()) return;
+
+   perfHudAge += timePassed;
+   if(perfHudAge < PERF_HUD_REFRESH_INTERVAL) return;
+   perfHudAge = 0;
+
+   std::vector<std::string> lines;
+   describePerformance("", lines);
+
+   std::string text;
+   for(std::vector<std::string>::const_iterator iter = lines.begin(); iter != lines.end(); ++iter)
+   {
+      if(!text.empty()) text += '\n';
+      text += *iter;
+   }
+
+   perfHud->setText(text);
+   GraphicsUtil::getInstance()->invalidateGUI();
+}
+
+void TileEngine::streamPerformanceCounters() const
+{
+   if(!ProfileServer::isStreaming()) return;
+
+   const Scheduler::ThreadCounts counts = scheduler.countThreads();
+   ProfileServer::addCounter("threads ready", counts.ready);
+   ProfileServer::addCounter("threads waiting", counts.waiting);
+   ProfileServer::addCounter("threads sleeping", counts.sleeping);
+   ProfileServer::addCounter("threads suspended", counts.suspended);
+
+   const ScriptAllocator& allocator = scriptEngine->getAllocator();
+   ProfileServer::addCounter("Lua heap KB", scriptEngine->getHeapSize());
+   ProfileServer::addCounter("Lua peak heap KB", scriptEngine->getPeakHeapSize());
+   ProfileServer::addCounter("Lua allocations", allocator.getLastFrameAllocations());
+
+   ProfileServer::addCounter("particles", particles.getParticleCount());
+   ProfileServer::addCounter("path queries", stepPathQueries);
+   ProfileServer::addCounter("path expansions", stepPathExpansions);
+}
+
+bool TileEngine::runDebugCommand(const std::string& command)
+{
+   std::stringstream words(command);
+   std::string commandName;
+   std::string action;
+   words >> commandName >> action;
+
+   if(commandName == "/gc")
+   {
+      int percent;
+      if(action == "show")
+      {
+         std::stringstream line;
+         const ScriptAllocator& allocator = scriptEngine->getAllocator();
+         line << "Lua heap: " << scriptEngine->getHeapSize() << "KB (peak " << scriptEngine->getPeakHeapSize() << "KB), "
+              << allocator.getLastFrameAllocations() << " allocations (" << allocator.getLastFrameBytesAllocated() / 1024 << "KB) last frame";
+         if(allocator.getMemoryLimit() > 0)
+         {
+            line << ", limit " << allocator.getMemoryLimit() / 1024 << "KB";
+         }
+
+         consoleWindow->addLine(line.str());
+      }
+      else if(action == "collect")
+      {
+         scriptEngine->collectAllGarbage();
+         std::stringstream line;
+         line << "Collected Lua garbage; the heap is down to " << scriptEngine->getHeapSize() << "KB.";
+         consoleWindow->addLine(line.str());
+      }
+      else if(action == "pause" && words >> percent)
+      {
+         scriptEngine->setGarbageCollectorPause(percent);
+         consoleWindow->addLine("Set the garbage collector's pause.");
+      }
+      else if(action == "stepmul" && words >> percent)
+      {
+         scriptEngine->setGarbageCollectorStepMultiplier(percent);
+         consoleWindow->addLine("Set the garbage collector's step multiplier.");
+      }
+      else if(action == "limit" && words >> percent && percent >= 0)
+      {
+         scriptEngine->getAllocator().setMemoryLimit(static_cast<size_t>(percent) * 1024);
+         consoleWindow->addLine(percent > 0 ? "Set the script memory limit." : "Removed the script memory limit.");
+      }
+      else
+      {
+         consoleWindow->addLine("Usage: /gc show|collect|pause <percent>|stepmul <percent>|limit <KB>");
+      }
+
+      GraphicsUtil::getInstance()->invalidateGUI();
+      return true;
+   }
+
+   if(commandName == "/frames")
+   {
+      if(action == "start")
+      {
+         FrameProfiler::setEnabled(true);
+         consoleWindow->addLine("Profiling frames.");
+      }
+      else if(action == "stop")
+      {
+         FrameProfiler::setEnabled(false);
+         consoleWindow->addLine("Stopped profiling frames.");
+      }
+      else if(action == "show")
+      {
+         std::vector<std::string> lines;
+         FrameProfiler::describe(lines);
+         for(std::vector<std::string>::const_iterator iter = lines.begin(); iter != lines.end(); ++iter)
+         {
+            consoleWindow->addLine(*iter);
+         }
+      }
+      else if(action == "overlay")
+      {
+         // The overlay has nothing to show unless frames are being profiled
+         FrameProfiler::setOverlayVisible(!FrameProfiler::isOverlayVisible());
+         FrameProfiler::setEnabled(FrameProfiler::isEnabled() || FrameProfiler::isOverlayVisible());
+         consoleWindow->addLine(FrameProfiler::isOverlayVisible() ? "Showing the frame profile overlay." : "Hid the frame profile overlay.");
+      }
+      else if(action == "dump")
+      {
+         std::string path;
+         if(!(words >> path))
+         {
+            path = "frame_trace.json";
+         }
+
+         consoleWindow->addLine(FrameProfiler::writeChromeTrace(path) ? "Wrote frame trace to " + path : "Unable to write frame trace to " + path);
+      }
+      else if(action == "hitches")
+      {
+         // Like the command line's --hitches, the second before each hitch is written unless told otherwise
+         double threshold = 0;
+         int frameCount = 60;
+         std::string thresholdText;
+         words >> thresholdText;
+         if(thresholdText != "off")
+         {
+            std::istringstream(thresholdText) >> threshold;
+            words >> frameCount;
+         }
+
+         FrameProfiler::setHitchDetection(threshold, frameCount, "hitch-");
+
+         std::ostringstream reply;
+         if(FrameProfiler::getHitchThreshold() > 0)
+         {
+            reply << "Writing the frames before each frame over " << FrameProfiler::getHitchThreshold() << " ms to hitch-<number>.json.";
+         }
+         else
+         {
+            reply << "Stopped watching for hitches.";
+         }
+
+         consoleWindow->addLine(reply.str());
+      }
+      else
+      {
+         consoleWindow->addLine("Usage: /frames start|stop|show|overlay|dump [path]|hitches <ms> [frames]|off");
+      }
+
+      GraphicsUtil::getInstance()->invalidateGUI();
+      return true;
+   }
+
+   if(commandName == "/capture")
+   {
+      FrameCapture* frameCapture = GraphicsUtil::getInstance()->getFrameCapture();
+      if(action == "start")
+      {
+         std::string directory;
+         if(!(words >> directory))
+         {
+            directory = ".";
+         }
+
+         consoleWindow->addLine(frameCapture->start(directory) ? "Capturing frames into " + directory : "Unable to capture frames into " + directory);
+      }
+      else if(action == "stop")
+      {
+         frameCapture->stop();
+
+         std::ostringstream summary;
+         summary << "Captured " << frameCapture->getFrameCount() << " frames (" << frameCapture->getDroppedCount() << " dropped).";
+         consoleWindow->addLine(summary.str());
+      }
+      else
+      {
+         consoleWindow->addLine("Usage: /capture start [directory]|stop");
+      }
+
+      GraphicsUtil::getInstance()->invalidateGUI();
+      return true;
+   }
+
+   if(commandName == "/time")
+   {
+      double scale;
+      int frames;
+      if(action == "scale" && words >> scale && scale > 0)
+      {
+         EngineClock::setTimeScale(scale);
+         std::ostringstream line;
+         line << "Running the game at " << scale << " times its speed.";
+         consoleWindow->addLine(line.str());
+      }
+      else if(action == "pause")
+      {
+         EngineClock::setPaused(true);
+         consoleWindow->addLine("Paused the game's time.");
+      }
+      else if(action == "resume")
+      {
+         EngineClock::setPaused(false);
+         consoleWindow->addLine("Resumed the game's time.");
+      }
+      else if(action == "step")
+      {
+         if(!(words >> frames) || frames < 1)
+         {
+            frames = 1;
+         }
+
+         // Stepping pauses the game, so that it stops again once the frames have run
+         EngineClock::setPaused(true);
+         EngineClock::stepFrames(frames);
+
+         std::ostringstream line;
+         line << "Stepping " << frames << (frames == 1 ? " frame." : " frames.");
+         consoleWindow->addLine(line.str());
+      }
+      else
+      {
+         consoleWindow->addLine("Usage: /time scale <factor>|pause|resume|step [frames]");
+      }
+
+      GraphicsUtil::getInstance()->invalidateGUI();
+      return true;
+   }
+
+   if(commandName == "/grid")
+   {
+      static const char* const OVERLAY_NAMES[] = { "off", "occupancy", "expansions", "cache", "congestion" };
+      static const EntityGrid::DebugOverlay OVERLAYS[] = { EntityGrid::NO_OVERLAY, EntityGrid::OCCUPANCY_OVERLAY,
+            EntityGrid::EXPANSION_OVERLAY, EntityGrid::PATH_CACHE_OVERLAY, EntityGrid::CONGESTION_OVERLAY };
+      static const int OVERLAY_COUNT = sizeof(OVERLAYS) / sizeof(OVERLAYS[0]);
+
+      int overlayIndex = 0;
+      while(overlayIndex < OVERLAY_COUNT && action != OVERLAY_NAMES[overlayIndex])
+      {
+         ++overlayIndex;
+      }
+
+      if(overlayIndex < OVERLAY_COUNT)
+      {
+         entityGrid.setDebugOverlay(OVERLAYS[overlayIndex]);
+         consoleWindow->addLine(overlayIndex == 0 ? "Stopped drawing the grid overlay." : "Drawing the " + action + " overlay over the map.");
+      }
+      else
+      {
+         consoleWindow->addLine("Usage: /grid occupancy|expansions|cache|congestion|off");
+      }
+
+      GraphicsUtil::getInstance()->invalidateGUI();
+      return true;
+   }
+
+   if(commandName == "/sample")
+   {
+      if(action == "start")
+      {
+         int interval;
+         if(!(words >> interval) || interval <= 0)
+         {
+            interval = ScriptSampler::DEFAULT_INTERVAL;
+         }
+
+         ScriptSampler::setEnabled(true, interval);
+         consoleWindow->addLine("Sampling scripts.");
+      }
+      else if(action == "stop")
+      {
+         ScriptSampler::setEnabled(false);
+         consoleWindow->addLine("Stopped sampling scripts.");
+      }
+      else if(action == "show")
+      {
+         std::vector<std::string> lines;
+         ScriptSampler::describe(lines);
+         for(std::vector<std::string>::const_iterator iter = lines.begin(); iter != lines.end(); ++iter)
+         {
+            consoleWindow->addLine(*iter);
+         }
+      }
+      else if(action == "dump")
+      {
+         std::string path;
+         if(!(words >> path))
+         {
+            path = "script_samples.folded";
+         }
+
+         consoleWindow->addLine(ScriptSampler::writeCollapsedStacks(path) ? "Wrote script samples to " + path : "Unable to write script samples to " + path);
+      }
+      else
+      {
+         consoleWindow->addLine("Usage: /sample start [instructions]|stop|show|dump [path]");
+      }
+
+      GraphicsUtil::getInstance()->invalidateGUI();
+      return true;
+   }
+
+   if(commandName == "/perf")
+   {
+      if(action == "show")
+      {
+         std::string subsystem;
+         words >> subsystem;
+
+         std::vector<std::string> lines;
+         describePerformance(subsystem, lines);
+         for(std::vector<std::string>::const_iterator iter = lines.begin(); iter != lines.end(); ++iter)
+         {
+            consoleWindow->addLine(*iter);
+         }
+
+         if(lines.empty())
+         {
+            consoleWindow->addLine("Usage: /perf show [fps|gl|gpu|threads|lua|memory|resources|paths|pools]");
+         }
+      }
+      else if(action == "overlay")
+      {
+         const bool visible = !perfHud->isVisible();
+         perfHud->setVisible(visible);
+
+         // Fill the display in on the next step instead of leaving it blank until the next refresh
+         perfHudAge = PERF_HUD_REFRESH_INTERVAL;
+
+         // The graph of frame times is the frame profiler's overlay, which has nothing to show unless frames are being profiled
+         FrameProfiler::setOverlayVisible(visible);
+         FrameProfiler::setEnabled(FrameProfiler::isEnabled() || visible);
+         consoleWindow->addLine(visible ? "Showing the performance display." : "Hid the performance display.");
+      }
+      else
+      {
+         consoleWindow->addLine("Usage: /perf show [fps|gl|gpu|threads|lua|memory|resources|paths|pools]|overlay");
+      }
+
+      GraphicsUtil::getInstance()->invalidateGUI();
+      return true;
+   }
+
+   if(commandName != "/profile")
+   {
+      return false;
+   }
+
+   SchedulerProfiler& profiler = scheduler.getProfiler();
+   if(action == "start")
+   {
+      profiler.setEnabled(true);
+      consoleWindow->addLine("Profiling scheduler threads.");
+   }
+   else if(action == "stop")
+   {
+      profiler.setEnabled(false);
+      consoleWindow->addLine("Stopped profiling scheduler threads.");
+   }
+   else if(action == "show")
+   {
+      std::vector<std::string> lines;
+      profiler.describe(lines);
+      for(std::vector<std::string>::const_iterator iter = lines.begin(); iter != lines.end(); ++iter)
+      {
+         consoleWindow->addLine(*iter);
+      }
+   }
+   else if(action == "dump")
+   {
+      std::string path;
+      if(!(words >> path))
+      {
+         path = "scheduler_trace.json";
+      }
+
+      consoleWindow->addLine(profiler.writeChromeTrace(path) ? "Wrote scheduler trace to " + path : "Unable to write scheduler trace to " + path);
+   }
+   else
+   {
+      consoleWindow->addLine("Usage: /profile start|stop|show|dump [path]");
+   }
+
+   GraphicsUtil::getInstance()->invalidateGUI();
+   return true;
+}
+
+void TileEngine::debugCommandPosted(void* context, const EventBus::Event& event)
+{
+   TileEngine* tileEngine = static_cast<TileEngine*>(context);
+   const std::string line(event.text);
+   if(!tileEngine->runDebugCommand(line))
+   {
+      tileEngine->scriptEngine->runScriptString(line);
+   }
+}
+
+void TileEngine::saveWritten(void* context, const EventBus::Event& event)
+{
+   TileEngine* tileEngine = static_cast<TileEngine*>(context);
+   tileEngine->consoleWindow->addLine(std::string(event.value ? "Saved the game to " : "Unable to save the game to ") + event.text);
+}
+
+bool TileEngine::advancePausedFrame()
+{
+   GraphicsUtil::getInstance()->stepGUI();
+
+   bool done = false;
+   InputQueue::Input input;
+   while(!done && InputQueue::poll(input))
+   {
+      if(input.event.type == SDL_QUIT)
+      {
+         done = true;
+      }
+      else if(input.action == InputQueue::TOGGLE_CONSOLE && input.pressed)
+      {
+         toggleDebugConsole();
+      }
+      else
+      {
+         // The rest of the game's actions are left alone, since nothing is stepped to answer them
+         handleEvent(input.event);
+      }
+   }
+
+   return !done;
+}
+
+void TileEngine::handleInputEvents(bool& finishState)
+{
+   InputQueue::Input input;
+   while(!finishState && InputQueue::poll(input))
+   {
+      if(input.event.type == SDL_QUIT)
+      {
+         finishState = true;
+         continue;
+      }
+
+      switch(input.action)
+      {
+         case InputQueue::CONFIRM:
+         {
+            if(input.pressed)
+            {
+               dialogue->setFastModeEnabled(true);
+               dialogue->nextLine();
+            }
+            else if(dialogue->hasDialogue())
+            {
+               dialogue->setFastModeEnabled(false);
+            }
+            else
+            {
+               action();
+            }
+
+            continue;
+         }
+         case InputQueue::CANCEL:
+         {
+            if(input.pressed)
+            {
+               finishState = true;
+               continue;
+            }
+
+            break;
+         }
+         case InputQueue::TOGGLE_CONSOLE:
+         {
+            if(input.pressed)
+            {
+               toggleDebugConsole();
+               continue;
+            }
+
+            break;
+         }
+         default:
+         {
+            break;
+         }
+      }
+
+      // If the tile engine didn't consume this event, then propagate to the generic input handling
+      handleEvent(input.event);
+   }
 }
 
 void TileEngine::action()
@@ -11,11 +11,22 @@
 
 #include "Scheduler.h"
 #include "EntityGrid.h"
+#include "Camera.h"
 #include "PlayerData.h"
+#include "LightMap.h"
+#include "Minimap.h"
+#include "ParticleSystem.h"
+#include "PerspectiveLayerRenderer.h"
+#include "AIStatePool.h"
+#include "EventBus.h"
 
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
+class Actor;
+class Map;
 class NPC;
 class ScriptEngine;
 class PlayerCharacter;
@@ -26,6 +37,7 @@ class Task;
 namespace edwt
 {
    class DebugConsoleWindow;
+   class TextBox;
 };
 
 /**
@@ -39,8 +51,9 @@ namespace edwt
  */
 class TileEngine: public GameState
 {
-   /** Time since the first logic step of the TileEngine instance. */
-   unsigned long time;
+   class ActorIdleCondition;
+   class ActorArrivalCondition;
+   class FlagCondition;
 
    /** The current region that the player is in. */
    Region* currRegion;
@@ -48,9 +61,24 @@ class TileEngine: public GameState
    /** The current map that the player is in. */
    EntityGrid entityGrid;
 
+   /** The map that the player left on the last map change, whose tiles are released on the next step, or NULL if there is none. */
+   const Map* departedMap;
+
    /** The debug console window to be used for diagnostics. */
    edwt::DebugConsoleWindow* consoleWindow;
 
+   /** The heads-up display of live performance numbers, shown with the /perf overlay command. */
+   edwt::TextBox* perfHud;
+
+   /** The time (in milliseconds) since the performance display was last refreshed. */
+   long perfHudAge;
+
+   /** The number of paths asked for during the last step. */
+   unsigned long stepPathQueries;
+
+   /** The number of tiles expanded by the main thread's path searches during the last step. */
+   unsigned long stepPathExpansions;
+
    /** Controller for dialogue and narrations. */
    DialogueController* dialogue;
 
@@ -66,14 +94,77 @@ class TileEngine: public GameState
    /** The actor representing the player character on the map */
    PlayerCharacter* playerActor;
 
-   /** A list of all NPCs in the map, identified by their names. */
-   std::map<std::string, NPC*> npcList;
+   /** The camera that determines which part of the map is drawn, and where. */
+   Camera camera;
+
+   /** true iff the camera is held on a point (such as by a cutscene), instead of following the player. */
+   bool cameraHeld;
+
+   /** The point (in pixels) that the camera is held on, if it is held. */
+   shapes::Point2D cameraFocus;
+
+   /** The lighting drawn over the current map. */
+   LightMap lightMap;
+
+   /** The weather and effects drawn on the current map. */
+   ParticleSystem particles;
+
+   /** How the map is seen when it is drawn in perspective. */
+   PerspectiveLayerRenderer::View perspectiveView;
+
+   /** Whether or not the map is drawn in perspective (where the driver supports it) instead of flat. */
+   bool perspectiveEnabled;
+
+   /** Whether or not the perspective camera looks at the middle of the flat camera's view, instead of a fixed point. */
+   bool perspectiveFollowsCamera;
+
+   /** The miniature of the current map, with the actors marked on it. */
+   Minimap minimap;
+
+   /** The area of the screen that the minimap is drawn over (with inclusive edge coordinates in pixels), which is empty while it is hidden. */
+   shapes::Rectangle minimapArea;
+
+   /** The worker Lua states that run the pure idle functions of NPCs. */
+   AIStatePool aiStates;
 
-   /** The x-offset to draw elements of the map at. */
-   int xMapOffset;
+   /** The names of the NPCs whose pure idle functions are being run. */
+   std::set<std::string> npcsThinking;
 
-   /** The y-offset to draw elements of the map at. */
-   int yMapOffset;
+   /** The time (on the aiTime clock) at which each NPC's pure idle function can run next, by NPC name. */
+   std::map<std::string, long> nextThinkTimes;
+
+   /** The time (in milliseconds) that has passed in the tile engine, which the pure idle functions run on. */
+   long aiTime;
+
+   /**
+    * The NPCs that have been despawned, kept with their scripts and sprites loaded so that they can be spawned again cheaply.
+    * They are filed under the region, map and name that their scripts were loaded for.
+    * The pool only holds NPCs of the current map, since their scripts' functions go with the map's script environment.
+    */
+   std::multimap<std::string, NPC*> npcPool;
+
+   /**
+    * Deletes the NPCs waiting in the pool.
+    */
+   void clearNPCPool();
+
+   /**
+    * @param npcName The name of an NPC.
+    *
+    * @return The key that an NPC with this name on the current map is pooled under.
+    */
+   std::string getNPCPoolKey(const std::string& npcName) const;
+
+   /**
+    * Spawns an NPC on the current map, reusing a pooled NPC with the same name if there is one.
+    *
+    * @param npcName The name of the npc to spawn
+    * @param spritesheetName The name of the spritesheet to draw the NPC with
+    * @param npcLocation The location where we spawn the NPC
+    *
+    * @return The spawned NPC (or NULL if it could not be placed in the map).
+    */
+   NPC* spawnNPC(const std::string& npcName, const std::string& spritesheetName, const shapes::Point2D& npcLocation);
    
    /**
     * Loads new player data.
@@ -94,6 +185,76 @@ class TileEngine: public GameState
     */
    void toggleDebugConsole();
 
+   /**
+    * Runs a command entered into the debug console that is handled by the engine itself
+    * instead of the scripting engine. The commands are:
+    *
+    * /profile start - start profiling the scheduler's threads
+    * /profile stop - stop profiling
+    * /profile show - list the time taken by each profiled thread in the console
+    * /profile dump [path] - write the profiled thread resumes out as a Chrome trace
+    * /sample start [instructions] - start sampling the scripts' call stacks every so many Lua instructions
+    * /sample stop - stop sampling scripts
+    * /sample show - list the script lines that the most samples were taken in
+    * /sample dump [path] - write the sampled stacks out as collapsed stacks, for a flame graph
+    * /gc show - list the size of the Lua heap in the console
+    * /gc collect - run a full garbage collection cycle
+    * /gc pause <percent> - set the garbage collector's pause
+    * /gc stepmul <percent> - set the garbage collector's step multiplier
+    * /gc limit <KB> - cap the memory that scripts can use (0 removes the cap)
+    * /frames start - start profiling the zones of each frame
+    * /frames stop - stop profiling frames
+    * /frames show - list the time taken by each profiled zone in the console
+    * /frames overlay - show or hide the graph of profiled frame times
+    * /frames dump [path] - write the profiled frames out as a Chrome trace
+    * /frames hitches <ms> [frames]|off - write the frames leading up to each frame slower than the threshold out as a trace of their own
+    * /capture start [directory]|stop - capture each frame drawn into a directory, or stop capturing
+    * /time scale <factor> - run the game's time faster (or slower) than real time
+    * /time pause|resume - pause or resume the game's time, leaving the debug console running
+    * /time step [frames] - pause the game's time, then run a number of frames (by default, 1) with a single logic step each
+    * /grid occupancy|expansions|cache|congestion|off - draw the collision map, or the pathfinder's work or blocked moves on each tile, over the map
+    * /perf show [fps|gl|gpu|threads|lua|memory|resources|paths|pools] - list the live performance numbers (of one subsystem, or of all of them)
+    * /perf overlay - show or hide the performance display, along with the graph of frame times
+    *
+    * @param command The text entered into the console.
+    *
+    * @return true iff the text was an engine command (and has been run).
+    */
+   bool runDebugCommand(const std::string& command);
+
+   /**
+    * Describes the live performance numbers of the engine's subsystems.
+    *
+    * @param subsystem The subsystem to describe (fps, gl, gpu, threads, lua, memory, resources, paths or pools), or an empty string for all of them.
+    * @param lines The list to add the lines of the description to, which is left as it is if the subsystem isn't known.
+    */
+   void describePerformance(const std::string& subsystem, std::vector<std::string>& lines) const;
+
+   /**
+    * Refreshes the performance display every so often, if it is shown.
+    *
+    * @param timePassed The amount of time that has passed since the last frame.
+    */
+   void refreshPerformanceHud(long timePassed);
+
+   /**
+    * Adds the tile engine's counters to the frame's profile, if it is being streamed to a viewer (see ProfileServer).
+    */
+   void streamPerformanceCounters() const;
+
+   /**
+    * Finds where the actor that a sound is playing from is, so that the sound follows it
+    * (see Sound::EmitterLocator).
+    *
+    * @param context The tile engine that the actor is on.
+    * @param emitter The handle of the actor.
+    * @param x Set to the x-coordinate (in pixels) of the middle of the actor.
+    * @param y Set to the y-coordinate (in pixels) of the middle of the actor.
+    *
+    * @return true iff the actor is still on the map.
+    */
+   static bool locateSoundEmitter(void* context, unsigned int emitter, int& x, int& y);
+
    /**
     * Recalculate the camera offset (based on map and window dimensions)
     * in order to center the map and its elements properly.
@@ -101,12 +262,48 @@ class TileEngine: public GameState
    void recalculateMapOffsets();
 
    /**
-    * Handles input events specific to the tile engine.
+    * Scrolls the camera so that the player is in the middle of the screen, as far as the map's edges allow.
+    * If the camera is held on a point, it is centred on that point instead.
+    *
+    * @param playerLocation Where the player is (or is drawn) on the map (in pixels).
+    */
+   void followPlayer(const shapes::Point2D& playerLocation);
+
+   /**
+    * Loads the chunks of the current map that are in and around the camera's view.
+    */
+   void streamMapChunks();
+
+   /**
+    * Releases the tiles of the map that the player left, unless the player has gone back to it.
+    */
+   void releaseDepartedMap();
+
+   /**
+    * Handles every input that arrived since the last step, in order, passing whatever the tile engine doesn't use on to the GUI.
+    * Once an input quits out of the tile engine, the rest is left for the state below.
     *
     * @param finishState Returned as true if the input event quit out of the tile engine.
     */
    void handleInputEvents(bool& finishState);
 
+   /**
+    * Runs a line entered into the debug console, as an engine command (see runDebugCommand) or else as a script
+    * (see EventBus::Handler).
+    *
+    * @param context The tile engine.
+    * @param event The DEBUG_COMMAND event holding the line.
+    */
+   static void debugCommandPosted(void* context, const EventBus::Event& event);
+
+   /**
+    * Reports on the debug console whether a save game was written (see EventBus::Handler).
+    *
+    * @param context The tile engine.
+    * @param event The SAVE_WRITTEN event.
+    */
+   static void saveWritten(void* context, const EventBus::Event& event);
+
    /**
     * Handles activation of NPCs when the player presses the action key.
     */
@@ -117,8 +314,18 @@ class TileEngine: public GameState
        * Logic step.
        * Sends time passed to all controllers so that they can update accordingly.
        * Takes user input if there is any. 
+       *
+       * @param timePassed The amount of game time (in milliseconds) that the step covers.
        */
-      bool step();
+      bool step(long timePassed);
+
+      /**
+       * Takes the input that arrived while the game's time is paused, which only goes as far as the debug console
+       * (so that the time can be stepped or resumed from it) and the GUI.
+       *
+       * @return true iff the tile engine is not finished running.
+       */
+      bool advancePausedFrame();
 
       /**
        * Draw map tiles if a map is loaded in, and then coordinate the drawing
@@ -126,10 +333,50 @@ class TileEngine: public GameState
        */
       void draw();
 
+      /**
+       * Steps the Lua garbage collector in the time left over after a frame is drawn.
+       *
+       * @param timeAvailable The time (in milliseconds) left before the next frame is due.
+       */
+      void idle(long timeAvailable);
+
    public:
       /** Tile size constant */
       static const int TILE_SIZE;
 
+      /** The description of an NPC to spawn, for adding a batch of NPCs at once. */
+      struct NPCDefinition
+      {
+         /** The name of the NPC (which is also the name of its script). */
+         std::string name;
+
+         /** The name of the spritesheet to draw the NPC with. */
+         std::string spritesheetName;
+
+         /** The location where the NPC spawns (in pixels). */
+         shapes::Point2D location;
+      };
+
+      /** An order to move an actor, for moving a batch of actors at once. */
+      struct ActorMove
+      {
+         /** The actor to move. */
+         Actor* actor;
+
+         /** Where the actor should move to (in pixels). */
+         shapes::Point2D destination;
+      };
+
+      /** A line of a conversation, for queueing up a whole conversation at once. */
+      struct ConversationLine
+      {
+         /** True iff the line is narrated, rather than said. */
+         bool narrated;
+
+         /** The line of dialogue (which can embed scripts). */
+         std::string speech;
+      };
+
       /**
        * Constructor.
        *
@@ -145,16 +392,96 @@ class TileEngine: public GameState
       std::string getMapName();
 
       /**
-       * Updates all NPCs on the map.
+       * Collects the next move of the player character and every NPC on the map,
+       * and resolves them together on the entity grid before anyone moves.
+       */
+      void resolveMovements();
+
+      /**
+       * Updates the NPCs on the map that are awake. NPCs near the screen are woken up first,
+       * and NPCs with nothing to do away from the screen are parked afterwards.
        *
        * @param timePassed the amount of time that has passed since the last frame. 
        */
       void stepNPCs(long timePassed);
 
       /**
-       * Draws all NPCs on the map.
+       * Applies the orders emitted by the pure idle functions that have finished running,
+       * and queues the pure idle functions of the idle NPCs that are due to run again.
+       * The orders are applied on the step after the one that queued the function, so that
+       * the functions can run in parallel with the rest of the frame.
+       *
+       * @param timePassed the amount of time that has passed since the last frame.
+       */
+      void stepNPCAI(long timePassed);
+
+      /**
+       * Draws the NPCs on the map that are in view of the camera.
+       *
+       * @param interpolation How far (from 0 to 1) the frame falls between the last logic step and the next one.
+       */
+      void drawNPCs(float interpolation);
+
+      /**
+       * Lights the map drawn on the screen, with the lights placed on the map and
+       * the lights carried by the actors in and around the camera's view.
+       *
+       * @param interpolation How far (from 0 to 1) the frame falls between the last logic step and the next one.
+       */
+      void drawLighting(float interpolation);
+
+      /**
+       * Draws the map's tile layers in perspective, in place of everything that is drawn on the flat map.
+       */
+      void drawPerspective();
+
+      /**
+       * @return The lighting drawn over the current map.
+       */
+      LightMap& getLightMap();
+
+      /**
+       * @return The weather and effects drawn on the current map.
+       */
+      ParticleSystem& getParticles();
+
+      /**
+       * Draws the map in perspective from now on (for overworld and flight sequences), where the driver supports it.
+       * Only the map's tile layers are drawn in perspective; obstacles, actors, particles and lighting are left out.
+       *
+       * @param view How the camera looks at the map.
+       * @param followCamera true iff the camera should look at the middle of what would be on screen (such as the player), instead of the view's point.
+       */
+      void setPerspective(const PerspectiveLayerRenderer::View& view, bool followCamera);
+
+      /**
+       * Draws the map flat again.
+       */
+      void clearPerspective();
+
+      /**
+       * Shows the minimap of the current map over an area of the screen, until it is hidden.
+       *
+       * @param area The area of the screen (with inclusive edge coordinates in pixels).
+       */
+      void showMinimap(const shapes::Rectangle& area);
+
+      /**
+       * Hides the minimap.
        */
-      void drawNPCs();
+      void hideMinimap();
+
+      /**
+       * Holds the camera on a point of the map, instead of following the player, until it is released.
+       *
+       * @param point The point (in pixels) to centre the camera on, as far as the map's edges allow.
+       */
+      void holdCamera(const shapes::Point2D& point);
+
+      /**
+       * Lets the camera follow the player again.
+       */
+      void releaseCamera();
 
       /**
        * Send a line of dialogue to the DialogueController as a narration.
@@ -171,6 +498,14 @@ class TileEngine: public GameState
        * @param task The ticket of this speech instruction
        */
       void dialogueSay(const char* speech, Task* task);
+
+      /**
+       * Send a whole conversation to the DialogueController at once.
+       *
+       * @param conversation The lines of the conversation, in the order that they appear.
+       * @param task The ticket of the conversation, which is signalled once its last line is finished
+       */
+      void dialogueConverse(const std::vector<ConversationLine>& conversation, Task* task);
       
       /**
        * Set a new location for the gameplay to take place in.
@@ -202,6 +537,27 @@ class TileEngine: public GameState
        */
       NPC* addNPC(const std::string& npcName, const std::string& spritesheetName, shapes::Point2D npcLocation);
 
+      /**
+       * Adds a batch of NPCs into the region, such as to populate a map when it is entered.
+       * NPCs that were despawned are reused if they match, so their scripts aren't loaded again.
+       * The NPCs are placed in order, so an NPC can't be placed over one earlier in the batch.
+       *
+       * @param definitions The NPCs to add.
+       * @param npcs The added NPCs are added to the back of this list, in the order of their definitions
+       *             (with NULL for the NPCs that could not be placed in the map).
+       */
+      void addNPCs(const std::vector<NPCDefinition>& definitions, std::vector<NPC*>& npcs);
+
+      /**
+       * Takes an NPC off the current map. The NPC is kept in a pool, to be reused by the next NPC
+       * added to the map with the same name, unless its script is in the middle of a run
+       * (in which case it is deleted). Either way, the NPC can't be used once it has been removed,
+       * and its handle no longer resolves.
+       *
+       * @param npc The NPC to remove.
+       */
+      void removeNPC(NPC* npc);
+
       /**
        * @param npcName The name of the NPC to find.
        *
@@ -209,11 +565,203 @@ class TileEngine: public GameState
        */
       NPC* getNPC(const std::string& npcName) const;
 
+      /**
+       * @param actor An actor in the current map.
+       *
+       * @return The handle of the actor, which scripts can hold on to and pass to resolveNPC
+       *         (or INVALID_HANDLE if the actor has been removed from the map).
+       */
+      ActorTable::ActorHandle getActorHandle(const Actor* actor) const;
+
+      /**
+       * @param handle The handle of an NPC.
+       *
+       * @return The NPC with the handle, or NULL if it is no longer in the current map.
+       */
+      NPC* resolveNPC(ActorTable::ActorHandle handle) const;
+
+      /**
+       * @param handle The handle of an actor (an NPC or the player character).
+       *
+       * @return The actor with the handle, or NULL if it is no longer in the current map.
+       */
+      Actor* resolveActor(ActorTable::ActorHandle handle) const;
+
+      /**
+       * Orders a batch of actors to move, such as to choreograph a cutscene. Destinations outside the map are ignored.
+       *
+       * @param moves The actors to move, and where to.
+       */
+      void moveActors(const std::vector<ActorMove>& moves);
+
+      /**
+       * Sets the animations of a batch of actors at once.
+       *
+       * @param actors The actors to animate.
+       * @param animationNames The animation for each of the actors, in the same order; if there is only one, every actor plays it.
+       */
+      void setActorAnimations(const std::vector<Actor*>& actors, const std::vector<std::string>& animationNames);
+
+      /**
+       * Finds where a batch of actors are.
+       *
+       * @param actors The actors (NULL entries are allowed, and are reported at the origin).
+       * @param locations The locations of the actors are added to the back of this list (in pixels), in the same order.
+       */
+      void getActorLocations(const std::vector<Actor*>& actors, std::vector<shapes::Point2D>& locations) const;
+
+      /**
+       * Finds the actors overlapping an area of the current map.
+       *
+       * @param area The area to search (with inclusive edge coordinates in pixels).
+       * @param actors The actors found are added to the back of this list.
+       */
+      void findActorsInArea(const shapes::Rectangle& area, std::vector<Actor*>& actors) const;
+
+      /**
+       * Finds the actors on the current map within a given distance of a point.
+       *
+       * @param center The point to search around (in pixels).
+       * @param radius The distance to search within (in pixels).
+       * @param actors The actors found are added to the back of this list.
+       */
+      void findActorsInRadius(const shapes::Point2D& center, int radius, std::vector<Actor*>& actors) const;
+
+      /**
+       * @param point The point to search around (in pixels).
+       * @param maxRadius The furthest distance to search (in pixels).
+       * @param excludedActor An actor to leave out of the search, or NULL.
+       *
+       * @return The actor on the current map closest to the point within the radius, or NULL if there is none.
+       */
+      Actor* findNearestActor(const shapes::Point2D& point, int maxRadius, const Actor* excludedActor) const;
+
+      /**
+       * Blocks an area of the current map (such as a door being closed), so that actors route around it.
+       *
+       * @param location The top-left corner of the area (in pixels).
+       * @param width The width of the area (in pixels).
+       * @param height The height of the area (in pixels).
+       *
+       * @return true iff the area was blocked; false if something was already in it.
+       */
+      bool addObstacle(const shapes::Point2D& location, int width, int height);
+
+      /**
+       * Clears an area of the current map that was blocked by addObstacle (such as a door being opened).
+       *
+       * @param location The top-left corner of the area (in pixels).
+       * @param width The width of the area (in pixels).
+       * @param height The height of the area (in pixels).
+       *
+       * @return true iff the area was cleared; false if any of it wasn't blocked.
+       */
+      bool removeObstacle(const shapes::Point2D& location, int width, int height);
+
+      /**
+       * Starts watching an area of the current map for actors coming and going.
+       *
+       * @param area The area to watch (with inclusive edge coordinates in pixels).
+       *
+       * @return The ID of the trigger zone, which is only good until the map changes.
+       */
+      TriggerZones::TriggerId addTrigger(const shapes::Rectangle& area);
+
+      /**
+       * Starts watching one of the trigger zones laid out in the current map's file.
+       *
+       * @param name The name of the trigger zone in the map file.
+       *
+       * @return The ID of the trigger zone, or INVALID_TRIGGER if the map has no trigger zone with the name.
+       */
+      TriggerZones::TriggerId addTrigger(const std::string& name);
+
+      /**
+       * Stops watching a trigger zone, waking up the script waiting on it.
+       *
+       * @param trigger The ID of the trigger zone.
+       */
+      void removeTrigger(TriggerZones::TriggerId trigger);
+
+      /**
+       * Blocks the running script until an actor comes into or goes out of a trigger zone.
+       * The script isn't blocked if the zone already has an event to take, or if it doesn't exist.
+       *
+       * @param trigger The ID of the trigger zone.
+       *
+       * @return A yield code from the script's thread, or 0 if it wasn't blocked.
+       */
+      int waitForTrigger(TriggerZones::TriggerId trigger);
+
+      /**
+       * Blocks the running script until an actor has carried out all of its orders (or has left the map).
+       * The condition is tested by the scheduler, so the script isn't resumed until it is met.
+       *
+       * @param actor The actor to wait on.
+       *
+       * @return A yield code from the script's thread, or 0 if it wasn't blocked (since the actor is already idle).
+       */
+      int waitUntilIdle(const Actor* actor);
+
+      /**
+       * Blocks the running script until every one of a group of actors has carried out all of its orders
+       * (or until any one of them has), with actors that have left the map counting as idle.
+       * The whole group is tested by the scheduler, so the script is only resumed once, when the group is done.
+       *
+       * @param actors The actors to wait on. NULL entries stand for actors that have left the map.
+       * @param waitForAll true to wait for all of the actors, or false to wait for any one of them.
+       *
+       * @return A yield code from the script's thread, or 0 if it wasn't blocked (since the group is already done).
+       */
+      int waitUntilIdle(const std::vector<Actor*>& actors, bool waitForAll);
+
+      /**
+       * Blocks the running script until an actor comes within a distance of a point (or has left the map).
+       * The condition is tested by the scheduler, so the script isn't resumed until it is met.
+       *
+       * @param actor The actor to wait on.
+       * @param point The point that the actor's top-left corner should reach (in pixels).
+       * @param radius How close to the point the actor has to come (in pixels).
+       *
+       * @return A yield code from the script's thread, or 0 if it wasn't blocked (since the actor is already there).
+       */
+      int waitUntilArrived(const Actor* actor, const shapes::Point2D& point, int radius);
+
+      /**
+       * Blocks the running script until a flag holds a value.
+       * The condition is tested by the scheduler, so the script isn't resumed until it is met.
+       *
+       * @param key The key of the flag in the player's flags.
+       * @param type The kind of value to wait for. UNSET waits for the flag to be unset, and BOOL compares the flag's boolean value
+       *             (so a flag holding a number other than 0 counts as true).
+       * @param value The boolean or number to wait for.
+       * @param stringValue The string to wait for, if the type is STRING.
+       *
+       * @return A yield code from the script's thread, or 0 if it wasn't blocked (since the flag already holds the value).
+       */
+      int waitUntilFlag(FlagStore::Key key, FlagStore::Type type, int value, const std::string& stringValue = "");
+
+      /**
+       * Takes the oldest event of a trigger zone.
+       *
+       * @param trigger The ID of the trigger zone.
+       * @param actor The parameter used to return the actor that came or went, or NULL if it has since been removed from the map.
+       * @param entered The parameter used to return true iff the actor came into the zone.
+       *
+       * @return true iff the zone had an event.
+       */
+      bool takeTriggerEvent(TriggerZones::TriggerId trigger, Actor*& actor, bool& entered);
+
       /**
        * @return The player character in the tile engine.
        */
       PlayerCharacter* getPlayerCharacter() const;
 
+      /**
+       * @return The player's flags.
+       */
+      FlagStore& getFlags();
+
       /**
        * Destructor.
        */
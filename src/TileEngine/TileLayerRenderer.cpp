@@ -0,0 +1,357 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "TileLayerRenderer.h"
+#include "Tileset.h"
+#include "TileEngine.h"
+#include "VertexBuffer.h"
+#include "RenderTarget.h"
+#include "GLState.h"
+#include "SDL_opengl.h"
+#include <algorithm>
+#include <map>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_TILE_ENG;
+
+TileLayerRenderer::TileLayerRenderer(bool blended) : blended(blended), chunksWide(0), scrollCache(NULL),
+      cacheTilesWide(0), cacheTilesHigh(0), cachedTiles(0, 0, -1, -1)
+{
+}
+
+void TileLayerRenderer::resize(int chunksWide, int chunksHigh)
+{
+   for(std::vector<Chunk>::iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
+   {
+      delete iter->buffer;
+      delete iter->animatedBuffer;
+   }
+
+   this->chunksWide = chunksWide;
+   chunks.assign(chunksWide * chunksHigh, Chunk());
+
+   delete scrollCache;
+   scrollCache = NULL;
+   cachedTiles = shapes::Rectangle(0, 0, -1, -1);
+}
+
+bool TileLayerRenderer::isChunkBuilt(int chunkNum) const
+{
+   return chunks[chunkNum].buffer != NULL;
+}
+
+void TileLayerRenderer::buildChunk(int chunkNum, const Tileset& tileset, const int* tiles, int stride, int left, int top, int width, int height)
+{
+   std::vector<float> vertices;
+   vertices.reserve(width * height * 4 * VertexBuffer::FLOATS_PER_VERTEX);
+
+   // The vertices of the animated tiles, keyed by the animation they show
+   std::map<int, std::vector<float> > animatedVertices;
+
+   for(int y = 0; y < height; ++y)
+   {
+      for(int x = 0; x < width; ++x)
+      {
+         const int tileNum = tiles[y * stride + x];
+         if(tileNum < 0) continue;
+
+         float textureLeft, textureTop, textureRight, textureBottom;
+         tileset.getTextureCoordinates(tileNum, textureLeft, textureTop, textureRight, textureBottom);
+
+         const float destLeft = float((left + x) * TileEngine::TILE_SIZE);
+         const float destRight = float((left + x + 1) * TileEngine::TILE_SIZE);
+         const float destTop = float((top + y) * TileEngine::TILE_SIZE);
+         const float destBottom = float((top + y + 1) * TileEngine::TILE_SIZE);
+
+         // The same corners, in the same order, as Tileset::draw
+         const float quad[] =
+         {
+            destLeft, destTop, textureLeft, textureTop,
+            destRight, destTop, textureRight, textureTop,
+            destRight, destBottom, textureRight, textureBottom,
+            destLeft, destBottom, textureLeft, textureBottom
+         };
+
+         const int animationNum = tileset.getAnimationNum(tileNum);
+         std::vector<float>& tileVertices = animationNum >= 0 ? animatedVertices[animationNum] : vertices;
+         tileVertices.insert(tileVertices.end(), quad, quad + sizeof(quad) / sizeof(quad[0]));
+      }
+   }
+
+   Chunk& chunk = chunks[chunkNum];
+   if(chunk.buffer == NULL)
+   {
+      chunk.buffer = new VertexBuffer(VertexBuffer::STATIC);
+   }
+
+   chunk.buffer->setVertices(vertices);
+
+   delete chunk.animatedBuffer;
+   chunk.animatedBuffer = NULL;
+   chunk.animatedRuns.clear();
+   if(!animatedVertices.empty())
+   {
+      std::vector<float> runVertices;
+      for(std::map<int, std::vector<float> >::const_iterator iter = animatedVertices.begin(); iter != animatedVertices.end(); ++iter)
+      {
+         AnimatedRun run;
+         run.animationNum = iter->first;
+         run.firstVertex = runVertices.size() / VertexBuffer::FLOATS_PER_VERTEX;
+         run.vertexCount = iter->second.size() / VertexBuffer::FLOATS_PER_VERTEX;
+         chunk.animatedRuns.push_back(run);
+         runVertices.insert(runVertices.end(), iter->second.begin(), iter->second.end());
+      }
+
+      chunk.animatedBuffer = new VertexBuffer(VertexBuffer::STATIC);
+      chunk.animatedBuffer->setVertices(runVertices);
+   }
+   chunk.left = left * TileEngine::TILE_SIZE;
+   chunk.top = top * TileEngine::TILE_SIZE;
+   chunk.width = width * TileEngine::TILE_SIZE;
+   chunk.height = height * TileEngine::TILE_SIZE;
+
+   // The tiles may have changed, so the chunk has to be drawn into the scroll cache again
+   forgetCachedChunk(chunk);
+}
+
+void TileLayerRenderer::releaseChunk(int chunkNum)
+{
+   forgetCachedChunk(chunks[chunkNum]);
+   delete chunks[chunkNum].buffer;
+   chunks[chunkNum].buffer = NULL;
+   delete chunks[chunkNum].animatedBuffer;
+   chunks[chunkNum].animatedBuffer = NULL;
+   chunks[chunkNum].animatedRuns.clear();
+}
+
+shapes::Rectangle TileLayerRenderer::getChunkTiles(const Chunk& chunk)
+{
+   return shapes::Rectangle(chunk.top / TileEngine::TILE_SIZE, chunk.left / TileEngine::TILE_SIZE,
+         (chunk.top + chunk.height) / TileEngine::TILE_SIZE - 1, (chunk.left + chunk.width) / TileEngine::TILE_SIZE - 1);
+}
+
+void TileLayerRenderer::forgetCachedChunk(const Chunk& chunk)
+{
+   if(cachedTiles.left > cachedTiles.right || chunk.width == 0) return;
+
+   if(getChunkTiles(chunk).intersects(cachedTiles))
+   {
+      cachedTiles = shapes::Rectangle(0, 0, -1, -1);
+   }
+}
+
+void TileLayerRenderer::drawIntoScrollCache(const Tileset& tileset, const shapes::Rectangle& chunkArea, const shapes::Rectangle& tileArea)
+{
+   const int tileSize = TileEngine::TILE_SIZE;
+   const int cacheHeight = cacheTilesHigh * tileSize;
+
+   scrollCache->resume();
+   glPushAttrib(GL_SCISSOR_BIT);
+   glEnable(GL_SCISSOR_TEST);
+
+   // The cache is drawn premultiplied, so blended tiles have to be drawn into it with the layer blend function
+   const bool blendEnabled = GLState::isBlending();
+   if(blended)
+   {
+      GLState::setBlending(true);
+      RenderTarget::useLayerBlending();
+   }
+
+   tileset.bindTexture();
+   glMatrixMode(GL_MODELVIEW);
+   glPushMatrix();
+
+   // The area is split where it wraps around the edges of the cache, into at most four pieces
+   for(int top = tileArea.top; top <= tileArea.bottom;)
+   {
+      const int slotTop = top % cacheTilesHigh;
+      const int bottom = std::min(tileArea.bottom, top + cacheTilesHigh - slotTop - 1);
+      for(int left = tileArea.left; left <= tileArea.right;)
+      {
+         const int slotLeft = left % cacheTilesWide;
+         const int right = std::min(tileArea.right, left + cacheTilesWide - slotLeft - 1);
+         const int pieceWidth = (right - left + 1) * tileSize;
+         const int pieceHeight = (bottom - top + 1) * tileSize;
+
+         // Only the piece is cleared and drawn over (the scissor box's rows run from the bottom of the cache up)
+         glScissor(slotLeft * tileSize, cacheHeight - slotTop * tileSize - pieceHeight, pieceWidth, pieceHeight);
+         glClear(GL_COLOR_BUFFER_BIT);
+
+         // Draw the piece's tiles relative to where the piece wraps around to, rather than to the map's corner
+         glLoadIdentity();
+         glTranslated((slotLeft - left) * tileSize, (slotTop - top) * tileSize, 0);
+
+         const shapes::Rectangle piece(top, left, bottom, right);
+         for(int chunkY = chunkArea.top; chunkY <= chunkArea.bottom; ++chunkY)
+         {
+            for(int chunkX = chunkArea.left; chunkX <= chunkArea.right; ++chunkX)
+            {
+               const Chunk& chunk = chunks[chunkY * chunksWide + chunkX];
+               if(chunk.buffer != NULL && getChunkTiles(chunk).intersects(piece))
+               {
+                  chunk.buffer->drawQuads();
+               }
+            }
+         }
+
+         left = right + 1;
+      }
+
+      top = bottom + 1;
+   }
+
+   glPopMatrix();
+   GLState::setBlending(blendEnabled);
+   glPopAttrib();
+   scrollCache->end();
+}
+
+void TileLayerRenderer::updateScrollCache(const Tileset& tileset, const shapes::Rectangle& chunkArea, const shapes::Rectangle& tileArea)
+{
+   const int tilesWide = tileArea.right - tileArea.left + 1;
+   const int tilesHigh = tileArea.bottom - tileArea.top + 1;
+   if(scrollCache == NULL || tilesWide > cacheTilesWide || tilesHigh > cacheTilesHigh)
+   {
+      // A spare row and column of tiles lets the view straddle tile edges; the cache is rounded up to powers of two
+      // so that its texture wraps around its edges exactly where the cache does
+      int cacheWidth = 1;
+      while(cacheWidth < (tilesWide + 1) * TileEngine::TILE_SIZE) cacheWidth <<= 1;
+
+      int cacheHeight = 1;
+      while(cacheHeight < (tilesHigh + 1) * TileEngine::TILE_SIZE) cacheHeight <<= 1;
+
+      delete scrollCache;
+      scrollCache = new RenderTarget(cacheWidth, cacheHeight);
+      cacheTilesWide = cacheWidth / TileEngine::TILE_SIZE;
+      cacheTilesHigh = cacheHeight / TileEngine::TILE_SIZE;
+      cachedTiles = shapes::Rectangle(0, 0, -1, -1);
+      DEBUG("Created a %dx%d scroll cache for a layer.", cacheWidth, cacheHeight);
+   }
+
+   const bool cacheEmpty = cachedTiles.left > cachedTiles.right;
+   if(!cacheEmpty && tileArea.left >= cachedTiles.left && tileArea.right <= cachedTiles.right
+         && tileArea.top >= cachedTiles.top && tileArea.bottom <= cachedTiles.bottom)
+   {
+      return;
+   }
+
+   if(cacheEmpty || !tileArea.intersects(cachedTiles))
+   {
+      drawIntoScrollCache(tileset, chunkArea, tileArea);
+   }
+   else
+   {
+      // The tiles still in view stay where they are in the cache, so only the strips that came into view are drawn:
+      // the columns on either side, and then the rows above and below the columns that were already there
+      const shapes::Rectangle kept(std::max(tileArea.top, cachedTiles.top), std::max(tileArea.left, cachedTiles.left),
+            std::min(tileArea.bottom, cachedTiles.bottom), std::min(tileArea.right, cachedTiles.right));
+
+      if(tileArea.left < kept.left)
+      {
+         drawIntoScrollCache(tileset, chunkArea, shapes::Rectangle(tileArea.top, tileArea.left, tileArea.bottom, kept.left - 1));
+      }
+
+      if(tileArea.right > kept.right)
+      {
+         drawIntoScrollCache(tileset, chunkArea, shapes::Rectangle(tileArea.top, kept.right + 1, tileArea.bottom, tileArea.right));
+      }
+
+      if(tileArea.top < kept.top)
+      {
+         drawIntoScrollCache(tileset, chunkArea, shapes::Rectangle(tileArea.top, kept.left, kept.top - 1, kept.right));
+      }
+
+      if(tileArea.bottom > kept.bottom)
+      {
+         drawIntoScrollCache(tileset, chunkArea, shapes::Rectangle(kept.bottom + 1, kept.left, tileArea.bottom, kept.right));
+      }
+   }
+
+   cachedTiles = tileArea;
+}
+
+void TileLayerRenderer::drawAnimatedTiles(const Chunk& chunk, const Tileset& tileset) const
+{
+   if(chunk.animatedBuffer == NULL) return;
+
+   if(blended)
+   {
+      GLState::setBlending(true);
+      GLState::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+   }
+
+   tileset.bindTexture();
+
+   // The tiles were built with their animations' first tiles, which the texture matrix moves onto the current frames
+   glMatrixMode(GL_TEXTURE);
+   for(std::vector<AnimatedRun>::const_iterator iter = chunk.animatedRuns.begin(); iter != chunk.animatedRuns.end(); ++iter)
+   {
+      float scale, offset;
+      tileset.getAnimationTransform(iter->animationNum, scale, offset);
+
+      glLoadIdentity();
+      glTranslatef(offset, 0.0f, 0.0f);
+      glScalef(scale, 1.0f, 1.0f);
+      chunk.animatedBuffer->drawQuads(iter->firstVertex, iter->vertexCount);
+   }
+
+   glLoadIdentity();
+   glMatrixMode(GL_MODELVIEW);
+}
+
+void TileLayerRenderer::draw(const Tileset& tileset, const shapes::Rectangle& chunkArea, const shapes::Rectangle& tileArea)
+{
+   if(chunkArea.top > chunkArea.bottom || chunkArea.left > chunkArea.right) return;
+   if(tileArea.top > tileArea.bottom || tileArea.left > tileArea.right) return;
+
+   const bool caching = textureCachingEnabled && RenderTarget::isSupported();
+   GLenum oldSrcFactor, oldDstFactor;
+   GLState::getBlendFunction(oldSrcFactor, oldDstFactor);
+   const bool blendEnabled = GLState::isBlending();
+   if(caching)
+   {
+      updateScrollCache(tileset, chunkArea, tileArea);
+
+      // The tiles in view are laid out in the cache as they are on the map, just wrapped around, so they are drawn as one quad
+      const int tileSize = TileEngine::TILE_SIZE;
+      scrollCache->drawWrapped((tileArea.left % cacheTilesWide) * tileSize, (tileArea.top % cacheTilesHigh) * tileSize,
+            tileArea.left * tileSize, tileArea.top * tileSize,
+            (tileArea.right - tileArea.left + 1) * tileSize, (tileArea.bottom - tileArea.top + 1) * tileSize);
+   }
+   else
+   {
+      tileset.bindTexture();
+      if(blended)
+      {
+         GLState::setBlending(true);
+         GLState::setBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      }
+   }
+
+   for(int chunkY = chunkArea.top; chunkY <= chunkArea.bottom; ++chunkY)
+   {
+      for(int chunkX = chunkArea.left; chunkX <= chunkArea.right; ++chunkX)
+      {
+         const int chunkNum = chunkY * chunksWide + chunkX;
+         if(chunks[chunkNum].buffer == NULL) continue;
+
+         if(!caching)
+         {
+            chunks[chunkNum].buffer->drawQuads();
+         }
+
+         drawAnimatedTiles(chunks[chunkNum], tileset);
+      }
+   }
+
+   GLState::setBlending(blendEnabled);
+   GLState::setBlendFunction(oldSrcFactor, oldDstFactor);
+}
+
+TileLayerRenderer::~TileLayerRenderer()
+{
+   resize(0, 0);
+}
@@ -0,0 +1,190 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef TILE_LAYER_RENDERER_H
+#define TILE_LAYER_RENDERER_H
+
+#include <cstddef>
+#include <vector>
+#include "Rectangle.h"
+
+class Tileset;
+class VertexBuffer;
+class RenderTarget;
+
+/**
+ * Draws a layer of map tiles from vertex buffers instead of one quad at a time.
+ * The quads for each chunk of the layer are built into a static vertex buffer once, when the
+ * chunk is first drawn, and are only rebuilt if the chunk is released and loaded again.
+ * Drawing the layer binds the tileset texture once and issues a single draw call per visible chunk.
+ *
+ * Where the driver supports render targets, the visible tiles are kept in a scroll cache: a texture a little larger
+ * than the screen, which the map wraps around (so a tile always lands at its coordinates modulo the texture's size).
+ * As the camera moves, only the strips of tiles that come into view are drawn into the cache, over the tiles
+ * that have gone out of view, and the whole view is drawn from the cache as a single textured quad.
+ * Rebuilding or releasing a chunk in view has the cache drawn again.
+ *
+ * Animated tiles are kept out of the chunk's texture, in a second vertex buffer grouped by animation.
+ * Each group is drawn with one draw call, with the texture matrix moving the animation's first tile onto
+ * its current frame, so animating the tiles doesn't cost anything per tile.
+ */
+class TileLayerRenderer
+{
+   /** The animated tiles of a chunk that show the same animation. */
+   struct AnimatedRun
+   {
+      /** The index of the animation within the tileset. */
+      int animationNum;
+
+      /** The index of the run's first vertex within the chunk's animated vertex buffer. */
+      int firstVertex;
+
+      /** The number of vertices in the run. */
+      int vertexCount;
+   };
+
+   /** A chunk of the layer. */
+   struct Chunk
+   {
+      /** The chunk's vertex buffer, or NULL if the chunk hasn't been built. */
+      VertexBuffer* buffer;
+
+      /** The vertex buffer holding the chunk's animated tiles, or NULL if the chunk has none. */
+      VertexBuffer* animatedBuffer;
+
+      /** The runs of animated tiles in the animated vertex buffer, one for each animation. */
+      std::vector<AnimatedRun> animatedRuns;
+
+      /** The area that the chunk covers on the map (in pixels). */
+      int left, top, width, height;
+
+      Chunk() : buffer(NULL), animatedBuffer(NULL), left(0), top(0), width(0), height(0) {}
+   };
+
+   /** Whether or not the layer's tiles blend with the tiles drawn before them. */
+   bool blended;
+
+   /** The width of the layer (in chunks). */
+   int chunksWide;
+
+   /** The chunks of the layer, stored row by row. */
+   std::vector<Chunk> chunks;
+
+   /** The texture that the visible tiles are kept in, or NULL if it hasn't been created. */
+   RenderTarget* scrollCache;
+
+   /** The size of the scroll cache (in tiles). */
+   int cacheTilesWide, cacheTilesHigh;
+
+   /** The tiles held in the scroll cache (with inclusive edge coordinates in tiles), which are empty if there are none. */
+   shapes::Rectangle cachedTiles;
+
+   /**
+    * @param chunk A chunk that has been built.
+    *
+    * @return The tiles that the chunk covers on the map (with inclusive edge coordinates in tiles).
+    */
+   static shapes::Rectangle getChunkTiles(const Chunk& chunk);
+
+   /**
+    * Empties the scroll cache if a chunk is in it, so that the chunk is drawn into it again.
+    *
+    * @param chunk The chunk.
+    */
+   void forgetCachedChunk(const Chunk& chunk);
+
+   /**
+    * Draws the static tiles of an area of the layer into the scroll cache, where they wrap around to,
+    * in place of whatever the cache held there. The area must fit in the cache.
+    *
+    * @param tileset The tileset that the tiles are drawn from.
+    * @param chunkArea The chunks that the area falls in (with inclusive edge coordinates in chunks).
+    * @param tileArea The area to draw (with inclusive edge coordinates in tiles).
+    */
+   void drawIntoScrollCache(const Tileset& tileset, const shapes::Rectangle& chunkArea, const shapes::Rectangle& tileArea);
+
+   /**
+    * Brings the scroll cache up to date with the tiles in view, drawing only the tiles that weren't in it already
+    * (or all of them, if the cache has to be created, or the view jumped away from what it held).
+    *
+    * @param tileset The tileset that the tiles are drawn from.
+    * @param chunkArea The chunks in view (with inclusive edge coordinates in chunks).
+    * @param tileArea The tiles in view (with inclusive edge coordinates in tiles).
+    */
+   void updateScrollCache(const Tileset& tileset, const shapes::Rectangle& chunkArea, const shapes::Rectangle& tileArea);
+
+   /**
+    * Draws the animated tiles of a built chunk at their current frames.
+    *
+    * @param chunk The chunk.
+    * @param tileset The tileset that the tiles are drawn from.
+    */
+   void drawAnimatedTiles(const Chunk& chunk, const Tileset& tileset) const;
+
+   public:
+      /** Whether or not the layer is drawn from a scroll cache where the driver supports it (currently HARDCODED) */
+      static const bool textureCachingEnabled = true;
+
+      /**
+       * Constructor.
+       *
+       * @param blended true iff the layer is drawn over other layers, so that its tiles blend with the tiles behind them.
+       */
+      TileLayerRenderer(bool blended = false);
+
+      /**
+       * Sets the number of chunks in the layer, releasing any chunks that have been built.
+       *
+       * @param chunksWide The width of the layer (in chunks).
+       * @param chunksHigh The height of the layer (in chunks).
+       */
+      void resize(int chunksWide, int chunksHigh);
+
+      /**
+       * @param chunkNum The number of a chunk in the layer.
+       *
+       * @return true iff the chunk's vertex buffer has been built.
+       */
+      bool isChunkBuilt(int chunkNum) const;
+
+      /**
+       * Builds the vertex buffers for a chunk of the layer, and has the chunk drawn into the scroll cache again.
+       * Empty tiles (-1) are left out, and animated tiles are put in a buffer of their own.
+       *
+       * @param chunkNum The number of the chunk.
+       * @param tileset The tileset that the tiles are drawn from.
+       * @param tiles The tiles of the chunk, row by row.
+       * @param stride The number of tiles in each row of the tiles.
+       * @param left The x-coordinate of the chunk's top-left tile on the map (in tiles).
+       * @param top The y-coordinate of the chunk's top-left tile on the map (in tiles).
+       * @param width The number of tile columns in the chunk that are on the map.
+       * @param height The number of tile rows in the chunk that are on the map.
+       */
+      void buildChunk(int chunkNum, const Tileset& tileset, const int* tiles, int stride, int left, int top, int width, int height);
+
+      /**
+       * Releases the vertex buffers for a chunk, so that it is rebuilt the next time the chunk is drawn.
+       *
+       * @param chunkNum The number of the chunk.
+       */
+      void releaseChunk(int chunkNum);
+
+      /**
+       * Draws the tiles within an area of the layer, from the chunks that have been built.
+       *
+       * @param tileset The tileset that the tiles are drawn from.
+       * @param chunkArea The chunks that the area falls in (with inclusive edge coordinates in chunks, clamped to the layer).
+       * @param tileArea The tiles to draw (with inclusive edge coordinates in tiles, clamped to the layer).
+       */
+      void draw(const Tileset& tileset, const shapes::Rectangle& chunkArea, const shapes::Rectangle& tileArea);
+
+      /**
+       * Destructor.
+       */
+      ~TileLayerRenderer();
+};
+
+#endif
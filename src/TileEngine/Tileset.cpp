@@ -5,9 +5,14 @@
  */
 
 #include "Tileset.h"
+#include "GLState.h"
 #include "SDL_opengl.h"
-#include <fstream>
+#include <SDL.h>
+#include <algorithm>
+#include <cstdlib>
 #include "GraphicsUtil.h"
+#include "PixelConverter.h"
+#include "AssetArchive.h"
 #include "TileEngine.h"
 #include "DebugUtils.h"
 
@@ -16,10 +21,81 @@ const int debugFlag = DEBUG_RES_LOAD | DEBUG_TILE_ENG;
 const std::string Tileset::IMG_EXTENSION = ".png";
 const std::string Tileset::DATA_EXTENSION = ".edt";
 
-Tileset::Tileset(ResourceKey name) : Resource(name)
+Tileset::Tileset(ResourceKey name) : Resource(name), width(0), height(0), animationTime(0), preparedImage(NULL)
 {
 }
 
+/**
+ * Reads the next whitespace-separated number out of a tileset's data.
+ *
+ * @param cursor The position in the data to read from, which is moved past the number.
+ * @param value The parameter used to return the number.
+ *
+ * @return true iff there was another number to read.
+ */
+static bool readNumber(const char*& cursor, long& value)
+{
+   char* numberEnd;
+   value = strtol(cursor, &numberEnd, 10);
+   if(numberEnd == cursor)
+   {
+      return false;
+   }
+
+   cursor = numberEnd;
+   return true;
+}
+
+void Tileset::prepare(const char* path)
+{
+   std::string imagePath(path);
+   imagePath += IMG_EXTENSION;
+
+   DEBUG("Preparing tileset image \"%s\"...", imagePath.c_str());
+   preparedImage = GraphicsUtil::loadImage(imagePath.c_str());
+   computeTileColours(preparedImage);
+}
+
+void Tileset::computeTileColours(SDL_Surface* image)
+{
+   std::vector<unsigned char> stagingPixels;
+   int pitch;
+   const unsigned char* pixels = PixelConverter::toRGBA(image, stagingPixels, pitch);
+
+   const int tilesWide = image->w / TileEngine::TILE_SIZE;
+   const int tilesHigh = image->h / TileEngine::TILE_SIZE;
+   const int pixelCount = TileEngine::TILE_SIZE * TileEngine::TILE_SIZE;
+   tileColours.assign(tilesWide * tilesHigh * 4, 0);
+
+   for(int tileNum = 0; tileNum < tilesWide * tilesHigh; ++tileNum)
+   {
+      const int left = tileNum % tilesWide * TileEngine::TILE_SIZE;
+      const int top = tileNum / tilesWide * TileEngine::TILE_SIZE;
+
+      // Transparent pixels don't count towards the colour, only towards how see-through the tile is
+      unsigned long red = 0, green = 0, blue = 0, alpha = 0;
+      for(int y = top; y < top + TileEngine::TILE_SIZE; ++y)
+      {
+         const unsigned char* pixel = pixels + y * pitch + left * 4;
+         for(int x = 0; x < TileEngine::TILE_SIZE; ++x, pixel += 4)
+         {
+            red += pixel[0] * pixel[3];
+            green += pixel[1] * pixel[3];
+            blue += pixel[2] * pixel[3];
+            alpha += pixel[3];
+         }
+      }
+
+      if(alpha == 0) continue;
+
+      unsigned char* colour = &tileColours[tileNum * 4];
+      colour[0] = static_cast<unsigned char>(red / alpha);
+      colour[1] = static_cast<unsigned char>(green / alpha);
+      colour[2] = static_cast<unsigned char>(blue / alpha);
+      colour[3] = static_cast<unsigned char>(alpha / pixelCount);
+   }
+}
+
 void Tileset::load(const char* path)
 {
    std::string imagePath(path);
@@ -28,10 +104,24 @@ void Tileset::load(const char* path)
    DEBUG("Loading tileset image \"%s\"...", imagePath.c_str());
 
    int imgWidth, imgHeight;
-   GraphicsUtil::getInstance()->loadGLTexture(imagePath.c_str(), texture, imgWidth, imgHeight);
+   if(preparedImage != NULL)
+   {
+      // The image was already loaded (and its tile colours worked out) in the background, so only the upload is left
+      SDL_Surface* image = preparedImage;
+      preparedImage = NULL;
+      textureRegion = GraphicsUtil::getInstance()->loadAtlasTexture(imagePath.c_str(), image, imgWidth, imgHeight);
+   }
+   else
+   {
+      // The image is loaded here rather than by the atlas, so that its tile colours can be worked out before it is freed
+      SDL_Surface* image = GraphicsUtil::loadImage(imagePath.c_str());
+      computeTileColours(image);
+      textureRegion = GraphicsUtil::getInstance()->loadAtlasTexture(imagePath.c_str(), image, imgWidth, imgHeight);
+   }
 
    width = imgWidth / TileEngine::TILE_SIZE;
    height = imgHeight / TileEngine::TILE_SIZE;
+   computeTextureCoordinates();
 
    // A data file is needed to hold the default passibility matrix for a Tileset
    // Since maps will rarely change the passibility of tiles, it doesn't make
@@ -41,53 +131,163 @@ void Tileset::load(const char* path)
    dataPath += DATA_EXTENSION;
    DEBUG("Loading tileset data \"%s\"...", dataPath.c_str());
 
-   std::ifstream in(dataPath.c_str());
-
-   if(!in.is_open())
+   // The numbers are read straight out of the file's contents, which are terminated so that strtol stops at the end
+   std::vector<char> contents;
+   if(!AssetArchive::read(dataPath, contents))
    {  
       T_T(std::string("Error opening file: ") + path);
    }
 
-   passibility = new bool*[width];
+   contents.push_back('\0');
+   const char* cursor = &contents[0];
+
+   // The data file lists the passibility column by column
+   passibility.assign((width * height + 7) / 8, 0);
    for(int i = 0; i < width; ++i)
    {
-      passibility[i] = new bool[height];
       for(int j = 0; j < height; ++j)
       {
-         if(in)
+         long c;
+         if(!readNumber(cursor, c))
          {
-            int c;
-            in >> c;
-            passibility[i][j] = (c != 0);
+            T_T("Tileset has incomplete passibility matrix.");
          }
-         else
+
+         if(c != 0)
          {
-            T_T("Tileset has incomplete passibility matrix.");
+            const int tileNum = j * width + i;
+            passibility[tileNum >> 3] |= 1 << (tileNum & 7);
          }
       }
    }
+
+   // The passibility matrix may be followed by the tileset's animations,
+   // each given as its first tile, its number of frames and the time each frame is shown for
+   tileAnimations.assign(width * height, -1);
+
+   long firstTile, frameCount, frameTime;
+   while(readNumber(cursor, firstTile) && readNumber(cursor, frameCount) && readNumber(cursor, frameTime))
+   {
+      TileAnimation animation;
+      animation.firstTile = firstTile;
+      animation.frameCount = frameCount;
+      animation.frameTime = frameTime;
+
+      if(animation.firstTile < 0 || animation.firstTile >= width * height || animation.frameCount <= 0
+            || animation.firstTile % width + animation.frameCount > width || animation.frameTime <= 0)
+      {
+         T_T("Tileset has an animation that doesn't fit within a row of its tiles.");
+      }
+
+      tileAnimations[animation.firstTile] = animations.size();
+      animations.push_back(animation);
+   }
+
+   DEBUG("Tileset has %d animations.", static_cast<int>(animations.size()));
+}
+
+void Tileset::step(long timePassed)
+{
+   animationTime += timePassed;
+}
+
+int Tileset::getAnimationNum(int tileNum) const
+{
+   // Maps can hold tiles past the end of the tileset, such as when the tileset is reloaded smaller
+   return tileNum < static_cast<int>(tileAnimations.size()) ? tileAnimations[tileNum] : -1;
+}
+
+int Tileset::getAnimationFrame(int animationNum) const
+{
+   const TileAnimation& animation = animations[animationNum];
+   return animation.firstTile + (animationTime / animation.frameTime) % animation.frameCount;
+}
+
+void Tileset::getAnimationTransform(int animationNum, float& scale, float& offset) const
+{
+   float firstLeft, firstRight, frameLeft, frameRight, top, bottom;
+   getTextureCoordinates(animations[animationNum].firstTile, firstLeft, top, firstRight, bottom);
+   getTextureCoordinates(getAnimationFrame(animationNum), frameLeft, top, frameRight, bottom);
+
+   // Map both edges of the first tile onto the edges of the current frame
+   scale = (frameRight - frameLeft) / (firstRight - firstLeft);
+   offset = frameLeft - firstLeft * scale;
 }
    
-void Tileset::draw(int destX, int destY, int tileNum)
+void Tileset::computeTextureCoordinates()
+{
+   const int tileCount = width * height;
+   tileLefts.resize(tileCount);
+   tileTops.resize(tileCount);
+   tileRights.resize(tileCount);
+   tileBottoms.resize(tileCount);
+
+   for(int tileNum = 0; tileNum < tileCount; ++tileNum)
+   {
+      int tilesetX = tileNum % width;
+      int tilesetY = tileNum / width;
+
+      float tileRight = float((tilesetX + 1) * TileEngine::TILE_SIZE - 1);
+      float tileBottom = float((tilesetY + 1) * TileEngine::TILE_SIZE - 1);
+
+      // The coordinates within the tileset image are then moved to where the image sits in the atlas
+      tileTops[tileNum] = textureRegion.mapV(float(tilesetY) / height);
+      tileBottoms[tileNum] = textureRegion.mapV(float(tileBottom) / (height * TileEngine::TILE_SIZE - 1));
+      tileLefts[tileNum] = textureRegion.mapU(float(tilesetX) / width);
+      tileRights[tileNum] = textureRegion.mapU(float(tileRight) / (width * TileEngine::TILE_SIZE - 1));
+   }
+}
+
+void Tileset::getTextureCoordinates(int tileNum, float& left, float& top, float& right, float& bottom) const
+{
+   if(tileNum < 0 || tileNum >= static_cast<int>(tileLefts.size()))
+   {
+      // Tiles past the end of the tileset (such as after it is reloaded smaller) are drawn as nothing
+      left = right = textureRegion.left;
+      top = bottom = textureRegion.top;
+      return;
+   }
+
+   left = tileLefts[tileNum];
+   top = tileTops[tileNum];
+   right = tileRights[tileNum];
+   bottom = tileBottoms[tileNum];
+}
+
+void Tileset::bindTexture() const
+{
+   GLState::bindTexture(textureRegion.texture);
+}
+
+const TextureAtlas::Region& Tileset::getTextureRegion() const
+{
+   return textureRegion;
+}
+
+const std::vector<unsigned char>& Tileset::getTileColours() const
 {
-   int tilesetX = tileNum % width;
-   int tilesetY = tileNum / width;
+   return tileColours;
+}
 
+void Tileset::draw(int destX, int destY, int tileNum)
+{
    float destLeft = float(destX * TileEngine::TILE_SIZE);
    float destRight = float((destX + 1) * TileEngine::TILE_SIZE);
    float destTop = float(destY * TileEngine::TILE_SIZE);
    float destBottom = float((destY + 1) * TileEngine::TILE_SIZE);
 
-   float tileRight = float((tilesetX + 1) * TileEngine::TILE_SIZE - 1);
-   float tileBottom = float((tilesetY + 1) * TileEngine::TILE_SIZE - 1);
+   const int animationNum = getAnimationNum(tileNum);
+   if(animationNum >= 0)
+   {
+      tileNum = getAnimationFrame(animationNum);
+   }
 
-   float top = float(tilesetY) / height;
-   float bottom = float(tileBottom) / (height * TileEngine::TILE_SIZE - 1);
-   float left = float(tilesetX) / width;
-   float right = float(tileRight) / (width * TileEngine::TILE_SIZE - 1);
+   float left, top, right, bottom;
+   getTextureCoordinates(tileNum, left, top, right, bottom);
 
-   glBindTexture(GL_TEXTURE_2D, texture);
+   bindTexture();
 
+   GLState::countDrawCall();
    glBegin(GL_QUADS);
       glTexCoord2f(left, top); glVertex3f(destLeft, destTop, 0.0f);
       glTexCoord2f(right, top); glVertex3f(destRight, destTop, 0.0f);
@@ -103,7 +303,8 @@ void Tileset::drawColorToTile(int destX, int destY, float r, float g, float b)
    float destTop = float(destY * TileEngine::TILE_SIZE);
    float destBottom = float((destY + 1) * TileEngine::TILE_SIZE);
 
-   glDisable(GL_TEXTURE_2D);
+   GLState::setTexturing(false);
+   GLState::countDrawCall();
    glBegin(GL_QUADS);
       glColor3f(r, g, b);
       glVertex3f(destLeft, destTop, 0.0f);
@@ -112,30 +313,64 @@ void Tileset::drawColorToTile(int destX, int destY, float r, float g, float b)
       glVertex3f(destLeft, destBottom, 0.0f);
       glColor3f(1.0f, 1.0f, 1.0f);
    glEnd();
-   glEnable(GL_TEXTURE_2D);
+}
+
+void Tileset::invalidate(const char* path)
+{
+   GraphicsUtil::getInstance()->forgetAtlasTexture((std::string(path) + IMG_EXTENSION).c_str());
+}
+
+bool Tileset::canReload()
+{
+   return true;
+}
+
+void Tileset::swapData(Resource& other)
+{
+   Tileset& otherTileset = static_cast<Tileset&>(other);
+   std::swap(width, otherTileset.width);
+   std::swap(height, otherTileset.height);
+   passibility.swap(otherTileset.passibility);
+   std::swap(textureRegion, otherTileset.textureRegion);
+   animations.swap(otherTileset.animations);
+   tileAnimations.swap(otherTileset.tileAnimations);
+   tileLefts.swap(otherTileset.tileLefts);
+   tileTops.swap(otherTileset.tileTops);
+   tileRights.swap(otherTileset.tileRights);
+   tileBottoms.swap(otherTileset.tileBottoms);
+   tileColours.swap(otherTileset.tileColours);
 }
 
 size_t Tileset::getSize()
 {
-   return sizeof(this);
+   // The tileset's image is kept as a 32-bit texture, alongside its passibility, animations, texture coordinates and tile colours
+   const int tileCount = width * height;
+   size_t size = sizeof(*this) + tileCount * TileEngine::TILE_SIZE * TileEngine::TILE_SIZE * 4
+         + passibility.size() + animations.size() * sizeof(TileAnimation) + tileAnimations.size() * sizeof(int)
+         + tileCount * 4 * sizeof(float) + tileColours.size();
+
+   if(preparedImage != NULL)
+   {
+      size += preparedImage->pitch * preparedImage->h;
+   }
+
+   return size;
 }
 
 bool Tileset::isPassible(int tileNum) const
 {
-   int tilesetX = tileNum % width;
-   int tilesetY = tileNum / width;
+   if(tileNum < 0 || tileNum >= width * height)
+   {
+      return false;
+   }
 
-   return passibility[tilesetX][tilesetY];
+   return (passibility[tileNum >> 3] & (1 << (tileNum & 7))) != 0;
 }
 
 Tileset::~Tileset()
 {
-   for(int i = 0; i < width; ++i)
+   if(preparedImage != NULL)
    {
-      delete [] passibility[i];
+      SDL_FreeSurface(preparedImage);
    }
-
-   delete [] passibility;
-
-   glDeleteTextures(1, &texture);
 }
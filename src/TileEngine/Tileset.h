@@ -8,13 +8,20 @@
 #define TILESET_H
 
 #include "Resource.h"
+#include "TextureAtlas.h"
+#include <vector>
 
-typedef unsigned int GLuint;
+struct SDL_Surface;
 
 /**
  * This resource holds a tileset image texture and associated data
  * including dimensions (in tiles) and default passibility of each tile.
  *
+ * Tiles can also be animated (such as water or torches). An animation plays a run of
+ * consecutive tiles in one row of the tileset, and is placed on a map as its first tile.
+ * Every animation in the tileset is played by the same clock, so that all of the
+ * tiles showing an animation stay in step with each other.
+ *
  * @author Noam Chitayat
  */
 class Tileset : public Resource
@@ -31,14 +38,79 @@ class Tileset : public Resource
    /** Height (in tiles) */
    int height;
 
-   /** Passibility matrix */
-   bool** passibility;
-
-   /** The tile texture */
-   GLuint texture;
+   /**
+    * The default passibility of each tile, packed one bit per tile by tile index (bit i % 8 of byte i / 8),
+    * which is set iff the tile is passible. Maps build their own passibility out of it when they load.
+    */
+   std::vector<unsigned char> passibility;
+
+   /** The region of the texture atlas that holds the tiles */
+   TextureAtlas::Region textureRegion;
+
+   /**
+    * The texture coordinates of each tile in the texture atlas, worked out when the tileset is loaded.
+    * Each edge is kept in its own array (indexed by tile), so that runs of tiles can be copied out together.
+    */
+   std::vector<float> tileLefts, tileTops, tileRights, tileBottoms;
+
+   /** The average colour of each tile (as RGBA, with the colour weighted by the pixels' alpha), for drawing maps in miniature. */
+   std::vector<unsigned char> tileColours;
+
+   /** An animation of consecutive tiles in a row of the tileset */
+   struct TileAnimation
+   {
+      /** The first tile of the animation, which is the tile placed on maps */
+      int firstTile;
+
+      /** The number of tiles (frames) in the animation */
+      int frameCount;
+
+      /** The time that each frame is shown for (in milliseconds) */
+      long frameTime;
+   };
+
+   /** The animations in the tileset */
+   std::vector<TileAnimation> animations;
+
+   /** The index of the animation that starts at each tile, or -1 for tiles that don't start one */
+   std::vector<int> tileAnimations;
+
+   /** The time that the animations have been playing (in milliseconds) */
+   long animationTime;
+
+   /** The tileset image, if it was loaded ahead of time by prepare() and hasn't been packed into the atlas yet */
+   SDL_Surface* preparedImage;
+
+   /**
+    * @param animationNum The index of an animation.
+    *
+    * @return The tile showing the animation's current frame.
+    */
+   int getAnimationFrame(int animationNum) const;
+
+   /**
+    * Works out the texture coordinates of every tile, once the tileset's size and place in the atlas are known.
+    */
+   void computeTextureCoordinates();
+
+   /**
+    * Works out the average colour of every tile in the tileset's image.
+    * This doesn't touch the OpenGL context, so that it can be done while the tileset is prepared in the background.
+    *
+    * @param image The tileset's image.
+    */
+   void computeTileColours(SDL_Surface* image);
 
    void load(const char* path);
 
+   /**
+    * Implementation of method in Resource class.
+    * Swaps the tileset's image, size, passibility and animations, leaving the animations' clock running.
+    *
+    * @param other The tileset to swap data with.
+    */
+   void swapData(Resource& other);
+
    public:
 
       /**
@@ -48,10 +120,33 @@ class Tileset : public Resource
        */
       Tileset(ResourceKey name);
 
+      /**
+       * Implementation of method in Resource class.
+       * Loads the tileset image, leaving it to be packed into the texture atlas when the tileset is loaded.
+       *
+       * @param path The path to the tileset's files (without their extensions).
+       */
+      void prepare(const char* path);
+
+      /**
+       * Implementation of method in Resource class.
+       * Forgets the tileset image's space in the texture atlas, so that the image is loaded afresh.
+       *
+       * @param path The path to the tileset's files (without their extensions).
+       */
+      void invalidate(const char* path);
+
       /**
        * Implementation of method in Resource class.
        *
-       * @return The size of the tileset resource in memory.
+       * @return true, since maps rebuild their tiles when their tileset is reloaded.
+       */
+      bool canReload();
+
+      /**
+       * Implementation of method in Resource class.
+       *
+       * @return The size of the tileset resource in memory, including its texture.
        */
       size_t getSize();
 
@@ -66,7 +161,32 @@ class Tileset : public Resource
       int getHeight();
 
       /**
-       * Draws the specified tile to the coordinates specified
+       * Plays the tileset's animations forward.
+       *
+       * @param timePassed The time since the last step (in milliseconds).
+       */
+      void step(long timePassed);
+
+      /**
+       * @param tileNum The index of a tile.
+       *
+       * @return The index of the animation that the tile starts, or -1 if the tile isn't animated.
+       */
+      int getAnimationNum(int tileNum) const;
+
+      /**
+       * Gets the horizontal texture coordinate transform that moves an animation's first tile onto its current frame,
+       * so that tiles drawn with the first tile's coordinates can be animated from the texture matrix.
+       *
+       * @param animationNum The index of the animation.
+       * @param scale The parameter used to return the factor to multiply horizontal texture coordinates by.
+       * @param offset The parameter used to return the amount to add to horizontal texture coordinates afterwards.
+       */
+      void getAnimationTransform(int animationNum, float& scale, float& offset) const;
+
+      /**
+       * Draws the specified tile to the coordinates specified.
+       * Animated tiles are drawn at their current frame.
        *
        * @param destX The destination x-location (in tiles)
        * @param destY The destination y-location (in tiles)
@@ -75,7 +195,35 @@ class Tileset : public Resource
       void draw(int destX, int destY, int tileNum);
 
       /**
-       * Draws the specified color to the coordinates specified
+       * Gets the texture coordinates of a tile in the texture atlas, for drawing tiles in batches.
+       *
+       * @param tileNum The index of the tile
+       * @param left The parameter used to return the left texture coordinate
+       * @param top The parameter used to return the top texture coordinate
+       * @param right The parameter used to return the right texture coordinate
+       * @param bottom The parameter used to return the bottom texture coordinate
+       */
+      void getTextureCoordinates(int tileNum, float& left, float& top, float& right, float& bottom) const;
+
+      /**
+       * Binds the atlas texture holding the tileset, for drawing tiles in batches.
+       */
+      void bindTexture() const;
+
+      /**
+       * @return Where the tileset's image sits in its atlas page, for looking up tiles in a shader.
+       */
+      const TextureAtlas::Region& getTextureRegion() const;
+
+      /**
+       * @return The average colour of each tile, as 4 bytes (red, green, blue and alpha) per tile by tile index.
+       */
+      const std::vector<unsigned char>& getTileColours() const;
+
+      /**
+       * Draws the specified color to the coordinates specified.
+       * Texturing is left disabled afterwards, so that a run of colored tiles doesn't
+       * switch it back and forth; re-enable it with GLState::setTexturing once the run is done.
        *
        * @param destX The destination x-location (in tiles)
        * @param destY The destination y-location (in tiles)
@@ -88,7 +236,7 @@ class Tileset : public Resource
       /**
        * @param tileNum The index of the tile to check
        *
-       * @return true iff the tile at tileNum is passible by default
+       * @return true iff the tile at tileNum is passible by default (tiles that aren't in the tileset are impassible)
        */
       bool isPassible(int tileNum) const;
 
@@ -0,0 +1,358 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "TimelinePlayer.h"
+#include "TileEngine.h"
+#include "ScriptEngine.h"
+#include "JsonPullParser.h"
+#include "NPC.h"
+#include "PlayerCharacter.h"
+#include "GraphicsUtil.h"
+#include "ScreenTransition.h"
+#include "ResourceLoader.h"
+#include "Music.h"
+#include "Sound.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_TILE_ENG;
+
+// Timelines are authored beside the scripts that play them
+static const std::string TIMELINE_PATH = "data/scripts/timelines/";
+static const std::string TIMELINE_EXTENSION = ".json";
+
+const char* TimelinePlayer::PLAYER_ACTOR = "player";
+
+TimelinePlayer::Keyframe::Keyframe() : time(0), type(SCRIPT), location(0, 0), located(false), duration(0), flagged(false)
+{
+}
+
+TimelinePlayer::TimelinePlayer(TileEngine& tileEngine, ScriptEngine& scriptEngine, const std::string& timelineName)
+   : tileEngine(tileEngine), scriptEngine(scriptEngine), timelineName(timelineName), nextKey(0), nextCameraKey(0), length(0), time(0), holdingCamera(false)
+{
+   const std::string path = TIMELINE_PATH + timelineName + TIMELINE_EXTENSION;
+   DEBUG("Loading timeline \"%s\"...", path.c_str());
+
+   JsonPullParser parser(path);
+   if(parser.peek() != JsonPullParser::OBJECT)
+   {
+      DEBUG("Unexpected root element in timeline %s.", timelineName.c_str());
+      T_T("Failed to parse timeline.");
+   }
+
+   std::string key;
+   parser.beginObject();
+   while(parser.nextKey(key))
+   {
+      if(key == "tracks") parseTracks(parser);
+      else if(key == "length") length = parser.readInt();
+      else parser.skipValue();
+   }
+
+   parser.finish();
+
+   // The keys of each track are already in order, so a stable sort keeps the tracks' order among keys at the same time
+   std::stable_sort(keys.begin(), keys.end(), isEarlier);
+   std::stable_sort(cameraKeys.begin(), cameraKeys.end(), isEarlier);
+
+   if(!keys.empty()) length = std::max(length, keys.back().time);
+   if(!cameraKeys.empty()) length = std::max(length, cameraKeys.back().time);
+
+   DEBUG("Timeline %s loaded with %d keys over %ld milliseconds.", timelineName.c_str(), static_cast<int>(keys.size() + cameraKeys.size()), length);
+}
+
+void TimelinePlayer::parseTracks(JsonPullParser& parser)
+{
+   if(parser.peek() != JsonPullParser::ARRAY)
+   {
+      DEBUG("The tracks of timeline %s aren't a list.", timelineName.c_str());
+      T_T("Failed to parse timeline.");
+   }
+
+   std::string key;
+   std::string typeName;
+   std::string actor;
+   std::vector<Keyframe> trackKeys;
+
+   parser.beginArray();
+   while(parser.hasNextElement())
+   {
+      typeName.clear();
+      actor.clear();
+      trackKeys.clear();
+
+      parser.beginObject();
+      while(parser.nextKey(key))
+      {
+         if(key == "type")
+         {
+            parser.readString(typeName);
+         }
+         else if(key == "actor")
+         {
+            parser.readString(actor);
+         }
+         else if(key == "keys" && parser.peek() == JsonPullParser::ARRAY)
+         {
+            parser.beginArray();
+            while(parser.hasNextElement())
+            {
+               trackKeys.push_back(Keyframe());
+               parseKey(parser, trackKeys.back());
+            }
+         }
+         else
+         {
+            parser.skipValue();
+         }
+      }
+
+      // The track's type and actor can come after its keys, so they are only filled in once the whole track is read
+      TrackType type;
+      if(!parseTrackType(typeName, type))
+      {
+         DEBUG("Encountered unknown track type \"%s\" in timeline %s.", typeName.c_str(), timelineName.c_str());
+         T_T("Parse error reading timeline.");
+      }
+
+      if((type == MOVE || type == ANIMATION) && actor.empty())
+      {
+         DEBUG("Encountered %s track without an actor in timeline %s.", typeName.c_str(), timelineName.c_str());
+         T_T("Parse error reading timeline.");
+      }
+
+      std::vector<Keyframe>& track = type == CAMERA ? cameraKeys : keys;
+      for(std::vector<Keyframe>::iterator trackKey = trackKeys.begin(); trackKey != trackKeys.end(); ++trackKey)
+      {
+         trackKey->type = type;
+         trackKey->actor = actor;
+         track.push_back(*trackKey);
+      }
+   }
+}
+
+void TimelinePlayer::parseKey(JsonPullParser& parser, Keyframe& keyframe)
+{
+   bool hasX = false;
+   bool hasY = false;
+
+   std::string key;
+   parser.beginObject();
+   while(parser.nextKey(key))
+   {
+      if(key == "time")
+      {
+         keyframe.time = parser.readInt();
+      }
+      else if(key == "x")
+      {
+         keyframe.location.x = parser.readInt();
+         hasX = true;
+      }
+      else if(key == "y")
+      {
+         keyframe.location.y = parser.readInt();
+         hasY = true;
+      }
+      else if(key == "duration")
+      {
+         keyframe.duration = parser.readInt();
+      }
+      else if(key == "animation" || key == "effect" || key == "sound" || key == "music" || key == "text" || key == "script")
+      {
+         parser.readString(keyframe.value);
+      }
+      else if(key == "follow" || key == "stop" || key == "narrate")
+      {
+         keyframe.flagged = parser.readBool();
+      }
+      else
+      {
+         parser.skipValue();
+      }
+   }
+
+   keyframe.located = hasX && hasY;
+}
+
+bool TimelinePlayer::parseTrackType(const std::string& name, TrackType& type)
+{
+   if(name == "move") type = MOVE;
+   else if(name == "animation") type = ANIMATION;
+   else if(name == "camera") type = CAMERA;
+   else if(name == "transition") type = TRANSITION;
+   else if(name == "sound") type = SOUND;
+   else if(name == "music") type = MUSIC;
+   else if(name == "dialogue") type = DIALOGUE;
+   else if(name == "script") type = SCRIPT;
+   else return false;
+
+   return true;
+}
+
+bool TimelinePlayer::isEarlier(const Keyframe& first, const Keyframe& second)
+{
+   return first.time < second.time;
+}
+
+std::string TimelinePlayer::getName()
+{
+   return "timeline " + timelineName;
+}
+
+Actor* TimelinePlayer::findActor(const std::string& name) const
+{
+   if(name == PLAYER_ACTOR)
+   {
+      return tileEngine.getPlayerCharacter();
+   }
+
+   return tileEngine.getNPC(name);
+}
+
+void TimelinePlayer::play(const Keyframe& key)
+{
+   Actor* actor = key.actor.empty() ? NULL : findActor(key.actor);
+   if(!key.actor.empty() && actor == NULL)
+   {
+      DEBUG("Timeline %s skipped a key for actor %s, who isn't on the map.", timelineName.c_str(), key.actor.c_str());
+      return;
+   }
+
+   switch(key.type)
+   {
+      case MOVE:
+      {
+         actor->move(key.location.x, key.location.y);
+         break;
+      }
+      case ANIMATION:
+      {
+         actor->setAnimation(key.value);
+         break;
+      }
+      case TRANSITION:
+      {
+         const ScreenTransition::Style style = key.value == "wipeOut" || key.value == "wipeIn" ? ScreenTransition::WIPE : ScreenTransition::FADE;
+         const bool covering = key.value == "fadeOut" || key.value == "wipeOut";
+         GraphicsUtil::getInstance()->getTransition()->start(style, 0.0f, 0.0f, 0.0f, covering, key.duration);
+         break;
+      }
+      case SOUND:
+      {
+         Sound* sound = ResourceLoader::getSound(key.value);
+         if(key.located)
+         {
+            sound->playAt(key.location.x, key.location.y);
+         }
+         else if(actor != NULL)
+         {
+            sound->playFrom(tileEngine.getActorHandle(actor));
+         }
+         else
+         {
+            sound->play();
+         }
+         break;
+      }
+      case MUSIC:
+      {
+         if(key.flagged)
+         {
+            Music::fadeOutMusic(key.duration);
+         }
+         else
+         {
+            ResourceLoader::getMusic(key.value)->play(key.duration);
+         }
+         break;
+      }
+      case DIALOGUE:
+      {
+         if(key.flagged)
+         {
+            tileEngine.dialogueNarrate(key.value.c_str(), NULL);
+         }
+         else
+         {
+            tileEngine.dialogueSay(key.value.c_str(), NULL);
+         }
+         break;
+      }
+      case SCRIPT:
+      {
+         // The script runs alongside the cutscene, which keeps to its own clock instead of waiting for it
+         scriptEngine.startScriptString(key.value);
+         break;
+      }
+      case CAMERA:
+      {
+         break;
+      }
+   }
+}
+
+void TimelinePlayer::moveCamera()
+{
+   while(nextCameraKey < cameraKeys.size() && cameraKeys[nextCameraKey].time <= time)
+   {
+      ++nextCameraKey;
+   }
+
+   if(nextCameraKey == 0) return;
+
+   const Keyframe& lastKey = cameraKeys[nextCameraKey - 1];
+   if(lastKey.flagged)
+   {
+      if(holdingCamera)
+      {
+         tileEngine.releaseCamera();
+         holdingCamera = false;
+      }
+
+      return;
+   }
+
+   shapes::Point2D focus = lastKey.location;
+   if(nextCameraKey < cameraKeys.size() && !cameraKeys[nextCameraKey].flagged)
+   {
+      // The camera glides from the last key's point to the next one's, getting there right at the next key
+      const Keyframe& upcomingKey = cameraKeys[nextCameraKey];
+      const double progress = double(time - lastKey.time) / double(upcomingKey.time - lastKey.time);
+      focus.x += static_cast<int>((upcomingKey.location.x - lastKey.location.x) * progress);
+      focus.y += static_cast<int>((upcomingKey.location.y - lastKey.location.y) * progress);
+   }
+
+   tileEngine.holdCamera(focus);
+   holdingCamera = true;
+}
+
+bool TimelinePlayer::resume(long timePassed)
+{
+   time += timePassed;
+
+   while(nextKey < keys.size() && keys[nextKey].time <= time)
+   {
+      play(keys[nextKey]);
+      ++nextKey;
+   }
+
+   moveCamera();
+
+   if(time < length)
+   {
+      return false;
+   }
+
+   if(holdingCamera)
+   {
+      tileEngine.releaseCamera();
+   }
+
+   DEBUG("Timeline %s finished.", timelineName.c_str());
+   return true;
+}
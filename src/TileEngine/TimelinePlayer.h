@@ -0,0 +1,202 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef TIMELINE_PLAYER_H
+#define TIMELINE_PLAYER_H
+
+#include "Thread.h"
+#include "Point2D.h"
+#include <string>
+#include <vector>
+
+class Actor;
+class JsonPullParser;
+class ScriptEngine;
+class TileEngine;
+
+/**
+ * Plays a cutscene from a timeline, without running any Lua until the timeline calls for it.
+ *
+ * A timeline (data/scripts/timelines/<name>.json) is an object holding a list of "tracks" and, optionally,
+ * the "length" of the cutscene in milliseconds (which is otherwise the time of its last key). Each track has a "type",
+ * the "actor" that it drives (an NPC's name, or "player") where the type needs one, and a list of "keys",
+ * each with the "time" (in milliseconds from the start of the cutscene) at which it happens:
+ *
+ * - move: the actor starts walking to "x", "y" (in pixels).
+ * - animation: the actor plays the "animation".
+ * - camera: the camera is held on "x", "y" (in pixels), gliding there from the last camera key,
+ *   or follows the player again if the key has "follow": true.
+ * - transition: the screen plays the "effect" (fadeOut, fadeIn, wipeOut or wipeIn) over the "duration".
+ * - sound: the "sound" plays, from "x", "y" (in pixels) if they are given, or from the track's actor if it has one.
+ * - music: the "music" starts, fading in over the "duration", or the music fades out over the "duration" if the key has "stop": true.
+ * - dialogue: the "text" is said, or narrated if the key has "narrate": true.
+ * - script: the Lua "script" is run, as the one point where the cutscene hands over to Lua.
+ *
+ * All of the tracks run on the cutscene's own clock, which is advanced by exactly the time given to each frame,
+ * so the keys happen on the same frames every time the cutscene plays. Keys at the same time happen in the order
+ * that their tracks are listed. Once the cutscene is over, the camera follows the player again.
+ */
+class TimelinePlayer : public Thread
+{
+   /** The kinds of tracks in a timeline. */
+   enum TrackType
+   {
+      MOVE,
+      ANIMATION,
+      CAMERA,
+      TRANSITION,
+      SOUND,
+      MUSIC,
+      DIALOGUE,
+      SCRIPT
+   };
+
+   /** A key of one of the timeline's tracks. */
+   struct Keyframe
+   {
+      /** The time of the key (in milliseconds from the start of the cutscene). */
+      long time;
+
+      /** The type of the key's track. */
+      TrackType type;
+
+      /** The name of the actor that the key's track drives, or an empty string if it doesn't drive one. */
+      std::string actor;
+
+      /** The name or text that the key carries (an animation, a sound, music, an effect, dialogue or a script, depending on the track). */
+      std::string value;
+
+      /** The point (in pixels) given by the key, if it has one. */
+      shapes::Point2D location;
+
+      /** true iff the key gives a point. */
+      bool located;
+
+      /** The duration of the key's effect (in milliseconds). */
+      long duration;
+
+      /** true iff the key's camera follows the player, its music stops, or its dialogue is narrated (depending on the track). */
+      bool flagged;
+
+      Keyframe();
+   };
+
+   /** The name that tracks use for the player's actor. */
+   static const char* PLAYER_ACTOR;
+
+   /** The tile engine that the cutscene plays in. */
+   TileEngine& tileEngine;
+
+   /** The script engine that runs the cutscene's scripts. */
+   ScriptEngine& scriptEngine;
+
+   /** The name of the timeline. */
+   const std::string timelineName;
+
+   /** The keys of every track but the camera's, in the order that they happen. */
+   std::vector<Keyframe> keys;
+
+   /** The keys of the camera track, in the order that they happen, which are kept apart so that the camera can glide between them. */
+   std::vector<Keyframe> cameraKeys;
+
+   /** The index of the next key to happen. */
+   unsigned int nextKey;
+
+   /** The index of the next camera key to happen. */
+   unsigned int nextCameraKey;
+
+   /** The length of the cutscene (in milliseconds). */
+   long length;
+
+   /** The time (in milliseconds) that the cutscene has been playing for. */
+   long time;
+
+   /** true iff the cutscene is holding the camera. */
+   bool holdingCamera;
+
+   /**
+    * Reads the tracks of a timeline into its keys.
+    *
+    * @param parser The parser, at the timeline's list of tracks.
+    */
+   void parseTracks(JsonPullParser& parser);
+
+   /**
+    * Reads a key of one of the timeline's tracks.
+    *
+    * @param parser The parser, at the key.
+    * @param keyframe The parameter used to return the key.
+    */
+   static void parseKey(JsonPullParser& parser, Keyframe& keyframe);
+
+   /**
+    * @param name The name of a track type.
+    * @param type The parameter used to return the track type.
+    *
+    * @return true iff the name is a track type.
+    */
+   static bool parseTrackType(const std::string& name, TrackType& type);
+
+   /**
+    * @return true iff the first key happens before the second.
+    */
+   static bool isEarlier(const Keyframe& first, const Keyframe& second);
+
+   /**
+    * @param name The name of an actor, or PLAYER_ACTOR.
+    *
+    * @return The actor, or NULL if it isn't on the map.
+    */
+   Actor* findActor(const std::string& name) const;
+
+   /**
+    * Makes a key happen.
+    *
+    * @param key The key.
+    */
+   void play(const Keyframe& key);
+
+   /**
+    * Moves the camera to where the camera track has it at the cutscene's current time.
+    */
+   void moveCamera();
+
+   /**
+    * TimelinePlayers can't be copied.
+    */
+   TimelinePlayer(const TimelinePlayer&);
+
+   /**
+    * TimelinePlayers can't be copied.
+    */
+   TimelinePlayer& operator=(const TimelinePlayer&);
+
+   public:
+      /**
+       * Constructor. Reads the timeline.
+       *
+       * @param tileEngine The tile engine that the cutscene plays in.
+       * @param scriptEngine The script engine that runs the cutscene's scripts.
+       * @param timelineName The name of the timeline.
+       */
+      TimelinePlayer(TileEngine& tileEngine, ScriptEngine& scriptEngine, const std::string& timelineName);
+
+      /**
+       * @return The name of the timeline.
+       */
+      std::string getName();
+
+      /**
+       * Advances the cutscene, making every key up to its new time happen.
+       *
+       * @param timePassed The number of milliseconds that has passed since the last frame.
+       *
+       * @return true iff the cutscene is over.
+       */
+      bool resume(long timePassed);
+};
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "TriggerZones.h"
+#include "Task.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_ENTITY_GRID;
+
+// The same size as the actor index's cells, so that an actor's move touches about as many cells in each
+const int TriggerZones::CELL_SIZE = 64;
+
+TriggerZones::TriggerZones() : cellsWide(0), cellsHigh(0), nextId(INVALID_TRIGGER + 1)
+{
+}
+
+void TriggerZones::resize(int pixelWidth, int pixelHeight)
+{
+   // The scripts watching the last map's zones are woken up, and find that they have no events left
+   for(std::map<TriggerId, Zone>::iterator iter = zones.begin(); iter != zones.end(); ++iter)
+   {
+      wake(iter->second);
+   }
+
+   zones.clear();
+
+   cellsWide = std::max(1, (pixelWidth + CELL_SIZE - 1) / CELL_SIZE);
+   cellsHigh = std::max(1, (pixelHeight + CELL_SIZE - 1) / CELL_SIZE);
+
+   cells.clear();
+   cells.resize(cellsWide * cellsHigh);
+}
+
+bool TriggerZones::isEmpty() const
+{
+   return zones.empty();
+}
+
+shapes::Rectangle TriggerZones::getCellRange(const shapes::Rectangle& area) const
+{
+   return shapes::Rectangle(std::max(0, area.top / CELL_SIZE),
+                            std::max(0, area.left / CELL_SIZE),
+                            std::min(cellsHigh - 1, area.bottom / CELL_SIZE),
+                            std::min(cellsWide - 1, area.right / CELL_SIZE));
+}
+
+void TriggerZones::findZones(const shapes::Rectangle& area, std::vector<TriggerId>& ids) const
+{
+   const shapes::Rectangle cellRange = getCellRange(area);
+   for(int cellY = cellRange.top; cellY <= cellRange.bottom; ++cellY)
+   {
+      for(int cellX = cellRange.left; cellX <= cellRange.right; ++cellX)
+      {
+         const std::vector<TriggerId>& cell = cells[cellY * cellsWide + cellX];
+         ids.insert(ids.end(), cell.begin(), cell.end());
+      }
+   }
+}
+
+void TriggerZones::wake(Zone& zone)
+{
+   if(zone.waitingTask != NULL)
+   {
+      zone.waitingTask->signal();
+      zone.waitingTask = NULL;
+   }
+}
+
+TriggerZones::TriggerId TriggerZones::add(const shapes::Rectangle& area)
+{
+   if(cells.empty()) return INVALID_TRIGGER;
+
+   const TriggerId id = nextId++;
+   zones.insert(std::make_pair(id, Zone(area)));
+
+   const shapes::Rectangle cellRange = getCellRange(area);
+   for(int cellY = cellRange.top; cellY <= cellRange.bottom; ++cellY)
+   {
+      for(int cellX = cellRange.left; cellX <= cellRange.right; ++cellX)
+      {
+         cells[cellY * cellsWide + cellX].push_back(id);
+      }
+   }
+
+   DEBUG("Watching trigger zone %u from %d,%d to %d,%d", id, area.left, area.top, area.right, area.bottom);
+   return id;
+}
+
+void TriggerZones::remove(TriggerId id)
+{
+   std::map<TriggerId, Zone>::iterator zone = zones.find(id);
+   if(zone == zones.end()) return;
+
+   const shapes::Rectangle cellRange = getCellRange(zone->second.area);
+   for(int cellY = cellRange.top; cellY <= cellRange.bottom; ++cellY)
+   {
+      for(int cellX = cellRange.left; cellX <= cellRange.right; ++cellX)
+      {
+         std::vector<TriggerId>& cell = cells[cellY * cellsWide + cellX];
+         cell.erase(std::remove(cell.begin(), cell.end(), id), cell.end());
+      }
+   }
+
+   wake(zone->second);
+   zones.erase(zone);
+}
+
+void TriggerZones::actorMoved(ActorTable::ActorHandle actor, const shapes::Rectangle* previousArea, const shapes::Rectangle* currentArea)
+{
+   if(zones.empty()) return;
+   if(previousArea != NULL && currentArea != NULL && previousArea->top == currentArea->top && previousArea->left == currentArea->left
+         && previousArea->bottom == currentArea->bottom && previousArea->right == currentArea->right)
+   {
+      return;
+   }
+
+   // Only the zones near where the actor was or is now can have changed
+   std::vector<TriggerId> ids;
+   if(previousArea != NULL) findZones(*previousArea, ids);
+   if(currentArea != NULL) findZones(*currentArea, ids);
+
+   std::sort(ids.begin(), ids.end());
+   ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+   for(std::vector<TriggerId>::const_iterator iter = ids.begin(); iter != ids.end(); ++iter)
+   {
+      Zone& zone = zones.find(*iter)->second;
+      const bool wasInside = previousArea != NULL && previousArea->intersects(zone.area);
+      const bool isInside = currentArea != NULL && currentArea->intersects(zone.area);
+      if(wasInside == isInside) continue;
+
+      TRACE("Actor %u %s trigger zone %u", actor, isInside ? "entered" : "left", *iter);
+
+      Event event = { actor, isInside };
+      zone.events.push_back(event);
+      wake(zone);
+   }
+}
+
+bool TriggerZones::wait(TriggerId id, Task* task)
+{
+   std::map<TriggerId, Zone>::iterator zone = zones.find(id);
+   if(zone == zones.end() || !zone->second.events.empty()) return false;
+
+   wake(zone->second);
+   zone->second.waitingTask = task;
+   return true;
+}
+
+bool TriggerZones::takeEvent(TriggerId id, Event& event)
+{
+   std::map<TriggerId, Zone>::iterator zone = zones.find(id);
+   if(zone == zones.end() || zone->second.events.empty()) return false;
+
+   event = zone->second.events.front();
+   zone->second.events.pop_front();
+   return true;
+}
@@ -0,0 +1,168 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef TRIGGER_ZONES_H
+#define TRIGGER_ZONES_H
+
+#include <deque>
+#include <map>
+#include <vector>
+#include "ActorTable.h"
+#include "Rectangle.h"
+
+class Task;
+
+/**
+ * The TriggerZones are the areas of a map that scripts watch for actors entering and leaving.
+ *
+ * Instead of a script checking where the actors are every frame, the entity grid reports each actor's move
+ * to the trigger zones, which work out which zones the actor has come into or gone out of, and queue an event for each.
+ * A script waiting on a zone is blocked on a task, which is only signalled once an event is queued for the zone.
+ *
+ * The zones are bucketed into a uniform grid of cells, like the actors in the ActorIndex, so a move only looks at
+ * the zones in the cells around the actor, and a move that stays within the same zones costs a few rectangle tests.
+ */
+class TriggerZones
+{
+   public:
+      /** Identifies a trigger zone. */
+      typedef unsigned int TriggerId;
+
+      /** The ID that no trigger zone has. */
+      static const TriggerId INVALID_TRIGGER = 0;
+
+      /** An actor coming into or going out of a trigger zone. */
+      struct Event
+      {
+         /** The handle of the actor. */
+         ActorTable::ActorHandle actor;
+
+         /** true if the actor came into the zone, or false if it went out of it. */
+         bool entered;
+      };
+
+   private:
+      /** The width and height (in pixels) of each cell. */
+      static const int CELL_SIZE;
+
+      /** An area being watched. */
+      struct Zone
+      {
+         /** The area of the zone (with inclusive edge coordinates in pixels). */
+         shapes::Rectangle area;
+
+         /** The events that haven't been taken yet, oldest first. */
+         std::deque<Event> events;
+
+         /** The task of the script waiting for the zone's next event, or NULL if no script is waiting. */
+         Task* waitingTask;
+
+         Zone(const shapes::Rectangle& area) : area(area), waitingTask(NULL) {}
+      };
+
+      /** The number of cells across the width of the map. */
+      int cellsWide;
+
+      /** The number of cells down the height of the map. */
+      int cellsHigh;
+
+      /** The zones filed in each cell, stored row by row. */
+      std::vector<std::vector<TriggerId> > cells;
+
+      /** The zones, mapped by ID. */
+      std::map<TriggerId, Zone> zones;
+
+      /** The ID that the next zone is given. */
+      TriggerId nextId;
+
+      /**
+       * @param area An area of the map (with inclusive edge coordinates in pixels).
+       *
+       * @return The cells covered by the area, clamped to the map (with inclusive edge coordinates in cells).
+       */
+      shapes::Rectangle getCellRange(const shapes::Rectangle& area) const;
+
+      /**
+       * Adds the zones filed in the cells covered by an area to a list.
+       *
+       * @param area The area (with inclusive edge coordinates in pixels).
+       * @param ids The zones are added to the back of this list, which can end up holding a zone more than once.
+       */
+      void findZones(const shapes::Rectangle& area, std::vector<TriggerId>& ids) const;
+
+      /**
+       * Signals the task waiting on a zone, if there is one.
+       *
+       * @param zone The zone.
+       */
+      static void wake(Zone& zone);
+
+   public:
+      /**
+       * Constructor.
+       */
+      TriggerZones();
+
+      /**
+       * Removes every zone (waking up the scripts waiting on them) and resizes the grid of cells to cover a map.
+       *
+       * @param pixelWidth The width of the map (in pixels).
+       * @param pixelHeight The height of the map (in pixels).
+       */
+      void resize(int pixelWidth, int pixelHeight);
+
+      /**
+       * @return true iff there are no zones.
+       */
+      bool isEmpty() const;
+
+      /**
+       * Starts watching an area. Actors that are already in the area don't raise an event until they leave it.
+       *
+       * @param area The area to watch (with inclusive edge coordinates in pixels).
+       *
+       * @return The ID of the new zone.
+       */
+      TriggerId add(const shapes::Rectangle& area);
+
+      /**
+       * Stops watching a zone, waking up the script waiting on it.
+       *
+       * @param id The ID of the zone.
+       */
+      void remove(TriggerId id);
+
+      /**
+       * Queues an event for each zone that an actor has come into or gone out of.
+       *
+       * @param actor The handle of the actor.
+       * @param previousArea The area that the actor covered before (with inclusive edge coordinates in pixels), or NULL if it wasn't on the map.
+       * @param currentArea The area that the actor covers now (with inclusive edge coordinates in pixels), or NULL if it has left the map.
+       */
+      void actorMoved(ActorTable::ActorHandle actor, const shapes::Rectangle* previousArea, const shapes::Rectangle* currentArea);
+
+      /**
+       * Has a task signalled once a zone has an event to take.
+       *
+       * @param id The ID of the zone.
+       * @param task The task to signal, which takes the place of any task already waiting on the zone.
+       *
+       * @return true iff the task is waiting on the zone; if the zone already has an event (or doesn't exist), the task is left alone.
+       */
+      bool wait(TriggerId id, Task* task);
+
+      /**
+       * Takes the oldest event of a zone.
+       *
+       * @param id The ID of the zone.
+       * @param event The parameter used to return the event.
+       *
+       * @return true iff the zone had an event.
+       */
+      bool takeEvent(TriggerId id, Event& event);
+};
+
+#endif
@@ -10,92 +10,758 @@
 #include "Pathfinder.h"
 #include "ResourceLoader.h"
 #include "TileEngine.h"
+#include "AssetStream.h"
 #include "DebugUtils.h"
-#include "tinyxml.h"
+#include <SDL.h>
+#include <zlib.h>
 
-#include <sstream>
+#include <iterator>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 const int debugFlag = DEBUG_RES_LOAD;
 
 //#define DRAW_PASSIBILITY
 
-XMap::XMap(const std::string& name, const std::string& filePath)
-{  
-   mapName = name;
+// Tiled keeps whether a tile is flipped (or rotated, on hexagonal maps) in the top bits of its number
+static const Uint32 TILE_FLAG_MASK = 0xF0000000;
 
-   DEBUG("Loading map file %s", filePath.c_str());
+// Each tile of a base64 layer is a 32-bit little-endian tile number
+static const int BYTES_PER_ENCODED_TILE = 4;
 
-   std::ifstream input(filePath.c_str());
-   if(!input)
+// Marks the characters in the base64 table that aren't base64 digits: whitespace is skipped, padding ends the data
+static const unsigned char BASE64_PADDING = 0xFD;
+static const unsigned char BASE64_SPACE = 0xFE;
+static const unsigned char BASE64_INVALID = 0xFF;
+
+// The value of each base64 digit, indexed by character
+static const unsigned char BASE64_VALUES[256] =
+{
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 0xFE, 0xFF, 0xFF, 0xFE, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+   0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFD, 0xFF, 0xFF,
+   0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+   0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+   0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+// The map, its layers and their properties (or its object groups and their objects) are the deepest elements that the map's loading looks inside of
+static const int MAX_ENCLOSING_ELEMENTS = 3;
+
+/** An element's start or end tag, found in place in the map file's text. None of the tag's text is copied. */
+struct MapTag
+{
+   /** The element's name (which isn't terminated). */
+   const char* name;
+
+   /** The length of the element's name. */
+   size_t nameLength;
+
+   /** The rest of the tag after the name, where its attributes are. */
+   const char* attributes;
+
+   /** The end of the tag, just past its closing bracket. */
+   const char* end;
+
+   /** Whether or not this is an end tag. */
+   bool closing;
+
+   /** Whether or not the element closes itself (as in <property ... />), so that it has no content. */
+   bool empty;
+};
+
+/** How a layer's tiles are written in the map file. */
+enum LayerEncoding
+{
+   /** The tile numbers, separated by commas. */
+   CSV_ENCODING,
+   /** The tile numbers as 32-bit little-endian numbers, in base64. */
+   BASE64_ENCODING
+};
+
+/** Where a layer's tiles are in the map file's text, and how they are written there. */
+struct MapLayer
+{
+   /** The start of the layer's tile data. */
+   const char* tiles;
+
+   /** The end of the layer's tile data. */
+   const char* tilesEnd;
+
+   /** How the tiles are written. */
+   LayerEncoding encoding;
+
+   /** Whether or not the tiles are compressed (with zlib or gzip) before they are written in base64. */
+   bool compressed;
+
+   /** Whether or not the layer is the one that the actors are drawn over (with an "actorLayer" property of "true"). */
+   bool actorLayer;
+};
+
+/**
+ * Finds the next start or end tag in the map file's text, skipping comments, declarations and processing instructions.
+ * Attribute values can't hold a closing bracket, which Tiled always escapes.
+ *
+ * @param cursor The position to start looking from, which is moved past the tag.
+ * @param textEnd The end of the map file's text.
+ * @param tag The parameter used to return the tag.
+ *
+ * @return true iff a tag was found before the end of the text.
+ */
+static bool findTag(const char*& cursor, const char* textEnd, MapTag& tag)
+{
+   for(;;)
    {
-      T_T("Failed to open map file for reading.");
+      const char* tagStart = static_cast<const char*>(memchr(cursor, '<', textEnd - cursor));
+      if(tagStart == NULL) return false;
+
+      if(strncmp(tagStart, "<!--", 4) == 0)
+      {
+         const char* commentEnd = strstr(tagStart + 4, "-->");
+         if(commentEnd == NULL)
+         {
+            DEBUG("Unterminated comment in map XML.");
+            T_T("Failed to parse map data.");
+         }
+
+         cursor = commentEnd + 3;
+         continue;
+      }
+
+      const char* tagEnd = static_cast<const char*>(memchr(tagStart, '>', textEnd - tagStart));
+      if(tagEnd == NULL)
+      {
+         DEBUG("Unterminated tag in map XML.");
+         T_T("Failed to parse map data.");
+      }
+
+      cursor = tagEnd + 1;
+      if(tagStart[1] == '?' || tagStart[1] == '!') continue;
+
+      tag.closing = tagStart[1] == '/';
+      tag.name = tagStart + (tag.closing ? 2 : 1);
+      tag.nameLength = strcspn(tag.name, " \t\r\n/>");
+      tag.attributes = tag.name + tag.nameLength;
+      tag.end = cursor;
+      tag.empty = tagEnd[-1] == '/';
+      return true;
+   }
+}
+
+/**
+ * @param tag A tag.
+ * @param name An element name.
+ *
+ * @return true iff the tag belongs to an element with the given name.
+ */
+static bool isNamed(const MapTag& tag, const char* name)
+{
+   return tag.nameLength == strlen(name) && strncmp(tag.name, name, tag.nameLength) == 0;
+}
+
+/**
+ * Finds the value of one of a tag's attributes, in place.
+ *
+ * @param tag A start tag.
+ * @param name The name of the attribute.
+ * @param value The parameter used to return the start of the attribute's value (which isn't terminated, or unescaped).
+ * @param valueLength The parameter used to return the length of the attribute's value.
+ *
+ * @return true iff the tag has the attribute.
+ */
+static bool findAttribute(const MapTag& tag, const char* name, const char*& value, size_t& valueLength)
+{
+   const size_t nameLength = strlen(name);
+   const char* cursor = tag.attributes;
+   while(cursor < tag.end)
+   {
+      const char* attributeName = cursor + strspn(cursor, " \t\r\n");
+      const char* equals = static_cast<const char*>(memchr(attributeName, '=', tag.end - attributeName));
+      if(equals == NULL) return false;
+
+      const char* quote = equals + 1 + strspn(equals + 1, " \t\r\n");
+      if(*quote != '"' && *quote != '\'') return false;
+
+      const char* valueEnd = static_cast<const char*>(memchr(quote + 1, *quote, tag.end - (quote + 1)));
+      if(valueEnd == NULL) return false;
+
+      if(static_cast<size_t>(strcspn(attributeName, " \t\r\n=")) == nameLength && strncmp(attributeName, name, nameLength) == 0)
+      {
+         value = quote + 1;
+         valueLength = valueEnd - value;
+         return true;
+      }
+
+      cursor = valueEnd + 1;
+   }
+
+   return false;
+}
+
+/**
+ * Reads one of a tag's attributes, replacing the character references that Tiled writes with the characters they stand for.
+ *
+ * @param tag A start tag.
+ * @param name The name of the attribute.
+ * @param value The parameter used to return the attribute's value.
+ *
+ * @return true iff the tag has the attribute.
+ */
+static bool getAttribute(const MapTag& tag, const char* name, std::string& value)
+{
+   const char* text;
+   size_t length;
+   if(!findAttribute(tag, name, text, length)) return false;
+
+   static const char* const ENTITIES[] = { "&lt;", "&gt;", "&amp;", "&quot;", "&apos;" };
+   static const char ENTITY_CHARACTERS[] = { '<', '>', '&', '"', '\'' };
+
+   value.clear();
+   value.reserve(length);
+   for(size_t i = 0; i < length; ++i)
+   {
+      if(text[i] != '&')
+      {
+         value += text[i];
+         continue;
+      }
+
+      const char* referenceEnd = static_cast<const char*>(memchr(text + i, ';', length - i));
+      if(referenceEnd == NULL)
+      {
+         value += text[i];
+         continue;
+      }
+
+      const size_t referenceLength = referenceEnd + 1 - (text + i);
+      bool replaced = false;
+      for(unsigned int entity = 0; entity < sizeof(ENTITY_CHARACTERS) && !replaced; ++entity)
+      {
+         if(referenceLength == strlen(ENTITIES[entity]) && strncmp(text + i, ENTITIES[entity], referenceLength) == 0)
+         {
+            value += ENTITY_CHARACTERS[entity];
+            replaced = true;
+         }
+      }
+
+      if(!replaced && text[i + 1] == '#')
+      {
+         // Numeric references are only written for control characters, such as line breaks
+         const long character = text[i + 2] == 'x' ? strtol(text + i + 3, NULL, 16) : strtol(text + i + 2, NULL, 10);
+         if(character > 0 && character < 128)
+         {
+            value += static_cast<char>(character);
+            replaced = true;
+         }
+      }
+
+      if(replaced)
+      {
+         i += referenceLength - 1;
+      }
+      else
+      {
+         value += text[i];
+      }
    }
 
-   TiXmlDocument xmlDoc;
-   input >> xmlDoc;
+   return true;
+}
+
+/**
+ * @param tag A start tag.
+ * @param name The name of the attribute.
+ *
+ * @return The attribute's value as a number, or 0 if the tag doesn't have the attribute.
+ */
+static int getNumberAttribute(const MapTag& tag, const char* name)
+{
+   const char* value;
+   size_t length;
+   return findAttribute(tag, name, value, length) ? static_cast<int>(strtol(value, NULL, 10)) : 0;
+}
 
-   if(xmlDoc.Error())
+/**
+ * @param tag A start tag.
+ * @param name The name of the attribute.
+ *
+ * @return The attribute's value as a number of pixels, rounded to the nearest pixel, or 0 if the tag doesn't have the attribute.
+ */
+static int getPixelAttribute(const MapTag& tag, const char* name)
+{
+   const char* value;
+   size_t length;
+   return findAttribute(tag, name, value, length) ? static_cast<int>(floor(strtod(value, NULL) + 0.5)) : 0;
+}
+
+/**
+ * @param tag A start tag.
+ * @param name The name of the attribute.
+ * @param expected A value.
+ *
+ * @return true iff the tag has the attribute, and its value is the given value.
+ */
+static bool hasAttributeValue(const MapTag& tag, const char* name, const char* expected)
+{
+   const char* value;
+   size_t length;
+   return findAttribute(tag, name, value, length) && length == strlen(expected) && strncmp(value, expected, length) == 0;
+}
+
+/**
+ * Reads how a layer's tiles are written, and where they are, from the tag that starts its data.
+ *
+ * @param tag The start tag of the layer's data element.
+ * @param textEnd The end of the map file's text.
+ * @param layer The layer to fill in.
+ */
+static void readLayerData(const MapTag& tag, const char* textEnd, MapLayer& layer)
+{
+   if(hasAttributeValue(tag, "encoding", "csv"))
    {
-      DEBUG("Error occurred in map XML parsing: %s", xmlDoc.ErrorDesc());
+      layer.encoding = CSV_ENCODING;
+   }
+   else if(hasAttributeValue(tag, "encoding", "base64"))
+   {
+      layer.encoding = BASE64_ENCODING;
+   }
+   else
+   {
+      DEBUG("Map layers must be saved in CSV or base64 format.");
       T_T("Failed to parse map data.");
    }
 
-   TiXmlElement* root = xmlDoc.RootElement();
-   if(strcmp(root->Value(), "map") != 0)
+   const char* compression;
+   size_t compressionLength;
+   layer.compressed = findAttribute(tag, "compression", compression, compressionLength);
+   if(layer.compressed && !hasAttributeValue(tag, "compression", "zlib") && !hasAttributeValue(tag, "compression", "gzip"))
    {
-      DEBUG("Unexpected root element name.");
+      DEBUG("Map layers must be compressed with zlib or gzip (if they are compressed at all).");
       T_T("Failed to parse map data.");
    }
 
-   root->Attribute("width", &width);
-   root->Attribute("height", &height);
+   layer.tiles = tag.empty ? tag.end - 1 : tag.end;
+   const char* tilesEnd = tag.empty ? NULL : static_cast<const char*>(memchr(tag.end, '<', textEnd - tag.end));
+   layer.tilesEnd = tilesEnd == NULL ? layer.tiles : tilesEnd;
+}
+
+/**
+ * Decodes base64 text, skipping whitespace, up to the end of the text or its padding.
+ * The digits are decoded four at a time (three bytes) until the first whitespace or padding, and one at a time after that.
+ *
+ * @param text The start of the text.
+ * @param textEnd The end of the text.
+ * @param bytes Filled with the decoded bytes.
+ */
+static void decodeBase64(const char* text, const char* textEnd, std::vector<unsigned char>& bytes)
+{
+   // Tiled puts a line break and indentation before the digits, but none between them
+   const unsigned char* digit = reinterpret_cast<const unsigned char*>(text);
+   const unsigned char* const digitsEnd = reinterpret_cast<const unsigned char*>(textEnd);
+   while(digit < digitsEnd && BASE64_VALUES[*digit] == BASE64_SPACE)
+   {
+      ++digit;
+   }
+
+   bytes.resize((digitsEnd - digit) / 4 * 3 + 3);
+   unsigned char* output = bytes.empty() ? NULL : &bytes[0];
+
+   for(; digitsEnd - digit >= 4; digit += 4)
+   {
+      const Uint32 first = BASE64_VALUES[digit[0]];
+      const Uint32 second = BASE64_VALUES[digit[1]];
+      const Uint32 third = BASE64_VALUES[digit[2]];
+      const Uint32 fourth = BASE64_VALUES[digit[3]];
+      if((first | second | third | fourth) >= 64) break;
+
+      const Uint32 group = first << 18 | second << 12 | third << 6 | fourth;
+      output[0] = static_cast<unsigned char>(group >> 16);
+      output[1] = static_cast<unsigned char>(group >> 8);
+      output[2] = static_cast<unsigned char>(group);
+      output += 3;
+   }
+
+   Uint32 bits = 0;
+   int bitCount = 0;
+   for(; digit < digitsEnd; ++digit)
+   {
+      const unsigned char value = BASE64_VALUES[*digit];
+      if(value == BASE64_PADDING) break;
+      if(value == BASE64_SPACE) continue;
+      if(value == BASE64_INVALID)
+      {
+         DEBUG("Invalid base64 data in map layer.");
+         T_T("Failed to parse map data.");
+      }
+
+      bits = bits << 6 | value;
+      bitCount += 6;
+      if(bitCount >= 8)
+      {
+         bitCount -= 8;
+         *output++ = static_cast<unsigned char>(bits >> bitCount);
+      }
+   }
+
+   bytes.resize(output - (bytes.empty() ? NULL : &bytes[0]));
+}
+
+/**
+ * Decompresses a layer's tiles, which must come out to exactly the size of the layer.
+ *
+ * @param compressed The compressed tiles (with a zlib or gzip header).
+ * @param bytes The tiles to fill in, which is already the size of the layer's tiles.
+ */
+static void decompressLayer(std::vector<unsigned char>& compressed, std::vector<unsigned char>& bytes)
+{
+   if(compressed.empty() || bytes.empty())
+   {
+      T_T("Tile map incomplete.");
+   }
+
+   z_stream stream;
+   memset(&stream, 0, sizeof(stream));
+
+   // Adding 32 to the window size has zlib tell zlib and gzip streams apart by their headers
+   if(inflateInit2(&stream, MAX_WBITS + 32) != Z_OK)
+   {
+      T_T("Unable to decompress map layer.");
+   }
+
+   stream.next_in = &compressed[0];
+   stream.avail_in = static_cast<uInt>(compressed.size());
+   stream.next_out = &bytes[0];
+   stream.avail_out = static_cast<uInt>(bytes.size());
+
+   const int result = inflate(&stream, Z_FINISH);
+   const uLong decompressedSize = stream.total_out;
+   inflateEnd(&stream);
 
-   TiXmlElement* propertiesElement = root->FirstChildElement("properties");
-   
-   TiXmlElement* propertyElement = propertiesElement->FirstChildElement("property");
-   while(propertyElement != NULL)
+   if(result != Z_STREAM_END || decompressedSize != bytes.size())
+   {
+      T_T("Tile map incomplete.");
+   }
+}
+
+/**
+ * Reads the area of a map object, as a volume for the map's collision tree.
+ *
+ * @param tag The object's start tag.
+ * @param volumes The volume is added to the back of this list, if the object has a rectangular area.
+ */
+static void readCollisionVolume(const MapTag& tag, std::vector<CollisionTree::Volume>& volumes)
+{
+   // Rotated objects' areas aren't rectangles on the map, and points and lines have no area to collide with
+   const int objectWidth = getPixelAttribute(tag, "width");
+   const int objectHeight = getPixelAttribute(tag, "height");
+   if(objectWidth <= 0 || objectHeight <= 0 || getPixelAttribute(tag, "rotation") != 0)
    {
-      if(std::string(propertyElement->Attribute("name")) == "tilesetName")
+      DEBUG("Skipping map object without a rectangular area.");
+      return;
+   }
+
+   const int left = getPixelAttribute(tag, "x");
+   const int top = getPixelAttribute(tag, "y");
+   const shapes::Rectangle area(top, left, top + objectHeight - 1, left + objectWidth - 1);
+
+   // Older versions of Tiled call the object's class its type
+   const CollisionTree::Kind kind = hasAttributeValue(tag, "type", "trigger") || hasAttributeValue(tag, "class", "trigger") ? CollisionTree::TRIGGER : CollisionTree::SOLID;
+
+   std::string volumeName;
+   getAttribute(tag, "name", volumeName);
+   volumes.push_back(CollisionTree::Volume(area, kind, volumeName));
+}
+
+XMap::XMap(const std::string& name, const std::string& filePath) : filePath(filePath)
+{  
+   mapName = name;
+
+   DEBUG("Loading map file %s", filePath.c_str());
+
+   // The file is read in binary mode so that offsets into its text can be used to seek back to its tiles
+   AssetStream input(filePath, std::ios::in | std::ios::binary);
+   if(!input)
+   {
+      T_T("Failed to open map file for reading.");
+   }
+
+   const std::string fileText((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+   const char* const fileStart = fileText.c_str();
+   const char* const fileEnd = fileStart + fileText.size();
+
+   // Only the map's size, its properties, its layers and its objects are needed, so the XML is scanned in place for them,
+   // keeping track of the elements enclosing each tag, instead of being parsed into a document
+   width = 0;
+   height = 0;
+   std::vector<MapLayer> layers;
+   MapTag enclosingTags[MAX_ENCLOSING_ELEMENTS];
+   int depth = 0;
+   bool foundRoot = false;
+
+   const char* cursor = fileStart;
+   MapTag tag;
+   while(findTag(cursor, fileEnd, tag))
+   {
+      if(tag.closing)
+      {
+         --depth;
+         continue;
+      }
+
+      if(depth == 0)
+      {
+         if(foundRoot || !isNamed(tag, "map"))
+         {
+            DEBUG("Unexpected root element name.");
+            T_T("Failed to parse map data.");
+         }
+
+         foundRoot = true;
+         width = getNumberAttribute(tag, "width");
+         height = getNumberAttribute(tag, "height");
+      }
+      else if(depth == 1 && isNamed(tag, "layer"))
+      {
+         MapLayer layer = { NULL, NULL, CSV_ENCODING, false, false };
+         layers.push_back(layer);
+      }
+      else if(depth == 2 && isNamed(enclosingTags[1], "objectgroup") && isNamed(tag, "object"))
+      {
+         readCollisionVolume(tag, collisionVolumes);
+      }
+      else if(depth == 2 && isNamed(enclosingTags[1], "properties") && isNamed(tag, "property"))
+      {
+         std::string propertyName;
+         std::string propertyValue;
+         if(getAttribute(tag, "name", propertyName) && getAttribute(tag, "value", propertyValue))
+         {
+            properties[propertyName] = propertyValue;
+         }
+      }
+      else if(depth == 2 && isNamed(enclosingTags[1], "layer") && isNamed(tag, "data"))
+      {
+         readLayerData(tag, fileEnd, layers.back());
+      }
+      else if(depth == 3 && isNamed(enclosingTags[1], "layer") && isNamed(enclosingTags[2], "properties") && isNamed(tag, "property"))
       {
-         std::string tilesetName = propertyElement->Attribute("value");
-         tileset = ResourceLoader::getTileset(tilesetName);
-         break;
+         if(hasAttributeValue(tag, "name", "actorLayer"))
+         {
+            layers.back().actorLayer = hasAttributeValue(tag, "value", "true");
+         }
       }
 
-      propertyElement = propertyElement->NextSiblingElement("property");
+      if(!tag.empty)
+      {
+         if(depth < MAX_ENCLOSING_ELEMENTS)
+         {
+            enclosingTags[depth] = tag;
+         }
+
+         ++depth;
+      }
+   }
+
+   if(!foundRoot)
+   {
+      DEBUG("Error occurred in map XML parsing: no map element.");
+      T_T("Failed to parse map data.");
    }
 
+   tilesetName = getProperty("tilesetName");
+   tileset = tilesetName.empty() ? NULL : ResourceLoader::getTileset(tilesetName);
+
    if(tileset == NULL)
    {
       T_T("Map doesn't contain a tileset.");
    }
 
-   TiXmlElement* floorElement = root->FirstChildElement("layer");
-   if(floorElement == NULL)
+   tileset->acquire();
+
+   // The layers are drawn in the order they appear, with the actors drawn right after the actor layer
+   layerCount = static_cast<int>(layers.size());
+   lowerLayerCount = 0;
+   for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+   {
+      if(lowerLayerCount == 0 && layers[layerNum].actorLayer)
+      {
+         lowerLayerCount = layerNum + 1;
+      }
+
+      if(layers[layerNum].tiles == NULL)
+      {
+         DEBUG("Expected tile data in map layer.");
+         T_T("Failed to parse map data.");
+      }
+   }
+
+   if(layerCount == 0)
    {
       DEBUG("Expected layer data in map.");
       T_T("Failed to parse map data.");
    }
 
-   TiXmlText* floorDataElement = floorElement->FirstChildElement("data")->FirstChild()->ToText();
-   std::stringstream layerStream(floorDataElement->Value());
+   // Without an actor layer, every layer is drawn under the actors
+   if(lowerLayerCount == 0)
+   {
+      lowerLayerCount = layerCount;
+   }
+
+   initializeChunks();
+   allocatePassibility();
+
+   // CSV tiles can be read back a chunk at a time by their offsets in the file, but base64 tiles can't,
+   // so a map with any base64 layers keeps all of its tiles loaded instead of streaming them
+   streamable = true;
+   for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+   {
+      streamable = streamable && layers[layerNum].encoding == CSV_ENCODING;
+   }
 
-   tileMap = new int*[height];
-   for(int y = 0; y < height; ++y)
+   if(!streamable)
    {
-      tileMap[y] = new int[width];
-      
-      for(int x = 0; x < width; ++x)
+      for(std::vector<int*>::iterator iter = chunks.begin(); iter != chunks.end(); ++iter)
       {
-         std::string entry;
-         std::getline(layerStream, entry, ',');
-		 tileMap[y][x] = atoi(entry.c_str()) - 1;
+         *iter = new int[CHUNK_SIZE * CHUNK_SIZE * layerCount];
+
+         // The parts of the edge chunks past the edges of the map are empty
+         std::fill(*iter, *iter + CHUNK_SIZE * CHUNK_SIZE * layerCount, -1);
       }
    }
+   else
+   {
+      chunkRowOffsets.resize(layerCount * height * chunksWide);
+   }
 
-   initializePassibilityMatrix();
+   std::vector<unsigned char> encodedBytes;
+   std::vector<unsigned char> decodedBytes;
+   for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+   {
+      const MapLayer& layer = layers[layerNum];
+      if(layer.encoding == CSV_ENCODING)
+      {
+         // For a streamed map, this pass just records where each chunk's rows start in each layer, and how passable each floor tile is
+         const char* entry = layer.tiles;
+         for(int y = 0; y < height; ++y)
+         {
+            for(int x = 0; x < width; ++x)
+            {
+               if(streamable && x % CHUNK_SIZE == 0)
+               {
+                  chunkRowOffsets[(layerNum * height + y) * chunksWide + x / CHUNK_SIZE] = entry - fileStart;
+               }
+
+               char* entryEnd;
+               const int tileNum = strtol(entry, &entryEnd, 10) - 1;
+               if(entryEnd == entry || entryEnd > layer.tilesEnd)
+               {
+                  T_T("Tile map incomplete.");
+               }
+
+               if(!streamable)
+               {
+                  chunks[getChunkNum(x, y)][layerNum * CHUNK_SIZE * CHUNK_SIZE + getChunkOffset(x, y)] = tileNum;
+               }
+
+               if(layerNum == 0 && tileset->isPassible(tileNum))
+               {
+                  setPassible(x, y);
+               }
+
+               entry = *entryEnd == ',' ? entryEnd + 1 : entryEnd;
+            }
+         }
+      }
+      else
+      {
+         // The tiles are decoded straight out of the file's text, and only copied again into their chunks
+         decodeBase64(layer.tiles, layer.tilesEnd, encodedBytes);
+         std::vector<unsigned char>* tileBytes = &encodedBytes;
+         if(layer.compressed)
+         {
+            decodedBytes.resize(width * height * BYTES_PER_ENCODED_TILE);
+            decompressLayer(encodedBytes, decodedBytes);
+            tileBytes = &decodedBytes;
+         }
+
+         if(tileBytes->size() != static_cast<size_t>(width * height * BYTES_PER_ENCODED_TILE))
+         {
+            T_T("Tile map incomplete.");
+         }
+
+         const unsigned char* encodedTile = tileBytes->empty() ? NULL : &(*tileBytes)[0];
+         for(int y = 0; y < height; ++y)
+         {
+            for(int x = 0; x < width; ++x)
+            {
+               const Uint32 tileId = static_cast<Uint32>(encodedTile[0]) | static_cast<Uint32>(encodedTile[1]) << 8 | static_cast<Uint32>(encodedTile[2]) << 16 | static_cast<Uint32>(encodedTile[3]) << 24;
+               const int tileNum = static_cast<int>(tileId & ~TILE_FLAG_MASK) - 1;
+               encodedTile += BYTES_PER_ENCODED_TILE;
+
+               chunks[getChunkNum(x, y)][layerNum * CHUNK_SIZE * CHUNK_SIZE + getChunkOffset(x, y)] = tileNum;
+               if(layerNum == 0 && tileset->isPassible(tileNum))
+               {
+                  setPassible(x, y);
+               }
+            }
+         }
+      }
+   }
+
+   DEBUG("Map has %d layers, %d of them under the actors%s.", layerCount, lowerLayerCount, streamable ? "" : " (kept loaded, since some of them are in base64)");
 
    std::vector<Obstacle*> obstacles;
 
    DEBUG("XMap loaded.");
 }
+
+void XMap::readChunk(int chunkX, int chunkY, int* tiles) const
+{
+   AssetStream input(filePath, std::ios::in | std::ios::binary);
+   if(!input)
+   {
+      T_T("Failed to open map file for reading.");
+   }
+
+   const int chunkLeft = chunkX * CHUNK_SIZE;
+   const int chunkTop = chunkY * CHUNK_SIZE;
+   const int chunkWidth = std::min(CHUNK_SIZE, width - chunkLeft);
+   const int chunkHeight = std::min(CHUNK_SIZE, height - chunkTop);
+
+   for(int layerNum = 0; layerNum < layerCount; ++layerNum)
+   {
+      int* layerTiles = tiles + layerNum * CHUNK_SIZE * CHUNK_SIZE;
+      for(int y = 0; y < chunkHeight; ++y)
+      {
+         input.seekg(chunkRowOffsets[(layerNum * height + chunkTop + y) * chunksWide + chunkX]);
+         for(int x = 0; x < chunkWidth; ++x)
+         {
+            int entry;
+            if(!(input >> entry))
+            {
+               T_T("Tile map incomplete.");
+            }
+
+            layerTiles[y * CHUNK_SIZE + x] = entry - 1;
+            input.ignore(1, ',');
+         }
+      }
+   }
+}
+
+XMap::~XMap()
+{
+   // The chunk loader reads through this map's file, so it must stop before the map is torn down
+   releaseChunks();
+}
@@ -8,6 +8,7 @@
 #define XMAP_H
 
 #include <string>
+#include <vector>
 #include "Map.h"
 
 /**
@@ -16,10 +17,32 @@
  * interacting with NPCs and casting spells. The player may leave this map and
  * cross to either another map in the same Region, or the Overworld.
  *
+ * XMaps are read from Tiled map files, whose layers can be saved as CSV or as base64 (optionally compressed with zlib or gzip).
+ * Rectangle objects in the map's object groups are read as the obstacles (or, with a class of "trigger", the trigger zones) that don't line up with its tiles.
+ * Maps whose layers are all CSV stream their tiles back from the file a chunk at a time; the others keep all their tiles loaded.
+ *
  * @author Noam Chitayat
  */
 class XMap : public Map
 {
+   /** The path to the map file. */
+   std::string filePath;
+
+   /**
+    * The offset in the map file of the first tile of each chunk's part of each tile row in each layer,
+    * indexed by ((layer * height + row) * chunksWide) + chunk column. Empty unless the map is streamable.
+    */
+   std::vector<std::streamoff> chunkRowOffsets;
+
+   /**
+    * Reads the tiles of a chunk back from the map file.
+    *
+    * @param chunkX The x-coordinate (in chunks) of the chunk to read.
+    * @param chunkY The y-coordinate (in chunks) of the chunk to read.
+    * @param tiles The tiles of the chunk to fill in, with CHUNK_SIZE tiles per row and CHUNK_SIZE rows per layer.
+    */
+   void readChunk(int chunkX, int chunkY, int* tiles) const;
+
    public:
 
       /**
@@ -31,6 +54,11 @@ class XMap : public Map
        *           beginning of this Map's data.
        */
       XMap(const std::string& name, const std::string& filePath);
+
+      /**
+       * Destructor.
+       */
+      ~XMap();
 };
 
 #endif
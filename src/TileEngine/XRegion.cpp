@@ -6,50 +6,162 @@
 
 #include "XRegion.h"
 #include "XMap.h"
-#include <fstream>
-#include <dirent.h>
+#include "CompiledMap.h"
+#include "AssetArchive.h"
+#include "ResourceLoader.h"
+#include <sstream>
+#include <algorithm>
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_RES_LOAD;
 
+// Enough for the player to walk back and forth between a handful of interiors without reparsing them,
+// while keeping big regions from holding every map they contain
+const unsigned int XRegion::MAX_LOADED_MAPS = 8;
+
 XRegion::XRegion(const ResourceKey& name) : Region(name)
 {
 }
 
 void XRegion::load(const char* path)
 {
-   struct dirent *entry;
-   DIR *dp;
-   std::vector<std::string> files;
- 
-   dp = opendir(path);
-   if (dp == NULL)
+   std::vector<std::string> fileNames;
+   if(!AssetArchive::listDirectory(path, fileNames))
    {
-      T_T("opendir");
+      T_T(std::string("Unable to list region directory: ") + path);
    }
- 
-   while((entry = readdir(dp)))
+
+   std::vector<std::string> files;
+   for(std::vector<std::string>::iterator iter = fileNames.begin(); iter != fileNames.end(); ++iter)
    {
-      std::string filename(entry->d_name);
-      if(filename.length() > 4 && filename.substr(filename.length() - 4, 4) == ".tmx")
+      const std::string extension = iter->length() > 4 ? iter->substr(iter->length() - 4, 4) : "";
+      if(extension == ".tmx" || extension == ".edm")
       {
-         files.push_back(filename);
+         files.push_back(*iter);
       }
    }
 
-   closedir(dp);
+   if(files.empty())
+   {
+      T_T(std::string("Region directory contains no maps: ") + path);
+   }
 
+   // Only the file paths are recorded here; each map is parsed the first time it is requested.
+   // A compiled map takes the place of the Tiled map with the same name, since it loads much faster.
    for(std::vector<std::string>::iterator iter = files.begin(); iter != files.end(); ++iter)
    {
-      std::string mapFile(std::string(path) + *iter);
-      try
+      std::string& mapPath = mapPaths[iter->substr(0, iter->length() - 4)];
+      if(mapPath.empty() || iter->substr(iter->length() - 4, 4) == ".edm")
+      {
+         mapPath = std::string(path) + *iter;
+      }
+   }
+
+   // A baked map was compiled from the Tiled map as it is now, so it takes the place of both
+   std::string bakedPath;
+   for(std::map<std::string, std::string>::iterator iter = mapPaths.begin(); iter != mapPaths.end(); ++iter)
+   {
+      if(ResourceLoader::findBakedAsset(std::string(path) + iter->first + ".tmx", bakedPath))
+      {
+         iter->second = bakedPath;
+      }
+   }
+
+   DEBUG("Indexed %d maps in region %s", static_cast<int>(mapPaths.size()), regionName.c_str());
+}
+
+Map* XRegion::loadMap(const std::string& name)
+{
+   const std::string& mapFile = mapPaths[name];
+   try
+   {
+      const bool compiled = mapFile.substr(mapFile.length() - 4, 4) == ".edm";
+      Map* map = compiled ? static_cast<Map*>(new CompiledMap(name, mapFile)) : new XMap(name, mapFile);
+      areas[name] = map;
+      return map;
+   }
+   catch(Exception e)
+   {
+      T_T(std::string("Malformed map in map file: ") + mapFile + '\n' + e.getMessage());
+   }
+}
+
+void XRegion::queueNeighbouringMaps(const Map& map)
+{
+   std::istringstream neighbours(map.getProperty("neighbouringMaps"));
+   std::string neighbour;
+   while(std::getline(neighbours, neighbour, ','))
+   {
+      neighbour.erase(0, neighbour.find_first_not_of(" \t"));
+      neighbour.erase(neighbour.find_last_not_of(" \t") + 1);
+
+      if(mapPaths.find(neighbour) == mapPaths.end())
       {
-         Map* nextMap = new XMap(iter->substr(0, iter->length() - 4), mapFile);
-         areas[nextMap->getName()] = nextMap;
+         DEBUG("Ignoring unknown neighbouring map %s of map %s", neighbour.c_str(), map.getName().c_str());
       }
-      catch(Exception e)
+      else if(areas.find(neighbour) == areas.end() && std::find(prefetchQueue.begin(), prefetchQueue.end(), neighbour) == prefetchQueue.end())
       {
-         T_T(std::string("Malformed map in map file: ") + mapFile + '\n' + e.getMessage());
+         prefetchQueue.push_back(neighbour);
       }
    }
 }
+
+void XRegion::reclaimMaps()
+{
+   while(recentMaps.size() > MAX_LOADED_MAPS)
+   {
+      const std::string& name = recentMaps.back();
+      DEBUG("Releasing map %s, which hasn't been requested recently", name.c_str());
+
+      std::map<std::string, Map*>::iterator area = areas.find(name);
+      delete area->second;
+      areas.erase(area);
+      recentMaps.pop_back();
+   }
+}
+
+Map* XRegion::getStartingMap()
+{
+   return mapPaths.empty() ? NULL : getMap(mapPaths.begin()->first);
+}
+
+Map* XRegion::getMap(const std::string& name)
+{
+   if(mapPaths.find(name) == mapPaths.end())
+   {
+      DEBUG("Region %s has no map named %s", regionName.c_str(), name.c_str());
+      return NULL;
+   }
+
+   std::map<std::string, Map*>::iterator area = areas.find(name);
+   Map* map = area != areas.end() ? area->second : loadMap(name);
+
+   recentMaps.remove(name);
+   recentMaps.push_front(name);
+   prefetchQueue.remove(name);
+
+   queueNeighbouringMaps(*map);
+   reclaimMaps();
+   return map;
+}
+
+void XRegion::prefetchNextMap()
+{
+   // Prefetching never pushes out maps that were actually requested
+   if(prefetchQueue.empty() || recentMaps.size() >= MAX_LOADED_MAPS) return;
+
+   const std::string name = prefetchQueue.front();
+   prefetchQueue.pop_front();
+   if(areas.find(name) != areas.end()) return;
+
+   try
+   {
+      loadMap(name);
+      recentMaps.push_back(name);
+      DEBUG("Prefetched map %s", name.c_str());
+   }
+   catch(Exception& e)
+   {
+      DEBUG("Failed to prefetch map %s: %s", name.c_str(), e.getMessage().c_str());
+   }
+}
@@ -10,6 +10,7 @@
 #include "Region.h"
 #include <string>
 #include <map>
+#include <list>
 
 class Map;
 class XMap;
@@ -24,10 +25,53 @@ class XMap;
  * The first map loaded from file becomes the starting map, and the player
  * character begins there when entering a region unless otherwise specified.
  *
+ * An XRegion only indexes its map files when it is loaded. Each map is parsed the first time
+ * it is requested, and the maps listed in its 'neighbouringMaps' property are queued to be
+ * prefetched. Once too many maps are loaded, the ones that haven't been requested recently are
+ * released, and parsed again if they are requested later.
+ *
+ * Maps can be Tiled (.tmx) files or compiled map (.edm) files. Where a map has both,
+ * the compiled map is loaded, unless the Tiled map has been baked (see ResourceLoader::findBakedAsset),
+ * in which case the baked map is loaded in place of both.
+ *
  * @author Noam Chitayat
  */
 class XRegion : public Region
 {
+   /** The most maps to keep loaded before releasing the least recently requested ones. */
+   static const unsigned int MAX_LOADED_MAPS;
+
+   /** The paths to the region's map files, keyed by map names. */
+   std::map<std::string, std::string> mapPaths;
+
+   /** The names of the loaded maps, from the most recently requested to the least. */
+   std::list<std::string> recentMaps;
+
+   /** The names of the maps waiting to be prefetched, in the order they were queued. */
+   std::list<std::string> prefetchQueue;
+
+   /**
+    * Parses a map from its file and adds it to the loaded maps.
+    *
+    * @param name The name of the map to load.
+    *
+    * @return The loaded map.
+    */
+   Map* loadMap(const std::string& name);
+
+   /**
+    * Queues the maps that a map lists as its neighbours to be prefetched, if they aren't loaded yet.
+    *
+    * @param map The map whose neighbours should be prefetched.
+    */
+   void queueNeighbouringMaps(const Map& map);
+
+   /**
+    * Releases the least recently requested maps until no more than MAX_LOADED_MAPS are loaded.
+    * The most recently requested map is never released.
+    */
+   void reclaimMaps();
+
    protected:
       /**
        * Loads this region from the specified EDR file.
@@ -41,6 +85,24 @@ class XRegion : public Region
        * Constructor.
        */
       XRegion(const ResourceKey& name);
+
+      /** @return the starting map (the first map by name) for this Region. */
+      Map* getStartingMap();
+
+      /**
+       * Loads the map if it isn't loaded yet, and marks it as the most recently requested map.
+       *
+       * @param name The name of the Map to retrieve.
+       *
+       * @return the Map with the specified name, or NULL if the region doesn't have it.
+       */
+      Map* getMap(const std::string& name);
+
+      /**
+       * Loads the next map waiting to be prefetched, as long as there is room for it
+       * without releasing maps that were requested.
+       */
+      void prefetchNextMap();
 };
 
 #endif
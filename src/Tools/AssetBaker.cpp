@@ -0,0 +1,607 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * The offline asset baker. It finds every file in the data directory that one of the offline compilers converts
+ * (Tiled maps, the item database, the languages' strings and the GUI's images), and runs the compilers on the ones whose inputs
+ * have changed since the last bake, several at once.
+ *
+ * Usage: eden_bake [-j <jobs>] [--tools <directory>]
+ *
+ * Run the baker from the game's directory, so that the paths of the data files match the ones the engine opens.
+ * The compilers are run out of the tools directory, which defaults to the directory that the baker was run from,
+ * and as many of them run at once as there are processors (unless -j says otherwise).
+ *
+ * Each baked file is written under data/baked/, at its source's path with the hash of its inputs added to its name
+ * (as in data/baked/regions/sereia/outside-0123456789abcdef.edm). The hash covers the source, the other files that
+ * its compiler reads (such as the tilesets, for maps) and the version of the compiled format, so a file is only
+ * compiled again once one of those changes, and the older version of it is deleted once the new one has been written.
+ * The bake manifest (data/baked/manifest.txt) lists the baked file of each source; see BakeManifest.h for its layout.
+ */
+
+#include "CompiledMapFormat.h"
+#include "ImageVariantFormat.h"
+#include "ItemDataFormat.h"
+#include "StringTableFormat.h"
+#include "SDL_stdinc.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// The engine's paths all start with it, so the baker has to be run from the game's directory
+static const char* const DATA_DIRECTORY = "data";
+
+// The same as the paths that the engine loads the bake manifest and packed files from
+static const char* const BAKED_DIRECTORY = "data/baked";
+static const char* const MANIFEST_PATH = "data/baked/manifest.txt";
+
+// The same as BakeManifest::VERSION
+static const int MANIFEST_VERSION = 1;
+
+// Saved games are written by the game as it runs, and the baked files are the baker's own output
+static const char* const SKIPPED_DIRECTORIES[] = { "data/savegames", "data/baked" };
+
+/** The files that one of the offline compilers converts, and what it converts them into. */
+struct BakeRule
+{
+   /** The directory holding the sources (under the data directory), or the start of their paths. */
+   const char* sourcePrefix;
+
+   /** The extension of the sources. */
+   const char* sourceExtension;
+
+   /** The extension of the baked files. */
+   const char* bakedExtension;
+
+   /** The name of the compiler's executable, which takes the source and the baked file's paths. */
+   const char* compiler;
+
+   /** A directory whose files the compiler also reads (under the data directory), or NULL if it only reads the source. */
+   const char* dependencies;
+
+   /** The version of the compiled format, so that files compiled into an older version are compiled again. */
+   Uint32 formatVersion;
+};
+
+// A map's tileset is named inside the map, so every tileset counts as an input of every map.
+// The strings are measured with the compiler's default font, which is one of the game's fonts.
+// The GUI's images keep their sources, which are loaded wherever an image is shown at its full size.
+static const BakeRule RULES[] =
+{
+   { "regions/", ".tmx", ".edm", "map_compiler", "tilesets", CompiledMapFormat::VERSION },
+   { "metadata/items", ".edb", ".edi", "item_data_compiler", NULL, ItemDataFormat::VERSION },
+   { "strings/", ".json", ".eds", "string_table_compiler", "fonts", StringTableFormat::VERSION },
+   { "images/", ".jpg", ".edv", "image_variant_compiler", NULL, ImageVariantFormat::VERSION },
+   { "images/", ".png", ".edv", "image_variant_compiler", NULL, ImageVariantFormat::VERSION },
+};
+
+static const int RULE_COUNT = sizeof(RULES) / sizeof(RULES[0]);
+
+/** A source that is to be baked. */
+struct Bake
+{
+   /** The path of the source. */
+   std::string sourcePath;
+
+   /** The rule that the source is baked by. */
+   const BakeRule* rule;
+
+   /** The hash of the source's inputs, in hexadecimal. */
+   std::string hash;
+
+   /** The path of the baked file. */
+   std::string bakedPath;
+};
+
+/** The source paths of the baked files listed by a manifest, with the hash and the path of each baked file. */
+typedef std::map<std::string, std::pair<std::string, std::string> > ManifestEntries;
+
+/**
+ * Finds every file under a directory, except for the skipped directories.
+ *
+ * @param directory The path of the directory, with forward slashes and without a trailing slash.
+ * @param paths The list to add the paths of the files to.
+ *
+ * @return true iff the directory (and every directory under it) could be read.
+ */
+static bool findFiles(const std::string& directory, std::vector<std::string>& paths)
+{
+   DIR* dir = opendir(directory.c_str());
+   if(dir == NULL)
+   {
+      fprintf(stderr, "Failed to read directory %s.\n", directory.c_str());
+      return false;
+   }
+
+   const char* const* const skippedEnd = SKIPPED_DIRECTORIES + sizeof(SKIPPED_DIRECTORIES) / sizeof(SKIPPED_DIRECTORIES[0]);
+
+   bool succeeded = true;
+   struct dirent* entry;
+   while(succeeded && (entry = readdir(dir)) != NULL)
+   {
+      // Skip hidden files, along with the current and parent directories
+      if(entry->d_name[0] == '.') continue;
+
+      const std::string path = directory + '/' + entry->d_name;
+      struct stat fileInfo;
+      if(stat(path.c_str(), &fileInfo) != 0)
+      {
+         fprintf(stderr, "Failed to read %s.\n", path.c_str());
+         succeeded = false;
+      }
+      else if(S_ISDIR(fileInfo.st_mode))
+      {
+         if(std::find(SKIPPED_DIRECTORIES, skippedEnd, path) == skippedEnd)
+         {
+            succeeded = findFiles(path, paths);
+         }
+      }
+      else if(S_ISREG(fileInfo.st_mode))
+      {
+         paths.push_back(path);
+      }
+   }
+
+   closedir(dir);
+   return succeeded;
+}
+
+/**
+ * Adds bytes to a 64-bit FNV-1a hash.
+ *
+ * @param hash The hash to add to.
+ * @param data The bytes to add.
+ * @param size The number of bytes.
+ */
+static void addToHash(Uint64& hash, const char* data, std::size_t size)
+{
+   for(std::size_t i = 0; i < size; ++i)
+   {
+      hash ^= static_cast<unsigned char>(data[i]);
+      hash *= 0x100000001B3ULL;
+   }
+}
+
+/**
+ * Adds a file's path and contents to a hash, so that renaming an input counts as changing it.
+ *
+ * @param hash The hash to add to.
+ * @param path The path of the file.
+ *
+ * @return true iff the file could be read.
+ */
+static bool addFileToHash(Uint64& hash, const std::string& path)
+{
+   std::ifstream input(path.c_str(), std::ios::in | std::ios::binary);
+   if(!input)
+   {
+      fprintf(stderr, "Failed to read %s.\n", path.c_str());
+      return false;
+   }
+
+   // The path's '\0' keeps the path from running into the contents
+   addToHash(hash, path.c_str(), path.length() + 1);
+
+   char buffer[64 * 1024];
+   while(input.read(buffer, sizeof(buffer)) || input.gcount() > 0)
+   {
+      addToHash(hash, buffer, static_cast<std::size_t>(input.gcount()));
+   }
+
+   return !input.bad();
+}
+
+/**
+ * @param hash A hash.
+ *
+ * @return The hash, as 16 hexadecimal digits.
+ */
+static std::string toHex(Uint64 hash)
+{
+   static const char* const DIGITS = "0123456789abcdef";
+
+   std::string hex(16, '0');
+   for(int digit = 15; digit >= 0; --digit)
+   {
+      hex[digit] = DIGITS[hash & 0xF];
+      hash >>= 4;
+   }
+
+   return hex;
+}
+
+/**
+ * @param path A path.
+ * @param suffix A suffix.
+ *
+ * @return true iff the path ends with the suffix.
+ */
+static bool endsWith(const std::string& path, const char* suffix)
+{
+   const std::size_t length = strlen(suffix);
+   return path.length() >= length && path.compare(path.length() - length, length, suffix) == 0;
+}
+
+/**
+ * @param path A path.
+ *
+ * @return true iff a file can be opened at the path.
+ */
+static bool fileExists(const std::string& path)
+{
+   return std::ifstream(path.c_str()).is_open();
+}
+
+/**
+ * Creates the directories leading up to a file, where they don't already exist.
+ *
+ * @param path The path of the file.
+ *
+ * @return true iff the file's directory exists.
+ */
+static bool createDirectories(const std::string& path)
+{
+   for(std::size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+   {
+      const std::string directory = path.substr(0, slash);
+#ifdef _WIN32
+      const int result = _mkdir(directory.c_str());
+#else
+      const int result = mkdir(directory.c_str(), 0755);
+#endif
+      if(result != 0 && errno != EEXIST)
+      {
+         fprintf(stderr, "Failed to create directory %s.\n", directory.c_str());
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * Reads the manifest of the last bake.
+ *
+ * @param entries The entries to fill in, which are left empty if there is no manifest (or it is of another version).
+ */
+static void readManifest(ManifestEntries& entries)
+{
+   std::ifstream input(MANIFEST_PATH);
+   std::string line;
+   std::string sourcePath;
+   std::string hash;
+   bool versionMatches = false;
+   while(std::getline(input, line))
+   {
+      if(!line.empty() && line[line.length() - 1] == '\r')
+      {
+         line.erase(line.length() - 1);
+      }
+
+      if(line.compare(0, 8, "version ") == 0)
+      {
+         versionMatches = atoi(line.c_str() + 8) == MANIFEST_VERSION;
+      }
+      else if(versionMatches && line.compare(0, 6, "asset ") == 0 && line.length() > 23 && line[22] == ' ')
+      {
+         hash = line.substr(6, 16);
+         sourcePath = line.substr(23);
+      }
+      else if(versionMatches && line.compare(0, 7, "output ") == 0 && !sourcePath.empty())
+      {
+         entries[sourcePath] = std::make_pair(hash, line.substr(7));
+         sourcePath.clear();
+      }
+   }
+}
+
+/**
+ * Writes the manifest of this bake.
+ *
+ * @param entries The baked files.
+ *
+ * @return true iff the manifest was written.
+ */
+static bool writeManifest(const ManifestEntries& entries)
+{
+   std::ofstream output(MANIFEST_PATH);
+   output << "# The files compiled by eden_bake, by the source that each was compiled from" << std::endl;
+   output << "version " << MANIFEST_VERSION << std::endl;
+   for(ManifestEntries::const_iterator iter = entries.begin(); iter != entries.end(); ++iter)
+   {
+      output << std::endl << "asset " << iter->second.first << ' ' << iter->first << std::endl;
+      output << "output " << iter->second.second << std::endl;
+   }
+
+   return output.good();
+}
+
+/**
+ * @param compiler The name of a compiler's executable.
+ * @param toolsDirectory The directory holding the compilers, or empty to find them on the search path.
+ *
+ * @return The path to run the compiler from.
+ */
+static std::string getCompilerPath(const char* compiler, const std::string& toolsDirectory)
+{
+   return toolsDirectory.empty() ? std::string(compiler) : toolsDirectory + '/' + compiler;
+}
+
+#ifdef _WIN32
+
+/**
+ * Runs the compiler of each bake. Windows has no fork(), so the compilers are run one after the other there.
+ *
+ * @param bakes The bakes to run.
+ * @param toolsDirectory The directory holding the compilers.
+ * @param jobCount Unused.
+ * @param succeeded Whether or not each bake's compiler succeeded.
+ */
+static void runCompilers(const std::vector<Bake>& bakes, const std::string& toolsDirectory, int /*jobCount*/, std::vector<bool>& succeeded)
+{
+   for(std::size_t i = 0; i < bakes.size(); ++i)
+   {
+      const std::string compilerPath = getCompilerPath(bakes[i].rule->compiler, toolsDirectory);
+      const char* const args[] = { compilerPath.c_str(), bakes[i].sourcePath.c_str(), bakes[i].bakedPath.c_str(), NULL };
+      succeeded[i] = _spawnvp(_P_WAIT, args[0], args) == 0;
+   }
+}
+
+#else
+
+/**
+ * Starts the compiler of a bake in a process of its own.
+ *
+ * @param bake The bake to run.
+ * @param toolsDirectory The directory holding the compilers.
+ *
+ * @return The compiler's process, or -1 if it couldn't be started.
+ */
+static pid_t startCompiler(const Bake& bake, const std::string& toolsDirectory)
+{
+   const std::string compilerPath = getCompilerPath(bake.rule->compiler, toolsDirectory);
+   const char* const args[] = { compilerPath.c_str(), bake.sourcePath.c_str(), bake.bakedPath.c_str(), NULL };
+
+   const pid_t process = fork();
+   if(process == 0)
+   {
+      execvp(args[0], const_cast<char* const*>(args));
+      fprintf(stderr, "Failed to run %s: %s\n", args[0], strerror(errno));
+      _exit(127);
+   }
+   else if(process < 0)
+   {
+      fprintf(stderr, "Failed to start %s for %s.\n", args[0], bake.sourcePath.c_str());
+   }
+
+   return process;
+}
+
+/**
+ * Runs the compiler of each bake, with up to a given number of compilers running at once.
+ *
+ * @param bakes The bakes to run.
+ * @param toolsDirectory The directory holding the compilers.
+ * @param jobCount The most compilers to run at once.
+ * @param succeeded Whether or not each bake's compiler succeeded.
+ */
+static void runCompilers(const std::vector<Bake>& bakes, const std::string& toolsDirectory, int jobCount, std::vector<bool>& succeeded)
+{
+   std::map<pid_t, std::size_t> running;
+   std::size_t nextBake = 0;
+   while(nextBake < bakes.size() || !running.empty())
+   {
+      while(nextBake < bakes.size() && static_cast<int>(running.size()) < jobCount)
+      {
+         const pid_t process = startCompiler(bakes[nextBake], toolsDirectory);
+         if(process > 0)
+         {
+            running[process] = nextBake;
+         }
+
+         ++nextBake;
+      }
+
+      if(running.empty()) continue;
+
+      int status = 0;
+      const pid_t process = waitpid(-1, &status, 0);
+      if(process < 0)
+      {
+         fprintf(stderr, "Failed to wait for the compilers: %s\n", strerror(errno));
+         return;
+      }
+
+      const std::map<pid_t, std::size_t>::iterator finished = running.find(process);
+      if(finished != running.end())
+      {
+         succeeded[finished->second] = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+         running.erase(finished);
+      }
+   }
+}
+
+#endif
+
+int main(int argc, char* argv[])
+{
+#ifdef _WIN32
+   int jobCount = 1;
+#else
+   int jobCount = std::max(1, static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)));
+#endif
+
+   // The compilers are built beside the baker
+   std::string toolsDirectory = argv[0];
+   std::replace(toolsDirectory.begin(), toolsDirectory.end(), '\\', '/');
+   const std::size_t lastSlash = toolsDirectory.find_last_of('/');
+   toolsDirectory.erase(lastSlash == std::string::npos ? 0 : lastSlash);
+
+   for(int argNum = 1; argNum < argc; ++argNum)
+   {
+      if(strcmp(argv[argNum], "-j") == 0 && argNum + 1 < argc && atoi(argv[argNum + 1]) > 0)
+      {
+         jobCount = atoi(argv[++argNum]);
+      }
+      else if(strcmp(argv[argNum], "--tools") == 0 && argNum + 1 < argc)
+      {
+         toolsDirectory = argv[++argNum];
+      }
+      else
+      {
+         fprintf(stderr, "Usage: %s [-j <jobs>] [--tools <directory>]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   std::vector<std::string> paths;
+   if(!findFiles(DATA_DIRECTORY, paths))
+   {
+      return 1;
+   }
+
+   std::sort(paths.begin(), paths.end());
+
+   // The files that the compilers also read are hashed once for every source that depends on them
+   std::map<std::string, Uint64> dependencyHashes;
+   for(int rule = 0; rule < RULE_COUNT; ++rule)
+   {
+      if(RULES[rule].dependencies == NULL || dependencyHashes.count(RULES[rule].dependencies) > 0) continue;
+
+      const std::string directory = std::string(DATA_DIRECTORY) + '/' + RULES[rule].dependencies + '/';
+      Uint64 hash = 0xCBF29CE484222325ULL;
+      for(std::vector<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter)
+      {
+         if(iter->compare(0, directory.length(), directory) == 0 && !addFileToHash(hash, *iter))
+         {
+            return 1;
+         }
+      }
+
+      dependencyHashes[RULES[rule].dependencies] = hash;
+   }
+
+   ManifestEntries lastEntries;
+   readManifest(lastEntries);
+
+   ManifestEntries entries;
+   std::vector<Bake> bakes;
+   int upToDateCount = 0;
+   for(std::vector<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter)
+   {
+      const std::string relativePath = iter->substr(strlen(DATA_DIRECTORY) + 1);
+      const BakeRule* rule = NULL;
+      for(int ruleNum = 0; ruleNum < RULE_COUNT && rule == NULL; ++ruleNum)
+      {
+         if(relativePath.compare(0, strlen(RULES[ruleNum].sourcePrefix), RULES[ruleNum].sourcePrefix) == 0 && endsWith(relativePath, RULES[ruleNum].sourceExtension))
+         {
+            rule = &RULES[ruleNum];
+         }
+      }
+
+      if(rule == NULL) continue;
+
+      Uint64 hash = 0xCBF29CE484222325ULL;
+      addToHash(hash, rule->compiler, strlen(rule->compiler) + 1);
+      for(int byte = 0; byte < 4; ++byte)
+      {
+         const char versionByte = static_cast<char>((rule->formatVersion >> (byte * 8)) & 0xFF);
+         addToHash(hash, &versionByte, 1);
+      }
+
+      if(rule->dependencies != NULL)
+      {
+         const Uint64 dependencyHash = dependencyHashes[rule->dependencies];
+         for(int byte = 0; byte < 8; ++byte)
+         {
+            const char hashByte = static_cast<char>((dependencyHash >> (byte * 8)) & 0xFF);
+            addToHash(hash, &hashByte, 1);
+         }
+      }
+
+      if(!addFileToHash(hash, *iter))
+      {
+         return 1;
+      }
+
+      Bake bake;
+      bake.sourcePath = *iter;
+      bake.rule = rule;
+      bake.hash = toHex(hash);
+
+      const std::string stem = relativePath.substr(0, relativePath.length() - strlen(rule->sourceExtension));
+      bake.bakedPath = std::string(BAKED_DIRECTORY) + '/' + stem + '-' + bake.hash + rule->bakedExtension;
+
+      const ManifestEntries::const_iterator lastEntry = lastEntries.find(bake.sourcePath);
+      if(lastEntry != lastEntries.end() && lastEntry->second.first == bake.hash && lastEntry->second.second == bake.bakedPath && fileExists(bake.bakedPath))
+      {
+         entries[bake.sourcePath] = lastEntry->second;
+         ++upToDateCount;
+      }
+      else if(createDirectories(bake.bakedPath))
+      {
+         bakes.push_back(bake);
+      }
+      else
+      {
+         return 1;
+      }
+   }
+
+   std::vector<bool> succeeded(bakes.size(), false);
+   runCompilers(bakes, toolsDirectory, jobCount, succeeded);
+
+   // A source that failed to bake is left out of the manifest, so that the engine loads the source instead of an older bake
+   int failedCount = 0;
+   for(std::size_t i = 0; i < bakes.size(); ++i)
+   {
+      if(succeeded[i])
+      {
+         entries[bakes[i].sourcePath] = std::make_pair(bakes[i].hash, bakes[i].bakedPath);
+      }
+      else
+      {
+         fprintf(stderr, "Failed to bake %s with %s.\n", bakes[i].sourcePath.c_str(), bakes[i].rule->compiler);
+         remove(bakes[i].bakedPath.c_str());
+         ++failedCount;
+      }
+   }
+
+   if(!createDirectories(MANIFEST_PATH) || !writeManifest(entries))
+   {
+      fprintf(stderr, "Failed to write bake manifest %s.\n", MANIFEST_PATH);
+      return 1;
+   }
+
+   // The older versions of the baked files are only deleted once the manifest no longer lists them
+   for(ManifestEntries::const_iterator iter = lastEntries.begin(); iter != lastEntries.end(); ++iter)
+   {
+      const ManifestEntries::const_iterator entry = entries.find(iter->first);
+      if(entry == entries.end() || entry->second.second != iter->second.second)
+      {
+         remove(iter->second.second.c_str());
+      }
+   }
+
+   printf("Baked %d files (%d up to date, %d failed).\n", static_cast<int>(bakes.size()) - failedCount, upToDateCount, failedCount);
+   return failedCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,164 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * The offline asset packer. It packs every file under a data directory into an asset archive (.edp),
+ * which the engine maps into memory in one piece instead of opening each of its files separately.
+ * See AssetArchiveFormat.h for the layout of the output.
+ *
+ * Usage: asset_packer <data directory> <archive.edp>
+ *
+ * The files are stored under the data directory's path as it is given, so run the packer from the
+ * game's directory (as in "asset_packer data data.edp") so that the paths match the ones the engine opens.
+ */
+
+#include "AssetArchiveFormat.h"
+#include "BinaryOutput.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Saved games are written by the game as it runs, so they have to stay loose files
+static const char* const SKIPPED_DIRECTORY = "savegames";
+
+/**
+ * Orders paths by their bytes (as unsigned characters), the same way that the engine searches the index.
+ */
+static bool pathLess(const std::string& lhs, const std::string& rhs)
+{
+   const int order = memcmp(lhs.data(), rhs.data(), std::min(lhs.length(), rhs.length()));
+   return order < 0 || (order == 0 && lhs.length() < rhs.length());
+}
+
+/**
+ * Finds every file under a directory.
+ *
+ * @param directory The path of the directory, with forward slashes and without a trailing slash.
+ * @param paths The list to add the paths of the files to.
+ *
+ * @return true iff the directory (and every directory under it) could be read.
+ */
+static bool findFiles(const std::string& directory, std::vector<std::string>& paths)
+{
+   DIR* dir = opendir(directory.c_str());
+   if(dir == NULL)
+   {
+      fprintf(stderr, "Failed to read directory %s.\n", directory.c_str());
+      return false;
+   }
+
+   bool succeeded = true;
+   struct dirent* entry;
+   while(succeeded && (entry = readdir(dir)) != NULL)
+   {
+      // Skip hidden files, along with the current and parent directories
+      if(entry->d_name[0] == '.') continue;
+
+      const std::string path = directory + '/' + entry->d_name;
+      struct stat fileInfo;
+      if(stat(path.c_str(), &fileInfo) != 0)
+      {
+         fprintf(stderr, "Failed to read %s.\n", path.c_str());
+         succeeded = false;
+      }
+      else if(S_ISDIR(fileInfo.st_mode))
+      {
+         if(strcmp(entry->d_name, SKIPPED_DIRECTORY) != 0)
+         {
+            succeeded = findFiles(path, paths);
+         }
+      }
+      else if(S_ISREG(fileInfo.st_mode))
+      {
+         paths.push_back(path);
+      }
+   }
+
+   closedir(dir);
+   return succeeded;
+}
+
+int main(int argc, char* argv[])
+{
+   if(argc < 3)
+   {
+      fprintf(stderr, "Usage: %s <data directory> <archive.edp>\n", argv[0]);
+      return 1;
+   }
+
+   std::string directory = argv[1];
+   std::replace(directory.begin(), directory.end(), '\\', '/');
+   while(directory.length() > 1 && directory[directory.length() - 1] == '/')
+   {
+      directory.erase(directory.length() - 1);
+   }
+
+   std::vector<std::string> paths;
+   if(!findFiles(directory, paths))
+   {
+      return 1;
+   }
+
+   std::sort(paths.begin(), paths.end(), pathLess);
+
+   using AssetArchiveFormat::Header;
+   using AssetArchiveFormat::Entry;
+
+   std::vector<char> output(sizeof(Header) + paths.size() * sizeof(Entry), 0);
+   memcpy(&output[0], AssetArchiveFormat::MAGIC, sizeof(AssetArchiveFormat::MAGIC));
+   writeNumberAt(output, offsetof(Header, version), AssetArchiveFormat::VERSION);
+   writeNumberAt(output, offsetof(Header, entryCount), paths.size());
+   writeNumberAt(output, offsetof(Header, indexOffset), sizeof(Header));
+
+   const std::size_t pathsOffset = output.size();
+   writeNumberAt(output, offsetof(Header, pathsOffset), pathsOffset);
+   for(std::size_t i = 0; i < paths.size(); ++i)
+   {
+      const std::size_t entryOffset = sizeof(Header) + i * sizeof(Entry);
+      writeNumberAt(output, entryOffset + offsetof(Entry, pathOffset), output.size() - pathsOffset);
+      writeNumberAt(output, entryOffset + offsetof(Entry, pathLength), paths[i].length());
+      output.insert(output.end(), paths[i].begin(), paths[i].end());
+   }
+
+   for(std::size_t i = 0; i < paths.size(); ++i)
+   {
+      std::ifstream file(paths[i].c_str(), std::ios::in | std::ios::binary);
+      if(!file)
+      {
+         fprintf(stderr, "Failed to read %s.\n", paths[i].c_str());
+         return 1;
+      }
+
+      // Every file starts on an aligned boundary so that the engine can use its contents in place
+      output.resize((output.size() + AssetArchiveFormat::ALIGNMENT - 1) & ~std::size_t(AssetArchiveFormat::ALIGNMENT - 1), 0);
+
+      const std::size_t dataOffset = output.size();
+      output.insert(output.end(), std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+      const std::size_t entryOffset = sizeof(Header) + i * sizeof(Entry);
+      writeNumberAt(output, entryOffset + offsetof(Entry, dataOffset), dataOffset);
+      writeNumberAt(output, entryOffset + offsetof(Entry, dataSize), output.size() - dataOffset);
+   }
+
+   writeNumberAt(output, offsetof(Header, fileSize), output.size());
+
+   std::ofstream archive(argv[2], std::ios::out | std::ios::binary);
+   if(!archive.write(&output[0], output.size()))
+   {
+      fprintf(stderr, "Failed to write asset archive %s.\n", argv[2]);
+      return 1;
+   }
+
+   printf("Packed %d files from %s into %s (%d bytes)\n", static_cast<int>(paths.size()), directory.c_str(), argv[2], static_cast<int>(output.size()));
+   return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef BINARY_OUTPUT_H
+#define BINARY_OUTPUT_H
+
+#include "SDL_stdinc.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * The byte writers shared by the offline tools that write the engine's binary formats.
+ * Every number in those formats is 32 bits wide and little-endian, whatever the machine's byte order.
+ */
+
+/**
+ * Appends a number to the output in little-endian byte order.
+ *
+ * @param output The output to append to.
+ * @param number The number to append.
+ */
+inline void writeNumber(std::vector<char>& output, Uint32 number)
+{
+   for(int byte = 0; byte < 4; ++byte)
+   {
+      output.push_back(static_cast<char>((number >> (byte * 8)) & 0xFF));
+   }
+}
+
+/**
+ * Overwrites a number in the output in little-endian byte order.
+ *
+ * @param output The output to write to.
+ * @param offset The offset of the number to overwrite.
+ * @param number The number to write.
+ */
+inline void writeNumberAt(std::vector<char>& output, std::size_t offset, Uint32 number)
+{
+   for(int byte = 0; byte < 4; ++byte)
+   {
+      output[offset + byte] = static_cast<char>((number >> (byte * 8)) & 0xFF);
+   }
+}
+
+/**
+ * Appends a string (its 32-bit length followed by its characters) to the output.
+ *
+ * @param output The output to append to.
+ * @param str The string to append.
+ */
+inline void writeString(std::vector<char>& output, const std::string& str)
+{
+   writeNumber(output, str.length());
+   output.insert(output.end(), str.begin(), str.end());
+}
+
+#endif
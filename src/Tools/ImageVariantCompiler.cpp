@@ -0,0 +1,211 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * The offline image variant compiler. It turns one of the GUI's images (such as a portrait or a menu background)
+ * into an image variant file (.edv), holding copies of the image downscaled to half its size, a quarter of it and so on,
+ * so that the engine can load an image shown smaller than its source from the smallest copy that covers it.
+ * See ImageVariantFormat.h for the layout of the output.
+ *
+ * Usage: image_variant_compiler <image> <variants.edv>
+ */
+
+#include "BinaryOutput.h"
+#include "ImageVariantFormat.h"
+#include "SDL_image.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// Below this size (in pixels, on either side) a variant is no cheaper to keep than to scale from a larger one
+static const int MIN_VARIANT_SIZE = 32;
+
+/**
+ * Reads an image into rows of RGBA pixels, the same way that the GUI's image loader does.
+ *
+ * @param path The path of the image.
+ * @param pixels The pixels of the image, 4 bytes each.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ *
+ * @return true iff the image was read.
+ */
+static bool readImage(const char* path, std::vector<unsigned char>& pixels, int& width, int& height)
+{
+   SDL_Surface* image = IMG_Load(path);
+   if(image == NULL)
+   {
+      fprintf(stderr, "Failed to load image %s: %s\n", path, IMG_GetError());
+      return false;
+   }
+
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+   SDL_Surface* format = SDL_CreateRGBSurface(SDL_SWSURFACE, 0, 0, 32, 0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF);
+#else
+   SDL_Surface* format = SDL_CreateRGBSurface(SDL_SWSURFACE, 0, 0, 32, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000);
+#endif
+
+   SDL_Surface* converted = format == NULL ? NULL : SDL_ConvertSurface(image, format->format, SDL_SWSURFACE);
+   SDL_FreeSurface(format);
+   SDL_FreeSurface(image);
+   if(converted == NULL)
+   {
+      fprintf(stderr, "Failed to convert image %s: %s\n", path, SDL_GetError());
+      return false;
+   }
+
+   width = converted->w;
+   height = converted->h;
+   pixels.resize(width * height * 4);
+
+   SDL_LockSurface(converted);
+   for(int y = 0; y < height; ++y)
+   {
+      memcpy(&pixels[y * width * 4], static_cast<const char*>(converted->pixels) + y * converted->pitch, width * 4);
+   }
+   SDL_UnlockSurface(converted);
+   SDL_FreeSurface(converted);
+
+   // The GUI draws magic pink as transparent, so it is taken out before it can bleed into the pixels around it
+   for(std::size_t i = 0; i < pixels.size(); i += 4)
+   {
+      if(pixels[i] == 0xFF && pixels[i + 1] == 0x00 && pixels[i + 2] == 0xFF && pixels[i + 3] == 0xFF)
+      {
+         pixels[i + 3] = 0;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * Downscales an image to half its size (rounding down, but no smaller than a pixel), averaging each square of 2x2 pixels.
+ * The colours are weighted by their opacity, so that the colours of transparent pixels don't show at the edges of shapes.
+ *
+ * @param source The pixels of the image.
+ * @param sourceWidth The width of the image.
+ * @param sourceHeight The height of the image.
+ * @param scaled The pixels of the downscaled image.
+ * @param width The width of the downscaled image.
+ * @param height The height of the downscaled image.
+ */
+static void halve(const std::vector<unsigned char>& source, int sourceWidth, int sourceHeight, std::vector<unsigned char>& scaled, int& width, int& height)
+{
+   width = sourceWidth > 1 ? sourceWidth / 2 : 1;
+   height = sourceHeight > 1 ? sourceHeight / 2 : 1;
+   scaled.resize(width * height * 4);
+
+   for(int y = 0; y < height; ++y)
+   {
+      for(int x = 0; x < width; ++x)
+      {
+         unsigned int colour[3] = { 0, 0, 0 };
+         unsigned int alpha = 0;
+         for(int sample = 0; sample < 4; ++sample)
+         {
+            // A side of a single pixel is sampled twice over
+            const int sourceX = std::min(x * 2 + (sample & 1), sourceWidth - 1);
+            const int sourceY = std::min(y * 2 + (sample >> 1), sourceHeight - 1);
+            const unsigned char* pixel = &source[(sourceY * sourceWidth + sourceX) * 4];
+            for(int channel = 0; channel < 3; ++channel)
+            {
+               colour[channel] += pixel[channel] * pixel[3];
+            }
+
+            alpha += pixel[3];
+         }
+
+         unsigned char* pixel = &scaled[(y * width + x) * 4];
+         for(int channel = 0; channel < 3; ++channel)
+         {
+            pixel[channel] = alpha == 0 ? 0 : static_cast<unsigned char>((colour[channel] + alpha / 2) / alpha);
+         }
+
+         pixel[3] = static_cast<unsigned char>((alpha + 2) / 4);
+      }
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   if(argc < 3)
+   {
+      fprintf(stderr, "Usage: %s <image> <variants.edv>\n", argv[0]);
+      return 1;
+   }
+
+   std::vector<unsigned char> pixels;
+   int width, height;
+   if(!readImage(argv[1], pixels, width, height))
+   {
+      return 1;
+   }
+
+   const int sourceWidth = width;
+   const int sourceHeight = height;
+
+   std::vector<std::vector<unsigned char> > variants;
+   std::vector<std::pair<int, int> > variantSizes;
+   while(width / 2 >= MIN_VARIANT_SIZE && height / 2 >= MIN_VARIANT_SIZE)
+   {
+      std::vector<unsigned char> scaled;
+      halve(pixels, width, height, scaled, width, height);
+      pixels.swap(scaled);
+
+      uLongf compressedSize = compressBound(pixels.size());
+      std::vector<unsigned char> compressed(compressedSize);
+      if(compress2(&compressed[0], &compressedSize, &pixels[0], pixels.size(), Z_BEST_COMPRESSION) != Z_OK)
+      {
+         fprintf(stderr, "Failed to compress the %dx%d variant of %s.\n", width, height, argv[1]);
+         return 1;
+      }
+
+      compressed.resize(compressedSize);
+      variants.push_back(compressed);
+      variantSizes.push_back(std::make_pair(width, height));
+   }
+
+   std::vector<char> output(sizeof(ImageVariantFormat::Header), 0);
+   memcpy(&output[0], ImageVariantFormat::MAGIC, sizeof(ImageVariantFormat::MAGIC));
+   writeNumberAt(output, offsetof(ImageVariantFormat::Header, version), ImageVariantFormat::VERSION);
+   writeNumberAt(output, offsetof(ImageVariantFormat::Header, sourceWidth), sourceWidth);
+   writeNumberAt(output, offsetof(ImageVariantFormat::Header, sourceHeight), sourceHeight);
+   writeNumberAt(output, offsetof(ImageVariantFormat::Header, variantCount), variants.size());
+   writeNumberAt(output, offsetof(ImageVariantFormat::Header, variantsOffset), output.size());
+
+   // The pixels go after all of the variants, each found by the offset in its variant
+   std::size_t pixelsOffset = output.size() + variants.size() * sizeof(ImageVariantFormat::Variant);
+   for(std::size_t i = 0; i < variants.size(); ++i)
+   {
+      writeNumber(output, variantSizes[i].first);
+      writeNumber(output, variantSizes[i].second);
+      writeNumber(output, pixelsOffset);
+      writeNumber(output, variants[i].size());
+      pixelsOffset += variants[i].size();
+   }
+
+   for(std::size_t i = 0; i < variants.size(); ++i)
+   {
+      output.insert(output.end(), variants[i].begin(), variants[i].end());
+   }
+
+   writeNumberAt(output, offsetof(ImageVariantFormat::Header, fileSize), output.size());
+
+   std::ofstream file(argv[2], std::ios::out | std::ios::binary);
+   if(!file.write(&output[0], output.size()))
+   {
+      fprintf(stderr, "Failed to write image variants %s.\n", argv[2]);
+      return 1;
+   }
+
+   printf("Compiled %d variants of %s (%dx%d) into %s (%d bytes)\n", static_cast<int>(variants.size()), argv[1],
+         sourceWidth, sourceHeight, argv[2], static_cast<int>(output.size()));
+   return 0;
+}
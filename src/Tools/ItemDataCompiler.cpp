@@ -0,0 +1,135 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * The offline item data compiler. It turns the JSON item database (items.edb) into a compiled item database (.edi),
+ * with a record for every item ID in order, so that the engine can map the file and index the records by ID
+ * without parsing any JSON. See ItemDataFormat.h for the layout of the output.
+ *
+ * Usage: item_data_compiler <items.edb> <items.edi>
+ */
+
+#include "BinaryOutput.h"
+#include "ItemDataFormat.h"
+#include "json.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Item IDs are grouped in ranges of a few hundred by kind of item, so a database with IDs above this is most likely a typo
+static const int MAX_ITEM_ID = 65535;
+
+int main(int argc, char* argv[])
+{
+   if(argc < 3)
+   {
+      fprintf(stderr, "Usage: %s <items.edb> <items.edi>\n", argv[0]);
+      return 1;
+   }
+
+   std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+   if(!input)
+   {
+      fprintf(stderr, "Failed to open item database %s.\n", argv[1]);
+      return 1;
+   }
+
+   // The item database has comments between its items, which the reader allows
+   const std::string document((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+   Json::Reader reader;
+   Json::Value root;
+   if(!reader.parse(document, root, false))
+   {
+      fprintf(stderr, "Failed to parse item database %s: %s\n", argv[1], reader.getFormattedErrorMessages().c_str());
+      return 1;
+   }
+
+   const Json::Value& itemList = root["data"];
+   if(!itemList.isArray())
+   {
+      fprintf(stderr, "Item database %s must be an object holding an array of items named \"data\".\n", argv[1]);
+      return 1;
+   }
+
+   std::vector<std::string> names;
+   std::vector<bool> used;
+   for(Json::ArrayIndex i = 0; i < itemList.size(); ++i)
+   {
+      const Json::Value& item = itemList[i];
+      if(!item.isObject() || !item["id"].isInt() || !item["name"].isString())
+      {
+         fprintf(stderr, "Item %u in %s must have an integer id and a string name.\n", i, argv[1]);
+         return 1;
+      }
+
+      const int id = item["id"].asInt();
+      if(id < 0 || id > MAX_ITEM_ID)
+      {
+         fprintf(stderr, "Item %s in %s has ID %d, which is outside of 0 to %d.\n", item["name"].asCString(), argv[1], id, MAX_ITEM_ID);
+         return 1;
+      }
+
+      if(static_cast<std::size_t>(id) >= names.size())
+      {
+         names.resize(id + 1);
+         used.resize(id + 1, false);
+      }
+
+      if(used[id])
+      {
+         fprintf(stderr, "Items %s and %s in %s both have ID %d.\n", names[id].c_str(), item["name"].asCString(), argv[1], id);
+         return 1;
+      }
+
+      names[id] = item["name"].asString();
+      used[id] = true;
+   }
+
+   std::vector<char> output(sizeof(ItemDataFormat::Header), 0);
+   memcpy(&output[0], ItemDataFormat::MAGIC, sizeof(ItemDataFormat::MAGIC));
+   writeNumberAt(output, offsetof(ItemDataFormat::Header, version), ItemDataFormat::VERSION);
+   writeNumberAt(output, offsetof(ItemDataFormat::Header, recordCount), names.size());
+   writeNumberAt(output, offsetof(ItemDataFormat::Header, itemCount), itemList.size());
+
+   // The names go one after the other, each found by the record of its item
+   std::string characters;
+   writeNumberAt(output, offsetof(ItemDataFormat::Header, recordsOffset), output.size());
+   for(std::size_t id = 0; id < names.size(); ++id)
+   {
+      if(!used[id])
+      {
+         writeNumber(output, ItemDataFormat::NO_ITEM);
+         writeNumber(output, 0);
+         continue;
+      }
+
+      writeNumber(output, characters.size());
+      writeNumber(output, names[id].length());
+      characters += names[id];
+      characters += '\0';
+   }
+
+   writeNumberAt(output, offsetof(ItemDataFormat::Header, namesOffset), output.size());
+   writeNumberAt(output, offsetof(ItemDataFormat::Header, namesSize), characters.size());
+   output.insert(output.end(), characters.begin(), characters.end());
+
+   writeNumberAt(output, offsetof(ItemDataFormat::Header, fileSize), output.size());
+
+   std::ofstream database(argv[2], std::ios::out | std::ios::binary);
+   if(!database.write(&output[0], output.size()))
+   {
+      fprintf(stderr, "Failed to write item database %s.\n", argv[2]);
+      return 1;
+   }
+
+   printf("Compiled %d items from %s (IDs 0 to %d) into %s (%d bytes)\n", static_cast<int>(itemList.size()), argv[1],
+         static_cast<int>(names.size()) - 1, argv[2], static_cast<int>(output.size()));
+   return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * The offline map compiler. It turns a Tiled map (.tmx) and the passability of its tileset into
+ * a compiled map (.edm) file, which the engine can load without parsing any XML or text.
+ * See CompiledMapFormat.h for the layout of the output.
+ *
+ * Usage: map_compiler <map.tmx> <map.edm> [tileset directory]
+ *
+ * The tileset directory defaults to data/tilesets/, and must hold the tileset's image (.png)
+ * and passability data (.edt), since the tileset size comes from the image.
+ */
+
+#include "BinaryOutput.h"
+#include "CompiledMapFormat.h"
+#include "tinyxml.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// The same as TileEngine::TILE_SIZE, which the tileset image is divided into
+static const int TILE_SIZE = 32;
+
+// The same as ResourceLoader's tileset path
+static const char* const DEFAULT_TILESET_DIRECTORY = "data/tilesets/";
+
+/** A tileset's size and the passability of each of its tiles. */
+struct TilesetPassability
+{
+   /** The width of the tileset (in tiles). */
+   int width;
+
+   /** The height of the tileset (in tiles). */
+   int height;
+
+   /** The passability of each tile, indexed by tile number. */
+   std::vector<bool> passable;
+};
+
+/**
+ * Reads the size of a tileset from its image, and the passability of its tiles from its data file,
+ * the same way that the engine's tilesets do.
+ *
+ * @param path The path to the tileset, without an extension.
+ * @param tileset The tileset passability to fill in.
+ *
+ * @return true iff the tileset was read.
+ */
+static bool readTileset(const std::string& path, TilesetPassability& tileset)
+{
+   // The image size is in the PNG header: an 8-byte signature, then the IHDR chunk's length, type, width and height
+   std::ifstream image((path + ".png").c_str(), std::ios::in | std::ios::binary);
+   unsigned char imageHeader[24];
+   if(!image.read(reinterpret_cast<char*>(imageHeader), sizeof(imageHeader)) || memcmp(imageHeader + 1, "PNG", 3) != 0)
+   {
+      fprintf(stderr, "Failed to read the tileset image %s.png\n", path.c_str());
+      return false;
+   }
+
+   const long imageWidth = (long(imageHeader[16]) << 24) | (imageHeader[17] << 16) | (imageHeader[18] << 8) | imageHeader[19];
+   const long imageHeight = (long(imageHeader[20]) << 24) | (imageHeader[21] << 16) | (imageHeader[22] << 8) | imageHeader[23];
+   tileset.width = imageWidth / TILE_SIZE;
+   tileset.height = imageHeight / TILE_SIZE;
+   tileset.passable.assign(tileset.width * tileset.height, false);
+
+   // Tileset data lists passability column by column
+   std::ifstream data((path + ".edt").c_str());
+   for(int x = 0; x < tileset.width; ++x)
+   {
+      for(int y = 0; y < tileset.height; ++y)
+      {
+         int passable;
+         if(!(data >> passable))
+         {
+            fprintf(stderr, "Tileset %s has an incomplete passibility matrix.\n", path.c_str());
+            return false;
+         }
+
+         tileset.passable[y * tileset.width + x] = passable != 0;
+      }
+   }
+
+   return true;
+}
+
+int main(int argc, char* argv[])
+{
+   if(argc < 3)
+   {
+      fprintf(stderr, "Usage: %s <map.tmx> <map.edm> [tileset directory]\n", argv[0]);
+      return 1;
+   }
+
+   const std::string tilesetDirectory = argc > 3 ? argv[3] : DEFAULT_TILESET_DIRECTORY;
+
+   TiXmlDocument xmlDoc(argv[1]);
+   if(!xmlDoc.LoadFile())
+   {
+      fprintf(stderr, "Failed to parse map %s: %s\n", argv[1], xmlDoc.ErrorDesc());
+      return 1;
+   }
+
+   TiXmlElement* root = xmlDoc.RootElement();
+   if(root == NULL || strcmp(root->Value(), "map") != 0)
+   {
+      fprintf(stderr, "Unexpected root element name in map %s.\n", argv[1]);
+      return 1;
+   }
+
+   int width = 0;
+   int height = 0;
+   root->Attribute("width", &width);
+   root->Attribute("height", &height);
+   if(width <= 0 || height <= 0)
+   {
+      fprintf(stderr, "Map %s has no size.\n", argv[1]);
+      return 1;
+   }
+
+   std::map<std::string, std::string> properties;
+   TiXmlElement* propertiesElement = root->FirstChildElement("properties");
+   TiXmlElement* propertyElement = propertiesElement != NULL ? propertiesElement->FirstChildElement("property") : NULL;
+   while(propertyElement != NULL)
+   {
+      const char* propertyName = propertyElement->Attribute("name");
+      const char* propertyValue = propertyElement->Attribute("value");
+      if(propertyName != NULL && propertyValue != NULL)
+      {
+         properties[propertyName] = propertyValue;
+      }
+
+      propertyElement = propertyElement->NextSiblingElement("property");
+   }
+
+   const std::string tilesetName = properties["tilesetName"];
+   TilesetPassability tileset;
+   if(tilesetName.empty())
+   {
+      fprintf(stderr, "Map %s doesn't contain a tileset.\n", argv[1]);
+      return 1;
+   }
+   else if(!readTileset(tilesetDirectory + tilesetName, tileset))
+   {
+      return 1;
+   }
+
+   TiXmlElement* floorElement = root->FirstChildElement("layer");
+   TiXmlElement* dataElement = floorElement != NULL ? floorElement->FirstChildElement("data") : NULL;
+   TiXmlNode* dataNode = dataElement != NULL ? dataElement->FirstChild() : NULL;
+   TiXmlText* floorData = dataNode != NULL ? dataNode->ToText() : NULL;
+   if(floorData == NULL)
+   {
+      fprintf(stderr, "Expected layer data in map %s.\n", argv[1]);
+      return 1;
+   }
+
+   const int chunkSize = CompiledMapFormat::CHUNK_SIZE;
+   const int chunksWide = (width + chunkSize - 1) / chunkSize;
+   const int chunksHigh = (height + chunkSize - 1) / chunkSize;
+
+   std::vector<Sint32> tiles(chunksWide * chunksHigh * chunkSize * chunkSize, -1);
+   std::vector<unsigned char> passability((width * height + 7) / 8, 0);
+   int unknownTiles = 0;
+
+   const char* cursor = floorData->Value();
+   for(int y = 0; y < height; ++y)
+   {
+      for(int x = 0; x < width; ++x)
+      {
+         char* entryEnd;
+         const int tileNum = strtol(cursor, &entryEnd, 10) - 1;
+         if(entryEnd == cursor)
+         {
+            fprintf(stderr, "Tile map incomplete in map %s.\n", argv[1]);
+            return 1;
+         }
+
+         cursor = *entryEnd == ',' ? entryEnd + 1 : entryEnd;
+
+         const int chunkNum = (y / chunkSize) * chunksWide + x / chunkSize;
+         tiles[chunkNum * chunkSize * chunkSize + (y % chunkSize) * chunkSize + x % chunkSize] = tileNum;
+
+         // Tiles that aren't in the tileset are left impassable
+         const bool known = tileNum >= 0 && tileNum < static_cast<int>(tileset.passable.size());
+         unknownTiles += known ? 0 : 1;
+         if(known && tileset.passable[tileNum])
+         {
+            const int tileIndex = y * width + x;
+            passability[tileIndex >> 3] |= 1 << (tileIndex & 7);
+         }
+      }
+   }
+
+   if(unknownTiles > 0)
+   {
+      fprintf(stderr, "Warning: %d tiles in map %s are not in tileset %s, and are impassable.\n", unknownTiles, argv[1], tilesetName.c_str());
+   }
+
+   std::vector<char> output(sizeof(CompiledMapFormat::Header), 0);
+   memcpy(&output[0], CompiledMapFormat::MAGIC, sizeof(CompiledMapFormat::MAGIC));
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, version), CompiledMapFormat::VERSION);
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, width), width);
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, height), height);
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, chunkSize), chunkSize);
+
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, propertyCount), properties.size());
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, propertiesOffset), output.size());
+   for(std::map<std::string, std::string>::const_iterator iter = properties.begin(); iter != properties.end(); ++iter)
+   {
+      writeString(output, iter->first);
+      writeString(output, iter->second);
+   }
+
+   // Tiles are aligned so that the engine can use them in place
+   output.resize((output.size() + 3) & ~std::size_t(3), 0);
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, tilesOffset), output.size());
+   for(std::vector<Sint32>::const_iterator iter = tiles.begin(); iter != tiles.end(); ++iter)
+   {
+      writeNumber(output, static_cast<Uint32>(*iter));
+   }
+
+   // Tiled maps carry no obstacles for the engine, so the obstacle records are empty
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, obstacleCount), 0);
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, obstaclesOffset), output.size());
+
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, passabilityOffset), output.size());
+   output.insert(output.end(), passability.begin(), passability.end());
+
+   writeNumberAt(output, offsetof(CompiledMapFormat::Header, fileSize), output.size());
+
+   std::ofstream compiledMap(argv[2], std::ios::out | std::ios::binary);
+   if(!compiledMap.write(&output[0], output.size()))
+   {
+      fprintf(stderr, "Failed to write compiled map %s.\n", argv[2]);
+      return 1;
+   }
+
+   printf("Compiled %s (%dx%d tiles) into %s (%d bytes)\n", argv[1], width, height, argv[2], static_cast<int>(output.size()));
+   return 0;
+}
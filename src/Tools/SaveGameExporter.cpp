@@ -0,0 +1,516 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * The save game exporter, for debugging save games. It decodes a binary save game (.edd) and writes it out as JSON,
+ * in the same layout as the JSON save games that came before the binary format (so the game can load the export too).
+ * See SaveGameFormat.h for the layout of the input.
+ *
+ * Usage: save_game_exporter <savegame.edd> [savegame.json]
+ *
+ * The JSON goes to the standard output if no output file is given. Fields that the exporter doesn't know
+ * (such as ones added by a later version of the game) are left out, with a warning.
+ */
+
+#include "SaveGameFormat.h"
+#include "SaveGameItemNames.h"
+#include "json.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/** A record of the save game being read. */
+struct Record
+{
+   /** The next byte to read. */
+   const char* position;
+
+   /** The end of the record. */
+   const char* end;
+};
+
+/** The string table of the save game. */
+static std::vector<std::string> strings;
+
+/** Set when the save game turns out not to decode. */
+static bool corrupt = false;
+
+/**
+ * @return The next varint in the record, or 0 if the record ends in the middle of one.
+ */
+static Uint32 readVarint(Record& record)
+{
+   Uint32 value = 0;
+   for(int byte = 0; byte < 5 && record.position != record.end; ++byte)
+   {
+      const unsigned char bits = static_cast<unsigned char>(*record.position++);
+      value |= static_cast<Uint32>(bits & 0x7F) << (7 * byte);
+      if((bits & 0x80) == 0)
+      {
+         return value;
+      }
+   }
+
+   corrupt = true;
+   record.position = record.end;
+   return 0;
+}
+
+/**
+ * Moves on to the next field of a record.
+ *
+ * @param record The record.
+ * @param tag Set to the tag of the field.
+ * @param wireType Set to the way that the field's value is stored.
+ *
+ * @return true iff there was another field in the record.
+ */
+static bool nextField(Record& record, unsigned int& tag, int& wireType)
+{
+   if(record.position == record.end)
+   {
+      return false;
+   }
+
+   const Uint32 key = readVarint(record);
+   tag = key >> SaveGameFormat::TAG_SHIFT;
+   wireType = key & ((1 << SaveGameFormat::TAG_SHIFT) - 1);
+   return !corrupt;
+}
+
+/**
+ * @return The value of a VARINT field.
+ */
+static Uint32 readUnsigned(Record& record, int wireType)
+{
+   if(wireType != SaveGameFormat::VARINT)
+   {
+      corrupt = true;
+      record.position = record.end;
+      return 0;
+   }
+
+   return readVarint(record);
+}
+
+/**
+ * @return The value of a VARINT field that holds a signed number.
+ */
+static int readInt(Record& record, int wireType)
+{
+   const Uint32 bits = readUnsigned(record, wireType);
+   return static_cast<int>((bits >> 1) ^ (0u - (bits & 1)));
+}
+
+/**
+ * @return The value of a VARINT field that holds a string.
+ */
+static std::string readString(Record& record, int wireType)
+{
+   const Uint32 index = readUnsigned(record, wireType);
+   if(index >= strings.size())
+   {
+      corrupt = true;
+      return "";
+   }
+
+   return strings[index];
+}
+
+/**
+ * @return The nested record (or packed list) held by a LENGTH_DELIMITED field.
+ */
+static Record readNested(Record& record, int wireType)
+{
+   Record nested = { record.end, record.end };
+   if(wireType != SaveGameFormat::LENGTH_DELIMITED)
+   {
+      corrupt = true;
+      record.position = record.end;
+      return nested;
+   }
+
+   const Uint32 length = readVarint(record);
+   if(length > static_cast<std::size_t>(record.end - record.position))
+   {
+      corrupt = true;
+      record.position = record.end;
+      return nested;
+   }
+
+   nested.position = record.position;
+   nested.end = record.position + length;
+   record.position = nested.end;
+   return nested;
+}
+
+/**
+ * @return The numbers in a field that holds a packed list, as a JSON array.
+ */
+static Json::Value readPacked(Record& record, int wireType)
+{
+   Json::Value values(Json::arrayValue);
+   Record packed = readNested(record, wireType);
+   while(packed.position != packed.end)
+   {
+      values.append(Json::Value(static_cast<Json::UInt>(readVarint(packed))));
+   }
+
+   return values;
+}
+
+/**
+ * Skips a field that the exporter doesn't know.
+ */
+static void skipField(Record& record, const char* recordName, unsigned int tag, int wireType)
+{
+   fprintf(stderr, "Warning: skipping unknown field %u of a %s record.\n", tag, recordName);
+   if(wireType == SaveGameFormat::VARINT)
+   {
+      readVarint(record);
+   }
+   else
+   {
+      readNested(record, wireType);
+   }
+}
+
+/**
+ * @return The JSON for an equipment slot record.
+ */
+static Json::Value exportEquipSlot(Record record)
+{
+   Json::Value slotNode(Json::objectValue);
+
+   unsigned int tag;
+   int wireType;
+   while(nextField(record, tag, wireType))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::EquipSlotField::EQUIPPED: slotNode["equipped"] = static_cast<int>(readUnsigned(record, wireType)); break;
+         case SaveGameFormat::EquipSlotField::ACCEPTED_TYPES: slotNode["types"] = readPacked(record, wireType); break;
+         case SaveGameFormat::EquipSlotField::DISABLED: slotNode["enabled"] = readUnsigned(record, wireType) == 0; break;
+         default: skipField(record, "equipment slot", tag, wireType);
+      }
+   }
+
+   return slotNode;
+}
+
+/**
+ * @return The JSON for an equipment record.
+ */
+static Json::Value exportEquipment(Record record)
+{
+   Json::Value equipmentNode(Json::objectValue);
+   Json::Value accessoriesNode(Json::arrayValue);
+
+   unsigned int tag;
+   int wireType;
+   while(nextField(record, tag, wireType))
+   {
+      const char* slotName = NULL;
+      switch(tag)
+      {
+         case SaveGameFormat::EquipmentField::HEAD: slotName = "Head"; break;
+         case SaveGameFormat::EquipmentField::BODY: slotName = "Body"; break;
+         case SaveGameFormat::EquipmentField::PRIMARY_WEAPON: slotName = "Wpn1"; break;
+         case SaveGameFormat::EquipmentField::PRIMARY_OFFHAND: slotName = "Off1"; break;
+         case SaveGameFormat::EquipmentField::SECONDARY_WEAPON: slotName = "Wpn2"; break;
+         case SaveGameFormat::EquipmentField::SECONDARY_OFFHAND: slotName = "Off2"; break;
+         case SaveGameFormat::EquipmentField::GARMENT: slotName = "Garment"; break;
+         case SaveGameFormat::EquipmentField::FEET: slotName = "Feet"; break;
+         case SaveGameFormat::EquipmentField::ACCESSORY:
+         {
+            accessoriesNode.append(exportEquipSlot(readNested(record, wireType)));
+            continue;
+         }
+         default:
+         {
+            skipField(record, "equipment", tag, wireType);
+            continue;
+         }
+      }
+
+      equipmentNode[slotName] = exportEquipSlot(readNested(record, wireType));
+   }
+
+   equipmentNode["Accessories"] = accessoriesNode;
+   return equipmentNode;
+}
+
+/**
+ * @return The JSON for a character record.
+ */
+static Json::Value exportCharacter(Record record)
+{
+   Json::Value characterNode(Json::objectValue);
+
+   unsigned int tag;
+   int wireType;
+   while(nextField(record, tag, wireType))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::CharacterField::NAME: characterNode[NAME_ATTRIBUTE] = readString(record, wireType); break;
+         case SaveGameFormat::CharacterField::HP: characterNode[HP_ATTRIBUTE] = readInt(record, wireType); break;
+         case SaveGameFormat::CharacterField::SP: characterNode[SP_ATTRIBUTE] = readInt(record, wireType); break;
+         case SaveGameFormat::CharacterField::MAX_HP: characterNode[MAX_HP_ATTRIBUTE] = readInt(record, wireType); break;
+         case SaveGameFormat::CharacterField::MAX_SP: characterNode[MAX_SP_ATTRIBUTE] = readInt(record, wireType); break;
+         case SaveGameFormat::CharacterField::STRENGTH: characterNode[STR_ATTRIBUTE] = readInt(record, wireType); break;
+         case SaveGameFormat::CharacterField::INTELLIGENCE: characterNode[INT_ATTRIBUTE] = readInt(record, wireType); break;
+         case SaveGameFormat::CharacterField::EQUIPMENT: characterNode["Equipment"] = exportEquipment(readNested(record, wireType)); break;
+         case SaveGameFormat::CharacterField::PORTRAIT_PATH: characterNode[PORTRAIT_ELEMENT][PATH_ATTRIBUTE] = readString(record, wireType); break;
+         default: skipField(record, "character", tag, wireType);
+      }
+   }
+
+   return characterNode;
+}
+
+/**
+ * @return The JSON for a quest record (and its subquests).
+ */
+static Json::Value exportQuest(Record record)
+{
+   Json::Value questNode(Json::objectValue);
+   Json::Value subquestsNode(Json::arrayValue);
+
+   unsigned int tag;
+   int wireType;
+   while(nextField(record, tag, wireType))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::QuestField::NAME: questNode[NAME_ATTRIBUTE] = readString(record, wireType); break;
+         case SaveGameFormat::QuestField::DESCRIPTION: questNode[DESCRIPTION_ELEMENT] = readString(record, wireType); break;
+         case SaveGameFormat::QuestField::COMPLETED: questNode[COMPLETED_ATTRIBUTE] = readUnsigned(record, wireType) != 0; break;
+         case SaveGameFormat::QuestField::IS_OPTIONAL: questNode[OPTIONAL_ATTRIBUTE] = readUnsigned(record, wireType) != 0; break;
+         case SaveGameFormat::QuestField::SUBQUEST: subquestsNode.append(exportQuest(readNested(record, wireType))); break;
+         default: skipField(record, "quest", tag, wireType);
+      }
+   }
+
+   questNode[QUEST_ELEMENT] = subquestsNode;
+   return questNode;
+}
+
+/**
+ * Add the value of a flag record to the JSON for the flags.
+ *
+ * @param record The flag record.
+ * @param flagsNode The JSON object holding the value of each flag by name.
+ */
+static void exportFlag(Record record, Json::Value& flagsNode)
+{
+   std::string name;
+   Json::Value value;
+
+   unsigned int tag;
+   int wireType;
+   while(nextField(record, tag, wireType))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::FlagField::NAME: name = readString(record, wireType); break;
+         case SaveGameFormat::FlagField::BOOL_VALUE: value = readUnsigned(record, wireType) != 0; break;
+         case SaveGameFormat::FlagField::INT_VALUE: value = readInt(record, wireType); break;
+         case SaveGameFormat::FlagField::STRING_VALUE: value = readString(record, wireType); break;
+         default: skipField(record, "flag", tag, wireType);
+      }
+   }
+
+   if(!value.isNull())
+   {
+      flagsNode[name] = value;
+   }
+}
+
+/**
+ * @return The JSON for a random number streams record.
+ */
+static Json::Value exportRandomStreams(Record record)
+{
+   Json::Value randomNode(Json::objectValue);
+   Json::Value streamsNode(Json::objectValue);
+
+   unsigned int tag;
+   int wireType;
+   while(nextField(record, tag, wireType))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::RandomStreamsField::SEED:
+         {
+            randomNode[SEED_ATTRIBUTE] = Json::Value(static_cast<Json::UInt>(readUnsigned(record, wireType)));
+            break;
+         }
+         case SaveGameFormat::RandomStreamsField::STREAM:
+         {
+            Record streamRecord = readNested(record, wireType);
+            std::string streamName;
+            Json::Value stateNode(Json::arrayValue);
+
+            unsigned int streamTag;
+            int streamWireType;
+            while(nextField(streamRecord, streamTag, streamWireType))
+            {
+               switch(streamTag)
+               {
+                  case SaveGameFormat::RandomStreamField::NAME: streamName = readString(streamRecord, streamWireType); break;
+                  case SaveGameFormat::RandomStreamField::STATE: stateNode = readPacked(streamRecord, streamWireType); break;
+                  default: skipField(streamRecord, "random stream", streamTag, streamWireType);
+               }
+            }
+
+            streamsNode[streamName] = stateNode;
+            break;
+         }
+         default:
+         {
+            skipField(record, "random streams", tag, wireType);
+         }
+      }
+   }
+
+   randomNode[STREAMS_ELEMENT] = streamsNode;
+   return randomNode;
+}
+
+/**
+ * @return The JSON for the player data record.
+ */
+static Json::Value exportPlayerData(Record record)
+{
+   Json::Value playerDataNode(Json::objectValue);
+   Json::Value partyNode(Json::arrayValue);
+   Json::Value reserveNode(Json::arrayValue);
+   Json::Value inventoryNode(Json::arrayValue);
+   Json::Value flagsNode(Json::objectValue);
+
+   unsigned int tag;
+   int wireType;
+   while(nextField(record, tag, wireType))
+   {
+      switch(tag)
+      {
+         case SaveGameFormat::PlayerDataField::PARTY: partyNode.append(exportCharacter(readNested(record, wireType))); break;
+         case SaveGameFormat::PlayerDataField::RESERVE: reserveNode.append(exportCharacter(readNested(record, wireType))); break;
+         case SaveGameFormat::PlayerDataField::QUEST_LOG: playerDataNode[QUEST_ELEMENT] = exportQuest(readNested(record, wireType)); break;
+         case SaveGameFormat::PlayerDataField::RANDOM_STREAMS: playerDataNode[RANDOM_ELEMENT] = exportRandomStreams(readNested(record, wireType)); break;
+         case SaveGameFormat::PlayerDataField::INVENTORY:
+         {
+            const Json::Value itemsHeld = readPacked(record, wireType);
+            for(Json::ArrayIndex i = 0; i + 1 < itemsHeld.size(); i += 2)
+            {
+               Json::Value itemEntry(Json::objectValue);
+               itemEntry[ITEM_NUM_ATTRIBUTE] = itemsHeld[i].asInt();
+               itemEntry[ITEM_QUANTITY_ATTRIBUTE] = itemsHeld[i + 1].asInt();
+               inventoryNode.append(itemEntry);
+            }
+            break;
+         }
+         case SaveGameFormat::PlayerDataField::PLAY_TIME: playerDataNode[PLAY_TIME_ATTRIBUTE] = readUnsigned(record, wireType); break;
+
+         // The checkpoint number only ties the save game to its autosave log, which a JSON save game can't have
+         case SaveGameFormat::PlayerDataField::CHECKPOINT: readUnsigned(record, wireType); break;
+
+         case SaveGameFormat::PlayerDataField::FLAG: exportFlag(readNested(record, wireType), flagsNode); break;
+         default:
+         {
+            skipField(record, "player data", tag, wireType);
+         }
+      }
+   }
+
+   playerDataNode[CHARACTER_LIST_ELEMENT][PARTY_ELEMENT] = partyNode;
+   playerDataNode[CHARACTER_LIST_ELEMENT][RESERVE_ELEMENT] = reserveNode;
+   playerDataNode[INVENTORY_ELEMENT] = inventoryNode;
+   playerDataNode[FLAGS_ELEMENT] = flagsNode;
+   return playerDataNode;
+}
+
+int main(int argc, char* argv[])
+{
+   if(argc < 2)
+   {
+      fprintf(stderr, "Usage: %s <savegame.edd> [savegame.json]\n", argv[0]);
+      return 1;
+   }
+
+   std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+   if(!input)
+   {
+      fprintf(stderr, "Failed to open save game %s.\n", argv[1]);
+      return 1;
+   }
+
+   const std::string saveGame((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+   if(saveGame.size() < sizeof(SaveGameFormat::MAGIC) || memcmp(saveGame.data(), SaveGameFormat::MAGIC, sizeof(SaveGameFormat::MAGIC)) != 0)
+   {
+      fprintf(stderr, "%s is not a binary save game (it may already be a JSON one).\n", argv[1]);
+      return 1;
+   }
+
+   Record file = { saveGame.data() + sizeof(SaveGameFormat::MAGIC), saveGame.data() + saveGame.size() };
+   const Uint32 version = readVarint(file);
+   if(version > SaveGameFormat::VERSION)
+   {
+      fprintf(stderr, "%s was written with format version %u, but this exporter only reads version %u.\n", argv[1], version, SaveGameFormat::VERSION);
+      return 1;
+   }
+
+   if(version >= SaveGameFormat::SUMMARY_VERSION)
+   {
+      // Everything in the summary is also in the player data record, so the summary isn't exported
+      readNested(file, SaveGameFormat::LENGTH_DELIMITED);
+   }
+
+   const Uint32 stringCount = readVarint(file);
+   for(Uint32 i = 0; i < stringCount && !corrupt; ++i)
+   {
+      const Uint32 length = readVarint(file);
+      if(length > static_cast<std::size_t>(file.end - file.position))
+      {
+         corrupt = true;
+         break;
+      }
+
+      strings.push_back(std::string(file.position, length));
+      file.position += length;
+   }
+
+   const Json::Value playerDataNode = exportPlayerData(file);
+   if(corrupt)
+   {
+      fprintf(stderr, "%s is corrupt.\n", argv[1]);
+      return 1;
+   }
+
+   Json::StyledWriter writer;
+   const std::string json = writer.write(playerDataNode);
+
+   if(argc < 3)
+   {
+      fwrite(json.data(), 1, json.size(), stdout);
+      return 0;
+   }
+
+   std::ofstream output(argv[2]);
+   if(!output.write(json.data(), json.size()))
+   {
+      fprintf(stderr, "Failed to write %s.\n", argv[2]);
+      return 1;
+   }
+
+   fprintf(stderr, "Exported %s (%d strings) to %s\n", argv[1], static_cast<int>(strings.size()), argv[2]);
+   return 0;
+}
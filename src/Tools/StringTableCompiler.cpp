@@ -0,0 +1,276 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+/**
+ * The offline string table compiler. It turns the strings of a language (a JSON object from string IDs to strings)
+ * into a compiled string table (.eds), with the long lines of each string broken to fit the dialogue box
+ * in the game's default font, so that the engine never has to measure or wrap them.
+ * See StringTableFormat.h for the layout of the output.
+ *
+ * Usage: string_table_compiler <strings.json> <strings.eds> [font.ttf] [font size] [width]
+ *
+ * The font, font size and width default to the ones that the game's dialogue is drawn with.
+ * Scripts embedded in the strings (between '<' and '>') take up no room, and lines only break at spaces,
+ * so a single word too wide for a line is left to run over it.
+ */
+
+#include "BinaryOutput.h"
+#include "StringTableFormat.h"
+#include "json.h"
+#include "SDL_ttf.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// The same as GraphicsUtil's font
+static const char* const DEFAULT_FONT = "data/fonts/LDSRegular.ttf";
+static const int DEFAULT_FONT_SIZE = 16;
+
+// The width of DialogueController's dialogue box, less the pixel that TextBox indents its text by on each side
+static const int DEFAULT_WIDTH = 798;
+
+/** A string to compile, with its ID. */
+struct StringEntry
+{
+   std::string id;
+   std::string text;
+};
+
+/**
+ * Orders strings by the bytes of their IDs (as unsigned characters), the same way that the engine searches the table.
+ */
+static bool idLess(const StringEntry& lhs, const StringEntry& rhs)
+{
+   const int order = memcmp(lhs.id.data(), rhs.id.data(), std::min(lhs.id.length(), rhs.id.length()));
+   return order < 0 || (order == 0 && lhs.id.length() < rhs.id.length());
+}
+
+/**
+ * Measures part of a string as it is shown, without its embedded scripts.
+ *
+ * @param font The font to measure with.
+ * @param text The string.
+ * @param start The offset of the start of the part.
+ * @param end The offset of the end of the part.
+ *
+ * @return The width of the part (in pixels).
+ */
+static int measure(TTF_Font* font, const std::string& text, std::size_t start, std::size_t end)
+{
+   std::string shown;
+   for(std::size_t i = start; i < end; ++i)
+   {
+      if(text[i] == '<')
+      {
+         const std::size_t scriptEnd = text.find('>', i);
+         if(scriptEnd == std::string::npos) break;
+         i = scriptEnd;
+      }
+      else
+      {
+         shown += text[i];
+      }
+   }
+
+   int width = 0;
+   int height = 0;
+   if(!shown.empty())
+   {
+      TTF_SizeText(font, shown.c_str(), &width, &height);
+   }
+
+   return width;
+}
+
+/**
+ * Breaks a string into lines that fit a width, greedily, at the last space before each word that doesn't fit.
+ *
+ * @param font The font to measure with.
+ * @param width The width (in pixels) to fit the lines into.
+ * @param text The string.
+ * @param breaks The offsets of the spaces to break the string at are added to the back of this list, in order.
+ */
+static void breakLines(TTF_Font* font, int width, const std::string& text, std::vector<Uint32>& breaks)
+{
+   std::size_t lineStart = 0;
+   std::size_t lastSpace = std::string::npos;
+
+   for(std::size_t i = 0; i <= text.length(); ++i)
+   {
+      if(i < text.length() && text[i] == '<')
+      {
+         // Spaces inside scripts are part of the scripts' code, so they can't be broken at
+         const std::size_t scriptEnd = text.find('>', i);
+         if(scriptEnd == std::string::npos) break;
+         i = scriptEnd;
+         continue;
+      }
+
+      if(i < text.length() && text[i] != ' ' && text[i] != '\n')
+      {
+         continue;
+      }
+
+      // A word ends here, so it goes on the next line if it doesn't fit on this one
+      if(lastSpace != std::string::npos && measure(font, text, lineStart, i) > width)
+      {
+         breaks.push_back(lastSpace);
+         lineStart = lastSpace + 1;
+      }
+
+      if(i == text.length()) break;
+
+      if(text[i] == '\n')
+      {
+         lineStart = i + 1;
+         lastSpace = std::string::npos;
+      }
+      else
+      {
+         lastSpace = i;
+      }
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   if(argc < 3)
+   {
+      fprintf(stderr, "Usage: %s <strings.json> <strings.eds> [font.ttf] [font size] [width]\n", argv[0]);
+      return 1;
+   }
+
+   const char* const fontPath = argc > 3 ? argv[3] : DEFAULT_FONT;
+   const int fontSize = argc > 4 ? atoi(argv[4]) : DEFAULT_FONT_SIZE;
+   const int width = argc > 5 ? atoi(argv[5]) : DEFAULT_WIDTH;
+
+   std::ifstream input(argv[1]);
+   if(!input)
+   {
+      fprintf(stderr, "Failed to open strings %s.\n", argv[1]);
+      return 1;
+   }
+
+   Json::Value root;
+   try
+   {
+      input >> root;
+   }
+   catch(const std::exception& e)
+   {
+      fprintf(stderr, "Failed to parse strings %s: %s\n", argv[1], e.what());
+      return 1;
+   }
+
+   if(!root.isObject())
+   {
+      fprintf(stderr, "Strings %s must be an object from string IDs to strings.\n", argv[1]);
+      return 1;
+   }
+
+   std::vector<StringEntry> strings;
+   const Json::Value::Members ids = root.getMemberNames();
+   for(Json::Value::Members::const_iterator iter = ids.begin(); iter != ids.end(); ++iter)
+   {
+      const Json::Value& text = root[*iter];
+      if(!text.isString())
+      {
+         fprintf(stderr, "String %s in %s is not a string.\n", iter->c_str(), argv[1]);
+         return 1;
+      }
+
+      StringEntry entry;
+      entry.id = *iter;
+      entry.text = text.asString();
+      strings.push_back(entry);
+   }
+
+   std::sort(strings.begin(), strings.end(), idLess);
+
+   if(TTF_Init() == -1)
+   {
+      fprintf(stderr, "Failed to initialize SDL_ttf: %s\n", TTF_GetError());
+      return 1;
+   }
+
+   TTF_Font* font = TTF_OpenFont(fontPath, fontSize);
+   if(font == NULL)
+   {
+      fprintf(stderr, "Failed to open font %s: %s\n", fontPath, TTF_GetError());
+      TTF_Quit();
+      return 1;
+   }
+
+   std::vector<std::vector<Uint32> > stringBreaks(strings.size());
+   std::size_t breakCount = 0;
+   for(std::size_t i = 0; i < strings.size(); ++i)
+   {
+      breakLines(font, width, strings[i].text, stringBreaks[i]);
+      breakCount += stringBreaks[i].size();
+   }
+
+   TTF_CloseFont(font);
+   TTF_Quit();
+
+   std::vector<char> output(sizeof(StringTableFormat::Header), 0);
+   memcpy(&output[0], StringTableFormat::MAGIC, sizeof(StringTableFormat::MAGIC));
+   writeNumberAt(output, offsetof(StringTableFormat::Header, version), StringTableFormat::VERSION);
+   writeNumberAt(output, offsetof(StringTableFormat::Header, stringCount), strings.size());
+   writeNumberAt(output, offsetof(StringTableFormat::Header, layoutWidth), width);
+   writeNumberAt(output, offsetof(StringTableFormat::Header, layoutFontSize), fontSize);
+
+   // The IDs and strings go one after the other, each found by its entry
+   std::string characters;
+   writeNumberAt(output, offsetof(StringTableFormat::Header, entriesOffset), output.size());
+   std::size_t firstBreak = 0;
+   for(std::size_t i = 0; i < strings.size(); ++i)
+   {
+      writeNumber(output, characters.size());
+      writeNumber(output, strings[i].id.length());
+      characters += strings[i].id;
+
+      writeNumber(output, characters.size());
+      writeNumber(output, strings[i].text.length());
+      characters += strings[i].text;
+
+      writeNumber(output, firstBreak);
+      writeNumber(output, stringBreaks[i].size());
+      firstBreak += stringBreaks[i].size();
+   }
+
+   writeNumberAt(output, offsetof(StringTableFormat::Header, breakCount), breakCount);
+   writeNumberAt(output, offsetof(StringTableFormat::Header, breaksOffset), output.size());
+   for(std::size_t i = 0; i < strings.size(); ++i)
+   {
+      for(std::vector<Uint32>::const_iterator iter = stringBreaks[i].begin(); iter != stringBreaks[i].end(); ++iter)
+      {
+         writeNumber(output, *iter);
+      }
+   }
+
+   writeNumberAt(output, offsetof(StringTableFormat::Header, charactersOffset), output.size());
+   writeNumberAt(output, offsetof(StringTableFormat::Header, charactersSize), characters.size());
+   output.insert(output.end(), characters.begin(), characters.end());
+
+   writeNumberAt(output, offsetof(StringTableFormat::Header, fileSize), output.size());
+
+   std::ofstream table(argv[2], std::ios::out | std::ios::binary);
+   if(!table.write(&output[0], output.size()))
+   {
+      fprintf(stderr, "Failed to write string table %s.\n", argv[2]);
+      return 1;
+   }
+
+   printf("Compiled %d strings from %s (with %d line breaks) into %s (%d bytes)\n", static_cast<int>(strings.size()), argv[1],
+         static_cast<int>(breakCount), argv[2], static_cast<int>(output.size()));
+   return 0;
+}
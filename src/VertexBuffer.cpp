@@ -0,0 +1,123 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "VertexBuffer.h"
+#include "GLState.h"
+#include "GraphicsUtil.h"
+#include <SDL.h>
+#include "SDL_opengl.h"
+#include <cstring>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_GRAPHICS;
+
+bool VertexBuffer::functionsLoaded = false;
+bool VertexBuffer::buffersSupported = false;
+
+// The vertex buffer object functions aren't part of OpenGL 1.1, so they have to be looked up from the driver
+static PFNGLGENBUFFERSARBPROC genBuffers = NULL;
+static PFNGLBINDBUFFERARBPROC bindBuffer = NULL;
+static PFNGLBUFFERDATAARBPROC bufferData = NULL;
+static PFNGLDELETEBUFFERSARBPROC deleteBuffers = NULL;
+
+void VertexBuffer::loadFunctions()
+{
+   functionsLoaded = true;
+
+   const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+   if(extensions == NULL || strstr(extensions, "GL_ARB_vertex_buffer_object") == NULL)
+   {
+      DEBUG("Vertex buffer objects are not supported; vertices will be drawn from system memory.");
+      return;
+   }
+
+   genBuffers = reinterpret_cast<PFNGLGENBUFFERSARBPROC>(GraphicsUtil::getProcAddress("glGenBuffersARB"));
+   bindBuffer = reinterpret_cast<PFNGLBINDBUFFERARBPROC>(GraphicsUtil::getProcAddress("glBindBufferARB"));
+   bufferData = reinterpret_cast<PFNGLBUFFERDATAARBPROC>(GraphicsUtil::getProcAddress("glBufferDataARB"));
+   deleteBuffers = reinterpret_cast<PFNGLDELETEBUFFERSARBPROC>(GraphicsUtil::getProcAddress("glDeleteBuffersARB"));
+
+   buffersSupported = genBuffers != NULL && bindBuffer != NULL && bufferData != NULL && deleteBuffers != NULL;
+   DEBUG("Vertex buffer objects are %s", buffersSupported ? "supported" : "missing functions; vertices will be drawn from system memory.");
+}
+
+VertexBuffer::VertexBuffer(Usage usage, bool depth) : usage(usage), depth(depth), buffer(0), vertexCount(0)
+{
+}
+
+void VertexBuffer::setVertices(const std::vector<float>& vertices)
+{
+   if(!functionsLoaded)
+   {
+      loadFunctions();
+   }
+
+   vertexCount = vertices.size() / (depth ? FLOATS_PER_DEPTH_VERTEX : FLOATS_PER_VERTEX);
+
+   if(!buffersSupported)
+   {
+      clientVertices = vertices;
+      return;
+   }
+
+   if(buffer == 0)
+   {
+      genBuffers(1, &buffer);
+   }
+
+   bindBuffer(GL_ARRAY_BUFFER_ARB, buffer);
+   bufferData(GL_ARRAY_BUFFER_ARB, vertices.size() * sizeof(float), vertices.empty() ? NULL : &vertices[0],
+         usage == STATIC ? GL_STATIC_DRAW_ARB : GL_STREAM_DRAW_ARB);
+   bindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+int VertexBuffer::getVertexCount() const
+{
+   return vertexCount;
+}
+
+void VertexBuffer::drawQuads() const
+{
+   drawQuads(0, vertexCount);
+}
+
+void VertexBuffer::drawQuads(int firstVertex, int count) const
+{
+   if(count <= 0) return;
+
+   const int positionSize = depth ? 3 : 2;
+   const GLsizei stride = (positionSize + 2) * sizeof(float);
+   const float* vertices = NULL;
+   if(buffer != 0)
+   {
+      // With a buffer bound, the vertex pointers are offsets into the buffer
+      bindBuffer(GL_ARRAY_BUFFER_ARB, buffer);
+   }
+   else
+   {
+      vertices = &clientVertices[0];
+   }
+
+   // The arrays are left enabled between draws, since nothing else draws from them
+   GLState::setVertexArrays(true);
+   glVertexPointer(positionSize, GL_FLOAT, stride, vertices);
+   glTexCoordPointer(2, GL_FLOAT, stride, vertices + positionSize);
+
+   GLState::countDrawCall();
+   glDrawArrays(GL_QUADS, firstVertex, count);
+
+   if(buffer != 0)
+   {
+      bindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+   }
+}
+
+VertexBuffer::~VertexBuffer()
+{
+   if(buffer != 0)
+   {
+      deleteBuffers(1, &buffer);
+   }
+}
@@ -0,0 +1,114 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef VERTEX_BUFFER_H
+#define VERTEX_BUFFER_H
+
+#include <vector>
+
+typedef unsigned int GLuint;
+
+/**
+ * A list of textured 2D vertices (x, y, u, v) that can be drawn with a single draw call.
+ * A buffer can also hold vertices with a depth (x, y, z, u, v), for drawing against the depth buffer.
+ * Where the OpenGL driver supports vertex buffer objects, the vertices are kept in video memory;
+ * otherwise, they are kept in system memory and drawn as a client-side vertex array.
+ *
+ * Vertex buffers may only be used while the OpenGL context is current.
+ */
+class VertexBuffer
+{
+   public:
+      /** The number of floats in each vertex (x, y, u and v). */
+      static const int FLOATS_PER_VERTEX = 4;
+
+      /** The number of floats in each vertex of a buffer with depths (x, y, z, u and v). */
+      static const int FLOATS_PER_DEPTH_VERTEX = 5;
+
+      /** How often the vertices of a buffer are expected to change. */
+      enum Usage
+      {
+         /** The vertices are set once and drawn many times. */
+         STATIC,
+
+         /** The vertices are set again about as often as they are drawn. */
+         DYNAMIC
+      };
+
+   private:
+      /** Whether or not the vertex buffer object functions have been looked up. */
+      static bool functionsLoaded;
+
+      /** Whether or not the driver supports vertex buffer objects. */
+      static bool buffersSupported;
+
+      /**
+       * Looks up the vertex buffer object functions, if the driver supports them.
+       */
+      static void loadFunctions();
+
+      /** How often the vertices are expected to change. */
+      Usage usage;
+
+      /** Whether or not each vertex has a depth. */
+      bool depth;
+
+      /** The vertex buffer object, or 0 if one hasn't been created. */
+      GLuint buffer;
+
+      /** The vertices, when they are drawn as a client-side vertex array. */
+      std::vector<float> clientVertices;
+
+      /** The number of vertices in the buffer. */
+      int vertexCount;
+
+      /** Vertex buffers can't be copied. */
+      VertexBuffer(const VertexBuffer&);
+
+      /** Vertex buffers can't be copied. */
+      VertexBuffer& operator=(const VertexBuffer&);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param usage How often the vertices are expected to change.
+       * @param depth true iff each vertex has a depth (with FLOATS_PER_DEPTH_VERTEX floats for each vertex).
+       */
+      VertexBuffer(Usage usage = STATIC, bool depth = false);
+
+      /**
+       * Replaces the vertices in the buffer.
+       *
+       * @param vertices The new vertices, with FLOATS_PER_VERTEX floats for each vertex (or FLOATS_PER_DEPTH_VERTEX, if they have depths).
+       */
+      void setVertices(const std::vector<float>& vertices);
+
+      /**
+       * @return The number of vertices in the buffer.
+       */
+      int getVertexCount() const;
+
+      /**
+       * Draws the vertices in the buffer as quads, using the currently bound texture.
+       */
+      void drawQuads() const;
+
+      /**
+       * Draws a range of the vertices in the buffer as quads, using the currently bound texture.
+       *
+       * @param firstVertex The index of the first vertex to draw.
+       * @param count The number of vertices to draw.
+       */
+      void drawQuads(int firstVertex, int count) const;
+
+      /**
+       * Destructor.
+       */
+      ~VertexBuffer();
+};
+
+#endif
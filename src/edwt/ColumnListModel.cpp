@@ -0,0 +1,27 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ColumnListModel.h"
+
+namespace edwt
+{
+   std::string ColumnListModel::getElementAt(int i)
+   {
+      std::string text;
+      const unsigned int numColumns = getNumberOfColumnsAt(i);
+      for(unsigned int column = 0; column < numColumns; ++column)
+      {
+         if(column > 0)
+         {
+            text += '\t';
+         }
+
+         text += getColumnAt(i, column);
+      }
+
+      return text;
+   }
+};
@@ -0,0 +1,56 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef COLUMN_LIST_MODEL_H
+#define COLUMN_LIST_MODEL_H
+
+#include "guichan.hpp"
+#include <string>
+
+namespace edwt
+{
+   /**
+    * A list model that keeps each element's text already split into the columns that a ListBox shows,
+    * and counts the changes made to its elements.
+    * A ListBox showing one of these reads the columns without copying them, and only lays its rows out again
+    * when the model's revision changes, instead of fetching and splitting every element's text on every frame.
+    *
+    * getElementAt still gives the whole text of an element, with its columns separated by tab characters,
+    * for anything that uses the model as a plain gcn::ListModel.
+    */
+   class ColumnListModel : public gcn::ListModel
+   {
+      public:
+         /**
+          * @param i The index of a list item.
+          *
+          * @return The number of columns that the item's text has.
+          */
+         virtual unsigned int getNumberOfColumnsAt(int i) = 0;
+
+         /**
+          * @param i The index of a list item.
+          * @param column The index of one of the item's columns.
+          *
+          * @return The text of the column, which stays valid until the model is changed.
+          */
+         virtual const std::string& getColumnAt(int i, unsigned int column) = 0;
+
+         /**
+          * @return A number that changes whenever any of the model's elements are changed, added or removed.
+          */
+         virtual unsigned int getRevision() const = 0;
+
+         /**
+          * @param i The index of a list item.
+          *
+          * @return The text of the list item, with its columns separated by tab characters.
+          */
+         std::string getElementAt(int i);
+   };
+};
+
+#endif
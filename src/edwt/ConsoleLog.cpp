@@ -0,0 +1,199 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "ConsoleLog.h"
+#include "Atomics.h"
+#include <SDL_thread.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EDWT;
+
+// Enough history to look back over a script's output, without holding on to all of it for the whole game
+static const std::vector<std::string>::size_type MAX_LINES = 1000;
+
+// The number of lines in the queue, which must be a power of two.
+// Room for a burst of output from the worker threads between the log's logic steps
+static const unsigned long QUEUE_SIZE = 1 << 8;
+
+// Enough for any line of output; longer lines from other threads are cut short
+static const size_t MAX_QUEUED_LINE_LENGTH = 256;
+
+namespace edwt
+{
+   struct ConsoleLog::QueuedLine
+   {
+      /**
+       * The position in the queue that the line can be claimed at, or that position plus one once the text in it
+       * is ready to be moved into the log. Moving the text into the log frees the line for the position a lap of the queue later.
+       */
+      volatile unsigned long sequence;
+
+      /** The text of the line. */
+      char text[MAX_QUEUED_LINE_LENGTH];
+   };
+};
+
+namespace edwt
+{
+   ConsoleLog::ConsoleLog() : oldestLine(0), queueWritePosition(0), queueReadPosition(0), droppedCount(0), reportedDroppedCount(0)
+   {
+      mainThread = SDL_ThreadID();
+
+      queue = new QueuedLine[QUEUE_SIZE];
+      for(unsigned long i = 0; i < QUEUE_SIZE; ++i)
+      {
+         queue[i].sequence = i;
+      }
+
+      setHeight(0);
+   }
+
+   const std::string& ConsoleLog::getLine(std::vector<std::string>::size_type index) const
+   {
+      return lines[(oldestLine + index) % lines.size()];
+   }
+
+   void ConsoleLog::appendLine(const std::string& line)
+   {
+      if(lines.size() < MAX_LINES)
+      {
+         lines.push_back(line);
+      }
+      else
+      {
+         // The newest line takes the place of the oldest one, so nothing else in the ring moves
+         lines[oldestLine] = line;
+         oldestLine = (oldestLine + 1) % lines.size();
+      }
+
+      if(getFont()->getWidth(line) > getWidth())
+      {
+         setWidth(getFont()->getWidth(line));
+      }
+   }
+
+   bool ConsoleLog::drainQueue()
+   {
+      bool added = false;
+      for(;;)
+      {
+         QueuedLine& queuedLine = queue[queueReadPosition & (QUEUE_SIZE - 1)];
+         if(queuedLine.sequence != queueReadPosition + 1) break;
+
+         Atomics::memoryBarrier();
+         appendLine(queuedLine.text);
+         Atomics::memoryBarrier();
+
+         queuedLine.sequence = queueReadPosition + QUEUE_SIZE;
+         ++queueReadPosition;
+         added = true;
+      }
+
+      const unsigned long dropped = droppedCount;
+      if(dropped != reportedDroppedCount)
+      {
+         std::ostringstream message;
+         message << (dropped - reportedDroppedCount) << " lines were dropped because the console couldn't keep up.";
+         appendLine(message.str());
+         reportedDroppedCount = dropped;
+         added = true;
+      }
+
+      return added;
+   }
+
+   void ConsoleLog::linesAdded()
+   {
+      const int rowHeight = getFont()->getHeight();
+      setHeight(rowHeight * lines.size());
+      showPart(gcn::Rectangle(0, getHeight() - rowHeight, 1, rowHeight));
+   }
+
+   void ConsoleLog::addLine(const std::string& line)
+   {
+      if(SDL_ThreadID() == mainThread)
+      {
+         // Lines queued from other threads came first, so they go in ahead of this one
+         drainQueue();
+         appendLine(line);
+         linesAdded();
+         return;
+      }
+
+      unsigned long position = queueWritePosition;
+      for(;;)
+      {
+         QueuedLine& queuedLine = queue[position & (QUEUE_SIZE - 1)];
+         const long lap = static_cast<long>(queuedLine.sequence - position);
+         if(lap == 0)
+         {
+            if(Atomics::compareAndSwap(&queueWritePosition, position, position + 1))
+            {
+               strncpy(queuedLine.text, line.c_str(), MAX_QUEUED_LINE_LENGTH);
+               queuedLine.text[MAX_QUEUED_LINE_LENGTH - 1] = '\0';
+
+               // The text has to be in the line before the main thread can see that it is ready
+               Atomics::memoryBarrier();
+               queuedLine.sequence = position + 1;
+               return;
+            }
+         }
+         else if(lap < 0)
+         {
+            // The line still holds the text from a lap ago, which hasn't been moved into the log yet
+            Atomics::increment(&droppedCount);
+            return;
+         }
+
+         position = queueWritePosition;
+      }
+   }
+
+   void ConsoleLog::logic()
+   {
+      if(drainQueue())
+      {
+         linesAdded();
+      }
+   }
+
+   void ConsoleLog::draw(gcn::Graphics* graphics)
+   {
+      if(lines.empty()) return;
+
+      graphics->setColor(getForegroundColor());
+      graphics->setFont(getFont());
+
+      // The history is mostly scrolled out of view, so only the lines that overlap the clip area are drawn
+      const int rowHeight = getFont()->getHeight();
+      const gcn::ClipRectangle& clipArea = graphics->getCurrentClipArea();
+      const int clipTop = clipArea.y - clipArea.yOffset;
+      const int clipBottom = clipTop + clipArea.height;
+      const int firstLine = std::max(0, clipTop / rowHeight);
+      const int lastLine = std::min(static_cast<int>(lines.size()), clipBottom / rowHeight + 1);
+
+      for(int i = firstLine; i < lastLine; ++i)
+      {
+         graphics->drawText(getLine(i), 1, i * rowHeight);
+      }
+   }
+
+   void ConsoleLog::fontChanged()
+   {
+      if(!lines.empty())
+      {
+         linesAdded();
+      }
+   }
+
+   ConsoleLog::~ConsoleLog()
+   {
+      delete [] queue;
+   }
+};
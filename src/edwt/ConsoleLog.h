@@ -0,0 +1,129 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef CONSOLE_LOG_H
+#define CONSOLE_LOG_H
+
+#include "guichan.hpp"
+#include <string>
+#include <vector>
+
+namespace edwt
+{
+   /**
+    * A scrolling log of lines of text, such as the commands and output of the debug console.
+    *
+    * The log keeps a fixed number of the latest lines in a ring, dropping the oldest line as each new one comes in,
+    * and only draws the lines that are in view, so adding to a long history (or drawing it) costs no more than
+    * adding to a short one.
+    *
+    * Lines can be added from any thread. Lines added from other threads are copied into a queue without taking a lock,
+    * and are moved into the log the next time the log's logic runs on the main thread.
+    * If the queue fills up faster than that, the lines that don't fit are dropped and counted.
+    */
+   class ConsoleLog : public gcn::Widget
+   {
+      /** A line waiting in the queue for the main thread. */
+      struct QueuedLine;
+
+      /** The lines in the log, which are stored as a ring once the log is full. */
+      std::vector<std::string> lines;
+
+      /** The index in the ring of the oldest line. */
+      std::vector<std::string>::size_type oldestLine;
+
+      /** The queue of lines added from other threads. */
+      QueuedLine* queue;
+
+      /** The position in the queue that the next line will be claimed at. */
+      volatile unsigned long queueWritePosition;
+
+      /** The position in the queue of the next line to move into the log (only touched by the main thread). */
+      unsigned long queueReadPosition;
+
+      /** The number of lines that have been dropped because the queue was full. */
+      volatile unsigned long droppedCount;
+
+      /** The number of dropped lines that have been reported in the log. */
+      unsigned long reportedDroppedCount;
+
+      /** The ID of the thread that the log was created on (the main thread). */
+      unsigned long mainThread;
+
+      /**
+       * Adds a line to the ring, dropping the oldest line if the ring is full.
+       * Only the main thread does this.
+       *
+       * @param line The line to add.
+       */
+      void appendLine(const std::string& line);
+
+      /**
+       * Moves the lines waiting in the queue into the log, and reports any that were dropped.
+       * Only the main thread does this.
+       *
+       * @return true iff any lines were added to the log.
+       */
+      bool drainQueue();
+
+      /**
+       * Resizes the log to fit its lines, and scrolls to the newest line.
+       */
+      void linesAdded();
+
+      /**
+       * @param index The index of a line, counting from the oldest line in the log.
+       *
+       * @return The line.
+       */
+      const std::string& getLine(std::vector<std::string>::size_type index) const;
+
+      /** Console logs can't be copied. */
+      ConsoleLog(const ConsoleLog&);
+
+      /** Console logs can't be copied. */
+      ConsoleLog& operator=(const ConsoleLog&);
+
+      public:
+         /**
+          * Constructor. Must be called on the main thread.
+          */
+         ConsoleLog();
+
+         /**
+          * Adds a line to the end of the log. Safe to call from any thread.
+          * Lines added on the main thread show up right away; lines added
+          * from other threads show up the next time the log's logic runs.
+          *
+          * @param line The line to add.
+          */
+         void addLine(const std::string& line);
+
+         /**
+          * Moves any lines added from other threads into the log.
+          */
+         virtual void logic();
+
+         /**
+          * Draws the lines of the log that are in view.
+          *
+          * @param graphics The graphics object to draw with.
+          */
+         virtual void draw(gcn::Graphics* graphics);
+
+         /**
+          * Resizes the log to fit its lines in the new font.
+          */
+         virtual void fontChanged();
+
+         /**
+          * Destructor.
+          */
+         ~ConsoleLog();
+   };
+};
+
+#endif
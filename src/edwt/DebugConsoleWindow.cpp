@@ -5,8 +5,8 @@
  */
 
 #include "DebugConsoleWindow.h"
-#include <SDL.h>
-#include "TextBox.h"
+#include "ConsoleLog.h"
+#include "EventBus.h"
 #include "TextField.h"
 #include <string>
 
@@ -29,17 +29,14 @@ namespace edwt
 
       int consoleLogHeight = height - (consoleInput->getHeight() + getTitleBarHeight());
 
-      consoleLog = new TextBox();
-      consoleLog->setOpaque(false);
-      consoleLog->setEditable(false);
-      consoleLog->setFocusable(false);
+      consoleLog = new ConsoleLog();
 
       consoleLogScroll = new gcn::ScrollArea(consoleLog);
       consoleLogScroll->setSize(width, consoleLogHeight);
       consoleLogScroll->setVerticalScrollPolicy(gcn::ScrollArea::SHOW_ALWAYS);
 
       int consoleLogWidth = width - (consoleLogScroll->getScrollbarWidth() + getPadding());
-      consoleLog->setSize(consoleLogWidth, consoleLogHeight);
+      consoleLog->setWidth(consoleLogWidth);
 
       add(consoleLogScroll, 0, 0);
       add(consoleInput, 0, consoleLogHeight);
@@ -57,25 +54,22 @@ namespace edwt
    {
       if(keyEvent.getKey() == gcn::Key::ENTER)
       {
-         const std::string& text = consoleInput->getText();
+         // The line is copied, since clearing the text field clears the field's own copy
+         const std::string text = consoleInput->getText();
          if(text.length() > 0)
          {
             consoleInput->setText("");
-            consoleLog->addRow(text);
-
-            SDL_Event event;
-            event.type = SDL_USEREVENT;
-            event.user.code = DEBUG_CONSOLE_EVENT;
-
-            // Create a copy of the string that was entered into the debug console and embed it in the SDL event
-            event.user.data1 = new std::string(text);
-
-            event.user.data2 = 0;
-            SDL_PushEvent(&event);
+            consoleLog->addLine(text);
+            EventBus::post(EventBus::DEBUG_COMMAND, 0, text.c_str());
          }
       }
    }
 
+   void DebugConsoleWindow::addLine(const std::string& line)
+   {
+      consoleLog->addLine(line);
+   }
+
    DebugConsoleWindow::~DebugConsoleWindow()
    {
       delete consoleLog;
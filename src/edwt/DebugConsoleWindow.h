@@ -9,15 +9,14 @@
 
 #include "guichan.hpp"
 
-const int DEBUG_CONSOLE_EVENT = 10;
-
 namespace edwt
 {
-   class TextBox;
+   class ConsoleLog;
    class TextField;
 
    /**
     * A window in which debug commands can be written and interpreted.
+    * Each line entered is posted to the main loop as an EventBus::DEBUG_COMMAND event.
     *
     * @author Noam Chitayat
     */
@@ -27,7 +26,7 @@ namespace edwt
       gcn::ScrollArea* consoleLogScroll;
       
       /** The text log of commands and output. */
-      TextBox* consoleLog;
+      ConsoleLog* consoleLog;
       
       /** The input field where a user can enter debug commands. */
       TextField* consoleInput;
@@ -53,6 +52,13 @@ namespace edwt
           * @param keyEvent The keyboard GUI event to consume.
           */
          void keyPressed(gcn::KeyEvent& keyEvent);
+
+         /**
+          * Adds a line of output to the console log. Safe to call from any thread.
+          *
+          * @param line The line to add.
+          */
+         void addLine(const std::string& line);
       
          /**
           * Destructor.
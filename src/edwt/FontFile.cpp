@@ -0,0 +1,50 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "FontFile.h"
+#include "AssetArchive.h"
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_RES_LOAD | DEBUG_EDWT;
+
+FontFile::FontFile(ResourceKey name) : Resource(name), data(NULL), dataSize(0)
+{
+}
+
+void FontFile::load(const char* path)
+{
+   DEBUG("Loading font file %s", path);
+
+   // Files in the mounted archive stay mapped until it is unmounted, so they are used where they are instead of copied
+   if(AssetArchive::find(path, data, dataSize))
+   {
+      return;
+   }
+
+   if(!AssetArchive::read(path, contents) || contents.empty())
+   {
+      T_T("Failed to load font file.");
+   }
+
+   data = &contents[0];
+   dataSize = contents.size();
+}
+
+const char* FontFile::getData() const
+{
+   return data;
+}
+
+size_t FontFile::getDataSize() const
+{
+   return dataSize;
+}
+
+size_t FontFile::getSize()
+{
+   return sizeof(*this) + contents.capacity();
+}
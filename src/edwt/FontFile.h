@@ -0,0 +1,65 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef FONT_FILE_H
+#define FONT_FILE_H
+
+#include "Resource.h"
+#include <vector>
+
+/**
+ * The contents of a True Type font file, read once and shared by every font opened from it (see edwt::OpenGLTrueTypeFont).
+ * Each size of a font used to open and read its own copy of the file; with the file cached by the ResourceLoader,
+ * the menu's title and action fonts read the same bytes, and reopening the menu doesn't read the file again.
+ *
+ * Font files are named by their paths (such as "data/fonts/LDSRegular.ttf").
+ * Open fonts keep reading glyphs from the contents of the file, so fonts hold their file for as long as they are open.
+ */
+class FontFile : public Resource
+{
+   /** The contents of the file, when it was read from a loose file. */
+   std::vector<char> contents;
+
+   /** The contents of the file (in the mounted archive, or in the contents buffer), or NULL if the file hasn't loaded. */
+   const char* data;
+
+   /** The size of the file (in bytes). */
+   size_t dataSize;
+
+   /**
+    * Reads the file, or finds it in the mounted archive.
+    *
+    * @param path The path to the font file.
+    */
+   void load(const char* path);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param name The path to the font file.
+       */
+      FontFile(ResourceKey name);
+
+      /**
+       * @return The contents of the file, or NULL if the file failed to load.
+       */
+      const char* getData() const;
+
+      /**
+       * @return The size of the file (in bytes).
+       */
+      size_t getDataSize() const;
+
+      /**
+       * Implementation of method in Resource class.
+       *
+       * @return The size of the font file resource in memory.
+       */
+      size_t getSize();
+};
+
+#endif
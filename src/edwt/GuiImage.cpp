@@ -0,0 +1,229 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "GuiImage.h"
+#include "guichan.hpp"
+#include "guichan/opengl.hpp"
+#include "GLState.h"
+#include "ImageVariantFormat.h"
+#include "MappedFile.h"
+#include "ResourceLoader.h"
+#include "SDL_opengl.h"
+#include <zlib.h>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "DebugUtils.h"
+
+const int debugFlag = DEBUG_RES_LOAD | DEBUG_EDWT;
+
+/**
+ * Reads the header and the list of variants of an image variant file, checking that they fit in the file.
+ *
+ * @param file The image variant file.
+ * @param header The header of the file.
+ *
+ * @return The variants in the file, or NULL if the file isn't an image variant file for this version of the engine.
+ */
+static const ImageVariantFormat::Variant* readVariants(const MappedFile& file, ImageVariantFormat::Header& header)
+{
+   const std::size_t fileSize = file.getSize();
+   if(fileSize < sizeof(header))
+   {
+      return NULL;
+   }
+
+   memcpy(&header, file.getData(), sizeof(header));
+   const std::size_t variantCount = SDL_SwapLE32(header.variantCount);
+   const std::size_t variantsOffset = SDL_SwapLE32(header.variantsOffset);
+   if(memcmp(header.magic, ImageVariantFormat::MAGIC, sizeof(header.magic)) != 0 || SDL_SwapLE32(header.version) != ImageVariantFormat::VERSION
+         || SDL_SwapLE32(header.fileSize) != fileSize || variantsOffset % sizeof(Uint32) != 0
+         || variantsOffset + variantCount * sizeof(ImageVariantFormat::Variant) > fileSize)
+   {
+      return NULL;
+   }
+
+   return reinterpret_cast<const ImageVariantFormat::Variant*>(file.getData() + variantsOffset);
+}
+
+GuiImage::GuiImage(ResourceKey name) : Resource(name), image(NULL), preparedWidth(0), preparedHeight(0)
+{
+}
+
+int GuiImage::splitName(const std::string& name, std::string& sourcePath)
+{
+   const std::string::size_type separator = name.find_last_of(VARIANT_SEPARATOR);
+   if(separator == std::string::npos)
+   {
+      sourcePath = name;
+      return 0;
+   }
+
+   sourcePath = name.substr(0, separator);
+   return atoi(name.c_str() + separator + 1);
+}
+
+std::string GuiImage::getVariantName(const std::string& path, int width, int height)
+{
+   std::string bakedPath;
+   if(!ResourceLoader::findBakedAsset(path, bakedPath))
+   {
+      return path;
+   }
+
+   MappedFile file;
+   try
+   {
+      file.openAsset(bakedPath);
+   }
+   catch(const Exception&)
+   {
+      return path;
+   }
+
+   ImageVariantFormat::Header header;
+   const ImageVariantFormat::Variant* variants = readVariants(file, header);
+   if(variants == NULL)
+   {
+      DEBUG("File %s is not an image variant file for this version of the engine, and must be recompiled.", bakedPath.c_str());
+      return path;
+   }
+
+   // The variants get smaller as they go, so the last one that covers the size is the smallest that does
+   int chosenVariant = 0;
+   const int variantCount = static_cast<int>(SDL_SwapLE32(header.variantCount));
+   for(int i = 0; i < variantCount; ++i)
+   {
+      if(static_cast<int>(SDL_SwapLE32(variants[i].width)) < width || static_cast<int>(SDL_SwapLE32(variants[i].height)) < height) break;
+      chosenVariant = i + 1;
+   }
+
+   if(chosenVariant == 0)
+   {
+      return path;
+   }
+
+   std::ostringstream name;
+   name << path << VARIANT_SEPARATOR << chosenVariant;
+   return name.str();
+}
+
+bool GuiImage::readVariant(const std::string& sourcePath, int variant, std::vector<unsigned int>& pixels, int& width, int& height)
+{
+   std::string bakedPath;
+   if(!ResourceLoader::findBakedAsset(sourcePath, bakedPath))
+   {
+      return false;
+   }
+
+   MappedFile file;
+   try
+   {
+      file.openAsset(bakedPath);
+   }
+   catch(const Exception&)
+   {
+      return false;
+   }
+
+   ImageVariantFormat::Header header;
+   const ImageVariantFormat::Variant* variants = readVariants(file, header);
+   if(variants == NULL || variant < 1 || variant > static_cast<int>(SDL_SwapLE32(header.variantCount)))
+   {
+      return false;
+   }
+
+   const ImageVariantFormat::Variant& record = variants[variant - 1];
+   const std::size_t pixelsOffset = SDL_SwapLE32(record.pixelsOffset);
+   const std::size_t pixelsSize = SDL_SwapLE32(record.pixelsSize);
+   if(pixelsOffset > file.getSize() || pixelsSize > file.getSize() - pixelsOffset)
+   {
+      return false;
+   }
+
+   width = SDL_SwapLE32(record.width);
+   height = SDL_SwapLE32(record.height);
+   pixels.resize(width * height);
+
+   uLongf pixelBytes = pixels.size() * sizeof(unsigned int);
+   const int result = uncompress(reinterpret_cast<Bytef*>(&pixels[0]), &pixelBytes, reinterpret_cast<const Bytef*>(file.getData() + pixelsOffset), pixelsSize);
+   if(result != Z_OK || pixelBytes != pixels.size() * sizeof(unsigned int))
+   {
+      pixels.clear();
+      return false;
+   }
+
+   return true;
+}
+
+void GuiImage::prepare(const char* path)
+{
+   std::string sourcePath;
+   const int variant = splitName(path, sourcePath);
+   if(variant > 0 && !readVariant(sourcePath, variant, preparedPixels, preparedWidth, preparedHeight))
+   {
+      // Loading the image will try the variant again on its own
+      preparedPixels.clear();
+   }
+}
+
+void GuiImage::load(const char* path)
+{
+   std::string sourcePath;
+   const int variant = splitName(path, sourcePath);
+   if(variant > 0)
+   {
+      if(preparedPixels.empty() && !readVariant(sourcePath, variant, preparedPixels, preparedWidth, preparedHeight))
+      {
+         DEBUG("Variant %d of GUI image %s couldn't be read, so the image is loaded at its full size.", variant, sourcePath.c_str());
+      }
+   }
+
+   if(!preparedPixels.empty())
+   {
+      DEBUG("Loading GUI image %s from its %dx%d variant", sourcePath.c_str(), preparedWidth, preparedHeight);
+      gcn::OpenGLImage* variantImage = new gcn::OpenGLImage(&preparedPixels[0], preparedWidth, preparedHeight);
+      std::vector<unsigned int>().swap(preparedPixels);
+
+      // Variants are drawn stretched over the size that their image is shown at, so they are filtered as they are stretched
+      GLState::bindTexture(variantImage->getTextureHandle());
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+      image = variantImage;
+      return;
+   }
+
+   DEBUG("Loading GUI image %s", sourcePath.c_str());
+
+   try
+   {
+      image = gcn::Image::load(sourcePath);
+   }
+   catch(gcn::Exception& e)
+   {
+      // The resource loader only knows how to recover from the engine's own exceptions
+      DEBUG("%s", e.getMessage().c_str());
+      T_T("Failed to load GUI image.");
+   }
+}
+
+const gcn::Image* GuiImage::getImage() const
+{
+   return image;
+}
+
+size_t GuiImage::getSize()
+{
+   // The image is kept as a 32-bit texture
+   return sizeof(*this) + (image == NULL ? 0 : image->getWidth() * image->getHeight() * 4);
+}
+
+GuiImage::~GuiImage()
+{
+   delete image;
+}
@@ -0,0 +1,123 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef GUI_IMAGE_H
+#define GUI_IMAGE_H
+
+#include "Resource.h"
+#include <string>
+#include <vector>
+
+namespace gcn
+{
+   class Image;
+};
+
+/**
+ * An image shown by the GUI (such as a menu background or a character portrait), loaded through Guichan's image loader.
+ * GUI images are cached by the ResourceLoader like any other resource, so a menu that is opened again
+ * shows the textures that were uploaded the last time, instead of decoding its images afresh.
+ *
+ * GUI images are named by their paths (such as "data/images/menubg.jpg"), which is how widgets and save games refer to them.
+ * Widgets that show a GUI image (see edwt::Icon) hold it for as long as they show it.
+ *
+ * An image that the asset baker has made downscaled variants of (see ImageVariantFormat.h) can also be loaded
+ * from one of its variants, for a widget that shows it smaller than its source (see getVariantName).
+ * A variant is named by its image's path followed by '#' and its number (as in "data/images/splash.jpg#1" for the variant at half size),
+ * and its pixels are read and decompressed in the background, so only the upload is left for the main thread.
+ */
+class GuiImage : public Resource
+{
+   /** The character that separates an image's path from the number of one of its variants. */
+   static const char VARIANT_SEPARATOR = '#';
+
+   /** The loaded image, or NULL if the image hasn't loaded. */
+   gcn::Image* image;
+
+   /** The pixels of the image's variant, if they were read ahead of time by prepare(). */
+   std::vector<unsigned int> preparedPixels;
+
+   /** The size of the variant in preparedPixels. */
+   int preparedWidth, preparedHeight;
+
+   /**
+    * Splits the name of a GUI image into the path of its image and the number of its variant.
+    *
+    * @param name The name of the GUI image.
+    * @param sourcePath The string to put the path of the image in.
+    *
+    * @return The number of the variant (counting from 1 for the variant at half size), or 0 if the name is of the image itself.
+    */
+   static int splitName(const std::string& name, std::string& sourcePath);
+
+   /**
+    * Reads and decompresses the pixels of one of an image's baked variants.
+    *
+    * @param sourcePath The path of the image.
+    * @param variant The number of the variant.
+    * @param pixels The pixels of the variant.
+    * @param width The width of the variant.
+    * @param height The height of the variant.
+    *
+    * @return true iff the variant was read.
+    */
+   static bool readVariant(const std::string& sourcePath, int variant, std::vector<unsigned int>& pixels, int& width, int& height);
+
+   /**
+    * Loads the image and uploads it as an OpenGL texture.
+    *
+    * @param path The path to the image.
+    */
+   void load(const char* path);
+
+   public:
+      /**
+       * Constructor.
+       *
+       * @param name The path to the image, or the name of one of its variants.
+       */
+      GuiImage(ResourceKey name);
+
+      /**
+       * Finds the smallest of an image's baked variants that is still at least as large as the size it is shown at,
+       * so that no more of the image is loaded than can be seen.
+       *
+       * @param path The path to the image.
+       * @param width The width that the image is shown at.
+       * @param height The height that the image is shown at.
+       *
+       * @return The name of the variant to load, or the path to the image itself if it has no variant that large
+       *         (or hasn't been baked into variants at all).
+       */
+      static std::string getVariantName(const std::string& path, int width, int height);
+
+      /**
+       * Implementation of method in Resource class.
+       * Reads and decompresses the pixels of the image's variant, so that loading it only has to upload them.
+       *
+       * @param path The name of the image's variant.
+       */
+      void prepare(const char* path);
+
+      /**
+       * @return The loaded image, or NULL if the image failed to load.
+       */
+      const gcn::Image* getImage() const;
+
+      /**
+       * Implementation of method in Resource class.
+       *
+       * @return The size of the image resource in memory, including its texture.
+       */
+      size_t getSize();
+
+      /**
+       * Destructor.
+       */
+      ~GuiImage();
+};
+
+#endif
@@ -5,32 +5,88 @@
  */
 
 #include "Icon.h"
+#include "GuiImage.h"
+#include "OpenGLGraphics.h"
+#include "ResourceLoader.h"
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_EDWT;
 
 namespace edwt
 {
-   Icon::Icon() : gcn::Icon()
+   Icon::Icon() : gcn::Icon(), guiImage(NULL), displayWidth(0), displayHeight(0)
    {
    }
 
-   Icon::Icon(const std::string& filename) : gcn::Icon(filename)
+   Icon::Icon(const std::string& filename) : gcn::Icon(), guiImage(NULL), displayWidth(0), displayHeight(0)
    {
+      setImage(filename);
    }
 
-   Icon::Icon(const gcn::Image* image) : gcn::Icon(image)
+   Icon::Icon(const gcn::Image* image) : gcn::Icon(image), guiImage(NULL), displayWidth(0), displayHeight(0)
    {
    }
 
+   void Icon::showGuiImage(const std::string& name)
+   {
+      GuiImage* newImage = ResourceLoader::getGuiImage(name);
+      newImage->acquire();
+      clearImage();
+
+      guiImage = newImage;
+      if(guiImage->getImage() != NULL)
+      {
+         gcn::Icon::setImage(guiImage->getImage());
+      }
+   }
+
    void Icon::setImage(const std::string& filename)
    {
-       gcn::Icon::setImage(gcn::Image::load(filename));
-       mInternalImage = true;
+      showGuiImage(filename);
+   }
+
+   void Icon::setImage(const std::string& filename, int width, int height)
+   {
+      showGuiImage(GuiImage::getVariantName(filename, width, height));
+      displayWidth = width;
+      displayHeight = height;
+      setSize(width, height);
+   }
+
+   void Icon::draw(gcn::Graphics* graphics)
+   {
+      OpenGLGraphics* openGlGraphics = dynamic_cast<OpenGLGraphics*>(graphics);
+      if (mImage == NULL || displayWidth <= 0 || displayHeight <= 0 || openGlGraphics == NULL)
+      {
+         gcn::Icon::draw(graphics);
+         return;
+      }
+
+      // The image keeps its shape, so whichever side is relatively shorter is scaled to cover the size and the other overhangs it
+      const int imageWidth = mImage->getWidth();
+      const int imageHeight = mImage->getHeight();
+      int width = displayWidth;
+      int height = displayHeight;
+      if (imageWidth * displayHeight > imageHeight * displayWidth)
+      {
+         width = imageWidth * displayHeight / imageHeight;
+      }
+      else
+      {
+         height = imageHeight * displayWidth / imageWidth;
+      }
+
+      openGlGraphics->drawScaledImage(mImage, (getWidth() - width) / 2, (getHeight() - height) / 2, width, height);
    }
 
    void Icon::clearImage()
    {
+        if (guiImage != NULL)
+        {
+            guiImage->release();
+            guiImage = NULL;
+        }
+
         if (mInternalImage)
         {
             delete mImage;
@@ -38,6 +94,13 @@ namespace edwt
 
         mImage = NULL;
         mInternalImage = false;
+        displayWidth = 0;
+        displayHeight = 0;
         setSize(0, 0);
    }
+
+   Icon::~Icon()
+   {
+      clearImage();
+   }
 };
@@ -10,6 +10,8 @@
 #include <string>
 #include "guichan.hpp"
 
+class GuiImage;
+
 namespace edwt
 {
    /**
@@ -20,6 +22,19 @@ namespace edwt
     */
    class Icon : public gcn::Icon
    {
+      /** The cached GUI image that the icon is showing, or NULL if it isn't showing one. */
+      GuiImage* guiImage;
+
+      /** The size that the image is shown at, or 0 to show it at its own size. */
+      int displayWidth, displayHeight;
+
+      /**
+       * Shows a GUI image from the ResourceLoader's cache, releasing the one shown before.
+       *
+       * @param name The name of the GUI image.
+       */
+      void showGuiImage(const std::string& name);
+
       public:
         /**
          * Default constructor.
@@ -27,7 +42,8 @@ namespace edwt
         Icon();
 
         /**
-         * Constructor.
+         * Constructor. The image is shared through the ResourceLoader,
+         * so icons showing the same file don't load it again.
          *
          * @param filename The filename of the image to display.
          */
@@ -41,18 +57,43 @@ namespace edwt
         Icon(const gcn::Image* image);
 
         /**
-         * Sets the image to display. Existing image is freed automatically
-         * if it was loaded internally.
+         * Sets the image to display, from the ResourceLoader's cache of GUI images.
+         * Existing image is freed automatically if it was loaded internally.
+         * If the image fails to load, the icon is left empty.
          *
          * @param filename The image to load for display.
          */
         void setImage(const std::string& filename);
 
+        /**
+         * Sets the image to display, scaled (keeping its shape) to cover a size and centered in the icon.
+         * The image is loaded from the smallest of its baked variants that covers the size (see GuiImage::getVariantName),
+         * so an image shown smaller than its source costs no more than the size it is shown at.
+         * The icon is resized to the size.
+         *
+         * @param filename The image to load for display.
+         * @param width The width to show the image at.
+         * @param height The height to show the image at.
+         */
+        void setImage(const std::string& filename, int width, int height);
+
+        /**
+         * Draws the image, scaled to cover the icon if it was set to be shown at a size of its own.
+         *
+         * @param graphics The graphics object to draw with.
+         */
+        virtual void draw(gcn::Graphics* graphics);
+
         /**
          * Clears the image loaded by the Icon. Existing image is freed automatically
          * if it was loaded internally.
          */
         void clearImage();
+
+        /**
+         * Destructor.
+         */
+        ~Icon();
    };
 };
 
@@ -0,0 +1,73 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef IMAGE_VARIANT_FORMAT_H
+#define IMAGE_VARIANT_FORMAT_H
+
+#include "SDL_stdinc.h"
+
+/**
+ * The layout of image variant (.edv) files, which are written by the image variant compiler and loaded by GuiImage.
+ * An image's variants are copies of it downscaled to half its size, then to half of that, and so on, so that an image
+ * shown smaller than its source can be loaded from a variant that is only as big as it is shown.
+ * Every number in the file is stored in little-endian byte order. The file is laid out as:
+ *
+ * - The header below.
+ * - The variants (4-byte aligned): a Variant for each variant, from the largest (half the size of the source) to the smallest.
+ * - The pixels of each variant: its rows from top to bottom, as 4 bytes (red, green, blue and alpha) per pixel,
+ *   compressed with zlib.
+ */
+namespace ImageVariantFormat
+{
+   /** The characters that every image variant file starts with. */
+   static const char MAGIC[4] = { 'E', 'D', 'V', '\0' };
+
+   /** The version of the format; files written with any other version must be recompiled. */
+   static const Uint32 VERSION = 1;
+
+   /** The header at the start of every image variant file. */
+   struct Header
+   {
+      /** The characters in MAGIC. */
+      char magic[4];
+
+      /** The format version that the file was written with. */
+      Uint32 version;
+
+      /** Width (in pixels) of the source image. */
+      Uint32 sourceWidth;
+
+      /** Height (in pixels) of the source image. */
+      Uint32 sourceHeight;
+
+      /** The number of variants. */
+      Uint32 variantCount;
+
+      /** The file offset of the variants. */
+      Uint32 variantsOffset;
+
+      /** The size of the whole file. */
+      Uint32 fileSize;
+   };
+
+   /** One of the downscaled copies of the image. */
+   struct Variant
+   {
+      /** Width (in pixels) of the variant. */
+      Uint32 width;
+
+      /** Height (in pixels) of the variant. */
+      Uint32 height;
+
+      /** The file offset of the variant's compressed pixels. */
+      Uint32 pixelsOffset;
+
+      /** The size (in bytes) of the variant's compressed pixels. */
+      Uint32 pixelsSize;
+   };
+};
+
+#endif
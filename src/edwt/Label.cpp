@@ -18,4 +18,33 @@ namespace edwt
    Label::Label(const std::string& caption) : gcn::Label(caption)
    {
    }
+
+   void Label::draw(gcn::Graphics* graphics)
+   {
+      mCaptionLayout.setFont(getFont());
+      mCaptionLayout.setText(getCaption());
+
+      const int captionWidth = mCaptionLayout.getWidth();
+      int textX;
+      int textY = getHeight() / 2 - getFont()->getHeight() / 2;
+
+      switch (getAlignment())
+      {
+         case gcn::Graphics::LEFT:
+            textX = 0;
+            break;
+         case gcn::Graphics::CENTER:
+            textX = getWidth() / 2 - captionWidth / 2;
+            break;
+         case gcn::Graphics::RIGHT:
+            textX = getWidth() - captionWidth;
+            break;
+         default:
+            throw GCN_EXCEPTION("Unknown alignment.");
+      }
+
+      graphics->setFont(getFont());
+      graphics->setColor(getForegroundColor());
+      mCaptionLayout.draw(graphics, textX, textY);
+   }
 };
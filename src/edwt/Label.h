@@ -8,17 +8,20 @@
 #define LABEL_H
 
 #include "guichan.hpp"
+#include "TextLayout.h"
 
 namespace edwt
 {
    /**
-    * Overrides the original Guichan Label.
-    * This class is currently a stub for encapsulation purposes.
+    * Overrides the original Guichan Label to keep its caption laid out between frames.
     *
     * @author Noam Chitayat
     */
    class Label : public gcn::Label
    {
+      /** The laid out caption, which is only redone when the caption or font changes */
+      TextLayout mCaptionLayout;
+
       public:
          /**
           * Constructor.
@@ -31,6 +34,14 @@ namespace edwt
           * @param caption A caption to set for this label.
           */
          Label(const std::string& caption);
+
+         /**
+          * Draw the label.
+          * Overridden to draw the caption from its cached layout, instead of measuring it every frame.
+          *
+          * @param graphics The graphics driver to draw with.
+          */
+         void draw(gcn::Graphics* graphics);
    };
 };
 
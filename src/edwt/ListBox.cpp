@@ -5,8 +5,9 @@
  */
 
 #include "ListBox.h"
-#include "StringListModel.h"
+#include "ColumnListModel.h"
 #include "Sound.h"
+#include <algorithm>
 #include <sstream>
 
 #include "DebugUtils.h"
@@ -29,6 +30,11 @@ namespace edwt
       mOpaque = true;
       mRowPadding = 0;
       mColumnPadding = 0;
+      mLayoutColumns = 0;
+      mLayoutModel = NULL;
+      mColumnModel = NULL;
+      mLayoutRevision = 0;
+      mLayoutFont = NULL;
       setNumColumns(1);
       setColumnAlignment(0, LEFT);
 
@@ -143,25 +149,30 @@ namespace edwt
       graphics->setColor(getForegroundColor());
       graphics->setFont(getFont());
 
-      int i, fontHeight;
-      int y = getRowPadding() >> 1;
-
-      fontHeight = getRowHeight();
+      const int fontHeight = getRowHeight();
+      const int rowsTop = getRowPadding() >> 1;
       gcn::Color highlight = getHighlightColor();
       gcn::Color base = getBaseColor();
       graphics->setColor(base);
 
-      for (i = 0; i < mListModel->getNumberOfElements(); ++i)
+      // Long lists are mostly scrolled out of view, so only the rows that overlap the clip area are drawn
+      const gcn::ClipRectangle& clipArea = graphics->getCurrentClipArea();
+      const int clipTop = clipArea.y - clipArea.yOffset;
+      const int clipBottom = clipTop + clipArea.height;
+      const int numElements = mListModel->getNumberOfElements();
+      const int firstRow = std::max(0, (clipTop - rowsTop) / fontHeight);
+      const int lastRow = std::min(numElements, (clipBottom - rowsTop) / fontHeight + 1);
+
+      updateRowLayouts(firstRow, lastRow);
+
+      int y = rowsTop + firstRow * fontHeight;
+      for (int i = firstRow; i < lastRow; ++i)
       {
          int columnBeginning = 0;
-         std::string elementText = mListModel->getElementAt(i);
-         std::stringstream columnText(elementText);
+         std::vector<TextLayout>& columnLayouts = mRowLayouts[i];
          
-         for(unsigned int j = 0; j < mColumns; ++j)
+         for(unsigned int j = 0; j < columnLayouts.size(); ++j)
          {
-            std::string currString;
-            if(!std::getline(columnText, currString, '\t')) break;
-
             int columnWidth = mColumnWidths[j] > mMinColumnWidths[j] ? mColumnWidths[j] : mMinColumnWidths[j];
             int xloc;
             
@@ -169,12 +180,12 @@ namespace edwt
             {
                case RIGHT:
                {
-                  xloc = columnBeginning + 1 + columnWidth - getFont()->getWidth(currString);
+                  xloc = columnBeginning + 1 + columnWidth - columnLayouts[j].getWidth();
                   break;
                }
                case CENTER:
                {
-                  xloc = columnBeginning + 1 + (columnWidth - getFont()->getWidth(currString))/2;
+                  xloc = columnBeginning + 1 + (columnWidth - columnLayouts[j].getWidth())/2;
                   break;
                }
                case LEFT:
@@ -188,12 +199,12 @@ namespace edwt
             if (i == mSelected)
             {
                graphics->setColor(highlight);
-               graphics->drawText(currString, xloc, y);
+               columnLayouts[j].draw(graphics, xloc, y);
                graphics->setColor(base);
             }
             else
             {
-               graphics->drawText(currString, xloc, y);
+               columnLayouts[j].draw(graphics, xloc, y);
             }
 
             columnBeginning += columnWidth + getColumnPadding();
@@ -203,6 +214,94 @@ namespace edwt
       }
    }
 
+   void ListBox::updateRowLayouts(int firstRow, int lastRow)
+   {
+      if(mLayoutColumns != mColumns || mLayoutModel != mListModel)
+      {
+         // The elements have to be split up again to fit the new number of columns (or the new list model)
+         mRowTexts.clear();
+         mRowLayouts.clear();
+         mLayoutColumns = mColumns;
+         mLayoutModel = mListModel;
+         mColumnModel = dynamic_cast<ColumnListModel*>(mListModel);
+         mLayoutFont = NULL;
+      }
+
+      const int numElements = mListModel->getNumberOfElements();
+      const bool fontChanged = getFont() != mLayoutFont;
+      mLayoutFont = getFont();
+
+      if(mColumnModel != NULL)
+      {
+         const unsigned int revision = mColumnModel->getRevision();
+         if(!fontChanged && revision == mLayoutRevision && numElements == static_cast<int>(mRowLayouts.size()))
+         {
+            return;
+         }
+
+         mLayoutRevision = revision;
+         mRowLayouts.resize(numElements);
+         for (int i = 0; i < numElements; ++i)
+         {
+            updateColumnRow(i);
+         }
+
+         return;
+      }
+
+      mRowTexts.resize(numElements);
+      mRowLayouts.resize(numElements);
+
+      if(fontChanged)
+      {
+         firstRow = 0;
+         lastRow = numElements;
+      }
+
+      for (int i = std::max(firstRow, 0); i < std::min(lastRow, numElements); ++i)
+      {
+         updateTextRow(i);
+      }
+   }
+
+   void ListBox::updateColumnRow(int row)
+   {
+      std::vector<TextLayout>& columnLayouts = mRowLayouts[row];
+      columnLayouts.resize(std::min(mColumns, mColumnModel->getNumberOfColumnsAt(row)));
+
+      for(unsigned int j = 0; j < columnLayouts.size(); ++j)
+      {
+         columnLayouts[j].setText(mColumnModel->getColumnAt(row, j));
+         columnLayouts[j].setFont(getFont());
+      }
+   }
+
+   void ListBox::updateTextRow(int row)
+   {
+      std::vector<TextLayout>& columnLayouts = mRowLayouts[row];
+      const std::string elementText = mListModel->getElementAt(row);
+
+      if(elementText != mRowTexts[row])
+      {
+         mRowTexts[row] = elementText;
+         columnLayouts.clear();
+
+         // Split the string into columns based on the presence of tab characters.
+         std::stringstream columnText(elementText);
+         std::string column;
+         while(columnLayouts.size() < mColumns && std::getline(columnText, column, '\t'))
+         {
+            columnLayouts.push_back(TextLayout());
+            columnLayouts.back().setText(column);
+         }
+      }
+
+      for(std::vector<TextLayout>::iterator iter = columnLayouts.begin(); iter != columnLayouts.end(); ++iter)
+      {
+         iter->setFont(getFont());
+      }
+   }
+
    unsigned int ListBox::getRowHeight() const
    {
       return gcn::ListBox::getRowHeight() + getRowPadding();
@@ -245,24 +344,23 @@ namespace edwt
 
       // Find the maximum string width needed in each column, and set the widths to those maxima
 
-      gcn::Font* font = getFont();
+      updateRowLayouts(0, mListModel->getNumberOfElements());
 
       // At each iteration, get the next item on the list and find its width relative to the font in use
       for (int i = 0; i < mListModel->getNumberOfElements(); ++i)
       {
-         std::stringstream itemStream(mListModel->getElementAt(i));
+         std::vector<TextLayout>& columnLayouts = mRowLayouts[i];
          std::vector<unsigned int>::iterator iter = mColumnWidths.begin();
          std::vector<unsigned int>::iterator minWidthIter = mMinColumnWidths.begin();
 
-         // Split the string into columns based on the presence of tab characters.
-         std::string column;
-         while(iter != mColumnWidths.end() && std::getline(itemStream, column, '\t'))
+         // The layouts already hold the string split into columns based on the presence of tab characters.
+         for(std::vector<TextLayout>::iterator column = columnLayouts.begin(); column != columnLayouts.end(); ++column)
          {
             // Get the minimum width of the column.
             int minWidth = *minWidthIter;
             
             // Get the width of the column relative to the font.
-            int itemWidth = font->getWidth(column);
+            int itemWidth = column->getWidth();
 
             // If this item's width in the current column is larger, then set a new maximum.
             int currWidth = *iter;
@@ -9,12 +9,14 @@
 
 #include "guichan.hpp"
 #include "TextAlignment.h"
+#include "TextLayout.h"
 
 class Sound;
 
 namespace edwt
 {
    class StringListModel;
+   class ColumnListModel;
 
    /** 
     *  A widget that overrides the original Guichan List Box to add 
@@ -48,6 +50,53 @@ namespace edwt
       /** The color to use when drawing a selected (highlighted) element */
       gcn::Color highlightColor;
 
+      /** The text of each element, as of the last time its columns were laid out */
+      std::vector<std::string> mRowTexts;
+
+      /** The laid out columns of each element, which are only redone when the element's text or the font changes */
+      std::vector<std::vector<TextLayout> > mRowLayouts;
+
+      /** The number of columns that the elements were last split into */
+      unsigned int mLayoutColumns;
+
+      /** The list model that the elements were last laid out from */
+      gcn::ListModel* mLayoutModel;
+
+      /** The list model, if it keeps its elements split into columns (or NULL if it doesn't) */
+      ColumnListModel* mColumnModel;
+
+      /** The revision of the column list model that the elements were last laid out from */
+      unsigned int mLayoutRevision;
+
+      /** The font that the elements were last laid out in (NULL if they have to be laid out again) */
+      gcn::Font* mLayoutFont;
+
+      /**
+       * Brings the laid out columns of the elements up to date with the list model.
+       * Every element is brought up to date if the list model keeps its elements split into columns
+       * (which only happens when it has changed) or if the font has changed; otherwise only the elements
+       * in the given range are, since the text of every other element would have to be fetched from the model.
+       *
+       * @param firstRow The first element that has to be up to date.
+       * @param lastRow One past the last element that has to be up to date.
+       */
+      void updateRowLayouts(int firstRow, int lastRow);
+
+      /**
+       * Lays out the columns of an element of a ColumnListModel, without copying their text
+       * unless it has changed.
+       *
+       * @param row The index of the element.
+       */
+      void updateColumnRow(int row);
+
+      /**
+       * Lays out the columns of an element of a plain list model, splitting its text at its tab characters.
+       *
+       * @param row The index of the element.
+       */
+      void updateTextRow(int row);
+
       public:
          /**
           * Constructor.
@@ -132,6 +181,7 @@ namespace edwt
          /**
           * Draw the list box. 
           * Overridden to provide special drawing properties, including transparency.
+          * Only the rows inside the clip area (such as the part of the list shown by a scroll area) are drawn.
           *
           * @param graphics The graphics driver to draw with.
           */
@@ -0,0 +1,268 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "OpenGLGraphics.h"
+#include "GLState.h"
+#include "RenderTarget.h"
+#include "SDL_opengl.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EDWT;
+
+// The colour that images are multiplied by, so that they are drawn in their own colours
+static const gcn::Color UNTINTED(255, 255, 255, 255);
+
+namespace edwt
+{
+   OpenGLGraphics::OpenGLGraphics() : batchTexture(0)
+   {
+   }
+
+   void OpenGLGraphics::_beginDraw()
+   {
+      gcn::OpenGLGraphics::_beginDraw();
+
+      // The original blend function squares the alpha of translucent pixels drawn into an empty layer;
+      // the layer blending draws the same colours, but keeps the layer's alpha correct
+      RenderTarget::useLayerBlending();
+
+      // Opaque quads blend to the same colours they would replace, so blending is left on for the whole batch
+      glEnable(GL_BLEND);
+      resetScissor();
+   }
+
+   void OpenGLGraphics::_endDraw()
+   {
+      flush();
+      gcn::OpenGLGraphics::_endDraw();
+   }
+
+   bool OpenGLGraphics::pushClipArea(gcn::Rectangle area)
+   {
+      return gcn::Graphics::pushClipArea(area);
+   }
+
+   void OpenGLGraphics::popClipArea()
+   {
+      gcn::Graphics::popClipArea();
+   }
+
+   void OpenGLGraphics::scissorToClipArea()
+   {
+      const gcn::ClipRectangle& top = mClipStack.top();
+      glScissor(top.x, mHeight - top.y - top.height, top.width, top.height);
+   }
+
+   void OpenGLGraphics::resetScissor()
+   {
+      glScissor(0, 0, mWidth, mHeight);
+   }
+
+   void OpenGLGraphics::addQuad(GLuint texture, int destLeft, int destTop, int destRight, int destBottom,
+         float textureLeft, float textureTop, float textureRight, float textureBottom, const gcn::Color& color)
+   {
+      if (mClipStack.empty())
+      {
+         throw GCN_EXCEPTION("Clip stack is empty, perhaps you called a draw funtion outside of _beginDraw() and _endDraw()?");
+      }
+
+      const gcn::ClipRectangle& clipArea = mClipStack.top();
+      const int clippedLeft = std::max(destLeft, clipArea.x);
+      const int clippedTop = std::max(destTop, clipArea.y);
+      const int clippedRight = std::min(destRight, clipArea.x + clipArea.width);
+      const int clippedBottom = std::min(destBottom, clipArea.y + clipArea.height);
+
+      if (clippedLeft >= clippedRight || clippedTop >= clippedBottom) return;
+
+      // Cutting a quad down to the clip area cuts its texture coordinates down by the same proportion
+      const float textureXScale = (textureRight - textureLeft) / (destRight - destLeft);
+      const float textureYScale = (textureBottom - textureTop) / (destBottom - destTop);
+      textureRight = textureLeft + (clippedRight - destLeft) * textureXScale;
+      textureLeft += (clippedLeft - destLeft) * textureXScale;
+      textureBottom = textureTop + (clippedBottom - destTop) * textureYScale;
+      textureTop += (clippedTop - destTop) * textureYScale;
+
+      if (texture != batchTexture)
+      {
+         flush();
+         batchTexture = texture;
+      }
+
+      Vertex corner;
+      corner.r = color.r;
+      corner.g = color.g;
+      corner.b = color.b;
+      corner.a = color.a;
+
+      // The same corners, in the same order, as the quads that the original driver drew one at a time
+      corner.x = clippedLeft;
+      corner.y = clippedTop;
+      corner.u = textureLeft;
+      corner.v = textureTop;
+      vertices.push_back(corner);
+
+      corner.y = clippedBottom;
+      corner.v = textureBottom;
+      vertices.push_back(corner);
+
+      corner.x = clippedRight;
+      corner.u = textureRight;
+      vertices.push_back(corner);
+
+      corner.y = clippedTop;
+      corner.v = textureTop;
+      vertices.push_back(corner);
+   }
+
+   void OpenGLGraphics::addFilledQuad(int destLeft, int destTop, int destRight, int destBottom)
+   {
+      if (mClipStack.empty())
+      {
+         throw GCN_EXCEPTION("Clip stack is empty, perhaps you called a draw funtion outside of _beginDraw() and _endDraw()?");
+      }
+
+      const gcn::ClipRectangle& top = mClipStack.top();
+      addQuad(0, destLeft + top.xOffset, destTop + top.yOffset, destRight + top.xOffset, destBottom + top.yOffset,
+            0.0f, 0.0f, 0.0f, 0.0f, mColor);
+   }
+
+   void OpenGLGraphics::drawImage(const gcn::Image* image, int srcX, int srcY, int dstX, int dstY, int width, int height)
+   {
+      const gcn::OpenGLImage* srcImage = dynamic_cast<const gcn::OpenGLImage*>(image);
+
+      if (srcImage == NULL)
+      {
+         throw GCN_EXCEPTION("Trying to draw an image of unknown format, must be an OpenGLImage.");
+      }
+
+      if (mClipStack.empty())
+      {
+         throw GCN_EXCEPTION("Clip stack is empty, perhaps you called a draw funtion outside of _beginDraw() and _endDraw()?");
+      }
+
+      const gcn::ClipRectangle& top = mClipStack.top();
+      dstX += top.xOffset;
+      dstY += top.yOffset;
+
+      const float textureWidth = srcImage->getTextureWidth();
+      const float textureHeight = srcImage->getTextureHeight();
+
+      addQuad(srcImage->getTextureHandle(), dstX, dstY, dstX + width, dstY + height,
+            srcX / textureWidth, srcY / textureHeight, (srcX + width) / textureWidth, (srcY + height) / textureHeight, UNTINTED);
+   }
+
+   void OpenGLGraphics::drawScaledImage(const gcn::Image* image, int dstX, int dstY, int dstWidth, int dstHeight)
+   {
+      const gcn::OpenGLImage* srcImage = dynamic_cast<const gcn::OpenGLImage*>(image);
+
+      if (srcImage == NULL)
+      {
+         throw GCN_EXCEPTION("Trying to draw an image of unknown format, must be an OpenGLImage.");
+      }
+
+      if (mClipStack.empty())
+      {
+         throw GCN_EXCEPTION("Clip stack is empty, perhaps you called a draw funtion outside of _beginDraw() and _endDraw()?");
+      }
+
+      const gcn::ClipRectangle& top = mClipStack.top();
+      dstX += top.xOffset;
+      dstY += top.yOffset;
+
+      addQuad(srcImage->getTextureHandle(), dstX, dstY, dstX + dstWidth, dstY + dstHeight, 0.0f, 0.0f,
+            static_cast<float>(srcImage->getWidth()) / srcImage->getTextureWidth(), static_cast<float>(srcImage->getHeight()) / srcImage->getTextureHeight(), UNTINTED);
+   }
+
+   void OpenGLGraphics::drawPoint(int x, int y)
+   {
+      addFilledQuad(x, y, x + 1, y + 1);
+   }
+
+   void OpenGLGraphics::drawLine(int x1, int y1, int x2, int y2)
+   {
+      if (x1 == x2 || y1 == y2)
+      {
+         // Like the original driver's lines, the quad covers both end points
+         addFilledQuad(std::min(x1, x2), std::min(y1, y2), std::max(x1, x2) + 1, std::max(y1, y2) + 1);
+         return;
+      }
+
+      // Slanted lines can't be clipped as quads, so they are drawn (and scissored) as they come
+      flush();
+      scissorToClipArea();
+      gcn::OpenGLGraphics::drawLine(x1, y1, x2, y2);
+      resetScissor();
+   }
+
+   void OpenGLGraphics::drawRectangle(const gcn::Rectangle& rectangle)
+   {
+      if (rectangle.width <= 0 || rectangle.height <= 0) return;
+
+      const int left = rectangle.x;
+      const int top = rectangle.y;
+      const int right = rectangle.x + rectangle.width;
+      const int bottom = rectangle.y + rectangle.height;
+
+      // The sides don't overlap, so translucent outlines don't come out darker at the corners
+      addFilledQuad(left, top, right, top + 1);
+      if (bottom - 1 > top)
+      {
+         addFilledQuad(left, bottom - 1, right, bottom);
+      }
+
+      addFilledQuad(left, top + 1, left + 1, bottom - 1);
+      if (right - 1 > left)
+      {
+         addFilledQuad(right - 1, top + 1, right, bottom - 1);
+      }
+   }
+
+   void OpenGLGraphics::fillRectangle(const gcn::Rectangle& rectangle)
+   {
+      addFilledQuad(rectangle.x, rectangle.y, rectangle.x + rectangle.width, rectangle.y + rectangle.height);
+   }
+
+   void OpenGLGraphics::flush()
+   {
+      if (vertices.empty()) return;
+
+      if (batchTexture != 0)
+      {
+         glBindTexture(GL_TEXTURE_2D, batchTexture);
+         glEnable(GL_TEXTURE_2D);
+
+         // Images are given white corners, so modulating them draws them in their own colours,
+         // while text is given the colour it is drawn in
+         glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+      }
+      else
+      {
+         glDisable(GL_TEXTURE_2D);
+      }
+
+      const GLsizei stride = sizeof(Vertex);
+      GLState::setVertexArrays(true);
+      glVertexPointer(2, GL_FLOAT, stride, &vertices[0].x);
+      glTexCoordPointer(2, GL_FLOAT, stride, &vertices[0].u);
+
+      // Vertex buffers are drawn without colours, so the colour array is only enabled while the batch is drawn
+      glEnableClientState(GL_COLOR_ARRAY);
+      glColorPointer(4, GL_UNSIGNED_BYTE, stride, &vertices[0].r);
+
+      GLState::countDrawCall();
+      glDrawArrays(GL_QUADS, 0, vertices.size());
+
+      glDisableClientState(GL_COLOR_ARRAY);
+
+      // Guichan draws its slanted lines untextured, in the current colour (which the colour array leaves undefined)
+      glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+      glDisable(GL_TEXTURE_2D);
+      glColor4ub(mColor.r, mColor.g, mColor.b, mColor.a);
+
+      vertices.clear();
+   }
+};
@@ -0,0 +1,147 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef OPENGL_GRAPHICS_H
+#define OPENGL_GRAPHICS_H
+
+#include "guichan.hpp"
+#include "guichan/opengl.hpp"
+#include <vector>
+
+typedef unsigned int GLuint;
+
+namespace edwt
+{
+   /**
+    * Overrides the original Guichan OpenGL graphics driver so that widgets can be drawn
+    * into an offscreen layer (a RenderTarget) as well as straight onto the screen.
+    *
+    * The original driver draws every rectangle, line and image with a glBegin/glEnd block of its own,
+    * and sets the scissor box every time a widget pushes or pops a clip area. This driver collects
+    * the rectangles, axis-aligned lines, points and images into a single vertex array instead, and
+    * only draws the collected quads when the texture changes or the drawing is done.
+    * The quads are clipped to the current clip area as they are added, so the scissor box
+    * stays at the whole target and changing the clip area doesn't break up the batch.
+    */
+   class OpenGLGraphics : public gcn::OpenGLGraphics
+   {
+      /** A corner of a quad waiting to be drawn. */
+      struct Vertex
+      {
+         /** The position of the corner (in pixels). */
+         float x, y;
+
+         /** The texture coordinates of the corner. */
+         float u, v;
+
+         /** The colour of the corner. */
+         unsigned char r, g, b, a;
+      };
+
+      /** The corners of the quads added since the last flush, four for each quad. */
+      std::vector<Vertex> vertices;
+
+      /** The texture that the quads in the batch are drawn with, or 0 if they are untextured. */
+      GLuint batchTexture;
+
+      /**
+       * Adds an untextured quad in the current colour to the batch.
+       *
+       * @param destLeft The left edge of the quad (in pixels, relative to the current clip area).
+       * @param destTop The top edge of the quad (in pixels, relative to the current clip area).
+       * @param destRight The right edge of the quad (in pixels, relative to the current clip area).
+       * @param destBottom The bottom edge of the quad (in pixels, relative to the current clip area).
+       */
+      void addFilledQuad(int destLeft, int destTop, int destRight, int destBottom);
+
+      /**
+       * Sets the scissor box to the current clip area, for drawing that can't be clipped as it is batched.
+       */
+      void scissorToClipArea();
+
+      /**
+       * Sets the scissor box back to the whole target.
+       */
+      void resetScissor();
+
+      public:
+         /**
+          * Constructor.
+          */
+         OpenGLGraphics();
+
+         // Needed so that drawImage(gcn::Image *, int, int) is visible.
+         using gcn::OpenGLGraphics::drawImage;
+
+         /**
+          * Sets up drawing as the original driver does, but with a blend function
+          * that keeps alpha correct when the widgets are drawn into a layer.
+          */
+         virtual void _beginDraw();
+
+         /**
+          * Draws the quads still in the batch, then finishes drawing as the original driver does.
+          */
+         virtual void _endDraw();
+
+         /**
+          * Pushes a clip area without touching the scissor box, since the quads are clipped as they are added.
+          *
+          * @param area The clip area to push.
+          *
+          * @return true iff the clip area is visible at all.
+          */
+         virtual bool pushClipArea(gcn::Rectangle area);
+
+         /**
+          * Pops a clip area without touching the scissor box.
+          */
+         virtual void popClipArea();
+
+         virtual void drawImage(const gcn::Image* image, int srcX, int srcY, int dstX, int dstY, int width, int height);
+
+         /**
+          * Draws a whole image stretched over a rectangle, such as an image loaded from a smaller variant than it is shown at.
+          *
+          * @param image The image to draw.
+          * @param dstX The x-coordinate of the rectangle, relative to the current clip area.
+          * @param dstY The y-coordinate of the rectangle, relative to the current clip area.
+          * @param dstWidth The width of the rectangle.
+          * @param dstHeight The height of the rectangle.
+          */
+         void drawScaledImage(const gcn::Image* image, int dstX, int dstY, int dstWidth, int dstHeight);
+
+         virtual void drawPoint(int x, int y);
+         virtual void drawLine(int x1, int y1, int x2, int y2);
+         virtual void drawRectangle(const gcn::Rectangle& rectangle);
+         virtual void fillRectangle(const gcn::Rectangle& rectangle);
+
+         /**
+          * Adds a quad to the batch, flushing the batch first if the quad uses another texture.
+          * The quad is clipped to the current clip area; quads that fall outside of it aren't added.
+          *
+          * @param texture The texture to draw the quad with, or 0 to draw it untextured.
+          * @param destLeft The left edge of the quad (in pixels, relative to the target).
+          * @param destTop The top edge of the quad (in pixels, relative to the target).
+          * @param destRight The right edge of the quad (in pixels, relative to the target).
+          * @param destBottom The bottom edge of the quad (in pixels, relative to the target).
+          * @param textureLeft The left texture coordinate.
+          * @param textureTop The top texture coordinate.
+          * @param textureRight The right texture coordinate.
+          * @param textureBottom The bottom texture coordinate.
+          * @param color The colour to draw the quad in (or to multiply its texture by).
+          */
+         void addQuad(GLuint texture, int destLeft, int destTop, int destRight, int destBottom,
+               float textureLeft, float textureTop, float textureRight, float textureBottom, const gcn::Color& color);
+
+         /**
+          * Draws every quad added since the last flush with one draw call, and empties the batch.
+          */
+         void flush();
+   };
+};
+
+#endif
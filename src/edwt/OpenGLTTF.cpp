@@ -73,8 +73,14 @@
 #include "guichan/image.hpp"
 #include "guichan/platform.hpp"
 
-#include "guichan/opengl/openglgraphics.hpp"
-#include "guichan/opengl/openglimage.hpp"
+#include "OpenGLGraphics.h"
+#include "SDL_opengl.h"
+#include "ResourceLoader.h"
+#include "FontFile.h"
+#include "GPUPassTimer.h"
+
+#include <algorithm>
+#include <vector>
 
 #include "DebugUtils.h"
 
@@ -89,26 +95,212 @@ namespace edwt
       mAntiAlias = true;        
       mFilename = filename;
       mFont = NULL;
+      mFontFile = NULL;
+      mAtlasTexture = 0;
+      mAtlasWidth = 0;
+      mAtlasHeight = 0;
 
-      mFont = TTF_OpenFont(filename.c_str(), size);
+      // Every size of the font reads from the same copy of the file, which is held until the font is closed
+      FontFile* fontFile = ResourceLoader::getFontFile(filename);
+      if (fontFile->getData() == NULL)
+      {
+         throw GCN_EXCEPTION("SDLTrueTypeFont::SDLTrueTypeFont. Failed to load font file " + filename);
+      }
+
+      SDL_RWops* fontSource = SDL_RWFromConstMem(fontFile->getData(), fontFile->getDataSize());
+      if (fontSource != NULL)
+      {
+         mFont = TTF_OpenFontRW(fontSource, 1, size);
+      }
 
       if (mFont == NULL)
       {
          throw GCN_EXCEPTION("SDLTrueTypeFont::SDLTrueTypeFont. "+std::string(TTF_GetError()));
       }
+
+      mFontFile = fontFile;
+      mFontFile->acquire();
+
+      layOutGlyphs();
    }
     
    OpenGLTrueTypeFont::~OpenGLTrueTypeFont()
    {
+      if (mAtlasTexture != 0)
+      {
+         glDeleteTextures(1, &mAtlasTexture);
+      }
+
       TTF_CloseFont(mFont);
+      mFontFile->release();
    }
-  
-   int OpenGLTrueTypeFont::getWidth(const std::string& text) const
+
+   void OpenGLTrueTypeFont::layOutGlyphs()
+   {
+      const int fontHeight = TTF_FontHeight(mFont);
+      int totalCellArea = 0;
+
+      for (int ch = 0; ch < GLYPH_COUNT; ++ch)
+      {
+         Glyph& glyph = mGlyphs[ch];
+         if (TTF_GlyphMetrics(mFont, ch, &glyph.minX, &glyph.maxX, &glyph.minY, &glyph.maxY, &glyph.advance) != 0)
+         {
+            glyph.minX = glyph.maxX = glyph.minY = glyph.maxY = glyph.advance = 0;
+         }
+
+         // Leave a pixel between cells, so that neighbouring glyphs never touch
+         glyph.cellWidth = std::max(glyph.maxX - glyph.minX, 0) + 2;
+         glyph.cellHeight = std::max(fontHeight, glyph.maxY - glyph.minY) + 2;
+         glyph.width = 0;
+         glyph.height = 0;
+         glyph.rasterized = false;
+
+         totalCellArea += glyph.cellWidth * glyph.cellHeight;
+      }
+
+      // Make the atlas roughly square, then lay the cells out in rows across it
+      mAtlasWidth = 64;
+      while (mAtlasWidth * mAtlasWidth < totalCellArea)
+      {
+         mAtlasWidth *= 2;
+      }
+
+      int x = 0;
+      int y = 0;
+      int rowHeight = 0;
+      for (int ch = 0; ch < GLYPH_COUNT; ++ch)
+      {
+         Glyph& glyph = mGlyphs[ch];
+         if (x + glyph.cellWidth > mAtlasWidth)
+         {
+            x = 0;
+            y += rowHeight;
+            rowHeight = 0;
+         }
+
+         glyph.atlasX = x;
+         glyph.atlasY = y;
+         x += glyph.cellWidth;
+         rowHeight = std::max(rowHeight, glyph.cellHeight);
+      }
+
+      mAtlasHeight = 1;
+      while (mAtlasHeight < y + rowHeight)
+      {
+         mAtlasHeight *= 2;
+      }
+   }
+
+   void OpenGLTrueTypeFont::rasterizeGlyph(unsigned char ch)
+   {
+      Glyph& glyph = mGlyphs[ch];
+      glyph.rasterized = true;
+
+      if (mAtlasTexture == 0)
+      {
+         // The atlas is created on first use, since fonts can be loaded before there is anything to draw them with
+         glGenTextures(1, &mAtlasTexture);
+         glBindTexture(GL_TEXTURE_2D, mAtlasTexture);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+         const std::vector<unsigned char> blankPixels(mAtlasWidth * mAtlasHeight * 4, 0);
+         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mAtlasWidth, mAtlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, &blankPixels[0]);
+      }
+
+      // Glyphs are rendered in white and tinted by the current colour when they are drawn
+      SDL_Color white;
+      white.r = white.g = white.b = 255;
+
+      SDL_Surface *glyphSurface = mAntiAlias ? TTF_RenderGlyph_Blended(mFont, ch, white) : TTF_RenderGlyph_Solid(mFont, ch, white);
+      if (glyphSurface == NULL)
+      {
+         // Glyphs with nothing to draw, like spaces, don't render to a surface
+         return;
+      }
+
+      glyph.width = std::min(glyphSurface->w, glyph.cellWidth);
+      glyph.height = std::min(glyphSurface->h, glyph.cellHeight);
+
+      std::vector<unsigned char> pixels(std::max(glyph.width * glyph.height * 4, 4));
+      const SDL_PixelFormat* format = glyphSurface->format;
+      const bool colorKeyed = (glyphSurface->flags & SDL_SRCCOLORKEY) != 0;
+
+      SDL_LockSurface(glyphSurface);
+      for (int y = 0; y < glyph.height; ++y)
+      {
+         const Uint8* row = static_cast<const Uint8*>(glyphSurface->pixels) + y * glyphSurface->pitch;
+         for (int x = 0; x < glyph.width; ++x)
+         {
+            // Solid glyphs are 8-bit and colour keyed, while blended glyphs are 32-bit with alpha
+            const Uint32 pixel = format->BytesPerPixel == 1 ? row[x] : reinterpret_cast<const Uint32*>(row)[x];
+            Uint8* rgba = &pixels[(y * glyph.width + x) * 4];
+            SDL_GetRGBA(pixel, const_cast<SDL_PixelFormat*>(format), &rgba[0], &rgba[1], &rgba[2], &rgba[3]);
+
+            if (colorKeyed && pixel == format->colorkey)
+            {
+               rgba[3] = 0;
+            }
+         }
+      }
+      SDL_UnlockSurface(glyphSurface);
+      SDL_FreeSurface(glyphSurface);
+
+      if (glyph.width > 0 && glyph.height > 0)
+      {
+         glBindTexture(GL_TEXTURE_2D, mAtlasTexture);
+         glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+         glTexSubImage2D(GL_TEXTURE_2D, 0, glyph.atlasX, glyph.atlasY, glyph.width, glyph.height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+      }
+   }
+
+   int OpenGLTrueTypeFont::getKerning(unsigned char first, unsigned char second) const
    {
+      const unsigned int pairKey = (first << 8) | second;
+      std::map<unsigned int, int>::const_iterator kerning = mKerning.find(pairKey);
+      if (kerning != mKerning.end())
+      {
+         return kerning->second;
+      }
+
+      // SDL_ttf doesn't expose kerning, but it does apply it when measuring text,
+      // so the kerning is whatever the measured pair adds to the pair's unkerned width
+      const char pair[] = { static_cast<char>(first), static_cast<char>(second), '\0' };
       int w, h;
-      TTF_SizeText(mFont, text.c_str(), &w, &h);
+      TTF_SizeText(mFont, pair, &w, &h);
 
-      return w;
+      const int pairKerning = w - measureText(pair, false);
+      mKerning[pairKey] = pairKerning;
+      return pairKerning;
+   }
+
+   int OpenGLTrueTypeFont::measureText(const std::string& text, bool useKerning) const
+   {
+      int penX = 0;
+      int left = 0;
+      int right = 0;
+
+      for (std::string::size_type i = 0; i < text.length(); ++i)
+      {
+         const unsigned char ch = text[i];
+         const Glyph& glyph = mGlyphs[ch];
+
+         if (useKerning && i > 0)
+         {
+            penX += getKerning(text[i - 1], ch);
+         }
+
+         left = std::min(left, penX + glyph.minX);
+         right = std::max(right, penX + std::max(glyph.advance, glyph.maxX));
+         penX += glyph.advance;
+      }
+
+      return right - left;
+   }
+  
+   int OpenGLTrueTypeFont::getWidth(const std::string& text) const
+   {
+      return measureText(text, true);
    }
 
    int OpenGLTrueTypeFont::getHeight() const
@@ -116,43 +308,117 @@ namespace edwt
       return TTF_FontHeight(mFont) + mRowSpacing;
    }
     
-   void OpenGLTrueTypeFont::drawString(gcn::Graphics* graphics, const std::string& text, const int x, const int y)
+   void OpenGLTrueTypeFont::shapeText(const std::string& text, GlyphRun& run) const
    {
+      run.text = text;
+      run.penPositions.resize(text.length());
+      run.width = 0;
+
       if (text == "") return;
 
-      gcn::OpenGLGraphics *openGlGraphics = dynamic_cast<gcn::OpenGLGraphics *>(graphics);
+      int penX = 0;
+      int left = 0;
+      int right = 0;
+
+      for (std::string::size_type i = 0; i < text.length(); ++i)
+      {
+         const unsigned char ch = text[i];
+         const Glyph& glyph = mGlyphs[ch];
+
+         if (i > 0)
+         {
+            penX += getKerning(text[i - 1], ch);
+         }
+
+         run.penPositions[i] = penX;
+         left = std::min(left, penX + glyph.minX);
+         right = std::max(right, penX + std::max(glyph.advance, glyph.maxX));
+         penX += glyph.advance;
+      }
+
+      // Like SDL_ttf, text starting with a glyph that hangs left of the pen is shifted over to fit it
+      const int leadingShift = -std::min(mGlyphs[static_cast<unsigned char>(text[0])].minX, 0);
+      for (std::vector<int>::iterator iter = run.penPositions.begin(); iter != run.penPositions.end(); ++iter)
+      {
+         *iter += leadingShift;
+      }
+
+      run.width = right - left;
+   }
+
+   void OpenGLTrueTypeFont::drawGlyphRun(gcn::Graphics* graphics, const GlyphRun& run, const int x, const int y, std::string::size_type glyphCount)
+   {
+      // Glyphs past the count keep the positions they were given, so text revealed a glyph at a time doesn't shift
+      const std::string::size_type length = std::min(glyphCount, run.text.length());
+      if (length == 0) return;
+
+      OpenGLGraphics *openGlGraphics = dynamic_cast<OpenGLGraphics *>(graphics);
 
       if (openGlGraphics == NULL)
       {
-         throw GCN_EXCEPTION("OpenGLTrueTypeFont::drawString. Graphics object not an OpenGL graphics object!");
+         throw GCN_EXCEPTION("OpenGLTrueTypeFont::drawGlyphRun. Graphics object not an OpenGL graphics object!");
          return;
       }
+
+      // Glyphs can't be copied into the atlas in the middle of drawing, so any new ones are rasterized first
+      std::string::size_type firstMissing = 0;
+      while (firstMissing < length && mGlyphs[static_cast<unsigned char>(run.text[firstMissing])].rasterized)
+      {
+         ++firstMissing;
+      }
+
+      if (firstMissing < length)
+      {
+         // The uploads into the atlas are timed as a pass of their own, apart from the GUI drawing around them
+         PROFILE_GPU_PASS("Text");
+         for (std::string::size_type i = firstMissing; i < length; ++i)
+         {
+            const unsigned char ch = run.text[i];
+            if (!mGlyphs[ch].rasterized)
+            {
+               rasterizeGlyph(ch);
+            }
+         }
+      }
+
+      if (mAtlasTexture == 0) return;
         
       // This is needed for drawing the Glyph in the middle if we have spacing
       int yoffset = getRowSpacing() / 2;
-        
-      gcn::Color col = openGlGraphics->getColor();
 
-      SDL_Color sdlCol;
-      sdlCol.r = col.r;
-      sdlCol.g = col.g;
-      sdlCol.b = col.b;
+      const gcn::ClipRectangle& clipArea = openGlGraphics->getCurrentClipArea();
+      const int ascent = TTF_FontAscent(mFont);
+      const int top = y + yoffset + clipArea.yOffset;
+      const int left = x + clipArea.xOffset;
 
-      SDL_Surface *textSurface;
-      if (mAntiAlias)
-      {
-         textSurface = TTF_RenderText_Blended(mFont, text.c_str(), sdlCol);
-      }
-      else
+      // The glyphs are white, so modulating them by the current colour draws them in that colour
+      const gcn::Color& color = openGlGraphics->getColor();
+
+      for (std::string::size_type i = 0; i < length; ++i)
       {
-         textSurface = TTF_RenderText_Solid(mFont, text.c_str(), sdlCol);
-      }
+         const Glyph& glyph = mGlyphs[static_cast<unsigned char>(run.text[i])];
+
+         if (glyph.width > 0 && glyph.height > 0)
+         {
+            const int destLeft = left + run.penPositions[i] + glyph.minX;
+            const int destTop = top + ascent - glyph.maxY;
 
-      gcn::OpenGLImage *img = new gcn::OpenGLImage((unsigned int*)textSurface->pixels, textSurface->w, textSurface->h);
-      openGlGraphics->drawImage(img, 0, 0, x, y + yoffset, textSurface->w, textSurface->h);
-      delete img;
+            const float texLeft = glyph.atlasX / (float)mAtlasWidth;
+            const float texTop = glyph.atlasY / (float)mAtlasHeight;
+            const float texRight = (glyph.atlasX + glyph.width) / (float)mAtlasWidth;
+            const float texBottom = (glyph.atlasY + glyph.height) / (float)mAtlasHeight;
 
-      SDL_FreeSurface(textSurface);
+            openGlGraphics->addQuad(mAtlasTexture, destLeft, destTop, destLeft + glyph.width, destTop + glyph.height,
+                  texLeft, texTop, texRight, texBottom, color);
+         }
+      }
+   }
+
+   void OpenGLTrueTypeFont::drawString(gcn::Graphics* graphics, const std::string& text, const int x, const int y)
+   {
+      GlyphRun run;
+      shapeText(text, run);
+      drawGlyphRun(graphics, run, x, y);
    }
     
    void OpenGLTrueTypeFont::setRowSpacing(int spacing)
@@ -177,7 +443,15 @@ namespace edwt
 
    void OpenGLTrueTypeFont::setAntiAlias(bool antiAlias)
    {
+      if (antiAlias == mAntiAlias) return;
+
       mAntiAlias = antiAlias;
+
+      // The glyphs that were already rasterized are redrawn the next time they are used
+      for (int ch = 0; ch < GLYPH_COUNT; ++ch)
+      {
+         mGlyphs[ch].rasterized = false;
+      }
    }
 
    bool OpenGLTrueTypeFont::isAntiAlias()
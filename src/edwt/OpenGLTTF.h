@@ -65,15 +65,23 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "SDL_ttf.h"
 #include "guichan/font.hpp"
 
+typedef unsigned int GLuint;
+class FontFile;
+
 namespace edwt
 {
    /**
     * OpenGL True Type Font implementation of Font. It uses the SDL_ttf library
-    * and pipes the SDL display to an OpenGLImage texture.
+    * to rasterize each glyph once into a glyph atlas texture, and draws text
+    * as a batch of quads from the atlas.
+    *
+    * The font file is loaded through the ResourceLoader, so every size of a font
+    * shares one copy of the file, which the font holds for as long as it is open.
     *
     * NOTE: You must initialize the SDL_ttf library before using this
     *       class. Also, remember to call the SDL_ttf libraries quit
@@ -143,6 +151,40 @@ namespace edwt
           */
          virtual bool isAntiAlias();
       
+         /** A line of text whose glyphs have already been positioned, so that it can be drawn again without measuring it. */
+         struct GlyphRun
+         {
+            /** The characters of the glyphs in the run. */
+            std::string text;
+
+            /** The pen position of each glyph, relative to the start of the run. */
+            std::vector<int> penPositions;
+
+            /** The width of the run. */
+            int width;
+
+            GlyphRun() : width(0) {}
+         };
+
+         /**
+          * Positions the glyphs of a line of text, applying the kerning between them.
+          *
+          * @param text the text to position.
+          * @param run the parameter used to return the positioned glyphs.
+          */
+         void shapeText(const std::string& text, GlyphRun& run) const;
+
+         /**
+          * Draws a line of text that was positioned by shapeText.
+          *
+          * @param graphics the graphics object to draw with.
+          * @param run the positioned glyphs to draw.
+          * @param x the x-coordinate to draw the text at.
+          * @param y the y-coordinate to draw the text at.
+          * @param glyphCount the number of glyphs to draw from the start of the run (all of them, by default).
+          */
+         void drawGlyphRun(gcn::Graphics* graphics, const GlyphRun& run, int x, int y, std::string::size_type glyphCount = std::string::npos);
+
          // Inherited from Font
          virtual int getWidth(const std::string& text) const;
          virtual int getHeight() const;        
@@ -150,6 +192,9 @@ namespace edwt
       
       protected:
          TTF_Font *mFont;
+
+         /** The file that the font was opened from, which SDL_ttf keeps reading glyphs from. */
+         FontFile* mFontFile;
       
          int mHeight;
          int mGlyphSpacing;
@@ -157,6 +202,78 @@ namespace edwt
 
          std::string mFilename;
          bool mAntiAlias;      
+
+         /** The number of glyphs in the atlas (one for each Latin-1 character). */
+         static const int GLYPH_COUNT = 256;
+
+         /** The metrics of a glyph, and where it sits in the atlas. */
+         struct Glyph
+         {
+            /** The glyph's bounding box, relative to the pen position and baseline. */
+            int minX, maxX, minY, maxY;
+
+            /** The distance to advance the pen after the glyph. */
+            int advance;
+
+            /** The top-left corner of the glyph's cell in the atlas. */
+            int atlasX, atlasY;
+
+            /** The size of the glyph's cell in the atlas. */
+            int cellWidth, cellHeight;
+
+            /** The size of the rasterized glyph within its cell. */
+            int width, height;
+
+            /** Whether or not the glyph has been rasterized into the atlas. */
+            bool rasterized;
+         };
+
+         /** The metrics and atlas cells of each glyph. */
+         Glyph mGlyphs[GLYPH_COUNT];
+
+         /** The kerning between pairs of glyphs that have been measured so far, keyed by (first << 8) | second. */
+         mutable std::map<unsigned int, int> mKerning;
+
+         /** The glyph atlas texture, or 0 if it hasn't been created yet. */
+         GLuint mAtlasTexture;
+
+         /** The width of the glyph atlas texture. */
+         int mAtlasWidth;
+
+         /** The height of the glyph atlas texture. */
+         int mAtlasHeight;
+
+         /**
+          * Reads the metrics of every glyph, and lays out their cells in the atlas.
+          */
+         void layOutGlyphs();
+
+         /**
+          * Renders a glyph and copies it into its cell in the atlas.
+          *
+          * @param ch the character of the glyph.
+          */
+         void rasterizeGlyph(unsigned char ch);
+
+         /**
+          * Gets the kerning between two glyphs, measuring it the first time the pair is seen.
+          *
+          * @param first the character of the first glyph.
+          * @param second the character of the glyph following it.
+          *
+          * @return the adjustment to the pen position between the two glyphs.
+          */
+         int getKerning(unsigned char first, unsigned char second) const;
+
+         /**
+          * Measures text the same way SDL_ttf does, from the glyph metrics.
+          *
+          * @param text the text to measure.
+          * @param useKerning true if the kerning between glyphs should be applied.
+          *
+          * @return the width of the text.
+          */
+         int measureText(const std::string& text, bool useKerning) const;
    }; 
 }
 
@@ -5,20 +5,46 @@
  */
 
 #include "StringListModel.h"
+#include <sstream>
 #include "DebugUtils.h"
 
 const int debugFlag = DEBUG_EDWT;
 
 namespace edwt
 {
+   StringListModel::ListItem::ListItem(const std::string& label, int action) : actionFlag(action)
+   {
+      // The columns are split once here, instead of by the list box whenever it lays the item out
+      std::stringstream labelText(label);
+      std::string column;
+      while(std::getline(labelText, column, '\t'))
+      {
+         columns.push_back(column);
+      }
+   }
+
+   StringListModel::StringListModel() : revision(0)
+   {
+   }
+
    int StringListModel::getNumberOfElements()
    {
       return listOps.size();
    }
 
-   std::string StringListModel::getElementAt(int i)
+   unsigned int StringListModel::getNumberOfColumnsAt(int i)
+   {
+      return listOps[i].columns.size();
+   }
+
+   const std::string& StringListModel::getColumnAt(int i, unsigned int column)
+   {
+      return listOps[i].columns[column];
+   }
+
+   unsigned int StringListModel::getRevision() const
    {
-      return listOps[i].name;
+      return revision;
    }
     
    int StringListModel::getActionAt(int i)
@@ -29,10 +55,12 @@ namespace edwt
    void StringListModel::add(const std::string& label, int a)
    {
       listOps.push_back(ListItem(label,a));
+      ++revision;
    }
     
    void StringListModel::clear()
    {
       listOps.clear();
+      ++revision;
    }
 };
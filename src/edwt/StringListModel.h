@@ -7,7 +7,8 @@
 #ifndef STRING_LIST_MODEL_H
 #define STRING_LIST_MODEL_H
 
-#include "guichan.hpp"
+#include "ColumnListModel.h"
+#include <string>
 #include <vector>
 
 namespace edwt
@@ -20,7 +21,7 @@ namespace edwt
     *
     * @author Noam Chitayat
     */
-   class StringListModel : public gcn::ListModel
+   class StringListModel : public ColumnListModel
    {
       /**
        * A list item holds both a name and an associated action flag.
@@ -29,20 +30,27 @@ namespace edwt
        */
       struct ListItem
       {
-         /** The name of the option */
-         std::string name;
+         /** The name of the option, split into columns at its tab characters */
+         std::vector<std::string> columns;
 
          /** The action associated with the option */
          int actionFlag;
 
          /** Constructor. */
-         ListItem(const std::string& label, int action) : name(label), actionFlag(action) {}
+         ListItem(const std::string& label, int action);
       };
 
       /** The string items (and associated action flags) in the list */ 
       std::vector<ListItem> listOps;
 
+      /** The number of times that items have been added or cleared */
+      unsigned int revision;
+
       public:
+         /**
+          * Constructor.
+          */
+         StringListModel();
 
          /**
           * @return the number of items in this list model
@@ -51,9 +59,21 @@ namespace edwt
 
          /**
           * @param i the index of a list item
-          * @return the list item at index i
+          * @return the number of columns in the list item at index i
+          */
+         unsigned int getNumberOfColumnsAt(int i);
+
+         /**
+          * @param i the index of a list item
+          * @param column the index of a column in the list item
+          * @return the text of the column
+          */
+         const std::string& getColumnAt(int i, unsigned int column);
+
+         /**
+          * @return the number of times that items have been added or cleared
           */
-         std::string getElementAt(int i);
+         unsigned int getRevision() const;
 
          /**
           * @param i the index of a list item
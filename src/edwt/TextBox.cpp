@@ -9,6 +9,7 @@
 #include <SDL.h>
 #include "SDL_mixer.h"
 #include "StringListModel.h"
+#include <algorithm>
 
 const int debugFlag = DEBUG_EDWT;
 
@@ -35,9 +36,16 @@ namespace edwt
       graphics->setColor(getForegroundColor());
       graphics->setFont(getFont());
    
-      for (unsigned int i = 0; i < mTextRows.size(); i++)
+      mRowLayouts.resize(mTextRows.size());
+      std::string::size_type remaining = mRevealedLength;
+      for (unsigned int i = 0; i < mTextRows.size() && remaining > 0; i++)
       {
-         graphics->drawText(mTextRows[i], determineX(mTextRows[i]), i * getFont()->getHeight());
+         mRowLayouts[i].setFont(getFont());
+         mRowLayouts[i].setText(mTextRows[i]);
+         mRowLayouts[i].draw(graphics, determineX(mRowLayouts[i].getWidth()), i * getFont()->getHeight(), remaining);
+
+         // The row's characters and the break after it are used up
+         remaining -= std::min(remaining, mTextRows[i].length() + 1);
       }
    }
    
@@ -59,17 +67,17 @@ namespace edwt
       if(getHeight() < minHeight) setHeight(minHeight);
    }
    
-   int TextBox::determineX(const std::string& text)
+   int TextBox::determineX(int textWidth)
    {
       switch(align)
       {
          case CENTER:
          {
-            return (getWidth() - getFont()->getWidth(text)) / 2;
+            return (getWidth() - textWidth) / 2;
          }
          case RIGHT:
          {
-            return (getWidth() - getFont()->getWidth(text)) - 1;
+            return (getWidth() - textWidth) - 1;
          }
          case LEFT:
          default:
@@ -98,4 +106,9 @@ namespace edwt
    {
       return align;
    }
+
+   void TextBox::setRevealedLength(std::string::size_type length)
+   {
+      mRevealedLength = length;
+   }
 };
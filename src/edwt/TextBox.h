@@ -9,6 +9,7 @@
 
 #include "guichan.hpp"
 #include "TextAlignment.h"
+#include "TextLayout.h"
 
 namespace edwt
 {
@@ -26,8 +27,14 @@ namespace edwt
          /** The text color of the TextBox */
          gcn::Color textColor;
 
-         /** Determine the point in the x-axis where the text begins */
-         int determineX(const std::string& text);
+         /** The laid out text rows, which are only redone when a row's text or the font changes */
+         std::vector<TextLayout> mRowLayouts;
+
+         /** The number of characters of the text that are drawn, counting the breaks between rows */
+         std::string::size_type mRevealedLength;
+
+         /** Determine the point in the x-axis where a row of text of the given width begins */
+         int determineX(int textWidth);
 
       protected:
          /**
@@ -44,7 +51,7 @@ namespace edwt
           *
           * Text is left-aligned by default.
           */
-         TextBox() : align(LEFT) {}
+         TextBox() : align(LEFT), mRevealedLength(std::string::npos) {}
 
          /**
           * Scroll to the bottom row of the text box.
@@ -61,6 +68,16 @@ namespace edwt
           */
          TextAlignment getAlignment();
 
+         /**
+          * Sets how much of the text is drawn, so that text can be revealed a character at a time.
+          * The text is still laid out in full (there is no need to set it again as it is revealed),
+          * so the revealed characters stay where they will be once the rest of the text shows up.
+          *
+          * @param length The number of characters to draw, counting each break between rows
+          *               (std::string::npos to draw all of the text).
+          */
+         void setRevealedLength(std::string::size_type length);
+
          /**
           * Border drawing is overridden to prevent drawing
           * when the text box is transparent.
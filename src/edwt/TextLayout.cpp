@@ -0,0 +1,116 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#include "TextLayout.h"
+#include <algorithm>
+
+#include "DebugUtils.h"
+const int debugFlag = DEBUG_EDWT;
+
+namespace edwt
+{
+   TextLayout::TextLayout() : mFont(NULL), mTrueTypeFont(NULL), mWidth(0), mValid(false)
+   {
+   }
+
+   void TextLayout::setFont(gcn::Font* font)
+   {
+      if(font != mFont)
+      {
+         mFont = font;
+         mTrueTypeFont = dynamic_cast<OpenGLTrueTypeFont*>(font);
+         mValid = false;
+      }
+   }
+
+   void TextLayout::setText(const std::string& text)
+   {
+      if(text != mText)
+      {
+         mText = text;
+         mValid = false;
+      }
+   }
+
+   const std::string& TextLayout::getText() const
+   {
+      return mText;
+   }
+
+   void TextLayout::layOut()
+   {
+      mLines.clear();
+      mWidth = 0;
+      mValid = true;
+
+      if(mFont == NULL) return;
+
+      std::string::size_type lineStart = 0;
+      for(;;)
+      {
+         const std::string::size_type lineEnd = mText.find('\n', lineStart);
+
+         mLines.push_back(Line());
+         Line& line = mLines.back();
+         line.text = mText.substr(lineStart, lineEnd == std::string::npos ? std::string::npos : lineEnd - lineStart);
+
+         if(mTrueTypeFont != NULL)
+         {
+            mTrueTypeFont->shapeText(line.text, line.glyphRun);
+            line.width = line.glyphRun.width;
+         }
+         else
+         {
+            line.width = mFont->getWidth(line.text);
+         }
+
+         mWidth = std::max(mWidth, line.width);
+
+         if(lineEnd == std::string::npos) break;
+         lineStart = lineEnd + 1;
+      }
+   }
+
+   int TextLayout::getWidth()
+   {
+      if(!mValid) layOut();
+      return mWidth;
+   }
+
+   int TextLayout::getLineCount()
+   {
+      if(!mValid) layOut();
+      return mLines.size();
+   }
+
+   void TextLayout::draw(gcn::Graphics* graphics, int x, int y, std::string::size_type length)
+   {
+      if(!mValid) layOut();
+      if(mFont == NULL) return;
+
+      const int lineHeight = mFont->getHeight();
+      for(std::vector<Line>::iterator iter = mLines.begin(); iter != mLines.end() && length > 0; ++iter)
+      {
+         const std::string::size_type lineLength = std::min(length, iter->text.length());
+         if(mTrueTypeFont != NULL)
+         {
+            mTrueTypeFont->drawGlyphRun(graphics, iter->glyphRun, x, y, lineLength);
+         }
+         else if(lineLength == iter->text.length())
+         {
+            mFont->drawString(graphics, iter->text, x, y);
+         }
+         else
+         {
+            mFont->drawString(graphics, iter->text.substr(0, lineLength), x, y);
+         }
+
+         // The line's characters and the '\n' after it are used up
+         length -= std::min(length, iter->text.length() + 1);
+         y += lineHeight;
+      }
+   }
+};
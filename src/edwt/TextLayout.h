@@ -0,0 +1,112 @@
+/*
+ *  This file is covered by the Ruby license. See LICENSE.txt for more details.
+ *
+ *  Copyright (C) 2007-2012 Noam Chitayat. All rights reserved.
+ */
+
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include "guichan.hpp"
+#include "OpenGLTTF.h"
+#include <string>
+#include <vector>
+
+namespace edwt
+{
+   /**
+    * A block of text laid out ahead of time, for widgets that draw the same text every frame.
+    * The text is split into lines, and each line is measured (and, with an OpenGL TrueType font,
+    * has its glyphs positioned) the first time it is needed. The layout is only redone
+    * once the text or the font changes, so setting the same text again every frame is cheap.
+    */
+   class TextLayout
+   {
+      /** A line of the laid out text. */
+      struct Line
+      {
+         /** The text of the line. */
+         std::string text;
+
+         /** The width of the line (in pixels). */
+         int width;
+
+         /** The positioned glyphs of the line, if the font is an OpenGL TrueType font. */
+         OpenGLTrueTypeFont::GlyphRun glyphRun;
+      };
+
+      /** The font that the text is laid out with. */
+      gcn::Font* mFont;
+
+      /** The font, if it is an OpenGL TrueType font (NULL otherwise). */
+      OpenGLTrueTypeFont* mTrueTypeFont;
+
+      /** The text to lay out. */
+      std::string mText;
+
+      /** The lines of the text. */
+      std::vector<Line> mLines;
+
+      /** The width of the widest line (in pixels). */
+      int mWidth;
+
+      /** Whether or not the lines are up to date with the text and font. */
+      bool mValid;
+
+      /**
+       * Splits the text into lines and measures them.
+       */
+      void layOut();
+
+      public:
+         /**
+          * Constructor.
+          */
+         TextLayout();
+
+         /**
+          * Sets the font to lay out the text with.
+          * The text is only laid out again if the font has changed.
+          *
+          * @param font The font to use.
+          */
+         void setFont(gcn::Font* font);
+
+         /**
+          * Sets the text to lay out. Lines are separated by '\n'.
+          * The text is only laid out again if it has changed.
+          *
+          * @param text The text to lay out.
+          */
+         void setText(const std::string& text);
+
+         /**
+          * @return The text being laid out.
+          */
+         const std::string& getText() const;
+
+         /**
+          * @return The width of the widest line of text (in pixels).
+          */
+         int getWidth();
+
+         /**
+          * @return The number of lines of text.
+          */
+         int getLineCount();
+
+         /**
+          * Draws the text, one line under the other, with the graphics object's current color.
+          * Only the start of the text can be drawn, so that it can be revealed a character at a time
+          * without laying it out again.
+          *
+          * @param graphics The graphics driver to draw with.
+          * @param x The x-coordinate of the left edge of the text.
+          * @param y The y-coordinate of the top of the first line.
+          * @param length The number of characters of the text to draw, counting each '\n' (all of them, by default).
+          */
+         void draw(gcn::Graphics* graphics, int x, int y, std::string::size_type length = std::string::npos);
+   };
+};
+
+#endif
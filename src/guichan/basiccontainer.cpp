@@ -70,6 +70,7 @@ namespace gcn
             {
                 mWidgets.erase(iter);
                 mWidgets.push_back(widget);
+                geometryChanged();
                 return;
             }
         }
@@ -88,6 +89,7 @@ namespace gcn
         }
         mWidgets.erase(iter);
         mWidgets.push_front(widget);
+        geometryChanged();
     }
 
     void BasicContainer::death(const Event& event)
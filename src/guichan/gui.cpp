@@ -74,7 +74,12 @@ namespace gcn
              mLastMouseX(0),
              mLastMouseY(0),
              mClickCount(1),
-             mLastMouseDragButton(0)
+             mLastMouseDragButton(0),
+             mWidgetAtValid(false),
+             mWidgetAtX(0),
+             mWidgetAtY(0),
+             mWidgetAt(NULL),
+             mWidgetAtRevision(0)
     {
         mFocusHandler = new FocusHandler();
     }
@@ -101,6 +106,7 @@ namespace gcn
         }
 
         mTop = top;
+        mWidgetAtValid = false;
     }
 
     Widget* Gui::getTop() const
@@ -624,20 +630,41 @@ namespace gcn
 
     Widget* Gui::getWidgetAt(int x, int y)
     {
-        // If the widget's parent has no child then we have found the widget..
-        Widget* parent = mTop;
-        Widget* child = mTop;
+        // A single mouse input looks up the same position several times, and
+        // nothing can have moved in between unless the geometry revision says so.
+        if (mWidgetAtValid
+            && mWidgetAtX == x
+            && mWidgetAtY == y
+            && mWidgetAtRevision == Widget::getGeometryRevision())
+        {
+            return mWidgetAt;
+        }
+
+        Widget* widget = mTop;
+        int widgetX, widgetY;
+        mTop->getAbsolutePosition(widgetX, widgetY);
 
+        // If the widget has no child at the position then we have found the widget.
+        Widget* child = widget->getWidgetAt(x - widgetX, y - widgetY);
         while (child != NULL)
         {
-            Widget* swap = child;
-            int parentX, parentY;
-            parent->getAbsolutePosition(parentX, parentY);
-            child = parent->getWidgetAt(x - parentX, y - parentY);
-            parent = swap;
+            // Work out the child's absolute position from its parent's
+            // rather than walking back up to the top for every level.
+            const Rectangle childrenArea = widget->getChildrenArea();
+            widgetX += childrenArea.x + child->getX();
+            widgetY += childrenArea.y + child->getY();
+
+            widget = child;
+            child = widget->getWidgetAt(x - widgetX, y - widgetY);
         }
 
-        return parent;
+        mWidgetAtValid = true;
+        mWidgetAtX = x;
+        mWidgetAtY = y;
+        mWidgetAt = widget;
+        mWidgetAtRevision = Widget::getGeometryRevision();
+
+        return widget;
     }
 
     Widget* Gui::getMouseEventSource(int x, int y)
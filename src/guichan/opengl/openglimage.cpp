@@ -49,63 +49,92 @@
 
 #include "guichan/exception.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+#ifdef __BIG_ENDIAN__
+    const unsigned int magicPink = 0xff00ffff;
+#else
+    const unsigned int magicPink = 0xffff00ff;
+#endif
+
+    // Without this extension, every texture has to be padded out to powers of two
+    bool hasNonPowerOfTwoTextures()
+    {
+        static int supported = -1;
+        if (supported == -1)
+        {
+            const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+            if (extensions == NULL)
+            {
+                // There is no context to ask yet, so ask again next time
+                return false;
+            }
+
+            supported = strstr(extensions, "GL_ARB_texture_non_power_of_two") != NULL ? 1 : 0;
+        }
+
+        return supported == 1;
+    }
+
+    int nextPowerOfTwo(int size)
+    {
+        int powerOfTwo = 1;
+        while(powerOfTwo < size)
+        {
+            powerOfTwo *= 2;
+        }
+
+        return powerOfTwo;
+    }
+}
+
 namespace gcn
 {
     OpenGLImage::OpenGLImage(const unsigned int* pixels, int width, int height,
                              bool convertToDisplayFormat)
     {
         mAutoFree = true;
+        mPixels = NULL;
 
         mWidth = width;
         mHeight = height;
-        mTextureWidth = 1, mTextureHeight = 1;
+        setTextureSize();
 
-        while(mTextureWidth < mWidth)
-        {
-            mTextureWidth *= 2;
-        }
+        const unsigned int* pixelsEnd = pixels + mWidth * mHeight;
 
-        while(mTextureHeight < mHeight)
+        if (!convertToDisplayFormat)
         {
-            mTextureHeight *= 2;
-        }
-
-        // Create a new pixel array and copy the pixels into it
-        mPixels = new unsigned int[mTextureWidth * mTextureHeight];
+            // Keep a copy of the pixels around for getPixel and putPixel
+            mPixels = new unsigned int[mTextureWidth * mTextureHeight];
+            std::fill(mPixels, mPixels + mTextureWidth * mTextureHeight, 0x00000000u);
 
-#ifdef __BIG_ENDIAN__
-        const unsigned int magicPink = 0xff00ffff;
-#else
-        const unsigned int magicPink = 0xffff00ff;
-#endif
-        int x, y;
-        for (y = 0; y < mTextureHeight; y++)
-        {
-            for (x = 0; x < mTextureWidth; x++)
+            for (int y = 0; y < mHeight; y++)
             {
-                if (x < mWidth && y < mHeight)
-                {
-                    unsigned int c = pixels[x + y * mWidth];
-
-                    // Magic pink to transparent
-                    if (c == magicPink)
-                    {
-                        c = 0x00000000;
-                    }
-
-                    mPixels[x + y * mTextureWidth] = c;
-                }
-                else
-                {
-                    mPixels[x + y * mTextureWidth] = 0x00000000;
-                }
+                unsigned int* row = mPixels + y * mTextureWidth;
+                std::copy(pixels + y * mWidth, pixels + (y + 1) * mWidth, row);
+
+                // Magic pink to transparent
+                std::replace(row, row + mWidth, magicPink, 0x00000000u);
             }
+
+            return;
         }
 
-        if (convertToDisplayFormat)
+        // Most images have no magic pink, and those are uploaded without copying them at all
+        if (std::find(pixels, pixelsEnd, magicPink) == pixelsEnd)
         {
-            OpenGLImage::convertToDisplayFormat();
+            uploadTexture(pixels, mWidth);
+            return;
         }
+
+        // Magic pink to transparent
+        std::vector<unsigned int> keyedPixels(pixels, pixelsEnd);
+        std::replace(keyedPixels.begin(), keyedPixels.end(), magicPink, 0x00000000u);
+        uploadTexture(&keyedPixels[0], mWidth);
     }
 
     OpenGLImage::OpenGLImage(GLuint textureHandle, int width, int height, bool autoFree)
@@ -114,19 +143,11 @@ namespace gcn
         mAutoFree = autoFree;
         mPixels = NULL;
 
+        // The texture was made elsewhere, so it can't be known to be any other size
         mWidth = width;
         mHeight = height;
-        mTextureWidth = 1, mTextureHeight = 1;
-
-        while(mTextureWidth < mWidth)
-        {
-            mTextureWidth *= 2;
-        }
-
-        while(mTextureHeight < mHeight)
-        {
-            mTextureHeight *= 2;
-        }
+        mTextureWidth = nextPowerOfTwo(mWidth);
+        mTextureHeight = nextPowerOfTwo(mHeight);
     }
 
     OpenGLImage::~OpenGLImage()
@@ -232,25 +253,83 @@ namespace gcn
             throw GCN_EXCEPTION("Image has already been converted to display format");
         }
 
+        // Stop the pixels leaking if the upload throws
+        unsigned int* pixels = mPixels;
+        mPixels = NULL;
+
+        try
+        {
+            uploadTexture(pixels, mTextureWidth);
+        }
+        catch (...)
+        {
+            delete[] pixels;
+            throw;
+        }
+
+        delete[] pixels;
+    }
+
+    void OpenGLImage::setTextureSize()
+    {
+        if (hasNonPowerOfTwoTextures())
+        {
+            mTextureWidth = mWidth;
+            mTextureHeight = mHeight;
+        }
+        else
+        {
+            mTextureWidth = nextPowerOfTwo(mWidth);
+            mTextureHeight = nextPowerOfTwo(mHeight);
+        }
+    }
+
+    void OpenGLImage::uploadTexture(const unsigned int* pixels, int rowLength)
+    {
         glGenTextures(1, &mTextureHandle);
         glBindTexture(GL_TEXTURE_2D, mTextureHandle);
 
-        glTexImage2D(GL_TEXTURE_2D,
-                     0,
-                     4,
-                     mTextureWidth,
-                     mTextureHeight,
-                     0,
-                     GL_RGBA,
-                     GL_UNSIGNED_BYTE,
-                     mPixels);
+        if (mTextureWidth == mWidth && mTextureHeight == mHeight && rowLength == mWidth)
+        {
+            glTexImage2D(GL_TEXTURE_2D,
+                         0,
+                         4,
+                         mTextureWidth,
+                         mTextureHeight,
+                         0,
+                         GL_RGBA,
+                         GL_UNSIGNED_BYTE,
+                         pixels);
+        }
+        else
+        {
+            // Only the image is uploaded, so its rows are read right out of the array and the padding is left undefined
+            glTexImage2D(GL_TEXTURE_2D,
+                         0,
+                         4,
+                         mTextureWidth,
+                         mTextureHeight,
+                         0,
+                         GL_RGBA,
+                         GL_UNSIGNED_BYTE,
+                         NULL);
+
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+            glTexSubImage2D(GL_TEXTURE_2D,
+                            0,
+                            0,
+                            0,
+                            mWidth,
+                            mHeight,
+                            GL_RGBA,
+                            GL_UNSIGNED_BYTE,
+                            pixels);
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        }
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-        delete[] mPixels;
-        mPixels = NULL;
-
         GLenum error = glGetError();
         if (error)
         {
@@ -67,6 +67,7 @@ namespace gcn
     Font* Widget::mGlobalFont = NULL;
     DefaultFont Widget::mDefaultFont;
     std::list<Widget*> Widget::mWidgets;
+    unsigned int Widget::mGeometryRevision = 0;
 
     Widget::Widget()
             : mForegroundColor(0x000000),
@@ -100,6 +101,7 @@ namespace gcn
         _setFocusHandler(NULL);
 
         mWidgets.remove(this);
+        geometryChanged();
     }
 
     void Widget::drawFrame(Graphics* graphics)
@@ -129,6 +131,7 @@ namespace gcn
     void Widget::_setParent(Widget* parent)
     {
         mParent = parent;
+        geometryChanged();
     }
 
     Widget* Widget::getParent() const
@@ -202,6 +205,14 @@ namespace gcn
         Rectangle oldDimension = mDimension;
         mDimension = dimension;
 
+        if (mDimension.x != oldDimension.x
+            || mDimension.y != oldDimension.y
+            || mDimension.width != oldDimension.width
+            || mDimension.height != oldDimension.height)
+        {
+            geometryChanged();
+        }
+
         if (mDimension.width != oldDimension.width
             || mDimension.height != oldDimension.height)
         {
@@ -218,6 +229,7 @@ namespace gcn
     void Widget::setFrameSize(unsigned int frameSize)
     {
         mFrameSize = frameSize;
+        geometryChanged();
     }
 
     unsigned int Widget::getFrameSize() const
@@ -310,6 +322,11 @@ namespace gcn
             distributeHiddenEvent();
         }
 
+        if (mVisible != visible)
+        {
+            geometryChanged();
+        }
+
         mVisible = visible;
     }
 
@@ -515,6 +532,16 @@ namespace gcn
         return result;
     }
 
+    unsigned int Widget::getGeometryRevision()
+    {
+        return mGeometryRevision;
+    }
+
+    void Widget::geometryChanged()
+    {
+        ++mGeometryRevision;
+    }
+
     bool Widget::isTabInEnabled() const
     {
         return mTabIn;
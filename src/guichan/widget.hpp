@@ -690,6 +690,17 @@ namespace gcn
          */
         static bool widgetExists(const Widget* widget);
 
+        /**
+         * Gets the revision of the geometry of all widgets. The revision
+         * changes whenever a widget is moved, resized, shown, hidden,
+         * reordered, added to or removed from a container or deleted,
+         * so anything worked out from where the widgets are can be kept
+         * until it changes.
+         *
+         * @return The revision of the geometry of all widgets.
+         */
+        static unsigned int getGeometryRevision();
+
         /**
          * Checks if tab in is enabled. Tab in means that you can set focus
          * to this widget by pressing the tab button. If tab in is disabled
@@ -1000,6 +1011,15 @@ namespace gcn
          */
         void distributeShownEvent();
 
+        /**
+         * Marks the geometry of the widgets as changed. Widgets that
+         * change their children area or the order of their children
+         * should call this.
+         *
+         * @see getGeometryRevision
+         */
+        static void geometryChanged();
+
         /**
          * Typdef.
          */
@@ -1188,6 +1208,11 @@ namespace gcn
          * Holds a list of all instances of widgets.
          */
         static std::list<Widget*> mWidgets;
+
+        /**
+         * Holds the revision of the geometry of all widgets.
+         */
+        static unsigned int mGeometryRevision;
     };
 }
 
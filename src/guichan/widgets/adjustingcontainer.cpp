@@ -63,7 +63,8 @@ namespace gcn
                   mPaddingTop(0),
                   mPaddingBottom(0),
                   mVerticalSpacing(0),
-                  mHorizontalSpacing(0)
+                  mHorizontalSpacing(0),
+                  mLayoutDirty(true)
             
             
         {
@@ -79,6 +80,7 @@ namespace gcn
         void AdjustingContainer::setNumberOfColumns(unsigned int numberOfColumns)
         {
             mNumberOfColumns = numberOfColumns;
+            mLayoutDirty = true;
         
             if (mColumnAlignment.size() < numberOfColumns)
             {
@@ -102,6 +104,7 @@ namespace gcn
             if (column < mColumnAlignment.size())
             {
                 mColumnAlignment[column] = alignment;
+                mLayoutDirty = true;
             }
         }
 
@@ -114,16 +117,19 @@ namespace gcn
             mPaddingRight = paddingRight;
             mPaddingTop = paddingTop;
             mPaddingBottom = paddingBottom;
+            mLayoutDirty = true;
         }
 
         void AdjustingContainer::setVerticalSpacing(unsigned int verticalSpacing)
         {
             mVerticalSpacing = verticalSpacing;
+            mLayoutDirty = true;
         }
 
         void AdjustingContainer::setHorizontalSpacing(unsigned int horizontalSpacing)
         {
             mHorizontalSpacing = horizontalSpacing;
+            mLayoutDirty = true;
         }
 
         void AdjustingContainer::logic()
@@ -136,6 +142,10 @@ namespace gcn
         {
             Container::add(widget);
             mContainedWidgets.push_back(widget);
+
+            // The columns and rows have to be measured again whenever a widget changes size
+            widget->addWidgetListener(this);
+            mLayoutDirty = true;
         }
     
         void AdjustingContainer::add(Widget *widget, int x, int y)
@@ -145,8 +155,15 @@ namespace gcn
     
         void AdjustingContainer::clear()
         {
+            std::vector<gcn::Widget *>::iterator it;
+            for(it = mContainedWidgets.begin(); it != mContainedWidgets.end(); it++)
+            {
+                (*it)->removeWidgetListener(this);
+            }
+
             Container::clear();
             mContainedWidgets.clear();
+            mLayoutDirty = true;
         }
 
         void AdjustingContainer::remove(Widget *widget)
@@ -157,7 +174,9 @@ namespace gcn
             {
                 if(*it == widget)
                 {
+                    widget->removeWidgetListener(this);
                     mContainedWidgets.erase(it);
+                    mLayoutDirty = true;
                     break;
                 }
             }
@@ -223,8 +242,35 @@ namespace gcn
             setWidth(mWidth);
         }
 
+        void AdjustingContainer::death(const Event& event)
+        {
+            Container::death(event);
+
+            // A deleted widget can't be told to stop listening, and mustn't be arranged again
+            std::vector<gcn::Widget *>::iterator it;
+            for(it = mContainedWidgets.begin(); it != mContainedWidgets.end(); it++)
+            {
+                if(*it == event.getSource())
+                {
+                    mContainedWidgets.erase(it);
+                    mLayoutDirty = true;
+                    break;
+                }
+            }
+        }
+
+        void AdjustingContainer::widgetResized(const Event& event)
+        {
+            mLayoutDirty = true;
+        }
+
         void AdjustingContainer::adjustContent()
         {
+            if (!mLayoutDirty)
+            {
+                return;
+            }
+
             adjustSize();
 
             unsigned int columnCount = 0;
@@ -274,6 +320,8 @@ namespace gcn
                     rowCount++;
                 }
             }
+
+            mLayoutDirty = false;
         }
     }
 }
@@ -815,6 +815,10 @@ namespace gcn
         int w = getWidth();
         int h = getHeight();
 
+        // The scroll bars take their room out of the children area
+        const bool hBarWasVisible = mHBarVisible;
+        const bool vBarWasVisible = mVBarVisible;
+
         mHBarVisible = false;
         mVBarVisible = false;
 
@@ -852,6 +856,11 @@ namespace gcn
                 mHBarVisible = true;
             }
 
+            if (mHBarVisible != hBarWasVisible || mVBarVisible != vBarWasVisible)
+            {
+                geometryChanged();
+            }
+
             return;
         }
 
@@ -903,6 +912,11 @@ namespace gcn
           default:
               throw GCN_EXCEPTION("Vertical scroll policy invalid.");
         }
+
+        if (mHBarVisible != hBarWasVisible || mVBarVisible != vBarWasVisible)
+        {
+            geometryChanged();
+        }
     }
 
     Rectangle ScrollArea::getUpButtonDimension()
@@ -86,6 +86,7 @@ namespace gcn
     void Window::setPadding(unsigned int padding)
     {
         mPadding = padding;
+        geometryChanged();
     }
 
     unsigned int Window::getPadding() const
@@ -96,6 +97,7 @@ namespace gcn
     void Window::setTitleBarHeight(unsigned int height)
     {
         mTitleBarHeight = height;
+        geometryChanged();
     }
 
     unsigned int Window::getTitleBarHeight()
@@ -5,13 +5,31 @@
  */
 
 #include "GraphicsUtil.h"
+#include "AudioSystem.h"
 #include "ScriptEngine.h"
 #include "ExecutionStack.h"
 #include "MainMenu.h"
+#include "TileEngine.h"
 #include "ResourceLoader.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "AssetArchive.h"
+#include "StringTable.h"
+#include "SaveGameWriter.h"
+#include "InputReplay.h"
+#include "RandomStreams.h"
+#include "StartupTimeline.h"
+#include "FrameProfiler.h"
+#include "ProfileServer.h"
+#include "ScriptSampler.h"
+#include "EngineClock.h"
+#include "Pathfinder.h"
 #include "guichan.hpp"
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "SDL.h"
 
@@ -22,41 +40,308 @@ const int debugFlag = DEBUG_MAIN;
  * The main function.
  * Creates the graphics utilities, pushes a title screen onto the ExecutionStack,
  * and executes it. Afterwards, destroys graphics utilities and we're done.
+ *
+ * Usage: eden [--headless] [--audio <rate>:<buffer>:<channels>] [--frames <count>] [--render-scale <scale>[:<budget>]] [--no-pipelining] [--chapter <name>] [--archive <path>] [--loose-files] [--watch] [--trace-resources] [--record <path>] [--replay <path>] [--language <name>] [--log <level>[:<categories>]] [--hitches <threshold>[:<frames>]] [--time-scale <factor>] [--pathfinding <jps|astar>] [--profile-server <port>] [--sample-scripts <instructions>]
+ *
+ * --headless draws into an offscreen buffer instead of a window, without capping the frame rate.
+ * --audio sets the sample rate (in Hz), buffer size (in samples) and output channels of the audio device (such as --audio 48000:256:2).
+ * Smaller buffers play sounds sooner; if the device rejects the buffer, larger ones are tried until it opens.
+ * --frames stops the game after drawing a number of frames, and reports how long they took (and how long each phase of startup took).
+ * --render-scale draws the map and its actors at a fraction of the screen's resolution (from 0.5 to 1), stretched over the screen
+ * under the GUI, which is still drawn at the screen's resolution. With a budget (in milliseconds), the fraction drops while the GPU
+ * takes longer than the budget to draw each frame, and comes back up once it catches up (such as --render-scale 1:12).
+ * --no-pipelining shows each frame as soon as it is drawn, instead of after the next frame's logic has run
+ * (which overlaps the logic with the GPU's drawing, at the cost of a frame of latency).
+ * --chapter skips the title screen and starts the game at a chapter.
+ * Together, these let whole game loops be timed on machines without a display.
+ *
+ * --archive reads the game's data out of a packed asset archive (by default, data.edp, if there is one).
+ * --loose-files uses loose files in data/ ahead of the archived ones, so that edits show up without repacking.
+ * --watch reloads tilesets, spritesheets and sounds as soon as their files in data/ are edited (and implies --loose-files).
+ * --trace-resources records the resources used on each map into the prefetch manifest (data/prefetch.edm) as the game is played,
+ * so that later runs can load them ahead of time.
+ *
+ * --record writes the player's input (and the seed of the game's random numbers) to a file as the game is played.
+ * --replay plays a recorded session back in place of the player's input, and stops the game where the recording stopped.
+ * Together with --chapter (and --headless), these let the same session of play be timed in different builds.
+ * --language sets the language (by default, en) whose string table (in data/strings/) the game's text is shown from.
+ * --log sets the level (error, warning, info or trace) that the engine logs at, for all categories or for a comma-separated list
+ * of them (such as --log trace:scheduler,pathfinder). It can be given more than once.
+ * --hitches watches for frames that take longer than a threshold (in milliseconds), and writes the frames leading up to each one
+ * (by default, the last 60) to hitch-<number>.json, with the zones, resource loads, script resumes and garbage collection in each
+ * (such as --hitches 50:120).
+ * --time-scale runs the game's time at a multiple of real time (such as --time-scale 10 to fast-forward a session ten times over).
+ * --pathfinding sets the search (jump point search or A*) that rerouted paths are found with on maps that don't name one.
+ * --profile-server streams each frame's zones, counters and memory use to a profile viewer connected to a port on the loopback address
+ * (such as --profile-server 8086), so that builds without a console can be profiled as they run.
+ * --sample-scripts samples the call stacks of the running scripts every so many Lua instructions (such as --sample-scripts 1000),
+ * and writes them out as collapsed stacks (for a flame graph) to script_samples.folded once the game exits.
  */
 int main (int argc, char *argv[])
 {  
+   int frameLimit = 0;
+   bool pipelined = true;
+   const char* chapterName = NULL;
+   const char* archivePath = NULL;
+   const char* language = "en";
+   bool watchFiles = false;
+   bool traceResources = false;
+   const char* recordPath = NULL;
+   const char* replayPath = NULL;
+   double hitchThreshold = 0;
+   int profileServerPort = 0;
+   int scriptSampleInterval = 0;
+
+   // A second of frames at 60 frames per second covers whatever set the hitch off, such as a request that came due
+   int hitchFrames = 60;
+   for(int argNum = 1; argNum < argc; ++argNum)
+   {
+      if(strcmp(argv[argNum], "--headless") == 0)
+      {
+         GraphicsUtil::setHeadless(true);
+         AudioSystem::setHeadless(true);
+      }
+      else if(strcmp(argv[argNum], "--audio") == 0 && argNum + 1 < argc)
+      {
+         int rate = AudioSystem::DEFAULT_SAMPLE_RATE;
+         int buffer = AudioSystem::DEFAULT_BUFFER_SIZE;
+         int channels = AudioSystem::DEFAULT_OUTPUT_CHANNELS;
+         sscanf(argv[++argNum], "%d:%d:%d", &rate, &buffer, &channels);
+         AudioSystem::configure(rate, buffer, channels);
+      }
+      else if(strcmp(argv[argNum], "--frames") == 0 && argNum + 1 < argc)
+      {
+         frameLimit = atoi(argv[++argNum]);
+      }
+      else if(strcmp(argv[argNum], "--render-scale") == 0 && argNum + 1 < argc)
+      {
+         float scale = 1.0f;
+         double budget = 0.0;
+         sscanf(argv[++argNum], "%f:%lf", &scale, &budget);
+         GraphicsUtil::configureSceneScale(scale, budget);
+      }
+      else if(strcmp(argv[argNum], "--no-pipelining") == 0)
+      {
+         pipelined = false;
+      }
+      else if(strcmp(argv[argNum], "--chapter") == 0 && argNum + 1 < argc)
+      {
+         chapterName = argv[++argNum];
+      }
+      else if(strcmp(argv[argNum], "--archive") == 0 && argNum + 1 < argc)
+      {
+         archivePath = argv[++argNum];
+      }
+      else if(strcmp(argv[argNum], "--loose-files") == 0)
+      {
+         AssetArchive::setLooseFilesFirst(true);
+      }
+      else if(strcmp(argv[argNum], "--watch") == 0)
+      {
+         // Edited files are only read back if they take precedence over the archive
+         AssetArchive::setLooseFilesFirst(true);
+         watchFiles = true;
+      }
+      else if(strcmp(argv[argNum], "--trace-resources") == 0)
+      {
+         traceResources = true;
+      }
+      else if(strcmp(argv[argNum], "--record") == 0 && argNum + 1 < argc)
+      {
+         recordPath = argv[++argNum];
+      }
+      else if(strcmp(argv[argNum], "--replay") == 0 && argNum + 1 < argc)
+      {
+         replayPath = argv[++argNum];
+      }
+      else if(strcmp(argv[argNum], "--language") == 0 && argNum + 1 < argc)
+      {
+         language = argv[++argNum];
+      }
+      else if(strcmp(argv[argNum], "--hitches") == 0 && argNum + 1 < argc)
+      {
+         sscanf(argv[++argNum], "%lf:%d", &hitchThreshold, &hitchFrames);
+      }
+      else if(strcmp(argv[argNum], "--profile-server") == 0 && argNum + 1 < argc)
+      {
+         profileServerPort = atoi(argv[++argNum]);
+      }
+      else if(strcmp(argv[argNum], "--sample-scripts") == 0 && argNum + 1 < argc)
+      {
+         scriptSampleInterval = atoi(argv[++argNum]);
+      }
+      else if(strcmp(argv[argNum], "--time-scale") == 0 && argNum + 1 < argc)
+      {
+         EngineClock::setTimeScale(atof(argv[++argNum]));
+      }
+      else if(strcmp(argv[argNum], "--pathfinding") == 0 && argNum + 1 < argc && (strcmp(argv[argNum + 1], "jps") == 0 || strcmp(argv[argNum + 1], "astar") == 0))
+      {
+         // Maps that name their own search mode keep it
+         Pathfinder::setDefaultSearchMode(strcmp(argv[++argNum], "jps") == 0 ? Pathfinder::JUMP_POINT_SEARCH : Pathfinder::A_STAR_SEARCH);
+      }
+      else if(strcmp(argv[argNum], "--log") == 0 && argNum + 1 < argc && DebugUtils::configure(argv[argNum + 1]))
+      {
+         ++argNum;
+      }
+      else
+      {
+         printf("Usage: %s [--headless] [--audio <rate>:<buffer>:<channels>] [--frames <count>] [--render-scale <scale>[:<budget>]] [--no-pipelining] [--chapter <name>] [--archive <path>] [--loose-files] [--watch] [--trace-resources] [--record <path>] [--replay <path>] [--language <name>] [--log <level>[:<categories>]] [--hitches <threshold>[:<frames>]] [--time-scale <factor>] [--pathfinding <jps|astar>] [--profile-server <port>] [--sample-scripts <instructions>]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   DebugUtils::startLogThread();
+
    try
    {
+      // The archive has to be mounted before anything (even the GUI's fonts) is loaded
+      const int archivePhase = StartupTimeline::begin("asset archive");
+      if(archivePath != NULL || std::ifstream("data.edp").is_open())
+      {
+         AssetArchive::mount(archivePath != NULL ? archivePath : "data.edp");
+      }
+
+      // The baked assets are listed before anything looks for them, starting with the string table
+      ResourceLoader::loadBakeManifest("data/baked/manifest.txt");
+
+      // The string table is read out of the archive too, if it was packed into one
+      StringTable::setLanguage(language);
+      StartupTimeline::end(archivePhase);
+
+      // The workers are shared by everything that runs in the background, from resource loads to NPC idle functions
+      const int jobPhase = StartupTimeline::begin("job system");
+      JobSystem::start();
+      StartupTimeline::end(jobPhase);
+
+      // The audio device opens on a worker while the window, OpenGL and the GUI's font are set up
+      AudioSystem::openInBackground();
+      const int graphicsPhase = StartupTimeline::begin("graphics");
       GraphicsUtil::getInstance();
+      StartupTimeline::end(graphicsPhase);
+
+      if(watchFiles && !ResourceLoader::watchFiles("data"))
+      {
+         DEBUG("Unable to watch the data directory; resources won't be reloaded when their files change.");
+      }
+
+      const int manifestPhase = StartupTimeline::begin("prefetch manifest");
+      ResourceLoader::loadManifest("data/prefetch.edm", traceResources);
+      StartupTimeline::end(manifestPhase);
+
+      if(replayPath != NULL)
+      {
+         if(!InputReplay::play(replayPath))
+         {
+            return 1;
+         }
+
+         // The recorded input only plays out the same way with the same random numbers
+         RandomStreams::setInitialSeed(InputReplay::getSeed());
+      }
+      else if(recordPath != NULL && !InputReplay::record(recordPath, RandomStreams::getInitialSeed()))
+      {
+         return 1;
+      }
+
       DEBUG("Initializing execution stack.");
       ExecutionStack stack;
-      DEBUG("Pushing Main Menu state.");
-      stack.pushState(new MainMenu(stack));
+      stack.setFrameLimit(frameLimit);
+      stack.setPipelined(pipelined);
+
+      // Headless runs are for timing, so frames are drawn as fast as they can be
+      if(GraphicsUtil::isHeadless())
+      {
+         stack.getFramePacer().setTargetFrameRate(0);
+      }
+
+      const int statePhase = StartupTimeline::begin(chapterName != NULL ? "tile engine" : "title screen");
+      if(chapterName != NULL)
+      {
+         DEBUG("Pushing Tile Engine state for chapter %s.", chapterName);
+         stack.pushState(new TileEngine(stack, chapterName));
+      }
+      else
+      {
+         DEBUG("Pushing Main Menu state.");
+         stack.pushState(new MainMenu(stack));
+      }
+      StartupTimeline::end(statePhase);
+
+      if(hitchThreshold > 0)
+      {
+         FrameProfiler::setHitchDetection(hitchThreshold, hitchFrames, "hitch-");
+      }
+
+      // The viewer is sent the zones recorded by the profiler, which is only enabled here on the main thread
+      if(profileServerPort > 0 && ProfileServer::start(profileServerPort))
+      {
+         FrameProfiler::setEnabled(true);
+      }
+
+      if(scriptSampleInterval > 0)
+      {
+         ScriptSampler::setEnabled(true, scriptSampleInterval);
+      }
+
       DEBUG("Beginning game execution.");
+      const Uint32 startTime = SDL_GetTicks();
       stack.execute();
+      const Uint32 runTime = SDL_GetTicks() - startTime;
+
+      if(frameLimit > 0 || replayPath != NULL)
+      {
+         const int framesDrawn = stack.getFramesDrawn();
+         printf("Drew %d frames in %ums (%.3fms per frame)\n", framesDrawn, static_cast<unsigned int>(runTime),
+               framesDrawn > 0 ? static_cast<double>(runTime) / framesDrawn : 0.0);
+
+         std::vector<std::string> startupLines;
+         StartupTimeline::describe(startupLines);
+         for(std::vector<std::string>::const_iterator iter = startupLines.begin(); iter != startupLines.end(); ++iter)
+         {
+            printf("Startup: %s\n", iter->c_str());
+         }
+      }
+
+      // States left on the stack by the frame limit still hold resources and GUI widgets
+      stack.clear();
+      InputReplay::stop();
+
+      // Saves still being written in the background are finished before the game exits
+      SaveGameWriter::stop();
+      ProfileServer::stop();
+
+      if(scriptSampleInterval > 0)
+      {
+         ScriptSampler::writeCollapsedStacks("script_samples.folded");
+      }
 
       DEBUG("Game is finished. Freeing resources and destroying singletons.");
+      GraphicsUtil::getInstance()->closeFont();
       ResourceLoader::freeAll();
+      JobSystem::stop();
+      FrameArena::release();
+      AudioSystem::close();
       GraphicsUtil::destroy();
+      AssetArchive::unmount();
    }
    catch (gcn::Exception& e)
    {
-      DEBUG("Uncaught Guichan exception: \n%s", e.getMessage().c_str());
+      LOG_ERROR("Uncaught Guichan exception: \n%s", e.getMessage().c_str());
       return 1;
    }
    catch(Exception& e)
    {
-      DEBUG("Uncaught game exception: \n%s", e.getMessage().c_str());
+      LOG_ERROR("Uncaught game exception: \n%s", e.getMessage().c_str());
       return 1;
    }
    catch(std::exception& e)
    {
-      DEBUG("Uncaught STL exception: \n%s", e.what());
+      LOG_ERROR("Uncaught STL exception: \n%s", e.what());
       return 1;
    }
    catch(...)
    {
-      DEBUG("Uncaught general exception.");
+      LOG_ERROR("Uncaught general exception.");
       return 1;
    }
 